@@ -8,14 +8,14 @@ AC_ARG_ENABLE(drivers,
 	[  --enable-drivers=<list> compile drivers for LCDs in <list>,]
 	[                  which is a comma-separated list of drivers.]
 	[                  Possible drivers are:]
-	[                    bayrad,CFontz,CFontzPacket,curses,CwLnx,ea65,]
+	[                    bayrad,bench,CFontz,CFontzPacket,curses,CwLnx,ea65,]
 	[                    EyeboxOne,futaba,g15,glcd,glcdlib,glk,hd44780,i2500vfd,]
 	[                    icp_a106,imon,imonlcd,IOWarrior,irman,irtrans,]
 	[                    joy,jw002,lb216,lcdm001,lcterm,linux_input,lirc,lis,MD8800,mdm166a,]
-	[                    ms6931,mtc_s16209x,MtxOrb,mx5000,NoritakeVFD,]
+	[                    ms6931,mtc_s16209x,MtxOrb,mx5000,netlcd,NoritakeVFD,]
 	[                    Olimex_MOD_LCD1x9,picolcd,pyramid,rawserial,]
 	[                    sdeclcd,sed1330,sed1520,serialPOS,serialVFD,]
-	[                    shuttleVFD,sli,stv5730,SureElec,svga,t6963,text,]
+	[                    shm,shuttleVFD,sli,stv5730,SureElec,svga,t6963,text,]
 	[                    tyan,ula200,vlsys_m428,xosd,yard2LCD]
 	[                    ]
 	[                  'all' compiles all drivers;]
@@ -23,7 +23,7 @@ AC_ARG_ENABLE(drivers,
 	drivers="$enableval",
 	drivers=[bayrad,CFontz,CFontzPacket,curses,CwLnx,glk,lb216,lcdm001,MtxOrb,pyramid,text])
 
-allDrivers=[bayrad,CFontz,CFontzPacket,curses,CwLnx,ea65,EyeboxOne,futaba,g15,glcd,glcdlib,glk,hd44780,i2500vfd,icp_a106,imon,imonlcd,IOWarrior,irman,irtrans,joy,jw002,lb216,lcdm001,lcterm,linux_input,lirc,lis,MD8800,mdm166a,ms6931,mtc_s16209x,MtxOrb,mx5000,NoritakeVFD,Olimex_MOD_LCD1x9,picolcd,pyramid,sdeclcd,sed1330,sed1520,serialPOS,serialVFD,shuttleVFD,sli,stv5730,SureElec,svga,t6963,text,tyan,ula200,vlsys_m428,xosd,rawserial,yard2LCD]
+allDrivers=[bayrad,bench,CFontz,CFontzPacket,curses,CwLnx,ea65,EyeboxOne,futaba,g15,glcd,glcdlib,glk,hd44780,i2500vfd,icp_a106,imon,imonlcd,IOWarrior,irman,irtrans,joy,jw002,lb216,lcdm001,lcterm,linux_input,lirc,lis,MD8800,mdm166a,ms6931,mtc_s16209x,MtxOrb,mx5000,netlcd,NoritakeVFD,Olimex_MOD_LCD1x9,picolcd,pyramid,sdeclcd,sed1330,sed1520,serialPOS,serialVFD,shm,shuttleVFD,sli,stv5730,SureElec,svga,t6963,text,tyan,ula200,vlsys_m428,xosd,rawserial,yard2LCD]
 if test "$debug" = yes; then
 	allDrivers=["${allDrivers},debug"]
 fi
@@ -55,6 +55,10 @@ for driver in $selectdrivers ; do
 			DRIVERS="$DRIVERS bayrad${SO}"
 			actdrivers=["$actdrivers bayrad"]
 			;;
+		bench)
+			DRIVERS="$DRIVERS bench${SO}"
+			actdrivers=["$actdrivers bench"]
+			;;
 		CFontz)
 			DRIVERS="$DRIVERS CFontz${SO}"
 			actdrivers=["$actdrivers CFontz"]
@@ -211,6 +215,12 @@ dnl				else
 			if test "$enable_libX11" = yes ; then
 				GLCD_DRIVERS="$GLCD_DRIVERS glcd-glcd-x11.o"
 			fi
+			AC_CHECK_HEADERS([linux/fb.h],[
+				GLCD_DRIVERS="$GLCD_DRIVERS glcd-glcd-fbdev.o"
+			])
+			if test "$ac_cv_search_shm_open" != no ; then
+				GLCD_DRIVERS="$GLCD_DRIVERS glcd-glcd-shm.o"
+			fi
 			DRIVERS="$DRIVERS glcd${SO}"
 			actdrivers=["$actdrivers glcd"]
 			;;
@@ -439,6 +449,10 @@ dnl			else
 				AC_MSG_WARN([The mx5000 driver needs libmx5000/mx5000.h])
 			])
 			;;
+		netlcd)
+			DRIVERS="$DRIVERS netlcd${SO}"
+			actdrivers=["$actdrivers netlcd"]
+			;;
 		NoritakeVFD)
 			DRIVERS="$DRIVERS NoritakeVFD${SO}"
 			actdrivers=["$actdrivers NoritakeVFD"]
@@ -508,6 +522,14 @@ dnl			else
 			DRIVERS="$DRIVERS serialVFD${SO}"
 			actdrivers=["$actdrivers serialVFD"]
 			;;
+		shm)
+			if test "$ac_cv_search_shm_open" != no ; then
+				DRIVERS="$DRIVERS shm${SO}"
+				actdrivers=["$actdrivers shm"]
+			else
+				AC_MSG_WARN([The shm driver needs the shm_open function])
+			fi
+			;;
 		shuttleVFD)
 			if test "$enable_libusb" = yes ; then
 				DRIVERS="$DRIVERS shuttleVFD${SO}"
@@ -605,10 +627,61 @@ dnl			else
 	esac
 done
 
+dnl link drivers into LCDd instead of building modules
+AC_ARG_ENABLE(static-drivers,
+	[  --enable-static-drivers=<list> link the drivers in <list> into LCDd]
+	[                  instead of building them as loadable modules;]
+	[                  'all' links all compiled drivers into LCDd],
+	static_drivers="$enableval",
+	static_drivers=no)
+
+STATIC_DRIVERS=""
+if test "$static_drivers" = all -o "$static_drivers" = yes; then
+	static_drivers="$actdrivers"
+elif test "$static_drivers" = no; then
+	static_drivers=""
+fi
+for driver in `echo $static_drivers | sed -e 's/,/ /g'`; do
+	case " $actdrivers " in
+		*" $driver "*)
+			DRIVERS=`echo " $DRIVERS " | sed -e "s/ ${driver}${SO} / /"`
+			STATIC_DRIVERS="$STATIC_DRIVERS ${driver}${SO}"
+			;;
+		*)
+			AC_MSG_WARN([Driver $driver is not compiled, so it cannot be linked into LCDd])
+			;;
+	esac
+done
+if test -n "$STATIC_DRIVERS"; then
+	AC_CHECK_TOOL(OBJCOPY, objcopy, no)
+	AC_CHECK_TOOL(NM, nm, no)
+	if test "$OBJCOPY" = no -o "$NM" = no; then
+		AC_MSG_ERROR([Linking drivers into LCDd needs objcopy and nm])
+	fi
+	dnl objcopy cannot rename the symbols of LTO objects: optimise the
+	dnl drivers when they are linked into a relocatable object instead
+	STATIC_LDFLAGS=""
+	case " $CFLAGS " in
+		*" -flto"*)
+			STATIC_LDFLAGS="-flinker-output=nolto-rel"
+			;;
+	esac
+	AC_DEFINE(HAVE_STATIC_DRIVERS, [1], [Define to 1 if drivers are linked into LCDd])
+fi
+AC_SUBST(STATIC_LDFLAGS)
+AM_CONDITIONAL(STATIC_DRIVERS, test -n "$STATIC_DRIVERS")
+
 AC_MSG_RESULT([---------------------------------------])
 AC_MSG_RESULT([LCDd will be compiled with the drivers:])
 for driver in $actdrivers; do
-	AC_MSG_RESULT([    -  $driver])
+	case " $STATIC_DRIVERS " in
+		*" ${driver}${SO} "*)
+			AC_MSG_RESULT([    -  $driver (linked into LCDd)])
+			;;
+		*)
+			AC_MSG_RESULT([    -  $driver])
+			;;
+	esac
 done
 AC_MSG_RESULT([---------------------------------------])
 
@@ -617,6 +690,7 @@ AC_SUBST(LIBIRMAN)
 AC_SUBST(LIBLIRC_CLIENT)
 AC_SUBST(LIBSVGA)
 AC_SUBST(DRIVERS)
+AC_SUBST(STATIC_DRIVERS)
 AC_SUBST(HD44780_DRIVERS)
 AC_SUBST(HD44780_I2C)
 AC_SUBST(GLCD_DRIVERS)
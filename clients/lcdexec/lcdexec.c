@@ -21,6 +21,8 @@
 #include <time.h>
 #include <sys/wait.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <spawn.h>
 
 #include "getopt.h"
 
@@ -28,6 +30,7 @@
 #include "shared/report.h"
 #include "shared/configfile.h"
 #include "shared/sockets.h"
+#include "shared/lcdclient.h"
 
 #include "menu.h"
 
@@ -42,6 +45,11 @@
 #define DEFAULT_CONFIGFILE	SYSCONFDIR "/lcdexec.conf"
 #define DEFAULT_PIDFILE		PIDFILEDIR "/lcdexec.pid"
 
+/** Characters that need a shell to run a command */
+#define SHELL_CHARS	"\"'`$\\|&;<>(){}[]*?~#=%!^\n"
+/** Most words of a command that is started without a shell */
+#define MAX_WORDS	32
+
 
 /** information about a process started by lcdexec */
 typedef struct ProcInfo {
@@ -53,6 +61,11 @@ typedef struct ProcInfo {
 	int status;		/**< exit status of the process */
 	int feedback;		/**< what info to show to the user */
 	int shown;		/**< tell if the info has been shown to the user */
+	int out_fd;		/**< read end of the process' output, -1 if none */
+	char *out_lines;	/**< last lines of output, out_rows of lcd_wid+1 bytes */
+	int out_rows;		/**< number of output lines on the screen */
+	int out_col;		/**< column in the last output line */
+	int out_screen;		/**< tell if the output screen has been added */
 } ProcInfo;
 
 
@@ -96,6 +109,7 @@ int lcd_wid = 0;		/**< LCD display width reported by the server */
 int lcd_hgt = 0;		/**< LCD display height reported by the server */
 
 int sock = -1;			/**< socket to connect to server */
+static int use_menu_batch = TRUE;	/**< server takes menu_batch */
 
 int Quit = 0;			/**< indicate end of main loop */
 
@@ -109,6 +123,153 @@ static int connect_and_setup(void);
 static int process_response(char *str);
 static int exec_command(MenuEntry *cmd);
 static int show_procinfo_msg(ProcInfo *p);
+static int show_output(ProcInfo *p);
+static void free_procinfo(ProcInfo *p);
+/** Start a new line of output, scrolling the others up. */
+static void output_newline(ProcInfo *p)
+{
+	memmove(p->out_lines, p->out_lines + lcd_wid + 1, (p->out_rows - 1) * (lcd_wid + 1));
+	memset(p->out_lines + (p->out_rows - 1) * (lcd_wid + 1), '\0', lcd_wid + 1);
+	p->out_col = 0;
+}
+
+
+/** Add text to the output lines; characters beyond the width are cut. */
+static void output_add(ProcInfo *p, const char *text, int len)
+{
+	char *last = p->out_lines + (p->out_rows - 1) * (lcd_wid + 1);
+	int i;
+
+	for (i = 0; i < len; i++) {
+		unsigned char c = text[i];
+
+		if (c == '\n')
+			output_newline(p);
+		else if (c == '\r') {
+			memset(last, '\0', lcd_wid + 1);
+			p->out_col = 0;
+		}
+		else if (p->out_col < lcd_wid) {
+			if (c == '\t')
+				c = ' ';
+			else if (c == '{')
+				c = '(';
+			else if (c == '}')
+				c = ')';
+			else if ((c < 32) || (c >= 128))
+				c = '?';
+			last[p->out_col++] = c;
+		}
+	}
+}
+
+
+/**
+ * Read what a process wrote. After it finished, its output is read to
+ * the end and the pipe closed.
+ * \return  1 if output came, 0 if not.
+ */
+static int read_output(ProcInfo *p)
+{
+	char buf[512];
+	int len, got = 0;
+
+	while ((len = read(p->out_fd, buf, sizeof(buf))) > 0) {
+		if (p->out_lines != NULL)
+			output_add(p, buf, len);
+		got = 1;
+	}
+	/* done at its end, or when it finished: whatever it started may keep the pipe */
+	if ((len == 0) || ((len < 0) && (errno != EAGAIN) && (errno != EINTR)) || (p->endtime > 0)) {
+		close(p->out_fd);
+		p->out_fd = -1;
+	}
+	return got;
+}
+
+
+/**
+ * Show the output of a process on its screen, and at its end how it
+ * finished. The screen stays for a while afterwards.
+ * \return  1 if the end was shown, 0 if not.
+ */
+static int show_output(ProcInfo *p)
+{
+	int row;
+
+	if ((lcd_wid <= 0) || (lcd_hgt <= 0))
+		return (p->endtime > 0);
+
+	if (!p->out_screen) {
+		p->out_rows = (lcd_hgt > 2) ? lcd_hgt - 1 : lcd_hgt;
+		p->out_lines = calloc(p->out_rows, lcd_wid + 1);
+		if (p->out_lines == NULL)
+			return (p->endtime > 0);
+		p->out_screen = 1;
+
+		/* the screen goes to the server at once */
+		sock_cork(sock);
+		sock_printf(sock, "screen_add [%u]\n", p->pid);
+		sock_printf(sock, "screen_set [%u] -name {lcdexec [%u]}"
+				  " -priority foreground -heartbeat off\n",
+				p->pid, p->pid);
+		if (lcd_hgt > 2) {
+			sock_printf(sock, "widget_add [%u] t title\n", p->pid);
+			sock_printf(sock, "widget_set [%u] t {%s}\n", p->pid, p->cmd->displayname);
+		}
+		for (row = 0; row < p->out_rows; row++)
+			sock_printf(sock, "widget_add [%u] o%d string\n", p->pid, row);
+		sock_uncork(sock);
+	}
+
+	if (p->out_fd >= 0)
+		read_output(p);
+
+	if ((p->endtime > 0) && (p->out_fd < 0)) {
+		char status[40];
+
+		if (WIFEXITED(p->status) && (WEXITSTATUS(p->status) == EXIT_SUCCESS))
+			snprintf(status, sizeof(status), "[succeeded]");
+		else if (WIFEXITED(p->status))
+			snprintf(status, sizeof(status), "[finished (0x%02X)]", WEXITSTATUS(p->status));
+		else
+			snprintf(status, sizeof(status), "[killed by SIG %d]", WTERMSIG(p->status));
+		if (p->out_col > 0)
+			output_newline(p);
+		output_add(p, status, strlen(status));
+	}
+
+	/* lines that did not change are left out */
+	sock_cork(sock);
+	for (row = 0; row < p->out_rows; row++)
+		lcd_client_printf(sock, "widget_set [%u] o%d 1 %d {%s}\n", p->pid, row,
+				  row + lcd_hgt - p->out_rows + 1,
+				  p->out_lines + row * (lcd_wid + 1));
+	if ((p->endtime > 0) && (p->out_fd < 0))
+		sock_printf(sock, "screen_set [%u] -priority alert -timeout %d\n", p->pid, 6*8);
+	sock_uncork(sock);
+
+	return ((p->endtime > 0) && (p->out_fd < 0));
+}
+
+
+/** Free a ProcInfo that has been removed from the queue. */
+static void free_procinfo(ProcInfo *p)
+{
+	if (p->out_fd >= 0)
+		close(p->out_fd);
+	if (p->out_lines != NULL) {
+		char screen[16];
+
+		/* a later process may get the same pid, and screen id */
+		snprintf(screen, sizeof(screen), "[%u]", p->pid);
+		lcd_client_forget(screen);
+		free(p->out_lines);
+	}
+	free(p);
+}
+
+
 static int main_loop(void);
 
 
@@ -200,8 +361,8 @@ static void sigchld_handler(int signal)
 	pid_t pid;
 	int status;
 
-	/* wait for the child that was signalled as finished */
-	if ((pid = wait(&status)) != -1) {
+	/* wait for the children that finished; signals may have merged */
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
 		ProcInfo *p;
 
 		/* fill the procinfo structure with the necessary information */
@@ -372,12 +533,15 @@ static int connect_and_setup(void)
 			sock_printf(sock, "client_set -name {%s}\n", progname);
 	}
 
-	/* Create our menu */
-	if (menu_sock_send(main_menu, NULL, sock) < 0) {
+	/* Create our menu, all items in one go */
+	sock_cork(sock);
+	if (((use_menu_batch) ? menu_sock_send_batch(main_menu, sock)
+			      : menu_sock_send(main_menu, NULL, sock)) < 0) {
+		sock_uncork(sock);
 		return -1;
 	}
 
-	return 0;
+	return (sock_uncork(sock) < 0) ? -1 : 0;
 }
 
 
@@ -482,14 +646,12 @@ static int process_response(char *str)
 		}
 	}
 	else if (strcmp(argv[0], "connect") == 0) {
-		int a;
+		LCDServerInfo info;
 
 		/* determine display height and width */
-		for (a = 1; a < argc; a++) {
-			if (strcmp(argv[a], "wid") == 0)
-				lcd_wid = atoi(argv[++a]);
-			else if (strcmp(argv[a], "hgt") == 0)
-				lcd_hgt = atoi(argv[++a]);
+		if (lcd_client_parse_connect(argc, argv, &info) == 0) {
+			lcd_wid = info.wid;
+			lcd_hgt = info.hgt;
 		}
 	}
 	else if (strcmp(argv[0], "bye") == 0) {
@@ -498,6 +660,19 @@ static int process_response(char *str)
 		exit_program(EXIT_SUCCESS);
 	}
 	else if (strcmp(argv[0], "huh?") == 0) {
+		if ((argc > 3) && (strcmp(argv[1], "Invalid") == 0)
+		    && (strcmp(argv[3], "\"menu_batch\"") == 0)) {
+			/* An older server: send the menu command by command,
+			 * once for all the batches it refused */
+			if (use_menu_batch) {
+				report(RPT_INFO, "Server does not know menu_batch, sending the menu item by item");
+				use_menu_batch = FALSE;
+				sock_cork(sock);
+				menu_sock_send(main_menu, NULL, sock);
+				sock_uncork(sock);
+			}
+			return 0;
+		}
 		/* Report errors */
 		report(RPT_WARNING, "Server said: \"%s\"", str);
 	}
@@ -512,23 +687,79 @@ err_invalid:
 }
 
 
+/**
+ * Start a command. A command of plain words, without quotes, variables,
+ * redirections and the like, is started directly; only others and those
+ * that cannot be started so (e.g. shell builtins) go through the shell,
+ * which saves its startup on every action.
+ * \param command  Command line.
+ * \param envp     Environment of the command.
+ * \param out_fd   Descriptor to send its output to, or -1.
+ * \param sigmask  Signal mask for the command.
+ * \param pid      Where to put the process id.
+ * \retval 0   Started.
+ * \retval -1  Could not be started.
+ */
+static int spawn_command(const char *command, char **envp, int out_fd,
+			 const sigset_t *sigmask, pid_t *pid)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	char *words = NULL;
+	char *argv[MAX_WORDS + 1];
+	int err = -1;
+
+	posix_spawn_file_actions_init(&actions);
+	if (out_fd >= 0) {
+		posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+		posix_spawn_file_actions_adddup2(&actions, out_fd, STDERR_FILENO);
+	}
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setsigmask(&attr, sigmask);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+	if ((strpbrk(command, SHELL_CHARS) == NULL) && ((words = strdup(command)) != NULL)) {
+		char *word = strtok(words, " \t");
+		int n = 0;
+
+		while ((word != NULL) && (n < MAX_WORDS)) {
+			argv[n++] = word;
+			word = strtok(NULL, " \t");
+		}
+		argv[n] = NULL;
+		if ((n > 0) && (word == NULL)) {
+			debug(RPT_DEBUG, "Executing '%s' directly", command);
+			err = posix_spawnp(pid, argv[0], &actions, &attr, argv, envp);
+		}
+	}
+	if (err != 0) {
+		const char *shell_argv[4] = { default_shell, "-c", command, NULL };
+
+		debug(RPT_DEBUG, "Executing '%s' via Shell %s", command, default_shell);
+		err = posix_spawn(pid, default_shell, &actions, &attr, (char **) shell_argv, envp);
+		if (err != 0)
+			report(RPT_ERR, "Could not execute %s: %s", default_shell, strerror(err));
+	}
+
+	free(words);
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+	return (err == 0) ? 0 : -1;
+}
+
+
 static int exec_command(MenuEntry *cmd)
 {
 	if ((cmd != NULL)  && (menu_command(cmd) != NULL)) {
 		const char *command = menu_command(cmd);
-		const char *argv[4];
 		pid_t pid;
 		ProcInfo *p;
 		char *envp[cmd->numChildren+1];
 		MenuEntry *arg;
+		int out[2] = { -1, -1 };
+		sigset_t chld, oldmask;
 		int i;
 
-		/* set argument vector */
-		argv[0] = default_shell;
-		argv[1] = "-c";
-		argv[2] = command;
-		argv[3] = NULL;
-
 		/* set environment vector: allocate & fill contents */
 		for (arg = cmd->children, i = 0; arg != NULL; arg = arg->next, i++) {
 			char buf[1025];
@@ -573,37 +804,53 @@ static int exec_command(MenuEntry *cmd)
 		}
 		envp[cmd->numChildren] = NULL;
 
-		debug(RPT_DEBUG, "Executing '%s' via Shell %s", command, default_shell);
+		/* a pipe for the output to show */
+		if (cmd->data.exec.output) {
+			if (pipe(out) < 0) {
+				report(RPT_WARNING, "Could not create pipe: %s", strerror(errno));
+				out[0] = out[1] = -1;
+			}
+			else {
+				fcntl(out[0], F_SETFD, FD_CLOEXEC);
+				fcntl(out[1], F_SETFD, FD_CLOEXEC);
+				fcntl(out[0], F_SETFL, O_NONBLOCK);
+			}
+		}
 
-		switch (pid = fork()) {
-		  case 0:
-			/* We're the child: execute the command */
-			execve(argv[0], (char **) argv, envp);
-			exit(EXIT_SUCCESS);
-			break;
-		  default:
-			/* We're the parent: setup the ProcInfo structure */
+		/* the process must be in the queue before SIGCHLD can tell of its end */
+		sigemptyset(&chld);
+		sigaddset(&chld, SIGCHLD);
+		sigprocmask(SIG_BLOCK, &chld, &oldmask);
+
+		if (spawn_command(command, envp, out[1], &oldmask, &pid) == 0) {
+			/* setup the ProcInfo structure */
 			p = calloc(1, sizeof(ProcInfo));
 			if (p != NULL) {
 				p->cmd = cmd;
 				p->pid = pid;
 				p->starttime = time(NULL);
 				p->feedback = cmd->data.exec.feedback;
-				/* prepend it to existing queue atomically */
+				p->out_fd = out[0];
+				out[0] = -1;
+				/* prepend it to existing queue */
 				p->next = proc_queue;
 				proc_queue = p;
 			}
-        		break;
-		  case -1:
-			report(RPT_ERR, "Could not fork");
-			return -1;
 		}
+		else
+			pid = -1;
+		sigprocmask(SIG_SETMASK, &oldmask, NULL);
+
+		if (out[0] >= 0)
+			close(out[0]);
+		if (out[1] >= 0)
+			close(out[1]);
 
 		/* free envp's contents */
 		for (i = 0; envp[i] != NULL; i++)
 			free(envp[i]);
 
-		return 0;
+		return (pid > 0) ? 0 : -1;
 	}
 	return -1;
 }
@@ -611,12 +858,17 @@ static int exec_command(MenuEntry *cmd)
 
 static int show_procinfo_msg(ProcInfo *p)
 {
+	if ((p != NULL) && p->cmd->data.exec.output)
+		return show_output(p);
+
 	if ((p != NULL) && (lcd_wid > 0) && (lcd_hgt > 0)) {
 		if (p->endtime > 0) {
 			/* nothing to do => the quick way out (successful) */
 			if ((p->shown) || (!p->feedback))
 				return 1;
 
+			/* the screen goes to the server at once */
+			sock_cork(sock);
 			sock_printf(sock, "screen_add [%u]\n", p->pid);
 			sock_printf(sock, "screen_set [%u] -name {lcdexec [%u]}"
 					  " -priority alert -timeout %d"
@@ -673,6 +925,7 @@ static int show_procinfo_msg(ProcInfo *p)
 
 				}
 			}
+			sock_uncork(sock);
 			return 1;
 		}
 	}
@@ -695,6 +948,12 @@ static int main_loop(void)
 			/* wait for 1/10th of a second */
 			usleep(100000);
 
+			/* show the output of running processes as it comes */
+			for (p = proc_queue; p != NULL; p = p->next) {
+				if ((p->out_fd >= 0) && !p->shown)
+					p->shown |= show_output(p);
+			}
+
 			/* send an empty line every 3 seconds to make sure the server still exists */
 			if (keepalive_delay++ >= 30) {
 				keepalive_delay = 0;
@@ -713,14 +972,14 @@ static int main_loop(void)
 
 					if ((pn != NULL) && (pn->shown)) {
 						p->next = pn->next;
-						free(pn);
+						free_procinfo(pn);
 					}
 				}
 				/* deleting queue head is special */
 				if ((proc_queue != NULL) && (proc_queue->shown)) {
 					p = proc_queue;
 					proc_queue = proc_queue->next;
-					free(p);
+					free_procinfo(p);
 				}
 
 				/* look for a process to display, display it & mark it as shown */
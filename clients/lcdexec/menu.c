@@ -16,6 +16,7 @@
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
+#include <stdarg.h>
 
 #include "shared/report.h"
 #include "shared/configfile.h"
@@ -24,6 +25,13 @@
 #include "menu.h"
 
 
+/** Most commands sent in one menu_batch */
+#define MENU_BATCH_LINES	8
+/** Longest menu_batch sent; the server takes messages of up to 8 kB */
+#define MENU_BATCH_SIZE		4000
+/** Longest menu command */
+#define MENU_LINE_SIZE		2048
+
 /* names for boolean and tristate values */
 static char *boolValueName[] = { "false", "true" };
 static char *triGrayValueName[] = { "off", "on", "gray" };
@@ -93,6 +101,7 @@ MenuEntry *menu_read(MenuEntry *parent, const char *name)
 				return NULL;
 			}
 			me->data.exec.feedback = config_get_bool(name, "Feedback", 0, 0);
+			me->data.exec.output = config_get_bool(name, "Output", 0, 0);
 
 			// try to read parameters
 			while ((entryname = config_get_string(name, "Parameter", me->numChildren, NULL)) != NULL) {
@@ -243,12 +252,75 @@ MenuEntry *menu_read(MenuEntry *parent, const char *name)
 	return NULL;
 }
 
+/* menu_batch being built by menu_printf(), see menu_sock_send_batch() */
+static int batching = 0;
+static char batch[MENU_BATCH_SIZE + MENU_LINE_SIZE];
+static size_t batch_len = 0;
+static int batch_lines = 0;
+
+
+/** send the menu_batch built so far */
+static int menu_flush(int sock)
+{
+	size_t len = batch_len;
+
+	if (batch_lines == 0)
+		return 0;
+
+	batch[len++] = '\n';
+	batch_len = 0;
+	batch_lines = 0;
+	return sock_send(sock, batch, len);
+}
+
+
+/**
+ * Send a printf-like formatted menu command. While batching, the command
+ * is added to a menu_batch instead, which is sent when it is full.
+ */
+static int menu_printf(int sock, const char *format, .../*args*/)
+{
+	char line[MENU_LINE_SIZE];
+	va_list ap;
+	int len;
+
+	va_start(ap, format);
+	len = vsnprintf(line, sizeof(line), format, ap);
+	va_end(ap);
+
+	if ((len < 0) || ((size_t) len >= sizeof(line))) {
+		report(RPT_ERR, "menu command too long");
+		return -1;
+	}
+	if (!batching)
+		return sock_send(sock, line, len);
+
+	/* An argument ";" would end the command early in a batch */
+	if ((strstr(line, "\";\"") != NULL) || (strstr(line, "{;}") != NULL)) {
+		if (menu_flush(sock) < 0)
+			return -1;
+		return sock_send(sock, line, len);
+	}
+
+	if (line[len - 1] == '\n')
+		line[--len] = '\0';
+	if ((batch_lines >= MENU_BATCH_LINES) || (batch_len + 3 + len > MENU_BATCH_SIZE)) {
+		if (menu_flush(sock) < 0)
+			return -1;
+	}
+	batch_len += sprintf(batch + batch_len, "%s%s",
+			     (batch_lines == 0) ? "menu_batch " : " ; ", line);
+	batch_lines++;
+	return len;
+}
+
+
 /* Helper for repetitive code */
 static int menu_set_quit(MenuEntry *me, int sock) {
 	if (me->next != NULL)
 		return 0;
 
-	return sock_printf(sock, "menu_set_item {} {%d} -next _quit_\n",
+	return menu_printf(sock, "menu_set_item {} {%d} -next _quit_\n",
 			   me->id);
 }
 
@@ -270,7 +342,7 @@ int menu_sock_send(MenuEntry *me, MenuEntry *parent, int sock)
 			case MT_MENU:
 				// don't create a separate entry for the main menu
 				if ((parent != NULL) && (me->id != 0)) {
-					if (sock_printf(sock, "menu_add_item \"%s\" \"%d\" menu \"%s\"\n",
+					if (menu_printf(sock, "menu_add_item \"%s\" \"%d\" menu \"%s\"\n",
 							parent_id, me->id, me->displayname) < 0)
 						return -1;
 				}
@@ -283,17 +355,17 @@ int menu_sock_send(MenuEntry *me, MenuEntry *parent, int sock)
 				break;
 			case MT_EXEC:
 				if (me->children == NULL) {
-					if (sock_printf(sock, "menu_add_item \"%s\" \"%d\" action \"%s\"\n",
+					if (menu_printf(sock, "menu_add_item \"%s\" \"%d\" action \"%s\"\n",
 							parent_id, me->id, me->displayname) < 0)
 						return -1;
 
-					if (sock_printf(sock, "menu_set_item {} {%d} -menu_result quit\n",
+					if (menu_printf(sock, "menu_set_item {} {%d} -menu_result quit\n",
 							me->id) < 0)
 						return -1;
 				}
 				else {
 					if ((parent != NULL) && (me->id != 0)) {
-						if (sock_printf(sock, "menu_add_item \"%s\" \"%d\" menu \"%s\"\n",
+						if (menu_printf(sock, "menu_add_item \"%s\" \"%d\" menu \"%s\"\n",
 								parent_id, me->id, me->displayname) < 0)
 							return -1;
 					}
@@ -306,7 +378,7 @@ int menu_sock_send(MenuEntry *me, MenuEntry *parent, int sock)
 				}
 				break;
 			case MT_ARG_SLIDER:
-				if (sock_printf(sock, "menu_add_item \"%s\" \"%d\" slider -text \"%s\""
+				if (menu_printf(sock, "menu_add_item \"%s\" \"%d\" slider -text \"%s\""
 						      " -value %d -minvalue %d -maxvalue %d"
 						      " -mintext \"%s\" -maxtext \"%s\" -stepsize %d\n",
 						      parent_id, me->id, me->displayname,
@@ -336,7 +408,7 @@ int menu_sock_send(MenuEntry *me, MenuEntry *parent, int sock)
 						strcat(tmp, me->data.ring.strings[i]);
 					}
 
-					if (sock_printf(sock, "menu_add_item \"%s\" \"%d\" ring -text \"%s\""
+					if (menu_printf(sock, "menu_add_item \"%s\" \"%d\" ring -text \"%s\""
 							      " -value %d -strings \"%s\"\n",
 							      parent_id, me->id, me->displayname,
 							      me->data.ring.value,
@@ -349,7 +421,7 @@ int menu_sock_send(MenuEntry *me, MenuEntry *parent, int sock)
 
 				break;
 			case MT_ARG_NUMERIC:
-				if (sock_printf(sock, "menu_add_item \"%s\" \"%d\" numeric -text \"%s\""
+				if (menu_printf(sock, "menu_add_item \"%s\" \"%d\" numeric -text \"%s\""
 						      " -value %d -minvalue %d -maxvalue %d\n",
 						      parent_id, me->id, me->displayname,
 						      me->data.numeric.value,
@@ -362,7 +434,7 @@ int menu_sock_send(MenuEntry *me, MenuEntry *parent, int sock)
 
 				break;
 			case MT_ARG_ALPHA:
-				if (sock_printf(sock, "menu_add_item \"%s\" \"%d\" alpha -text \"%s\""
+				if (menu_printf(sock, "menu_add_item \"%s\" \"%d\" alpha -text \"%s\""
 						      " -value \"%s\" -minlength %d -maxlength %d"
 						      " -allow_caps false -allow_noncaps false"
 						      " -allow_numbers false -allowed_extra \"%s\"\n",
@@ -378,7 +450,7 @@ int menu_sock_send(MenuEntry *me, MenuEntry *parent, int sock)
 
 				break;
 			case MT_ARG_IP:
-				if (sock_printf(sock, "menu_add_item \"%s\" \"%d\" ip -text \"%s\""
+				if (menu_printf(sock, "menu_add_item \"%s\" \"%d\" ip -text \"%s\""
 						      " -value \"%s\" -v6 %s\n",
 						      parent_id, me->id, me->displayname,
 						      me->data.ip.value,
@@ -390,7 +462,7 @@ int menu_sock_send(MenuEntry *me, MenuEntry *parent, int sock)
 
 				break;
 			case MT_ARG_CHECKBOX:
-				if (sock_printf(sock, "menu_add_item \"%s\" \"%d\" checkbox -text \"%s\""
+				if (menu_printf(sock, "menu_add_item \"%s\" \"%d\" checkbox -text \"%s\""
 						      " -value %s -allow_gray %s\n",
 						      parent_id, me->id, me->displayname,
 						      triGrayValueName[me->data.checkbox.value],
@@ -402,11 +474,11 @@ int menu_sock_send(MenuEntry *me, MenuEntry *parent, int sock)
 
 				break;
 			case MT_ARG_ACTION | MT_AUTOMATIC:
-				if (sock_printf(sock, "menu_add_item \"%s\" \"%d\" action \"%s\"\n",
+				if (menu_printf(sock, "menu_add_item \"%s\" \"%d\" action \"%s\"\n",
 						parent_id, me->id, me->displayname) < 0)
 					return -1;
 
-				if (sock_printf(sock, "menu_set_item {} {%d} -menu_result quit\n",
+				if (menu_printf(sock, "menu_set_item {} {%d} -menu_result quit\n",
 						me->id) < 0)
 					return -1;
 				break;
@@ -419,6 +491,26 @@ int menu_sock_send(MenuEntry *me, MenuEntry *parent, int sock)
 }
 
 
+/**
+ * Send the menu entry hierarchy like menu_sock_send(), but in menu_batch
+ * commands of several menu commands each, which the server answers with
+ * a single reply.
+ */
+int menu_sock_send_batch(MenuEntry *me, int sock)
+{
+	int result;
+
+	batching = 1;
+	result = menu_sock_send(me, NULL, sock);
+	if (menu_flush(sock) < 0)
+		result = -1;
+	batching = 0;
+	batch_len = 0;
+	batch_lines = 0;
+	return result;
+}
+
+
 /** find menu entry by its id */
 MenuEntry *menu_find_by_id(MenuEntry *me, int id)
 {
@@ -562,6 +654,7 @@ void menu_dump(MenuEntry *me)
 			case MT_EXEC:
 				report(RPT_DEBUG, "Exec=\"%s\"", me->data.exec.command);
 				report(RPT_DEBUG, "Feedback=%s", boolValueName[me->data.exec.feedback]);
+				report(RPT_DEBUG, "Output=%s", boolValueName[me->data.exec.output]);
 
 				// dump entry's parameter referencess
 				for (entry = me->children; entry != NULL; entry = entry->next)
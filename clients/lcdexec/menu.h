@@ -58,6 +58,7 @@ typedef struct menu_entry {
 		struct exec{	// elements necessary for type MT_EXEC
 			char *command;	/**< Command to execute. */
 			int feedback;	/**< Feedback flag. */
+			int output;	/**< Show the output while the command runs. */
 		} exec;
 		struct slider {	// elements necessary for type MT_ARG_SLIDER
 			int value;	/**< Numeric value of slider. */
@@ -97,6 +98,7 @@ typedef struct menu_entry {
 
 MenuEntry *menu_read(MenuEntry *parent, const char *name);
 int menu_sock_send(MenuEntry *me, MenuEntry *parent, int sock);
+int menu_sock_send_batch(MenuEntry *me, int sock);
 MenuEntry *menu_find_by_id(MenuEntry *me, int id);
 const char *menu_command(MenuEntry *me);
 void menu_free(MenuEntry *me);
@@ -0,0 +1,746 @@
+/** \file clients/lcdload/lcdload.c
+ * Main file for \c lcdload, a load generator for stress-testing LCDd.
+ *
+ * lcdload opens a number of connections to the server, creates screens
+ * with widgets (and menu items) on each and then sends widget_set or
+ * menu_set_item commands at a given total rate, spread evenly over the
+ * connections and their widgets. Commands are pipelined: a connection
+ * does not wait for the reply to one command before sending the next, up
+ * to a limit of commands in flight. The time from sending a command to
+ * its "success" (or "huh?") reply is the server's response latency.
+ *
+ * Each report interval a line with the commands sent, replies received,
+ * achieved rate and latency is printed; a summary with latency
+ * percentiles follows at the end. Commands that were due while their
+ * connection had the most commands in flight are counted as behind: the
+ * server does not keep up with the rate asked for.
+ */
+
+/*-
+ * This file is part of lcdload, an LCDproc client.
+ *
+ * This file is released under the GNU General Public License. Refer to the
+ * COPYING file distributed with this package.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "getopt.h"
+
+#include "shared/report.h"
+#include "shared/sockets.h"
+#include "shared/lcdclient.h"
+
+#define MAX_CONNECTIONS	1000	/**< Most connections to open */
+#define MAX_PENDING	1024	/**< Most commands in flight per connection */
+#define SETUP_TIMEOUT	5000	/**< ms to wait for the replies to the setup */
+#define BUFSIZE		1024	/**< Size of the buffer for received lines */
+
+/** Kinds of widgets to drive */
+typedef enum {
+	KIND_STRING = 's',
+	KIND_HBAR = 'h',
+	KIND_VBAR = 'v',
+	KIND_SCROLLER = 'c',
+	KIND_MENU = 'm',
+} WidgetKind;
+
+/** A connection to the server */
+typedef struct Connection {
+	int fd;				/**< Socket, -1 when closed */
+	int index;			/**< Number of the connection */
+	char buf[BUFSIZE];		/**< Received characters of an incomplete line */
+	int buffered;			/**< Number of characters in buf */
+	unsigned long sent[MAX_PENDING];	/**< Send times of the commands in flight */
+	int first;			/**< Oldest command in flight in sent */
+	int pending;			/**< Number of commands in flight */
+	unsigned long updates;		/**< Number of widget updates sent */
+} Connection;
+
+/** Counters of a report interval or the whole run */
+typedef struct LoadStats {
+	unsigned long sent;		/**< Commands sent */
+	unsigned long replies;		/**< Replies received */
+	unsigned long errors;		/**< Replies that were errors */
+	unsigned long behind;		/**< Commands not sent, too many in flight */
+	unsigned long latency_sum;	/**< Sum of the latencies, in microseconds */
+	unsigned long latency_max;	/**< Longest latency, in microseconds */
+} LoadStats;
+
+char *help_text =
+"lcdload - load generator for stress-testing LCDd\n"
+"\n"
+"This program is released under the terms of the GNU General Public License.\n"
+"\n"
+"Usage: lcdload [<options>]\n"
+"  where <options> are:\n"
+"    -a <address>        DNS name or IP address of the LCDd server [localhost]\n"
+"    -p <port>           port of the LCDd server [13666]\n"
+"    -n <connections>    Number of connections to open [1]\n"
+"    -s <screens>        Number of screens per connection [1]\n"
+"    -w <widgets>        Number of widgets per screen [4]\n"
+"    -m <mix>            Kinds of widgets and their shares, a comma separated\n"
+"                        list of string, hbar, vbar, scroller and menu, each\n"
+"                        optionally followed by =<share> [string,hbar,scroller]\n"
+"    -R <rate>           Updates per second, over all connections [100]\n"
+"    -d <seconds>        Duration of the run [10]\n"
+"    -i <seconds>        Report interval, 0 to only print the summary [1]\n"
+"    -o <commands>       Most commands in flight per connection [32]\n"
+"    -r <level>          Set reporting level (0-5) [2: errors and warnings]\n"
+"    -h                  Show this help\n";
+
+char *progname = "lcdload";
+
+static char *address = "localhost";
+static int port = 13666;
+static int num_connections = 1;
+static int num_screens = 1;
+static int num_widgets = 4;
+static char mix[256];			/**< Kind of each widget, by widget number */
+static int mix_len = 0;
+static double rate = 100;
+static int duration = 10;
+static int interval = 1;
+static int max_pending = 32;
+static int report_level = RPT_ERR;
+
+static LCDServerInfo info;
+static Connection *connections = NULL;
+static LoadStats total;
+static LoadStats current;
+static unsigned int *latencies = NULL;	/**< Latency of every reply, for the percentiles */
+static unsigned long latencies_size = 0;
+
+static volatile sig_atomic_t Quit = 0;
+
+/* Function prototypes */
+static int process_command_line(int argc, char **argv);
+static int parse_mix(const char *arg);
+static int setup_connection(Connection *conn);
+static int run_load(void);
+static void print_summary(unsigned long elapsed);
+
+
+/* Current time in microseconds */
+static unsigned long
+now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+
+static void
+stop_load(int sig)
+{
+	Quit = 1;
+}
+
+
+int
+main(int argc, char **argv)
+{
+	struct sigaction sa;
+	unsigned long start;
+	int i;
+
+	if (parse_mix("string,hbar,scroller") < 0)
+		return EXIT_FAILURE;
+	if (process_command_line(argc, argv) < 0)
+		return EXIT_FAILURE;
+	set_reporting(progname, report_level, RPT_DEST_STDERR);
+
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sa.sa_handler = stop_load;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);
+
+	connections = calloc(num_connections, sizeof(Connection));
+	if (connections == NULL) {
+		report(RPT_ERR, "Error allocating connections");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < num_connections; i++) {
+		connections[i].index = i;
+		if (setup_connection(&connections[i]) < 0)
+			return EXIT_FAILURE;
+	}
+	printf("%d connections, %d screens with %d widgets each, %dx%d display, %g updates/s\n",
+	       num_connections, num_connections * num_screens, num_widgets,
+	       info.wid, info.hgt, rate);
+
+	start = now_usec();
+	run_load();
+	print_summary(now_usec() - start);
+
+	for (i = 0; i < num_connections; i++) {
+		if (connections[i].fd >= 0)
+			sock_close(connections[i].fd);
+	}
+	return (total.errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* Read an integer option, between min and max */
+static int
+int_option(const char *arg, int min, int max, int *value)
+{
+	char *end;
+	long temp = strtol(arg, &end, 0);
+
+	if ((*arg == '\0') || (*end != '\0') || (temp < min) || (temp > max))
+		return -1;
+	*value = temp;
+	return 0;
+}
+
+
+static int
+process_command_line(int argc, char **argv)
+{
+	int c;
+	int error = 0;
+
+	/* No error output from getopt */
+	opterr = 0;
+
+	while ((c = getopt(argc, argv, "ha:p:n:s:w:m:R:d:i:o:r:")) > 0) {
+		char *end;
+
+		switch (c) {
+		  case 'h':
+			fprintf(stderr, "%s", help_text);
+			exit(EXIT_SUCCESS);
+			/* NOTREACHED */
+		  case 'a':
+			address = strdup(optarg);
+			break;
+		  case 'p':
+			if (int_option(optarg, 1, 0xFFFF, &port) < 0) {
+				report(RPT_ERR, "Illegal port value %s", optarg);
+				error = -1;
+			}
+			break;
+		  case 'n':
+			if (int_option(optarg, 1, MAX_CONNECTIONS, &num_connections) < 0) {
+				report(RPT_ERR, "Illegal number of connections %s", optarg);
+				error = -1;
+			}
+			break;
+		  case 's':
+			if (int_option(optarg, 1, 1000, &num_screens) < 0) {
+				report(RPT_ERR, "Illegal number of screens %s", optarg);
+				error = -1;
+			}
+			break;
+		  case 'w':
+			if (int_option(optarg, 1, 1000, &num_widgets) < 0) {
+				report(RPT_ERR, "Illegal number of widgets %s", optarg);
+				error = -1;
+			}
+			break;
+		  case 'm':
+			if (parse_mix(optarg) < 0) {
+				report(RPT_ERR, "Illegal widget mix %s", optarg);
+				error = -1;
+			}
+			break;
+		  case 'R':
+			rate = strtod(optarg, &end);
+			if ((*optarg == '\0') || (*end != '\0') || (rate <= 0)) {
+				report(RPT_ERR, "Illegal rate %s", optarg);
+				error = -1;
+			}
+			break;
+		  case 'd':
+			if (int_option(optarg, 1, 1000000, &duration) < 0) {
+				report(RPT_ERR, "Illegal duration %s", optarg);
+				error = -1;
+			}
+			break;
+		  case 'i':
+			if (int_option(optarg, 0, 1000000, &interval) < 0) {
+				report(RPT_ERR, "Illegal report interval %s", optarg);
+				error = -1;
+			}
+			break;
+		  case 'o':
+			if (int_option(optarg, 1, MAX_PENDING, &max_pending) < 0) {
+				report(RPT_ERR, "Illegal number of commands in flight %s", optarg);
+				error = -1;
+			}
+			break;
+		  case 'r':
+			if (int_option(optarg, 0, RPT_DEBUG, &report_level) < 0) {
+				report(RPT_ERR, "Illegal report level value %s", optarg);
+				error = -1;
+			}
+			break;
+		  case ':':
+			report(RPT_ERR, "Missing option argument for %c", optopt);
+			error = -1;
+			break;
+		  case '?':
+		  default:
+			report(RPT_ERR, "Unknown option: %c", optopt);
+			error = -1;
+			break;
+		}
+	}
+	if (optind < argc) {
+		report(RPT_ERR, "Non-option arguments on the command line");
+		error = -1;
+	}
+	return error;
+}
+
+
+/**
+ * Read the kinds of widgets to drive, e.g. "string=2,hbar,menu=1", into
+ * mix: each kind appears as often as its share, and widget k of a screen
+ * is of kind mix[k % mix_len].
+ * \param arg  The mix option.
+ * \return  0 on success, -1 on error.
+ */
+static int
+parse_mix(const char *arg)
+{
+	static const struct {
+		const char *name;
+		WidgetKind kind;
+	} kinds[] = {
+		{ "string",	KIND_STRING },
+		{ "hbar",	KIND_HBAR },
+		{ "vbar",	KIND_VBAR },
+		{ "scroller",	KIND_SCROLLER },
+		{ "menu",	KIND_MENU },
+	};
+	char *copy = strdup(arg);
+	char *item;
+	int len = 0;
+
+	if (copy == NULL)
+		return -1;
+	for (item = strtok(copy, ","); item != NULL; item = strtok(NULL, ",")) {
+		char *share = strchr(item, '=');
+		int n = 1;
+		int k;
+
+		if (share != NULL) {
+			*share++ = '\0';
+			if (int_option(share, 0, 100, &n) < 0)
+				break;
+		}
+		for (k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+			if (strcmp(item, kinds[k].name) == 0)
+				break;
+		}
+		if ((k == sizeof(kinds) / sizeof(kinds[0])) || (len + n > sizeof(mix)))
+			break;
+		memset(mix + len, kinds[k].kind, n);
+		len += n;
+	}
+	free(copy);
+	if ((item != NULL) || (len == 0))
+		return -1;
+	mix_len = len;
+	return 0;
+}
+
+
+/* Send a command, remembering when it was sent to time its reply */
+static int
+send_command(Connection *conn, const char *command)
+{
+	if (sock_send_string(conn->fd, command) < 0) {
+		report(RPT_ERR, "Connection %d: error sending", conn->index);
+		sock_close(conn->fd);
+		conn->fd = -1;
+		return -1;
+	}
+	conn->sent[(conn->first + conn->pending) % MAX_PENDING] = now_usec();
+	conn->pending++;
+	current.sent++;
+	return 0;
+}
+
+
+/* Account for the reply to the oldest command in flight */
+static void
+got_reply(Connection *conn, int error)
+{
+	unsigned long latency;
+
+	if (conn->pending == 0) {
+		report(RPT_WARNING, "Connection %d: reply to no command", conn->index);
+		return;
+	}
+	latency = now_usec() - conn->sent[conn->first];
+	conn->first = (conn->first + 1) % MAX_PENDING;
+	conn->pending--;
+
+	current.replies++;
+	if (error)
+		current.errors++;
+	current.latency_sum += latency;
+	if (latency > current.latency_max)
+		current.latency_max = latency;
+
+	if (total.replies + current.replies > latencies_size) {
+		unsigned long size = (latencies_size == 0) ? 4096 : latencies_size * 2;
+		unsigned int *l = realloc(latencies, size * sizeof(unsigned int));
+
+		if (l == NULL)
+			return;
+		latencies = l;
+		latencies_size = size;
+	}
+	latencies[total.replies + current.replies - 1] = latency;
+}
+
+
+/**
+ * Read what the server sent on a connection and account for the replies
+ * in it. Other messages (listen, ignore, key, menuevent) are skipped.
+ * \param conn  The connection.
+ * \return  0 on success, -1 if the connection was closed.
+ */
+static int
+read_replies(Connection *conn)
+{
+	for (;;) {
+		char *line;
+		char *eol;
+		int len;
+
+		len = read(conn->fd, conn->buf + conn->buffered, sizeof(conn->buf) - conn->buffered);
+		if (len < 0)
+			return ((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1;
+		if (len == 0) {
+			report(RPT_ERR, "Connection %d: closed by the server", conn->index);
+			sock_close(conn->fd);
+			conn->fd = -1;
+			return -1;
+		}
+		conn->buffered += len;
+
+		line = conn->buf;
+		while ((eol = memchr(line, '\n', conn->buf + conn->buffered - line)) != NULL) {
+			*eol = '\0';
+			if (strncmp(line, "success", 7) == 0)
+				got_reply(conn, 0);
+			else if (strncmp(line, "huh?", 4) == 0) {
+				report(RPT_WARNING, "Connection %d: %s", conn->index, line);
+				got_reply(conn, 1);
+			}
+			line = eol + 1;
+		}
+		conn->buffered -= line - conn->buf;
+		if (conn->buffered == sizeof(conn->buf)) {
+			/* an overlong line: no reply, drop it */
+			conn->buffered = 0;
+		}
+		else
+			memmove(conn->buf, line, conn->buffered);
+	}
+}
+
+
+/* Wait until all commands on a connection were replied to */
+static int
+wait_replies(Connection *conn)
+{
+	unsigned long deadline = now_usec() + SETUP_TIMEOUT * 1000UL;
+
+	while (conn->pending > 0) {
+		struct pollfd pfd = { conn->fd, POLLIN, 0 };
+		long left = (long) (deadline - now_usec()) / 1000;
+
+		if ((left <= 0) || Quit) {
+			report(RPT_ERR, "Connection %d: no reply from the server", conn->index);
+			return -1;
+		}
+		if ((poll(&pfd, 1, left) > 0) && (read_replies(conn) < 0))
+			return -1;
+	}
+	return 0;
+}
+
+
+/**
+ * Connect to the server and create the screens, widgets and menu items of
+ * a connection.
+ * \param conn  The connection.
+ * \return  0 on success, -1 on error.
+ */
+static int
+setup_connection(Connection *conn)
+{
+	char command[256];
+	int s, w;
+
+	conn->fd = lcd_client_connect(address, port, &info);
+	if (conn->fd < 0) {
+		report(RPT_ERR, "Connection %d: could not connect to %s:%d",
+		       conn->index, address, port);
+		return -1;
+	}
+
+	snprintf(command, sizeof(command), "client_set -name load%d\n", conn->index);
+	if (send_command(conn, command) < 0)
+		return -1;
+	for (s = 0; s < num_screens; s++) {
+		snprintf(command, sizeof(command), "screen_add s%d\n", s);
+		if (send_command(conn, command) < 0)
+			return -1;
+		snprintf(command, sizeof(command), "screen_set s%d -name {load %d.%d}\n",
+			 s, conn->index, s);
+		if (send_command(conn, command) < 0)
+			return -1;
+		for (w = 0; w < num_widgets; w++) {
+			switch (mix[w % mix_len]) {
+			  case KIND_STRING:
+				snprintf(command, sizeof(command), "widget_add s%d w%d string\n", s, w);
+				break;
+			  case KIND_HBAR:
+				snprintf(command, sizeof(command), "widget_add s%d w%d hbar\n", s, w);
+				break;
+			  case KIND_VBAR:
+				snprintf(command, sizeof(command), "widget_add s%d w%d vbar\n", s, w);
+				break;
+			  case KIND_SCROLLER:
+				snprintf(command, sizeof(command), "widget_add s%d w%d scroller\n", s, w);
+				break;
+			  case KIND_MENU:
+				snprintf(command, sizeof(command),
+					 "menu_add_item \"\" m%d_%d slider -text {Load %d.%d}"
+					 " -minvalue 0 -maxvalue 100\n", s, w, s, w);
+				break;
+			}
+			if (send_command(conn, command) < 0)
+				return -1;
+			/* don't let the setup overrun the server's input */
+			if ((conn->pending >= max_pending) && (wait_replies(conn) < 0))
+				return -1;
+		}
+	}
+	if (wait_replies(conn) < 0)
+		return -1;
+
+	total.errors += current.errors;
+	memset(&current, 0, sizeof(current));
+	if (total.errors > 0) {
+		report(RPT_ERR, "Connection %d: the server refused the setup", conn->index);
+		return -1;
+	}
+	return 0;
+}
+
+
+/* Send the next update of a connection */
+static void
+send_update(Connection *conn)
+{
+	char command[256];
+	int n = conn->updates / num_widgets;
+	int s = n % num_screens;
+	int w = conn->updates % num_widgets;
+	int y = 1 + w % info.hgt;
+
+	switch (mix[w % mix_len]) {
+	  case KIND_STRING:
+		snprintf(command, sizeof(command), "widget_set s%d w%d 1 %d {load %d}\n",
+			 s, w, y, n);
+		break;
+	  case KIND_HBAR:
+		snprintf(command, sizeof(command), "widget_set s%d w%d 1 %d %d\n",
+			 s, w, y, n % (info.wid * info.cellwid + 1));
+		break;
+	  case KIND_VBAR:
+		snprintf(command, sizeof(command), "widget_set s%d w%d %d %d %d\n",
+			 s, w, 1 + w % info.wid, info.hgt, n % (info.hgt * info.cellhgt + 1));
+		break;
+	  case KIND_SCROLLER:
+		snprintf(command, sizeof(command),
+			 "widget_set s%d w%d 1 %d %d %d m 1 {load %d scrolling across the display}\n",
+			 s, w, y, info.wid, y, n);
+		break;
+	  case KIND_MENU:
+		snprintf(command, sizeof(command), "menu_set_item \"\" m%d_%d -value %d\n",
+			 s, w, n % 101);
+		break;
+	}
+	if (send_command(conn, command) == 0)
+		conn->updates++;
+}
+
+
+/* Print and reset the counters of a report interval */
+static void
+print_interval(double seconds, double length)
+{
+	printf("%7.1fs  sent %7lu  replies %7lu  rate %9.1f/s  latency avg %8.3f ms  max %8.3f ms  errors %lu  behind %lu\n",
+	       seconds, current.sent, current.replies, current.replies / length,
+	       current.replies ? current.latency_sum / 1000.0 / current.replies : 0.0,
+	       current.latency_max / 1000.0, current.errors, current.behind);
+}
+
+
+/* Add the counters of a report interval to the totals */
+static void
+end_interval(void)
+{
+	total.sent += current.sent;
+	total.replies += current.replies;
+	total.errors += current.errors;
+	total.behind += current.behind;
+	total.latency_sum += current.latency_sum;
+	if (current.latency_max > total.latency_max)
+		total.latency_max = current.latency_max;
+	memset(&current, 0, sizeof(current));
+}
+
+
+/**
+ * Send the updates at the rate asked for until the duration is over or
+ * the program is stopped, reading the replies meanwhile.
+ * \return  0 on success, -1 if all connections were closed.
+ */
+static int
+run_load(void)
+{
+	struct pollfd *pfds = calloc(num_connections, sizeof(struct pollfd));
+	unsigned long start = now_usec();
+	unsigned long end = start + duration * 1000000UL;
+	unsigned long next_report = start + interval * 1000000UL;
+	unsigned long last_report = start;
+	unsigned long due = 0;		/* updates due since the start */
+	int open = num_connections;
+	int next = 0;			/* connection to send the next update on */
+	int i;
+
+	if (pfds == NULL) {
+		report(RPT_ERR, "Error allocating");
+		return -1;
+	}
+
+	while (!Quit && (open > 0)) {
+		unsigned long now = now_usec();
+		unsigned long wait;
+
+		if (now >= end)
+			break;
+		if ((interval > 0) && (now >= next_report)) {
+			print_interval((now - start) / 1e6, (now - last_report) / 1e6);
+			end_interval();
+			last_report = now;
+			next_report += interval * 1000000UL;
+		}
+
+		/* send what is due, round robin over the connections */
+		for (; due < (unsigned long) ((now - start) * rate / 1e6); due++) {
+			Connection *conn = &connections[next];
+
+			next = (next + 1) % num_connections;
+			if (conn->fd < 0)
+				continue;
+			if (conn->pending >= max_pending)
+				current.behind++;
+			else
+				send_update(conn);
+		}
+
+		for (i = 0; i < num_connections; i++) {
+			pfds[i].fd = connections[i].fd;
+			pfds[i].events = POLLIN;
+			pfds[i].revents = 0;
+		}
+		/* until the next update is due, but at least a millisecond */
+		wait = start + (unsigned long) ((due + 1) * 1e6 / rate);
+		wait = (wait > now) ? (wait - now + 999) / 1000 : 1;
+		if ((interval > 0) && (wait > (next_report - now) / 1000 + 1))
+			wait = (next_report - now) / 1000 + 1;
+		if (poll(pfds, num_connections, wait) <= 0)
+			continue;
+
+		for (i = 0; i < num_connections; i++) {
+			if ((pfds[i].fd < 0) || (pfds[i].revents == 0))
+				continue;
+			if ((read_replies(&connections[i]) < 0) && (connections[i].fd < 0))
+				open--;
+		}
+	}
+
+	/* give the commands in flight their replies */
+	for (i = 0; i < num_connections; i++) {
+		if ((connections[i].fd >= 0) && (connections[i].pending > 0))
+			wait_replies(&connections[i]);
+	}
+	if ((interval > 0) && (current.sent + current.replies > 0))
+		print_interval((now_usec() - start) / 1e6, (now_usec() - last_report) / 1e6);
+	end_interval();
+	free(pfds);
+	return (open > 0) ? 0 : -1;
+}
+
+
+static int
+compare_latencies(const void *a, const void *b)
+{
+	unsigned int la = *(const unsigned int *) a;
+	unsigned int lb = *(const unsigned int *) b;
+
+	return (la > lb) - (la < lb);
+}
+
+
+/* Latency below which a share of the replies came, in milliseconds */
+static double
+percentile(unsigned long count, double share)
+{
+	unsigned long i = (unsigned long) (count * share);
+
+	if (count == 0)
+		return 0;
+	if (i >= count)
+		i = count - 1;
+	return latencies[i] / 1000.0;
+}
+
+
+static void
+print_summary(unsigned long elapsed)
+{
+	unsigned long count = (total.replies <= latencies_size) ? total.replies : latencies_size;
+
+	if (count > 0)
+		qsort(latencies, count, sizeof(unsigned int), compare_latencies);
+
+	printf("\n");
+	printf("duration   %.1f s\n", elapsed / 1e6);
+	printf("sent       %lu (%.1f/s, %.1f/s asked for)\n",
+	       total.sent, total.sent * 1e6 / elapsed, rate);
+	printf("replies    %lu (%.1f/s)\n", total.replies, total.replies * 1e6 / elapsed);
+	printf("errors     %lu\n", total.errors);
+	printf("behind     %lu\n", total.behind);
+	printf("latency    avg %.3f ms, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+	       total.replies ? total.latency_sum / 1000.0 / total.replies : 0.0,
+	       percentile(count, 0.5), percentile(count, 0.9), percentile(count, 0.99),
+	       total.latency_max / 1000.0);
+}
@@ -35,6 +35,7 @@
 #include <ctype.h>
 
 #include "shared/sockets.h"
+#include "shared/lcdclient.h"
 
 #include "main.h"
 #include "mode.h"
@@ -76,28 +77,28 @@ cpu_smp_screen (int rep, int display, int *flags_ptr)
 	if ((*flags_ptr & INITIALIZED) == 0) {
 		*flags_ptr |= INITIALIZED;
 
-		sock_send_string(sock, "screen_add P\n");
+		lcd_client_send(sock, "screen_add P\n");
 
 		/* print title if he have room for it */
 		if (lines_used < lcd_hgt) {
-			sock_send_string(sock, "widget_add P title title\n");
-			sock_printf(sock, "widget_set P title {SMP CPU%s}\n", get_hostname());
+			lcd_client_send(sock, "widget_add P title title\n");
+			lcd_client_printf(sock, "widget_set P title {SMP CPU%s}\n", get_hostname());
 		}
 		else {
-			sock_send_string(sock, "screen_set P -heartbeat off\n");
+			lcd_client_send(sock, "screen_set P -heartbeat off\n");
 		}
 
-		sock_printf(sock, "screen_set P -name {CPU Use: %s}\n", get_hostname());
+		lcd_client_printf(sock, "screen_set P -name {CPU Use: %s}\n", get_hostname());
 
 		for (z = 0; z < num_cpus; z++) {
 			int y_offs = (lines_used < lcd_hgt) ? 2 : 1;
 			int x = (num_cpus > lcd_hgt) ? ((z % 2) * (lcd_wid/2) + 1) : 1;
 			int y = (num_cpus > lcd_hgt) ? (z/2 + y_offs) : (z + y_offs);
 
-			sock_printf(sock, "widget_add P cpu%d_title string\n", z);
-			sock_printf(sock, "widget_set P cpu%d_title %d %d \"CPU%d[%*s]\"\n",
+			lcd_client_printf(sock, "widget_add P cpu%d_title string\n", z);
+			lcd_client_printf(sock, "widget_set P cpu%d_title %d %d \"CPU%d[%*s]\"\n",
 					z, x, y, z, bar_size, "");
-			sock_printf(sock, "widget_add P cpu%d_bar hbar\n", z);
+			lcd_client_printf(sock, "widget_add P cpu%d_bar hbar\n", z);
 		}
 
 		return 0;
@@ -126,7 +127,7 @@ cpu_smp_screen (int rep, int display, int *flags_ptr)
 		value /= CPU_BUF_SIZE;
 
 		n = (int) ((value * lcd_cellwid * bar_size) / 100.0 + 0.5);
-		sock_printf(sock, "widget_set P cpu%d_bar %d %d %d\n", z, x, y, n);
+		lcd_client_printf(sock, "widget_set P cpu%d_bar %d %d %d\n", z, x, y, n);
 	}
 
 	return 0;
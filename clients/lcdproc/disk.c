@@ -24,6 +24,7 @@
 
 #include "shared/configfile.h"
 #include "shared/sockets.h"
+#include "shared/lcdclient.h"
 
 #include "main.h"
 #include "mode.h"
@@ -102,35 +103,35 @@ disk_screen(int rep, int display, int *flags_ptr)
 		gauge_wid = lcd_wid - hbar_pos;
 		gauge_scale = gauge_wid * lcd_cellwid;
 
-		sock_send_string(sock, "screen_add D\n");
-		sock_printf(sock, "screen_set D -name {Disk Use: %s}\n", get_hostname());
-		sock_send_string(sock, "widget_add D title title\n");
-		sock_printf(sock, "widget_set D title {DISKS:%s}\n", get_hostname());
-		sock_send_string(sock, "widget_add D f frame\n");
-		sock_printf(sock, "widget_set D f 1 2 %i %i %i %i v 12\n", lcd_wid, lcd_hgt, lcd_wid, lcd_hgt - 1);
-		sock_send_string(sock, "widget_add D err1 string\n");
-		sock_send_string(sock, "widget_add D err2 string\n");
-		sock_send_string(sock, "widget_set D err1 5 2 {  Reading  }\n");
-		sock_send_string(sock, "widget_set D err2 5 3 {Filesystems}\n");
+		lcd_client_send(sock, "screen_add D\n");
+		lcd_client_printf(sock, "screen_set D -name {Disk Use: %s}\n", get_hostname());
+		lcd_client_send(sock, "widget_add D title title\n");
+		lcd_client_printf(sock, "widget_set D title {DISKS:%s}\n", get_hostname());
+		lcd_client_send(sock, "widget_add D f frame\n");
+		lcd_client_printf(sock, "widget_set D f 1 2 %i %i %i %i v 12\n", lcd_wid, lcd_hgt, lcd_wid, lcd_hgt - 1);
+		lcd_client_send(sock, "widget_add D err1 string\n");
+		lcd_client_send(sock, "widget_add D err2 string\n");
+		lcd_client_send(sock, "widget_set D err1 5 2 {  Reading  }\n");
+		lcd_client_send(sock, "widget_set D err2 5 3 {Filesystems}\n");
 	}
 
 	/* Get rid of old, unmounted filesystems... */
 	machine_get_fs(mnt, &count);
 	if (!count) {
-		sock_send_string(sock, "widget_set D err1 1 2 {Error Retrieving}\n");
-		sock_send_string(sock, "widget_set D err2 1 3 {Filesystem Stats}\n");
+		lcd_client_send(sock, "widget_set D err1 1 2 {Error Retrieving}\n");
+		lcd_client_send(sock, "widget_set D err2 1 3 {Filesystem Stats}\n");
 		return 0;
 	}
 
 	/* Fill the display structure... */
-	sock_send_string(sock, "widget_set D err1 0 0 .\n");
-	sock_send_string(sock, "widget_set D err2 0 0 .\n");
+	lcd_client_send(sock, "widget_set D err1 0 0 .\n");
+	lcd_client_send(sock, "widget_set D err2 0 0 .\n");
 
 	/*
 	 * Display stuff...  (show for two seconds, then scroll once per
 	 * second, then hold at the end for two seconds)
 	 */
-	sock_printf(sock, "widget_set D f 1 2 %i %i %i %i v 12\n", lcd_wid, lcd_hgt, lcd_wid, count);
+	lcd_client_printf(sock, "widget_set D f 1 2 %i %i %i %i v 12\n", lcd_wid, lcd_hgt, lcd_wid, count);
 	for (i = 0; i < count; i++) {
 		char tmp[lcd_wid + 1];	/* should be large enough */
 		char cap[8] = {'\0'};
@@ -158,16 +159,16 @@ disk_screen(int rep, int display, int *flags_ptr)
 
 		// Actual display/server output
 		if (i_widget >= num_disks) {	/* Make sure we have enough lines... */
-			sock_printf(sock, "widget_add D s%i string -in f\n", i_widget);
-			sock_printf(sock, "widget_add D h%i hbar -in f\n", i_widget);
+			lcd_client_printf(sock, "widget_add D s%i string -in f\n", i_widget);
+			lcd_client_printf(sock, "widget_add D h%i hbar -in f\n", i_widget);
 		}
 		if (lcd_wid >= 20) {	/* 20+x columns */
 			sprintf(tmp, "%-*s %6s E%*sF", dev_wid, dev, cap, gauge_wid, "");
 		} else {		/* < 20 columns */
 			sprintf(tmp, "%-*s E%*sF", dev_wid, dev, gauge_wid, "");
 		}
-		sock_printf(sock, "widget_set D s%i 1 %i {%s}\n", i_widget, i_widget + 1, tmp);
-		sock_printf(sock, "widget_set D h%i %i %i %i\n",
+		lcd_client_printf(sock, "widget_set D s%i 1 %i {%s}\n", i_widget, i_widget + 1, tmp);
+		lcd_client_printf(sock, "widget_set D h%i %i %i %i\n",
 					i_widget, hbar_pos, i_widget + 1, full);
 		// Only increment current widget index if we "consumed" a display row.
 		i_widget++; 
@@ -175,13 +176,13 @@ disk_screen(int rep, int display, int *flags_ptr)
 
 	/* Now remove extra widgets... */
 	for (i=i_widget; i < num_disks; i++) {
-		sock_printf(sock, "widget_del D s%i\n", i);
-		sock_printf(sock, "widget_del D h%i\n", i);
+		lcd_client_printf(sock, "widget_del D s%i\n", i);
+		lcd_client_printf(sock, "widget_del D h%i\n", i);
 	}
 	num_disks = i_widget;
 
 	// And update the count so there aren't blank spaces due to ignored entries.
-	sock_printf(sock, "widget_set D f 1 2 %i %i %i %i v 12\n", lcd_wid, lcd_hgt, lcd_wid, num_disks);
+	lcd_client_printf(sock, "widget_set D f 1 2 %i %i %i %i v 12\n", lcd_wid, lcd_hgt, lcd_wid, num_disks);
 
 
 	return 0;
@@ -0,0 +1,531 @@
+/** \file clients/lcdproc/headless.c
+ * Runs lcdproc's collectors without a display.
+ *
+ * In headless mode lcdproc does not connect to LCDd. It calls the
+ * machine_* collectors of the selected screens as often as those screens
+ * would update while visible, and writes what they return to stdout,
+ * either as line protocol or as JSON, a record per line. Each record
+ * tells how long the collector took, so this doubles as a benchmark of
+ * the machine_* backends with no server in the loop.
+ */
+
+/*-
+ * This file is part of lcdproc, the lcdproc client.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/utsname.h>
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "shared/LL.h"
+#include "shared/configfile.h"
+#include "shared/report.h"
+
+#include "main.h"
+#include "machine.h"
+#include "headless.h"
+
+/** Most interfaces of [Iface] that are collected */
+#define HEADLESS_INTERFACES	8
+/** Most file systems that are collected */
+#define HEADLESS_MOUNTS		256
+
+/** A collector and the screens that use it */
+typedef struct {
+	const char *name;	/**< Name in the records */
+	const char *screens;	/**< Short names of the screens using it */
+	void (*collect)(void);	/**< Writes the records */
+	long interval;		/**< Time units between runs; 0: not run */
+	long next;		/**< Time unit of the next run */
+} Collector;
+
+static void collect_load(void);
+static void collect_smp(void);
+static void collect_loadavg(void);
+static void collect_memory(void);
+static void collect_procs(void);
+static void collect_uptime(void);
+static void collect_battery(void);
+static void collect_disk(void);
+static void collect_iface(void);
+
+static Collector collectors[] = {
+	{ "load",    "CGU", collect_load    },
+	{ "smp",     "P",   collect_smp     },
+	{ "loadavg", "L",   collect_loadavg },
+	{ "memory",  "M",   collect_memory  },
+	{ "procs",   "S",   collect_procs   },
+	{ "uptime",  "U",   collect_uptime  },
+	{ "battery", "B",   collect_battery },
+	{ "disk",    "D",   collect_disk    },
+	{ "iface",   "I",   collect_iface   },
+	{ NULL, NULL, NULL },
+};
+
+static int json = 0;		/* JSON instead of line protocol */
+static char host[256];
+
+/* The record being written */
+static char record[4096];
+static size_t record_len;
+static int record_fields;
+static struct timespec record_time;
+
+
+/**
+ * Choose the output format.
+ * \param format  "line" for line protocol, or "json".
+ * \return  0 on success, -1 for an unknown format.
+ */
+int
+headless_set_format(const char *format)
+{
+	if (strcasecmp(format, "line") == 0)
+		json = 0;
+	else if (strcasecmp(format, "json") == 0)
+		json = 1;
+	else
+		return -1;
+	return 0;
+}
+
+
+/** Add printf-like formatted text to the record; too much is cut off. */
+static void
+record_printf(const char *format, .../*args*/)
+{
+	va_list ap;
+	int len;
+
+	if (record_len >= sizeof(record) - 1)
+		return;
+	va_start(ap, format);
+	len = vsnprintf(record + record_len, sizeof(record) - record_len, format, ap);
+	va_end(ap);
+	if (len > 0)
+		record_len += ((size_t) len < sizeof(record) - record_len)
+			      ? (size_t) len : sizeof(record) - record_len - 1;
+}
+
+
+/** Add a string to the record, escaped for the output format. */
+static void
+record_string(const char *s)
+{
+	for (; *s != '\0'; s++) {
+		unsigned char c = *s;
+
+		if (json) {
+			if ((c == '"') || (c == '\\'))
+				record_printf("\\%c", c);
+			else if (c < 0x20)
+				record_printf("\\u%04x", c);
+			else
+				record_printf("%c", c);
+		}
+		else {
+			if ((c == ',') || (c == '=') || (c == ' ') || (c == '\\'))
+				record_printf("\\%c", c);
+			else if (c >= 0x20)
+				record_printf("%c", c);
+		}
+	}
+}
+
+
+/**
+ * Start a record of a collector.
+ * \param collector  Its name.
+ * \param tag        Name of what the record is about, or NULL.
+ * \param value      What it is about, e.g. an interface name.
+ */
+static void
+record_begin(const char *collector, const char *tag, const char *value)
+{
+	clock_gettime(CLOCK_REALTIME, &record_time);
+	record_len = 0;
+	record_fields = 0;
+
+	if (json) {
+		record_printf("{\"collector\":\"%s\",\"host\":\"", collector);
+		record_string(host);
+		record_printf("\",\"time\":%ld.%09ld", (long) record_time.tv_sec, record_time.tv_nsec);
+		if (tag != NULL) {
+			record_printf(",\"%s\":\"", tag);
+			record_string(value);
+			record_printf("\"");
+		}
+		record_printf(",\"values\":{");
+	}
+	else {
+		record_printf("lcdproc_%s,host=", collector);
+		record_string(host);
+		if (tag != NULL) {
+			record_printf(",%s=", tag);
+			record_string(value);
+		}
+		record_printf(" ");
+	}
+}
+
+
+/** Add a value to the record. */
+static void
+record_field(const char *name, double value)
+{
+	record_printf("%s%s%s%s%.15g", (record_fields > 0) ? "," : "",
+		      (json) ? "\"" : "", name, (json) ? "\":" : "=", value);
+	record_fields++;
+}
+
+
+/**
+ * End the record and write it.
+ * \param duration  Time the collector took, in ns.
+ */
+static void
+record_end(long duration)
+{
+	if (json)
+		record_printf("},\"duration_ns\":%ld}\n", duration);
+	else
+		record_printf("%sduration_ns=%ldi %ld%09ld\n", (record_fields > 0) ? "," : "",
+			      duration, (long) record_time.tv_sec, record_time.tv_nsec);
+
+	/* A record cut off would no longer parse */
+	if (record_len >= sizeof(record) - 1) {
+		report(RPT_WARNING, "Headless: record too long, dropped");
+		return;
+	}
+	fwrite(record, 1, record_len, stdout);
+}
+
+
+/** Time since start, in ns. */
+static long
+elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000000L + (now.tv_nsec - start->tv_nsec);
+}
+
+
+static void
+collect_load(void)
+{
+	load_type load;
+	struct timespec start;
+	long duration;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (!machine_get_load(&load))
+		return;
+	duration = elapsed(&start);
+
+	record_begin("load", NULL, NULL);
+	record_field("user", load.user);
+	record_field("nice", load.nice);
+	record_field("system", load.system);
+	record_field("idle", load.idle);
+	record_field("total", load.total);
+	record_end(duration);
+}
+
+
+static void
+collect_smp(void)
+{
+	load_type load[MAX_CPUS];
+	int i, num = MAX_CPUS;
+	struct timespec start;
+	long duration;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (!machine_get_smpload(load, &num))
+		return;
+	duration = elapsed(&start);
+
+	for (i = 0; i < num; i++) {
+		char cpu[12];
+
+		sprintf(cpu, "%d", i);
+		record_begin("smp", "cpu", cpu);
+		record_field("user", load[i].user);
+		record_field("nice", load[i].nice);
+		record_field("system", load[i].system);
+		record_field("idle", load[i].idle);
+		record_field("total", load[i].total);
+		record_end(duration);
+	}
+}
+
+
+static void
+collect_loadavg(void)
+{
+	double loadavg;
+	struct timespec start;
+	long duration;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (!machine_get_loadavg(&loadavg))
+		return;
+	duration = elapsed(&start);
+
+	record_begin("loadavg", NULL, NULL);
+	record_field("load1", loadavg);
+	record_end(duration);
+}
+
+
+static void
+collect_memory(void)
+{
+	meminfo_type mem[2];
+	struct timespec start;
+	long duration;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (!machine_get_meminfo(mem))
+		return;
+	duration = elapsed(&start);
+
+	record_begin("memory", NULL, NULL);
+	record_field("total_kb", mem[0].total);
+	record_field("free_kb", mem[0].free);
+	record_field("shared_kb", mem[0].shared);
+	record_field("buffers_kb", mem[0].buffers);
+	record_field("cache_kb", mem[0].cache);
+	record_field("swap_total_kb", mem[1].total);
+	record_field("swap_free_kb", mem[1].free);
+	record_end(duration);
+}
+
+
+static void
+collect_procs(void)
+{
+	LinkedList *procs = LL_new();
+	struct timespec start;
+	long duration;
+	long count = 0, size = 0;
+
+	if (procs == NULL)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	machine_get_procs(procs);
+	duration = elapsed(&start);
+
+	LL_Rewind(procs);
+	do {
+		procinfo_type *p = LL_Get(procs);
+
+		if (p != NULL) {
+			count += p->number;
+			size += p->totl;
+			free(p);
+		}
+	} while (LL_Next(procs) == 0);
+	LL_Destroy(procs);
+
+	record_begin("procs", NULL, NULL);
+	record_field("processes", count);
+	record_field("size_kb", size);
+	record_end(duration);
+}
+
+
+static void
+collect_uptime(void)
+{
+	double up, idle;
+	struct timespec start;
+	long duration;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (!machine_get_uptime(&up, &idle))
+		return;
+	duration = elapsed(&start);
+
+	record_begin("uptime", NULL, NULL);
+	record_field("uptime_s", up);
+	record_field("idle_percent", idle);
+	record_end(duration);
+}
+
+
+static void
+collect_battery(void)
+{
+	int acstat, battflag, percent;
+	struct timespec start;
+	long duration;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (!machine_get_battstat(&acstat, &battflag, &percent))
+		return;
+	duration = elapsed(&start);
+
+	record_begin("battery", NULL, NULL);
+	record_field("ac", acstat);
+	record_field("battery", battflag);
+	record_field("percent", percent);
+	record_end(duration);
+}
+
+
+static void
+collect_disk(void)
+{
+	static mounts_type mounts[HEADLESS_MOUNTS];
+	int i, count = HEADLESS_MOUNTS;
+	struct timespec start;
+	long duration;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (!machine_get_fs(mounts, &count))
+		return;
+	duration = elapsed(&start);
+
+	for (i = 0; i < count; i++) {
+		record_begin("disk", "mount", mounts[i].mpoint);
+		record_field("size_kb", (double) mounts[i].blocks * mounts[i].bsize / 1024);
+		record_field("free_kb", (double) mounts[i].bfree * mounts[i].bsize / 1024);
+		record_field("files", mounts[i].files);
+		record_field("files_free", mounts[i].ffree);
+		record_end(duration);
+	}
+}
+
+
+static void
+collect_iface(void)
+{
+	static IfaceInfo ifaces[HEADLESS_INTERFACES];
+	static int count = -1;
+	struct timespec start;
+	long duration;
+	int i;
+
+	/* The interfaces of the Iface screen */
+	if (count < 0) {
+		for (count = 0; count < HEADLESS_INTERFACES; count++) {
+			char label[24];
+			const char *name;
+
+			sprintf(label, "Interface%d", count);
+			name = config_get_string("Iface", label, 0, NULL);
+			if ((name == NULL) || (*name == '\0'))
+				break;
+			ifaces[count].name = strdup(name);
+			if (ifaces[count].name == NULL)
+				break;
+		}
+		if (count == 0)
+			report(RPT_WARNING, "Headless: no Interface0 in [Iface], collecting no interfaces");
+	}
+	if (count == 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (!machine_get_iface_stats_all(ifaces, count))
+		return;
+	duration = elapsed(&start);
+
+	for (i = 0; i < count; i++) {
+		record_begin("iface", "interface", ifaces[i].name);
+		record_field("up", ifaces[i].status == up);
+		record_field("rx_bytes", ifaces[i].rc_byte);
+		record_field("tx_bytes", ifaces[i].tr_byte);
+		record_field("rx_packets", ifaces[i].rc_pkt);
+		record_field("tx_packets", ifaces[i].tr_pkt);
+		record_end(duration);
+	}
+}
+
+
+/** The current time in time units. */
+static long
+headless_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * (1000000 / TIME_UNIT) + now.tv_nsec / (TIME_UNIT * 1000);
+}
+
+
+/**
+ * Run the collectors of the active screens until lcdproc is told to quit.
+ * A collector runs as often as the most frequent of its screens updates
+ * while visible (its OnTime).
+ * \return  -1 if no active screen has a collector; else it does not return.
+ */
+int
+headless_loop(void)
+{
+	struct utsname name;
+	Collector *c;
+	int running = 0;
+
+	if (uname(&name) == 0)
+		snprintf(host, sizeof(host), "%s", name.nodename);
+
+	for (c = collectors; c->name != NULL; c++) {
+		const char *s;
+
+		for (s = c->screens; *s != '\0'; s++) {
+			int k;
+
+			for (k = 0; sequence[k].which != 0; k++) {
+				if ((sequence[k].which == *s) && (sequence[k].flags & ACTIVE)
+				    && ((c->interval == 0) || (sequence[k].on_time < c->interval)))
+					c->interval = max(sequence[k].on_time, 1);
+			}
+		}
+		if (c->interval > 0) {
+			report(RPT_INFO, "Headless: collecting %s every %ld ms",
+			       c->name, c->interval * TIME_UNIT / 1000);
+			running++;
+		}
+	}
+	if (running == 0) {
+		report(RPT_ERR, "Headless: none of the active screens has a collector");
+		return -1;
+	}
+
+	while (!Quit) {
+		long now = headless_now();
+		long next = now + 64;
+
+		for (c = collectors; c->name != NULL; c++) {
+			if (c->interval == 0)
+				continue;
+			if (c->next <= now) {
+				c->collect();
+				c->next = now + c->interval;
+			}
+			next = min(next, c->next);
+		}
+		fflush(stdout);
+
+		if (next > now)
+			usleep((next - now) * TIME_UNIT);
+	}
+	return 0;
+}
@@ -0,0 +1,20 @@
+/** \file clients/lcdproc/headless.h
+ * Running the collectors without a display.
+ */
+
+/*-
+ * This file is part of lcdproc, the lcdproc client.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+/** Choose the output format: "line" or "json" */
+int headless_set_format(const char *format);
+/** Run the collectors of the active screens until told to quit */
+int headless_loop(void);
+
+#endif
@@ -22,6 +22,7 @@
 #include <time.h>
 
 #include "shared/sockets.h"
+#include "shared/lcdclient.h"
 #include "shared/report.h"
 #include "shared/configfile.h"
 #include "main.h"
@@ -148,14 +149,12 @@ iface_screen(int rep, int display, int *flags_ptr)
 		return 0;
 	}
 
+	/* read the stats of all interfaces in one go */
+	if (!machine_get_iface_stats_all(iface, iface_count))
+		return 0;
+
 	/* for each interface do */
 	for (iface_nmbr = 0; iface_nmbr < iface_count; iface_nmbr++) {
-		/* read iface_parameter stats */
-		if (!machine_get_iface_stats(&iface[iface_nmbr])) {
-			/* there was an error, so we exit the loop */
-			break;
-		}
-
 		/* actualize speed values in display */
 		actualize_speed_screen(&iface[iface_nmbr], interval, iface_nmbr);
 
@@ -182,46 +181,46 @@ initialize_speed_screen(void)
 {
 	int iface_nmbr;	/* interface number */
 
-	sock_send_string(sock, "screen_add I\n");
-	sock_send_string(sock, "screen_set I name {Load}\n");
-	sock_send_string(sock, "widget_add I title title\n");
+	lcd_client_send(sock, "screen_add I\n");
+	lcd_client_send(sock, "screen_set I name {Load}\n");
+	lcd_client_send(sock, "widget_add I title title\n");
 
 	/* Single interface mode */
 	if ((iface_count == 1) && (lcd_hgt >= 4 )) {
-		sock_printf(sock, "widget_set I title {Net Load: %s}\n", iface[0].alias);
-		sock_send_string(sock, "widget_add I dl string\n");
-		sock_send_string(sock, "widget_set I dl 1 2 {DL:}\n");
-		sock_send_string(sock, "widget_add I ul string\n");
-		sock_send_string(sock, "widget_set I ul 1 3 {UL:}\n");
-		sock_send_string(sock, "widget_add I total string\n");
-		sock_send_string(sock, "widget_set I total 1 4 {Total:}\n");
+		lcd_client_printf(sock, "widget_set I title {Net Load: %s}\n", iface[0].alias);
+		lcd_client_send(sock, "widget_add I dl string\n");
+		lcd_client_send(sock, "widget_set I dl 1 2 {DL:}\n");
+		lcd_client_send(sock, "widget_add I ul string\n");
+		lcd_client_send(sock, "widget_set I ul 1 3 {UL:}\n");
+		lcd_client_send(sock, "widget_add I total string\n");
+		lcd_client_send(sock, "widget_set I total 1 4 {Total:}\n");
 	}
 	/* multi-interfaces mode: one line per interface */
 	else {
 		/* Set title */
 		if (strstr(unit_label, "B")) {
-			sock_printf(sock, "widget_set I title {Net Load (bytes)}\n");
+			lcd_client_printf(sock, "widget_set I title {Net Load (bytes)}\n");
 		}
 		else {
 			if (strstr(unit_label, "b")) {
-				sock_printf(sock, "widget_set I title {Net Load (bits)}\n");
+				lcd_client_printf(sock, "widget_set I title {Net Load (bits)}\n");
 			}
 			else {
-				sock_printf(sock, "widget_set I title {Net Load (packets)}\n");
+				lcd_client_printf(sock, "widget_set I title {Net Load (packets)}\n");
 			}
 		}
 
 		/* frame from (2, left) to (width, height) that is iface_count lines high */
-		sock_send_string (sock, "widget_add I f frame\n");
-		sock_printf(sock, "widget_set I f 1 2 %d %d %d %d v 16\n",
+		lcd_client_send(sock, "widget_add I f frame\n");
+		lcd_client_printf(sock, "widget_set I f 1 2 %d %d %d %d v 16\n",
 			    lcd_wid, lcd_hgt, lcd_wid, iface_count,
 			    /* scroll rate: 1 line every X ticks (=1/8 sec) */
 			    ((lcd_hgt >= 4) ? 8 : 16));
 
 		/* Add interfaces to frame */
 		for (iface_nmbr = 0; iface_nmbr < iface_count; iface_nmbr++) {
-			sock_printf(sock, "widget_add I i%1d string -in f\n", iface_nmbr);
-			sock_printf(sock, "widget_set I i%1d 1 %1d {%5.5s NA (never)}\n",
+			lcd_client_printf(sock, "widget_add I i%1d string -in f\n", iface_nmbr);
+			lcd_client_printf(sock, "widget_set I i%1d 1 %1d {%5.5s NA (never)}\n",
 				    iface_nmbr, iface_nmbr+1, iface[iface_nmbr].alias);
 		}
 	}
@@ -358,7 +357,7 @@ actualize_speed_screen(IfaceInfo *iface, unsigned int interval, int index)
 				rc_speed = (iface->rc_byte - iface->rc_byte_old) / interval;
 				format_value(speed, rc_speed, unit_label);
 			}
-			sock_printf(sock, "widget_set I dl 1 2 {DL: %*s/s}\n", lcd_wid - 6, speed);
+			lcd_client_printf(sock, "widget_set I dl 1 2 {DL: %*s/s}\n", lcd_wid - 6, speed);
 
 			/* Calculate and actualize upload speed */
 			if (strstr(unit_label, "pkt")) {
@@ -369,7 +368,7 @@ actualize_speed_screen(IfaceInfo *iface, unsigned int interval, int index)
 				tr_speed = (iface->tr_byte - iface->tr_byte_old) / interval;
 				format_value(speed, tr_speed, unit_label);
 			}
-			sock_printf(sock, "widget_set I ul 1 3 {UL: %*s/s}\n", lcd_wid - 6, speed);
+			lcd_client_printf(sock, "widget_set I ul 1 3 {UL: %*s/s}\n", lcd_wid - 6, speed);
 
 			/* Calculate and actualize total speed */
 			if (strstr(unit_label, "pkt")) {
@@ -378,13 +377,13 @@ actualize_speed_screen(IfaceInfo *iface, unsigned int interval, int index)
 			else {
 				format_value(speed, rc_speed + tr_speed, unit_label);
 			}
-			sock_printf(sock, "widget_set I total 1 4 {Total: %*s/s}\n", lcd_wid - 9, speed);
+			lcd_client_printf(sock, "widget_set I total 1 4 {Total: %*s/s}\n", lcd_wid - 9, speed);
 		}
 		else {
 			get_time_string(speed, iface->last_online);
-			sock_printf(sock, "widget_set I dl 1 2 {NA (%s)}\n", speed);
-			sock_send_string(sock, "widget_set I ul 1 3 {}\n");
-			sock_send_string(sock, "widget_set I total 1 4 {}\n");
+			lcd_client_printf(sock, "widget_set I dl 1 2 {NA (%s)}\n", speed);
+			lcd_client_send(sock, "widget_set I ul 1 3 {}\n");
+			lcd_client_send(sock, "widget_set I total 1 4 {}\n");
 		}
 	}
 	/* multi-interfaces mode: 1 line per interface */
@@ -403,15 +402,15 @@ actualize_speed_screen(IfaceInfo *iface, unsigned int interval, int index)
 			format_value_multi_interface(speed, rc_speed, unit_label);
 			format_value_multi_interface(speed1, tr_speed, unit_label);
 			if (lcd_wid > 16)
-				sock_printf(sock, "widget_set I i%1d 1 %1d {%5.5s U:%.4s D:%.4s}\n",
+				lcd_client_printf(sock, "widget_set I i%1d 1 %1d {%5.5s U:%.4s D:%.4s}\n",
 					    index, index+1, iface->alias, speed1, speed);
 			else
-				sock_printf(sock, "widget_set I i%1d 1 %1d {%4.4s ^%.4s v%.4s}\n",
+				lcd_client_printf(sock, "widget_set I i%1d 1 %1d {%4.4s ^%.4s v%.4s}\n",
 					    index, index+1, iface->alias, speed1, speed);
 		}
 		else {
 			get_time_string(speed, iface->last_online);
-			sock_printf(sock, "widget_set I i%1d 1 %1d {%5.5s NA (%s)}\n",
+			lcd_client_printf(sock, "widget_set I i%1d 1 %1d {%5.5s NA (%s)}\n",
 					index, index+1, iface->alias, speed);
 		}
 	}
@@ -426,36 +425,36 @@ initialize_transfer_screen(void)
 {
 	int iface_nmbr;		/* interface number */
 
-	sock_send_string(sock, "screen_add NT\n");
-	sock_send_string(sock, "screen_set NT name {Transfer}\n");
-	sock_send_string(sock, "widget_add NT title title\n");
+	lcd_client_send(sock, "screen_add NT\n");
+	lcd_client_send(sock, "screen_set NT name {Transfer}\n");
+	lcd_client_send(sock, "widget_add NT title title\n");
 
 	/* single interface mode */
 	if ((iface_count == 1) && (lcd_hgt >= 4)) {
-		sock_printf(sock, "widget_set NT title {Transfer: %s}\n", iface[0].alias);
-		sock_send_string(sock, "widget_add NT dl string\n");
-		sock_send_string(sock, "widget_set NT dl 1 2 {DL:}\n");
-		sock_send_string(sock, "widget_add NT ul string\n");
-		sock_send_string(sock, "widget_set NT ul 1 3 {UL:}\n");
-		sock_send_string(sock, "widget_add NT total string\n");
-		sock_send_string(sock, "widget_set NT total 1 4 {Total:}\n");
+		lcd_client_printf(sock, "widget_set NT title {Transfer: %s}\n", iface[0].alias);
+		lcd_client_send(sock, "widget_add NT dl string\n");
+		lcd_client_send(sock, "widget_set NT dl 1 2 {DL:}\n");
+		lcd_client_send(sock, "widget_add NT ul string\n");
+		lcd_client_send(sock, "widget_set NT ul 1 3 {UL:}\n");
+		lcd_client_send(sock, "widget_add NT total string\n");
+		lcd_client_send(sock, "widget_set NT total 1 4 {Total:}\n");
 	}
 	/* multi-interfaces mode: one line per interface */
 	else {
 		/* Set title (transfer screen is always in "bytes") */
-		sock_send_string(sock, "widget_set NT title {Net Transfer (bytes)}\n");
+		lcd_client_send(sock, "widget_set NT title {Net Transfer (bytes)}\n");
 
 		/* frame from (2, left) to (width, height) that is iface_count lines high */
-		sock_send_string(sock, "widget_add NT f frame\n");
-		sock_printf(sock, "widget_set NT f 1 2 %d %d %d %d v 16\n",
+		lcd_client_send(sock, "widget_add NT f frame\n");
+		lcd_client_printf(sock, "widget_set NT f 1 2 %d %d %d %d v 16\n",
 			    lcd_wid, lcd_hgt, lcd_wid, iface_count,
 			    /* scroll rate: 1 line every X ticks (=1/8 sec) */
 			    ((lcd_hgt >= 4) ? 8 : 16));
 
 		/* Add interfaces */
 		for (iface_nmbr = 0; iface_nmbr < iface_count; iface_nmbr++) {
-			sock_printf(sock, "widget_add NT i%1d string -in f\n", iface_nmbr);
-			sock_printf(sock, "widget_set NT i%1d 1 %1d {%5.5s NA (never)}\n",
+			lcd_client_printf(sock, "widget_add NT i%1d string -in f\n", iface_nmbr);
+			lcd_client_printf(sock, "widget_set NT i%1d 1 %1d {%5.5s NA (never)}\n",
 				    iface_nmbr, iface_nmbr+1, iface[iface_nmbr].alias);
 		}
 	}
@@ -478,21 +477,21 @@ actualize_transfer_screen(IfaceInfo *iface, int index)
 		if (iface->status == up) {
 			/* download traffic */
 			format_value(transfer, iface->rc_byte, "B");
-			sock_printf(sock, "widget_set NT dl 1 2 {DL: %*s}\n", lcd_wid - 4, transfer);
+			lcd_client_printf(sock, "widget_set NT dl 1 2 {DL: %*s}\n", lcd_wid - 4, transfer);
 
 			/* upload traffic */
 			format_value(transfer, iface->tr_byte, "B");
-			sock_printf(sock, "widget_set NT ul 1 3 {UL: %*s}\n", lcd_wid - 4, transfer);
+			lcd_client_printf(sock, "widget_set NT ul 1 3 {UL: %*s}\n", lcd_wid - 4, transfer);
 
 			/* total traffic */
 			format_value(transfer, iface->rc_byte + iface->tr_byte, "B");
-			sock_printf(sock, "widget_set NT total 1 4 {Total: %*s}\n", lcd_wid - 7, transfer);
+			lcd_client_printf(sock, "widget_set NT total 1 4 {Total: %*s}\n", lcd_wid - 7, transfer);
 		}
 		else {
 			get_time_string(transfer, iface->last_online);
-			sock_printf(sock, "widget_set NT dl 1 2 {NA (%s)}\n", transfer);
-			sock_send_string(sock, "widget_set NT ul 1 3 {}\n");
-			sock_send_string(sock, "widget_set NT total 1 4 {}\n");
+			lcd_client_printf(sock, "widget_set NT dl 1 2 {NA (%s)}\n", transfer);
+			lcd_client_send(sock, "widget_set NT ul 1 3 {}\n");
+			lcd_client_send(sock, "widget_set NT total 1 4 {}\n");
 		}
 	}
 	/* multi-interfaces mode: one line per interface */
@@ -503,15 +502,15 @@ actualize_transfer_screen(IfaceInfo *iface, int index)
 			format_value_multi_interface(transfer, iface->rc_byte, "B");
 			format_value_multi_interface(transfer1, iface->tr_byte, "B");
 			if (lcd_wid > 16)
-				sock_printf(sock, "widget_set NT i%1d 1 %1d {%5.5s U:%.4s D:%.4s}\n",
+				lcd_client_printf(sock, "widget_set NT i%1d 1 %1d {%5.5s U:%.4s D:%.4s}\n",
 					    index, index+1, iface->alias, transfer1, transfer);
 			else
-				sock_printf(sock, "widget_set NT i%1d 1 %1d {%4.4s ^%.4s v%.4s}\n",
+				lcd_client_printf(sock, "widget_set NT i%1d 1 %1d {%4.4s ^%.4s v%.4s}\n",
 					    index, index+1, iface->alias, transfer1, transfer);
 		}
 		else {
 			get_time_string(transfer, iface->last_online);
-			sock_printf(sock, "widget_set NT i%1d 1 %1d {%5.5s NA (%s)}\n",
+			lcd_client_printf(sock, "widget_set NT i%1d 1 %1d {%5.5s NA (%s)}\n",
 					index, index+1, iface->alias, transfer);
 		}
 	}
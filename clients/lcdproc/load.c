@@ -21,6 +21,7 @@
 
 #include "shared/configfile.h"
 #include "shared/sockets.h"
+#include "shared/lcdclient.h"
 #include "main.h"
 #include "mode.h"
 #include "machine.h"
@@ -50,10 +51,13 @@ int
 xload_screen(int rep, int display, int *flags_ptr)
 {
 	static int gauge_hgt = 0;
-	static double loads[LCD_MAX_WIDTH];
+	static double loads[LCD_MAX_WIDTH];	/* circular, oldest at head */
+	static int shown[LCD_MAX_WIDTH];	/* bar heights on the server */
+	static int shown_top = -1;
+	static int head = 0;
 	static double lowLoad = LOAD_MIN;
 	static double highLoad = LOAD_MAX;
-	int loadtop, i;
+	int loadtop, newest, i;
 	double loadmax = 0, factor;
 	int status = BACKLIGHT_ON;
 
@@ -66,38 +70,41 @@ xload_screen(int rep, int display, int *flags_ptr)
 
 		gauge_hgt = (lcd_hgt > 2) ? (lcd_hgt - 1) : lcd_hgt;
 		memset(loads, '\0', sizeof(double) * LCD_MAX_WIDTH);
+		memset(shown, '\0', sizeof(int) * LCD_MAX_WIDTH);
+		shown_top = -1;
+		head = 0;
 
-		sock_send_string(sock, "screen_add L\n");
-		sock_printf(sock, "screen_set L -name {Load: %s}\n", get_hostname());
+		lcd_client_send(sock, "screen_add L\n");
+		lcd_client_printf(sock, "screen_set L -name {Load: %s}\n", get_hostname());
 		/* Add the vbars... */
 		for (i = 1; i < lcd_wid; i++) {
-			sock_printf(sock, "widget_add L bar%i vbar\n", i);
-			sock_printf(sock, "widget_set L bar%i %i %i 0\n", i, i, lcd_hgt);
+			lcd_client_printf(sock, "widget_add L bar%i vbar\n", i);
+			lcd_client_printf(sock, "widget_set L bar%i %i %i 0\n", i, i, lcd_hgt);
 		}
 		/* And add a title... */
 		if (lcd_hgt > 2) {
-			sock_send_string(sock, "widget_add L title title\n");
-			sock_send_string(sock, "widget_set L title {LOAD        }\n");
+			lcd_client_send(sock, "widget_add L title title\n");
+			lcd_client_send(sock, "widget_set L title {LOAD        }\n");
 		} else {
-			sock_send_string(sock, "widget_add L title string\n");
-			sock_send_string(sock, "widget_set L title 1 1 {LOAD}\n");
-			sock_send_string(sock, "screen_set L -heartbeat off\n");
+			lcd_client_send(sock, "widget_add L title string\n");
+			lcd_client_send(sock, "widget_set L title 1 1 {LOAD}\n");
+			lcd_client_send(sock, "screen_set L -heartbeat off\n");
 		}
-		sock_send_string(sock, "widget_add L zero string\n");
-		sock_send_string(sock, "widget_add L top string\n");
-		sock_printf(sock, "widget_set L zero %i %i 0\n", lcd_wid, lcd_hgt);
-		sock_printf(sock, "widget_set L top %i %i 1\n", lcd_wid, (lcd_hgt + 1 - gauge_hgt));
+		lcd_client_send(sock, "widget_add L zero string\n");
+		lcd_client_send(sock, "widget_add L top string\n");
+		lcd_client_printf(sock, "widget_set L zero %i %i 0\n", lcd_wid, lcd_hgt);
+		lcd_client_printf(sock, "widget_set L top %i %i 1\n", lcd_wid, (lcd_hgt + 1 - gauge_hgt));
 	}
 
-	/* shift load history */
-	for (i = 0; i < (lcd_wid - 2); i++)
-		loads[i] = loads[i + 1];
-
 	/*
-	 * get new load value, ignore failure: the shift above makes sure we
-	 * still have the previous value
+	 * get new load value into the place of the oldest, ignore failure:
+	 * then the previous value is repeated
 	 */
-	machine_get_loadavg(&(loads[lcd_wid - 2]));
+	newest = (head + lcd_wid - 2) % (lcd_wid - 1);
+	if (!machine_get_loadavg(&(loads[head])))
+		loads[head] = loads[newest];
+	newest = head;
+	head = (head + 1) % (lcd_wid - 1);
 
 	/* determine max. load from history */
 	for (i = 0; i < lcd_wid - 1; i++)
@@ -111,25 +118,33 @@ xload_screen(int rep, int display, int *flags_ptr)
 
 	factor = (double) (lcd_cellhgt * gauge_hgt) / (double) loadtop;
 
-	/* display load */
-	sock_printf(sock, "widget_set L top %i %i %i\n", lcd_wid, (lcd_hgt + 1 - gauge_hgt), loadtop);
+	/* display load; only the bars that changed, oldest left */
+	if (display) {
+		if (loadtop != shown_top) {
+			lcd_client_printf(sock, "widget_set L top %i %i %i\n", lcd_wid, (lcd_hgt + 1 - gauge_hgt), loadtop);
+			shown_top = loadtop;
+		}
 
-	for (i = 0; i < lcd_wid - 1; i++) {
-		double x = loads[i] * factor;
+		for (i = 0; i < lcd_wid - 1; i++) {
+			int x = (int) (loads[(head + i) % (lcd_wid - 1)] * factor);
 
-		sock_printf(sock, "widget_set L bar%i %i %i %i\n", i + 1, i + 1, lcd_hgt, (int) x);
-	}
+			if (x != shown[i]) {
+				lcd_client_printf(sock, "widget_set L bar%i %i %i %i\n", i + 1, i + 1, lcd_hgt, x);
+				shown[i] = x;
+			}
+		}
 
-	/* And now the title... */
-	if (lcd_hgt > 2)
-		sock_printf(sock, "widget_set L title {LOAD %2.2f:%s}\n", loads[lcd_wid - 2], get_hostname());
-	else
-		sock_printf(sock, "widget_set L title 1 1 {%s %2.2f}\n", get_hostname(), loads[lcd_wid - 2]);
+		/* And now the title... */
+		if (lcd_hgt > 2)
+			lcd_client_printf(sock, "widget_set L title {LOAD %2.2f:%s}\n", loads[newest], get_hostname());
+		else
+			lcd_client_printf(sock, "widget_set L title 1 1 {%s %2.2f}\n", get_hostname(), loads[newest]);
+	}
 
 	/* set return status depending on max & current load */
 	if (lowLoad < highLoad) {
 		status = (loadmax > lowLoad) ? BACKLIGHT_ON : BACKLIGHT_OFF;
-		if (loads[lcd_wid - 2] > highLoad)
+		if (loads[newest] > highLoad)
 			status = BLINK_ON;
 	}
 
@@ -205,5 +205,16 @@ int machine_get_uptime(double *up, double *idle);
  */
 int machine_get_iface_stats(IfaceInfo *interface);
 
+/**
+ * Read network interface statistics for several interfaces at once, as
+ * machine_get_iface_stats() does for one. Interface names match exactly.
+ *
+ * \param  interfaces Array of the interfaces.
+ * \param  count      Number of interfaces in the array.
+ * \retval  FALSE  Error, do not trust the contents of the array.
+ * \retval  TRUE   OK, the array is filled with sensible data.
+ */
+int machine_get_iface_stats_all(IfaceInfo *interfaces, int count);
+
 
 #endif /* _lcdproc_machine_h_ */
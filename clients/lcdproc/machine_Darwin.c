@@ -54,6 +54,7 @@
 #include <sys/user.h>
 
 #include <errno.h>
+#include <time.h>
 #include <sys/socket.h>
 #include <net/if.h>
 #include <net/if_mib.h>
@@ -74,6 +75,9 @@ static int swapmode(int *rettotal, int *retfree);
 
 static mach_port_t lcdproc_port;
 
+/* A pass over the screens takes less; the next one is a time unit later */
+#define SNAPSHOT_AGE	50000000L	/* ns */
+
 
 int
 machine_init(void)
@@ -230,27 +234,60 @@ machine_get_fs(mounts_type fs[], int *cnt)
 	return (TRUE);
 }
 
-int
-machine_get_load(load_type * curr_load)
+/** Turn the tick counters of a CPU into a load_type. */
+static void
+load_from_ticks(const unsigned int *ticks, load_type *load)
 {
-	static load_type last_load = {0, 0, 0, 0, 0};
-	static load_type last_ret_load;
-	load_type load;
+	load->user = (unsigned long)(ticks[CPU_STATE_USER]);
+	load->nice = (unsigned long)(ticks[CPU_STATE_NICE]);
+	load->system = (unsigned long)(ticks[CPU_STATE_SYSTEM]);
+	load->idle = (unsigned long)(ticks[CPU_STATE_IDLE]);
+	load->total = load->user + load->nice + load->system + load->idle;
+}
 
+/**
+ * Get the CPU counters, read anew only if the last snapshot was not taken
+ * during the current pass over the screens.
+ */
+static int
+cpu_load_snapshot(load_type *load)
+{
+	static load_type snap;
+	static struct timespec taken;
+	static int valid = 0;
+	struct timespec now;
 	host_cpu_load_info_data_t load_info;
 	mach_msg_type_number_t info_count;
 
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (valid && ((now.tv_sec - taken.tv_sec) * 1000000000L
+		      + (now.tv_nsec - taken.tv_nsec) < SNAPSHOT_AGE)) {
+		*load = snap;
+		return (TRUE);
+	}
+
 	info_count = HOST_CPU_LOAD_INFO_COUNT;
 	if (host_statistics(lcdproc_port, HOST_CPU_LOAD_INFO, (host_info_t) & load_info, &info_count)) {
 		perror("host_statistics");
 		return (FALSE);
 	}
+	load_from_ticks(load_info.cpu_ticks, &snap);
+	taken = now;
+	valid = 1;
+	*load = snap;
+	return (TRUE);
+}
+
+int
+machine_get_load(load_type * curr_load)
+{
+	static load_type last_load = {0, 0, 0, 0, 0};
+	static load_type last_ret_load;
+	load_type load;
 
-	load.user = (unsigned long)(load_info.cpu_ticks[CPU_STATE_USER]);
-	load.nice = (unsigned long)(load_info.cpu_ticks[CPU_STATE_NICE]);
-	load.system = (unsigned long)(load_info.cpu_ticks[CPU_STATE_SYSTEM]);
-	load.idle = (unsigned long)(load_info.cpu_ticks[CPU_STATE_IDLE]);
-	load.total = load.user + load.nice + load.system + load.idle;
+	/* Several screens in one pass share a snapshot, and get the same load */
+	if (cpu_load_snapshot(&load) == FALSE)
+		return (FALSE);
 
 	if (load.total != last_load.total) {
 		curr_load->user = load.user - last_load.user;
@@ -397,31 +434,44 @@ machine_get_procs(LinkedList * procs)
 int
 machine_get_smpload(load_type * result, int *numcpus)
 {
+	static load_type last_load[MAX_CPUS];
+	natural_t count;
+	processor_cpu_load_info_t info;
+	mach_msg_type_number_t info_count;
 	int i, num;
-	size_t size;
-	load_type curr_load;
 
-	size = sizeof(int);
-	if (sysctlbyname("hw.ncpu", &num, &size, NULL, 0) < 0) {
-		perror("sysctl hw.ncpu");
-		return (FALSE);
-	}
-
-	if (machine_get_load(&curr_load) == FALSE)
+	if (numcpus == NULL)
 		return (FALSE);
 
-	if (numcpus == NULL)
+	/* the counters of all CPUs in one call */
+	if (host_processor_info(lcdproc_port, PROCESSOR_CPU_LOAD_INFO, &count,
+				(processor_info_array_t *) & info, &info_count) != KERN_SUCCESS) {
+		perror("host_processor_info");
 		return (FALSE);
+	}
 
 	/* restrict #CPUs to max. *numcpus */
-	num = (*numcpus >= num) ? num : *numcpus;
+	num = ((natural_t) *numcpus >= count) ? (int) count : *numcpus;
 	*numcpus = num;
 
-	/* Don't know how to get per-cpu-load values */
 	for (i = 0; i < num; i++) {
-		result[i] = curr_load;
+		load_type load;
+
+		load_from_ticks(info[i].cpu_ticks, &load);
+
+		/* store difference in result */
+		result[i].user = load.user - last_load[i].user;
+		result[i].nice = load.nice - last_load[i].nice;
+		result[i].system = load.system - last_load[i].system;
+		result[i].idle = load.idle - last_load[i].idle;
+		result[i].total = load.total - last_load[i].total;
+
+		/* store current value for next round */
+		last_load[i] = load;
 	}
 
+	vm_deallocate(mach_task_self(), (vm_address_t) info,
+		      info_count * sizeof(integer_t));
 	return (TRUE);
 }
 
@@ -483,67 +533,89 @@ swapmode(int *rettotal, int *retfree)
 	return (FALSE);
 }
 
+/**
+ * Store the counters of an interface found in the ifmib table, if it is
+ * one of those asked for.
+ * \return  TRUE if it was asked for.
+ */
+static int
+iface_stats_found(IfaceInfo * interfaces, int count, const struct ifmibdata *ifmd)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		IfaceInfo *interface = &interfaces[i];
+
+		if (strcmp(ifmd->ifmd_name, interface->name) != 0)
+			continue;
+
+		interface->rc_byte = ifmd->ifmd_data.ifi_ibytes;
+		interface->tr_byte = ifmd->ifmd_data.ifi_obytes;
+		interface->rc_pkt = ifmd->ifmd_data.ifi_ipackets;
+		interface->tr_pkt = ifmd->ifmd_data.ifi_opackets;
+
+		if (interface->last_online == 0) {
+			interface->rc_byte_old = interface->rc_byte;
+			interface->tr_byte_old = interface->tr_byte;
+			interface->rc_pkt_old = interface->rc_pkt;
+			interface->tr_pkt_old = interface->tr_pkt;
+		}
+
+		if ((ifmd->ifmd_flags & IFF_UP) == IFF_UP) {
+			interface->status = up;	/* is up */
+			interface->last_online = time(NULL);	/* save actual time */
+		}
+		return (TRUE);
+	}
+	return (FALSE);
+}
+
+
 /* Get network statistics */
 int
 machine_get_iface_stats(IfaceInfo * interface)
 {
-	int rows;
-	int name[6] = {CTL_NET, PF_LINK, NETLINK_GENERIC, IFMIB_SYSTEM, IFMIB_IFCOUNT};
+	return machine_get_iface_stats_all(interface, 1);
+}
+
+
+int
+machine_get_iface_stats_all(IfaceInfo * interfaces, int count)
+{
+	static const int count_name[5] = {CTL_NET, PF_LINK, NETLINK_GENERIC, IFMIB_SYSTEM, IFMIB_IFCOUNT};
+	int name[6] = {CTL_NET, PF_LINK, NETLINK_GENERIC, IFMIB_IFDATA, 0, IFDATA_GENERAL};
+	int rows, i, found = 0;
 	size_t len;
 	struct ifmibdata ifmd;	/* ifmibdata contains the network statistics */
 
 	len = sizeof(rows);
 	/* get number of interfaces */
-	if (sysctl(name, 5, &rows, &len, 0, 0) == 0) {
-		interface->status = down;	/* set status down by default */
+	if (sysctl((int *) count_name, 5, &rows, &len, 0, 0) != 0) {
+		perror("read sysctl IFMIB_IFCOUNT");
+		return (FALSE);
+	}
 
-		name[3] = IFMIB_IFDATA;
-		name[4] = 0;
-		name[5] = IFDATA_GENERAL;
+	/* set status down by default */
+	for (i = 0; i < count; i++)
+		interfaces[i].status = down;
 
+	/*
+	 * walk through all interfaces in the ifmib table from last to first
+	 * once for all interfaces asked for
+	 */
+	for (; (rows > 0) && (found < count); rows--) {
+		name[4] = rows;	/* set the interface index */
 		len = sizeof(ifmd);
-		/*
-		 * walk through all interfaces in the ifmib table from last
-		 * to first
-		 */
-		for (; rows > 0; rows--) {
-			name[4] = rows;	/* set the interface index */
-			/* retrive the ifmibdata for the current index */
-			if (sysctl(name, 6, &ifmd, &len, NULL, 0) == -1) {
-				perror("read sysctl");
-				break;
-			}
-			/* check if its interface name matches */
-			if (strcmp(ifmd.ifmd_name, interface->name) == 0) {
-
-				interface->rc_byte = ifmd.ifmd_data.ifi_ibytes;
-				interface->tr_byte = ifmd.ifmd_data.ifi_obytes;
-				interface->rc_pkt = ifmd.ifmd_data.ifi_ipackets;
-				interface->tr_pkt = ifmd.ifmd_data.ifi_opackets;
-
-				if (interface->last_online == 0) {
-					interface->rc_byte_old = interface->rc_byte;
-					interface->tr_byte_old = interface->tr_byte;
-					interface->rc_pkt_old = interface->rc_pkt;
-					interface->tr_pkt_old = interface->tr_pkt;
-				}
-
-				if ((ifmd.ifmd_flags & IFF_UP) == IFF_UP) {
-					interface->status = up;	/* is up */
-					interface->last_online = time(NULL);	/* save actual time */
-				}
-
-				return (TRUE);
-			}
+		/* retrive the ifmibdata for the current index */
+		if (sysctl(name, 6, &ifmd, &len, NULL, 0) == -1) {
+			perror("read sysctl");
+			break;
 		}
-		/* if we are here there is no interface with the given name */
-		return (TRUE);
+		found += iface_stats_found(interfaces, count, &ifmd);
 	}
-	else {
-		perror("read sysctl IFMIB_IFCOUNT");
-		return (FALSE);
-	}
-}
 
+	/* interfaces not found keep being down */
+	return (TRUE);
+}
 
 #endif				/* __APPLE__ */
@@ -49,6 +49,7 @@
 #include <sys/mount.h>
 #include <sys/time.h>
 #include <sys/user.h>
+#include <time.h>
 #include <kvm.h>
 #include <errno.h>
 #include <sys/socket.h>
@@ -73,9 +74,91 @@
 
 static int pageshift;
 static kvm_t *kvmd;
+static int ncpu = 1;
 #define pagetok(size) ((size) << pageshift)
 static int swapmode(int *retavail, int *retfree);
 
+/** A sysctl name, resolved to its MIB on first use */
+typedef struct {
+	const char *name;
+	int mib[CTL_MAXNAME];
+	size_t len;		/**< Length of mib; 0 while not resolved */
+} CachedMib;
+
+static CachedMib mib_cp_time = { "kern.cp_time" };
+static CachedMib mib_cp_times = { "kern.cp_times" };
+static CachedMib mib_page_count = { "vm.stats.vm.v_page_count" };
+static CachedMib mib_free_count = { "vm.stats.vm.v_free_count" };
+static CachedMib mib_ifcount = { "net.link.generic.system.ifcount" };
+
+/* A pass over the screens takes less; the next one is a time unit later */
+#define SNAPSHOT_AGE	50000000L	/* ns */
+
+
+/**
+ * Read a sysctl by name like sysctlbyname(), but look the name up only
+ * the first time.
+ * \return  0 on success, -1 on error.
+ */
+static int
+cached_sysctl(CachedMib *m, void *value, size_t *size)
+{
+	if (m->len == 0) {
+		m->len = CTL_MAXNAME;
+		if (sysctlnametomib(m->name, m->mib, &m->len) < 0) {
+			m->len = 0;
+			return -1;
+		}
+	}
+	return sysctl(m->mib, m->len, value, size, NULL, 0);
+}
+
+
+/** Turn the CPU time counters of the kernel into a load_type. */
+static void
+load_from_cp_time(const long *cp_time, load_type *load)
+{
+	load->user = (unsigned long)(cp_time[CP_USER]);
+	load->nice = (unsigned long)(cp_time[CP_NICE]);
+	load->system = (unsigned long)(cp_time[CP_SYS] + cp_time[CP_INTR]);
+	load->idle = (unsigned long)(cp_time[CP_IDLE]);
+	load->total = load->user + load->nice + load->system + load->idle;
+}
+
+
+/**
+ * Get the CPU counters, read anew only if the last snapshot was not taken
+ * during the current pass over the screens.
+ */
+static int
+cp_time_snapshot(load_type *load)
+{
+	static load_type snap;
+	static struct timespec taken;
+	static int valid = 0;
+	struct timespec now;
+	long cp_time[CPUSTATES];
+	size_t size;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (valid && ((now.tv_sec - taken.tv_sec) * 1000000000L
+		      + (now.tv_nsec - taken.tv_nsec) < SNAPSHOT_AGE)) {
+		*load = snap;
+		return (TRUE);
+	}
+
+	size = sizeof(cp_time);
+	if (cached_sysctl(&mib_cp_time, cp_time, &size) < 0) {
+		perror("sysctl kern.cp_time failed");
+		return (FALSE);
+	}
+	load_from_cp_time(cp_time, &snap);
+	taken = now;
+	valid = 1;
+	*load = snap;
+	return (TRUE);
+}
+
 
 int
 machine_init(void)
@@ -85,6 +168,8 @@ machine_init(void)
 	 * it
 	 */
 	int pagesize = getpagesize();
+	size_t size;
+
 	pageshift = 0;
 	while (pagesize > 1) {
 		pageshift++;
@@ -94,6 +179,13 @@ machine_init(void)
 	/* we only need the amount of log(2)1024 for our conversion */
 	pageshift -= 10;
 
+	/* the number of CPUs does not change while we run */
+	size = sizeof(ncpu);
+	if ((sysctlbyname("hw.ncpu", &ncpu, &size, NULL, 0) < 0) || (ncpu < 1)) {
+		perror("sysctl hw.ncpu");
+		ncpu = 1;
+	}
+
 	/* open kernel virtual memory */
 	if ((kvmd = kvm_open(NULL, NULL, NULL, O_RDONLY, "kvm_open")) == NULL) {
 		perror("kvm_open failed");
@@ -224,20 +316,10 @@ machine_get_load(load_type * curr_load)
 	static load_type last_load = {0, 0, 0, 0, 0};
 	static load_type last_ret_load;
 	load_type load;
-	long cp_time[CPUSTATES];
-	size_t size;
 
-	size = sizeof(cp_time);
-	if (sysctlbyname("kern.cp_time", cp_time, &size, NULL, 0) < 0) {
-		perror("sysctl kern.cp_time failed");
+	/* Several screens in one pass share a snapshot, and get the same load */
+	if (cp_time_snapshot(&load) == FALSE)
 		return (FALSE);
-	}
-
-	load.user = (unsigned long)(cp_time[CP_USER]);
-	load.nice = (unsigned long)(cp_time[CP_NICE]);
-	load.system = (unsigned long)(cp_time[CP_SYS] + cp_time[CP_INTR]);
-	load.idle = (unsigned long)(cp_time[CP_IDLE]);
-	load.total = load.user + load.nice + load.system + load.idle;
 
 	if (load.total != last_load.total) {
 		curr_load->user = load.user - last_load.user;
@@ -276,12 +358,12 @@ machine_get_meminfo(meminfo_type * result)
 
 	size = sizeof(int);
 
-	if (sysctlbyname("vm.stats.vm.v_page_count", &total_pages, &size, NULL, 0) < 0) {
+	if (cached_sysctl(&mib_page_count, &total_pages, &size) < 0) {
 		perror("sysctl vm.stats.vm.v_page_count");
 		return (FALSE);
 	}
 
-	if (sysctlbyname("vm.stats.vm.v_free_count", &free_pages, &size, NULL, 0) < 0) {
+	if (cached_sysctl(&mib_free_count, &free_pages, &size) < 0) {
 		perror("sysctl vm.stats.vm.v_free_count");
 		return (FALSE);
 	}
@@ -353,49 +435,66 @@ machine_get_procs(LinkedList * procs)
 int
 machine_get_smpload(load_type * result, int *numcpus)
 {
+	static load_type last_load[MAX_CPUS];
+	static long *cp_times = NULL;	/* counters of all CPUs */
+	static int have_cp_times = 1;
 	int i, num;
 	size_t size;
 	load_type load;
 #ifdef HAVE_SYS_PCPU_H
-	static load_type last_load[MAX_CPUS];
 	struct pcpu *pcpudata;
-
-	if (kvmd == NULL)
-		return (FALSE);
 #endif
 
 	if (numcpus == NULL)
 		return (FALSE);
 
-	size = sizeof(int);
-	if (sysctlbyname("hw.ncpu", &num, &size, NULL, 0) < 0) {
-		perror("sysctl hw.ncpu");
-		return (FALSE);
-	}
-
 	/* restrict #CPUs to max. *numcpus */
-	num = (*numcpus >= num) ? num : *numcpus;
+	num = (*numcpus >= ncpu) ? ncpu : *numcpus;
 	*numcpus = num;
 
-#ifndef HAVE_SYS_PCPU_H
-	if (machine_get_load(&load) == FALSE)
+	/* The counters of all CPUs in one call, where the kernel has them */
+	if (have_cp_times && (cp_times == NULL)) {
+		cp_times = calloc(ncpu * CPUSTATES, sizeof(long));
+		have_cp_times = (cp_times != NULL);
+	}
+	if (have_cp_times) {
+		size = ncpu * CPUSTATES * sizeof(long);
+		if (cached_sysctl(&mib_cp_times, cp_times, &size) < 0)
+			have_cp_times = 0;
+		else if (size < num * CPUSTATES * sizeof(long))
+			num = *numcpus = size / (CPUSTATES * sizeof(long));
+	}
+
+#ifdef HAVE_SYS_PCPU_H
+	if (!have_cp_times && (kvmd == NULL))
 		return (FALSE);
+#else
+	if (!have_cp_times) {
+		if (machine_get_load(&load) == FALSE)
+			return (FALSE);
+		for (i = 0; i < num; i++)
+			result[i] = load;
+		return (TRUE);
+	}
 #endif
 
 	for (i = 0; i < num; i++) {
+		if (have_cp_times)
+			load_from_cp_time(cp_times + i * CPUSTATES, &load);
 #ifdef HAVE_SYS_PCPU_H
-		pcpudata = kvm_getpcpu(kvmd, i);
+		else {
+			pcpudata = kvm_getpcpu(kvmd, i);
 
-		if (pcpudata == NULL || pcpudata == (void *)-1)
-			return (FALSE);
+			if (pcpudata == NULL || pcpudata == (void *)-1)
+				return (FALSE);
+
+			/* extract the data for single CPU */
+			load_from_cp_time(pcpudata->pc_cp_time, &load);
 
-		/* extract the data for single CPU */
-		load.user = (unsigned long)(pcpudata->pc_cp_time[CP_USER]);
-		load.nice = (unsigned long)(pcpudata->pc_cp_time[CP_NICE]);
-		load.system = (unsigned long)(pcpudata->pc_cp_time[CP_SYS] +
-					      pcpudata->pc_cp_time[CP_INTR]);
-		load.idle = (unsigned long)(pcpudata->pc_cp_time[CP_IDLE]);
-		load.total = load.user + load.nice + load.system + load.idle;
+			/* free pcpu buffer */
+			free(pcpudata);
+		}
+#endif
 
 		/* store difference in result */
 		result[i].user = load.user - last_load[i].user;
@@ -405,17 +504,7 @@ machine_get_smpload(load_type * result, int *numcpus)
 		result[i].total = load.total - last_load[i].total;
 
 		/* store current value for next round */
-		last_load[i].user = load.user;
-		last_load[i].nice = load.nice;
-		last_load[i].system = load.system;
-		last_load[i].idle = load.idle;
-		last_load[i].total = load.total;
-
-		/* free pcpu buffer */
-		free(pcpudata);
-#else
-		result[i] = load;
-#endif
+		last_load[i] = load;
 	}
 
 	return (TRUE);
@@ -476,61 +565,87 @@ swapmode(int *retavail, int *retfree)
 	return (n);
 }
 
+/**
+ * Store the counters of an interface found in the ifmib table, if it is
+ * one of those asked for.
+ * \return  TRUE if it was asked for.
+ */
+static int
+iface_stats_found(IfaceInfo * interfaces, int count, const struct ifmibdata *ifmd)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		IfaceInfo *interface = &interfaces[i];
+
+		if (strcmp(ifmd->ifmd_name, interface->name) != 0)
+			continue;
+
+		interface->rc_byte = ifmd->ifmd_data.ifi_ibytes;
+		interface->tr_byte = ifmd->ifmd_data.ifi_obytes;
+		interface->rc_pkt = ifmd->ifmd_data.ifi_ipackets;
+		interface->tr_pkt = ifmd->ifmd_data.ifi_opackets;
+
+		if (interface->last_online == 0) {
+			interface->rc_byte_old = interface->rc_byte;
+			interface->tr_byte_old = interface->tr_byte;
+			interface->rc_pkt_old = interface->rc_pkt;
+			interface->tr_pkt_old = interface->tr_pkt;
+		}
+
+		if ((ifmd->ifmd_flags & IFF_UP) == IFF_UP) {
+			interface->status = up;	/* is up */
+			interface->last_online = time(NULL);	/* save actual time */
+		}
+		return (TRUE);
+	}
+	return (FALSE);
+}
+
+
 int
 machine_get_iface_stats(IfaceInfo * interface)
 {
-	int rows;
+	return machine_get_iface_stats_all(interface, 1);
+}
+
+
+int
+machine_get_iface_stats_all(IfaceInfo * interfaces, int count)
+{
+	int rows, i, found = 0;
 	int name[6] = {CTL_NET, PF_LINK, NETLINK_GENERIC, IFMIB_IFDATA, 0, IFDATA_GENERAL};
 	size_t len;
 	struct ifmibdata ifmd;	/* ifmibdata contains the network statistics */
 
 	len = sizeof(rows);
 	/* get number of interfaces */
-	if (sysctlbyname("net.link.generic.system.ifcount", &rows, &len, NULL, 0) == 0) {
-		interface->status = down;	/* set status down by default */
+	if (cached_sysctl(&mib_ifcount, &rows, &len) < 0) {
+		perror("read sysctlbyname");
+		return (FALSE);
+	}
+
+	/* set status down by default */
+	for (i = 0; i < count; i++)
+		interfaces[i].status = down;
 
+	/*
+	 * walk through all interfaces in the ifmib table from last to first
+	 * once for all interfaces asked for
+	 */
+	for (; (rows > 0) && (found < count); rows--) {
+		name[4] = rows;	/* set the interface index */
 		len = sizeof(ifmd);
-		/*
-		 * walk through all interfaces in the ifmib table from last
-		 * to first
-		 */
-		for (; rows > 0; rows--) {
-			name[4] = rows;	/* set the interface index */
-			/* retrive the ifmibdata for the current index */
-			if (sysctl(name, 6, &ifmd, &len, NULL, 0) == -1) {
-				perror("read sysctl");
-				break;
-			}
-			/* check if its interface name matches */
-			if (strcmp(ifmd.ifmd_name, interface->name) == 0) {
-
-				interface->rc_byte = ifmd.ifmd_data.ifi_ibytes;
-				interface->tr_byte = ifmd.ifmd_data.ifi_obytes;
-				interface->rc_pkt = ifmd.ifmd_data.ifi_ipackets;
-				interface->tr_pkt = ifmd.ifmd_data.ifi_opackets;
-
-				if (interface->last_online == 0) {
-					interface->rc_byte_old = interface->rc_byte;
-					interface->tr_byte_old = interface->tr_byte;
-					interface->rc_pkt_old = interface->rc_pkt;
-					interface->tr_pkt_old = interface->tr_pkt;
-				}
-
-				if ((ifmd.ifmd_flags & IFF_UP) == IFF_UP) {
-					interface->status = up;	/* is up */
-					interface->last_online = time(NULL);	/* save actual time */
-				}
-
-				return (TRUE);
-			}
+		/* retrive the ifmibdata for the current index */
+		if (sysctl(name, 6, &ifmd, &len, NULL, 0) == -1) {
+			perror("read sysctl");
+			break;
 		}
-		/* if we are here there is no interface with the given name */
-		return (TRUE);
-	}
-	else {
-		perror("read sysctlbyname");
-		return (FALSE);
+		found += iface_stats_found(interfaces, count, &ifmd);
 	}
+
+	/* interfaces not found keep being down */
+	return (TRUE);
 }
 
 #endif				/* __FreeBSD__ */
@@ -17,6 +17,7 @@
 #include <unistd.h>
 #include <ctype.h>
 #include <string.h>
+#include <strings.h>
 #include <fcntl.h>
 #include <dirent.h>
 #include <sys/param.h>
@@ -24,6 +25,7 @@
 #include <sys/stat.h>
 #include <sys/statvfs.h>
 #include <errno.h>
+#include <poll.h>
 
 #ifdef HAVE_CONFIG_H
 # include "config.h"
@@ -44,6 +46,11 @@
 # define USE_GETLOADAVG
 #endif
 
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_LIBPTHREAD)
+# define USE_THREADS
+# include <pthread.h>
+#endif
+
 #ifdef USE_GETLOADAVG
 # ifdef HAVE_SYS_LOADAVG_H
 #  include <sys/loadavg.h>
@@ -58,27 +65,86 @@
 # include <sys/procfs.h>
 #endif
 
+#ifdef HAVE_LINUX_RTNETLINK_H
+# include <sys/socket.h>
+# include <linux/netlink.h>
+# include <linux/rtnetlink.h>
+# include <linux/if_link.h>
+#endif
+
 #include "main.h"
 #include "mode.h"
 #include "machine.h"
 #include "shared/LL.h"
+#include "shared/hash.h"
+#include "shared/configfile.h"
 #include "shared/report.h"
 
 
-static int batt_fd;
+static int batt_fd;			/* /proc/apm, if there is no power supply class */
 static int load_fd;
 static int loadavg_fd;
 static int meminfo_fd;
 static int uptime_fd;
+static int netdev_fd = -1;
+static int cgroup_fd = -1;		/* cgroup to collect the stats of */
+
+static int cgroup_open(const char *path);
+#ifdef HAVE_LINUX_RTNETLINK_H
+static int netlink_fd = -1;
+static int netlink_failed = 0;	/* use /proc/net/dev instead */
+#endif
 
 static char procbuf[1024];	/* TODO ugly hack! */
 
-static FILE *mtab_fd;
+/* Power supplies of the power supply class */
+#define POWER_SUPPLY_DIR	"/sys/class/power_supply"
+#define MAX_BATTERIES		4
+
+static int ac_online_fd = -1;		/* "online" of the mains supply */
+static int batt_capacity_fd[MAX_BATTERIES];	/* "capacity" of each battery */
+static int batt_status_fd[MAX_BATTERIES];	/* "status" of each battery */
+static int batt_count = 0;
+
+static int power_supply_open(void);
+
+/** The values of /proc/meminfo that are shown, in kB */
+typedef struct {
+	long mem_total;
+	long mem_free;
+	long mem_shared;
+	long buffers;
+	long cached;
+	long swap_total;
+	long swap_free;
+} MemInfo;
+
+/* Mounted file systems to get the statistics of, from the mount table */
+#define MAX_MOUNTS	256
+/* Milliseconds to wait for the statistics of all file systems */
+#define STATFS_TIMEOUT	500
+
+static mounts_type mounts[MAX_MOUNTS];
+static int mounts_stat[MAX_MOUNTS];	/* 1: statistics known, -1: failed */
+static int mounts_count = -1;		/* -1: table not read yet */
+static int mounts_fd = -1;		/* signals changes of the table */
+
+#ifdef USE_THREADS
+/* statvfs() is done by a worker, since it can hang on NFS mounts */
+static pthread_mutex_t statfs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t statfs_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t statfs_idle = PTHREAD_COND_INITIALIZER;
+static unsigned int statfs_asked = 0;	/* rounds of statistics asked for */
+static unsigned int statfs_done = 0;	/* and done */
+static int statfs_thread_running = 0;
+#endif
 
 
 int
 machine_init(void)
 {
+	const char *collector;
+
 	uptime_fd = -1;
 	batt_fd = -1;
 	load_fd = -1;
@@ -119,7 +185,8 @@ machine_init(void)
 		}
 	}
 
-	if (batt_fd < 0) {
+	/* Without the power supply class, try APM of ancient kernels */
+	if ((batt_fd < 0) && !power_supply_open()) {
 		batt_fd = open("/proc/apm", O_RDONLY);
 		if (batt_fd < 0) {
 			/* allow opening /proc/apm to fail */
@@ -127,6 +194,18 @@ machine_init(void)
 		}
 	}
 
+	/* Where to collect the stats of CPU, memory and processes */
+	collector = config_get_string(progname, "Collector", 0, "proc");
+	if (strcasecmp(collector, "cgroup") == 0) {
+		const char *path = config_get_string(progname, "CgroupPath", 0, NULL);
+
+		if (!cgroup_open(path))
+			report(RPT_WARNING, "No cgroup v2 stats in %s, collecting from /proc",
+			       (path != NULL) ? path : "the cgroup of lcdproc");
+	}
+	else if (strcasecmp(collector, "proc") != 0)
+		report(RPT_WARNING, "Unknown Collector %s, collecting from /proc", collector);
+
 	return (TRUE);
 }
 
@@ -137,6 +216,16 @@ machine_close(void)
 		close(batt_fd);
 	batt_fd = -1;
 
+	if (ac_online_fd >= 0)
+		close(ac_online_fd);
+	ac_online_fd = -1;
+	while (batt_count > 0) {
+		batt_count--;
+		close(batt_capacity_fd[batt_count]);
+		if (batt_status_fd[batt_count] >= 0)
+			close(batt_status_fd[batt_count]);
+	}
+
 	if (load_fd >= 0)
 		close(load_fd);
 	load_fd = -1;
@@ -155,6 +244,24 @@ machine_close(void)
 		close(uptime_fd);
 	uptime_fd = -1;
 
+	if (netdev_fd >= 0)
+		close(netdev_fd);
+	netdev_fd = -1;
+
+	if (mounts_fd >= 0)
+		close(mounts_fd);
+	mounts_fd = -1;
+
+	if (cgroup_fd >= 0)
+		close(cgroup_fd);
+	cgroup_fd = -1;
+
+#ifdef HAVE_LINUX_RTNETLINK_H
+	if (netlink_fd >= 0)
+		close(netlink_fd);
+	netlink_fd = -1;
+#endif
+
 	return (TRUE);
 }
 
@@ -167,37 +274,434 @@ reread(int f, char *errmsg)
 	exit(1);
 }
 
+/**
+ * Read a whole file from its start into a buffer that grows as needed.
+ * \param f       File descriptor.
+ * \param buffer  Buffer, reallocated if it is too small.
+ * \param size    Its size.
+ * \return  Number of bytes read, the data ending with a 0; -1 on error.
+ */
+static ssize_t
+read_all(int f, char **buffer, size_t *size)
+{
+	size_t len = 0;
+	ssize_t n;
+
+	do {
+		if (len + 1 >= *size) {
+			size_t new_size = (*size > 0) ? 2 * *size : 4096;
+			char *new_buffer = realloc(*buffer, new_size);
+
+			if (new_buffer == NULL)
+				return -1;
+			*buffer = new_buffer;
+			*size = new_size;
+		}
+		n = pread(f, *buffer + len, *size - len - 1, len);
+		if (n < 0)
+			return -1;
+		len += n;
+	} while (n > 0);
+	(*buffer)[len] = '\0';
+	return len;
+}
+
+/**
+ * Read a small file below a directory, such as /proc/<pid>/statm.
+ * \return  Number of bytes read, the data ending with a 0; -1 on error.
+ */
 static int
-getentry(const char *tag, const char *bufptr, long *value)
-{
-	char *tail;
-	int len = strlen(tag);
-	long val;
-
-	while (bufptr != NULL) {
-		if (*bufptr == '\n')
-			bufptr++;
-		if (!strncmp(tag, bufptr, len)) {
-			errno = 0;
-			val = strtol(bufptr + len, &tail, 10);
-			if ((errno == 0) && (tail != bufptr + len)) {
-				*value = val;
-				return TRUE;
+read_at(int dir_fd, const char *path, char *buf, size_t size)
+{
+	int fd = openat(dir_fd, path, O_RDONLY);
+	ssize_t len;
+
+	if (fd < 0)
+		return -1;
+	len = read(fd, buf, size - 1);
+	close(fd);
+	if (len < 0)
+		return -1;
+	buf[len] = '\0';
+	return len;
+}
+
+
+/**
+ * Read /proc/meminfo and pick the values that are shown in a single pass
+ * over its lines. Values not in the file are 0.
+ */
+static void
+meminfo_read(MemInfo *m)
+{
+	static char *buffer = NULL;	/* contents of /proc/meminfo */
+	static size_t size = 0;
+	const char *line;
+
+	if (read_all(meminfo_fd, &buffer, &size) < 0) {
+		perror("get_meminfo");
+		exit(1);
+	}
+
+	memset(m, 0, sizeof(*m));
+	for (line = buffer; *line != '\0'; ) {
+		size_t len = strcspn(line, ":\n");
+		long *value = NULL;
+
+#define IS_TAG(tag)	((len == sizeof(tag) - 1) && (memcmp(line, tag, len) == 0))
+		if (line[len] == ':') {
+			switch (line[0]) {
+			    case 'M':
+				value = IS_TAG("MemTotal") ? &m->mem_total
+				      : IS_TAG("MemFree") ? &m->mem_free
+				      : IS_TAG("MemShared") ? &m->mem_shared : NULL;
+				break;
+			    case 'B':
+				value = IS_TAG("Buffers") ? &m->buffers : NULL;
+				break;
+			    case 'C':
+				value = IS_TAG("Cached") ? &m->cached : NULL;
+				break;
+			    case 'S':
+				/* Shmem is what kernels since 2.6.32 call MemShared */
+				value = IS_TAG("SwapTotal") ? &m->swap_total
+				      : IS_TAG("SwapFree") ? &m->swap_free
+				      : IS_TAG("Shmem") ? &m->mem_shared : NULL;
+				break;
 			}
-			else
-				return FALSE;
 		}
-		bufptr = strchr(bufptr, '\n');
+#undef IS_TAG
+		if (value != NULL)
+			*value = strtol(line + len + 1, NULL, 10);
+
+		line += len + strcspn(line + len, "\n");
+		if (*line == '\n')
+			line++;
+	}
+}
+
+/**
+ * Find a value in a file of "key value" lines, as the cgroup files have.
+ * \return  TRUE if found, FALSE if not.
+ */
+static int
+cgroup_entry(const char *buf, const char *key, unsigned long long *value)
+{
+	size_t len = strlen(key);
+
+	while (buf != NULL) {
+		if ((strncmp(buf, key, len) == 0) && (buf[len] == ' ')) {
+			*value = strtoull(buf + len + 1, NULL, 10);
+			return TRUE;
+		}
+		buf = strchr(buf, '\n');
+		if (buf != NULL)
+			buf++;
 	}
 	return FALSE;
 }
 
+
+/**
+ * Read a number from a cgroup file that has a single one.
+ * \return  TRUE if read, FALSE if the file is missing or says "max".
+ */
+static int
+cgroup_value(const char *name, unsigned long long *value)
+{
+	char buf[64];
+
+	if ((read_at(cgroup_fd, name, buf, sizeof(buf)) <= 0) || !isdigit((unsigned char) buf[0]))
+		return FALSE;
+	*value = strtoull(buf, NULL, 10);
+	return TRUE;
+}
+
+
+/**
+ * Open the cgroup to collect the stats of: the one configured with
+ * CgroupPath, else the one lcdproc runs in.
+ * \return  TRUE if it can be used, FALSE if not.
+ */
+static int
+cgroup_open(const char *path)
+{
+	char found[1024];
+	char mount[512] = "";
+	char line[1024];
+	FILE *f;
+
+	if (path == NULL) {
+		/* The cgroup2 file system... */
+		f = fopen("/proc/self/mounts", "r");
+		while ((f != NULL) && (fgets(line, sizeof(line), f) != NULL)) {
+			char mpoint[512], type[64];
+
+			if ((sscanf(line, "%*s %511s %63s", mpoint, type) == 2)
+			    && (strcmp(type, "cgroup2") == 0)) {
+				strcpy(mount, mpoint);
+				break;
+			}
+		}
+		if (f != NULL)
+			fclose(f);
+
+		/* ... and our place in it */
+		f = fopen("/proc/self/cgroup", "r");
+		while ((f != NULL) && (fgets(line, sizeof(line), f) != NULL)) {
+			if ((mount[0] != '\0') && (strncmp(line, "0::", 3) == 0)) {
+				line[strcspn(line, "\n")] = '\0';
+				snprintf(found, sizeof(found), "%s%s", mount, line + 3);
+				path = found;
+				break;
+			}
+		}
+		if (f != NULL)
+			fclose(f);
+		if (path == NULL)
+			return FALSE;
+	}
+
+	cgroup_fd = open(path, O_RDONLY | O_DIRECTORY);
+	if (cgroup_fd < 0)
+		return FALSE;
+	if (faccessat(cgroup_fd, "cpu.stat", R_OK, 0) < 0) {
+		close(cgroup_fd);
+		cgroup_fd = -1;
+		return FALSE;
+	}
+	report(RPT_INFO, "Collecting the stats of cgroup %s", path);
+	return TRUE;
+}
+
+
+/** Number of CPUs the cgroup may use, by its quota if it has one. */
+static double
+cgroup_cpus(void)
+{
+	char buf[64];
+	double quota, period;
+
+	if ((read_at(cgroup_fd, "cpu.max", buf, sizeof(buf)) > 0)
+	    && (sscanf(buf, "%lf %lf", &quota, &period) == 2) && (period > 0))
+		return quota / period;
+	return sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+
+/**
+ * Get the CPU counters of the cgroup, in USER_HZ as /proc/stat has them.
+ * The idle time is what the cgroup could have used but did not.
+ */
+static int
+cgroup_get_load(load_type *load)
+{
+	static unsigned long long last_time = 0, last_busy = 0;
+	static double idle_usec = 0;
+	unsigned long long user, system, nice = 0, busy, now_usec;
+	struct timespec now;
+	char buf[1024];
+
+	if ((read_at(cgroup_fd, "cpu.stat", buf, sizeof(buf)) < 0)
+	    || !cgroup_entry(buf, "user_usec", &user) || !cgroup_entry(buf, "system_usec", &system))
+		return FALSE;
+	cgroup_entry(buf, "nice_usec", &nice);
+	if (nice > user)
+		nice = user;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	now_usec = now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+	busy = user + system;
+	if (last_time != 0) {
+		double unused = (now_usec - last_time) * cgroup_cpus() - (double) (busy - last_busy);
+
+		if (unused > 0)
+			idle_usec += unused;
+	}
+	last_time = now_usec;
+	last_busy = busy;
+
+	load->user = (user - nice) / 10000;
+	load->nice = nice / 10000;
+	load->system = system / 10000;
+	load->idle = idle_usec / 10000;
+	load->total = load->user + load->nice + load->system + load->idle;
+	return TRUE;
+}
+
+
+/**
+ * Get the memory usage of the cgroup. A cgroup without a limit has the
+ * memory of the system.
+ */
+static int
+cgroup_get_meminfo(meminfo_type *result)
+{
+	char buf[8192];
+	unsigned long long current, limit, value;
+	MemInfo m;
+
+	if (!cgroup_value("memory.current", &current))
+		return FALSE;
+	if (!cgroup_value("memory.max", &limit)) {
+		meminfo_read(&m);
+		limit = (m.mem_total > 0) ? m.mem_total * 1024ULL : current;
+	}
+
+	result[0].total = limit / 1024;
+	result[0].free = (limit > current) ? (limit - current) / 1024 : 0;
+	result[0].buffers = 0;
+	result[0].shared = 0;
+	result[0].cache = 0;
+	if (read_at(cgroup_fd, "memory.stat", buf, sizeof(buf)) > 0) {
+		if (cgroup_entry(buf, "shmem", &value))
+			result[0].shared = value / 1024;
+		if (cgroup_entry(buf, "file", &value))
+			result[0].cache = value / 1024;
+	}
+
+	if (cgroup_value("memory.swap.current", &current)) {
+		if (!cgroup_value("memory.swap.max", &limit)) {
+			meminfo_read(&m);
+			limit = (m.swap_total > 0) ? m.swap_total * 1024ULL : current;
+		}
+		result[1].total = limit / 1024;
+		result[1].free = (limit > current) ? (limit - current) / 1024 : 0;
+	}
+	else {
+		result[1].total = 0;
+		result[1].free = 0;
+	}
+	return TRUE;
+}
+
+
+/**
+ * Find the mains supply and the batteries of the power supply class, and
+ * open the files of their state, to be read anew on every update.
+ * Batteries of devices like mice are left out.
+ * \return  TRUE if there is a power supply, FALSE if not.
+ */
+static int
+power_supply_open(void)
+{
+	DIR *dir = opendir(POWER_SUPPLY_DIR);
+	struct dirent *entry;
+
+	if (dir == NULL)
+		return (FALSE);
+
+	while ((entry = readdir(dir)) != NULL) {
+		char type[32], scope[32];
+		int fd;
+
+		if (entry->d_name[0] == '.')
+			continue;
+		fd = openat(dirfd(dir), entry->d_name, O_RDONLY | O_DIRECTORY);
+		if (fd < 0)
+			continue;
+
+		if (read_at(fd, "type", type, sizeof(type)) <= 0)
+			type[0] = '\0';
+		if ((read_at(fd, "scope", scope, sizeof(scope)) > 0)
+		    && (strncmp(scope, "Device", 6) == 0))
+			type[0] = '\0';
+
+		if ((strncmp(type, "Mains", 5) == 0) && (ac_online_fd < 0))
+			ac_online_fd = openat(fd, "online", O_RDONLY);
+		else if ((strncmp(type, "Battery", 7) == 0) && (batt_count < MAX_BATTERIES)) {
+			batt_capacity_fd[batt_count] = openat(fd, "capacity", O_RDONLY);
+			if (batt_capacity_fd[batt_count] >= 0) {
+				batt_status_fd[batt_count] = openat(fd, "status", O_RDONLY);
+				batt_count++;
+			}
+		}
+		close(fd);
+	}
+	closedir(dir);
+
+	return ((ac_online_fd >= 0) || (batt_count > 0));
+}
+
+
+/**
+ * Read the value of a power supply from its open file.
+ * \return  Its length, or -1 on error.
+ */
+static int
+power_supply_value(int fd, char *buf, size_t size)
+{
+	ssize_t len = pread(fd, buf, size - 1, 0);
+
+	if (len < 0)
+		return -1;
+	while ((len > 0) && (buf[len - 1] == '\n'))
+		len--;
+	buf[len] = '\0';
+	return len;
+}
+
+
+/**
+ * Get the state of AC and batteries from the power supply class. Several
+ * batteries are shown as one, with their mean capacity.
+ */
+static int
+power_supply_battstat(int *acstat, int *battflag, int *percent)
+{
+	char buf[32];
+	int i, capacity = 0, batteries = 0, charging = 0, discharging = 0;
+
+	for (i = 0; i < batt_count; i++) {
+		if (power_supply_value(batt_capacity_fd[i], buf, sizeof(buf)) <= 0)
+			continue;	/* e.g. the battery was removed */
+		capacity += atoi(buf);
+		batteries++;
+		if ((batt_status_fd[i] >= 0)
+		    && (power_supply_value(batt_status_fd[i], buf, sizeof(buf)) > 0)) {
+			if (strcmp(buf, "Charging") == 0)
+				charging = 1;
+			else if (strcmp(buf, "Discharging") == 0)
+				discharging = 1;
+		}
+	}
+
+	if ((ac_online_fd >= 0) && (power_supply_value(ac_online_fd, buf, sizeof(buf)) > 0))
+		*acstat = (buf[0] == '1') ? LCDP_AC_ON : LCDP_AC_OFF;
+	else if (batteries > 0)
+		*acstat = (discharging) ? LCDP_AC_OFF : LCDP_AC_ON;
+	else
+		*acstat = LCDP_AC_UNKNOWN;
+
+	if (batteries == 0) {
+		*battflag = LCDP_BATT_ABSENT;
+		*percent = 100;
+		return (TRUE);
+	}
+
+	*percent = capacity / batteries;
+	if (charging)
+		*battflag = LCDP_BATT_CHARGING;
+	else if (*percent <= 5)
+		*battflag = LCDP_BATT_CRITICAL;
+	else if (*percent <= 20)
+		*battflag = LCDP_BATT_LOW;
+	else
+		*battflag = LCDP_BATT_HIGH;
+
+	return (TRUE);
+}
+
+
 int
 machine_get_battstat(int *acstat, int *battflag, int *percent)
 {
 	char str[64];
 	int battstat;
 
+	if ((ac_online_fd >= 0) || (batt_count > 0))
+		return power_supply_battstat(acstat, battflag, percent);
+
 	/* no battery status available: fake one ;-) */
 	if (batt_fd < 0) {
 		*acstat = LCDP_AC_ON;
@@ -248,102 +752,371 @@ machine_get_battstat(int *acstat, int *battflag, int *percent)
 	return (TRUE);
 }
 
-int
-machine_get_fs(mounts_type fs[], int *cnt)
+/**
+ * Get the statistics of one file system.
+ * \param mpoint  Its mount point.
+ * \param result  Where to store the block and file counts.
+ * \return  0 on success, -1 on error.
+ */
+static int
+fs_stat(const char *mpoint, mounts_type *result)
 {
 #ifdef STAT_STATVFS
 	struct statvfs fsinfo;
 #else
 	struct statfs fsinfo;
 #endif
-	char line[256];
-	int x = 0, err;
+	int err;
+
+#ifdef STAT_STATVFS
+	err = statvfs(mpoint, &fsinfo);
+#elif STAT_STATFS2_BSIZE
+	err = statfs(mpoint, &fsinfo);
+#elif STAT_STATFS4
+	err = statfs(mpoint, &fsinfo, sizeof(fsinfo), 0);
+#else
+#error "statfs for this system not yet supported"
+#endif
+	if (err < 0) {
+		debug(RPT_INFO, "statvfs(%s): %s", mpoint, strerror(errno));
+		return -1;
+	}
+
+	result->blocks = fsinfo.f_blocks;
+	result->bsize = fsinfo.f_bsize;
+	result->bfree = fsinfo.f_bfree;
+	result->files = fsinfo.f_files;
+	result->ffree = fsinfo.f_ffree;
+	return 0;
+}
+
+
+/**
+ * Tell whether the mount table changed since it was read. The kernel
+ * signals a change with POLLPRI on /proc/self/mounts; without it the
+ * table is read every time.
+ */
+static int
+mounts_changed(void)
+{
+	struct pollfd pfd;
+
+	if (mounts_count < 0)
+		return TRUE;
+	if (mounts_fd < 0)
+		return TRUE;
+
+	pfd.fd = mounts_fd;
+	pfd.events = POLLPRI;
+	pfd.revents = 0;
+	return (poll(&pfd, 1, 0) > 0) && (pfd.revents & (POLLPRI | POLLERR));
+}
+
+
+/** Read the mount table, keeping the file systems to show. */
+static void
+mounts_load(void)
+{
+	FILE *mtab;
+	char line[1024];
+	int x = 0;
+
+	if (mounts_fd < 0)
+		mounts_fd = open("/proc/self/mounts", O_RDONLY);
 
 #ifdef MTAB_FILE
-	mtab_fd = fopen(MTAB_FILE, "r");
+	mtab = fopen(MTAB_FILE, "r");
 #else
 #error "Can't find your mounted filesystem table file."
 #endif
+	if (mtab == NULL) {
+		debug(RPT_INFO, "fopen(%s): %s", MTAB_FILE, strerror(errno));
+		mounts_count = 0;
+		return;
+	}
 
 	/* Get rid of old, unmounted filesystems... */
-	memset(fs, 0, sizeof(mounts_type) * 256);
-
-	while (x < 256) {
-		if (fgets(line, 256, mtab_fd) == NULL)
-			break;
+	memset(mounts, 0, sizeof(mounts));
+	memset(mounts_stat, 0, sizeof(mounts_stat));
 
-		sscanf(line, "%s %s %s", fs[x].dev, fs[x].mpoint, fs[x].type);
+	while ((x < MAX_MOUNTS) && (fgets(line, sizeof(line), mtab) != NULL)) {
+		if (sscanf(line, "%255s %255s %63s", mounts[x].dev, mounts[x].mpoint, mounts[x].type) != 3)
+			continue;
 
-		if (strcmp(fs[x].type, "proc")
-		    && strcmp(fs[x].type, "tmpfs")
+		if (strcmp(mounts[x].type, "proc")
+		    && strcmp(mounts[x].type, "tmpfs")
 #ifndef STAT_NFS
-		    && strcmp(fs[x].type, "nfs")
+		    && strcmp(mounts[x].type, "nfs")
 #endif
 #ifndef STAT_SMBFS
-		    && strcmp(fs[x].type, "smbfs")
+		    && strcmp(mounts[x].type, "smbfs")
 #endif
-			) {
-#ifdef STAT_STATVFS
-			err = statvfs(fs[x].mpoint, &fsinfo);
-#elif STAT_STATFS2_BSIZE
-			err = statfs(fs[x].mpoint, &fsinfo);
-#elif STAT_STATFS4
-			err = statfs(fs[x].mpoint, &fsinfo, sizeof(fsinfo), 0);
-#else
-#error "statfs for this system not yet supported"
-#endif
-			if (err < 0) {
-				debug(RPT_INFO, "statvfs(%s): %s", fs[x].mpoint, strerror(errno));
-				continue;
-			}
+			)
+			x++;
+	}
+	memset(&mounts[x], 0, sizeof(mounts[x]) * (MAX_MOUNTS - x));
+
+	fclose(mtab);
+	mounts_count = x;
+}
+
 
-			fs[x].blocks = fsinfo.f_blocks;
-			if (fs[x].blocks > 0) {
-				fs[x].bsize = fsinfo.f_bsize;
-				fs[x].bfree = fsinfo.f_bfree;
-				fs[x].files = fsinfo.f_files;
-				fs[x].ffree = fsinfo.f_ffree;
-				x++;
+#ifdef USE_THREADS
+/** Worker that gets the statistics of the file systems when asked to. */
+static void *
+statfs_thread(void *arg)
+{
+	pthread_mutex_lock(&statfs_mutex);
+	for (;;) {
+		unsigned int round;
+		int count, i;
+
+		while (statfs_done == statfs_asked)
+			pthread_cond_wait(&statfs_wake, &statfs_mutex);
+		round = statfs_asked;
+		count = mounts_count;
+		pthread_mutex_unlock(&statfs_mutex);
+
+		/* The table does not change during a round */
+		for (i = 0; i < count; i++) {
+			mounts_type result;
+			int err = fs_stat(mounts[i].mpoint, &result);
+
+			pthread_mutex_lock(&statfs_mutex);
+			if (err == 0) {
+				mounts[i].blocks = result.blocks;
+				mounts[i].bsize = result.bsize;
+				mounts[i].bfree = result.bfree;
+				mounts[i].files = result.files;
+				mounts[i].ffree = result.ffree;
 			}
+			mounts_stat[i] = (err == 0) ? 1 : -1;
+			pthread_mutex_unlock(&statfs_mutex);
 		}
+
+		pthread_mutex_lock(&statfs_mutex);
+		statfs_done = round;
+		pthread_cond_broadcast(&statfs_idle);
 	}
+	return NULL;
+}
+
+
+/**
+ * Have the worker get the statistics, waiting for it up to
+ * STATFS_TIMEOUT. A file system that does not answer in time keeps its
+ * last statistics; while the worker waits for it, no new round starts.
+ * Called with statfs_mutex held.
+ * \return  0 on success, -1 if there is no worker.
+ */
+static int
+statfs_round(void)
+{
+	struct timespec deadline;
+	pthread_t thread;
+
+	if (!statfs_thread_running) {
+		if (pthread_create(&thread, NULL, statfs_thread, NULL) != 0)
+			return -1;
+		pthread_detach(thread);
+		statfs_thread_running = 1;
+	}
+
+	if (statfs_done != statfs_asked)
+		return 0;	/* still busy with the last round */
+
+	if (mounts_changed())
+		mounts_load();
+	statfs_asked++;
+	pthread_cond_signal(&statfs_wake);
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_nsec += (STATFS_TIMEOUT % 1000) * 1000000L;
+	deadline.tv_sec += STATFS_TIMEOUT / 1000 + deadline.tv_nsec / 1000000000L;
+	deadline.tv_nsec %= 1000000000L;
+	while (statfs_done != statfs_asked) {
+		if (pthread_cond_timedwait(&statfs_idle, &statfs_mutex, &deadline) != 0) {
+			debug(RPT_INFO, "machine_get_fs: file system statistics are late");
+			break;
+		}
+	}
+	return 0;
+}
+#endif
+
+
+int
+machine_get_fs(mounts_type fs[], int *cnt)
+{
+	int i, x = 0;
+
+#ifdef USE_THREADS
+	pthread_mutex_lock(&statfs_mutex);
+	if (statfs_round() < 0)
+#endif
+	{
+		if (mounts_changed())
+			mounts_load();
+		for (i = 0; i < mounts_count; i++)
+			mounts_stat[i] = (fs_stat(mounts[i].mpoint, &mounts[i]) == 0) ? 1 : -1;
+	}
+
+	for (i = 0; i < mounts_count; i++) {
+		if ((mounts_stat[i] > 0) && (mounts[i].blocks > 0))
+			fs[x++] = mounts[i];
+	}
+	memset(&fs[x], 0, sizeof(mounts_type) * (MAX_MOUNTS - x));
+#ifdef USE_THREADS
+	pthread_mutex_unlock(&statfs_mutex);
+#endif
 
-	fclose(mtab_fd);
 	*cnt = x;
 	return (TRUE);
 }
 
-int
-machine_get_load(load_type * curr_load)
+/**
+ * Parse a decimal number, skipping the blanks before it.
+ * \return  The character after the number, or NULL if there is none.
+ */
+static const char *
+parse_ulong(const char *p, unsigned long *value)
 {
-	static load_type last_load = {0, 0, 0, 0, 0};
-	load_type load;
-	int ret;
-	unsigned long load_iowait, load_irq, load_softirq;
+	unsigned long v = 0;
+
+	while (*p == ' ')
+		p++;
+	if ((*p < '0') || (*p > '9'))
+		return NULL;
+	while ((*p >= '0') && (*p <= '9'))
+		v = v * 10 + (*p++ - '0');
+	*value = v;
+	return p;
+}
+
 
-	reread(load_fd, "get_load");
+/**
+ * Parse the counters of a "cpu" line of /proc/stat, after the name, into
+ * the fields of load_type as the screens use them.
+ * \return  The end of the line.
+ */
+static const char *
+parse_cpu_line(const char *p, load_type *load)
+{
+	unsigned long field[7] = {0, 0, 0, 0, 0, 0, 0};
+	const char *q;
+	int n;
+
+	for (n = 0; (n < 7) && ((q = parse_ulong(p, &field[n])) != NULL); n++)
+		p = q;
+
+	load->user = field[0];
+	load->nice = field[1];
+	/* system + irq + softirq, idle + iowait */
+	load->system = field[2] + field[5] + field[6];
+	load->idle = field[3] + field[4];
+	load->total = load->user + load->nice + load->system + load->idle;
+
+	return p + strcspn(p, "\n");
+}
+
+
+/** The counters of /proc/stat, parsed once for all screens of an update */
+typedef struct {
+	unsigned int generation;	/**< Count of snapshots taken */
+	struct timespec taken;
+	int have_cpus;			/**< cpu[] was read */
+	int ncpu;			/**< Number of CPUs in cpu[] */
+	load_type all;			/**< The line of all CPUs */
+	load_type cpu[MAX_CPUS];
+} StatSnapshot;
+
+/* A pass over the screens takes less; the next one is a time unit later */
+#define STAT_SNAPSHOT_AGE	50000000L	/* ns */
+
+/**
+ * Get the CPU counters, read anew if the last snapshot was not taken
+ * during the current pass over the screens. With the cgroup collector,
+ * the counters of all CPUs are those of the cgroup, and /proc/stat is
+ * only read for the counters of each CPU.
+ * \param per_cpu  The counters of each CPU are needed.
+ */
+static const StatSnapshot *
+stat_snapshot(int per_cpu)
+{
+	static StatSnapshot snap;
+	static char *buffer = NULL;	/* contents of /proc/stat */
+	static size_t size = 0;
+	struct timespec now;
+	const char *p;
+	int fresh, have_all, ncpu = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	fresh = (snap.generation > 0)
+		&& ((now.tv_sec - snap.taken.tv_sec) * 1000000000L
+		    + (now.tv_nsec - snap.taken.tv_nsec) < STAT_SNAPSHOT_AGE);
+	if (fresh && (!per_cpu || snap.have_cpus))
+		return &snap;
+
+	have_all = fresh;
+	if (!fresh) {
+		snap.have_cpus = 0;
+		snap.taken = now;
+		snap.generation++;
+		have_all = (cgroup_fd >= 0) && cgroup_get_load(&snap.all);
+		if (have_all && !per_cpu)
+			return &snap;
+	}
 
-	ret = sscanf(procbuf, "cpu %lu %lu %lu %lu %lu %lu %lu",
-		     &load.user, &load.nice, &load.system, &load.idle,
-		     &load_iowait, &load_irq, &load_softirq);
+	if (read_all(load_fd, &buffer, &size) < 0) {
+		perror("get_load");
+		exit(1);
+	}
 
-	if (ret >= 5)
-		load.idle += load_iowait;
-	if (ret >= 6)
-		load.system += load_irq;
-	if (ret >= 7)
-		load.system += load_softirq;
+	/* The cpu lines come first: "cpu", then "cpu0", "cpu1", ... */
+	p = buffer;
+	while (strncmp(p, "cpu", 3) == 0) {
+		if ((p[3] == ' ') && !have_all)
+			p = parse_cpu_line(p + 3, &snap.all);
+		else if (isdigit((unsigned char) p[3]) && (ncpu < MAX_CPUS)) {
+			p += 3 + strspn(p + 3, "0123456789");
+			p = parse_cpu_line(p, &snap.cpu[ncpu++]);
+		}
+		else
+			p += strcspn(p, "\n");
+		if (*p == '\n')
+			p++;
+	}
 
-	load.total = load.user + load.nice + load.system + load.idle;
+	snap.ncpu = ncpu;
+	snap.have_cpus = 1;
+	return &snap;
+}
 
-	curr_load->user = load.user - last_load.user;
-	curr_load->nice = load.nice - last_load.nice;
-	curr_load->system = load.system - last_load.system;
-	curr_load->idle = load.idle - last_load.idle;
-	curr_load->total = load.total - last_load.total;
+
+int
+machine_get_load(load_type * curr_load)
+{
+	static load_type last_load = {0, 0, 0, 0, 0};
+	static load_type last_result = {0, 0, 0, 0, 0};
+	static unsigned int last_generation = 0;
+	const StatSnapshot *snap = stat_snapshot(0);
+
+	/* Several screens in one pass get the same load */
+	if (snap->generation == last_generation) {
+		*curr_load = last_result;
+		return (TRUE);
+	}
+
+	curr_load->user = snap->all.user - last_load.user;
+	curr_load->nice = snap->all.nice - last_load.nice;
+	curr_load->system = snap->all.system - last_load.system;
+	curr_load->idle = snap->all.idle - last_load.idle;
+	curr_load->total = snap->all.total - last_load.total;
 
 	/* struct assignment is legal in C89 */
-	last_load = load;
+	last_load = snap->all;
+	last_result = *curr_load;
+	last_generation = snap->generation;
 
 	return (TRUE);
 }
@@ -369,127 +1142,185 @@ machine_get_loadavg(double *load)
 int
 machine_get_meminfo(meminfo_type * result)
 {
-	long tmp;
+	MemInfo m;
+
+	if ((cgroup_fd >= 0) && cgroup_get_meminfo(result))
+		return (TRUE);
 
-	reread(meminfo_fd, "get_meminfo");
-	result[0].total = (getentry("MemTotal:", procbuf, &tmp) == TRUE) ? tmp : 0L;
-	result[0].free = (getentry("MemFree:", procbuf, &tmp) == TRUE) ? tmp : 0L;
-	result[0].shared = (getentry("MemShared:", procbuf, &tmp) == TRUE) ? tmp : 0L;
-	result[0].buffers = (getentry("Buffers:", procbuf, &tmp) == TRUE) ? tmp : 0L;
-	result[0].cache = (getentry("Cached:", procbuf, &tmp) == TRUE) ? tmp : 0L;
-	result[1].total = (getentry("SwapTotal:", procbuf, &tmp) == TRUE) ? tmp : 0L;
-	result[1].free = (getentry("SwapFree:", procbuf, &tmp) == TRUE) ? tmp : 0L;
+	meminfo_read(&m);
+	result[0].total = m.mem_total;
+	result[0].free = m.mem_free;
+	result[0].shared = m.mem_shared;
+	result[0].buffers = m.buffers;
+	result[0].cache = m.cached;
+	result[1].total = m.swap_total;
+	result[1].free = m.swap_free;
 
 	return (TRUE);
 }
 
+/**
+ * Account for the memory of one process in the list of processes.
+ * \param names    Entries of the list by process name.
+ * \param procs    List of procinfo_type.
+ * \param proc_fd  Directory /proc.
+ * \param pid      Id of the process, as a string.
+ * \return  0, or -1 if memory ran out.
+ */
+static int
+proc_add(HashTable *names, LinkedList *procs, int proc_fd, const char *pid)
+{
+	static long page_kb = 0;
+	char path[300];
+	char buf[128];
+	char procName[16];
+	long procSize, procText, procData;
+	int threshold = 400;
+	procinfo_type *p;
+	int len;
+
+	if (page_kb == 0)
+		page_kb = sysconf(_SC_PAGESIZE) / 1024;
+
+	/*
+	 * statm has the sizes in pages: total, resident, shared, text,
+	 * library, data + stack. A process that has finished before we
+	 * could examine it is not a serious error.
+	 */
+	snprintf(path, sizeof(path), "%s/statm", pid);
+	if ((read_at(proc_fd, path, buf, sizeof(buf)) < 0)
+	    || (sscanf(buf, "%ld %*d %*d %ld %*d %ld", &procSize, &procText, &procData) != 3))
+		return 0;
+	if (procSize * page_kb <= threshold)
+		return 0;
+
+	snprintf(path, sizeof(path), "%s/comm", pid);
+	len = read_at(proc_fd, path, procName, sizeof(procName));
+	if (len < 0)
+		return 0;
+	if ((len > 0) && (procName[len - 1] == '\n'))
+		procName[len - 1] = '\0';
+
+	p = HT_Find(names, procName);
+	if (p != NULL) {
+		p->number++;
+		p->totl += (procText + procData) * page_kb;
+		return 0;
+	}
+
+	/* If this is the first one by this name... */
+	p = malloc(sizeof(procinfo_type));
+	if (p == NULL) {
+		perror("mem_top_screen: Error allocating process entry");
+		return -1;
+	}
+	strcpy(p->name, procName);
+	p->totl = (procText + procData) * page_kb;
+	p->number = 1;
+	/* TODO:  Check for errors here? */
+	LL_Push(procs, (void *)p);
+	HT_Insert(names, p->name, p);
+	return 0;
+}
+
+
+/**
+ * Account for the processes of a cgroup and of the cgroups below it.
+ * \param dir_fd   Directory of the cgroup.
+ * \param depth    Levels of cgroups above it.
+ * \return  0, or -1 if memory ran out.
+ */
+static int
+cgroup_procs(HashTable *names, LinkedList *procs, int proc_fd, int dir_fd, int depth)
+{
+	static char *buffer = NULL;	/* contents of cgroup.procs */
+	static size_t size = 0;
+	struct dirent *entry;
+	DIR *dir;
+	char *pid, *next;
+	int fd;
+
+	fd = openat(dir_fd, "cgroup.procs", O_RDONLY);
+	if (fd >= 0) {
+		ssize_t len = read_all(fd, &buffer, &size);
+
+		close(fd);
+		for (pid = buffer; (len > 0) && (*pid != '\0'); pid = next) {
+			next = pid + strcspn(pid, "\n");
+			if (*next != '\0')
+				*next++ = '\0';
+			if ((*pid != '\0') && (proc_add(names, procs, proc_fd, pid) < 0))
+				return -1;
+		}
+	}
+
+	/* The cgroups below it */
+	if (depth >= 16)
+		return 0;
+	fd = openat(dir_fd, ".", O_RDONLY | O_DIRECTORY);
+	if ((fd < 0) || ((dir = fdopendir(fd)) == NULL)) {
+		if (fd >= 0)
+			close(fd);
+		return 0;
+	}
+	while ((entry = readdir(dir)) != NULL) {
+		int sub_fd;
+
+		if ((entry->d_type != DT_DIR) || (entry->d_name[0] == '.'))
+			continue;
+		sub_fd = openat(dirfd(dir), entry->d_name, O_RDONLY | O_DIRECTORY);
+		if (sub_fd < 0)
+			continue;
+		if (cgroup_procs(names, procs, proc_fd, sub_fd, depth + 1) < 0) {
+			close(sub_fd);
+			closedir(dir);
+			return -1;
+		}
+		close(sub_fd);
+	}
+	closedir(dir);
+	return 0;
+}
+
+
 int
 machine_get_procs(LinkedList * procs)
 {
 	/* Much of this code was ripped from "gmemusage" */
-	DIR *proc;
-	FILE *StatusFile;
+	static DIR *proc = NULL;	/* kept open between the updates */
 	struct dirent *procdir;
+	HashTable *names;
+	int proc_fd;
 
-	char procName[16];
-	int procSize, procRSS, procData, procStk, procExe;
-	const char
-			*NameLine = "Name:",
-			*VmSizeLine = "VmSize:",
-			*VmRSSLine = "VmRSS",
-			*VmDataLine = "VmData",
-			*VmStkLine = "VmStk",
-			*VmExeLine = "VmExe";
-	const int
-			NameLineLen = strlen(NameLine),
-			VmSizeLineLen = strlen(VmSizeLine),
-			VmDataLineLen = strlen(VmDataLine),
-			VmStkLineLen = strlen(VmStkLine),
-			VmExeLineLen = strlen(VmExeLine),
-			VmRSSLineLen = strlen(VmRSSLine);
-	int threshold = 400, unique;
-
-	if ((proc = opendir("/proc")) == NULL) {
+	if ((proc == NULL) && ((proc = opendir("/proc")) == NULL)) {
 		/* ToDo: correct error reporting */
 		perror("mem_top_screen: unable to open /proc");
 		return (FALSE);
 	}
+	proc_fd = dirfd(proc);
 
-	while ((procdir = readdir(proc))) {
-		char buf[128];
-
-		/* ignore everything in proc except process ids */
-		if (!strchr("1234567890", procdir->d_name[0]))
-			continue;
-
-		sprintf(buf, "/proc/%s/status", procdir->d_name);
-		if ((StatusFile = fopen(buf, "r")) == NULL) {
-			/*
-			 * Not a serious error; process has finished before
-			 * we could examine it:
-			 */
-			continue;
-		}
+	/* Processes sharing a name are counted together */
+	names = HT_new();
+	if (names == NULL) {
+		perror("mem_top_screen: Error allocating process table");
+		return (FALSE);
+	}
 
-		procRSS = procSize = procData = procStk = procExe = 0;
-		while (fgets(buf, sizeof(buf), StatusFile)) {
-			if (!strncmp(buf, NameLine, NameLineLen)) {
-				/* Name: procName */
-				sscanf(buf, "%*s %s", procName);
-			}
-			else if (!strncmp(buf, VmSizeLine, VmSizeLineLen)) {
-				/* VmSize: procSize kB */
-				sscanf(buf, "%*s %d", &procSize);
-			}
-			else if (!strncmp(buf, VmRSSLine, VmRSSLineLen)) {
-				/* VmRSS: procRSS kB */
-				sscanf(buf, "%*s %d", &procRSS);
-			}
-			else if (!strncmp(buf, VmDataLine, VmDataLineLen)) {
-				/* VmData: procData kB */
-				sscanf(buf, "%*s %d", &procData);
-			}
-			else if (!strncmp(buf, VmStkLine, VmStkLineLen)) {
-				/* VmStk: procStk kB */
-				sscanf(buf, "%*s %d", &procStk);
-			}
-			else if (!strncmp(buf, VmExeLine, VmExeLineLen)) {
-				/* VmExe: procExe kB */
-				sscanf(buf, "%*s %d", &procExe);
-			}
-		}
-		fclose(StatusFile);
-
-		if (procSize > threshold) {
-			/* Figure out if it's sharing any memory... */
-			unique = 1;
-			LL_Rewind(procs);
-			do {
-				procinfo_type *p = LL_Get(procs);
-
-				if ((p != NULL) && (0 == strcmp(p->name, procName))) {
-					unique = 0;
-					p->number++;
-					p->totl += procData + procStk + procExe;
-				}
-			} while (LL_Next(procs) == 0);
-
-			/* If this is the first one by this name... */
-			if (unique) {
-				procinfo_type *p = malloc(sizeof(procinfo_type));
-				if (p == NULL) {
-					perror("mem_top_screen: Error allocating process entry");
-					break;
-				}
-				strcpy(p->name, procName);
-				p->totl = procData + procStk + procExe;
-				p->number = 1;
-				/* TODO:  Check for errors here? */
-				LL_Push(procs, (void *)p);
-			}
+	if (cgroup_fd >= 0) {
+		/* The processes of the cgroup, without a walk over /proc */
+		cgroup_procs(names, procs, proc_fd, cgroup_fd, 0);
+	}
+	else {
+		rewinddir(proc);
+		while ((procdir = readdir(proc))) {
+			/* ignore everything in proc except process ids */
+			if (!strchr("1234567890", procdir->d_name[0]))
+				continue;
+			if (proc_add(names, procs, proc_fd, procdir->d_name) < 0)
+				break;
 		}
 	}
-	closedir(proc);
+	HT_Destroy(names);
 
 	return (TRUE);
 }
@@ -497,49 +1328,35 @@ machine_get_procs(LinkedList * procs)
 int
 machine_get_smpload(load_type * result, int *numcpus)
 {
-	char *token;
 	static load_type last_load[MAX_CPUS];
-	load_type curr_load[MAX_CPUS];
-	int ncpu = 0;
-	int ret;
-	unsigned long load_iowait, load_irq, load_softirq;
-
-	reread(load_fd, "get_load");
-
-	/* Look for lines starting with "cpu0", "cpu1", etc. */
-	token = strtok(procbuf, "\n");
-	while (token != NULL) {
-		if ((strlen(token) > 3) && (!strncmp(token, "cpu", 3)) && isdigit(token[3])) {
-			ret = sscanf(token, "cpu%*d %lu %lu %lu %lu %lu %lu %lu",
-				     &curr_load[ncpu].user, &curr_load[ncpu].nice, &curr_load[ncpu].system,
-				     &curr_load[ncpu].idle, &load_iowait, &load_irq, &load_softirq);
-
-			if (ret >= 5)
-				curr_load[ncpu].idle += load_iowait;
-			if (ret >= 6)
-				curr_load[ncpu].system += load_irq;
-			if (ret >= 7)
-				curr_load[ncpu].system += load_softirq;
-
-			curr_load[ncpu].total = curr_load[ncpu].user + curr_load[ncpu].nice +
-				curr_load[ncpu].system + curr_load[ncpu].idle;
-
-			result[ncpu].total = curr_load[ncpu].total - last_load[ncpu].total;
-			result[ncpu].user = curr_load[ncpu].user - last_load[ncpu].user;
-			result[ncpu].nice = curr_load[ncpu].nice - last_load[ncpu].nice;
-			result[ncpu].system = curr_load[ncpu].system - last_load[ncpu].system;
-			result[ncpu].idle = curr_load[ncpu].idle - last_load[ncpu].idle;
-
-			/* struct assignment is legal in C89 */
-			last_load[ncpu] = curr_load[ncpu];
-
-			/* restrict # CPUs to min(*numcpus, MAX_CPUS) */
-			ncpu++;
-			if ((ncpu >= *numcpus) || (ncpu >= MAX_CPUS))
-				break;
-		}
-		token = strtok(NULL, "\n");
+	static load_type last_result[MAX_CPUS];
+	static unsigned int last_generation = 0;
+	static int last_ncpu = 0;
+	const StatSnapshot *snap = stat_snapshot(1);
+	int ncpu, i;
+
+	/* restrict # CPUs to min(*numcpus, MAX_CPUS) */
+	if (snap->generation == last_generation) {
+		ncpu = (last_ncpu < *numcpus) ? last_ncpu : *numcpus;
+		memcpy(result, last_result, ncpu * sizeof(load_type));
+		*numcpus = ncpu;
+		return (TRUE);
 	}
+
+	ncpu = (snap->ncpu < *numcpus) ? snap->ncpu : *numcpus;
+	for (i = 0; i < ncpu; i++) {
+		result[i].total = snap->cpu[i].total - last_load[i].total;
+		result[i].user = snap->cpu[i].user - last_load[i].user;
+		result[i].nice = snap->cpu[i].nice - last_load[i].nice;
+		result[i].system = snap->cpu[i].system - last_load[i].system;
+		result[i].idle = snap->cpu[i].idle - last_load[i].idle;
+
+		/* struct assignment is legal in C89 */
+		last_load[i] = snap->cpu[i];
+		last_result[i] = result[i];
+	}
+	last_ncpu = ncpu;
+	last_generation = snap->generation;
 	*numcpus = ncpu;
 
 	return (TRUE);
@@ -566,68 +1383,194 @@ machine_get_uptime(double *up, double *idle)
 int
 machine_get_iface_stats(IfaceInfo * interface)
 {
-	FILE *file;		/* file handler */
-	char buffer[1024];	/* buffer to work with the file */
-	static int first_time = 1;	/* is it first time we call this
-					 * function? */
-	char *ch_pointer = NULL;/* pointer to where interface values are in
-				 * file */
-
-	/* Open the file in read-only mode and parse */
-	if ((file = fopen("/proc/net/dev", "r")) != NULL) {
-		/* Skip first 2 header lines of file */
-		fgets(buffer, sizeof(buffer), file);
-		fgets(buffer, sizeof(buffer), file);
-
-		/* By default, treat interface as down */
-		interface->status = down;
-
-		/* Search iface_name and scan values */
-		while ((fgets(buffer, sizeof(buffer), file) != NULL)) {
-			if (strstr(buffer, interface->name)) {
-				/* interface exists */
-				interface->status = up;	/* is up */
-				interface->last_online = time(NULL);	/* save actual time */
-
-				/* search ':' and skip over it */
-				ch_pointer = strchr(buffer, ':');
-				ch_pointer++;
-
-				/*
-				 * Now ch_pointer points to values of
-				 * iface_name
-				 */
-				/* Scan values from here */
-				sscanf(ch_pointer, "%lf %lf %*s %*s %*s %*s %*s %*s %lf %lf",
-				       &interface->rc_byte,
-				       &interface->rc_pkt,
-				       &interface->tr_byte,
-				       &interface->tr_pkt);
-
-				/*
-				 * if is the first time we call this
-				 * function, old values are the same as new
-				 * so we don't get big speeds when
-				 * calculating
-				 */
-				if (first_time) {
-					interface->rc_byte_old = interface->rc_byte;
-					interface->tr_byte_old = interface->tr_byte;
-					interface->rc_pkt_old = interface->rc_pkt;
-					interface->tr_pkt_old = interface->tr_pkt;
-					first_time = 0;	/* now it isn't first
-							 * time */
+	return machine_get_iface_stats_all(interface, 1);
+}
+
+
+/**
+ * Store the counters of an interface found in the system's statistics,
+ * if it is one of the interfaces asked for.
+ */
+static void
+iface_stats_found(IfaceInfo * interfaces, int count, const char *name, size_t name_len,
+		  double rc_byte, double rc_pkt, double tr_byte, double tr_pkt)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		IfaceInfo *interface = &interfaces[i];
+
+		if ((strncmp(interface->name, name, name_len) != 0)
+		    || (interface->name[name_len] != '\0'))
+			continue;
+
+		interface->rc_byte = rc_byte;
+		interface->rc_pkt = rc_pkt;
+		interface->tr_byte = tr_byte;
+		interface->tr_pkt = tr_pkt;
+
+		/*
+		 * if it was never seen before, old values are the same as
+		 * new so we don't get big speeds when calculating
+		 */
+		if (interface->last_online == 0) {
+			interface->rc_byte_old = interface->rc_byte;
+			interface->tr_byte_old = interface->tr_byte;
+			interface->rc_pkt_old = interface->rc_pkt;
+			interface->tr_pkt_old = interface->tr_pkt;
+		}
+		interface->status = up;
+		interface->last_online = time(NULL);
+	}
+}
+
+
+#ifdef HAVE_LINUX_RTNETLINK_H
+/**
+ * Get the counters of all interfaces with one RTM_GETLINK dump request.
+ * \retval TRUE   The interfaces are filled.
+ * \retval FALSE  Netlink is not usable.
+ */
+static int
+iface_stats_netlink(IfaceInfo * interfaces, int count)
+{
+	static char buffer[32768] __attribute__ ((aligned(NLMSG_ALIGNTO)));
+	static unsigned int seq = 0;
+	struct {
+		struct nlmsghdr nlh;
+		struct ifinfomsg ifi;
+	} req;
+	ssize_t len;
+
+	if (netlink_fd < 0) {
+		netlink_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+		if (netlink_fd < 0)
+			return (FALSE);
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(req.ifi));
+	req.nlh.nlmsg_type = RTM_GETLINK;
+	req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.nlh.nlmsg_seq = ++seq;
+	req.ifi.ifi_family = AF_UNSPEC;
+	if (send(netlink_fd, &req, req.nlh.nlmsg_len, 0) < 0)
+		return (FALSE);
+
+	/* The answer comes in several datagrams, up to NLMSG_DONE */
+	while ((len = recv(netlink_fd, buffer, sizeof(buffer), 0)) > 0) {
+		struct nlmsghdr *nlh;
+
+		for (nlh = (struct nlmsghdr *) buffer; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+			struct ifinfomsg *ifi = NLMSG_DATA(nlh);
+			struct rtattr *rta;
+			int rta_len;
+			const char *name = NULL;
+			size_t name_len = 0;
+			struct rtnl_link_stats64 stats64;
+			int have_stats = 0;
+
+			if (nlh->nlmsg_seq != seq)
+				continue;	/* answer to an earlier request */
+			if (nlh->nlmsg_type == NLMSG_DONE)
+				return (TRUE);
+			if (nlh->nlmsg_type == NLMSG_ERROR)
+				return (FALSE);
+			if (nlh->nlmsg_type != RTM_NEWLINK)
+				continue;
+
+			rta_len = IFLA_PAYLOAD(nlh);
+			for (rta = IFLA_RTA(ifi); RTA_OK(rta, rta_len); rta = RTA_NEXT(rta, rta_len)) {
+				if (rta->rta_type == IFLA_IFNAME) {
+					name = RTA_DATA(rta);
+					name_len = strnlen(name, RTA_PAYLOAD(rta));
+				}
+				else if ((rta->rta_type == IFLA_STATS64)
+					 && (RTA_PAYLOAD(rta) >= sizeof(stats64))) {
+					memcpy(&stats64, RTA_DATA(rta), sizeof(stats64));
+					have_stats = 1;
 				}
 			}
+			if ((name != NULL) && have_stats)
+				iface_stats_found(interfaces, count, name, name_len,
+						  stats64.rx_bytes, stats64.rx_packets,
+						  stats64.tx_bytes, stats64.tx_packets);
 		}
+	}
+	return (FALSE);
+}
+#endif
 
-		fclose(file);
-		return (TRUE);
+
+/**
+ * Get the counters of all interfaces from /proc/net/dev, read at once.
+ */
+static int
+iface_stats_proc(IfaceInfo * interfaces, int count)
+{
+	static char *buffer = NULL;	/* contents of /proc/net/dev */
+	static size_t size = 0;
+	char *line, *name, *colon;
+
+	if (netdev_fd < 0) {
+		netdev_fd = open("/proc/net/dev", O_RDONLY);
+		if (netdev_fd < 0) {
+			perror("Error: Could not open /proc/net/dev");
+			return (FALSE);
+		}
 	}
-	else {			/* error when opening the file */
-		perror("Error: Could not open DEVFILE");
+
+	/* Read the whole file; there is a line per interface */
+	if (read_all(netdev_fd, &buffer, &size) < 0) {
+		perror("Error: Could not read /proc/net/dev");
 		return (FALSE);
 	}
+
+	/* Skip the 2 header lines, then match each line's interface name */
+	line = strchr(buffer, '\n');
+	if (line != NULL)
+		line = strchr(line + 1, '\n');
+	while (line != NULL) {
+		double rc_byte, rc_pkt, tr_byte, tr_pkt;
+
+		line++;
+		name = line + strspn(line, " ");
+		line = strchr(line, '\n');
+		colon = strchr(name, ':');
+		if ((colon == NULL) || ((line != NULL) && (colon > line)))
+			continue;
+
+		if (sscanf(colon + 1, "%lf %lf %*s %*s %*s %*s %*s %*s %lf %lf",
+			   &rc_byte, &rc_pkt, &tr_byte, &tr_pkt) == 4)
+			iface_stats_found(interfaces, count, name, colon - name,
+					  rc_byte, rc_pkt, tr_byte, tr_pkt);
+	}
+
+	return (TRUE);
+}
+
+
+int
+machine_get_iface_stats_all(IfaceInfo * interfaces, int count)
+{
+	int i;
+
+	/* By default, treat interfaces as down */
+	for (i = 0; i < count; i++)
+		interfaces[i].status = down;
+
+#ifdef HAVE_LINUX_RTNETLINK_H
+	/* Binary 64-bit counters in one request; else parse /proc */
+	if (!netlink_failed) {
+		if (iface_stats_netlink(interfaces, count))
+			return (TRUE);
+		report(RPT_INFO, "Netlink interface statistics unavailable, reading /proc/net/dev");
+		netlink_failed = 1;
+		for (i = 0; i < count; i++)
+			interfaces[i].status = down;
+	}
+#endif
+	return iface_stats_proc(interfaces, count);
 }
 
 #endif				/* linux */
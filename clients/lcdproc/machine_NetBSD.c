@@ -56,6 +56,7 @@
 #include <uvm/uvm_extern.h>
 #include <machine/apmvar.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/socket.h>
 #include <net/if.h>
 #include <ifaddrs.h>
@@ -70,6 +71,7 @@
 #include "shared/LL.h"
 
 static int pageshift;
+static int ncpu = 1;
 #define pagetok(size) ((size) << pageshift)
 #define PROCSIZE(pp) ((pp)->p_vm_tsize + (pp)->p_vm_dsize + (pp)->p_vm_ssize)
 
@@ -82,6 +84,9 @@ machine_init(void)
 	 * it
 	 */
 	int pagesize = getpagesize();
+	int mib[2];
+	size_t size;
+
 	pageshift = 0;
 	while (pagesize > 1) {
 		pageshift++;
@@ -91,6 +96,15 @@ machine_init(void)
 	/* we only need the amount of log(2)1024 for our conversion */
 	pageshift -= 10;
 
+	/* the number of CPUs does not change while we run */
+	mib[0] = CTL_HW;
+	mib[1] = HW_NCPU;
+	size = sizeof(ncpu);
+	if ((sysctl(mib, 2, &ncpu, &size, NULL, 0) < 0) || (ncpu < 1)) {
+		perror("sysctl hw.ncpu");
+		ncpu = 1;
+	}
+
 	return (TRUE);
 }
 
@@ -189,29 +203,58 @@ machine_get_fs(mounts_type fs[], int *cnt)
 	return (TRUE);
 }
 
-int
-machine_get_load(load_type * curr_load)
+/* A pass over the screens takes less; the next one is a time unit later */
+#define SNAPSHOT_AGE	50000000L	/* ns */
+
+/**
+ * Get the CPU counters, read anew only if the last snapshot was not taken
+ * during the current pass over the screens.
+ */
+static int
+cp_time_snapshot(load_type *load)
 {
-	static load_type last_load = {0, 0, 0, 0, 0};
-	static load_type last_ret_load;
-	load_type load;
+	static load_type snap;
+	static struct timespec taken;
+	static int valid = 0;
+	static const int mib[2] = { CTL_KERN, KERN_CP_TIME };
+	struct timespec now;
 	u_int64_t cp_time[CPUSTATES];
 	size_t size;
-	int mib[2];
 
-	mib[0] = CTL_KERN;
-	mib[1] = KERN_CP_TIME;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (valid && ((now.tv_sec - taken.tv_sec) * 1000000000L
+		      + (now.tv_nsec - taken.tv_nsec) < SNAPSHOT_AGE)) {
+		*load = snap;
+		return (TRUE);
+	}
+
 	size = sizeof(cp_time);
 	if (sysctl(mib, 2, cp_time, &size, NULL, 0) < 0) {
 		perror("sysctl kern.cp_time failed");
 		return (FALSE);
 	}
 
-	load.user = (unsigned long)(cp_time[CP_USER]);
-	load.nice = (unsigned long)(cp_time[CP_NICE]);
-	load.system = (unsigned long)(cp_time[CP_SYS] + cp_time[CP_INTR]);
-	load.idle = (unsigned long)(cp_time[CP_IDLE]);
-	load.total = load.user + load.nice + load.system + load.idle;
+	snap.user = (unsigned long)(cp_time[CP_USER]);
+	snap.nice = (unsigned long)(cp_time[CP_NICE]);
+	snap.system = (unsigned long)(cp_time[CP_SYS] + cp_time[CP_INTR]);
+	snap.idle = (unsigned long)(cp_time[CP_IDLE]);
+	snap.total = snap.user + snap.nice + snap.system + snap.idle;
+	taken = now;
+	valid = 1;
+	*load = snap;
+	return (TRUE);
+}
+
+int
+machine_get_load(load_type * curr_load)
+{
+	static load_type last_load = {0, 0, 0, 0, 0};
+	static load_type last_ret_load;
+	load_type load;
+
+	/* Several screens in one pass share a snapshot, and get the same load */
+	if (cp_time_snapshot(&load) == FALSE)
+		return (FALSE);
 
 	if (load.total != last_load.total) {
 		curr_load->user = load.user - last_load.user;
@@ -318,19 +361,9 @@ machine_get_procs(LinkedList * procs)
 int
 machine_get_smpload(load_type * result, int *numcpus)
 {
-	int mib[2], i, num;
-	size_t size;
+	int i, num;
 	load_type curr_load;
 
-	mib[0] = CTL_HW;
-	mib[1] = HW_NCPU;
-	size = sizeof(int);
-
-	if (sysctl(mib, 2, &num, &size, NULL, 0) < 0) {
-		perror("sysctl hw.ncpu");
-		return (FALSE);
-	}
-
 	if (machine_get_load(&curr_load) == FALSE)
 		return (FALSE);
 
@@ -338,7 +371,7 @@ machine_get_smpload(load_type * result, int *numcpus)
 		return (FALSE);
 
 	/* restrict #CPUs to max. *numcpus */
-	num = (*numcpus >= num) ? num : *numcpus;
+	num = (*numcpus >= ncpu) ? ncpu : *numcpus;
 	*numcpus = num;
 
 	/* Don't know how to get per-cpu-load values */
@@ -377,50 +410,75 @@ machine_get_uptime(double *up, double *idle)
 	return (TRUE);
 }
 
-/* Get network statistics */
-int
-machine_get_iface_stats(IfaceInfo * interface)
+/**
+ * Store the counters of a link level address of an interface, if it is
+ * one of those asked for.
+ */
+static void
+iface_stats_found(IfaceInfo * interfaces, int count, const struct ifaddrs *ifa)
 {
-	struct ifaddrs *ifa, *ifa_ptr;
-	struct if_data *ifd;
+	const struct if_data *ifd = (const struct if_data *)ifa->ifa_data;
+	int i;
 
-	/* get first interface */
-	if (getifaddrs(&ifa) == -1)
-		perror("getifaddr failed");
+	for (i = 0; i < count; i++) {
+		IfaceInfo *interface = &interfaces[i];
 
-	/* loop through all interfaces */
-	for (ifa_ptr = ifa; ifa_ptr != NULL; ifa_ptr = ifa_ptr->ifa_next) {
-		interface->status = down;	/* set status down by default */
+		if (strcmp(ifa->ifa_name, interface->name) != 0)
+			continue;
 
-		/* check if we got the right interface and if it is Link type */
-		if ((strcmp(ifa_ptr->ifa_name, interface->name) == 0) &&
-		    (ifa_ptr->ifa_addr->sa_family == AF_LINK)) {
+		interface->rc_byte = ifd->ifi_ibytes;
+		interface->tr_byte = ifd->ifi_obytes;
+		interface->rc_pkt = ifd->ifi_ipackets;
+		interface->tr_pkt = ifd->ifi_opackets;
 
-			ifd = (struct if_data *)ifa_ptr->ifa_data;
+		if (interface->last_online == 0) {
+			interface->rc_byte_old = interface->rc_byte;
+			interface->tr_byte_old = interface->tr_byte;
+			interface->rc_pkt_old = interface->rc_pkt;
+			interface->tr_pkt_old = interface->tr_pkt;
+		}
 
-			interface->rc_byte = ifd->ifi_ibytes;
-			interface->tr_byte = ifd->ifi_obytes;
-			interface->rc_pkt = ifd->ifi_ipackets;
-			interface->tr_pkt = ifd->ifi_opackets;
+		if ((ifa->ifa_flags & IFF_UP) == IFF_UP) {
+			interface->status = up;	/* is up */
+			interface->last_online = time(NULL);	/* save actual time */
+		}
+	}
+}
 
-			if (interface->last_online == 0) {
-				interface->rc_byte_old = interface->rc_byte;
-				interface->tr_byte_old = interface->tr_byte;
-				interface->rc_pkt_old = interface->rc_pkt;
-				interface->tr_pkt_old = interface->tr_pkt;
-			}
 
-			if ((ifa_ptr->ifa_flags & IFF_UP) == IFF_UP) {
-				interface->status = up;	/* is up */
-				interface->last_online = time(NULL);	/* save actual time */
-			}
+/* Get network statistics */
+int
+machine_get_iface_stats(IfaceInfo * interface)
+{
+	return machine_get_iface_stats_all(interface, 1);
+}
 
-			return (TRUE);
-		}
+
+int
+machine_get_iface_stats_all(IfaceInfo * interfaces, int count)
+{
+	struct ifaddrs *ifa, *ifa_ptr;
+	int i;
+
+	/* set status down by default */
+	for (i = 0; i < count; i++)
+		interfaces[i].status = down;
+
+	/* one list of all interfaces for all those asked for */
+	if (getifaddrs(&ifa) == -1) {
+		perror("getifaddr failed");
+		return (FALSE);
+	}
+
+	/* loop through the link level addresses; they carry the counters */
+	for (ifa_ptr = ifa; ifa_ptr != NULL; ifa_ptr = ifa_ptr->ifa_next) {
+		if ((ifa_ptr->ifa_addr != NULL) && (ifa_ptr->ifa_addr->sa_family == AF_LINK)
+		    && (ifa_ptr->ifa_data != NULL))
+			iface_stats_found(interfaces, count, ifa_ptr);
 	}
 	freeifaddrs(ifa);
 
-	/* if we are here there is no interface with the given name */
+	/* interfaces not found keep being down */
 	return (TRUE);
 }
 
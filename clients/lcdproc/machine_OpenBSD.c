@@ -53,6 +53,7 @@
 #include <machine/apmvar.h>
 #include <kvm.h>
 #include <errno.h>
+#include <time.h>
 
 #include "main.h"
 #include "machine.h"
@@ -60,6 +61,7 @@
 #include "shared/LL.h"
 
 static int pageshift;
+static int ncpu = 1;
 #define pagetok(size) ((size) << pageshift)
 #if OpenBSD >= 201111
 #define PROCSIZE(pp) ((pp)->p_vm_tsize + (pp)->p_vm_dsize + (pp)->p_vm_ssize)
@@ -76,6 +78,9 @@ machine_init(void)
 	 * it
 	 */
 	int pagesize = getpagesize();
+	int mib[2];
+	size_t size;
+
 	pageshift = 0;
 	while (pagesize > 1) {
 		pageshift++;
@@ -85,6 +90,15 @@ machine_init(void)
 	/* we only need the amount of log(2)1024 for our conversion */
 	pageshift -= 10;
 
+	/* the number of CPUs does not change while we run */
+	mib[0] = CTL_HW;
+	mib[1] = HW_NCPU;
+	size = sizeof(ncpu);
+	if ((sysctl(mib, 2, &ncpu, &size, NULL, 0) < 0) || (ncpu < 1)) {
+		perror("sysctl hw.ncpu");
+		ncpu = 1;
+	}
+
 	return (TRUE);
 }
 
@@ -196,29 +210,58 @@ machine_get_fs(mounts_type fs[], int *cnt)
 	return (TRUE);
 }
 
-int
-machine_get_load(load_type * curr_load)
+/* A pass over the screens takes less; the next one is a time unit later */
+#define SNAPSHOT_AGE	50000000L	/* ns */
+
+/**
+ * Get the CPU counters, read anew only if the last snapshot was not taken
+ * during the current pass over the screens.
+ */
+static int
+cp_time_snapshot(load_type *load)
 {
-	static load_type last_load = {0, 0, 0, 0, 0};
-	static load_type last_ret_load;
-	load_type load;
+	static load_type snap;
+	static struct timespec taken;
+	static int valid = 0;
+	static const int mib[2] = { CTL_KERN, KERN_CPTIME };
+	struct timespec now;
 	long cp_time[CPUSTATES];
 	size_t size;
-	int mib[2];
 
-	mib[0] = CTL_KERN;
-	mib[1] = KERN_CPTIME;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (valid && ((now.tv_sec - taken.tv_sec) * 1000000000L
+		      + (now.tv_nsec - taken.tv_nsec) < SNAPSHOT_AGE)) {
+		*load = snap;
+		return (TRUE);
+	}
+
 	size = sizeof(cp_time);
 	if (sysctl(mib, 2, cp_time, &size, NULL, 0) < 0) {
 		perror("sysctl kern.cp_time failed");
 		return (FALSE);
 	}
 
-	load.user = (unsigned long)(cp_time[CP_USER]);
-	load.nice = (unsigned long)(cp_time[CP_NICE]);
-	load.system = (unsigned long)(cp_time[CP_SYS] + cp_time[CP_INTR]);
-	load.idle = (unsigned long)(cp_time[CP_IDLE]);
-	load.total = load.user + load.nice + load.system + load.idle;
+	snap.user = (unsigned long)(cp_time[CP_USER]);
+	snap.nice = (unsigned long)(cp_time[CP_NICE]);
+	snap.system = (unsigned long)(cp_time[CP_SYS] + cp_time[CP_INTR]);
+	snap.idle = (unsigned long)(cp_time[CP_IDLE]);
+	snap.total = snap.user + snap.nice + snap.system + snap.idle;
+	taken = now;
+	valid = 1;
+	*load = snap;
+	return (TRUE);
+}
+
+int
+machine_get_load(load_type * curr_load)
+{
+	static load_type last_load = {0, 0, 0, 0, 0};
+	static load_type last_ret_load;
+	load_type load;
+
+	/* Several screens in one pass share a snapshot, and get the same load */
+	if (cp_time_snapshot(&load) == FALSE)
+		return (FALSE);
 
 	if (load.total != last_load.total) {
 		curr_load->user = load.user - last_load.user;
@@ -336,19 +379,9 @@ machine_get_procs(LinkedList * procs)
 int
 machine_get_smpload(load_type * result, int *numcpus)
 {
-	int mib[2], i, num;
-	size_t size;
+	int i, num;
 	load_type curr_load;
 
-	mib[0] = CTL_HW;
-	mib[1] = HW_NCPU;
-	size = sizeof(int);
-
-	if (sysctl(mib, 2, &num, &size, NULL, 0) < 0) {
-		perror("sysctl hw.ncpu");
-		return (FALSE);
-	}
-
 	if (machine_get_load(&curr_load) == FALSE)
 		return (FALSE);
 
@@ -356,7 +389,7 @@ machine_get_smpload(load_type * result, int *numcpus)
 		return (FALSE);
 
 	/* restrict #CPUs to max. *numcpus */
-	num = (*numcpus >= num) ? num : *numcpus;
+	num = (*numcpus >= ncpu) ? ncpu : *numcpus;
 	*numcpus = num;
 
 	/* Don't know how to get per-cpu-load values */
@@ -403,4 +436,17 @@ machine_get_iface_stats(IfaceInfo * interface)
 	return 0;
 }
 
+
+int
+machine_get_iface_stats_all(IfaceInfo * interfaces, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (!machine_get_iface_stats(&interfaces[i]))
+			return (FALSE);
+	}
+	return (TRUE);
+}
+
 #endif				/* __OpenBSD__ */
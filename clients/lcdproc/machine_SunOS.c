@@ -438,4 +438,17 @@ machine_get_iface_stats(IfaceInfo * interface)
 	return 0;
 }
 
+
+int
+machine_get_iface_stats_all(IfaceInfo * interfaces, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (!machine_get_iface_stats(&interfaces[i]))
+			return (FALSE);
+	}
+	return (TRUE);
+}
+
 #endif				/* sun */
@@ -27,6 +27,8 @@
 #include <sys/stat.h>
 #include <sys/utsname.h>
 #include <sys/param.h>
+#include <poll.h>
+#include <time.h>
 
 #ifdef HAVE_CONFIG_H
 # include "config.h"
@@ -35,7 +37,9 @@
 #include "main.h"
 #include "mode.h"
 #include "shared/sockets.h"
+#include "shared/lcdclient.h"
 #include "shared/report.h"
+#include "shared/str.h"
 #include "shared/configfile.h"
 #include "getopt.h"		/* This is our local getopt.h! */
 
@@ -49,6 +53,8 @@
 #include "mem.h"
 #include "machine.h"
 #include "iface.h"
+#include "metrics.h"
+#include "headless.h"
 #ifdef LCDPROC_EYEBOXONE
 # include "eyebox.h"
 #endif
@@ -72,11 +78,15 @@ static struct utsname unamebuf;
 /* local prototypes */
 static void HelpScreen(int exit_state);
 static void exit_program(int val);
+static void catch_timing_signal(int val);
+static void close_servers(void);
 static void main_loop(void);
+static void setup_servers(void);
+static int connect_servers(void);
 static int process_configfile(char *cfgfile);
 
 
-#define TIME_UNIT	125000	/**< 1/8th second is a single time unit. */
+#define MAX_WAIT	8	/**< Longest sleep of the main loop, in time units */
 
 #if !defined(SYSCONFDIR)
 # define SYSCONFDIR	"/etc"
@@ -93,26 +103,44 @@ static int process_configfile(char *cfgfile);
 #define DEFAULT_REPORTDEST	RPT_DEST_STDERR
 #define DEFAULT_REPORTLEVEL	RPT_WARNING
 
+/** Most servers the screens are sent to at once */
+#define MAX_SERVERS	8
+
+/** A server the screens are sent to */
+typedef struct {
+	char *host;		/**< Hostname, IP-address or UNIX socket path */
+	int port;		/**< Port number */
+	int fd;			/**< Socket; -1 if not connected or gone */
+	int connected;		/**< It sent its connect response */
+	char buf[8192];		/**< What it sent that is not handled yet */
+	size_t buffered;	/**< Bytes in buf */
+} Server;
+
+static Server servers[MAX_SERVERS];
+static int server_count = 0;
+static Server *only_to = NULL;	/**< Send to this server only, not to all */
+
 /** list of screen modes to run */
 ScreenMode sequence[] =
 {
 	/* flags default ACTIVE will run by default */
 	/* longname    which on  off inv  timer   flags */
-	{ "CPU",       'C',   1,    2, 0, 0xffff, ACTIVE, cpu_screen        },	// [C]PU
+	{ "CPU",       'C',   1,    2, 0, 0xffff, ACTIVE | HISTORY, cpu_screen   },	// [C]PU
 	{ "Iface",     'I',   1,    2, 0, 0xffff, 0,      iface_screen      }, 	// [I]face
 	{ "Memory",    'M',   4,   16, 0, 0xffff, ACTIVE, mem_screen        },	// [M]emory
-	{ "Load",      'L',  64,  128, 1, 0xffff, ACTIVE, xload_screen      },	// [L]oad (load histogram)
+	{ "Load",      'L',  64,  128, 1, 0xffff, ACTIVE | HISTORY, xload_screen },	// [L]oad (load histogram)
 	{ "TimeDate",  'T',   4,   64, 0, 0xffff, ACTIVE, time_screen       },	// [T]ime/Date
 	{ "About",     'A', 999, 9999, 0, 0xffff, ACTIVE, credit_screen     },	// [A]bout (credits)
 	{ "SMP-CPU",   'P',   1,    2, 0, 0xffff, 0,      cpu_smp_screen    },	// CPU_SM[P]
 	{ "OldTime",   'O',   4,   64, 0, 0xffff, 0,      clock_screen      },	// [O]ld Timescreen
 	{ "BigClock",  'K',   4,   64, 0, 0xffff, 0,      big_clock_screen  },	// big cloc[K]
 	{ "Uptime",    'U',   4,  128, 0, 0xffff, 0,      uptime_screen     },	// Old [U]ptime Screen
-	{ "Battery",   'B',  32,  256, 1, 0xffff, 0,      battery_screen    },	// [B]attery Status
-	{ "CPUGraph",  'G',   1,    2, 0, 0xffff, 0,      cpu_graph_screen  },	// CPU histogram [G]raph
-	{ "ProcSize",  'S',  16,  256, 1, 0xffff, 0,      mem_top_screen    },	// [S]ize of biggest processes
-	{ "Disk",      'D', 256,  256, 1, 0xffff, 0,      disk_screen       },	// [D]isk stats
+	{ "Battery",   'B',  32,  256, 0, 0xffff, 0,      battery_screen    },	// [B]attery Status
+	{ "CPUGraph",  'G',   1,    2, 0, 0xffff, HISTORY, cpu_graph_screen  },	// CPU histogram [G]raph
+	{ "ProcSize",  'S',  16,  256, 0, 0xffff, 0,      mem_top_screen    },	// [S]ize of biggest processes
+	{ "Disk",      'D', 256,  256, 0, 0xffff, 0,      disk_screen       },	// [D]isk stats
 	{ "MiniClock", 'N',   4,   64, 0, 0xffff, 0,      mini_clock_screen },	// Mi[n]i clock
+	{ "Metrics",   'X',   1,    8, 0, 0xffff, HISTORY, metrics_screen    },	// Metrics from other programs ([X]ternal)
 	{  NULL, 0, 0, 0, 0, 0, 0, NULL},			  	// No more..  all done.
 };
 
@@ -121,8 +149,9 @@ ScreenMode sequence[] =
 static int islow = -1;		/**< pause after mode update (in 1/100s) */
 char *progname = "lcdproc";
 char *server = NULL;
-int port = LCDPORT;
+int port = UNSET_INT;
 int foreground = FALSE;
+static int headless = FALSE;	/**< write the collected values to stdout */
 static int report_level = UNSET_INT;
 static int report_dest = UNSET_INT;
 char *configfile = NULL;
@@ -130,6 +159,7 @@ char *pidfile = NULL;
 int pidfile_written = FALSE;
 char *displayname = NULL;	/**< display name for the main menu */
 char *hostname = "";
+static volatile sig_atomic_t timing_requested = 0;	/**< SIGUSR1 came */
 
 /** Returns the network name of this machine */
 const char *
@@ -186,7 +216,7 @@ set_mode(int shortname, char *longname, int state)
 				sequence[k].flags &= (~ACTIVE & ~INITIALIZED);
 				/* delete the screen if we are connected */
 				if (sock >= 0) {
-					sock_printf(sock, "screen_del %c\n", sequence[k].which);
+					lcd_client_printf(sock, "screen_del %c\n", sequence[k].which);
 				}
 			}
 			else
@@ -231,12 +261,13 @@ main(int argc, char **argv)
 	signal(SIGHUP, exit_program);	/* kill -HUP */
 	signal(SIGPIPE, exit_program);	/* write to closed socket */
 	signal(SIGKILL, exit_program);	/* kill -9 [cannot be trapped; but ...] */
+	signal(SIGUSR1, catch_timing_signal);	/* report the update times */
 
 	/* No error output from getopt */
 	opterr = 0;
 
 	/* get options from command line */
-	while ((c = getopt(argc, argv, "s:p:e:c:fhv")) > 0) {
+	while ((c = getopt(argc, argv, "s:p:e:c:fH:hv")) > 0) {
 		char *end;
 
 		switch (c) {
@@ -267,6 +298,14 @@ main(int argc, char **argv)
 			case 'f':
 				foreground = TRUE;
 				break;
+			/* H is for headless */
+			case 'H':
+				if (headless_set_format(optarg) < 0) {
+					fprintf(stderr, "Illegal output format %s\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				headless = TRUE;
+				break;
 			case 'h':
 				HelpScreen(EXIT_SUCCESS);
 				break;
@@ -330,19 +369,18 @@ main(int argc, char **argv)
 		}
 	}
 
-	if (server == NULL)
-		server = DEFAULT_SERVER;
+	/* Without a display: no server, and stdout stays ours */
+	if (headless) {
+		mode_init();
+		exit_program((headless_loop() < 0) ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
 
-	/* Connect to the server... */
-	sock = sock_connect(server, port);
-	if (sock < 0) {
-		fprintf(stderr, "Error connecting to LCD server %s on port %d.\n"
-			"Check to see that the server is running and operating normally.\n",
-			server, port);
+	/* Connect to the servers... */
+	setup_servers();
+	if (connect_servers() < 0)
 		return (EXIT_FAILURE);
-	}
 
-	sock_send_string(sock, "hello\n");
+	lcd_client_send(sock, "hello\n");
 	usleep(500000);		/* wait for the server to say hi. */
 
 	/* We grab the real values below, from the "connect" line. */
@@ -420,13 +458,6 @@ process_configfile(char *configfile)
 		return -1;
 	}
 
-	if (server == NULL) {
-		server = strdup(config_get_string(progname, "Server", 0, DEFAULT_SERVER));
-	}
-	if (port == UNSET_INT) {
-		port = config_get_int(progname, "Port", 0, LCDPORT);
-	}
-
 	if (report_level == UNSET_INT) {
 		report_level = config_get_int(progname, "ReportLevel", 0, RPT_WARNING);
 	}
@@ -447,6 +478,7 @@ process_configfile(char *configfile)
 	if (islow < 0) {
 		islow = config_get_int(progname, "Delay", 0, -1);
 	}
+	mode_timing = config_get_bool(progname, "Timing", 0, FALSE);
 	if ((tmp = config_get_string(progname, "DisplayName", 0, NULL)) != NULL) {
 		displayname = strdup(tmp);
 	}
@@ -486,6 +518,8 @@ HelpScreen(int exit_state)
 		"    -p <port>           connect to LCDd daemon using <port>\n"
 		"    -f                  run in foreground\n"
 		"    -e <delay>          slow down initial announcement of screens (in 1/100s)\n"
+		"    -H <format>         do not connect; write the screens' data to stdout\n"
+		"                        as 'line' protocol or 'json'\n"
 		"    -c <config>         use a configuration file other than %s\n"
 		"    -h                  show this help screen\n"
 		"    -v                  display program version\n"
@@ -504,6 +538,7 @@ HelpScreen(int exit_state)
 		"    U Uptime            uptime screen\n"
 		"    K BigClock          big clock\n"
 		"    N MiniClock         minimal clock\n"
+		"    X Metrics           metrics sent by other programs\n"
 		"    A About             credits page\n"
 		"\n"
 		"Example:\n"
@@ -525,13 +560,21 @@ exit_program(int val)
 	eyebox_clear();
 #endif
 	Quit = 1;
-	sock_close(sock);
+	close_servers();
 	mode_close();
 	if ((foreground != TRUE) && (pidfile != NULL) && (pidfile_written == TRUE))
 		unlink(pidfile);
 	exit(val);
 }
 
+
+/** Called upon USR1 signal: the main loop reports the update times. */
+static void
+catch_timing_signal(int val)
+{
+	timing_requested = 1;
+}
+
 #ifdef LCDPROC_MENUS
 int
 menus_init()
@@ -540,7 +583,7 @@ menus_init()
 
 	for (k = 0; sequence[k].which; k++) {
 		if (sequence[k].longname) {
-			sock_printf(sock, "menu_add_item {} %c checkbox {%s} -value %s\n",
+			lcd_client_printf(sock, "menu_add_item {} %c checkbox {%s} -value %s\n",
 				    sequence[k].which, sequence[k].longname,
 			       (sequence[k].flags & ACTIVE) ? "on" : "off");
 		}
@@ -551,34 +594,34 @@ menus_init()
 	 * to be entered on escape from test_menu (but overwritten for
 	 * test_{checkbox,ring}
 	 */
-	sock_send_string(sock, "menu_add_item {} ask menu {Leave menus?} -is_hidden true\n");
-	sock_send_string(sock, "menu_add_item {ask} ask_yes action {Yes} -next _quit_\n");
-	sock_send_string(sock, "menu_add_item {ask} ask_no action {No} -next _close_\n");
-	sock_send_string(sock, "menu_add_item {} test menu {Test}\n");
-	sock_send_string(sock, "menu_add_item {test} test_action action {Action}\n");
-	sock_send_string(sock, "menu_add_item {test} test_checkbox checkbox {Checkbox}\n");
-	sock_send_string(sock, "menu_add_item {test} test_ring ring {Ring} -strings {one\ttwo\tthree}\n");
-	sock_send_string(sock, "menu_add_item {test} test_slider slider {Slider} -mintext < -maxtext > -value 50\n");
-	sock_send_string(sock, "menu_add_item {test} test_numeric numeric {Numeric} -value 42\n");
-	sock_send_string(sock, "menu_add_item {test} test_alpha alpha {Alpha} -value abc\n");
-	sock_send_string(sock, "menu_add_item {test} test_ip ip {IP} -v6 false -value 192.168.1.1\n");
-	sock_send_string(sock, "menu_add_item {test} test_menu menu {Menu}\n");
-	sock_send_string(sock, "menu_add_item {test_menu} test_menu_action action {Submenu's action}\n");
+	lcd_client_send(sock, "menu_add_item {} ask menu {Leave menus?} -is_hidden true\n");
+	lcd_client_send(sock, "menu_add_item {ask} ask_yes action {Yes} -next _quit_\n");
+	lcd_client_send(sock, "menu_add_item {ask} ask_no action {No} -next _close_\n");
+	lcd_client_send(sock, "menu_add_item {} test menu {Test}\n");
+	lcd_client_send(sock, "menu_add_item {test} test_action action {Action}\n");
+	lcd_client_send(sock, "menu_add_item {test} test_checkbox checkbox {Checkbox}\n");
+	lcd_client_send(sock, "menu_add_item {test} test_ring ring {Ring} -strings {one\ttwo\tthree}\n");
+	lcd_client_send(sock, "menu_add_item {test} test_slider slider {Slider} -mintext < -maxtext > -value 50\n");
+	lcd_client_send(sock, "menu_add_item {test} test_numeric numeric {Numeric} -value 42\n");
+	lcd_client_send(sock, "menu_add_item {test} test_alpha alpha {Alpha} -value abc\n");
+	lcd_client_send(sock, "menu_add_item {test} test_ip ip {IP} -v6 false -value 192.168.1.1\n");
+	lcd_client_send(sock, "menu_add_item {test} test_menu menu {Menu}\n");
+	lcd_client_send(sock, "menu_add_item {test_menu} test_menu_action action {Submenu's action}\n");
 	/*
 	 * no successor for menus. Since test_checkbox and test_ring have
 	 * their own predecessors defined the "ask" rule will not work for
 	 * them.
 	 */
-	sock_send_string(sock, "menu_set_item {} test -prev {ask}\n");
-
-	sock_send_string(sock, "menu_set_item {} test_action -next {test_checkbox}\n");
-	sock_send_string(sock, "menu_set_item {} test_checkbox -next {test_ring} -prev test_action\n");
-	sock_send_string(sock, "menu_set_item {} test_ring -next {test_slider} -prev {test_checkbox}\n");
-	sock_send_string(sock, "menu_set_item {} test_slider -next {test_numeric} -prev {test_ring}\n");
-	sock_send_string(sock, "menu_set_item {} test_numeric -next {test_alpha} -prev {test_slider}\n");
-	sock_send_string(sock, "menu_set_item {} test_alpha -next {test_ip} -prev {test_numeric}\n");
-	sock_send_string(sock, "menu_set_item {} test_ip -next {test_menu} -prev {test_alpha}\n");
-	sock_send_string(sock, "menu_set_item {} test_menu_action -next {_close_}\n");
+	lcd_client_send(sock, "menu_set_item {} test -prev {ask}\n");
+
+	lcd_client_send(sock, "menu_set_item {} test_action -next {test_checkbox}\n");
+	lcd_client_send(sock, "menu_set_item {} test_checkbox -next {test_ring} -prev test_action\n");
+	lcd_client_send(sock, "menu_set_item {} test_ring -next {test_slider} -prev {test_checkbox}\n");
+	lcd_client_send(sock, "menu_set_item {} test_slider -next {test_numeric} -prev {test_ring}\n");
+	lcd_client_send(sock, "menu_set_item {} test_numeric -next {test_alpha} -prev {test_slider}\n");
+	lcd_client_send(sock, "menu_set_item {} test_alpha -next {test_ip} -prev {test_numeric}\n");
+	lcd_client_send(sock, "menu_set_item {} test_ip -next {test_menu} -prev {test_alpha}\n");
+	lcd_client_send(sock, "menu_set_item {} test_menu_action -next {_close_}\n");
 #endif				/* LCDPROC_CLIENT_TESTMENUS */
 
 	return 0;
@@ -586,149 +629,472 @@ menus_init()
 #endif				/* LCDPROC_MENUS */
 
 
-/** Main program loop... */
-void
-main_loop(void)
+/**
+ * Make the list of servers: the one given by -s, or those of the Server=
+ * lines of the config file, each with the Port= at the same position or
+ * else the first Port=. A port given by -p is used for all of them.
+ */
+static void
+setup_servers(void)
 {
-	int i = 0, j;
-	int connected = 0;
-	char buf[8192];
-	char *argv[256];
-	int argc, newtoken;
-	int len;
+	int default_port = config_get_int(progname, "Port", 0, LCDPORT);
+	const char *host;
+
+	if (server != NULL) {
+		servers[0].host = server;
+		servers[0].port = (port != UNSET_INT) ? port : default_port;
+		server_count = 1;
+		return;
+	}
 
-	while (!Quit) {
-		/* Check for server input... */
-		len = sock_recv(sock, buf, 8000);
-
-		/* Handle server input... */
-		while (len > 0) {
-			/* Now split the string into tokens... */
-			argc = 0;
-			newtoken = 1;
-
-			for (i = 0; i < len; i++) {
-				switch (buf[i]) {
-					case ' ':
-						newtoken = 1;
-						buf[i] = 0;
-						break;
-					default:	/* regular chars, keep
-							 * tokenizing */
-						if (newtoken)
-							argv[argc++] = buf + i;
-						newtoken = 0;
-						break;
-					case '\0':
-					case '\n':
-						buf[i] = 0;
-						if (argc > 0) {
-							if (0 == strcmp(argv[0], "listen")) {
-								for (j = 0; sequence[j].which; j++) {
-									if (sequence[j].which == argv[1][0]) {
-										sequence[j].flags |= VISIBLE;
-										debug(RPT_DEBUG, "Listen %s", argv[1]);
-									}
-								}
-							}
-							else if (0 == strcmp(argv[0], "ignore")) {
-								for (j = 0; sequence[j].which; j++) {
-									if (sequence[j].which == argv[1][0]) {
-										sequence[j].flags &= ~VISIBLE;
-										debug(RPT_DEBUG, "Ignore %s", argv[1]);
-									}
-								}
-							}
-							else if (0 == strcmp(argv[0], "key")) {
-								debug(RPT_DEBUG, "Key %s", argv[1]);
-							}
+	while ((server_count < MAX_SERVERS)
+	       && ((host = config_get_string(progname, "Server", server_count, NULL)) != NULL)) {
+		servers[server_count].host = strdup(host);
+		servers[server_count].port = (port != UNSET_INT) ? port
+			: config_get_int(progname, "Port", server_count, default_port);
+		server_count++;
+	}
+	if (server_count == 0) {
+		servers[0].host = DEFAULT_SERVER;
+		servers[0].port = (port != UNSET_INT) ? port : default_port;
+		server_count = 1;
+	}
+}
+
+
+/**
+ * Send what the screens send to every server; installed with
+ * sock_set_send_func() when there is more than one. The data is gathered
+ * once and only the writes are repeated.
+ * \param fd    Socket file descriptor the data was sent to
+ * \param src   The data
+ * \param size  Its length
+ * \return  Number of bytes sent, -1 if no server took them.
+ */
+static int
+send_to_servers(int fd, const void *src, size_t size)
+{
+	int result = -1;
+	int i;
+
+	/* Send with the socket layer's own means, corked or not */
+	sock_set_send_func(NULL);
+	if (only_to != NULL)
+		result = sock_send(only_to->fd, src, size);
+	else if (fd != sock)
+		result = sock_send(fd, src, size);
+	else {
+		for (i = 0; i < server_count; i++) {
+			if ((servers[i].fd >= 0) && (sock_send(servers[i].fd, src, size) >= 0))
+				result = size;
+		}
+	}
+	sock_set_send_func(send_to_servers);
+	return result;
+}
+
+
+/**
+ * Connect to all servers. Those that cannot be reached are left out as
+ * long as one of them can.
+ * \return  0 on success, -1 if no server could be reached.
+ */
+static int
+connect_servers(void)
+{
+	int i;
+
+	for (i = 0; i < server_count; i++) {
+		Server *s = &servers[i];
+
+		s->fd = sock_connect(s->host, s->port);
+		if (s->fd < 0) {
+			fprintf(stderr, "Error connecting to LCD server %s on port %d.\n"
+				"Check to see that the server is running and operating normally.\n",
+				s->host, s->port);
+			continue;
+		}
+		if (sock < 0)
+			sock = s->fd;
+	}
+	if (sock < 0)
+		return -1;
+
+	if (server_count > 1) {
+		sock_set_send_func(send_to_servers);
+		/* A server that is gone is dropped when reading from it fails */
+		signal(SIGPIPE, SIG_IGN);
+	}
+	return 0;
+}
+
+
+/** Close the connections to all servers. */
+static void
+close_servers(void)
+{
+	int i;
+
+	sock_set_send_func(NULL);
+	for (i = 0; i < server_count; i++) {
+		if (servers[i].fd >= 0)
+			sock_close(servers[i].fd);
+		servers[i].fd = -1;
+	}
+	sock = -1;
+}
+
+
+/**
+ * Stop sending to a server that closed the connection or failed. The
+ * others go on; lcdproc exits when the last one is gone.
+ * \param s  The server
+ */
+static void
+drop_server(Server *s)
+{
+	unsigned int bit = 1U << (s - servers);
+	int i;
+
+	sock_close(s->fd);
+	s->fd = -1;
+	for (i = 0; sequence[i].which; i++) {
+		sequence[i].shown_on &= ~bit;
+		if (sequence[i].shown_on == 0)
+			sequence[i].flags &= ~VISIBLE;
+	}
+
+	/* sock stands for all servers; it has to be one that is left */
+	sock = -1;
+	for (i = 0; i < server_count; i++) {
+		if (servers[i].fd >= 0) {
+			sock = servers[i].fd;
+			break;
+		}
+	}
+	if (sock < 0)
+		exit_program(EXIT_FAILURE);
+}
+
+
+/** Cork (1), flush (0) or uncork (-1) the sockets of all servers. */
+static void
+servers_cork(int how)
+{
+	int i;
+
+	for (i = 0; i < server_count; i++) {
+		if (servers[i].fd < 0)
+			continue;
+		if (how > 0)
+			sock_cork(servers[i].fd);
+		else if (how == 0)
+			sock_flush(servers[i].fd);
+		else
+			sock_uncork(servers[i].fd);
+	}
+}
+
+
+/** Time in time units since some point in the past. */
+static long
+time_units(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long) ((ts.tv_sec * 1000000LL + ts.tv_nsec / 1000) / TIME_UNIT);
+}
+
+
+/**
+ * Wait until the start of a time unit, or until there is input from a
+ * server.
+ * \param until  The time unit.
+ */
+static void
+wait_for_server(long until)
+{
+	struct timespec ts;
+	struct pollfd pfd[MAX_SERVERS];
+	long long wait;
+	int i, n = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	/* Round up: waiting 0 ms for the last part of a millisecond would spin */
+	wait = (until * (long long) TIME_UNIT - (ts.tv_sec * 1000000LL + ts.tv_nsec / 1000) + 999) / 1000;
+	if (wait <= 0)
+		return;
+	if (sock < 0) {
+		usleep(wait * 1000);
+		return;
+	}
+
+	for (i = 0; i < server_count; i++) {
+		if (servers[i].fd < 0)
+			continue;
+		pfd[n].fd = servers[i].fd;
+		pfd[n].events = POLLIN;
+		pfd[n].revents = 0;
+		n++;
+	}
+	poll(pfd, n, (int) wait);
+}
+
+
+/**
+ * Handle a line a server sent, split into arguments.
+ * \param s     The server
+ * \param argc  Number of arguments
+ * \param argv  The arguments
+ */
+static void
+handle_server_line(Server *s, int argc, char **argv)
+{
+	unsigned int bit = 1U << (s - servers);
+	int j;
+
+	if (argc < 1)
+		return;
+	if ((0 == strcmp(argv[0], "listen")) && (argc > 1)) {
+		for (j = 0; sequence[j].which; j++) {
+			if (sequence[j].which == argv[1][0]) {
+				sequence[j].shown_on |= bit;
+				sequence[j].flags |= VISIBLE;
+				/* update it at once */
+				sequence[j].next_update = 0;
+				debug(RPT_DEBUG, "Listen %s", argv[1]);
+			}
+		}
+	}
+	else if ((0 == strcmp(argv[0], "ignore")) && (argc > 1)) {
+		for (j = 0; sequence[j].which; j++) {
+			if (sequence[j].which == argv[1][0]) {
+				/* Hidden when no server shows it */
+				sequence[j].shown_on &= ~bit;
+				if (sequence[j].shown_on == 0)
+					sequence[j].flags &= ~VISIBLE;
+				debug(RPT_DEBUG, "Ignore %s", argv[1]);
+			}
+		}
+	}
+	else if ((0 == strcmp(argv[0], "key")) && (argc > 1)) {
+		debug(RPT_DEBUG, "Key %s", argv[1]);
+	}
 #ifdef LCDPROC_MENUS
-							else if (0 == strcmp(argv[0], "menuevent")) {
-								if (argc == 4 && (0 == strcmp(argv[1], "update"))) {
-									set_mode(argv[2][0], "", strcmp(argv[3], "off"));
-								}
-							}
+	else if (0 == strcmp(argv[0], "menuevent")) {
+		if (argc == 4 && (0 == strcmp(argv[1], "update"))) {
+			set_mode(argv[2][0], "", strcmp(argv[3], "off"));
+		}
+	}
 #else
-							else if (0 == strcmp(argv[0], "menu")) {
-							}
+	else if (0 == strcmp(argv[0], "menu")) {
+	}
 #endif
-							else if (0 == strcmp(argv[0], "connect")) {
-								int a;
-								for (a = 1; a < argc; a++) {
-									if (0 == strcmp(argv[a], "wid"))
-										lcd_wid = atoi(argv[++a]);
-									else if (0 == strcmp(argv[a], "hgt"))
-										lcd_hgt = atoi(argv[++a]);
-									else if (0 == strcmp(argv[a], "cellwid"))
-										lcd_cellwid = atoi(argv[++a]);
-									else if (0 == strcmp(argv[a], "cellhgt"))
-										lcd_cellhgt = atoi(argv[++a]);
-									else if (0 == strcmp(argv[a], "protocol"))
-										sscanf(argv[++a], "%d.%d", &protocol_major_version, &protocol_minor_version);
-								}
-								connected = 1;
-								if (displayname != NULL)
-									sock_printf(sock, "client_set -name \"%s\"\n", displayname);
-								else
-									sock_printf(sock, "client_set -name {LCDproc %s}\n", get_hostname());
+	else if (0 == strcmp(argv[0], "connect")) {
+		static int sized = 0;
+		LCDServerInfo info;
+
+		if (lcd_client_parse_connect(argc, argv, &info) == 0) {
+			if (!sized) {
+				lcd_wid = info.wid;
+				lcd_hgt = info.hgt;
+				if (info.cellwid > 0)
+					lcd_cellwid = info.cellwid;
+				if (info.cellhgt > 0)
+					lcd_cellhgt = info.cellhgt;
+				sized = 1;
+			}
+			else if ((info.wid != lcd_wid) || (info.hgt != lcd_hgt)) {
+				/* All get the same screens: lay them out for the smallest */
+				report(RPT_NOTICE, "Server %s has a %dx%d display; using %dx%d for all",
+				       s->host, info.wid, info.hgt,
+				       min(info.wid, lcd_wid), min(info.hgt, lcd_hgt));
+				lcd_wid = min(info.wid, lcd_wid);
+				lcd_hgt = min(info.hgt, lcd_hgt);
+			}
+			protocol_major_version = info.protocol_major;
+			protocol_minor_version = info.protocol_minor;
+		}
+		s->connected = 1;
+
+		/* This goes to the server that connected only */
+		only_to = s;
+		sock_cork(s->fd);
+		if (displayname != NULL)
+			lcd_client_printf(sock, "client_set -name \"%s\"\n", displayname);
+		else
+			lcd_client_printf(sock, "client_set -name {LCDproc %s}\n", get_hostname());
 #ifdef LCDPROC_MENUS
-								menus_init();
+		menus_init();
 #endif
-							}
-							else if (0 == strcmp(argv[0], "bye")) {
-								exit_program(EXIT_SUCCESS);
-							}
-							else if (0 == strcmp(argv[0], "success")) {
-							}
-							else {
-								/*
-								int j;
-								for (j = 0; j < argc; j++)
-									printf("%s ", argv[j]);
-								printf("\n");
-								*/
-							}
-						}
-
-						/* Restart tokenizing */
-						argc = 0;
-						newtoken = 1;
-						break;
-				}	/* switch( buf[i] ) */
-			}
+		sock_uncork(s->fd);
+		only_to = NULL;
+	}
+	else if (0 == strcmp(argv[0], "bye")) {
+		if (server_count == 1)
+			exit_program(EXIT_SUCCESS);
+		report(RPT_NOTICE, "Server %s said bye", s->host);
+		drop_server(s);
+	}
+	else if (0 == strcmp(argv[0], "success")) {
+	}
+	else {
+		/*
+		int j;
+		for (j = 0; j < argc; j++)
+			printf("%s ", argv[j]);
+		printf("\n");
+		*/
+	}
+}
 
-			len = sock_recv(sock, buf, 8000);
+
+/**
+ * Read what a server sent and handle its complete lines. A line that
+ * came only in part stays in the buffer until the rest arrives.
+ * \param s  The server
+ */
+static void
+read_server(Server *s)
+{
+	char *buf = s->buf;
+	char *argv[256];
+	int len;
+
+	while ((len = sock_recv(s->fd, buf + s->buffered, sizeof(s->buf) - 1 - s->buffered)) != 0) {
+		char *line = buf;
+		char *end;
+
+		if (len < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+				return;
+			report(RPT_ERR, "Error reading from server %s: %s", s->host, sock_geterror());
+			if (server_count == 1)
+				exit_program(EXIT_FAILURE);
+			drop_server(s);
+			return;
+		}
+		end = buf + s->buffered + len;
+		*end = '\0';
+
+		/* Split the complete lines into tokens */
+		while (line < end) {
+			size_t n = strcspn(line, "\n");
+
+			if (line + n >= end)
+				break;
+			line[n] = '\0';
+			handle_server_line(s, get_args(argv, line, sizeof(argv) / sizeof(argv[0])), argv);
+			if (s->fd < 0)
+				return;	/* it said bye */
+			line += n + 1;
+		}
+
+		/* Keep the start of a line for the next read */
+		s->buffered = end - line;
+		if (s->buffered >= sizeof(s->buf) - 1) {
+			report(RPT_WARNING, "Line from server too long, dropped");
+			s->buffered = 0;
+		}
+		else if ((s->buffered > 0) && (line > buf))
+			memmove(buf, line, s->buffered);
+	}
+
+	report(RPT_ERR, "Server %s closed the connection", s->host);
+	if (server_count == 1)
+		exit_program(EXIT_FAILURE);
+	drop_server(s);
+}
+
+
+/** Main program loop... */
+void
+main_loop(void)
+{
+	int i = 0;
+	int connected;
+	long now, next;
+	int interval;
+	ModeTiming send_timing = { 0 };
+
+	while (!Quit) {
+		/* Handle server input; the screens start when all servers
+		 * have answered */
+		connected = 1;
+		for (i = 0; i < server_count; i++) {
+			if (servers[i].fd >= 0)
+				read_server(&servers[i]);
+			if ((servers[i].fd >= 0) && !servers[i].connected)
+				connected = 0;
+		}
+
+		if (timing_requested) {
+			timing_requested = 0;
+			mode_report_timing(&send_timing);
 		}
 
-		/* Gather stats and update screens */
+		/* Gather stats and update screens; the widget updates of a
+		 * pass go to the server at once */
+		now = time_units();
+		next = now + MAX_WAIT;
 		if (connected) {
+			servers_cork(1);
 			for (i = 0; sequence[i].which > 0; i++) {
-				sequence[i].timer++;
+				ScreenMode *m = &sequence[i];
+				int display;
 
-				if (!(sequence[i].flags & ACTIVE))
+				if (!(m->flags & ACTIVE))
 					continue;
 
-				if (sequence[i].flags & VISIBLE) {
-					if (sequence[i].timer >= sequence[i].on_time) {
-						sequence[i].timer = 0;
-						/* Now, update the screen... */
-						update_screen(&sequence[i], 1);
-					}
+				/*
+				 * A hidden screen only gets the stats to set
+				 * itself up, to keep its history or when it is
+				 * to show them while not visible.
+				 */
+				if (m->flags & VISIBLE) {
+					interval = m->on_time;
+					display = 1;
 				}
-				else {
-					if (sequence[i].timer >= sequence[i].off_time) {
-						sequence[i].timer = 0;
-						/* Now, update the screen... */
-						update_screen(&sequence[i], sequence[i].show_invisible);
+				else if (!(m->flags & INITIALIZED) || (m->flags & HISTORY)
+					 || m->show_invisible) {
+					interval = m->off_time;
+					display = m->show_invisible;
+				}
+				else
+					continue;
+
+				if (m->next_update <= now) {
+					m->timer = now - m->last_update;
+					m->last_update = now;
+					m->next_update = now + ((interval > 0) ? interval : 1);
+					/* Now, update the screen... */
+					update_screen(m, display);
+
+					if (islow > 0) {
+						servers_cork(0);
+						usleep(islow * 10000);
 					}
 				}
-				if (islow > 0)
-					usleep(islow * 10000);
+				if (m->next_update < next)
+					next = m->next_update;
 			}
+			if (mode_timing) {
+				struct timespec start;
+
+				clock_gettime(CLOCK_MONOTONIC, &start);
+				servers_cork(-1);
+				timing_add(&send_timing, &start);
+			}
+			else
+				servers_cork(-1);
 		}
+		else
+			next = now + 1;
 
-		/* Now sleep... */
-		usleep(TIME_UNIT);
+		/* Now sleep until the next update is due, or the server
+		 * says something */
+		wait_for_server(next);
 	}
 }
 
@@ -37,12 +37,22 @@ extern int Quit;
 extern int sock;
 extern char *version;
 extern char *build_date;
+extern char *progname;
 
 extern int lcd_wid;
 extern int lcd_hgt;
 extern int lcd_cellwid;
 extern int lcd_cellhgt;
 
+/** How long something took, over its runs */
+typedef struct _mode_timing
+{
+	long count;		/**< Number of runs */
+	long min_ns;		/**< Shortest run */
+	long max_ns;		/**< Longest run */
+	long long total_ns;	/**< All runs together */
+} ModeTiming;
+
 /** Screen data structure */
 typedef struct _screen_mode
 {
@@ -54,12 +64,21 @@ typedef struct _screen_mode
 	int timer;		/**< Time since last update */
 	int flags;		/**< See mode flags defines */
 	int (*func)(int,int,int *);	/**< Pointer to init / update function */
+	long last_update;	/**< Time unit of the last update */
+	long next_update;	/**< Time unit when the next update is due */
+	ModeTiming timing;	/**< Duration of the updates, if timing is on */
+	unsigned int shown_on;	/**< Servers showing it, a bit each */
 } ScreenMode;
 
+extern ScreenMode sequence[];
+
+#define TIME_UNIT	125000	/**< 1/8th second is a single time unit. */
+
 /* mode flags */
 #define VISIBLE 	0x00000001	/**< currently visible */
 #define ACTIVE 		0x00000002	/**< selected for display */
 #define INITIALIZED	0x00000004	/**< screen had already been initialized */
+#define HISTORY		0x00000008	/**< collects history also while not visible */
 
 #define BLINK_ON	0x10
 #define BLINK_OFF	0x11
@@ -20,6 +20,7 @@
 #include <dirent.h>
 
 #include "shared/sockets.h"
+#include "shared/lcdclient.h"
 #include "shared/LL.h"
 
 #include "main.h"
@@ -62,8 +63,8 @@ mem_screen(int rep, int display, int *flags_ptr)
 	if ((*flags_ptr & INITIALIZED) == 0) {
 		*flags_ptr |= INITIALIZED;
 
-		sock_send_string(sock, "screen_add M\n");
-		sock_printf(sock, "screen_set M -name {Memory & Swap: %s}\n", get_hostname());
+		lcd_client_send(sock, "screen_add M\n");
+		lcd_client_printf(sock, "screen_set M -name {Memory & Swap: %s}\n", get_hostname());
 
 		title_sep_wid = (lcd_wid >= 16) ? lcd_wid - 16 : 0;
 
@@ -75,14 +76,14 @@ mem_screen(int rep, int display, int *flags_ptr)
 			label_wid = (title_sep_wid >= 4) ? 4 : title_sep_wid;
 			label_offs = (lcd_wid - label_wid) / 2 + 1;
 
-			sock_send_string(sock, "widget_add M title title\n");
-			sock_printf(sock, "widget_set M title { MEM %.*s SWAP}\n", title_sep_wid, title_sep);
-			sock_send_string(sock, "widget_add M totl string\n");
-			sock_send_string(sock, "widget_add M free string\n");
-			sock_printf(sock, "widget_set M totl %i 2 %.*s\n", label_offs, label_wid, "Totl");
-			sock_printf(sock, "widget_set M free %i 3 %.*s\n", label_offs, label_wid, "Free");
-			sock_send_string(sock, "widget_add M memused string\n");
-			sock_send_string(sock, "widget_add M swapused string\n");
+			lcd_client_send(sock, "widget_add M title title\n");
+			lcd_client_printf(sock, "widget_set M title { MEM %.*s SWAP}\n", title_sep_wid, title_sep);
+			lcd_client_send(sock, "widget_add M totl string\n");
+			lcd_client_send(sock, "widget_add M free string\n");
+			lcd_client_printf(sock, "widget_set M totl %i 2 %.*s\n", label_offs, label_wid, "Totl");
+			lcd_client_printf(sock, "widget_set M free %i 3 %.*s\n", label_offs, label_wid, "Free");
+			lcd_client_send(sock, "widget_add M memused string\n");
+			lcd_client_send(sock, "widget_add M swapused string\n");
 		}
 		else {
 			if (lcd_wid >= 20) {
@@ -98,16 +99,16 @@ mem_screen(int rep, int display, int *flags_ptr)
 				gauge_wid = gauge_offs = 0;
 			}
 
-			sock_send_string(sock, "widget_add M m string\n");
-			sock_send_string(sock, "widget_add M s string\n");
-			sock_send_string(sock, "widget_set M m 1 1 {M}\n");
-			sock_send_string(sock, "widget_set M s 1 2 {S}\n");
-			sock_send_string(sock, "widget_add M mem% string\n");
-			sock_send_string(sock, "widget_add M swap% string\n");
+			lcd_client_send(sock, "widget_add M m string\n");
+			lcd_client_send(sock, "widget_add M s string\n");
+			lcd_client_send(sock, "widget_set M m 1 1 {M}\n");
+			lcd_client_send(sock, "widget_set M s 1 2 {S}\n");
+			lcd_client_send(sock, "widget_add M mem% string\n");
+			lcd_client_send(sock, "widget_add M swap% string\n");
 		}
 
-		sock_send_string(sock, "widget_add M memtotl string\n");
-		sock_send_string(sock, "widget_add M swaptotl string\n");
+		lcd_client_send(sock, "widget_add M memtotl string\n");
+		lcd_client_send(sock, "widget_add M swaptotl string\n");
 
 		pbar_widget_add("M", "memgauge");
 		pbar_widget_add("M", "swapgauge");
@@ -117,10 +118,10 @@ mem_screen(int rep, int display, int *flags_ptr)
 		/* flip the title back and forth... (every 4 updates) */
 		if (which_title & 4) {
 			if (get_hostname()[0] != '\0')
-				sock_printf(sock, "widget_set M title {%s}\n", get_hostname());
+				lcd_client_printf(sock, "widget_set M title {%s}\n", get_hostname());
 		}
 		else {
-			sock_printf(sock, "widget_set M title { MEM %.*s SWAP}\n", title_sep_wid, title_sep);
+			lcd_client_printf(sock, "widget_set M title { MEM %.*s SWAP}\n", title_sep_wid, title_sep);
 		}
 		which_title = (which_title + 1) & 7;
 	}
@@ -135,19 +136,19 @@ mem_screen(int rep, int display, int *flags_ptr)
 
 		/* Total memory */
 		sprintf_memory(tmp, mem[0].total * 1024.0, 1);
-		sock_printf(sock, "widget_set M memtotl 1 2 {%7s}\n", tmp);
+		lcd_client_printf(sock, "widget_set M memtotl 1 2 {%7s}\n", tmp);
 
 		/* Free memory (plus buffers and cache) */
 		sprintf_memory(tmp, (mem[0].free + mem[0].buffers + mem[0].cache) * 1024.0, 1);
-		sock_printf(sock, "widget_set M memused 1 3 {%7s}\n", tmp);
+		lcd_client_printf(sock, "widget_set M memused 1 3 {%7s}\n", tmp);
 
 		/* Total swap */
 		sprintf_memory(tmp, mem[1].total * 1024.0, 1);
-		sock_printf(sock, "widget_set M swaptotl %i 2 {%7s}\n", lcd_wid - 7, tmp);
+		lcd_client_printf(sock, "widget_set M swaptotl %i 2 {%7s}\n", lcd_wid - 7, tmp);
 
 		/* Free swap */
 		sprintf_memory(tmp, mem[1].free * 1024.0, 1);
-		sock_printf(sock, "widget_set M swapused %i 3 {%7s}\n", lcd_wid - 7, tmp);
+		lcd_client_printf(sock, "widget_set M swapused %i 3 {%7s}\n", lcd_wid - 7, tmp);
 
 		if (gauge_wid > 0) {
 			/* Free memory graph */
@@ -171,11 +172,11 @@ mem_screen(int rep, int display, int *flags_ptr)
 
 		/* Total memory */
 		sprintf_memory(tmp, mem[0].total * 1024.0, 1);
-		sock_printf(sock, "widget_set M memtotl 3 1 {%6s}\n", tmp);
+		lcd_client_printf(sock, "widget_set M memtotl 3 1 {%6s}\n", tmp);
 
 		/* Total swap */
 		sprintf_memory(tmp, mem[1].total * 1024.0, 1);
-		sock_printf(sock, "widget_set M swaptotl 3 2 {%6s}\n", tmp);
+		lcd_client_printf(sock, "widget_set M swaptotl 3 2 {%6s}\n", tmp);
 
 		/* Free memory graph */
 		strcpy(tmp, "N/A");
@@ -188,7 +189,7 @@ mem_screen(int rep, int display, int *flags_ptr)
 
 			sprintf_percent(tmp, value * 100);
 		}
-		sock_printf(sock, "widget_set M mem%% %i 1 {%5s}\n", lcd_wid - 5, tmp);
+		lcd_client_printf(sock, "widget_set M mem%% %i 1 {%5s}\n", lcd_wid - 5, tmp);
 
 		/* Free swap graph */
 		strcpy(tmp, "N/A");
@@ -200,29 +201,78 @@ mem_screen(int rep, int display, int *flags_ptr)
 
 			sprintf_percent(tmp, value * 100);
 		}
-		sock_printf(sock, "widget_set M swap%% %i 2 {%5s}\n", lcd_wid - 5, tmp);
+		lcd_client_printf(sock, "widget_set M swap%% %i 2 {%5s}\n", lcd_wid - 5, tmp);
 	}
 
 	return 0;
 }
 
 
+/** Restore the min-heap of top[] below position i, by memory usage. */
+static void
+heap_down(procinfo_type **top, int count, int i)
+{
+	for (;;) {
+		int smallest = i;
+		int child = 2 * i + 1;
+		procinfo_type *tmp;
+
+		if ((child < count) && (top[child]->totl < top[smallest]->totl))
+			smallest = child;
+		if ((child + 1 < count) && (top[child + 1]->totl < top[smallest]->totl))
+			smallest = child + 1;
+		if (smallest == i)
+			return;
+		tmp = top[i];
+		top[i] = top[smallest];
+		top[smallest] = tmp;
+		i = smallest;
+	}
+}
+
+
 /**
- * Compares memory usage two procinfo structures and returns 1 (true) if the
- * second one's is larger than the first one's, 0 (false) otherwise.
+ * Finds the processes using the most memory, keeping the largest n seen
+ * so far in a min-heap rather than sorting the whole list.
+ * \param procs  List of procinfo_type.
+ * \param top    Array of n entries to store the result in, the largest
+ *               first.
+ * \param n      Size of the array.
+ * \return  Number of entries stored.
  */
 static int
-sort_procs(void *a, void *b)
+top_procs(LinkedList *procs, procinfo_type **top, int n)
 {
-	procinfo_type *one, *two;
+	int count = 0;
+	int i;
 
-	if ((a == NULL) || (b == NULL))
-		return 0;
+	LL_Rewind(procs);
+	do {
+		procinfo_type *p = LL_Get(procs);
 
-	one = (procinfo_type *) a;
-	two = (procinfo_type *) b;
+		if (p == NULL)
+			continue;
+		if (count < n) {
+			/* Sift the new entry up */
+			for (i = count++; (i > 0) && (top[(i - 1) / 2]->totl > p->totl); i = (i - 1) / 2)
+				top[i] = top[(i - 1) / 2];
+			top[i] = p;
+		}
+		else if ((n > 0) && (p->totl > top[0]->totl)) {
+			top[0] = p;
+			heap_down(top, count, 0);
+		}
+	} while (LL_Next(procs) == 0);
 
-	return (two->totl > one->totl);
+	/* Take the smallest off the heap to the end, leaving them sorted */
+	for (i = count - 1; i > 0; i--) {
+		procinfo_type *tmp = top[0];
+
+		top[0] = top[i];
+		top[i] = tmp;
+		heap_down(top, i, 0);
+	}
+	return count;
 }
 
 
@@ -249,7 +299,8 @@ int
 mem_top_screen(int rep, int display, int *flags_ptr)
 {
 	LinkedList *procs;
-	int lines;
+	procinfo_type **top;
+	int lines, count;
 	int i;
 
 	/* On screen <= 4 lines show info for 5 processes and use scrolling */
@@ -271,24 +322,24 @@ mem_top_screen(int rep, int display, int *flags_ptr)
 	if ((*flags_ptr & INITIALIZED) == 0) {
 		*flags_ptr |= INITIALIZED;
 
-		sock_send_string(sock, "screen_add S\n");
-		sock_printf(sock, "screen_set S -name {Top Memory Use: %s}\n", get_hostname());
-		sock_send_string(sock, "widget_add S title title\n");
-		sock_printf(sock, "widget_set S title {TOP MEM:%s}\n", get_hostname());
+		lcd_client_send(sock, "screen_add S\n");
+		lcd_client_printf(sock, "screen_set S -name {Top Memory Use: %s}\n", get_hostname());
+		lcd_client_send(sock, "widget_add S title title\n");
+		lcd_client_printf(sock, "widget_set S title {TOP MEM:%s}\n", get_hostname());
 
 		/* frame from (2nd line, left) to (last line, right) */
-		sock_send_string(sock, "widget_add S f frame\n");
+		lcd_client_send(sock, "widget_add S f frame\n");
 
 		/* scroll rate: 1 line every X ticks (= 1/8 sec) */
-		sock_printf(sock, "widget_set S f 1 2 %i %i %i %i v %i\n",
+		lcd_client_printf(sock, "widget_set S f 1 2 %i %i %i %i v %i\n",
 			    lcd_wid, lcd_hgt, lcd_wid, lines,
 			    ((lcd_hgt >= 4) ? 8 : 12));
 
 		/* frame contents */
 		for (i = 1; i <= lines; i++) {
-			sock_printf(sock, "widget_add S %i string -in f\n", i);
+			lcd_client_printf(sock, "widget_add S %i string -in f\n", i);
 		}
-		sock_send_string(sock, "widget_set S 1 1 1 Checking...\n");
+		lcd_client_send(sock, "widget_set S 1 1 1 Checking...\n");
 	}
 
 	if (!display)
@@ -308,11 +359,10 @@ mem_top_screen(int rep, int display, int *flags_ptr)
 	 */
 
 	/* Now, print some info... */
-	LL_Rewind(procs);
-	LL_Sort(procs, sort_procs);
-	LL_Rewind(procs);
+	top = malloc(lines * sizeof(procinfo_type *));
+	count = (top != NULL) ? top_procs(procs, top, lines) : 0;
 	for (i = 1; i <= lines; i++) {
-		procinfo_type *p = LL_Get(procs);
+		procinfo_type *p = (i <= count) ? top[i - 1] : NULL;
 
 		if (p != NULL) {
 			char mem[10];
@@ -320,18 +370,17 @@ mem_top_screen(int rep, int display, int *flags_ptr)
 			sprintf_memory(mem, (double) p->totl * 1024.0, 1);
 
 			if (p->number > 1)
-				sock_printf(sock, "widget_set S %i 1 %i {%i %5s %s(%i)}\n",
+				lcd_client_printf(sock, "widget_set S %i 1 %i {%i %5s %s(%i)}\n",
 					    i, i, i, mem, p->name, p->number);
 			else
-				sock_printf(sock, "widget_set S %i 1 %i {%i %5s %s}\n",
+				lcd_client_printf(sock, "widget_set S %i 1 %i {%i %5s %s}\n",
 					    i, i, i, mem, p->name);
 		}
 		else {
-			sock_printf(sock, "widget_set S %i 1 %i { }\n", i, i);
+			lcd_client_printf(sock, "widget_set S %i 1 %i { }\n", i, i);
 		}
-
-		LL_Next(procs);
 	}
+	free(top);
 
 	/* Delete the process list */
 	LL_Rewind(procs);
@@ -0,0 +1,310 @@
+/** \file clients/lcdproc/metrics.c
+ * Implements the 'Metrics' screen: values that other programs publish.
+ *
+ * Programs send datagrams to a UNIX domain socket of lcdproc. Each line of
+ * a datagram sets a metric, as "key value" or "key=value". The lines of
+ * the screen are templates from the config file in which {key} stands for
+ * the value of a metric. A service publishes its numbers with a single
+ * sendto(); nothing is started per update, and lines whose text did not
+ * change are not sent to the server again.
+ */
+
+/*-
+ * This file is part of lcdproc, the lcdproc client.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "shared/configfile.h"
+#include "shared/sockets.h"
+#include "shared/lcdclient.h"
+#include "shared/report.h"
+#include "shared/hash.h"
+
+#include "main.h"
+#include "mode.h"
+#include "metrics.h"
+
+#if !defined(PIDFILEDIR)
+# define PIDFILEDIR	"/var/run"
+#endif
+
+/** Default socket to receive the metrics on */
+#define DEFAULT_METRICS_SOCKET	PIDFILEDIR "/lcdproc-metrics.sock"
+/** Most metrics kept; further keys are ignored */
+#define MAX_METRICS		256
+/** Most lines of the screen */
+#define MAX_METRIC_LINES	16
+#define MAX_KEY			32
+#define MAX_VALUE		64
+
+/** A metric and its last value */
+typedef struct Metric {
+	char key[MAX_KEY];
+	char value[MAX_VALUE];
+} Metric;
+
+static HashTable *metrics = NULL;
+static int metric_count = 0;
+static int metrics_fd = -1;
+static char *socket_path = NULL;
+
+static char *templates[MAX_METRIC_LINES];
+static char *shown[MAX_METRIC_LINES];	/* text of the lines on the server */
+static int line_count = 0;
+
+
+/** Open the socket the metrics come in on. */
+static void
+metrics_open(void)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+
+	socket_path = strdup(config_get_string("Metrics", "Socket", 0, DEFAULT_METRICS_SOCKET));
+	if ((socket_path == NULL) || (strlen(socket_path) >= sizeof(addr.sun_path))) {
+		report(RPT_ERR, "Metrics: invalid socket path");
+		return;
+	}
+
+	/* A socket left by an earlier run is in the way */
+	if ((lstat(socket_path, &st) == 0) && S_ISSOCK(st.st_mode))
+		unlink(socket_path);
+
+	metrics_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (metrics_fd < 0) {
+		report(RPT_ERR, "Metrics: socket failed: %s", strerror(errno));
+		return;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path);
+	if (bind(metrics_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		report(RPT_ERR, "Metrics: cannot bind %s: %s", socket_path, strerror(errno));
+		close(metrics_fd);
+		metrics_fd = -1;
+		return;
+	}
+	report(RPT_INFO, "Metrics: receiving on %s", socket_path);
+}
+
+
+/** Close the socket and remove it. */
+void
+metrics_close(void)
+{
+	if (metrics_fd < 0)
+		return;
+	close(metrics_fd);
+	metrics_fd = -1;
+	unlink(socket_path);
+}
+
+
+/**
+ * Store a "key value" or "key=value" line.
+ * \return  1 if a value changed, 0 if not.
+ */
+static int
+metrics_set(char *line)
+{
+	size_t key_len = strcspn(line, " \t=");
+	char *value = line + key_len;
+	Metric *m;
+	char *p;
+
+	if ((key_len == 0) || (key_len >= MAX_KEY) || (*value == '\0'))
+		return 0;
+	*value++ = '\0';
+	value += strspn(value, " \t=");
+	value[strcspn(value, "\r")] = '\0';
+
+	/* The value goes into a {} quoted string: keep it so */
+	for (p = value; *p != '\0'; p++) {
+		if (*p == '{')
+			*p = '(';
+		else if (*p == '}')
+			*p = ')';
+	}
+
+	m = HT_Find(metrics, line);
+	if (m == NULL) {
+		if (metric_count >= MAX_METRICS)
+			return 0;
+		m = calloc(1, sizeof(*m));
+		if (m == NULL)
+			return 0;
+		strcpy(m->key, line);
+		if (HT_Insert(metrics, m->key, m) < 0) {
+			free(m);
+			return 0;
+		}
+		metric_count++;
+	}
+	else if (strncmp(m->value, value, MAX_VALUE - 1) == 0)
+		return 0;
+
+	strncpy(m->value, value, MAX_VALUE - 1);
+	m->value[MAX_VALUE - 1] = '\0';
+	return 1;
+}
+
+
+/**
+ * Take all datagrams that wait on the socket.
+ * \return  1 if a value changed, 0 if not.
+ */
+static int
+metrics_receive(void)
+{
+	char buf[4096];
+	ssize_t len;
+	int changed = 0;
+
+	while ((len = recv(metrics_fd, buf, sizeof(buf) - 1, 0)) >= 0) {
+		char *line, *next;
+
+		buf[len] = '\0';
+		for (line = buf; *line != '\0'; line = next) {
+			next = line + strcspn(line, "\n");
+			if (*next != '\0')
+				*next++ = '\0';
+			changed |= metrics_set(line);
+		}
+	}
+	return changed;
+}
+
+
+/**
+ * Fill a template: {key} becomes the value of the metric, or '-' for a
+ * metric that was not received yet.
+ */
+static void
+metrics_format(char *out, size_t size, const char *template)
+{
+	size_t len = 0;
+
+	while ((*template != '\0') && (len + 1 < size)) {
+		const char *end;
+
+		if ((*template == '{') && ((end = strchr(template, '}')) != NULL)
+		    && (end - template - 1 < MAX_KEY)) {
+			char key[MAX_KEY];
+			Metric *m;
+
+			memcpy(key, template + 1, end - template - 1);
+			key[end - template - 1] = '\0';
+			m = HT_Find(metrics, key);
+			len += snprintf(out + len, size - len, "%s", (m != NULL) ? m->value : "-");
+			if (len >= size)
+				len = size - 1;
+			template = end + 1;
+		}
+		else if ((*template == '}') || (*template == '{'))
+			template++;
+		else
+			out[len++] = *template++;
+	}
+	out[len] = '\0';
+}
+
+
+/**
+ * Metrics Screen shows the values other programs send, on lines laid out
+ * in the config file; more lines than fit scroll.
+ *
+ *\verbatim
+ *
+ * +--------------------+
+ * |## Metrics: myhos #@|
+ * |Req/s 1204  p99 31ms|
+ * |Queue 17            |
+ * |Errors 0            |
+ * +--------------------+
+ *
+ *\endverbatim
+ *
+ * \param rep        Time since last screen update
+ * \param display    1 if screen is visible or data should be updated
+ * \param flags_ptr  Mode flags
+ * \return  Always 0
+ */
+int
+metrics_screen(int rep, int display, int *flags_ptr)
+{
+	static int force = 1;
+	int lines = (lcd_hgt > 1) ? lcd_hgt - 1 : 1;
+	int i;
+
+	if ((*flags_ptr & INITIALIZED) == 0) {
+		const char *value;
+
+		*flags_ptr |= INITIALIZED;
+
+		metrics = HT_new();
+		while ((line_count < MAX_METRIC_LINES)
+		       && ((value = config_get_string("Metrics", "Line", line_count, NULL)) != NULL)) {
+			templates[line_count] = strdup(value);
+			shown[line_count] = NULL;
+			line_count++;
+		}
+		if (metrics != NULL)
+			metrics_open();
+
+		lcd_client_send(sock, "screen_add X\n");
+		lcd_client_printf(sock, "screen_set X -name {Metrics: %s}\n", get_hostname());
+		lcd_client_send(sock, "widget_add X title title\n");
+		lcd_client_printf(sock, "widget_set X title {%s}\n",
+				  config_get_string("Metrics", "Title", 0, "Metrics"));
+
+		/* frame from (2nd line, left) to (last line, right) */
+		lcd_client_send(sock, "widget_add X f frame\n");
+		lcd_client_printf(sock, "widget_set X f 1 2 %i %i %i %i v %i\n",
+				  lcd_wid, lcd_hgt, lcd_wid, (line_count > lines) ? line_count : lines,
+				  ((lcd_hgt >= 4) ? 8 : 12));
+		for (i = 1; i <= line_count; i++)
+			lcd_client_printf(sock, "widget_add X %i string -in f\n", i);
+		if (line_count == 0)
+			lcd_client_send(sock, "widget_add X 1 string -in f\n"
+					"widget_set X 1 1 1 {No Line= in [Metrics]}\n");
+	}
+
+	if (metrics_fd < 0)
+		return 0;
+
+	/* Take the values also while hidden, so they are fresh when shown */
+	if (metrics_receive())
+		force = 1;
+	if (!display || !force)
+		return 0;
+	force = 0;
+
+	for (i = 0; i < line_count; i++) {
+		char text[256];
+
+		metrics_format(text, sizeof(text), templates[i]);
+		if ((shown[i] != NULL) && (strcmp(shown[i], text) == 0))
+			continue;
+		lcd_client_printf(sock, "widget_set X %i 1 %i {%s}\n", i + 1, i + 1, text);
+		free(shown[i]);
+		shown[i] = strdup(text);
+	}
+
+	return 0;
+}
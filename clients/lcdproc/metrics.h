@@ -0,0 +1,7 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+int metrics_screen(int rep, int display, int *flags_ptr);
+void metrics_close(void);
+
+#endif
@@ -16,6 +16,7 @@
 #include <unistd.h>
 #include <sys/utsname.h>
 #include <string.h>
+#include <time.h>
 
 #ifdef HAVE_CONFIG_H
 # include "config.h"
@@ -26,14 +27,21 @@
 #endif
 
 #include "shared/sockets.h"
+#include "shared/lcdclient.h"
+#include "shared/report.h"
 
 #include "main.h"
 #include "mode.h"
 #include "machine.h"
+#include "metrics.h"
 #ifdef LCDPROC_EYEBOXONE
 # include "eyebox.h"
 #endif
 
+/** Measure how long the screens take to update ([lcdproc] Timing) */
+int mode_timing = FALSE;
+
+
 /** Initialize mode specific things. */
 int
 mode_init(void)
@@ -47,6 +55,7 @@ mode_init(void)
 void
 mode_close(void)
 {
+	metrics_close();
 	machine_close();
 }
 
@@ -67,11 +76,17 @@ update_screen(ScreenMode *m, int display)
 	int old_status = status;
 
 	if (m && m->func) {
+		struct timespec start;
 #ifdef LCDPROC_EYEBOXONE
 		/* Save the initialized flag (may be modified by m->func) */
 		int init_flag = (m->flags & INITIALIZED);
 #endif
+
+		if (mode_timing)
+			clock_gettime(CLOCK_MONOTONIC, &start);
 		status = m->func(m->timer, display, &(m->flags));
+		if (mode_timing)
+			timing_add(&m->timing, &start);
 #ifdef LCDPROC_EYEBOXONE
 		/* Eyebox Init */
 		if (init_flag == 0)
@@ -83,17 +98,74 @@ update_screen(ScreenMode *m, int display)
 
 	if (status != old_status) {
 		if (status == BACKLIGHT_OFF)
-			sock_send_string(sock, "backlight off\n");
+			lcd_client_send(sock, "backlight off\n");
 		if (status == BACKLIGHT_ON)
-			sock_send_string(sock, "backlight on\n");
+			lcd_client_send(sock, "backlight on\n");
 		if (status == BLINK_ON)
-			sock_send_string(sock, "backlight blink\n");
+			lcd_client_send(sock, "backlight blink\n");
 	}
 
 	return (status);
 }
 
 
+/**
+ * Account for a run that began at start.
+ * \param t      Accumulated durations
+ * \param start  CLOCK_MONOTONIC time the run began
+ */
+void
+timing_add(ModeTiming *t, const struct timespec *start)
+{
+	struct timespec now;
+	long ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = (now.tv_sec - start->tv_sec) * 1000000000L + (now.tv_nsec - start->tv_nsec);
+	if ((t->count == 0) || (ns < t->min_ns))
+		t->min_ns = ns;
+	if (ns > t->max_ns)
+		t->max_ns = ns;
+	t->total_ns += ns;
+	t->count++;
+}
+
+
+/** Report one line of timing, in microseconds. */
+static void
+report_timing_line(const char *name, const ModeTiming *t)
+{
+	report(RPT_NOTICE, "%-12s %8ld %10.1f %10.1f %10.1f %12.1f", name, t->count,
+	       t->min_ns / 1000.0, (double) t->total_ns / t->count / 1000.0,
+	       t->max_ns / 1000.0, t->total_ns / 1000.0);
+}
+
+
+/**
+ * Report how long the updates of each screen took so far, and how long
+ * sending them to the server took.
+ * \param send  Durations of sending the updates of a pass
+ */
+void
+mode_report_timing(const ModeTiming *send)
+{
+	int k;
+
+	if (!mode_timing) {
+		report(RPT_NOTICE, "Timing is off; set Timing=yes in [lcdproc]");
+		return;
+	}
+	report(RPT_NOTICE, "%-12s %8s %10s %10s %10s %12s", "Screen", "Updates",
+	       "Min us", "Avg us", "Max us", "Total us");
+	for (k = 0; sequence[k].which != 0; k++) {
+		if (sequence[k].timing.count > 0)
+			report_timing_line(sequence[k].longname, &sequence[k].timing);
+	}
+	if (send->count > 0)
+		report_timing_line("(send)", send);
+}
+
+
 /**
  * Credit Screen shows who wrote this...
  *
@@ -187,27 +259,27 @@ credit_screen(int rep, int display, int *flags_ptr)
 		for (contr_num = 0; contributors[contr_num] != NULL; contr_num++)
 			;	/* NADA */
 
-		sock_send_string(sock, "screen_add A\n");
-		sock_send_string(sock, "screen_set A -name {Credits for LCDproc}\n");
-		sock_send_string(sock, "widget_add A title title\n");
-		sock_printf(sock, "widget_set A title {LCDPROC %s}\n", version);
+		lcd_client_send(sock, "screen_add A\n");
+		lcd_client_send(sock, "screen_set A -name {Credits for LCDproc}\n");
+		lcd_client_send(sock, "widget_add A title title\n");
+		lcd_client_printf(sock, "widget_set A title {LCDPROC %s}\n", version);
 		if (lcd_hgt >= 4) {
-			sock_send_string(sock, "widget_add A text scroller\n");
-			sock_printf(sock, "widget_set A text 1 2 %d 2 h 8 {%s}\n",
+			lcd_client_send(sock, "widget_add A text scroller\n");
+			lcd_client_printf(sock, "widget_set A text 1 2 %d 2 h 8 {%s}\n",
 				    lcd_wid, "LCDproc was brought to you by:");
 		}
 
 		/* frame from (2nd/3rd line, left) to (last line, right) */
-		sock_send_string(sock, "widget_add A f frame\n");
-		sock_printf(sock, "widget_set A f 1 %i %i %i %i %i v %i\n",
+		lcd_client_send(sock, "widget_add A f frame\n");
+		lcd_client_printf(sock, "widget_set A f 1 %i %i %i %i %i v %i\n",
 			    ((lcd_hgt >= 4) ? 3 : 2), lcd_wid, lcd_hgt, lcd_wid, contr_num,
 			    /* scroll rate: 1 line every X ticks (= 1/8 sec) */
 			    ((lcd_hgt >= 4) ? 8 : 12));
 
 		/* frame contents */
 		for (i = 1; i < contr_num; i++) {
-			sock_printf(sock, "widget_add A c%i string -in f\n", i);
-			sock_printf(sock, "widget_set A c%i 1 %i {%s}\n", i, i, contributors[i]);
+			lcd_client_printf(sock, "widget_add A c%i string -in f\n", i);
+			lcd_client_printf(sock, "widget_set A c%i 1 %i {%s}\n", i, i, contributors[i]);
 		}
 	}
 
@@ -1,9 +1,15 @@
 #ifndef MODE_H
 #define MODE_H
 
+#include <time.h>
+
+extern int mode_timing;
+
 int mode_init(void);
 void mode_close(void);
 int update_screen(ScreenMode *m, int display);
+void timing_add(ModeTiming *t, const struct timespec *start);
+void mode_report_timing(const ModeTiming *send);
 int credit_screen(int rep, int display, int *flags_ptr);
 
 #endif
@@ -22,6 +22,7 @@
 
 #include <sys/types.h>
 #include "shared/sockets.h"
+#include "shared/lcdclient.h"
 #include "main.h"
 #include "util.h"
 
@@ -110,13 +111,13 @@ pbar_widget_add(const char *screen, const char *name)
 {
 
 	if (check_protocol_version(0, 4)) {
-		sock_printf(sock, "widget_add %s %s pbar\n", screen, name);
+		lcd_client_printf(sock, "widget_add %s %s pbar\n", screen, name);
 	} else {
-		sock_printf(sock, "widget_add %s %s-begin-label string\n",
+		lcd_client_printf(sock, "widget_add %s %s-begin-label string\n",
 			    screen, name);
-		sock_printf(sock, "widget_add %s %s hbar\n",
+		lcd_client_printf(sock, "widget_add %s %s hbar\n",
 			    screen, name);
-		sock_printf(sock, "widget_add %s %s-end-label string\n",
+		lcd_client_printf(sock, "widget_add %s %s-end-label string\n",
 			    screen, name);
 	}
 }
@@ -142,12 +143,12 @@ pbar_widget_set(const char *screen, const char *name, int x, int y, int width,
 
 	if (check_protocol_version(0, 4)) {
 		if (begin_label || end_label)
-			sock_printf(sock, "widget_set %s %s %d %d %d %d {%s} {%s}\n",
+			lcd_client_printf(sock, "widget_set %s %s %d %d %d %d {%s} {%s}\n",
 				    screen, name, x, y, width, promille,
 				    begin_label ? begin_label : "",
 				    end_label ? end_label : "");
 		else
-			sock_printf(sock, "widget_set %s %s %d %d %d %d\n",
+			lcd_client_printf(sock, "widget_set %s %s %d %d %d %d\n",
 				    screen, name, x, y, width, promille);
 		return;
 	}
@@ -180,17 +181,17 @@ pbar_widget_set(const char *screen, const char *name, int x, int y, int width,
 
 	len = width - begin_length - end_length;
 
-	sock_printf(sock, "widget_set %s %s-begin-label %d %d {%s}\n",
+	lcd_client_printf(sock, "widget_set %s %s-begin-label %d %d {%s}\n",
 		    screen, name, x, y, begin_label);
 	x += begin_length;
 
 	/* hbar takes number of pixels to fill as 3th argument */
 	hbar_pixels = (promille * lcd_cellwid * len + 500) / 1000;
-	sock_printf(sock, "widget_set %s %s %d %d %d\n",
+	lcd_client_printf(sock, "widget_set %s %s %d %d %d\n",
 		    screen, name, x, y, hbar_pixels);
 	x += len;
 
-	sock_printf(sock, "widget_set %s %s-end-label %d %d {%s}\n",
+	lcd_client_printf(sock, "widget_set %s %s-end-label %d %d {%s}\n",
 		    screen, name, x, y, end_label);
 }
 
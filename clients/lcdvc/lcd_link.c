@@ -27,6 +27,7 @@
 #include "shared/report.h"
 #include "shared/str.h"
 #include "shared/sockets.h"
+#include "shared/lcdclient.h"
 
 char *address = UNSET_STR;
 int port = UNSET_INT;
@@ -44,8 +45,33 @@ short last_vc_cursor_x = 0;
 short last_lcd_cursor_x = 0;
 short last_lcd_cursor_y = 0;
 
-static int read_connect_string(void);
-static int split(char *str, char delim, char *parts[], int maxparts);
+/** Room for a widget_set command besides the characters of its line */
+#define LINE_CMD_SIZE	48
+/** Commands for the changed lines of an update */
+static char *line_buf = NULL;
+
+/** A console character as it is put into a "" string, and its length */
+static char escaped[256][2];
+static char escaped_len[256];
+
+
+/** Fill the table for putting console characters into "" strings. */
+static void init_escaped(void)
+{
+	int c;
+
+	for (c = 0; c < 256; c++) {
+		if ((c == '\\') || (c == '\"')) {
+			escaped[c][0] = '\\'; /* add escape char */
+			escaped[c][1] = c;
+			escaped_len[c] = 2;
+		}
+		else {
+			escaped[c][0] = ((c >= 32) && (c < 128)) ? c : '?';
+			escaped_len[c] = 1;
+		}
+	}
+}
 
 
 int setup_connection(void)
@@ -54,24 +80,23 @@ int setup_connection(void)
 	int i;
 	int e = 0;
 	short line;
+	LCDServerInfo info;
 
 	report(RPT_INFO, "Connecting to %s:%d", address, port);
 
-	sock = sock_connect(address, port);
+	sock = lcd_client_connect(address, port, &info);
 	if (sock < 0) {
 		report(RPT_ERR, "Connecting to %s:%d failed", address, port);
 		return -1;
 	}
-	/* Create our menu */
-	sock_send_string(sock, "hello\n");
-	if (read_connect_string() < 0) {
-		return -1;
-	}
+	lcd_width = info.wid;
+	lcd_height = info.hgt;
 
 	snprintf(buf, sizeof(buf)-1, "client_set -name \"%s\"\n", progname);
 	sock_send_string(sock, buf);
 
-	/* Create screen */
+	/* Create screen, sent at once with the menu and keys */
+	sock_cork(sock);
 	CHAIN(e, sock_send_string(sock, "screen_add console\n"));
 	for (line = 0; line < lcd_height; line++) {
 		snprintf(buf, sizeof(buf)-1, "widget_add console line%d string\n", line);
@@ -88,6 +113,8 @@ int setup_connection(void)
 		snprintf(buf, sizeof(buf)-1, "client_add_key \"%s\"\n", keys[i]);
 		CHAIN(e, sock_send_string(sock, buf));
 	}
+	if (sock_uncork(sock) < 0)
+		e = -1;
 
 	if (e < 0) {
 		report(RPT_ERR, "Could not send to to LCDd");
@@ -106,85 +133,47 @@ int teardown_connection(void)
 }
 
 
-static int read_connect_string(void)
-{
-	char buf[8192];
-	int len = 0;
-	int a;
-	char *argv[20];
-	int argc;
-	short received = 0;
-	short timeout = 50; /* Give the server 5 secs to respond */
-
-	buf[0] = '\0';
-
-	while (!received && timeout > 0) {
-		len = sock_recv_string(sock, buf, sizeof(buf));
-		if (len == 0) {
-			usleep(100000);
-			timeout --;
-		} else {
-			received = 1;
-		}
-	}
-	report(RPT_INFO, "Received: %s", buf);
-
-	if (len <= 0) {
-		report(RPT_ERR, "Did not receive LCDd connect response.");
-		return -1;
-	}
-
-	argc = split(buf, ' ', argv, 20);
-	for (a = 1; a < argc; a++) {
-		if (0 == strcmp(argv[a], "wid"))
-			lcd_width = atoi(argv[++a]);
-		else if (0 == strcmp(argv[a], "hgt"))
-			lcd_height = atoi(argv[++a]);
-	}
-	if (argc <= 0 || strcmp(argv[0], "connect") != 0
-	|| lcd_width == 0 || lcd_width == 0) {
-		report(RPT_ERR, "Received invalid LCDd connect response.");
-		return -1;
-	}
-	return 0;
-}
-
-
 /**
- * Splits a string into parts, to which pointers will be returned in &parts.
- * The return value is the number of parts.
- * maxparts is the maximum number of parts returned. If more parts exist
- * they are (unsplit) in the last part.
- * The parts are split at the character delim.
- * No new space will be allocated, the string str will be mutated !
+ * Read a line the server sent. Lines may come in parts; what came of a
+ * line is kept until the rest arrives.
+ * \param buf      Where to put the line, without the newline.
+ * \param maxsize  Its size; longer lines are cut.
+ * \return  Length of the line plus 1, 0 if no complete line came yet,
+ *          -1 if the server closed the connection or on error.
  */
-static int split(char *str, char delim, char *parts[], int maxparts)
+int read_response(char *buf, int maxsize)
 {
-	char *p1 = str;
-	char *p2;
-	int part_nr = 0;
-
-	/* Find the delim char to end the current part */
-	while (part_nr < maxparts - 1 && (p2 = strchr(p1, delim))) {
-
-		/* subsequent parts... */
-		*p2 = 0;
-		parts[part_nr] = p1;
+	static char input[1024];
+	static int buffered = 0;
+	int len;
+
+	while (1) {
+		char *nl = memchr(input, '\n', buffered);
+
+		if (nl != NULL) {
+			int line_len = nl - input;
+			int copy = (line_len < maxsize - 1) ? line_len : maxsize - 1;
+
+			memcpy(buf, input, copy);
+			buf[copy] = '\0';
+			buffered -= line_len + 1;
+			memmove(input, nl + 1, buffered);
+			if (line_len > 0)
+				return copy + 1;
+			continue;	/* empty line */
+		}
+		if (buffered == sizeof(input)) {
+			report(RPT_WARNING, "Line from server too long, dropped");
+			buffered = 0;
+		}
 
-		p1 = p2 + 1; /* Just after the delim char */
-		part_nr ++;
+		len = sock_recv(sock, input + buffered, sizeof(input) - buffered);
+		if (len == 0)
+			return -1;
+		if (len < 0)
+			return ((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1;
+		buffered += len;
 	}
-	/* and the last part... */
-	parts[part_nr] = p1;
-	part_nr ++;
-
-	return part_nr;
-}
-
-
-int read_response(char *buf, int maxsize)
-{
-	return sock_recv_string(sock, buf, maxsize);
 }
 
 
@@ -266,23 +255,40 @@ int process_response(char *str)
 }
 
 
+/**
+ * Read the part of the console the display shows and send what changed.
+ * While the screen is not shown only the cursor position is read.
+ * \return  1 if the console changed, 0 if not, -1 on error.
+ */
 int update_display(void)
 {
-	//int bytes_read;
 	short line;
 	int e = 0;
+	int changed, lines_changed;
 	char buf[80];
-	char *str_buf;
+	char *a;
 	short num_lines;
-	num_lines = min(lcd_height, vc_height);
 
+	changed = read_vcinfo();
+	if (changed < 0)
+		return -1;
 	if (!listening)
 		return 0;
+	num_lines = min(lcd_height, vc_height);
 
 	if (!lcd_buf) {
 		/* Not yet allocated */
 		lcd_buf = malloc(lcd_width * lcd_height);
+		line_buf = malloc(lcd_height * (LINE_CMD_SIZE + 2 * lcd_width));
+		if ((lcd_buf == NULL) || (line_buf == NULL)) {
+			report(RPT_ERR, "malloc failure: %s", strerror(errno));
+			free(lcd_buf);
+			free(line_buf);
+			lcd_buf = line_buf = NULL;
+			return -1;
+		}
 		memset(lcd_buf, ' ', lcd_width * lcd_height);
+		init_escaped();
 	}
 
 	if (autoscroll
@@ -300,6 +306,15 @@ int update_display(void)
 		if (scroll_y < vc_cursor_y - lcd_height + 1)
 			scroll_y = vc_cursor_y - lcd_height + 1;
 	}
+
+	/* Read only the lines that are shown */
+	lines_changed = read_vclines(scroll_y, num_lines);
+	if (lines_changed < 0)
+		return -1;
+
+	/* The changes go to the server at once */
+	sock_cork(sock);
+
 	lcd_cursor_x = vc_cursor_x - scroll_x + 1;
 	lcd_cursor_y = vc_cursor_y - scroll_y + 1;
 	if (lcd_cursor_x != last_lcd_cursor_x || lcd_cursor_y != last_lcd_cursor_y) {
@@ -318,8 +333,8 @@ int update_display(void)
 		CHAIN(e, sock_send_string(sock, buf));
 	}
 
-	/* Send all (changed) lines */
-	str_buf = malloc(80 + 2 * lcd_width);
+	/* Send all (changed) lines, together with the cursor */
+	a = line_buf;
 	for (line = 0; line < num_lines; line++) {
 
 		char *vc_p;
@@ -334,46 +349,35 @@ int update_display(void)
 
 		/* Has the line data changed ? */
 		if (memcmp(vc_p, lcd_p, line_width) != 0) {
-			/* Yes, so send it */
-			char *a;
+			/* Yes, so add it */
 			short pos;
 
 			/* Format/escape the data */
-			snprintf(str_buf, 80, "widget_set console line%d 1 %d \"", line, line+1);
-
-			a = str_buf + strlen(str_buf); /* start just after the " */
+			a += sprintf(a, "widget_set console line%d 1 %d \"", line, line+1);
 			for (pos = 0; pos < line_width; pos++) {
-				if (vc_p[pos] == '\\' || vc_p[pos] == '\"') {
-					*a++ = '\\'; /* add escape char */
-				}
-				if ((signed char) vc_p[pos] >= 32) {
-					*a++ = vc_p[pos]; /* add char */
-				} else {
-					*a++ = '?';
-				}
+				unsigned char c = vc_p[pos];
+
+				memcpy(a, escaped[c], 2);
+				a += escaped_len[c];
 			}
 			*a++ = '\"'; /* end string */
 			*a++ = '\n'; /* newline */
-			*a = 0; /* terminate */
-			CHAIN(e, sock_send_string(sock, str_buf));
 
 			/* And store the new data */
 			memcpy(lcd_p, vc_p, line_width);
 
 		}
 	}
-	free(str_buf);
+	if (a > line_buf)
+		CHAIN(e, sock_send(sock, line_buf, a - line_buf));
+	if (sock_uncork(sock) < 0)
+		e = -1;
 
 	if (e < 0) {
 		report(RPT_ERR, "Error while sending data to LCDd");
 		return -1;
 	}
 
-	return 0;
+	return (changed || lines_changed);
 }
 
-
-int send_nop(void)
-{
-	return sock_send_string(sock, "\n");
-}
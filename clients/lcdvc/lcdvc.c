@@ -21,6 +21,8 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <time.h>
+#include <poll.h>
 
 #include "getopt.h"
 
@@ -41,6 +43,9 @@
 #define DEFAULT_CONFIGFILE	SYSCONFDIR "/lcdvc.conf"
 #define DEFAULT_PIDFILE		PIDFILEDIR "/lcdvc.pid"
 
+#define POLL_MIN	50	/**< ms between reads of a changing console */
+#define POLL_MAX	800	/**< ms between reads of an idle console */
+
 
 char *help_text =
 "lcdvc - LCDproc virtual console\n"
@@ -266,30 +271,88 @@ static int process_configfile(char *configfile)
 }
 
 
+/** Monotonic time in ms. */
+static long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+
+/*
+ * The console is read when it changed: poll() tells so with POLLPRI on
+ * /dev/vcsa. Where the device gives no notification, it is read every
+ * POLL_MIN ms while it changes, and less often, up to every POLL_MAX ms,
+ * while it does not.
+ */
 static int main_loop(void)
 {
-	int num_bytes;
+	struct pollfd pfd[2];
+	struct stat st;
+	int num_bytes = 0;
 	char buf[80];
-	short w = 0;
+	int notify;
+	int interval = POLL_MIN;
+	int update = 1;
+	long next_read = 0;
+
+	notify = (fstat(vcsa, &st) == 0) && S_ISCHR(st.st_mode);
+
+	while (!Quit) {
+		long now;
+		int timeout;
+
+		if (update) {
+			int changed = update_display();
+
+			if (!notify) {
+				if (changed > 0)
+					interval = POLL_MIN;
+				else if (interval < POLL_MAX)
+					interval = min(interval * 2, POLL_MAX);
+				next_read = now_ms() + interval;
+			}
+			update = 0;
+		}
 
-	/* Continuously check if we get a menu event... */
+		/* A lost server shows as an error on the socket: it is
+		 * probed by TCP keepalive, see sock_set_keepalive() */
+		now = now_ms();
+		timeout = (notify) ? -1 : max(next_read - now, 0);
+
+		pfd[0].fd = sock;
+		pfd[0].events = POLLIN;
+		pfd[0].revents = 0;
+		pfd[1].fd = vcsa;
+		pfd[1].events = POLLPRI;
+		pfd[1].revents = 0;
+		if (poll(pfd, notify ? 2 : 1, timeout) < 0) {
+			if (errno == EINTR)
+				continue;
+			report(RPT_ERR, "poll failed: %s", strerror(errno));
+			break;
+		}
 
-	while (!Quit && ((num_bytes = read_response(buf, sizeof(buf)-1)) >= 0)) {
-		if (num_bytes != 0) {
-			process_response(buf);
+		if (!notify)
+			update = (now_ms() >= next_read);
+		else if (pfd[1].revents & (POLLERR | POLLNVAL)) {
+			report(RPT_INFO, "No change notification from %s, polling it", vcsa_device);
+			notify = 0;
+			update = 1;
 		}
-		else {
-			read_vcdata();
-			update_display();
-
-			/* Send an empty line every 3 seconds to make sure the server still exists */
-			if (w++ >= 60) {
-				w = 0;
-				if (send_nop() < 0) {
-					break; /* Out of while loop */
-				}
-			}
-			usleep(50000);
+		else if (pfd[1].revents & POLLPRI)
+			update = 1;
+
+		/* Continuously check if we get a menu event... */
+		if (pfd[0].revents) {
+			while ((num_bytes = read_response(buf, sizeof(buf))) > 0)
+				process_response(buf);
+			if (num_bytes < 0)
+				break;
+			/* Keys scroll; listen shows the screen */
+			update = 1;
 		}
 	}
 
@@ -49,23 +49,25 @@ int open_vcs(void)
 }
 
 
-int read_vcdata(void)
+/**
+ * Read the size of the console and the cursor position from /dev/vcsa.
+ * This also takes back a change notification of the device.
+ * \return  1 if they changed, 0 if not, -1 on error.
+ */
+int read_vcinfo(void)
 {
 	unsigned short new_vc_height;
 	unsigned short new_vc_width;
+	unsigned char buf[4];
+	int changed;
 
-	int bytes_read;
-	unsigned char buf[20];
-
-	/* Read size and cursor position from /dev/vcsa */
-	lseek(vcsa, 0, SEEK_SET);
-	bytes_read = read(vcsa, buf, 4);
-	if (bytes_read != 4) {
+	if (pread(vcsa, buf, 4, 0) != 4) {
 		report(RPT_ERR, "Could not read from %s", vcsa_device);
 		return -1;
 	}
 	new_vc_height = buf[0];
 	new_vc_width = buf[1];
+	changed = (vc_cursor_x != buf[2]) || (vc_cursor_y != buf[3]);
 	vc_cursor_x = buf[2];
 	vc_cursor_y = buf[3];
 
@@ -73,6 +75,7 @@ int read_vcdata(void)
 	if ((new_vc_width != vc_width) || (new_vc_height != vc_height)) {
 		vc_width = new_vc_width;
 		vc_height = new_vc_height;
+		changed = 1;
 
 		if (vc_width * vc_height > 0) {
 			vc_buf = realloc(vc_buf, vc_width * vc_height);
@@ -84,14 +87,47 @@ int read_vcdata(void)
 			memset(vc_buf, ' ', vc_width * vc_height);
 		}
 	}
+	return changed;
+}
+
+
+/**
+ * Read lines of the console from /dev/vcs into vc_buf; the other lines
+ * of vc_buf keep what they had.
+ * \param first      First line to read.
+ * \param num_lines  Number of lines.
+ * \return  1 if they changed, 0 if not, -1 on error.
+ */
+int read_vclines(int first, int num_lines)
+{
+	static char *buf = NULL;
+	static int buf_size = 0;
+	int offset, size;
+
+	if (first + num_lines > vc_height)
+		num_lines = vc_height - first;
+	if ((first < 0) || (num_lines <= 0) || (vc_buf == NULL))
+		return 0;
+	offset = vc_width * first;
+	size = vc_width * num_lines;
+
+	if (size > buf_size) {
+		char *new_buf = realloc(buf, size);
+
+		if (new_buf == NULL) {
+			report(RPT_ERR, "malloc failure: %s", strerror(errno));
+			return -1;
+		}
+		buf = new_buf;
+		buf_size = size;
+	}
 
-	/* Read characters from /dev/cvs0 */
-	lseek(vcs0, 0, SEEK_SET);
-	bytes_read = read(vcs0, vc_buf, vc_width * vc_height);
-	if (bytes_read != vc_width * vc_height) {
+	if (pread(vcs0, buf, size, offset) != size) {
 		report(RPT_ERR, "Could not read from %s", vcs_device);
 		return -1;
 	}
-	return 0;
+	if (memcmp(vc_buf + offset, buf, size) == 0)
+		return 0;
+	memcpy(vc_buf + offset, buf, size);
+	return 1;
 }
-
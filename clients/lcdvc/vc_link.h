@@ -4,8 +4,10 @@
 extern unsigned short vc_width, vc_height;
 extern unsigned short vc_cursor_x, vc_cursor_y;
 extern char *vc_buf;
+extern int vcsa;
 
 int open_vcs(void);
-int read_vcdata(void);
+int read_vcinfo(void);
+int read_vclines(int first, int num_lines);
 
 #endif
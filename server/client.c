@@ -14,19 +14,24 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <ctype.h>
 
 #ifdef HAVE_CONFIG_H
 # include "config.h"
 #endif
 
 #include "client.h"
+#include "clients.h"
 #include "screen.h"
 #include "screenlist.h"
 #include "render.h"
 #include "input.h"
 #include "menuscreens.h"
+#include "framesub.h"
 #include "shared/report.h"
-#include "shared/LL.h"
+#include "shared/vector.h"
+
+size_t client_memory_limit = 0;
 
 Client *client_create(int sock)
 {
@@ -43,27 +48,59 @@ Client *client_create(int sock)
 	/* Init struct members*/
 	c->sock = sock;
 	c->messages = NULL;
+	c->queued = 0;
 	c->backlight = BACKLIGHT_OPEN;
 	c->heartbeat = HEARTBEAT_OPEN;
 
 	/*Set up message list...*/
-	c->messages = LL_new();
+	c->messages = V_new();
 	if (!c->messages) {
 		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
 		free(c);
 		return NULL;
 	}
 
+	/* ...and the memory for everything the client creates */
+	c->pool = pool_new();
+	if (!c->pool) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		V_Destroy(c->messages);
+		free(c);
+		return NULL;
+	}
+
 	c->state = NEW;
 	c->name = NULL;
 	c->menu = NULL;
 
-	c->screenlist = LL_new();
+	c->screenlist = V_new();
 
 	if (!c->screenlist) {
 		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
 		return NULL;
 	}
+
+	c->screenhash = HT_new();
+	if (!c->screenhash) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		return NULL;
+	}
+	c->screenhandles = NULL;
+	c->screenhandles_size = 0;
+	c->use_handles = 0;
+	c->binary = 0;
+	c->deflate = 0;
+	c->utf8 = 0;
+	c->key_count = 0;
+	c->key_time = 0;
+	c->display = 0;
+	c->frame_ack = 0;
+	memset(&c->parse_time, 0, sizeof(c->parse_time));
+	c->commands = 0;
+	memset(&c->reply_time, 0, sizeof(c->reply_time));
+	memset(&c->event_render, 0, sizeof(c->event_render));
+	c->event_sent = 0;
+	c->event_replied = 0;
 	return c;
 }
 
@@ -73,6 +110,7 @@ client_destroy(Client *c)
 	Screen *s;
 	Menu *m;
 	char *str;
+	int i;
 
 	if (!c)
 		return -1;
@@ -81,21 +119,23 @@ client_destroy(Client *c)
 
 	/* Eat messages */
 	while ((str = client_get_message(c))) {
-		free(str);
+		pool_free(c->pool, str);
 	}
-	LL_Destroy(c->messages);
+	V_Destroy(c->messages);
 
 	/* Clean up the screenlist...*/
 	debug(RPT_DEBUG, "%s: Cleaning screenlist", __FUNCTION__);
 
-	for (s = LL_GetFirst(c->screenlist); s; s = LL_GetNext(c->screenlist)) {
+	for (i = 0; (s = V_Get(c->screenlist, i)) != NULL; i++) {
 		/* Free its memory...*/
 		screen_destroy(s);
 		/* Note that the screen is not removed from the list because
 		 * the list will be destroyed anyway...
 		 */
 	}
-	LL_Destroy(c->screenlist);
+	V_Destroy(c->screenlist);
+	HT_Destroy(c->screenhash);
+	free(c->screenhandles);
 
 	m = (Menu *) c->menu;
 	/* Destroy the client's menu, if it exists */
@@ -109,6 +149,9 @@ client_destroy(Client *c)
 	/* Forget client's key reservations */
 	input_release_client_keys(c);
 
+	/* Stop mirroring the display to it */
+	framesub_unsubscribe(c);
+
 	/* Close the socket */
 	close(c->sock);
 
@@ -119,6 +162,10 @@ client_destroy(Client *c)
 	if (c->name)
 		free(c->name);
 
+	/* Everything from the pool has been freed by now, but some memory
+	 * may still be held in its chunks */
+	pool_destroy(c->pool);
+
 	/* Remove structure */
 	free(c);
 
@@ -140,12 +187,67 @@ client_add_message(Client *c, char *message)
 	if (strlen(message) > 0) {
 		debug(RPT_DEBUG, "%s(c=[%d], message=\"%s\")", __FUNCTION__,
 			c->sock, message);
-		err = LL_Enqueue(c->messages, (void *) message);
+		err = V_Append(c->messages, (void *) message);
+		if (err == 0)
+			c->queued += strlen(message);
 	}
+	else
+		pool_free(c->pool, message);
 
 	return err;
 }
 
+/**
+ * Add a block of binary frames to the client's queue.
+ * \param c      The client.
+ * \param block  The block, starting with CLIENT_BINARY_HEADER; the queue
+ *               takes ownership of it.
+ * \retval <0    error.
+ * \retval  0    success.
+ */
+int
+client_add_binary_message(Client *c, char *block)
+{
+	if (!c)
+		return -1;
+	if (!block)
+		return -1;
+
+	if (V_Append(c->messages, (void *) block) < 0)
+		return -1;
+	c->queued += client_binary_length(block);
+	return 0;
+}
+
+/** Tell how many bytes of a message block count against MaxInputQueue. */
+static int
+client_message_length(const char *message)
+{
+	return client_message_is_binary(message) ? client_binary_length(message) : strlen(message);
+}
+
+/**
+ * Put a message back to the front of the client's queue, e.g. the
+ * unparsed rest of a message block.
+ * \param c        The client.
+ * \param message  The message, which the queue takes ownership of.
+ * \retval <0      error.
+ * \retval  0      success.
+ */
+int
+client_unget_message(Client *c, char *message)
+{
+	if (!c)
+		return -1;
+	if (!message)
+		return -1;
+
+	if (V_Prepend(c->messages, (void *) message) < 0)
+		return -1;
+	c->queued += client_message_length(message);
+	return 0;
+}
+
 /* Woo-hoo!  A simple function.  :)*/
 char *
 client_get_message(Client *c)
@@ -157,12 +259,22 @@ client_get_message(Client *c)
 	if (!c)
 		return NULL;
 
-	str = (char *) LL_Dequeue(c->messages);
+	str = (char *) V_Shift(c->messages);
+	if (str != NULL)
+		c->queued -= client_message_length(str);
 
 	return str;
 }
 
 
+/**
+ * Find a screen of the client by its id.
+ * If the client uses numeric handles, an id of the form \c \#<n> refers
+ * to the screen with handle n.
+ * \param c   The client.
+ * \param id  Id or handle of the screen.
+ * \return    The screen; \c NULL if not found.
+ */
 Screen *
 client_find_screen(Client *c, char *id)
 {
@@ -175,16 +287,48 @@ client_find_screen(Client *c, char *id)
 
 	debug(RPT_DEBUG, "%s(c=[%d], id=\"%s\")", __FUNCTION__, c->sock, id);
 
-	LL_Rewind(c->screenlist);
-	do {
-		s = LL_Get(c->screenlist);
-		if ((s) && (0 == strcmp(s->id, id))) {
-			debug(RPT_DEBUG, "%s: Found %s", __FUNCTION__, id);
-			return s;
-		}
-	} while (LL_Next(c->screenlist) == 0);
+	if ((c->use_handles) && (id[0] == '#') && isdigit((unsigned char) id[1])) {
+		char *end;
+		long handle = strtol(id + 1, &end, 10);
+
+		if ((*end == '\0') && (handle > 0) && (handle <= c->screenhandles_size)
+		    && (c->screenhandles[handle - 1] != NULL))
+			return c->screenhandles[handle - 1];
+		/* not a valid handle: maybe it is an ordinary id */
+	}
+
+	s = HT_Find(c->screenhash, id);
+	if (s != NULL)
+		debug(RPT_DEBUG, "%s: Found %s", __FUNCTION__, id);
 
-	return NULL;
+	return s;
+}
+
+/* Give the screen the lowest free numeric handle of the client. */
+static int
+client_assign_handle(Client *c, Screen *s)
+{
+	int i;
+
+	for (i = 0; i < c->screenhandles_size; i++) {
+		if (c->screenhandles[i] == NULL)
+			break;
+	}
+	if (i == c->screenhandles_size) {
+		int size = (c->screenhandles_size > 0) ? 2 * c->screenhandles_size : 16;
+		Screen **handles = realloc(c->screenhandles, size * sizeof(Screen *));
+
+		if (handles == NULL)
+			return -1;
+		memset(handles + c->screenhandles_size, 0,
+		       (size - c->screenhandles_size) * sizeof(Screen *));
+		c->screenhandles = handles;
+		c->screenhandles_size = size;
+	}
+	c->screenhandles[i] = s;
+	s->handle = i + 1;
+
+	return 0;
 }
 
 int
@@ -197,7 +341,15 @@ client_add_screen(Client *c, Screen *s)
 
 	debug(RPT_DEBUG, "%s(c=[%d], s=[%s])", __FUNCTION__, c->sock, s->id);
 
-	LL_Push(c->screenlist, (void *) s);
+	if (HT_Insert(c->screenhash, s->id, (void *) s) < 0)
+		return -1;
+	if (client_assign_handle(c, s) < 0) {
+		HT_Remove(c->screenhash, s->id, (void *) s);
+		return -1;
+	}
+
+	V_Append(c->screenlist, (void *) s);
+	clients_serial++;
 
 	/* Now, add it to the screenlist...*/
 	screenlist_add(s);
@@ -216,7 +368,12 @@ client_remove_screen(Client *c, Screen *s)
 	debug(RPT_DEBUG, "%s(c=[%d], s=[%s])", __FUNCTION__, c->sock, s->id);
 
 	/* TODO:  Check for errors here?*/
-	LL_Remove(c->screenlist, (void *) s, NEXT);
+	V_Remove(c->screenlist, (void *) s);
+	HT_Remove(c->screenhash, s->id, (void *) s);
+	if ((s->handle > 0) && (s->handle <= c->screenhandles_size))
+		c->screenhandles[s->handle - 1] = NULL;
+	s->handle = 0;
+	clients_serial++;
 
 	/* Now, remove it from the screenlist...*/
 	screenlist_remove(s);
@@ -226,5 +383,72 @@ client_remove_screen(Client *c, Screen *s)
 
 int client_screen_count(Client *c)
 {
-	return LL_Length(c->screenlist);
+	return V_Length(c->screenlist);
+}
+
+/* Memory held outside the client's pool: its menu, keys, the interned
+ * strings charged to it, and the names and keys of its screens */
+static size_t
+client_memory_outside(Client *c, ClientMemory *m)
+{
+	Screen *s;
+	size_t outside;
+	int i;
+
+	m->menus = menuitem_memory((MenuItem *) c->menu);
+	m->keys = input_client_key_count(c) * sizeof(KeyReservation);
+	m->strings = c->strings;
+	outside = m->menus + m->keys + m->strings;
+	for (i = 0; (s = V_Get(c->screenlist, i)) != NULL; i++) {
+		if (s->name != NULL)
+			outside += strlen(s->name) + 1;
+		outside += s->keys_size * sizeof(int);
+	}
+	return outside;
+}
+
+/**
+ * Tell how much memory a client holds, by what it is for. This walks all
+ * of its screens and widgets; to check the total use client_memory_total().
+ * \param c  The client.
+ * \param m  Where to store the figures.
+ */
+void
+client_memory(Client *c, ClientMemory *m)
+{
+	Screen *s;
+	char *message;
+	int i;
+
+	memset(m, 0, sizeof(ClientMemory));
+	m->total = c->pool->used + client_memory_outside(c, m);
+	for (i = 0; (s = V_Get(c->screenlist, i)) != NULL; i++)
+		m->screens += screen_memory(s, &m->widgets);
+	for (i = 0; (message = V_Get(c->messages, i)) != NULL; i++)
+		m->messages += pool_usable_size(c->pool, message);
+}
+
+/**
+ * Tell how much memory a client holds in total: everything in its pool,
+ * which holds its screens, widgets and messages, and its menu and keys.
+ * \param c  The client.
+ * \return  Bytes held.
+ */
+size_t
+client_memory_total(Client *c)
+{
+	ClientMemory m;
+
+	return c->pool->used + client_memory_outside(c, &m);
+}
+
+/**
+ * Tell whether a client holds more memory than client_memory_limit allows.
+ * \param c  The client.
+ * \return  Non-zero if it does.
+ */
+int
+client_memory_exceeded(Client *c)
+{
+	return (client_memory_limit > 0) && (client_memory_total(c) > client_memory_limit);
 }
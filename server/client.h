@@ -24,10 +24,20 @@
 #ifndef CLIENT_H_TYPES
 #define CLIENT_H_TYPES
 
-#include "shared/LL.h"
+#include <string.h>
+
+#include "shared/vector.h"
+#include "shared/ilist.h"
+#include "shared/hash.h"
+#include "shared/pool.h"
+#include "stats.h"
 
 #define CLIENT_NAME_SIZE 256
 
+/** Size of the header of a block of binary frames in the message queue:
+ * a NUL, which no block of text lines starts with, and the length. */
+#define CLIENT_BINARY_HEADER	(1 + sizeof(int))
+
 /** Possible states of a client. */
 typedef enum _clientstate {
 	NEW,			/**< Client did not yet send \c hello. */
@@ -38,18 +48,58 @@ typedef enum _clientstate {
 
 /** The structure representing a client in the server. */
 typedef struct Client {
+	IL_node node;			/**< Link in the list of clients. */
 	char *name;
 	ClientState state;
 	int sock;
 	int backlight;
 	int heartbeat;
 
-	LinkedList *messages;		/**< Messages that the client sent. */
-	LinkedList *screenlist;		/**< List of client's screens. */
+	Vector *messages;		/**< Blocks of message lines that the client sent. */
+	int queued;			/**< Total length of the blocks in messages. */
+	Pool *pool;			/**< Memory of its messages, screens and widgets. */
+	Vector *screenlist;		/**< List of client's screens. */
+	HashTable *screenhash;		/**< Index of screenlist by screen id. */
+	struct Screen **screenhandles;	/**< Screens by numeric handle - 1. */
+	int screenhandles_size;		/**< Allocated size of screenhandles. */
+	int use_handles;		/**< Client asked for numeric handles. */
+	int binary;			/**< Client sends binary frames (hello binary). */
+	int deflate;			/**< Client sends a zlib stream (hello deflate). */
+	int utf8;			/**< Client sends texts in UTF-8 (client_set -charset). */
+	int key_count;			/**< Keys pressed repeatedly are sent once, with a count
+					 *   (client_set -keycount). */
+	int key_time;			/**< Keys are sent with the time they were pressed
+					 *   (client_set -keytime). */
+	int display;			/**< Display its screens are shown on (client_set -display). */
+	int frame_ack;			/**< Is told when its changes to a screen are shown
+					 *   (client_set -frameack). */
+
+	StatsHistogram parse_time;	/**< Time spent parsing its messages. */
+	unsigned long commands;		/**< Number of commands it sent. */
+	StatsHistogram reply_time;	/**< Time from a key or menu event to its next command. */
+	StatsHistogram event_render;	/**< Time from a key or menu event to the frame after its reply. */
+	unsigned long event_sent;	/**< When the oldest unanswered event was sent, 0 if none. */
+	unsigned long event_replied;	/**< When the event it answered was sent, until the next frame. */
+
+	size_t strings;			/**< Memory of the interned strings charged to it. */
 
 	void* menu;			/**< Menu hierarchy, if any */
 } Client;
 
+/** Memory a client holds in bytes, by what it is for. */
+typedef struct ClientMemory {
+	size_t screens;			/**< Screens, their names and keys. */
+	size_t widgets;			/**< Widgets, their texts and buffers. */
+	size_t menus;			/**< Its menu and the items in it. */
+	size_t messages;		/**< Messages waiting to be parsed. */
+	size_t keys;			/**< Key reservations. */
+	size_t strings;			/**< Interned ids and labels charged to it. */
+	size_t total;			/**< All of it, and whatever else is in its pool. */
+} ClientMemory;
+
+/** Most memory a client may hold, in bytes; 0 for no limit. */
+extern size_t client_memory_limit;
+
 #endif
 
 #ifndef INC_TYPES_ONLY
@@ -72,9 +122,37 @@ void client_close_sock(Client *c);
 /* Add message to the client's queue...*/
 int client_add_message(Client *c, char *message);
 
+/* Add a block of binary frames to the client's queue */
+int client_add_binary_message(Client *c, char *block);
+
+/* Put message back to the front of the queue */
+int client_unget_message(Client *c, char *message);
+
 /* Get message from queue */
 char *client_get_message(Client *c);
 
+/** Tell whether a message block holds binary frames instead of lines. */
+static inline int client_message_is_binary(const char *message)
+{
+	return (message[0] == '\0');
+}
+
+/** Get the length of the frames in a binary message block. */
+static inline int client_binary_length(const char *block)
+{
+	int len;
+
+	memcpy(&len, block + 1, sizeof(len));
+	return len;
+}
+
+/** Set the length of the frames in a binary message block. */
+static inline void client_binary_set_length(char *block, int len)
+{
+	block[0] = '\0';
+	memcpy(block + 1, &len, sizeof(len));
+}
+
 /* Find a named screen for the client */
 Screen *client_find_screen(Client *c, char *id);
 
@@ -84,5 +162,14 @@ int client_remove_screen(Client *c, Screen *s);
 
 int client_screen_count(Client *c);
 
+/* Tell how much memory the client holds, by what it is for */
+void client_memory(Client *c, ClientMemory *m);
+
+/* Tell how much memory the client holds in total */
+size_t client_memory_total(Client *c);
+
+/* Tell whether the client holds more memory than it may */
+int client_memory_exceeded(Client *c);
+
 #endif
 #endif
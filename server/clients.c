@@ -20,12 +20,20 @@
 #include <string.h>
 
 #include "shared/report.h"
-#include "shared/LL.h"
+#include "shared/ilist.h"
+#include "shared/configfile.h"
+#include "shared/defines.h"
 #include "client.h"
 #include "clients.h"
 #include "render.h"
 
-LinkedList *clientlist = NULL;
+/* The clients are linked through a node in their structure: walking the
+ * list needs no "current" position, adding and removing allocates nothing */
+static IL_list clientlist;
+static int clientlist_ready = 0;
+
+/** Increased whenever a client or a client's screen comes or goes */
+unsigned long clients_serial = 0;
 
 /* Initialize and kill client list...*/
 int
@@ -33,11 +41,10 @@ clients_init(void)
 {
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	clientlist = LL_new();
-	if (!clientlist) {
-		report(RPT_ERR, "%s: Unable to create client list", __FUNCTION__);
-		return -1;
-	}
+	IL_Init(&clientlist);
+	clientlist_ready = 1;
+
+	client_memory_limit = max(config_get_int("Server", "MaxClientMemory", 0, 0), 0);
 
 	return 0;
 }
@@ -45,32 +52,28 @@ clients_init(void)
 int
 clients_shutdown(void)
 {
-	Client *c;
+	IL_node *n;
 
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	if (!clientlist) {
+	if (!clientlist_ready) {
 		/* Program shutdown before completed startup */
 		return -1;
 	}
 
 	/* Free all client structures... */
-	for (c = LL_GetFirst(clientlist); c; c = LL_GetNext(clientlist)) {
-		debug(RPT_DEBUG, "%s: ...", __FUNCTION__);
-		if (c) {
-			debug(RPT_DEBUG, "%s: ... %i ...", __FUNCTION__, c->sock);
-			if (client_destroy(c) != 0) {
-				report(RPT_ERR, "%s: Error freeing client", __FUNCTION__);
-			} else {
-				debug(RPT_DEBUG, "%s: Freed client...", __FUNCTION__);
-			}
+	while ((n = IL_First(&clientlist)) != NULL) {
+		Client *c = IL_ENTRY(n, Client, node);
+
+		debug(RPT_DEBUG, "%s: ... %i ...", __FUNCTION__, c->sock);
+		IL_Remove(&clientlist, n);
+		if (client_destroy(c) != 0) {
+			report(RPT_ERR, "%s: Error freeing client", __FUNCTION__);
 		} else {
-			debug(RPT_DEBUG, "%s: No client!", __FUNCTION__);
+			debug(RPT_DEBUG, "%s: Freed client...", __FUNCTION__);
 		}
 	}
-
-	/* Then, free the list...*/
-	LL_Destroy(clientlist);
+	clientlist_ready = 0;
 
 	debug(RPT_DEBUG, "%s: done", __FUNCTION__);
 
@@ -81,37 +84,41 @@ clients_shutdown(void)
 Client *
 clients_add_client(Client *c)
 {
-	if (LL_Push(clientlist, c) == 0)
-		return c;
-
-	return NULL;
+	IL_Append(&clientlist, &c->node);
+	clients_serial++;
+	return c;
 }
 
 /* Remove the client from the clients list... */
 Client *
-clients_remove_client(Client *c, Direction whereto)
+clients_remove_client(Client *c)
 {
-	Client *client = LL_Remove(clientlist, c, whereto);
-
-	return client;
+	IL_Remove(&clientlist, &c->node);
+	clients_serial++;
+	return c;
 }
 
 Client *
 clients_getfirst(void)
 {
-	return (Client *) LL_GetFirst(clientlist);
+	IL_node *n = IL_First(&clientlist);
+
+	return (n != NULL) ? IL_ENTRY(n, Client, node) : NULL;
 }
 
+/* The client following c; fetch it before c may be removed */
 Client *
-clients_getnext(void)
+clients_getnext(Client *c)
 {
-	return (Client *) LL_GetNext(clientlist);
+	IL_node *n = IL_Next(&clientlist, &c->node);
+
+	return (n != NULL) ? IL_ENTRY(n, Client, node) : NULL;
 }
 
 int
 clients_client_count(void)
 {
-	return LL_Length(clientlist);
+	return IL_Length(&clientlist);
 }
 
 
@@ -126,7 +133,7 @@ clients_find_client_by_sock(int sock)
 
 	debug(RPT_DEBUG, "%s(sock=%i)", __FUNCTION__, sock);
 
-	for (c = LL_GetFirst(clientlist); c; c = LL_GetNext(clientlist)) {
+	for (c = clients_getfirst(); c; c = clients_getnext(c)) {
 		if (c->sock == sock) {
 			return c;
 		}
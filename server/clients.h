@@ -15,17 +15,20 @@
 
 #include "client.h"
 
+/** Increased whenever a client or a client's screen comes or goes */
+extern unsigned long clients_serial;
+
 /* Initialize and kill client list...*/
 int clients_init(void);
 int clients_shutdown(void);
 
 /* Add/remove clients (return NULL for error) */
 Client *clients_add_client(Client *c);
-Client *clients_remove_client(Client *c, Direction whereto);
+Client *clients_remove_client(Client *c);
 
 /* List functions */
 Client *clients_getfirst(void);
-Client *clients_getnext(void);
+Client *clients_getnext(Client *c);
 int clients_client_count(void);
 
 /* Search for a client with a particular filedescriptor...*/
@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
 #include <errno.h>
 
@@ -29,8 +30,10 @@
 
 #include "drivers.h"
 #include "client.h"
+#include "screen.h"
 #include "render.h"
 #include "input.h"
+#include "sock.h"
 #include "client_commands.h"
 
 
@@ -54,8 +57,16 @@ test_func_func(Client *c, int argc, char **argv)
  *
  * It sends back a string of info about the server to the client.
  *
+ * With the option \c binary the client switches to binary frames for
+ * everything it sends after the reply (see parse.c), and may use numeric
+ * screen handles; the reply then ends with \c binary.
+ *
+ * With the option \c deflate the client compresses everything it sends
+ * after the reply as one zlib stream (see sock.c); the reply then ends
+ * with \c deflate. Servers built without zlib leave it out.
+ *
  *\verbatim
- * Usage: hello
+ * Usage: hello [binary] [deflate]
  *\endverbatim
  *
  * \todo  Give \em real info about the server/lcd
@@ -63,16 +74,39 @@ test_func_func(Client *c, int argc, char **argv)
 int
 hello_func(Client *c, int argc, char **argv)
 {
-	if (argc > 1) {
-		sock_send_error(c->sock, "extra parameters ignored\n");
+	int binary = 0;
+	int deflate = 0;
+	int extra = 0;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "binary") == 0) && (c->state == NEW))
+			binary = 1;
+		else if ((strcmp(argv[i], "deflate") == 0) && (c->state == NEW))
+			deflate = 1;
+		else
+			extra = 1;
 	}
+	if (extra)
+		sock_send_error(c->sock, "extra parameters ignored\n");
 
 	debug(RPT_INFO, "Hello!");
 
-	sock_printf(c->sock, "connect LCDproc %s protocol %s lcd wid %i hgt %i cellwid %i cellhgt %i\n",
+	/* The rest of the client's input is inflated from now on */
+	if (deflate && (sock_client_inflate(c) < 0))
+		deflate = 0;
+
+	sock_printf(c->sock, "connect LCDproc %s protocol %s lcd wid %i hgt %i cellwid %i cellhgt %i%s%s\n",
 		VERSION, PROTOCOL_VERSION,
 		display_props->width, display_props->height,
-		display_props->cellwidth, display_props->cellheight);
+		display_props->cellwidth, display_props->cellheight,
+		(binary) ? " binary" : "",
+		(deflate) ? " deflate" : "");
+
+	if (binary) {
+		c->binary = 1;
+		c->use_handles = 1;
+	}
 
 	/* make note that client has sent hello */
 	c->state = ACTIVE;
@@ -102,10 +136,19 @@ bye_func(Client *c, int argc, char **argv)
 }
 
 /**
- * Sets info about the client, such as its name
+ * Sets info about the client, such as its name or the character set of
+ * the texts it sends
+ *
+ * \c -display moves the client's screens, and those it adds later, to a
+ * display; see screen_set.
+ *
+ * \c -frameack on makes the server send \c "flushed <screen> <frame>" after
+ * the first frame that shows a screen with all the changes the client made
+ * to it with screen_set and widget commands, once per screen and frame.
+ * Clients can pace their updates by it.
  *
  *\verbatim
- * Usage: client_set -name <id>
+ * Usage: client_set {-name <id>|-charset {latin1|utf-8}|-keycount {on|off}|-keytime {on|off}|-display <name>|-frameack {on|off}}
  *\endverbatim
  */
 int
@@ -117,7 +160,7 @@ client_set_func(Client *c, int argc, char **argv)
 		return 1;
 
 	if (argc != 3) {
-		sock_send_error(c->sock, "Usage: client_set -name <name>\n");
+		sock_send_error(c->sock, "Usage: client_set {-name <name>|-charset {latin1|utf-8}|-keycount {on|off}|-keytime {on|off}|-display <name>|-frameack {on|off}}\n");
 		return 0;
 	}
 
@@ -151,6 +194,119 @@ client_set_func(Client *c, int argc, char **argv)
 				i++; /* bypass argument (name string)*/
 			}
 		}
+		/* Handle the "charset" option */
+		else if (strcmp(p, "charset") == 0) {
+			i++;
+			if (argv[i] == NULL) {
+				sock_printf_error(c->sock, "internal error: no parameter #%d\n", i);
+				continue;
+			}
+
+			debug(RPT_DEBUG, "client_set: charset=\"%s\"", argv[i]);
+
+			/* texts already set stay as they are */
+			if ((strcasecmp(argv[i], "utf-8") == 0) || (strcasecmp(argv[i], "utf8") == 0)) {
+				c->utf8 = 1;
+				sock_send_string(c->sock, "success\n");
+			}
+			else if ((strcasecmp(argv[i], "latin1") == 0) || (strcasecmp(argv[i], "iso-8859-1") == 0)) {
+				c->utf8 = 0;
+				sock_send_string(c->sock, "success\n");
+			}
+			else {
+				sock_printf_error(c->sock, "unknown charset (%s)\n", argv[i]);
+			}
+		}
+		/* Handle the "keycount" option */
+		else if (strcmp(p, "keycount") == 0) {
+			i++;
+			if (argv[i] == NULL) {
+				sock_printf_error(c->sock, "internal error: no parameter #%d\n", i);
+				continue;
+			}
+
+			debug(RPT_DEBUG, "client_set: keycount=\"%s\"", argv[i]);
+
+			if ((strcasecmp(argv[i], "on") == 0) || (strcasecmp(argv[i], "yes") == 0)) {
+				c->key_count = 1;
+				sock_send_string(c->sock, "success\n");
+			}
+			else if ((strcasecmp(argv[i], "off") == 0) || (strcasecmp(argv[i], "no") == 0)) {
+				c->key_count = 0;
+				sock_send_string(c->sock, "success\n");
+			}
+			else {
+				sock_printf_error(c->sock, "invalid keycount (%s)\n", argv[i]);
+			}
+		}
+		/* Handle the "keytime" option */
+		else if (strcmp(p, "keytime") == 0) {
+			i++;
+			if (argv[i] == NULL) {
+				sock_printf_error(c->sock, "internal error: no parameter #%d\n", i);
+				continue;
+			}
+
+			debug(RPT_DEBUG, "client_set: keytime=\"%s\"", argv[i]);
+
+			if ((strcasecmp(argv[i], "on") == 0) || (strcasecmp(argv[i], "yes") == 0)) {
+				c->key_time = 1;
+				sock_send_string(c->sock, "success\n");
+			}
+			else if ((strcasecmp(argv[i], "off") == 0) || (strcasecmp(argv[i], "no") == 0)) {
+				c->key_time = 0;
+				sock_send_string(c->sock, "success\n");
+			}
+			else {
+				sock_printf_error(c->sock, "invalid keytime (%s)\n", argv[i]);
+			}
+		}
+		/* Handle the "display" option */
+		else if (strcmp(p, "display") == 0) {
+			Screen *s;
+			int display;
+			int k;
+
+			i++;
+			if (argv[i] == NULL) {
+				sock_printf_error(c->sock, "internal error: no parameter #%d\n", i);
+				continue;
+			}
+
+			debug(RPT_DEBUG, "client_set: display=\"%s\"", argv[i]);
+
+			display = drivers_display_find(argv[i]);
+			if (display < 0) {
+				sock_send_error(c->sock, "Unknown display\n");
+				continue;
+			}
+			c->display = display;
+			for (k = 0; (s = V_Get(c->screenlist, k)) != NULL; k++)
+				screen_set_display(s, display);
+			sock_send_string(c->sock, "success\n");
+		}
+		/* Handle the "frameack" option */
+		else if (strcmp(p, "frameack") == 0) {
+			i++;
+			if (argv[i] == NULL) {
+				sock_printf_error(c->sock, "internal error: no parameter #%d\n", i);
+				continue;
+			}
+
+			debug(RPT_DEBUG, "client_set: frameack=\"%s\"", argv[i]);
+
+			if ((strcasecmp(argv[i], "on") == 0) || (strcasecmp(argv[i], "yes") == 0)) {
+				c->frame_ack = 1;
+				sock_send_string(c->sock, "success\n");
+			}
+			else if ((strcasecmp(argv[i], "off") == 0) || (strcasecmp(argv[i], "no") == 0)) {
+				c->frame_ack = 0;
+				sock_send_string(c->sock, "success\n");
+			}
+			else {
+				sock_printf_error(c->sock, "invalid frameack (%s)\n", argv[i]);
+			}
+		}
 		else {
 			sock_printf_error(c->sock, "invalid parameter (%s)\n", p);
 		}
@@ -24,7 +24,8 @@
 #include "widget_commands.h"
 #include "menu_commands.h"
 
-static client_function commands[] = {
+/* The table is indexed by CommandId: keep both in the same order! */
+static client_function commands[NUM_COMMANDS + 1] = {
 	{ "test_func",      test_func_func      },
 	{ "hello",          hello_func          },
 	{ "client_set",     client_set_func     },
@@ -38,6 +39,7 @@ static client_function commands[] = {
 	{ "widget_add",     widget_add_func     },
 	{ "widget_del",     widget_del_func     },
 	{ "widget_set",     widget_set_func     },
+	{ "widget_set_batch", widget_set_batch_func },
 	{ "menu_add_item",  menu_add_item_func  },
 	{ "menu_del_item",  menu_del_item_func  },
 	{ "menu_set_item",  menu_set_item_func  },
@@ -48,28 +50,133 @@ static client_function commands[] = {
 	{ "output",         output_func         },
 	{ "noop",           noop_func           },
 	{ "info",           info_func           },
+	{ "stats",          stats_func          },
 	{ "sleep",          sleep_func          },
 	{ "bye",            bye_func            },
+	{ "driver_stats",   driver_stats_func   },
+	{ "menu_batch",     menu_batch_func     },
+	{ "screen_clone",   screen_clone_func   },
+	{ "subscribe",      subscribe_func      },
 	{ NULL,             NULL},
 };
 
 /**
- * Looks up a function for a command sent by the client.
+ * Looks up the identifier of a command sent by the client.
+ *
+ * Instead of comparing the command with every table entry, the length and
+ * one or two distinguishing characters select the only candidate, which
+ * is then verified with a single string compare.
+ *
  * \param cmd  Command to look up as string.
- * \return  Pointer to the implementing function.
+ * \return  Identifier of the command, or CMD_UNKNOWN.
  */
-CommandFunc get_command_function(char *cmd)
+CommandId get_command_id(const char *cmd)
 {
-	int i;
+	CommandId id = CMD_UNKNOWN;
 
 	if (cmd == NULL)
-		return NULL;
+		return CMD_UNKNOWN;
 
-	for (i = 0; commands[i].keyword != NULL; i++) {
-		if (0 == strcmp(cmd, commands[i].keyword))
-			return commands[i].function;
+	switch (strlen(cmd)) {
+	case 3:
+		id = CMD_BYE;
+		break;
+	case 4:
+		id = (cmd[0] == 'n') ? CMD_NOOP : CMD_INFO;
+		break;
+	case 5:
+		id = (cmd[0] == 'h') ? CMD_HELLO
+		   : (cmd[1] == 'l') ? CMD_SLEEP : CMD_STATS;
+		break;
+	case 6:
+		id = CMD_OUTPUT;
+		break;
+	case 7:		/* key_add, key_del */
+		id = (cmd[4] == 'a') ? CMD_KEY_ADD : CMD_KEY_DEL;
+		break;
+	case 9:
+		switch (cmd[0]) {
+		case 't': id = CMD_TEST_FUNC; break;
+		case 'm': id = CMD_MENU_GOTO; break;
+		case 'b': id = CMD_BACKLIGHT; break;
+		case 's': id = CMD_SUBSCRIBE; break;
+		}
+		break;
+	case 10:	/* client_set, menu_batch, screen_*, widget_* */
+		switch (cmd[0]) {
+		case 'm':
+			id = CMD_MENU_BATCH;
+			break;
+		case 'c':
+			id = CMD_CLIENT_SET;
+			break;
+		case 's':
+			id = (cmd[7] == 'a') ? CMD_SCREEN_ADD
+			   : (cmd[7] == 'd') ? CMD_SCREEN_DEL : CMD_SCREEN_SET;
+			break;
+		case 'w':
+			id = (cmd[7] == 'a') ? CMD_WIDGET_ADD
+			   : (cmd[7] == 'd') ? CMD_WIDGET_DEL : CMD_WIDGET_SET;
+			break;
+		}
+		break;
+	case 12:	/* driver_stats, screen_clone */
+		id = (cmd[0] == 'd') ? CMD_DRIVER_STATS : CMD_SCREEN_CLONE;
+		break;
+	case 13:	/* menu_add_item, menu_del_item, menu_set_item, menu_set_main */
+		id = (cmd[5] == 'a') ? CMD_MENU_ADD_ITEM
+		   : (cmd[5] == 'd') ? CMD_MENU_DEL_ITEM
+		   : (cmd[9] == 'i') ? CMD_MENU_SET_ITEM : CMD_MENU_SET_MAIN;
+		break;
+	case 14:	/* client_add_key, client_del_key */
+		id = (cmd[7] == 'a') ? CMD_CLIENT_ADD_KEY : CMD_CLIENT_DEL_KEY;
+		break;
+	case 16:
+		id = CMD_WIDGET_SET_BATCH;
+		break;
 	}
 
-	return NULL;
+	if ((id != CMD_UNKNOWN) && (strcmp(cmd, commands[id].keyword) == 0))
+		return id;
+
+	return CMD_UNKNOWN;
+}
+
+
+/**
+ * Looks up the function implementing a command.
+ * \param id  Identifier of the command.
+ * \return  Pointer to the implementing function, or NULL for an invalid id.
+ */
+CommandFunc get_command_function_by_id(CommandId id)
+{
+	if ((id < 0) || (id >= NUM_COMMANDS))
+		return NULL;
+
+	return commands[id].function;
+}
+
+
+/**
+ * Looks up the protocol keyword of a command.
+ * \param id  Identifier of the command.
+ * \return  Command string, or NULL for an invalid id.
+ */
+const char *get_command_name(CommandId id)
+{
+	if ((id < 0) || (id >= NUM_COMMANDS))
+		return NULL;
+
+	return commands[id].keyword;
 }
 
+
+/**
+ * Looks up a function for a command sent by the client.
+ * \param cmd  Command to look up as string.
+ * \return  Pointer to the implementing function.
+ */
+CommandFunc get_command_function(char *cmd)
+{
+	return get_command_function_by_id(get_command_id(cmd));
+}
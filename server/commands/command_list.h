@@ -21,6 +21,43 @@
  */
 typedef int (*CommandFunc) (Client *c, int argc, char **argv);
 
+/** Identifiers of the client commands, in the order of the command table.
+ * Binary frames carry these values, so new commands go at the end. */
+typedef enum {
+	CMD_UNKNOWN = -1,	/**< Not a valid command */
+	CMD_TEST_FUNC = 0,
+	CMD_HELLO,
+	CMD_CLIENT_SET,
+	CMD_CLIENT_ADD_KEY,
+	CMD_CLIENT_DEL_KEY,
+	CMD_SCREEN_ADD,
+	CMD_SCREEN_DEL,
+	CMD_SCREEN_SET,
+	CMD_KEY_ADD,
+	CMD_KEY_DEL,
+	CMD_WIDGET_ADD,
+	CMD_WIDGET_DEL,
+	CMD_WIDGET_SET,
+	CMD_WIDGET_SET_BATCH,
+	CMD_MENU_ADD_ITEM,
+	CMD_MENU_DEL_ITEM,
+	CMD_MENU_SET_ITEM,
+	CMD_MENU_GOTO,
+	CMD_MENU_SET_MAIN,
+	CMD_BACKLIGHT,
+	CMD_OUTPUT,
+	CMD_NOOP,
+	CMD_INFO,
+	CMD_STATS,
+	CMD_SLEEP,
+	CMD_BYE,
+	CMD_DRIVER_STATS,
+	CMD_MENU_BATCH,
+	CMD_SCREEN_CLONE,
+	CMD_SUBSCRIBE,
+	NUM_COMMANDS		/**< Number of commands, not a command */
+} CommandId;
+
 /** Defines an entry in the command table */
 typedef struct client_function {
 	char *keyword;		/**< Command string in the protocol */
@@ -28,6 +65,9 @@ typedef struct client_function {
 } client_function;
 
 
+CommandId get_command_id(const char *cmd);
+CommandFunc get_command_function_by_id(CommandId id);
+const char *get_command_name(CommandId id);
 CommandFunc get_command_function(char *cmd);
 
 #endif
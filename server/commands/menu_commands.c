@@ -32,10 +32,12 @@
 #include "shared/sockets.h"
 
 #include "client.h"
+#include "sock.h"
 #include "menuitem.h"
 #include "menu.h"
 #include "menuscreens.h"
 #include "menu_commands.h"
+#include "stats.h"
 
 /* Local functions */
 MenuEventFunc(menu_commands_handler);
@@ -98,6 +100,11 @@ menu_add_item_func(Client *c, int argc, char **argv)
 	menu_id = argv[1];
 	item_id = argv[2];
 
+	if (client_memory_exceeded(c)) {
+		sock_send_error(c->sock, "Client memory limit exceeded\n");
+		return 0;
+	}
+
 	/* Does the client have a menu already ? */
 	if (c->menu == NULL) {
 		/* We need to create it */
@@ -107,6 +114,8 @@ menu_add_item_func(Client *c, int argc, char **argv)
 			sock_send_error(c->sock, "Cannot create menu\n");
 			return 1;
 		}
+		/* Item ids are unique per client: look them up by hash */
+		menu_create_index(c->menu);
 		menu_add_item(main_menu, c->menu);
 	}
 
@@ -288,6 +297,11 @@ menu_del_item_func(Client *c, int argc, char **argv)
  * -next id			()
  *	Sets the successor of this item (what happens after "Enter")
  *
+ * menu:
+ * -lazy false|true		(false)
+ *	Ask the client with a populate event for the items of the menu
+ *	when the user enters it while it has none.
+ *
  * action:
  * -menu_result none|close|quit	(none)
  *	Sets what to do with the menu when this action is selected:
@@ -382,6 +396,7 @@ menu_set_item_func(Client *c, int argc, char **argv)
 		{ -1,			"is_hidden",	BOOLEAN,	offsetof(MenuItem,is_hidden) },
 		{ -1,			"prev",		STRING,		-1 },
 		{ -1,			"next",		STRING,		-1 },
+		{ MENUITEM_MENU,	"lazy",		BOOLEAN,	offsetof(MenuItem,data.menu.lazy) },
 		{ MENUITEM_ACTION,	"menu_result",	STRING,		-1 },
 		{ MENUITEM_CHECKBOX,	"value",	CHECKBOX_VALUE,	offsetof(MenuItem,data.checkbox.value) },
 		{ MENUITEM_CHECKBOX,	"allow_gray",	BOOLEAN,	offsetof(MenuItem,data.checkbox.allow_gray) },
@@ -667,6 +682,8 @@ menu_set_item_func(Client *c, int argc, char **argv)
 			argnr ++;
 			continue; /* Skip current option and the invalid value */
 		}
+		/* is_hidden may have changed what the parent shows */
+		menu_invalidate(item->parent);
 		menuscreen_inform_item_modified(item);
 		if (option_table[option_nr].attr_type != NOVALUE) {
 			/* Skip the now used argument */
@@ -856,6 +873,73 @@ menu_set_main_func(Client *c, int argc, char **argv)
 	return 0;
 }
 
+/**
+ * Runs several menu commands with a single reply, so a client can upload
+ * a large menu without waiting for the server to answer each item.
+ *
+ *\verbatim
+ * Usage: menu_batch <command> <args> [ ; <command> <args> ]...
+ *\endverbatim
+ *
+ * The commands may be menu_add_item, menu_del_item and menu_set_item; a
+ * lone ';' separates them. They are run in order up to the first one that
+ * fails. The reply is "success", or the error of the failing command with
+ * its number in the batch.
+ */
+int
+menu_batch_func(Client *c, int argc, char **argv)
+{
+	char error[128];
+	int start, end;
+	int n = 0;
+
+	debug(RPT_DEBUG, "%s(Client [%d], ...)", __FUNCTION__, c->sock);
+	if (c->state != ACTIVE)
+		return 1;
+
+	if (argc < 2) {
+		sock_send_error(c->sock, "Usage: menu_batch <command> <args> [ ; <command> <args> ]...\n");
+		return 0;
+	}
+
+	for (start = 1; start < argc; start = end + 1) {
+		int (*function) (Client *c, int argc, char **argv);
+		int failed;
+
+		for (end = start; (end < argc) && (strcmp(argv[end], ";") != 0); end++)
+			;
+		if (end == start)
+			continue;
+		n++;
+
+		if (strcmp(argv[start], "menu_add_item") == 0)
+			function = menu_add_item_func;
+		else if (strcmp(argv[start], "menu_set_item") == 0)
+			function = menu_set_item_func;
+		else if (strcmp(argv[start], "menu_del_item") == 0)
+			function = menu_del_item_func;
+		else {
+			sock_printf_error(c->sock, "Command %d: %.40s is not allowed in menu_batch\n",
+					  n, argv[start]);
+			return 0;
+		}
+
+		/* The commands see only their own arguments */
+		if (end < argc)
+			argv[end] = NULL;
+		sock_client_hold_replies(c);
+		failed = function(c, end - start, argv + start);
+		if (sock_client_release_replies(c, error, sizeof(error)) || failed) {
+			sock_printf_error(c->sock, "Command %d (%s): %s\n", n, argv[start],
+					  failed ? "Function returned error" : error);
+			return 0;
+		}
+	}
+
+	sock_send_string(c->sock, "success\n");
+	return 0;
+}
+
 /**
  * This function catches the event for the menus that have been
  * created on behalf of the clients. It informs the client with
@@ -925,6 +1009,7 @@ MenuEventFunc(menu_commands_handler)
 			menuitem_eventtype_to_eventtypename(event),
 			item->id);
 	}
+	stats_client_event(c);
 
 	return 0;
 }
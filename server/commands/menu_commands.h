@@ -17,6 +17,7 @@ int menu_del_item_func(Client *c, int argc, char **argv);
 int menu_set_item_func(Client *c, int argc, char **argv);
 int menu_goto_func(Client *c, int argc, char **argv);
 int menu_set_main_func(Client *c, int argc, char **argv);
+int menu_batch_func(Client *c, int argc, char **argv);
 
 #endif
 
@@ -29,27 +29,36 @@
 
 #include "client.h"
 #include "screen.h"
+#include "drivers.h"
+#include "input.h"
+#include "screenlist.h"
 #include "render.h"
 #include "screen_commands.h"
 
 /**
  * Tells the server the client has another screen to offer
  *
+ * With \c -handle the reply carries a numeric handle \c \#<n> that can be
+ * used instead of the screen id in later commands.
+ *
  *\verbatim
- * Usage: screen_add <id>
+ * Usage: screen_add <id> [-handle]
  *\endverbatim
  */
 int
 screen_add_func(Client *c, int argc, char **argv)
 {
 	int err = 0;
+	int handle = 0;
 	Screen *s;
 
 	if (c->state != ACTIVE)
 		return 1;
 
-	if (argc != 2) {
-		sock_send_error(c->sock, "Usage: screen_add <screenid>\n");
+	if ((argc == 3) && (strcmp(argv[2], "-handle") == 0))
+		handle = 1;
+	else if (argc != 2) {
+		sock_send_error(c->sock, "Usage: screen_add <screenid> [-handle]\n");
 		return 0;
 	}
 
@@ -61,6 +70,11 @@ screen_add_func(Client *c, int argc, char **argv)
 		return 0;
 	}
 
+	if (client_memory_exceeded(c)) {
+		sock_send_error(c->sock, "Client memory limit exceeded\n");
+		return 0;
+	}
+
 	s = screen_create(argv[1], c);
 	if (s == NULL) {
 		sock_send_error(c->sock, "failed to create screen\n");
@@ -70,14 +84,79 @@ screen_add_func(Client *c, int argc, char **argv)
 	err = client_add_screen(c, s);
 
 	if (err == 0) {
-		sock_send_string(c->sock, "success\n");
+		if (handle) {
+			c->use_handles = 1;
+			sock_printf(c->sock, "success #%d\n", s->handle);
+		}
+		else
+			sock_send_string(c->sock, "success\n");
 	} else {
 		sock_send_error(c->sock, "failed to add screen\n");
+		screen_destroy(s);
+		return 0;
 	}
 	report(RPT_INFO, "Client on socket %d added added screen \"%s\"", c->sock, s->id);
 	return 0;
 }
 
+/**
+ * Adds a copy of one of the client's screens, with all its attributes and
+ * widgets, under a new id. A client showing many screens of the same
+ * layout builds one and clones it; only the values differ afterwards.
+ *
+ *\verbatim
+ * Usage: screen_clone <screenid> <newscreenid> [-handle]
+ *\endverbatim
+ */
+int
+screen_clone_func(Client *c, int argc, char **argv)
+{
+	int handle = 0;
+	Screen *src;
+	Screen *s;
+
+	if (c->state != ACTIVE)
+		return 1;
+
+	if ((argc == 4) && (strcmp(argv[3], "-handle") == 0))
+		handle = 1;
+	else if (argc != 3) {
+		sock_send_error(c->sock, "Usage: screen_clone <screenid> <newscreenid> [-handle]\n");
+		return 0;
+	}
+
+	src = client_find_screen(c, argv[1]);
+	if (src == NULL) {
+		sock_send_error(c->sock, "Unknown screen id\n");
+		return 0;
+	}
+	if (client_find_screen(c, argv[2]) != NULL) {
+		sock_send_error(c->sock, "Screen already exists\n");
+		return 0;
+	}
+
+	s = screen_clone(src, argv[2]);
+	if (s == NULL) {
+		sock_send_error(c->sock, "failed to create screen\n");
+		return 0;
+	}
+
+	if (client_add_screen(c, s) < 0) {
+		sock_send_error(c->sock, "failed to add screen\n");
+		screen_destroy(s);
+		return 0;
+	}
+	if (handle) {
+		c->use_handles = 1;
+		sock_printf(c->sock, "success #%d\n", s->handle);
+	}
+	else
+		sock_send_string(c->sock, "success\n");
+
+	report(RPT_INFO, "Client on socket %d cloned screen \"%s\" as \"%s\"", c->sock, src->id, s->id);
+	return 0;
+}
+
 /**
  * The client requests that the server forget about a screen
  *
@@ -133,7 +212,12 @@ screen_del_func(Client *c, int argc, char **argv)
  *     [-priority <prio>] [-duration <int>] [-timeout <int>]
  *     [-heartbeat <type>] [-backlight <type>]
  *     [-cursor <type>] [-cursor_x <xpos>] [-cursor_y <ypos>]
+ *     [-update_interval <int>] [-display <name>]
  *\endverbatim
+ *
+ * \c -display shows the screen on the display of the drivers whose
+ * sections give that name with Display=; \c main is the display of the
+ * drivers without one. Each display rotates its own screens.
  */
 int
 screen_set_func(Client *c, int argc, char **argv)
@@ -153,7 +237,8 @@ screen_set_func(Client *c, int argc, char **argv)
 				" [-duration <int>] [-timeout <int>]"
 				" [-heartbeat <type>] [-backlight <type>]"
 				" [-cursor <type>]"
-				" [-cursor_x <xpos>] [-cursor_y <ypos>]\n");
+				" [-cursor_x <xpos>] [-cursor_y <ypos>]"
+				" [-update_interval <int>] [-display <name>]\n");
 		return 0;
 	}
 	else if (argc == 2) {
@@ -167,6 +252,10 @@ screen_set_func(Client *c, int argc, char **argv)
 		sock_send_error(c->sock, "Unknown screen id\n");
 		return 0;
 	}
+	/* Any attribute may change the display */
+	s->dirty = 1;
+	screen_changed_by_client(s);
+
 	/* Handle the rest of the parameters*/
 	for (i = 2; i < argc; i++) {
 		char *p = argv[i];
@@ -213,6 +302,7 @@ screen_set_func(Client *c, int argc, char **argv)
 				}
 				if (number >= 0) {
 					s->priority = number;
+					screenlist_update(s);
 					sock_send_string(c->sock, "success\n");
 				}
 				else {
@@ -303,6 +393,7 @@ screen_set_func(Client *c, int argc, char **argv)
 				 */
 				if (number > 0) {
 					s->timeout = number;
+					screenlist_timeout_set(s);
 					report(RPT_NOTICE, "Timeout set.");
 				}
 				sock_send_string(c->sock, "success\n");
@@ -311,6 +402,39 @@ screen_set_func(Client *c, int argc, char **argv)
 				sock_send_error(c->sock, "-timeout requires a parameter\n");
 			}
 		}
+		/* Handle the "update_interval" parameter*/
+		else if (strcmp(p, "update_interval") == 0) {
+			if (argc > i + 1) {
+				i++;
+				debug(RPT_DEBUG, "screen_set: update_interval=\"%s\"", argv[i]);
+				/* count of TIME_UNITS, 0 renders every change */
+				number = atoi(argv[i]);
+				if (number >= 0)
+					s->update_interval = number;
+				sock_send_string(c->sock, "success\n");
+			}
+			else {
+				sock_send_error(c->sock, "-update_interval requires a parameter\n");
+			}
+		}
+		/* Handle the "display" parameter*/
+		else if (strcmp(p, "display") == 0) {
+			if (argc > i + 1) {
+				i++;
+				debug(RPT_DEBUG, "screen_set: display=\"%s\"", argv[i]);
+
+				number = drivers_display_find(argv[i]);
+				if (number < 0)
+					sock_send_error(c->sock, "Unknown display\n");
+				else if (screen_set_display(s, number) < 0)
+					sock_send_error(c->sock, "failed to move screen\n");
+				else
+					sock_send_string(c->sock, "success\n");
+			}
+			else {
+				sock_send_error(c->sock, "-display requires a parameter\n");
+			}
+		}
 		/* Handle the "backlight" parameter*/
 		else if (strcmp(p, "backlight") == 0) {
 			if (argc > i + 1) {
@@ -426,7 +550,8 @@ int
 key_add_func(Client *c, int argc, char **argv)
 {
 	Screen *s;
-	int len;
+	int *keys;
+	int i;
 
 	if (argc < 3) {
 		sock_send_error(c->sock, "Usage: key_add screen_id {<key>}+\n");
@@ -439,11 +564,21 @@ key_add_func(Client *c, int argc, char **argv)
 		return 0;
 	}
 
-	len = argv[argc - 1] - argv[2] + strlen(argv[argc - 1]) + 1;
+	keys = realloc(s->keys, (s->keys_size + argc - 2) * sizeof(int));
+	if (keys == NULL) {
+		sock_send_error(c->sock, "Out of memory\n");
+		return 0;
+	}
+	s->keys = keys;
+	for (i = 2; i < argc; i++) {
+		int key = input_key_id(argv[i]);
 
-	s->keys = realloc(s->keys, len + s->keys_size);
-	memcpy(&s->keys[s->keys_size], argv[2], len);
-	s->keys_size += len;
+		if (key < 0) {
+			sock_printf_error(c->sock, "Too many keys, cannot add \"%s\"\n", argv[i]);
+			return 0;
+		}
+		s->keys[s->keys_size++] = key;
+	}
 
 	sock_send_string(c->sock, "success\n");
 
@@ -462,8 +597,7 @@ int
 key_del_func(Client *c, int argc, char **argv)
 {
 	Screen *s;
-	int i, len;
-	char *key, *p;
+	int i, n;
 
 	if (argc < 3) {
 		sock_send_error(c->sock, "Usage: key_del screen_id {<key>}+\n");
@@ -477,12 +611,11 @@ key_del_func(Client *c, int argc, char **argv)
 	}
 
 	for (i = 2; argv[i]; ++i) {
-		key = argv[i];
-		p = screen_find_key(s, key);
-		if (p) {
-			len = strlen(key) + 1;
-			memmove(p, p + len, s->keys_size - (p - s->keys));
-			s->keys_size -= len;
+		n = screen_find_key(s, input_key_lookup(argv[i]));
+		if (n >= 0) {
+			memmove(&s->keys[n], &s->keys[n + 1],
+				(s->keys_size - n - 1) * sizeof(int));
+			s->keys_size--;
 
 			sock_send_string(c->sock, "success\n");
 		}
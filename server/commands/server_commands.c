@@ -29,6 +29,8 @@
 
 #include "client.h"
 #include "render.h"
+#include "stats.h"
+#include "framesub.h"
 #include "server_commands.h"
 
 #define ALL_OUTPUTS_ON -1
@@ -85,12 +87,9 @@ output_func(Client *c, int argc, char **argv)
 
 	sock_send_string(c->sock, "success\n");
 
-	/* Makes sense to me to set the output immediately;
-	 * however, the outputs are currently set in
-	 * draw_screen(screen *s, int timer)
-	 * Whatever for? */
-
-	/* drivers_output(output_state); */
+	/* The state is only latched here: the next frame carries it, so
+	 * a client changing several outputs in a row costs the drivers one
+	 * update, and they are only called when it differs from the last. */
 
 	report(RPT_NOTICE, "output states changed");
 	return 0;
@@ -181,3 +180,107 @@ noop_func(Client *c, int argc, char **argv)
 	sock_send_string(c->sock, "noop complete\n");
 	return 0;
 }
+
+/**
+ * Reports the server's timing and load statistics: frame render times,
+ * flush times per driver, parse times and queue depths per client, and
+ * skipped and dropped frames. Each line of the reply starts with
+ * "stats", the reply ends with "success".
+ *
+ *\verbatim
+ * Usage: stats
+ *\endverbatim
+ */
+int
+stats_func(Client *c, int argc, char **argv)
+{
+	if (c->state != ACTIVE)
+		return 1;
+
+	if (argc > 1) {
+		sock_send_error(c->sock, "Extra arguments ignored...\n");
+	}
+
+	stats_send(c->sock);
+	sock_send_string(c->sock, "success\n");
+	return 0;
+}
+
+/**
+ * Reports the I/O statistics of one or all drivers: frames dropped, bytes
+ * and characters written, custom characters uploaded, I/O errors,
+ * reconnects, and the flush times. Each line of the reply starts with
+ * "driver_stats" and the driver's name, the reply ends with "success".
+ *
+ *\verbatim
+ * Usage: driver_stats [<driver>]
+ *\endverbatim
+ */
+int
+driver_stats_func(Client *c, int argc, char **argv)
+{
+	if (c->state != ACTIVE)
+		return 1;
+
+	if (argc > 2) {
+		sock_send_error(c->sock, "Usage: driver_stats [<driver>]\n");
+		return 0;
+	}
+
+	if (stats_send_drivers(c->sock, (argc == 2) ? argv[1] : NULL) < 0) {
+		sock_printf_error(c->sock, "Unknown driver: %.40s\n", argv[1]);
+		return 0;
+	}
+	sock_send_string(c->sock, "success\n");
+	return 0;
+}
+
+
+/**
+ * Subscribes the client to the frames shown on the main display, for
+ * mirroring it (see framesub.c). The client is sent all of the frame
+ * first, then what changed, at most once per \c interval milliseconds
+ * (default 200); 0 sends every frame. \c off ends the subscription.
+ *
+ *\verbatim
+ * Usage: subscribe frames [<interval>|off]
+ *\endverbatim
+ */
+int
+subscribe_func(Client *c, int argc, char **argv)
+{
+	long interval = FRAMESUB_DEFAULT_INTERVAL;
+
+	if (c->state != ACTIVE)
+		return 1;
+
+	if ((argc < 2) || (argc > 3) || (strcmp(argv[1], "frames") != 0)) {
+		sock_send_error(c->sock, "Usage: subscribe frames [<interval>|off]\n");
+		return 0;
+	}
+
+	if ((argc == 3) && (strcmp(argv[2], "off") == 0)) {
+		framesub_unsubscribe(c);
+		sock_send_string(c->sock, "success\n");
+		return 0;
+	}
+	if (argc == 3) {
+		char *end;
+
+		errno = 0;
+		interval = strtol(argv[2], &end, 10);
+		if ((errno != 0) || (*argv[2] == '\0') || (*end != '\0')
+		    || (interval < 0) || (interval > 3600000)) {
+			sock_send_error(c->sock, "Invalid interval\n");
+			return 0;
+		}
+	}
+
+	/* the reply comes before the first frame */
+	if (framesub_subscribe(c, (int) interval) < 0) {
+		sock_send_error(c->sock, "Can't subscribe\n");
+		return 0;
+	}
+	sock_send_string(c->sock, "success\n");
+	return 0;
+}
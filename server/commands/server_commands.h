@@ -17,5 +17,8 @@ int test_func_func(Client *c, int argc, char **argv);
 int noop_func(Client *c, int argc, char **argv);
 int info_func(Client *c, int argc, char **argv);
 int sleep_func(Client *c, int argc, char **argv);
+int stats_func(Client *c, int argc, char **argv);
+int driver_stats_func(Client *c, int argc, char **argv);
+int subscribe_func(Client *c, int argc, char **argv);
 
 #endif
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 
 #include "shared/report.h"
 #include "shared/sockets.h"
@@ -31,14 +32,18 @@
 #include "screen.h"
 #include "widget.h"
 #include "drivers.h"
+#include "sources.h"
 #include "widget_commands.h"
 
+/** Most widgets one widget_set_batch command can set */
+#define MAX_BATCH_WIDGETS	128
+
 
 /**
  * Adds a widget to a screen, but doesn't give it a value
  *
  *\verbatim
- * Usage: widget_add <screenid> <widgetid> <widgettype> [-in <id>]
+ * Usage: widget_add <screenid> <widgetid> <widgettype> [-in <id>] [-source <name>]
  *\endverbatim
  */
 int
@@ -48,14 +53,17 @@ widget_add_func(Client *c, int argc, char **argv)
 	char *sid;
 	char *wid;
 	WidgetType wtype;
+	char *source = NULL;
+	int i;
 	Screen * s;
+	Screen * top;
 	Widget * w;
 
 	if (c->state != ACTIVE)
 		return 1;
 
-	if ((argc < 4) || (argc > 6)) {
-		sock_send_error(c->sock, "Usage: widget_add <screenid> <widgetid> <widgettype> [-in <id>]\n");
+	if ((argc < 4) || (argc > 8)) {
+		sock_send_error(c->sock, "Usage: widget_add <screenid> <widgetid> <widgettype> [-in <id>] [-source <name>]\n");
 		return 0;
 	}
 
@@ -67,6 +75,7 @@ widget_add_func(Client *c, int argc, char **argv)
 		sock_send_error(c->sock, "Invalid screen id\n");
 		return 0;
 	}
+	top = s;
 
 	/* Find widget type */
 	wtype = widget_typename_to_type(argv[3]);
@@ -75,9 +84,14 @@ widget_add_func(Client *c, int argc, char **argv)
 		return 0;
 	}
 
+	if (client_memory_exceeded(c)) {
+		sock_send_error(c->sock, "Client memory limit exceeded\n");
+		return 0;
+	}
+
 	/* Check for additional flags...*/
-	if (argc > 4) {
-		char *p = argv[4];
+	for (i = 4; i < argc; i += 2) {
+		char *p = argv[i];
 
 		/* ignore leading '-' in options: we allow both forms */
 		if (*p == '-')
@@ -87,7 +101,7 @@ widget_add_func(Client *c, int argc, char **argv)
 		if (strcmp(p, "in") == 0) {
 			Widget *frame;
 
-			if (argc < 6) {
+			if (i + 1 >= argc) {
 				sock_send_error(c->sock, "Specify a frame to place widget in\n");
 				return 0;
 			}
@@ -96,13 +110,25 @@ widget_add_func(Client *c, int argc, char **argv)
 			 * This way it will not be placed in the normal screen
 			 * but in the framescreen.
 			 */
-			frame = screen_find_widget(s, argv[5]);
-			if (frame == NULL) {
+			frame = screen_find_widget(s, argv[i + 1]);
+			if ((frame == NULL) || (frame->type != WID_FRAME)) {
 				sock_send_error(c->sock, "Error finding frame\n");
 				return 0;
 			}
 			s = frame->frame_screen;
 		}
+		/* ...and the "source" flag to show a server-side value */
+		else if (strcmp(p, "source") == 0) {
+			if (i + 1 >= argc) {
+				sock_send_error(c->sock, "Specify a data source to show\n");
+				return 0;
+			}
+			if (!sources_widget_type(wtype)) {
+				sock_send_error(c->sock, "Widget type can't show a data source\n");
+				return 0;
+			}
+			source = argv[i + 1];
+		}
 	}
 
 	/* Create the widget */
@@ -111,11 +137,18 @@ widget_add_func(Client *c, int argc, char **argv)
 		sock_send_error(c->sock, "Error adding widget\n");
 		return 0;
 	}
+	if ((source != NULL) && (sources_bind(w, source) < 0)) {
+		widget_destroy(w);
+		sock_send_error(c->sock, "Unknown data source\n");
+		return 0;
+	}
 
 	/* Add the widget to the screen */
 	err = screen_add_widget(s, w);
-	if (err == 0)
+	if (err == 0) {
+		screen_changed_by_client(top);
 		sock_send_string(c->sock, "success\n");
+	}
 	else
 		sock_send_error(c->sock, "Error adding widget\n");
 
@@ -165,8 +198,10 @@ widget_del_func(Client *c, int argc, char **argv)
 	}
 
 	err = screen_remove_widget(s, w);
-	if (err == 0)
+	if (err == 0) {
+		screen_changed_by_client(s);
 		sock_send_string(c->sock, "success\n");
+	}
 	else
 		sock_send_error(c->sock, "Error removing widget\n");
 
@@ -177,6 +212,290 @@ static int not_direction(char c) {
 	return c != 'h' && c != 'v';
 }
 
+/* Convert a number for a widget's short fields, clamped to their range */
+static short
+widget_number(const char *str)
+{
+	long n = strtol(str, NULL, 10);
+
+	return (n < SHRT_MIN) ? SHRT_MIN : (n > SHRT_MAX) ? SHRT_MAX : n;
+}
+
+/**
+ * Tell how many arguments a widget takes in a widget_set_batch tuple:
+ * the pbar labels are not optional there, as the next widget id could
+ * not be told from a label otherwise.
+ * \param w  Widget to set.
+ * \return  Number of arguments behind the widget id; -1 for no type.
+ */
+static int
+widget_set_argc(Widget *w)
+{
+	switch (w->type) {
+	case WID_TITLE:		return 1;
+	case WID_NUM:		return 2;
+	case WID_STRING:
+	case WID_HBAR:
+	case WID_VBAR:
+	case WID_ICON:		return 3;
+	case WID_GRAPH:		return 5;
+	case WID_PBAR:		return 6;
+	case WID_SCROLLER:	return 7;
+	case WID_FRAME:		return 8;
+	default:		return -1;
+	}
+}
+
+
+/**
+ * Tell whether the numeric values of a widget differ from a copy taken
+ * before it was set; widget_strset() checks the strings itself.
+ * \param old  Copy of the widget before it was set.
+ * \param w    The widget.
+ * \return  1 if a value changed, 0 if they are all equal.
+ */
+static int
+widget_moved(const Widget *old, const Widget *w)
+{
+	return (old->x != w->x) || (old->y != w->y)
+	       || (old->width != w->width) || (old->height != w->height)
+	       || (old->left != w->left) || (old->top != w->top)
+	       || (old->right != w->right) || (old->bottom != w->bottom)
+	       || (old->length != w->length) || (old->speed != w->speed)
+	       || (old->promille != w->promille);
+}
+
+
+/**
+ * Check the widget-specific arguments of widget_set and, if asked to,
+ * store them in the widget.
+ * \param w      Widget to set.
+ * \param argc   Number of arguments.
+ * \param argv   The arguments behind the widget id.
+ * \param apply  0 only checks the arguments, 1 also sets the widget.
+ * \return  NULL on success, otherwise the error message for the client.
+ */
+static const char *
+widget_set_values(Widget *w, int argc, char **argv, int apply)
+{
+	Widget old = *w;
+	int icon;
+
+	switch (w->type) {
+	case WID_STRING:		/* String takes "x y text" */
+		if (argc != 3)
+			return "Wrong number of arguments";
+
+		if ((!isdigit((unsigned int) argv[0][0])) ||
+		    (!isdigit((unsigned int) argv[1][0])))
+			return "Invalid coordinates";
+
+		if (!apply)
+			break;
+
+		w->x = widget_number(argv[0]);
+		w->y = widget_number(argv[1]);
+		w->text = widget_strset(w, w->text, argv[2]);
+		debug(RPT_DEBUG, "Widget %s set to %s", w->id, w->text);
+
+		break;
+	case WID_HBAR:			/* Hbar takes "x y length" */
+		if (argc != 3)
+			return "Wrong number of arguments";
+
+		if ((!isdigit((unsigned int) argv[0][0])) ||
+		    (!isdigit((unsigned int) argv[1][0])))
+			return "Invalid coordinates";
+
+		if (!apply)
+			break;
+
+		w->x = widget_number(argv[0]);
+		w->y = widget_number(argv[1]);
+		w->length = widget_number(argv[2]);
+
+		debug(RPT_DEBUG, "Widget %s set to %i", w->id, w->length);
+
+		break;
+	case WID_VBAR:			/* Vbar takes "x y length" */
+		if (argc != 3)
+			return "Wrong number of arguments";
+		if ((!isdigit((unsigned int) argv[0][0])) ||
+		    (!isdigit((unsigned int) argv[1][0])))
+			return "Invalid coordinates";
+
+		if (!apply)
+			break;
+
+		w->x = widget_number(argv[0]);
+		w->y = widget_number(argv[1]);
+		w->length = widget_number(argv[2]);
+
+		debug(RPT_DEBUG, "Widget %s set to %i", w->id, w->length);
+
+		break;
+	case WID_PBAR:			/* Pbar takes "x y width promille [begin-label end-label]" */
+		if (argc < 4 || argc > 6)
+			return "Wrong number of arguments";
+		if ((!isdigit((unsigned int) argv[0][0])) ||
+		    (!isdigit((unsigned int) argv[1][0])))
+			return "Invalid coordinates";
+		if (!apply)
+			break;
+
+		w->begin_label = widget_labelset(w, w->begin_label, (argc >= 5) ? argv[4] : NULL);
+		w->end_label = widget_labelset(w, w->end_label, (argc >= 6) ? argv[5] : NULL);
+		w->x = widget_number(argv[0]);
+		w->y = widget_number(argv[1]);
+		w->width = widget_number(argv[2]);
+		w->promille = widget_number(argv[3]);
+		debug(RPT_DEBUG, "Widget %s set to %i", w->id, w->promille);
+
+		break;
+	case WID_ICON:			/* Icon takes "x y icon" */
+		if (argc != 3)
+			return "Wrong number of arguments";
+
+		if ((!isdigit((unsigned int) argv[0][0])) ||
+		    (!isdigit((unsigned int) argv[1][0])))
+			return "Invalid coordinates";
+		icon = widget_iconname_to_icon(argv[2]);
+		if (icon == -1)
+			return "Invalid icon name";
+
+		if (!apply)
+			break;
+		w->x = widget_number(argv[0]);
+		w->y = widget_number(argv[1]);
+		w->length = icon;
+
+		break;
+	case WID_TITLE:			/* title takes "text" */
+		if (argc != 1)
+			return "Wrong number of arguments";
+
+		if (!apply)
+			break;
+
+		w->text = widget_strset(w, w->text, argv[0]);
+		/* Set width too */
+		w->width = display_props->width;
+		debug(RPT_DEBUG, "Widget %s set to %s", w->id, w->text);
+
+		break;
+	case WID_SCROLLER:		/* Scroller takes "left top right bottom direction speed text" */
+		if (argc != 7)
+			return "Wrong number of arguments";
+
+		if ((!isdigit((unsigned int) argv[0][0])) ||
+		    (!isdigit((unsigned int) argv[1][0])) ||
+		    (!isdigit((unsigned int) argv[2][0])) ||
+		    (!isdigit((unsigned int) argv[3][0])))
+			return "Invalid coordinates";
+
+		/* Direction must be m, v or h*/
+		if (not_direction(argv[4][0]) && argv[4][0] != 'm')
+			return "Invalid direction";
+
+		if (!apply)
+			break;
+
+		w->left = widget_number(argv[0]);
+		w->top = widget_number(argv[1]);
+		w->right = widget_number(argv[2]);
+		w->bottom = widget_number(argv[3]);
+		w->length = argv[4][0];
+		w->speed = widget_number(argv[5]);
+		w->text = widget_strset(w, w->text, argv[6]);
+		debug(RPT_DEBUG, "Widget %s set to %s", w->id, w->text);
+
+		break;
+	case WID_FRAME:			/* Frame takes "left top right bottom wid hgt direction speed" */
+		if (argc != 8)
+			return "Wrong number of arguments";
+
+		if ((!isdigit((unsigned int) argv[0][0])) ||
+		    (!isdigit((unsigned int) argv[1][0])) ||
+		    (!isdigit((unsigned int) argv[2][0])) ||
+		    (!isdigit((unsigned int) argv[3][0])) ||
+		    (!isdigit((unsigned int) argv[4][0])) ||
+		    (!isdigit((unsigned int) argv[5][0])))
+			return "Invalid coordinates";
+
+		if (not_direction(argv[6][0]))
+			return "Invalid direction";
+
+		if (!apply)
+			break;
+
+		w->left = widget_number(argv[0]);
+		w->top = widget_number(argv[1]);
+		w->right = widget_number(argv[2]);
+		w->bottom = widget_number(argv[3]);
+		w->width = widget_number(argv[4]);
+		w->height = widget_number(argv[5]);
+		w->length = argv[6][0];
+		w->speed = widget_number(argv[7]);
+		debug(RPT_DEBUG, "Widget %s set to (%i,%i)-(%i,%i) %ix%i", w->id, w->left, w->top, w->right, w->bottom, w->width, w->height);
+
+		break;
+	case WID_NUM:			/* Num takes "x num" */
+		if (argc != 2)
+			return "Wrong number of arguments";
+
+		if (!isdigit((unsigned int) argv[0][0]))
+			return "Invalid coordinates";
+		if (!isdigit((unsigned int) argv[1][0]))
+			return "Invalid number";
+
+		if (!apply)
+			break;
+
+		w->x = widget_number(argv[0]);
+		w->y = widget_number(argv[1]);
+
+		debug(RPT_DEBUG, "Widget %s set to %i", w->id, w->y);
+
+		break;
+	case WID_GRAPH:			/* Graph takes "x y width height promille" */
+		if (argc != 5)
+			return "Wrong number of arguments";
+
+		if ((!isdigit((unsigned int) argv[0][0])) ||
+		    (!isdigit((unsigned int) argv[1][0])))
+			return "Invalid coordinates";
+		if ((atoi(argv[2]) < 1) || (atoi(argv[2]) > LCD_MAX_WIDTH) ||
+		    (atoi(argv[3]) < 1) || (atoi(argv[3]) > LCD_MAX_HEIGHT))
+			return "Invalid size";
+
+		if (!apply)
+			break;
+
+		w->x = widget_number(argv[0]);
+		w->y = widget_number(argv[1]);
+		w->width = widget_number(argv[2]);
+		w->height = widget_number(argv[3]);
+		/* every value shifts the graph, so this always makes it dirty */
+		widget_graph_add(w, w->width, atoi(argv[4]));
+
+		debug(RPT_DEBUG, "Widget %s added %i", w->id, atoi(argv[4]));
+
+		break;
+	case WID_NONE:
+	default:
+		return "Widget has no type";
+	}
+
+	/* Have the widget rendered again, unless the values are the same */
+	if (apply && widget_moved(&old, w)) {
+		w->dirty = 1;
+		if (w->type == WID_FRAME)
+			screen_layout_serial++;
+	}
+	return NULL;
+}
+
+
 /**
  * Configures information about a widget, such as its size, shape,
  * contents, position, speed, etc.
@@ -188,7 +507,7 @@ static int not_direction(char c) {
 int
 widget_set_func(Client *c, int argc, char **argv)
 {
-	int i;
+	const char *error;
 	char *wid;
 	char *sid;
 
@@ -230,216 +549,95 @@ widget_set_func(Client *c, int argc, char **argv)
 		}
 		return 0;
 	}
-	i = 3;
-	switch (w->type) {
-	case WID_STRING:		/* String takes "x y text" */
-		if (argc != i + 3) {
-			sock_send_error(c->sock, "Wrong number of arguments\n");
-			return 0;
-		}
-
-		if ((!isdigit((unsigned int) argv[i][0])) ||
-		    (!isdigit((unsigned int) argv[i + 1][0]))) {
-			sock_send_error(c->sock, "Invalid coordinates\n");
-			return 0;
-		}
-
-		w->x = atoi(argv[i]);
-		w->y = atoi(argv[i + 1]);
-		free(w->text);
-		w->text = strdup(argv[i + 2]);
-		debug(RPT_DEBUG, "Widget %s set to %s", wid, w->text);
-
-		break;
-	case WID_HBAR:			/* Hbar takes "x y length" */
-		if (argc != i + 3) {
-			sock_send_error(c->sock, "Wrong number of arguments\n");
-			return 0;
-		}
-
-		if ((!isdigit((unsigned int) argv[i][0])) ||
-		    (!isdigit((unsigned int) argv[i + 1][0]))) {
-			sock_send_error(c->sock, "Invalid coordinates\n");
-			return 0;
-		}
-
-		w->x = atoi(argv[i]);
-		w->y = atoi(argv[i + 1]);
-		w->length = atoi(argv[i + 2]);
-
-		debug(RPT_DEBUG, "Widget %s set to %i", wid, w->length);
-
-		break;
-	case WID_VBAR:			/* Vbar takes "x y length" */
-		if (argc != i + 3) {
-			sock_send_error(c->sock, "Wrong number of arguments\n");
-			return 0;
-		}
-		if ((!isdigit((unsigned int) argv[i][0])) ||
-		    (!isdigit((unsigned int) argv[i + 1][0]))) {
-			sock_send_error(c->sock, "Invalid coordinates\n");
-			return 0;
-		}
 
-		w->x = atoi(argv[i]);
-		w->y = atoi(argv[i + 1]);
-		w->length = atoi(argv[i + 2]);
-
-		debug(RPT_DEBUG, "Widget %s set to %i", wid, w->length);
-
-		break;
-	case WID_PBAR:			/* Pbar takes "x y width promille [begin-label end-label]" */
-		if (argc < i + 4 || argc > i + 6) {
-			sock_send_error(c->sock, "Wrong number of arguments\n");
-			return 0;
-		}
-		if ((!isdigit((unsigned int) argv[i][0])) ||
-		    (!isdigit((unsigned int) argv[i + 1][0]))) {
-			sock_send_error(c->sock, "Invalid coordinates\n");
-			return 0;
-		}
-		free(w->begin_label);
-		free(w->end_label);
-		w->begin_label = NULL;
-		w->end_label = NULL;
-		w->x = atoi(argv[i]);
-		w->y = atoi(argv[i + 1]);
-		w->width = atoi(argv[i + 2]);
-		w->promille = atoi(argv[i + 3]);
-		if (argc >= i + 5)
-			w->begin_label = strdup(argv[i + 4]);
-		if (argc >= i + 6)
-			w->end_label = strdup(argv[i + 5]);
-		debug(RPT_DEBUG, "Widget %s set to %i", wid, w->promille);
-
-		break;
-	case WID_ICON:			/* Icon takes "x y icon" */
-		if (argc != i + 3) {
-			sock_send_error(c->sock, "Wrong number of arguments\n");
-			return 0;
-		}
-
-		if ((!isdigit((unsigned int) argv[i][0])) ||
-		    (!isdigit((unsigned int) argv[i + 1][0]))) {
-			sock_send_error(c->sock, "Invalid coordinates\n");
-			return 0;
-		}
-		int icon;
-
-		icon = widget_iconname_to_icon(argv[i + 2]);
-		if (icon == -1) {
-			sock_send_error(c->sock, "Invalid icon name\n");
-			return 0;
-		}
+	error = widget_set_values(w, argc - 3, argv + 3, 1);
+	if (error != NULL) {
+		sock_printf_error(c->sock, "%s\n", error);
+		return 0;
+	}
 
-		w->x = atoi(argv[i]);
-		w->y = atoi(argv[i + 1]);
-		w->length = icon;
+	screen_changed_by_client(s);
+	sock_send_string(c->sock, "success\n");
+	return 0;
+}
 
-		break;
-	case WID_TITLE:			/* title takes "text" */
-		if (argc != i + 1) {
-			sock_send_error(c->sock, "Wrong number of arguments\n");
-			return 0;
-		}
 
-		free(w->text);
-		w->text = strdup(argv[i]);
-		/* Set width too */
-		w->width = display_props->width;
-		debug(RPT_DEBUG, "Widget %s set to %s", wid, w->text);
+/**
+ * Sets many widgets of a screen at once. The tuples take the same
+ * arguments as widget_set, except that the labels of a pbar must be
+ * given (an empty label means none). All tuples are checked before any
+ * widget is set, so either all widgets change in the same frame or none.
+ *
+ *\verbatim
+ * widget_set_batch <screenid> <widgetid> <widget-SPECIFIC-data> [<widgetid> <widget-SPECIFIC-data> ...]
+ *\endverbatim
+ */
+int
+widget_set_batch_func(Client *c, int argc, char **argv)
+{
+	Widget *widgets[MAX_BATCH_WIDGETS];
+	int counts[MAX_BATCH_WIDGETS];
+	int first[MAX_BATCH_WIDGETS];
+	const char *error;
+	int num = 0;
+	int i, n;
 
-		break;
-	case WID_SCROLLER:		/* Scroller takes "left top right bottom direction speed text" */
-		if (argc != i + 7) {
-			sock_send_error(c->sock, "Wrong number of arguments\n");
-			return 0;
-		}
+	Screen *s;
+	Widget *w;
 
-		if ((!isdigit((unsigned int) argv[i][0])) ||
-		    (!isdigit((unsigned int) argv[i + 1][0])) ||
-		    (!isdigit((unsigned int) argv[i + 2][0])) ||
-		    (!isdigit((unsigned int) argv[i + 3][0]))) {
-			sock_send_error(c->sock, "Invalid coordinates\n");
-			return 0;
-		}
+	if (c->state != ACTIVE)
+		return 1;
 
-		/* Direction must be m, v or h*/
-		if (not_direction(argv[i + 4][0]) && argv[i + 4][0] != 'm') {
-			sock_send_error(c->sock, "Invalid direction\n");
-			return 0;
-		}
+	if (argc < 4) {
+		sock_send_error(c->sock, "Usage: widget_set_batch <screenid> <widgetid> <widget-SPECIFIC-data> [...]\n");
+		return 0;
+	}
 
-		w->left = atoi(argv[i]);
-		w->top = atoi(argv[i + 1]);
-		w->right = atoi(argv[i + 2]);
-		w->bottom = atoi(argv[i + 3]);
-		w->length = argv[i + 4][0];
-		w->speed = atoi(argv[i + 5]);
-		free(w->text);
-		w->text = strdup(argv[i + 6]);
-		debug(RPT_DEBUG, "Widget %s set to %s", wid, w->text);
+	s = client_find_screen(c, argv[1]);
+	if (s == NULL) {
+		sock_send_error(c->sock, "Unknown screen id\n");
+		return 0;
+	}
 
-		break;
-	case WID_FRAME:			/* Frame takes "left top right bottom wid hgt direction speed" */
-		if (argc != i + 8) {
-			sock_send_error(c->sock, "Wrong number of arguments\n");
+	/* Split the tuples and check them all */
+	for (i = 2; i < argc; i += 1 + n) {
+		w = screen_find_widget(s, argv[i]);
+		if (w == NULL) {
+			sock_printf_error(c->sock, "Unknown widget id (%.40s)\n", argv[i]);
 			return 0;
 		}
-
-		if ((!isdigit((unsigned int) argv[i][0])) ||
-		    (!isdigit((unsigned int) argv[i + 1][0])) ||
-		    (!isdigit((unsigned int) argv[i + 2][0])) ||
-		    (!isdigit((unsigned int) argv[i + 3][0])) ||
-		    (!isdigit((unsigned int) argv[i + 4][0])) ||
-		    (!isdigit((unsigned int) argv[i + 5][0]))) {
-			sock_send_error(c->sock, "Invalid coordinates\n");
+		n = widget_set_argc(w);
+		if ((n < 0) || (i + n >= argc)) {
+			sock_printf_error(c->sock, "Wrong number of arguments for widget %.40s\n", argv[i]);
 			return 0;
 		}
-
-		if (not_direction(argv[i + 6][0])) {
-			sock_send_error(c->sock, "Invalid direction\n");
+		if (num >= MAX_BATCH_WIDGETS) {
+			sock_send_error(c->sock, "Too many widgets\n");
 			return 0;
 		}
 
-		w->left = atoi(argv[i]);
-		w->top = atoi(argv[i + 1]);
-		w->right = atoi(argv[i + 2]);
-		w->bottom = atoi(argv[i + 3]);
-		w->width = atoi(argv[i + 4]);
-		w->height = atoi(argv[i + 5]);
-		w->length = argv[i + 6][0];
-		w->speed = atoi(argv[i + 7]);
-		debug(RPT_DEBUG, "Widget %s set to (%i,%i)-(%i,%i) %ix%i", wid, w->left, w->top, w->right, w->bottom, w->width, w->height);
-
-		break;
-	case WID_NUM:			/* Num takes "x num" */
-		if (argc != i + 2) {
-			sock_send_error(c->sock, "Wrong number of arguments\n");
-			return 0;
+		widgets[num] = w;
+		first[num] = i + 1;
+		counts[num] = n;
+		/* Empty pbar labels at the end are no labels */
+		if (w->type == WID_PBAR) {
+			while ((counts[num] > 4) && (argv[i + counts[num]][0] == '\0'))
+				counts[num]--;
 		}
 
-		if (!isdigit((unsigned int) argv[i][0])) {
-			sock_send_error(c->sock, "Invalid coordinates\n");
-			return 0;
-		}
-		if (!isdigit((unsigned int) argv[i + 1][0])) {
-			sock_send_error(c->sock, "Invalid number\n");
+		error = widget_set_values(w, counts[num], argv + first[num], 0);
+		if (error != NULL) {
+			sock_printf_error(c->sock, "%s (widget %.40s)\n", error, argv[i]);
 			return 0;
 		}
-
-		w->x = atoi(argv[i]);
-		w->y = atoi(argv[i + 1]);
-
-		debug(RPT_DEBUG, "Widget %s set to %i", wid, w->y);
-
-		break;
-	case WID_NONE:
-	default:
-		sock_send_error(c->sock, "Widget has no type\n");
-		return 0;
+		num++;
 	}
 
+	/* Now set them; none of this can fail any more */
+	for (i = 0; i < num; i++)
+		widget_set_values(widgets[i], counts[i], argv + first[i], 1);
+
+	screen_changed_by_client(s);
 	sock_send_string(c->sock, "success\n");
 	return 0;
 }
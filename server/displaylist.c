@@ -0,0 +1,265 @@
+/** \file server/displaylist.c
+ * This file contains lists of recorded driver output operations. The core
+ * records a frame into such a list while it is rendered, and hands it to
+ * the drivers once it is complete.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "shared/report.h"
+
+#include "displaylist.h"
+
+
+/**
+ * Append a copy of an operation to a list; strings are copied too.
+ * \param list  The list.
+ * \param op    The operation.
+ * \return  -1 on error, 0 on success.
+ */
+int
+displaylist_add(DisplayList *list, const DriverOp *op)
+{
+	DriverOp *new_op;
+
+	if (list->count >= list->size) {
+		int size = (list->size > 0) ? list->size * 2 : 64;
+		DriverOp *ops = realloc(list->ops, size * sizeof(DriverOp));
+
+		if (ops == NULL) {
+			report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+			return -1;
+		}
+		list->ops = ops;
+		list->size = size;
+	}
+
+	new_op = &list->ops[list->count];
+	*new_op = *op;
+	new_op->s1 = (op->s1 != NULL) ? strdup(op->s1) : NULL;
+	new_op->s2 = (op->s2 != NULL) ? strdup(op->s2) : NULL;
+	if (((op->s1 != NULL) && (new_op->s1 == NULL))
+	    || ((op->s2 != NULL) && (new_op->s2 == NULL))) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		free((char *) new_op->s1);
+		free((char *) new_op->s2);
+		return -1;
+	}
+	list->count++;
+	return 0;
+}
+
+
+/* Free the strings of an operation */
+static void
+displaylist_free_op(DriverOp *op)
+{
+	free((char *) op->s1);
+	free((char *) op->s2);
+}
+
+
+/**
+ * Empty a list, keeping its memory for the next frame.
+ * \param list  The list.
+ */
+void
+displaylist_reset(DisplayList *list)
+{
+	int i;
+
+	for (i = 0; i < list->count; i++)
+		displaylist_free_op(&list->ops[i]);
+	list->count = 0;
+}
+
+
+/**
+ * Empty a list and release its memory.
+ * \param list  The list.
+ */
+void
+displaylist_free(DisplayList *list)
+{
+	displaylist_reset(list);
+	free(list->ops);
+	list->ops = NULL;
+	list->size = 0;
+}
+
+
+/* Mark the cells an operation other than text may write to */
+static void
+displaylist_mark(unsigned char *mask, int width, int height,
+		 int x, int y, int w, int h)
+{
+	int i, j;
+
+	for (j = y; j < y + h; j++) {
+		if ((j < 1) || (j > height))
+			continue;
+		for (i = x; i < x + w; i++) {
+			if ((i >= 1) && (i <= width))
+				mask[(j - 1) * width + i - 1] = 1;
+		}
+	}
+}
+
+
+/* Write a string into the text of a frame, clipped like the drivers do.
+ * Returns -1 if it covers a cell written by another operation before. */
+static int
+displaylist_text(unsigned char *text, const unsigned char *mask, int width,
+		 int height, int x, int y, const char *str, int len)
+{
+	int i;
+
+	if ((y < 1) || (y > height))
+		return 0;
+	for (i = 0; (i < len) && (str[i] != '\0') && (x + i <= width); i++) {
+		int cell = (y - 1) * width + x + i - 1;
+
+		if (x + i < 1)
+			continue;
+		if (mask[cell])
+			return -1;
+		text[cell] = (unsigned char) str[i];
+	}
+	return 0;
+}
+
+
+/*
+ * Apply a list to a driver that has blit_text: the text written after the
+ * last clear is composed into a grid and handed over in a single call,
+ * followed by all other operations in the order recorded. That is only
+ * done if no text is written over the output of another operation, which
+ * would then be overwritten itself.
+ * Returns -1 if the list has to be applied operation by operation.
+ */
+static int
+displaylist_blit(const DisplayList *list, Driver *drv)
+{
+	int width, height;
+	int start = -1;
+	unsigned char *text;
+	unsigned char *mask;
+	LCDRect rect;
+	int i;
+
+	if ((drv->width == NULL) || (drv->height == NULL))
+		return -1;
+	width = drv->width(drv);
+	height = drv->height(drv);
+	if ((width <= 0) || (height <= 0))
+		return -1;
+
+	for (i = list->count - 1; i >= 0; i--) {
+		if (list->ops[i].type == DOP_CLEAR) {
+			start = i;
+			break;
+		}
+	}
+	if (start < 0)
+		return -1;
+
+	text = malloc(2 * width * height);
+	if (text == NULL)
+		return -1;
+	mask = text + width * height;
+	memset(text, ' ', width * height);
+	memset(mask, 0, width * height);
+
+	for (i = start + 1; i < list->count; i++) {
+		const DriverOp *op = &list->ops[i];
+		char c;
+
+		switch (op->type) {
+		case DOP_STRING:
+			if (displaylist_text(text, mask, width, height, op->x, op->y,
+					     op->s1, width - op->x + 1) < 0)
+				goto inorder;
+			break;
+		case DOP_CHR:
+			c = (char) op->a;
+			if (displaylist_text(text, mask, width, height, op->x, op->y,
+					     &c, 1) < 0)
+				goto inorder;
+			break;
+		case DOP_VBAR:
+			displaylist_mark(mask, width, height, op->x, op->y - op->a + 1, 1, op->a);
+			break;
+		case DOP_HBAR:
+			displaylist_mark(mask, width, height, op->x, op->y, op->a, 1);
+			break;
+		case DOP_PBAR:
+			displaylist_mark(mask, width, height, op->x, op->y, op->a, 1);
+			break;
+		case DOP_NUM:
+			displaylist_mark(mask, width, height, op->x, 1,
+					 (op->a == 10) ? 1 : 3, height);
+			break;
+		case DOP_ICON:
+			displaylist_mark(mask, width, height, op->x, op->y,
+					 (op->a >= 0x200) ? 2 : 1, 1);
+			break;
+		case DOP_HEARTBEAT:
+			displaylist_mark(mask, width, height, width, 1, 1, 1);
+			break;
+		case DOP_CURSOR:
+			displaylist_mark(mask, width, height, op->x, op->y, 1, 1);
+			break;
+		default:
+			break;
+		}
+	}
+
+	for (i = 0; i <= start; i++)
+		driver_apply_op(drv, &list->ops[i]);
+	rect.x = 1;
+	rect.y = 1;
+	rect.width = width;
+	rect.height = height;
+	drv->blit_text(drv, text, width, &rect);
+	for (i = start + 1; i < list->count; i++) {
+		if ((list->ops[i].type != DOP_STRING) && (list->ops[i].type != DOP_CHR))
+			driver_apply_op(drv, &list->ops[i]);
+	}
+	free(text);
+	return 0;
+
+inorder:
+	free(text);
+	return -1;
+}
+
+
+/**
+ * Apply all operations of a list to a driver, in the order recorded.
+ * Drivers with a blit_text() function get the text of a frame in one call
+ * instead, if the result is the same.
+ * \param list  The list.
+ * \param drv   The driver.
+ */
+void
+displaylist_apply(const DisplayList *list, Driver *drv)
+{
+	int i;
+
+	if ((drv->caps & DRV_CAP_BLIT_TEXT) && (displaylist_blit(list, drv) == 0))
+		return;
+
+	for (i = 0; i < list->count; i++)
+		driver_apply_op(drv, &list->ops[i]);
+}
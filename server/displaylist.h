@@ -0,0 +1,35 @@
+/** \file server/displaylist.h
+ * Interface to lists of recorded driver output operations.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef DISPLAYLIST_H
+#define DISPLAYLIST_H
+
+#include "driver.h"
+
+/** List of output operations */
+typedef struct DisplayList {
+	DriverOp *ops;
+	int count;
+	int size;
+} DisplayList;
+
+/* Append a copy of an operation (strings included). */
+int displaylist_add(DisplayList *list, const DriverOp *op);
+
+/* Empty a list, keeping its memory. */
+void displaylist_reset(DisplayList *list);
+
+/* Empty a list and release its memory. */
+void displaylist_free(DisplayList *list);
+
+/* Apply all operations of a list to a driver. */
+void displaylist_apply(const DisplayList *list, Driver *drv);
+
+#endif
@@ -30,7 +30,15 @@
 #include "widget.h"
 #include "driver.h"
 #include "drivers.h"
+#include "reconnect.h"
+#include "stats.h"
+#include "flightrec.h"
+#include "warmstate.h"
+#include "sock.h"
 #include "drivers/lcd.h"
+#ifdef HAVE_STATIC_DRIVERS
+# include "static_drivers.h"
+#endif
 /* lcd.h is used for the driver API definition */
 
 
@@ -73,6 +81,11 @@ DriverSymbols driver_symbols[] = {
 	{ "output",             offsetof(Driver, output),             0 },
 	{ "get_key",            offsetof(Driver, get_key),            0 },
 	{ "get_info",           offsetof(Driver, get_info),           0 },
+	{ "flush_spans",        offsetof(Driver, flush_spans),        0 },
+	{ "blit_text",          offsetof(Driver, blit_text),          0 },
+	{ "get_key_fd",         offsetof(Driver, get_key_fd),         0 },
+	{ "scroll_text",        offsetof(Driver, scroll_text),        0 },
+	{ "get_key_event",      offsetof(Driver, get_key_event),      0 },
 	{ NULL, 0, 0 }
 };
 
@@ -82,19 +95,49 @@ DriverSymbols driver_symbols[] = {
 static int request_display_width(void);
 static int request_display_height(void);
 static int driver_store_private_ptr(Driver *driver, void *private_data);
-
-
-/** Create a driver object.
+static void driver_flush_busy(Driver *driver, int usecs);
+
+/** Function applying a recorded output operation to a driver */
+typedef void (*DriverApplyFunc)(Driver *drv, const DriverOp *op);
+
+/** A driver together with the data only the server core uses */
+typedef struct driver_core {
+	Driver driver;				/**< The driver, must come first */
+	DriverApplyFunc apply[DOP_COUNT];	/**< Dispatch table per operation */
+	int frame_skip;				/**< Skip flushes while busy */
+	long reported_busy;			/**< From flush_busy(), in us */
+	long busy;				/**< Busy after flush_end, in us */
+	unsigned long flush_end;		/**< When the last flush returned */
+	int key_fd;				/**< Driver's descriptor watched for keys, or -1 */
+	int key_dup;				/**< Duplicate of it given to the poller */
+	int key_fd_refused;			/**< Descriptor the poller did not take, or -1 */
+	int key_reinit;				/**< Value of reinits when key_fd was taken */
+	volatile int reinits;			/**< Count of driver_reinit() calls */
+	int flight_id;				/**< Number in the flight record, or -1 */
+	int output_known;			/**< Non-zero once output() was called */
+	int output_sent;			/**< Last state passed to output() */
+	int tiled;				/**< Shows a part of its display, see driver_set_tile() */
+	LCDRect tile;				/**< That part */
+	int tile_corner;			/**< The tile has the display's heartbeat */
+} DriverCore;
+
+#define DRIVER_CORE(drv)	((DriverCore *) (drv))
+
+static unsigned int driver_find_caps(Driver *driver);
+static void driver_init_dispatch(Driver *driver);
+static void driver_apply_tile_op(Driver *drv, const DriverOp *op);
+
+
+/** Create a driver object without initializing it.
  * Allocate memory for the driver object, load it from file and bind its symbols.
  * \param name      Name under which the driver shall be known further on.
  * \param filename  Name of the file containing the drivers object code.
  * \return          Pointer to the freshly created driver; \c NULL on error.
  */
 Driver *
-driver_load(const char *name, const char *filename)
+driver_new(const char *name, const char *filename)
 {
 	Driver *driver = NULL;
-	int res;
 
 	report(RPT_DEBUG, "%s(name=\"%.40s\", filename=\"%.80s\")",
 		__FUNCTION__, name, filename);
@@ -104,11 +147,15 @@ driver_load(const char *name, const char *filename)
 		return NULL;
 
 	/* Allocate memory for new driver struct */
-	driver = calloc(1, sizeof(Driver));
+	driver = calloc(1, sizeof(DriverCore));
 	if (driver == NULL) {
 		report(RPT_ERR, "%s: error allocating driver", __FUNCTION__);
 		return NULL;
 	}
+	DRIVER_CORE(driver)->key_fd = -1;
+	DRIVER_CORE(driver)->key_dup = -1;
+	DRIVER_CORE(driver)->key_fd_refused = -1;
+	DRIVER_CORE(driver)->flight_id = flightrec_driver(name);
 
 	/* And store its name and filename */
 	driver->name = malloc(strlen(name) + 1);
@@ -140,13 +187,31 @@ driver_load(const char *name, const char *filename)
 	/* Check module version */
 	if (strcmp(*(driver->api_version), API_VERSION) != 0) {
 		report(RPT_ERR, "Driver [%.40s] is of an incompatible version", name);
-		driver_unbind_module(driver);
-		free(driver->name);
-		free(driver->filename);
-		free(driver);
+		driver_free(driver);
 		return NULL;
 	}
 
+	/* The driver's init function may drop capabilities it cannot use */
+	driver->caps = driver_find_caps(driver);
+
+	DRIVER_CORE(driver)->frame_skip = config_get_bool(name, "FrameSkip", 0,
+		config_get_bool("Server", "FrameSkip", 0, 1));
+
+	return driver;
+}
+
+
+/** Initialize a driver created by driver_new().
+ * If the driver's init function fails, the driver object is freed.
+ * Several drivers may be initialized at the same time on different threads.
+ * \param driver  Pointer to the driver object.
+ * \return        Return code of the driver's init function; <0 on error.
+ */
+int
+driver_init(Driver *driver)
+{
+	int res;
+
 	/* Call the init function */
 	debug(RPT_DEBUG, "%s: Calling driver [%.40s] init function",
 		__FUNCTION__, driver->name);
@@ -158,19 +223,82 @@ driver_load(const char *name, const char *filename)
 		/* Driver load failed, driver should not be added to list
 		 * Free driver structure again
 		 */
-		driver_unbind_module(driver);
-		free(driver->name);
-		free(driver->filename);
-		free(driver);
-		return NULL;
+		driver_free(driver);
+		return res;
 	}
 
+	driver_init_dispatch(driver);
+
 	debug(RPT_NOTICE, "Driver [%.40s] loaded", driver->name);
 
+	return res;
+}
+
+
+/** Initialize a driver again after its device was lost.
+ * The driver is closed first, then its init function is called. Unlike
+ * driver_init() the driver object is kept if init fails, so this can be
+ * tried over and over; a failed init is closed by the next attempt.
+ * \param driver  Pointer to the driver object.
+ * \return        Return code of the driver's init function; <0 on error.
+ */
+int
+driver_reinit(Driver *driver)
+{
+	int res;
+
+	if ((driver->private_data != NULL) && (driver->close != NULL))
+		driver->close(driver);
+	driver->private_data = NULL;
+	/* a new descriptor for keys may get the number of the old one */
+	DRIVER_CORE(driver)->reinits++;
+
+	debug(RPT_DEBUG, "%s: Calling driver [%.40s] init function",
+		__FUNCTION__, driver->name);
+
+	res = driver->init(driver);
+	if (res < 0) {
+		debug(RPT_INFO, "Driver [%.40s] init failed again, return code %d",
+			driver->name, res);
+		return res;
+	}
+
+	driver_init_dispatch(driver);
+	return res;
+}
+
+
+/** Create a driver object.
+ * Allocate memory for the driver object, load it from file, bind its symbols
+ * and initialize it.
+ * \param name      Name under which the driver shall be known further on.
+ * \param filename  Name of the file containing the drivers object code.
+ * \return          Pointer to the freshly created driver; \c NULL on error.
+ */
+Driver *
+driver_load(const char *name, const char *filename)
+{
+	Driver *driver = driver_new(name, filename);
+
+	if ((driver == NULL) || (driver_init(driver) < 0))
+		return NULL;
 	return driver;
 }
 
 
+/** Free a driver object that is not initialized, or whose init failed.
+ * \param driver  Driver to free.
+ */
+void
+driver_free(Driver *driver)
+{
+	driver_unbind_module(driver);
+	free(driver->name);
+	free(driver->filename);
+	free(driver);
+}
+
+
 /** Unload driver from memory.
  * \param driver  Driver to unload.
  * \retval <0     Error.
@@ -182,6 +310,7 @@ driver_unload(Driver *driver)
 	debug(RPT_NOTICE, "Closing driver [%.40s]", driver->name);
 
 	/* close the driver, if its \c close method is [already] defined */
+	driver_unwatch_keys(driver);
 	if (driver->close != NULL)
 		driver->close(driver);
 
@@ -202,7 +331,50 @@ driver_unload(Driver *driver)
 }
 
 
-/** Dynamically load a module and bind it to the Driver's symbols.
+#ifdef HAVE_STATIC_DRIVERS
+/* Find the driver linked into LCDd whose module a file would hold */
+static const StaticDriver *
+driver_find_static(const char *filename)
+{
+	const char *base = strrchr(filename, '/');
+	size_t len;
+	int i;
+
+	base = (base != NULL) ? base + 1 : filename;
+	len = strcspn(base, ".");
+	for (i = 0; static_drivers[i].name != NULL; i++) {
+		if ((strlen(static_drivers[i].name) == len)
+		    && (strncmp(static_drivers[i].name, base, len) == 0))
+			return &static_drivers[i];
+	}
+	return NULL;
+}
+#endif
+
+
+/* Look up a symbol in a driver's module, or in the driver linked into LCDd */
+static void *
+driver_find_symbol(Driver *driver, const char *name)
+{
+#ifdef HAVE_STATIC_DRIVERS
+	const StaticDriver *sd = driver_find_static(driver->filename);
+
+	if (sd != NULL) {
+		const StaticSymbol *sym;
+
+		for (sym = sd->symbols; sym->name != NULL; sym++) {
+			if (strcmp(sym->name, name) == 0)
+				return sym->addr;
+		}
+		return NULL;
+	}
+#endif
+	return dlsym(driver->module_handle, name);
+}
+
+
+/** Dynamically load a module and bind it to the Driver's symbols. Drivers
+ * linked into LCDd are bound without loading anything.
  * \param driver  Pointer to the Driver object.
  * \retval <0     Error.
  * \retval  0     Success.
@@ -216,8 +388,14 @@ driver_bind_module(Driver *driver)
 	debug(RPT_DEBUG, "%s(driver=[%.40s])", __FUNCTION__, driver->name);
 
 	/* Load the module */
-	driver->module_handle = dlopen(driver->filename, RTLD_NOW);
-	if (driver->module_handle == NULL) {
+#ifdef HAVE_STATIC_DRIVERS
+	if (driver_find_static(driver->filename) != NULL) {
+		debug(RPT_DEBUG, "%s: driver is linked into LCDd", __FUNCTION__);
+		driver->module_handle = NULL;
+	}
+	else
+#endif
+	if ((driver->module_handle = dlopen(driver->filename, RTLD_NOW)) == NULL) {
 		report(RPT_ERR, "Could not open driver module %.40s: %s",
 			driver->filename, dlerror());
 		return -1;
@@ -236,13 +414,13 @@ driver_bind_module(Driver *driver)
 			strcpy(s, *(driver->symbol_prefix));
 			strcat(s, driver_symbols[i].name);
 			debug(RPT_DEBUG, "%s: finding symbol: %s", __FUNCTION__, s);
-			*p = dlsym(driver->module_handle, s);
+			*p = driver_find_symbol(driver, s);
 			free(s);
 		}
 		/* 2) try to retrieve the symbol without the symbol prefix */
 		if (*p == NULL) {
 			debug(RPT_DEBUG, "%s: finding symbol: %s", __FUNCTION__, driver_symbols[i].name);
-			*p = dlsym(driver->module_handle, driver_symbols[i].name);
+			*p = driver_find_symbol(driver, driver_symbols[i].name);
 		}
 
 		if (*p != NULL) {
@@ -262,7 +440,8 @@ driver_bind_module(Driver *driver)
 	if (missing_symbols > 0) {
   		report(RPT_ERR, "Driver [%.40s]  misses %d required symbols",
 			driver->name, missing_symbols);
-		dlclose(driver->module_handle);
+		if (driver->module_handle != NULL)
+			dlclose(driver->module_handle);
 		return -1;
 	}
 
@@ -283,6 +462,18 @@ driver_bind_module(Driver *driver)
 	driver->request_display_width	= request_display_width;
 	driver->request_display_height	= request_display_height;
 
+	/* Device loss and transport time */
+	driver->lost_device		= reconnect_lost;
+	driver->flush_busy		= driver_flush_busy;
+
+	/* Statistics */
+	driver->count_io		= stats_driver_count;
+	driver->clock			= stats_clock;
+
+	/* State kept over a restart */
+	driver->save_state		= warmstate_save;
+	driver->load_state		= warmstate_load;
+
 	return 0;
 }
 
@@ -297,7 +488,8 @@ driver_unbind_module(Driver *driver)
 {
 	debug(RPT_DEBUG, "%s(driver=[%.40s])", __FUNCTION__, driver->name);
 
-	dlclose(driver->module_handle);
+	if (driver->module_handle != NULL)
+		dlclose(driver->module_handle);
 
 	return 0;
 }
@@ -358,6 +550,176 @@ driver_supports_multiple(Driver *driver)
 }
 
 
+/* Take note that the device goes on being busy after the current flush */
+static void
+driver_flush_busy(Driver *driver, int usecs)
+{
+	DriverCore *core = DRIVER_CORE(driver);
+
+	if (usecs > core->reported_busy)
+		core->reported_busy = usecs;
+}
+
+
+/** Tell how long a driver is still busy with its last flush.
+ * That is as long as the driver said with flush_busy(), e.g. while a slow
+ * serial line transmits the data the flush wrote, but at least as long
+ * as the flush took: a driver whose flushes take long is flushed at most
+ * every other time it could be, so it cannot hold the others up.
+ * \param drv  Pointer to the driver object.
+ * \return     Time in microseconds until it may be flushed again; 0 if now.
+ */
+long
+driver_busy(Driver *drv)
+{
+	DriverCore *core = DRIVER_CORE(drv);
+	unsigned long passed;
+
+	if (core->busy == 0)
+		return 0;
+
+	passed = stats_clock() - core->flush_end;
+	if (passed >= (unsigned long) core->busy) {
+		core->busy = 0;
+		return 0;
+	}
+	return core->busy - passed;
+}
+
+
+/** Take note that a driver's flush just returned; see driver_busy().
+ * \param drv    Pointer to the driver object.
+ * \param start  stats_clock() when the flush was called.
+ */
+void
+driver_flushed(Driver *drv, unsigned long start)
+{
+	DriverCore *core = DRIVER_CORE(drv);
+	long took;
+
+	core->flush_end = stats_clock();
+	took = core->flush_end - start;
+	core->busy = (core->frame_skip) ? max(took, core->reported_busy) : 0;
+	core->reported_busy = 0;
+	flightrec_event(FLIGHT_FLUSH, core->flight_id, took);
+}
+
+
+/** Get a driver's number in the flight record.
+ * \param drv  Pointer to the driver object.
+ * \return     Its id for flightrec_event(), or -1 if it has none.
+ */
+int
+driver_flight_id(Driver *drv)
+{
+	return DRIVER_CORE(drv)->flight_id;
+}
+
+
+/** Make a driver a tile of its display: it shows the part of the display
+ * from the given position on, as large as the driver itself. Operations
+ * are moved to the driver's coordinates, and those that fall outside the
+ * tile are left out.
+ * \param drv     Pointer to the driver object.
+ * \param x       Column of the display the tile's first column shows.
+ * \param y       Row of the display the tile's first row shows.
+ * \param corner  Non-zero if the tile has the upper right corner of the
+ *                display, where the heartbeat is shown.
+ */
+void
+driver_set_tile(Driver *drv, int x, int y, int corner)
+{
+	DriverCore *core = DRIVER_CORE(drv);
+
+	core->tiled = 1;
+	core->tile.x = x;
+	core->tile.y = y;
+	core->tile.width = drv->width(drv);
+	core->tile.height = drv->height(drv);
+	core->tile_corner = corner;
+}
+
+
+/** Get the part of its display a tile shows.
+ * \param drv   Pointer to the driver object.
+ * \param rect  Set to the part of the display, if it is a tile.
+ * \return      Non-zero if the driver is a tile.
+ */
+int
+driver_get_tile(Driver *drv, LCDRect *rect)
+{
+	DriverCore *core = DRIVER_CORE(drv);
+
+	if (core->tiled && (rect != NULL))
+		*rect = core->tile;
+	return core->tiled;
+}
+
+
+/** Watch the descriptor an input driver gives for its keys along with the
+ * client sockets, so the main loop wakes up for keys instead of polling
+ * the driver. The poller gets a duplicate, which stays valid when the
+ * driver closes its descriptor, e.g. while it is being reconnected; a lost
+ * device then makes the duplicate readable and the main loop notices the
+ * driver is offline. Called from the main thread only.
+ * \param drv  Pointer to the driver object.
+ * \retval 1   The driver's keys are watched.
+ * \retval 0   The driver has to be polled.
+ */
+int
+driver_watch_keys(Driver *drv)
+{
+	DriverCore *core = DRIVER_CORE(drv);
+	int reinits = core->reinits;
+	int fd = -1;
+
+	/* only an int is read, this needs no lock against a flush thread */
+	if ((drv->get_key_fd != NULL) && reconnect_online(drv))
+		fd = drv->get_key_fd(drv);
+
+	if ((fd == core->key_fd) && (reinits == core->key_reinit))
+		return (core->key_fd >= 0) ? 1 : 0;
+
+	driver_unwatch_keys(drv);
+	if (reinits != core->key_reinit)
+		core->key_fd_refused = -1;
+	core->key_reinit = reinits;
+	if ((fd < 0) || (fd == core->key_fd_refused))
+		return 0;
+
+	core->key_dup = dup(fd);
+	if ((core->key_dup < 0) || (sock_watch_input(core->key_dup) < 0)) {
+		/* e.g. a regular file; keep polling it */
+		if (core->key_dup >= 0)
+			close(core->key_dup);
+		core->key_dup = -1;
+		core->key_fd_refused = fd;
+		return 0;
+	}
+	core->key_fd = fd;
+	debug(RPT_DEBUG, "Driver [%.40s] keys are watched on descriptor %d",
+		drv->name, fd);
+	return 1;
+}
+
+
+/** Stop watching the descriptor of a driver's keys, if it is watched.
+ * \param drv  Pointer to the driver object.
+ */
+void
+driver_unwatch_keys(Driver *drv)
+{
+	DriverCore *core = DRIVER_CORE(drv);
+
+	if (core->key_dup >= 0) {
+		sock_unwatch_input(core->key_dup);
+		close(core->key_dup);
+		core->key_dup = -1;
+	}
+	core->key_fd = -1;
+}
+
+
 static int
 driver_store_private_ptr(Driver *driver, void *private_data)
 {
@@ -387,6 +749,19 @@ request_display_height(void)
 }
 
 
+/* Number of cells the alternative bars fill: those at positions pos with
+ * 2 * pos < promille * len / 500 + 1, found without testing each cell */
+static int
+driver_alt_bar_cells(int len, int promille)
+{
+	long level = (long) promille * len / 500;
+
+	if (level < 0)
+		return 0;
+	return (level / 2 + 1 < len) ? level / 2 + 1 : len;
+}
+
+
 /** Draw a vertical bar bottom-up.
  * Fallback for the driver's \c vbar method if the driver does not provide one.
  * \param drv      Pointer to driver structure.
@@ -408,13 +783,8 @@ driver_alt_vbar(Driver *drv, int x, int y, int len, int promille, int options)
 	if (drv->chr == NULL)
 		return;
 
-	for (pos = 0; pos < len; pos++) {
-		if (2 * pos < ((long) promille * len / 500 + 1)) {
-			drv->chr(drv, x, y-pos, '|');
-		} else {
-			; /* print nothing */
-		}
-	}
+	for (pos = 0; pos < driver_alt_bar_cells(len, promille); pos++)
+		drv->chr(drv, x, y-pos, '|');
 }
 
 
@@ -439,13 +809,8 @@ driver_alt_hbar(Driver *drv, int x, int y, int len, int promille, int options)
 	if (drv->chr == NULL)
 		return;
 
-	for (pos = 0; pos < len; pos++) {
-		if (2 * pos < ((long) promille * len / 500 + 1)) {
-			drv->chr(drv, x+pos, y, '-');
-		} else {
-			; /* print nothing */
-		}
-	}
+	for (pos = 0; pos < driver_alt_bar_cells(len, promille); pos++)
+		drv->chr(drv, x+pos, y, '-');
 }
 
 /**
@@ -461,7 +826,7 @@ driver_alt_hbar(Driver *drv, int x, int y, int len, int promille, int options)
  * \param end_label    Optional text to render at the end of the pbar.
  */
 void
-driver_pbar(Driver *drv, int x, int y, int width, int promille, char *begin_label, char *end_label)
+driver_pbar(Driver *drv, int x, int y, int width, int promille, const char *begin_label, const char *end_label)
 {
 	int begin_length, end_length, len;
 
@@ -475,7 +840,7 @@ driver_pbar(Driver *drv, int x, int y, int width, int promille, char *begin_labe
 	 * not provide a pbar method *and* no labels are given, draw []
 	 * around the hbar to mark the beginning and end of the bar.
 	 */
-	if (!drv->pbar && begin_label == NULL && end_label == NULL) {
+	if (!(drv->caps & DRV_CAP_PBAR) && begin_label == NULL && end_label == NULL) {
 		begin_label = "[";
 		end_label = "]";
 	}
@@ -494,9 +859,9 @@ driver_pbar(Driver *drv, int x, int y, int width, int promille, char *begin_labe
 		x += begin_length;
 	}
 
-	if (drv->pbar)
+	if (drv->caps & DRV_CAP_PBAR)
 		drv->pbar(drv, x, y, len, promille);
-	else if (drv->hbar)
+	else if (drv->caps & DRV_CAP_HBAR)
 		drv->hbar(drv, x, y, len, promille, BAR_PATTERN_FILLED);
 	else
 		driver_alt_hbar(drv, x, y, len, promille, BAR_PATTERN_FILLED);
@@ -506,6 +871,275 @@ driver_pbar(Driver *drv, int x, int y, int width, int promille, char *begin_labe
 		drv->string(drv, x, y, end_label);
 }
 
+
+/* Find the capabilities of a driver from the functions it provides */
+static unsigned int
+driver_find_caps(Driver *driver)
+{
+	unsigned int caps = 0;
+
+	if (driver->vbar != NULL)
+		caps |= DRV_CAP_VBAR;
+	if (driver->hbar != NULL)
+		caps |= DRV_CAP_HBAR;
+	if (driver->pbar != NULL)
+		caps |= DRV_CAP_PBAR;
+	if (driver->num != NULL)
+		caps |= DRV_CAP_NUM;
+	if (driver->heartbeat != NULL)
+		caps |= DRV_CAP_HEARTBEAT;
+	if (driver->icon != NULL)
+		caps |= DRV_CAP_ICON;
+	if (driver->cursor != NULL)
+		caps |= DRV_CAP_CURSOR;
+	if (driver->flush_spans != NULL)
+		caps |= DRV_CAP_FLUSH_SPANS;
+	if (driver->blit_text != NULL)
+		caps |= DRV_CAP_BLIT_TEXT;
+	if (driver->scroll_text != NULL)
+		caps |= DRV_CAP_SCROLL_TEXT;
+	return caps;
+}
+
+
+/* The entries of the dispatch tables */
+
+static void
+driver_op_ignore(Driver *drv, const DriverOp *op)
+{
+}
+
+static void
+driver_op_clear(Driver *drv, const DriverOp *op)
+{
+	drv->clear(drv);
+}
+
+static void
+driver_op_string(Driver *drv, const DriverOp *op)
+{
+	drv->string(drv, op->x, op->y, op->s1);
+}
+
+static void
+driver_op_chr(Driver *drv, const DriverOp *op)
+{
+	drv->chr(drv, op->x, op->y, (char) op->a);
+}
+
+static void
+driver_op_vbar(Driver *drv, const DriverOp *op)
+{
+	drv->vbar(drv, op->x, op->y, op->a, op->b, op->c);
+}
+
+static void
+driver_op_alt_vbar(Driver *drv, const DriverOp *op)
+{
+	driver_alt_vbar(drv, op->x, op->y, op->a, op->b, op->c);
+}
+
+static void
+driver_op_hbar(Driver *drv, const DriverOp *op)
+{
+	drv->hbar(drv, op->x, op->y, op->a, op->b, op->c);
+}
+
+static void
+driver_op_alt_hbar(Driver *drv, const DriverOp *op)
+{
+	driver_alt_hbar(drv, op->x, op->y, op->a, op->b, op->c);
+}
+
+static void
+driver_op_pbar(Driver *drv, const DriverOp *op)
+{
+	driver_pbar(drv, op->x, op->y, op->a, op->b, (char *) op->s1, (char *) op->s2);
+}
+
+static void
+driver_op_num(Driver *drv, const DriverOp *op)
+{
+	drv->num(drv, op->x, op->a);
+}
+
+static void
+driver_op_alt_num(Driver *drv, const DriverOp *op)
+{
+	driver_alt_num(drv, op->x, op->a);
+}
+
+static void
+driver_op_heartbeat(Driver *drv, const DriverOp *op)
+{
+	drv->heartbeat(drv, op->a);
+}
+
+static void
+driver_op_alt_heartbeat(Driver *drv, const DriverOp *op)
+{
+	driver_alt_heartbeat(drv, op->a);
+}
+
+static void
+driver_op_icon(Driver *drv, const DriverOp *op)
+{
+	/* do alternative call if driver's function does not know the icon */
+	if (drv->icon(drv, op->x, op->y, op->a) == -1)
+		driver_alt_icon(drv, op->x, op->y, op->a);
+}
+
+static void
+driver_op_alt_icon(Driver *drv, const DriverOp *op)
+{
+	driver_alt_icon(drv, op->x, op->y, op->a);
+}
+
+static void
+driver_op_cursor(Driver *drv, const DriverOp *op)
+{
+	drv->cursor(drv, op->x, op->y, op->a);
+}
+
+static void
+driver_op_alt_cursor(Driver *drv, const DriverOp *op)
+{
+	driver_alt_cursor(drv, op->x, op->y, op->a);
+}
+
+static void
+driver_op_backlight(Driver *drv, const DriverOp *op)
+{
+	drv->backlight(drv, op->a);
+}
+
+/* Every frame carries the output state; the driver only gets changes,
+ * as many drivers send all of their outputs on each call. */
+static void
+driver_op_output(Driver *drv, const DriverOp *op)
+{
+	DriverCore *core = DRIVER_CORE(drv);
+
+	if (core->output_known && (core->output_sent == op->a))
+		return;
+	drv->output(drv, op->a);
+	core->output_sent = op->a;
+	core->output_known = 1;
+}
+
+
+/*
+ * Fill the dispatch table of a driver once it is initialized: each
+ * operation goes straight to the driver's function or to the alternative
+ * from the server core, so applying it does not need to check again.
+ */
+static void
+driver_init_dispatch(Driver *driver)
+{
+	DriverApplyFunc *apply = DRIVER_CORE(driver)->apply;
+	unsigned int caps = driver->caps;
+
+	apply[DOP_CLEAR] = (driver->clear) ? driver_op_clear : driver_op_ignore;
+	apply[DOP_STRING] = (driver->string) ? driver_op_string : driver_op_ignore;
+	apply[DOP_CHR] = (driver->chr) ? driver_op_chr : driver_op_ignore;
+	apply[DOP_VBAR] = (caps & DRV_CAP_VBAR) ? driver_op_vbar : driver_op_alt_vbar;
+	apply[DOP_HBAR] = (caps & DRV_CAP_HBAR) ? driver_op_hbar : driver_op_alt_hbar;
+	apply[DOP_PBAR] = driver_op_pbar;
+	apply[DOP_NUM] = (caps & DRV_CAP_NUM) ? driver_op_num : driver_op_alt_num;
+	apply[DOP_HEARTBEAT] = (caps & DRV_CAP_HEARTBEAT) ? driver_op_heartbeat : driver_op_alt_heartbeat;
+	apply[DOP_ICON] = (caps & DRV_CAP_ICON) ? driver_op_icon : driver_op_alt_icon;
+	apply[DOP_CURSOR] = (caps & DRV_CAP_CURSOR) ? driver_op_cursor : driver_op_alt_cursor;
+	apply[DOP_BACKLIGHT] = (driver->backlight) ? driver_op_backlight : driver_op_ignore;
+	apply[DOP_OUTPUT] = (driver->output) ? driver_op_output : driver_op_ignore;
+	/* a driver initialized again does not know its outputs */
+	DRIVER_CORE(driver)->output_known = 0;
+}
+
+
+/* Tell whether a block of the display overlaps a tile */
+static int
+driver_tile_overlaps(const LCDRect *tile, int x, int y, int width, int height)
+{
+	return (x < tile->x + tile->width) && (x + width > tile->x)
+	       && (y < tile->y + tile->height) && (y + height > tile->y);
+}
+
+
+/*
+ * Apply an operation to a tile: moved to the tile's coordinates, and only
+ * if it shows on the tile. What crosses the tile's edges is cut by the
+ * driver, which the part on the next tile is drawn by, so a bar across
+ * two tiles looks like one.
+ */
+static void
+driver_apply_tile_op(Driver *drv, const DriverOp *op)
+{
+	DriverCore *core = DRIVER_CORE(drv);
+	const LCDRect *tile = &core->tile;
+	DriverOp moved = *op;
+	int shows = 1;
+
+	switch (op->type) {
+	case DOP_STRING:
+		shows = driver_tile_overlaps(tile, op->x, op->y, strlen(op->s1), 1);
+		break;
+	case DOP_CHR:
+	case DOP_CURSOR:
+		shows = driver_tile_overlaps(tile, op->x, op->y, 1, 1);
+		break;
+	case DOP_ICON:
+		shows = driver_tile_overlaps(tile, op->x, op->y, (op->a >= 0x200) ? 2 : 1, 1);
+		break;
+	case DOP_HBAR:
+	case DOP_PBAR:
+		shows = driver_tile_overlaps(tile, op->x, op->y, op->a, 1);
+		break;
+	case DOP_VBAR:
+		shows = driver_tile_overlaps(tile, op->x, op->y - op->a + 1, 1, op->a);
+		break;
+	case DOP_NUM:
+		shows = driver_tile_overlaps(tile, op->x, tile->y, (op->a == 10) ? 1 : 3, tile->height);
+		break;
+	case DOP_HEARTBEAT:
+		/* the heartbeat is in the display's corner, on one tile only */
+		if (!core->tile_corner)
+			moved.a = HEARTBEAT_OFF;
+		break;
+	default:
+		break;
+	}
+
+	if (!shows) {
+		/* a cursor elsewhere is off on this tile */
+		if (op->type != DOP_CURSOR)
+			return;
+		moved.a = CURSOR_OFF;
+	}
+	moved.x -= tile->x - 1;
+	moved.y -= tile->y - 1;
+	core->apply[op->type](drv, &moved);
+}
+
+
+/**
+ * Apply a recorded output operation to a driver.
+ * Functions the driver does not provide are replaced by the alternatives
+ * from the server core, like the drivers_* functions do; which one is
+ * used was decided when the driver was loaded.
+ * \param drv  Pointer to driver structure.
+ * \param op   The operation and its arguments.
+ */
+void
+driver_apply_op(Driver *drv, const DriverOp *op)
+{
+	DriverCore *core = DRIVER_CORE(drv);
+
+	if (core->tiled)
+		driver_apply_tile_op(drv, op);
+	else
+		core->apply[op->type](drv, op);
+}
+
 /** Write a big number to the screen.
  * Fallback for the driver's \c num method if the driver does not provide one.
  * \param drv  Pointer to driver structure.
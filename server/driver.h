@@ -22,9 +22,21 @@
 #endif
 #include "shared/defines.h"
 
+Driver *
+driver_new(const char *name, const char *filename);
+
+int
+driver_init(Driver *driver);
+
+int
+driver_reinit(Driver *driver);
+
 Driver *
 driver_load(const char *name, const char *filename);
 
+void
+driver_free(Driver *driver);
+
 int
 driver_unload(Driver *driver);
 
@@ -47,7 +59,58 @@ bool
 driver_stay_in_foreground(Driver *driver);
 
 void
-driver_pbar(Driver *drv, int x, int y, int width, int promille, char *begin_label, char *end_label);
+driver_pbar(Driver *drv, int x, int y, int width, int promille, const char *begin_label, const char *end_label);
+
+long
+driver_busy(Driver *drv);
+
+void
+driver_flushed(Driver *drv, unsigned long start);
+
+int
+driver_flight_id(Driver *drv);
+
+void
+driver_set_tile(Driver *drv, int x, int y, int corner);
+
+int
+driver_get_tile(Driver *drv, LCDRect *rect);
+
+int
+driver_watch_keys(Driver *drv);
+
+void
+driver_unwatch_keys(Driver *drv);
+
+
+/** Output operations that can be recorded and applied to a driver later */
+typedef enum {
+	DOP_CLEAR,
+	DOP_STRING,		/**< x, y, s1 */
+	DOP_CHR,		/**< x, y, a = character */
+	DOP_VBAR,		/**< x, y, a = len, b = promille, c = pattern */
+	DOP_HBAR,		/**< x, y, a = len, b = promille, c = pattern */
+	DOP_PBAR,		/**< x, y, a = width, b = promille, s1, s2 = labels */
+	DOP_NUM,		/**< x, a = num */
+	DOP_HEARTBEAT,		/**< a = state */
+	DOP_ICON,		/**< x, y, a = icon */
+	DOP_CURSOR,		/**< x, y, a = state */
+	DOP_BACKLIGHT,		/**< a = state */
+	DOP_OUTPUT,		/**< a = state */
+	DOP_COUNT		/**< Number of operation types */
+} DriverOpType;
+
+/** An output operation with its arguments */
+typedef struct DriverOp {
+	DriverOpType type;
+	int x, y;
+	int a, b, c;
+	const char *s1, *s2;	/**< String arguments, may be NULL */
+} DriverOp;
+
+/* Apply an output operation to a driver, using the core's alternatives
+ * for functions the driver does not provide */
+void driver_apply_op(Driver *drv, const DriverOp *op);
 
 
 /* Alternative functions for all extended functions */
@@ -20,44 +20,252 @@
 # include "config.h"
 #endif
 
-#include "shared/LL.h"
+#include "shared/vector.h"
 #include "shared/report.h"
 #include "shared/configfile.h"
+#include "shared/hash.h"
 
 #include "driver.h"
 #include "drivers.h"
+#include "drvthread.h"
+#include "iothread.h"
+#include "reconnect.h"
+#include "displaylist.h"
+#include "framebuf.h"
+#include "stats.h"
+#include "profile.h"
 #include "widget.h"
 
 Driver *output_driver = NULL;
-LinkedList *loaded_drivers = NULL;		/**< list of loaded drivers */
+Vector *loaded_drivers = NULL;		/**< list of loaded drivers */
 DisplayProps *display_props = NULL;		/**< properties of the display */
 
-#define ForAllDrivers(drv) for (drv = LL_GetFirst(loaded_drivers); drv; drv = LL_GetNext(loaded_drivers))
+#define ForAllDrivers(i, drv) for (i = 0; (drv = drivers_get(i)) != NULL; i++)
+
+/** Cursor of a frame; x and y are 0 while it is off */
+typedef struct FrameCursor {
+	int x, y;
+	int state;		/**< CURSOR_*, -1 before the first frame */
+} FrameCursor;
+
+#define FRAME_CURSOR_NONE	{ 0, 0, -1 }
+
+/** Back buffer: the operations of the frame being rendered */
+static DisplayList back_buffer = { NULL, 0, 0 };
+/** Backlight, output and cursor state of the frame being rendered */
+static int frame_backlight = -1;
+static int frame_output = -1;
+static FrameCursor frame_cursor = FRAME_CURSOR_NONE;
+/** List output goes to instead of the frame, see drivers_record() */
+static DisplayList *offscreen = NULL;
+/** Spare frame, rendered ahead; see drivers_swap_frame() */
+static DisplayList spare_buffer = { NULL, 0, 0 };
+static int spare_backlight = -1;
+static int spare_output = -1;
+static FrameCursor spare_cursor = FRAME_CURSOR_NONE;
+/** Backlight, output and cursor state of the frame on the displays */
+static int shown_backlight = -1;
+static int shown_output = -1;
+static FrameCursor shown_cursor = FRAME_CURSOR_NONE;
+/** Drivers that were too busy to flush the last frame they got */
+static Vector *skipped_drivers = NULL;
+/** The changed spans a tile shows, see drivers_tile_spans() */
+static LCDSpan *tile_spans = NULL;
+static int tile_spans_size = 0;
+/** Settings of the loaded drivers by name, see drivers_settings() */
+static HashTable *driver_settings = NULL;
+
+/** Flushes longer than this, in microseconds, are slow for FlushThread=auto */
+#define AUTO_FLUSH_SLOW_TIME	5000
+/** Slow flushes in a row that move a driver to a flush thread */
+#define AUTO_FLUSH_SLOW_COUNT	3
+
+/** A driver with FlushThread=auto: flushed on the main thread until it
+ * turns out to be slow */
+typedef struct AutoFlush {
+	Driver *drv;
+	int interval;		/**< FlushInterval for its thread */
+	int slow;		/**< Slow flushes in a row */
+} AutoFlush;
+
+/** Drivers with FlushThread=auto still flushed on the main thread */
+static Vector *auto_flush = NULL;
+
+/** A display: the drivers whose section names it with Display=, which
+ * show the same screens. Drivers without that setting are on the main
+ * display, number 0. The displays are rendered one after the other; the
+ * frame state above is that of the selected one, the others keep theirs
+ * here (see drivers_select_display()). Only the main display has the
+ * frame buffer, the drivers on others always flush everything. */
+typedef struct Display {
+	char *name;		/**< Display= of its drivers, "main" for display 0 */
+	Vector *drivers;	/**< Its loaded drivers */
+	Driver *output;		/**< Its first output driver, which it has the size of */
+	DisplayProps props;	/**< Its size, see drivers_display_props() */
+	DisplayList back_buffer;
+	int frame_backlight;
+	int frame_output;
+	FrameCursor frame_cursor;
+	DisplayList spare_buffer;
+	int spare_backlight;
+	int spare_output;
+	FrameCursor spare_cursor;
+	int shown_backlight;
+	int shown_output;
+	FrameCursor shown_cursor;
+} Display;
+
+static const FrameCursor no_cursor = FRAME_CURSOR_NONE;
+
+/** All displays, the main one first. They stay when the drivers are
+ * unloaded, so screens keep their display over a reload. */
+static Vector *displays = NULL;
+/** The display being rendered */
+static int selected = 0;
+/** Properties of the main display while another one is selected */
+static DisplayProps *main_props = NULL;
+
+
+/*
+ * Record an output operation in the back buffer. The drivers get the
+ * whole frame at once in drivers_flush(), so no driver ever shows a frame
+ * that is only partly drawn.
+ */
+static void
+drivers_dispatch(const DriverOp *op)
+{
+	displaylist_add((offscreen != NULL) ? offscreen : &back_buffer, op);
+}
 
+/* Output goes to the core frame buffer: rendering the main display, and
+ * not into a list of drivers_record() */
+#define FRAMEBUF_OUTPUT	((selected == 0) && (offscreen == NULL))
 
-/**
- * Load driver based on "DriverPath" config setting and section name or
+
+/* Get a display by number */
+static Display *
+drivers_display(int display)
+{
+	return V_Get(displays, display);
+}
+
+
+/*
+ * Find a display by name, adding it if there is none of that name yet.
+ * NULL and "main" stand for the main display. Returns its number, or -1
+ * on error.
+ */
+static int
+drivers_display_add(const char *name)
+{
+	Display *disp;
+	int i;
+
+	if (displays == NULL) {
+		displays = V_new();
+		if (displays == NULL) {
+			report(RPT_ERR, "Error allocating display list.");
+			return -1;
+		}
+	}
+	if ((name == NULL) || (*name == '\0'))
+		name = "main";
+	for (i = 0; (disp = drivers_display(i)) != NULL; i++) {
+		if (strcasecmp(disp->name, name) == 0)
+			return i;
+	}
+	/* the main display comes first */
+	if ((i == 0) && (strcasecmp(name, "main") != 0) && (drivers_display_add(NULL) < 0))
+		return -1;
+
+	disp = calloc(1, sizeof(Display));
+	if ((disp == NULL) || ((disp->name = strdup(name)) == NULL)
+	    || ((disp->drivers = V_new()) == NULL) || (V_Append(displays, disp) < 0)) {
+		report(RPT_ERR, "Error allocating display %.40s.", name);
+		if (disp != NULL) {
+			free(disp->name);
+			V_Destroy(disp->drivers);
+		}
+		free(disp);
+		return -1;
+	}
+	disp->frame_backlight = disp->frame_output = -1;
+	disp->spare_backlight = disp->spare_output = -1;
+	disp->shown_backlight = disp->shown_output = -1;
+	disp->frame_cursor = disp->spare_cursor = disp->shown_cursor = no_cursor;
+	return V_Length(displays) - 1;
+}
+
+
+/* Exchange the frame state of the selected display with a display's */
+static void
+drivers_swap_display(Display *disp)
+{
+	DisplayList list;
+	FrameCursor cursor;
+	int tmp;
+
+	list = back_buffer;
+	back_buffer = disp->back_buffer;
+	disp->back_buffer = list;
+	list = spare_buffer;
+	spare_buffer = disp->spare_buffer;
+	disp->spare_buffer = list;
+	tmp = frame_backlight;
+	frame_backlight = disp->frame_backlight;
+	disp->frame_backlight = tmp;
+	tmp = frame_output;
+	frame_output = disp->frame_output;
+	disp->frame_output = tmp;
+	tmp = spare_backlight;
+	spare_backlight = disp->spare_backlight;
+	disp->spare_backlight = tmp;
+	tmp = spare_output;
+	spare_output = disp->spare_output;
+	disp->spare_output = tmp;
+	tmp = shown_backlight;
+	shown_backlight = disp->shown_backlight;
+	disp->shown_backlight = tmp;
+	tmp = shown_output;
+	shown_output = disp->shown_output;
+	disp->shown_output = tmp;
+	cursor = frame_cursor;
+	frame_cursor = disp->frame_cursor;
+	disp->frame_cursor = cursor;
+	cursor = spare_cursor;
+	spare_cursor = disp->spare_cursor;
+	disp->spare_cursor = cursor;
+	cursor = shown_cursor;
+	shown_cursor = disp->shown_cursor;
+	disp->shown_cursor = cursor;
+}
+
+
+/*
+ * Create a driver object for a section, without initializing it. The module
+ * is found by the "DriverPath" config setting and the section name or the
  * "File" configuration setting in the driver's section.
- * \param name  Driver section name.
- * \retval  <0  error.
- * \retval   0  OK
- * \retval   2  OK, driver needs to run in the foreground.
  */
-int
-drivers_load_driver(const char *name)
+static Driver *
+drivers_new_driver(const char *name)
 {
 	Driver *driver;
 	const char *s;
 
-	debug(RPT_DEBUG, "%s(name=\"%.40s\")", __FUNCTION__, name);
-
 	/* First driver ? */
 	if (!loaded_drivers) {
-		/* Create linked list */
-		loaded_drivers = LL_new();
+		/* Create the list */
+		loaded_drivers = V_new();
 		if (!loaded_drivers) {
 			report(RPT_ERR, "Error allocating driver list.");
-			return -1;
+			return NULL;
+		}
+	}
+	if (!skipped_drivers) {
+		skipped_drivers = V_new();
+		if (!skipped_drivers) {
+			report(RPT_ERR, "Error allocating driver list.");
+			return NULL;
 		}
 	}
 
@@ -74,36 +282,309 @@ drivers_load_driver(const char *name)
 		strcat(filename, MODULE_EXTENSION);
 
 	/* Load the module */
-	driver = driver_load(name, filename);
+	driver = driver_new(name, filename);
 	if (driver == NULL) {
-		/* It failed. The message has already been given by driver_load() */
+		/* It failed. The message has already been given by driver_new() */
 		report(RPT_INFO, "Module %.40s could not be loaded", filename);
-		return -1;
+		return NULL;
 	}
+	return driver;
+}
 
-	/* Add driver to list */
-	LL_Push(loaded_drivers, driver);
 
-	/* If first output driver, store display properties */
-	if (driver_does_output(driver) && !output_driver) {
-		output_driver = driver;
+/* Get the properties of a driver's display */
+static void
+drivers_get_props(Driver *driver, DisplayProps *props)
+{
+	props->width      = driver->width(driver);
+	props->height     = driver->height(driver);
+
+	if (driver->cellwidth != NULL && driver->cellwidth(driver) > 0)
+		props->cellwidth  = driver->cellwidth(driver);
+	else
+		props->cellwidth  = LCD_DEFAULT_CELLWIDTH;
+
+	if (driver->cellheight != NULL && driver->cellheight(driver) > 0)
+		props->cellheight = driver->cellheight(driver);
+	else
+		props->cellheight = LCD_DEFAULT_CELLHEIGHT;
+}
 
-		/* Allocate new DisplayProps structure */
-		display_props = malloc(sizeof(DisplayProps));
-		display_props->width      = driver->width(driver);
-		display_props->height     = driver->height(driver);
 
-		if (driver->cellwidth != NULL && driver->cellwidth(driver) > 0)
-			display_props->cellwidth  = driver->cellwidth(driver);
-		else
-			display_props->cellwidth  = LCD_DEFAULT_CELLWIDTH;
+/* The display a driver's section puts it on; -1 on error */
+static int
+drivers_display_setting(const char *name)
+{
+	return drivers_display_add(config_get_string(name, "Display", 0, NULL));
+}
+
+
+/* If this is the first output driver of its display, store the display
+ * properties */
+static void
+drivers_set_display(Driver *driver, int display)
+{
+	Display *disp = drivers_display(display);
+
+	if (!driver_does_output(driver) || (disp == NULL) || (disp->output != NULL))
+		return;
+
+	disp->output = driver;
+	if (display != 0) {
+		drivers_get_props(driver, &disp->props);
+		return;
+	}
+	output_driver = driver;
+
+	/* Allocate new DisplayProps structure */
+	display_props = malloc(sizeof(DisplayProps));
+	drivers_get_props(driver, display_props);
+
+	/* The core frame buffer follows the display's size */
+	framebuf_init(display_props->width, display_props->height);
+}
+
+
+/*
+ * Make a driver with a Tile setting a tile of its display, and grow the
+ * display to take it in. The display's size was set by its first output
+ * driver; with tiles it becomes the smallest that holds all of them. The
+ * tile with the upper right corner of the display shows its heartbeat.
+ */
+static void
+drivers_set_tile(Driver *driver, int display)
+{
+	const char *setting = config_get_string(driver->name, "Tile", 0, NULL);
+	Display *disp = drivers_display(display);
+	DisplayProps *props;
+	Driver *drv;
+	LCDRect tile;
+	int x, y, width, height;
+	int i;
+
+	if ((setting == NULL) || !driver_does_output(driver) || (disp == NULL)
+	    || (disp->output == NULL))
+		return;
+	if ((sscanf(setting, "%d,%d", &x, &y) != 2) || (x < 1) || (y < 1)) {
+		report(RPT_WARNING, "Driver [%.40s]: Tile=%s is not a position like 21,1; no tile",
+		       driver->name, setting);
+		return;
+	}
+	width = driver->width(driver);
+	height = driver->height(driver);
+	if ((x - 1 + width > LCD_MAX_WIDTH) || (y - 1 + height > LCD_MAX_HEIGHT)) {
+		report(RPT_WARNING, "Driver [%.40s]: tile at %d,%d ends beyond %dx%d; no tile",
+		       driver->name, x, y, LCD_MAX_WIDTH, LCD_MAX_HEIGHT);
+		return;
+	}
+
+	props = (display == 0) ? display_props : &disp->props;
+	driver_set_tile(driver, x, y, 0);
+	if ((x - 1 + width > props->width) || (y - 1 + height > props->height)) {
+		props->width = max(props->width, x - 1 + width);
+		props->height = max(props->height, y - 1 + height);
+		if (display == 0)
+			framebuf_init(props->width, props->height);
+		report(RPT_INFO, "Display %s is %dx%d with its tiles", disp->name,
+		       props->width, props->height);
+	}
+
+	/* the corner may have moved to another tile */
+	for (i = 0; (drv = V_Get(disp->drivers, i)) != NULL; i++) {
+		if (driver_get_tile(drv, &tile))
+			driver_set_tile(drv, tile.x, tile.y,
+					(tile.x - 1 + tile.width == props->width) && (tile.y == 1));
+	}
+}
+
+
+/*
+ * The settings a driver is loaded with: its section and the keys of the
+ * server section that apply to it. Returns a string to be freed.
+ */
+static char *
+drivers_settings(const char *name)
+{
+	char *section = config_section_text(name);
+	const char *path = config_get_string("Server", "DriverPath", 0, "");
+	const char *skip = config_get_string("Server", "FrameSkip", 0, "");
+	const char *fanout = config_get_string("Server", "FanOut", 0, "");
+	size_t size = strlen(path) + strlen(skip) + strlen(fanout) + 64;
+	char *text;
+
+	if (section != NULL)
+		size += strlen(section);
+	text = malloc(size);
+	if (text != NULL)
+		snprintf(text, size, "%s[Server]\nDriverPath=%s\nFrameSkip=%s\nFanOut=%s\n",
+			 (section != NULL) ? section : "", path, skip, fanout);
+	free(section);
+	return text;
+}
+
+
+/* Find the entry of a driver with FlushThread=auto */
+static AutoFlush *
+drivers_auto_flush_find(Driver *drv)
+{
+	AutoFlush *af;
+	int i;
+
+	for (i = 0; (af = V_Get(auto_flush, i)) != NULL; i++) {
+		if (af->drv == drv)
+			return af;
+	}
+	return NULL;
+}
+
+
+/* Flush a driver with FlushThread=auto on the main thread for now */
+static void
+drivers_auto_flush_add(Driver *drv, int interval)
+{
+	AutoFlush *af;
+
+	if (auto_flush == NULL)
+		auto_flush = V_new();
+	af = calloc(1, sizeof(AutoFlush));
+	if ((auto_flush == NULL) || (af == NULL) || (V_Append(auto_flush, af) < 0)) {
+		report(RPT_WARNING, "Driver [%.40s] flushes on the main thread", drv->name);
+		free(af);
+		return;
+	}
+	af->drv = drv;
+	af->interval = interval;
+}
+
+
+/* Forget a driver with FlushThread=auto */
+static void
+drivers_auto_flush_remove(Driver *drv)
+{
+	AutoFlush *af = drivers_auto_flush_find(drv);
+
+	if (af != NULL) {
+		V_Remove(auto_flush, af);
+		free(af);
+	}
+}
+
+
+/* Count the slow flushes in a row of a driver with FlushThread=auto */
+static void
+drivers_auto_flush_count(Driver *drv, unsigned long usecs)
+{
+	AutoFlush *af = drivers_auto_flush_find(drv);
+
+	if (af != NULL)
+		af->slow = (usecs > AUTO_FLUSH_SLOW_TIME) ? af->slow + 1 : 0;
+}
+
 
-		if (driver->cellheight != NULL && driver->cellheight(driver) > 0)
-			display_props->cellheight = driver->cellheight(driver);
+/*
+ * Move the drivers with FlushThread=auto that flushed slowly several
+ * times in a row to a thread of their own. Called between frames, when
+ * the main thread is done with them; they get the next frame in full.
+ */
+static void
+drivers_auto_flush_move(void)
+{
+	AutoFlush *af;
+	int i = 0;
+
+	while ((af = V_Get(auto_flush, i)) != NULL) {
+		Driver *drv = af->drv;
+
+		if (af->slow < AUTO_FLUSH_SLOW_COUNT) {
+			i++;
+			continue;
+		}
+		V_RemoveAt(auto_flush, i);
+		report(RPT_NOTICE, "Driver [%.40s] is slow to flush, moving it to a thread of its own",
+		       drv->name);
+		if (drvthread_start(drv, af->interval, drivers_display_of(drv)) < 0)
+			report(RPT_WARNING, "Driver [%.40s] flushes on the main thread", drv->name);
+		else {
+			/* flush threads always flush everything */
+			V_Remove(skipped_drivers, drv);
+			drv->caps |= DRV_CAP_THREADED;
+			drv->caps &= ~(DRV_CAP_FLUSH_SPANS | DRV_CAP_SCROLL_TEXT);
+		}
+		free(af);
+	}
+}
+
+
+/*
+ * Add an initialized driver to the list of loaded drivers.
+ * Returns 2 if it needs to run in the foreground, 0 otherwise.
+ */
+static int
+drivers_add_driver(Driver *driver)
+{
+	const char *name = driver->name;
+	int display = drivers_display_setting(name);
+	Display *disp;
+	int tiled;
+
+	/* the main display if the other one could not be set up */
+	if (display < 0)
+		display = 0;
+	disp = drivers_display(display);
+
+	/* Add driver to list */
+	V_Append(loaded_drivers, driver);
+	if (disp != NULL)
+		V_Append(disp->drivers, driver);
+	stats_driver_add(driver);
+
+	/* Remember what it was loaded with, for drivers_reload() */
+	if (driver_settings == NULL)
+		driver_settings = HT_new_nocase();
+	if (driver_settings != NULL) {
+		char *text = drivers_settings(name);
+
+		if ((text != NULL) && (HT_Insert(driver_settings, driver->name, text) < 0))
+			free(text);
+	}
+
+	/* Slow displays can be flushed on a thread of their own; with FanOut
+	 * all of them are, unless their section says otherwise. With auto
+	 * a driver gets its thread once its flushes turn out to be slow. */
+	if (driver_does_output(driver)
+	    && (strcasecmp(config_get_string(name, "FlushThread", 0, ""), "auto") == 0))
+		drivers_auto_flush_add(driver, config_get_int(name, "FlushInterval", 0, 0));
+	else if (driver_does_output(driver)
+	    && config_get_bool(name, "FlushThread", 0, config_get_bool("Server", "FanOut", 0, 0))) {
+		if (drvthread_start(driver, config_get_int(name, "FlushInterval", 0, 0), display) < 0)
+			report(RPT_WARNING, "Driver [%.40s] flushes on the main thread", name);
 		else
-			display_props->cellheight = LCD_DEFAULT_CELLHEIGHT;
+			driver->caps |= DRV_CAP_THREADED;
 	}
 
+	drivers_set_display(driver, display);
+	drivers_set_tile(driver, display);
+	tiled = driver_get_tile(driver, NULL);
+
+	/* Changed spans only fit displays of the frame buffer's size, or
+	 * tiles of it, and flush threads and other displays always flush
+	 * everything */
+	if ((driver->caps & DRV_CAP_FLUSH_SPANS)
+	    && ((driver->caps & DRV_CAP_THREADED) || (display != 0)
+		|| (driver->width == NULL) || (driver->height == NULL)
+		|| (!tiled && !framebuf_matches(driver->width(driver), driver->height(driver)))))
+		driver->caps &= ~DRV_CAP_FLUSH_SPANS;
+	/* the same goes for the lines scrolled in hardware, which tiles
+	 * only show a part of */
+	if ((driver->caps & DRV_CAP_SCROLL_TEXT)
+	    && ((driver->caps & DRV_CAP_THREADED) || (display != 0) || tiled
+		|| (driver->width == NULL) || (driver->height == NULL)
+		|| !framebuf_matches(driver->width(driver), driver->height(driver))))
+		driver->caps &= ~DRV_CAP_SCROLL_TEXT;
+	/* text is blitted in the driver's coordinates */
+	if (tiled)
+		driver->caps &= ~DRV_CAP_BLIT_TEXT;
+
 	/* Return the driver type */
 	if (driver_stay_in_foreground(driver))
 		return 2;
@@ -112,6 +593,146 @@ drivers_load_driver(const char *name)
 }
 
 
+
+/**
+ * Load driver based on "DriverPath" config setting and section name or
+ * "File" configuration setting in the driver's section.
+ * \param name  Driver section name.
+ * \retval  <0  error.
+ * \retval   0  OK
+ * \retval   2  OK, driver needs to run in the foreground.
+ */
+int
+drivers_load_driver(const char *name)
+{
+	Driver *driver;
+
+	debug(RPT_DEBUG, "%s(name=\"%.40s\")", __FUNCTION__, name);
+
+	driver = drivers_new_driver(name);
+	if ((driver == NULL) || (driver_init(driver) < 0))
+		return -1;
+
+	return drivers_add_driver(driver);
+}
+
+
+/* Start the init of a driver: on a thread of its own if its section (or the
+ * server section) says ParallelInit=yes, in which case *job is set and 0 is
+ * returned, or else right away. */
+static int
+drivers_start_init(Driver *driver, DriverInit **job)
+{
+	const char *name = driver->name;
+
+	*job = NULL;
+	if (config_get_bool(name, "ParallelInit", 0, config_get_bool("Server", "ParallelInit", 0, 0))) {
+		double timeout = config_get_float(name, "InitTimeout", 0,
+						  config_get_float("Server", "InitTimeout", 0, 0));
+
+		*job = drvthread_init_start(driver, (int) (timeout * 1000));
+		if (*job != NULL)
+			return 0;
+	}
+	return driver_init(driver);
+}
+
+
+/* Finish the init of a driver started by drivers_start_init() */
+static int
+drivers_finish_init(DriverInit *job, int res)
+{
+	return (job != NULL) ? drvthread_init_wait(job) : res;
+}
+
+
+/**
+ * Load the drivers of several sections, like drivers_load_driver() does
+ * for each of them. Drivers whose section (or the server section) says
+ * ParallelInit=yes are initialized on threads of their own at the same
+ * time, and given up if their init takes longer than InitTimeout seconds.
+ * The first output driver is initialized before all others, as they may
+ * adapt to its display. The drivers are added in the order given.
+ * \param names  Driver section names.
+ * \param count  Number of names.
+ * \retval   0  OK
+ * \retval   2  OK, a driver needs to run in the foreground.
+ */
+int
+drivers_load_drivers(char *const names[], int count)
+{
+	Driver *drivers[count];
+	DriverInit *jobs[count];
+	int res[count];
+	int done[count];
+	int ret = 0;
+	int i;
+
+	debug(RPT_DEBUG, "%s(count=%d)", __FUNCTION__, count);
+
+	for (i = 0; i < count; i++) {
+		drivers[i] = drivers_new_driver(names[i]);
+		jobs[i] = NULL;
+		res[i] = -1;
+		done[i] = (drivers[i] == NULL);
+	}
+
+	/* find the display the other drivers may adapt to first */
+	for (i = 0; (i < count) && (output_driver == NULL); i++) {
+		if (done[i] || !driver_does_output(drivers[i])
+		    || (drivers_display_setting(names[i]) > 0))
+			continue;
+		res[i] = drivers_start_init(drivers[i], &jobs[i]);
+		res[i] = drivers_finish_init(jobs[i], res[i]);
+		done[i] = 1;
+		if (res[i] >= 0)
+			drivers_set_display(drivers[i], 0);
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!done[i])
+			res[i] = drivers_start_init(drivers[i], &jobs[i]);
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!done[i])
+			res[i] = drivers_finish_init(jobs[i], res[i]);
+		if (res[i] < 0)
+			report(RPT_ERR, "Could not load driver %.40s", names[i]);
+		else if (drivers_add_driver(drivers[i]) == 2)
+			ret = 2;
+	}
+	return ret;
+}
+
+
+/* Stop and unload a driver that was taken from the list of loaded drivers */
+static void
+drivers_unload_driver(Driver *driver)
+{
+	Display *disp;
+	int i;
+	char *text = (driver_settings != NULL) ? HT_Find(driver_settings, driver->name) : NULL;
+
+	if (text != NULL) {
+		HT_Remove(driver_settings, driver->name, text);
+		free(text);
+	}
+	if (skipped_drivers != NULL)
+		V_Remove(skipped_drivers, driver);
+	for (i = 0; (disp = drivers_display(i)) != NULL; i++) {
+		V_Remove(disp->drivers, driver);
+		if (disp->output == driver)
+			disp->output = NULL;
+	}
+	drivers_auto_flush_remove(driver);
+	reconnect_stop(driver);
+	drvthread_stop(driver);
+	stats_driver_remove(driver);
+	driver_unload(driver);
+}
+
+
 /**
  * Unload all loaded drivers.
  */
@@ -119,14 +740,131 @@ void
 drivers_unload_all(void)
 {
 	Driver *driver;
+	Display *disp;
+	int i;
 
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
 	output_driver = NULL;
 
-	while ((driver = LL_Pop(loaded_drivers)) != NULL) {
-		driver_unload(driver);
+	while ((driver = V_Pop(loaded_drivers)) != NULL)
+		drivers_unload_driver(driver);
+
+	V_Destroy(skipped_drivers);
+	skipped_drivers = NULL;
+	displaylist_free(&back_buffer);
+	displaylist_free(&spare_buffer);
+	framebuf_shutdown();
+	free(tile_spans);
+	tile_spans = NULL;
+	tile_spans_size = 0;
+
+	/* the displays stay, without their frames */
+	for (i = 0; (disp = drivers_display(i)) != NULL; i++) {
+		displaylist_free(&disp->back_buffer);
+		displaylist_free(&disp->spare_buffer);
+		disp->shown_backlight = disp->shown_output = -1;
+		disp->shown_cursor = no_cursor;
+	}
+}
+
+
+/**
+ * Unload the drivers whose device is gone. Their reconnect threads call
+ * their init, which reads the configuration, so they have to go before it
+ * is read again; drivers_reload() then loads them anew.
+ */
+void
+drivers_unload_offline(void)
+{
+	Driver *drv;
+	int k;
+
+	for (k = V_Length(loaded_drivers) - 1; k >= 0; k--) {
+		drv = V_Get(loaded_drivers, k);
+		if (reconnect_online(drv))
+			continue;
+		if (drv == output_driver) {
+			drivers_unload_all();
+			return;
+		}
+		V_RemoveAt(loaded_drivers, k);
+		drivers_unload_driver(drv);
+	}
+}
+
+
+/**
+ * Load the drivers of a configuration that was read again, keeping the
+ * loaded drivers whose settings did not change: they go on with their
+ * devices, custom characters and what they show, without going through
+ * their init again. Drivers that are no longer listed or whose settings
+ * changed are unloaded, and the new ones are loaded after the kept ones.
+ * When the display's driver changes, all drivers are loaded anew, as the
+ * others may adapt to its display.
+ * \param names  Driver section names.
+ * \param count  Number of names.
+ * \retval   0  OK
+ * \retval   2  OK, a driver needs to run in the foreground.
+ */
+int
+drivers_reload(char *const names[], int count)
+{
+	char *load[count];
+	int kept[count];
+	int loads = 0;
+	int ret = 0;
+	Driver *drv;
+	int i, k;
+
+	debug(RPT_DEBUG, "%s(count=%d)", __FUNCTION__, count);
+
+	for (i = 0; i < count; i++)
+		kept[i] = 0;
+
+	for (k = V_Length(loaded_drivers) - 1; k >= 0; k--) {
+		const char *old;
+		char *text;
+		int same = 0;
+
+		drv = V_Get(loaded_drivers, k);
+		old = (driver_settings != NULL) ? HT_Find(driver_settings, drv->name) : NULL;
+		text = drivers_settings(drv->name);
+		for (i = 0; i < count; i++) {
+			if (!kept[i] && (strcasecmp(names[i], drv->name) == 0)) {
+				same = (old != NULL) && (text != NULL) && (strcmp(old, text) == 0);
+				kept[i] = same;
+				break;
+			}
+		}
+		free(text);
+		if (same)
+			continue;
+
+		if (drv == output_driver) {
+			report(RPT_NOTICE, "Settings of display driver [%.40s] changed, reloading all drivers",
+			       drv->name);
+			drivers_unload_all();
+			return drivers_load_drivers(names, count);
+		}
+		report(RPT_NOTICE, "Settings of driver [%.40s] changed, unloading it", drv->name);
+		V_RemoveAt(loaded_drivers, k);
+		drivers_unload_driver(drv);
+	}
+
+	ForAllDrivers(k, drv) {
+		report(RPT_INFO, "Keeping driver [%.40s]", drv->name);
+		if (driver_stay_in_foreground(drv))
+			ret = 2;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!kept[i])
+			load[loads++] = names[i];
 	}
+	if ((loads > 0) && (drivers_load_drivers(load, loads) == 2))
+		ret = 2;
+	return ret;
 }
 
 
@@ -139,12 +877,20 @@ const char *
 drivers_get_info(void)
 {
 	Driver *drv;
+	int i;
 
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	ForAllDrivers(drv) {
-		if (drv->get_info) {
-			return drv->get_info(drv);
+	ForAllDrivers(i, drv) {
+		if (drv->get_info && reconnect_online(drv)) {
+			const char *info;
+
+			iothread_drivers_lock();
+			drvthread_lock(drv);
+			info = drv->get_info(drv);
+			drvthread_unlock(drv);
+			iothread_drivers_unlock();
+			return info;
 		}
 	}
 	return "";
@@ -158,32 +904,292 @@ drivers_get_info(void)
 void
 drivers_clear(void)
 {
-	Driver *drv;
-
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	ForAllDrivers(drv) {
-		if (drv->clear)
-			drv->clear(drv);
+	DriverOp op = { DOP_CLEAR };
+
+	if (FRAMEBUF_OUTPUT)
+		framebuf_clear();
+
+	drivers_dispatch(&op);
+}
+
+
+/**
+ * Exchange the frame being rendered with a spare frame. Output between two
+ * calls goes into the spare frame, emptied first, and the frame rendered
+ * before is left alone; a later call brings the spare frame back, ready
+ * for drivers_flush(). This renders a frame ahead, e.g. the next screen
+ * of the rotation, so that showing it only takes a swap.
+ * \param discard  Non-zero to empty the frame swapped in.
+ */
+void
+drivers_swap_frame(int discard)
+{
+	DisplayList list = back_buffer;
+	FrameCursor cursor = frame_cursor;
+	int tmp;
+
+	back_buffer = spare_buffer;
+	spare_buffer = list;
+	tmp = frame_backlight;
+	frame_backlight = spare_backlight;
+	spare_backlight = tmp;
+	tmp = frame_output;
+	frame_output = spare_output;
+	spare_output = tmp;
+	frame_cursor = spare_cursor;
+	spare_cursor = cursor;
+	if (selected == 0)
+		framebuf_swap();
+
+	if (discard)
+		displaylist_reset(&back_buffer);
+}
+
+
+/**
+ * Record the output of the following drivers_string(), drivers_hbar() and
+ * other cell drawing calls in a list of the caller's instead of the frame,
+ * e.g. to draw the whole contents of a scrolling frame once and show parts
+ * of it with drivers_replay(). The frame and the core frame buffer are
+ * left alone until recording stops.
+ * \param list  The list to record to, emptied first; NULL to stop.
+ */
+void
+drivers_record(DisplayList *list)
+{
+	if (list != NULL)
+		displaylist_reset(list);
+	offscreen = list;
+}
+
+
+/**
+ * Draw recorded operations into the frame, moved by an offset. Only the
+ * operations that draw cells are drawn.
+ * \param ops    The operations, e.g. part of a list of drivers_record().
+ * \param count  Their number.
+ * \param dx     Columns to move them right.
+ * \param dy     Rows to move them down.
+ */
+void
+drivers_replay(const DriverOp *ops, int count, int dx, int dy)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		const DriverOp *op = &ops[i];
+		int x = op->x + dx;
+		int y = op->y + dy;
+
+		switch (op->type) {
+		case DOP_STRING:
+			drivers_string(x, y, op->s1);
+			break;
+		case DOP_CHR:
+			drivers_chr(x, y, (char) op->a);
+			break;
+		case DOP_VBAR:
+			drivers_vbar(x, y, op->a, op->b, op->c);
+			break;
+		case DOP_HBAR:
+			drivers_hbar(x, y, op->a, op->b, op->c);
+			break;
+		case DOP_PBAR:
+			drivers_pbar(x, y, op->a, op->b, op->s1, op->s2);
+			break;
+		case DOP_ICON:
+			drivers_icon(x, y, op->a);
+			break;
+		default:
+			/* not positioned in the frame */
+			break;
+		}
+	}
+}
+
+
+/*
+ * Flush a driver running on the main thread.
+ * A count < 0 means all of the display changed.
+ */
+static void
+drivers_flush_driver(Driver *drv, unsigned long start, const LCDSpan *spans, int count)
+{
+	StatsHistogram *flush_stats;
+
+	if ((drv->caps & DRV_CAP_FLUSH_SPANS) && (count >= 0))
+		drv->flush_spans(drv, spans, count);
+	else if (drv->flush)
+		drv->flush(drv);
+	driver_flushed(drv, start);
+	if ((flush_stats = stats_driver_flush(drv)) != NULL)
+		stats_histogram_add(flush_stats, stats_clock() - start);
+	drivers_auto_flush_count(drv, stats_clock() - start);
+	reconnect_check(drv);
+}
+
+
+/*
+ * Let a driver move the lines of the frame that scrolled by a column in
+ * hardware. Returns the number of spans then left to flush in *spans, or
+ * count if the driver did not move all of them.
+ */
+static int
+drivers_scroll_driver(Driver *drv, const LCDSpan **spans, int count)
+{
+	const FrameScroll *scrolls;
+	const LCDSpan *left;
+	int n, i;
+
+	n = framebuf_scrolls(&scrolls);
+	if (n <= 0)
+		return count;
+	for (i = 0; i < n; i++) {
+		if (drv->scroll_text(drv, &scrolls[i].rect, scrolls[i].shift) < 0)
+			break;
+	}
+	/* lines moved already are sent completely, which is still right */
+	if (i < n)
+		return count;
+
+	n = framebuf_diff_scrolled(&left);
+	if (n < 0)
+		return count;
+	*spans = left;
+	return n;
+}
+
+
+/*
+ * Cut the changed spans of the frame down to what a tile shows, in the
+ * tile's coordinates. Returns their number, with the spans in tile_spans.
+ */
+static int
+drivers_tile_spans(const LCDRect *tile, const LCDSpan *spans, int count)
+{
+	int n = 0;
+	int i;
+
+	if (count > tile_spans_size) {
+		LCDSpan *grown = realloc(tile_spans, count * sizeof(LCDSpan));
+
+		if (grown == NULL)
+			return -1;
+		tile_spans = grown;
+		tile_spans_size = count;
+	}
+	for (i = 0; i < count; i++) {
+		int x = max(spans[i].x, tile->x);
+		int end = min(spans[i].x + spans[i].len, tile->x + tile->width);
+
+		if ((spans[i].y < tile->y) || (spans[i].y >= tile->y + tile->height) || (x >= end))
+			continue;
+		tile_spans[n].x = x - tile->x + 1;
+		tile_spans[n].y = spans[i].y - tile->y + 1;
+		tile_spans[n].len = end - x;
+		n++;
 	}
+	return n;
 }
 
 
 /**
- * Flush data on all loaded drivers to LCDs.
- * Call flush() function of all loaded drivers that have a flush() function defined.
+ * Swap the frame rendered since the last call onto the selected display:
+ * apply it to all of its drivers at once and call their flush() function.
+ * Drivers with a flush thread are handed the frame and flush it themselves.
+ * A frame that is identical to the one on the display is not sent at all.
  */
 void
 drivers_flush(void)
 {
+	Display *disp = drivers_display(selected);
 	Driver *drv;
+	int i;
+	const LCDSpan *spans = NULL;
+	int count = -1;
 
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	ForAllDrivers(drv) {
-		if (drv->flush)
-			drv->flush(drv);
+	/* Find out once what changed; drivers that can make use of it only
+	 * get the changed spans, as long as their display has the size of
+	 * the frame buffer. */
+	if (selected == 0)
+		count = framebuf_diff(&spans);
+
+	if ((count == 0) && (frame_backlight == shown_backlight)
+	    && (frame_output == shown_output)
+	    && (frame_cursor.state == shown_cursor.state)
+	    && (frame_cursor.x == shown_cursor.x) && (frame_cursor.y == shown_cursor.y)) {
+		debug(RPT_DEBUG, "%s: frame unchanged", __FUNCTION__);
+		displaylist_reset(&back_buffer);
+		framebuf_commit();
+		return;
 	}
+
+	/* drivers with a flush thread share one copy of the frame */
+	drvthread_publish(&back_buffer, selected);
+
+	for (i = 0; (disp != NULL) && ((drv = V_Get(disp->drivers, i)) != NULL); i++) {
+		const LCDSpan *drv_spans = spans;
+		int drv_count = count;
+		unsigned long start;
+		ProfileSlot *prev;
+		LCDRect tile;
+
+		if ((drv->caps & DRV_CAP_THREADED) || !reconnect_online(drv))
+			continue;
+
+		start = stats_clock();
+		prev = PROFILE_ENTER(profile_driver(drv));
+		displaylist_apply(&back_buffer, drv);
+
+		/* A tile only gets the spans it shows, and no flush at all
+		 * if nothing changed there */
+		if ((count > 0) && driver_get_tile(drv, &tile)) {
+			drv_count = drivers_tile_spans(&tile, spans, count);
+			drv_spans = tile_spans;
+			if ((drv_count == 0) && (frame_backlight == shown_backlight)
+			    && (frame_output == shown_output)
+			    && (frame_cursor.state == shown_cursor.state)
+			    && (frame_cursor.x == shown_cursor.x) && (frame_cursor.y == shown_cursor.y)
+			    && (V_IndexOf(skipped_drivers, drv) < 0)) {
+				PROFILE_LEAVE(prev);
+				continue;
+			}
+		}
+
+		/* Still sending the last frame: this one only goes into the
+		 * driver's frame buffer and is flushed once the driver is
+		 * done, by drivers_flush_skipped() or the next frame. */
+		if (driver_busy(drv) > 0) {
+			if (V_IndexOf(skipped_drivers, drv) < 0)
+				V_Append(skipped_drivers, drv);
+			PROFILE_LEAVE(prev);
+			continue;
+		}
+		/* the spans do not cover what changed in the frames skipped */
+		if (V_Remove(skipped_drivers, drv) != NULL)
+			drivers_flush_driver(drv, start, NULL, -1);
+		else if (drv->caps & DRV_CAP_SCROLL_TEXT) {
+			const LCDSpan *left = spans;
+			int n = drivers_scroll_driver(drv, &left, count);
+
+			drivers_flush_driver(drv, start, left, n);
+		}
+		else
+			drivers_flush_driver(drv, start, drv_spans, drv_count);
+		PROFILE_LEAVE(prev);
+	}
+
+	displaylist_reset(&back_buffer);
+	shown_backlight = frame_backlight;
+	shown_output = frame_output;
+	shown_cursor = frame_cursor;
+	if (selected == 0)
+		framebuf_commit();
+	drivers_auto_flush_move();
 }
 
 
@@ -197,14 +1203,17 @@ drivers_flush(void)
 void
 drivers_string(int x, int y, const char *string)
 {
-	Driver *drv;
+	DriverOp op = { DOP_STRING };
 
 	debug(RPT_DEBUG, "%s(x=%d, y=%d, string=\"%.40s\")", __FUNCTION__, x, y, string);
 
-	ForAllDrivers(drv) {
-		if (drv->string)
-			drv->string(drv, x, y, string);
-	}
+	if (FRAMEBUF_OUTPUT)
+		framebuf_string(x, y, string);
+
+	op.x = x;
+	op.y = y;
+	op.s1 = string;
+	drivers_dispatch(&op);
 }
 
 
@@ -218,14 +1227,17 @@ drivers_string(int x, int y, const char *string)
 void
 drivers_chr(int x, int y, char c)
 {
-	Driver *drv;
+	DriverOp op = { DOP_CHR };
 
 	debug(RPT_DEBUG, "%s(x=%d, y=%d, c='%c')", __FUNCTION__, x, y, c);
 
-	ForAllDrivers(drv) {
-		if (drv->chr)
-			drv->chr(drv, x, y, c);
-	}
+	if (FRAMEBUF_OUTPUT)
+		framebuf_chr(x, y, c);
+
+	op.x = x;
+	op.y = y;
+	op.a = c;
+	drivers_dispatch(&op);
 }
 
 
@@ -242,7 +1254,7 @@ drivers_chr(int x, int y, char c)
 void
 drivers_vbar(int x, int y, int len, int promille, int pattern)
 {
-	Driver *drv;
+	DriverOp op = { DOP_VBAR };
 
 	debug(RPT_DEBUG, "%s(x=%d, y=%d, len=%d, promille=%d, pattern=%d)",
 	      __FUNCTION__, x, y, len, promille, pattern);
@@ -252,13 +1264,16 @@ drivers_vbar(int x, int y, int len, int promille, int pattern)
 	 * We need more data in the widget. Requires language update...
 	 */
 
+	/* the bar grows upwards from (x,y) */
+	if (FRAMEBUF_OUTPUT)
+		framebuf_block(FB_VBAR, x, y - len + 1, 1, len, promille, pattern, len);
 
-	ForAllDrivers(drv) {
-		if (drv->vbar)
-			drv->vbar(drv, x, y, len, promille, pattern);
-		else
-			driver_alt_vbar(drv, x, y, len, promille, pattern);
-	}
+	op.x = x;
+	op.y = y;
+	op.a = len;
+	op.b = promille;
+	op.c = pattern;
+	drivers_dispatch(&op);
 }
 
 
@@ -275,17 +1290,20 @@ drivers_vbar(int x, int y, int len, int promille, int pattern)
 void
 drivers_hbar(int x, int y, int len, int promille, int pattern)
 {
-	Driver *drv;
+	DriverOp op = { DOP_HBAR };
 
 	debug(RPT_DEBUG, "%s(x=%d, y=%d, len=%d, promille=%d, pattern=%d)",
 	      __FUNCTION__, x, y, len, promille, pattern);
 
-	ForAllDrivers(drv) {
-		if (drv->hbar)
-			drv->hbar(drv, x, y, len, promille, pattern);
-		else
-			driver_alt_hbar(drv, x, y, len, promille, pattern);
-	}
+	if (FRAMEBUF_OUTPUT)
+		framebuf_block(FB_HBAR, x, y, len, 1, promille, pattern, len);
+
+	op.x = x;
+	op.y = y;
+	op.a = len;
+	op.b = promille;
+	op.c = pattern;
+	drivers_dispatch(&op);
 }
 
 
@@ -304,12 +1322,23 @@ drivers_hbar(int x, int y, int len, int promille, int pattern)
  * space.
  */
 void
-drivers_pbar(int x, int y, int width, int promille, char *begin_label, char *end_label)
+drivers_pbar(int x, int y, int width, int promille, const char *begin_label, const char *end_label)
 {
-	Driver *drv;
-
-	ForAllDrivers(drv)
-		driver_pbar(drv, x, y, width, promille, begin_label, end_label);
+	DriverOp op = { DOP_PBAR };
+
+	/* labels are part of the bar, a change of them has to show */
+	if (FRAMEBUF_OUTPUT)
+		framebuf_block(FB_PBAR, x, y, width, 1, promille,
+			       (begin_label != NULL) ? (int) HT_HashString(begin_label) : 0,
+			       (end_label != NULL) ? (int) HT_HashString(end_label) : 0);
+
+	op.x = x;
+	op.y = y;
+	op.a = width;
+	op.b = promille;
+	op.s1 = begin_label;
+	op.s2 = end_label;
+	drivers_dispatch(&op);
 }
 
 
@@ -323,16 +1352,17 @@ drivers_pbar(int x, int y, int width, int promille, char *begin_label, char *end
 void
 drivers_num(int x, int num)
 {
-	Driver *drv;
+	DriverOp op = { DOP_NUM };
 
 	debug(RPT_DEBUG, "%s(x=%d, num=%d)", __FUNCTION__, x, num);
 
-	ForAllDrivers(drv) {
-		if (drv->num)
-			drv->num(drv, x, num);
-		else
-			driver_alt_num(drv, x, num);
-	}
+	/* digits are 3 characters wide, the colon (10) is 1 */
+	if (FRAMEBUF_OUTPUT && (display_props != NULL))
+		framebuf_block(FB_NUM, x, 1, (num == 10) ? 1 : 3, display_props->height, num, 0, 0);
+
+	op.x = x;
+	op.a = num;
+	drivers_dispatch(&op);
 }
 
 
@@ -345,16 +1375,16 @@ drivers_num(int x, int num)
 void
 drivers_heartbeat(int state)
 {
-	Driver *drv;
+	DriverOp op = { DOP_HEARTBEAT };
 
 	debug(RPT_DEBUG, "%s(state=%d)", __FUNCTION__, state);
 
-	ForAllDrivers(drv) {
-		if (drv->heartbeat)
-			drv->heartbeat(drv, state);
-		else
-			driver_alt_heartbeat(drv, state);
-	}
+	/* drivers animate the heartbeat in the top right corner */
+	if (FRAMEBUF_OUTPUT && (state == HEARTBEAT_ON) && (display_props != NULL))
+		framebuf_animated(display_props->width, 1);
+
+	op.a = state;
+	drivers_dispatch(&op);
 }
 
 
@@ -371,23 +1401,18 @@ drivers_heartbeat(int state)
 void
 drivers_icon(int x, int y, int icon)
 {
-	Driver *drv;
+	DriverOp op = { DOP_ICON };
 
 	debug(RPT_DEBUG, "%s(x=%d, y=%d, icon=ICON_%s)", __FUNCTION__, x, y, widget_icon_to_iconname(icon));
 
-	ForAllDrivers(drv) {
-		/* Does the driver have the icon function ? */
-		if (drv->icon) {
-			/* Try driver call */
-			if (drv->icon(drv, x, y, icon) == -1) {
-				/* do alternative call if driver's function does not know the icon */
-				driver_alt_icon(drv, x, y, icon);
-			}
-		} else {
-			/* Also do alternative call if the driver does not have icon function */
-			driver_alt_icon(drv, x, y, icon);
-		}
-	}
+	/* icons from 0x200 on are two characters wide */
+	if (FRAMEBUF_OUTPUT)
+		framebuf_block(FB_ICON, x, y, (icon >= 0x200) ? 2 : 1, 1, icon, 0, 0);
+
+	op.x = x;
+	op.y = y;
+	op.a = icon;
+	drivers_dispatch(&op);
 }
 
 
@@ -402,16 +1427,45 @@ drivers_icon(int x, int y, int icon)
 void
 drivers_cursor(int x, int y, int state)
 {
-	Driver *drv;
+	DriverOp op = { DOP_CURSOR };
 
 	debug(RPT_DEBUG, "%s(x=%d, y=%d, state=%d)", __FUNCTION__, x, y, state);
 
-	ForAllDrivers(drv) {
-		if (drv->cursor)
-			drv->cursor(drv, x, y, state);
-		else
-			driver_alt_cursor(drv, x, y, state);
+	/* Drivers with a cursor of their own are only told when it moves
+	 * or changes; without one it is drawn as a blinking character. */
+	frame_cursor.x = (state != CURSOR_OFF) ? x : 0;
+	frame_cursor.y = (state != CURSOR_OFF) ? y : 0;
+	frame_cursor.state = state;
+	if ((selected == 0) && (state != CURSOR_OFF) && !drivers_cursor_native(0))
+		framebuf_animated(x, y);
+
+	op.x = x;
+	op.y = y;
+	op.a = state;
+	drivers_dispatch(&op);
+}
+
+
+/**
+ * Tell whether all drivers of a display show the cursor themselves, so it
+ * is not drawn as a blinking character and does not animate the screen.
+ * \param display  The display's number.
+ * \return  1 if they all have a native cursor, 0 if not or without drivers.
+ */
+int
+drivers_cursor_native(int display)
+{
+	Display *disp = drivers_display(display);
+	Driver *drv;
+	int i;
+
+	if ((disp == NULL) || (V_Length(disp->drivers) == 0))
+		return 0;
+	for (i = 0; (drv = V_Get(disp->drivers, i)) != NULL; i++) {
+		if (!(drv->caps & DRV_CAP_CURSOR))
+			return 0;
 	}
+	return 1;
 }
 
 
@@ -423,14 +1477,13 @@ drivers_cursor(int x, int y, int state)
 void
 drivers_backlight(int state)
 {
-	Driver *drv;
+	DriverOp op = { DOP_BACKLIGHT };
 
 	debug(RPT_DEBUG, "%s(state=%d)", __FUNCTION__, state);
 
-	ForAllDrivers(drv) {
-		if (drv->backlight)
-			drv->backlight(drv, state);
-	}
+	frame_backlight = state;
+	op.a = state;
+	drivers_dispatch(&op);
 }
 
 
@@ -442,14 +1495,13 @@ drivers_backlight(int state)
 void
 drivers_output(int state)
 {
-	Driver *drv;
+	DriverOp op = { DOP_OUTPUT };
 
 	debug(RPT_DEBUG, "%s(state=%d)", __FUNCTION__, state);
 
-	ForAllDrivers(drv) {
-		if (drv->output)
-			drv->output(drv, state);
-	}
+	frame_output = state;
+	op.a = state;
+	drivers_dispatch(&op);
 }
 
 
@@ -460,18 +1512,53 @@ drivers_output(int state)
  */
 const char *
 drivers_get_key(void)
+{
+	unsigned long when;
+	Driver *from;
+
+	return drivers_get_key_event(&when, &from);
+}
+
+
+/**
+ * Get key presses from loaded drivers, with the time they were pressed.
+ * Drivers without get_key_event() give no time, their keys count as
+ * pressed when they are read.
+ * \param when  Where to store the time of the press, by stats_clock().
+ * \param from  Where to store the driver the key came from.
+ * \return  Pointer to key string as drivers_get_key() returns it.
+ */
+const char *
+drivers_get_key_event(unsigned long *when, Driver **from)
 {
 	/* Find the first input keystroke, if any */
 	Driver *drv;
+	int i;
 	const char *keystroke;
 
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	ForAllDrivers(drv) {
-		if (drv->get_key) {
-			keystroke = drv->get_key(drv);
+	ForAllDrivers(i, drv) {
+		if (drv->get_key && !reconnect_online(drv)) {
+			/* a lost device keeps the watched duplicate readable */
+			driver_unwatch_keys(drv);
+			continue;
+		}
+		/* keys are polled again soon, don't wait for a busy driver */
+		if (drv->get_key && (drvthread_trylock(drv) == 0)) {
+			*when = 0;
+			keystroke = (drv->get_key_event != NULL)
+				    ? drv->get_key_event(drv, when)
+				    : drv->get_key(drv);
+			drvthread_unlock(drv);
+			/* catch a closed or lost descriptor at once */
+			driver_watch_keys(drv);
+			reconnect_check(drv);
 			if (keystroke != NULL) {
 				report(RPT_INFO, "Driver [%.40s] generated keystroke %.40s", drv->name, keystroke);
+				if (*when == 0)
+					*when = stats_clock();
+				*from = drv;
 				return keystroke;
 			}
 		}
@@ -479,3 +1566,212 @@ drivers_get_key(void)
 	return NULL;
 }
 
+
+
+/**
+ * Flush the drivers that were too busy to flush the last frame they got,
+ * as soon as they are done; see driver_busy(). On displays that do not
+ * change any more this shows the last frame, on others it may come before
+ * the next frame does.
+ * \return  Time in microseconds until the next of them is done, -1 if
+ *          there are none.
+ */
+long
+drivers_flush_skipped(void)
+{
+	Driver *drv;
+	ProfileSlot *prev;
+	long wait = -1;
+	long busy;
+	int i = 0;
+
+	while ((drv = V_Get(skipped_drivers, i)) != NULL) {
+		/* once back online it gets a whole new frame anyway */
+		if (!reconnect_online(drv)) {
+			V_RemoveAt(skipped_drivers, i);
+			continue;
+		}
+		busy = driver_busy(drv);
+		if (busy > 0) {
+			wait = (wait < 0) ? busy : min(wait, busy);
+			i++;
+			continue;
+		}
+		V_RemoveAt(skipped_drivers, i);
+		prev = PROFILE_ENTER(profile_driver(drv));
+		drivers_flush_driver(drv, stats_clock(), NULL, -1);
+		PROFILE_LEAVE(prev);
+	}
+	drivers_auto_flush_move();
+	return wait;
+}
+
+
+/**
+ * Tell whether drivers whose device was lost came back since the last call.
+ * The next frame then goes to the displays in full, as they were cleared
+ * when the drivers were initialized again.
+ * \retval 1  a driver is online again; render everything anew.
+ * \retval 0  nothing changed.
+ */
+int
+drivers_reconnected(void)
+{
+	if (!reconnect_poll())
+		return 0;
+
+	framebuf_invalidate();
+	return 1;
+}
+
+
+/**
+ * Tell whether any loaded driver has keys that must be polled. Drivers
+ * giving a descriptor for their keys with get_key_fd() are watched along
+ * with the client sockets instead, and wake the main loop when a key
+ * arrives; this call updates those watches. The main loop cannot sleep
+ * indefinitely while a driver has to be polled.
+ * \retval 1  at least one driver's get_key() has to be polled.
+ * \retval 0  no keys need polling.
+ */
+int
+drivers_have_input(void)
+{
+	Driver *drv;
+	int i;
+	int polled = 0;
+
+	ForAllDrivers(i, drv) {
+		if (drv->get_key && !driver_watch_keys(drv))
+			polled = 1;
+	}
+	return polled;
+}
+
+
+/**
+ * Stop watching the descriptors of the drivers' keys. The next
+ * drivers_have_input() watches them again, or polls them if they can no
+ * longer be watched, as once a thread of its own waits on the sockets.
+ */
+void
+drivers_unwatch_keys(void)
+{
+	Driver *drv;
+	int i;
+
+	ForAllDrivers(i, drv)
+		driver_unwatch_keys(drv);
+}
+
+
+/**
+ * Tell how many displays there are: the main display and those named by
+ * the Display setting of the drivers loaded so far.
+ * \return  Number of displays; 1 before any driver was loaded.
+ */
+int
+drivers_display_count(void)
+{
+	return max(V_Length(displays), 1);
+}
+
+
+/**
+ * Find a display by the name the drivers on it give with Display=.
+ * \param name  The name; "main" is the display of the drivers without one.
+ * \return  The display's number, or -1 if there is none of that name.
+ */
+int
+drivers_display_find(const char *name)
+{
+	Display *disp;
+	int i;
+
+	if (strcasecmp(name, "main") == 0)
+		return 0;
+	for (i = 1; (disp = drivers_display(i)) != NULL; i++) {
+		if (strcasecmp(disp->name, name) == 0)
+			return i;
+	}
+	return -1;
+}
+
+
+/**
+ * Get the name of a display.
+ * \param display  The display's number.
+ * \return  Its name, or NULL if there is no such display.
+ */
+const char *
+drivers_display_name(int display)
+{
+	Display *disp = drivers_display(display);
+
+	if (display == 0)
+		return "main";
+	return (disp != NULL) ? disp->name : NULL;
+}
+
+
+/**
+ * Get the properties of a display.
+ * \param display  The display's number.
+ * \return  Its properties, or NULL if none of its drivers does output.
+ */
+DisplayProps *
+drivers_display_props(int display)
+{
+	Display *disp;
+
+	if (display == 0)
+		return (selected == 0) ? display_props : main_props;
+	disp = drivers_display(display);
+	return ((disp != NULL) && (disp->output != NULL)) ? &disp->props : NULL;
+}
+
+
+/**
+ * Find the display a driver is on.
+ * \param drv  A loaded driver.
+ * \return  The display's number; 0 for drivers not loaded.
+ */
+int
+drivers_display_of(Driver *drv)
+{
+	Display *disp;
+	int i;
+
+	for (i = 1; (disp = drivers_display(i)) != NULL; i++) {
+		if (V_IndexOf(disp->drivers, drv) >= 0)
+			return i;
+	}
+	return 0;
+}
+
+
+/**
+ * Select the display the output functions draw on, and drivers_flush()
+ * and drivers_swap_frame() work on. Each display has frames of its own,
+ * so selecting another one leaves the frame of this one as it is. While a
+ * display is selected, display_props are its properties. Everything but
+ * the rendering of other displays expects the main display to be selected.
+ * \param display  The display's number.
+ */
+void
+drivers_select_display(int display)
+{
+	Display *disp = drivers_display(display);
+
+	if ((display == selected) || (disp == NULL))
+		return;
+
+	/* the selected display's state goes back into its place, and the
+	 * placeholder left there moves on to the newly selected one */
+	if (selected == 0)
+		main_props = display_props;
+	drivers_swap_display(drivers_display(selected));
+	drivers_swap_display(disp);
+	selected = display;
+	display_props = (display == 0) ? main_props : &disp->props;
+}
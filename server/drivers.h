@@ -13,7 +13,8 @@
 #define DRIVERS_H
 
 #include "drivers/lcd.h"
-#include "shared/LL.h"
+#include "shared/vector.h"
+#include "displaylist.h"
 
 typedef struct DisplayProps {
 	int width, height;
@@ -25,9 +26,18 @@ extern DisplayProps *display_props;
 int
 drivers_load_driver(const char *name);
 
+int
+drivers_load_drivers(char *const names[], int count);
+
 void
 drivers_unload_all(void);
 
+void
+drivers_unload_offline(void);
+
+int
+drivers_reload(char *const names[], int count);
+
 const char *
 drivers_get_info(void);
 
@@ -37,6 +47,15 @@ drivers_clear(void);
 void
 drivers_flush(void);
 
+void
+drivers_swap_frame(int discard);
+
+void
+drivers_record(DisplayList *list);
+
+void
+drivers_replay(const DriverOp *ops, int count, int dx, int dy);
+
 void
 drivers_string(int x, int y, const char *string);
 
@@ -50,7 +69,7 @@ void
 drivers_hbar(int x, int y, int len, int promille, int pattern);
 
 void
-drivers_pbar(int x, int y, int width, int promille, char *begin_label, char *end_label);
+drivers_pbar(int x, int y, int width, int promille, const char *begin_label, const char *end_label);
 
 void
 drivers_num(int x, int num);
@@ -82,20 +101,52 @@ drivers_output(int state);
 const char *
 drivers_get_key(void);
 
+const char *
+drivers_get_key_event(unsigned long *when, Driver **from);
+
+long
+drivers_flush_skipped(void);
+
+int
+drivers_reconnected(void);
+
+int
+drivers_have_input(void);
+
+void
+drivers_unwatch_keys(void);
+
+int
+drivers_display_count(void);
+
+int
+drivers_display_find(const char *name);
+
+const char *
+drivers_display_name(int display);
+
+DisplayProps *
+drivers_display_props(int display);
+
+int
+drivers_display_of(Driver *drv);
+
+int
+drivers_cursor_native(int display);
+
+void
+drivers_select_display(int display);
+
 
 extern Driver *output_driver;
 
 /* Please don't read this list except using the following functions */
-extern LinkedList *loaded_drivers;
-
-static inline Driver *drivers_getfirst(void)
-{
-	return LL_GetFirst(loaded_drivers);
-}
+extern Vector *loaded_drivers;
 
-static inline Driver *drivers_getnext(void)
+/* Get the index'th loaded driver; NULL behind the last one */
+static inline Driver *drivers_get(int index)
 {
-	return LL_GetNext(loaded_drivers);
+	return V_Get(loaded_drivers, index);
 }
 
 #endif
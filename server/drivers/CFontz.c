@@ -29,8 +29,6 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
-#include <termios.h>
-#include <fcntl.h>
 #include <string.h>
 #include <errno.h>
 
@@ -40,6 +38,7 @@
 
 #include "lcd.h"
 #include "CFontz.h"
+#include "serial_lib.h"
 #include "shared/report.h"
 #include "lcd_lib.h"
 #include "CFontz-charmap.h"
@@ -53,7 +52,7 @@
 typedef struct CFontz_private_data {
 	char device[200];
 
-	int fd;
+	SerialPort serial;
 
 	int model;
 	int newfirmware;
@@ -68,10 +67,16 @@ typedef struct CFontz_private_data {
 
 	/* definable characters */
 	CGmode ccmode;
+	CharCache charcache;	/**< glyphs the custom characters show */
 
 	int contrast;
 	int brightness;
 	int offbrightness;
+
+	/* cursor wanted, shown at the next flush */
+	int cursor_x, cursor_y;
+	int cursor_state;
+	int cursor_shown;	/**< style command last sent */
 } PrivateData;
 
 
@@ -102,10 +107,8 @@ static void CFontz_raw_chr(Driver *drvthis, int x, int y, unsigned char c);
 MODULE_EXPORT int
 CFontz_init(Driver *drvthis)
 {
-	struct termios portset;
 	int tmp, w, h;
 	int reboot = 0;
-	int usb = 0;
 	int speed = DEFAULT_SPEED;
 	char size[200] = DEFAULT_SIZE;
 
@@ -119,10 +122,11 @@ CFontz_init(Driver *drvthis)
 		return -1;
 
 	/* Initialize the PrivateData structure */
-	p->fd = -1;
+	p->serial.fd = -1;
 	p->cellwidth = DEFAULT_CELL_WIDTH;
 	p->cellheight = DEFAULT_CELL_HEIGHT;
 	p->ccmode = standard;
+	lib_cc_init(&p->charcache, NUM_CCs, p->cellheight);
 
 	debug(RPT_INFO, "CFontz: init(%p)", drvthis);
 
@@ -174,11 +178,8 @@ CFontz_init(Driver *drvthis)
 
 	/* Which speed */
 	tmp = drvthis->config_get_int(drvthis->name, "Speed", 0, DEFAULT_SPEED);
-	if (tmp == 1200) speed = B1200;
-	else if (tmp == 2400) speed = B2400;
-	else if (tmp == 9600) speed = B9600;
-	else if (tmp == 19200) speed = B19200;
-	else if (tmp == 115200) speed = B115200;
+	if ((tmp == 1200) || (tmp == 2400) || (tmp == 9600) || (tmp == 19200) || (tmp == 115200))
+		speed = tmp;
 	else {
 		report(RPT_WARNING, "%s: Speed must be 1200, 2400, 9600, 19200 or 115200; using default %d",
 				drvthis->name, DEFAULT_SPEED);
@@ -191,45 +192,17 @@ CFontz_init(Driver *drvthis)
 	/* Reboot display? */
 	reboot = drvthis->config_get_bool(drvthis->name, "Reboot", 0, 0);
 
-	/* Am I USB or not? */
-	usb = drvthis->config_get_bool(drvthis->name, "USB", 0, 0);
-
-	/* Set up io port correctly, and open it... */
+	/*
+	 * Set up io port correctly, and open it. The USB setting is not
+	 * needed any more: the port never blocks, USB adapter or not.
+	 */
 	debug(RPT_DEBUG, "CFontz: Opening device: %s", p->device);
-	p->fd = open(p->device, (usb) ? (O_RDWR | O_NOCTTY) : (O_RDWR | O_NOCTTY | O_NDELAY));
-	if (p->fd == -1) {
+	if (lib_serial_open(&p->serial, p->device, speed, 0) < 0) {
 		report(RPT_ERR, "%s: open(%s) failed (%s)",
 				drvthis->name, p->device, strerror(errno));
 		return -1;
 	}
 
-	tcgetattr(p->fd, &portset);
-
-	/* We use RAW mode */
-#ifdef HAVE_CFMAKERAW
-	/* The easy way */
-	cfmakeraw(&portset);
-#else
-	/* The hard way */
-	portset.c_iflag &= ~( IGNBRK | BRKINT | PARMRK | ISTRIP
-				| INLCR | IGNCR | ICRNL | IXON );
-	portset.c_oflag &= ~OPOST;
-	portset.c_lflag &= ~( ECHO | ECHONL | ICANON | ISIG | IEXTEN );
-	portset.c_cflag &= ~( CSIZE | PARENB | CRTSCTS );
-	portset.c_cflag |= CS8 | CREAD | CLOCAL ;
-#endif
-	if (usb) {
-		portset.c_cc[VMIN] = 1;
-		portset.c_cc[VTIME] = 3;
-	}
-
-	/* Set port speed */
-	cfsetospeed(&portset, speed);
-	cfsetispeed(&portset, B0);
-
-	/* Do it... */
-	tcsetattr(p->fd, TCSANOW, &portset);
-
 	/* make sure the frame buffer is there... */
 	p->framebuf = (unsigned char *) malloc(p->width * p->height);
 	if (p->framebuf == NULL) {
@@ -246,6 +219,8 @@ CFontz_init(Driver *drvthis)
 
 	sleep (1);
 	CFontz_hidecursor(drvthis);
+	p->cursor_state = CURSOR_OFF;
+	p->cursor_shown = CFONTZ_Hide_Cursor;
 	CFontz_linewrap(drvthis, 1);
 	CFontz_autoscroll(drvthis, 0);
 	//CFontz_backlight(drvthis, backlight_brightness);  // render.c variables should not be used in drivers !
@@ -268,8 +243,7 @@ CFontz_close(Driver *drvthis)
 	PrivateData *p = drvthis->private_data;
 
 	if (p != NULL) {
-		if (p->fd >= 0)
-			close(p->fd);
+		lib_serial_close(&p->serial);
 
 		if (p->framebuf)
 			free(p->framebuf);
@@ -374,7 +348,7 @@ CFontz_flush(Driver *drvthis)
 				}
 				*ptr++ = c;
 			}
-			write(p->fd, out, (ptr - out));
+			lib_serial_write(&p->serial, out, (ptr - out));
 		}
 	}
 	else {
@@ -388,9 +362,14 @@ CFontz_flush(Driver *drvthis)
 			/* move cursor to start of (i+1)'th line */
 			CFontz_cursor_goto(drvthis, 1, i+1);
 
-			write(p->fd, p->framebuf + (p->width * i), p->width);
+			lib_serial_write(&p->serial, p->framebuf + (p->width * i), p->width);
 		}
 	}
+
+	/* writing the lines moved the cursor */
+	if (p->cursor_state != CURSOR_OFF)
+		CFontz_cursor_goto(drvthis, p->cursor_x, p->cursor_y);
+	lib_serial_flush(drvthis, &p->serial);
 }
 
 
@@ -474,7 +453,8 @@ CFontz_set_contrast(Driver *drvthis, int promille)
 
 	// And do it (converted from [0,1000] - > [0,100])
 	out[1] = (unsigned char) (promille / 10);
-	write(p->fd, out, 2);
+	lib_serial_write(&p->serial, out, 2);
+	lib_serial_flush(drvthis, &p->serial);
 }
 
 
@@ -533,7 +513,7 @@ CFontz_backlight(Driver *drvthis, int on)
 
 	/* map range [0, 1000] -> [0, 100] that the hardware understands */
 	out[1] = (unsigned char) (promille / 10);
-	write(p->fd, out, 2);
+	lib_serial_write(&p->serial, out, 2);
 }
 
 
@@ -549,7 +529,7 @@ CFontz_linewrap(Driver *drvthis, int on)
 	char out[4];
 
 	out[0] = (on) ? CFONTZ_Wrap_On : CFONTZ_Wrap_Off;
-	write(p->fd, out, 1);
+	lib_serial_write(&p->serial, out, 1);
 }
 
 
@@ -565,7 +545,7 @@ CFontz_autoscroll(Driver *drvthis, int on)
 	char out[4];
 
 	out[0] = (on) ? CFONTZ_Scroll_On : CFONTZ_Scroll_Off;
-	write(p->fd, out, 1);
+	lib_serial_write(&p->serial, out, 1);
 }
 
 
@@ -579,7 +559,7 @@ CFontz_hidecursor(Driver *drvthis)
 	PrivateData *p = drvthis->private_data;
 	char out[4] = { CFONTZ_Hide_Cursor };
 
-	write(p->fd, out, 1);
+	lib_serial_write(&p->serial, out, 1);
 }
 
 
@@ -593,7 +573,8 @@ CFontz_reboot(Driver *drvthis)
 	PrivateData *p = drvthis->private_data;
 	char out[4] = { CFONTZ_Reboot, CFONTZ_Reboot };
 
-	write(p->fd, out, 2);
+	lib_serial_write(&p->serial, out, 2);
+	lib_serial_flush(NULL, &p->serial);
 	sleep(4);
 }
 
@@ -615,7 +596,7 @@ CFontz_cursor_goto(Driver *drvthis, int x, int y)
 		out[1] = (unsigned char) (x - 1);
 	if ((y > 0) && (y <= p->height))
 		out[2] = (unsigned char) (y - 1);
-	write(p->fd, out, 3);
+	lib_serial_write(&p->serial, out, 3);
 }
 
 
@@ -774,7 +755,11 @@ CFontz_set_char(Driver *drvthis, int n, unsigned char *dat)
 	for (row = 0; row < p->cellheight; row++) {
 		out[2+row] = dat[row] & mask;
 	}
-	write(p->fd, out, 2 + p->cellheight);
+	/* skip definitions the display already has, e.g. for big numbers */
+	if (lib_cc_resident(&p->charcache, n, out + 2))
+		return;
+	lib_serial_write(&p->serial, out, 2 + p->cellheight);
+	drvthis->count_io(drvthis, IO_CGRAM, 1);
 }
 
 
@@ -942,10 +927,16 @@ CFontz_cursor(Driver *drvthis, int x, int y, int state)
 			stylecmd[0] = CFONTZ_Show_Block_Cursor;
 			break;
 	}
-	write(p->fd, stylecmd, 1);
+	/* the style only goes out when it changes */
+	if (stylecmd[0] != p->cursor_shown) {
+		lib_serial_write(&p->serial, stylecmd, 1);
+		p->cursor_shown = stylecmd[0];
+	}
 
-	/* set cursor position */
-	CFontz_cursor_goto(drvthis, x, y);
+	/* the position is set by the next flush */
+	p->cursor_state = state;
+	p->cursor_x = x;
+	p->cursor_y = y;
 }
 
 
@@ -5,7 +5,7 @@
 #define DEFAULT_CELL_HEIGHT	8
 #define DEFAULT_CONTRAST	560
 #define DEFAULT_DEVICE		"/dev/lcd"
-#define DEFAULT_SPEED		B9600
+#define DEFAULT_SPEED		9600
 #define DEFAULT_BRIGHTNESS	1000
 #define DEFAULT_OFFBRIGHTNESS	0
 #define DEFAULT_SIZE		"20x4"
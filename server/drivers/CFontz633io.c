@@ -81,10 +81,17 @@
 #endif
 
 
+/* Acknowledgements still to come, oldest first */
+static unsigned char pending[CFONTZ633_MAX_WINDOW];
+static int num_pending = 0;
+static int packet_window = CFONTZ633_DEF_WINDOW;
+
 /* static local functions */
 static void send_packet(int fd, COMMAND_PACKET *out, COMMAND_PACKET *in);
 static int  get_crc(unsigned char *buf, int len, int seed);
-static int  test_packet(int fd, unsigned char response, COMMAND_PACKET *in);
+static void handle_packet(COMMAND_PACKET *in);
+static void read_packets(int fd, COMMAND_PACKET *in);
+static void wait_for_acks(int fd, int max_pending, COMMAND_PACKET *in);
 static int  check_for_packet(int fd, COMMAND_PACKET *in, unsigned char expected_length);
 #ifdef DEBUG
 static void print_packet(COMMAND_PACKET *packet);
@@ -95,7 +102,8 @@ static void print_packet(COMMAND_PACKET *packet);
  *
  * KeyRing handling functions.
  * This separates the producer from the consumer.
- * It is just a small fifo of unsigned char.
+ * It is just a small fifo of unsigned char, on a ring of the driver
+ * library, so that a reader thread can fill it without locking.
  * @{
  */
 
@@ -108,7 +116,7 @@ KeyRing keyring;
  */
 void EmptyKeyRing(KeyRing *kr)
 {
-	kr->head = kr->tail = 0;
+	lib_ring_init(&kr->ring, kr->contents, KEYRINGSIZE, 1);
 }
 
 
@@ -121,14 +129,8 @@ void EmptyKeyRing(KeyRing *kr)
  */
 int AddKeyToKeyRing(KeyRing *kr, unsigned char key)
 {
-	if (((kr->head + 1) % KEYRINGSIZE) != (kr->tail % KEYRINGSIZE)) {
-		kr->contents[kr->head % KEYRINGSIZE] = key;
-		kr->head = (kr->head + 1) % KEYRINGSIZE;
-		return 1;
-	}
-
 	/* KeyRing overflow: do not accept extra key */
-	return 0;
+	return (lib_ring_put(&kr->ring, &key) == 0) ? 1 : 0;
 }
 
 
@@ -142,13 +144,7 @@ unsigned char GetKeyFromKeyRing(KeyRing *kr)
 {
 	unsigned char retval = '\0';
 
-	kr->tail %= KEYRINGSIZE;
-
-	if ((kr->head % KEYRINGSIZE) != kr->tail) {
-		retval = kr->contents[kr->tail];
-	        kr->tail = (kr->tail + 1) % KEYRINGSIZE;
-	}
-
+	lib_ring_get(&kr->ring, &retval);
 	return retval;
 }
 /** @} */
@@ -215,7 +211,38 @@ void send_zerobyte_message(int fd, unsigned char msg)
 
 
 /**
- * Send out to the given handle; calc & send CRC when doing so.
+ * Set how many packets may be sent before their acknowledgements arrive.
+ * \param window  Number of packets; 1 waits for each acknowledgement before
+ *                sending the next packet.
+ */
+void set_packet_window(int window)
+{
+	if (window < 1)
+		window = 1;
+	if (window > CFONTZ633_MAX_WINDOW)
+		window = CFONTZ633_MAX_WINDOW;
+	packet_window = window;
+}
+
+
+/**
+ * Wait for the acknowledgements of all packets sent. Call this at the end of
+ * an update, so keys reported in between are seen and the next update does
+ * not start on a full window.
+ * \param fd  File handle to read from.
+ */
+void flush_packets(int fd)
+{
+	COMMAND_PACKET in;
+
+	wait_for_acks(fd, 0, &in);
+}
+
+
+/**
+ * Send out to the given handle; calc & send CRC when doing so. The packet
+ * is written at once, and up to packet_window packets are on their way
+ * without an acknowledgement.
  * \param fd    File handle to write to.
  * \param out   Pointer to COMMAND_PACKET structure to write.
  * \param in    Pointer to COMMAND_PACKET structure to read after write.
@@ -223,24 +250,90 @@ void send_zerobyte_message(int fd, unsigned char msg)
 static void
 send_packet(int fd, COMMAND_PACKET *out, COMMAND_PACKET *in)
 {
-	unsigned char CRC[2];
+	unsigned char buf[MAX_DATA_LENGTH + 4];
+	int len = out->data_length + 2;
 
-	write(fd, &out->command, 1);
-	write(fd, &out->data_length, 1);
-	if (out->data_length > 0)
-		write(fd, out->data, out->data_length);
+	/* make room in the window */
+	wait_for_acks(fd, packet_window - 1, in);
 
-	/* calculate & send the CRC: convert to bytes manually to avoid endianess issues */
-	out->crc = get_crc((unsigned char *) out, out->data_length + 2, 0xFFFF);
-	CRC[0] = out->crc & 0xFF;
-	CRC[1] = (out->crc >> 8) & 0xFF;
-	write(fd, CRC, 2);
+	buf[0] = out->command;
+	buf[1] = out->data_length;
+	memcpy(buf + 2, out->data, out->data_length);
+
+	/* calculate & append the CRC: convert to bytes manually to avoid endianess issues */
+	out->crc = get_crc(buf, len, 0xFFFF);
+	buf[len++] = out->crc & 0xFF;
+	buf[len++] = (out->crc >> 8) & 0xFF;
+	write(fd, buf, len);
 
 	/**** TEST STUFF ****/
 	//print_packet(out);
 
-	/* Every time we send a message, we also check for an incoming one. */
-	test_packet(fd, 0x40 | out->command, in);
+	pending[num_pending++] = out->command;
+
+	/* Every time we send a message, we also check for incoming ones. */
+	read_packets(fd, in);
+}
+
+
+/* CRC lookup table to avoid bit-shifting loops. */
+static const word crcLookupTable[256] = {
+	0x00000, 0x01189, 0x02312, 0x0329B, 0x04624, 0x057AD, 0x06536, 0x074BF,
+	0x08C48, 0x09DC1, 0x0AF5A, 0x0BED3, 0x0CA6C, 0x0DBE5, 0x0E97E, 0x0F8F7,
+	0x01081, 0x00108, 0x03393, 0x0221A, 0x056A5, 0x0472C, 0x075B7, 0x0643E,
+	0x09CC9, 0x08D40, 0x0BFDB, 0x0AE52, 0x0DAED, 0x0CB64, 0x0F9FF, 0x0E876,
+	0x02102, 0x0308B, 0x00210, 0x01399, 0x06726, 0x076AF, 0x04434, 0x055BD,
+	0x0AD4A, 0x0BCC3, 0x08E58, 0x09FD1, 0x0EB6E, 0x0FAE7, 0x0C87C, 0x0D9F5,
+	0x03183, 0x0200A, 0x01291, 0x00318, 0x077A7, 0x0662E, 0x054B5, 0x0453C,
+	0x0BDCB, 0x0AC42, 0x09ED9, 0x08F50, 0x0FBEF, 0x0EA66, 0x0D8FD, 0x0C974,
+	0x04204, 0x0538D, 0x06116, 0x0709F, 0x00420, 0x015A9, 0x02732, 0x036BB,
+	0x0CE4C, 0x0DFC5, 0x0ED5E, 0x0FCD7, 0x08868, 0x099E1, 0x0AB7A, 0x0BAF3,
+	0x05285, 0x0430C, 0x07197, 0x0601E, 0x014A1, 0x00528, 0x037B3, 0x0263A,
+	0x0DECD, 0x0CF44, 0x0FDDF, 0x0EC56, 0x098E9, 0x08960, 0x0BBFB, 0x0AA72,
+	0x06306, 0x0728F, 0x04014, 0x0519D, 0x02522, 0x034AB, 0x00630, 0x017B9,
+	0x0EF4E, 0x0FEC7, 0x0CC5C, 0x0DDD5, 0x0A96A, 0x0B8E3, 0x08A78, 0x09BF1,
+	0x07387, 0x0620E, 0x05095, 0x0411C, 0x035A3, 0x0242A, 0x016B1, 0x00738,
+	0x0FFCF, 0x0EE46, 0x0DCDD, 0x0CD54, 0x0B9EB, 0x0A862, 0x09AF9, 0x08B70,
+	0x08408, 0x09581, 0x0A71A, 0x0B693, 0x0C22C, 0x0D3A5, 0x0E13E, 0x0F0B7,
+	0x00840, 0x019C9, 0x02B52, 0x03ADB, 0x04E64, 0x05FED, 0x06D76, 0x07CFF,
+	0x09489, 0x08500, 0x0B79B, 0x0A612, 0x0D2AD, 0x0C324, 0x0F1BF, 0x0E036,
+	0x018C1, 0x00948, 0x03BD3, 0x02A5A, 0x05EE5, 0x04F6C, 0x07DF7, 0x06C7E,
+	0x0A50A, 0x0B483, 0x08618, 0x09791, 0x0E32E, 0x0F2A7, 0x0C03C, 0x0D1B5,
+	0x02942, 0x038CB, 0x00A50, 0x01BD9, 0x06F66, 0x07EEF, 0x04C74, 0x05DFD,
+	0x0B58B, 0x0A402, 0x09699, 0x08710, 0x0F3AF, 0x0E226, 0x0D0BD, 0x0C134,
+	0x039C3, 0x0284A, 0x01AD1, 0x00B58, 0x07FE7, 0x06E6E, 0x05CF5, 0x04D7C,
+	0x0C60C, 0x0D785, 0x0E51E, 0x0F497, 0x08028, 0x091A1, 0x0A33A, 0x0B2B3,
+	0x04A44, 0x05BCD, 0x06956, 0x078DF, 0x00C60, 0x01DE9, 0x02F72, 0x03EFB,
+	0x0D68D, 0x0C704, 0x0F59F, 0x0E416, 0x090A9, 0x08120, 0x0B3BB, 0x0A232,
+	0x05AC5, 0x04B4C, 0x079D7, 0x0685E, 0x01CE1, 0x00D68, 0x03FF3, 0x02E7A,
+	0x0E70E, 0x0F687, 0x0C41C, 0x0D595, 0x0A12A, 0x0B0A3, 0x08238, 0x093B1,
+	0x06B46, 0x07ACF, 0x04854, 0x059DD, 0x02D62, 0x03CEB, 0x00E70, 0x01FF9,
+	0x0F78F, 0x0E606, 0x0D49D, 0x0C514, 0x0B1AB, 0x0A022, 0x092B9, 0x08330,
+	0x07BC7, 0x06A4E, 0x058D5, 0x0495C, 0x03DE3, 0x02C6A, 0x01EF1, 0x00F78
+};
+
+/*
+ * crcSliceTables[n][b] is the CRC register after byte b followed by n + 1
+ * zero bytes, so eight bytes can be folded in one step.
+ */
+static word crcSliceTables[7][256];
+static int crcSliceTablesReady = 0;
+
+/* Derive the slice-by-8 tables from crcLookupTable. */
+static void
+make_crc_slice_tables(void)
+{
+	int n, b;
+
+	for (b = 0; b < 256; b++) {
+		word crc = crcLookupTable[b];
+
+		for (n = 0; n < 7; n++) {
+			crc = (crc >> 8) ^ crcLookupTable[crc & 0xFF];
+			crcSliceTables[n][b] = crc;
+		}
+	}
+	crcSliceTablesReady = 1;
 }
 
 
@@ -264,46 +357,27 @@ send_packet(int fd, COMMAND_PACKET *out, COMMAND_PACKET *in)
 static int
 get_crc(unsigned char *buf, int len, int seed)
 {
-
-	/* CRC lookup table to avoid bit-shifting loops. */
-	static const word crcLookupTable[256] = {
-		0x00000, 0x01189, 0x02312, 0x0329B, 0x04624, 0x057AD, 0x06536, 0x074BF,
-		0x08C48, 0x09DC1, 0x0AF5A, 0x0BED3, 0x0CA6C, 0x0DBE5, 0x0E97E, 0x0F8F7,
-		0x01081, 0x00108, 0x03393, 0x0221A, 0x056A5, 0x0472C, 0x075B7, 0x0643E,
-		0x09CC9, 0x08D40, 0x0BFDB, 0x0AE52, 0x0DAED, 0x0CB64, 0x0F9FF, 0x0E876,
-		0x02102, 0x0308B, 0x00210, 0x01399, 0x06726, 0x076AF, 0x04434, 0x055BD,
-		0x0AD4A, 0x0BCC3, 0x08E58, 0x09FD1, 0x0EB6E, 0x0FAE7, 0x0C87C, 0x0D9F5,
-		0x03183, 0x0200A, 0x01291, 0x00318, 0x077A7, 0x0662E, 0x054B5, 0x0453C,
-		0x0BDCB, 0x0AC42, 0x09ED9, 0x08F50, 0x0FBEF, 0x0EA66, 0x0D8FD, 0x0C974,
-		0x04204, 0x0538D, 0x06116, 0x0709F, 0x00420, 0x015A9, 0x02732, 0x036BB,
-		0x0CE4C, 0x0DFC5, 0x0ED5E, 0x0FCD7, 0x08868, 0x099E1, 0x0AB7A, 0x0BAF3,
-		0x05285, 0x0430C, 0x07197, 0x0601E, 0x014A1, 0x00528, 0x037B3, 0x0263A,
-		0x0DECD, 0x0CF44, 0x0FDDF, 0x0EC56, 0x098E9, 0x08960, 0x0BBFB, 0x0AA72,
-		0x06306, 0x0728F, 0x04014, 0x0519D, 0x02522, 0x034AB, 0x00630, 0x017B9,
-		0x0EF4E, 0x0FEC7, 0x0CC5C, 0x0DDD5, 0x0A96A, 0x0B8E3, 0x08A78, 0x09BF1,
-		0x07387, 0x0620E, 0x05095, 0x0411C, 0x035A3, 0x0242A, 0x016B1, 0x00738,
-		0x0FFCF, 0x0EE46, 0x0DCDD, 0x0CD54, 0x0B9EB, 0x0A862, 0x09AF9, 0x08B70,
-		0x08408, 0x09581, 0x0A71A, 0x0B693, 0x0C22C, 0x0D3A5, 0x0E13E, 0x0F0B7,
-		0x00840, 0x019C9, 0x02B52, 0x03ADB, 0x04E64, 0x05FED, 0x06D76, 0x07CFF,
-		0x09489, 0x08500, 0x0B79B, 0x0A612, 0x0D2AD, 0x0C324, 0x0F1BF, 0x0E036,
-		0x018C1, 0x00948, 0x03BD3, 0x02A5A, 0x05EE5, 0x04F6C, 0x07DF7, 0x06C7E,
-		0x0A50A, 0x0B483, 0x08618, 0x09791, 0x0E32E, 0x0F2A7, 0x0C03C, 0x0D1B5,
-		0x02942, 0x038CB, 0x00A50, 0x01BD9, 0x06F66, 0x07EEF, 0x04C74, 0x05DFD,
-		0x0B58B, 0x0A402, 0x09699, 0x08710, 0x0F3AF, 0x0E226, 0x0D0BD, 0x0C134,
-		0x039C3, 0x0284A, 0x01AD1, 0x00B58, 0x07FE7, 0x06E6E, 0x05CF5, 0x04D7C,
-		0x0C60C, 0x0D785, 0x0E51E, 0x0F497, 0x08028, 0x091A1, 0x0A33A, 0x0B2B3,
-		0x04A44, 0x05BCD, 0x06956, 0x078DF, 0x00C60, 0x01DE9, 0x02F72, 0x03EFB,
-		0x0D68D, 0x0C704, 0x0F59F, 0x0E416, 0x090A9, 0x08120, 0x0B3BB, 0x0A232,
-		0x05AC5, 0x04B4C, 0x079D7, 0x0685E, 0x01CE1, 0x00D68, 0x03FF3, 0x02E7A,
-		0x0E70E, 0x0F687, 0x0C41C, 0x0D595, 0x0A12A, 0x0B0A3, 0x08238, 0x093B1,
-		0x06B46, 0x07ACF, 0x04854, 0x059DD, 0x02D62, 0x03CEB, 0x00E70, 0x01FF9,
-		0x0F78F, 0x0E606, 0x0D49D, 0x0C514, 0x0B1AB, 0x0A022, 0x092B9, 0x08330,
-		0x07BC7, 0x06A4E, 0x058D5, 0x0495C, 0x03DE3, 0x02C6A, 0x01EF1, 0x00F78
-	};
-
-    	/* initialize the new crc with the given seed */
+	/* initialize the new crc with the given seed */
 	int newCrc = seed;
 
+	if (!crcSliceTablesReady)
+		make_crc_slice_tables();
+
+	/*
+	 * Slice-by-8: fold eight bytes per step, the first two into the
+	 * register and all of them through the table for their distance
+	 * from the end of the block.
+	 */
+	while (len >= 8) {
+		newCrc ^= buf[0] | (buf[1] << 8);
+		newCrc = crcSliceTables[6][newCrc & 0xFF] ^ crcSliceTables[5][(newCrc >> 8) & 0xFF]
+			^ crcSliceTables[4][buf[2]] ^ crcSliceTables[3][buf[3]]
+			^ crcSliceTables[2][buf[4]] ^ crcSliceTables[1][buf[5]]
+			^ crcSliceTables[0][buf[6]] ^ crcLookupTable[buf[7]];
+		buf += 8;
+		len -= 8;
+	}
+
 	/* This algorithm is based on the IrDA LAP example */
 	while (len-- > 0)
 		newCrc = (newCrc >> 8) ^ crcLookupTable[(newCrc ^ *buf++) & 0xFF];
@@ -492,53 +566,87 @@ unsigned char PeekByte(ReceiveBuffer *rb)
 
 
 /**
- * Check for a response packet and try to identify it.
- * \param fd        File handle to read from.
- * \param response  Expected response command.
- * \param in        Pointer to COMMAND_PACKET structure to write the response to.
- * \retval 1  Expected response received.
- * \retval 0  Expected response not received.
+ * Handle a packet received: store key reports, and match acknowledgements
+ * (0x40 | command, or 0xC0 | command for errors) with the packets sent. The
+ * LCD answers in order, so packets sent before the one acknowledged have
+ * lost their answer.
+ * \param in  Pointer to the COMMAND_PACKET received.
+ */
+static void
+handle_packet(COMMAND_PACKET *in)
+{
+	int i;
+
+	/* key activity ? */
+	if (in->command == 0x80) {
+		AddKeyToKeyRing(&keyring, in->data[0]);
+		return;
+	}
+	if ((in->command & 0x40) == 0)
+		return;
+
+	for (i = 0; i < num_pending; i++) {
+		if (pending[i] == (in->command & 0x3F)) {
+			num_pending -= i + 1;
+			memmove(pending, pending + i + 1, num_pending);
+			return;
+		}
+	}
+}
+
+
+/**
+ * Handle all complete packets that can be read now.
+ * \param fd  File handle to read from.
+ * \param in  Pointer to COMMAND_PACKET structure to read the packets to.
  *
  * \todo check_for_packet is always called with MAX_DATA_LENGTH. This doesn't
  *       do any harm, but passing that parameter is useless then. Additionally
  *       one complete packet is MAX_DATA_LENGTH + 4 (command, length, CRC).
  */
-static int
-test_packet(int fd, unsigned char response, COMMAND_PACKET *in)
+static void
+read_packets(int fd, COMMAND_PACKET *in)
 {
-#if defined(HAVE_SELECT) && defined(CFONTZ633_WRITE_DELAY) && (CFONTZ633_WRITE_DELAY > 0)
-	int response_received = 0;
-	int loop;
-
-	/* wait for answer packet but forever (LCDs should answer within max. 250ms) */
-	for (loop = 250000/CFONTZ633_WRITE_DELAY; !response_received && loop > 0; loop--) {
-		int is_msg = check_for_packet(fd, in, MAX_DATA_LENGTH);
-
-		while (is_msg != GIVE_UP) {
-			if (is_msg == GOOD_MSG) {
-				/* key activity ? */
-				if (in->command == 0x80)
-					AddKeyToKeyRing(&keyring, in->data[0]);
-				else if (in->command == response)
-					response_received = 1;
-			}
-
-			is_msg = check_for_packet(fd, in, MAX_DATA_LENGTH);
-		}
-	}
-	return(response_received);
-#else
 	int is_msg = check_for_packet(fd, in, MAX_DATA_LENGTH);
+
 	while (is_msg != GIVE_UP) {
-		if (is_msg == GOOD_MSG) {
-			if (in->command == 0x80)
-				AddKeyToKeyRing(&keyring, in->data[0]);
-		}
+		if (is_msg == GOOD_MSG)
+			handle_packet(in);
 
 		is_msg = check_for_packet(fd, in, MAX_DATA_LENGTH);
 	}
+}
 
-	return 1;
+
+/**
+ * Wait until at most max_pending packets wait for their acknowledgement.
+ * The LCD should answer each packet within 250ms; a packet that is not
+ * answered in that time is given up.
+ * \param fd           File handle to read from.
+ * \param max_pending  Number of unacknowledged packets to leave.
+ * \param in           Pointer to COMMAND_PACKET structure to read the packets to.
+ */
+static void
+wait_for_acks(int fd, int max_pending, COMMAND_PACKET *in)
+{
+#if defined(HAVE_SELECT) && defined(CFONTZ633_WRITE_DELAY) && (CFONTZ633_WRITE_DELAY > 0)
+	while (num_pending > max_pending) {
+		int waiting = num_pending;
+		int loop;
+
+		for (loop = 250000/CFONTZ633_WRITE_DELAY; (num_pending == waiting) && loop > 0; loop--)
+			read_packets(fd, in);
+
+		/* no answer to the oldest packet: forget it */
+		if (num_pending == waiting) {
+			num_pending--;
+			memmove(pending, pending + 1, num_pending);
+		}
+	}
+#else
+	/* without select() answers cannot be waited for */
+	read_packets(fd, in);
+	num_pending = 0;
 #endif
 }
 
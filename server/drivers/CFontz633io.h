@@ -8,6 +8,8 @@
  * ====================================================================
  */
 
+#include "ring_lib.h"
+
 #define CF633_Ping_Command					0
 #define CF633_Get_Hardware_And_Firmware_Version			1
 #define CF633_Write_User_Flash_Area				2
@@ -79,9 +81,8 @@ typedef unsigned long dword;
 #define KEYRINGSIZE	16
 
 typedef struct {
+	LibRing ring;
 	unsigned char contents[KEYRINGSIZE];
-	int head;
-	int tail;
 } KeyRing;
 
 
@@ -108,6 +109,10 @@ typedef struct {
 } COMMAND_PACKET;
 
 
+/* packets on their way without acknowledgement */
+#define CFONTZ633_DEF_WINDOW	4
+#define CFONTZ633_MAX_WINDOW	16
+
 void          EmptyKeyRing(KeyRing *kr);
 int           AddKeyToKeyRing(KeyRing *kr, unsigned char key);
 unsigned char GetKeyFromKeyRing(KeyRing *kr);
@@ -115,6 +120,8 @@ unsigned char GetKeyFromKeyRing(KeyRing *kr);
 void          send_bytes_message(int fd, unsigned char msg, int len, unsigned char *data);
 void          send_onebyte_message(int fd, unsigned char msg, unsigned char value);
 void          send_zerobyte_message(int fd, unsigned char msg);
+void          set_packet_window(int window);
+void          flush_packets(int fd);
 
 void          EmptyReceiveBuffer(ReceiveBuffer *rb);
 void          SyncReceiveBuffer(ReceiveBuffer *rb, int fd, unsigned int number);
@@ -81,6 +81,7 @@ typedef struct CFontzPacket_private_data {
 
 	/* definable characters */
 	CGmode ccmode;
+	CharCache charcache;	/**< glyphs the custom characters show */
 
 	int contrast;
 	int brightness;
@@ -142,6 +143,7 @@ CFontzPacket_init (Driver *drvthis)
 	p->fd = -1;
 	p->cellheight = DEFAULT_CELL_HEIGHT;
 	p->ccmode = standard;
+	lib_cc_init(&p->charcache, NUM_CCs, p->cellheight);
 	p->LEDstate = 0xFFFF;
 
 	debug(RPT_INFO, "%s(%p)", __FUNCTION__, drvthis);
@@ -230,6 +232,16 @@ CFontzPacket_init (Driver *drvthis)
 	}
 	p->speed = (tmp == 19200) ? B19200 : B115200;
 
+	/* How many packets may wait for their acknowledgement */
+	tmp = drvthis->config_get_int(drvthis->name, "PacketWindow", 0, CFONTZ633_DEF_WINDOW);
+	debug(RPT_INFO, "%s: PacketWindow (in config) is '%d'", __FUNCTION__, tmp);
+	if ((tmp < 1) || (tmp > CFONTZ633_MAX_WINDOW)) {
+		report(RPT_WARNING, "%s: PacketWindow must be between 1 and %d; using default %d",
+			drvthis->name, CFONTZ633_MAX_WINDOW, CFONTZ633_DEF_WINDOW);
+		tmp = CFONTZ633_DEF_WINDOW;
+	}
+	set_packet_window(tmp);
+
 	/* Does the display has an old firmware (<= 0.6)? */
 	p->oldfirmware = drvthis->config_get_bool(drvthis->name, "OldFirmware", 0, 0);
 
@@ -324,8 +336,10 @@ CFontzPacket_close (Driver *drvthis)
 	PrivateData *p = drvthis->private_data;
 
 	if (p != NULL) {
-		if (p->fd >= 0)
+		if (p->fd >= 0) {
+			flush_packets(p->fd);
 			close(p->fd);
+		}
 
 		if (p->framebuf)
 			free(p->framebuf);
@@ -413,28 +427,16 @@ CFontzPacket_flush (Driver *drvthis)
 		 * Older CFA-633 HW/FW types only support updates of full or
 		 * partial line starting from pos 0.
 		 */
-		unsigned char *xp = p->framebuf;
-		unsigned char *xq = p->backingstore;
-
-		for (i = 0; i < p->width; i++) {
-			if (*xp++ != *xq++) {
-				send_bytes_message(p->fd, CF633_Set_LCD_Contents_Line_One, 16, p->framebuf);
-				memcpy(p->backingstore, p->framebuf, p->width);
-				modified++;
-				break;
-			}
+		if (lib_diff_first(p->framebuf, p->backingstore, p->width) >= 0) {
+			send_bytes_message(p->fd, CF633_Set_LCD_Contents_Line_One, 16, p->framebuf);
+			memcpy(p->backingstore, p->framebuf, p->width);
+			modified++;
 		}
 
-		xp = p->framebuf + p->width;
-		xq = p->backingstore + p->width;
-
-		for (i = 0; i < p->width; i++) {
-			if (*xp++ != *xq++) {
-				send_bytes_message(p->fd, CF633_Set_LCD_Contents_Line_Two, 16, p->framebuf + p->width);
-				memcpy(p->backingstore + p->width, p->framebuf + p->width, p->width);
-				modified++;
-				break;
-			}
+		if (lib_diff_first(p->framebuf + p->width, p->backingstore + p->width, p->width) >= 0) {
+			send_bytes_message(p->fd, CF633_Set_LCD_Contents_Line_Two, 16, p->framebuf + p->width);
+			memcpy(p->backingstore + p->width, p->framebuf + p->width, p->width);
+			modified++;
 		}
 	}
 	else {
@@ -455,21 +457,17 @@ CFontzPacket_flush (Driver *drvthis)
 			unsigned char *sp = p->framebuf + (i * p->width);
 			unsigned char *sq = p->backingstore + (i * p->width);
 
-			/* set pointers to end of the line in frame buffer & backing store */
-			unsigned char *ep = sp + (p->width - 1);
-			unsigned char *eq = sq + (p->width - 1);
 			int length = 0;
+			int last;
 
 			debug(RPT_DEBUG, "Framebuf: '%.*s'", p->width, sp);
 			debug(RPT_DEBUG, "Backingstore: '%.*s'", p->width, sq);
 
-			/* skip over leading identical portions of the line */
-			for (j = 0; (sp <= ep) && (*sp == *sq); sp++, sq++, j++)
-			  ;
-
-			/* skip over trailing identical portions of the line */
-			for (length = p->width - j; (length > 0) && (*ep == *eq); ep--, eq--, length--)
-			  ;
+			/* leave out leading and trailing identical portions of the line */
+			if (lib_diff_span(sp, sq, p->width, &j, &last)) {
+				sp += j;
+				length = last - j + 1;
+			}
 
 			/* there are differences, ... */
 			if (length > 0) {
@@ -495,6 +493,8 @@ CFontzPacket_flush (Driver *drvthis)
 	/* send something to the LCD to allow keys to be received */
 	if (!modified)
 		send_zerobyte_message(p->fd, CF633_Ping_Command);
+
+	flush_packets(p->fd);
 }
 
 
@@ -945,6 +945,9 @@ CFontzPacket_set_char (Driver *drvthis, int n, unsigned char *dat)
 	for (row = 0; row < p->cellheight; row++) {
 		out[row+1] = dat[row] & mask;
 	}
+	/* skip definitions the display already has, e.g. for big numbers */
+	if (lib_cc_resident(&p->charcache, n, out + 1))
+		return;
 	send_bytes_message(p->fd, CF633_Set_LCD_Special_Character_Data, 9, out);
 }
 
@@ -1204,6 +1207,40 @@ CFontzPacket_string (Driver *drvthis, int x, int y, const char string[])
 }
 
 
+/**
+ * Write a block of characters to the screen. Row r of the block starts at
+ * buf + r * stride; the parts outside the display are left out.
+ * \param drvthis  Pointer to driver structure.
+ * \param buf      Characters of the top left row.
+ * \param stride   Distance between the rows in buf.
+ * \param rect     Position and size of the block.
+ */
+MODULE_EXPORT void
+CFontzPacket_blit_text (Driver *drvthis, const unsigned char *buf, int stride, const LCDRect *rect)
+{
+	PrivateData *p = drvthis->private_data;
+	int i, j;
+
+	for (j = 0; j < rect->height; j++) {
+		const unsigned char *src = buf + j * stride;
+		int y = rect->y - 1 + j;
+
+		if ((y < 0) || (y >= p->height))
+			continue;
+		for (i = 0; i < rect->width; i++) {
+			int x = rect->x - 1 + i;
+
+			if (x < 0)
+				continue;
+			if (x >= p->width)
+				break;
+			p->framebuf[(y * p->width) + x] =
+				p->model_desc->charmap[src[i]];
+		}
+	}
+}
+
+
 /**
  * Set output port: output values using the LEDs of a CF635.
  * \param drvthis  Pointer to driver structure.
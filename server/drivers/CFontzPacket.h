@@ -32,6 +32,7 @@ MODULE_EXPORT void CFontzPacket_clear (Driver *drvthis);
 MODULE_EXPORT void CFontzPacket_flush (Driver *drvthis);
 MODULE_EXPORT void CFontzPacket_string (Driver *drvthis, int x, int y, const char string[]);
 MODULE_EXPORT void CFontzPacket_chr (Driver *drvthis, int x, int y, char c);
+MODULE_EXPORT void CFontzPacket_blit_text (Driver *drvthis, const unsigned char *buf, int stride, const LCDRect *rect);
 MODULE_EXPORT const char *CFontzPacket_get_key (Driver *drvthis);
 
 MODULE_EXPORT void CFontzPacket_vbar (Driver *drvthis, int x, int y, int len, int promille, int options);
@@ -43,8 +43,6 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/time.h>
-#include <termios.h>
-#include <fcntl.h>
 #include <string.h>
 #include <strings.h>
 #include <errno.h>
@@ -56,11 +54,13 @@
 #endif
 
 #include "lcd.h"
+#include "serial_lib.h"
 #include "lcd_lib.h"
 #include "MtxOrb.h"
 #include "adv_bignum.h"
 
 #include "shared/report.h"
+#include "shared/defines.h"
 
 
 /* MO displays allow 25 keys that map by default to 'A' - 'Y' */
@@ -104,10 +104,16 @@ typedef enum {
 /* Constants for userdefchar_mode */
 #define NUM_CCs		8 /* max. number of custom characters */
 
+/*
+ * Bytes of a cursor positioning command. Unchanged characters between two
+ * changes are sent again if that is not more than moving the cursor.
+ */
+#define MTXORB_GOTO_COST	4
+
 
 /** private data for the \c MtxOrb driver */
 typedef struct MtxOrb_private_data {
-	int fd;			/**< LCD file descriptor */
+	SerialPort serial;	/**< Port of the LCD */
 
 	/* dimensions */
 	int width, height;
@@ -119,6 +125,12 @@ typedef struct MtxOrb_private_data {
 
 	/* definable characters */
 	CGmode ccmode;
+	CharCache charcache;	/**< glyphs the custom characters show */
+
+	int cursor_x, cursor_y;	/**< where text goes to on the LCD; 0 if unknown */
+	int show_x, show_y;	/**< where the cursor is wanted, see MtxOrb_cursor() */
+	int show_state;		/**< cursor state wanted */
+	int cursor_shown;	/**< cursor on the LCD: 1 on, 0 off, -1 unknown */
 
 	int output_state;	/**< current output state */
 	int contrast;		/**< current contrast */
@@ -267,6 +279,8 @@ static void MtxOrb_linewrap(Driver *drvthis, int on);
 static void MtxOrb_autoscroll(Driver *drvthis, int on);
 static void MtxOrb_cursorblink(Driver *drvthis, int on);
 static void MtxOrb_cursor_goto(Driver *drvthis, int x, int y);
+static void MtxOrb_flush_cursor(Driver *drvthis);
+static void MtxOrb_send_text(Driver *drvthis, int x, int y, int length);
 
 
 /**
@@ -278,10 +292,8 @@ static void MtxOrb_cursor_goto(Driver *drvthis, int x, int y);
 MODULE_EXPORT int
 MtxOrb_init (Driver *drvthis)
 {
-	struct termios portset;
-
 	char device[256] = DEFAULT_DEVICE;
-	int speed = DEFAULT_SPEED;
+	int speed;
 	char size[256] = DEFAULT_SIZE;
 	char buf[256] = "";
 	int tmp, w, h;
@@ -296,13 +308,14 @@ MtxOrb_init (Driver *drvthis)
 		return -1;
 
 	/* Initialise the PrivateData structure */
-	p->fd = -1;
+	p->serial.fd = -1;
 	p->MtxOrb_type = MTXORB_LKD;  /* Assume it's an LCD w/keypad */
 
 	p->width = LCD_DEFAULT_WIDTH;
 	p->height = LCD_DEFAULT_HEIGHT;
 	p->cellwidth = LCD_DEFAULT_CELLWIDTH;
 	p->cellheight = LCD_DEFAULT_CELLHEIGHT;
+	lib_cc_init(&p->charcache, NUM_CCs, p->cellheight);
 
 	p->framebuf = NULL;
 	p->backingstore = NULL;
@@ -370,19 +383,13 @@ MtxOrb_init (Driver *drvthis)
 	tmp = drvthis->config_get_int(drvthis->name, "Speed", 0, DEFAULT_SPEED);
 	switch (tmp) {
 		case 1200:
-			speed = B1200;
-			break;
 		case 2400:
-			speed = B2400;
-			break;
 		case 9600:
-			speed = B9600;
-			break;
 		case 19200:
-			speed = B19200;
+			speed = tmp;
 			break;
 		default:
-			speed = B19200;
+			speed = 19200;
 			report(RPT_WARNING, "%s: Speed must be 1200, 2400, 9600 or 19200; using default %d",
 					drvthis->name, tmp);
 	}
@@ -447,8 +454,7 @@ MtxOrb_init (Driver *drvthis)
 	/* End of config file parsing */
 
 	/* Set up io port correctly, and open it... */
-	p->fd = open(device, O_RDWR | O_NOCTTY);
-	if (p->fd == -1) {
+	if (lib_serial_open(&p->serial, device, speed, 0) < 0) {
 		report(RPT_ERR, "%s: open(%s) failed (%s)", drvthis->name, device, strerror(errno));
 		if (errno == EACCES)
 			report(RPT_ERR, "%s: %s device could not be opened...", drvthis->name, device);
@@ -456,35 +462,6 @@ MtxOrb_init (Driver *drvthis)
 	}
 	report(RPT_INFO, "%s: opened display on %s", drvthis->name, device);
 
-	tcgetattr(p->fd, &portset);
-
-	/* We use RAW mode */
-#ifdef HAVE_CFMAKERAW
-	/* The easy way */
-	cfmakeraw(&portset);
-#else
-	/* The hard way */
-	portset.c_iflag &= ~( IGNBRK | BRKINT | PARMRK | ISTRIP
-			      | INLCR | IGNCR | ICRNL | IXON );
-	portset.c_oflag &= ~OPOST;
-	portset.c_lflag &= ~( ECHO | ECHONL | ICANON | ISIG | IEXTEN );
-	portset.c_cflag &= ~( CSIZE | PARENB | CRTSCTS );
-	portset.c_cflag |= CS8 | CREAD | CLOCAL;
-#endif
-	/* Set timeouts */
-	portset.c_cc[VMIN] = 1;
-	portset.c_cc[VTIME] = 3;
-
-	/* Set port speed */
-	cfsetospeed(&portset, speed);
-	cfsetispeed(&portset, B0);
-
-	/* Do it... */
-	if (tcsetattr(p->fd, TCSANOW, &portset) == -1) {
-		report(RPT_ERR, "%s: failed to configure port (%s)", drvthis->name, strerror(errno));
-		return -1;
-	}
-
 
 	/* Make sure the frame buffer is there... */
 	p->framebuf = (unsigned char *) calloc(p->width * p->height, 1);
@@ -507,6 +484,8 @@ MtxOrb_init (Driver *drvthis)
 	MtxOrb_linewrap(drvthis, DEFAULT_LINEWRAP);
 	MtxOrb_autoscroll(drvthis, DEFAULT_AUTOSCROLL);
 	MtxOrb_cursorblink(drvthis, DEFAULT_CURSORBLINK);
+	p->show_state = CURSOR_OFF;
+	p->cursor_shown = -1;
 	MtxOrb_set_contrast(drvthis, p->contrast);
 	MtxOrb_backlight(drvthis, DEFAULT_BACKLIGHT);
 	MtxOrb_get_info(drvthis);
@@ -528,8 +507,7 @@ MtxOrb_close (Driver *drvthis)
 	PrivateData *p = drvthis->private_data;
 
 	if (p != NULL) {
-		if (p->fd >= 0)
-			close(p->fd);
+		lib_serial_close(&p->serial);
 
 		if (p->framebuf)
 			free(p->framebuf);
@@ -667,51 +645,142 @@ MtxOrb_flush (Driver *drvthis)
 		/* set pointers to start of the line in frame buffer & backing store */
 		unsigned char *sp = p->framebuf + (i * p->width);
 		unsigned char *sq = p->backingstore + (i * p->width);
-
-		/* set pointers to end of the line in frame buffer & backing store */
-		unsigned char *ep = sp + (p->width - 1);
-		unsigned char *eq = sq + (p->width - 1);
-		int length = 0;
+		int start = -1;		/* first changed character of the run */
+		int same = 0;		/* unchanged characters since the last change */
 
 		debug(RPT_DEBUG, "Framebuf: '%.*s'", p->width, sp);
 		debug(RPT_DEBUG, "Backingstore: '%.*s'", p->width, sq);
 
 		/* Strategy:
-		 * - not more than one update command per line
-		 * - leave out leading and trailing parts that are identical
+		 * - send runs of changed characters, leaving out the
+		 *   identical parts around them
+		 * - start a new run only where repositioning the cursor
+		 *   costs less than resending the identical characters
 		 */
+		for (j = 0; j < p->width; j++) {
+			if (sp[j] != sq[j]) {
+				if (start < 0)
+					start = j;
+				else if (same > MTXORB_GOTO_COST) {
+					MtxOrb_send_text(drvthis, start, i, j - same - start);
+					start = j;
+				}
+				same = 0;
+				modified++;
+			}
+			else if (start >= 0)
+				same++;
+		}
+		if (start >= 0)
+			MtxOrb_send_text(drvthis, start, i, p->width - same - start);
+	}
 
-		/* skip over leading identical portions of the line */
-		for (j = 0; (sp <= ep) && (*sp == *sq); sp++, sq++, j++)
-			;
-
-		/* skip over trailing identical portions of the line */
-		for (length = p->width - j; (length > 0) && (*ep == *eq); ep--, eq--, length--)
-			;
+	if (modified)
+		memcpy(p->backingstore, p->framebuf, p->width * p->height);
+	MtxOrb_flush_cursor(drvthis);
+	lib_serial_flush(drvthis, &p->serial);
 
-		/* there are differences, ... */
-		if (length > 0) {
-			unsigned char out[length+2];
-			unsigned char *byte;
+	debug(RPT_DEBUG, "MtxOrb: frame buffer flushed");
+}
 
-			memcpy(out, sp, length);
-			/* replace command character \xFE by space */
-			while ((byte = memchr(out, '\xFE', length)) != NULL)
-				*byte = ' ';
 
-			debug(RPT_DEBUG, "%s: l=%d c=%d count=%d string='%.*s'",
-			      __FUNCTION__, i, j, length, length, sp);
+/**
+ * Send the parts of the frame buffer that changed to the LCD. The server
+ * core has already found them, so there is no need to compare the frame
+ * buffer to the backing store. Spans on one line that are closer than a
+ * cursor positioning command are sent as one.
+ * \param drvthis  Pointer to driver structure.
+ * \param spans    Parts of the display that changed.
+ * \param count    Number of spans.
+ */
+MODULE_EXPORT void
+MtxOrb_flush_spans (Driver *drvthis, const LCDSpan *spans, int count)
+{
+	PrivateData *p = drvthis->private_data;
+	int run_x = 0, run_y = -1, run_end = 0;	/* run not sent yet */
+	int i;
 
-			MtxOrb_cursor_goto(drvthis, j+1, i+1);
-			write(p->fd, out, length);
-			modified++;
+	for (i = 0; i < count; i++) {
+		int x = spans[i].x - 1;
+		int y = spans[i].y - 1;
+		int length = spans[i].len;
+
+		if ((x < 0) || (y < 0) || (y >= p->height) || (length <= 0))
+			continue;
+		if (x + length > p->width)
+			length = p->width - x;
+		if (length <= 0)
+			continue;
+
+		if ((y == run_y) && (x >= run_x) && (x - run_end <= MTXORB_GOTO_COST)) {
+			run_end = max(run_end, x + length);
+			continue;
 		}
+		if (run_y >= 0)
+			MtxOrb_send_text(drvthis, run_x, run_y, run_end - run_x);
+		run_x = x;
+		run_y = y;
+		run_end = x + length;
 	}
+	if (run_y >= 0)
+		MtxOrb_send_text(drvthis, run_x, run_y, run_end - run_x);
+	MtxOrb_flush_cursor(drvthis);
+	lib_serial_flush(drvthis, &p->serial);
 
-	if (modified)
-		memcpy(p->backingstore, p->framebuf, p->width * p->height);
+	debug(RPT_DEBUG, "MtxOrb: %d spans flushed", count);
+}
 
-	debug(RPT_DEBUG, "MtxOrb: frame buffer flushed");
+
+/**
+ * Send characters of the frame buffer to the LCD, moving the cursor there
+ * first unless the previous text ended there. The backing store is updated
+ * to match.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column), zero-based.
+ * \param y        Vertical character position (row), zero-based.
+ * \param length   Number of characters.
+ */
+static void
+MtxOrb_send_text(Driver *drvthis, int x, int y, int length)
+{
+	PrivateData *p = drvthis->private_data;
+	int offset = (y * p->width) + x;
+	unsigned char out[length];
+	unsigned char *byte;
+
+	memcpy(out, p->framebuf + offset, length);
+	/* replace command character \xFE by space */
+	while ((byte = memchr(out, '\xFE', length)) != NULL)
+		*byte = ' ';
+
+	debug(RPT_DEBUG, "%s: l=%d c=%d count=%d string='%.*s'",
+	      __FUNCTION__, y, x, length, length, out);
+
+	if ((p->cursor_x != x + 1) || (p->cursor_y != y + 1))
+		MtxOrb_cursor_goto(drvthis, x + 1, y + 1);
+	lib_serial_write(&p->serial, out, length);
+
+	/* where the cursor goes after the last column depends on line wrapping */
+	p->cursor_x = (x + length < p->width) ? x + length + 1 : 0;
+
+	/* keep the backing store valid for MtxOrb_flush() */
+	memcpy(p->backingstore + offset, p->framebuf + offset, length);
+}
+
+
+/**
+ * Move the cursor where it is shown after a flush, unless writing the
+ * text left it there.
+ * \param drvthis  Pointer to driver structure.
+ */
+static void
+MtxOrb_flush_cursor(Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	if ((p->show_state != CURSOR_OFF)
+	    && ((p->cursor_x != p->show_x) || (p->cursor_y != p->show_y)))
+		MtxOrb_cursor_goto(drvthis, p->show_x, p->show_y);
 }
 
 
@@ -782,7 +851,8 @@ MtxOrb_set_contrast (Driver *drvthis, int promille)
 		unsigned char out[4] = { '\xFE', 'P', 0 };
 
 		out[2] = (unsigned char) real_contrast;
-		write(p->fd, out, 3);
+		lib_serial_write(&p->serial, out, 3);
+		lib_serial_flush(drvthis, &p->serial);
 
 		report(RPT_DEBUG, "%s: contrast set to %d",
 				drvthis->name, real_contrast);
@@ -831,6 +901,7 @@ MtxOrb_set_brightness(Driver *drvthis, int state, int promille)
 		p->offbrightness = promille;
 	}
 	MtxOrb_backlight(drvthis, state);
+	lib_serial_flush(drvthis, &p->serial);
 }
 
 
@@ -856,7 +927,7 @@ MtxOrb_backlight (Driver *drvthis, int on)
 			/* map range [0, 1000] -> [0, 3] that the hardware understands */
 			out[2] = (unsigned char) ((long) promille * 3 / 1000);
 
-			write(p->fd, out, 3);
+			lib_serial_write(&p->serial, out, 3);
 		}
 		else {
 			unsigned char out[5] = { '\xFE', '\x99', 0 };
@@ -864,7 +935,7 @@ MtxOrb_backlight (Driver *drvthis, int on)
 			/* map range [0, 1000] -> [0, 255] that the hardware understands */
 			out[2] = (unsigned char) ((long) promille * 255 / 1000);
 
-			write(p->fd, out, 3);
+			lib_serial_write(&p->serial, out, 3);
 		}
 
 		debug(RPT_DEBUG, "MtxOrb: changed brightness to %d", promille);
@@ -872,11 +943,11 @@ MtxOrb_backlight (Driver *drvthis, int on)
 	else {
 		if (on == BACKLIGHT_ON) {
 			unsigned char out[4] = { '\xFE', 'B', '\0', 0};
-			write(p->fd, out, 3);
+			lib_serial_write(&p->serial, out, 3);
 		}
 		else {
 			unsigned char out[4] = { '\xFE', 'F', 0};
-			write(p->fd, out, 2);
+			lib_serial_write(&p->serial, out, 2);
 		}
 	}
 }
@@ -903,7 +974,7 @@ MtxOrb_output (Driver *drvthis, int state)
 	if (IS_LCD_DISPLAY || IS_VFD_DISPLAY) {
 		/* LCD and VFD displays only have one output port */
 		out[1] = (state) ? 'W' : 'V';
-		write(p->fd, out, 2);
+		lib_serial_write(&p->serial, out, 2);
 	}
 	else {
 		int i;
@@ -915,7 +986,7 @@ MtxOrb_output (Driver *drvthis, int state)
 		for (i = 0; i < 6; i++) {
 			out[1] = (state & (1 << i)) ? 'W' : 'V';
 			out[2] = i+1;
-			write(p->fd, out, 3);
+			lib_serial_write(&p->serial, out, 3);
 		}
 	}
 }
@@ -930,7 +1001,8 @@ MtxOrb_hardware_clear (Driver *drvthis)
 {
 	PrivateData *p = drvthis->private_data;
 
-	write(p->fd, "\xFE" "X", 2);
+	lib_serial_write(&p->serial, "\xFE" "X", 2);
+	p->cursor_x = p->cursor_y = 0;
 
 	debug(RPT_DEBUG, "MtxOrb: cleared LCD");
 }
@@ -948,7 +1020,7 @@ MtxOrb_linewrap (Driver *drvthis, int on)
 	unsigned char out[3] = { '\xFE', 0 };
 
 	out[1] = (on) ? 'C' : 'D';
-	write(p->fd, out, 2);
+	lib_serial_write(&p->serial, out, 2);
 
 	debug(RPT_DEBUG, "MtxOrb: linewrap turned %s", (on) ? "on" : "off");
 }
@@ -966,7 +1038,7 @@ MtxOrb_autoscroll (Driver *drvthis, int on)
 	unsigned char out[3] = { '\xFE', 0 };
 
 	out[1] = (on) ? 'Q' : 'R';
-	write(p->fd, out, 2);
+	lib_serial_write(&p->serial, out, 2);
 
 	debug(RPT_DEBUG, "MtxOrb: autoscroll turned %s", (on) ? "on" : "off");
 }
@@ -986,7 +1058,7 @@ MtxOrb_cursorblink (Driver *drvthis, int on)
 	unsigned char out[3] = { '\xFE', 0 };
 
 	out[1] = (on) ? 'S' : 'T';
-	write(p->fd, out, 2);
+	lib_serial_write(&p->serial, out, 2);
 
 	debug(RPT_DEBUG, "MtxOrb: cursorblink turned %s", (on) ? "on" : "off");
 }
@@ -1009,7 +1081,9 @@ MtxOrb_cursor_goto(Driver *drvthis, int x, int y)
 		out[2] = (unsigned char) x;
 	if ((y > 0) && (y <= p->height))
 		out[3] = (unsigned char) y;
-	write(p->fd, out, 4);
+	lib_serial_write(&p->serial, out, 4);
+	p->cursor_x = out[2];
+	p->cursor_y = out[3];
 }
 
 
@@ -1038,23 +1112,24 @@ MtxOrb_get_info (Driver *drvthis)
 
 	/* Watch fd to see when it has input. */
 	FD_ZERO(&rfds);
-	FD_SET(p->fd, &rfds);
+	FD_SET(p->serial.fd, &rfds);
 
 	/*
 	 * Read type of display
 	 * In query for its type, the display return a single byte value.
 	 */
 	memset(tmp, '\0', sizeof(tmp));
-	write(p->fd, "\x0FE" "7", 2);
+	lib_serial_write(&p->serial, "\x0FE" "7", 2);
+	lib_serial_flush(NULL, &p->serial);
 
 	/* Wait the specified amount of time for the module to return display type */
 	tv.tv_sec = 0;		/* seconds */
 	tv.tv_usec = 40000;	/* microseconds */
 
-	retval = select(p->fd+1, &rfds, NULL, NULL, &tv);
+	retval = select(p->serial.fd+1, &rfds, NULL, NULL, &tv);
 
 	if (retval) {
-		if (read(p->fd, &tmp, 1) < 0)
+		if (read(p->serial.fd, &tmp, 1) < 0)
 			report(RPT_WARNING, "%s: unable to read data", drvthis->name);
 		else {
 			for (i = 0; modulelist[i].model != 0; i++) {
@@ -1081,16 +1156,17 @@ MtxOrb_get_info (Driver *drvthis)
 	 * NOTE: The manual doesn't describe the format of the returned byte
 	 */
 	memset(tmp, '\0', sizeof(tmp));
-	write(p->fd, "\x0FE" "6", 2);
+	lib_serial_write(&p->serial, "\x0FE" "6", 2);
+	lib_serial_flush(NULL, &p->serial);
 
 	/* Wait the specified amount of time for the module return firmware revision number */
 	tv.tv_sec = 0;		/* seconds */
 	tv.tv_usec = 25000;	/* microseconds */
 
-	retval = select(p->fd+1, &rfds, NULL, NULL, &tv);
+	retval = select(p->serial.fd+1, &rfds, NULL, NULL, &tv);
 
 	if (retval) {
-		if (read(p->fd, &tmp, 1) < 0)
+		if (read(p->serial.fd, &tmp, 1) < 0)
 			report(RPT_WARNING, "%s: unable to read data", drvthis->name);
 
 	}
@@ -1110,16 +1186,17 @@ MtxOrb_get_info (Driver *drvthis)
 	 * have to be supplied, so it is likely the display will return those.
 	 */
 	memset(tmp, '\0', sizeof(tmp));
-	write(p->fd, "\x0FE" "5", 2);
+	lib_serial_write(&p->serial, "\x0FE" "5", 2);
+	lib_serial_flush(NULL, &p->serial);
 
 	/* Wait the specified amount of time. */
 	tv.tv_sec = 0;		/* seconds */
 	tv.tv_usec = 25000;	/* microseconds */
 
-	retval = select(p->fd+1, &rfds, NULL, NULL, &tv);
+	retval = select(p->serial.fd+1, &rfds, NULL, NULL, &tv);
 
 	if (retval) {
-		if (read(p->fd, &tmp, 2) < 0)
+		if (read(p->serial.fd, &tmp, 2) < 0)
 			report(RPT_WARNING, "%s: unable to read data", drvthis->name);
 	}
 	else
@@ -1282,7 +1359,13 @@ MtxOrb_set_char (Driver *drvthis, int n, unsigned char *dat)
 	for (row = 0; row < p->cellheight; row++) {
 		out[row+3] = dat[row] & mask;
 	}
-	write(p->fd, out, 11);
+	/* skip definitions the display already has, e.g. for big numbers */
+	if (lib_cc_resident(&p->charcache, n, out + 3))
+		return;
+	lib_serial_write(&p->serial, out, 11);
+	drvthis->count_io(drvthis, IO_CGRAM, 1);
+	/* do not rely on the cursor position after writing CGRAM */
+	p->cursor_x = p->cursor_y = 0;
 }
 
 
@@ -1477,22 +1560,18 @@ MODULE_EXPORT void
 MtxOrb_cursor (Driver *drvthis, int x, int y, int state)
 {
 	PrivateData *p = (PrivateData *) drvthis->private_data;
+	int on = (state != CURSOR_OFF);
 
-	/* set cursor state */
-	switch (state) {
-		case CURSOR_OFF:	/* no cursor */
-			write(p->fd, "\xFE" "K", 2);
-			break;
-		case CURSOR_UNDER:	/* underline cursor */
-		case CURSOR_BLOCK:	/* inverting blinking block */
-		case CURSOR_DEFAULT_ON:	/* blinking block */
-		default:
-			write(p->fd, "\xFE" "J", 2);
-			break;
+	/* set cursor state; all states but off show the underline */
+	if (on != p->cursor_shown) {
+		lib_serial_write(&p->serial, (on) ? "\xFE" "J" : "\xFE" "K", 2);
+		p->cursor_shown = on;
 	}
 
-	/* set cursor position */
-	 MtxOrb_cursor_goto(drvthis, x, y);
+	/* the position is set by the next flush, after the text */
+	p->show_state = state;
+	p->show_x = x;
+	p->show_y = y;
 }
 
 
@@ -1514,14 +1593,14 @@ MtxOrb_get_key (Driver *drvthis)
 		return NULL;
 
 	/* poll for data or return */
-	fds[0].fd = p->fd;
+	fds[0].fd = p->serial.fd;
 	fds[0].events = POLLIN;
 	fds[0].revents = 0;
 	poll(fds,1,0);
 	if (fds[0].revents == 0)
 		return NULL;
 
-	(void) read(p->fd, &key, 1);
+	(void) read(p->serial.fd, &key, 1);
 	report(RPT_DEBUG, "%s: get_key: key 0x%02X", drvthis->name, key);
 
 	if (key == '\0')
@@ -61,6 +61,7 @@
 
 #include "lcd.h"
 #include "NoritakeVFD.h"
+#include "serial_lib.h"
 #include "shared/report.h"
 #include "adv_bignum.h"
 
@@ -71,7 +72,7 @@
 /** private data for the \c NoritakeVFD driver */
 typedef struct NoritakeVFD_private_data {
 	char device[200];
-	int fd;
+	SerialPort serial;
 	int speed;
 	int parity;
 	/* dimensions */
@@ -109,7 +110,6 @@ static void NoritakeVFD_cursor_goto (Driver *drvthis, int x, int y);
 MODULE_EXPORT int
 NoritakeVFD_init (Driver *drvthis)
 {
-	struct termios portset;
 	int tmp, w, h;
 	int reboot = 0;
 	char size[200] = DEFAULT_SIZE;
@@ -124,7 +124,7 @@ NoritakeVFD_init (Driver *drvthis)
 		return -1;
 
 	/* Initialize the PrivateData structure */
-	p->fd = -1;
+	p->serial.fd = -1;
 	p->cellwidth = DEFAULT_CELL_WIDTH;
 	p->cellheight = DEFAULT_CELL_HEIGHT;
 	p->ccmode = standard;
@@ -176,11 +176,7 @@ NoritakeVFD_init (Driver *drvthis)
 			drvthis->name, DEFAULT_SPEED);
 		tmp = DEFAULT_SPEED;
 	}
-	if (tmp == 1200) p->speed = B1200;
-	else if (tmp == 2400) p->speed = B2400;
-	else if (tmp == 9600) p->speed = B9600;
-	else if (tmp == 19200) p->speed = B19200;
-	else if (tmp == 115200) p->speed = B115200;
+	p->speed = tmp;
 
 	/* Which parity */
 	tmp = drvthis->config_get_int(drvthis->name, "Parity", 0, DEFAULT_PARITY);
@@ -190,7 +186,7 @@ NoritakeVFD_init (Driver *drvthis)
 		tmp = DEFAULT_PARITY;
 	}
 	if (tmp != 0)
-		p->parity = (tmp & 1) ? (PARENB | PARODD) : PARENB;
+		p->parity = (tmp & 1) ? LIB_SERIAL_PARITY_ODD : LIB_SERIAL_PARITY_EVEN;
 
 
 	/* Reboot display? */
@@ -198,39 +194,11 @@ NoritakeVFD_init (Driver *drvthis)
 
 	/* Set up io port correctly, and open it...*/
 	debug(RPT_DEBUG, "%s: Opening device: %s", __FUNCTION__, p->device);
-	p->fd = open(p->device, O_RDWR | O_NOCTTY | O_NDELAY);
-
-	if (p->fd == -1) {
+	if (lib_serial_open(&p->serial, p->device, p->speed, p->parity) < 0) {
 		report(RPT_ERR, "%s: open() of %s failed (%s)", drvthis->name, p->device, strerror(errno));
 		return -1;
 	}
 
-	tcgetattr(p->fd, &portset);
-
-	// We use RAW mode (with varying parity)
-#ifdef HAVE_CFMAKERAW
-	// The easy way
-	cfmakeraw(&portset);
-	// set parity the way we want it
-	portset.c_cflag &= ~(PARENB | PARODD);
-	portset.c_cflag |= p->parity;
-#else
-	// The hard way
-	portset.c_iflag &= ~( IGNBRK | BRKINT | PARMRK | ISTRIP
-   	                   | INLCR | IGNCR | ICRNL | IXON );
-	portset.c_oflag &= ~OPOST;
-	portset.c_lflag &= ~( ECHO | ECHONL | ICANON | ISIG | IEXTEN );
-	portset.c_cflag &= ~( CSIZE | PARENB | CRTSCTS );
-	portset.c_cflag |= CS8 | CREAD | CLOCAL | p->parity;
-#endif
-
-	// Set port speed
-	cfsetospeed(&portset, p->speed);
-	cfsetispeed(&portset, B0);
-
-	// Do it...
-	tcsetattr(p->fd, TCSANOW, &portset);
-
 	/* make sure the frame buffer is there... */
 	p->framebuf = (unsigned char *) malloc(p->width * p->height);
 	if (p->framebuf == NULL) {
@@ -251,6 +219,7 @@ NoritakeVFD_init (Driver *drvthis)
 	/* Set display-specific stuff..*/
 	if (reboot) {
 		NoritakeVFD_reboot(drvthis);
+		lib_serial_flush(NULL, &p->serial);
 		sleep(4);
 	}
 	NoritakeVFD_hidecursor(drvthis);
@@ -273,8 +242,7 @@ NoritakeVFD_close (Driver *drvthis)
 {
 	PrivateData *p = drvthis->private_data;
 	if (p != NULL) {
-		if (p->fd >= 0)
-			close(p->fd);
+		lib_serial_close(&p->serial);
 
 		if (p->framebuf)
 			free(p->framebuf);
@@ -362,9 +330,12 @@ NoritakeVFD_flush (Driver *drvthis)
 			memcpy(p->backingstore+offset, p->framebuf+offset, p->width);
 
 			NoritakeVFD_cursor_goto(drvthis, 1, i+1);
-			write(p->fd, p->framebuf+offset, p->width);
+			lib_serial_write(&p->serial, p->framebuf+offset, p->width);
 		}
 	}
+
+	/* all at once, and the server knows how long the line is busy */
+	lib_serial_flush(drvthis, &p->serial);
 }
 
 
@@ -656,7 +627,7 @@ NoritakeVFD_cursor (Driver *drvthis, int x, int y, int state)
 			out[0] = 0x15;
 			break;
 	}
-	write(p->fd, out, 1);
+	lib_serial_write(&p->serial, out, 1);
 
 	NoritakeVFD_cursor_goto(drvthis, x, y);
 }
@@ -704,7 +675,7 @@ NoritakeVFD_set_char (Driver *drvthis, int n, unsigned char *dat)
 		out[3 + i/8] |= ((dat[i/5] >> (4 - i%5)) & 1) << i%8;
 	}
 
-	write(p->fd, out, 8);
+	lib_serial_write(&p->serial, out, 8);
 }
 
 
@@ -746,6 +717,7 @@ NoritakeVFD_set_brightness(Driver *drvthis, int state, int promille)
 		p->offbrightness = promille;
 	}
 	NoritakeVFD_backlight(drvthis, state);
+	lib_serial_flush(drvthis, &p->serial);
 }
 
 
@@ -767,7 +739,7 @@ NoritakeVFD_backlight (Driver *drvthis, int on)
 	/* not sure if the formula is correct:
 	 * What is the allowed range for the brightness value ? */
 	out[2] = (int) (hardware_value * 255 / 1000);
-	write(p->fd, out, 3);
+	lib_serial_write(&p->serial, out, 3);
 }
 
 
@@ -783,7 +755,7 @@ NoritakeVFD_autoscroll (Driver *drvthis, int on)
 	char out[2];
 
 	out[0] = (on) ? 0x12 : 0x11;
-	write(p->fd, out, 1);
+	lib_serial_write(&p->serial, out, 1);
 }
 
 
@@ -797,7 +769,7 @@ NoritakeVFD_hidecursor (Driver *drvthis)
 	PrivateData *p = drvthis->private_data;
 	char out[2] = { 0x16 };
 
-	write(p->fd, out, 1);
+	lib_serial_write(&p->serial, out, 1);
 }
 
 
@@ -813,10 +785,10 @@ NoritakeVFD_reboot (Driver *drvthis)
 	char flickerless_out[3] = { 0x1B, 0x53 };
 
 	/* reset display */
-	write(p->fd, reset_out, 2);
+	lib_serial_write(&p->serial, reset_out, 2);
 
 	/* switch on flickerless write */
-	write(p->fd, flickerless_out, 2);
+	lib_serial_write(&p->serial, flickerless_out, 2);
 }
 
 
@@ -835,7 +807,7 @@ NoritakeVFD_cursor_goto(Driver *drvthis, int x, int y)
 	/* set cursor position */
 	if ((x > 0) && (x <= p->width) && (y > 0) && (y <= p->height))
 		out[2] = (y-1) * p->width + (x-1);
-	write(p->fd, out, 3);
+	lib_serial_write(&p->serial, out, 3);
 }
 
 
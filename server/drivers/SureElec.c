@@ -40,8 +40,6 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/time.h>
-#include <termios.h>
-#include <fcntl.h>
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
@@ -53,6 +51,7 @@
 #include "lcd.h"
 #include "lcd_lib.h"
 #include "SureElec.h"
+#include "serial_lib.h"
 #include "adv_bignum.h"
 
 #include "shared/report.h"
@@ -72,7 +71,7 @@ typedef enum {
 
 /** private data for the \c SureElec driver */
 typedef struct SureElec_private_data {
-	int fd;			/* Serial port file descriptor */
+	SerialPort serial;	/* Serial port */
 
 	int width, height;	/* Screen size */
 	int cellwidth, cellheight;	/* Cell size */
@@ -83,6 +82,7 @@ typedef struct SureElec_private_data {
 
 	/* definable characters */
 	CGmode ccmode;
+	CharCache charcache;	/**< glyphs the custom characters show */
 
 	int output_state;	/**< current output state */
 	int contrast;		/**< current contrast */
@@ -129,12 +129,13 @@ SureElec_init(Driver * drvthis)
 		return -1;
 
 	/* Initialise the PrivateData structure */
-	p->fd = -1;
+	p->serial.fd = -1;
 	p->edition = SURE_ELEC_EDITION2;	/* Assume an edition 2
 						 * version */
 
 	p->cellwidth = CELL_WIDTH;
 	p->cellheight = CELL_HEIGHT;
+	lib_cc_init(&p->charcache, NUM_CC, p->cellheight);
 
 	p->framebuf = NULL;
 	p->backingstore = NULL;
@@ -269,8 +270,7 @@ SureElec_close(Driver * drvthis)
 	PrivateData *p = drvthis->private_data;
 
 	if (p != NULL) {
-		if (p->fd >= 0)
-			close(p->fd);
+		lib_serial_close(&p->serial);
 
 		/* Free allocated framebuffers */
 		if (p->framebuf)
@@ -413,17 +413,13 @@ SureElec_flush(Driver * drvthis)
 {
 	PrivateData *p = drvthis->private_data;
 	int modified = 0;
-	int i, j;
+	int i;
 	unsigned char cmd[4] = {'\xFE', '\x47', '\x01', /* line */ 0};
 
 	for (i = 0; i < p->height; i++) {
 		/* Check if line content changed */
-		for (j = 0; j < p->width && p->framebuf[p->width * i + j] ==
-		     p->backingstore[p->width * i + j]; j++) {
-			;
-		}
-
-		if (j < p->width) {
+		if (lib_diff_first(p->framebuf + p->width * i,
+				   p->backingstore + p->width * i, p->width) >= 0) {
 			/*
 			 * Line content has been changed, need to output the
 			 * line on screen
@@ -441,6 +437,7 @@ SureElec_flush(Driver * drvthis)
 		/* If something changed on screen, update the backingstore */
 		memcpy(p->backingstore, p->framebuf, p->width * p->height);
 	}
+	lib_serial_flush(drvthis, &p->serial);
 	debug(RPT_DEBUG, "SureElec: frame buffer flushed");
 }
 
@@ -485,6 +482,7 @@ SureElec_set_contrast(Driver * drvthis, int promille)
 	cmd[2] = real_contrast;
 
 	write_(drvthis, cmd, sizeof(cmd));
+	lib_serial_flush(drvthis, &p->serial);
 }
 
 /**
@@ -714,6 +712,9 @@ SureElec_set_char(Driver * drvthis, int n, unsigned char *dat)
 	for (row = 0; row < p->cellheight; row++) {
 		cmd[row + 3] = dat[row] & mask;
 	}
+	/* skip definitions the display already has, e.g. for big numbers */
+	if (lib_cc_resident(&p->charcache, n, cmd + 3))
+		return;
 	write_(drvthis, cmd, sizeof(cmd));
 }
 
@@ -877,15 +878,12 @@ static int
 open_port(Driver * drvthis, const char *device)
 {
 	PrivateData *p = drvthis->private_data;
-	struct termios portset;
-
 	unsigned char cmd[3] = {'\xFE', '\x56', 0};
 	unsigned char init_seq[7] = {'\x54', '\x58', '\x4B', '\x52', '\x44', '\x41', '\x60'};
 	int i;
 
 	/* Set up io port correctly, and open it... */
-	p->fd = open(device, O_RDWR | O_NOCTTY);
-	if (p->fd == -1) {
+	if (lib_serial_open(&p->serial, device, 9600, 0) < 0) {
 		report(RPT_ERR, "%s: open(%s) failed (%s)", drvthis->name, device, strerror(errno));
 		if (errno == EACCES)
 			report(RPT_ERR, "%s: %s device could not be opened", drvthis->name, device);
@@ -893,35 +891,6 @@ open_port(Driver * drvthis, const char *device)
 	}
 	report(RPT_INFO, "%s: opened display on %s", drvthis->name, device);
 
-	tcgetattr(p->fd, &portset);
-
-	/* We use RAW mode */
-#ifdef HAVE_CFMAKERAW
-	/* The easy way */
-	cfmakeraw(&portset);
-#else
-	/* The hard way */
-	portset.c_iflag &= ~( IGNBRK | BRKINT | PARMRK | ISTRIP
-			      | INLCR | IGNCR | ICRNL | IXON );
-	portset.c_oflag &= ~OPOST;
-	portset.c_lflag &= ~( ECHO | ECHONL | ICANON | ISIG | IEXTEN );
-	portset.c_cflag &= ~( CSIZE | PARENB | CRTSCTS );
-	portset.c_cflag |= CS8 | CREAD | CLOCAL;
-#endif
-	/* Set timeouts */
-	portset.c_cc[VMIN] = 1;
-	portset.c_cc[VTIME] = 3;
-
-	/* Set port speed */
-	cfsetospeed(&portset, B9600);
-	cfsetispeed(&portset, B0);
-
-	/* Do it... */
-	if (tcsetattr(p->fd, TCSANOW, &portset) == -1) {
-		report(RPT_ERR, "%s: failed to configure port (%s)", drvthis->name, strerror(errno));
-		return -1;
-	}
-
 	/* Send initialization sequence */
 	for (i = 1; i <= 8; i++) {
 		cmd[2] = i;
@@ -959,7 +928,8 @@ get_device_screen_size(Driver * drvthis, int *width, int *height)
 }
 
 /**
- * Writes count bytes from a buffer to the device.
+ * Queues count bytes from a buffer for the device. They are sent by the
+ * next lib_serial_flush().
  * \param drvthis  Pointer to driver structure
  * \param buf      Pointer to the buffer
  * \param count    Number of bytes to write
@@ -968,18 +938,14 @@ get_device_screen_size(Driver * drvthis, int *width, int *height)
 static int
 write_(Driver * drvthis, const unsigned char *buf, size_t count)
 {
-	int write_count = 0, written;
 	PrivateData *p = drvthis->private_data;
 
-	while (write_count < count) {
-		written = write(p->fd, &buf[write_count], count - write_count);
-		if (written == -1) {
-			report(RPT_ERR, "SureElec: cannot write to port");
-			return -1;
-		}
-		write_count += written;
+	if (p->serial.fd < 0) {
+		report(RPT_ERR, "SureElec: cannot write to port");
+		return -1;
 	}
-	return write_count;
+	lib_serial_write(&p->serial, buf, count);
+	return count;
 }
 
 /**
@@ -997,9 +963,13 @@ read_(Driver * drvthis, void *buf, size_t count)
 	PrivateData *p = drvthis->private_data;
 	int read_count;
 
+	/* the device answers what it has been sent */
+	if (lib_serial_flush(NULL, &p->serial) < 0)
+		return -1;
+
 	/* Watch fd to see when it has input. */
 	FD_ZERO(&rfds);
-	FD_SET(p->fd, &rfds);
+	FD_SET(p->serial.fd, &rfds);
 
 	read_count = 0;
 	while (read_count < count) {
@@ -1012,9 +982,9 @@ read_(Driver * drvthis, void *buf, size_t count)
 		tv.tv_sec = 1;	/* seconds */
 		tv.tv_usec = 0;	/* microseconds */
 
-		retval = select(p->fd + 1, &rfds, NULL, NULL, &tv);
+		retval = select(p->serial.fd + 1, &rfds, NULL, NULL, &tv);
 		if (retval) {
-			int read_result = read(p->fd, ((char *)buf) + read_count, count - read_count);
+			int read_result = read(p->serial.fd, ((char *)buf) + read_count, count - read_count);
 			if (read_result < 0) {
 				return -1;
 			} else {
@@ -12,7 +12,6 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <termios.h>
-#include <fcntl.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/types.h>
@@ -34,6 +33,7 @@
 #endif
 #include "lcd.h"
 #include "bayrad.h"
+#include "serial_lib.h"
 #include "shared/report.h"
 #include "lcd_lib.h"
 
@@ -46,7 +46,7 @@
 typedef struct bayrad_private_data {
   char device[256];
   int speed;
-  int fd;
+  SerialPort serial;
   int width;
   int height;
   int cellwidth;
@@ -73,7 +73,6 @@ MODULE_EXPORT int
 bayrad_init(Driver *drvthis)
 {
   PrivateData *p;
-  struct termios portset;
 
   /* Allocate and store private data */
   p = (PrivateData *) calloc(1, sizeof(PrivateData));
@@ -83,8 +82,8 @@ bayrad_init(Driver *drvthis)
     return -1;
 
   /* initialize private data */
-  p->fd = -1;
-  p->speed = B9600;
+  p->serial.fd = -1;
+  p->speed = 9600;
   p->width = 20;
   p->height = 2;
   p->cellwidth = 5;
@@ -104,51 +103,21 @@ bayrad_init(Driver *drvthis)
   /* What speed to use */
   p->speed = drvthis->config_get_int(drvthis->name, "Speed", 0, 9600);
 
-  if (p->speed == 1200)       p->speed = B1200;
-  else if (p->speed == 2400)  p->speed = B2400;
-  else if (p->speed == 9600)  p->speed = B9600;
-  else if (p->speed == 19200) p->speed = B19200;
-  else {
+  if ((p->speed != 1200) && (p->speed != 2400) && (p->speed != 9600) && (p->speed != 19200)) {
     report(RPT_WARNING, "%s: illegal Speed %d; must be one of 1200, 2400, 9600 or 19200; using default %d",
 		    drvthis->name, p->speed, 9600);
-    p->speed = B9600;
+    p->speed = 9600;
   }
 
   // Set up io port correctly, and open it...
-  p->fd = open(p->device, O_RDWR | O_NOCTTY | O_NDELAY);
-  if (p->fd == -1) {
+  if (lib_serial_open(&p->serial, p->device, p->speed, 0) < 0) {
     report(RPT_ERR, "%s: open(%s) failed (%s)", drvthis->name, p->device, strerror(errno));
     return -1;
   }
 
   //debug(RPT_DEBUG, "bayrad_init: opened device %s", device);
 
-  tcflush(p->fd, TCIOFLUSH);
-
-  // We use RAW mode
-#ifdef HAVE_CFMAKERAW
-  // The easy way
-  cfmakeraw(&portset);
-#else
-  // The hard way
-  portset.c_iflag &= ~( IGNBRK | BRKINT | PARMRK | ISTRIP
-                        | INLCR | IGNCR | ICRNL | IXON );
-  portset.c_oflag &= ~OPOST;
-  portset.c_lflag &= ~( ECHO | ECHONL | ICANON | ISIG | IEXTEN );
-  portset.c_cflag &= ~( CSIZE | PARENB | CRTSCTS );
-  portset.c_cflag |= CS8 | CREAD | CLOCAL ;
-#endif
-
-  portset.c_cc[VTIME] = 0;  // Don't use the timer, no workee
-  portset.c_cc[VMIN] = 1;  // Need at least 1 char
-
-  // Set port speed
-  cfsetospeed(&portset, B9600);
-  cfsetispeed(&portset, B0);
-
-  // Do it...
-  tcsetattr(p->fd, TCSANOW, &portset);
-  tcflush(p->fd, TCIOFLUSH);
+  tcflush(p->serial.fd, TCIOFLUSH);
 
   /*------------------------------------*/
 
@@ -163,7 +132,8 @@ bayrad_init(Driver *drvthis)
   /*** Open the port write-only, then fork off a process that reads chars ?!!? ***/
 
   /* Reset and clear the BayRAD */
-  write(p->fd, "\x80\x86\x00\x1a\x1e", 5);  // sync,reset to type 0, clear screen, home
+  lib_serial_write(&p->serial, "\x80\x86\x00\x1a\x1e", 5);  // sync,reset to type 0, clear screen, home
+  lib_serial_flush(drvthis, &p->serial);
 
   report(RPT_DEBUG, "%s: init() done", drvthis->name);
 
@@ -182,10 +152,8 @@ bayrad_close(Driver *drvthis)
 
   //debug(RPT_DEBUG, "Closing BayRAD");
   if (p != NULL) {
-    if (p->fd >= 0) {
-      write(p->fd, "\x8e\x00", 2);  // Backlight OFF
-      close(p->fd);
-    }
+    lib_serial_write(&p->serial, "\x8e\x00", 2);  // Backlight OFF
+    lib_serial_close(&p->serial);
 
     if (p->framebuf != NULL)
       free(p->framebuf);
@@ -276,10 +244,11 @@ bayrad_flush(Driver *drvthis)
   PrivateData *p = drvthis->private_data;
 
   //debug(RPT_DEBUG, "BayRAD flush");
-  write(p->fd, "\x80\x1e", 2);  //sync, home
-  write(p->fd, p->framebuf, 20);
-  write(p->fd, "\x1e\x0a", 2);  //home, LF
-  write(p->fd, p->framebuf+20, 20);
+  lib_serial_write(&p->serial, "\x80\x1e", 2);  //sync, home
+  lib_serial_write(&p->serial, p->framebuf, 20);
+  lib_serial_write(&p->serial, "\x1e\x0a", 2);  //home, LF
+  lib_serial_write(&p->serial, p->framebuf+20, 20);
+  lib_serial_flush(drvthis, &p->serial);
 }
 
 
@@ -366,10 +335,10 @@ bayrad_backlight(Driver *drvthis, int on)
   debug(RPT_DEBUG, "Backlight %s", (on) ? "ON" : "OFF");
 
   if (on) {
-    write(p->fd, "\x8e\x0f", 2);
+    lib_serial_write(&p->serial, "\x8e\x0f", 2);
   }
   else {
-    write(p->fd, "\x8e\x00", 2);
+    lib_serial_write(&p->serial, "\x8e\x00", 2);
   }
 }
 
@@ -399,15 +368,15 @@ bayrad_set_char(Driver *drvthis, int n, unsigned char *dat)
 
   /* Set the LCD to accept data for rewrite-able char n */
   snprintf(out, sizeof(out), "\x88%c", 0x40 + (n * 8));
-  write(p->fd, out, 2);
+  lib_serial_write(&p->serial, out, 2);
 
   for (row = 0; row < p->cellheight; row++) {
     char letter = dat[row] & mask;
-    write(p->fd, &letter, 1);
+    lib_serial_write(&p->serial, &letter, 1);
   }
 
   /* return the LCD to normal operation */
-  write(p->fd, "\x80", 1);
+  lib_serial_write(&p->serial, "\x80", 1);
 }
 
 
@@ -537,14 +506,14 @@ bayrad_get_key(Driver *drvthis)
   /* Check for incoming data.  Turn backlight ON/OFF as needed */
 
   FD_ZERO(&brfdset);
-  FD_SET(p->fd, &brfdset);
+  FD_SET(p->serial.fd, &brfdset);
 
   twait.tv_sec = 0;
   twait.tv_usec = 0;
 
-  if (select(p->fd + 1, &brfdset, NULL, NULL, &twait)) {
+  if (select(p->serial.fd + 1, &brfdset, NULL, NULL, &twait)) {
     char ch;
-    int retval = read(p->fd, &ch, 1);
+    int retval = read(p->serial.fd, &ch, 1);
 
     if (retval > 0) {	/* read() succeeded and returned data */
       debug(RPT_INFO, "bayrad_get_key: Got key: %c", ch);
@@ -0,0 +1,784 @@
+/** \file server/drivers/bench.c
+ * LCDd \c bench driver for measuring the server core.
+ * It drives no hardware and prints nothing while running. Instead it counts
+ * the calls of each driver function and the time the core takes to hand a
+ * frame to the driver, and reports a summary when it is closed. Bars, big
+ * numbers, icons and custom characters are drawn into a frame buffer like a
+ * real character display does, so rendering and parsing changes can be
+ * benchmarked with the full driver API in the loop and no device behind it.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "lcd.h"
+#include "lcd_lib.h"
+#include "bench.h"
+#include "adv_bignum.h"
+#include "shared/report.h"
+
+
+#define BENCH_CELLWIDTH		LCD_DEFAULT_CELLWIDTH
+#define BENCH_CELLHEIGHT	LCD_DEFAULT_CELLHEIGHT
+#define BENCH_CUSTOM_CHARS	8
+#define BENCH_DEF_CONTRAST	500
+#define BENCH_DEF_BRIGHTNESS	750
+#define BENCH_DEF_OFFBRIGHTNESS	250
+
+/** Driver functions whose calls are counted */
+enum bench_func {
+	BF_CLEAR, BF_FLUSH, BF_FLUSH_SPANS, BF_STRING, BF_CHR, BF_BLIT_TEXT,
+	BF_SCROLL_TEXT, BF_VBAR, BF_HBAR, BF_NUM, BF_ICON, BF_CURSOR, BF_SET_CHAR,
+	BF_BACKLIGHT, BF_OUTPUT, BF_GET_KEY, BF_QUERY,
+	BF_COUNT
+};
+
+/** Names of the counted functions, by enum bench_func */
+static const char *bench_func_names[BF_COUNT] = {
+	"clear", "flush", "flush_spans", "string", "chr", "blit_text",
+	"scroll_text", "vbar", "hbar", "num", "icon", "cursor", "set_char",
+	"backlight", "output", "get_key", "queries"
+};
+
+/** private data for the \c bench driver */
+typedef struct bench_private_data {
+	int width;		/**< display width in characters */
+	int height;		/**< display height in characters */
+	char *framebuf;		/**< frame buffer */
+	char *backingstore;	/**< frame buffer content at the last flush */
+	CGmode ccmode;		/**< custom character mode in use */
+	unsigned char cc[BENCH_CUSTOM_CHARS][BENCH_CELLHEIGHT];	/**< custom characters */
+	int contrast;		/**< current contrast */
+	int brightness;		/**< current brightness (for backlight on) */
+	int offbrightness;	/**< current brightness (for backlight off) */
+
+	unsigned long calls[BF_COUNT];	/**< calls by enum bench_func */
+	int in_frame;			/**< output has started since the last flush */
+	unsigned long frame_start;	/**< time of the first output of the frame */
+	unsigned long last_flush;	/**< time of the last flush, 0 before the first */
+	unsigned long frames;		/**< frames flushed */
+	unsigned long long frame_sum;	/**< sum of the frame times */
+	unsigned long frame_min;	/**< shortest frame time */
+	unsigned long frame_max;	/**< longest frame time */
+	unsigned long long interval_sum; /**< sum of the times between flushes */
+	unsigned long long changed;	/**< characters that differed at a flush */
+	unsigned long spans;		/**< spans given to flush_spans() */
+} PrivateData;
+
+
+/* Vars for the server core */
+MODULE_EXPORT char *api_version = API_VERSION;
+MODULE_EXPORT int stay_in_foreground = 0;
+MODULE_EXPORT int supports_multiple = 1;
+MODULE_EXPORT char *symbol_prefix = "bench_";
+
+
+/* Current time in microseconds; only differences are meaningful */
+static unsigned long
+bench_clock(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (unsigned long) tv.tv_sec * 1000000UL + tv.tv_usec;
+}
+
+
+/* Count a call of an output function; the first one after a flush starts
+ * the frame whose time flush() takes */
+static void
+bench_count(PrivateData *p, enum bench_func f)
+{
+	p->calls[f]++;
+	if (!p->in_frame) {
+		p->in_frame = 1;
+		p->frame_start = bench_clock();
+	}
+}
+
+
+/* End the frame at a flush, counting the characters that changed */
+static void
+bench_end_frame(Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+	unsigned long now = bench_clock();
+	unsigned long t;
+	int i, n = 0;
+
+	/* a frame without any output took no time in the core */
+	t = (p->in_frame) ? now - p->frame_start : 0;
+	p->in_frame = 0;
+
+	if ((p->frames == 0) || (t < p->frame_min))
+		p->frame_min = t;
+	if (t > p->frame_max)
+		p->frame_max = t;
+	p->frame_sum += t;
+	if (p->last_flush != 0)
+		p->interval_sum += now - p->last_flush;
+	p->last_flush = now;
+	p->frames++;
+
+	for (i = 0; i < p->width * p->height; i++) {
+		if (p->framebuf[i] != p->backingstore[i]) {
+			p->backingstore[i] = p->framebuf[i];
+			n++;
+		}
+	}
+	p->changed += n;
+	drvthis->count_io(drvthis, IO_CHARS, n);
+}
+
+
+/* Set up the custom characters of a mode, unless it is in use already */
+static void
+bench_set_ccmode(Driver *drvthis, CGmode mode)
+{
+	PrivateData *p = drvthis->private_data;
+	unsigned char bar[BENCH_CELLHEIGHT];
+	int i;
+
+	if (p->ccmode == mode)
+		return;
+	p->ccmode = mode;
+
+	if (mode == vbar) {
+		memset(bar, 0, sizeof(bar));
+		for (i = 1; i < BENCH_CELLHEIGHT; i++) {
+			bar[BENCH_CELLHEIGHT - i] = 0x1F;
+			bench_set_char(drvthis, i, bar);
+		}
+	}
+	else if (mode == hbar) {
+		for (i = 1; i <= BENCH_CELLWIDTH; i++) {
+			memset(bar, (0xFF << (BENCH_CELLWIDTH - i)) & 0x1F, sizeof(bar));
+			bench_set_char(drvthis, i, bar);
+		}
+	}
+}
+
+
+/**
+ * Initialize the driver.
+ * \param drvthis  Pointer to driver structure.
+ * \retval 0       Success.
+ * \retval <0      Error.
+ */
+MODULE_EXPORT int
+bench_init (Driver *drvthis)
+{
+	PrivateData *p;
+	char buf[256];
+
+	/* Allocate and store private data */
+	p = (PrivateData *) calloc(1, sizeof(PrivateData));
+	if (p == NULL)
+		return -1;
+	if (drvthis->store_private_ptr(drvthis, p))
+		return -1;
+
+	p->ccmode = standard;
+	p->contrast = BENCH_DEF_CONTRAST;
+	p->brightness = BENCH_DEF_BRIGHTNESS;
+	p->offbrightness = BENCH_DEF_OFFBRIGHTNESS;
+
+	/* Read display size from config file */
+	strncpy(buf, drvthis->config_get_string(drvthis->name, "Size", 0, BENCH_DEFAULT_SIZE), sizeof(buf));
+	buf[sizeof(buf)-1] = '\0';
+	if ((sscanf(buf, "%dx%d", &p->width, &p->height) != 2)
+	    || (p->width <= 0) || (p->width > LCD_MAX_WIDTH)
+	    || (p->height <= 0) || (p->height > LCD_MAX_HEIGHT)) {
+		report(RPT_WARNING, "%s: cannot read Size: %s; using default %s",
+				drvthis->name, buf, BENCH_DEFAULT_SIZE);
+		sscanf(BENCH_DEFAULT_SIZE, "%dx%d", &p->width, &p->height);
+	}
+
+	/* Let the core use the plain functions instead of the bulk ones,
+	 * to compare both paths */
+	if (!drvthis->config_get_bool(drvthis->name, "FlushSpans", 0, 1))
+		drvthis->caps &= ~DRV_CAP_FLUSH_SPANS;
+	if (!drvthis->config_get_bool(drvthis->name, "BlitText", 0, 1))
+		drvthis->caps &= ~DRV_CAP_BLIT_TEXT;
+	if (!drvthis->config_get_bool(drvthis->name, "ScrollText", 0, 1))
+		drvthis->caps &= ~DRV_CAP_SCROLL_TEXT;
+
+	p->framebuf = malloc(p->width * p->height);
+	p->backingstore = malloc(p->width * p->height);
+	if ((p->framebuf == NULL) || (p->backingstore == NULL)) {
+		report(RPT_ERR, "%s: unable to create framebuffer", drvthis->name);
+		return -1;
+	}
+	memset(p->framebuf, ' ', p->width * p->height);
+	memset(p->backingstore, ' ', p->width * p->height);
+
+	report(RPT_DEBUG, "%s: init() done", drvthis->name);
+
+	return 0;
+}
+
+
+/**
+ * Close the driver, reporting what was measured.
+ * \param drvthis  Pointer to driver structure.
+ */
+MODULE_EXPORT void
+bench_close (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+	int i;
+
+	if (p != NULL) {
+		unsigned long frames = (p->frames > 0) ? p->frames : 1;
+
+		report(RPT_NOTICE, "%s: %lu frames, %llu characters changed, %lu spans",
+		       drvthis->name, p->frames, p->changed, p->spans);
+		report(RPT_NOTICE, "%s: core time per frame: min %lu us, avg %llu us, max %lu us",
+		       drvthis->name, p->frame_min, p->frame_sum / frames, p->frame_max);
+		if (p->frames > 1)
+			report(RPT_NOTICE, "%s: time between flushes: avg %llu us",
+			       drvthis->name, p->interval_sum / (p->frames - 1));
+		for (i = 0; i < BF_COUNT; i++) {
+			if (p->calls[i] > 0)
+				report(RPT_NOTICE, "%s: %-11s %lu calls, %.1f per frame",
+				       drvthis->name, bench_func_names[i], p->calls[i],
+				       (double) p->calls[i] / frames);
+		}
+
+		if (p->framebuf != NULL)
+			free(p->framebuf);
+		if (p->backingstore != NULL)
+			free(p->backingstore);
+
+		free(p);
+	}
+	drvthis->store_private_ptr(drvthis, NULL);
+}
+
+
+/**
+ * Return the display width in characters.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Number of characters the display is wide.
+ */
+MODULE_EXPORT int
+bench_width (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	p->calls[BF_QUERY]++;
+	return p->width;
+}
+
+
+/**
+ * Return the display height in characters.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Number of characters the display is high.
+ */
+MODULE_EXPORT int
+bench_height (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	p->calls[BF_QUERY]++;
+	return p->height;
+}
+
+
+/**
+ * Return the width of a character in pixels.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Number of pixel columns a character cell is wide.
+ */
+MODULE_EXPORT int
+bench_cellwidth (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	p->calls[BF_QUERY]++;
+	return BENCH_CELLWIDTH;
+}
+
+
+/**
+ * Return the height of a character in pixels.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Number of pixel lines a character cell is high.
+ */
+MODULE_EXPORT int
+bench_cellheight (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	p->calls[BF_QUERY]++;
+	return BENCH_CELLHEIGHT;
+}
+
+
+/**
+ * Clear the screen.
+ * \param drvthis  Pointer to driver structure.
+ */
+MODULE_EXPORT void
+bench_clear (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	bench_count(p, BF_CLEAR);
+	memset(p->framebuf, ' ', p->width * p->height);
+	p->ccmode = standard;
+}
+
+
+/**
+ * End the frame: take its time and count the characters that changed.
+ * \param drvthis  Pointer to driver structure.
+ */
+MODULE_EXPORT void
+bench_flush (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	p->calls[BF_FLUSH]++;
+	bench_end_frame(drvthis);
+}
+
+
+/**
+ * End the frame like bench_flush(), given the spans that changed.
+ * \param drvthis  Pointer to driver structure.
+ * \param spans    The changed spans.
+ * \param count    Number of spans.
+ */
+MODULE_EXPORT void
+bench_flush_spans (Driver *drvthis, const LCDSpan *spans, int count)
+{
+	PrivateData *p = drvthis->private_data;
+
+	p->calls[BF_FLUSH_SPANS]++;
+	p->spans += count;
+	bench_end_frame(drvthis);
+}
+
+
+/**
+ * Move characters on the display like a display scrolling a line in
+ * hardware: the frame buffer content at the last flush moves, so only the
+ * characters moved in count as changed at the next flush.
+ * \param drvthis  Pointer to driver structure.
+ * \param rect     The characters to move.
+ * \param shift    Columns to move them; < 0 moves them to the left.
+ * \retval 0       Success.
+ * \retval -1      The rectangle is not on the display.
+ */
+MODULE_EXPORT int
+bench_scroll_text (Driver *drvthis, const LCDRect *rect, int shift)
+{
+	PrivateData *p = drvthis->private_data;
+	int y;
+
+	if ((rect->x < 1) || (rect->y < 1) || (rect->width <= abs(shift))
+	    || (rect->x - 1 + rect->width > p->width)
+	    || (rect->y - 1 + rect->height > p->height))
+		return -1;
+
+	bench_count(p, BF_SCROLL_TEXT);
+	for (y = rect->y - 1; y < rect->y - 1 + rect->height; y++) {
+		char *row = p->backingstore + y * p->width + rect->x - 1;
+		int len = rect->width - abs(shift);
+
+		/* the cells moved in show something unknown */
+		if (shift < 0) {
+			memmove(row, row - shift, len);
+			memset(row + len, 0, -shift);
+		}
+		else {
+			memmove(row + shift, row, len);
+			memset(row, 0, shift);
+		}
+	}
+	return 0;
+}
+
+
+/**
+ * Print a string on the screen at position (x,y).
+ * The upper-left corner is (1,1), the lower-right corner is (p->width, p->height).
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column).
+ * \param y        Vertical character position (row).
+ * \param string   String that gets written.
+ */
+MODULE_EXPORT void
+bench_string (Driver *drvthis, int x, int y, const char string[])
+{
+	PrivateData *p = drvthis->private_data;
+	int i;
+
+	bench_count(p, BF_STRING);
+
+	x--;
+	y--;
+	if ((y < 0) || (y >= p->height))
+		return;
+
+	for (i = 0; (string[i] != '\0') && (x < p->width); i++, x++) {
+		if (x >= 0)
+			p->framebuf[(y * p->width) + x] = string[i];
+	}
+}
+
+
+/**
+ * Write a block of characters at once.
+ * \param drvthis  Pointer to driver structure.
+ * \param buf      The characters, row r of them starting at buf + r * stride.
+ * \param stride   Distance between the rows in buf.
+ * \param rect     Where the block goes on the display.
+ */
+MODULE_EXPORT void
+bench_blit_text (Driver *drvthis, const unsigned char *buf, int stride, const LCDRect *rect)
+{
+	PrivateData *p = drvthis->private_data;
+	int j;
+
+	bench_count(p, BF_BLIT_TEXT);
+
+	for (j = 0; j < rect->height; j++) {
+		const unsigned char *src = buf + j * stride;
+		int y = rect->y - 1 + j;
+		int x = rect->x - 1;
+		int len = rect->width;
+
+		if ((y < 0) || (y >= p->height))
+			continue;
+		if (x < 0) {
+			src -= x;
+			len += x;
+			x = 0;
+		}
+		if (x + len > p->width)
+			len = p->width - x;
+		if (len > 0)
+			memcpy(p->framebuf + (y * p->width) + x, src, len);
+	}
+}
+
+
+/**
+ * Print a character on the screen at position (x,y).
+ * The upper-left corner is (1,1), the lower-right corner is (p->width, p->height).
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column).
+ * \param y        Vertical character position (row).
+ * \param c        Character that gets written.
+ */
+MODULE_EXPORT void
+bench_chr (Driver *drvthis, int x, int y, char c)
+{
+	PrivateData *p = drvthis->private_data;
+
+	bench_count(p, BF_CHR);
+
+	x--;
+	y--;
+	if ((x >= 0) && (y >= 0) && (x < p->width) && (y < p->height))
+		p->framebuf[(y * p->width) + x] = c;
+}
+
+
+/**
+ * Draw a vertical bar bottom-up.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column) of the starting point.
+ * \param y        Vertical character position (row) of the starting point.
+ * \param len      Number of characters that the bar is high at 100%
+ * \param promille Current height level of the bar in promille.
+ * \param options  Options (currently unused).
+ */
+MODULE_EXPORT void
+bench_vbar (Driver *drvthis, int x, int y, int len, int promille, int options)
+{
+	PrivateData *p = drvthis->private_data;
+
+	bench_count(p, BF_VBAR);
+	bench_set_ccmode(drvthis, vbar);
+	lib_vbar_static(drvthis, x, y, len, promille, options, BENCH_CELLHEIGHT, 0);
+}
+
+
+/**
+ * Draw a horizontal bar to the right.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column) of the starting point.
+ * \param y        Vertical character position (row) of the starting point.
+ * \param len      Number of characters that the bar is long at 100%
+ * \param promille Current length level of the bar in promille.
+ * \param options  Options (currently unused).
+ */
+MODULE_EXPORT void
+bench_hbar (Driver *drvthis, int x, int y, int len, int promille, int options)
+{
+	PrivateData *p = drvthis->private_data;
+
+	bench_count(p, BF_HBAR);
+	bench_set_ccmode(drvthis, hbar);
+	lib_hbar_static(drvthis, x, y, len, promille, options, BENCH_CELLWIDTH, 0);
+}
+
+
+/**
+ * Write a big number to the screen.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column).
+ * \param num      Character to write (0 - 10 with 10 representing ':')
+ */
+MODULE_EXPORT void
+bench_num (Driver *drvthis, int x, int num)
+{
+	PrivateData *p = drvthis->private_data;
+	int do_init = 0;
+
+	if ((num < 0) || (num > 10))
+		return;
+
+	bench_count(p, BF_NUM);
+	if (p->ccmode != bignum) {
+		p->ccmode = bignum;
+		do_init = 1;
+	}
+	lib_adv_bignum(drvthis, x, num, 0, do_init);
+}
+
+
+/**
+ * Place an icon on the screen. The block and the hearts are drawn here,
+ * the others are left to the server core.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column).
+ * \param y        Vertical character position (row).
+ * \param icon     synbolic value representing the icon.
+ * \retval 0       Icon has been successfully defined/written.
+ * \retval <0      Server core shall define/write the icon.
+ */
+MODULE_EXPORT int
+bench_icon (Driver *drvthis, int x, int y, int icon)
+{
+	static unsigned char heart_open[] =
+		{ b__XXXXX, b__X_X_X, b_______, b_______,
+		  b_______, b__X___X, b__XX_XX, b__XXXXX };
+	static unsigned char heart_filled[] =
+		{ b__XXXXX, b__X_X_X, b___X_X_, b___XXX_,
+		  b___XXX_, b__X_X_X, b__XX_XX, b__XXXXX };
+	PrivateData *p = drvthis->private_data;
+
+	bench_count(p, BF_ICON);
+
+	switch (icon) {
+		case ICON_BLOCK_FILLED:
+			bench_chr(drvthis, x, y, 255);
+			break;
+		case ICON_HEART_OPEN:
+			bench_set_char(drvthis, 0, heart_open);
+			bench_chr(drvthis, x, y, 0);
+			break;
+		case ICON_HEART_FILLED:
+			bench_set_char(drvthis, 0, heart_filled);
+			bench_chr(drvthis, x, y, 0);
+			break;
+		default:
+			return -1;
+	}
+	return 0;
+}
+
+
+/**
+ * Set cursor position and state. Only counted.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal cursor position (column).
+ * \param y        Vertical cursor position (row).
+ * \param type     Appearance of the cursor
+ */
+MODULE_EXPORT void
+bench_cursor (Driver *drvthis, int x, int y, int type)
+{
+	PrivateData *p = drvthis->private_data;
+
+	bench_count(p, BF_CURSOR);
+}
+
+
+/**
+ * Define a custom character.
+ * \param drvthis  Pointer to driver structure.
+ * \param n        Custom character to define [0 - (BENCH_CUSTOM_CHARS-1)].
+ * \param dat      Array of 8 (=cellheight) bytes, each representing a pixel row
+ *                 starting from the top to bottom.
+ */
+MODULE_EXPORT void
+bench_set_char (Driver *drvthis, int n, unsigned char *dat)
+{
+	PrivateData *p = drvthis->private_data;
+
+	if ((n < 0) || (n >= BENCH_CUSTOM_CHARS) || (dat == NULL))
+		return;
+
+	bench_count(p, BF_SET_CHAR);
+	if (memcmp(p->cc[n], dat, BENCH_CELLHEIGHT) != 0) {
+		memcpy(p->cc[n], dat, BENCH_CELLHEIGHT);
+		drvthis->count_io(drvthis, IO_CGRAM, 1);
+	}
+}
+
+
+/**
+ * Get total number of custom characters available.
+ * \param drvthis  Pointer to driver structure.
+ * \return  Number of custom characters.
+ */
+MODULE_EXPORT int
+bench_get_free_chars (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	p->calls[BF_QUERY]++;
+	return BENCH_CUSTOM_CHARS;
+}
+
+
+/**
+ * Get current LCD contrast.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Stored contrast in promille.
+ */
+MODULE_EXPORT int
+bench_get_contrast (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	p->calls[BF_QUERY]++;
+	return p->contrast;
+}
+
+
+/**
+ * Change LCD contrast.
+ * \param drvthis  Pointer to driver structure.
+ * \param promille New contrast value in promille.
+ */
+MODULE_EXPORT void
+bench_set_contrast (Driver *drvthis, int promille)
+{
+	PrivateData *p = drvthis->private_data;
+
+	if ((promille >= 0) && (promille <= 1000))
+		p->contrast = promille;
+}
+
+
+/**
+ * Retrieve brightness.
+ * \param drvthis  Pointer to driver structure.
+ * \param state    Brightness state (on/off) for which we want the value.
+ * \return         Stored brightness in promille.
+ */
+MODULE_EXPORT int
+bench_get_brightness (Driver *drvthis, int state)
+{
+	PrivateData *p = drvthis->private_data;
+
+	p->calls[BF_QUERY]++;
+	return (state == BACKLIGHT_ON) ? p->brightness : p->offbrightness;
+}
+
+
+/**
+ * Set on/off brightness.
+ * \param drvthis   Pointer to driver structure.
+ * \param state     Brightness state (on/off) for which we want to store the value.
+ * \param promille  New brightness in promille.
+ */
+MODULE_EXPORT void
+bench_set_brightness (Driver *drvthis, int state, int promille)
+{
+	PrivateData *p = drvthis->private_data;
+
+	if ((promille < 0) || (promille > 1000))
+		return;
+
+	if (state == BACKLIGHT_ON)
+		p->brightness = promille;
+	else
+		p->offbrightness = promille;
+}
+
+
+/**
+ * Turn the backlight on or off. Only counted.
+ * \param drvthis  Pointer to driver structure.
+ * \param on       New backlight status.
+ */
+MODULE_EXPORT void
+bench_backlight (Driver *drvthis, int on)
+{
+	PrivateData *p = drvthis->private_data;
+
+	bench_count(p, BF_BACKLIGHT);
+}
+
+
+/**
+ * Send out-of-band data to the device. Only counted.
+ * \param drvthis  Pointer to driver structure.
+ * \param value    Integer. Meaning is specific to the device
+ */
+MODULE_EXPORT void
+bench_output (Driver *drvthis, int value)
+{
+	PrivateData *p = drvthis->private_data;
+
+	bench_count(p, BF_OUTPUT);
+}
+
+
+/**
+ * Handle input. There are no keys, the calls are only counted.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Always \c NULL.
+ */
+MODULE_EXPORT const char *
+bench_get_key (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	p->calls[BF_GET_KEY]++;
+	return NULL;
+}
+
+
+/**
+ * Provide some information about this driver.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Constant string with information.
+ */
+MODULE_EXPORT const char *
+bench_get_info (Driver *drvthis)
+{
+	static char *info_string = "bench driver, measuring the server core";
+
+	return info_string;
+}
@@ -0,0 +1,40 @@
+#ifndef LCD_BENCH_H
+#define LCD_BENCH_H
+
+MODULE_EXPORT int  bench_init (Driver *drvthis);
+MODULE_EXPORT void bench_close (Driver *drvthis);
+MODULE_EXPORT int  bench_width (Driver *drvthis);
+MODULE_EXPORT int  bench_height (Driver *drvthis);
+MODULE_EXPORT int  bench_cellwidth (Driver *drvthis);
+MODULE_EXPORT int  bench_cellheight (Driver *drvthis);
+MODULE_EXPORT void bench_clear (Driver *drvthis);
+MODULE_EXPORT void bench_flush (Driver *drvthis);
+MODULE_EXPORT void bench_flush_spans (Driver *drvthis, const LCDSpan *spans, int count);
+MODULE_EXPORT void bench_string (Driver *drvthis, int x, int y, const char string[]);
+MODULE_EXPORT void bench_chr (Driver *drvthis, int x, int y, char c);
+MODULE_EXPORT void bench_blit_text (Driver *drvthis, const unsigned char *buf, int stride, const LCDRect *rect);
+MODULE_EXPORT int  bench_scroll_text (Driver *drvthis, const LCDRect *rect, int shift);
+MODULE_EXPORT const char *bench_get_key (Driver *drvthis);
+
+MODULE_EXPORT void bench_vbar (Driver *drvthis, int x, int y, int len, int promille, int options);
+MODULE_EXPORT void bench_hbar (Driver *drvthis, int x, int y, int len, int promille, int options);
+MODULE_EXPORT void bench_num (Driver *drvthis, int x, int num);
+MODULE_EXPORT int  bench_icon (Driver *drvthis, int x, int y, int icon);
+MODULE_EXPORT void bench_cursor (Driver *drvthis, int x, int y, int type);
+MODULE_EXPORT void bench_set_char (Driver *drvthis, int n, unsigned char *dat);
+MODULE_EXPORT int  bench_get_free_chars (Driver *drvthis);
+/* bench_heartbeat and bench_pbar not implemented, the server's default
+ * draws them with icon() and hbar() */
+
+MODULE_EXPORT int  bench_get_contrast (Driver *drvthis);
+MODULE_EXPORT void bench_set_contrast (Driver *drvthis, int promille);
+MODULE_EXPORT int  bench_get_brightness (Driver *drvthis, int state);
+MODULE_EXPORT void bench_set_brightness (Driver *drvthis, int state, int promille);
+MODULE_EXPORT void bench_backlight (Driver *drvthis, int on);
+MODULE_EXPORT void bench_output (Driver *drvthis, int value);
+
+MODULE_EXPORT const char *bench_get_info (Driver *drvthis);
+
+#define BENCH_DEFAULT_SIZE "20x4"
+
+#endif
@@ -105,6 +105,9 @@ Different implementations of (n)curses available on:
 typedef struct curses_private_data {
 	WINDOW *win;
 
+	char *framebuf;		/**< characters of the frame being drawn */
+	char *backingstore;	/**< characters the window shows */
+
 	int current_color_pair;
 	int current_border_pair;
 	int curses_backlight_state;
@@ -131,6 +134,7 @@ MODULE_EXPORT char *symbol_prefix = "curses_";
 
 /* local helper functions */
 static void curses_wborder (Driver *drvthis);
+static void curses_reset_window (Driver *drvthis);
 static chtype get_color_by_name (char *colorname, chtype default_color);
 static void curses_restore_screen (Driver *drvthis);
 
@@ -164,6 +168,8 @@ curses_init (Driver *drvthis)
 
 	/* initialize private data */
 	p->win = NULL;
+	p->framebuf = NULL;
+	p->backingstore = NULL;
 	p->current_color_pair = 2;
 	p->current_border_pair = 3;
 	p->curses_backlight_state = 0;
@@ -280,7 +286,15 @@ curses_init (Driver *drvthis)
 		init_pair(5, COLOR_WHITE, backlight_color);
 	}
 
+	p->framebuf = malloc(p->width * p->height);
+	p->backingstore = malloc(p->width * p->height);
+	if ((p->framebuf == NULL) || (p->backingstore == NULL)) {
+		report(RPT_ERR, "%s: unable to create framebuffer", drvthis->name);
+		return -1;
+	}
+
 	curses_clear(drvthis);
+	curses_reset_window(drvthis);
 
 	report(RPT_DEBUG, "%s: init() done", drvthis->name);
 
@@ -310,6 +324,8 @@ curses_close (Driver *drvthis)
 		endwin();
 		curs_set(1);
 
+		free(p->framebuf);
+		free(p->backingstore);
 		free(p);
 	}
 	drvthis->store_private_ptr(drvthis, NULL);
@@ -352,12 +368,7 @@ curses_clear (Driver *drvthis)
 {
 	PrivateData *p = drvthis->private_data;
 
-	wbkgdset(p->win, COLOR_PAIR(p->current_color_pair) | ' ');
-
-	if (p->drawBorder)
-		curses_wborder(drvthis);
-
-	werase(p->win);
+	memset(p->framebuf, ' ', p->width * p->height);
 }
 
 
@@ -390,7 +401,8 @@ curses_backlight (Driver *drvthis, int on)
 		p->current_border_pair = 3;
 	}
 
-	curses_clear(drvthis);
+	/* all characters change their colors */
+	curses_reset_window(drvthis);
 }
 
 
@@ -406,16 +418,15 @@ MODULE_EXPORT void
 curses_string (Driver *drvthis, int x, int y, const char string[])
 {
 	PrivateData *p = drvthis->private_data;
+	int i;
 
 	if ((x <= 0) || (y <= 0) || (x > p->width) || (y > p->height))
 		return;
 
-	if (!p->drawBorder) {
-		x--;
-		y--;
-	}
-
-	mvwaddstr(p->win, y, x, string);
+	x--;
+	y--;
+	for (i = 0; (string[i] != '\0') && (x + i < p->width); i++)
+		p->framebuf[(y * p->width) + x + i] = string[i];
 }
 
 
@@ -435,12 +446,7 @@ curses_chr (Driver *drvthis, int x, int y, char c)
 	if ((x <= 0) || (y <= 0) || (x > p->width) || (y > p->height))
 		return;
 
-	if (!p->drawBorder) {
-		x--;
-		y--;
-	}
-
-	mvwaddch(p->win, y, x, c);
+	p->framebuf[((y - 1) * p->width) + x - 1] = c;
 }
 
 
@@ -597,13 +603,17 @@ curses_icon (Driver *drvthis, int x, int y, int icon)
 
 
 /**
- * Flush data on screen to the display.
+ * Flush data on screen to the display. Only the characters that changed
+ * since the last flush are put into the window, so curses has only those
+ * lines to compare and the terminal gets only those characters.
  * \param drvthis  Pointer to driver structure.
  */
 MODULE_EXPORT void
 curses_flush (Driver *drvthis)
 {
 	PrivateData *p = drvthis->private_data;
+	int offs = (p->drawBorder) ? 1 : 0;
+	int x, y;
 	int c;
 
 	if ((c = getch()) != ERR) {
@@ -613,10 +623,21 @@ curses_flush (Driver *drvthis)
 		ungetch(c);
 	}
 
-	if (p->drawBorder)
-		curses_wborder(drvthis);
+	for (y = 0; y < p->height; y++) {
+		char *sp = p->framebuf + (y * p->width);
+		char *sq = p->backingstore + (y * p->width);
 
-	wrefresh(p->win);
+		if (memcmp(sp, sq, p->width) == 0)
+			continue;
+		for (x = 0; x < p->width; x++) {
+			if (sp[x] != sq[x])
+				mvwaddch(p->win, y + offs, x + offs, sp[x]);
+		}
+		memcpy(sq, sp, p->width);
+	}
+
+	wnoutrefresh(p->win);
+	doupdate();
 }
 
 
@@ -704,6 +725,26 @@ curses_wborder (Driver *drvthis)
 }
 
 
+/*
+ * Blank the window in the current colors, e.g. after the backlight changed,
+ * and redraw its border. The next flush puts all characters into it again.
+ */
+static void
+curses_reset_window (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	wbkgdset(p->win, COLOR_PAIR(p->current_color_pair) | ' ');
+	werase(p->win);
+
+	if (p->drawBorder)
+		curses_wborder(drvthis);
+
+	/* a blank window shows spaces; draw everything else again */
+	memset(p->backingstore, ' ', p->width * p->height);
+}
+
+
 static chtype
 get_color_by_name (char *colorname, chtype default_color) {
 	if (strcasecmp(colorname, "red") == 0)
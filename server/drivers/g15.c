@@ -113,6 +113,16 @@ MODULE_EXPORT int g15_init (Driver *drvthis)
 	p->g15screen_fd = -1;
 	p->g15d_ver = g15daemon_version();
 
+	/* Frames coming faster than the LCD shows them are merged */
+	p->min_interval = drvthis->config_get_int(drvthis->name, "MinInterval", 0,
+						  G15_DEFAULT_MIN_INTERVAL);
+	if (p->min_interval < 0) {
+		report(RPT_WARNING, "%s: MinInterval must be 0 or more; using %d",
+		       drvthis->name, G15_DEFAULT_MIN_INTERVAL);
+		p->min_interval = G15_DEFAULT_MIN_INTERVAL;
+	}
+	p->min_interval *= 1000;
+
 	if((p->g15screen_fd = new_g15_screen(G15_G15RBUF)) < 0)
 	{
 		/* g15daemon is not running, use hidraw access instead */
@@ -265,6 +275,9 @@ static void g15_pixmap_to_lcd(unsigned char *lcd_buffer, unsigned char const *da
 }
 
 // Blasts a single frame onscreen, to the lcd...
+// Frames that look like the one sent last are not sent again, and after
+// sending one the server holds back the next for MinInterval, flushing
+// only the latest frame rendered meanwhile.
 //
 MODULE_EXPORT void g15_flush (Driver *drvthis)
 {
@@ -279,10 +292,16 @@ MODULE_EXPORT void g15_flush (Driver *drvthis)
 
 	if (p->g15screen_fd != -1) {
 		g15_send(p->g15screen_fd, (char*)p->canvas.buffer, 1048);
+		drvthis->count_io(drvthis, IO_BYTES, 1048);
 	} else {
 		g15_pixmap_to_lcd(lcd_buf, p->canvas.buffer);
 		lib_hidraw_send_output_report(p->hidraw_handle, lcd_buf, sizeof(lcd_buf));
+		drvthis->count_io(drvthis, IO_BYTES, sizeof(lcd_buf));
 	}
+	drvthis->count_io(drvthis, IO_WRITES, 1);
+
+	if (p->min_interval > 0)
+		drvthis->flush_busy(drvthis, p->min_interval);
 }
 
 // LCDd 1-dimension char coordinates to g15r 0-(dimension-1) pixel coords */
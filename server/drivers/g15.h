@@ -41,8 +41,13 @@ typedef struct g15_private_data {
 	g15font *font;
 	/* status indicators */
 	int backlight_state;
+	/* shortest time between frames sent, in microseconds */
+	int min_interval;
 } PrivateData;
 
+/** Default for MinInterval, in milliseconds */
+#define G15_DEFAULT_MIN_INTERVAL	40
+
 #define G15_OFFSET				32
 #define G15_PX_WIDTH			160
 #define G15_PX_HEIGHT			43
@@ -32,6 +32,12 @@ int glcd_x11_init(Driver *drvthis);
 #ifdef HAVE_LIBGPIOD
 int glcd_rnx16_init(Driver *drvthis);
 #endif
+#ifdef HAVE_LINUX_FB_H
+int glcd_fbdev_init(Driver *drvthis);
+#endif
+#ifdef HAVE_SHM_OPEN
+int glcd_shm_init(Driver *drvthis);
+#endif
 
 /* symbolic names for connection types */
 #define GLCD_CT_UNKNOWN		0
@@ -42,12 +48,15 @@ int glcd_rnx16_init(Driver *drvthis);
 #define GLCD_CT_X11		5
 #define GLCD_CT_PICOLCDGFX	6
 #define GLCD_CT_RNX16 		7
+#define GLCD_CT_FBDEV		8
+#define GLCD_CT_SHM		9
 
 /** Structure linking symbolic names to initialization routines */
 typedef struct ConnectionMapping {
 	char *name;
 	int connectiontype;
 	int (*init_fn)(Driver *drvthis);
+	int grayscale;		/**< blit() handles FB_TYPE_LINEAR with more than 1bpp */
 } ConnectionMapping;
 
 
@@ -55,13 +64,14 @@ typedef struct ConnectionMapping {
  * - string to identify connection in config file
  * - connection type identifier
  * - initialization function
+ * - whether it can show gray levels (see BitsPerPixel)
  */
 static const ConnectionMapping connectionMapping[] = {
 #ifdef HAVE_PCSTYLE_LPT_CONTROL
 	{"t6963", GLCD_CT_T6963, glcd_t6963_init},
 #endif
 #ifdef HAVE_LIBPNG
-	{"png", GLCD_CT_PNG, glcd_png_init},
+	{"png", GLCD_CT_PNG, glcd_png_init, 1},
 #endif
 #ifdef HAVE_SERDISPLIB
 	{"serdisplib", GLCD_CT_SERDISP, glcd_serdisp_init},
@@ -71,13 +81,19 @@ static const ConnectionMapping connectionMapping[] = {
 	{"picolcdgfx", GLCD_CT_PICOLCDGFX, glcd_picolcdgfx_init},
 #endif
 #ifdef HAVE_LIBX11
-	{"x11", GLCD_CT_X11, glcd_x11_init},
+	{"x11", GLCD_CT_X11, glcd_x11_init, 1},
 #endif
 #ifdef HAVE_LIBGPIOD
 	{"rnx16", GLCD_CT_RNX16, glcd_rnx16_init},
+#endif
+#ifdef HAVE_LINUX_FB_H
+	{"fbdev", GLCD_CT_FBDEV, glcd_fbdev_init},
+#endif
+#ifdef HAVE_SHM_OPEN
+	{"shm", GLCD_CT_SHM, glcd_shm_init, 1},
 #endif
 	/* default, end of structure element (do not delete) */
-	{NULL, GLCD_CT_UNKNOWN, NULL}
+	{NULL, GLCD_CT_UNKNOWN, NULL, 0}
 };
 
 #endif
@@ -0,0 +1,263 @@
+/** \file server/drivers/glcd-fbdev.c
+ * This connection type writes the framebuffer content to a Linux frame
+ * buffer device, e.g. a small SPI TFT driven by fbtft. The device memory
+ * is mapped, and only the changed areas of the framebuffer are converted
+ * to the device's pixel format and written to it.
+ */
+
+/*-
+ * This file is released under the GNU General Public License. Refer to the
+ * COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fb.h>
+
+#include "lcd.h"
+#include "shared/report.h"
+#include "shared/defines.h"
+#include "glcd-low.h"
+
+#define FBDEV_DEF_DEVICE		"/dev/fb0"
+#define FBDEV_DEF_PIXEL_COLOR		0x000000
+#define FBDEV_DEF_BACKLIGHT_COLOR	0x80FF80
+
+/** Most bytes per device pixel */
+#define FBDEV_MAX_BYTES		4
+
+/** Private data for the fbdev connection type */
+typedef struct glcd_fbdev_data {
+	int fd;				/**< frame buffer device */
+	unsigned char *mem;		/**< mapped device memory */
+	size_t mem_size;		/**< size of the mapping */
+	unsigned char *origin;		/**< device pixel at the top left of the LCD */
+	int line_length;		/**< bytes per device line */
+	int bytespp;			/**< bytes per device pixel */
+	/** Device pixels of each framebuffer byte, MSB first */
+	unsigned char expand[256][8 * FBDEV_MAX_BYTES];
+} CT_fbdev_data;
+
+/* Prototypes */
+void glcd_fbdev_blit(PrivateData *p);
+void glcd_fbdev_close(PrivateData *p);
+void glcd_fbdev_set_backlight(PrivateData *p, int state);
+
+/**
+ * Convert a 0xRRGGBB color to a device pixel value.
+ * \param var    The device's variable screen info.
+ * \param color  The color.
+ * \return       The pixel value.
+ */
+static unsigned long
+fbdev_pixel(const struct fb_var_screeninfo *var, unsigned long color)
+{
+	unsigned long r = (color >> 16) & 0xFF;
+	unsigned long g = (color >> 8) & 0xFF;
+	unsigned long b = color & 0xFF;
+
+	return ((r >> (8 - var->red.length)) << var->red.offset)
+		| ((g >> (8 - var->green.length)) << var->green.offset)
+		| ((b >> (8 - var->blue.length)) << var->blue.offset);
+}
+
+/**
+ * Fill the table expanding a framebuffer byte to 8 device pixels, so that
+ * a blit copies whole runs of pixels instead of setting them one by one.
+ * \param ct_data  Connection type's private data.
+ * \param fg       Device pixel value of set pixels.
+ * \param bg       Device pixel value of unset pixels.
+ */
+static void
+fbdev_fill_expand(CT_fbdev_data *ct_data, unsigned long fg, unsigned long bg)
+{
+	int byte, bit, i;
+
+	for (byte = 0; byte < 256; byte++) {
+		for (bit = 0; bit < 8; bit++) {
+			unsigned long px = (byte & (0x80 >> bit)) ? fg : bg;
+			unsigned char *dest = &ct_data->expand[byte][bit * ct_data->bytespp];
+
+			/* 16 and 32 bit pixels are in host byte order */
+			if (ct_data->bytespp == 2) {
+				uint16_t v = px;
+				memcpy(dest, &v, sizeof(v));
+			}
+			else if (ct_data->bytespp == 4) {
+				uint32_t v = px;
+				memcpy(dest, &v, sizeof(v));
+			}
+			else {
+				for (i = 0; i < ct_data->bytespp; i++)
+					dest[i] = (px >> (8 * i)) & 0xFF;
+			}
+		}
+	}
+}
+
+/**
+ * API: Initialize the connection type driver.
+ * \param drvthis  Pointer to driver structure.
+ * \retval 0       Success.
+ * \retval <0      Error.
+ */
+int
+glcd_fbdev_init(Driver *drvthis)
+{
+	PrivateData *p = (PrivateData *) drvthis->private_data;
+	CT_fbdev_data *ct_data;
+	struct fb_var_screeninfo var;
+	struct fb_fix_screeninfo fix;
+	const char *device;
+	unsigned long fgcolor, bgcolor;
+
+	report(RPT_INFO, "GLCD/fbdev: initializing");
+
+	/* Set up connection type low-level functions */
+	p->glcd_functions->blit = glcd_fbdev_blit;
+	p->glcd_functions->close = glcd_fbdev_close;
+	p->glcd_functions->set_backlight = glcd_fbdev_set_backlight;
+
+	/* Allocate memory structures */
+	ct_data = (CT_fbdev_data *) calloc(1, sizeof(CT_fbdev_data));
+	if (ct_data == NULL) {
+		report(RPT_ERR, "GLCD/fbdev: error allocating connection data");
+		return -1;
+	}
+	ct_data->fd = -1;
+	p->ct_data = ct_data;
+
+	device = drvthis->config_get_string(drvthis->name, "fbdev_Device", 0, FBDEV_DEF_DEVICE);
+	fgcolor = drvthis->config_get_int(drvthis->name, "fbdev_PixelColor", 0,
+					  FBDEV_DEF_PIXEL_COLOR);
+	bgcolor = drvthis->config_get_int(drvthis->name, "fbdev_BacklightColor", 0,
+					  FBDEV_DEF_BACKLIGHT_COLOR);
+
+	ct_data->fd = open(device, O_RDWR);
+	if (ct_data->fd < 0) {
+		report(RPT_ERR, "GLCD/fbdev: cannot open %s: %s", device, strerror(errno));
+		return -1;
+	}
+
+	if ((ioctl(ct_data->fd, FBIOGET_VSCREENINFO, &var) < 0)
+	    || (ioctl(ct_data->fd, FBIOGET_FSCREENINFO, &fix) < 0)) {
+		report(RPT_ERR, "GLCD/fbdev: cannot get screen info of %s: %s",
+		       device, strerror(errno));
+		return -1;
+	}
+
+	if ((fix.type != FB_TYPE_PACKED_PIXELS) || (fix.visual != FB_VISUAL_TRUECOLOR)
+	    || ((var.bits_per_pixel != 16) && (var.bits_per_pixel != 24)
+		&& (var.bits_per_pixel != 32))) {
+		report(RPT_ERR, "GLCD/fbdev: %s uses an unsupported pixel format (%d bpp)",
+		       device, var.bits_per_pixel);
+		return -1;
+	}
+
+	if ((p->framebuf.px_width > (int) var.xres) || (p->framebuf.px_height > (int) var.yres)) {
+		report(RPT_ERR, "GLCD/fbdev: Size %dx%d does not fit on %s (%dx%d)",
+		       p->framebuf.px_width, p->framebuf.px_height, device, var.xres, var.yres);
+		return -1;
+	}
+
+	ct_data->mem_size = fix.smem_len;
+	ct_data->mem = mmap(NULL, ct_data->mem_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			    ct_data->fd, 0);
+	if (ct_data->mem == MAP_FAILED) {
+		ct_data->mem = NULL;
+		report(RPT_ERR, "GLCD/fbdev: cannot map %s: %s", device, strerror(errno));
+		return -1;
+	}
+
+	ct_data->bytespp = var.bits_per_pixel / 8;
+	ct_data->line_length = fix.line_length;
+	ct_data->origin = ct_data->mem + var.yoffset * fix.line_length
+		+ var.xoffset * ct_data->bytespp;
+
+	fbdev_fill_expand(ct_data, fbdev_pixel(&var, fgcolor), fbdev_pixel(&var, bgcolor));
+
+	report(RPT_INFO, "GLCD/fbdev: using %s (%dx%d, %d bpp)", device,
+	       var.xres, var.yres, var.bits_per_pixel);
+
+	return 0;
+}
+
+/**
+ * API: Write the framebuffer to the display
+ * \param p  Pointer to glcd driver's private date structure.
+ */
+void
+glcd_fbdev_blit(PrivateData *p)
+{
+	CT_fbdev_data *ct_data = (CT_fbdev_data *) p->ct_data;
+	int bytes8 = 8 * ct_data->bytespp;
+	int i;
+
+	/*
+	 * Each dirty area is the changed part of one pixel row, starting at a
+	 * byte of the framebuffer; every byte becomes 8 device pixels.
+	 */
+	for (i = 0; i < p->framebuf.numDirty; i++) {
+		struct glcd_rect *r = &p->framebuf.dirty[i];
+		int len, x;
+		int pos = fb_rect_bytes(&p->framebuf, r, &len);
+		unsigned char *src = p->framebuf.data + pos;
+		unsigned char *dest = ct_data->origin + r->y * ct_data->line_length
+			+ r->x * ct_data->bytespp;
+
+		for (x = r->x; x < r->x + r->width; x += 8) {
+			int n = min(8, r->x + r->width - x);
+
+			memcpy(dest, ct_data->expand[*src++], n * ct_data->bytespp);
+			dest += bytes8;
+		}
+	}
+}
+
+/**
+ * API: Release low-level resources.
+ * \param p  Pointer to glcd driver's private date structure.
+ */
+void
+glcd_fbdev_close(PrivateData *p)
+{
+	if (p->ct_data != NULL) {
+		CT_fbdev_data *ct_data = (CT_fbdev_data *) p->ct_data;
+
+		if (ct_data->mem != NULL)
+			munmap(ct_data->mem, ct_data->mem_size);
+		if (ct_data->fd >= 0)
+			close(ct_data->fd);
+
+		free(p->ct_data);
+		p->ct_data = NULL;
+	}
+}
+
+/**
+ * API: Turn the backlight on or off by (un)blanking the device. Drivers
+ * like fbtft switch the backlight of the display with it.
+ * \param p      Pointer to glcd driver's private date structure.
+ * \param state  State of backlight.
+ */
+void
+glcd_fbdev_set_backlight(PrivateData *p, int state)
+{
+	CT_fbdev_data *ct_data = (CT_fbdev_data *) p->ct_data;
+
+	if (ioctl(ct_data->fd, FBIOBLANK,
+		  (state == BACKLIGHT_ON) ? FB_BLANK_UNBLANK : FB_BLANK_NORMAL) < 0)
+		p->glcd_functions->drv_debug(RPT_DEBUG, "GLCD/fbdev: FBIOBLANK failed: %s",
+					     strerror(errno));
+}
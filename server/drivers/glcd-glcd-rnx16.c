@@ -47,8 +47,6 @@ typedef struct glcd_rnx16_data {
 	struct gpiod_line *reset;
 	unsigned char inverted;
 	int keytimeout;
-
-	unsigned char *backingstore;
 } CT_rnx16_data;
 
 /* Prototypes */
@@ -120,17 +118,6 @@ glcd_rnx16_init(Driver *drvthis)
 	/* Since the display is fixed to 256x64 we have to recalculate. */
 	p->framebuf.size = (RNX16_HEIGHT / 8) * RNX16_WIDTH;
 
-	ct_data->backingstore = malloc(p->framebuf.size);
-	if (ct_data->backingstore == NULL) {
-		report(RPT_ERR, "GLCD/rnx16: unable to allocate backing store");
-		return -1;
-	}
-
-	/* framebuf is initialized with 0x00 so initialize the backingstore with
-	 * 0xFF so the first call to _blit will draw the entire screen.
-	 * */
-	memset(ct_data->backingstore, 0xFF, p->framebuf.size);
-
 	// /* Get inverted option */
 	// if (drvthis->config_get_bool(drvthis->name, "picolcdgfx_Inverted", 0, PICOLCDGFX_DEF_INVERTED))
 	// 	ct_data->inverted = 0xFF;
@@ -178,32 +165,35 @@ glcd_rnx16_blit(PrivateData *p)
 
 	CT_rnx16_data *ct_data = (CT_rnx16_data *) p->ct_data;
 
-	unsigned char page;
 	unsigned int xpix = 4;
+	int i;
+
+	if (p->framebuf.numDirty == 0)
+		return;
 
 	spi_send_cmd(p, 0xA6);
 	spi_send_cmd(p, 0x40);
 
-	for (page = 0; page < 4; page ++) {
-		int offset = (128 * page);
-		if (memcmp((p->framebuf.data) + offset, (ct_data->backingstore) + offset, 128) == 0)
-			continue;
+	/* Each dirty area is the changed part of one page */
+	for (i = 0; i < p->framebuf.numDirty; i++) {
+		struct glcd_rect *r = &p->framebuf.dirty[i];
+		unsigned int col = xpix + r->x;
+		int len;
+		int offset = fb_rect_bytes(&p->framebuf, r, &len);
 
 		gpiod_line_set_value(ct_data->cs, 0);
 		gpiod_line_set_value(ct_data->dc, 0);
 
-		spi_send_cmd(p, 0xb0 + page);
-		spi_send_cmd(p, (xpix >> 4) | 0x10);
-		spi_send_cmd(p, xpix & 0xf);
+		spi_send_cmd(p, 0xb0 + r->y / 8);
+		spi_send_cmd(p, (col >> 4) | 0x10);
+		spi_send_cmd(p, col & 0xf);
 
 		gpiod_line_set_value(ct_data->dc, 1);
 
-		for (int i = 0; i < 128; i++) {
-			spi_send_data(p, *((p->framebuf.data) + offset + i));
+		for (int j = 0; j < len; j++) {
+			spi_send_data(p, *((p->framebuf.data) + offset + j));
 		}
 	}
-
-	memcpy(ct_data->backingstore, p->framebuf.data, p->framebuf.size);
 }
 
 /**
@@ -219,9 +209,6 @@ glcd_rnx16_close(PrivateData *p)
 			gpiod_chip_close(ct_data->chip);
 		}
 
-		if (ct_data->backingstore != NULL)
-			free(ct_data->backingstore);
-
 		free(p->ct_data);
 		p->ct_data = NULL;
 	}
@@ -33,6 +33,11 @@
 #define GLCD2USB_VID	0x1c40
 #define GLCD2USB_PID	0x0525
 
+/** Most bytes a write report holds */
+#define GLCD2USB_MAX_WRITE	128
+/** Longest gap of unchanged bytes a write report always bridges */
+#define GLCD2USB_MAX_GAP	4
+
 /** Data local to the glcd2usb connection type */
 typedef struct glcd_glcd2usb_data {
 	usb_dev_handle *device;
@@ -217,6 +222,24 @@ glcd2usb_backlight(PrivateData *p, int state)
 }
 
 
+/**
+ * Get the size of the write report that carries a number of bytes. The
+ * device has reports for 4, 8, 16, 32, 64 and 128 bytes; usbSetReport()
+ * pads the data to the next one.
+ * \param len  Number of bytes to write.
+ * \return     Number of bytes the report holds.
+ */
+static int
+glcd2usb_report_size(int len)
+{
+	int size = 4;
+
+	while (size < len)
+		size *= 2;
+	return size;
+}
+
+
 /**
  * API: Transfer an image to the glcd2usb device. This function and its update
  * algorithm are copied from the LCD4Linux driver as it does its job well.
@@ -232,72 +255,66 @@ glcd2usb_blit(PrivateData *p)
 
 	p->glcd_functions->drv_debug(RPT_DEBUG, "glcd2usb_blit: starting");
 
+	if (p->framebuf.numDirty == 0)
+		return;
+
 	/* Reset the dirty buffer */
 	memset(ctd->dirty_buffer, 0x00, p->framebuf.size);
 
 	/*
 	 * Step 1: Compare the content of the secondary buffer with the frame
 	 * buffer and copy the differences. For each different byte, set the
-	 * flag in the dirty buffer.
+	 * flag in the dirty buffer. Only the areas the driver found changed
+	 * need comparing.
 	 */
-	for (pos = 0; pos < p->framebuf.size; pos++) {
-		if (ctd->paged_buffer[pos] != p->framebuf.data[pos]) {
-			ctd->paged_buffer[pos] = p->framebuf.data[pos];
-			ctd->dirty_buffer[pos] = 1;
+	for (r = 0; r < p->framebuf.numDirty; r++) {
+		int len;
+		int start = fb_rect_bytes(&p->framebuf, &p->framebuf.dirty[r], &len);
+
+		for (pos = start; pos < start + len; pos++) {
+			if (ctd->paged_buffer[pos] != p->framebuf.data[pos]) {
+				ctd->paged_buffer[pos] = p->framebuf.data[pos];
+				ctd->dirty_buffer[pos] = 1;
+			}
 		}
 	}
 
 	/*
-	 * Step 2: Short gaps of unchanged bytes in fact increase the
-	 * communication overhead. So we eliminate them here.
+	 * Step 2: Send the changes. Each write report starts at a changed
+	 * byte and takes in the following ones, as long as the gaps of
+	 * unchanged bytes between are short (they increase the communication
+	 * overhead less than another report) or still fit into the report
+	 * size that is sent anyway.
 	 */
-	for (j = -1, i = 0; i < p->framebuf.size; i++) {
-		if (ctd->dirty_buffer[i] && j >= 0 && i - j <= 4) {
-			/* found a clean gap <= 4 bytes: mark it dirty */
-			for (r = j; r < i; r++)
-				ctd->dirty_buffer[r] = 1;
-		}
-
-		/* if this is dirty, drop the saved position */
-		if (ctd->dirty_buffer[i])
-			j = -1;
-
-		/* save position of this clean entry if no position saved yet */
-		if (!ctd->dirty_buffer[i] && j < 0)
-			j = i;
-	}
+	for (i = 0; i < p->framebuf.size;) {
+		int end;
 
-	/* Step 3: Send the changes. */
-	ctd->tx_buffer.bytes[0] = 0;
-	for (i = 0; i < p->framebuf.size; i++) {
-		if (ctd->dirty_buffer[i]) {
-			/* Start a new packet */
-			if (!ctd->tx_buffer.bytes[0]) {
-				ctd->tx_buffer.bytes[0] = GLCD2USB_RID_WRITE;
-				ctd->tx_buffer.bytes[1] = i % 256;
-				ctd->tx_buffer.bytes[2] = i / 256;
-				ctd->tx_buffer.bytes[3] = 0;	/* length */
-			}
-			/* Append the dirty byte and increase size */
-			ctd->tx_buffer.bytes[4 + ctd->tx_buffer.bytes[3]++] = ctd->paged_buffer[i];
+		if (!ctd->dirty_buffer[i]) {
+			i++;
+			continue;
 		}
 
-		/*
-		 * Send the data if we hit a clean byte, are at the end of
-		 * the frame or reached the maximum payload for a write
-		 * request.
-		 */
-		if (!ctd->dirty_buffer[i] || i == p->framebuf.size - 1 || ctd->tx_buffer.bytes[3] == 128) {
-			/* Only write if there IS something to be written */
-			if (ctd->tx_buffer.bytes[0] == GLCD2USB_RID_WRITE && ctd->tx_buffer.bytes[3] > 0) {
-				err = usbSetReport(ctd->device, USB_HID_REPORT_TYPE_FEATURE,
-						   ctd->tx_buffer.bytes, ctd->tx_buffer.bytes[3] + 4);
-				if (err)
-					p->glcd_functions->drv_report(RPT_ERR, "glcd2usb_blit: error in transfer");
-				/* Start a new packet the next time */
-				ctd->tx_buffer.bytes[0] = 0;
-			}
+		end = i + 1;
+		for (j = end; (j < p->framebuf.size) && (j - i < GLCD2USB_MAX_WRITE); j++) {
+			if (!ctd->dirty_buffer[j])
+				continue;
+			if ((j - end > GLCD2USB_MAX_GAP)
+			    && (j + 1 - i > glcd2usb_report_size(end - i)))
+				break;
+			end = j + 1;
 		}
+
+		ctd->tx_buffer.bytes[0] = GLCD2USB_RID_WRITE;
+		ctd->tx_buffer.bytes[1] = i % 256;
+		ctd->tx_buffer.bytes[2] = i / 256;
+		ctd->tx_buffer.bytes[3] = end - i;	/* length */
+		memcpy(ctd->tx_buffer.bytes + 4, ctd->paged_buffer + i, end - i);
+
+		err = usbSetReport(ctd->device, USB_HID_REPORT_TYPE_FEATURE,
+				   ctd->tx_buffer.bytes, ctd->tx_buffer.bytes[3] + 4);
+		if (err)
+			p->glcd_functions->drv_report(RPT_ERR, "glcd2usb_blit: error in transfer");
+		i = end;
 	}
 }
 
@@ -8,6 +8,8 @@
 #ifndef GLCD_LOW_H
 #define GLCD_LOW_H
 
+#include <string.h>
+
 #define GLCD_DEFAULT_SIZE	"128x64"
 #define GLCD_DEFAULT_CELLWIDTH	6
 #define GLCD_DEFAULT_CELLHEIGHT	8
@@ -19,12 +21,27 @@
 #define GLCD_KEYPAD_MAX			26
 #define GLCD_DEFAULT_REPEAT_DELAY	500	/* milliseconds */
 #define GLCD_DEFAULT_REPEAT_INTERVAL	300	/* milliseconds */
+#define GLCD_DEFAULT_BPP		1
 
 enum fb_types {
 	FB_TYPE_LINEAR = 0,
 	FB_TYPE_VPAGED
 };
 
+/**
+ * An area of the framebuffer that changed since the last blit. Each one
+ * covers a run of bytes within one line of the memory layout: one pixel
+ * row of a FB_TYPE_LINEAR framebuffer (x and width are multiples of the
+ * pixels per byte, except at the right edge), one page of 8 pixel rows of a
+ * FB_TYPE_VPAGED one.
+ */
+struct glcd_rect {
+	int x;			/**< left column */
+	int y;			/**< top row */
+	int width;		/**< width in dots */
+	int height;		/**< height in dots */
+};
+
 /** The framebuffer and its properties */
 struct glcd_framebuf {
 	unsigned char *data;	/**< frame buffer */
@@ -33,12 +50,19 @@ struct glcd_framebuf {
 	int bytesPerLine;	/**< number of bytes per pixel row */
 	int size;		/**< total size in bytes */
 	enum fb_types layout;	/**< memory layout */
+	int bpp;		/**< bits per pixel: 1, or 2 or 4 (gray levels) for FB_TYPE_LINEAR */
+	unsigned char *backingstore;	/**< data as of the last blit */
+	struct glcd_rect *dirty;	/**< areas changed since the last blit */
+	int numDirty;		/**< number of areas in \c dirty */
 };
 
 /** private data for the \c glcd driver */
 typedef struct glcd_private_data {
 	/* framebuffer and size settings */
 	struct glcd_framebuf framebuf;	/**< the main framebuffer */
+	struct glcd_framebuf *drawbuf;	/**< framebuffer drawn into: framebuf,
+					 *   or a FB_TYPE_LINEAR one converted
+					 *   to framebuf on flush */
 	int cellwidth;			/**< character cell width */
 	int cellheight;			/**< character cell height */
 	int width;			/**< display width in characters */
@@ -68,7 +92,11 @@ struct glcdHwFcns {
 	void (*drv_report)(const int level, const char *format,... /* args */ );
 	void (*drv_debug)(const int level, const char *format,... /* args */ );
 
-	/* Transfer the framebuffer to the display */
+	/*
+	 * Transfer the framebuffer to the display. framebuf.dirty lists the
+	 * areas that changed since the last call; there are none if the
+	 * screen is unchanged.
+	 */
 	void (*blit)(PrivateData *p);
 
 	/* Switch the backlight on or off */
@@ -92,10 +120,34 @@ struct glcdHwFcns {
 #define FB_BLACK 1
 #define FB_WHITE 0
 
+/** Darkest gray level of a framebuffer: 1, 3 or 15 */
+#define FB_MAX_LEVEL(fb)	((1 << (fb)->bpp) - 1)
+
+/**
+ * Find a pixel of a FB_TYPE_LINEAR framebuffer. Rows hold the pixels from
+ * left to right, most significant bits first; with more than 1bpp each
+ * pixel holds a gray level from 0 (white) to FB_MAX_LEVEL (black).
+ *
+ * \param fb     Pointer to framebuffer
+ * \param x      X-position
+ * \param y      Y-position
+ * \param shift  Returns the position of the pixel's lowest bit in the byte
+ * \return       Offset of the byte in fb->data
+ */
+static inline unsigned int
+fb_linear_pos(struct glcd_framebuf *fb, int x, int y, int *shift)
+{
+	int bit = x * fb->bpp;
+
+	*shift = 8 - fb->bpp - (bit % 8);
+	return y * fb->bytesPerLine + (bit / 8);
+}
+
 /**
  * Draw one pixel into the framebuffer using 1bpp (black and white). This
  * function actually decides about the format of the framebuffer. Using this
  * implementation (0,0) is top left and bytes contain pixels from left to right.
+ * In a gray level framebuffer black is the darkest level.
  *
  * \param fb     Pointer to framebuffer
  * \param x      X-position
@@ -112,8 +164,10 @@ fb_draw_pixel(struct glcd_framebuf *fb, int x, int y, int color)
 		return;
 
 	if (fb->layout == FB_TYPE_LINEAR) {
-		pos = y * fb->bytesPerLine + (x / 8);
-		bit = 0x80 >> (x % 8);
+		int shift;
+
+		pos = fb_linear_pos(fb, x, y, &shift);
+		bit = FB_MAX_LEVEL(fb) << shift;
 	}
 	else {
 		pos = (y / 8) * fb->px_width + x;
@@ -145,8 +199,11 @@ fb_get_pixel(struct glcd_framebuf *fb, int x, int y)
 		return FB_WHITE;
 
 	if (fb->layout == FB_TYPE_LINEAR) {
-		pos = y * fb->bytesPerLine + (x / 8);
-		bit = 0x80 >> (x % 8);
+		int shift;
+
+		/* the darker half of the gray levels counts as black */
+		pos = fb_linear_pos(fb, x, y, &shift);
+		bit = 1 << (shift + fb->bpp - 1);
 	}
 	else {
 		pos = (y / 8) * fb->px_width + x;
@@ -158,4 +215,290 @@ fb_get_pixel(struct glcd_framebuf *fb, int x, int y)
 	else
 		return FB_WHITE;
 }
+
+
+/**
+ * Get the gray level of one pixel of a FB_TYPE_LINEAR framebuffer.
+ *
+ * \param fb  Pointer to framebuffer
+ * \param x   X-position
+ * \param y   Y-position
+ * \return    Level from 0 (white) to FB_MAX_LEVEL(fb) (black)
+ */
+static inline int
+fb_get_level(struct glcd_framebuf *fb, int x, int y)
+{
+	int shift;
+	unsigned int pos;
+
+	if (x < 0 || x >= fb->px_width || y < 0 || y >= fb->px_height)
+		return 0;
+
+	pos = fb_linear_pos(fb, x, y, &shift);
+	return (fb->data[pos] >> shift) & FB_MAX_LEVEL(fb);
+}
+
+
+/**
+ * Draw a row of pixels from an 8 bit coverage bitmap (0 = white, 255 =
+ * black), as Freetype renders antialiased glyphs, into a FB_TYPE_LINEAR
+ * framebuffer. The coverage is rounded to the framebuffer's gray levels,
+ * so with 1bpp a pixel is black from half coverage on.
+ *
+ * \param fb      Pointer to framebuffer
+ * \param x       X-position of the first pixel
+ * \param y       Y-position
+ * \param levels  The bitmap row, one byte per pixel
+ * \param width   Number of pixels
+ */
+static inline void
+fb_draw_levels(struct glcd_framebuf *fb, int x, int y, const unsigned char *levels, int width)
+{
+	int max = FB_MAX_LEVEL(fb);
+	int col;
+
+	if (y < 0 || y >= fb->px_height)
+		return;
+
+	for (col = 0; col < width; col++) {
+		int px = x + col;
+		int shift;
+		unsigned int pos;
+
+		if (px < 0 || px >= fb->px_width)
+			continue;
+		pos = fb_linear_pos(fb, px, y, &shift);
+		fb->data[pos] = (fb->data[pos] & ~(max << shift))
+			| ((levels[col] * max + 127) / 255) << shift;
+	}
+}
+
+
+/**
+ * Get the bytes of the framebuffer a changed area covers.
+ *
+ * \param fb   Pointer to framebuffer
+ * \param r    One of the areas in fb->dirty
+ * \param len  Returns the number of bytes
+ * \return     Offset of the first byte in fb->data
+ */
+static inline int
+fb_rect_bytes(struct glcd_framebuf *fb, const struct glcd_rect *r, int *len)
+{
+	if (fb->layout == FB_TYPE_LINEAR) {
+		*len = ((r->x + r->width) * fb->bpp + 7) / 8 - r->x * fb->bpp / 8;
+		return r->y * fb->bytesPerLine + r->x * fb->bpp / 8;
+	}
+	*len = r->width;
+	return (r->y / 8) * fb->px_width + r->x;
+}
+
+
+/**
+ * Fill a rectangle of the framebuffer with one color. Whole bytes are
+ * written at once, only the bytes at the edges of the rectangle need
+ * masking. Parts outside the framebuffer are clipped.
+ *
+ * \param fb      Pointer to framebuffer
+ * \param x       X-position of the left column
+ * \param y       Y-position of the top row
+ * \param width   Width in pixels
+ * \param height  Height in pixels
+ * \param color   Pixel color: 1 = set (black), 0 = not set (blank/white)
+ */
+static inline void
+fb_draw_box(struct glcd_framebuf *fb, int x, int y, int width, int height, int color)
+{
+	unsigned char fill = (color == FB_BLACK) ? 0xFF : 0x00;
+	unsigned char mask;
+	int x2, y2;
+	int i, j;
+
+	if (x < 0) {
+		width += x;
+		x = 0;
+	}
+	if (y < 0) {
+		height += y;
+		y = 0;
+	}
+	x2 = (x + width > fb->px_width) ? fb->px_width : x + width;
+	y2 = (y + height > fb->px_height) ? fb->px_height : y + height;
+	if ((x >= x2) || (y >= y2))
+		return;
+
+	if (fb->layout == FB_TYPE_LINEAR) {
+		/* black is all bits set at any depth, so work in bits */
+		int bx = x * fb->bpp;
+		int bx2 = x2 * fb->bpp;
+		int first = bx / 8;
+		int last = (bx2 - 1) / 8;
+		unsigned char lmask = 0xFF >> (bx % 8);
+		unsigned char rmask = 0xFF << (7 - (bx2 - 1) % 8);
+
+		if (first == last)
+			lmask = rmask = lmask & rmask;
+		for (j = y; j < y2; j++) {
+			unsigned char *row = fb->data + j * fb->bytesPerLine;
+
+			row[first] = (row[first] & ~lmask) | (fill & lmask);
+			if (last > first) {
+				memset(row + first + 1, fill, last - first - 1);
+				row[last] = (row[last] & ~rmask) | (fill & rmask);
+			}
+		}
+	}
+	else {
+		for (j = y; j < y2; j = (j / 8 + 1) * 8) {
+			unsigned char *page = fb->data + (j / 8) * fb->px_width;
+			int end = ((j / 8 + 1) * 8 < y2) ? (j / 8 + 1) * 8 : y2;
+
+			mask = (0xFF >> (8 - (end - j))) << (j % 8);
+			if (mask == 0xFF) {
+				memset(page + x, fill, x2 - x);
+				continue;
+			}
+			for (i = x; i < x2; i++)
+				page[i] = (page[i] & ~mask) | (fill & mask);
+		}
+	}
+}
+
+
+/**
+ * Draw a row of pixels from a 1bpp bitmap whose bytes hold pixels from left
+ * to right (most significant bit first), as Freetype renders them. Pixels
+ * are set or cleared according to the bitmap.
+ *
+ * \param fb     Pointer to framebuffer
+ * \param x      X-position of the first pixel
+ * \param y      Y-position
+ * \param bits   The bitmap row
+ * \param width  Number of pixels
+ */
+static inline void
+fb_draw_hbits(struct glcd_framebuf *fb, int x, int y, const unsigned char *bits, int width)
+{
+	int col;
+
+	if (y < 0 || y >= fb->px_height)
+		return;
+
+	if ((fb->layout == FB_TYPE_LINEAR) && (fb->bpp > 1)) {
+		for (col = 0; col < width; col++)
+			fb_draw_pixel(fb, x + col, y, (bits[col / 8] >> (7 - (col % 8))) & 1);
+	}
+	else if (fb->layout == FB_TYPE_LINEAR) {
+		unsigned char *row = fb->data + y * fb->bytesPerLine;
+
+		for (col = 0; col < width; col += 8) {
+			int n = (width - col < 8) ? width - col : 8;
+			int px = x + col;
+			unsigned char mask = 0xFF << (8 - n);
+			unsigned char src = bits[col / 8] & mask;
+			int shift, pos;
+
+			if ((px < 0) || (px + n > fb->px_width)) {
+				int i;
+
+				/* the edges of the framebuffer: pixel by pixel */
+				for (i = 0; i < n; i++)
+					fb_draw_pixel(fb, px + i, y, (src >> (7 - i)) & 1);
+				continue;
+			}
+			shift = px % 8;
+			pos = px / 8;
+			row[pos] = (row[pos] & ~(mask >> shift)) | (src >> shift);
+			if (shift + n > 8) {
+				unsigned char m = mask << (8 - shift);
+
+				row[pos + 1] = (row[pos + 1] & ~m) | (unsigned char) (src << (8 - shift));
+			}
+		}
+	}
+	else {
+		unsigned char *page = fb->data + (y / 8) * fb->px_width;
+		unsigned char bit = 1 << (y % 8);
+
+		for (col = 0; col < width; col++) {
+			int px = x + col;
+
+			if (px < 0 || px >= fb->px_width)
+				continue;
+			if ((bits[col / 8] >> (7 - (col % 8))) & 1)
+				page[px] |= bit;
+			else
+				page[px] &= ~bit;
+		}
+	}
+}
+
+
+/**
+ * Draw a column of pixels from a bitmap whose bytes hold pixels from top to
+ * bottom (least significant bit first), like the big number font. Pixels
+ * are set or cleared according to the bitmap.
+ *
+ * \param fb      Pointer to framebuffer
+ * \param x       X-position
+ * \param y       Y-position of the first pixel
+ * \param bits    The bitmap column
+ * \param height  Number of pixels
+ */
+static inline void
+fb_draw_vbits(struct glcd_framebuf *fb, int x, int y, const unsigned char *bits, int height)
+{
+	int row;
+
+	if (x < 0 || x >= fb->px_width)
+		return;
+
+	if (fb->layout == FB_TYPE_VPAGED) {
+		for (row = 0; row < height; row += 8) {
+			int n = (height - row < 8) ? height - row : 8;
+			int py = y + row;
+			unsigned char mask = 0xFF >> (8 - n);
+			unsigned char src = bits[row / 8] & mask;
+			unsigned char *data;
+			int shift;
+
+			if ((py < 0) || (py + n > fb->px_height)) {
+				int i;
+
+				/* the edges of the framebuffer: pixel by pixel */
+				for (i = 0; i < n; i++)
+					fb_draw_pixel(fb, x, py + i, (src >> i) & 1);
+				continue;
+			}
+			shift = py % 8;
+			data = fb->data + (py / 8) * fb->px_width + x;
+			*data = (*data & ~(mask << shift)) | (unsigned char) (src << shift);
+			if (shift + n > 8) {
+				unsigned char m = mask >> (8 - shift);
+
+				data[fb->px_width] = (data[fb->px_width] & ~m) | (src >> (8 - shift));
+			}
+		}
+	}
+	else if (fb->bpp > 1) {
+		for (row = 0; row < height; row++)
+			fb_draw_pixel(fb, x, y + row, (bits[row / 8] >> (row % 8)) & 1);
+	}
+	else {
+		unsigned char bit = 0x80 >> (x % 8);
+
+		for (row = 0; row < height; row++) {
+			int py = y + row;
+			unsigned char *data;
+
+			if (py < 0 || py >= fb->px_height)
+				continue;
+			data = fb->data + py * fb->bytesPerLine + x / 8;
+			if ((bits[row / 8] >> (row % 8)) & 1)
+				*data |= bit;
+			else
+				*data &= ~bit;
+		}
+	}
+}
 #endif
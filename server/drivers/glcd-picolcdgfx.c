@@ -57,8 +57,6 @@ typedef struct glcd_picolcdgfx_data {
 	usb_dev_handle *lcd;
 	unsigned char inverted;
 	int keytimeout;
-
-	unsigned char *backingstore;
 } CT_picolcdgfx_data;
 
 /* Prototypes */
@@ -126,17 +124,6 @@ glcd_picolcdgfx_init(Driver *drvthis)
 	/* Since the display is fixed to 256x64 we have to recalculate. */
 	p->framebuf.size = (PICOLCDGFX_HEIGHT / 8) * PICOLCDGFX_WIDTH;
 
-	ct_data->backingstore = malloc(p->framebuf.size);
-	if (ct_data->backingstore == NULL) {
-		report(RPT_ERR, "GLCD/picolcdgfx: unable to allocate backing store");
-		return -1;
-	}
-
-	/* framebuf is initialized with 0x00 so initialize the backingstore with
-	 * 0xFF so the first call to _blit will draw the entire screen.
-	 * */
-	memset(ct_data->backingstore, 0xFF, p->framebuf.size);
-
 	/* Get key timeout */
 	ct_data->keytimeout = drvthis->config_get_int(drvthis->name,
 						      "picolcdgfx_KeyTimeout", 0,
@@ -231,14 +218,33 @@ glcd_picolcdgfx_blit(PrivateData *p)
 	int offset;
 	int index;
 	unsigned char cs, line;		/* controller and page */
+	unsigned char changed[PICOLCDGFX_HEIGHT / 8] = {0};	/* halves to update per page */
+	int i, half;
+
+	/*
+	 * Each controller drives 64 columns, and a report carries 32 of them.
+	 * Find the halves of the controllers' pages that have changes.
+	 */
+	for (i = 0; i < p->framebuf.numDirty; i++) {
+		struct glcd_rect *r = &p->framebuf.dirty[i];
+
+		for (half = r->x / 32; half <= (r->x + r->width - 1) / 32; half++)
+			changed[r->y / 8] |= 1 << half;
+	}
 
 	for (cs = 0; cs < 4; cs++) {
 		unsigned char chipsel = (cs << 2);
 		for (line = 0; line < 8; line++) {
-			offset = line * PICOLCDGFX_WIDTH + cs * 64;
-			if (memcmp((p->framebuf.data) + offset, (ct_data->backingstore) + offset, 64) == 0)
+			int halves = (changed[line] >> (cs * 2)) & 0x03;
+
+			if (halves == 0)
 				continue;
 
+			/* An unchanged first half is skipped by starting at column 32 */
+			offset = line * PICOLCDGFX_WIDTH + cs * 64;
+			if (halves == 0x02)
+				offset += 32;
+
 			cmd3[0] = PICOLCDGFX_OUT_CMD_DATA;
 			cmd3[1] = chipsel;
 			cmd3[2] = 0x02;
@@ -247,31 +253,31 @@ glcd_picolcdgfx_blit(PrivateData *p)
 			cmd3[5] = 0xb8 | line;
 			cmd3[6] = 0x00;
 			cmd3[7] = 0x00;
-			cmd3[8] = 0x40;
+			cmd3[8] = 0x40 | ((halves == 0x02) ? 32 : 0);
 			cmd3[9] = 0x00;
 			cmd3[10] = 0x00;
 			cmd3[11] = 32;
 
-			cmd4[0] = PICOLCDGFX_OUT_DATA;
-			cmd4[1] = chipsel | 0x01;
-			cmd4[2] = 0x00;
-			cmd4[3] = 0x00;
-			cmd4[4] = 32;
-
 			for (index = 0; index < 32; index++) {
 				cmd3[12 + index] = *((p->framebuf.data) + offset + index) ^ ct_data->inverted;
 			}
+			picolcdgfx_write(ct_data->lcd, cmd3, 44);
 
-			for (index = 32; index < 64; index++) {
-				cmd4[5 + (index - 32)] = *((p->framebuf.data) + offset + index) ^ ct_data->inverted;
-			}
+			/* The second half follows the first one */
+			if (halves == 0x03) {
+				cmd4[0] = PICOLCDGFX_OUT_DATA;
+				cmd4[1] = chipsel | 0x01;
+				cmd4[2] = 0x00;
+				cmd4[3] = 0x00;
+				cmd4[4] = 32;
 
-			picolcdgfx_write(ct_data->lcd, cmd3, 44);
-			picolcdgfx_write(ct_data->lcd, cmd4, 37);
+				for (index = 32; index < 64; index++) {
+					cmd4[5 + (index - 32)] = *((p->framebuf.data) + offset + index) ^ ct_data->inverted;
+				}
+				picolcdgfx_write(ct_data->lcd, cmd4, 37);
+			}
 		}
 	}
-
-	memcpy(ct_data->backingstore, p->framebuf.data, p->framebuf.size);
 }
 
 /**
@@ -288,9 +294,6 @@ glcd_picolcdgfx_close(PrivateData *p)
 			usb_close(ct_data->lcd);
 		}
 
-		if (ct_data->backingstore != NULL)
-			free(ct_data->backingstore);
-
 		free(p->ct_data);
 		p->ct_data = NULL;
 	}
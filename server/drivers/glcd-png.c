@@ -1,6 +1,12 @@
 /** \file server/drivers/glcd-png.c
  * This driver writes the framebuffer content to PNG images as
- * /tmp/lcdproc######.png.
+ * /tmp/lcdproc######.png, or to a single file that is replaced on every
+ * change. Instead of PNG it can write PGM images, or keep a PGM image in a
+ * file that is mapped into memory and updated in place.
+ *
+ * Compressing a PNG image takes some time, so where threads are available
+ * the images are written by a thread of their own. If that thread is still
+ * busy when the next frame comes, only the latest frame is written.
  */
 
 /*-
@@ -18,9 +24,16 @@
 #include <errno.h>
 #include <stdio.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
+#include <strings.h>
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_LIBPTHREAD)
+# define USE_THREADS
+# include <pthread.h>
+#endif
 
 #include <png.h>
 
@@ -28,15 +41,318 @@
 #include "shared/report.h"
 #include "glcd-low.h"
 
-/* Prototypes */
-void glcd_png_blit(PrivateData *p);
-void glcd_png_close(PrivateData *p);
+#define PNG_DEF_FORMAT		"png"
+#define PNG_DEF_COMPRESSION	6
+#define PNG_DEF_MMAP_FILE	"/tmp/lcdproc.pgm"
+
+/** Kinds of output */
+enum glcd_png_format {
+	GLCD_PNG_FORMAT_PNG,		/**< PNG files */
+	GLCD_PNG_FORMAT_PGM,		/**< binary PGM files */
+	GLCD_PNG_FORMAT_MMAP		/**< a PGM file updated in place */
+};
 
 /** Private data for the PNG connection type */
 typedef struct glcd_png_data {
-	unsigned char *backingstore;	/**< backing buffer */
+	enum glcd_png_format format;	/**< kind of output */
+	int level;		/**< zlib compression level of PNG images */
+	char file[256];		/**< file to replace; empty for numbered files */
+	int num;		/**< number of the next numbered file */
+
+	unsigned char *map;	/**< the mapped PGM file */
+	size_t map_size;	/**< its size */
+	int map_header;		/**< size of its header */
+
+#ifdef USE_THREADS
+	int threaded;		/**< the images are written by the thread */
+	pthread_t thread;	/**< the thread writing the images */
+	pthread_mutex_t lock;	/**< protects pending, have_frame and stop */
+	pthread_cond_t cond;	/**< signals a new frame or stop */
+	unsigned char *pending;	/**< the latest frame, not yet taken by the thread */
+	int have_frame;		/**< pending holds a frame */
+	int stop;		/**< the thread shall end */
+	unsigned char *frame;	/**< the frame the thread writes */
+#endif
 } CT_png_data;
 
+/* Prototypes */
+void glcd_png_blit(PrivateData *p);
+void glcd_png_close(PrivateData *p);
+
+/**
+ * Make the name of the file to write the next image to.
+ * \param ct_data  Connection type's private data.
+ * \param buf      Buffer for the name.
+ * \param size     Size of the buffer.
+ */
+static void
+glcd_png_filename(CT_png_data *ct_data, char *buf, size_t size)
+{
+	if (ct_data->file[0] != '\0')
+		snprintf(buf, size, "%s", ct_data->file);
+	else
+		snprintf(buf, size, "/tmp/lcdproc%06d.%s", ct_data->num++,
+			 (ct_data->format == GLCD_PNG_FORMAT_PNG) ? "png" : "pgm");
+}
+
+/**
+ * Write a frame as PNG image.
+ * \param p     Pointer to glcd driver's private date structure.
+ * \param fp    File to write to.
+ * \param data  The frame, in the layout of the framebuffer.
+ * \retval 0    Success.
+ * \retval <0   Error.
+ */
+static int
+glcd_png_write_png(PrivateData *p, FILE *fp, unsigned char *data)
+{
+	CT_png_data *ct_data = (CT_png_data *) p->ct_data;
+	int row;
+	png_structp png_ptr;
+	png_infop info_ptr;
+	png_bytep row_pointer;
+
+	/* initialize stuff */
+	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	if (!png_ptr) {
+		p->glcd_functions->drv_debug(RPT_ERR, "png_create_write_struct failed");
+		return -1;
+	}
+
+	info_ptr = png_create_info_struct(png_ptr);
+	if (!info_ptr) {
+		p->glcd_functions->drv_debug(RPT_ERR, "png_create_info_struct failed");
+		png_destroy_write_struct(&png_ptr, (png_infopp) NULL);
+		return -1;
+	}
+
+	if (setjmp(png_jmpbuf(png_ptr))) {
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+		return -1;
+	}
+
+	png_init_io(png_ptr, fp);
+	png_set_compression_level(png_ptr, ct_data->level);
+
+	png_set_IHDR(png_ptr, info_ptr, p->framebuf.px_width, p->framebuf.px_height,
+		     p->framebuf.bpp, PNG_COLOR_TYPE_GRAY, PNG_INTERLACE_NONE,
+		     PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+	/* The framebuffer has set (dark) pixels as high levels, PNG as low */
+	png_set_invert_mono(png_ptr);
+
+	png_write_info(png_ptr, info_ptr);
+
+	/* Write the image row by row */
+	row_pointer = data;
+	for (row = 0; row < p->framebuf.px_height; row++) {
+		png_write_row(png_ptr, row_pointer);
+		row_pointer += p->framebuf.bytesPerLine;
+	}
+
+	png_write_end(png_ptr, NULL);
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+	return 0;
+}
+
+/**
+ * Convert a row of a frame to PGM pixels: 0 for set pixels, 255 for unset
+ * ones, and the grays between for the levels of a grayscale framebuffer.
+ * \param p     Pointer to glcd driver's private date structure.
+ * \param src   The row, in the layout of the framebuffer.
+ * \param dest  Buffer for px_width pixels.
+ */
+static void
+glcd_png_pgm_row(PrivateData *p, const unsigned char *src, unsigned char *dest)
+{
+	int bpp = p->framebuf.bpp;
+	int max = FB_MAX_LEVEL(&p->framebuf);
+	int x;
+
+	if (bpp == 1) {
+		for (x = 0; x < p->framebuf.px_width; x++)
+			dest[x] = (src[x / 8] & (0x80 >> (x % 8))) ? 0 : 255;
+		return;
+	}
+
+	for (x = 0; x < p->framebuf.px_width; x++) {
+		int shift = 8 - bpp - (x * bpp) % 8;
+		int level = (src[x * bpp / 8] >> shift) & max;
+
+		dest[x] = 255 - level * 255 / max;
+	}
+}
+
+/**
+ * Write a frame as binary PGM image.
+ * \param p     Pointer to glcd driver's private date structure.
+ * \param fp    File to write to.
+ * \param data  The frame, in the layout of the framebuffer.
+ * \retval 0    Success.
+ * \retval <0   Error.
+ */
+static int
+glcd_png_write_pgm(PrivateData *p, FILE *fp, unsigned char *data)
+{
+	unsigned char row[GLCD_MAX_WIDTH];
+	int y;
+
+	fprintf(fp, "P5\n%d %d\n255\n", p->framebuf.px_width, p->framebuf.px_height);
+	for (y = 0; y < p->framebuf.px_height; y++) {
+		glcd_png_pgm_row(p, data + y * p->framebuf.bytesPerLine, row);
+		if (fwrite(row, p->framebuf.px_width, 1, fp) != 1)
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * Write a frame to the next file. It is first written to a temporary file
+ * that is then renamed, so whoever reads the files never sees a partial
+ * image.
+ * \param p     Pointer to glcd driver's private date structure.
+ * \param data  The frame, in the layout of the framebuffer.
+ */
+static void
+glcd_png_write_frame(PrivateData *p, unsigned char *data)
+{
+	CT_png_data *ct_data = (CT_png_data *) p->ct_data;
+	char filename[256];
+	char tmpname[sizeof(filename) + 4];
+	FILE *fp;
+	int res;
+
+	glcd_png_filename(ct_data, filename, sizeof(filename));
+	snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename);
+
+	fp = fopen(tmpname, "wb");
+	if (!fp) {
+		p->glcd_functions->drv_debug(RPT_ERR, "File %s could not be opened for writing", tmpname);
+		return;
+	}
+
+	if (ct_data->format == GLCD_PNG_FORMAT_PNG)
+		res = glcd_png_write_png(p, fp, data);
+	else
+		res = glcd_png_write_pgm(p, fp, data);
+
+	if ((fclose(fp) != 0) || (res < 0)) {
+		p->glcd_functions->drv_debug(RPT_ERR, "Error writing image %s", filename);
+		unlink(tmpname);
+		return;
+	}
+	if (rename(tmpname, filename) < 0) {
+		p->glcd_functions->drv_debug(RPT_ERR, "Cannot rename %s: %s", tmpname, strerror(errno));
+		unlink(tmpname);
+	}
+}
+
+/**
+ * Create the PGM file and map it into memory.
+ * \param p     Pointer to glcd driver's private date structure.
+ * \retval 0    Success.
+ * \retval <0   Error.
+ */
+static int
+glcd_png_map_file(PrivateData *p)
+{
+	CT_png_data *ct_data = (CT_png_data *) p->ct_data;
+	char header[32];
+	int fd;
+
+	ct_data->map_header = snprintf(header, sizeof(header), "P5\n%d %d\n255\n",
+				       p->framebuf.px_width, p->framebuf.px_height);
+	ct_data->map_size = ct_data->map_header
+		+ (size_t) p->framebuf.px_width * p->framebuf.px_height;
+
+	fd = open(ct_data->file, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		report(RPT_ERR, "GLCD/png: cannot open %s: %s", ct_data->file, strerror(errno));
+		return -1;
+	}
+	if (ftruncate(fd, ct_data->map_size) < 0) {
+		report(RPT_ERR, "GLCD/png: cannot resize %s: %s", ct_data->file, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	ct_data->map = mmap(NULL, ct_data->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ct_data->map == MAP_FAILED) {
+		ct_data->map = NULL;
+		report(RPT_ERR, "GLCD/png: cannot map %s: %s", ct_data->file, strerror(errno));
+		return -1;
+	}
+
+	memcpy(ct_data->map, header, ct_data->map_header);
+	memset(ct_data->map + ct_data->map_header, 255, ct_data->map_size - ct_data->map_header);
+	return 0;
+}
+
+#ifdef USE_THREADS
+/**
+ * The thread writing the images. It waits for a frame, takes it and
+ * writes it while the next one may already be put into pending.
+ * \param arg  Pointer to glcd driver's private date structure.
+ * \return     NULL.
+ */
+static void *
+glcd_png_writer(void *arg)
+{
+	PrivateData *p = (PrivateData *) arg;
+	CT_png_data *ct_data = (CT_png_data *) p->ct_data;
+	unsigned char *swap;
+
+	pthread_mutex_lock(&ct_data->lock);
+	while (1) {
+		while (!ct_data->have_frame && !ct_data->stop)
+			pthread_cond_wait(&ct_data->cond, &ct_data->lock);
+		/* the last frame is still written when stopping */
+		if (!ct_data->have_frame)
+			break;
+
+		swap = ct_data->frame;
+		ct_data->frame = ct_data->pending;
+		ct_data->pending = swap;
+		ct_data->have_frame = 0;
+
+		pthread_mutex_unlock(&ct_data->lock);
+		glcd_png_write_frame(p, ct_data->frame);
+		pthread_mutex_lock(&ct_data->lock);
+	}
+	pthread_mutex_unlock(&ct_data->lock);
+	return NULL;
+}
+
+/**
+ * Start the thread writing the images.
+ * \param p     Pointer to glcd driver's private date structure.
+ * \retval 0    Success.
+ * \retval <0   Error.
+ */
+static int
+glcd_png_start_writer(PrivateData *p)
+{
+	CT_png_data *ct_data = (CT_png_data *) p->ct_data;
+	int err;
+
+	ct_data->pending = malloc(p->framebuf.size);
+	ct_data->frame = malloc(p->framebuf.size);
+	if ((ct_data->pending == NULL) || (ct_data->frame == NULL))
+		return -1;
+
+	pthread_mutex_init(&ct_data->lock, NULL);
+	pthread_cond_init(&ct_data->cond, NULL);
+	err = pthread_create(&ct_data->thread, NULL, glcd_png_writer, p);
+	if (err != 0) {
+		report(RPT_WARNING, "GLCD/png: pthread_create() - %s", strerror(err));
+		pthread_cond_destroy(&ct_data->cond);
+		pthread_mutex_destroy(&ct_data->lock);
+		return -1;
+	}
+	ct_data->threaded = 1;
+	return 0;
+}
+#endif
+
 /**
  * API: Initialize the connection type driver.
  * \param drvthis  Pointer to driver structure.
@@ -48,6 +364,7 @@ glcd_png_init(Driver *drvthis)
 {
 	PrivateData *p = (PrivateData *)drvthis->private_data;
 	CT_png_data *ct_data;
+	const char *s;
 
 	report(RPT_INFO, "GLCD/png: intializing");
 
@@ -63,12 +380,43 @@ glcd_png_init(Driver *drvthis)
 	}
 	p->ct_data = ct_data;
 
-	ct_data->backingstore = malloc(p->framebuf.size);
-	if (ct_data->backingstore == NULL) {
-		report(RPT_ERR, "GLCD/png: unable to allocate backing store");
-		return -1;
+	/* Get output format */
+	s = drvthis->config_get_string(drvthis->name, "png_Format", 0, PNG_DEF_FORMAT);
+	if (strcasecmp(s, "png") == 0)
+		ct_data->format = GLCD_PNG_FORMAT_PNG;
+	else if (strcasecmp(s, "pgm") == 0)
+		ct_data->format = GLCD_PNG_FORMAT_PGM;
+	else if (strcasecmp(s, "mmap") == 0)
+		ct_data->format = GLCD_PNG_FORMAT_MMAP;
+	else {
+		report(RPT_WARNING, "GLCD/png: unknown png_Format %s; using default %s",
+		       s, PNG_DEF_FORMAT);
+		ct_data->format = GLCD_PNG_FORMAT_PNG;
 	}
-	memset(ct_data->backingstore, 0x00, p->framebuf.size);
+
+	/* Get compression level */
+	ct_data->level = drvthis->config_get_int(drvthis->name, "png_CompressionLevel",
+						 0, PNG_DEF_COMPRESSION);
+	if ((ct_data->level < 0) || (ct_data->level > 9)) {
+		report(RPT_WARNING, "GLCD/png: png_CompressionLevel must be between 0 and 9; using default %d",
+		       PNG_DEF_COMPRESSION);
+		ct_data->level = PNG_DEF_COMPRESSION;
+	}
+
+	/* Get the file to replace, if any */
+	s = drvthis->config_get_string(drvthis->name, "png_File", 0,
+				       (ct_data->format == GLCD_PNG_FORMAT_MMAP) ? PNG_DEF_MMAP_FILE : "");
+	strncpy(ct_data->file, s, sizeof(ct_data->file));
+	ct_data->file[sizeof(ct_data->file) - 1] = '\0';
+
+	if (ct_data->format == GLCD_PNG_FORMAT_MMAP) {
+		if (glcd_png_map_file(p) < 0)
+			return -1;
+	}
+#ifdef USE_THREADS
+	else if (glcd_png_start_writer(p) < 0)
+		report(RPT_WARNING, "GLCD/png: writing images on the render thread");
+#endif
 
 	debug(RPT_DEBUG, "GLCD/png: init() done");
 
@@ -83,76 +431,39 @@ void
 glcd_png_blit(PrivateData *p)
 {
 	CT_png_data *ct_data = (CT_png_data *) p->ct_data;
-	char filename[256];
-	static int num = 0;
-	int row;
-	FILE *fp;
-	png_structp png_ptr;
-	png_infop info_ptr;
-	png_bytep row_pointer;
+	int i;
 
 	/* Check if framebufer has changed. If not there's nothing to do */
-	if (memcmp(p->framebuf.data, ct_data->backingstore, p->framebuf.size) == 0)
+	if (p->framebuf.numDirty == 0)
 		return;
 
-	snprintf(filename, sizeof(filename), "/tmp/lcdproc%06d.png", num++);
-	fp = fopen(filename, "wb");
-	if (!fp) {
-		p->glcd_functions->drv_debug(RPT_ERR, "File %s could not be opened for writing", filename);
-		return;
-	}
+	/* Update the changed rows of the mapped file */
+	if (ct_data->map != NULL) {
+		for (i = 0; i < p->framebuf.numDirty; i++) {
+			struct glcd_rect *r = &p->framebuf.dirty[i];
+			int y;
 
-	/* initialize stuff */
-	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-	if (!png_ptr) {
-		p->glcd_functions->drv_debug(RPT_ERR, "png_create_write_struct failed");
-		fclose(fp);
+			for (y = r->y; y < r->y + r->height; y++)
+				glcd_png_pgm_row(p, p->framebuf.data + y * p->framebuf.bytesPerLine,
+					    ct_data->map + ct_data->map_header
+					    + y * p->framebuf.px_width);
+		}
 		return;
 	}
 
-	info_ptr = png_create_info_struct(png_ptr);
-	if (!info_ptr) {
-		p->glcd_functions->drv_debug(RPT_ERR, "png_create_info_struct failed");
-		png_destroy_write_struct(&png_ptr, (png_infopp) NULL);
-		fclose(fp);
+#ifdef USE_THREADS
+	/* Hand the frame to the thread; one it has not taken yet is dropped */
+	if (ct_data->threaded) {
+		pthread_mutex_lock(&ct_data->lock);
+		memcpy(ct_data->pending, p->framebuf.data, p->framebuf.size);
+		ct_data->have_frame = 1;
+		pthread_cond_signal(&ct_data->cond);
+		pthread_mutex_unlock(&ct_data->lock);
 		return;
 	}
+#endif
 
-	if (setjmp(png_jmpbuf(png_ptr)))
-		goto err_out;
-
-	png_init_io(png_ptr, fp);
-
-	png_set_IHDR(png_ptr, info_ptr, p->framebuf.px_width, p->framebuf.px_height,
-		     1, PNG_COLOR_TYPE_GRAY, PNG_INTERLACE_NONE,
-		     PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
-	png_set_invert_mono(png_ptr);
-
-	png_write_info(png_ptr, info_ptr);
-
-	/* Write the image row by row */
-	row_pointer = p->framebuf.data;
-	for (row = 0; row < p->framebuf.px_height; row++) {
-		png_write_row(png_ptr, row_pointer);
-		row_pointer += p->framebuf.bytesPerLine;
-	}
-
-	png_write_end(png_ptr, NULL);
-	fclose(fp);
-	fp = NULL;
-	png_destroy_write_struct(&png_ptr, &info_ptr);
-
-	memcpy(ct_data->backingstore, p->framebuf.data, p->framebuf.size);
-
-	return;
-
-err_out:
-	p->glcd_functions->drv_debug(RPT_ERR, "Error writing PNG image");
-	if (fp != NULL)
-		fclose(fp);
-	if (png_ptr != NULL)
-		png_destroy_write_struct(&png_ptr, &info_ptr);
-	return;
+	glcd_png_write_frame(p, p->framebuf.data);
 }
 
 /**
@@ -165,8 +476,22 @@ glcd_png_close(PrivateData *p)
 	if (p->ct_data != NULL) {
 		CT_png_data *ct_data = (CT_png_data *) p->ct_data;
 
-		if (ct_data->backingstore != NULL)
-			free(ct_data->backingstore);
+#ifdef USE_THREADS
+		if (ct_data->threaded) {
+			pthread_mutex_lock(&ct_data->lock);
+			ct_data->stop = 1;
+			pthread_cond_signal(&ct_data->cond);
+			pthread_mutex_unlock(&ct_data->lock);
+			pthread_join(ct_data->thread, NULL);
+			pthread_cond_destroy(&ct_data->cond);
+			pthread_mutex_destroy(&ct_data->lock);
+		}
+		free(ct_data->pending);
+		free(ct_data->frame);
+#endif
+
+		if (ct_data->map != NULL)
+			munmap(ct_data->map, ct_data->map_size);
 
 		free(p->ct_data);
 		p->ct_data = NULL;
@@ -32,16 +32,52 @@
 #include "shared/defines.h"
 
 #ifdef HAVE_FT2
+/** Number of rendered glyphs kept by the Freetype renderer */
+#define GLYPH_CACHE_SIZE	256
+
+/**
+ * A glyph rendered by Freetype. Text and big numbers are drawn from these,
+ * so each character is rendered only once per size.
+ */
+typedef struct glcd_glyph {
+	int c;				/**< Character code */
+	int size;			/**< Pixel size it was rendered at; 0 if unused */
+	int width;			/**< Width of the bitmap in pixels */
+	int rows;			/**< Height of the bitmap in pixels */
+	int pitch;			/**< Bytes per row of the bitmap */
+	int left;			/**< Horizontal offset of the bitmap from the pen */
+	int top;			/**< Rows of the bitmap above the baseline */
+	int descender;			/**< Descender of the font at this size in pixels */
+	int gray;			/**< Bitmap has 8 bit coverage, not 1bpp */
+	unsigned char *bits;		/**< 1bpp bitmap, most significant bit left,
+					 *   or one coverage byte per pixel */
+} GlyphCache;
+
 /** Configuration for the Freetype renderer */
 typedef struct glcd_render_data {
 	FT_Library ft_library;		/**< freetype library handle */
 	FT_Face ft_normal_font;		/**< handle for the normal font */
 	char ft_has_icons;		/**< flag is the font has icons */
+	int ft_size;			/**< pixel size set for the font */
+	GlyphCache glyphs[GLYPH_CACHE_SIZE];	/**< the rendered glyphs */
 } RenderConfig;
 
 static int icon2unicode(int icon);
 #endif
 
+/** Bytes per row of a big digit in the atlas: the widest one is 16 pixels */
+#define BIGNUM_PITCH	2
+
+/**
+ * The built-in big digits converted from their column format to rows, most
+ * significant bit left, so drawing one is a few masked byte writes per row
+ * instead of setting its pixels one by one.
+ */
+static unsigned char bignum_atlas[nr_chrs_NUM][chr_hgt_NUM][BIGNUM_PITCH];
+static int bignum_atlas_ready = 0;
+
+static void glcd_render_bignum_atlas(void);
+
 
 /**
  * Initializes rendering code. Any rendering related configuration settings
@@ -61,6 +97,8 @@ glcd_render_init(Driver *drvthis)
 
 	debug(RPT_DEBUG, "%s: render_init()", drvthis->name);
 
+	glcd_render_bignum_atlas();
+
 #ifdef HAVE_FT2
 	int rc;
 	const char *tmp;
@@ -75,6 +113,7 @@ glcd_render_init(Driver *drvthis)
 		return -1;
 	}
 	p->render_config = rconf;
+	rconf->ft_size = -1;
 
 	/* use_ft2 is available in PrivateDate for easy use! */
 	p->use_ft2 = drvthis->config_get_bool(drvthis->name, "useFT2", 0, 1);
@@ -149,6 +188,10 @@ glcd_render_close(Driver *drvthis)
 	RenderConfig *rconf = p->render_config;
 
 	if (rconf != NULL) {
+		int i;
+
+		for (i = 0; i < GLYPH_CACHE_SIZE; i++)
+			free(rconf->glyphs[i].bits);
 		if (rconf->ft_normal_font != NULL)
 			FT_Done_Face(rconf->ft_normal_font);
 		if (rconf->ft_library != NULL)
@@ -162,6 +205,82 @@ glcd_render_close(Driver *drvthis)
 
 
 #ifdef HAVE_FT2
+/**
+ * Gets a glyph rendered at the given size, from the cache if it is there.
+ * Otherwise Freetype renders it, and it replaces the glyph that had its
+ * place in the cache.
+ *
+ * \param drvthis  Pointer to driver structure.
+ * \param c        Character code.
+ * \param size     Pixel size.
+ * \return         The glyph; NULL on error.
+ */
+static GlyphCache *
+glcd_render_glyph(Driver *drvthis, int c, int size)
+{
+	PrivateData *p = drvthis->private_data;
+	RenderConfig *rconf = p->render_config;
+	GlyphCache *g = &rconf->glyphs[((unsigned int) c * 31 + size) % GLYPH_CACHE_SIZE];
+	FT_GlyphSlot glyph;
+	FT_Bitmap *bitmap;
+	unsigned char *bits;
+	int row, pitch;
+	int gray = (p->framebuf.bpp > 1);
+	int rc;
+
+	if ((g->size == size) && (g->c == c))
+		return g;
+
+	/*
+	 * Set the font size. We set the font pixel width and height to the
+	 * same value (size), otherwise characters look too much condensed.
+	 */
+	if (rconf->ft_size != size) {
+		debug(RPT_INFO, "%s: Setting font size to %d",  drvthis->name, size);
+		rc = FT_Set_Pixel_Sizes(rconf->ft_normal_font, size, size);
+		if (rc != 0) {
+			report(RPT_ERR, "%s: Failed to set pixel size (%dx%x)", drvthis->name,
+			       p->cellwidth, p->cellheight);
+			return NULL;
+		}
+
+		rconf->ft_size = size;
+	}
+
+	/* load the glyph and render it, antialiased if there are gray levels */
+	rc = FT_Load_Char(rconf->ft_normal_font, c,
+			  gray ? FT_LOAD_RENDER : (FT_LOAD_RENDER | FT_LOAD_MONOCHROME));
+	if (rc != 0) {
+		report(RPT_ERR, "%s: loading char '%c' (0x%x) failed", drvthis->name, c, c);
+		return NULL;
+	}
+
+	glyph = rconf->ft_normal_font->glyph;
+	bitmap = &glyph->bitmap;
+	pitch = gray ? bitmap->width : (bitmap->width + 7) / 8;
+
+	bits = realloc(g->bits, max(bitmap->rows * pitch, 1));
+	if (bits == NULL) {
+		report(RPT_ERR, "%s: error allocating glyph cache", drvthis->name);
+		return NULL;
+	}
+	for (row = 0; row < bitmap->rows; row++)
+		memcpy(bits + row * pitch, bitmap->buffer + row * bitmap->pitch, pitch);
+
+	g->c = c;
+	g->size = size;
+	g->width = bitmap->width;
+	g->rows = bitmap->rows;
+	g->pitch = pitch;
+	g->gray = gray;
+	g->left = glyph->bitmap_left;
+	g->top = glyph->bitmap_top;
+	g->descender = rconf->ft_normal_font->size->metrics.descender >> 6;
+	g->bits = bits;
+	return g;
+}
+
+
 /**
  * Draws character c to the framebuffer at position x,y using Freetype 2 for
  * font rendering. Top left corner is (1/1).
@@ -176,16 +295,11 @@ glcd_render_close(Driver *drvthis)
 void
 glcd_render_char_unicode(Driver *drvthis, int x, int y, int c, int yscale, int xscale)
 {
-	static int last_font_size = -1;
 	PrivateData *p = drvthis->private_data;
-	RenderConfig *rconf = p->render_config;
-	int col, row;		/* Position in the font bitmap */
+	int row;		/* Row in the font bitmap */
 	int px, py;		/* Pixel position on the display */
 	int r_width, r_height;	/* Size of the cell used to render char into */
-	int rc;
-	FT_Face face;
-	FT_GlyphSlot glyph;
-	FT_Bitmap *bitmap;
+	GlyphCache *g;
 	unsigned char *bitmap_buf;
 
 	if (x < 1 || x > p->width || y < 1 || y > p->height)
@@ -202,50 +316,21 @@ glcd_render_char_unicode(Driver *drvthis, int x, int y, int c, int yscale, int x
 	r_height = p->cellheight * yscale;
 	r_width = p->cellwidth * xscale;
 
-	/*
-	 * Set the font size. We set the font pixel width and height to the
-	 * same value (r_height), otherwise characters look too much condensed.
-	 */
-	if (last_font_size != r_height) {
-		debug(RPT_INFO, "%s: Setting font size to %d",  drvthis->name, r_height);
-		rc = FT_Set_Pixel_Sizes(rconf->ft_normal_font, r_height, r_height);
-		if (rc != 0) {
-			report(RPT_ERR, "%s: Failed to set pixel size (%dx%x)", drvthis->name,
-			       p->cellwidth, p->cellheight);
-			return;
-		}
-
-		last_font_size = r_height;
-	}
-
-	/* load the glyph and render it */
-	rc = FT_Load_Char(rconf->ft_normal_font, c, FT_LOAD_RENDER | FT_LOAD_MONOCHROME);
-	if (rc != 0) {
-		report(RPT_ERR, "%s: loading char '%c' (0x%x) failed", drvthis->name, c, c);
+	g = glcd_render_glyph(drvthis, c, r_height);
+	if (g == NULL)
 		return;
-	}
-
-	/* set some data elements for convenience */
-	face = rconf->ft_normal_font;
-	glyph = rconf->ft_normal_font->glyph;
-	bitmap = &glyph->bitmap;
-	bitmap_buf = bitmap->buffer;
+	bitmap_buf = g->bits;
 
 	/* Clear the cell. */
 	py = max(y * p->cellheight - r_height, 0);
-	for (row = 0; row < r_height; row++, py++) {
-		px = x * p->cellwidth;
-		for (col = 0; col < r_width; col++, px++) {
-			fb_draw_pixel(&(p->framebuf), px, py, 0);
-		}
-	}
+	fb_draw_box(p->drawbuf, x * p->cellwidth, py, r_width, r_height, FB_WHITE);
 
 	/*
 	 * Copy the pixels. Important: The font metrics may result in negative
 	 * py value! So protect it by restricting it to 0.
 	 */
-	py = max(y * p->cellheight + (face->size->metrics.descender >> 6) - glyph->bitmap_top, 0);
-	for (row = 0; (row < bitmap->rows) && (row < r_height); row++) {
+	py = max(y * p->cellheight + g->descender - g->top, 0);
+	for (row = 0; (row < g->rows) && (row < r_height); row++) {
 		px = x * p->cellwidth;
 		/*
 		 * Hack: If scales are not the same, ignore Freetype's idea of
@@ -253,15 +338,15 @@ glcd_render_char_unicode(Driver *drvthis, int x, int y, int c, int yscale, int x
 		 * for the ':' of the bignum.
 		 */
 		if (yscale == xscale)
-			px += glyph->bitmap_left;
+			px += g->left;
 		else
-			px += (r_width - bitmap->width)/2;
+			px += (r_width - g->width)/2;
 
-		for (col = 0; (col < bitmap->width) && (col < r_width); col++) {
-			fb_draw_pixel(&(p->framebuf), px, py, bitmap_buf[col / 8] >> (7 - (col % 8)) & 1);
-			px++;
-		}
-		bitmap_buf += bitmap->pitch;
+		if (g->gray)
+			fb_draw_levels(p->drawbuf, px, py, bitmap_buf, min(g->width, r_width));
+		else
+			fb_draw_hbits(p->drawbuf, px, py, bitmap_buf, min(g->width, r_width));
+		bitmap_buf += g->pitch;
 		py++;
 	}
 }
@@ -280,8 +365,9 @@ void
 glcd_render_char(Driver *drvthis, int x, int y, unsigned char c)
 {
 	PrivateData *p = drvthis->private_data;
-	int font_x, font_y;	/* Position in the font definition array */
-	int px, py;		/* Pixel position on the display */
+	int font_y;		/* Row in the font definition array */
+	int py;			/* Pixel row on the display */
+	unsigned char bits;	/* The font row, leftmost pixel first */
 
 	if (x < 1 || x > p->width || y < 1 || y > p->height)
 		return;
@@ -299,18 +385,12 @@ glcd_render_char(Driver *drvthis, int x, int y, unsigned char c)
 	/* FIXME: What happens if font is larger than cell size? */
 	py = y * p->cellheight;
 	for (font_y = 0; font_y < GLCD_FONT_HEIGHT; font_y++) {
-		px = x * p->cellwidth;
 		/*
-		 * Note: Initializing font_x with font's width leaves one
-		 * empty column to the left.
+		 * Note: Drawing the font's width + 1 bits (from bit 5 on) leaves
+		 * one empty column to the left.
 		 */
-		for (font_x = GLCD_FONT_WIDTH; font_x >= 0; font_x--) {
-			if (glcd_iso8859_1[c][font_y] & (1 << font_x))
-				fb_draw_pixel(&(p->framebuf), px, py, 1);
-			else
-				fb_draw_pixel(&(p->framebuf), px, py, 0);
-			px++;
-		}
+		bits = glcd_iso8859_1[c][font_y] << (7 - GLCD_FONT_WIDTH);
+		fb_draw_hbits(p->drawbuf, x * p->cellwidth, py, &bits, GLCD_FONT_WIDTH + 1);
 		py++;
 	}
 }
@@ -393,10 +473,34 @@ glcd_render_icon(Driver *drvthis, int x, int y, int icon)
 
 
 /**
- * Draw a big digit (or colon) using the built-in 16x24 font. Although the font
- * is stored in different pixel layout (column format, LSB top) this does not
- * matter as we need to address pixels in frame buffer anyway. The digit is
- * centered vertically.
+ * Fill the atlas of big digits from the column format font, once.
+ */
+static void
+glcd_render_bignum_atlas(void)
+{
+	int num, col, row;
+
+	if (bignum_atlas_ready)
+		return;
+
+	memset(bignum_atlas, 0, sizeof(bignum_atlas));
+	for (num = 0; num < nr_chrs_NUM; num++) {
+		for (col = 0; col < widtbl_NUM[num]; col++) {
+			const unsigned char *bits = &chrtbl_NUM[num][col * 3];
+
+			for (row = 0; row < chr_hgt_NUM; row++) {
+				if ((bits[row / 8] >> (row % 8)) & 1)
+					bignum_atlas[num][row][col / 8] |= 0x80 >> (col % 8);
+			}
+		}
+	}
+	bignum_atlas_ready = 1;
+}
+
+
+/**
+ * Draw a big digit (or colon) using the built-in 16x24 font. The digit is
+ * drawn from the atlas built at init time and centered vertically.
  *
  * \note  Works only for displays with pixel height >= 24! Smaller displays are
  *        not supported and nothing will be drawn.
@@ -409,7 +513,7 @@ void
 glcd_render_bignum(Driver *drvthis, int x, int num)
 {
 	PrivateData *p = drvthis->private_data;
-	int c, z;		/* Column and byte within font definition */
+	int row;		/* Row within the digit */
 	int px, py;		/* Pixel coordinates within the frame buffer */
 
 	if (p->framebuf.px_height < chr_hgt_NUM)
@@ -418,17 +522,8 @@ glcd_render_bignum(Driver *drvthis, int x, int num)
 	x--;
 
 	px = x * p->cellwidth;
-	for (c = 0; c < widtbl_NUM[num]; c++) {
-		/* center vertically */
-		py = (p->framebuf.px_height - chr_hgt_NUM) / 2;
-		for (z = 0; z < chr_hgt_NUM; z++) {
-			/* Test if pixel bit is set and draw it */
-			if (chrtbl_NUM[num][c * 3 + z / 8] & (1 << (z % 8)))
-				fb_draw_pixel(&(p->framebuf), px, py, 1);
-			else
-				fb_draw_pixel(&(p->framebuf), px, py, 0);
-			py++;
-		}
-		px++;
-	}
+	/* center vertically */
+	py = (p->framebuf.px_height - chr_hgt_NUM) / 2;
+	for (row = 0; row < chr_hgt_NUM; row++)
+		fb_draw_hbits(p->drawbuf, px, py + row, bignum_atlas[num][row], widtbl_NUM[num]);
 }
@@ -125,6 +125,8 @@ glcd_serdisp_init(Driver *drvthis)
 	ct_data->bsbuf.px_width = p->framebuf.px_width;
 	ct_data->bsbuf.px_height = p->framebuf.px_height;
 	ct_data->bsbuf.bytesPerLine = p->framebuf.bytesPerLine;
+	ct_data->bsbuf.layout = p->framebuf.layout;
+	ct_data->bsbuf.bpp = p->framebuf.bpp;
 	ct_data->bsbuf.size = p->framebuf.size;
 	ct_data->bsbuf.data = malloc(ct_data->bsbuf.size);
 	if (ct_data->bsbuf.data == NULL) {
@@ -180,20 +182,28 @@ glcd_serdisp_blit(PrivateData *p)
 	CT_serdisp_data *ct_data = (CT_serdisp_data *) p->ct_data;
 	int px, py;
 	int pixel_new, pixel_old;
+	int i;
+
+	if (p->framebuf.numDirty == 0)
+		return;
 
 	/*
-	 * Update method: go through the whole framebuffer line by line and
-	 * compare each pixel with the one in the backing store. If different
-	 * draw to serdisplib.
+	 * Update method: go through the changed areas of the framebuffer
+	 * line by line and compare each pixel with the one in the backing
+	 * store. If different draw to serdisplib.
 	 */
-	for (py = 0; py < p->framebuf.px_height; py++) {
-		for (px = 0; px < p->framebuf.px_width; px++) {
-			pixel_old = fb_get_pixel(&(ct_data->bsbuf), px, py);
-			pixel_new = fb_get_pixel(&(p->framebuf), px, py);
-			if (pixel_old != pixel_new) {
-				serdisp_setcolour(ct_data->disp, px, py,
-						  (pixel_new == FB_BLACK) ? SD_COL_BLACK : SD_COL_WHITE);
-				fb_draw_pixel(&(ct_data->bsbuf), px, py, pixel_new);
+	for (i = 0; i < p->framebuf.numDirty; i++) {
+		struct glcd_rect *r = &p->framebuf.dirty[i];
+
+		for (py = r->y; py < r->y + r->height; py++) {
+			for (px = r->x; px < r->x + r->width; px++) {
+				pixel_old = fb_get_pixel(&(ct_data->bsbuf), px, py);
+				pixel_new = fb_get_pixel(&(p->framebuf), px, py);
+				if (pixel_old != pixel_new) {
+					serdisp_setcolour(ct_data->disp, px, py,
+							  (pixel_new == FB_BLACK) ? SD_COL_BLACK : SD_COL_WHITE);
+					fb_draw_pixel(&(ct_data->bsbuf), px, py, pixel_new);
+				}
 			}
 		}
 	}
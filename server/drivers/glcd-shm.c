@@ -0,0 +1,151 @@
+/** \file server/drivers/glcd-shm.c
+ * This connection type publishes the framebuffer in a POSIX shared memory
+ * segment, for programs mirroring the display (see shm_frame.h). Only the
+ * changed parts of the framebuffer are copied into it.
+ */
+
+/*-
+ * This file is released under the GNU General Public License. Refer to the
+ * COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lcd.h"
+#include "shared/report.h"
+#include "glcd-low.h"
+#include "shm_lib.h"
+
+#define SHM_DEF_NAME	"/lcdproc-glcd"
+
+/** Private data for the shm connection type */
+typedef struct glcd_shm_data {
+	char name[256];			/**< name of the segment */
+	struct lcd_shm_frame *shm;	/**< the mapped segment */
+} CT_shm_data;
+
+/* Prototypes */
+void glcd_shm_blit(PrivateData *p);
+void glcd_shm_close(PrivateData *p);
+void glcd_shm_set_backlight(PrivateData *p, int state);
+
+/**
+ * API: Initialize the connection type driver.
+ * \param drvthis  Pointer to driver structure.
+ * \retval 0       Success.
+ * \retval <0      Error.
+ */
+int
+glcd_shm_init(Driver *drvthis)
+{
+	PrivateData *p = (PrivateData *) drvthis->private_data;
+	CT_shm_data *ct_data;
+	struct lcd_shm_frame *f;
+
+	report(RPT_INFO, "GLCD/shm: initializing");
+
+	/* Set up connection type low-level functions */
+	p->glcd_functions->blit = glcd_shm_blit;
+	p->glcd_functions->close = glcd_shm_close;
+	p->glcd_functions->set_backlight = glcd_shm_set_backlight;
+
+	/* Allocate memory structures */
+	ct_data = (CT_shm_data *) calloc(1, sizeof(CT_shm_data));
+	if (ct_data == NULL) {
+		report(RPT_ERR, "GLCD/shm: error allocating connection data");
+		return -1;
+	}
+	p->ct_data = ct_data;
+
+	strncpy(ct_data->name, drvthis->config_get_string(drvthis->name, "shm_Name", 0, SHM_DEF_NAME),
+		sizeof(ct_data->name));
+	ct_data->name[sizeof(ct_data->name) - 1] = '\0';
+	if (ct_data->name[0] != '/') {
+		report(RPT_ERR, "GLCD/shm: shm_Name must start with a '/': %s", ct_data->name);
+		return -1;
+	}
+
+	f = lib_shm_create(ct_data->name, LCD_SHM_PIXELS, p->framebuf.size);
+	if (f == NULL)
+		return -1;
+	ct_data->shm = f;
+
+	lib_shm_begin(f);
+	f->width = p->framebuf.px_width;
+	f->height = p->framebuf.px_height;
+	f->cellwidth = p->cellwidth;
+	f->cellheight = p->cellheight;
+	f->bpp = p->framebuf.bpp;
+	f->bytes_per_line = p->framebuf.bytesPerLine;
+	f->backlight = 1;
+	lib_shm_end(f);
+
+	report(RPT_INFO, "GLCD/shm: publishing in %s", ct_data->name);
+
+	return 0;
+}
+
+/**
+ * API: Write the changed areas of the framebuffer to the segment.
+ * \param p  Pointer to glcd driver's private date structure.
+ */
+void
+glcd_shm_blit(PrivateData *p)
+{
+	CT_shm_data *ct_data = (CT_shm_data *) p->ct_data;
+	unsigned char *dest = LCD_SHM_DATA(ct_data->shm);
+	int i;
+
+	if (p->framebuf.numDirty == 0)
+		return;
+
+	lib_shm_begin(ct_data->shm);
+	for (i = 0; i < p->framebuf.numDirty; i++) {
+		int len;
+		int pos = fb_rect_bytes(&p->framebuf, &p->framebuf.dirty[i], &len);
+
+		memcpy(dest + pos, p->framebuf.data + pos, len);
+	}
+	lib_shm_end(ct_data->shm);
+}
+
+/**
+ * API: Release low-level resources.
+ * \param p  Pointer to glcd driver's private date structure.
+ */
+void
+glcd_shm_close(PrivateData *p)
+{
+	if (p->ct_data != NULL) {
+		CT_shm_data *ct_data = (CT_shm_data *) p->ct_data;
+
+		lib_shm_destroy(ct_data->shm, ct_data->name);
+
+		free(p->ct_data);
+		p->ct_data = NULL;
+	}
+}
+
+/**
+ * API: Publish the backlight state.
+ * \param p      Pointer to glcd driver's private date structure.
+ * \param state  State of backlight.
+ */
+void
+glcd_shm_set_backlight(PrivateData *p, int state)
+{
+	CT_shm_data *ct_data = (CT_shm_data *) p->ct_data;
+	unsigned int on = (state == BACKLIGHT_ON) ? 1 : 0;
+
+	if (ct_data->shm->backlight == on)
+		return;
+
+	lib_shm_begin(ct_data->shm);
+	ct_data->shm->backlight = on;
+	lib_shm_end(ct_data->shm);
+}
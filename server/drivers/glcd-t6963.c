@@ -35,7 +35,6 @@ void glcd_t6963_close(PrivateData *p);
 
 /** Data local to the t6963 connection type */
 typedef struct glcd_t6963_data {
-	unsigned char *backingstore;	/**< backing buffer */
 	T6963_port *port_config;	/**< parallel port configuration */
 } CT_t6963_data;
 
@@ -80,13 +79,6 @@ glcd_t6963_init(Driver *drvthis)
 	}
 	ct_data->port_config = port_config;
 
-	ct_data->backingstore = malloc(p->framebuf.size);
-	if (ct_data->backingstore == NULL) {
-		report(RPT_ERR, "GLCD/T6963: unable to allocate backing store");
-		return -1;
-	}
-	memset(ct_data->backingstore, 0x00, p->framebuf.size);
-
 	/* Get port from config */
 	port_config->port = drvthis->config_get_int(drvthis->name, "Port", 0, DEFAULT_PORT);
 	if ((port_config->port < 0x200) || (port_config->port > 0x400)) {
@@ -99,6 +91,12 @@ glcd_t6963_init(Driver *drvthis)
 	port_config->bidirectLPT = drvthis->config_get_bool(drvthis->name, "bidirectional", 0, 1);
 	/* Additional delay necessary? Default: no */
 	port_config->delayBus = drvthis->config_get_bool(drvthis->name, "delayBus", 0, 0);
+	/* Bytes per status check in auto write mode. Default: 1 */
+	port_config->autoBurst = drvthis->config_get_int(drvthis->name, "AutoWriteBurst", 0, 1);
+	if ((port_config->autoBurst < 1) || (port_config->autoBurst > 255)) {
+		port_config->autoBurst = 1;
+		report(RPT_WARNING, "GLCD/T6963: AutoWriteBurst must be between 1 and 255. Using default 1");
+	}
 
 	/* Now initialize port */
 	if (t6963_low_init(port_config) == -1) {
@@ -135,38 +133,18 @@ void
 glcd_t6963_blit(PrivateData *p)
 {
 	CT_t6963_data *ct_data = (CT_t6963_data *) p->ct_data;
-	int x, y;
-
-	for (y = 0; y < p->framebuf.px_height; y++) {
-		/* set pointers to start of the line */
-		unsigned char *sp = p->framebuf.data + (y * p->framebuf.bytesPerLine);
-		unsigned char *sq = ct_data->backingstore + (y * p->framebuf.bytesPerLine);
-
-		/* set pointers to end of the line */
-		unsigned char *ep = sp + (p->framebuf.bytesPerLine - 1);
-		unsigned char *eq = sq + (p->framebuf.bytesPerLine - 1);
+	int i;
 
-		/* find begin and end of differences */
-		x = 0;
-		while ((sp <= ep) && (*sp == *sq)) {
-			sp++, sq++, x++;
-		}
-		while ((ep >= sp) && (*ep == *eq)) {
-			ep--, eq--;
-		}
+	for (i = 0; i < p->framebuf.numDirty; i++) {
+		int len;
+		int pos = fb_rect_bytes(&p->framebuf, &p->framebuf.dirty[i], &len);
+		unsigned char *sp = p->framebuf.data + pos;
 
-		/* there are differences, ... */
-		if (sp <= ep) {
-			t6963_low_command_word(ct_data->port_config, SET_ADDRESS_POINTER,
-				  GRAPHIC_BASE + (y * p->framebuf.bytesPerLine) + x);
-			t6963_low_command(ct_data->port_config, AUTO_WRITE);
-			while (sp <= ep) {
-				t6963_low_auto_write(ct_data->port_config, *sp);
-				/* Update backing store and advance */
-				*sq++ = *sp++;
-			}
-			t6963_low_command(ct_data->port_config, AUTO_RESET);
-		}
+		t6963_low_command_word(ct_data->port_config, SET_ADDRESS_POINTER,
+			  GRAPHIC_BASE + pos);
+		t6963_low_command(ct_data->port_config, AUTO_WRITE);
+		t6963_low_auto_write_block(ct_data->port_config, sp, len);
+		t6963_low_command(ct_data->port_config, AUTO_RESET);
 	}
 }
 
@@ -186,9 +164,6 @@ glcd_t6963_close(PrivateData *p)
 			free(ct_data->port_config);
 		}
 
-		if (ct_data->backingstore != NULL)
-			free(ct_data->backingstore);
-
 		free(p->ct_data);
 		p->ct_data = NULL;
 	}
@@ -204,13 +179,11 @@ t6963_graphic_clear(PrivateData *p)
 {
 	CT_t6963_data *ct_data = (CT_t6963_data *) p->ct_data;
 	int num = p->framebuf.size;
-	int i;
 
 	p->glcd_functions->drv_debug(RPT_DEBUG, "GLCD/T6963: Clearing graphic: %d bytes", num);
 
 	t6963_low_command_word(ct_data->port_config, SET_ADDRESS_POINTER, GRAPHIC_BASE);
 	t6963_low_command(ct_data->port_config, AUTO_WRITE);
-	for (i = 0; i < num; i++)
-		t6963_low_auto_write(ct_data->port_config, 0);
+	t6963_low_auto_fill(ct_data->port_config, 0, num);
 	t6963_low_command(ct_data->port_config, AUTO_RESET);
 }
@@ -27,9 +27,15 @@
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xresource.h>
+#ifdef HAVE_XSHM
+# include <sys/ipc.h>
+# include <sys/shm.h>
+# include <X11/extensions/XShm.h>
+#endif
 
 #include "lcd.h"
 #include "shared/report.h"
+#include "shared/defines.h"
 #include "glcd-low.h"
 
 #define X11_DEF_PIXEL_SIZE		"3+1"
@@ -57,7 +63,11 @@ typedef struct glcd_x11_data {
 	int dimx, dimy;		/** Width/height of the X window */
 	Atom wmDeleteMessage;	/** Atom identifier for closing the window */
 
-	unsigned char *backingstore;	/** Holds a copy of the LCD screen data */
+	XImage *image;		/** Image of the LCD area, drawn to and then put to the window */
+#ifdef HAVE_XSHM
+	XShmSegmentInfo shminfo;	/** Shared memory holding the image data */
+	int use_shm;		/** The image is in shared memory */
+#endif
 } CT_x11_data;
 
 /* Prototypes */
@@ -65,13 +75,16 @@ void glcd_x11_blit(PrivateData *p);
 void glcd_x11_close(PrivateData *p);
 unsigned char glcd_x11_pollkeys(PrivateData *p);
 void glcd_x11_set_backlight(PrivateData *p, int state);
+static unsigned long x11w_mix_color(unsigned long fgc, unsigned long bgc, int level, int max);
 static void x11w_adj_contrast_brightness(unsigned long *pfgc, unsigned long *pbgc, int contrast,
 					 int brightness);
 static void x11w_draw_pixel(CT_x11_data * ct_data, int x, int y, unsigned long fgc,
 			    unsigned long bgc);
+static int x11w_create_image(CT_x11_data * ct_data, int width, int height);
+static void x11w_put_image(CT_x11_data * ct_data, int x, int y, int width, int height);
 
 /**
- * Draws a single LCD pixel in the X11 window.
+ * Draws a single LCD pixel into the image of the LCD area.
  * \param ct_data  Connection type's private data.
  * \param x        LCD x position.
  * \param y        LCD y position.
@@ -82,20 +95,145 @@ static void
 x11w_draw_pixel(CT_x11_data * ct_data, int x, int y, unsigned long fgc, unsigned long bgc)
 {
 	int pxlsize = ct_data->pixel + ct_data->pgap;
-	int xoffset = ct_data->border + (x * pxlsize);
-	int yoffset = ct_data->border + (y * pxlsize);
-
-	/* This basically erases the area beneath LCD pixel being drawn. */
-	XSetForeground(ct_data->dp, ct_data->gc, bgc);
-	XFillRectangle(ct_data->dp, ct_data->w, ct_data->gc, xoffset, yoffset, pxlsize, pxlsize);
-
-	/* Only draw if foreground color is different from background color.
-	 * No need to draw the same area twice. */
-	if (fgc != bgc) {
-		XSetForeground(ct_data->dp, ct_data->gc, fgc);
-		XFillRectangle(ct_data->dp, ct_data->w, ct_data->gc, xoffset,
-			       yoffset, ct_data->pixel, ct_data->pixel);
+	int xoffset = x * pxlsize;
+	int yoffset = y * pxlsize;
+	int i, j;
+
+	/* The pixel itself, the gap to the right and below in background color */
+	for (j = 0; j < pxlsize; j++) {
+		for (i = 0; i < pxlsize; i++) {
+			XPutPixel(ct_data->image, xoffset + i, yoffset + j,
+				  ((i < ct_data->pixel) && (j < ct_data->pixel)) ? fgc : bgc);
+		}
+	}
+}
+
+#ifdef HAVE_XSHM
+/** Set by x11w_shm_error() if attaching the shared memory failed */
+static int x11w_shm_failed;
+
+/** X error handler used while attaching the shared memory */
+static int
+x11w_shm_error(Display *dp, XErrorEvent *ev)
+{
+	x11w_shm_failed = 1;
+	return 0;
+}
+
+/**
+ * Creates the image in memory shared with the X server, so putting it to
+ * the window does not send the image data through the X connection. This
+ * only works if the X server runs on the same machine.
+ * \param ct_data  Connection type's private data.
+ * \param width    Width of the image.
+ * \param height   Height of the image.
+ * \retval 0       Success.
+ * \retval <0      Shared memory is not available.
+ */
+static int
+x11w_create_shm_image(CT_x11_data * ct_data, int width, int height)
+{
+	XErrorHandler old_handler;
+
+	if (!XShmQueryExtension(ct_data->dp))
+		return -1;
+
+	ct_data->image = XShmCreateImage(ct_data->dp, ct_data->vi,
+					 DefaultDepth(ct_data->dp, ct_data->sc), ZPixmap, NULL,
+					 &ct_data->shminfo, width, height);
+	if (ct_data->image == NULL)
+		return -1;
+
+	ct_data->shminfo.shmid = shmget(IPC_PRIVATE, ct_data->image->bytes_per_line * height,
+					IPC_CREAT | 0600);
+	if (ct_data->shminfo.shmid < 0)
+		goto err_image;
+	ct_data->shminfo.shmaddr = shmat(ct_data->shminfo.shmid, NULL, 0);
+	if (ct_data->shminfo.shmaddr == (char *) -1) {
+		shmctl(ct_data->shminfo.shmid, IPC_RMID, NULL);
+		goto err_image;
+	}
+	ct_data->image->data = ct_data->shminfo.shmaddr;
+	ct_data->shminfo.readOnly = False;
+
+	/* A remote X server fails to attach; that error is reported asynchronously */
+	x11w_shm_failed = 0;
+	old_handler = XSetErrorHandler(x11w_shm_error);
+	XShmAttach(ct_data->dp, &ct_data->shminfo);
+	XSync(ct_data->dp, False);
+	XSetErrorHandler(old_handler);
+
+	/* Attached or not, the segment goes away once it is detached */
+	shmctl(ct_data->shminfo.shmid, IPC_RMID, NULL);
+	if (x11w_shm_failed) {
+		shmdt(ct_data->shminfo.shmaddr);
+		goto err_image;
+	}
+
+	ct_data->use_shm = 1;
+	return 0;
+
+err_image:
+	ct_data->image->data = NULL;
+	XDestroyImage(ct_data->image);
+	ct_data->image = NULL;
+	return -1;
+}
+#endif
+
+/**
+ * Creates the image of the LCD area. The LCD pixels are drawn into the
+ * image, and only the areas that changed are put to the window.
+ * \param ct_data  Connection type's private data.
+ * \param width    Width of the image.
+ * \param height   Height of the image.
+ * \retval 0       Success.
+ * \retval <0      Error.
+ */
+static int
+x11w_create_image(CT_x11_data * ct_data, int width, int height)
+{
+#ifdef HAVE_XSHM
+	if (x11w_create_shm_image(ct_data, width, height) == 0)
+		return 0;
+	report(RPT_INFO, "GLCD/x11: shared memory not available, sending images");
+#endif
+
+	ct_data->image = XCreateImage(ct_data->dp, ct_data->vi,
+				      DefaultDepth(ct_data->dp, ct_data->sc), ZPixmap, 0, NULL,
+				      width, height, 32, 0);
+	if (ct_data->image == NULL)
+		return -1;
+
+	ct_data->image->data = calloc(ct_data->image->bytes_per_line, height);
+	if (ct_data->image->data == NULL) {
+		XDestroyImage(ct_data->image);
+		ct_data->image = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Puts an area of the image of the LCD area to the window.
+ * \param ct_data  Connection type's private data.
+ * \param x        Left column of the area in the image.
+ * \param y        Top row of the area in the image.
+ * \param width    Width of the area.
+ * \param height   Height of the area.
+ */
+static void
+x11w_put_image(CT_x11_data * ct_data, int x, int y, int width, int height)
+{
+#ifdef HAVE_XSHM
+	if (ct_data->use_shm) {
+		XShmPutImage(ct_data->dp, ct_data->w, ct_data->gc, ct_data->image, x, y,
+			     ct_data->border + x, ct_data->border + y, width, height, False);
+		return;
 	}
+#endif
+	XPutImage(ct_data->dp, ct_data->w, ct_data->gc, ct_data->image, x, y,
+		  ct_data->border + x, ct_data->border + y, width, height);
 }
 
 /**
@@ -148,6 +286,29 @@ x11w_adj_contrast_brightness(unsigned long *pfgc, unsigned long *pbgc, int contr
 	*pbgc = bgc;
 }
 
+/**
+ * Mix foreground and background color for a gray level of the framebuffer.
+ * \param fgc    Foreground color, the color of level max.
+ * \param bgc    Background color, the color of level 0.
+ * \param level  The gray level.
+ * \param max    The darkest gray level.
+ * \return       The color.
+ */
+static unsigned long
+x11w_mix_color(unsigned long fgc, unsigned long bgc, int level, int max)
+{
+	unsigned long color = 0;
+	int shift;
+
+	for (shift = 0; shift <= 16; shift += 8) {
+		int fg = (fgc >> shift) & 0xFF;
+		int bg = (bgc >> shift) & 0xFF;
+
+		color |= (unsigned long) (bg + (fg - bg) * level / max) << shift;
+	}
+	return color;
+}
+
 /**
  * API: Initialize the connection type driver.
  * \param drvthis  Pointer to driver structure.
@@ -177,13 +338,6 @@ glcd_x11_init(Driver *drvthis)
 	}
 	p->ct_data = ct_data;
 
-	ct_data->backingstore = malloc(p->framebuf.size);
-	if (ct_data->backingstore == NULL) {
-		report(RPT_ERR, "GLCD/x11: unable to allocate backing store");
-		return -1;
-	}
-	memset(ct_data->backingstore, 0x00, p->framebuf.size);
-
 	/* Get and parse pixel size */
 	strncpy(buf, drvthis->config_get_string(drvthis->name, "x11_PixelSize",
 						0, X11_DEF_PIXEL_SIZE), sizeof(buf));
@@ -257,6 +411,12 @@ glcd_x11_init(Driver *drvthis)
 	ct_data->w = XCreateWindow(ct_data->dp, ct_data->rw, 0, 0, sh.min_width,
 				   sh.min_height, 0, 0, InputOutput, ct_data->vi, CWEventMask, &wa);
 
+	if (x11w_create_image(ct_data, ct_data->dimx - (ct_data->border * 2),
+			      ct_data->dimy - (ct_data->border * 2)) < 0) {
+		report(RPT_ERR, "GLCD/x11: unable to create image");
+		return -1;
+	}
+
 	XSetWMProperties(ct_data->dp, ct_data->w, NULL, NULL, NULL, 0, &sh, NULL, NULL);
 	ct_data->wmDeleteMessage = XInternAtom(ct_data->dp, "WM_DELETE_WINDOW", False);
 	XSetWMProtocols(ct_data->dp, ct_data->w, &ct_data->wmDeleteMessage, 1);
@@ -289,16 +449,18 @@ glcd_x11_blit(PrivateData *p)
 {
 	CT_x11_data *ct_data = (CT_x11_data *) p->ct_data;
 
-	/* Check if frame buffer has changed. If not there's nothing to do */
-	if (memcmp(p->framebuf.data, ct_data->backingstore, p->framebuf.size)
-	    == 0)
-		return;
-
 	unsigned long fgc = ct_data->fgcolor;
 	unsigned long bgc = ct_data->bgcolor;
+	unsigned long colors[1 << 4];	/* color of each gray level */
+	int max = FB_MAX_LEVEL(&p->framebuf);
+	int i;
 	int y;
 	int x;
 
+	/* If the frame buffer has not changed there's nothing to do */
+	if (p->framebuf.numDirty == 0)
+		return;
+
 	/* Adjust colors for contrast and brightness */
 	if (p->backlightstate == 0) {
 		x11w_adj_contrast_brightness(&fgc, &bgc, p->contrast, p->offbrightness);
@@ -307,19 +469,49 @@ glcd_x11_blit(PrivateData *p)
 		x11w_adj_contrast_brightness(&fgc, &bgc, p->contrast, p->brightness);
 	}
 
-	/* Draw each LCD pixel on the X11 window. */
-	for (y = 0; y < p->framebuf.px_height; y++) {
-		for (x = 0; x < p->framebuf.px_width; x++) {
-			if ((fb_get_pixel(&p->framebuf, x, y) ^ ct_data->inverted) == FB_BLACK)
-				x11w_draw_pixel(ct_data, x, y, fgc, bgc);
-			else
-				x11w_draw_pixel(ct_data, x, y, bgc, bgc);
-		}
+	if (max > 1) {
+		for (i = 0; i <= max; i++)
+			colors[i] = x11w_mix_color(fgc, bgc, i, max);
 	}
 
-	XFlush(ct_data->dp);
-	memcpy(ct_data->backingstore, p->framebuf.data, p->framebuf.size);
+	/*
+	 * Draw the changed LCD pixels into the image, and put each run of
+	 * adjacent changed areas to the window with a single request.
+	 */
+	for (i = 0; i < p->framebuf.numDirty;) {
+		struct glcd_rect *r = &p->framebuf.dirty[i];
+		int pxlsize = ct_data->pixel + ct_data->pgap;
+		int left = r->x, right = r->x + r->width;
+		int top = r->y, bottom;
+
+		do {
+			r = &p->framebuf.dirty[i++];
+			for (y = r->y; y < r->y + r->height; y++) {
+				for (x = r->x; x < r->x + r->width; x++) {
+					if (max > 1) {
+						int level = fb_get_level(&p->framebuf, x, y);
+
+						if (ct_data->inverted)
+							level = max - level;
+						x11w_draw_pixel(ct_data, x, y, colors[level], bgc);
+					}
+					else if ((fb_get_pixel(&p->framebuf, x, y) ^ ct_data->inverted) == FB_BLACK)
+						x11w_draw_pixel(ct_data, x, y, fgc, bgc);
+					else
+						x11w_draw_pixel(ct_data, x, y, bgc, bgc);
+				}
+			}
+			left = min(left, r->x);
+			right = max(right, r->x + r->width);
+			bottom = r->y + r->height;
+		} while ((i < p->framebuf.numDirty) && (p->framebuf.dirty[i].y == bottom));
+
+		x11w_put_image(ct_data, left * pxlsize, top * pxlsize,
+			       (right - left) * pxlsize, (bottom - top) * pxlsize);
+	}
 
+	/* The X server must have read shared memory before it is drawn to again */
+	XSync(ct_data->dp, False);
 }
 
 /**
@@ -332,13 +524,22 @@ glcd_x11_close(PrivateData *p)
 	if (p->ct_data != NULL) {
 		CT_x11_data *ct_data = (CT_x11_data *) p->ct_data;
 
+		if (ct_data->image != NULL) {
+#ifdef HAVE_XSHM
+			if (ct_data->use_shm) {
+				XShmDetach(ct_data->dp, &ct_data->shminfo);
+				XSync(ct_data->dp, False);
+				shmdt(ct_data->shminfo.shmaddr);
+				ct_data->image->data = NULL;
+			}
+#endif
+			XDestroyImage(ct_data->image);
+		}
+
 		if (ct_data->dp != NULL) {
 			XCloseDisplay(ct_data->dp);
 		}
 
-		if (ct_data->backingstore != NULL)
-			free(ct_data->backingstore);
-
 		free(p->ct_data);
 		p->ct_data = NULL;
 	}
@@ -434,6 +635,7 @@ glcd_x11_set_backlight(PrivateData *p, int state)
 		XSetWindowBackground(ct_data->dp, ct_data->w, bgc);
 	}
 
+	/* The window is blank now; redraw all pixels set on the next blit */
 	XClearWindow(ct_data->dp, ct_data->w);
-	memset(ct_data->backingstore, 0, p->framebuf.size);
+	memset(p->framebuf.backingstore, 0, p->framebuf.size);
 }
@@ -11,7 +11,9 @@
  * understood by the display and to transmit the data to the display.
  *
  * The framebuffer is of linear type, storing a black and white image of the
- * screen. Each byte contains 8 pixels (1bpp).
+ * screen. Each byte contains 8 pixels (1bpp). CT-drivers may ask for a
+ * framebuffer of vertical pages instead; the base driver then still draws
+ * into a linear one and converts it to pages on flush.
  *
  * The base driver does not implement incremental updates. Instead the
  * CT-driver is responsible for this.
@@ -43,6 +45,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
 
 #include "lcd.h"
 #include "lcd_lib.h"
@@ -62,6 +65,8 @@ MODULE_EXPORT char *symbol_prefix = "glcd_";
 
 static char *defaultKeyMap[GLCD_KEYPAD_MAX] = {"Up", "Down", "Left", "Right", "Enter", "Escape"};
 
+static int glcd_alloc_drawbuf(PrivateData *p);
+
 /**
  * Initialize the driver. (Required)
  * \param drvthis  Pointer to driver structure.
@@ -110,7 +115,7 @@ glcd_init(Driver *drvthis)
 		return -1;
 	}
 	p->glcd_functions->drv_report = report;
-	p->glcd_functions->drv_debug = debug;
+	p->glcd_functions->drv_debug = DEBUG_FUNCTION;
 	p->glcd_functions->blit = NULL;
 	p->glcd_functions->close = NULL;
 	p->glcd_functions->set_contrast = NULL;
@@ -131,7 +136,21 @@ glcd_init(Driver *drvthis)
 	p->framebuf.px_width = w;
 	p->framebuf.px_height = h;
 	p->framebuf.layout = FB_TYPE_LINEAR;
-	p->framebuf.bytesPerLine = (p->framebuf.px_width + 7) / 8;
+
+	/* Gray levels; used only if the connection type can show them */
+	tmp = drvthis->config_get_int(drvthis->name, "BitsPerPixel", 0, GLCD_DEFAULT_BPP);
+	if ((tmp != 1) && (tmp != 2) && (tmp != 4)) {
+		report(RPT_WARNING, "%s: BitsPerPixel must be 1, 2 or 4; using default %d",
+			drvthis->name, GLCD_DEFAULT_BPP);
+		tmp = GLCD_DEFAULT_BPP;
+	}
+	if ((tmp > 1) && !connectionMapping[i].grayscale) {
+		report(RPT_WARNING, "%s: ConnectionType %s cannot show gray levels; using BitsPerPixel 1",
+		       drvthis->name, connectionMapping[i].name);
+		tmp = 1;
+	}
+	p->framebuf.bpp = tmp;
+	p->framebuf.bytesPerLine = (p->framebuf.px_width * p->framebuf.bpp + 7) / 8;
 	p->framebuf.size = p->framebuf.bytesPerLine * p->framebuf.px_height;
 	debug(RPT_INFO, "%s: size (first) = %d", drvthis->name, p->framebuf.size);
 
@@ -189,7 +208,7 @@ glcd_init(Driver *drvthis)
 
 	/* Allocate framebuffer (re-calculate size before) */
 	if (p->framebuf.layout == FB_TYPE_LINEAR) {
-		p->framebuf.bytesPerLine = (p->framebuf.px_width + 7) / 8;
+		p->framebuf.bytesPerLine = (p->framebuf.px_width * p->framebuf.bpp + 7) / 8;
 		p->framebuf.size = p->framebuf.bytesPerLine * p->framebuf.px_height;
 	}
 	else {
@@ -205,6 +224,29 @@ glcd_init(Driver *drvthis)
 	}
 	memset(p->framebuf.data, 0x00, p->framebuf.size);
 
+	/*
+	 * What the display shows is unknown, so the backing store differs
+	 * from the framebuffer everywhere and the first flush draws it all.
+	 */
+	p->framebuf.backingstore = malloc(p->framebuf.size);
+	p->framebuf.dirty = malloc(sizeof(struct glcd_rect) * p->framebuf.px_height);
+	if ((p->framebuf.backingstore == NULL) || (p->framebuf.dirty == NULL)) {
+		report(RPT_ERR, "%s: unable to allocate backing store", drvthis->name);
+		return -1;
+	}
+	memset(p->framebuf.backingstore, 0xFF, p->framebuf.size);
+
+	/*
+	 * Drawing text and boxes into vertical pages sets pixel by pixel, so
+	 * draw into a linear framebuffer and convert it on flush instead.
+	 */
+	if (p->framebuf.layout == FB_TYPE_LINEAR)
+		p->drawbuf = &p->framebuf;
+	else if (glcd_alloc_drawbuf(p) != 0) {
+		report(RPT_ERR, "%s: unable to allocate framebuffer", drvthis->name);
+		return -1;
+	}
+
 	/* Initialize renderer */
 	if (glcd_render_init(drvthis) != 0)
 		return -1;
@@ -284,6 +326,12 @@ glcd_close(Driver *drvthis)
 		if (p->framebuf.data != NULL)
 			free(p->framebuf.data);
 		p->framebuf.data = NULL;
+		free(p->framebuf.backingstore);
+		free(p->framebuf.dirty);
+		if ((p->drawbuf != NULL) && (p->drawbuf != &p->framebuf)) {
+			free(p->drawbuf->data);
+			free(p->drawbuf);
+		}
 		glcd_render_close(drvthis);
 
 		free(p);
@@ -367,8 +415,153 @@ glcd_clear(Driver *drvthis)
 
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	memset(p->framebuf.data, 0x00, p->framebuf.size);
+	memset(p->drawbuf->data, 0x00, p->drawbuf->size);
+
+}
+
+
+/**
+ * Transpose an 8x8 bit matrix held in a 64 bit word, row 0 in the most
+ * significant byte and column 0 in the most significant bit of each row.
+ * The three steps swap 1x1, 2x2 and 4x4 blocks at once, so a whole tile
+ * takes a dozen operations instead of 64 pixel moves.
+ * \param x  The matrix.
+ * \return   The transposed matrix.
+ */
+static inline uint64_t
+glcd_transpose8(uint64_t x)
+{
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+	x = x ^ t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+	x = x ^ t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+	x = x ^ t ^ (t << 28);
+	return x;
+}
+
+
+/**
+ * Convert a 1bpp FB_TYPE_LINEAR framebuffer to a FB_TYPE_VPAGED one of the
+ * same size, one tile of 8x8 pixels at a time.
+ * \param src   The linear framebuffer.
+ * \param dest  The paged framebuffer.
+ */
+static void
+glcd_linear_to_vpaged(const struct glcd_framebuf *src, struct glcd_framebuf *dest)
+{
+	int page, col, row, i;
+
+	for (page = 0; page < (dest->px_height + 7) / 8; page++) {
+		const unsigned char *in = src->data + page * 8 * src->bytesPerLine;
+		unsigned char *out = dest->data + page * dest->px_width;
+		int rows = min(8, src->px_height - page * 8);
+
+		for (col = 0; col < src->bytesPerLine; col++) {
+			int cols = min(8, src->px_width - col * 8);
+			uint64_t x = 0;
+
+			/*
+			 * Put the bottom row first, so the transposed tile
+			 * has the top pixel of each column in the least
+			 * significant bit, as pages store them.
+			 */
+			for (row = rows - 1; row >= 0; row--)
+				x = (x << 8) | in[row * src->bytesPerLine + col];
+			x = glcd_transpose8(x);
+
+			for (i = 0; i < cols; i++)
+				out[col * 8 + i] = x >> (56 - 8 * i);
+		}
+	}
+}
+
+
+/**
+ * Allocate the linear framebuffer drawn into for a connection type using
+ * FB_TYPE_VPAGED.
+ * \param p  Pointer to glcd driver's private date structure.
+ * \retval 0   Success.
+ * \retval <0  Error.
+ */
+static int
+glcd_alloc_drawbuf(PrivateData *p)
+{
+	struct glcd_framebuf *fb = calloc(1, sizeof(struct glcd_framebuf));
 
+	if (fb == NULL)
+		return -1;
+	fb->px_width = p->framebuf.px_width;
+	fb->px_height = p->framebuf.px_height;
+	fb->layout = FB_TYPE_LINEAR;
+	fb->bpp = 1;
+	fb->bytesPerLine = (fb->px_width + 7) / 8;
+	fb->size = fb->bytesPerLine * fb->px_height;
+	fb->data = calloc(1, fb->size);
+	if (fb->data == NULL) {
+		free(fb);
+		return -1;
+	}
+	p->drawbuf = fb;
+	return 0;
+}
+
+
+/**
+ * Find the areas of the framebuffer that changed since the last flush and
+ * update the backing store. The server redraws the whole screen for every
+ * frame, so this compares the contents instead of tracking what was drawn;
+ * the connection types then send only those areas.
+ * \param p  Pointer to glcd driver's private date structure.
+ */
+static void
+glcd_find_dirty(PrivateData *p)
+{
+	struct glcd_framebuf *fb = &p->framebuf;
+	int lines, lineBytes;
+	int line;
+
+	if (fb->layout == FB_TYPE_LINEAR) {
+		lines = fb->px_height;
+		lineBytes = fb->bytesPerLine;
+	}
+	else {
+		lines = (fb->px_height + 7) / 8;
+		lineBytes = fb->px_width;
+	}
+
+	fb->numDirty = 0;
+	for (line = 0; line < lines; line++) {
+		unsigned char *new = fb->data + line * lineBytes;
+		unsigned char *old = fb->backingstore + line * lineBytes;
+		struct glcd_rect *r;
+		int first, last;
+
+		if (memcmp(new, old, lineBytes) == 0)
+			continue;
+
+		for (first = 0; new[first] == old[first]; first++)
+			;
+		for (last = lineBytes - 1; new[last] == old[last]; last--)
+			;
+		memcpy(old + first, new + first, last - first + 1);
+
+		r = &fb->dirty[fb->numDirty++];
+		if (fb->layout == FB_TYPE_LINEAR) {
+			r->x = first * 8 / fb->bpp;
+			r->width = min((last + 1) * 8 / fb->bpp, fb->px_width) - r->x;
+			r->y = line;
+			r->height = 1;
+		}
+		else {
+			r->x = first;
+			r->width = last - first + 1;
+			r->y = line * 8;
+			r->height = min(8, fb->px_height - r->y);
+		}
+	}
 }
 
 
@@ -383,6 +576,9 @@ glcd_flush(Driver *drvthis)
 
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
+	if (p->drawbuf != &p->framebuf)
+		glcd_linear_to_vpaged(p->drawbuf, &p->framebuf);
+	glcd_find_dirty(p);
 	p->glcd_functions->blit(p);
 }
 
@@ -469,7 +665,6 @@ glcd_vbar(Driver *drvthis, int x, int y, int len, int promille, int options)
 {
 	PrivateData *p = drvthis->private_data;
 	int xstart, xend, ystart, yend;
-	int col, row;
 
 	debug(RPT_DEBUG, "%s(%i,%i,%i,%i,%i)", __FUNCTION__, x, y, len, promille, options);
 
@@ -479,11 +674,7 @@ glcd_vbar(Driver *drvthis, int x, int y, int len, int promille, int options)
 	ystart = y * p->cellheight;
 	yend = ystart - (((long) 2 * len * p->cellheight) * promille / 2000) + 1;
 
-	for (col = xstart; col < xend; col++) {
-		for (row = ystart; row > yend; row--) {
-			fb_draw_pixel(&(p->framebuf), col, row, 1);
-		}
-	}
+	fb_draw_box(p->drawbuf, xstart, yend + 1, xend - xstart, ystart - yend, FB_BLACK);
 }
 
 
@@ -495,7 +686,6 @@ glcd_hbar(Driver *drvthis, int x, int y, int len, int promille, int options)
 {
 	PrivateData *p = drvthis->private_data;
 	int xstart, xend, ystart, yend;
-	int col, row;
 
 	debug(RPT_DEBUG, "%s(%i,%i,%i,%i,%i)", __FUNCTION__, x, y, len, promille, options);
 
@@ -505,12 +695,7 @@ glcd_hbar(Driver *drvthis, int x, int y, int len, int promille, int options)
 	ystart = (y - 1) * p->cellheight + 1;
 	yend = ystart + p->cellheight - 1;
 
-	for (row = ystart; row < yend; row++) {
-		for (col = xstart; col < xend; col++) {
-			fb_draw_pixel(&(p->framebuf), col, row, 1);
-		}
-	}
-
+	fb_draw_box(p->drawbuf, xstart, ystart, xend - xstart, yend - ystart, FB_BLACK);
 }
 
 
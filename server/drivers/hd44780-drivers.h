@@ -62,66 +62,68 @@
  * - connection type identifier
  * - interface type
  * - initialisation function
+ * - cost of moving the cursor, in data bytes: an unchanged part of a line
+ *   is skipped when it is longer than this
  */
 static const ConnectionMapping connectionMapping[] = {
 #ifdef HAVE_PCSTYLE_LPT_CONTROL
 	/* parallel connection types */
-	{ "4bit",          HD44780_CT_4BIT,          IF_TYPE_PARPORT, hd_init_4bit      },
-	{ "8bit",          HD44780_CT_8BIT,          IF_TYPE_PARPORT, hd_init_ext8bit   },
-	{ "serialLpt",     HD44780_CT_SERIALLPT,     IF_TYPE_PARPORT, hd_init_serialLpt },
-	{ "winamp",        HD44780_CT_WINAMP,        IF_TYPE_PARPORT, hd_init_winamp    },
-	{ "lcm162",        HD44780_CT_LCM162,        IF_TYPE_PARPORT, hd_init_lcm162    },
+	{ "4bit",          HD44780_CT_4BIT,          IF_TYPE_PARPORT, hd_init_4bit,      1 },
+	{ "8bit",          HD44780_CT_8BIT,          IF_TYPE_PARPORT, hd_init_ext8bit,   1 },
+	{ "serialLpt",     HD44780_CT_SERIALLPT,     IF_TYPE_PARPORT, hd_init_serialLpt, 1 },
+	{ "winamp",        HD44780_CT_WINAMP,        IF_TYPE_PARPORT, hd_init_winamp,    1 },
+	{ "lcm162",        HD44780_CT_LCM162,        IF_TYPE_PARPORT, hd_init_lcm162,    1 },
 #endif
 	/* serial connection types */
-	{ "picanlcd",      HD44780_CT_PICANLCD,      IF_TYPE_SERIAL,  hd_init_serial    },
-	{ "lcdserializer", HD44780_CT_LCDSERIALIZER, IF_TYPE_SERIAL,  hd_init_serial    },
-	{ "los-panel",     HD44780_CT_LOS_PANEL,     IF_TYPE_SERIAL,  hd_init_serial    },
-	{ "vdr-lcd",       HD44780_CT_VDR_LCD,       IF_TYPE_SERIAL,  hd_init_serial    },
-	{ "vdr-wakeup",    HD44780_CT_VDR_WAKEUP,    IF_TYPE_SERIAL,  hd_init_serial    },
-	{ "pertelian",     HD44780_CT_PERTELIAN,     IF_TYPE_SERIAL,  hd_init_serial    },
-	{ "ezio",          HD44780_CT_EZIO,          IF_TYPE_SERIAL,  hd_init_serial    },
+	{ "picanlcd",      HD44780_CT_PICANLCD,      IF_TYPE_SERIAL,  hd_init_serial,    2 },
+	{ "lcdserializer", HD44780_CT_LCDSERIALIZER, IF_TYPE_SERIAL,  hd_init_serial,    2 },
+	{ "los-panel",     HD44780_CT_LOS_PANEL,     IF_TYPE_SERIAL,  hd_init_serial,    2 },
+	{ "vdr-lcd",       HD44780_CT_VDR_LCD,       IF_TYPE_SERIAL,  hd_init_serial,    2 },
+	{ "vdr-wakeup",    HD44780_CT_VDR_WAKEUP,    IF_TYPE_SERIAL,  hd_init_serial,    2 },
+	{ "pertelian",     HD44780_CT_PERTELIAN,     IF_TYPE_SERIAL,  hd_init_serial,    2 },
+	{ "ezio",          HD44780_CT_EZIO,          IF_TYPE_SERIAL,  hd_init_serial,    2 },
 	/* USB connection types */
-	{ "lis2",          HD44780_CT_LIS2,          IF_TYPE_USB,     hd_init_lis2      },
-	{ "mplay",         HD44780_CT_MPLAY,         IF_TYPE_USB,     hd_init_lis2      },
-	{ "usblcd",        HD44780_CT_USBLCD,        IF_TYPE_USB,     hd_init_usblcd    },
+	{ "lis2",          HD44780_CT_LIS2,          IF_TYPE_USB,     hd_init_lis2,      1 },
+	{ "mplay",         HD44780_CT_MPLAY,         IF_TYPE_USB,     hd_init_lis2,      1 },
+	{ "usblcd",        HD44780_CT_USBLCD,        IF_TYPE_USB,     hd_init_usblcd,    1 },
 #ifdef HAVE_LIBUSB
-	{ "bwctusb",       HD44780_CT_BWCTUSB,       IF_TYPE_USB,     hd_init_bwct_usb  },
-	{ "usbtiny",       HD44780_CT_USBTINY,       IF_TYPE_USB,     hd_init_usbtiny   },
-	{ "uss720",        HD44780_CT_USS720,        IF_TYPE_USB,     hd_init_uss720    },
-	{ "usb4all",       HD44780_CT_USB4ALL,       IF_TYPE_USB,     hd_init_usb4all   },
+	{ "bwctusb",       HD44780_CT_BWCTUSB,       IF_TYPE_USB,     hd_init_bwct_usb,  1 },
+	{ "usbtiny",       HD44780_CT_USBTINY,       IF_TYPE_USB,     hd_init_usbtiny,   1 },
+	{ "uss720",        HD44780_CT_USS720,        IF_TYPE_USB,     hd_init_uss720,    1 },
+	{ "usb4all",       HD44780_CT_USB4ALL,       IF_TYPE_USB,     hd_init_usb4all,   1 },
 #endif
 #ifdef HAVE_LIBUSB_1_0
-    { "lcd2usb",       HD44780_CT_LCD2USB,       IF_TYPE_USB,     hd_init_lcd2usb   },
+    { "lcd2usb",       HD44780_CT_LCD2USB,       IF_TYPE_USB,     hd_init_lcd2usb,   8 },
 #endif
 #ifdef HAVE_LIBFTDI
-	{ "ftdi",          HD44780_CT_FTDI,          IF_TYPE_USB,     hd_init_ftdi      },
+	{ "ftdi",          HD44780_CT_FTDI,          IF_TYPE_USB,     hd_init_ftdi,      1 },
 #endif
 	/* I2C connection types */
 #ifdef HAVE_I2C
-	{ "i2c",           HD44780_CT_I2C,           IF_TYPE_I2C,     hd_init_i2c       },
-        { "piplate",       HD44780_CT_PIPLATE,       IF_TYPE_I2C,     hd_init_i2c_piplate },
+	{ "i2c",           HD44780_CT_I2C,           IF_TYPE_I2C,     hd_init_i2c,       2 },
+        { "piplate",       HD44780_CT_PIPLATE,       IF_TYPE_I2C,     hd_init_i2c_piplate, 1 },
 #endif
 #ifdef HAVE_SPI
-	{ "spi",           HD44780_CT_SPI,           IF_TYPE_SPI,     hd_init_spi       },
-	{ "pifacecad",     HD44780_CT_PIFACECAD,     IF_TYPE_SPI,     hd_init_pifacecad },
+	{ "spi",           HD44780_CT_SPI,           IF_TYPE_SPI,     hd_init_spi,       2 },
+	{ "pifacecad",     HD44780_CT_PIFACECAD,     IF_TYPE_SPI,     hd_init_pifacecad, 1 },
 #endif
 	/* TCP socket connection types */
 #ifdef WITH_ETHLCD
-	{ "ethlcd",        HD44780_CT_ETHLCD,        IF_TYPE_TCP,     hd_init_ethlcd    },
+	{ "ethlcd",        HD44780_CT_ETHLCD,        IF_TYPE_TCP,     hd_init_ethlcd,    1 },
 #endif
 #ifdef WITH_RASPBERRYPI
-	{ "raspberrypi",   HD44780_CT_RASPBERRYPI,   IF_TYPE_PARPORT,  hd_init_rpi      },
+	{ "raspberrypi",   HD44780_CT_RASPBERRYPI,   IF_TYPE_PARPORT,  hd_init_rpi,      1 },
 #endif
 #ifdef HAVE_UGPIO
-	{ "ugpio",         HD44780_CT_UGPIO,          IF_TYPE_PARPORT, hd_init_ugpio     },
+	{ "ugpio",         HD44780_CT_UGPIO,          IF_TYPE_PARPORT, hd_init_ugpio,     1 },
 #endif
 #ifdef HAVE_GPIOD
-	{ "gpiod",         HD44780_CT_GPIOD,         IF_TYPE_PARPORT,  hd_init_gpiod     },
+	{ "gpiod",         HD44780_CT_GPIOD,         IF_TYPE_PARPORT,  hd_init_gpiod,     1 },
 #endif
 	/* add new connection types in the correct section above or here */
 
 	/* default, end of structure element (do not delete) */
-	{ NULL, HD44780_CT_UNKNOWN, IF_TYPE_UNKNOWN, NULL }
+	{ NULL, HD44780_CT_UNKNOWN, IF_TYPE_UNKNOWN, NULL, 0 }
 };
 
 #endif
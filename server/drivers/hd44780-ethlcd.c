@@ -6,6 +6,13 @@
  * and ENC28J60 ethernet controller. The device is connected via ethernet, has
  * its own IP address and is available via TCP protocol. More info at project
  * homepage: http://manio.skyboo.net/ethlcd/
+ *
+ * The device replies to every request with its command byte. Waiting for
+ * each reply costs a network round trip per character, so with the option
+ * EthlcdPipeline the requests of a whole flush are written at once and up
+ * to that many of them are on the way before the replies are read. The
+ * replies come in the order of the requests over TCP; each one is matched
+ * with the command byte of its request.
  */
 
 /*-
@@ -16,6 +23,7 @@
  */
 
 #include <string.h>
+#include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/socket.h>
@@ -29,12 +37,18 @@
 
 
 void ethlcd_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned char flags, unsigned char ch);
+void ethlcd_HD44780_senddata_bulk(PrivateData *p, unsigned char displayID, unsigned char flags,
+				  const unsigned char *buf, int len);
+void ethlcd_HD44780_flush(PrivateData *p);
 unsigned char ethlcd_HD44780_scankeypad(PrivateData *p);
 void ethlcd_HD44780_backlight(PrivateData *p, unsigned char state);
 void ethlcd_HD44780_close(PrivateData *p);
 
-/* helper function */
+/* helper functions */
 static void ethlcd_send_low(PrivateData *p, unsigned char *data, int length);
+static void ethlcd_queue_request(PrivateData *p, unsigned char cmd, unsigned char value);
+static void ethlcd_send_queue(PrivateData *p);
+static void ethlcd_read_replies(PrivateData *p, int count);
 
 /* fake pause function (pausing is handled by ethlcd device itself) */
 void
@@ -68,6 +82,19 @@ hd_init_ethlcd(Driver *drvthis)
 	strncpy(hostname, drvthis->config_get_string(drvthis->name, "Device", 0, "ethlcd"), sizeof(hostname));
 	hostname[sizeof(hostname) - 1] = '\0';
 
+	p->ethlcd_pipeline = drvthis->config_get_int(drvthis->name, "EthlcdPipeline", 0, 1);
+	if ((p->ethlcd_pipeline < 1) || (p->ethlcd_pipeline > ETHLCD_MAX_PIPELINE)) {
+		report(RPT_WARNING, "%s[%s]: EthlcdPipeline must be between 1 and %d; using 1",
+			drvthis->name, ETHLCD_DRV_NAME, ETHLCD_MAX_PIPELINE);
+		p->ethlcd_pipeline = 1;
+	}
+	p->ethlcd_queued = 0;
+	p->ethlcd_in_flight = 0;
+	if (p->ethlcd_pipeline > 1) {
+		hd44780_functions->senddata_bulk = ethlcd_HD44780_senddata_bulk;
+		hd44780_functions->flush = ethlcd_HD44780_flush;
+	}
+
 	p->sock = sock_connect(hostname, DEFAULT_ETHLCD_PORT);
 	if (p->sock < 0) {
 		report(RPT_ERR, "%s[%s]: Connecting to %s:%d failed",
@@ -134,7 +161,45 @@ ethlcd_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned char f
 		buff[0] = ETHLCD_SEND_DATA;
 	buff[1] = ch;
 
-	ethlcd_send_low(p, buff, 2);
+	if (p->ethlcd_pipeline > 1)
+		ethlcd_queue_request(p, buff[0], buff[1]);
+	else
+		ethlcd_send_low(p, buff, 2);
+}
+
+
+/**
+ * Send several bytes of data or commands to the display, for EthlcdPipeline.
+ * They are only queued; ethlcd_HD44780_flush() sends the rest.
+ * \param p          Pointer to driver's private data structure.
+ * \param displayID  ID of the display (or 0 for all) to send data to.
+ * \param flags      Defines whether to end a command or data.
+ * \param buf        The values to send.
+ * \param len        Number of values in buf.
+ */
+void
+ethlcd_HD44780_senddata_bulk(PrivateData *p, unsigned char displayID, unsigned char flags,
+			     const unsigned char *buf, int len)
+{
+	unsigned char cmd = (flags == RS_INSTR) ? ETHLCD_SEND_INSTR : ETHLCD_SEND_DATA;
+	int i;
+
+	for (i = 0; i < len; i++)
+		ethlcd_queue_request(p, cmd, buf[i]);
+}
+
+
+/**
+ * Send the requests queued and wait for all their replies, for
+ * EthlcdPipeline. Called at the end of every flush, and before requests
+ * that are answered with data.
+ * \param p  Pointer to driver's private data structure.
+ */
+void
+ethlcd_HD44780_flush(PrivateData *p)
+{
+	ethlcd_send_queue(p);
+	ethlcd_read_replies(p, p->ethlcd_in_flight);
 }
 
 
@@ -151,6 +216,8 @@ ethlcd_HD44780_scankeypad(PrivateData *p)
 
 	buff[0] = ETHLCD_GET_BUTTONS;
 
+	if (p->ethlcd_pipeline > 1)
+		ethlcd_HD44780_flush(p);
 	ethlcd_send_low(p, buff, 1);
 
 	/* answer should be in second byte on bits 0-6 in negative logic: */
@@ -197,6 +264,8 @@ ethlcd_HD44780_backlight(PrivateData *p, unsigned char state)
 	else
 		buff[1] = ETHLCD_BACKLIGHT_OFF;
 
+	if (p->ethlcd_pipeline > 1)
+		ethlcd_HD44780_flush(p);
 	ethlcd_send_low(p, buff, 2);
 }
 
@@ -208,6 +277,8 @@ ethlcd_HD44780_backlight(PrivateData *p, unsigned char state)
 void
 ethlcd_HD44780_close(PrivateData *p)
 {
+	if ((p->ethlcd_pipeline > 1) && !p->device_lost)
+		ethlcd_HD44780_flush(p);
 	sock_close(p->sock);
 }
 
@@ -269,3 +340,103 @@ ethlcd_send_low(PrivateData *p, unsigned char *data, int length)
 		exit(-1);
 	}
 }
+
+
+/**
+ * Queue a request for EthlcdPipeline. A full batch of requests is written
+ * at once; before the next one, the replies are read until there is room
+ * for it on the way to the device.
+ * \param p      Pointer to driver's private data structure.
+ * \param cmd    Command byte of the request.
+ * \param value  Its argument.
+ */
+static void
+ethlcd_queue_request(PrivateData *p, unsigned char cmd, unsigned char value)
+{
+	/* half of the pipeline is written at once, so that the device works
+	 * on one batch while the next one travels */
+	int batch = p->ethlcd_pipeline / 2;
+
+	if (p->device_lost)
+		return;
+
+	p->ethlcd_queue[2 * p->ethlcd_queued] = cmd;
+	p->ethlcd_queue[2 * p->ethlcd_queued + 1] = value;
+	p->ethlcd_queued++;
+	if (p->ethlcd_queued < batch)
+		return;
+
+	ethlcd_send_queue(p);
+	if (p->ethlcd_in_flight > p->ethlcd_pipeline - batch)
+		ethlcd_read_replies(p, p->ethlcd_in_flight - (p->ethlcd_pipeline - batch));
+}
+
+
+/**
+ * Write the queued requests to the device with a single call.
+ * \param p  Pointer to driver's private data structure.
+ */
+static void
+ethlcd_send_queue(PrivateData *p)
+{
+	int i;
+
+	if (p->device_lost || (p->ethlcd_queued == 0))
+		return;
+
+	if (sock_send(p->sock, p->ethlcd_queue, 2 * p->ethlcd_queued) < 2 * p->ethlcd_queued) {
+		p->hd44780_functions->drv_report(RPT_ERR, "%s: Write to socket failed: %s",
+					ETHLCD_DRV_NAME, strerror(errno));
+		p->ethlcd_queued = 0;
+		p->device_lost = 1;
+		return;
+	}
+	for (i = 0; i < p->ethlcd_queued; i++)
+		p->ethlcd_sent[p->ethlcd_in_flight++] = p->ethlcd_queue[2 * i];
+	p->ethlcd_queued = 0;
+}
+
+
+/**
+ * Read the replies to the oldest requests on the way and match each with
+ * its request. A missing or wrong reply leaves the requests sent since in
+ * an unknown state, so the device counts as lost then; the server
+ * reconnects it.
+ * \param p      Pointer to driver's private data structure.
+ * \param count  Number of replies to read.
+ */
+static void
+ethlcd_read_replies(PrivateData *p, int count)
+{
+	unsigned char replies[ETHLCD_MAX_PIPELINE];
+	int got = 0;
+	int i;
+
+	if (p->device_lost || (count <= 0))
+		return;
+
+	while (got < count) {
+		int len = sock_recv(p->sock, replies + got, count - got);
+
+		if (len <= 0) {
+			p->hd44780_functions->drv_report(RPT_ERR, "%s: Read from socket failed: %s",
+						ETHLCD_DRV_NAME, strerror(errno));
+			p->ethlcd_in_flight = 0;
+			p->device_lost = 1;
+			return;
+		}
+		got += len;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (replies[i] != p->ethlcd_sent[i]) {
+			p->hd44780_functions->drv_report(RPT_ERR, "%s: Invalid device response: got 0x%02X, expected: 0x%02X",
+						ETHLCD_DRV_NAME, replies[i], p->ethlcd_sent[i]);
+			p->ethlcd_in_flight = 0;
+			p->device_lost = 1;
+			return;
+		}
+	}
+	p->ethlcd_in_flight -= count;
+	memmove(p->ethlcd_sent, p->ethlcd_sent + count, p->ethlcd_in_flight);
+}
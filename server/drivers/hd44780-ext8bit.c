@@ -72,6 +72,7 @@ void lcdtime_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned
 void lcdtime_HD44780_backlight(PrivateData *p, unsigned char state);
 unsigned char lcdtime_HD44780_readkeypad(PrivateData *p, unsigned int YData);
 void lcdtime_HD44780_output(PrivateData *p, int data);
+int lcdtime_HD44780_readbusy(PrivateData *p, unsigned char displayID);
 
 #define RS	STRB
 #define RW	LF
@@ -101,6 +102,7 @@ hd_init_ext8bit(Driver *drvthis)
 	hd44780_functions->senddata = lcdtime_HD44780_senddata;
 	hd44780_functions->backlight = lcdtime_HD44780_backlight;
 	hd44780_functions->readkeypad = lcdtime_HD44780_readkeypad;
+	hd44780_functions->readbusy = lcdtime_HD44780_readbusy;
 
 	// setup the lcd in 8 bit mode
 	hd44780_functions->senddata(p, 0, RS_INSTR, FUNCSET | IF_8BIT);
@@ -153,6 +155,34 @@ lcdtime_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned char
 }
 
 
+/**
+ * Read the busy flag. The data port is switched to input (this needs a
+ * bi-directional port, set to PS/2 or EPP mode in the BIOS) and R/W is
+ * raised, so R/W must be wired to nLF for this.
+ * \param p          Pointer to driver's private data structure.
+ * \param displayID  ID of the display to read from.
+ * \return  1 if the display is busy, 0 if it is ready.
+ */
+int
+lcdtime_HD44780_readbusy(PrivateData *p, unsigned char displayID)
+{
+	unsigned char portControl = ENBI | RW | p->backlight_bit;
+	unsigned char readval;
+
+	port_out(p->port + 2, portControl ^ OUTMASK);
+	if (p->delayBus) p->hd44780_functions->uPause(p, 1);
+	port_out(p->port + 2, (EN1|portControl) ^ OUTMASK);
+	if (p->delayBus) p->hd44780_functions->uPause(p, 1);
+	readval = port_in(p->port);
+	port_out(p->port + 2, portControl ^ OUTMASK);
+
+	/* back to writing */
+	port_out(p->port + 2, p->backlight_bit ^ OUTMASK);
+
+	return (readval & 0x80) ? 1 : 0;
+}
+
+
 /**
  * Turn display backlight on or off.
  * \param p      Pointer to driver's private data structure.
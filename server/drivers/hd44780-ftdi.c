@@ -49,12 +49,104 @@
 
 #include "hd44780-ftdi.h"
 #include "hd44780-low.h"
+#include "timing.h"
 #include "shared/report.h"
 
 /* connection type specific functions to be exposed using pointers in init() */
 void ftdi_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned char flags, unsigned char ch);
 void ftdi_HD44780_backlight(PrivateData *p, unsigned char state);
 void ftdi_HD44780_close(PrivateData *p);
+void ftdi_HD44780_uPause(PrivateData *p, int usecs);
+void ftdi_HD44780_flush(PrivateData *p);
+
+/**
+ * Bitbang bytes per microsecond the fastest FTDI chips clock out. A pause
+ * is made of this many copies of the last byte per microsecond; on slower
+ * chips it just lasts longer.
+ */
+#define FTDI_BYTES_PER_USEC	3
+/** Longest pause (in microseconds) made of bitbang bytes instead of waiting */
+#define FTDI_PAD_MAX_USECS	100
+
+
+/**
+ * Write the queued bitbang bytes of the 4 bit wiring. They are collected
+ * until the display has to wait longer than FTDI_PAD_MAX_USECS, the frame
+ * ends or the queue is full, so a frame takes a few large USB transfers
+ * instead of one per character.
+ * \param p  Pointer to driver's private data structure.
+ */
+static void
+ftdi_send_queue(PrivateData *p)
+{
+    int f;
+
+    if (p->ftdi_queued == 0)
+	return;
+
+    f = ftdi_write_data(&p->ftdic, p->ftdi_queue, p->ftdi_queued);
+    if (f < 0) {
+	p->hd44780_functions->drv_report(RPT_ERR, "failed to write: %d (%s). Exiting",
+				   f, ftdi_get_error_string(&p->ftdic));
+	exit(-1);
+    }
+    p->ftdi_queued = 0;
+}
+
+
+/**
+ * Add bitbang bytes to the queue, writing it first if they do not fit.
+ * \param p    Pointer to driver's private data structure.
+ * \param buf  Bytes to add.
+ * \param len  Number of bytes.
+ */
+static void
+ftdi_queue(PrivateData *p, const unsigned char *buf, int len)
+{
+    if (p->ftdi_queued + len > FTDI_QUEUE_BYTES)
+	ftdi_send_queue(p);
+    memcpy(p->ftdi_queue + p->ftdi_queued, buf, len);
+    p->ftdi_queued += len;
+}
+
+
+/**
+ * Wait for the display. With the 4 bit wiring a short pause becomes part of
+ * the queued bitbang bytes: the last byte is repeated for as long as the
+ * chip takes to clock the copies out. Longer pauses write the queue first.
+ * \param p      Pointer to driver's private data structure.
+ * \param usecs  Micro seconds to wait.
+ */
+void
+ftdi_HD44780_uPause(PrivateData *p, int usecs)
+{
+    int n = usecs * p->delayMult * FTDI_BYTES_PER_USEC;
+
+    if ((p->ftdi_queued > 0) && (usecs * p->delayMult <= FTDI_PAD_MAX_USECS)) {
+	unsigned char idle = p->ftdi_queue[p->ftdi_queued - 1];
+
+	while (n-- > 0) {
+	    if (p->ftdi_queued == FTDI_QUEUE_BYTES)
+		ftdi_send_queue(p);
+	    p->ftdi_queue[p->ftdi_queued++] = idle;
+	}
+	return;
+    }
+
+    ftdi_send_queue(p);
+    timing_uPause(usecs * p->delayMult);
+}
+
+
+/**
+ * Write the queued bitbang bytes at the end of a frame.
+ * \param p  Pointer to driver's private data structure.
+ */
+void
+ftdi_HD44780_flush(PrivateData *p)
+{
+    ftdi_send_queue(p);
+}
 
 
 /**
@@ -175,9 +267,15 @@ hd_init_ftdi(Driver *drvthis)
 	common_init(p, IF_8BIT);
     }
     else if (p->ftdi_mode == 4) {
+	p->hd44780_functions->uPause = ftdi_HD44780_uPause;
+	p->hd44780_functions->flush = ftdi_HD44780_flush;
+
 	ftdi_HD44780_senddata(p, 0, RS_INSTR, FUNCSET | IF_4BIT);
+	ftdi_HD44780_uPause(p, 4100);
 	ftdi_HD44780_senddata(p, 0, RS_INSTR, FUNCSET | IF_4BIT);
+	ftdi_HD44780_uPause(p, 4100);
 	ftdi_HD44780_senddata(p, 0, RS_INSTR, FUNCSET | IF_4BIT);
+	ftdi_HD44780_uPause(p, 4100);
 
 	common_init(p, IF_4BIT);
     }
@@ -255,17 +353,9 @@ ftdi_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned char fla
 	buf[1] = ((ch >> 4) & 0x0F) | portControl;
 	buf[2] = (ch & 0x0F) | portControl | enableLines;
 	buf[3] = (ch & 0x0F) | portControl;
-	int f = ftdi_write_data(&p->ftdic, buf, 4);
-
-	if (f < 0) {
-	    p->hd44780_functions->drv_report(RPT_ERR, "failed to write: %d (%s). Exiting",
-				       f, ftdi_get_error_string(&p->ftdic));
-	    exit(-1);
-	}
 
-	if (flags == RS_INSTR) {
-	    usleep(4100);
-	}
+	/* written with the frame; the pause after it is queued as well */
+	ftdi_queue(p, buf, 4);
     }
 }
 
@@ -293,12 +383,8 @@ ftdi_HD44780_backlight(PrivateData *p, unsigned char state)
 	}
     }
     else {
-	f = ftdi_write_data(&p->ftdic, buf, 1);
-	if (f < 0) {
-	    p->hd44780_functions->drv_report(RPT_ERR, "failed to write: %d (%s). Exiting",
-				  f, ftdi_get_error_string(&p->ftdic));
-	    exit(-1);
-	}
+	ftdi_queue(p, buf, 1);
+	ftdi_send_queue(p);
     }
 }
 
@@ -310,6 +396,8 @@ ftdi_HD44780_backlight(PrivateData *p, unsigned char state)
 void
 ftdi_HD44780_close(PrivateData *p)
 {
+    ftdi_send_queue(p);
+
     ftdi_disable_bitbang(&p->ftdic);
     ftdi_usb_close(&p->ftdic);
     ftdi_deinit(&p->ftdic);
@@ -35,6 +35,9 @@ void gpiod_HD44780_backlight(PrivateData *p, unsigned char state);
 void gpiod_HD44780_reset(PrivateData *p);
 void gpiod_HD44780_close(PrivateData *p);
 
+/* Bytes of a frame go straight to senddata, with the delay inlined */
+HD44780_SENDDATA_BULK(gpiod_HD44780_senddata_bulk, gpiod_HD44780_senddata)
+
 typedef struct {
 	struct gpiod_chip *chip;
 	struct gpiod_line *en;
@@ -46,11 +49,12 @@ typedef struct {
 	struct gpiod_line *en2;
 	struct gpiod_line *bl;
 	struct gpiod_line *rw;
+	struct gpiod_line_bulk data;	/* D4 to D7, requested together */
 } gpio_pins;
 
 /**
- * Initialize a struct gpiod_line context by reading the related configuration
- * option.
+ * Get the GPIO line of a pin from the related configuration option, without
+ * requesting it.
  *
  * \param drvthis   Pointer to driver structure.
  * \param pin       Pointer to struct gpiod_line *structure to be initialized.
@@ -58,7 +62,7 @@ typedef struct {
  * \return          0 on success; -1 on error.
  */
 static int
-init_gpio_pin(Driver *drvthis, struct gpiod_line **pin, const char *name)
+get_gpio_pin(Driver *drvthis, struct gpiod_line **pin, const char *name)
 {
 	PrivateData *p = (PrivateData *) drvthis->private_data;
 	gpio_pins *pins = (gpio_pins *) p->connection_data;
@@ -77,14 +81,69 @@ init_gpio_pin(Driver *drvthis, struct gpiod_line **pin, const char *name)
 		return -1;
 	}
 
+	report(RPT_INFO, "init_gpio_pin: Pin %s mapped to GPIO%d", name, number);
+
+	return 0;
+}
+
+
+/**
+ * Initialize a struct gpiod_line context by reading the related configuration
+ * option.
+ *
+ * \param drvthis   Pointer to driver structure.
+ * \param pin       Pointer to struct gpiod_line *structure to be initialized.
+ * \param name      Name of the GPIO pin.
+ * \return          0 on success; -1 on error.
+ */
+static int
+init_gpio_pin(Driver *drvthis, struct gpiod_line **pin, const char *name)
+{
+	if (get_gpio_pin(drvthis, pin, name) != 0)
+		return -1;
+
 	if (gpiod_line_request_output(*pin, "LCDd", 0) < 0) {
 		report(RPT_ERR, "init_gpio_pin: unable to open file descriptor for GPIO%d: %s",
-		       number, strerror(errno));
+		       gpiod_line_offset(*pin), strerror(errno));
 		*pin = NULL;
 		return -1;
 	}
 
-	report(RPT_INFO, "init_gpio_pin: Pin %s mapped to GPIO%d", name, number);
+	return 0;
+}
+
+
+/**
+ * Initialize the data lines D4 to D7 as one request, so a nibble is set
+ * with a single call.
+ *
+ * \param drvthis   Pointer to driver structure.
+ * \return          0 on success; -1 on error.
+ */
+static int
+init_gpio_data_pins(Driver *drvthis)
+{
+	PrivateData *p = (PrivateData *) drvthis->private_data;
+	gpio_pins *pins = (gpio_pins *) p->connection_data;
+	static const int zeros[4] = { 0, 0, 0, 0 };
+
+	if (get_gpio_pin(drvthis, &pins->d4, "D4") != 0 ||
+	    get_gpio_pin(drvthis, &pins->d5, "D5") != 0 ||
+	    get_gpio_pin(drvthis, &pins->d6, "D6") != 0 ||
+	    get_gpio_pin(drvthis, &pins->d7, "D7") != 0)
+		return -1;
+
+	gpiod_line_bulk_init(&pins->data);
+	gpiod_line_bulk_add(&pins->data, pins->d4);
+	gpiod_line_bulk_add(&pins->data, pins->d5);
+	gpiod_line_bulk_add(&pins->data, pins->d6);
+	gpiod_line_bulk_add(&pins->data, pins->d7);
+
+	if (gpiod_line_request_bulk_output(&pins->data, "LCDd", zeros) < 0) {
+		report(RPT_ERR, "init_gpio_pin: unable to open file descriptor for data pins: %s",
+		       strerror(errno));
+		return -1;
+	}
 
 	return 0;
 }
@@ -100,24 +159,26 @@ static void
 send_nibble(PrivateData *p, unsigned char ch, unsigned char displayID)
 {
 	gpio_pins *pins = (gpio_pins *) p->connection_data;
+	int values[4];
 
-	gpiod_line_set_value(pins->d7, ch & 0x08);
-	gpiod_line_set_value(pins->d6, ch & 0x04);
-	gpiod_line_set_value(pins->d5, ch & 0x02);
-	gpiod_line_set_value(pins->d4, ch & 0x01);
+	values[0] = ch & 0x01;		/* D4 */
+	values[1] = (ch >> 1) & 0x01;	/* D5 */
+	values[2] = (ch >> 2) & 0x01;	/* D6 */
+	values[3] = (ch >> 3) & 0x01;	/* D7 */
+	gpiod_line_set_value_bulk(&pins->data, values);
 
 	/* Data is clocked on the falling edge of EN */
 	if (displayID == 1 || displayID == 0)
 		gpiod_line_set_value(pins->en, 1);
 	if (displayID == 2 || (p->numDisplays > 1 && displayID == 0))
 		gpiod_line_set_value(pins->en2, 1);
-        p->hd44780_functions->uPause(p, 50);
+	hd44780_uPause(p, 50);
 
 	if (displayID == 1 || displayID == 0)
 		gpiod_line_set_value(pins->en, 0);
 	if (displayID == 2 || (p->numDisplays > 1 && displayID == 0))
 		gpiod_line_set_value(pins->en2, 0);
-	p->hd44780_functions->uPause(p, 50);
+	hd44780_uPause(p, 50);
 }
 
 
@@ -158,10 +219,7 @@ hd_init_gpiod(Driver *drvthis)
 
 	if (init_gpio_pin(drvthis, &pins->en, "EN") != 0 ||
 	    init_gpio_pin(drvthis, &pins->rs, "RS") != 0 ||
-	    init_gpio_pin(drvthis, &pins->d7, "D7") != 0 ||
-	    init_gpio_pin(drvthis, &pins->d6, "D6") != 0 ||
-	    init_gpio_pin(drvthis, &pins->d5, "D5") != 0 ||
-	    init_gpio_pin(drvthis, &pins->d4, "D4") != 0) {
+	    init_gpio_data_pins(drvthis) != 0) {
 		report(RPT_ERR, "hd_init_gpio: unable to initialize GPIO pins");
 		gpiod_HD44780_close(p);
 		return -1;
@@ -176,6 +234,8 @@ hd_init_gpiod(Driver *drvthis)
 	}
 
 	p->hd44780_functions->senddata = gpiod_HD44780_senddata;
+	if (p->numDisplays == 1)
+		p->hd44780_functions->senddata_bulk = gpiod_HD44780_senddata_bulk;
 	p->hd44780_functions->close = gpiod_HD44780_close;
 	p->hd44780_functions->reset = gpiod_HD44780_reset;
 
@@ -211,9 +271,9 @@ gpiod_HD44780_reset(PrivateData *p)
 	gpiod_line_set_value(pins->rs, 0);
 
 	send_nibble(p, (FUNCSET | IF_8BIT) >> 4, 0);
-	p->hd44780_functions->uPause(p, 4100);
+	hd44780_uPause(p, 4100);
 	send_nibble(p, (FUNCSET | IF_8BIT) >> 4, 0);
-	p->hd44780_functions->uPause(p, 100);
+	hd44780_uPause(p, 100);
 	send_nibble(p, (FUNCSET | IF_8BIT) >> 4, 0);
 	send_nibble(p, (FUNCSET | IF_4BIT) >> 4, 0);
 
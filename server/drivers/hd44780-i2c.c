@@ -73,6 +73,7 @@
 
 #include "hd44780-i2c.h"
 #include "hd44780-low.h"
+#include "timing.h"
 
 #include "shared/report.h"
 #ifdef HAVE_CONFIG_H
@@ -92,6 +93,9 @@
 // HD44780_readkeypad
 
 void i2c_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned char flags, unsigned char ch);
+void i2c_HD44780_senddata_bulk(PrivateData *p, unsigned char displayID, unsigned char flags, const unsigned char *buf, int len);
+void i2c_HD44780_flush(PrivateData *p);
+void i2c_HD44780_uPause(PrivateData *p, int usecs);
 void i2c_HD44780_backlight(PrivateData *p, unsigned char state);
 void i2c_HD44780_close(PrivateData *p);
 
@@ -109,27 +113,78 @@ void i2c_HD44780_close(PrivateData *p);
 #define I2C_ADDR_MASK 0x7f
 #define I2C_PCAX_MASK 0x80
 
+/*
+ * The port states are not written one by one but collected in i2c_queue.
+ * All of them go to the bus in one transfer when the display has to wait
+ * (see i2c_HD44780_uPause()), at the end of a frame, or when the queue is
+ * full: a PCF8574 sets its port to each byte of a write in turn, a PCA9554
+ * gets one message with command byte per state in a combined transfer. A
+ * state stays on the port for the time of at least one byte on the bus
+ * (22us even at 400kHz), so the states need no pauses between them.
+ */
 static void
-i2c_out(PrivateData *p, unsigned char val)
+i2c_send_queue(PrivateData *p)
 {
-	unsigned char data[2];
-	int datalen;
+	int rc = 0;
+	int i;
 	static int no_more_errormsgs=0;
 
+	if (p->i2c_queued == 0)
+		return;
+
 	if (p->port & I2C_PCAX_MASK) { // we have a PCA9554 or similar, that needs a 2-byte command
-		data[0]=1; // command: read/write output port register
-		data[1]=val;
-		datalen=2;
+		unsigned char data[2];
+
+		data[0] = 1; // command: read/write output port register
+		for (i = 0; (i < p->i2c_queued) && (rc >= 0); i++) {
+			data[1] = p->i2c_queue[i];
+			rc = i2c_queue(p->i2c, data, 2);
+		}
+		if (rc >= 0)
+			rc = i2c_commit(p->i2c);
 	} else { // we have a PCF8574 or similar, that needs a 1-byte command
-		data[0]=val;
-		datalen=1;
+		rc = i2c_write(p->i2c, p->i2c_queue, p->i2c_queued);
 	}
 
-	if (i2c_write(p->i2c, data, datalen) < 0) {
-		p->hd44780_functions->drv_report(no_more_errormsgs?RPT_DEBUG:RPT_ERR, "HD44780: I2C: i2c write data %u failed: %s",
-			val, strerror(errno));
+	if (rc < 0) {
+		p->hd44780_functions->drv_report(no_more_errormsgs?RPT_DEBUG:RPT_ERR, "HD44780: I2C: i2c write of %d port states failed: %s",
+			p->i2c_queued, strerror(errno));
 		no_more_errormsgs=1;
 	}
+	p->i2c_queued = 0;
+}
+
+static void
+i2c_out(PrivateData *p, unsigned char val)
+{
+	if (p->i2c_queued == I2C_QUEUE_STATES)
+		i2c_send_queue(p);
+	p->i2c_queue[p->i2c_queued++] = val;
+}
+
+
+/**
+ * Write the queued port states before waiting, so the display gets the
+ * time it needs after the last of them.
+ * \param p      Pointer to driver's private data structure.
+ * \param usecs  Micro seconds to wait.
+ */
+void
+i2c_HD44780_uPause(PrivateData *p, int usecs)
+{
+	i2c_send_queue(p);
+	timing_uPause(usecs * p->delayMult);
+}
+
+
+/**
+ * Write the queued port states.
+ * \param p  Pointer to driver's private data structure.
+ */
+void
+i2c_HD44780_flush(PrivateData *p)
+{
+	i2c_send_queue(p);
 }
 
 
@@ -197,7 +252,11 @@ hd_init_i2c(Driver *drvthis)
 		}
 	}
 
+	p->i2c_queued = 0;
 	hd44780_functions->senddata = i2c_HD44780_senddata;
+	hd44780_functions->senddata_bulk = i2c_HD44780_senddata_bulk;
+	hd44780_functions->flush = i2c_HD44780_flush;
+	hd44780_functions->uPause = i2c_HD44780_uPause;
 	hd44780_functions->backlight = i2c_HD44780_backlight;
 	hd44780_functions->close = i2c_HD44780_close;
 
@@ -259,20 +318,16 @@ hd_init_i2c(Driver *drvthis)
 
 void
 i2c_HD44780_close(PrivateData *p) {
-	if (p->i2c >= 0)
+	if (p->i2c >= 0) {
+		i2c_send_queue(p);
 		i2c_close(p->i2c);
+	}
 }
 
 
-/**
- * Send data or commands to the display.
- * \param p          Pointer to driver's private data structure.
- * \param displayID  ID of the display (or 0 for all) to send data to.
- * \param flags      Defines whether to end a command or data.
- * \param ch         The value to send.
- */
-void
-i2c_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned char flags, unsigned char ch)
+/* The six port states that clock one byte into the display, in 4 bit mode */
+static void
+i2c_port_states(PrivateData *p, unsigned char flags, unsigned char ch, unsigned char *out)
 {
 	unsigned char portControl = 0;
 	unsigned char h=0;
@@ -292,21 +347,49 @@ i2c_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned char flag
 
 	portControl |= p->backlight_bit;
 
-	i2c_out(p, portControl | h);
-	if (p->delayBus)
-		p->hd44780_functions->uPause(p, 1);
-	i2c_out(p, p->i2c_line_EN | portControl | h);
-	if (p->delayBus)
-		p->hd44780_functions->uPause(p, 1);
-	i2c_out(p, portControl | h);
+	out[0] = portControl | h;
+	out[1] = p->i2c_line_EN | portControl | h;
+	out[2] = portControl | h;
+	out[3] = portControl | l;
+	out[4] = p->i2c_line_EN | portControl | l;
+	out[5] = portControl | l;
+}
 
-	i2c_out(p, portControl | l);
-	if (p->delayBus)
-		p->hd44780_functions->uPause(p, 1);
-	i2c_out(p, p->i2c_line_EN | portControl | l);
-	if (p->delayBus)
-		p->hd44780_functions->uPause(p, 1);
-	i2c_out(p, portControl | l);
+
+/**
+ * Send data or commands to the display.
+ * \param p          Pointer to driver's private data structure.
+ * \param displayID  ID of the display (or 0 for all) to send data to.
+ * \param flags      Defines whether to end a command or data.
+ * \param ch         The value to send.
+ */
+void
+i2c_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned char flags, unsigned char ch)
+{
+	i2c_HD44780_senddata_bulk(p, displayID, flags, &ch, 1);
+}
+
+
+/**
+ * Send several bytes of data or commands to the display. Their port
+ * states are queued; the caller's next pause writes them.
+ * \param p          Pointer to driver's private data structure.
+ * \param displayID  ID of the display (or 0 for all) to send data to.
+ * \param flags      Defines whether to end a command or data.
+ * \param buf        The values to send.
+ * \param len        Number of values.
+ */
+void
+i2c_HD44780_senddata_bulk(PrivateData *p, unsigned char displayID, unsigned char flags, const unsigned char *buf, int len)
+{
+	unsigned char states[6];
+	int i, j;
+
+	for (i = 0; i < len; i++) {
+		i2c_port_states(p, flags, buf[i], states);
+		for (j = 0; j < 6; j++)
+			i2c_out(p, states[j]);
+	}
 }
 
 
@@ -322,4 +405,5 @@ void i2c_HD44780_backlight(PrivateData *p, unsigned char state)
 	else // Inverted backlight - npn transistor
 		p->backlight_bit = ((have_backlight_pin(p) && state) ? p->i2c_line_BL : 0);
 	i2c_out(p, p->backlight_bit);
+	i2c_send_queue(p);
 }
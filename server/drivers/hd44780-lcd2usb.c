@@ -68,12 +68,18 @@ hd_init_lcd2usb(Driver *drvthis)
 	usb_debug = 2;
 #endif
 
-	libusb_init(NULL);
+	/* a context of its own: the transfers finish in our libusb calls only */
+	if (libusb_init(&p->libusbContext) != 0) {
+		report(RPT_ERR, "hd_init_lcd2usb: libusb_init failed");
+		p->libusbContext = NULL;
+		return -1;
+	}
 
 	libusb_device **list;
-	ssize_t count = libusb_get_device_list(NULL, &list);
+	ssize_t count = libusb_get_device_list(p->libusbContext, &list);
 	if (count < 0) {
 		report(RPT_WARNING, "hd_init_lcd2usb: list error %s", libusb_strerror(count));
+		lcd2usb_HD44780_close(p);
 		return -1;
 	}
 
@@ -122,6 +128,14 @@ hd_init_lcd2usb(Driver *drvthis)
 	}
 	else {
 		report(RPT_ERR, "hd_init_lcd2usb: no (matching) LCD2USB device found");
+		lcd2usb_HD44780_close(p);
+		return -1;
+	}
+
+	p->usbQueue = lib_usb_queue_new(drvthis, p->libusbContext, p->libusbHandle, LIB_USB_QUEUE_DEPTH);
+	if (p->usbQueue == NULL) {
+		report(RPT_ERR, "hd_init_lcd2usb: could not allocate transfer queue");
+		lcd2usb_HD44780_close(p);
 		return -1;
 	}
 
@@ -171,30 +185,40 @@ lcd2usb_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned char
 }
 
 /**
- * Actually send data or command to the display.
+ * Actually send data or command to the display. The message is only
+ * queued; earlier messages that have been sent meanwhile are collected.
  * \param p  Pointer to driver's private data structure.
  */
 void
 lcd2usb_HD44780_flush(PrivateData *p)
 {
-	/* only if some data available */
-	if (p->tx_buf.use_count == 0)
+	int rc;
+
+	if (p->device_lost)
 		return;
 
-	/* construct and send message */
-	if (libusb_control_transfer(
-			p->libusbHandle,
-			LIBUSB_REQUEST_TYPE_VENDOR,
-			p->tx_buf.type | (p->tx_buf.use_count - 1),
-			p->tx_buf.buffer[0] | (p->tx_buf.buffer[1] << 8),
-			p->tx_buf.buffer[2] | (p->tx_buf.buffer[3] << 8),
-			NULL, 0, 1000) < 0) {
-		p->hd44780_functions->drv_report(RPT_WARNING, "lcd2usb_HD44780_flush: flush failed");
+	/* only if some data available */
+	if (p->tx_buf.use_count > 0) {
+		/* construct and send message */
+		rc = lib_usb_control(p->usbQueue,
+				LIBUSB_REQUEST_TYPE_VENDOR,
+				p->tx_buf.type | (p->tx_buf.use_count - 1),
+				p->tx_buf.buffer[0] | (p->tx_buf.buffer[1] << 8),
+				p->tx_buf.buffer[2] | (p->tx_buf.buffer[3] << 8),
+				NULL, 0, 1000, NULL, NULL);
+		if ((rc < 0) && (rc != LIBUSB_ERROR_NO_DEVICE))
+			p->hd44780_functions->drv_report(RPT_WARNING, "lcd2usb_HD44780_flush: flush failed");
+
+		/* buffer is now free again. Not necessary to clear what's in it. */
+		p->tx_buf.type = -1;
+		p->tx_buf.use_count = 0;
 	}
 
-	/* buffer is now free again. Not necessary to clear what's in it. */
-	p->tx_buf.type = -1;
-	p->tx_buf.use_count = 0;
+	lib_usb_poll(p->usbQueue);
+	if (lib_usb_lost(p->usbQueue)) {
+		/* unplugged; HD44780_flush() tells the server */
+		p->device_lost = 1;
+	}
 }
 
 /**
@@ -213,8 +237,8 @@ lcd2usb_HD44780_backlight(PrivateData *p, unsigned char state)
 	p->hd44780_functions->drv_debug(RPT_DEBUG, "lcd2usb_HD44780_backlight: Setting backlight to %d", promille);
 
 	/* and set it (converted from [0,1000] -> [0,255]) */
-	if (libusb_control_transfer(p->libusbHandle, LIBUSB_REQUEST_TYPE_VENDOR, LCD2USB_SET_BRIGHTNESS,
-			     (promille * 255) / 1000, 0, NULL, 0, 1000) < 0)
+	if (lib_usb_control(p->usbQueue, LIBUSB_REQUEST_TYPE_VENDOR, LCD2USB_SET_BRIGHTNESS,
+			     (promille * 255) / 1000, 0, NULL, 0, 1000, NULL, NULL) < 0)
 		p->hd44780_functions->drv_report(RPT_WARNING, "lcd2usb_HD44780_backlight: setting backlight failed");
 }
 
@@ -227,8 +251,8 @@ lcd2usb_HD44780_backlight(PrivateData *p, unsigned char state)
 void
 lcd2usb_HD44780_set_contrast(PrivateData *p, unsigned char value)
 {
-	if (libusb_control_transfer(p->libusbHandle, LIBUSB_REQUEST_TYPE_VENDOR, LCD2USB_SET_CONTRAST,
-			     value, 0, NULL, 0, 1000) < 0)
+	if (lib_usb_control(p->usbQueue, LIBUSB_REQUEST_TYPE_VENDOR, LCD2USB_SET_CONTRAST,
+			     value, 0, NULL, 0, 1000, NULL, NULL) < 0)
 		p->hd44780_functions->drv_report(RPT_WARNING, "lcd2usb_HD44780_set_contrast: setting contrast failed");
 }
 
@@ -271,10 +295,19 @@ lcd2usb_HD44780_scankeypad(PrivateData *p)
 void
 lcd2usb_HD44780_close(PrivateData *p)
 {
+	/* let the queued messages reach the display first */
+	if (p->usbQueue != NULL) {
+		lib_usb_queue_free(p->usbQueue);
+		p->usbQueue = NULL;
+	}
 	if (p->libusbHandle != NULL) {
 		libusb_close(p->libusbHandle);
 		p->libusbHandle = NULL;
 	}
+	if (p->libusbContext != NULL) {
+		libusb_exit(p->libusbContext);
+		p->libusbContext = NULL;
+	}
 	if (p->tx_buf.buffer != NULL) {
 		free(p->tx_buf.buffer);
 		p->tx_buf.buffer = NULL;
@@ -133,6 +133,8 @@ int hd_init_lis2(Driver *drvthis)
 
 	p->hd44780_functions->senddata = lis2_HD44780_senddata;
 	p->hd44780_functions->close = lis2_HD44780_close;
+	/* the firmware counts the rows from the start of a char */
+	p->cc_whole = 1;
 
 	common_init(p, IF_8BIT);
 
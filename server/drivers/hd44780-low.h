@@ -16,6 +16,7 @@
 
 #ifdef HAVE_LIBUSB_1_0
 # include <libusb-1.0/libusb.h>
+# include "usb_lib.h"
 #endif
 
 #if TIME_WITH_SYS_TIME
@@ -33,7 +34,13 @@
 # include <ftdi.h>
 #endif
 
+#ifdef HAVE_GPIOD
+# include <gpiod.h>
+#endif
+
 #include "i2c.h"
+#include "lcd_lib.h"
+#include "timing.h"
 
 /** \name Symbolic names for connection types
  *@{*/
@@ -148,16 +155,33 @@
 /** number of custom characters */
 #define NUM_CCs 8
 
+/** port states the i2c connection type collects before writing them */
+#define I2C_QUEUE_STATES 1024
+
+/** bitbang bytes the ftdi connection type collects before writing them */
+#define FTDI_QUEUE_BYTES 4096
+
+/** most requests the ethlcd connection type keeps on the way to the device */
+#define ETHLCD_MAX_PIPELINE 64
+
 /**
  * One entry of the custom character cache consists of 8 bytes of cache data
- * and a clean flag.
+ * and a bit mask of the rows that differ from the display's CGRAM.
  */
 typedef struct cgram_cache {
 	unsigned char cache[LCD_DEFAULT_CELLHEIGHT];
-	int clean;
+	unsigned char dirty;	/**< bit n set: row n is to be sent */
 } CGram;
 
 
+/** A run of changed characters of a line, as HD44780_flush() sends it */
+typedef struct flush_run {
+	int x, y;		/**< position of the first character */
+	int len;		/**< number of characters */
+	int sent;		/**< characters sent; -1 before the position command */
+} FlushRun;
+
+
 /**
  * Provides necessary data to initialize a connection type (sub-driver).
  */
@@ -170,6 +194,9 @@ typedef struct ConnectionMapping {
 	int if_type;
 	/** Pointer to connection type's initialization function */
 	int (*init_fn) (Driver *drvthis);
+	/** Cost of a cursor position command compared to resending one
+	 *  character, see HD44780_flush() */
+	int position_cost;
 } ConnectionMapping;
 
 
@@ -206,7 +233,9 @@ typedef struct hd44780_private_data {
 #endif
 
 #ifdef HAVE_LIBUSB_1_0
+	libusb_context *libusbContext;	/**< libusb context of the driver */
 	libusb_device_handle *libusbHandle;
+	UsbQueue *usbQueue;		/**< Transfers on the way to the device */
 #endif
 
 #ifdef HAVE_LIBFTDI
@@ -219,6 +248,8 @@ typedef struct hd44780_private_data {
 	int ftdi_line_EN;
 	int ftdi_line_EN2;
 	int ftdi_line_backlight;
+	unsigned char ftdi_queue[FTDI_QUEUE_BYTES];	/**< bitbang bytes not yet written */
+	int ftdi_queued;	/**< number of bytes in ftdi_queue */
 #endif
 
 #ifdef HAVE_I2C
@@ -235,10 +266,18 @@ typedef struct hd44780_private_data {
 	int i2c_line_D7;
 
 	I2CHandle *i2c;
+	unsigned char i2c_queue[I2C_QUEUE_STATES];	/**< port states not yet written */
+	int i2c_queued;		/**< number of states in i2c_queue */
 #endif
 
 #ifdef WITH_ETHLCD
 	int sock;		/**< socket for TCP devices */
+	int ethlcd_pipeline;	/**< requests on the way to the device; 1 waits for each reply */
+	unsigned char ethlcd_queue[ETHLCD_MAX_PIPELINE * 2];	/**< requests not sent yet */
+	int ethlcd_queued;	/**< number of requests in ethlcd_queue */
+	unsigned char ethlcd_sent[ETHLCD_MAX_PIPELINE];	/**< commands of the requests
+							     not replied to yet, oldest first */
+	int ethlcd_in_flight;	/**< number of commands in ethlcd_sent */
 #endif
 #ifdef WITH_RASPBERRYPI
 	struct rpi_gpio_map *rpi_gpio;	/**< GPIO pin mapping for Raspberry Pi */
@@ -252,12 +291,19 @@ typedef struct hd44780_private_data {
 
 	unsigned char *framebuf;	/**< the framebuffer */
 	unsigned char *backingstore;	/**< buffer for incremental updates */
+	FlushRun *runs;		/**< runs of the frame HD44780_flush() sends */
+	int numRuns;		/**< number of runs */
+	int *dispRun;		/**< each display's current run when interleaving */
+	char interleave;	/**< overlap the waits of several displays */
 
 	CGram cc[NUM_CCs];	/**< the custom character cache */
+	CharCache charcache;	/**< which glyphs the custom characters show */
 	CGmode ccmode;		/**< character mode of the current screen */
 
 	/* Connection type data */
 	int connectiontype;
+	int position_cost;	/**< see ConnectionMapping */
+	char cc_whole;		/**< connection type takes only whole custom chars */
 	struct hwDependentFns *hd44780_functions;
 	void *connection_data;
 
@@ -293,6 +339,11 @@ typedef struct hd44780_private_data {
 				     For extended mode on some weird controllers
 				     set to HD44780_MODEL_EXTENDED */
 	int line_address;	/**< address of the next line in extended mode  */
+	int hwscroll;		/**< shift lines scrolled in hardware (extended mode) */
+	int line_shift[4];	/**< columns each line is shifted by, see HD44780_scroll_text() */
+	int cursor_x, cursor_y;	/**< cursor position wanted, see HD44780_cursor() */
+	int cursor_state;	/**< cursor state wanted (CURSOR_*) */
+	int cursor_shown;	/**< cursor bits of ONOFFCTRL last sent, -1: unknown */
 	int backlight_type;	/**< way of handling backlight. */
 	int backlight_cmd_on;	/**< internal command(s) for enabling backlight */
 	int backlight_cmd_off;	/**< internal command(s) for disabling backlight */
@@ -306,6 +357,12 @@ typedef struct hd44780_private_data {
 
 	int delayMult;		/**< Delay multiplier for slow displays */
 	char delayBus;		/**< Delay if data is sent too fast over LPT port */
+	int delayMode;		/**< TIMING_SLEEP or TIMING_HYBRID */
+	long delayOvershoot;	/**< Overshoot of nanosleep for TIMING_HYBRID, in ns */
+	char busyFlag;		/**< Poll the busy flag instead of waiting fixed times */
+	int busyTimeouts;	/**< Polls in a row that did not see the display ready */
+	char warm;		/**< The display shows the backing store saved when the
+				 *   server last exited: do not clear it */
 
 	/**
 	 * lastline controls the use of the last line, if pixel addressable
@@ -335,6 +392,12 @@ typedef struct hd44780_private_data {
 	int pressed_key_repetitions;	/**< Number of repeated key presses */
 	struct timeval pressed_key_time;/**< Time the key was pressed first */
 	int stuckinputs;		/**< Value on the parallel port input if no keys are pressed */
+#ifdef HAVE_GPIOD
+	struct gpiod_chip *keyChip;	/**< GPIO chip of the keypad interrupt */
+	struct gpiod_line *keyLine;	/**< Keypad interrupt; NULL to scan always */
+	int keyState;			/**< KEY_IDLE, KEY_DEBOUNCE or KEY_HELD */
+	struct timeval keyEdgeTime;	/**< Time of the last activity seen */
+#endif
 	/**@}*/
 
 	int backlight_bit;		/**< shorthand for the value of the BL bit if it is set */
@@ -363,6 +426,9 @@ typedef struct hd44780_private_data {
 
 	/** Output buffer to collect command or data bytes */
 	tx_buffer tx_buf;
+
+	/** Set by connection types that notice the device is gone */
+	int device_lost;
 } PrivateData;
 
 
@@ -388,6 +454,27 @@ typedef struct hwDependentFns {
 	 */
 	void (*senddata) (PrivateData *p, unsigned char dispID, unsigned char flags, unsigned char ch);
 
+	/** Send several bytes of data to the LCD at once (optional). Sub-drivers
+	 * that can send them in one transaction provide this; it has to keep
+	 * the display's execution time after each byte itself. Without it
+	 * each byte is sent by senddata followed by uPause.
+	 * \param p       pointer to private date structure
+	 * \param dispID  display to send data to (0 = all displays)
+	 * \param flags   data or instruction command (RS_DATA | RS_INSTR)
+	 * \param buf     characters to display or instruction values
+	 * \param len     number of bytes in buf
+	 */
+	void (*senddata_bulk) (PrivateData *p, unsigned char dispID, unsigned char flags,
+			       const unsigned char *buf, int len);
+
+	/** Read the busy flag of the LCD (optional). Sub-drivers that can read
+	 * from the display provide this for the BusyFlag option.
+	 * \param p       pointer to private date structure
+	 * \param dispID  display to read from (not 0)
+	 * \return  1 if the display is busy, 0 if it is ready, -1 on error
+	 */
+	int (*readbusy) (PrivateData *p, unsigned char dispID);
+
 	/**
 	 * Flush data to the display. To be used by sub-drivers that queue from
 	 * senddata internally.
@@ -440,6 +527,48 @@ typedef struct hwDependentFns {
 } HD44780_functions;
 
 
+/**
+ * Wait some micro seconds the way the core's uPause does. Connection types
+ * that keep the core's uPause call this directly in their send loops
+ * rather than through hd44780_functions->uPause, so the compiler inlines
+ * the delay.
+ * \param p      pointer to private date structure
+ * \param usecs  micro seconds to wait
+ */
+static inline void
+hd44780_uPause(PrivateData *p, int usecs)
+{
+	if (p->delayMode == TIMING_HYBRID)
+		timing_hybrid_uPause(usecs * p->delayMult, p->delayOvershoot);
+	else
+		timing_uPause(usecs * p->delayMult);
+}
+
+/**
+ * Define a senddata_bulk function for a connection type from its senddata
+ * function. The loop calls senddata directly and waits the execution time
+ * with hd44780_uPause(), so both can be inlined into it, instead of two
+ * calls through function pointers per byte in the core's loop. Only for
+ * connection types that keep the core's uPause and do not read the busy
+ * flag, and only for a single controller: displays with several of them
+ * are sent interleaved by the core.
+ * \param name      name of the function to define
+ * \param senddata  senddata function of the connection type
+ */
+#define HD44780_SENDDATA_BULK(name, senddata)					\
+static void									\
+name(PrivateData *p, unsigned char dispID, unsigned char flags,		\
+     const unsigned char *buf, int len)						\
+{										\
+	int i;									\
+										\
+	for (i = 0; i < len; i++) {						\
+		senddata(p, dispID, flags, buf[i]);				\
+		hd44780_uPause(p, 40);	/* Minimum exec time for all commands */	\
+	}									\
+}
+
+
 /* Prototypes */
 void common_init(PrivateData *p, unsigned char if_bit);
 
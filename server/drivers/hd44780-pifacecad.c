@@ -60,6 +60,8 @@
 
 void pifacecad_HD44780_senddata(PrivateData *p,
 				unsigned char displayID, unsigned char flags, unsigned char ch);
+void pifacecad_HD44780_senddata_bulk(PrivateData *p, unsigned char displayID,
+				     unsigned char flags, const unsigned char *buf, int len);
 void pifacecad_HD44780_backlight(PrivateData *p, unsigned char state);
 void pifacecad_HD44780_close(PrivateData *p);
 unsigned char pifacecad_HD44780_scankeypad(PrivateData *p);
@@ -88,6 +90,8 @@ const unsigned char spi_delay = 0;
 #define IODIRB		0x01	/**< I/O direction B */
 #define IPOLA		0x02	/**< Input polarity A */
 #define IPOLB		0x03	/**< Input polarity B */
+#define GPINTENA	0x04	/**< Interrupt on change A */
+#define INTCONA		0x08	/**< Interrupt control A */
 #define IOCON		0x0A	/**< I/O config (also 0x0B) */
 #define GPPUA		0x0C	/**< Port A pull-ups when input */
 #define GPPUB		0x0D	/**< Port B pull-ups when input */
@@ -103,6 +107,11 @@ const unsigned char spi_delay = 0;
 #define DELAY_PULSE_US 1	/**< 1us hold time for EN */
 #define DELAY_SETTLE_US 40	/**< 40us delay for executing LCD command */
 
+/** Characters pifacecad_HD44780_senddata_bulk() sends per SPI message */
+#define PIFACECAD_BULK_CHARS	32
+/** Port writes per character: data, EN set and EN cleared for each nibble */
+#define WRITES_PER_CHAR		6
+
 /** \name LCD control pins
  * LCD control pins are connected to upper nibble of Port B on the MCP23S17
  *@{*/
@@ -177,6 +186,34 @@ mcp23s17_read_reg(PrivateData *p, unsigned char reg)
 	return rx_buf[2];
 }
 
+/**
+ * Prepares one transfer of an SPI message that writes to the LCD port of the
+ * MCP23S17. Chip select is released after it, which ends the write command,
+ * unless it is the last transfer of the message.
+ *
+ * \param xfer   Transfer to fill.
+ * \param tx     Buffer of three bytes for it.
+ * \param data   Value for the port.
+ * \param delay  Microseconds to wait after it.
+ */
+static void
+mcp23s17_port_xfer(struct spi_ioc_transfer *xfer, unsigned char *tx,
+		   unsigned char data, int delay)
+{
+	tx[0] = 0x40 | SPI_HW_ADDR | WRITE_CMD;
+	tx[1] = LCD_PORT;
+	tx[2] = data;
+
+	memset(xfer, 0, sizeof(*xfer));
+	xfer->tx_buf = (unsigned long) tx;
+	xfer->len = 3;
+	xfer->delay_usecs = delay;
+	xfer->speed_hz = spi_speed;
+	xfer->bits_per_word = spi_bpw;
+	xfer->cs_change = 1;
+}
+
+
 /**
  * Writes control and data to HD44780 through Port B on MCP23S17.
  *
@@ -248,8 +285,11 @@ hd_init_pifacecad(Driver *drvthis)
 	mcp23s17_write_reg(p, IODIRA, 0xff);	/* Set GPIOA (switches) to input */
 	mcp23s17_write_reg(p, GPPUA, 0xff);	/* enable pull-ups on input */
 	mcp23s17_write_reg(p, IPOLA, 0xff);	/* invert inputs */
+	mcp23s17_write_reg(p, INTCONA, 0x00);	/* interrupt when a switch changes... */
+	mcp23s17_write_reg(p, GPINTENA, 0xff);	/* ...on INTA, see KeypadIRQ */
 
 	hd44780_functions->senddata = pifacecad_HD44780_senddata;
+	hd44780_functions->senddata_bulk = pifacecad_HD44780_senddata_bulk;
 	hd44780_functions->backlight = pifacecad_HD44780_backlight;
 	hd44780_functions->close = pifacecad_HD44780_close;
 	hd44780_functions->scankeypad = pifacecad_HD44780_scankeypad;
@@ -302,19 +342,65 @@ void
 pifacecad_HD44780_senddata(PrivateData *p,
 			   unsigned char displayID, unsigned char flags, unsigned char ch)
 {
-	unsigned char portControl = 0;
-	unsigned char h = (ch >> 4) & 0x0f;	/* high nibble */
-	unsigned char l = ch & 0x0f;	/* low nibble */
+	pifacecad_HD44780_senddata_bulk(p, displayID, flags, &ch, 1);
+}
 
-	if (flags == RS_INSTR)
-		portControl = 0;
-	else
-		portControl = RS;
+
+/**
+ * Send several bytes of data or commands to the display. All port writes
+ * for up to PIFACECAD_BULK_CHARS bytes go in one SPI message, with the
+ * pulse and execution times of the display as delays between them, instead
+ * of an ioctl() and a pause of the server for each of them.
+ *
+ * \param p          Pointer to driver's private data structure.
+ * \param displayID  ID of the display (or 0 for all) to send data to.
+ * \param flags      Defines whether to end a command or data.
+ * \param buf        The values to send.
+ * \param len        Number of values.
+ */
+void
+pifacecad_HD44780_senddata_bulk(PrivateData *p, unsigned char displayID,
+				unsigned char flags, const unsigned char *buf, int len)
+{
+	struct spi_ioc_transfer xfer[PIFACECAD_BULK_CHARS * WRITES_PER_CHAR];
+	unsigned char tx[PIFACECAD_BULK_CHARS * WRITES_PER_CHAR][3];
+	unsigned char portControl = (flags == RS_INSTR) ? 0 : RS;
+	int pulse = p->delayBus ? DELAY_PULSE_US * p->delayMult : 0;
+	int settle = DELAY_SETTLE_US * p->delayMult;
 
 	portControl |= p->backlight_bit;
 
-	write_and_pulse(p, portControl | h);
-	write_and_pulse(p, portControl | l);
+	while (len > 0) {
+		int n = (len > PIFACECAD_BULK_CHARS) ? PIFACECAD_BULK_CHARS : len;
+		int i, k = 0;
+
+		for (i = 0; i < n; i++) {
+			unsigned char nibble[2] = { (buf[i] >> 4) & 0x0f, buf[i] & 0x0f };
+			int j;
+
+			for (j = 0; j < 2; j++) {
+				unsigned char data = portControl | nibble[j];
+
+				mcp23s17_port_xfer(&xfer[k], tx[k], data, pulse);
+				k++;
+				mcp23s17_port_xfer(&xfer[k], tx[k], data | EN, pulse);
+				k++;
+				mcp23s17_port_xfer(&xfer[k], tx[k], data, settle);
+				k++;
+			}
+		}
+		/* on the last one it would keep the chip selected */
+		xfer[k - 1].cs_change = 0;
+
+		if (ioctl(p->fd, SPI_IOC_MESSAGE(k), xfer) < 0) {
+			p->hd44780_functions->drv_report(RPT_ERR,
+							 "HD44780: PiFaceCAD: senddata: There was "
+							 "a error during the SPI transaction: %s",
+							 strerror(errno));
+		}
+		buf += n;
+		len -= n;
+	}
 }
 
 
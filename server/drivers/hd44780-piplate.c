@@ -6,6 +6,10 @@
  *
  * The LCD is operated in its 4 bit-mode to be connected to the 8 bit-port
  * of a single MCP23017 that is accessed by the server via the I2C bus.
+ *
+ * Register writes are queued with i2c_queue() and go to the bus in combined
+ * transfers when the display has to wait, a register is read or a frame
+ * is complete, rather than one write() per nibble edge.
  */
 
 /*-
@@ -47,21 +51,13 @@
 
 #include "hd44780-piplate.h"
 #include "hd44780-low.h"
+#include "timing.h"
+#include "i2c.h"
 #include "shared/report.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <sys/ioctl.h>
-
-#ifdef HAVE_DEV_IICBUS_IIC_H
-# include <strings.h>
-# include <dev/iicbus/iic.h>
-#else				/* HAVE_LINUX_I2C_DEV_H */
-# include <linux/i2c-dev.h>
-#endif
 
 #define DEFAULT_DEVICE		"/dev/i2c-1"
 
@@ -69,6 +65,8 @@ void i2c_piplate_HD44780_senddata(PrivateData *p,
 				  unsigned char displayID, unsigned char flags, unsigned char ch);
 void i2c_piplate_HD44780_backlight(PrivateData *p, unsigned char state);
 unsigned char i2c_piplate_HD44780_scankeypad(PrivateData *p);
+void i2c_piplate_HD44780_uPause(PrivateData *p, int usecs);
+void i2c_piplate_HD44780_flush(PrivateData *p);
 void i2c_piplate_HD44780_close(PrivateData *p);
 
 /* MCP23017 registers */
@@ -108,7 +106,8 @@ void i2c_piplate_HD44780_close(PrivateData *p);
 #define I2C_ADDR_MASK 0x7f
 
 /**
- * Read one of the MCP23017 registers
+ * Read one of the MCP23017 registers. The register writes queued are
+ * written first.
  * \param p     Pointer to driver private data.
  * \param reg   Address of the register to read.
  * \param val   Pointer to the read buffer.
@@ -119,12 +118,12 @@ static int
 i2c_read_reg(PrivateData *p, unsigned char reg, unsigned char *val)
 {
 	/* Set the address to be read */
-	if (write(p->fd, &reg, 1) != 1) {
+	if (i2c_queue(p->i2c, &reg, 1) < 0) {
 		return -1;
 	}
 
 	/* Read the value */
-	if (read(p->fd, val, 1) != 1) {
+	if (i2c_read(p->i2c, val, 1) < 0) {
 		return -1;
 	}
 
@@ -132,7 +131,7 @@ i2c_read_reg(PrivateData *p, unsigned char reg, unsigned char *val)
 }
 
 /**
- * Write one of the MCP23017 registers
+ * Queue a write of one of the MCP23017 registers.
  * \param p     Pointer to driver private data.
  * \param reg   Address of the register to write.
  * \param val   Value to be written.
@@ -146,7 +145,7 @@ i2c_write_reg(PrivateData *p, unsigned char reg, unsigned char val)
 
 	buf[0] = reg;
 	buf[1] = val;
-	if (write(p->fd, buf, sizeof(buf)) != sizeof(buf)) {
+	if (i2c_queue(p->i2c, buf, sizeof(buf)) < 0) {
 		return -1;
 	}
 	return 0;
@@ -164,10 +163,6 @@ hd_init_i2c_piplate(Driver *drvthis)
 	PrivateData *p = (PrivateData *) drvthis->private_data;
 	HD44780_functions *hd44780_functions = p->hd44780_functions;
 	char device[256] = DEFAULT_DEVICE;
-#ifdef HAVE_DEV_IICBUS_IIC_H
-	struct iiccmd cmd;
-	bzero(&cmd, sizeof(cmd));
-#endif
 
 	/* Get serial device to use */
 	strncpy(device, drvthis->config_get_string(drvthis->name, "Device", 0, DEFAULT_DEVICE), sizeof(device));
@@ -176,35 +171,13 @@ hd_init_i2c_piplate(Driver *drvthis)
 	       device, p->port & I2C_ADDR_MASK);
 
 	/* Open the I2C device */
-	p->fd = open(device, O_RDWR);
-	if (p->fd < 0) {
-		report(RPT_ERR, "HD44780: piplate: open i2c device '%s' failed: %s",
-		       device, strerror(errno));
+	p->i2c = i2c_open(device, p->port & I2C_ADDR_MASK);
+	if (p->i2c == NULL) {
+		report(RPT_ERR, "HD44780: piplate: connecting to device '%s' slave 0x%02X failed: %s",
+		       device, p->port & I2C_ADDR_MASK, strerror(errno));
 		return -1;
 	}
 
-	/* Set I2C address */
-#ifdef HAVE_DEV_IICBUS_IIC_H
-	cmd.slave = (p->port & I2C_ADDR_MASK) << 1;
-	cmd.last = 0;
-	cmd.count = 0;
-	if (ioctl(p->fd, I2CRSTCARD, &cmd) < 0) {
-		report(RPT_ERR, "HD44780: piplate: reset bus failed: %s", strerror(errno));
-		return -1;
-	}
-	if (ioctl(p->fd, I2CSTART, &cmd) < 0) {
-		report(RPT_ERR, "HD44780: piplate: set address to 0x%02X: %s",
-		       p->port & I2C_ADDR_MASK, strerror(errno));
-		return -1;
-	}
-#else				/* HAVE_LINUX_I2C_DEV_H */
-	if (ioctl(p->fd, I2C_SLAVE, p->port & I2C_ADDR_MASK) < 0) {
-		report(RPT_ERR, "HD44780: piplate: set address to 0x%02X: %s",
-		       p->port & I2C_ADDR_MASK, strerror(errno));
-		return -1;
-	}
-#endif
-
 	/* IODIRA - keys as input, all other as output */
 	i2c_write_reg(p, MCP23017_IODIRA,
 		      (unsigned char) (L_KEY_BIT | U_KEY_BIT | D_KEY_BIT | R_KEY_BIT | S_KEY_BIT) & ~(G_BIT | R_BIT));
@@ -224,6 +197,8 @@ hd_init_i2c_piplate(Driver *drvthis)
 	hd44780_functions->senddata = i2c_piplate_HD44780_senddata;
 	hd44780_functions->backlight = i2c_piplate_HD44780_backlight;
 	hd44780_functions->scankeypad = i2c_piplate_HD44780_scankeypad;
+	hd44780_functions->uPause = i2c_piplate_HD44780_uPause;
+	hd44780_functions->flush = i2c_piplate_HD44780_flush;
 	hd44780_functions->close = i2c_piplate_HD44780_close;
 
 	/* Initialize the LCD */
@@ -245,11 +220,35 @@ hd_init_i2c_piplate(Driver *drvthis)
 void
 i2c_piplate_HD44780_close(PrivateData *p)
 {
-	if (p->fd >= 0) {
-		close(p->fd);
+	if (p->i2c != NULL) {
+		i2c_close(p->i2c);
+		p->i2c = NULL;
 	}
 }
 
+/**
+ * Write the queued register writes before waiting, so the display gets the
+ * time it needs after the last of them.
+ * \param p      Pointer to driver's private data structure.
+ * \param usecs  Micro seconds to wait.
+ */
+void
+i2c_piplate_HD44780_uPause(PrivateData *p, int usecs)
+{
+	i2c_commit(p->i2c);
+	timing_uPause(usecs * p->delayMult);
+}
+
+/**
+ * Write the queued register writes.
+ * \param p  Pointer to driver's private data structure.
+ */
+void
+i2c_piplate_HD44780_flush(PrivateData *p)
+{
+	i2c_commit(p->i2c);
+}
+
 /**
  * Send data or commands to the display.
  * \param p          Pointer to driver's private data structure.
@@ -286,14 +285,14 @@ i2c_piplate_HD44780_senddata(PrivateData *p,
 		/* Set enable bit */
 		i2c_write_reg(p, MCP23017_GPIOB, write_val | EN_BIT);
 
-		p->hd44780_functions->uPause(p, 1);
+		/* A register write on the bus takes longer than the enable pulse */
+		if (p->delayBus)
+			p->hd44780_functions->uPause(p, 1);
 
 		/* Clear enable bit */
 		i2c_write_reg(p, MCP23017_GPIOB, write_val & ~EN_BIT);
 
 	}			/* for each nibble */
-
-	p->hd44780_functions->uPause(p, 1);
 }
 
 /**
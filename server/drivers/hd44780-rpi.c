@@ -62,6 +62,9 @@ void lcdrpi_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned c
 void lcdrpi_HD44780_backlight(PrivateData *p, unsigned char state);
 void lcdrpi_HD44780_close(PrivateData *p);
 
+/* Bytes of a frame go straight to senddata, with the delay inlined */
+HD44780_SENDDATA_BULK(lcdrpi_HD44780_senddata_bulk, lcdrpi_HD44780_senddata)
+
 /**
  * Pointer to the memory mapped GPIO registers. Note the pointer type is
  * (unsigned int) not (char). This is important when calculating offset
@@ -303,24 +306,23 @@ static void
 send_nibble(PrivateData *p, unsigned char ch, unsigned char displayID)
 {
 	if (gpio_map != NULL) {
-		SET_GPIO(p->rpi_gpio->d7, ch & 0x08);
-		SET_GPIO(p->rpi_gpio->d6, ch & 0x04);
-		SET_GPIO(p->rpi_gpio->d5, ch & 0x02);
-		SET_GPIO(p->rpi_gpio->d4, ch & 0x01);
-		p->hd44780_functions->uPause(p, 50);
+		unsigned int bits = p->rpi_gpio->data_bits[ch & 0x0F];
+
+		SET_GPIO_MASK(bits, p->rpi_gpio->data_mask & ~bits);
+		hd44780_uPause(p, 50);
 
 		/* Data is clocked on the falling edge of EN */
 		if (displayID == 1 || displayID == 0)
 			SET_GPIO(p->rpi_gpio->en, 1);
 		if (displayID == 2 || (p->numDisplays > 1 && displayID == 0))
 			SET_GPIO(p->rpi_gpio->en2, 1);
-		p->hd44780_functions->uPause(p, 50);
+		hd44780_uPause(p, 50);
 
 		if (displayID == 1 || displayID == 0)
 			SET_GPIO(p->rpi_gpio->en, 0);
 		if (displayID == 2 || (p->numDisplays > 1 && displayID == 0))
 			SET_GPIO(p->rpi_gpio->en2, 0);
-		p->hd44780_functions->uPause(p, 50);
+		hd44780_uPause(p, 50);
 	}
 }
 
@@ -364,6 +366,7 @@ hd_init_rpi(Driver *drvthis)
 	PrivateData *p = (PrivateData *) drvthis->private_data;
 	const int *allowed_gpio_pins = NULL;
 	int used_pins[GPIO_PINS] = {};
+	int i;
 
 	if ((allowed_gpio_pins = check_board_rev(drvthis)) == NULL)
 		return -1;
@@ -425,6 +428,16 @@ hd_init_rpi(Driver *drvthis)
 		return -1;
 	}
 
+	/* The GPIO bits of each nibble, to set all data lines at once */
+	for (i = 0; i < 16; i++) {
+		p->rpi_gpio->data_bits[i] =
+			((i & 0x08) ? 1U << (p->rpi_gpio->d7 % 32) : 0) |
+			((i & 0x04) ? 1U << (p->rpi_gpio->d6 % 32) : 0) |
+			((i & 0x02) ? 1U << (p->rpi_gpio->d5 % 32) : 0) |
+			((i & 0x01) ? 1U << (p->rpi_gpio->d4 % 32) : 0);
+	}
+	p->rpi_gpio->data_mask = p->rpi_gpio->data_bits[0x0F];
+
 	setup_gpio(drvthis, p->rpi_gpio->en);
 	setup_gpio(drvthis, p->rpi_gpio->rs);
 	setup_gpio(drvthis, p->rpi_gpio->d7);
@@ -433,6 +446,8 @@ hd_init_rpi(Driver *drvthis)
 	setup_gpio(drvthis, p->rpi_gpio->d4);
 
 	p->hd44780_functions->senddata = lcdrpi_HD44780_senddata;
+	if (p->numDisplays == 1)
+		p->hd44780_functions->senddata_bulk = lcdrpi_HD44780_senddata_bulk;
 	p->hd44780_functions->close = lcdrpi_HD44780_close;
 
 	if (have_backlight_pin(p)) {
@@ -448,9 +463,9 @@ hd_init_rpi(Driver *drvthis)
 	 * followed by (FUNCSET | IF_4BIT) using four nibbles. */
 	SET_GPIO(p->rpi_gpio->rs, 0);
 	send_nibble(p, (FUNCSET | IF_8BIT) >> 4, 0);
-	p->hd44780_functions->uPause(p, 4100);
+	hd44780_uPause(p, 4100);
 	send_nibble(p, (FUNCSET | IF_8BIT) >> 4, 0);
-	p->hd44780_functions->uPause(p, 150);
+	hd44780_uPause(p, 150);
 	send_nibble(p, (FUNCSET | IF_8BIT) >> 4, 0);
 	send_nibble(p, (FUNCSET | IF_4BIT) >> 4, 0);
 
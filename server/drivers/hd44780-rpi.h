@@ -17,6 +17,8 @@ struct rpi_gpio_map {
 	int d6;
 	int d5;
 	int d4;
+	unsigned int data_bits[16];	/**< GPIO bits of D4 to D7 for each nibble */
+	unsigned int data_mask;		/**< GPIO bits of all of D4 to D7 */
 };
 
 /** Peripheral base address of the BCM2835 */
@@ -35,5 +37,7 @@ struct rpi_gpio_map {
 #define INP_GPIO(g) *(gpio_map+((g)/10)) &= ~(7<<(((g)%10)*3))
 /** Sets or clears a GPIO pin */
 #define SET_GPIO(g,a) *(gpio_map+((a)?7:10))=1<<((g)%32);
+/** Sets the GPIO pins of bitmask s and clears those of bitmask c */
+#define SET_GPIO_MASK(s,c) do { *(gpio_map+7)=(s); *(gpio_map+10)=(c); } while (0)
 
 #endif				// HD_LCDRPI_H
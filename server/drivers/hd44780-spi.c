@@ -34,6 +34,7 @@
 #include <linux/spi/spidev.h>
 
 void spi_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned char flags, unsigned char ch);
+void spi_HD44780_senddata_bulk(PrivateData *p, unsigned char displayID, unsigned char flags, const unsigned char *buf, int len);
 void spi_HD44780_backlight(PrivateData *p, unsigned char state);
 
 #define DEFAULT_DEVICE		"/dev/spidev0.0"
@@ -45,6 +46,9 @@ void spi_HD44780_backlight(PrivateData *p, unsigned char state);
 /** KS0073 Register Select bit: 0 = instruction register follows, 1 = data register follows */
 #define RS	0x02u
 
+/** Characters spi_HD44780_senddata_bulk() sends per SPI message */
+#define SPI_BULK_CHARS	64
+
 
 /**
  * Reverses the bits of \a u8.
@@ -63,6 +67,32 @@ bit_reverse8(uint8_t u8)
 }
 
 
+/**
+ * Build the three bytes that send a value to the KS0073.
+ * \param flags  Defines whether to end a command or data.
+ * \param ch     The value to send.
+ * \param buf    Buffer of three bytes to fill.
+ */
+static void
+spi_frame(unsigned char flags, unsigned char ch, unsigned char *buf)
+{
+	unsigned char reverse;
+
+	if (flags == RS_INSTR)
+		buf[0] = SYNC;
+	else
+		buf[0] = SYNC | RS;
+
+	/* KS0073 wants Least Significant Bit first, with the added twist of
+	 * peculiar splitting of a byte across 4 nibbles. If we ever need to
+	 * read from the device, remember to bit_reverse8() each byte (note
+	 * that replies aren't split into nibbles). */
+	reverse = bit_reverse8(ch);
+	buf[1] = reverse & 0xF0;
+	buf[2] = (reverse & 0x0F) << 4;
+}
+
+
 /**
  * Do a SPI transfer by sending \c length bytes of \c outbuf and read the same
  * number of bytes into \c inbuf.
@@ -155,6 +185,7 @@ hd_init_spi(Driver *drvthis)
 	}
 
 	hd44780_functions->senddata = spi_HD44780_senddata;
+	hd44780_functions->senddata_bulk = spi_HD44780_senddata_bulk;
 	common_init(p, IF_8BIT);
 
 	return 0;
@@ -172,25 +203,55 @@ void
 spi_HD44780_senddata(PrivateData *p, unsigned char displayID, unsigned char flags, unsigned char ch)
 {
 	unsigned char buf[3];
-	unsigned char reverse;
 
 	p->hd44780_functions->drv_report(RPT_DEBUG, "HD44780: SPI: sending %s %02x",
 					 RS_INSTR == flags ? "CMD" : "DATA", ch);
 
-	if (flags == RS_INSTR)
-		buf[0] = SYNC;
-	else
-		buf[0] = SYNC | RS;
+	spi_frame(flags, ch, buf);
+	spi_transfer(p, buf, NULL, sizeof(buf));
+}
 
-	/* KS0073 wants Least Significant Bit first, with the added twist of
-	 * peculiar splitting of a byte across 4 nibbles. If we ever need to
-	 * read from the device, remember to bit_reverse8() each byte (note
-	 * that replies aren't split into nibbles). */
-	reverse = bit_reverse8(ch);
-	buf[1] = reverse & 0xF0;
-	buf[2] = (reverse & 0x0F) << 4;
 
-	spi_transfer(p, buf, NULL, sizeof(buf));
+/**
+ * Send several bytes of data or commands to the display in one SPI
+ * message. Each byte is a transfer of its own that ends with chip select
+ * released for the execution time of the display.
+ * \param p          Pointer to driver's private data structure.
+ * \param displayID  ID of the display (or 0 for all) to send data to.
+ * \param flags      Defines whether to end a command or data.
+ * \param buf        The values to send.
+ * \param len        Number of values.
+ */
+void
+spi_HD44780_senddata_bulk(PrivateData *p, unsigned char displayID, unsigned char flags, const unsigned char *buf, int len)
+{
+	struct spi_ioc_transfer xfer[SPI_BULK_CHARS];
+	unsigned char frames[SPI_BULK_CHARS][3];
+	static unsigned char no_more_errormsgs = 0;
+
+	while (len > 0) {
+		int n = (len > SPI_BULK_CHARS) ? SPI_BULK_CHARS : len;
+		int i;
+
+		memset(xfer, 0, n * sizeof(xfer[0]));
+		for (i = 0; i < n; i++) {
+			spi_frame(flags, buf[i], frames[i]);
+			xfer[i].tx_buf = (unsigned long) frames[i];
+			xfer[i].len = sizeof(frames[i]);
+			xfer[i].delay_usecs = 40 * p->delayMult;	/* Minimum exec time for all commands */
+			/* on the last one it would keep the chip selected */
+			xfer[i].cs_change = (i < n - 1);
+		}
+
+		if (ioctl(p->fd, SPI_IOC_MESSAGE(n), xfer) < 0) {
+			p->hd44780_functions->drv_report(no_more_errormsgs ? RPT_DEBUG : RPT_ERR,
+							 "HD44780: SPI: spidev write of %d bytes failed: %s",
+							 n, strerror(errno));
+			no_more_errormsgs = 1;
+		}
+		buf += n;
+		len -= n;
+	}
 }
 
 
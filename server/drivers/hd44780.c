@@ -57,6 +57,19 @@
 #define KEYPAD_AUTOREPEAT_DELAY 500
 #define KEYPAD_AUTOREPEAT_FREQ 15
 
+#ifdef HAVE_GPIOD
+/* Time the keys get to settle after an interrupt before they are read (ms) */
+# define KEYPAD_DEBOUNCE 20
+
+/* States of a keypad with interrupt line */
+# define KEY_IDLE	0	/* no key pressed: read only after an interrupt */
+# define KEY_DEBOUNCE	1	/* interrupt seen: read once the keys settled */
+# define KEY_HELD	2	/* key pressed: read on every call for autorepeat */
+#endif
+
+/* Busy flag polls in a row that may time out before the fixed delays are used */
+#define BUSY_MAX_TIMEOUTS 3
+
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -107,8 +120,23 @@ MODULE_EXPORT char *symbol_prefix = "HD44780_";
 
 /* Internal functions */
 void HD44780_position(Driver *drvthis, int x, int y);
+static int HD44780_ddaddr(PrivateData *p, int x, int y);
+static void HD44780_send_interleaved(PrivateData *p);
 static void uPause(PrivateData *p, int usecs);
+static void HD44780_senddata_bulk(PrivateData *p, unsigned char dispID, unsigned char flags, const unsigned char *buf, int len);
+static void HD44780_wait(PrivateData *p, unsigned char dispID, int usecs);
+static void HD44780_busy_calibrate(Driver *drvthis);
+static void HD44780_load_state(Driver *drvthis);
+static void HD44780_save_state(Driver *drvthis);
+static void HD44780_flush_cursor(Driver *drvthis);
+static void HD44780_glyph(PrivateData *p, const unsigned char *dat, unsigned char *glyph);
+static void HD44780_define_char(PrivateData *p, int n, const unsigned char *glyph);
+static int HD44780_custom_char(Driver *drvthis, unsigned char *dat);
 unsigned char HD44780_scankeypad(PrivateData *p);
+#ifdef HAVE_GPIOD
+static int HD44780_keypad_irq_init(Driver *drvthis);
+static int HD44780_keypad_activity(PrivateData *p, struct timeval *now);
+#endif
 static int parse_span_list(int *spanListArray[], int *spLsize, int *dispOffsets[], int *dOffsize, int *dispSizeArray[], const char *spanlist);
 
 
@@ -337,6 +365,9 @@ HD44780_init(Driver *drvthis)
 				 * property !!! */
 	p->cellwidth = 5;
 	p->ccmode = standard;
+	lib_cc_init(&p->charcache, NUM_CCs, p->cellheight);
+	for (i = 0; i < NUM_CCs; i++)
+		p->cc[i].dirty = (1 << p->cellheight) - 1;	/* CGRAM is unknown */
 	p->backlightstate = -1;	/* Init to invalid value */
 	p->fd = -1;
 
@@ -385,7 +416,23 @@ HD44780_init(Driver *drvthis)
 	p->have_output		= drvthis->config_get_bool(drvthis->name, "outputport", 0, 0);
 	p->delayMult 		= drvthis->config_get_int(drvthis->name, "delaymult", 0, 1);
 	p->delayBus 		= drvthis->config_get_bool(drvthis->name, "delaybus", 0, 1);
+	s = drvthis->config_get_string(drvthis->name, "delaymode", 0, "sleep");
+	if (strcasecmp(s, "hybrid") == 0)
+		p->delayMode = TIMING_HYBRID;
+	else if (strcasecmp(s, "sleep") == 0)
+		p->delayMode = TIMING_SLEEP;
+	else {
+		report(RPT_WARNING, "%s: unknown DelayMode '%s'; using sleep",
+			drvthis->name, s);
+		p->delayMode = TIMING_SLEEP;
+	}
+	p->busyFlag 		= drvthis->config_get_bool(drvthis->name, "busyflag", 0, 0);
 	p->lastline 		= drvthis->config_get_bool(drvthis->name, "lastline", 0, 1);
+	p->hwscroll		= drvthis->config_get_bool(drvthis->name, "hardwarescroll", 0, 0);
+	if (p->hwscroll && !ext_mode) {
+		report(RPT_WARNING, "%s: HardwareScroll needs extended mode; ignored", drvthis->name);
+		p->hwscroll = 0;
+	}
 
 	p->nextrefresh		= 0;
 	p->refreshdisplay 	= drvthis->config_get_int(drvthis->name, "refreshdisplay", 0, 0);
@@ -406,6 +453,7 @@ HD44780_init(Driver *drvthis)
 	} else {
 		/* set connection type */
 		p->connectiontype = connectionMapping[i].connectiontype;
+		p->position_cost = connectionMapping[i].position_cost;
 
 		report(RPT_INFO, "HD44780: using ConnectionType: %s", connectionMapping[i].name);
 
@@ -489,11 +537,30 @@ HD44780_init(Driver *drvthis)
 			report(RPT_ERR, "%s: error mallocing", drvthis->name);
 	}
 
+	/* lines are shifted one at a time on a single controller */
+	if (p->hwscroll && ((p->numDisplays > 1) || (p->height > 4)
+			    || (p->width >= p->line_address))) {
+		report(RPT_WARNING, "%s: HardwareScroll needs one controller and lines shorter than LineAddress; ignored",
+		       drvthis->name);
+		p->hwscroll = 0;
+	}
+	if (!p->hwscroll)
+		drvthis->caps &= ~DRV_CAP_SCROLL_TEXT;
+	/* the cursor of the controller showing the line is not tracked */
+	if (p->numDisplays > 1)
+		drvthis->caps &= ~DRV_CAP_CURSOR;
+	p->cursor_shown = -1;
+
 	/* Set up timing */
 	if (timing_init() == -1) {
 		report(RPT_ERR, "%s: timing_init() failed (%s)", drvthis->name, strerror(errno));
 		return -1;
 	}
+	if (p->delayMode == TIMING_HYBRID) {
+		p->delayOvershoot = timing_calibrate();
+		report(RPT_INFO, "%s: spinning through the last %ld ns of delays",
+			drvthis->name, p->delayOvershoot);
+	}
 
 	/* Allocate framebuffer */
 	p->framebuf = (unsigned char *) calloc(p->width * p->height, sizeof(char));
@@ -510,6 +577,15 @@ HD44780_init(Driver *drvthis)
 		return -1;
 	}
 
+	/* Runs of a frame: each but the last of a line is followed by an
+	 * unchanged part of at least two characters, plus the 16x1 split */
+	p->runs = (FlushRun *) malloc(p->height * (p->width / 2 + 2) * sizeof(FlushRun));
+	p->dispRun = (int *) malloc(p->numDisplays * sizeof(int));
+	if ((p->runs == NULL) || (p->dispRun == NULL)) {
+		report(RPT_ERR, "%s: unable to allocate flush runs", drvthis->name);
+		return -1;
+	}
+
 	/* Keypad ? */
 	if (p->have_keypad) {
 		int x, y;
@@ -577,6 +653,9 @@ HD44780_init(Driver *drvthis)
 	/* Output latch state - init to a non-valid value */
 	p->output_state = 999999;
 
+	/* The display may still show what the server showed when it exited */
+	HD44780_load_state(drvthis);
+
 	/* allocate local function pointers */
 	if ((p->hd44780_functions = (HD44780_functions *) calloc(1, sizeof(HD44780_functions))) == NULL) {
 		report(RPT_ERR, "%s: error mallocing", drvthis->name);
@@ -588,8 +667,10 @@ HD44780_init(Driver *drvthis)
 	 */
 	p->hd44780_functions->uPause = uPause;
 	p->hd44780_functions->drv_report = report;
-	p->hd44780_functions->drv_debug = debug;
+	p->hd44780_functions->drv_debug = DEBUG_FUNCTION;
 	p->hd44780_functions->senddata = NULL;
+	p->hd44780_functions->senddata_bulk = NULL;
+	p->hd44780_functions->readbusy = NULL;
 	p->hd44780_functions->backlight = NULL;
 	p->hd44780_functions->set_contrast = NULL;
 	p->hd44780_functions->readkeypad = NULL;
@@ -620,6 +701,11 @@ HD44780_init(Driver *drvthis)
 	if (p->hd44780_functions->scankeypad == NULL)
 		p->have_keypad = 0;
 
+#ifdef HAVE_GPIOD
+	if (p->have_keypad && (HD44780_keypad_irq_init(drvthis) < 0))
+		return -1;
+#endif
+
 	/* consistency check: no local backlight function => no external backlight
 	 * still backlight might be set using internal commands of display independant
 	 * of connection type*/
@@ -630,6 +716,20 @@ HD44780_init(Driver *drvthis)
 	if (p->hd44780_functions->output == NULL)
 		p->have_output = 0;
 
+	/*
+	 * Displays with several controllers: when the connection type waits
+	 * the execution time after every byte, give one byte to each
+	 * controller in turn and wait once for all of them.
+	 */
+	p->interleave = (p->numDisplays > 1)
+			&& (p->hd44780_functions->senddata_bulk == NULL)
+			&& (p->hd44780_functions->flush == NULL);
+
+	/* check that reading the busy flag works before relying on it; that
+	 * clears the display, so a warm start relies on the last check */
+	if (p->busyFlag && !p->warm)
+		HD44780_busy_calibrate(drvthis);
+
 	/* set contrast */
 	HD44780_set_contrast(drvthis, p->contrast);
 
@@ -692,13 +792,16 @@ common_init(PrivateData *p, unsigned char if_bit)
 	p->hd44780_functions->senddata(p, 0, RS_INSTR, cmd_funcset);
 	p->hd44780_functions->uPause(p, 40);
 
-	/* Turn off display, as manipulatimg below can cause some garbage on screen */
-	p->hd44780_functions->senddata(p, 0, RS_INSTR, ONOFFCTRL | DISPOFF | CURSOROFF | CURSORNOBLINK);
-	p->hd44780_functions->uPause(p, 40);
+	/* On a warm start the display keeps showing what it showed */
+	if (!p->warm) {
+		/* Turn off display, as manipulatimg below can cause some garbage on screen */
+		p->hd44780_functions->senddata(p, 0, RS_INSTR, ONOFFCTRL | DISPOFF | CURSOROFF | CURSORNOBLINK);
+		p->hd44780_functions->uPause(p, 40);
 
-	p->hd44780_functions->senddata(p, 0, RS_INSTR, CLEAR);
-	/* winstar OLEDs require 6.2ms for this command, according to spec */
-	p->hd44780_functions->uPause(p, (p->model == HD44780_MODEL_WINSTAR_OLED) ? 6200 : 1600);
+		p->hd44780_functions->senddata(p, 0, RS_INSTR, CLEAR);
+		/* winstar OLEDs require 6.2ms for this command, according to spec */
+		p->hd44780_functions->uPause(p, (p->model == HD44780_MODEL_WINSTAR_OLED) ? 6200 : 1600);
+	}
 
 	if (p->model == HD44780_MODEL_WINSTAR_OLED) {
 		/* For WINSTAR OLED displays need to set TEXT mode and additionally level of brigtness.
@@ -715,6 +818,8 @@ common_init(PrivateData *p, unsigned char if_bit)
 	p->hd44780_functions->uPause(p, 40);
 	p->hd44780_functions->senddata(p, 0, RS_INSTR, HOMECURSOR);
 	p->hd44780_functions->uPause(p, 1600);
+	/* going home undoes any display shift */
+	memset(p->line_shift, 0, sizeof(p->line_shift));
 
 	/* Turn on display again */
 	p->hd44780_functions->senddata(p, 0, RS_INSTR, ONOFFCTRL | DISPON | CURSOROFF | CURSORNOBLINK);
@@ -733,7 +838,213 @@ common_init(PrivateData *p, unsigned char if_bit)
 static void
 uPause(PrivateData *p, int usecs)
 {
-	timing_uPause(usecs * p->delayMult);
+	hd44780_uPause(p, usecs);
+}
+
+
+/**
+ * Send several bytes of data to the display, in one go if the connection
+ * type can do that, one by one otherwise.
+ * \param p       Pointer to PrivateData structure.
+ * \param dispID  Display to send data to (0 = all displays).
+ * \param flags   Data or instruction command (RS_DATA | RS_INSTR).
+ * \param buf     Bytes to send.
+ * \param len     Number of bytes.
+ */
+static void
+HD44780_senddata_bulk(PrivateData *p, unsigned char dispID, unsigned char flags, const unsigned char *buf, int len)
+{
+	int i;
+
+	if (p->hd44780_functions->senddata_bulk != NULL) {
+		p->hd44780_functions->senddata_bulk(p, dispID, flags, buf, len);
+		return;
+	}
+	for (i = 0; i < len; i++) {
+		p->hd44780_functions->senddata(p, dispID, flags, buf[i]);
+		HD44780_wait(p, dispID, 40);  /* Minimum exec time for all commands */
+	}
+}
+
+
+/**
+ * Poll the busy flag until the display is ready.
+ * \param p        Pointer to PrivateData structure.
+ * \param dispID   Display to wait for (0 = all displays).
+ * \param timeout  Longest time to poll in micro seconds.
+ * \return  Micro seconds it took; -1 if the display did not get ready or
+ *          the flag could not be read.
+ */
+static long
+HD44780_poll_busy(PrivateData *p, unsigned char dispID, long timeout)
+{
+	struct timeval start, now;
+	long elapsed = 0;
+	int first = (dispID == 0) ? 1 : dispID;
+	int last = (dispID == 0) ? p->numDisplays : dispID;
+	int d;
+
+	gettimeofday(&start, NULL);
+	for (d = first; d <= last; d++) {
+		for (;;) {
+			int busy = p->hd44780_functions->readbusy(p, d);
+
+			gettimeofday(&now, NULL);
+			elapsed = (now.tv_sec - start.tv_sec) * 1000000L + (now.tv_usec - start.tv_usec);
+			if (busy == 0)
+				break;
+			if ((busy < 0) || (elapsed > timeout))
+				return -1;
+		}
+	}
+	return elapsed;
+}
+
+
+/**
+ * Wait until the display has executed the last command or data byte: poll
+ * its busy flag if BusyFlag is set, wait the given time otherwise. Polling
+ * is given up for the fixed times when the display does not get ready
+ * several times in a row.
+ * \param p       Pointer to PrivateData structure.
+ * \param dispID  Display to wait for (0 = all displays).
+ * \param usecs   Execution time of the command in micro seconds.
+ */
+static void
+HD44780_wait(PrivateData *p, unsigned char dispID, int usecs)
+{
+	if (p->busyFlag) {
+		/* a ready display answers well within ten times its exec time */
+		if (HD44780_poll_busy(p, dispID, 10L * usecs * p->delayMult) >= 0) {
+			p->busyTimeouts = 0;
+			return;
+		}
+		if (++p->busyTimeouts >= BUSY_MAX_TIMEOUTS) {
+			report(RPT_WARNING, "HD44780: busy flag stuck; using fixed delays");
+			p->busyFlag = 0;
+		}
+	}
+	p->hd44780_functions->uPause(p, usecs);
+}
+
+
+/**
+ * Check whether the busy flag of the display can be read: after a clear
+ * command it has to be set and then cleared within the time the command
+ * takes. If not, e.g. because R/W is wired to ground, the fixed delays are
+ * used.
+ * \param drvthis  Pointer to driver structure.
+ */
+static void
+HD44780_busy_calibrate(Driver *drvthis)
+{
+	PrivateData *p = (PrivateData *) drvthis->private_data;
+	int busy;
+	long elapsed;
+
+	p->busyFlag = 0;
+	p->busyTimeouts = 0;
+	if (p->hd44780_functions->readbusy == NULL) {
+		report(RPT_WARNING, "%s: connection type cannot read the busy flag; using fixed delays",
+		       drvthis->name);
+		return;
+	}
+
+	p->hd44780_functions->senddata(p, 0, RS_INSTR, CLEAR);
+	busy = p->hd44780_functions->readbusy(p, 1);
+	elapsed = HD44780_poll_busy(p, 0, 10000L * p->delayMult);
+	if ((busy != 1) || (elapsed < 0)) {
+		report(RPT_WARNING, "%s: cannot read the busy flag (check R/W wiring); using fixed delays",
+		       drvthis->name);
+		p->hd44780_functions->uPause(p, 1600);
+		return;
+	}
+
+	report(RPT_INFO, "%s: polling the busy flag; clearing the display took %ld us",
+	       drvthis->name, elapsed);
+	p->busyFlag = 1;
+}
+
+
+/** What the driver keeps over a restart of the server, followed by the
+ * backing store */
+typedef struct HD44780State {
+	int width, height;
+	int connectiontype;
+	int model;
+	int charmap;
+	char busyFlag;		/**< the busy flag could be read */
+	CGram cc[NUM_CCs];	/**< custom characters, and those not yet sent */
+	CharCache charcache;
+} HD44780State;
+
+
+/**
+ * Take up the state saved when the server last exited, if the display is
+ * set up the same: the display still shows the backing store and the
+ * custom characters, so it is not cleared and the first flush only sends
+ * what changed. With hardware scrolling the display shift is not known,
+ * so the display is always cleared.
+ * \param drvthis  Pointer to driver structure.
+ */
+static void
+HD44780_load_state(Driver *drvthis)
+{
+	PrivateData *p = (PrivateData *) drvthis->private_data;
+	int size = sizeof(HD44780State) + p->width * p->height;
+	HD44780State *st;
+
+	if (p->hwscroll)
+		return;
+	st = malloc(size);
+	if (st == NULL)
+		return;
+
+	if ((drvthis->load_state(drvthis, st, size) == size)
+	    && (st->width == p->width) && (st->height == p->height)
+	    && (st->connectiontype == p->connectiontype) && (st->model == p->model)
+	    && (st->charmap == p->charmap)) {
+		memcpy(p->backingstore, (unsigned char *) (st + 1), p->width * p->height);
+		memcpy(p->cc, st->cc, sizeof(p->cc));
+		p->charcache = st->charcache;
+		p->busyFlag = p->busyFlag && st->busyFlag;
+		p->warm = 1;
+		report(RPT_INFO, "%s: display still shows the last frame, not clearing it",
+		       drvthis->name);
+	}
+	free(st);
+}
+
+
+/**
+ * Save the state of the display for the next start of the server, see
+ * HD44780_load_state().
+ * \param drvthis  Pointer to driver structure.
+ */
+static void
+HD44780_save_state(Driver *drvthis)
+{
+	PrivateData *p = (PrivateData *) drvthis->private_data;
+	int size = sizeof(HD44780State) + p->width * p->height;
+	HD44780State *st;
+
+	if ((p->backingstore == NULL) || p->hwscroll)
+		return;
+	st = calloc(1, size);
+	if (st == NULL)
+		return;
+
+	st->width = p->width;
+	st->height = p->height;
+	st->connectiontype = p->connectiontype;
+	st->model = p->model;
+	st->charmap = p->charmap;
+	st->busyFlag = p->busyFlag;
+	memcpy(st->cc, p->cc, sizeof(st->cc));
+	st->charcache = p->charcache;
+	memcpy((unsigned char *) (st + 1), p->backingstore, p->width * p->height);
+	drvthis->save_state(drvthis, st, size);
+	free(st);
 }
 
 
@@ -747,6 +1058,8 @@ HD44780_close(Driver *drvthis)
 	PrivateData *p = (PrivateData *) drvthis->private_data;
 
 	if (p != NULL) {
+		HD44780_save_state(drvthis);
+
 		if (p->hd44780_functions->close != NULL)
 			p->hd44780_functions->close(p);
 
@@ -756,6 +1069,19 @@ HD44780_close(Driver *drvthis)
 		if (p->backingstore)
 			free(p->backingstore);
 
+		if (p->runs)
+			free(p->runs);
+
+		if (p->dispRun)
+			free(p->dispRun);
+
+#ifdef HAVE_GPIOD
+		if (p->keyLine != NULL)
+			gpiod_line_release(p->keyLine);
+		if (p->keyChip != NULL)
+			gpiod_chip_close(p->keyChip);
+#endif
+
 		free(p);
 	}
 	drvthis->store_private_ptr(drvthis, NULL);
@@ -829,12 +1155,37 @@ HD44780_position(Driver *drvthis, int x, int y)
 {
 	PrivateData *p = (PrivateData *) drvthis->private_data;
 	int dispID = p->spanList[y];
+
+	p->hd44780_functions->senddata(p, dispID, RS_INSTR, POSITION | HD44780_ddaddr(p, x, y));
+	HD44780_wait(p, dispID, 40);  /* Minimum exec time for all commands */
+	if (p->hd44780_functions->flush != NULL)
+		p->hd44780_functions->flush(p);
+}
+
+
+/**
+ * Get the display data RAM address of a position.
+ * \param p  Pointer to PrivateData structure.
+ * \param x  X-coordinate.
+ * \param y  Y-coordinate.
+ * \return  The address on the display showing line y.
+ */
+static int
+HD44780_ddaddr(PrivateData *p, int x, int y)
+{
+	int dispID = p->spanList[y];
 	int relY = y - p->dispVOffset[dispID - 1];
 	int DDaddr;
 
 	if (has_extended_mode(p)) {
-		/* Linear addressing, each line starts 0x20 higher. */
-		DDaddr = x + relY * p->line_address;
+		/*
+		 * Linear addressing, each line starts 0x20 higher. A line
+		 * shifted in hardware shows its memory from line_shift on.
+		 */
+		DDaddr = x;
+		if (p->hwscroll)
+			DDaddr = (x + p->line_shift[relY]) % p->line_address;
+		DDaddr += relY * p->line_address;
 	} else {
 		/*
 		 * 16x1 is a special case: char 0 starts at 0x00, but char 8
@@ -855,10 +1206,150 @@ HD44780_position(Driver *drvthis, int x, int y)
 		if ((relY % 4) >= 2)
 			DDaddr += p->width;
 	}
-	p->hd44780_functions->senddata(p, dispID, RS_INSTR, POSITION | DDaddr);
-	p->hd44780_functions->uPause(p, 40);  /* Minimum exec time for all commands */
-	if (p->hd44780_functions->flush != NULL)
-		p->hd44780_functions->flush(p);
+	return DDaddr;
+}
+
+
+/**
+ * Find a display's next run of the frame.
+ * \param p       Pointer to PrivateData structure.
+ * \param dispID  The display.
+ * \param from    Index to start searching at.
+ * \return  Index of the run; -1 if there is none.
+ */
+static int
+HD44780_next_run(PrivateData *p, int dispID, int from)
+{
+	for (; from < p->numRuns; from++) {
+		if (p->spanList[p->runs[from].y] == dispID)
+			return from;
+	}
+	return -1;
+}
+
+
+/**
+ * Find the next run of changed custom character rows. A row is addressed
+ * by its CGRAM address, char * 8 + row, so the rows of consecutive chars
+ * are contiguous. Like the runs of the frame, a run bridges unchanged rows
+ * where resending them is cheaper than setting the address again.
+ * \param p     Pointer to PrivateData structure.
+ * \param from  CGRAM address to start searching at.
+ * \param len   Returns the number of rows of the run.
+ * \return  CGRAM address of the run; -1 if there is none.
+ */
+static int
+HD44780_next_cgram_run(PrivateData *p, int from, int *len)
+{
+	int start, end, a;
+
+	for (start = from; start < NUM_CCs * 8; start++) {
+		if (p->cc[start / 8].dirty & (1 << (start % 8)))
+			break;
+	}
+	if (start >= NUM_CCs * 8)
+		return -1;
+
+	end = start + 1;
+	for (a = end; a < NUM_CCs * 8; a++) {
+		if ((a % 8 >= p->cellheight) || (p->cc_whole && (a % 8 == 0)))
+			break;
+		if (p->cc[a / 8].dirty & (1 << (a % 8)))
+			end = a + 1;
+		else if (a + 1 - end > p->position_cost)
+			break;
+	}
+	*len = end - start;
+	return start;
+}
+
+
+/**
+ * Send the runs of a frame to a display with several controllers, one
+ * byte to each controller in turn: they execute it at the same time, so
+ * one wait covers all of them.
+ * \param p  Pointer to PrivateData structure.
+ */
+static void
+HD44780_send_interleaved(PrivateData *p)
+{
+	int d;
+	int sent;
+
+	for (d = 0; d < p->numDisplays; d++)
+		p->dispRun[d] = HD44780_next_run(p, d + 1, 0);
+
+	do {
+		sent = 0;
+		for (d = 0; d < p->numDisplays; d++) {
+			FlushRun *run;
+
+			if (p->dispRun[d] < 0)
+				continue;
+			run = &p->runs[p->dispRun[d]];
+			if (run->sent < 0) {
+				p->hd44780_functions->senddata(p, d + 1, RS_INSTR,
+							       POSITION | HD44780_ddaddr(p, run->x, run->y));
+			}
+			else {
+				p->hd44780_functions->senddata(p, d + 1, RS_DATA,
+							       p->framebuf[run->y * p->width + run->x + run->sent]);
+			}
+			if (++run->sent == run->len)
+				p->dispRun[d] = HD44780_next_run(p, d + 1, p->dispRun[d] + 1);
+			sent = 1;
+		}
+		if (sent)
+			HD44780_wait(p, 0, 40);  /* Minimum exec time for all commands */
+	} while (sent);
+}
+
+
+/**
+ * Shift a line on the display by one column, for a scroller filling it.
+ * Only extended mode controllers (KS0073 style) shift single lines; the
+ * cursor addresses of the line move along, see HD44780_ddaddr().
+ * \param drvthis  Pointer to driver structure.
+ * \param rect     The characters to move: a whole line.
+ * \param shift    -1 moves them to the left, 1 to the right.
+ * \retval 0       Success: only the character moved in is left to send.
+ * \retval -1      The line cannot be shifted.
+ */
+MODULE_EXPORT int
+HD44780_scroll_text(Driver *drvthis, const LCDRect *rect, int shift)
+{
+	PrivateData *p = (PrivateData *) drvthis->private_data;
+	unsigned char *row;
+	int relY = rect->y - 1;
+
+	if (!p->hwscroll || (rect->x != 1) || (rect->width != p->width)
+	    || (rect->height != 1) || (relY < 0) || (relY >= p->height)
+	    || ((shift != 1) && (shift != -1)))
+		return -1;
+
+	/* enable the shift for this line only, then shift */
+	p->hd44780_functions->senddata(p, 1, RS_INSTR, p->func_set_mode | EXTREG);
+	HD44780_wait(p, 1, 40);
+	p->hd44780_functions->senddata(p, 1, RS_INSTR, HSCROLLEN | (1 << relY));
+	HD44780_wait(p, 1, 40);
+	p->hd44780_functions->senddata(p, 1, RS_INSTR, p->func_set_mode);
+	HD44780_wait(p, 1, 40);
+	p->hd44780_functions->senddata(p, 1, RS_INSTR,
+				       CURSORSHIFT | SCROLLDISP | ((shift < 0) ? MOVELEFT : MOVERIGHT));
+	HD44780_wait(p, 1, 40);
+	p->line_shift[relY] = (p->line_shift[relY] - shift + p->line_address) % p->line_address;
+
+	/* the display shows the line moved; what moved in is unknown */
+	row = p->backingstore + relY * p->width;
+	if (shift < 0) {
+		memmove(row, row + 1, p->width - 1);
+		row[p->width - 1] = ~p->framebuf[relY * p->width + p->width - 1];
+	}
+	else {
+		memmove(row + 1, row, p->width - 1);
+		row[0] = ~p->framebuf[relY * p->width];
+	}
+	return 0;
 }
 
 
@@ -873,6 +1364,7 @@ HD44780_flush(Driver *drvthis)
 	int x, y;
 	int i;
 	int count;
+	int len;
 	char refreshNow = 0;
 	char keepaliveNow = 0;
 	time_t now = time(NULL);
@@ -881,8 +1373,10 @@ HD44780_flush(Driver *drvthis)
 	if ((p->refreshdisplay > 0) && (now > p->nextrefresh)) {
 		refreshNow = 1;
 		p->nextrefresh = now + p->refreshdisplay;
-		if (p->hd44780_functions->reset)
+		if (p->hd44780_functions->reset) {
 			p->hd44780_functions->reset(p);
+			p->cursor_shown = -1;
+		}
 	}
 	/* keepalive refresh of display */
 	if ((p->keepalivedisplay > 0) && (now > p->nextkeepalive)) {
@@ -892,23 +1386,23 @@ HD44780_flush(Driver *drvthis)
 
 	/*
 	 * LCD update algorithm: For each line skip over leading and trailing
-	 * identical portions of the line. Then send everything in between.
-	 * This will also update unchanged parts in the middle but is still
-	 * faster than the old algorithm, especially with devices using the
+	 * identical portions of the line. Then send everything in between,
+	 * except for unchanged parts in the middle that are longer than the
+	 * cost of moving the cursor of the connection type (position_cost):
+	 * short ones are cheaper to resend, especially with devices using the
 	 * transmit buffer.
 	 */
 	count = 0;
+	p->numRuns = 0;
 	for (y = 0; y < p->height; y++) {
-		int drawing;
 		int dispID = p->spanList[y];
 
 		/* set pointers to start of the line */
 		unsigned char *sp = p->framebuf + (y * p->width);
 		unsigned char *sq = p->backingstore + (y * p->width);
 
-		/* set pointers to end of the line */
+		/* set pointer to end of the line */
 		unsigned char *ep = sp + (p->width - 1);
-		unsigned char *eq = sq + (p->width - 1);
 
 		/* On forced refresh update everything */
 		if (refreshNow || keepaliveNow) {
@@ -916,51 +1410,181 @@ HD44780_flush(Driver *drvthis)
 		}
 		else {
 			/* find begin and end of differences */
-			for (x = 0; (sp <= ep) && (*sp == *sq); sp++, sq++, x++)
-			  ;
-			for (; (ep >= sp) && (*ep == *eq); ep--, eq--)
-			  ;
+			int first, last;
+
+			if (!lib_diff_span(sp, sq, p->width, &first, &last))
+				continue;
+			x = first;
+			ep = sp + last;
+			sp += first;
+			sq += first;
 		}
 
-		/* there are differences, ... */
-		if (sp <= ep) {
-			for (drawing = 0; sp <= ep; x++, sp++, sq++) {
-				 /* x%8 is for 16x1 displays only ! */
-				if (!drawing || (p->dispSizes[dispID-1] == 1 && p->width == 16 && (x % 8 == 0))) {
-					drawing = 1;
-					HD44780_position(drvthis,x,y);
+		/* there are differences, send them a run at a time */
+		while (sp <= ep) {
+			int len;
+
+			if (!refreshNow && !keepaliveNow) {
+				/* skip unchanged characters up to the next run */
+				int skip = lib_diff_first(sp, sq, ep - sp + 1);
+
+				sp += skip;
+				sq += skip;
+				x += skip;
+			}
+			len = ep - sp + 1;
+
+			/* 16x1 displays: x%8 starts the second half of the line */
+			if (p->dispSizes[dispID-1] == 1 && p->width == 16 && (x < 8) && (x + len > 8))
+				len = 8 - x;
+
+			/*
+			 * End the run before an unchanged part that costs
+			 * more to resend than moving the cursor past it.
+			 */
+			if (!refreshNow && !keepaliveNow) {
+				for (i = 0; i < len; i++) {
+					int gap;
+
+					for (gap = 0; (i + gap < len) && (sp[i + gap] == sq[i + gap]); gap++)
+					  ;
+					if (gap > p->position_cost) {
+						len = i;
+						break;
+					}
+					i += gap;
 				}
-				p->hd44780_functions->senddata(p, dispID, RS_DATA, *sp);
-				p->hd44780_functions->uPause(p, 40);  /* Minimum exec time for all commands */
-				*sq = *sp;	/* Update backing store */
-				count++;
 			}
+
+			p->runs[p->numRuns].x = x;
+			p->runs[p->numRuns].y = y;
+			p->runs[p->numRuns].len = len;
+			p->runs[p->numRuns].sent = -1;
+			p->numRuns++;
+			memcpy(sq, sp, len);	/* Update backing store */
+			x += len;
+			sp += len;
+			sq += len;
+			count += len;
+		}
+	}
+
+	if (p->interleave) {
+		HD44780_send_interleaved(p);
+	}
+	else {
+		for (i = 0; i < p->numRuns; i++) {
+			FlushRun *run = &p->runs[i];
+
+			HD44780_position(drvthis, run->x, run->y);
+			HD44780_senddata_bulk(p, p->spanList[run->y], RS_DATA,
+					      p->framebuf + run->y * p->width + run->x, run->len);
 		}
 	}
 	debug(RPT_DEBUG, "HD44780: flushed %d chars", count);
+	drvthis->count_io(drvthis, IO_CHARS, count);
 
 	/* Check which definable chars we need to update */
 	count = 0;
 	for (i = 0; i < NUM_CCs; i++) {
-		if (!p->cc[i].clean) {
-			int row;
-
-			/* Tell the HD44780 we will redefine char number i */
-			p->hd44780_functions->senddata(p, 0, RS_INSTR, SETCHAR | i * 8);
-			p->hd44780_functions->uPause(p, 40);  /* Minimum exec time for all commands */
-
-			/* Send the subsequent rows */
-			for (row = 0; row < p->cellheight; row++) {
-				p->hd44780_functions->senddata(p, 0, RS_DATA, p->cc[i].cache[row]);
-				p->hd44780_functions->uPause(p, 40);  /* Minimum exec time for all commands */
-			}
-			p->cc[i].clean = 1;	/* mark as clean */
+		if (p->cc[i].dirty) {
+			if (p->cc_whole)
+				p->cc[i].dirty = (1 << p->cellheight) - 1;
 			count++;
 		}
 	}
+	for (i = 0; (i = HD44780_next_cgram_run(p, i, &len)) >= 0; i += len) {
+		unsigned char rows[NUM_CCs * 8];
+		int a;
+
+		for (a = 0; a < len; a++)
+			rows[a] = p->cc[(i + a) / 8].cache[(i + a) % 8];
+
+		/* Tell the HD44780 we will redefine the rows from address i on */
+		p->hd44780_functions->senddata(p, 0, RS_INSTR, SETCHAR | i);
+		HD44780_wait(p, 0, 40);  /* Minimum exec time for all commands */
+
+		/* Send the rows; the address increments after each */
+		HD44780_senddata_bulk(p, 0, RS_DATA, rows, len);
+	}
+	for (i = 0; i < NUM_CCs; i++)
+		p->cc[i].dirty = 0;	/* mark as clean */
 	if (p->hd44780_functions->flush != NULL)
 		p->hd44780_functions->flush(p);
 	debug(RPT_DEBUG, "%s: flushed %d custom chars", drvthis->name, count);
+	drvthis->count_io(drvthis, IO_CGRAM, count);
+
+	HD44780_flush_cursor(drvthis);
+
+	if (p->device_lost)
+		drvthis->lost_device(drvthis);
+}
+
+
+/**
+ * Show the cursor wanted after a flush (not part of API). Writing the
+ * frame and the custom characters moves the address counter, so a cursor
+ * that is on goes back to its position on every flush; the core only
+ * flushes frames that changed.
+ * \param drvthis  Pointer to driver structure.
+ */
+static void
+HD44780_flush_cursor(Driver *drvthis)
+{
+	PrivateData *p = (PrivateData *) drvthis->private_data;
+	int bits;
+
+	if (p->numDisplays > 1)
+		return;
+
+	switch (p->cursor_state) {
+		case CURSOR_OFF:
+			bits = CURSOROFF | CURSORNOBLINK;
+			break;
+		case CURSOR_UNDER:
+			bits = CURSORON | CURSORNOBLINK;
+			break;
+		case CURSOR_BLOCK:
+			bits = CURSOROFF | CURSORBLINK;
+			break;
+		case CURSOR_DEFAULT_ON:
+		default:
+			bits = CURSORON | CURSORBLINK;
+			break;
+	}
+	if (bits != p->cursor_shown) {
+		p->hd44780_functions->senddata(p, 0, RS_INSTR, ONOFFCTRL | DISPON | bits);
+		HD44780_wait(p, 0, 40);
+		p->cursor_shown = bits;
+		if ((p->cursor_state == CURSOR_OFF) && (p->hd44780_functions->flush != NULL))
+			p->hd44780_functions->flush(p);
+	}
+	if (p->cursor_state != CURSOR_OFF)
+		HD44780_position(drvthis, p->cursor_x, p->cursor_y);
+}
+
+
+/**
+ * Set the cursor, shown by the controller at the next flush.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal cursor position (column).
+ * \param y        Vertical cursor position (row).
+ * \param state    New cursor state.
+ */
+MODULE_EXPORT void
+HD44780_cursor(Driver *drvthis, int x, int y, int state)
+{
+	PrivateData *p = (PrivateData *) drvthis->private_data;
+
+	p->cursor_state = state;
+	if (state == CURSOR_OFF)
+		return;
+	if ((x < 1) || (x > p->width) || (y < 1) || (y > p->height)) {
+		p->cursor_state = CURSOR_OFF;
+		return;
+	}
+	p->cursor_x = x - 1;
+	p->cursor_y = y - 1;
 }
 
 
@@ -975,6 +1599,7 @@ HD44780_clear(Driver *drvthis)
 
 	memset(p->framebuf, ' ', p->width * p->height);
 	p->ccmode = standard;
+	lib_cc_frame(&p->charcache);
 }
 
 
@@ -1221,29 +1846,25 @@ MODULE_EXPORT void
 HD44780_vbar(Driver *drvthis, int x, int y, int len, int promille, int options)
 {
 	PrivateData *p = (PrivateData *) drvthis->private_data;
+	unsigned char vBar[p->cellheight];
+	int full, partial;
+	int pos;
 
-	if (p->ccmode != vbar) {
-		unsigned char vBar[p->cellheight];
-		int i;
+	lib_bar_plan(len, promille, p->cellheight, &full, &partial);
 
-		if (p->ccmode != standard) {
-			/* Not supported(yet) */
-			report(RPT_WARNING, "%s: vbar: cannot combine two modes using user-defined characters",
-				drvthis->name);
-			return;
-		}
-		p->ccmode = vbar;
+	for (pos = 0; pos < full; pos++)
+		HD44780_icon(drvthis, x, y - pos, ICON_BLOCK_FILLED);
 
-		memset(vBar, 0x00, sizeof(vBar));
+	if (partial > 0) {
+		int n;
 
-		for (i = 1; i < p->cellheight; i++) {
-			/* add pixel line per pixel line ... */
-			vBar[p->cellheight - i] = 0xFF;
-			HD44780_set_char(drvthis, i, vBar);
-		}
+		/* fill pixel lines from the bottom up */
+		memset(vBar, 0x00, sizeof(vBar));
+		memset(vBar + p->cellheight - partial, 0xFF, partial);
+		n = HD44780_custom_char(drvthis, vBar);
+		if (n >= 0)
+			HD44780_chr(drvthis, x, y - full, n);
 	}
-
-	lib_vbar_static(drvthis, x, y, len, promille, options, p->cellheight, 0);
 }
 
 
@@ -1260,28 +1881,24 @@ MODULE_EXPORT void
 HD44780_hbar(Driver *drvthis, int x, int y, int len, int promille, int options)
 {
 	PrivateData *p = (PrivateData *) drvthis->private_data;
+	unsigned char hBar[p->cellheight];
+	int full, partial;
+	int pos;
 
-	if (p->ccmode != hbar) {
-		unsigned char hBar[p->cellheight];
-		int i;
+	lib_bar_plan(len, promille, p->cellwidth, &full, &partial);
 
-		if (p->ccmode != standard) {
-			/* Not supported(yet) */
-			report(RPT_WARNING, "%s: hbar: cannot combine two modes using user-defined characters",
-			      drvthis->name);
-			return;
-		}
+	for (pos = 0; pos < full; pos++)
+		HD44780_icon(drvthis, x + pos, y, ICON_BLOCK_FILLED);
 
-		p->ccmode = hbar;
+	if (partial > 0) {
+		int n;
 
-		for (i = 1; i <= p->cellwidth; i++) {
-			/* fill pixel columns from left to right. */
-			memset(hBar, 0xFF & ~((1 << (p->cellwidth - i)) - 1), sizeof(hBar));
-			HD44780_set_char(drvthis, i, hBar);
-		}
+		/* fill pixel columns from left to right. */
+		memset(hBar, 0xFF & ~((1 << (p->cellwidth - partial)) - 1), sizeof(hBar));
+		n = HD44780_custom_char(drvthis, hBar);
+		if (n >= 0)
+			HD44780_chr(drvthis, x + full, y, n);
 	}
-
-	lib_hbar_static(drvthis, x, y, len, promille, options, p->cellwidth, 0);
 }
 
 
@@ -1343,24 +1960,77 @@ MODULE_EXPORT void
 HD44780_set_char(Driver *drvthis, int n, unsigned char *dat)
 {
 	PrivateData *p = (PrivateData *) drvthis->private_data;
-	unsigned char mask = (1 << p->cellwidth) - 1;
-	int row;
+	unsigned char glyph[LCD_DEFAULT_CELLHEIGHT];
 
 	if ((n < 0) || (n >= NUM_CCs))
 		return;
 	if (!dat)
 		return;
 
-	for (row = 0; row < p->cellheight; row++) {
-		int letter = 0;
+	HD44780_glyph(p, dat, glyph);
+	lib_cc_set(&p->charcache, n, glyph);
+	HD44780_define_char(p, n, glyph);
+}
+
+
+/* Convert pixel rows to what the display stores: only the pixel columns of
+ * a cell, and the last line blank unless it is enabled */
+static void
+HD44780_glyph(PrivateData *p, const unsigned char *dat, unsigned char *glyph)
+{
+	unsigned char mask = (1 << p->cellwidth) - 1;
+	int row;
 
+	for (row = 0; row < p->cellheight; row++) {
+		glyph[row] = 0;
 		if (p->lastline || (row < p->cellheight - 1))
-			letter = dat[row] & mask;
+			glyph[row] = dat[row] & mask;
+	}
+}
+
+
+/* Store a custom character for the next flush */
+static void
+HD44780_define_char(PrivateData *p, int n, const unsigned char *glyph)
+{
+	int row;
+
+	for (row = 0; row < p->cellheight; row++) {
+		if (p->cc[n].cache[row] != glyph[row])
+			p->cc[n].dirty |= 1 << row;	/* only mark dirty if really different */
+		p->cc[n].cache[row] = glyph[row];
+	}
+}
+
 
-		if (p->cc[n].cache[row] != letter)
-			p->cc[n].clean = 0;	/* only mark dirty if really different */
-		p->cc[n].cache[row] = letter;
+/*
+ * Get a custom character showing the given pixel rows from the character
+ * cache, defining one if none shows them yet. Bars and icons share the
+ * characters this way, and a glyph still defined from an earlier screen
+ * is not uploaded again. Returns the character, or -1 if there is none
+ * left (or big numbers use them all).
+ */
+static int
+HD44780_custom_char(Driver *drvthis, unsigned char *dat)
+{
+	PrivateData *p = (PrivateData *) drvthis->private_data;
+	unsigned char glyph[LCD_DEFAULT_CELLHEIGHT];
+	int define;
+	int n;
+
+	if (p->ccmode == bignum)
+		return -1;
+
+	HD44780_glyph(p, dat, glyph);
+	n = lib_cc_alloc(&p->charcache, glyph, &define);
+	if (n < 0) {
+		debug(RPT_DEBUG, "%s: no custom character left", drvthis->name);
+		return -1;
 	}
+	if (define)
+		HD44780_define_char(p, n, glyph);
+	p->ccmode = custom;
+	return n;
 }
 
 
@@ -1376,7 +2046,8 @@ HD44780_set_char(Driver *drvthis, int n, unsigned char *dat)
 MODULE_EXPORT int
 HD44780_icon(Driver *drvthis, int x, int y, int icon)
 {
-	PrivateData *p = (PrivateData *) drvthis->private_data;
+	unsigned char *dat;
+	int n;
 
 	static unsigned char heart_open[] =
 		{ b__XXXXX,
@@ -1461,76 +2132,131 @@ HD44780_icon(Driver *drvthis, int x, int y, int icon)
 		return 0;
 	}
 
-	/* The full block works except if ccmode=bignum */
-	if (icon == ICON_BLOCK_FILLED) {
-		if (p->ccmode != bignum) {
-			HD44780_set_char(drvthis, 0, block_filled);
-			HD44780_chr(drvthis, x, y, 0);
-			return 0;
-		}
-		else {
-			return -1;
-		}
-	}
-
-	/* The heartbeat icons do not work in bignum and vbar mode */
-	if ((icon == ICON_HEART_FILLED) || (icon == ICON_HEART_OPEN)) {
-		if ((p->ccmode != bignum) && (p->ccmode != vbar)) {
-			switch (icon) {
-			    case ICON_HEART_FILLED:
-				HD44780_set_char(drvthis, 7, heart_filled);
-				HD44780_chr(drvthis, x, y, 7);
-				return 0;
-			    case ICON_HEART_OPEN:
-				HD44780_set_char(drvthis, 7, heart_open);
-				HD44780_chr(drvthis, x, y, 7);
-				return 0;
-			}
-		}
-		else {
-			return -1;
-		}
-	}
-
-	/* All other icons work only in the standard or icon ccmode */
-	if (p->ccmode != icons) {
-		if (p->ccmode != standard) {
-			/* Not supported (yet) */
-			report(RPT_WARNING, "%s: num: cannot combine two modes using user-defined characters",
-					drvthis->name);
-			return -1;
-		}
-		p->ccmode = icons;
-	}
-
 	switch (icon) {
+		case ICON_BLOCK_FILLED:
+			dat = block_filled;
+			break;
+		case ICON_HEART_FILLED:
+			dat = heart_filled;
+			break;
+		case ICON_HEART_OPEN:
+			dat = heart_open;
+			break;
 		case ICON_ARROW_UP:
-			HD44780_set_char(drvthis, 1, arrow_up);
-			HD44780_chr(drvthis, x, y, 1);
+			dat = arrow_up;
 			break;
 		case ICON_ARROW_DOWN:
-			HD44780_set_char(drvthis, 2, arrow_down);
-			HD44780_chr(drvthis, x, y, 2);
+			dat = arrow_down;
 			break;
 		case ICON_CHECKBOX_OFF:
-			HD44780_set_char(drvthis, 3, checkbox_off);
-			HD44780_chr(drvthis, x, y, 3);
+			dat = checkbox_off;
 			break;
 		case ICON_CHECKBOX_ON:
-			HD44780_set_char(drvthis, 4, checkbox_on);
-			HD44780_chr(drvthis, x, y, 4);
+			dat = checkbox_on;
 			break;
 		case ICON_CHECKBOX_GRAY:
-			HD44780_set_char(drvthis, 5, checkbox_gray);
-			HD44780_chr(drvthis, x, y, 5);
+			dat = checkbox_gray;
 			break;
 		default:
 			return -1;	/* Let the core do other icons */
 	}
+
+	/* Other icons share the custom characters, except with big numbers */
+	n = HD44780_custom_char(drvthis, dat);
+	if (n < 0)
+		return -1;
+	HD44780_chr(drvthis, x, y, n);
+	return 0;
+}
+
+
+#ifdef HAVE_GPIOD
+/**
+ * Set up the interrupt line of the keypad, if one is configured: a GPIO
+ * line that changes when a key is pressed or released, like the INT
+ * output of the port expander of i2c or pifacecad keypads. With it the
+ * keypad is read only after a change instead of on every call of
+ * HD44780_get_key().
+ * \param drvthis  Pointer to driver structure.
+ * \retval 0       Success, or no interrupt line configured.
+ * \retval -1      Error.
+ */
+static int
+HD44780_keypad_irq_init(Driver *drvthis)
+{
+	PrivateData *p = (PrivateData *) drvthis->private_data;
+	const char *chip;
+	int line;
+
+	line = drvthis->config_get_int(drvthis->name, "KeypadIRQ", 0, -1);
+	if (line < 0)
+		return 0;
+
+	chip = drvthis->config_get_string(drvthis->name, "gpiochip", 0, "gpiochip0");
+	p->keyChip = gpiod_chip_open_lookup(chip);
+	if (p->keyChip == NULL) {
+		report(RPT_ERR, "%s: unable to open GPIO chip %s: %s",
+		       drvthis->name, chip, strerror(errno));
+		return -1;
+	}
+
+	p->keyLine = gpiod_chip_get_line(p->keyChip, line);
+	if ((p->keyLine == NULL)
+	    || (gpiod_line_request_both_edges_events(p->keyLine, "LCDd") < 0)) {
+		report(RPT_ERR, "%s: unable to request GPIO%d as keypad interrupt: %s",
+		       drvthis->name, line, strerror(errno));
+		p->keyLine = NULL;
+		return -1;
+	}
+
+	/* a key may be pressed already */
+	p->keyState = KEY_DEBOUNCE;
+	report(RPT_INFO, "%s: keypad interrupt on GPIO%d", drvthis->name, line);
 	return 0;
 }
 
 
+/**
+ * Tell whether a keypad with interrupt line needs to be read. After an
+ * interrupt the keys get KEYPAD_DEBOUNCE milliseconds to settle; while a
+ * key is held it is read on every call, for autorepeat and to see it
+ * released.
+ * \param p    Pointer to PrivateData structure.
+ * \param now  The current time.
+ * \return  1 to read the keypad, 0 if nothing has changed yet.
+ */
+static int
+HD44780_keypad_activity(PrivateData *p, struct timeval *now)
+{
+	struct timespec no_wait = { 0, 0 };
+	struct gpiod_line_event event;
+	struct timeval diff;
+	int changed = 0;
+
+	while (gpiod_line_event_wait(p->keyLine, &no_wait) == 1) {
+		if (gpiod_line_event_read(p->keyLine, &event) < 0)
+			break;
+		changed = 1;
+	}
+	if (changed) {
+		p->keyState = KEY_DEBOUNCE;
+		p->keyEdgeTime = *now;
+		return 0;
+	}
+
+	switch (p->keyState) {
+		case KEY_IDLE:
+			return 0;
+		case KEY_DEBOUNCE:
+			timersub(now, &p->keyEdgeTime, &diff);
+			return (diff.tv_sec * 1000 + diff.tv_usec / 1000) >= KEYPAD_DEBOUNCE;
+		default:
+			return 1;
+	}
+}
+#endif
+
+
 /**
  * Get key from the key panel connected to the display.
  * \param drvthis  Pointer to driver structure.
@@ -1551,7 +2277,16 @@ HD44780_get_key(Driver *drvthis)
 
 	gettimeofday(&curr_time, NULL);
 
+#ifdef HAVE_GPIOD
+	if ((p->keyLine != NULL) && !HD44780_keypad_activity(p, &curr_time))
+		return NULL;
+#endif
+
 	scancode = p->hd44780_functions->scankeypad(p);
+#ifdef HAVE_GPIOD
+	if (p->keyLine != NULL)
+		p->keyState = (scancode != '\0') ? KEY_HELD : KEY_IDLE;
+#endif
 	if (scancode != '\0') {
 		/* Check if arrays are large enough */
 		if ((scancode&0x0F) > KEYPAD_MAXX || ((scancode&0xF0)>>4) > KEYPAD_MAXY) {
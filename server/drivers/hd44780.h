@@ -25,6 +25,7 @@ MODULE_EXPORT int  HD44780_cellwidth(Driver *drvthis);
 MODULE_EXPORT int  HD44780_cellheight(Driver *drvthis);
 MODULE_EXPORT void HD44780_clear(Driver *drvthis);
 MODULE_EXPORT void HD44780_flush(Driver *drvthis);
+MODULE_EXPORT int  HD44780_scroll_text(Driver *drvthis, const LCDRect *rect, int shift);
 MODULE_EXPORT void HD44780_string(Driver *drvthis, int x, int y, const char s[]);
 MODULE_EXPORT void HD44780_chr(Driver *drvthis, int x, int y, char ch);
 
@@ -32,6 +33,7 @@ MODULE_EXPORT void HD44780_vbar(Driver *drvthis, int x, int y, int len, int prom
 MODULE_EXPORT void HD44780_hbar(Driver *drvthis, int x, int y, int len, int promille, int options);
 MODULE_EXPORT void HD44780_num(Driver *drvthis, int x, int num);
 MODULE_EXPORT int  HD44780_icon(Driver *drvthis, int x, int y, int icon);
+MODULE_EXPORT void HD44780_cursor(Driver *drvthis, int x, int y, int state);
 
 MODULE_EXPORT void HD44780_set_char(Driver *drvthis, int n, unsigned char *dat);
 MODULE_EXPORT int  HD44780_get_free_chars(Driver *drvthis);
@@ -1,5 +1,11 @@
 /** \file server/drivers/i2c.c
  * OS agnostic functions to access i2c devices.
+ *
+ * Drivers that write many small messages, like the port states of an I/O
+ * expander, queue them with i2c_queue() and write them with i2c_commit():
+ * on Linux they then go to the bus in combined transfers, as many messages
+ * per I2C_RDWR ioctl as the kernel takes, instead of a write() each.
+ * Adapters that cannot do combined transfers get the messages one by one.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -8,6 +14,7 @@
 
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -15,24 +22,43 @@
 #ifdef HAVE_DEV_IICBUS_IIC_H
 #include <dev/iicbus/iic.h>
 #else /* HAVE_LINUX_I2C_DEV_H */
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 /* I2C_SLAVE is missing in linux/i2c-dev.h from kernel headers of 2.4.x kernels
 */
 #ifndef I2C_SLAVE
 #define I2C_SLAVE 0x0703  /* ioctl to change slave address */
 #endif
+#ifndef I2C_RDWR_IOCTL_MAX_MSGS
+#define I2C_RDWR_IOCTL_MAX_MSGS 42
+#endif
 #endif
 
 #define I2C_DEFAULT_DEVICE "/dev/i2c-0"
 
+/** bytes of the messages i2c_queue() keeps */
+#define I2C_QUEUE_BYTES 2048
+/** messages i2c_queue() keeps */
+#define I2C_QUEUE_MSGS 1024
+
 /** data to access an i2c slave */
 typedef struct {
 	int fd;			/**< file descriptor of the i2c device */
 #ifdef HAVE_DEV_IICBUS_IIC_H
 	unsigned int slave;	/**< slave address */
+#else
+	unsigned int addr;	/**< slave address */
+	int combined;		/**< the adapter does combined transfers (I2C_RDWR) */
 #endif
+	unsigned char queue[I2C_QUEUE_BYTES];	/**< messages not written yet */
+	unsigned short queue_len[I2C_QUEUE_MSGS];	/**< length of each of them */
+	unsigned int queued_bytes;	/**< bytes used in queue */
+	unsigned int queued_msgs;	/**< messages in queue */
 } I2CHandle;
 
+int i2c_write(I2CHandle *h, void *buf, unsigned int count);
+int i2c_commit(I2CHandle *h);
+
 
 /**
  * setup connection to i2c slave
@@ -70,7 +96,15 @@ I2CHandle *i2c_open(const char *device, unsigned int addr)
 	if (ioctl(h->fd, I2C_SLAVE, addr) < 0) {
 		goto close;
 	}
+	h->addr = addr;
+	{
+		unsigned long funcs = 0;
+
+		h->combined = (ioctl(h->fd, I2C_FUNCS, &funcs) == 0) && (funcs & I2C_FUNC_I2C);
+	}
 #endif
+	h->queued_bytes = 0;
+	h->queued_msgs = 0;
 
 	return h;
 
@@ -82,10 +116,11 @@ free:
 }
 
 /**
- * close connection to i2c slave
+ * close connection to i2c slave, after writing the messages still queued
  */
 void i2c_close(I2CHandle *h)
 {
+	i2c_commit(h);
 #ifdef HAVE_DEV_IICBUS_IIC_H
 	ioctl(h->fd, I2CSTOP);
 #endif
@@ -118,3 +153,125 @@ int i2c_write(I2CHandle *h, void *buf, unsigned int count)
 	return 0;
 #endif
 }
+
+/**
+ * read data from an i2c slave. Messages still queued are written first.
+ * \param h	Handle of i2c slave
+ * \param buf   Buffer for the data read
+ * \param count Number of bytes to read
+ * \retval >=0     Success.
+ * \retval <0      Error.
+ */
+int i2c_read(I2CHandle *h, void *buf, unsigned int count)
+{
+#ifdef HAVE_DEV_IICBUS_IIC_H
+	struct iiccmd cmd;
+#endif
+
+	if (i2c_commit(h) < 0)
+		return -1;
+#ifdef HAVE_DEV_IICBUS_IIC_H
+	bzero(&cmd, sizeof(cmd));
+	cmd.slave = h->slave;
+	cmd.last = 1;
+	cmd.count = count;
+	cmd.buf = buf;
+
+	return ioctl(h->fd, I2CREAD, &cmd);
+#else /* HAVE_LINUX_I2C_DEV_H */
+	if (read(h->fd, buf, count) != count)
+		return -1;
+	return 0;
+#endif
+}
+
+/**
+ * queue a message to an i2c slave, to be written by i2c_commit() together
+ * with the others. A full queue is written first.
+ * \param h	Handle of i2c slave
+ * \param buf   The message
+ * \param len   Number of bytes of the message
+ * \retval >=0     Success.
+ * \retval <0      Error writing the full queue, or the message is too long.
+ */
+int i2c_queue(I2CHandle *h, const void *buf, unsigned int len)
+{
+	int rc = 0;
+
+	if (len > I2C_QUEUE_BYTES)
+		return -1;
+	if ((h->queued_msgs == I2C_QUEUE_MSGS) || (h->queued_bytes + len > I2C_QUEUE_BYTES))
+		rc = i2c_commit(h);
+
+	memcpy(h->queue + h->queued_bytes, buf, len);
+	h->queue_len[h->queued_msgs++] = len;
+	h->queued_bytes += len;
+	return rc;
+}
+
+/**
+ * write the messages queued by i2c_queue() in as few combined transfers as
+ * the system allows, with a repeated start instead of a stop between them.
+ * Where there are no combined transfers each message is written on its own.
+ * The queue is empty afterwards, also on error.
+ * \param h	Handle of i2c slave
+ * \retval >=0     Success.
+ * \retval <0      Error.
+ */
+int i2c_commit(I2CHandle *h)
+{
+	unsigned char *buf = h->queue;
+	unsigned int i = 0;
+	int rc = 0;
+#ifndef HAVE_DEV_IICBUS_IIC_H
+	struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+	struct i2c_rdwr_ioctl_data data;
+
+	while (h->combined && (i < h->queued_msgs)) {
+		unsigned int n;
+
+		for (n = 0; (n < I2C_RDWR_IOCTL_MAX_MSGS) && (i < h->queued_msgs); n++, i++) {
+			msgs[n].addr = h->addr;
+			msgs[n].flags = 0;
+			msgs[n].len = h->queue_len[i];
+			msgs[n].buf = buf;
+			buf += h->queue_len[i];
+		}
+		data.msgs = msgs;
+		data.nmsgs = n;
+		if (ioctl(h->fd, I2C_RDWR, &data) < 0) {
+			rc = -1;
+			break;
+		}
+	}
+#endif
+	for (; (rc >= 0) && (i < h->queued_msgs); i++) {
+		rc = i2c_write(h, buf, h->queue_len[i]);
+		buf += h->queue_len[i];
+	}
+
+	h->queued_bytes = 0;
+	h->queued_msgs = 0;
+	return (rc < 0) ? -1 : 0;
+}
+
+/**
+ * write several messages to an i2c slave in one combined transfer, like
+ * i2c_queue() for each of them followed by i2c_commit().
+ * \param h	Handle of i2c slave
+ * \param buf    Buffer holding the messages one after the other
+ * \param msglen Number of bytes of each message
+ * \param count  Number of messages
+ * \retval >=0     Success.
+ * \retval <0      Error.
+ */
+int i2c_write_msgs(I2CHandle *h, unsigned char *buf, unsigned int msglen, unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (i2c_queue(h, buf + i * msglen, msglen) < 0)
+			return -1;
+	}
+	return i2c_commit(h);
+}
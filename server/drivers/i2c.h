@@ -10,5 +10,9 @@ typedef struct i2c_data I2CHandle;
 extern I2CHandle *i2c_open(const char *device, unsigned int addr);
 extern void i2c_close(I2CHandle *h);
 extern int i2c_write(I2CHandle *h, void *buf, unsigned int count);
+extern int i2c_read(I2CHandle *h, void *buf, unsigned int count);
+extern int i2c_queue(I2CHandle *h, const void *buf, unsigned int len);
+extern int i2c_commit(I2CHandle *h);
+extern int i2c_write_msgs(I2CHandle *h, unsigned char *buf, unsigned int msglen, unsigned int count);
 
 #endif /* I2C_H */
@@ -49,6 +49,7 @@
 #define DEFAULT_CONTRAST     200
 #define DEFAULT_BACKLIGHT    1	/**< turn backlight on */
 #define DEFAULT_DISCMODE     0	/**< spin the "slim" disc */
+#define DEFAULT_PARTIAL      1	/**< send the changed packets only */
 #define DEFAULT_ON_EXIT      1	/**< show the big clock */
 #define DEFAULT_PROTOCOL     0	/**< protocol for 15c2:ffdc device */
 
@@ -94,6 +95,9 @@ typedef struct imonlcd_private_data {
 	 */
 	int discMode;
 
+	/* send only the packets whose data changed, and the last one */
+	int partialUpdate;
+
 	/*
 	 * 0 = protocol for 15c2:ffdc device, 1 = protocol for 15c2:0038
 	 * device
@@ -367,6 +371,9 @@ imonlcd_init(Driver *drvthis)
 	/* Get the "disc-mode" setting */
 	p->discMode = drvthis->config_get_bool(drvthis->name, "DiscMode", 0, DEFAULT_DISCMODE);
 
+	/* Get the "partial update" setting */
+	p->partialUpdate = drvthis->config_get_bool(drvthis->name, "PartialUpdate", 0, DEFAULT_PARTIAL);
+
 	/*
 	 * We need a little bit of extra memory in the frame buffer so that
 	 * all of the last 7-byte-long packet data will be within the frame
@@ -537,16 +544,30 @@ imonlcd_flush(Driver *drvthis)
 	PrivateData *p = drvthis->private_data;
 
 	unsigned char msb;
-	int offset = 0, ret;
+	int size = p->bytesperline * p->height;
+	int offset = 0, ret, failed = 0;
+
+	if (memcmp(p->backingstore, p->framebuf, size) == 0)
+		return;
 
 	/*
-	 * The display only provides for a complete screen refresh. If
-	 * nothing has changed, don't refresh.
+	 * Every packet carries the memory register it writes, so only the
+	 * packets whose data changed need to be sent: each is a blocking USB
+	 * write. The last one is always sent, as it ends a complete refresh
+	 * too; PartialUpdate=no brings back complete refreshes for displays
+	 * that need them.
 	 */
-	if (memcmp(p->backingstore, p->framebuf, (p->bytesperline * p->height)) == 0)
-		return;
+	for (msb = 0x20; msb < 0x3c; msb++, offset += IMONLCD_PACKET_DATA_SIZE) {
+		if (p->partialUpdate && (msb != 0x3b)) {
+			int len = size - offset;
+
+			if (len > IMONLCD_PACKET_DATA_SIZE)
+				len = IMONLCD_PACKET_DATA_SIZE;
+			if ((len <= 0)
+			    || (memcmp(p->backingstore + offset, p->framebuf + offset, len) == 0))
+				continue;
+		}
 
-	for (msb = 0x20; msb < 0x3c; msb++) {
 		/* Copy the packet data from the frame buffer. */
 		memcpy(p->tx_buf, p->framebuf + offset, IMONLCD_PACKET_DATA_SIZE);
 
@@ -554,17 +575,29 @@ imonlcd_flush(Driver *drvthis)
 		p->tx_buf[IMONLCD_PACKET_DATA_SIZE] = msb;
 
 		ret = send_packet(p);
-		if (ret < 0)
+		if ((ret < 0) && (errno == ENODEV)) {
+			/* unplugged, the server brings the display back */
+			drvthis->lost_device(drvthis);
+			return;
+		}
+		else if (ret < 0) {
 			report(RPT_ERR, "imonlcd_flush: sending data for msb=%x: %s\n",
 					(int) msb, strerror(errno));
-		else if (ret != sizeof(p->tx_buf))
+			failed = 1;
+		}
+		else if (ret != sizeof(p->tx_buf)) {
 			report(RPT_ERR, "imonlcd: incomplete write\n");
-
-		offset += IMONLCD_PACKET_DATA_SIZE;
+			failed = 1;
+		}
+		else {
+			drvthis->count_io(drvthis, IO_BYTES, ret);
+			drvthis->count_io(drvthis, IO_WRITES, 1);
+		}
 	}
 
-	/* Update the backing store. */
-	memcpy(p->backingstore, p->framebuf, (p->bytesperline * p->height));
+	/* Update the backing store, unless the changes need to be sent again */
+	if (!failed)
+		memcpy(p->backingstore, p->framebuf, (p->bytesperline * p->height));
 }
 
 
@@ -618,6 +651,42 @@ imonlcd_chr(Driver *drvthis, int x, int y, char ch)
 	}
 }
 
+
+/**
+ * Write a block of characters to the screen. Row r of the block starts at
+ * buf + r * stride; the parts outside the display are left out.
+ * \param drvthis  Pointer to driver structure.
+ * \param buf      Characters of the top left row.
+ * \param stride   Distance between the rows in buf.
+ * \param rect     Position and size of the block.
+ */
+MODULE_EXPORT void
+imonlcd_blit_text (Driver *drvthis, const unsigned char *buf, int stride, const LCDRect *rect)
+{
+	PrivateData *p = drvthis->private_data;
+	imon_font *defn;
+	int i, j, col;
+
+	for (j = 0; j < rect->height; j++) {
+		const unsigned char *src = buf + j * stride;
+		int y = rect->y - 1 + j;
+
+		if ((y < 0) || (y >= p->height))
+			continue;
+		for (i = 0; i < rect->width; i++) {
+			int x = rect->x - 1 + i;
+
+			if (x < 0)
+				continue;
+			if (x >= p->width)
+				break;
+			defn = &font[src[i]];
+			for (col = 0; col < p->cellwidth; col++)
+				p->framebuf[x * p->cellwidth + col + y * p->bytesperline] = defn->pixels[col];
+		}
+	}
+}
+
 /**
  * Draw a vertical bar bottom-up.
  * \param drvthis  Pointer to driver structure.
@@ -43,6 +43,7 @@ typedef struct irmanin_private_data {
 	char device[256];	/**< IrMan device name */
 	char config[256];	/**< IrMan config file */
 	char *portname;		/**< IrMan port name */
+	int fd;			/**< Descriptor of the opened port */
 } PrivateData;
 
 
@@ -134,7 +135,7 @@ irmanin_init (Driver *drvthis)
 	}
 
 	errno = 0;
-	if (ir_init(p->portname) < 0) {
+	if ((p->fd = ir_init(p->portname)) < 0) {
 		report(RPT_ERR, "%s: error initialising Irman %s: %s",
 			drvthis->name, p->portname, strerror(errno));
 		return -1;
@@ -179,6 +180,8 @@ irmanin_get_key (Driver *drvthis)
 	case IR_CMD_ERROR:
 		report(RPT_WARNING, "%s: error reading command: %s",
 			drvthis->name, strerror(errno));
+		/* the port stays readable; open it again */
+		drvthis->lost_device(drvthis);
 		break;
 	case IR_CMD_UNKNOWN:
 		break;
@@ -191,4 +194,18 @@ irmanin_get_key (Driver *drvthis)
 	return key;
 }
 
+
+/**
+ * Get the descriptor that becomes readable when keys arrive.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Descriptor of the IrMan port.
+ */
+MODULE_EXPORT int
+irmanin_get_key_fd (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	return p->fd;
+}
+
 /* end of irmanin.c */
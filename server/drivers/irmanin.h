@@ -4,5 +4,6 @@
 MODULE_EXPORT int irmanin_init (Driver *drvthis);
 MODULE_EXPORT void irmanin_close (Driver *drvthis);
 MODULE_EXPORT const char *irmanin_get_key (Driver *drvthis);
+MODULE_EXPORT int irmanin_get_key_fd (Driver *drvthis);
 
 #endif
@@ -1,5 +1,12 @@
 /** \file server/drivers/irtrans.c
  * LCDd \c irtrans driver for IRTrans VFD displays.
+ *
+ * The driver keeps one connection to the irserver, which it never waits
+ * on: frames are sent without blocking, what the socket does not take is
+ * sent later, and the statuses the irserver sends back are read as they
+ * arrive. The server watches the socket, so codes received from the remote
+ * control are handed on as keys at once. When the connection is lost, the
+ * server connects again.
  */
 
 /*
@@ -37,10 +44,14 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
 #include <time.h>
 #include <netdb.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 
 #include "lcd.h"
@@ -57,6 +68,10 @@
 #define INADDR_NONE ((unsigned long) -1)
 #endif
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0          /* SIGPIPE is ignored by the server anyway */
+#endif
+
 /** private data for the \c irtrans driver */
 typedef struct irtrans_private_data {
     int width;
@@ -69,6 +84,13 @@ typedef struct irtrans_private_data {
     char hostname[256];
     char *framebuf;
     char *shadow_buf;
+    int lost;                   /* the connection is gone */
+    char remote[80];            /* keys only from this remote; "" for all */
+    LCDCOMMAND out;             /* frame being sent */
+    int out_left;               /* bytes of it the socket did not take yet */
+    char in[sizeof(STATUSBUFFER)];      /* statuses received, in part */
+    int in_len;
+    char key[24];               /* last key received */
 } PrivateData;
 
 // Vars for the server core
@@ -82,7 +104,8 @@ MODULE_EXPORT char *symbol_prefix = "irtrans_";
 //////////////////////////////////////////////////////////////////////////
 
 int InitClientSocket(char host[], SOCKET *sock, unsigned long id);
-int SendCommand(Driver *drvthis, LCDCOMMAND *com, STATUSBUFFER *stat);
+static int irtrans_drain(Driver *drvthis);
+static void irtrans_lost(Driver *drvthis, const char *why);
 
 
 MODULE_EXPORT int irtrans_init(Driver *drvthis)
@@ -96,6 +119,7 @@ MODULE_EXPORT int irtrans_init(Driver *drvthis)
         return -1;
     if (drvthis->store_private_ptr(drvthis, p))
         return -1;
+    p->socket = -1;
 
     /* initialize private data */
     p->has_backlight =
@@ -109,6 +133,11 @@ MODULE_EXPORT int irtrans_init(Driver *drvthis)
     p->hostname[sizeof(p->hostname) - 1] = '\0';
     report(RPT_INFO, "%s: Hostname is %s", drvthis->name, p->hostname);
 
+    strncpy(p->remote,
+            drvthis->config_get_string(drvthis->name, "Remote", 0, ""),
+            sizeof(p->remote));
+    p->remote[sizeof(p->remote) - 1] = '\0';
+
     // Set display sizes
     if ((drvthis->request_display_width() > 0)
         && (drvthis->request_display_height() > 0)) {
@@ -152,6 +181,8 @@ MODULE_EXPORT int irtrans_init(Driver *drvthis)
         report(RPT_ERR, "%s: unable to init client socket", drvthis->name);
         return -1;
     }
+    // Never wait for the irserver from here on
+    fcntl(p->socket, F_SETFL, fcntl(p->socket, F_GETFL) | O_NONBLOCK);
 
     report(RPT_DEBUG, "%s: init() done", drvthis->name);
 
@@ -165,19 +196,26 @@ MODULE_EXPORT void irtrans_close(Driver *drvthis)
 {
     PrivateData *p = drvthis->private_data;
 
-    irtrans_clear(drvthis);
-    sleep(5);
-    p->backlight = 0;
-    irtrans_flush(drvthis);
-
     if (p != NULL) {
+        // Say goodbye, unless the connection is gone
+        if ((p->socket >= 0) && !p->lost
+            && (p->framebuf != NULL) && (p->shadow_buf != NULL)) {
+            irtrans_clear(drvthis);
+            irtrans_flush(drvthis);
+            sleep(5);
+            p->backlight = 0;
+            irtrans_flush(drvthis);
+        }
+
+        if (p->socket >= 0)
+            close(p->socket);
         if (p->framebuf != NULL)
             free(p->framebuf);
+        if (p->shadow_buf != NULL)
+            free(p->shadow_buf);
         free(p);
     }
 
-    close(p->socket);
-
     drvthis->store_private_ptr(drvthis, NULL);
 }
 
@@ -214,12 +252,14 @@ MODULE_EXPORT void irtrans_clear(Driver *drvthis)
 //////////////////////////////////////////////////////////////////
 // Flushes all output to the lcd...
 //
+// A frame the socket did not take at once is sent before any newer one;
+// the newest frame follows once it is out, from here or from get_key.
 MODULE_EXPORT void irtrans_flush(Driver *drvthis)
 {
     PrivateData *p = drvthis->private_data;
 
-    LCDCOMMAND buf;
-    STATUSBUFFER stat;
+    if (irtrans_drain(drvthis) != 0)
+        return;
 
     if (!memcmp(p->shadow_buf, p->framebuf, p->width * p->height))
         return;
@@ -227,19 +267,20 @@ MODULE_EXPORT void irtrans_flush(Driver *drvthis)
     if ((time(0) - p->last_time) < p->timeout)
         return;
 
-    memcpy(buf.framebuffer, p->framebuf, p->width * p->height);
-    buf.wid = p->width;
-    buf.hgt = p->height;
+    memset(&p->out, 0, sizeof(p->out));
+    memcpy(p->out.framebuffer, p->framebuf, p->width * p->height);
+    p->out.wid = p->width;
+    p->out.hgt = p->height;
 
-    buf.netcommand = COMMAND_LCD;
-    buf.adress = 'L';
-    buf.lcdcommand = LCD_TEXT | p->backlight;
-    buf.protocol_version = IRTRANS_PROTOCOL_VERSION;
+    p->out.netcommand = COMMAND_LCD;
+    p->out.adress = 'L';
+    p->out.lcdcommand = LCD_TEXT | p->backlight;
+    p->out.protocol_version = IRTRANS_PROTOCOL_VERSION;
 
-    SendCommand(drvthis, &buf, &stat);  // Error Handling
+    p->out_left = sizeof(LCDCOMMAND);
     memcpy(p->shadow_buf, p->framebuf, p->width * p->height);
     p->last_time = time(0);
-
+    irtrans_drain(drvthis);
 }
 
 /////////////////////////////////////////////////////////////////
@@ -303,30 +344,119 @@ MODULE_EXPORT void irtrans_backlight(Driver *drvthis, int on)
     debug(RPT_DEBUG, "Backlight %s", (on) ? "ON" : "OFF");
 }
 
-int SendCommand(Driver *drvthis, LCDCOMMAND *com, STATUSBUFFER *stat)
+/////////////////////////////////////////////////////////////////
+// Reads the statuses the irserver sent, without waiting for any.
+// Replies to the frames sent are dropped; a code received from the
+// remote control is returned as a key, by its command name.
+//
+MODULE_EXPORT const char *irtrans_get_key(Driver *drvthis)
 {
     PrivateData *p = drvthis->private_data;
-    int res;
+    const char *key = NULL;
+    ssize_t n;
+
+    if (p->lost)
+        return NULL;
+
+    n = recv(p->socket, p->in + p->in_len, sizeof(p->in) - p->in_len,
+             MSG_DONTWAIT);
+    if ((n == 0) || ((n < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK)
+                     && (errno != EINTR))) {
+        irtrans_lost(drvthis, (n == 0) ? "closed by irserver" : strerror(errno));
+        return NULL;
+    }
+    if (n > 0)
+        p->in_len += n;
+
+    // Take the complete statuses, one key at a time
+    while ((key == NULL) && (p->in_len >= 8)) {
+        int16_t len, type;
+
+        memcpy(&len, p->in + offsetof(STATUSBUFFER, statuslen), sizeof(len));
+        memcpy(&type, p->in + offsetof(STATUSBUFFER, statustype), sizeof(type));
+        if ((len < 8) || (len > (int) sizeof(p->in))) {
+            irtrans_lost(drvthis, "bad status length");
+            return NULL;
+        }
+        if (p->in_len < len)
+            break;
+
+        if ((type == STATUS_RECEIVE)
+            && (len >= (int) offsetof(NETWORKRECV, data))) {
+            NETWORKRECV *rx = (NETWORKRECV *) p->in;
+            char remote[sizeof(rx->remote) + 1];
+
+            snprintf(remote, sizeof(remote), "%.*s",
+                     (int) sizeof(rx->remote), (char *) rx->remote);
+            snprintf(p->key, sizeof(p->key), "%.*s",
+                     (int) sizeof(rx->command), (char *) rx->command);
+            debug(RPT_DEBUG, "%s: received %s from %s", drvthis->name,
+                  p->key, remote);
+            if ((p->key[0] != '\0')
+                && ((p->remote[0] == '\0')
+                    || (strcasecmp(p->remote, remote) == 0)))
+                key = p->key;
+        }
+        p->in_len -= len;
+        memmove(p->in, p->in + len, p->in_len);
+    }
 
-    res = send(p->socket, (char *) com, sizeof(LCDCOMMAND), 0);
+    // Send the newest frame if it waited for the one before
+    if (p->out_left == 0)
+        irtrans_flush(drvthis);
+    else
+        irtrans_drain(drvthis);
 
-    if (res != sizeof(LCDCOMMAND)) {
-        close(p->socket);
-        return (ERR_SEND);
-    }
+    return key;
+}
 
-    memset(stat, 0, sizeof(STATUSBUFFER));
-
-    do {
-        res = recv(p->socket, (char *) stat, 8, 0);
-        if (stat->statuslen > 8) {
-            res =
-                recv(p->socket, ((char *) stat) + 8, stat->statuslen - 8,
-                     0);
-        } else
-            return (0);
-    } while (stat->statustype == STATUS_RECEIVE);
-    return (0);
+/////////////////////////////////////////////////////////////////
+// Returns the socket the server watches for keys
+//
+MODULE_EXPORT int irtrans_get_key_fd(Driver *drvthis)
+{
+    PrivateData *p = drvthis->private_data;
+
+    return p->socket;
+}
+
+// Gives up the connection; the server closes the driver and connects
+// again.
+static void irtrans_lost(Driver *drvthis, const char *why)
+{
+    PrivateData *p = drvthis->private_data;
+
+    report(RPT_ERR, "%s: connection to irserver lost: %s", drvthis->name,
+           why);
+    p->lost = 1;
+    p->out_left = 0;
+    drvthis->lost_device(drvthis);
+}
+
+// Sends what the socket did not take of the last frame.  Returns 0 when
+// all of it is sent, 1 while some is left and -1 when the connection is
+// gone.
+static int irtrans_drain(Driver *drvthis)
+{
+    PrivateData *p = drvthis->private_data;
+    ssize_t n;
+
+    if (p->lost)
+        return -1;
+    if (p->out_left == 0)
+        return 0;
+
+    n = send(p->socket,
+             (char *) &p->out + sizeof(LCDCOMMAND) - p->out_left,
+             p->out_left, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0) {
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+            return 1;
+        irtrans_lost(drvthis, strerror(errno));
+        return -1;
+    }
+    p->out_left -= n;
+    return (p->out_left > 0) ? 1 : 0;
 }
 
 int InitClientSocket(char host[], SOCKET *sock, unsigned long id)
@@ -335,6 +465,7 @@ int InitClientSocket(char host[], SOCKET *sock, unsigned long id)
     unsigned long adr;
     struct hostent *he;
     struct in_addr addr;
+    int on = 1;
 
     adr = inet_addr(host);
     if (adr == INADDR_NONE) {
@@ -355,9 +486,13 @@ int InitClientSocket(char host[], SOCKET *sock, unsigned long id)
     serv_addr.sin_addr.s_addr = adr;
     serv_addr.sin_port = htons(TCP_PORT);
 
-    if (connect(*sock, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) <
-        0)
+    if ((connect(*sock, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0)
+        || (send(*sock, (char *) &id, 4, 0) != 4)) {
+        close(*sock);
+        *sock = -1;
         return (ERR_CONNECT);
-    send(*sock, (char *) &id, 4, 0);
+    }
+    // Every frame is due now
+    setsockopt(*sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
     return (0);
 }
@@ -42,6 +42,8 @@ MODULE_EXPORT void irtrans_string(Driver *drvthis, int x, int y,
 MODULE_EXPORT void irtrans_chr(Driver * drvthis, int x, int y, char c);
 MODULE_EXPORT void irtrans_set_contrast(Driver *drvthis, int promille);
 MODULE_EXPORT void irtrans_backlight(Driver *drvthis, int on);
+MODULE_EXPORT const char *irtrans_get_key(Driver *drvthis);
+MODULE_EXPORT int irtrans_get_key_fd(Driver *drvthis);
 
 typedef int SOCKET;
 typedef int WSAEVENT;
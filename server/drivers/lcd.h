@@ -116,6 +116,40 @@ typedef enum {
 	bignum,			/* big numbers */
 } CGmode;
 
+/* Part of a line that changed since the previous frame (see flush_spans) */
+typedef struct lcd_span {
+	int x, y;		/* first changed position (1-based) */
+	int len;		/* number of characters from there */
+} LCDSpan;
+
+/* Rectangle of character positions (see blit_text, scroll_text) */
+typedef struct lcd_rect {
+	int x, y;		/* top left position (1-based) */
+	int width, height;	/* size in characters */
+} LCDRect;
+
+/* Capabilities of a driver (see caps); the server core finds them from the
+ * functions of the driver, which may drop some of them in its init function */
+#define DRV_CAP_VBAR		0x0001	/* native vertical bars */
+#define DRV_CAP_HBAR		0x0002	/* native horizontal bars */
+#define DRV_CAP_PBAR		0x0004	/* native percentage bars */
+#define DRV_CAP_NUM		0x0008	/* native big numbers */
+#define DRV_CAP_HEARTBEAT	0x0010	/* native heartbeat */
+#define DRV_CAP_ICON		0x0020	/* native icons */
+#define DRV_CAP_CURSOR		0x0040	/* native cursor */
+#define DRV_CAP_FLUSH_SPANS	0x0080	/* flushes the changed spans only */
+#define DRV_CAP_BLIT_TEXT	0x0100	/* takes the text of a frame at once */
+#define DRV_CAP_THREADED	0x0200	/* flushed by a thread of its own */
+#define DRV_CAP_SCROLL_TEXT	0x0400	/* moves text in hardware */
+
+/* I/O counters of a driver (see count_io), shown by the server's statistics */
+#define IO_BYTES		0	/* bytes written to the device */
+#define IO_CHARS		1	/* characters written to the display */
+#define IO_CGRAM		2	/* custom characters uploaded */
+#define IO_ERRORS		3	/* failed reads and writes */
+#define IO_WRITES		4	/* writes, transfers or datagrams sent */
+#define IO_COUNTERS		5	/* number of counters */
+
 /* What does the shared module handle look like on the current platform? */
 #define MODULE_HANDLE void*
 
@@ -179,6 +213,27 @@ typedef struct lcd_logical_driver {
 	/* informational functions */
 	const char * (*get_info) (struct lcd_logical_driver *drvthis);
 
+	/* optional replacement for flush: only send the spans that changed */
+	void (*flush_spans)	(struct lcd_logical_driver *drvthis, const LCDSpan *spans, int count);
+
+	/* optional bulk replacement for string: write a block of characters,
+	 * row r of it starting at buf + r * stride */
+	void (*blit_text)	(struct lcd_logical_driver *drvthis, const unsigned char *buf, int stride, const LCDRect *rect);
+
+	/* optional for input drivers: descriptor that becomes readable when
+	 * get_key() has keys, or -1 while get_key() has to be polled */
+	int (*get_key_fd)	(struct lcd_logical_driver *drvthis);
+
+	/* optional: move the characters inside rect shift columns (< 0: to
+	 * the left) on the display itself, before the frame is flushed;
+	 * returns 0 if done, so only the cells moved in need to be sent */
+	int (*scroll_text)	(struct lcd_logical_driver *drvthis, const LCDRect *rect, int shift);
+
+	/* optional for input drivers: like get_key(), which is still needed,
+	 * but also stores when the key was pressed, by clock() below; the
+	 * core then uses it instead of get_key() */
+	const char *(*get_key_event) (struct lcd_logical_driver *drvthis, unsigned long *when);
+
 
 	/******** Variables in server core available for drivers ********/
 
@@ -192,6 +247,8 @@ typedef struct lcd_logical_driver {
 				   Driver should cast this to it's own
 				   private structure pointer */
 
+	unsigned int caps;	/* Capabilities (DRV_CAP_*), set before init */
+
 
 	/******** Functions in server core available for drivers ********/
 
@@ -212,6 +269,33 @@ typedef struct lcd_logical_driver {
 	int (*request_display_width) ();
 	int (*request_display_height) ();
 
+	/* Tell the server the device is gone (e.g. unplugged). The server
+	 * stops using the driver, and calls close() and init() again
+	 * until the device is back. */
+	void (*lost_device) (struct lcd_logical_driver *drvthis);
+
+	/* Tell the server the device goes on being busy for usecs after the
+	 * current flush returns, e.g. while a slow serial line transmits
+	 * what flush() wrote. Flushes until then are skipped, the frames
+	 * merged: the next flush shows the latest one. */
+	void (*flush_busy) (struct lcd_logical_driver *drvthis, int usecs);
+
+	/* Add n to one of the driver's I/O counters (IO_*). Called from
+	 * the driver's functions only. */
+	void (*count_io) (struct lcd_logical_driver *drvthis, int counter, long n);
+
+	/* The server's clock in microseconds, for the times of
+	 * get_key_event(). */
+	unsigned long (*clock) (void);
+
+	/* Keep the driver's state over a restart of the server, e.g. what
+	 * the display shows, so it need not reset and clear the display.
+	 * save_state() keeps it when called from close() as the server
+	 * exits; load_state() gets it back in init() after the next start
+	 * and returns its size, 0 if there is none. */
+	int (*save_state) (struct lcd_logical_driver *drvthis, const void *data, int size);
+	int (*load_state) (struct lcd_logical_driver *drvthis, void *data, int size);
+
 } Driver;
 
 #endif
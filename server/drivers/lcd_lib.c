@@ -5,12 +5,49 @@
  * to this library.
  */
 
+#include <string.h>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+# include <arm_neon.h>
+#endif
+
 #include "lcd.h"
+#include "lcd_lib.h"
 
 #ifdef HAVE_CONFIG_H
 # include "config.h"
 #endif
 
+/**
+ * Work out which cells of a bar are filled, without looking at each cell:
+ * the first \c full cells are filled completely, and if the bar does not
+ * end there the next cell shows \c partial pixels (0 for an empty cell).
+ * The split is the same lib_hbar_static() and lib_vbar_static() draw.
+ * \param len       Length of the bar at 100% in cells.
+ * \param promille  Current fill level in promille.
+ * \param cellsize  Pixels per cell in the bar's direction.
+ * \param full      Receives the number of completely filled cells.
+ * \param partial   Receives the pixels of the cell behind them.
+ */
+void
+lib_bar_plan (int len, int promille, int cellsize, int *full, int *partial)
+{
+	int total_pixels = ((long) 2 * len * cellsize + 1 ) * promille / 2000;
+
+	*full = 0;
+	*partial = 0;
+	if ((total_pixels <= 0) || (len <= 0) || (cellsize <= 0))
+		return;
+
+	*full = total_pixels / cellsize;
+	if (*full >= len)
+		*full = len;
+	else
+		*partial = total_pixels - cellsize * *full;
+}
+
 /**
  * This function places a hbar using the v0.5 API format and the given cellwidth.
  * It assumes that custom chars have been statically defined, so that number
@@ -22,29 +59,23 @@
 void
 lib_hbar_static (Driver *drvthis, int x, int y, int len, int promille, int options, int cellwidth, int cc_offset)
 {
-	int total_pixels  = ((long) 2 * len * cellwidth + 1 ) * promille / 2000;
+	int full, partial;
 	int pos;
 
-	for (pos = 0; pos < len; pos ++ ) {
-
-		int pixels = total_pixels - cellwidth * pos;
+	lib_bar_plan(len, promille, cellwidth, &full, &partial);
 
-		if ( pixels >= cellwidth ) {
-			/* write a "full" block to the screen... */
-			if ( options & BAR_SEAMLESS )
-				drvthis->chr (drvthis, x+pos, y, cellwidth + cc_offset);
-			else
-				drvthis->icon (drvthis, x+pos, y, ICON_BLOCK_FILLED);
-		}
-		else if ( pixels > 0 ) {
-			/* write a partial block... */
-			drvthis->chr (drvthis, x+pos, y, pixels + cc_offset);
-			break;
-		}
-		else {
-			; /* write nothing (not even a space) */
-		}
+	for (pos = 0; pos < full; pos ++ ) {
+		/* write a "full" block to the screen... */
+		if ( options & BAR_SEAMLESS )
+			drvthis->chr (drvthis, x+pos, y, cellwidth + cc_offset);
+		else
+			drvthis->icon (drvthis, x+pos, y, ICON_BLOCK_FILLED);
 	}
+	if ( partial > 0 ) {
+		/* write a partial block... */
+		drvthis->chr (drvthis, x+full, y, partial + cc_offset);
+	}
+	/* the rest of the bar stays untouched (not even a space) */
 }
 
 /**
@@ -58,24 +89,224 @@ lib_hbar_static (Driver *drvthis, int x, int y, int len, int promille, int optio
 void
 lib_vbar_static (Driver *drvthis, int x, int y, int len, int promille, int options, int cellheight, int cc_offset)
 {
-	int total_pixels = ((long) 2 * len * cellheight + 1 ) * promille / 2000;
+	int full, partial;
 	int pos;
 
-	for (pos = 0; pos < len; pos ++ ) {
+	lib_bar_plan(len, promille, cellheight, &full, &partial);
 
-		int pixels = total_pixels - cellheight * pos;
+	for (pos = 0; pos < full; pos ++ ) {
+		/* write a "full" block to the screen... */
+		drvthis->icon (drvthis, x, y-pos, ICON_BLOCK_FILLED);
+	}
+	if ( partial > 0 ) {
+		/* write a partial block... */
+		drvthis->chr (drvthis, x, y-full, partial + cc_offset);
+	}
+	/* the rest of the bar stays untouched (not even a space) */
+}
 
-		if ( pixels >= cellheight ) {
-			/* write a "full" block to the screen... */
-			drvthis->icon (drvthis, x, y-pos, ICON_BLOCK_FILLED);
-		}
-		else if ( pixels > 0 ) {
-			/* write a partial block... */
-			drvthis->chr (drvthis, x, y-pos, pixels + cc_offset);
-			break;
-		}
-		else {
-			; /* write nothing (not even a space) */
+/**
+ * Set up a custom character cache with all characters undefined.
+ * \param cache  The cache.
+ * \param slots  Number of custom characters of the display.
+ * \param rows   Pixel rows per character.
+ */
+void
+lib_cc_init (CharCache *cache, int slots, int rows)
+{
+	memset(cache, 0, sizeof(CharCache));
+	cache->slots = (slots < LIB_CC_MAX) ? slots : LIB_CC_MAX;
+	cache->rows = (rows < LIB_CC_ROWS) ? rows : LIB_CC_ROWS;
+	cache->frame = 1;
+}
+
+/**
+ * Start a new frame: the characters of the previous one may be reused for
+ * other glyphs from now on. Drivers call this when the screen is cleared.
+ * \param cache  The cache.
+ */
+void
+lib_cc_frame (CharCache *cache)
+{
+	cache->frame++;
+	memset(cache->refs, 0, sizeof(cache->refs));
+}
+
+/**
+ * Get a custom character showing a glyph. If no character shows it yet,
+ * the one not used for the longest time is taken, as long as it is not
+ * used in the current frame.
+ * \param cache   The cache.
+ * \param glyph   Pixel rows of the glyph, as the display stores them.
+ * \param define  Set to 1 if the driver has to define the character
+ *                with the glyph, 0 if it already shows it.
+ * \return  Number of the character; -1 if all are used in this frame.
+ */
+int
+lib_cc_alloc (CharCache *cache, const unsigned char *glyph, int *define)
+{
+	int victim = -1;
+	int n;
+
+	*define = 0;
+	for (n = 0; n < cache->slots; n++) {
+		if ((cache->used[n] != 0)
+		    && (memcmp(cache->glyph[n], glyph, cache->rows) == 0)) {
+			cache->used[n] = cache->frame;
+			cache->refs[n]++;
+			return n;
 		}
+		if ((cache->refs[n] == 0)
+		    && ((victim < 0) || (cache->used[n] < cache->used[victim])))
+			victim = n;
+	}
+	if (victim < 0)
+		return -1;
+
+	lib_cc_set(cache, victim, glyph);
+	*define = 1;
+	return victim;
+}
+
+/**
+ * Record that a driver defined a character with a glyph of its own choice,
+ * e.g. for big numbers. The character counts as used in the current frame.
+ * \param cache  The cache.
+ * \param n      Number of the character.
+ * \param glyph  Pixel rows of the glyph, as the display stores them.
+ */
+void
+lib_cc_set (CharCache *cache, int n, const unsigned char *glyph)
+{
+	if ((n < 0) || (n >= cache->slots))
+		return;
+
+	memcpy(cache->glyph[n], glyph, cache->rows);
+	cache->used[n] = cache->frame;
+	cache->refs[n]++;
+}
+
+/**
+ * Tell whether a character already shows a glyph, for drivers that define
+ * characters at fixed numbers: they skip sending a definition the display
+ * already has. If the character shows another glyph, it is recorded as
+ * showing this one from now on.
+ * \param cache  The cache.
+ * \param n      Number of the character.
+ * \param glyph  Pixel rows of the glyph, as they are sent to the display.
+ * \return  1 if the character already shows the glyph, 0 if the driver
+ *          has to define it.
+ */
+int
+lib_cc_resident (CharCache *cache, int n, const unsigned char *glyph)
+{
+	if ((n < 0) || (n >= cache->slots))
+		return 0;
+
+	if ((cache->used[n] != 0)
+	    && (memcmp(cache->glyph[n], glyph, cache->rows) == 0)) {
+		cache->used[n] = cache->frame;
+		return 1;
+	}
+	lib_cc_set(cache, n, glyph);
+	return 0;
+}
+
+/*
+ * Comparing frame buffer and backing store: a block of LIB_DIFF_BLOCK
+ * bytes is compared at once, with SSE2 on x86 (part of every x86-64 CPU)
+ * and NEON on 64 bit ARM, or as two machine words elsewhere. Only within
+ * a block that differs the bytes are looked at one by one.
+ */
+#define LIB_DIFF_BLOCK	16
+
+/* Tell whether the LIB_DIFF_BLOCK bytes at a and b are the same */
+static inline int
+lib_diff_block_same (const unsigned char *a, const unsigned char *b)
+{
+#if defined(__SSE2__)
+	__m128i va = _mm_loadu_si128((const __m128i *) a);
+	__m128i vb = _mm_loadu_si128((const __m128i *) b);
+
+	return (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) == 0xFFFF);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	return (vminvq_u8(vceqq_u8(vld1q_u8(a), vld1q_u8(b))) == 0xFF);
+#else
+	unsigned long wa[LIB_DIFF_BLOCK / sizeof(unsigned long)];
+	unsigned long wb[LIB_DIFF_BLOCK / sizeof(unsigned long)];
+	unsigned long d = 0;
+	unsigned int i;
+
+	memcpy(wa, a, LIB_DIFF_BLOCK);
+	memcpy(wb, b, LIB_DIFF_BLOCK);
+	for (i = 0; i < LIB_DIFF_BLOCK / sizeof(unsigned long); i++)
+		d |= wa[i] ^ wb[i];
+	return (d == 0);
+#endif
+}
+
+/**
+ * Find the first byte that differs between two buffers, e.g. a line of
+ * the frame buffer and of the backing store.
+ * \param a    One buffer.
+ * \param b    The other buffer.
+ * \param len  Number of bytes to compare.
+ * \return  Offset of the first byte that differs; -1 if none does.
+ */
+int
+lib_diff_first (const unsigned char *a, const unsigned char *b, int len)
+{
+	int i = 0;
+
+	while ((i + LIB_DIFF_BLOCK <= len) && lib_diff_block_same(a + i, b + i))
+		i += LIB_DIFF_BLOCK;
+	for (; i < len; i++) {
+		if (a[i] != b[i])
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * Find the last byte that differs between two buffers.
+ * \param a    One buffer.
+ * \param b    The other buffer.
+ * \param len  Number of bytes to compare.
+ * \return  Offset of the last byte that differs; -1 if none does.
+ */
+int
+lib_diff_last (const unsigned char *a, const unsigned char *b, int len)
+{
+	int i = len;
+
+	while ((i >= LIB_DIFF_BLOCK) && lib_diff_block_same(a + i - LIB_DIFF_BLOCK, b + i - LIB_DIFF_BLOCK))
+		i -= LIB_DIFF_BLOCK;
+	for (i--; i >= 0; i--) {
+		if (a[i] != b[i])
+			return i;
 	}
+	return -1;
+}
+
+/**
+ * Find the part of two buffers that differs, from the first to the last
+ * byte that is not the same in both.
+ * \param a      One buffer.
+ * \param b      The other buffer.
+ * \param len    Number of bytes to compare.
+ * \param first  Receives the offset of the first byte that differs.
+ * \param last   Receives the offset of the last byte that differs.
+ * \return  1 if the buffers differ, 0 if they are the same (and
+ *          \c first and \c last are left alone).
+ */
+int
+lib_diff_span (const unsigned char *a, const unsigned char *b, int len, int *first, int *last)
+{
+	int f = lib_diff_first(a, b, len);
+
+	if (f < 0)
+		return 0;
+	*first = f;
+	*last = f + lib_diff_last(a + f, b + f, len - f);
+	return 1;
 }
@@ -5,6 +5,38 @@
 #include "lcd.h"
 #endif
 
+/** Most custom characters a CharCache manages */
+#define LIB_CC_MAX	16
+/** Most pixel rows of a custom character */
+#define LIB_CC_ROWS	8
+
+/**
+ * Cache of the custom characters defined on a display. Drivers ask it
+ * for a character showing a glyph instead of defining fixed character
+ * numbers: a glyph that is already defined is reused, another one takes
+ * the character unused for the longest time. Characters used in the
+ * current frame are never taken away.
+ */
+typedef struct lib_char_cache {
+	int slots;				/**< Number of custom characters */
+	int rows;				/**< Pixel rows per character */
+	unsigned long frame;			/**< Number of the current frame */
+	unsigned char glyph[LIB_CC_MAX][LIB_CC_ROWS];	/**< Defined glyphs */
+	unsigned long used[LIB_CC_MAX];		/**< Frame of last use; 0 = undefined */
+	int refs[LIB_CC_MAX];			/**< Uses in the current frame */
+} CharCache;
+
+void lib_cc_init (CharCache *cache, int slots, int rows);
+void lib_cc_frame (CharCache *cache);
+int lib_cc_alloc (CharCache *cache, const unsigned char *glyph, int *define);
+void lib_cc_set (CharCache *cache, int n, const unsigned char *glyph);
+int lib_cc_resident (CharCache *cache, int n, const unsigned char *glyph);
+
+int lib_diff_first (const unsigned char *a, const unsigned char *b, int len);
+int lib_diff_last (const unsigned char *a, const unsigned char *b, int len);
+int lib_diff_span (const unsigned char *a, const unsigned char *b, int len, int *first, int *last);
+
+void lib_bar_plan (int len, int promille, int cellsize, int *full, int *partial);
 void lib_hbar_static (Driver *drvthis, int x, int y, int len, int promille, int options, int cellwidth, int cc_offset);
 void lib_vbar_static (Driver *drvthis, int x, int y, int len, int promille, int options, int cellheight, int cc_offset);
 
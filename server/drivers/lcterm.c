@@ -31,7 +31,6 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <termios.h>
-#include <fcntl.h>
 #include <string.h>
 #include <errno.h>
 
@@ -42,6 +41,7 @@
 #include "lcd.h"
 #include "lcd_lib.h"
 #include "lcterm.h"
+#include "serial_lib.h"
 #include "shared/report.h"
 #include "adv_bignum.h"
 
@@ -54,7 +54,7 @@ typedef struct lcterm_private_data {
   unsigned char *last_framebuf;	/**< old frame buffer contents */
   int width;		/**< display width in characters */
   int height;		/**< display height in characters */
-  int fd;		/**< handle to the device */
+  SerialPort serial;	/**< port of the device */
 } PrivateData;
 
 
@@ -76,8 +76,6 @@ MODULE_EXPORT int
 lcterm_init (Driver *drvthis)
 {
   char device[200];
-  int speed=B9600;
-  struct termios portset;
   PrivateData *p;
 
   debug(RPT_INFO, "LCTERM: init(%p)", drvthis);
@@ -90,7 +88,7 @@ lcterm_init (Driver *drvthis)
     return -1;
 
   // initialize private data
-  p->fd = -1;
+  p->serial.fd = -1;
   p->ccmode = p->last_ccmode = standard;
 
   // READ CONFIG FILE:
@@ -131,8 +129,7 @@ lcterm_init (Driver *drvthis)
 
   // Set up io port correctly, and open it...
   debug(RPT_DEBUG, "%s: Opening serial device: %s", drvthis->name, device);
-  p->fd = open(device, O_RDWR | O_NOCTTY | O_NDELAY);
-  if (p->fd == -1) {
+  if (lib_serial_open(&p->serial, device, 9600, 0) < 0) {
     report(RPT_ERR, "%s: open(%) failed (%s)", drvthis->name, device, strerror(errno));
     if (errno == EACCES)
 	report(RPT_ERR, "%s: make sure you have rw access to %s!", drvthis->name, device);
@@ -140,26 +137,11 @@ lcterm_init (Driver *drvthis)
   }
   report(RPT_INFO, "%s: opened display on %s", drvthis->name, device);
 
-  tcgetattr(p->fd, &portset);
-#ifdef HAVE_CFMAKERAW
-  /* The easy way: */
-  cfmakeraw(&portset);
-#else
-  /* The hard way: */
-  portset.c_iflag &= ~( IGNBRK | BRKINT | PARMRK | ISTRIP
-			| INLCR | IGNCR | ICRNL | IXON );
-  portset.c_oflag &= ~OPOST;
-  portset.c_lflag &= ~( ECHO | ECHONL | ICANON | ISIG | IEXTEN );
-  portset.c_cflag &= ~( CSIZE | PARENB | CRTSCTS );
-  portset.c_cflag |= CS8 | CREAD | CLOCAL ;
-#endif
-  cfsetospeed(&portset, speed);
-  cfsetispeed(&portset, speed);
-  tcsetattr(p->fd, TCSANOW, &portset);
-  tcflush(p->fd, TCIOFLUSH);
+  tcflush(p->serial.fd, TCIOFLUSH);
 
   // clear the display, disable cursor, disable key scanning
-  write(p->fd, "\x1a\x16\x1bK", 4);
+  lib_serial_write(&p->serial, "\x1a\x16\x1bK", 4);
+  lib_serial_flush(drvthis, &p->serial);
 
   report(RPT_DEBUG, "%s: init() done", drvthis->name);
 
@@ -183,10 +165,8 @@ lcterm_close (Driver *drvthis)
       free(p->last_framebuf);
 
     // clear the display, disable key scanning
-    if (p->fd >= 0) {
-      write(p->fd, "\x1a\x1bK", 3);
-      close(p->fd);
-    }
+    lib_serial_write(&p->serial, "\x1a\x1bK", 3);
+    lib_serial_close(&p->serial);
 
     free(p);
   }
@@ -248,8 +228,11 @@ lcterm_flush (Driver *drvthis)
   int i, line;
   unsigned char *buf, *sp, *dp, c;
 
-  if (memcmp(p->framebuf, p->last_framebuf, p->width * p->height) == 0)
+  if (memcmp(p->framebuf, p->last_framebuf, p->width * p->height) == 0) {
+    // there may be custom characters, or bytes left from the last frame
+    lib_serial_flush(drvthis, &p->serial);
     return;
+  }
 
   buf = alloca(p->width * p->height * 2 + 5); /* worst case: we need to
 						 escape *every* character */
@@ -269,7 +252,8 @@ lcterm_flush (Driver *drvthis)
     *dp++ = 0x0a;
     *dp++ = 0x0d;
   }
-  write(p->fd, buf, dp-buf);
+  lib_serial_write(&p->serial, buf, dp-buf);
+  lib_serial_flush(drvthis, &p->serial);
   memcpy(p->last_framebuf, p->framebuf, p->width * p->height);
 }
 
@@ -351,7 +335,7 @@ lcterm_set_char (Driver *drvthis, int n, unsigned char *dat)
     buf[2+row] = data | 0x80;
   }
   buf[10] = 0x1E; // Cursor Home - exit CG-RAM mode
-  write(p->fd, buf, 11);
+  lib_serial_write(&p->serial, buf, 11);
 }
 
 
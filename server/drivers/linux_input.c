@@ -366,3 +366,17 @@ linuxInput_get_key (Driver *drvthis)
 
 	return retval;
 }
+
+/**
+ * Get the descriptor that becomes readable when keys arrive.
+ * \param drvthis  Pointer to driver structure.
+ * \retval         Descriptor of the input device;
+ *                 -1 while the device is lost and searched for.
+ */
+MODULE_EXPORT int
+linuxInput_get_key_fd (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	return p->fd;
+}
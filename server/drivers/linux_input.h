@@ -7,5 +7,6 @@ MODULE_EXPORT int  linuxInput_init (Driver *drvthis);
 MODULE_EXPORT void linuxInput_close (Driver *drvthis);
 
 MODULE_EXPORT const char *linuxInput_get_key (Driver *drvthis);
+MODULE_EXPORT int linuxInput_get_key_fd (Driver *drvthis);
 
 #endif
@@ -209,22 +209,46 @@ MODULE_EXPORT const char *
 lircin_get_key (Driver *drvthis)
 {
 	PrivateData * p = drvthis->private_data;
-
-	if (p->code == NULL) {
-		lirc_nextcode(&p->code);
-	}
-
-	char *cmd = NULL;
-	if (p->code != NULL) {
-		if (lirc_code2char(p->lircin_irconfig,p->code,&cmd)==0) {
-			if (cmd == NULL) {
-				free(p->code);
-				p->code = NULL;
-			} else {
-				report(RPT_DEBUG, "%s: \"%s\"", drvthis->name, cmd);
+	char *cmd;
+
+	/*
+	 * liblirc may have read several codes from the socket at once, so
+	 * go on until none is left: the server waits for the socket to become
+	 * readable before asking again.
+	 */
+	while (1) {
+		if (p->code == NULL) {
+			if (lirc_nextcode(&p->code) != 0) {
+				report(RPT_ERR, "%s: connection to lircd lost", drvthis->name);
+				drvthis->lost_device(drvthis);
+				return NULL;
 			}
+			if (p->code == NULL)
+				return NULL;
+		}
+
+		cmd = NULL;
+		if ((lirc_code2char(p->lircin_irconfig, p->code, &cmd) == 0) && (cmd != NULL)) {
+			report(RPT_DEBUG, "%s: \"%s\"", drvthis->name, cmd);
+			return cmd;
 		}
+
+		/* all commands for this code are done, or it has none */
+		free(p->code);
+		p->code = NULL;
 	}
+}
+
+
+/**
+ * Get the descriptor that becomes readable when keys arrive.
+ * \param drvthis  Pointer to driver structure.
+ * \return         The socket connected to lircd.
+ */
+MODULE_EXPORT int
+lircin_get_key_fd (Driver *drvthis)
+{
+	PrivateData * p = drvthis->private_data;
 
-	return cmd;
+	return p->lircin_fd;
 }
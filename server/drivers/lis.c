@@ -44,6 +44,7 @@
 #include <ftdi.h>
 
 #include "lcd.h"
+#include "ring_lib.h"
 #include "lis.h"
 #include "shared/report.h"
 #include "lcd_lib.h"
@@ -144,30 +145,32 @@ lis_standard_custom_chars (Driver *drvthis)
 }
 
 /**
- * Write a command to the display.
+ * Queue a command for the display. The I/O thread writes it and gives the
+ * display the time to process it, so the server does not wait for it.
  *
  * \param drvthis  Pointer to Driver
  * \param data     Data bytes
  * \param length   The number of bytes in data which are valid
- * \return 0 on success, negative value on error
+ * \return 0 on success, negative value if the queue is full or on error
  */
 static int
 lis_ftdi_write_command(Driver *drvthis, unsigned char *data, int length)
 {
 	PrivateData *p = (PrivateData *) drvthis->private_data;
-	int err;
+	LisCommand cmd;
 
-	err = ftdi_write_data(&p->ftdic, data, length);
-	if (err < 0) {
-		report(RPT_WARNING, "%s: ftdi_write_data failed with %d", drvthis->name, err);
+	if ((length <= 0) || (length > LIS_MAX_COMMAND))
+		return -EINVAL;
+
+	cmd.length = length;
+	memcpy(cmd.data, data, length);
+	if (lib_ring_put(&p->queue, &cmd) < 0) {
+		debug(RPT_DEBUG, "%s: write queue full", drvthis->name);
 		return -1;
 	}
 
-	timing_uPause(16000);
-
 	return 0;
 }
-
 /**
  * Displays a string at line n (n typically 1 or 2), starting in the first
  * column.
@@ -219,12 +222,13 @@ lis_flush(Driver *drvthis)
 	int line, err, i, count;
 	unsigned char buffer[65];
 
+	/* Nothing is marked clean until it is queued: what does not fit
+	 * into the queue is written with the next frame. */
+
 	// see if any custom characters changed
 	for (i = 0, count = 0; i < NUM_CCs; i++) {
-		if ( ! p->cc[i].clean ) {
+		if ( ! p->cc[i].clean )
 			count++;
-			p->cc[i].clean++;   // mark clean
-		}
 	}
 	if (count) {
 		// flush custom characters to device
@@ -233,49 +237,73 @@ lis_flush(Driver *drvthis)
 			memcpy(buffer + 1 + (i*CELLHEIGHT), p->cc[i].cache, CELLHEIGHT);
 		}
 		err = lis_ftdi_write_command(drvthis, buffer, sizeof(buffer));
-		if (err < 0) {
-			report(RPT_WARNING, "%s: lis_flush(): "
-				"lis_ftdi_write_command() failed", drvthis->name);
-		}
+		if (err < 0)
+			return;
+		for (i = 0; i < NUM_CCs; i++)
+			p->cc[i].clean = 1;	// mark clean
 		report(RPT_DEBUG, "Flushed %d custom chars that changed", count);
-		timing_uPause(16000);
 	}
 
 	// write any line that has a change in it
 	for (line = 0; line < p->height; line++) {
 		if (p->line_flags[line]) {
 			report(RPT_DEBUG, "Flushing line %d", line+1);
-			lis_ftdi_line_to_display(drvthis, line+1, p->framebuf + (line * p->width), p->width);
+			if (lis_ftdi_line_to_display(drvthis, line+1, p->framebuf + (line * p->width), p->width) < 0)
+				return;
 			p->line_flags[line] = 0;	// clean
-			timing_uPause(16000);
 		}
 	}
 }
 
 
 //////////////////////////////////////////////////////////////////////////////
-// Separate thread to keep a read up on the USB device at all times
-int
-lis_read_thread(void *arg)
+// Separate thread to keep a read up on the USB device at all times, and
+// to write the commands queued by the server
+static void *
+lis_io_thread(void *arg)
 {
 	Driver *drvthis;
 	PrivateData *p;
 	char unsigned buffer[64];
+	LisCommand cmd;
 	int size;
 
 	drvthis = (Driver *)arg;
 	p = (PrivateData *) drvthis->private_data;
 
-	while(! p->child_flag) {
+	for (;;) {
+		// the queue is emptied before stopping, for the goodbye screen
+		if (lib_ring_get(&p->queue, &cmd) == 0) {
+			size = ftdi_write_data(&p->ftdic, cmd.data, cmd.length);
+			if (size < 0)
+				report(RPT_WARNING, "%s: ftdi_write_data failed with %d",
+				       drvthis->name, size);
+			timing_uPause(16000);
+			continue;
+		}
+		if (__atomic_load_n(&p->stop, __ATOMIC_ACQUIRE))
+			break;
+
 		for (size = ftdi_read_data(&p->ftdic, buffer, 64); size > 0; size = ftdi_read_data(&p->ftdic, buffer, 64))
 			;
 		if (size < 0) {
-			p->parent_flag = 0;
-			return size;
+			report(RPT_ERR, "%s: ftdi_read_data failed with %d", drvthis->name, size);
+			break;
 		}
 	}
-	p->parent_flag = 0;
-	return 0;
+	return NULL;
+}
+
+
+/* Let the I/O thread write what is queued, and wait for it to end */
+static void
+lis_stop_thread(PrivateData *p)
+{
+	if (p->io_running) {
+		__atomic_store_n(&p->stop, 1, __ATOMIC_RELEASE);
+		pthread_join(p->io_thread, NULL);
+		p->io_running = 0;
+	}
 }
 
 /**
@@ -304,10 +332,10 @@ lis_set_brightness(Driver *drvthis, int state, int promille)
 	else
 		buffer[1] = 0x0;/* 100% */
 
-	err = ftdi_write_data(&p->ftdic, buffer, 2);
+	err = lis_ftdi_write_command(drvthis, buffer, 2);
 	if (err < 0) {
-		report(RPT_WARNING, "%s: lis_set_brightness(): ftdi_write_data failed with %d",
-		       drvthis->name, err);
+		report(RPT_WARNING, "%s: lis_set_brightness(): cannot queue the command",
+		       drvthis->name);
 		return err;
 	}
 	else
@@ -343,7 +371,6 @@ lis_init(Driver *drvthis)
 	const char *s;
 	unsigned char buffer[64];
 	int count;
-	pthread_t read_thread;
 
 	report(RPT_DEBUG, "%s: Initializing driver",
 		drvthis->name);
@@ -356,8 +383,9 @@ lis_init(Driver *drvthis)
 		return -1;
 	}
 
-	p->child_flag = 0;
-	p->parent_flag = 0;
+	p->io_running = 0;
+	p->stop = 0;
+	lib_ring_init(&p->queue, p->queued, LIS_QUEUE_SIZE, sizeof(LisCommand));
 	p->cellwidth = CELLWIDTH;
 	p->cellheight = CELLHEIGHT;
 
@@ -479,17 +507,13 @@ lis_init(Driver *drvthis)
 	}
 
 	// create a thread to keep a read up on the device
-	err = pthread_create(	&read_thread,
-				NULL,
-				(void *) lis_read_thread,
-				drvthis
-				);
+	err = pthread_create(&p->io_thread, NULL, lis_io_thread, drvthis);
 	if (err) {
 		report(RPT_ERR, "%s: pthread_create() - %s", drvthis->name, strerror(err));
 		goto err_framebuf;
 	}
-	report(RPT_INFO, "%s: read thread created");
-	p->parent_flag = 1;		// show we're now a happy parent, birth successful.
+	report(RPT_INFO, "%s: I/O thread created", drvthis->name);
+	p->io_running = 1;
 
 	// set communication parameters
 	err = ftdi_set_line_property(&p->ftdic, BITS_7, STOP_BIT_1, EVEN);
@@ -1120,6 +1144,7 @@ lis_init(Driver *drvthis)
 	return 0;
 
 err_ftdi:
+	lis_stop_thread(p);
 	ftdi_usb_close(&p->ftdic);
 	ftdi_deinit(&p->ftdic);
 	if(p->line_flags)
@@ -1127,12 +1152,7 @@ err_ftdi:
 err_framebuf:
 	free(p->framebuf);
 err_begin:
-
-	if (p->parent_flag) {			// terminate the child
-		p->child_flag = 1;
-		while(p->parent_flag)
-			timing_uPause(5*16000);
-	}
+	lis_stop_thread(p);
 	return -1;
 }
 
@@ -1146,11 +1166,7 @@ lis_close(Driver *drvthis)
 
 	report(RPT_DEBUG, "%s: closing driver", drvthis->name);
 	if (p != NULL) {
-		if (p->parent_flag) {	/* terminate the child */
-			p->child_flag = 1;
-			while(p->parent_flag)
-				timing_uPause(5*16000);
-		}
+		lis_stop_thread(p);
 		ftdi_usb_purge_buffers(&p->ftdic);
 		ftdi_usb_close(&p->ftdic);
 		ftdi_deinit(&p->ftdic);
@@ -23,6 +23,11 @@
 
 #define NUM_CCs 8
 
+/** Writes queued for the I/O thread; a power of 2 */
+#define LIS_QUEUE_SIZE 16
+/** Longest command: a line of up to LCD_MAX_WIDTH characters and 4 bytes */
+#define LIS_MAX_COMMAND (LCD_MAX_WIDTH + 4)
+
 
 /*------------------------ Private data types -----------------------------*/
 
@@ -32,6 +37,13 @@ typedef struct cgram_cache {
 } CGram;
 
 
+/** A write request for the I/O thread */
+typedef struct lis_command {
+	int length;
+	unsigned char data[LIS_MAX_COMMAND];
+} LisCommand;
+
+
 /** private data for the \c lis driver */
 typedef struct lis_private_data {
 	/* the handle for the USB FTDI library */
@@ -49,11 +61,16 @@ typedef struct lis_private_data {
 	/* dirty line flags */
 	unsigned int *line_flags;
 
-	/* child thread flag */
-	int child_flag;
+	/* thread reading from and writing to the device */
+	pthread_t io_thread;
+	int io_running;
+
+	/* tells the I/O thread to finish the queued writes and stop */
+	int stop;
 
-	/* parent thread flag */
-	int parent_flag;
+	/* writes handed from the server to the I/O thread */
+	LibRing queue;
+	LisCommand queued[LIS_QUEUE_SIZE];
 
 	/* display brightness 0-1000 */
 	int brightness;
@@ -42,6 +42,7 @@
 #define MDM166A_YSIZE 16
 #define MDM166A_SCREENSIZE MDM166A_XSIZE*MDM166A_YSIZE
 #define MDM166A_PACKEDSIZE 96*2
+#define MDM166A_REPORTSIZE 48	/**< packed bytes per pixel data report */
 
 #define WIDTH           16
 #define HEIGHT          2
@@ -67,6 +68,7 @@ typedef struct mdm166a_private_data {
 	bool offDimm;		/**< Brightness level on close */
 	unsigned char *framebuf;	/**< Pointer to internal framebuffer */
 	int changed;		/**< Indicator for framebuffer changes */
+	unsigned char sent[MDM166A_PACKEDSIZE];	/**< Packed data the display holds */
 	int last_output;	/**< Icon states after last update */
 	char info[255];		/**< Pointer to driver description */
 } PrivateData;
@@ -201,6 +203,7 @@ mdm166a_init(Driver *drvthis)
 	Cmd[2] = CMD_RESET;
 	hid_set_output_report(p->hid, PATH_OUT, sizeof(PATH_OUT), Cmd, 3);
 	p->last_output = 0;
+	/* the display RAM is clear now, like p->sent */
 
 	/* Set dimming */
 	Cmd[0] = 0x03;
@@ -365,6 +368,7 @@ mdm166a_flush(Driver *drvthis)
 	char Cmd[64];
 	int packed_begin = MDM166A_SCREENSIZE;
 	int xpos = 0, ypos = 0, i, j;
+	int next = -1;
 
 	if (!p->changed)
 		return;
@@ -385,26 +389,40 @@ mdm166a_flush(Driver *drvthis)
 			if (p->framebuf[ypos * MDM166A_XSIZE + xpos])
 				p->framebuf[packed_begin + (2 * xpos) + (ypos / 8)] |= (1 << (7 - (ypos % 8)));
 
-	/* Write data to display */
-	/* Set position (0,0) */
-	Cmd[0] = 0x03;
-	Cmd[1] = CMD_PREFIX;
-	Cmd[2] = CMD_SETRAM;
-	Cmd[3] = 0;
-	hid_set_output_report(p->hid, PATH_OUT, sizeof(PATH_OUT), Cmd, 4);
+	/*
+	 * Write data to display. It accepts max. 64 bytes at a time, so the
+	 * screen goes in 4 reports of 24 columns. Each one takes a few ms on
+	 * the USB, so only those that changed are sent; the RAM position is
+	 * set before the first of them and after one that was skipped.
+	 */
+	for (i = 0; i < MDM166A_PACKEDSIZE / MDM166A_REPORTSIZE; i++) {
+		unsigned char *packed = p->framebuf + packed_begin + i * MDM166A_REPORTSIZE;
 
-	/* Display accepts max. 64 bytes at a time -> Send 4 x 24 columns */
-	Cmd[0] = 51;
-	Cmd[1] = CMD_PREFIX;
-	Cmd[2] = CMD_SETPIXEL;
-	Cmd[3] = 48;
-	for (i = 0; i < 4; i++) {
-		for (j = 0; j < 24; j++) {
-			/* Copy two bytes in each step (= 48 bytes) */
-			Cmd[4 + 2 * j] = p->framebuf[packed_begin + i * 48 + 2 * j];
-			Cmd[5 + 2 * j] = p->framebuf[packed_begin + i * 48 + 2 * j + 1];
+		if (memcmp(packed, p->sent + i * MDM166A_REPORTSIZE, MDM166A_REPORTSIZE) == 0)
+			continue;
+
+		if (i != next) {
+			Cmd[0] = 0x03;
+			Cmd[1] = CMD_PREFIX;
+			Cmd[2] = CMD_SETRAM;
+			Cmd[3] = i * MDM166A_REPORTSIZE;
+			hid_set_output_report(p->hid, PATH_OUT, sizeof(PATH_OUT), Cmd, 4);
+			drvthis->count_io(drvthis, IO_BYTES, 4);
+			drvthis->count_io(drvthis, IO_WRITES, 1);
 		}
-		hid_set_output_report(p->hid, PATH_OUT, sizeof(PATH_OUT), Cmd, 52);
+
+		Cmd[0] = 51;
+		Cmd[1] = CMD_PREFIX;
+		Cmd[2] = CMD_SETPIXEL;
+		Cmd[3] = MDM166A_REPORTSIZE;
+		for (j = 0; j < MDM166A_REPORTSIZE; j++)
+			Cmd[4 + j] = packed[j];
+		hid_set_output_report(p->hid, PATH_OUT, sizeof(PATH_OUT), Cmd, 4 + MDM166A_REPORTSIZE);
+		drvthis->count_io(drvthis, IO_BYTES, 4 + MDM166A_REPORTSIZE);
+		drvthis->count_io(drvthis, IO_WRITES, 1);
+
+		memcpy(p->sent + i * MDM166A_REPORTSIZE, packed, MDM166A_REPORTSIZE);
+		next = i + 1;
 	}
 
 	p->changed = 0;
@@ -0,0 +1,926 @@
+/** \file server/drivers/netlcd.c
+ * LCDd \c netlcd driver, streaming the display to endpoints on the network.
+ *
+ * Each flush sends only the cells that changed since the last message, as
+ * runs of characters, over UDP or TCP. Messages carry sequence numbers, so
+ * a display notices a lost delta and waits for the next keyframe, which
+ * holds the whole frame; keyframes are sent periodically, when a delta
+ * would be bigger, and when a display asks for one. One datagram to a
+ * multicast or broadcast address drives any number of displays. The
+ * protocol is described in netlcd.h.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+
+#include "lcd.h"
+#include "lcd_lib.h"
+#include "netlcd.h"
+#include "adv_bignum.h"
+#include "shared/report.h"
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL	0	/* SIGPIPE is ignored by the server anyway */
+#endif
+
+#define NETLCD_CELLWIDTH	LCD_DEFAULT_CELLWIDTH
+#define NETLCD_CELLHEIGHT	LCD_DEFAULT_CELLHEIGHT
+
+/* Longest gap of unchanged cells a run of changes spans: a new run costs
+ * 3 bytes, so bridging up to 3 unchanged cells is never bigger */
+#define NETLCD_RUN_GAP		3
+#define NETLCD_MAX_RUN		255
+
+#define NETLCD_MAX_KEY		32
+
+/** private data for the \c netlcd driver */
+typedef struct netlcd_private_data {
+	int width;		/**< display width in characters */
+	int height;		/**< display height in characters */
+	char *framebuf;		/**< frame buffer */
+	char *sent;		/**< the frame the displays have been sent */
+	CGmode ccmode;		/**< custom character mode in use */
+	unsigned char cc[NETLCD_CUSTOM_CHARS][NETLCD_CELLHEIGHT];	/**< custom characters */
+	unsigned char cc_sent[NETLCD_CUSTOM_CHARS][NETLCD_CELLHEIGHT];	/**< custom characters sent */
+	int backlight;		/**< backlight state */
+	int backlight_sent;	/**< backlight state sent */
+
+	int sock;		/**< socket connected to the endpoint */
+	int tcp;		/**< the socket is a TCP stream */
+	unsigned long seq;	/**< sequence number of the last message */
+	int need_keyframe;	/**< a display asked for a keyframe */
+	int keyframe_interval;	/**< ms between keyframes; 0 for none */
+	unsigned long last_keyframe;	/**< time of the last keyframe in ms */
+
+	unsigned char *msg;	/**< message being built, 2 bytes in for the TCP length */
+	int keyframe_size;	/**< size of a keyframe message */
+	unsigned char *pending;	/**< TCP: part of the last message not written yet */
+	int pending_len;	/**< TCP: bytes in pending */
+	unsigned char in[2 + 2 + NETLCD_MAX_KEY];	/**< TCP: partial message received */
+	int in_len;		/**< TCP: bytes in in */
+	char key[NETLCD_MAX_KEY];	/**< last key received */
+} PrivateData;
+
+
+/* Vars for the server core */
+MODULE_EXPORT char *api_version = API_VERSION;
+MODULE_EXPORT int stay_in_foreground = 0;
+MODULE_EXPORT int supports_multiple = 1;
+MODULE_EXPORT char *symbol_prefix = "netlcd_";
+
+
+/* Current time in milliseconds; only differences are meaningful */
+static unsigned long
+netlcd_clock(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (unsigned long) tv.tv_sec * 1000UL + tv.tv_usec / 1000;
+}
+
+
+/* Resolve host and port, and connect a socket of the given type to the
+ * first address that takes it. Returns the socket or -1. */
+static int
+netlcd_connect(Driver *drvthis, const char *host, const char *port, int type)
+{
+	struct addrinfo hints, *res, *ap;
+	int status;
+	int fd = -1;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = type;
+	if ((status = getaddrinfo(host, port, &hints, &res)) != 0) {
+		report(RPT_ERR, "%s: getaddrinfo: %s (%s:%s)", drvthis->name, gai_strerror(status), host, port);
+		return -1;
+	}
+	for (ap = res; ap != NULL; ap = ap->ai_next) {
+		if ((fd = socket(ap->ai_family, ap->ai_socktype, ap->ai_protocol)) < 0)
+			continue;
+		if (type == SOCK_DGRAM) {
+			int on = 1;
+
+			/* in case Host is a broadcast address */
+			setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+#ifdef SO_TIMESTAMP
+			/* when keys arrived, for netlcd_get_key_event() */
+			setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on));
+#endif
+		}
+		if (connect(fd, ap->ai_addr, ap->ai_addrlen) == 0)
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+
+	if (fd < 0)
+		report(RPT_ERR, "%s: cannot connect to %s:%s: %s", drvthis->name, host, port, strerror(errno));
+	return fd;
+}
+
+
+/* Write what is left of the last TCP message. Returns 0 when all of it is
+ * written, 1 while some is still left and -1 when the connection is gone. */
+static int
+netlcd_drain(Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+	ssize_t n;
+
+	if (p->pending_len == 0)
+		return 0;
+
+	n = send(p->sock, p->pending, p->pending_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (n < 0) {
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+			return 1;
+		report(RPT_ERR, "%s: connection lost: %s", drvthis->name, strerror(errno));
+		p->pending_len = 0;
+		drvthis->count_io(drvthis, IO_ERRORS, 1);
+		drvthis->lost_device(drvthis);
+		return -1;
+	}
+	drvthis->count_io(drvthis, IO_BYTES, n);
+	drvthis->count_io(drvthis, IO_WRITES, 1);
+	p->pending_len -= n;
+	if (p->pending_len > 0) {
+		memmove(p->pending, p->pending + n, p->pending_len);
+		return 1;
+	}
+	return 0;
+}
+
+
+/* Send the message of len bytes built at p->msg + 2. A datagram that
+ * cannot be sent is lost like one lost on the way; the displays recover
+ * with the next keyframe. What the TCP stream does not take now is sent
+ * before the next message. */
+static void
+netlcd_send(Driver *drvthis, int len)
+{
+	PrivateData *p = drvthis->private_data;
+	ssize_t n;
+
+	if (!p->tcp) {
+		n = send(p->sock, p->msg + 2, len, MSG_DONTWAIT);
+		if (n < 0) {
+			debug(RPT_DEBUG, "%s: send: %s", drvthis->name, strerror(errno));
+			drvthis->count_io(drvthis, IO_ERRORS, 1);
+		}
+		else {
+			drvthis->count_io(drvthis, IO_BYTES, n);
+			drvthis->count_io(drvthis, IO_WRITES, 1);
+		}
+		return;
+	}
+
+	p->msg[0] = (len >> 8) & 0xFF;
+	p->msg[1] = len & 0xFF;
+	memcpy(p->pending, p->msg, len + 2);
+	p->pending_len = len + 2;
+	netlcd_drain(drvthis);
+}
+
+
+/* Start a message of the given type with the next sequence number.
+ * Returns the position after the header. */
+static int
+netlcd_header(PrivateData *p, int type)
+{
+	unsigned char *m = p->msg + 2;
+
+	p->seq++;
+	m[0] = NETLCD_VERSION;
+	m[1] = type;
+	m[2] = (p->seq >> 24) & 0xFF;
+	m[3] = (p->seq >> 16) & 0xFF;
+	m[4] = (p->seq >> 8) & 0xFF;
+	m[5] = p->seq & 0xFF;
+	m[6] = p->width;
+	m[7] = p->height;
+	m[8] = (p->backlight_sent == BACKLIGHT_ON) ? NETLCD_FLAG_BACKLIGHT : 0;
+	return NETLCD_HEADER_SIZE;
+}
+
+
+/* Send the frame the displays have been sent as a keyframe */
+static void
+netlcd_keyframe(Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+	int pos = netlcd_header(p, NETLCD_KEYFRAME);
+
+	memcpy(p->msg + 2 + pos, p->sent, p->width * p->height);
+	pos += p->width * p->height;
+	memcpy(p->msg + 2 + pos, p->cc_sent, sizeof(p->cc_sent));
+	pos += sizeof(p->cc_sent);
+	netlcd_send(drvthis, pos);
+
+	p->need_keyframe = 0;
+	p->last_keyframe = netlcd_clock();
+}
+
+
+/* Tell whether a keyframe is due */
+static int
+netlcd_keyframe_due(PrivateData *p)
+{
+	return p->need_keyframe
+	       || ((p->keyframe_interval > 0)
+		   && (netlcd_clock() - p->last_keyframe >= (unsigned long) p->keyframe_interval));
+}
+
+
+/**
+ * Initialize the driver.
+ * \param drvthis  Pointer to driver structure.
+ * \retval 0       Success.
+ * \retval <0      Error.
+ */
+MODULE_EXPORT int
+netlcd_init (Driver *drvthis)
+{
+	PrivateData *p;
+	char buf[256];
+	char host[256];
+	char port[16];
+	int size;
+
+	/* Allocate and store private data */
+	p = (PrivateData *) calloc(1, sizeof(PrivateData));
+	if (p == NULL)
+		return -1;
+	if (drvthis->store_private_ptr(drvthis, p))
+		return -1;
+
+	p->sock = -1;
+	p->ccmode = standard;
+	p->backlight = BACKLIGHT_ON;
+	p->backlight_sent = BACKLIGHT_ON;
+
+	/* Read display size from config file; the header has a byte for each */
+	strncpy(buf, drvthis->config_get_string(drvthis->name, "Size", 0, NETLCD_DEFAULT_SIZE), sizeof(buf));
+	buf[sizeof(buf)-1] = '\0';
+	if ((sscanf(buf, "%dx%d", &p->width, &p->height) != 2)
+	    || (p->width <= 0) || (p->width > LCD_MAX_WIDTH) || (p->width > 255)
+	    || (p->height <= 0) || (p->height > LCD_MAX_HEIGHT) || (p->height > 255)) {
+		report(RPT_WARNING, "%s: cannot read Size: %s; using default %s",
+				drvthis->name, buf, NETLCD_DEFAULT_SIZE);
+		sscanf(NETLCD_DEFAULT_SIZE, "%dx%d", &p->width, &p->height);
+	}
+
+	/* Where to send the frames to */
+	strncpy(host, drvthis->config_get_string(drvthis->name, "Host", 0, ""), sizeof(host));
+	host[sizeof(host)-1] = '\0';
+	if (host[0] == '\0') {
+		report(RPT_ERR, "%s: no Host given", drvthis->name);
+		return -1;
+	}
+	snprintf(port, sizeof(port), "%ld",
+		 drvthis->config_get_int(drvthis->name, "Port", 0, NETLCD_DEFAULT_PORT));
+
+	strncpy(buf, drvthis->config_get_string(drvthis->name, "Protocol", 0, "udp"), sizeof(buf));
+	buf[sizeof(buf)-1] = '\0';
+	if (strcasecmp(buf, "tcp") == 0)
+		p->tcp = 1;
+	else if (strcasecmp(buf, "udp") != 0) {
+		report(RPT_WARNING, "%s: unknown Protocol: %s; using udp", drvthis->name, buf);
+	}
+
+	/* A TCP stream loses nothing, so displays only need the first keyframe */
+	p->keyframe_interval = drvthis->config_get_int(drvthis->name, "KeyframeInterval", 0,
+						       p->tcp ? 0 : NETLCD_DEFAULT_KEYFRAME_UDP);
+	if (p->keyframe_interval < 0) {
+		report(RPT_WARNING, "%s: KeyframeInterval must be 0 or more; using 0", drvthis->name);
+		p->keyframe_interval = 0;
+	}
+
+	size = p->width * p->height;
+	p->framebuf = malloc(size);
+	p->sent = malloc(size);
+	/* big enough for a keyframe and for the custom characters of a
+	 * delta; runs are only added while the delta is smaller than a keyframe */
+	p->keyframe_size = NETLCD_HEADER_SIZE + size + sizeof(p->cc);
+	p->msg = malloc(2 + NETLCD_HEADER_SIZE + 1 + NETLCD_CUSTOM_CHARS * (1 + NETLCD_CELLHEIGHT) + size);
+	p->pending = malloc(2 + p->keyframe_size);
+	if ((p->framebuf == NULL) || (p->sent == NULL) || (p->msg == NULL) || (p->pending == NULL)) {
+		report(RPT_ERR, "%s: unable to create framebuffer", drvthis->name);
+		return -1;
+	}
+	memset(p->framebuf, ' ', size);
+	memset(p->sent, ' ', size);
+
+	p->sock = netlcd_connect(drvthis, host, port, p->tcp ? SOCK_STREAM : SOCK_DGRAM);
+	if (p->sock < 0)
+		return -1;
+	if (p->tcp) {
+		int on = 1;
+
+		/* every message is a frame that is due now */
+		setsockopt(p->sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	}
+	fcntl(p->sock, F_SETFL, fcntl(p->sock, F_GETFL) | O_NONBLOCK);
+
+	/* Show the empty screen */
+	netlcd_keyframe(drvthis);
+
+	report(RPT_INFO, "%s: sending to %s:%s over %s", drvthis->name, host, port, p->tcp ? "TCP" : "UDP");
+
+	return 0;
+}
+
+
+/**
+ * Close the driver (do necessary clean-up).
+ * \param drvthis  Pointer to driver structure.
+ */
+MODULE_EXPORT void
+netlcd_close (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	if (p != NULL) {
+		if (p->sock >= 0)
+			close(p->sock);
+
+		if (p->framebuf != NULL)
+			free(p->framebuf);
+		if (p->sent != NULL)
+			free(p->sent);
+		if (p->msg != NULL)
+			free(p->msg);
+		if (p->pending != NULL)
+			free(p->pending);
+
+		free(p);
+	}
+	drvthis->store_private_ptr(drvthis, NULL);
+}
+
+
+/**
+ * Return the display width in characters.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Number of characters the display is wide.
+ */
+MODULE_EXPORT int
+netlcd_width (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	return p->width;
+}
+
+
+/**
+ * Return the display height in characters.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Number of characters the display is high.
+ */
+MODULE_EXPORT int
+netlcd_height (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	return p->height;
+}
+
+
+/**
+ * Return the width of a character in pixels.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Number of pixel columns a character cell is wide.
+ */
+MODULE_EXPORT int
+netlcd_cellwidth (Driver *drvthis)
+{
+	return NETLCD_CELLWIDTH;
+}
+
+
+/**
+ * Return the height of a character in pixels.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Number of pixel lines a character cell is high.
+ */
+MODULE_EXPORT int
+netlcd_cellheight (Driver *drvthis)
+{
+	return NETLCD_CELLHEIGHT;
+}
+
+
+/**
+ * Clear the screen.
+ * \param drvthis  Pointer to driver structure.
+ */
+MODULE_EXPORT void
+netlcd_clear (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	memset(p->framebuf, ' ', p->width * p->height);
+	p->ccmode = standard;
+}
+
+
+/**
+ * Send what changed since the last message, or a keyframe if one is due
+ * or would be smaller. While a TCP connection has not taken the last
+ * message yet, frames are skipped; the next one sent holds their changes.
+ * \param drvthis  Pointer to driver structure.
+ */
+MODULE_EXPORT void
+netlcd_flush (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+	int size = p->width * p->height;
+	unsigned char *m = p->msg + 2;
+	int pos = 0, count_pos, changes = 0;
+	int i;
+
+	if (p->tcp && (netlcd_drain(drvthis) != 0))
+		return;
+
+	if (netlcd_keyframe_due(p))
+		goto keyframe;
+
+	/* the header tells the new backlight state */
+	if (p->backlight != p->backlight_sent) {
+		p->backlight_sent = p->backlight;
+		changes++;
+	}
+	pos = netlcd_header(p, NETLCD_DELTA);
+
+	/* changed custom characters */
+	count_pos = pos++;
+	m[count_pos] = 0;
+	for (i = 0; i < NETLCD_CUSTOM_CHARS; i++) {
+		if (memcmp(p->cc[i], p->cc_sent[i], NETLCD_CELLHEIGHT) != 0) {
+			m[pos++] = i;
+			memcpy(m + pos, p->cc[i], NETLCD_CELLHEIGHT);
+			pos += NETLCD_CELLHEIGHT;
+			m[count_pos]++;
+			changes++;
+		}
+	}
+	if (pos > p->keyframe_size)
+		goto keyframe;
+
+	/* runs of changed characters */
+	i = 0;
+	while (i < size) {
+		int start, end, j;
+
+		if (p->framebuf[i] == p->sent[i]) {
+			i++;
+			continue;
+		}
+		start = i;
+		end = i + 1;
+		for (j = end; (j < size) && (j < start + NETLCD_MAX_RUN); j++) {
+			if (p->framebuf[j] != p->sent[j])
+				end = j + 1;
+			else if (j + 1 - end > NETLCD_RUN_GAP)
+				break;
+		}
+
+		if (pos + 3 + (end - start) > p->keyframe_size)
+			goto keyframe;
+		m[pos++] = (start >> 8) & 0xFF;
+		m[pos++] = start & 0xFF;
+		m[pos++] = end - start;
+		memcpy(m + pos, p->framebuf + start, end - start);
+		pos += end - start;
+		changes++;
+		i = end;
+	}
+
+	if (changes == 0) {
+		/* nothing to send; give the number back */
+		p->seq--;
+		return;
+	}
+
+	memcpy(p->sent, p->framebuf, size);
+	memcpy(p->cc_sent, p->cc, sizeof(p->cc));
+	netlcd_send(drvthis, pos);
+	return;
+
+keyframe:
+	/* a delta that was started took a number; reuse it */
+	if (pos > 0)
+		p->seq--;
+	memcpy(p->sent, p->framebuf, size);
+	memcpy(p->cc_sent, p->cc, sizeof(p->cc));
+	p->backlight_sent = p->backlight;
+	netlcd_keyframe(drvthis);
+}
+
+
+/**
+ * Print a string on the screen at position (x,y).
+ * The upper-left corner is (1,1), the lower-right corner is (p->width, p->height).
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column).
+ * \param y        Vertical character position (row).
+ * \param string   String that gets written.
+ */
+MODULE_EXPORT void
+netlcd_string (Driver *drvthis, int x, int y, const char string[])
+{
+	PrivateData *p = drvthis->private_data;
+	int i;
+
+	x--;
+	y--;
+	if ((y < 0) || (y >= p->height))
+		return;
+
+	for (i = 0; (string[i] != '\0') && (x < p->width); i++, x++) {
+		if (x >= 0)
+			p->framebuf[(y * p->width) + x] = string[i];
+	}
+}
+
+
+/**
+ * Print a character on the screen at position (x,y).
+ * The upper-left corner is (1,1), the lower-right corner is (p->width, p->height).
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column).
+ * \param y        Vertical character position (row).
+ * \param c        Character that gets written.
+ */
+MODULE_EXPORT void
+netlcd_chr (Driver *drvthis, int x, int y, char c)
+{
+	PrivateData *p = drvthis->private_data;
+
+	x--;
+	y--;
+	if ((x >= 0) && (y >= 0) && (x < p->width) && (y < p->height))
+		p->framebuf[(y * p->width) + x] = c;
+}
+
+
+/* Handle a message from a display; returns the key it carries, if any */
+static const char *
+netlcd_message(Driver *drvthis, const unsigned char *msg, int len)
+{
+	PrivateData *p = drvthis->private_data;
+	int keylen;
+
+	if ((len < 2) || (msg[0] != NETLCD_VERSION))
+		return NULL;
+
+	switch (msg[1]) {
+	case NETLCD_RESYNC:
+		p->need_keyframe = 1;
+		break;
+	case NETLCD_KEY:
+		keylen = len - 2;
+		if ((keylen <= 0) || (keylen >= NETLCD_MAX_KEY))
+			break;
+		memcpy(p->key, msg + 2, keylen);
+		p->key[keylen] = '\0';
+		return p->key;
+	default:
+		break;
+	}
+	return NULL;
+}
+
+
+/* Receive a datagram; store the time the kernel received it in when, if
+ * it tells */
+static ssize_t
+netlcd_recv_stamped(int sock, unsigned char *buf, size_t size, unsigned long *when)
+{
+	struct iovec iov;
+	struct msghdr msg;
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(struct timeval))];
+	} control;
+	ssize_t n;
+
+	iov.iov_base = buf;
+	iov.iov_len = size;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	if ((n = recvmsg(sock, &msg, MSG_DONTWAIT)) <= 0)
+		return n;
+#ifdef SO_TIMESTAMP
+	{
+		struct cmsghdr *cm;
+
+		for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+			if ((cm->cmsg_level == SOL_SOCKET) && (cm->cmsg_type == SO_TIMESTAMP)) {
+				struct timeval tv;
+
+				memcpy(&tv, CMSG_DATA(cm), sizeof(tv));
+				*when = (unsigned long) tv.tv_sec * 1000000UL + tv.tv_usec;
+			}
+		}
+	}
+#endif
+	return n;
+}
+
+
+/**
+ * Read the messages the displays sent back, and send a keyframe if one is
+ * due. This is polled all the time, so keyframes go out while the screen
+ * does not change too.
+ * \param drvthis  Pointer to driver structure.
+ * \return         String representation of the key, or NULL.
+ */
+MODULE_EXPORT const char *
+netlcd_get_key (Driver *drvthis)
+{
+	unsigned long when;
+
+	return netlcd_get_key_event(drvthis, &when);
+}
+
+
+/**
+ * Like netlcd_get_key(), also telling when a key arrived over UDP, as the
+ * kernel stamped the datagram. Over TCP, keys are read as they arrive
+ * and get no time, the server then takes the time it read them.
+ * \param drvthis  Pointer to driver structure.
+ * \param when     Where to store the time, like the server's clock().
+ * \return         String representation of the key, or NULL.
+ */
+MODULE_EXPORT const char *
+netlcd_get_key_event (Driver *drvthis, unsigned long *when)
+{
+	PrivateData *p = drvthis->private_data;
+	const char *key = NULL;
+	ssize_t n;
+
+	if (!p->tcp) {
+		unsigned char buf[2 + NETLCD_MAX_KEY];
+
+		while (key == NULL) {
+			n = netlcd_recv_stamped(p->sock, buf, sizeof(buf), when);
+			if (n > 0)
+				key = netlcd_message(drvthis, buf, n);
+			/* errors of earlier datagrams (nobody listening) show up here */
+			else if ((n < 0) && (errno != ECONNREFUSED))
+				break;
+		}
+	}
+	else {
+		if (netlcd_drain(drvthis) < 0)
+			return NULL;
+
+		n = recv(p->sock, p->in + p->in_len, sizeof(p->in) - p->in_len, MSG_DONTWAIT);
+		if (n == 0 || ((n < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))) {
+			report(RPT_ERR, "%s: connection lost: %s", drvthis->name,
+			       (n == 0) ? "closed by peer" : strerror(errno));
+			drvthis->lost_device(drvthis);
+			return NULL;
+		}
+		if (n > 0)
+			p->in_len += n;
+
+		/* take the complete messages, one key at a time */
+		while ((key == NULL) && (p->in_len >= 2)) {
+			int len = (p->in[0] << 8) | p->in[1];
+
+			if (len > (int) sizeof(p->in) - 2) {
+				report(RPT_ERR, "%s: message too long (%d bytes)", drvthis->name, len);
+				drvthis->lost_device(drvthis);
+				return NULL;
+			}
+			if (p->in_len < 2 + len)
+				break;
+			key = netlcd_message(drvthis, p->in + 2, len);
+			p->in_len -= 2 + len;
+			memmove(p->in, p->in + 2 + len, p->in_len);
+		}
+	}
+
+	if (netlcd_keyframe_due(p) && (!p->tcp || (p->pending_len == 0)))
+		netlcd_keyframe(drvthis);
+
+	return key;
+}
+
+
+/**
+ * Draw a vertical bar bottom-up.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column) of the starting point.
+ * \param y        Vertical character position (row) of the starting point.
+ * \param len      Number of characters that the bar is high at 100%
+ * \param promille Current height level of the bar in promille.
+ * \param options  Options (currently unused).
+ */
+MODULE_EXPORT void
+netlcd_vbar (Driver *drvthis, int x, int y, int len, int promille, int options)
+{
+	PrivateData *p = drvthis->private_data;
+
+	if (p->ccmode != vbar) {
+		unsigned char vBar[NETLCD_CELLHEIGHT];
+		int i;
+
+		if (p->ccmode != standard) {
+			/* Not supported(yet) */
+			report(RPT_WARNING, "%s: vbar: cannot combine two modes using user-defined characters",
+					drvthis->name);
+			return;
+		}
+		p->ccmode = vbar;
+
+		memset(vBar, 0x00, sizeof(vBar));
+		for (i = 1; i < NETLCD_CELLHEIGHT; i++) {
+			/* add pixel line per pixel line ... */
+			vBar[NETLCD_CELLHEIGHT - i] = 0x1F;
+			netlcd_set_char(drvthis, i, vBar);
+		}
+	}
+
+	lib_vbar_static(drvthis, x, y, len, promille, options, NETLCD_CELLHEIGHT, 0);
+}
+
+
+/**
+ * Draw a horizontal bar to the right.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column) of the starting point.
+ * \param y        Vertical character position (row) of the starting point.
+ * \param len      Number of characters that the bar is long at 100%
+ * \param promille Current length level of the bar in promille.
+ * \param options  Options (currently unused).
+ */
+MODULE_EXPORT void
+netlcd_hbar (Driver *drvthis, int x, int y, int len, int promille, int options)
+{
+	PrivateData *p = drvthis->private_data;
+
+	if (p->ccmode != hbar) {
+		unsigned char hBar[NETLCD_CELLHEIGHT];
+		int i;
+
+		if (p->ccmode != standard) {
+			/* Not supported(yet) */
+			report(RPT_WARNING, "%s: hbar: cannot combine two modes using user-defined characters",
+					drvthis->name);
+			return;
+		}
+		p->ccmode = hbar;
+
+		for (i = 1; i <= NETLCD_CELLWIDTH; i++) {
+			/* fill pixel columns from left to right. */
+			memset(hBar, 0x1F & ~((1 << (NETLCD_CELLWIDTH - i)) - 1), sizeof(hBar));
+			netlcd_set_char(drvthis, i, hBar);
+		}
+	}
+
+	lib_hbar_static(drvthis, x, y, len, promille, options, NETLCD_CELLWIDTH, 0);
+}
+
+
+/**
+ * Write a big number to the screen.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column).
+ * \param num      Character to write (0 - 10 with 10 representing ':')
+ */
+MODULE_EXPORT void
+netlcd_num (Driver *drvthis, int x, int num)
+{
+	PrivateData *p = drvthis->private_data;
+	int do_init = 0;
+
+	if ((num < 0) || (num > 10))
+		return;
+
+	if (p->ccmode != bignum) {
+		if (p->ccmode != standard) {
+			/* Not supported (yet) */
+			report(RPT_WARNING, "%s: num: cannot combine two modes using user-defined characters",
+					drvthis->name);
+			return;
+		}
+		p->ccmode = bignum;
+		do_init = 1;
+	}
+
+	lib_adv_bignum(drvthis, x, num, 0, do_init);
+}
+
+
+/**
+ * Place an icon on the screen. Only the full block is drawn here, as
+ * character 255; the core draws the others.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column).
+ * \param y        Vertical character position (row).
+ * \param icon     synbolic value representing the icon.
+ * \retval 0       Icon has been successfully defined/written.
+ * \retval <0      Server core shall define/write the icon.
+ */
+MODULE_EXPORT int
+netlcd_icon (Driver *drvthis, int x, int y, int icon)
+{
+	if (icon != ICON_BLOCK_FILLED)
+		return -1;
+
+	netlcd_chr(drvthis, x, y, 255);
+	return 0;
+}
+
+
+/**
+ * Define a custom character. It is sent with the next frame.
+ * \param drvthis  Pointer to driver structure.
+ * \param n        Custom character to define [0 - 7].
+ * \param dat      Array of 8 (=cellheight) bytes, each representing a pixel row
+ *                 starting from the top to bottom.
+ *                 The bits in each byte represent the pixels where the LSB
+ *                 (least significant bit) is the rightmost pixel in each pixel row.
+ */
+MODULE_EXPORT void
+netlcd_set_char (Driver *drvthis, int n, unsigned char *dat)
+{
+	PrivateData *p = drvthis->private_data;
+	int row;
+
+	if ((n < 0) || (n >= NETLCD_CUSTOM_CHARS) || (dat == NULL))
+		return;
+
+	for (row = 0; row < NETLCD_CELLHEIGHT; row++)
+		p->cc[n][row] = dat[row] & 0x1F;
+}
+
+
+/**
+ * Get total number of custom characters available.
+ * \param drvthis  Pointer to driver structure.
+ * \return  Number of custom characters.
+ */
+MODULE_EXPORT int
+netlcd_get_free_chars (Driver *drvthis)
+{
+	return NETLCD_CUSTOM_CHARS;
+}
+
+
+/**
+ * Turn the backlight on or off; the displays get it with the next frame.
+ * \param drvthis  Pointer to driver structure.
+ * \param on       New backlight status.
+ */
+MODULE_EXPORT void
+netlcd_backlight (Driver *drvthis, int on)
+{
+	PrivateData *p = drvthis->private_data;
+
+	p->backlight = on;
+}
+
+
+/**
+ * Provide some information about this driver.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Constant string with information.
+ */
+MODULE_EXPORT const char *
+netlcd_get_info (Driver *drvthis)
+{
+	static char *info_string = "Network display driver";
+
+	return info_string;
+}
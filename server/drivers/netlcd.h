@@ -0,0 +1,70 @@
+#ifndef LCD_NETLCD_H
+#define LCD_NETLCD_H
+
+MODULE_EXPORT int  netlcd_init (Driver *drvthis);
+MODULE_EXPORT void netlcd_close (Driver *drvthis);
+MODULE_EXPORT int  netlcd_width (Driver *drvthis);
+MODULE_EXPORT int  netlcd_height (Driver *drvthis);
+MODULE_EXPORT int  netlcd_cellwidth (Driver *drvthis);
+MODULE_EXPORT int  netlcd_cellheight (Driver *drvthis);
+MODULE_EXPORT void netlcd_clear (Driver *drvthis);
+MODULE_EXPORT void netlcd_flush (Driver *drvthis);
+MODULE_EXPORT void netlcd_string (Driver *drvthis, int x, int y, const char string[]);
+MODULE_EXPORT void netlcd_chr (Driver *drvthis, int x, int y, char c);
+MODULE_EXPORT const char *netlcd_get_key (Driver *drvthis);
+MODULE_EXPORT const char *netlcd_get_key_event (Driver *drvthis, unsigned long *when);
+
+MODULE_EXPORT void netlcd_vbar (Driver *drvthis, int x, int y, int len, int promille, int options);
+MODULE_EXPORT void netlcd_hbar (Driver *drvthis, int x, int y, int len, int promille, int options);
+MODULE_EXPORT void netlcd_num (Driver *drvthis, int x, int num);
+MODULE_EXPORT int  netlcd_icon (Driver *drvthis, int x, int y, int icon);
+MODULE_EXPORT void netlcd_set_char (Driver *drvthis, int n, unsigned char *dat);
+MODULE_EXPORT int  netlcd_get_free_chars (Driver *drvthis);
+
+MODULE_EXPORT void netlcd_backlight (Driver *drvthis, int on);
+MODULE_EXPORT const char *netlcd_get_info (Driver *drvthis);
+
+#define NETLCD_DEFAULT_SIZE	"20x4"
+#define NETLCD_DEFAULT_PORT	13667
+#define NETLCD_DEFAULT_KEYFRAME_UDP	2000	/* ms */
+
+/*
+ * The protocol. Every message starts with the version and the type; the
+ * messages of the server continue with a header:
+ *
+ *   0     version (NETLCD_VERSION)
+ *   1     type
+ *   2-5   sequence number, big-endian, one more for every message
+ *   6     width in characters
+ *   7     height in characters
+ *   8     flags (NETLCD_FLAG_*)
+ *
+ * A keyframe holds all width * height characters, row by row, and then
+ * the 8 custom characters of 8 pixel rows each (top row first, the
+ * rightmost pixel in the LSB). A delta holds the changes to the frame of
+ * the previous sequence number: the number of custom characters that
+ * changed and for each its number and pixel rows, then runs of changed
+ * characters until the end of the message, each with the offset of its
+ * first cell (2 bytes, big-endian, row by row from the top left), its
+ * length (1 byte) and the characters. A display drops deltas not following
+ * the frame it shows and waits for the next keyframe, or asks for one.
+ *
+ * A display may send the name of a key that was pressed (NETLCD_KEY,
+ * followed by the name) and ask for a keyframe (NETLCD_RESYNC).
+ *
+ * Over UDP each message is a datagram. Over TCP each message is preceded
+ * by its length, 2 bytes big-endian.
+ */
+#define NETLCD_VERSION		1
+
+#define NETLCD_KEYFRAME		0x01	/* server: the whole frame */
+#define NETLCD_DELTA		0x02	/* server: what changed */
+#define NETLCD_KEY		0x81	/* display: a key was pressed */
+#define NETLCD_RESYNC		0x82	/* display: send a keyframe */
+
+#define NETLCD_FLAG_BACKLIGHT	0x01	/* backlight is on */
+
+#define NETLCD_HEADER_SIZE	9
+#define NETLCD_CUSTOM_CHARS	8
+
+#endif
@@ -43,6 +43,7 @@
 #include "adv_bignum.h"
 #include "shared/report.h"
 #include "picolcd.h"
+#include "usb_lib.h"
 #include "timing.h"
 
 #define NUM_CCs         8	/* max. number of custom characters */
@@ -129,6 +130,11 @@ typedef struct picolcd_private_data {
 	int keylights;
 	int key_light[KEYPAD_LIGHTS];
 	int linklights;
+	/* backlight and key light reports wanted and last sent (-1: none) */
+	int bklight_level;
+	int bklight_sent;
+	int leds;
+	int leds_sent;
 	CGmode ccmode;
 	char *info;
 	unsigned char *framebuf;
@@ -150,6 +156,8 @@ typedef struct picolcd_private_data {
 #ifdef HAVE_LIBUSB_1_0
 	/* Pointer to libusb 1.0 session */
 	libusb_context *lib_ctx;
+	/* output transfers on the way to the display */
+	UsbQueue *out_queue;
 	/* structure for the details of the USB transfer */
 	UsbTransferData input_transfer[USB_BUFFERS];
 	/* buffer for the key press data */
@@ -166,12 +174,13 @@ typedef struct picolcd_private_data {
 } PrivateData;
 
 /* Private function definitions */
-static void picolcd_send(USB_DEVICE_HANDLE *lcd, unsigned char *data, int size);
-static void picolcd_20x2_write(USB_DEVICE_HANDLE *lcd, const int row, const int col, const unsigned char *data);
-static void picolcd_20x4_write(USB_DEVICE_HANDLE *lcd, const int row, const int col, const unsigned char *data);
+static void picolcd_send(Driver *drvthis, unsigned char *data, int size);
+static void picolcd_20x2_write(Driver *drvthis, const int row, const int col, const unsigned char *data, int len);
+static void picolcd_20x4_write(Driver *drvthis, const int row, const int col, const unsigned char *data, int len);
 static void picolcd_20x2_set_char(Driver *drvthis, int n, unsigned char *dat);
 static void picolcd_20x4_set_char(Driver *drvthis, int n, unsigned char *dat);
-static void set_key_lights(USB_DEVICE_HANDLE *lcd, int keys[], int state);
+static void set_key_lights(Driver *drvthis, int keys[], int state);
+static void picolcd_send_states(Driver *drvthis);
 static void picolcd_lircsend(Driver *drvthis);
 static void ir_transcode(Driver *drvthis, unsigned char *data, unsigned int cbdata);
 #ifdef HAVE_LIBUSB_1_0
@@ -218,6 +227,7 @@ picolcd_device picolcd_device_ids[] = {
 		.contrast_min = 0,
 		.width        = 20,
 		.height       = 4,
+		.linked_rows  = 2,
 		.write        = picolcd_20x4_write,
 		.cchar        = picolcd_20x4_set_char,
 		/* all keymap labels must be shorter than KEYPAD_LABEL_MAX */
@@ -345,6 +355,13 @@ picoLCD_init(Driver *drvthis)
 		report(RPT_WARNING, "%s: libusb_set_interface_alt_setting error %d", drvthis->name, error);
 	}
 
+	/* Output is sent without waiting for each report to arrive */
+	p->out_queue = lib_usb_queue_new(drvthis, p->lib_ctx, p->lcd, LIB_USB_QUEUE_DEPTH);
+	if (p->out_queue == NULL) {
+		report(RPT_ERR, "%s: unable to create output queue", drvthis->name);
+		return -1;
+	}
+
 	/* Set-up USB input transfer data structures */
 	for (i = 0; i < USB_BUFFERS; i++)
 		p->input_transfer[i].transfer = NULL;
@@ -434,7 +451,7 @@ done:
 #endif	/* HAVE_LIBUSB_1_0 */
 
 	/* if the device has a init sequence send it to device */
-	picolcd_send(p->lcd, p->device->initseq, PICOLCD_MAX_DATA_LEN);
+	picolcd_send(drvthis, p->device->initseq, PICOLCD_MAX_DATA_LEN);
 
 	p->width = p->device->width;
 	p->height = p->device->height;
@@ -545,17 +562,20 @@ done:
 	p->lstframe[p->width * p->height] = '\0';
 
 	/* Apply config settings to the display */
+	p->bklight_level = p->bklight_sent = -1;
+	p->leds = p->leds_sent = -1;
 	if (p->backlight)
 		picoLCD_backlight(drvthis, 1);
 	else
 		picoLCD_backlight(drvthis, 0);
 
 	if (p->keylights)
-		set_key_lights(p->lcd, p->key_light, 1);
+		set_key_lights(drvthis, p->key_light, 1);
 	else
-		set_key_lights(p->lcd, p->key_light, 0);
+		set_key_lights(drvthis, p->key_light, 0);
 
 	picoLCD_set_contrast(drvthis, p->contrast);
+	picolcd_send_states(drvthis);
 
 	/* setup LIRC */
 	lirchost = drvthis->config_get_string(drvthis->name, "LircHost", 0, NULL);
@@ -668,6 +688,8 @@ picoLCD_close(Driver *drvthis)
 #ifdef HAVE_LIBUSB_1_0
 		int error;
 
+		/* let the queued output reach the display first */
+		lib_usb_queue_free(p->out_queue);
 		free_usb_transfers(drvthis);
 
 		error = libusb_release_interface(p->lcd, 0);
@@ -763,33 +785,61 @@ MODULE_EXPORT void
 picoLCD_flush(Driver *drvthis)
 {
 	PrivateData *p = drvthis->private_data;
-	unsigned char *fb = p->framebuf;
-	unsigned char *lf = p->lstframe;
-	static unsigned char text[48];
-	int i, line, offset;
+	int linked = p->device->linked_rows;
+	unsigned char text[2 * 20];	/* two rows of 20 characters */
+	int row;
 
 	debug(RPT_DEBUG, "%s: flush started", drvthis->name);
 
-	for (line = 0; line < p->height; line++) {
-		memset(text, 0, sizeof(text));
-		offset = line * p->width;
-		fb = p->framebuf + offset;
-		lf = p->lstframe + offset;
+	/*
+	 * Every report is an interrupt transfer of its own, and they cost
+	 * far more than the few bytes they carry. So each row, or pair of
+	 * rows that follow each other in the display RAM, gets at most one
+	 * write, from its first to its last changed character.
+	 */
+	for (row = 0; row < p->height; row++) {
+		int rows = 1, first = -1, last = -1;
+		int i;
 
-		for (i = 0; i < p->width; i++) {
-			if (*fb++ != *lf++) {
-				strncpy((char *)text, (char *)p->framebuf + offset, p->width);
-				p->device->write(p->lcd, line, 0, text);
-				memcpy(p->lstframe + offset, p->framebuf + offset, p->width);
+		if (linked) {
+			if (row % (2 * linked) >= linked)
+				continue;	/* written with row - linked */
+			if (row + linked < p->height)
+				rows = 2;
+		}
 
-				debug(RPT_DEBUG, "%s: flush wrote line %d (%s)",
-					drvthis->name, line + 1, text);
+		for (i = 0; i < rows * p->width; i++) {
+			int offset = (row + (i / p->width) * linked) * p->width + (i % p->width);
 
-				break;
+			text[i] = p->framebuf[offset];
+			if (text[i] != p->lstframe[offset]) {
+				if (first < 0)
+					first = i;
+				last = i;
 			}
 		}
+		if (first < 0)
+			continue;
+
+		p->device->write(drvthis, row, first, text + first, last - first + 1);
+		for (i = 0; i < rows; i++)
+			memcpy(p->lstframe + (row + i * linked) * p->width,
+			       p->framebuf + (row + i * linked) * p->width, p->width);
+
+		debug(RPT_DEBUG, "%s: flush wrote row %d, %d characters from %d",
+			drvthis->name, row + 1, last - first + 1, first + 1);
 	}
 
+	/* the backlight and key lights that changed, after the text */
+	picolcd_send_states(drvthis);
+
+#ifdef HAVE_LIBUSB_1_0
+	/* collect the reports that have arrived meanwhile */
+	lib_usb_poll(p->out_queue);
+	if (lib_usb_lost(p->out_queue))
+		drvthis->lost_device(drvthis);
+#endif
+
 	debug(RPT_DEBUG, "%s: flush complete\n\t(%s)\n\t(%s)",
 		drvthis->name, p->framebuf, p->lstframe);
 }
@@ -884,6 +934,40 @@ picoLCD_chr(Driver *drvthis, int x, int y, unsigned char c)
 }
 
 
+/**
+ * Write a block of characters to the screen. Row r of the block starts at
+ * buf + r * stride; the parts outside the display are left out.
+ * \param drvthis  Pointer to driver structure.
+ * \param buf      Characters of the top left row.
+ * \param stride   Distance between the rows in buf.
+ * \param rect     Position and size of the block.
+ */
+MODULE_EXPORT void
+picoLCD_blit_text(Driver *drvthis, const unsigned char *buf, int stride, const LCDRect *rect)
+{
+	PrivateData *p = drvthis->private_data;
+	int i, j;
+
+	for (j = 0; j < rect->height; j++) {
+		const unsigned char *src = buf + j * stride;
+		int y = rect->y - 1 + j;
+
+		if ((y < 0) || (y >= p->height))
+			continue;
+		for (i = 0; i < rect->width; i++) {
+			int x = rect->x - 1 + i;
+
+			if (x < 0)
+				continue;
+			if (x >= p->width)
+				break;
+			/* NUL is mapped like in picoLCD_chr() */
+			p->framebuf[y * p->width + x] = (src[i] != 0) ? src[i] : 8;
+		}
+	}
+}
+
+
 /* lcd_logical_driver User-defined character functions */
 
 /**
@@ -901,6 +985,7 @@ picoLCD_set_char(Driver *drvthis, int n, unsigned char *dat)
 	PrivateData *p = drvthis->private_data;
 
 	p->device->cchar(drvthis, n, dat);
+	drvthis->count_io(drvthis, IO_CGRAM, 1);
 }
 
 
@@ -1529,7 +1614,7 @@ picoLCD_set_contrast(Driver *drvthis, int promille)
 		packet[1] = p->device->contrast_max;
 	}
 
-	picolcd_send(p->lcd, packet, 2);
+	picolcd_send(drvthis, packet, 2);
 }
 
 
@@ -1570,7 +1655,8 @@ picoLCD_set_brightness(Driver *drvthis, int state, int promille)
 
 
 /**
- * Turn the backlight on or off.
+ * Turn the backlight on or off. The display gets the change with the next
+ * flush.
  * \param drvthis  Pointer to driver structure.
  * \param state    New backlight status.
  */
@@ -1578,37 +1664,35 @@ MODULE_EXPORT void
 picoLCD_backlight(Driver *drvthis, int state)
 {
 	PrivateData *p = drvthis->private_data;
-	unsigned char packet[2] = {0x91};	/* set backlight id */
 	int s;
 
 	if (state == BACKLIGHT_ON) {
 		s = p->brightness / 10;
 		if (s > p->device->bklight_max)
 			s = p->device->bklight_max;
-		packet[1] = (unsigned char) s;
-		picolcd_send(p->lcd, packet, 2);
+		p->bklight_level = s;
 		if (p->linklights) {
 			/* Only enable key lights if enabled by user */
 			if (p->keylights)
-				set_key_lights(p->lcd, p->key_light, state);
+				set_key_lights(drvthis, p->key_light, state);
 		}
 	}
 	else if (state == BACKLIGHT_OFF) {
 		s = p->offbrightness / 10;
 		if (s > p->device->bklight_min)
 			s = p->device->bklight_min;
-		packet[1] = (unsigned char) s;
-		picolcd_send(p->lcd, packet, 2);
+		p->bklight_level = s;
 		if (p->linklights) {
 			/* Always turn key lights off */
-			set_key_lights(p->lcd, p->key_light, state);
+			set_key_lights(drvthis, p->key_light, state);
 		}
 	}
 }
 
 
 /**
- * Set output port(s). If the keypad is connected this controls the key lights.
+ * Set output port(s). If the keypad is connected this controls the key lights,
+ * which change with the next flush.
  * \param drvthis  Pointer to driver structure.
  * \param state    Integer with bits representing port states.
  */
@@ -1622,7 +1706,7 @@ picoLCD_output(Driver *drvthis, int state)
 	for (x = 0, m = 1; x < KEYPAD_LIGHTS; x++, m <<= 1) {
 		p->key_light[x] = state & m;
 	}
-	set_key_lights(p->lcd, p->key_light, 1);
+	set_key_lights(drvthis, p->key_light, 1);
 }
 
 
@@ -1891,99 +1975,88 @@ picolcd_lircsend(Driver *drvthis)
 
 
 /**
- * Send raw data to the display using low level usb_interrupt_write.
- * \param lcd   pointer to device handle
- * \param data  pointer to data packet to send
- * \param size  number of bytes to send
+ * Send raw data to the display using an interrupt transfer. With
+ * libusb-1.0 the transfer is only queued; picoLCD_flush() collects the
+ * transfers that have finished.
+ * \param drvthis  Pointer to driver structure
+ * \param data     pointer to data packet to send
+ * \param size     number of bytes to send
  */
 static void
-picolcd_send(USB_DEVICE_HANDLE * lcd, unsigned char *data, int size)
+picolcd_send(Driver *drvthis, unsigned char *data, int size)
 {
-	if ((lcd == NULL) && (data == NULL))
+	PrivateData *p = drvthis->private_data;
+
+	if ((p->lcd == NULL) || (data == NULL))
 		return;
 #ifdef HAVE_LIBUSB_1_0
 	int error = 0;
-	int transferred = 0;
 	unsigned int timeout = 1000;	/* milliseconds */
-	error = libusb_interrupt_transfer(lcd, LIBUSB_ENDPOINT_OUT + 1, data, size, &transferred, timeout);
-	if (error) {
-		report(RPT_WARNING, "libusb_interrupt_transfer error %d, sent %d of %d bytes\n",
-			error, transferred, size);
+	error = lib_usb_interrupt(p->out_queue, LIBUSB_ENDPOINT_OUT + 1, data, size, timeout, NULL, NULL);
+	if (error && (error != LIBUSB_ERROR_NO_DEVICE)) {
+		report(RPT_WARNING, "%s: interrupt transfer error %d, %d bytes not sent",
+			drvthis->name, error, size);
 	}
 #else
-	usb_interrupt_write(lcd, USB_ENDPOINT_OUT + 1, (char *)data, size, 1000);
+	usb_interrupt_write(p->lcd, USB_ENDPOINT_OUT + 1, (char *)data, size, 1000);
 #endif
 }
 
 
 /**
- * Write function for 20x4 desktop displays.
- * \param lcd   pointer to device handle
- * \param row   Row to place the string at
- * \param col   ignored
- * \param data  pointer to NUL terminated string
+ * Write function for 20x4 desktop displays. Rows 0 and 2, and rows 1 and
+ * 3 follow each other in the display RAM, so a write can go on into the
+ * row after the next.
+ * \param drvthis  Pointer to driver structure
+ * \param row      Row to place the string at
+ * \param col      Column to place the string at (up to 39)
+ * \param data     pointer to the characters
+ * \param len      number of characters
  */
 static void
-picolcd_20x4_write(USB_DEVICE_HANDLE * lcd, const int row, const int col, const unsigned char *data)
+picolcd_20x4_write(Driver *drvthis, const int row, const int col, const unsigned char *data, int len)
 {
 	unsigned char packet[64] = {0x95, 0x01, 0x00, 0x01};
-	unsigned char lineset[4][6] = {
-		{0x94, 0x00, 0x01, 0x00, 0x64, 0x80},
-		{0x94, 0x00, 0x01, 0x00, 0x64, 0xC0},
-		{0x94, 0x00, 0x01, 0x00, 0x64, 0x94},
-		{0x94, 0x00, 0x01, 0x00, 0x64, 0xD4}
-	};
-	int len = strlen((char *)data);
+	unsigned char lineset[6] = {0x94, 0x00, 0x01, 0x00, 0x64};
+	static const unsigned char row_address[4] = {0x80, 0xC0, 0x94, 0xD4};
 
-	/* Cut off at display width */
-	if (len > 20)
-		len = 20;
+	if ((row < 0) || (row > 3) || (col < 0) || (col >= 40) || (len <= 0))
+		return;
 
-	/* Send command to select row */
-	switch (row) {
-	    case 0:
-		picolcd_send(lcd, lineset[0], 6);
-		break;
-	    case 1:
-		picolcd_send(lcd, lineset[1], 6);
-		break;
-	    case 2:
-		picolcd_send(lcd, lineset[2], 6);
-		break;
-	    case 3:
-		picolcd_send(lcd, lineset[3], 6);
-		break;
-	    default:
-		picolcd_send(lcd, lineset[0], 6);
-		break;
-	}
+	/* Cut off at the end of the linked row */
+	if (len > 40 - col)
+		len = 40 - col;
+
+	/* Send command to set the RAM address */
+	lineset[5] = row_address[row] + col;
+	picolcd_send(drvthis, lineset, 6);
 
 	/* Fill in an send packet */
 	packet[4] = len;
 	memcpy(packet + 5, data, len);
-	picolcd_send(lcd, packet, 5 + len);
+	picolcd_send(drvthis, packet, 5 + len);
 }
 
 
 /**
  * Write function for 20x2 OEM displays.
- * \param lcd   pointer to device handle
- * \param row   Row to place the string at
- * \param col   Column to place the string at
- * \param data  pointer to NUL terminated string
+ * \param drvthis  Pointer to driver structure
+ * \param row      Row to place the string at
+ * \param col      Column to place the string at
+ * \param data     pointer to the characters
+ * \param len      number of characters
  */
 static void
-picolcd_20x2_write(USB_DEVICE_HANDLE * lcd, const int row, const int col, const unsigned char *data)
+picolcd_20x2_write(Driver *drvthis, const int row, const int col, const unsigned char *data, int len)
 {
 	unsigned char packet[64] = {0x98};
-	int len = strlen((char *)data);
 
-	/*
-	 * FIXME: Is it possible that data is written beyond the end of
-	 * the selected row? Shouldn't cut off happen at (20 - col)?
-	 */
-	if (len > 20)
-		len = 20;
+	if ((col < 0) || (col >= 20) || (len <= 0))
+		return;
+
+	/* Cut off at the end of the row */
+	if (len > 20 - col)
+		len = 20 - col;
 
 	/* prepare and send packet */
 	packet[1] = row;
@@ -1992,7 +2065,7 @@ picolcd_20x2_write(USB_DEVICE_HANDLE * lcd, const int row, const int col, const
 
 	memcpy(packet + 4, data, len);
 
-	picolcd_send(lcd, packet, 4 + len);
+	picolcd_send(drvthis, packet, 4 + len);
 }
 
 
@@ -2021,7 +2094,7 @@ picolcd_20x2_set_char(Driver *drvthis, int n, unsigned char *dat)
 		packet[row + 2] = dat[row] & mask;
 	}
 
-	picolcd_send(p->lcd, packet, 10);
+	picolcd_send(drvthis, packet, 10);
 }
 
 
@@ -2034,8 +2107,6 @@ picolcd_20x2_set_char(Driver *drvthis, int n, unsigned char *dat)
 static void
 picolcd_20x4_set_char(Driver *drvthis, int n, unsigned char *dat)
 {
-	PrivateData *p = drvthis->private_data;
-
 	if ((n < 0) || (n >= NUM_CCs))
 		return;
 	if (dat == NULL)
@@ -2050,8 +2121,8 @@ picolcd_20x4_set_char(Driver *drvthis, int n, unsigned char *dat)
 		dat[4], dat[5], dat[6], dat[7]
 	};			/* 0x95 */
 
-	picolcd_send(p->lcd, command, 6);
-	picolcd_send(p->lcd, data, 13);
+	picolcd_send(drvthis, command, 6);
+	picolcd_send(drvthis, data, 13);
 }
 
 #ifndef HAVE_LIBUSB_1_0
@@ -2089,16 +2160,17 @@ get_key_event(usb_dev_handle * lcd, lcd_packet * packet, int timeout)
 
 
 /**
- * Set lights for individual keys.
- * \param lcd    Pointer to device handle
- * \param keys   Array indicating which key number to turn on
- * \param state  0 to turn all LEDs off, 1 to turn them on according to
- *               values set in 'keys' array
+ * Set lights for individual keys; they go to the display with the next
+ * flush (see picolcd_send_states()).
+ * \param drvthis  Pointer to driver structure
+ * \param keys     Array indicating which key number to turn on
+ * \param state    0 to turn all LEDs off, 1 to turn them on according to
+ *                 values set in 'keys' array
  */
 static void
-set_key_lights(USB_DEVICE_HANDLE * lcd, int keys[], int state)
+set_key_lights(Driver *drvthis, int keys[], int state)
 {
-	unsigned char packet[2] = {0x81};	/* set led */
+	PrivateData *p = drvthis->private_data;
 	unsigned int leds = 0;
 	int i;
 
@@ -2115,8 +2187,34 @@ set_key_lights(USB_DEVICE_HANDLE * lcd, int keys[], int state)
 		leds = 0;
 	}
 
-	packet[1] = leds;
-	picolcd_send(lcd, packet, 2);
+	p->leds = leds;
+}
+
+
+/**
+ * Send the backlight and key light states that changed since they were sent
+ * last. The server sets them for every frame; sending them once each, after
+ * the frame's text, keeps the reports between the frames few.
+ * \param drvthis  Pointer to driver structure
+ */
+static void
+picolcd_send_states(Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+	unsigned char packet[2];
+
+	if ((p->bklight_level >= 0) && (p->bklight_level != p->bklight_sent)) {
+		packet[0] = 0x91;	/* set backlight */
+		packet[1] = (unsigned char) p->bklight_level;
+		picolcd_send(drvthis, packet, 2);
+		p->bklight_sent = p->bklight_level;
+	}
+	if ((p->leds >= 0) && (p->leds != p->leds_sent)) {
+		packet[0] = 0x81;	/* set led */
+		packet[1] = (unsigned char) p->leds;
+		picolcd_send(drvthis, packet, 2);
+		p->leds_sent = p->leds;
+	}
 }
 
 
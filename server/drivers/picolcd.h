@@ -67,8 +67,10 @@ typedef struct _picolcd_device {
 	int contrast_min;           /* minimum contrast value */
 	int width;                  /* width of lcd screen */
 	int height;                 /* height of lcd screen */
-	/* Pointer to function that writes data to the LCD format */
-	void (*write) (USB_DEVICE_HANDLE *lcd, const int row, const int col, const unsigned char *data);
+	int linked_rows;            /* row r + linked_rows follows row r in the display RAM (0: none) */
+	/* Pointer to function that writes len characters to the LCD, starting at
+	 * col of row; with linked_rows, col may go on into the linked row */
+	void (*write) (Driver *drvthis, const int row, const int col, const unsigned char *data, int len);
 	/* Pointer to function that defines a custom character */
 	void (*cchar) (Driver *drvthis, int n, unsigned char *dat);
 } picolcd_device;
@@ -82,6 +84,7 @@ MODULE_EXPORT void picoLCD_clear(Driver *drvthis);
 MODULE_EXPORT void picoLCD_flush(Driver *drvthis);
 MODULE_EXPORT void picoLCD_string(Driver *drvthis, int x, int y, unsigned char string[]);
 MODULE_EXPORT void picoLCD_chr(Driver *drvthis, int x, int y, unsigned char c);
+MODULE_EXPORT void picoLCD_blit_text(Driver *drvthis, const unsigned char *buf, int stride, const LCDRect *rect);
 MODULE_EXPORT char *picoLCD_get_key(Driver *drvthis);
 
 MODULE_EXPORT int picoLCD_get_free_chars (Driver *drvthis);
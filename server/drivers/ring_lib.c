@@ -0,0 +1,104 @@
+/** \file server/drivers/ring_lib.c
+ * Lock-free handoff of items between two threads.
+ *
+ * The producer copies an item into the ring before it publishes the new
+ * head with release semantics; the consumer reads the head with acquire
+ * semantics before it copies the item out, and hands the slot back the
+ * same way through the tail. Neither side ever waits for the other: a
+ * full ring makes lib_ring_put() fail, and the caller tries again later.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <string.h>
+
+#include "ring_lib.h"
+
+
+/**
+ * Set up an empty ring on storage of the caller.
+ * \param ring       The ring.
+ * \param items      Storage for size items of item_size bytes.
+ * \param size       Number of items the ring holds; a power of 2.
+ * \param item_size  Bytes per item.
+ * \retval  0        Success.
+ * \retval -1        size is not a power of 2.
+ */
+int
+lib_ring_init(LibRing *ring, void *items, unsigned int size, unsigned int item_size)
+{
+	if ((size == 0) || ((size & (size - 1)) != 0))
+		return -1;
+
+	ring->items = items;
+	ring->size = size;
+	ring->item_size = item_size;
+	ring->head = 0;
+	ring->tail = 0;
+	return 0;
+}
+
+
+/**
+ * Add an item; called by the producer only.
+ * \param ring  The ring.
+ * \param item  The item to copy into the ring.
+ * \retval  0   Success.
+ * \retval -1   The ring is full.
+ */
+int
+lib_ring_put(LibRing *ring, const void *item)
+{
+	unsigned int head = ring->head;
+
+	if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= ring->size)
+		return -1;
+
+	memcpy(ring->items + (head & (ring->size - 1)) * ring->item_size, item, ring->item_size);
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+
+/**
+ * Take the oldest item; called by the consumer only.
+ * \param ring  The ring.
+ * \param item  Where to copy the item to.
+ * \retval  0   Success.
+ * \retval -1   The ring is empty.
+ */
+int
+lib_ring_get(LibRing *ring, void *item)
+{
+	unsigned int tail = ring->tail;
+
+	if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+		return -1;
+
+	memcpy(item, ring->items + (tail & (ring->size - 1)) * ring->item_size, ring->item_size);
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+
+/**
+ * Tell how many items wait in the ring. Either side may ask; the answer
+ * may be out of date by the time it is used.
+ * \param ring  The ring.
+ * \return      Number of items.
+ */
+unsigned int
+lib_ring_count(LibRing *ring)
+{
+	unsigned int tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail;
+}
@@ -0,0 +1,35 @@
+/** \file server/drivers/ring_lib.h
+ * A ring of fixed-size items that one thread fills and another one
+ * empties without locks, for drivers doing their I/O on a thread of their
+ * own: the reader thread hands keys to get_key(), and flush() hands write
+ * requests to the thread writing to the device.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef RING_LIB_H
+#define RING_LIB_H
+
+/**
+ * Single-producer, single-consumer ring. Only the producer calls
+ * lib_ring_put() and only the consumer lib_ring_get(); the counters run
+ * freely and are masked to find the slot. The storage is the caller's.
+ */
+typedef struct lib_ring {
+	unsigned char *items;		/**< Storage of size * item_size bytes */
+	unsigned int size;		/**< Number of items; a power of 2 */
+	unsigned int item_size;		/**< Bytes per item */
+	unsigned int head;		/**< Items put; written by the producer */
+	unsigned int tail;		/**< Items taken; written by the consumer */
+} LibRing;
+
+int lib_ring_init (LibRing *ring, void *items, unsigned int size, unsigned int item_size);
+int lib_ring_put (LibRing *ring, const void *item);
+int lib_ring_get (LibRing *ring, void *item);
+unsigned int lib_ring_count (LibRing *ring);
+
+#endif
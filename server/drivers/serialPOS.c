@@ -66,8 +66,6 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/time.h>
-#include <termios.h>
-#include <fcntl.h>
 #include <string.h>
 #include <strings.h>
 #include <errno.h>
@@ -115,6 +113,11 @@
  * does not see intermediate characters), or, shift the cursor to
  * each line and update a whole line's worth of information at one go.
  *
+ * Displays that cope can be told to move the cursor to the changed
+ * characters of a line (DeltaUpdate), which is much faster at low baud
+ * rates when only a few characters change, like prices on a pole display.
+ * It is used only for a line where it sends fewer bytes than the line.
+ *
  * In order to display graphic widgets, we define and use our own
  * custom characters. At this time, only custom characters for
  * vertical bars, and horizontal bars, the most commonly used
@@ -143,8 +146,6 @@ MODULE_EXPORT char* symbol_prefix = "serialPOS_";
 MODULE_EXPORT int
 serialPOS_init(Driver* drvthis)
 {
-	struct termios portset;
-
 	char device[256] = DEFAULT_DEVICE;
 	int speed = DEFAULT_SPEED;
 	char size[256] = DEFAULT_SIZE;
@@ -160,7 +161,7 @@ serialPOS_init(Driver* drvthis)
 		return -1;
 
 	/* Initialise the PrivateData structure */
-	p->fd = -1;
+	p->serial.fd = -1;
 
 	p->width = LCD_DEFAULT_WIDTH;
 	p->height = LCD_DEFAULT_HEIGHT;
@@ -271,31 +272,31 @@ serialPOS_init(Driver* drvthis)
 	p->cellheight = ch;
 	p->cellwidth = cw;
 
+	/* Send only the changed characters, if the protocol can move the cursor */
+	p->delta_update = drvthis->config_get_bool(drvthis->name, "DeltaUpdate",
+						   0, 0);
+	if (p->delta_update && (p->protocol_ops->cursor_move == NULL)) {
+		report(RPT_WARNING,
+		       "%s: the %s protocol cannot move the cursor; "
+		       "ignoring DeltaUpdate", drvthis->name, buf);
+		p->delta_update = 0;
+	}
+
 
 	/* Get speed */
 	tmp = drvthis->config_get_int(drvthis->name, "Speed", 0,
 				      DEFAULT_SPEED);
 	switch (tmp) {
 	    case 1200:
-		speed = B1200;
-		break;
 	    case 2400:
-		speed = B2400;
-		break;
 	    case 4800:
-		speed = B4800;
-		break;
 	    case 9600:
-		speed = B9600;
-		break;
 	    case 19200:
-		speed = B19200;
-		break;
 	    case 115200:
-		speed = B115200;
+		speed = tmp;
 		break;
 	    default:
-		speed = B9600;
+		speed = 9600;
 		report(RPT_WARNING,
 		       "%s: Speed must be either "
 		       "1200, 2400, 4800, 9600, 19200, or 115200 "
@@ -303,8 +304,7 @@ serialPOS_init(Driver* drvthis)
 	}
 
 	/* Set up io port correctly, and open it... */
-	p->fd = open(device, O_RDWR | O_NOCTTY);
-	if (p->fd == -1) {
+	if (lib_serial_open(&p->serial, device, speed, 0) < 0) {
 		report(RPT_ERR, "%s: open(%s) failed (%s)", drvthis->name,
 		       device, strerror(errno));
 		if (errno == EACCES)
@@ -314,43 +314,6 @@ serialPOS_init(Driver* drvthis)
 	}
 	report(RPT_INFO, "%s: opened display on %s", drvthis->name, device);
 
-	if (tcgetattr(p->fd, &portset)) {
-		report(RPT_ERR,
-		       "%s: unable to get terminal attributes for "
-		       "device: %s",
-		       drvthis->name, device);
-		return -1;
-	}
-
-	/* We use RAW mode */
-#ifdef HAVE_CFMAKERAW
-	/* The easy way */
-	cfmakeraw(&portset);
-#else
-	/* The hard way */
-	portset.c_iflag &=
-	    ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
-	portset.c_oflag &= ~OPOST;
-	portset.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
-	portset.c_cflag &= ~(CSIZE | PARENB | CRTSCTS);
-	portset.c_cflag |= CS8 | CREAD | CLOCAL;
-#endif
-	/* Set timeouts */
-	portset.c_cc[VMIN]  = 1;
-	portset.c_cc[VTIME] = 3;
-
-	/* Set port speed */
-	cfsetospeed(&portset, speed);
-	cfsetispeed(&portset, B0);
-
-	/* Do it... */
-	if (tcsetattr(p->fd, TCSANOW, &portset)) {
-		report(RPT_ERR,
-		       "%s: unable to set terminal attributes for"
-		       " device: %s",
-		       drvthis->name, device);
-	}
-
 	/* Make sure the frame buffer is there... */
 	p->framebuf = (uint8_t*) malloc(p->width * p->height);
 	if (p->framebuf == NULL) {
@@ -382,7 +345,8 @@ serialPOS_init(Driver* drvthis)
 		       drvthis->name, buf);
 		return -1;
 	}
-	write(p->fd, buffer, rtn);
+	lib_serial_write(&p->serial, buffer, rtn);
+	lib_serial_flush(drvthis, &p->serial);
 
 	report(RPT_INFO,
 	       "%s: initialized with display size of %dx%d, "
@@ -405,8 +369,7 @@ serialPOS_close(Driver* drvthis)
 	PrivateData* p = drvthis->private_data;
 
 	if (p != NULL) {
-		if (p->fd >= 0)
-			close(p->fd);
+		lib_serial_close(&p->serial);
 
 		if (p->framebuf)
 			free(p->framebuf);
@@ -598,8 +561,9 @@ serialPOS_flush(Driver* drvthis)
 	int rtn;
 
 	if ((rtn = p->protocol_ops->flush(p, buffer)) > 0) {
-		write(p->fd, buffer, rtn);
+		lib_serial_write(&p->serial, buffer, rtn);
 	}
+	lib_serial_flush(drvthis, &p->serial);
 	debug(RPT_DEBUG, "serialPOS: frame buffer flushed");
 }
 
@@ -809,7 +773,7 @@ serialPOS_get_key(Driver* drvthis)
 	fd_set fdset;
 
 	FD_ZERO(&fdset);
-	FD_SET(p->fd, &fdset);
+	FD_SET(p->serial.fd, &fdset);
 
 	if ((ret = select(FD_SETSIZE, &fdset, NULL, NULL, &selectTimeout))
 	    < 0) {
@@ -818,14 +782,14 @@ serialPOS_get_key(Driver* drvthis)
 		return NULL;
 	}
 	if (!ret) {
-		FD_SET(p->fd, &fdset);
+		FD_SET(p->serial.fd, &fdset);
 		return NULL;
 	}
 
-	if (!FD_ISSET(p->fd, &fdset))
+	if (!FD_ISSET(p->serial.fd, &fdset))
 		return NULL;
 
-	if ((ret = read(p->fd, &buf, 1)) < 0) {
+	if ((ret = read(p->serial.fd, &buf, 1)) < 0) {
 		debug(RPT_DEBUG, "%s: get_key: read() failed (%s)",
 		      drvthis->name, strerror(errno));
 		return NULL;
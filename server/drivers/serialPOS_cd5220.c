@@ -151,11 +151,15 @@ static int flush(PrivateData* data, uint8_t* buffer);
 
 static int cust_char_code(PrivateData* data, int idx);
 
+static int cursor_move(PrivateData* data, uint8_t* buffer, int x, int y);
+
 const ops serialPOS_cd5220_ops = {
     command_buffer_sz,
     init,
     flush,
     cust_char_code,
+    cursor_move,
+    sizeof(CD5220_CURSOR_POSITION) + 2,
 };
 
 static int
@@ -283,6 +287,8 @@ flush(PrivateData* data, uint8_t* buffer)
 	uint8_t* const start   = buffer;
 	uint32_t lines_flushed = 0;
 
+	/* Send the small changes, then whole lines for the rest */
+	buffer += serialPOS_flush_changes(data, buffer);
 	lines_flushed = serialPOS_lines_to_flush(data);
 	/* Flush display data */
 	if (lines_flushed & 0x01) {
@@ -361,3 +367,15 @@ cust_char_code(PrivateData* data, int idx)
 		return -1;
 	}
 }
+
+static int
+cursor_move(PrivateData* data, uint8_t* buffer, int x, int y)
+{
+	uint8_t* const start = buffer;
+
+	buffer = bytecpy_advance_ptr(buffer, CD5220_CURSOR_POSITION,
+				     sizeof(CD5220_CURSOR_POSITION));
+	*(buffer++) = x;
+	*(buffer++) = y;
+	return (buffer - start);
+}
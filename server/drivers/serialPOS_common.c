@@ -72,3 +72,65 @@ serialPOS_lines_to_flush(PrivateData* data)
 	}
 	return flush_lines;
 }
+
+int
+serialPOS_frame_changed(PrivateData* data)
+{
+	return (memcmp(data->framebuf, data->backingstore,
+		       data->width * data->height) != 0);
+}
+
+int
+serialPOS_flush_changes(PrivateData* data, uint8_t* buffer)
+{
+	const ops* protocol = data->protocol_ops;
+	uint8_t* const start = buffer;
+
+	if (!data->delta_update || (protocol->cursor_move == NULL))
+		return 0;
+
+	for (int h = 0; h < data->height; h++) {
+		uint8_t* framebuf_line_start =
+		    data->framebuf + ((data->width) * h);
+		uint8_t* backingstore_line_start =
+		    data->backingstore + ((data->width) * h);
+		int cost = 0;
+		int end = -1;
+
+		/* Weigh the runs of changes against resending the line */
+		for (int x = 0; x < data->width; x++) {
+			if (framebuf_line_start[x] == backingstore_line_start[x])
+				continue;
+			if ((end >= 0) && ((x - end) <= protocol->cursor_move_cost))
+				cost += (x - end);
+			else
+				cost += protocol->cursor_move_cost;
+			cost++;
+			end = x + 1;
+		}
+		if ((cost == 0)
+		    || (cost >= (protocol->cursor_move_cost + data->width)))
+			continue;
+
+		end = -1;
+		for (int x = 0; x < data->width; x++) {
+			if (framebuf_line_start[x] == backingstore_line_start[x])
+				continue;
+			if ((end >= 0) && ((x - end) <= protocol->cursor_move_cost))
+				buffer = bytecpy_advance_ptr(
+				    buffer, framebuf_line_start + end, x - end);
+			else
+				buffer += protocol->cursor_move(data, buffer,
+								x + 1, h + 1);
+			*(buffer++) = framebuf_line_start[x];
+			end = x + 1;
+		}
+		memcpy(backingstore_line_start, framebuf_line_start,
+		       data->width);
+	}
+	if (buffer != start) {
+		/* The cursor moved: force cursor position sync */
+		data->display_misc_state.cx = -1;
+	}
+	return (buffer - start);
+}
@@ -29,12 +29,13 @@
  */
 
 #include "lcd.h"
+#include "serial_lib.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 
 #define DEFAULT_DEVICE 		"/dev/ttyS0"
-#define DEFAULT_SPEED 		9800
+#define DEFAULT_SPEED 		9600
 #define DEFAULT_SIZE 		"16x2"
 #define DEFAULT_TYPE 		"AEDEX"
 #define DEFAULT_CELL_SIZE	"5x8"
@@ -118,7 +119,10 @@ typedef struct serialPOS_ops {
 	 * displays have problems dealing with high command rates and will
 	 * drop commands, leading to malformed data displayed on screen. The
 	 * "write-line" commands that allow atomic updates of single lines
-	 * should be preferred, instead.
+	 * should be preferred, instead. Only when the user asks for it
+	 * (\ref PrivateData::delta_update), call
+	 * \ref serialPOS_flush_changes() first to send the changed parts of
+	 * lines by moving the cursor.
 	 *
 	 * \param data private data used by the display
 	 * \param buffer buffer to write data to
@@ -136,6 +140,28 @@ typedef struct serialPOS_ops {
 	 * \return character code, or -1 on error
 	 */
 	int (*cust_char_code)(struct serialPOS_private_data* data, int idx);
+
+	/**
+	 * Obtain the command that moves the display cursor to a position.
+	 *
+	 * Used by \ref serialPOS_flush_changes() to send only the changed
+	 * characters of a line.
+	 *
+	 * \param data private display data
+	 * \param buffer buffer to write the command to
+	 * \param x horizontal position, 1-based
+	 * \param y vertical position, 1-based
+	 * \return number of bytes written to the buffer, which must be
+	 * \ref serialPOS_ops::cursor_move_cost
+	 */
+	int (*cursor_move)(struct serialPOS_private_data* data, uint8_t* buffer,
+			   int x, int y);
+
+	/**
+	 * Number of bytes of a \ref serialPOS_ops::cursor_move command,
+	 * weighed against resending unchanged characters.
+	 */
+	int cursor_move_cost;
 } ops;
 
 /*
@@ -162,7 +188,7 @@ typedef struct serialPOS_display_state_misc {
  * Private data for the \c serialPOS driver
  */
 typedef struct serialPOS_private_data {
-	int fd; /**< LCD file descriptor */
+	SerialPort serial; /**< Port of the LCD */
 
 	/* dimensions */
 	int width, height;
@@ -214,6 +240,12 @@ typedef struct serialPOS_private_data {
 	 */
 	serialPOS_state_misc buffered_misc_state;
 
+	/**
+	 * Send changed characters by moving the cursor, where the protocol
+	 * can and it costs less than resending the line.
+	 */
+	int delta_update;
+
 	/* framebuffer and buffer for old LCD contents */
 	uint8_t* framebuf;     /**< Framebuffer mutated by server calls */
 	uint8_t* backingstore; /**< real LCD display buffer */
@@ -295,4 +327,29 @@ void serialPOS_generate_vertical_block_glyph(uint8_t* buffer, int height);
  * and so on. (0 - based)
  */
 uint32_t serialPOS_lines_to_flush(PrivateData* data);
+
+/**
+ * Tell whether the framebuffer differs from the backing store.
+ *
+ * \param data private data
+ * \return non-zero if anything has to be flushed
+ */
+int serialPOS_frame_changed(PrivateData* data);
+
+/**
+ * Write the commands that send the changed characters of lines,
+ * moving the cursor to each run of changes, if
+ * \ref PrivateData::delta_update is set.
+ *
+ * A line is sent this way only if that costs fewer bytes than moving the
+ * cursor once and resending the whole line; short unchanged gaps between
+ * changes are resent instead of moving the cursor over them. The backing
+ * store is updated for the lines sent, so \ref serialPOS_lines_to_flush()
+ * returns only the remaining ones.
+ *
+ * \param data private data
+ * \param buffer buffer to write data to
+ * \return number of bytes written to the buffer
+ */
+int serialPOS_flush_changes(PrivateData* data, uint8_t* buffer);
 #endif /* SERVER_DRIVERS_SERIALPOS_COMMON_H_ */
@@ -151,8 +151,11 @@ static int flush(PrivateData* data, uint8_t* buffer);
 
 static int cust_char_code(PrivateData* data, int idx);
 
+static int cursor_move(PrivateData* data, uint8_t* buffer, int x, int y);
+
 const ops serialPOS_epson_ops = {command_buffer_sz, init, flush,
-				 cust_char_code};
+				 cust_char_code, cursor_move,
+				 sizeof(EPSON_CURSOR_POSITION) + 2};
 
 static int
 command_buffer_sz(PrivateData* data)
@@ -289,7 +292,7 @@ static int
 flush(PrivateData* data, uint8_t* buffer)
 {
 	uint8_t* start	 = buffer;
-	uint32_t lines_flushed = serialPOS_lines_to_flush(data);
+	int changed	 = serialPOS_frame_changed(data);
 	/*
 	 * If cursor is on, and we're doing a character-by-character update,
 	 * the cursor is going to be visible throughout the update in a
@@ -297,7 +300,7 @@ flush(PrivateData* data, uint8_t* buffer)
 	 *
 	 * Turn the cursor off before we update the screen.
 	 */
-	if (data->display_misc_state.cursor_state && (lines_flushed)) {
+	if (data->display_misc_state.cursor_state && changed) {
 		buffer      = bytecpy_advance_ptr(buffer, EPSON_CURSOR_STATE,
 						  sizeof(EPSON_CURSOR_STATE));
 		*(buffer++) = 0x00;
@@ -307,6 +310,10 @@ flush(PrivateData* data, uint8_t* buffer)
 		data->display_misc_state.cursor_state = 0;
 	}
 
+	/* Send the small changes, then whole lines for the rest */
+	buffer += serialPOS_flush_changes(data, buffer);
+	uint32_t lines_flushed = serialPOS_lines_to_flush(data);
+
 	int cursor_position = -1;
 	for (int h = 0; h < data->height; h++) {
 		if (lines_flushed & (0x01 << h)) {
@@ -388,3 +395,15 @@ cust_char_code(PrivateData* data, int idx)
 		return -1;
 	}
 }
+
+static int
+cursor_move(PrivateData* data, uint8_t* buffer, int x, int y)
+{
+	uint8_t* const start = buffer;
+
+	buffer = bytecpy_advance_ptr(buffer, EPSON_CURSOR_POSITION,
+				     sizeof(EPSON_CURSOR_POSITION));
+	*(buffer++) = x;
+	*(buffer++) = y;
+	return (buffer - start);
+}
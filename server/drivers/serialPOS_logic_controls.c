@@ -116,7 +116,11 @@ static int init(PrivateData* data, uint8_t* buffer);
 
 static int flush(PrivateData* data, uint8_t* buffer);
 
-const ops serialPOS_logic_controls_ops = {command_buffer_sz, init, flush, NULL};
+static int cursor_move(PrivateData* data, uint8_t* buffer, int x, int y);
+
+const ops serialPOS_logic_controls_ops = {command_buffer_sz, init, flush, NULL,
+					  cursor_move,
+					  sizeof(LOGIC_CURSOR_MOVE) + 1};
 
 static int
 command_buffer_sz(PrivateData* data)
@@ -167,14 +171,18 @@ flush(PrivateData* data, uint8_t* buffer)
 	uint8_t* const start   = buffer;
 	uint32_t lines_flushed = 0;
 
-	lines_flushed = serialPOS_lines_to_flush(data);
 	/* disable cursor, if enabled */
-	if (lines_flushed && data->display_misc_state.cursor_state) {
+	if (serialPOS_frame_changed(data)
+	    && data->display_misc_state.cursor_state) {
 		buffer = bytecpy_advance_ptr(buffer, LOGIC_CURSOR_OFF,
 					     sizeof(LOGIC_CURSOR_OFF));
 		data->display_misc_state.cursor_state = 0;
 	}
 
+	/* Send the small changes, then whole lines for the rest */
+	buffer += serialPOS_flush_changes(data, buffer);
+	lines_flushed = serialPOS_lines_to_flush(data);
+
 	/* Flush display data */
 	int cursor_position = -1;
 	for (int h = 0; h < data->height; h++) {
@@ -272,3 +280,15 @@ flush(PrivateData* data, uint8_t* buffer)
 
 	return (buffer - start);
 }
+
+static int
+cursor_move(PrivateData* data, uint8_t* buffer, int x, int y)
+{
+	uint8_t* const start = buffer;
+
+	buffer = bytecpy_advance_ptr(buffer, LOGIC_CURSOR_MOVE,
+				     sizeof(LOGIC_CURSOR_MOVE));
+	/* The second row starts at 0x14, whatever the display width */
+	*(buffer++) = ((y > 1) ? 0x14 : 0x00) + (x - 1);
+	return (buffer - start);
+}
@@ -106,6 +106,7 @@ serialVFD_init (Driver *drvthis)
 		return -1;
 
 	/* Initialize the PrivateData structure */
+	p->serial.fd = -1;
 	p->cellwidth = DEFAULT_CELL_WIDTH;
 	p->cellheight = DEFAULT_CELL_HEIGHT;
 	p->ccmode = standard;
@@ -134,11 +135,7 @@ serialVFD_init (Driver *drvthis)
 				drvthis->name, DEFAULT_SPEED);
 			tmp = DEFAULT_SPEED;
 		}
-		if (tmp == 1200) p->speed = B1200;
-		else if (tmp == 2400) p->speed = B2400;
-		else if (tmp == 9600) p->speed = B9600;
-		else if (tmp == 19200) p->speed = B19200;
-		else if (tmp == 115200) p->speed = B115200;
+		p->speed = tmp;
 	}
 
 	/* Which size */
@@ -239,6 +236,7 @@ serialVFD_init (Driver *drvthis)
 	Port_Function[p->use_parallel].write_fkt(drvthis, &p->hw_cmd[reset][1],p->hw_cmd[reset][0]);
 	Port_Function[p->use_parallel].write_fkt(drvthis, &p->hw_cmd[init_cmds][1],p->hw_cmd[init_cmds][0]);
 	serialVFD_backlight(drvthis, 1);
+	Port_Function[p->use_parallel].flush_fkt(drvthis);
 
 	report(RPT_DEBUG, "%s: init() done", drvthis->name);
 	return 0;
@@ -344,10 +342,9 @@ MODULE_EXPORT void
 serialVFD_flush (Driver *drvthis)
 {
 	PrivateData *p = drvthis->private_data;
-	int i, j, last_chr = -10;
+	int i, j, w, last_chr = -10;
 	char custom_char_changed[32]={0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
 
-
 	for (i = 0; i < p->customchars; i++) {
 		for (j = 0; j < p->usr_chr_dot_assignment[0]; j++) {
 			if (p->custom_char[i][j] != p->custom_char_store[i][j]) {
@@ -433,12 +430,16 @@ serialVFD_flush (Driver *drvthis)
 			else {
 				Port_Function[p->use_parallel].write_fkt(drvthis, &p->hw_cmd[next_line][1], p->hw_cmd[next_line][0]);
 			}
-			/* skip over identical lines */
-			if (memcmp(sp, sq, p->width) == 0) {
+			/*
+			 * write the data up to the last change: next_line
+			 * starts the next line from wherever the cursor is;
+			 * skip over identical lines
+			 */
+			w = lib_diff_last(sp, sq, p->width) + 1;
+			if (w == 0) {
 				continue;
 			}
-			/* write the data */
-			for (i = 0; i < p->width; i++) {
+			for (i = 0; i < w; i++) {
 				serialVFD_hw_write(drvthis, (i + (j * p->width)));
 			}
 			last_chr = 10;
@@ -450,6 +451,8 @@ serialVFD_flush (Driver *drvthis)
 		memcpy(p->backingstore, p->framebuf, p->height * p->width);
 		debug(RPT_DEBUG, "%s: memcpy", __FUNCTION__);
 	}
+
+	Port_Function[p->use_parallel].flush_fkt(drvthis);
 }
 
 
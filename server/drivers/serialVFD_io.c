@@ -62,7 +62,8 @@
 #define MAXBUSY 300
 
 /**
- * Write bytes to the serial port.
+ * Write bytes to the serial port. They are collected and sent at once by
+ * serialVFD_flush_serial().
  * \param drvthis  Pointer to driver
  * \param dat      Pointer to array storing the data
  * \param length   Number of bytes to write
@@ -72,10 +73,19 @@ serialVFD_write_serial (Driver *drvthis, unsigned char *dat, size_t length)
 {
 	PrivateData *p = drvthis->private_data;
 
-	if (length <= 0)
-		return;
+	lib_serial_write(&p->serial, dat, length);
+}
 
-	write(p->fd,dat,length);
+/**
+ * Send the bytes written to the serial port since the last call.
+ * \param drvthis  Pointer to driver
+ */
+void
+serialVFD_flush_serial (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	lib_serial_flush(drvthis, &p->serial);
 }
 
 /**
@@ -140,6 +150,15 @@ serialVFD_write_parallel (Driver *drvthis, unsigned char *dat, size_t length)
 #endif
 }
 
+/**
+ * Nothing to do: bytes go to the parallel port as they are written.
+ * \param drvthis  Pointer to driver
+ */
+void
+serialVFD_flush_parallel (Driver *drvthis)
+{
+}
+
 /**
  * Open a serial port according to the settings in \c serialVFD_private_data.
  * \param  drvthis  Pointer to driver
@@ -149,39 +168,13 @@ int
 serialVFD_init_serial (Driver *drvthis)
 {
 	PrivateData *p = drvthis->private_data;
-	struct termios portset;
 
 	/* Set up io port correctly, and open it...*/
 	debug( RPT_DEBUG, "%s: Opening device: %s", __FUNCTION__, p->device);
-	p->fd = open(p->device, O_RDWR | O_NOCTTY | O_NDELAY);
-
-	if (p->fd == -1) {
+	if (lib_serial_open(&p->serial, p->device, p->speed, 0) < 0) {
 		report(RPT_ERR, "%s: open() of %s failed (%s)", __FUNCTION__, p->device, strerror(errno));
 		return -1;
 	}
-
-	tcgetattr(p->fd, &portset);
-
-	/* We use RAW mode */
-#ifdef HAVE_CFMAKERAW
-	/* The easy way */
-	cfmakeraw( &portset );
-#else
-	/* The hard way */
-	portset.c_iflag &= ~( IGNBRK | BRKINT | PARMRK | ISTRIP
-   	                   | INLCR | IGNCR | ICRNL | IXON );
-	portset.c_oflag &= ~OPOST;
-	portset.c_lflag &= ~( ECHO | ECHONL | ICANON | ISIG | IEXTEN );
-	portset.c_cflag &= ~( CSIZE | PARENB | CRTSCTS );
-	portset.c_cflag |= CS8 | CREAD | CLOCAL ;
-#endif
-
-	/* Set port speed */
-	cfsetospeed(&portset, p->speed);
-	cfsetispeed(&portset, B0);
-
-	/* Do it... */
-	tcsetattr(p->fd, TCSANOW, &portset);
 	return 0;
 }
 
@@ -215,8 +208,8 @@ void
 serialVFD_close_serial (Driver *drvthis)
 {
 	PrivateData *p = drvthis->private_data;
-	if (p->fd >= 0)
-		close(p->fd);
+
+	lib_serial_close(&p->serial);
 }
 
 /**
@@ -0,0 +1,274 @@
+/** \file server/drivers/serial_lib.c
+ * Serial port access shared by the drivers for serial displays: opening
+ * and setting up the port, and sending each frame with as few write()
+ * calls as possible, without ever blocking the server.
+ *
+ * Many small writes cost a system call each, and on USB serial adapters
+ * often a USB transfer each. Collecting a frame's bytes and writing them
+ * at once is cheaper, and lets the server know how long the line will be
+ * busy sending them (see flush_busy() in lcd.h).
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#ifdef HAVE_SYS_IOCTL_H
+# include <sys/ioctl.h>
+#endif
+#ifdef __linux__
+# include <linux/serial.h>
+#endif
+
+#include "lcd.h"
+#include "serial_lib.h"
+#include "shared/report.h"
+
+
+/* Find the termios speed for a baud rate; B0 if there is none */
+static speed_t
+lib_serial_speed (int baudrate)
+{
+	switch (baudrate) {
+		case 1200:	return B1200;
+		case 2400:	return B2400;
+		case 4800:	return B4800;
+		case 9600:	return B9600;
+		case 19200:	return B19200;
+		case 38400:	return B38400;
+		case 57600:	return B57600;
+		case 115200:	return B115200;
+#ifdef B230400
+		case 230400:	return B230400;
+#endif
+		default:	return B0;
+	}
+}
+
+
+/**
+ * Open a serial port and set it up for a display: raw 8 bit data at the
+ * given speed, no flow control, and without blocking. Reads return at once
+ * whether there is input or not, so drivers wait for input with select()
+ * or poll(). Where the system allows it, the port passes received bytes
+ * on at once instead of collecting them (low latency mode).
+ * \param port      The port to set up.
+ * \param device    Device file of the port.
+ * \param baudrate  Speed, e.g. 9600.
+ * \param options   LIB_SERIAL_* flags, or 0.
+ * \return  File descriptor of the port; -1 on error, with errno set.
+ */
+int
+lib_serial_open (SerialPort *port, const char *device, int baudrate, int options)
+{
+	struct termios portset;
+	speed_t speed = lib_serial_speed(baudrate);
+	int err;
+
+	memset(port, 0, sizeof(SerialPort));
+	port->fd = -1;
+
+	if (speed == B0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	port->fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (port->fd < 0)
+		return -1;
+
+	if (tcgetattr(port->fd, &portset) < 0)
+		goto fail;
+
+#ifdef HAVE_CFMAKERAW
+	cfmakeraw(&portset);
+#else
+	portset.c_iflag &= ~( IGNBRK | BRKINT | PARMRK | ISTRIP
+			      | INLCR | IGNCR | ICRNL | IXON );
+	portset.c_oflag &= ~OPOST;
+	portset.c_lflag &= ~( ECHO | ECHONL | ICANON | ISIG | IEXTEN );
+	portset.c_cflag &= ~( CSIZE | PARENB | CRTSCTS );
+	portset.c_cflag |= CS8;
+#endif
+	portset.c_cflag &= ~( PARENB | PARODD | CRTSCTS );
+	portset.c_cflag |= CREAD | CLOCAL;
+	port->bits = 10;
+	if (options & (LIB_SERIAL_PARITY_ODD | LIB_SERIAL_PARITY_EVEN)) {
+		portset.c_cflag |= (options & LIB_SERIAL_PARITY_ODD) ? (PARENB | PARODD) : PARENB;
+		port->bits = 11;
+	}
+	portset.c_cc[VMIN] = 0;
+	portset.c_cc[VTIME] = 0;
+
+	cfsetospeed(&portset, speed);
+	cfsetispeed(&portset, B0);
+
+	if (tcsetattr(port->fd, TCSANOW, &portset) < 0)
+		goto fail;
+
+#if defined(TIOCGSERIAL) && defined(ASYNC_LOW_LATENCY)
+	{
+		struct serial_struct serinfo;
+
+		/* not all ports support it; they work all the same */
+		if (ioctl(port->fd, TIOCGSERIAL, &serinfo) == 0) {
+			serinfo.flags |= ASYNC_LOW_LATENCY;
+			(void) ioctl(port->fd, TIOCSSERIAL, &serinfo);
+		}
+	}
+#endif
+
+	port->baudrate = baudrate;
+	return port->fd;
+
+fail:
+	err = errno;
+	close(port->fd);
+	port->fd = -1;
+	errno = err;
+	return -1;
+}
+
+
+/**
+ * Add bytes to send to the write buffer of a port. They are written by the
+ * next lib_serial_flush().
+ * \param port    The port.
+ * \param data    Bytes to send.
+ * \param length  Number of bytes.
+ */
+void
+lib_serial_write (SerialPort *port, const void *data, size_t length)
+{
+	if ((port->fd < 0) || (length == 0))
+		return;
+
+	if (port->length + length > port->size) {
+		size_t size = (port->size > 0) ? port->size : 256;
+		unsigned char *buf;
+
+		while (size < port->length + length)
+			size *= 2;
+		/* the port has not taken anything for a long while */
+		if (size > LIB_SERIAL_MAX_PENDING) {
+			report(RPT_WARNING, "serial port not ready; dropping %lu bytes",
+			       (unsigned long) port->length);
+			port->length = 0;
+			size = (port->size > length) ? port->size : length;
+		}
+		if (size > port->size) {
+			buf = realloc(port->buf, size);
+			if (buf == NULL) {
+				/* send it unbuffered then */
+				(void) write(port->fd, data, length);
+				return;
+			}
+			port->buf = buf;
+			port->size = size;
+		}
+	}
+	memcpy(port->buf + port->length, data, length);
+	port->length += length;
+}
+
+
+/**
+ * Write the buffered bytes of a port. What the port does not take now
+ * stays in the buffer for the next call. The driver is told how long the
+ * line is busy sending it all (with flush_busy()), how many bytes were
+ * written and whether that failed (with count_io()), and if the device is
+ * gone (with lost_device()).
+ * \param drvthis  The driver using the port; may be NULL.
+ * \param port     The port.
+ * \return  0 if all is written, 1 if bytes are left, -1 on error.
+ */
+int
+lib_serial_flush (Driver *drvthis, SerialPort *port)
+{
+	size_t done = 0;
+	ssize_t n;
+	long writes = 0;
+	int res = 0;
+
+	if (port->fd < 0)
+		return -1;
+
+	while (done < port->length) {
+		n = write(port->fd, port->buf + done, port->length - done);
+		if (n > 0) {
+			done += n;
+			writes++;
+		}
+		else if ((n < 0) && (errno == EINTR))
+			continue;
+		else if ((n == 0) || (errno == EAGAIN) || (errno == EWOULDBLOCK))
+			break;
+		else {
+			if (drvthis != NULL) {
+				drvthis->count_io(drvthis, IO_BYTES, done);
+				drvthis->count_io(drvthis, IO_WRITES, writes);
+				drvthis->count_io(drvthis, IO_ERRORS, 1);
+				/* an unplugged USB adapter reports one of these */
+				if ((errno == ENODEV) || (errno == EIO))
+					drvthis->lost_device(drvthis);
+			}
+			port->length = 0;
+			return -1;
+		}
+	}
+
+	port->length -= done;
+	if (port->length > 0) {
+		memmove(port->buf, port->buf + done, port->length);
+		res = 1;
+	}
+
+	if ((drvthis != NULL) && ((done > 0) || (port->length > 0))) {
+		long long queued = done + port->length;
+#ifdef TIOCOUTQ
+		int outq;
+
+		/* the bytes the port still has to send, including ours */
+		if (ioctl(port->fd, TIOCOUTQ, &outq) == 0)
+			queued = (long long) outq + port->length;
+#endif
+		drvthis->flush_busy(drvthis, (int) (queued * port->bits * 1000000 / port->baudrate));
+		drvthis->count_io(drvthis, IO_BYTES, done);
+		drvthis->count_io(drvthis, IO_WRITES, writes);
+	}
+	return res;
+}
+
+
+/**
+ * Close a port. Buffered bytes are still sent, waiting for the port to
+ * take them if necessary.
+ * \param port  The port.
+ */
+void
+lib_serial_close (SerialPort *port)
+{
+	if (port->fd >= 0) {
+		if (port->length > 0) {
+			fcntl(port->fd, F_SETFL, fcntl(port->fd, F_GETFL) & ~O_NONBLOCK);
+			(void) write(port->fd, port->buf, port->length);
+		}
+		close(port->fd);
+		port->fd = -1;
+	}
+	free(port->buf);
+	port->buf = NULL;
+	port->length = port->size = 0;
+}
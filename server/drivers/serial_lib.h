@@ -0,0 +1,49 @@
+/** \file server/drivers/serial_lib.h
+ * Serial port access shared by the drivers for serial displays.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef SERIAL_LIB_H
+#define SERIAL_LIB_H
+
+#include <stddef.h>
+
+#ifndef LCD_H
+#include "lcd.h"
+#endif
+
+/** \name Options for lib_serial_open()
+ * @{ */
+#define LIB_SERIAL_PARITY_ODD	0x01	/**< Odd parity bit */
+#define LIB_SERIAL_PARITY_EVEN	0x02	/**< Even parity bit */
+/** @} */
+
+/** Most bytes kept for a port that does not take them */
+#define LIB_SERIAL_MAX_PENDING	65536
+
+/**
+ * A serial port with a write buffer. Drivers put everything a frame sends
+ * into the buffer with lib_serial_write(), and lib_serial_flush() writes
+ * it all at once at the end of their flush() function. The port does not
+ * block: what the port does not take yet is kept for the next flush.
+ */
+typedef struct lib_serial_port {
+	int fd;			/**< File descriptor; -1 if closed */
+	int baudrate;		/**< Speed of the line */
+	int bits;		/**< Bits on the line per byte */
+	unsigned char *buf;	/**< Bytes not written yet */
+	size_t length;		/**< Number of bytes in buf */
+	size_t size;		/**< Allocated size of buf */
+} SerialPort;
+
+int lib_serial_open (SerialPort *port, const char *device, int baudrate, int options);
+void lib_serial_write (SerialPort *port, const void *data, size_t length);
+int lib_serial_flush (Driver *drvthis, SerialPort *port);
+void lib_serial_close (SerialPort *port);
+
+#endif
@@ -0,0 +1,477 @@
+/** \file server/drivers/shm.c
+ * LCDd \c shm driver, publishing the display in shared memory.
+ *
+ * Web dashboards, video overlays and the like map the segment and mirror
+ * what LCDd shows, instead of scraping the output of another driver. The
+ * driver acts as a character display with 8 custom characters; each
+ * changed frame is written to the segment once, whatever the number of
+ * readers. See shm_frame.h for the layout and how to read it.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lcd.h"
+#include "lcd_lib.h"
+#include "shm.h"
+#include "shm_lib.h"
+#include "adv_bignum.h"
+#include "shared/report.h"
+
+
+#define SHM_CELLWIDTH		LCD_DEFAULT_CELLWIDTH
+#define SHM_CELLHEIGHT		LCD_DEFAULT_CELLHEIGHT
+
+/** private data for the \c shm driver */
+typedef struct shm_private_data {
+	int width;		/**< display width in characters */
+	int height;		/**< display height in characters */
+	char *framebuf;		/**< frame buffer */
+	CGmode ccmode;		/**< custom character mode in use */
+	unsigned char cc[LCD_SHM_CUSTOM_CHARS][SHM_CELLHEIGHT];	/**< custom characters */
+	int cc_changed;		/**< a custom character changed since the last flush */
+	int backlight;		/**< backlight state */
+	char name[256];		/**< name of the shared memory segment */
+	struct lcd_shm_frame *shm;	/**< the mapped segment */
+} PrivateData;
+
+
+/* Vars for the server core */
+MODULE_EXPORT char *api_version = API_VERSION;
+MODULE_EXPORT int stay_in_foreground = 0;
+MODULE_EXPORT int supports_multiple = 1;
+MODULE_EXPORT char *symbol_prefix = "shm_";
+
+
+/**
+ * Initialize the driver.
+ * \param drvthis  Pointer to driver structure.
+ * \retval 0       Success.
+ * \retval <0      Error.
+ */
+MODULE_EXPORT int
+shm_init (Driver *drvthis)
+{
+	PrivateData *p;
+	char buf[256];
+
+	/* Allocate and store private data */
+	p = (PrivateData *) calloc(1, sizeof(PrivateData));
+	if (p == NULL)
+		return -1;
+	if (drvthis->store_private_ptr(drvthis, p))
+		return -1;
+
+	p->ccmode = standard;
+	p->backlight = BACKLIGHT_ON;
+
+	/* Read display size from config file */
+	strncpy(buf, drvthis->config_get_string(drvthis->name, "Size", 0, SHM_DEFAULT_SIZE), sizeof(buf));
+	buf[sizeof(buf)-1] = '\0';
+	if ((sscanf(buf, "%dx%d", &p->width, &p->height) != 2)
+	    || (p->width <= 0) || (p->width > LCD_MAX_WIDTH)
+	    || (p->height <= 0) || (p->height > LCD_MAX_HEIGHT)) {
+		report(RPT_WARNING, "%s: cannot read Size: %s; using default %s",
+				drvthis->name, buf, SHM_DEFAULT_SIZE);
+		sscanf(SHM_DEFAULT_SIZE, "%dx%d", &p->width, &p->height);
+	}
+
+	/* Read the name of the segment */
+	strncpy(p->name, drvthis->config_get_string(drvthis->name, "Name", 0, SHM_DEFAULT_NAME), sizeof(p->name));
+	p->name[sizeof(p->name)-1] = '\0';
+	if (p->name[0] != '/') {
+		report(RPT_ERR, "%s: Name must start with a '/': %s", drvthis->name, p->name);
+		return -1;
+	}
+
+	p->framebuf = malloc(p->width * p->height);
+	if (p->framebuf == NULL) {
+		report(RPT_ERR, "%s: unable to create framebuffer", drvthis->name);
+		return -1;
+	}
+	memset(p->framebuf, ' ', p->width * p->height);
+
+	p->shm = lib_shm_create(p->name, LCD_SHM_TEXT, p->width * p->height);
+	if (p->shm == NULL)
+		return -1;
+
+	/* Publish the empty screen */
+	lib_shm_begin(p->shm);
+	p->shm->width = p->width;
+	p->shm->height = p->height;
+	p->shm->cellwidth = SHM_CELLWIDTH;
+	p->shm->cellheight = SHM_CELLHEIGHT;
+	p->shm->backlight = 1;
+	memcpy(LCD_SHM_DATA(p->shm), p->framebuf, p->width * p->height);
+	lib_shm_end(p->shm);
+
+	report(RPT_DEBUG, "%s: init() done, publishing in %s", drvthis->name, p->name);
+
+	return 0;
+}
+
+
+/**
+ * Close the driver (do necessary clean-up).
+ * \param drvthis  Pointer to driver structure.
+ */
+MODULE_EXPORT void
+shm_close (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	if (p != NULL) {
+		lib_shm_destroy(p->shm, p->name);
+
+		if (p->framebuf != NULL)
+			free(p->framebuf);
+
+		free(p);
+	}
+	drvthis->store_private_ptr(drvthis, NULL);
+}
+
+
+/**
+ * Return the display width in characters.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Number of characters the display is wide.
+ */
+MODULE_EXPORT int
+shm_width (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	return p->width;
+}
+
+
+/**
+ * Return the display height in characters.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Number of characters the display is high.
+ */
+MODULE_EXPORT int
+shm_height (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	return p->height;
+}
+
+
+/**
+ * Return the width of a character in pixels.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Number of pixel columns a character cell is wide.
+ */
+MODULE_EXPORT int
+shm_cellwidth (Driver *drvthis)
+{
+	return SHM_CELLWIDTH;
+}
+
+
+/**
+ * Return the height of a character in pixels.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Number of pixel lines a character cell is high.
+ */
+MODULE_EXPORT int
+shm_cellheight (Driver *drvthis)
+{
+	return SHM_CELLHEIGHT;
+}
+
+
+/**
+ * Clear the screen.
+ * \param drvthis  Pointer to driver structure.
+ */
+MODULE_EXPORT void
+shm_clear (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+
+	memset(p->framebuf, ' ', p->width * p->height);
+	p->ccmode = standard;
+}
+
+
+/**
+ * Publish the frame, unless it is the one the segment holds already.
+ * \param drvthis  Pointer to driver structure.
+ */
+MODULE_EXPORT void
+shm_flush (Driver *drvthis)
+{
+	PrivateData *p = drvthis->private_data;
+	struct lcd_shm_frame *f = p->shm;
+	unsigned int backlight = (p->backlight == BACKLIGHT_ON) ? 1 : 0;
+
+	/* only the server writes the segment, so it can be compared unlocked */
+	if (!p->cc_changed && (f->backlight == backlight)
+	    && (memcmp(LCD_SHM_DATA(f), p->framebuf, p->width * p->height) == 0))
+		return;
+
+	lib_shm_begin(f);
+	memcpy(LCD_SHM_DATA(f), p->framebuf, p->width * p->height);
+	if (p->cc_changed)
+		memcpy(f->cc, p->cc, sizeof(f->cc));
+	f->backlight = backlight;
+	lib_shm_end(f);
+
+	p->cc_changed = 0;
+}
+
+
+/**
+ * Print a string on the screen at position (x,y).
+ * The upper-left corner is (1,1), the lower-right corner is (p->width, p->height).
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column).
+ * \param y        Vertical character position (row).
+ * \param string   String that gets written.
+ */
+MODULE_EXPORT void
+shm_string (Driver *drvthis, int x, int y, const char string[])
+{
+	PrivateData *p = drvthis->private_data;
+	int i;
+
+	x--;
+	y--;
+	if ((y < 0) || (y >= p->height))
+		return;
+
+	for (i = 0; (string[i] != '\0') && (x < p->width); i++, x++) {
+		if (x >= 0)
+			p->framebuf[(y * p->width) + x] = string[i];
+	}
+}
+
+
+/**
+ * Print a character on the screen at position (x,y).
+ * The upper-left corner is (1,1), the lower-right corner is (p->width, p->height).
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column).
+ * \param y        Vertical character position (row).
+ * \param c        Character that gets written.
+ */
+MODULE_EXPORT void
+shm_chr (Driver *drvthis, int x, int y, char c)
+{
+	PrivateData *p = drvthis->private_data;
+
+	x--;
+	y--;
+	if ((x >= 0) && (y >= 0) && (x < p->width) && (y < p->height))
+		p->framebuf[(y * p->width) + x] = c;
+}
+
+
+/**
+ * Draw a vertical bar bottom-up.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column) of the starting point.
+ * \param y        Vertical character position (row) of the starting point.
+ * \param len      Number of characters that the bar is high at 100%
+ * \param promille Current height level of the bar in promille.
+ * \param options  Options (currently unused).
+ */
+MODULE_EXPORT void
+shm_vbar (Driver *drvthis, int x, int y, int len, int promille, int options)
+{
+	PrivateData *p = drvthis->private_data;
+
+	if (p->ccmode != vbar) {
+		unsigned char vBar[SHM_CELLHEIGHT];
+		int i;
+
+		if (p->ccmode != standard) {
+			/* Not supported(yet) */
+			report(RPT_WARNING, "%s: vbar: cannot combine two modes using user-defined characters",
+					drvthis->name);
+			return;
+		}
+		p->ccmode = vbar;
+
+		memset(vBar, 0x00, sizeof(vBar));
+		for (i = 1; i < SHM_CELLHEIGHT; i++) {
+			/* add pixel line per pixel line ... */
+			vBar[SHM_CELLHEIGHT - i] = 0x1F;
+			shm_set_char(drvthis, i, vBar);
+		}
+	}
+
+	lib_vbar_static(drvthis, x, y, len, promille, options, SHM_CELLHEIGHT, 0);
+}
+
+
+/**
+ * Draw a horizontal bar to the right.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column) of the starting point.
+ * \param y        Vertical character position (row) of the starting point.
+ * \param len      Number of characters that the bar is long at 100%
+ * \param promille Current length level of the bar in promille.
+ * \param options  Options (currently unused).
+ */
+MODULE_EXPORT void
+shm_hbar (Driver *drvthis, int x, int y, int len, int promille, int options)
+{
+	PrivateData *p = drvthis->private_data;
+
+	if (p->ccmode != hbar) {
+		unsigned char hBar[SHM_CELLHEIGHT];
+		int i;
+
+		if (p->ccmode != standard) {
+			/* Not supported(yet) */
+			report(RPT_WARNING, "%s: hbar: cannot combine two modes using user-defined characters",
+					drvthis->name);
+			return;
+		}
+		p->ccmode = hbar;
+
+		for (i = 1; i <= SHM_CELLWIDTH; i++) {
+			/* fill pixel columns from left to right. */
+			memset(hBar, 0x1F & ~((1 << (SHM_CELLWIDTH - i)) - 1), sizeof(hBar));
+			shm_set_char(drvthis, i, hBar);
+		}
+	}
+
+	lib_hbar_static(drvthis, x, y, len, promille, options, SHM_CELLWIDTH, 0);
+}
+
+
+/**
+ * Write a big number to the screen.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column).
+ * \param num      Character to write (0 - 10 with 10 representing ':')
+ */
+MODULE_EXPORT void
+shm_num (Driver *drvthis, int x, int num)
+{
+	PrivateData *p = drvthis->private_data;
+	int do_init = 0;
+
+	if ((num < 0) || (num > 10))
+		return;
+
+	if (p->ccmode != bignum) {
+		if (p->ccmode != standard) {
+			/* Not supported (yet) */
+			report(RPT_WARNING, "%s: num: cannot combine two modes using user-defined characters",
+					drvthis->name);
+			return;
+		}
+		p->ccmode = bignum;
+		do_init = 1;
+	}
+
+	lib_adv_bignum(drvthis, x, num, 0, do_init);
+}
+
+
+/**
+ * Place an icon on the screen. Only the full block is drawn here, as
+ * character 255; the core draws the others.
+ * \param drvthis  Pointer to driver structure.
+ * \param x        Horizontal character position (column).
+ * \param y        Vertical character position (row).
+ * \param icon     synbolic value representing the icon.
+ * \retval 0       Icon has been successfully defined/written.
+ * \retval <0      Server core shall define/write the icon.
+ */
+MODULE_EXPORT int
+shm_icon (Driver *drvthis, int x, int y, int icon)
+{
+	if (icon != ICON_BLOCK_FILLED)
+		return -1;
+
+	shm_chr(drvthis, x, y, 255);
+	return 0;
+}
+
+
+/**
+ * Define a custom character. It is published with the next frame.
+ * \param drvthis  Pointer to driver structure.
+ * \param n        Custom character to define [0 - 7].
+ * \param dat      Array of 8 (=cellheight) bytes, each representing a pixel row
+ *                 starting from the top to bottom.
+ *                 The bits in each byte represent the pixels where the LSB
+ *                 (least significant bit) is the rightmost pixel in each pixel row.
+ */
+MODULE_EXPORT void
+shm_set_char (Driver *drvthis, int n, unsigned char *dat)
+{
+	PrivateData *p = drvthis->private_data;
+	int row;
+
+	if ((n < 0) || (n >= LCD_SHM_CUSTOM_CHARS) || (dat == NULL))
+		return;
+
+	for (row = 0; row < SHM_CELLHEIGHT; row++) {
+		unsigned char bits = dat[row] & 0x1F;
+
+		if (p->cc[n][row] != bits) {
+			p->cc[n][row] = bits;
+			p->cc_changed = 1;
+		}
+	}
+}
+
+
+/**
+ * Get total number of custom characters available.
+ * \param drvthis  Pointer to driver structure.
+ * \return  Number of custom characters.
+ */
+MODULE_EXPORT int
+shm_get_free_chars (Driver *drvthis)
+{
+	return LCD_SHM_CUSTOM_CHARS;
+}
+
+
+/**
+ * Turn the backlight on or off; readers see it in the next frame.
+ * \param drvthis  Pointer to driver structure.
+ * \param on       New backlight status.
+ */
+MODULE_EXPORT void
+shm_backlight (Driver *drvthis, int on)
+{
+	PrivateData *p = drvthis->private_data;
+
+	p->backlight = on;
+}
+
+
+/**
+ * Provide some information about this driver.
+ * \param drvthis  Pointer to driver structure.
+ * \return         Constant string with information.
+ */
+MODULE_EXPORT const char *
+shm_get_info (Driver *drvthis)
+{
+	static char *info_string = "Shared memory export driver";
+
+	return info_string;
+}
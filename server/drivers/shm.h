@@ -0,0 +1,28 @@
+#ifndef LCD_SHM_H
+#define LCD_SHM_H
+
+MODULE_EXPORT int  shm_init (Driver *drvthis);
+MODULE_EXPORT void shm_close (Driver *drvthis);
+MODULE_EXPORT int  shm_width (Driver *drvthis);
+MODULE_EXPORT int  shm_height (Driver *drvthis);
+MODULE_EXPORT int  shm_cellwidth (Driver *drvthis);
+MODULE_EXPORT int  shm_cellheight (Driver *drvthis);
+MODULE_EXPORT void shm_clear (Driver *drvthis);
+MODULE_EXPORT void shm_flush (Driver *drvthis);
+MODULE_EXPORT void shm_string (Driver *drvthis, int x, int y, const char string[]);
+MODULE_EXPORT void shm_chr (Driver *drvthis, int x, int y, char c);
+
+MODULE_EXPORT void shm_vbar (Driver *drvthis, int x, int y, int len, int promille, int options);
+MODULE_EXPORT void shm_hbar (Driver *drvthis, int x, int y, int len, int promille, int options);
+MODULE_EXPORT void shm_num (Driver *drvthis, int x, int num);
+MODULE_EXPORT int  shm_icon (Driver *drvthis, int x, int y, int icon);
+MODULE_EXPORT void shm_set_char (Driver *drvthis, int n, unsigned char *dat);
+MODULE_EXPORT int  shm_get_free_chars (Driver *drvthis);
+
+MODULE_EXPORT void shm_backlight (Driver *drvthis, int on);
+MODULE_EXPORT const char *shm_get_info (Driver *drvthis);
+
+#define SHM_DEFAULT_SIZE	"20x4"
+#define SHM_DEFAULT_NAME	"/lcdproc"
+
+#endif
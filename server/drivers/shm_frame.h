@@ -0,0 +1,81 @@
+/** \file server/drivers/shm_frame.h
+ * Layout of the shared memory segments the \c shm driver and the glcd
+ * driver's \c shm connection type publish the display content in.
+ *
+ * A segment starts with struct lcd_shm_frame, the frame data follows at
+ * data_offset. The header and data are updated under a sequence lock:
+ * \c seq is odd while the server writes a frame and even otherwise. A
+ * reader copies what it needs and retries if \c seq was odd or changed
+ * meanwhile:
+ *
+ * \code
+ * do {
+ *	s1 = __atomic_load_n(&f->seq, __ATOMIC_ACQUIRE);
+ *	memcpy(copy, LCD_SHM_DATA(f), f->data_size);
+ *	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+ *	s2 = __atomic_load_n(&f->seq, __ATOMIC_RELAXED);
+ * } while ((s1 & 1) || (s1 != s2));
+ * \endcode
+ *
+ * On Linux the server wakes all waiters of the futex at \c seq after each
+ * frame, so readers can sleep in FUTEX_WAIT on the even value they saw
+ * instead of polling. When the server stops, \c state becomes
+ * LCD_SHM_CLOSED; a new server creates a new segment, so readers open the
+ * name again then.
+ *
+ * This header is meant to be copied into programs reading the segments;
+ * besides <stdint.h> it has no dependencies.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef SHM_FRAME_H
+#define SHM_FRAME_H
+
+#include <stdint.h>
+
+#define LCD_SHM_MAGIC		0x4644434cUL	/* "LCDF" on little-endian hosts */
+#define LCD_SHM_VERSION		1
+
+/* Frame types */
+#define LCD_SHM_TEXT		1	/* characters: width * height bytes */
+#define LCD_SHM_PIXELS		2	/* pixel rows of bytes_per_line bytes */
+
+/* Segment states */
+#define LCD_SHM_LIVE		0	/* the server updates the segment */
+#define LCD_SHM_CLOSED		1	/* the server stopped using it */
+
+#define LCD_SHM_CUSTOM_CHARS	8	/* custom characters of text frames */
+
+/** Header of a published frame */
+struct lcd_shm_frame {
+	uint32_t magic;		/**< LCD_SHM_MAGIC */
+	uint16_t version;	/**< LCD_SHM_VERSION */
+	uint16_t type;		/**< LCD_SHM_TEXT or LCD_SHM_PIXELS */
+	uint32_t seq;		/**< sequence lock, odd while a frame is written */
+	uint32_t state;		/**< LCD_SHM_LIVE or LCD_SHM_CLOSED */
+	uint32_t frames;	/**< number of frames published so far */
+	uint32_t width;		/**< width in characters or pixels */
+	uint32_t height;	/**< height in characters or pixels */
+	uint32_t cellwidth;	/**< character cell width in pixels */
+	uint32_t cellheight;	/**< character cell height in pixels */
+	uint32_t bpp;		/**< pixel frames: bits per pixel, MSB first;
+				 *   0 is blank, the highest value fully set */
+	uint32_t bytes_per_line; /**< pixel frames: bytes per pixel row */
+	uint32_t backlight;	/**< 1 if the backlight is on */
+	uint32_t data_offset;	/**< offset of the frame from the segment start */
+	uint32_t data_size;	/**< size of the frame in bytes */
+	/** Text frames: pixel rows of the characters 0 to 7, top row first,
+	 *  the rightmost pixel in the LSB. Characters 255 are full blocks,
+	 *  all others are the ISO-8859-1 characters the clients sent. */
+	unsigned char cc[LCD_SHM_CUSTOM_CHARS][8];
+};
+
+/** Start of the frame data of a segment */
+#define LCD_SHM_DATA(f)		((unsigned char *) (f) + (f)->data_offset)
+
+#endif
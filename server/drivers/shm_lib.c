@@ -0,0 +1,150 @@
+/** \file server/drivers/shm_lib.c
+ * Publishing frames in POSIX shared memory.
+ *
+ * Any number of programs can map a segment and mirror the display without
+ * the server doing anything for them: it writes each changed frame once,
+ * under a sequence lock, and readers never block it. On Linux the readers
+ * can sleep on the sequence counter with a futex until the next frame.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_SHM_OPEN
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef HAVE_LINUX_FUTEX_H
+# include <linux/futex.h>
+# include <sys/syscall.h>
+#endif
+
+#include "shm_lib.h"
+#include "shared/report.h"
+
+
+/* Size of the header, rounded up so that the frame data is aligned */
+#define SHM_DATA_OFFSET	((sizeof(struct lcd_shm_frame) + 63) & ~(size_t) 63)
+
+
+/* Wake the readers waiting for the sequence counter to change */
+static void
+lib_shm_wake (struct lcd_shm_frame *frame)
+{
+#ifdef HAVE_LINUX_FUTEX_H
+	syscall(SYS_futex, &frame->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+
+/**
+ * Create a shared memory segment for publishing frames. A segment left by
+ * an earlier server is removed first: its readers keep their mapping of
+ * it, see that it is closed and open the new one.
+ * \param name       Name of the segment, e.g. "/lcdproc".
+ * \param type       LCD_SHM_TEXT or LCD_SHM_PIXELS.
+ * \param data_size  Size of a frame in bytes.
+ * \return  The segment's header, with the frame cleared; NULL on error.
+ */
+struct lcd_shm_frame *
+lib_shm_create (const char *name, int type, size_t data_size)
+{
+	struct lcd_shm_frame *frame;
+	size_t size = SHM_DATA_OFFSET + data_size;
+	int fd;
+
+	shm_unlink(name);
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0) {
+		report(RPT_ERR, "cannot create shared memory %s: %s", name, strerror(errno));
+		return NULL;
+	}
+	/* readable for everyone, whatever the umask */
+	fchmod(fd, 0644);
+	if (ftruncate(fd, size) < 0) {
+		report(RPT_ERR, "cannot resize shared memory %s: %s", name, strerror(errno));
+		close(fd);
+		shm_unlink(name);
+		return NULL;
+	}
+	frame = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (frame == MAP_FAILED) {
+		report(RPT_ERR, "cannot map shared memory %s: %s", name, strerror(errno));
+		shm_unlink(name);
+		return NULL;
+	}
+
+	/* a new segment is all zeros; readers check the magic number last */
+	frame->version = LCD_SHM_VERSION;
+	frame->type = type;
+	frame->state = LCD_SHM_LIVE;
+	frame->data_offset = SHM_DATA_OFFSET;
+	frame->data_size = data_size;
+	__atomic_store_n(&frame->magic, LCD_SHM_MAGIC, __ATOMIC_RELEASE);
+	return frame;
+}
+
+
+/**
+ * Start writing a frame. Readers copying it meanwhile retry.
+ * \param frame  The segment's header.
+ */
+void
+lib_shm_begin (struct lcd_shm_frame *frame)
+{
+	__atomic_store_n(&frame->seq, frame->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+
+/**
+ * Finish writing a frame and wake the readers waiting for it.
+ * \param frame  The segment's header.
+ */
+void
+lib_shm_end (struct lcd_shm_frame *frame)
+{
+	frame->frames++;
+	__atomic_store_n(&frame->seq, frame->seq + 1, __ATOMIC_RELEASE);
+	lib_shm_wake(frame);
+}
+
+
+/**
+ * Tell the readers that the segment is no longer updated, unmap it and
+ * remove its name.
+ * \param frame  The segment's header; may be NULL.
+ * \param name   Name it was created with.
+ */
+void
+lib_shm_destroy (struct lcd_shm_frame *frame, const char *name)
+{
+	if (frame == NULL)
+		return;
+
+	lib_shm_begin(frame);
+	frame->state = LCD_SHM_CLOSED;
+	__atomic_store_n(&frame->seq, frame->seq + 1, __ATOMIC_RELEASE);
+	lib_shm_wake(frame);
+
+	munmap(frame, frame->data_offset + frame->data_size);
+	/* fails if LCDd dropped root privileges; the segment stays,
+	 * marked closed, until the next server replaces it */
+	shm_unlink(name);
+}
+
+#endif /* HAVE_SHM_OPEN */
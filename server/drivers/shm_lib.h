@@ -0,0 +1,30 @@
+/** \file server/drivers/shm_lib.h
+ * Publishing frames in shared memory, for the drivers that export what
+ * LCDd shows to other programs (see shm_frame.h for the layout).
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef SHM_LIB_H
+#define SHM_LIB_H
+
+#include <stddef.h>
+
+#include "shm_frame.h"
+
+/* Create a segment for frames of data_size bytes of the given type. */
+struct lcd_shm_frame *lib_shm_create (const char *name, int type, size_t data_size);
+
+/* Start and finish writing a frame: readers retry while it is written
+ * and are woken when it is done. */
+void lib_shm_begin (struct lcd_shm_frame *frame);
+void lib_shm_end (struct lcd_shm_frame *frame);
+
+/* Mark a segment closed, unmap it and remove its name. */
+void lib_shm_destroy (struct lcd_shm_frame *frame, const char *name);
+
+#endif
@@ -0,0 +1,147 @@
+#!/bin/sh
+#
+# Link the drivers that configure --enable-static-drivers puts into LCDd.
+#
+# static-link.sh "<static drivers>" "<partial link command>" <link command>
+#	Used as the link command of all drivers. A driver not in the list
+#	is linked by <link command> as a module. A driver in the list is
+#	linked by <partial link command> into a relocatable object instead,
+#	and all its global symbols except the entries of the driver API are
+#	made local, so drivers defining the same names do not clash in
+#	LCDd. The archives and libraries it needs are kept in a <driver>.libs
+#	file next to it.
+#
+# static-link.sh --registry <output> <drivers>
+#	Write the table of the drivers' API entries that the server binds
+#	them with (see server/static_drivers.h) to <output>.c, and the
+#	archives and libraries they need to <output>.libs.
+#
+# This file is part of LCDd, the lcdproc server.
+#
+# This file is released under the GNU General Public License.
+# Refer to the COPYING file distributed with this package.
+
+NM=${NM:-nm}
+OBJCOPY=${OBJCOPY:-objcopy}
+srcdir=`dirname "$0"`
+
+# Names of the driver API entries, from the table the server binds them with
+api=`sed -n 's/^	{ "\([a-z_]*\)",.*offsetof(Driver,.*/\1/p' "$srcdir/../driver.c" | tr '\n' '|'`
+api=${api%|}
+
+# Global symbols an object defines
+defined ()
+{
+	$NM -g "$1" | awk 'NF == 3 && $2 !~ /[Uw]/ { print $3 }'
+}
+
+# The driver's name: its file name without extension
+driver_name ()
+{
+	name=`basename "$1"`
+	echo "${name%.*}"
+}
+
+
+if test "x$1" = "x--registry"; then
+	out=$2
+	shift 2
+
+	{
+		echo "/* Generated by static-link.sh. Do not edit. */"
+		echo
+		echo "#include \"server/static_drivers.h\""
+		echo
+		for obj in "$@"; do
+			for sym in `defined "$obj"`; do
+				echo "extern char $sym;"
+			done
+		done
+		for obj in "$@"; do
+			name=`driver_name "$obj"`
+			echo
+			echo "static const StaticSymbol ${name}_symbols[] = {"
+			for sym in `defined "$obj"`; do
+				echo "	{ \"${sym#static_${name}_}\", &$sym },"
+			done
+			echo "	{ NULL, NULL }"
+			echo "};"
+		done
+		echo
+		echo "const StaticDriver static_drivers[] = {"
+		for obj in "$@"; do
+			name=`driver_name "$obj"`
+			echo "	{ \"$name\", ${name}_symbols },"
+		done
+		echo "	{ NULL, NULL }"
+		echo "};"
+	} > "$out.c" || exit 1
+
+	for obj in "$@"; do
+		cat "${obj%.*}.libs"
+	done > "$out.libs"
+	exit $?
+fi
+
+
+static=$1
+partial=$2
+shift 2
+
+out=
+prev=
+for arg in "$@"; do
+	test "x$prev" = "x-o" && out=$arg
+	prev=$arg
+done
+
+case " $static " in
+	*" $out "*)
+		;;
+	*)
+		exec "$@"
+		;;
+esac
+
+# Sort the inputs after "-o <output>" into objects and libraries
+objs=
+libs=
+seen=no
+prev=
+for arg in "$@"; do
+	if test $seen = no; then
+		test "x$prev" = "x-o" && seen=yes
+		prev=$arg
+		continue
+	fi
+	case $arg in
+		*.o)
+			objs="$objs $arg"
+			;;
+		/*.a|/*.so|/*.so.*)
+			libs="$libs $arg"
+			;;
+		*.a)
+			libs="$libs `pwd`/$arg"
+			;;
+		-l*|-L*|-Wl,*|-pthread)
+			libs="$libs $arg"
+			;;
+	esac
+done
+
+name=`driver_name "$out"`
+tmp="$out.tmp"
+trap 'rm -f "$tmp" "$tmp.keep" "$tmp.rename"' 0
+rm -f "$out"
+
+$partial -o "$tmp" $objs || exit 1
+
+# The API entries stay global; those without a prefix get the driver's name
+defined "$tmp" | grep -E "^(.*_)?($api)\$" > "$tmp.keep"
+grep -E "^($api)\$" "$tmp.keep" | sed "s/.*/& static_${name}_&/" > "$tmp.rename"
+
+$OBJCOPY --keep-global-symbols="$tmp.keep" "$tmp" || exit 1
+$OBJCOPY --redefine-syms="$tmp.rename" "$tmp" || exit 1
+echo $libs > "${out%.*}.libs" || exit 1
+mv "$tmp" "$out"
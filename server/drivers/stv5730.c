@@ -85,6 +85,7 @@ typedef struct stv5730_private_data {
     unsigned int charattrib;
     unsigned int flags;
     char *framebuf;
+    char *backingstore;		/**< What the stv5730 shows */
 } PrivateData;
 
 
@@ -170,98 +171,72 @@ stv5730_is_mute (unsigned int port)
 }
 
 /////////////////////////////////////////////////////////////////
-// stv5730_write16bit, stv5730_write8bit, stv5730_write0bit
-// this family of functions write commands or data to the stv5730
-// 8 bit writes repeat the high byte, 0 byte writes repeat the last
-// written word
+// stv5730_seq_word, stv5730_seq_out
+// A write to the stv5730 is a sequence of port states: CSN low, the
+// bits clocked in MSB first, CSN high. The states of one or more writes
+// are put in a table first and then sent in one loop, each after
+// IODELAY, so the bits are not worked out between the port writes.
+// 8 bit writes repeat the high byte, 0 bit writes repeat the last
+// written word.
+
+/** Number of port states of a 16 bit write, a row needs less than
+ * STV5730_WID of them */
+#define STV5730_SEQ_WORD	(5 + 16 * 3)
+
+/** Port states of some writes to the stv5730 */
+typedef struct {
+    unsigned char state[STV5730_WID * STV5730_SEQ_WORD];
+    int len;
+} STV5730Seq;
+
 static void
-stv5730_write16bit (unsigned int port, unsigned int flags, unsigned int value)
+stv5730_seq_word (STV5730Seq *seq, unsigned int flags, unsigned int value, int bits)
 {
+    unsigned char *s = seq->state + seq->len;
     int i;
 
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CSN + flags);
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CSN + STV5730_CLK + flags);
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CLK + flags);
+    *s++ = STV5730_CSN + flags;
+    *s++ = STV5730_CSN + STV5730_CLK + flags;
+    *s++ = STV5730_CLK + flags;
 
-    for (i = 15; i >= 0; i--) {
-	char databit = ((value & (1 << i)) != 0) ? STV5730_DATA : 0;
+    for (i = bits - 1; i >= 0; i--) {
+	unsigned char databit = ((value & (1 << i)) != 0) ? STV5730_DATA : 0;
 
-	port_out(port, databit + STV5730_CLK + flags);
-	stv5730_upause(IODELAY);
-	port_out(port, databit + flags);
-	stv5730_upause(IODELAY);
-	port_out(port, databit + STV5730_CLK + flags);
-	stv5730_upause(IODELAY);
+	*s++ = databit + STV5730_CLK + flags;
+	*s++ = databit + flags;
+	*s++ = databit + STV5730_CLK + flags;
     }
 
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CSN + STV5730_CLK + flags);
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CSN + flags);
-    stv5730_upause(IODELAY);
+    *s++ = STV5730_CSN + STV5730_CLK + flags;
+    *s++ = STV5730_CSN + flags;
+    seq->len = s - seq->state;
 }
 
 static void
-stv5730_write8bit (unsigned int port, unsigned int flags, unsigned int value)
+stv5730_seq_out (unsigned int port, STV5730Seq *seq)
 {
-    int i;
-
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CSN + flags);
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CSN + STV5730_CLK + flags);
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CLK + flags);
+    const unsigned char *s = seq->state;
+    const unsigned char *end = seq->state + seq->len;
 
-    for (i = 7; i >= 0; i--) {
-	char databit = ((value & (1 << i)) != 0) ? STV5730_DATA : 0;
-
-	port_out(port, databit + STV5730_CLK + flags);
-	stv5730_upause(IODELAY);
-	port_out(port, databit + flags);
-	stv5730_upause(IODELAY);
-	port_out(port, databit + STV5730_CLK + flags);
+    while (s < end) {
 	stv5730_upause(IODELAY);
+	port_out(port, *s++);
     }
-
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CSN + STV5730_CLK + flags);
     stv5730_upause(IODELAY);
-    port_out(port, STV5730_CSN + flags);
+    seq->len = 0;
 }
 
 static void
-stv5730_write0bit (unsigned int port, unsigned int flags)
+stv5730_write16bit (unsigned int port, unsigned int flags, unsigned int value)
 {
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CSN + flags);
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CSN + STV5730_CLK + flags);
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CLK + flags);
+    STV5730Seq seq;
 
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CSN + STV5730_CLK + flags);
-    stv5730_upause(IODELAY);
-    port_out(port, STV5730_CSN + flags);
+    seq.len = 0;
+    stv5730_seq_word(&seq, flags, value, 16);
+    stv5730_seq_out(port, &seq);
 }
 
 
-/////////////////////////////////////////////////////////////////
-// sets the memory pointer inside the stv5730 to the position
-// row, col.
-static void
-stv5730_locate (unsigned int port, unsigned int flags, int row, int col)
-{
-    if (row < 0 || row >= STV5730_HGT || col < 0 || col >= STV5730_WID)
-	return;
-
-    stv5730_write16bit(port, flags, (row << 8) + col);
-}
-
 /////////////////////////////////////////////////////////////////
 // draws  char z from fontmap to the framebuffer at position
 // x,y. These are zero-based textmode positions.
@@ -406,6 +381,15 @@ stv5730_init (Driver *drvthis)
     // clear screen
     memset(p->framebuf, 0, STV5730_WID * STV5730_HGT);
 
+    // The stv5730's memory is unknown, so the first flush writes all rows
+    p->backingstore = malloc(STV5730_WID * STV5730_HGT);
+    if (p->backingstore == NULL) {
+	  report(RPT_ERR, "%s: unable to allocate backing store", drvthis->name);
+	  stv5730_close(drvthis);
+	  return -1;
+    }
+    memset(p->backingstore, 0xFF, STV5730_WID * STV5730_HGT);
+
     report(RPT_DEBUG, "%s: init() done", drvthis->name);
 
     return 0;
@@ -422,6 +406,8 @@ stv5730_close (Driver *drvthis)
     if (p != NULL) {
 	if (p->framebuf != NULL)
 	    free(p->framebuf);
+	if (p->backingstore != NULL)
+	    free(p->backingstore);
 
 	free(p);
     }
@@ -487,24 +473,33 @@ MODULE_EXPORT void
 stv5730_flush (Driver *drvthis)
 {
     PrivateData *p = drvthis->private_data;
+    STV5730Seq seq;
     int i, j, atr;
 
-    stv5730_locate(p->port, p->flags, 0, 0);
-
+    // Only rows that changed are written, each starting at its first column
+    seq.len = 0;
     for (i = 0; i < STV5730_HGT; i++) {
+	char *row = p->framebuf + (i * STV5730_WID);
+
+	if (memcmp(row, p->backingstore + (i * STV5730_WID), STV5730_WID) == 0)
+	    continue;
+	memcpy(p->backingstore + (i * STV5730_WID), row, STV5730_WID);
+
 	if (i == 0)
 	    atr = (STV5730_COL_FLINE << 8);
 	else
 	    atr = (STV5730_COL_TEXT << 8);
-	stv5730_write16bit(p->port, p->flags, 0x1000 + atr + p->framebuf[i * STV5730_WID] +
-			      p->charattrib);
+	// set the memory pointer to the row, then write the first character
+	stv5730_seq_word(&seq, p->flags, (i << 8), 16);
+	stv5730_seq_word(&seq, p->flags, 0x1000 + atr + row[0] + p->charattrib, 16);
+
 	for (j = 1; j < STV5730_WID; j++) {
-	    if (p->framebuf[j + (i * STV5730_WID) - 1] !=
-		p->framebuf[j + (i * STV5730_WID)])
-		stv5730_write8bit(p->port, p->flags, p->framebuf[j + (i * STV5730_WID)]);
+	    if (row[j - 1] != row[j])
+		stv5730_seq_word(&seq, p->flags, row[j], 8);
 	    else
-		stv5730_write0bit(p->port, p->flags);
+		stv5730_seq_word(&seq, p->flags, 0, 0);
 	}
+	stv5730_seq_out(p->port, &seq);
     }
 }
 
@@ -1,5 +1,10 @@
 /** \file server/drivers/svgalib_drv.c
  * LCDd \c svga driver for displaying on SVGA screens.
+ *
+ * The output functions only fill a buffer of characters. On flush, the
+ * runs of cells that differ from the screen are drawn into an offscreen
+ * copy of it, and just the boxes of those runs are copied to the screen,
+ * so the screen is neither cleared nor redrawn at frame rate.
  */
 
 /*-
@@ -242,6 +247,7 @@ svga_init (Driver *drvthis)
 	p->contrast = DEFAULT_CONTRAST;
 	p->brightness = DEFAULT_BRIGHTNESS;
 	p->offbrightness = DEFAULT_OFFBRIGHTNESS;
+	p->fontcolor = -1;
 
 	debug(RPT_DEBUG, "%s(%p)", __FUNCTION__, drvthis);
 
@@ -336,11 +342,35 @@ svga_init (Driver *drvthis)
 	p->xoffs = p->cellwidth + (modeinfo->width - p->width * p->cellwidth) / 2;
 	p->yoffs = p->cellheight + (modeinfo->height - p->height * p->cellheight) / 2;
 
+	/* the characters to draw, and those on the screen */
+	p->framebuf = malloc(p->width * p->height);
+	p->shown = malloc(p->width * p->height);
+	if ((p->framebuf == NULL) || (p->shown == NULL)) {
+		report(RPT_ERR, "%s: unable to create framebuffer", drvthis->name);
+		return -1;
+	}
+	memset(p->framebuf, ' ', p->width * p->height);
+	memset(p->shown, ' ', p->width * p->height);
+
 	if (vga_setmode (p->mode) < 0) {
 		report(RPT_ERR, "%s: unable to switch to mode %s", drvthis->name, modestr);
 		return -1;
 	}
 	gl_setcontextvga(p->mode);	/* Physical screen context. */
+	gl_clearscreen(0);
+	p->physical = gl_allocatecontext();
+	p->offscreen = gl_allocatecontext();
+	if ((p->physical == NULL) || (p->offscreen == NULL)) {
+		report(RPT_ERR, "%s: unable to allocate graphics contexts", drvthis->name);
+		return -1;
+	}
+	gl_getcontext(p->physical);
+	/* everything is drawn offscreen, and copied to the screen on flush */
+	if (gl_setcontextvgavirtual(p->mode) < 0) {
+		report(RPT_ERR, "%s: unable to allocate offscreen context", drvthis->name);
+		return -1;
+	}
+	gl_getcontext(p->offscreen);
 	gl_setrgbpalette();
 
 	/* allocate space, expand and install the font */
@@ -355,7 +385,9 @@ svga_init (Driver *drvthis)
 		tmp = 1;
 	ExpandGroovyFont(p->cellwidth, p->cellheight, gl_rgbcolor(tmp, tmp, tmp), simple_font6x8, p->font);
 	gl_setfont(p->cellwidth, p->cellheight, p->font);
+	p->fontcolor = tmp;
 
+	/* the offscreen copy starts out black like the screen, as blanks */
 	gl_clearscreen(gl_rgbcolor (0, 0, 0));
 
 	report(RPT_DEBUG, "%s: init() done", drvthis->name);
@@ -379,6 +411,21 @@ svga_close (Driver *drvthis)
 			free(p->font);
 		p->font = NULL;
 
+		if (p->framebuf != NULL)
+			free(p->framebuf);
+		if (p->shown != NULL)
+			free(p->shown);
+		if (p->offscreen != NULL) {
+			/* the virtual screen gl_setcontextvgavirtual() allocated */
+			if (p->offscreen->vbuf != NULL)
+				free(p->offscreen->vbuf);
+			gl_freecontext(p->offscreen);
+		}
+		if (p->physical != NULL) {
+			gl_setcontext(p->physical);
+			gl_freecontext(p->physical);
+		}
+
 		free(p);
 	}
 	drvthis->store_private_ptr(drvthis, NULL);
@@ -441,20 +488,49 @@ svga_cellheight (Driver *drvthis)
 MODULE_EXPORT void
 svga_clear (Driver *drvthis)
 {
+	PrivateData *p = drvthis->private_data;
+
 	debug(RPT_DEBUG, "%s(%p)", __FUNCTION__, drvthis);
 
-	//vga_waitretrace ();
-	gl_clearscreen(gl_rgbcolor(0, 0, 0));
+	memset(p->framebuf, ' ', p->width * p->height);
 }
 
 
 /**
- * Flush framebuffer to screen
+ * Flush framebuffer to screen: draw each run of changed cells offscreen
+ * and copy its box, cellheight scanlines high, to the screen.
  */
 MODULE_EXPORT void
 svga_flush (Driver *drvthis)
 {
-	/* It's already on the screen ! */
+	PrivateData *p = drvthis->private_data;
+	int x, y;
+
+	for (y = 0; y < p->height; y++) {
+		unsigned char *row = p->framebuf + y * p->width;
+		unsigned char *old = p->shown + y * p->width;
+		int ypix = (y + 1) * p->cellheight + p->yoffs;
+
+		x = 0;
+		while (x < p->width) {
+			int start, xpix;
+
+			if (!p->redraw && (row[x] == old[x])) {
+				x++;
+				continue;
+			}
+			start = x;
+			while ((x < p->width) && (p->redraw || (row[x] != old[x])))
+				x++;
+
+			xpix = (start + 1) * p->cellwidth + p->xoffs;
+			gl_writen(xpix, ypix, x - start, (char *) row + start);
+			gl_copyboxtocontext(xpix, ypix, (x - start) * p->cellwidth, p->cellheight,
+					    p->physical, xpix, ypix);
+		}
+		memcpy(old, row, p->width);
+	}
+	p->redraw = 0;
 }
 
 
@@ -466,18 +542,23 @@ MODULE_EXPORT void
 svga_string (Driver *drvthis, int x, int y, const char string[])
 {
 	PrivateData *p = drvthis->private_data;
-	char *buffer = strdup(string);
-	char *ptr;
+	int i;
 
 	debug(RPT_DEBUG, "%s(%p, %d, %d, \"%s\")", __FUNCTION__, drvthis, x, y, string);
 
-	for (ptr = buffer; *ptr != '\0'; ptr++) {
+	x--;			/* convert 1-based coords to 0-based */
+	y--;
+	if ((y < 0) || (y >= p->height))
+		return;
+
+	for (i = 0; (string[i] != '\0') && (x < p->width); i++, x++) {
+		unsigned char c = (unsigned char) string[i];
 
-		if ((unsigned char) *ptr == 255)	// TODO: Is this still necessary ?
-			*ptr = '#';
+		if (c == 255)	// TODO: Is this still necessary ?
+			c = '#';
+		if (x >= 0)
+			p->framebuf[y * p->width + x] = c;
 	}
-	gl_writen(x * p->cellwidth + p->xoffs, y * p->cellheight + p->yoffs, (ptr - buffer), buffer);
-	free(buffer);
 }
 
 
@@ -489,10 +570,14 @@ MODULE_EXPORT void
 svga_chr (Driver *drvthis, int x, int y, char c)
 {
 	PrivateData *p = drvthis->private_data;
-	char buffer[2];
 
 	debug(RPT_DEBUG, "%s(%p, %d, %d, \'%c\')", __FUNCTION__, drvthis, x, y, c);
 
+	x--;			/* convert 1-based coords to 0-based */
+	y--;
+	if ((x < 0) || (x >= p->width) || (y < 0) || (y >= p->height))
+		return;
+
 	switch ((unsigned char) c) {		// TODO: is this still necessary ?
 		case '\0':
 			c = icon_char;
@@ -501,9 +586,7 @@ svga_chr (Driver *drvthis, int x, int y, char c)
 			c = '#';
 			break;
 	}
-	buffer[0] = c;
-	buffer[1] = '\0';
-	gl_writen(x * p->cellwidth + p->xoffs, y * p->cellheight + p->yoffs, 1, buffer);
+	p->framebuf[y * p->width + x] = c;
 }
 
 
@@ -703,7 +786,11 @@ svga_backlight (Driver *drvthis, int on)
 	if (value <= 0)
 		value = 1;
 
-	/* set font color */
-	gl_colorfont(p->cellwidth, p->cellheight, gl_rgbcolor(value, value, value), p->font);
+	/* set font color; what is on the screen is drawn again in it */
+	if (value != p->fontcolor) {
+		gl_colorfont(p->cellwidth, p->cellheight, gl_rgbcolor(value, value, value), p->font);
+		p->fontcolor = value;
+		p->redraw = 1;
+	}
 }
 
@@ -21,9 +21,16 @@ typedef struct svga_private_data {
 
 	void *font;
 
+	unsigned char *framebuf;	/**< characters of the frame being drawn */
+	unsigned char *shown;		/**< characters on the screen */
+	int redraw;			/**< the whole text has to be drawn again */
+	GraphicsContext *physical;	/**< the screen */
+	GraphicsContext *offscreen;	/**< copy of it the cells are drawn in */
+
 	int contrast;
 	int brightness;
 	int offbrightness;
+	int fontcolor;			/**< brightness the font is drawn in */
 } PrivateData;
 
 
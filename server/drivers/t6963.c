@@ -120,6 +120,13 @@ t6963_init(Driver *drvthis)
 	p->port_config->bidirectLPT = drvthis->config_get_bool(drvthis->name, "bidirectional", 0, 1);
 	/* Additional delay necessary? Default: no */
 	p->port_config->delayBus = drvthis->config_get_bool(drvthis->name, "delaybus", 0, 0);
+	/* Bytes per status check in auto write mode. Default: 1 */
+	p->port_config->autoBurst = drvthis->config_get_int(drvthis->name, "AutoWriteBurst", 0, 1);
+	if ((p->port_config->autoBurst < 1) || (p->port_config->autoBurst > 255)) {
+		p->port_config->autoBurst = 1;
+		report(RPT_WARNING, "%s: AutoWriteBurst must be between 1 and 255. Using default 1",
+		       drvthis->name);
+	}
 
 	/* Initialize port and timing */
 	debug(RPT_DEBUG, "T6963: Initializing parallel port at 0x%03X", p->port_config->port);
@@ -272,14 +279,12 @@ t6963_graphic_clear(Driver *drvthis)
 {
 	PrivateData *p = drvthis->private_data;
 	int num = p->bytes_per_line * p->px_height;
-	int i;
 
 	debug(RPT_DEBUG, "Clearing Graphic %d bytes", num);
 
 	t6963_low_command_word(p->port_config, SET_ADDRESS_POINTER, GRAPHIC_BASE);
 	t6963_low_command(p->port_config, AUTO_WRITE);
-	for (i = 0; i < num; i++)
-		t6963_low_auto_write(p->port_config, 0);
+	t6963_low_auto_fill(p->port_config, 0, num);
 	t6963_low_command(p->port_config, AUTO_RESET);
 }
 
@@ -290,7 +295,7 @@ MODULE_EXPORT void
 t6963_flush(Driver *drvthis)
 {
 	PrivateData *p = drvthis->private_data;
-	int r, c, line_address;
+	int r;
 
 	debug(RPT_DEBUG, "Flushing %d x %d", p->width, p->height);
 
@@ -305,10 +310,8 @@ t6963_flush(Driver *drvthis)
 	 * commands instead.
 	 */
 	for (r = 0; r < p->height; r++) {
-		line_address = r * p->width;
-		for (c = 0; c < p->width; c++) {
-			t6963_low_auto_write(p->port_config, p->display_buffer1[line_address + c]);
-		}
+		t6963_low_auto_write_block(p->port_config,
+			(u8 *) p->display_buffer1 + r * p->width, p->width);
 		/*
 		 * If width is not identical with bytes_per_line there must be
 		 * one additional empty column on the right.
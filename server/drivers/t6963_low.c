@@ -111,6 +111,49 @@ t6963_low_auto_write(T6963_port *p, u8 byte)
 	t6963_low_send(p, T_DATA, byte);
 }
 
+/**
+ * Write a block of data to display in AUTO mode. The status is checked
+ * before every \c autoBurst bytes only; panels whose controller keeps up
+ * with the port take the bytes in between without being asked, which
+ * saves the status reads (or the fixed wait without bi-directional port)
+ * for most bytes.
+ * \param p        Pointer to port configuration.
+ * \param data     Data bytes.
+ * \param len      Number of bytes.
+ */
+void
+t6963_low_auto_write_block(T6963_port *p, const u8 *data, int len)
+{
+	int burst = (p->autoBurst > 1) ? p->autoBurst : 1;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if ((i % burst) == 0)
+			t6963_low_dsp_ready(p, STA3);
+		t6963_low_send(p, T_DATA, data[i]);
+	}
+}
+
+/**
+ * Write the same byte a number of times to display in AUTO mode, checking
+ * the status like t6963_low_auto_write_block().
+ * \param p        Pointer to port configuration.
+ * \param byte     Data byte.
+ * \param len      Number of bytes.
+ */
+void
+t6963_low_auto_fill(T6963_port *p, u8 byte, int len)
+{
+	int burst = (p->autoBurst > 1) ? p->autoBurst : 1;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if ((i % burst) == 0)
+			t6963_low_dsp_ready(p, STA3);
+		t6963_low_send(p, T_DATA, byte);
+	}
+}
+
 /**
  * Send one byte of data followed by one command byte to the display.
  * \param p        Pointer to port configuration.
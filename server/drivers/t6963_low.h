@@ -96,6 +96,7 @@ typedef struct t6963_port_config {
 	unsigned int port;
 	short bidirectLPT;
 	short delayBus;
+	short autoBurst;	/**< Bytes written in AUTO mode per status check */
 } T6963_port;
 
 /* External usable functions */
@@ -103,6 +104,8 @@ int t6963_low_init(T6963_port *p);
 void t6963_low_close(T6963_port *p);
 void t6963_low_data(T6963_port *p, u8 byte);
 void t6963_low_auto_write(T6963_port *p, u8 byte);
+void t6963_low_auto_write_block(T6963_port *p, const u8 *data, int len);
+void t6963_low_auto_fill(T6963_port *p, u8 byte, int len);
 void t6963_low_command(T6963_port *p, u8 byte);
 void t6963_low_command_byte(T6963_port *p, u8 cmd, u8 byte);
 void t6963_low_command_word(T6963_port *p, u8 cmd, u16 word);
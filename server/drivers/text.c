@@ -2,6 +2,10 @@
  * LCDd \c text driver for dump text mode terminals.
  * It displays the LCD screens, one below the other on the terminal,
  * and is this suitable for dump hard-copy terminals.
+ *
+ * It can also print only the rows that changed, and in a compact format
+ * of one line per row for programs, e.g. to compare the output of the
+ * server with the output of an earlier version.
  */
 
 /* Copyright (C) 1998-2004 The LCDproc Team
@@ -28,17 +32,29 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
 
 #include "lcd.h"
 #include "text.h"
 #include "shared/report.h"
 
+/** Output bytes of a row besides its characters: borders or frame and row
+ * numbers, and the newline */
+#define TEXTDRV_LINE_EXTRA	32
+
 
 /** private data for the \c text driver */
 typedef struct text_private_data {
 	int width;		/**< display width in characters */
 	int height;		/**< display height in characters */
 	char *framebuf;		/**< fram buffer */
+	char *last;		/**< frame printed last; NULL before the first */
+	char *out;		/**< output of a frame, written at once */
+	int changes_only;	/**< print only the rows that changed */
+	int compact;		/**< print "frame row text" lines instead of a box */
+	unsigned long frame;	/**< number of the frame being flushed */
 } PrivateData;
 
 
@@ -98,6 +114,22 @@ text_init (Driver *drvthis)
 	}
 	memset(p->framebuf, ' ', p->width * p->height);
 
+	p->changes_only = drvthis->config_get_bool(drvthis->name, "ChangesOnly", 0, 0);
+	strncpy(buf, drvthis->config_get_string(drvthis->name, "Format", 0, "box"), sizeof(buf));
+	buf[sizeof(buf)-1] = '\0';
+	if (strcasecmp(buf, "compact") == 0)
+		p->compact = 1;
+	else if (strcasecmp(buf, "box") != 0)
+		report(RPT_WARNING, "%s: unknown Format: %s; using box", drvthis->name, buf);
+
+	/* Room for the borders and numbers of all rows */
+	p->last = malloc(p->width * p->height);
+	p->out = malloc((p->height + 2) * (p->width + TEXTDRV_LINE_EXTRA));
+	if ((p->last == NULL) || (p->out == NULL)) {
+		report(RPT_ERR, "%s: unable to create output buffer", drvthis->name);
+		return -1;
+	}
+
 	report(RPT_DEBUG, "%s: init() done", drvthis->name);
 
 	return 0;
@@ -116,6 +148,8 @@ text_close (Driver *drvthis)
 	if (p != NULL) {
 		if (p->framebuf != NULL)
 			free(p->framebuf);
+		free(p->last);
+		free(p->out);
 
 		free(p);
 	}
@@ -164,6 +198,84 @@ text_clear (Driver *drvthis)
 }
 
 
+/* Write the output of a frame with as few system calls as possible */
+static void
+text_write(Driver *drvthis, const char *buf, int len)
+{
+	while (len > 0) {
+		ssize_t n = write(STDOUT_FILENO, buf, len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			drvthis->count_io(drvthis, IO_ERRORS, 1);
+			return;
+		}
+		drvthis->count_io(drvthis, IO_WRITES, 1);
+		drvthis->count_io(drvthis, IO_BYTES, n);
+		buf += n;
+		len -= n;
+	}
+}
+
+
+/* Print the frame; with ChangesOnly only its rows that changed, unless all is set */
+static void
+text_print(Driver *drvthis, int all)
+{
+	PrivateData *p = drvthis->private_data;
+	char *out = p->out;
+	int i;
+
+	p->frame++;
+	if (p->frame == 1)
+		all = 1;	/* nothing printed yet */
+
+	if (!p->compact) {
+		*out++ = '+';
+		memset(out, '-', p->width);
+		out += p->width;
+		*out++ = '+';
+		if (p->changes_only)
+			out += sprintf(out, " %lu", p->frame);
+		*out++ = '\n';
+	}
+
+	for (i = 0; i < p->height; i++) {
+		const char *row = p->framebuf + (i * p->width);
+
+		if (p->changes_only && !all
+		    && (memcmp(row, p->last + (i * p->width), p->width) == 0))
+			continue;
+		if (p->compact)
+			out += sprintf(out, "%lu %d ", p->frame, i + 1);
+		else
+			*out++ = '|';
+		memcpy(out, row, p->width);
+		out += p->width;
+		if (!p->compact) {
+			*out++ = '|';
+			if (p->changes_only)
+				out += sprintf(out, " %d", i + 1);
+		}
+		*out++ = '\n';
+	}
+
+	if (!p->compact) {
+		*out++ = '+';
+		memset(out, '-', p->width);
+		out += p->width;
+		*out++ = '+';
+		*out++ = '\n';
+	}
+
+	/* In the compact format a frame without changes leaves no trace */
+	if (!p->compact || (out != p->out))
+		text_write(drvthis, p->out, out - p->out);
+	memcpy(p->last, p->framebuf, p->width * p->height);
+}
+
+
 /**
  * Flush data on screen to the display.
  * \param drvthis  Pointer to driver structure.
@@ -172,24 +284,34 @@ MODULE_EXPORT void
 text_flush (Driver *drvthis)
 {
 	PrivateData *p = drvthis->private_data;
-	char out[LCD_MAX_WIDTH];
-	int i;
 
-	memset(out, '-', p->width);
-	out[p->width] = '\0';
-	printf("+%s+\n", out);
-
-	for (i = 0; i < p->height; i++) {
-		memcpy(out, p->framebuf + (i * p->width), p->width);
-		out[p->width] = '\0';
-		printf("|%s|\n", out);
+	/* with ChangesOnly nothing is printed if nothing changed */
+	if (p->changes_only && (p->frame > 0)
+	    && (memcmp(p->framebuf, p->last, p->width * p->height) == 0)) {
+		p->frame++;
+		return;
 	}
+	text_print(drvthis, !p->changes_only);
+}
 
-	memset(out, '-', p->width);
-	out[p->width] = '\0';
-	printf("+%s+\n", out);
 
-        fflush(stdin);
+/**
+ * Flush the parts of the frame buffer that changed. A text terminal cannot
+ * move the cursor, so the whole frame is printed, but only if anything
+ * changed at all; with ChangesOnly just the rows that changed.
+ * \param drvthis  Pointer to driver structure.
+ * \param spans    Parts of the display that changed.
+ * \param count    Number of spans.
+ */
+MODULE_EXPORT void
+text_flush_spans (Driver *drvthis, const LCDSpan *spans, int count)
+{
+	PrivateData *p = drvthis->private_data;
+
+	if ((count > 0) || (p->frame == 0))
+		text_print(drvthis, !p->changes_only);
+	else
+		p->frame++;
 }
 
 
@@ -219,6 +341,39 @@ text_string (Driver *drvthis, int x, int y, const char string[])
 }
 
 
+/**
+ * Write a block of characters to the screen. Row r of the block starts at
+ * buf + r * stride; the parts outside the display are left out.
+ * \param drvthis  Pointer to driver structure.
+ * \param buf      Characters of the top left row.
+ * \param stride   Distance between the rows in buf.
+ * \param rect     Position and size of the block.
+ */
+MODULE_EXPORT void
+text_blit_text (Driver *drvthis, const unsigned char *buf, int stride, const LCDRect *rect)
+{
+	PrivateData *p = drvthis->private_data;
+	int i, j;
+
+	for (j = 0; j < rect->height; j++) {
+		const unsigned char *src = buf + j * stride;
+		int y = rect->y - 1 + j;
+
+		if ((y < 0) || (y >= p->height))
+			continue;
+		for (i = 0; i < rect->width; i++) {
+			int x = rect->x - 1 + i;
+
+			if (x < 0)
+				continue;
+			if (x >= p->width)
+				break;
+			p->framebuf[(y * p->width) + x] = src[i];
+		}
+	}
+}
+
+
 /**
  * Print a character on the screen at position (x,y).
  * The upper-left corner is (1,1), the lower-right corner is (p->width, p->height).
@@ -119,6 +119,19 @@
   } while (0)
 #endif
 
+/*
+ * Delay modes for drivers that let the user choose, see timing_calibrate().
+ */
+#define TIMING_SLEEP	0	/* sleep with the selected mechanism */
+#define TIMING_HYBRID	1	/* spin through what sleeping would overshoot */
+
+/* Clock used for spinning, the raw hardware clock where available */
+#if defined HAVE_CLOCK_GETTIME && defined CLOCK_MONOTONIC_RAW
+# define TIMING_CLOCK	CLOCK_MONOTONIC_RAW
+#elif defined HAVE_CLOCK_GETTIME && defined CLOCK_MONOTONIC
+# define TIMING_CLOCK	CLOCK_MONOTONIC
+#endif
+
 
 /**
  * Do necessary initialization for the selected waiting method.
@@ -191,4 +204,86 @@ timing_uPause(int usecs)
 }
 
 
+
+/**
+ * Read a clock in nanoseconds, for measuring short delays.
+ * \return  Current time in nanoseconds since some fixed point.
+ */
+static inline long long
+timing_now()
+{
+#ifdef TIMING_CLOCK
+	struct timespec ts;
+
+	clock_gettime(TIMING_CLOCK, &ts);
+	return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (long long) tv.tv_sec * 1000000000LL + tv.tv_usec * 1000LL;
+#endif
+}
+
+
+/**
+ * Measure how far nanosleep overshoots, for timing_hybrid_uPause(). Call
+ * it after timing_init(), as real-time scheduling shortens the overshoot.
+ * It takes about a millisecond.
+ * \return  Typical overshoot of a short nanosleep in nanoseconds.
+ */
+static inline long
+timing_calibrate()
+{
+	struct timespec delay_time = { 0, 1000 };
+	long samples[15];
+	long t;
+	int i, j;
+
+	for (i = 0; i < 15; i++) {
+		long long start = timing_now();
+
+		nanosleep(&delay_time, NULL);
+		t = (long) (timing_now() - start) - delay_time.tv_nsec;
+		/* insertion sort, the median is taken */
+		for (j = i; (j > 0) && (samples[j - 1] > t); j--)
+			samples[j] = samples[j - 1];
+		samples[j] = t;
+	}
+	t = samples[7];
+	report(RPT_DEBUG, "timing: nanosleep overshoots by %ld ns", t);
+	return (t > 0) ? t : 0;
+}
+
+
+/**
+ * Delay operation for some time, sleeping for all but the overshoot
+ * measured by timing_calibrate() and spinning on the clock for the rest.
+ * Delays shorter than the overshoot are spun entirely, so they last
+ * hardly longer than asked for, at the cost of CPU time.
+ * \param usecs     Microseconds to pause.
+ * \param overshoot Result of timing_calibrate().
+ */
+static inline void
+timing_hybrid_uPause(int usecs, long overshoot)
+{
+	long long end = timing_now() + usecs * 1000LL;
+	long sleep_ns = usecs * 1000L - overshoot;
+
+	if (sleep_ns > 0) {
+		struct timespec delay_time,remaining;
+
+		delay_time.tv_sec = sleep_ns / 1000000000L;
+		delay_time.tv_nsec = sleep_ns % 1000000000L;
+		while ( nanosleep(&delay_time,&remaining) == -1 )
+		{
+			delay_time.tv_sec  = remaining.tv_sec;
+			delay_time.tv_nsec = remaining.tv_nsec;
+		}
+	}
+	while (timing_now() < end)
+		;
+}
+
+
 #endif /* _TIMING_H */
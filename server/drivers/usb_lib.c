@@ -0,0 +1,337 @@
+/** \file server/drivers/usb_lib.c
+ * Asynchronous USB transfers shared by the drivers using libusb-1.0.
+ *
+ * A synchronous transfer returns only after the device has answered, which
+ * takes a millisecond or more even for a few bytes. Drivers sending a frame
+ * as many small transfers spend most of their flush waiting. With a queue
+ * the transfers are submitted at once and finish while the driver goes on;
+ * their results are collected whenever the driver calls into libusb.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_LIBUSB_1_0
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "usb_lib.h"
+#include "shared/report.h"
+
+/** A queue of transfers to one device */
+struct lib_usb_queue {
+	Driver *drvthis;		/**< Driver whose I/O is counted */
+	libusb_context *ctx;		/**< Context whose events finish the transfers */
+	libusb_device_handle *handle;	/**< The device */
+	int depth;			/**< Most transfers on the way */
+	int pending;			/**< Transfers submitted and not finished */
+	int lost;			/**< The device is gone */
+};
+
+/** A submitted transfer */
+typedef struct lib_usb_request {
+	UsbQueue *queue;
+	lib_usb_done done;
+	void *arg;
+	unsigned char data[];		/**< Copy of the data to send */
+} UsbRequest;
+
+
+/* Print a transfer status */
+static const char *
+lib_usb_status_name (int status)
+{
+	static const char *names[] = {
+		"COMPLETED", "ERROR", "TIMED_OUT", "CANCELLED", "STALL",
+		"NO_DEVICE", "OVERFLOW"
+	};
+
+	if ((status < 0) || (status >= (int) (sizeof(names) / sizeof(names[0]))))
+		return "UNKNOWN";
+	return names[status];
+}
+
+
+/* Call-back of all transfers of a queue */
+static void LIBUSB_CALL
+lib_usb_finished (struct libusb_transfer *transfer)
+{
+	UsbRequest *req = transfer->user_data;
+	UsbQueue *queue = req->queue;
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+		queue->drvthis->count_io(queue->drvthis, IO_BYTES, transfer->actual_length);
+		queue->drvthis->count_io(queue->drvthis, IO_WRITES, 1);
+	}
+	else if (transfer->status != LIBUSB_TRANSFER_CANCELLED) {
+		queue->drvthis->count_io(queue->drvthis, IO_ERRORS, 1);
+		if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE)
+			queue->lost = 1;
+		else
+			report(RPT_WARNING, "USB transfer failed: %s",
+			       lib_usb_status_name(transfer->status));
+	}
+
+	queue->pending--;
+	if (req->done != NULL)
+		req->done(req->arg, transfer->status);
+
+	free(req);
+	libusb_free_transfer(transfer);
+}
+
+
+/* Let libusb finish transfers for at most usecs microseconds */
+static int
+lib_usb_handle (UsbQueue *queue, long usecs)
+{
+	struct timeval tv;
+	int rc;
+
+	tv.tv_sec = usecs / 1000000;
+	tv.tv_usec = usecs % 1000000;
+	rc = libusb_handle_events_timeout_completed(queue->ctx, &tv, NULL);
+	return (rc == LIBUSB_ERROR_INTERRUPTED) ? 0 : rc;
+}
+
+
+/* Allocate a transfer with a request holding room for length bytes */
+static struct libusb_transfer *
+lib_usb_alloc (UsbQueue *queue, size_t length, lib_usb_done done, void *arg)
+{
+	struct libusb_transfer *transfer;
+	UsbRequest *req;
+
+	transfer = libusb_alloc_transfer(0);
+	if (transfer == NULL)
+		return NULL;
+
+	req = malloc(sizeof(UsbRequest) + length);
+	if (req == NULL) {
+		libusb_free_transfer(transfer);
+		return NULL;
+	}
+	req->queue = queue;
+	req->done = done;
+	req->arg = arg;
+	transfer->user_data = req;
+	return transfer;
+}
+
+
+/* Submit a filled transfer, waiting first if the queue is full */
+static int
+lib_usb_submit (UsbQueue *queue, struct libusb_transfer *transfer)
+{
+	int rc = 0;
+
+	/* a slow device must not make the transfers pile up */
+	while ((queue->pending >= queue->depth) && !queue->lost && (rc == 0))
+		rc = lib_usb_handle(queue, 1000000);
+
+	if (queue->lost)
+		rc = LIBUSB_ERROR_NO_DEVICE;
+	else if (rc == 0)
+		rc = libusb_submit_transfer(transfer);
+
+	if (rc < 0) {
+		queue->drvthis->count_io(queue->drvthis, IO_ERRORS, 1);
+		if (rc == LIBUSB_ERROR_NO_DEVICE)
+			queue->lost = 1;
+		free(transfer->user_data);
+		libusb_free_transfer(transfer);
+		return rc;
+	}
+	queue->pending++;
+	return 0;
+}
+
+
+/**
+ * Create a transfer queue for a device.
+ * \param drvthis The driver using the device.
+ * \param ctx     The driver's libusb context.
+ * \param handle  The opened device.
+ * \param depth   Most transfers to have on the way, e.g. LIB_USB_QUEUE_DEPTH.
+ * \return  The queue; NULL on error.
+ */
+UsbQueue *
+lib_usb_queue_new (Driver *drvthis, libusb_context *ctx,
+		   libusb_device_handle *handle, int depth)
+{
+	UsbQueue *queue = calloc(1, sizeof(UsbQueue));
+
+	if (queue == NULL)
+		return NULL;
+	queue->drvthis = drvthis;
+	queue->ctx = ctx;
+	queue->handle = handle;
+	queue->depth = (depth > 0) ? depth : 1;
+	return queue;
+}
+
+
+/**
+ * Submit a control transfer sending data to the device. The data is copied,
+ * so the caller may reuse its buffer at once.
+ * \param queue         The queue.
+ * \param request_type  bmRequestType; the direction must be out.
+ * \param request       bRequest.
+ * \param value         wValue.
+ * \param index         wIndex.
+ * \param data          Data stage; may be NULL if length is 0.
+ * \param length        Size of the data stage.
+ * \param timeout       Time the device has for it, in milliseconds.
+ * \param done          Function to call when it has finished; may be NULL.
+ * \param arg           Argument of done.
+ * \return  0 on success, a libusb error code otherwise.
+ */
+int
+lib_usb_control (UsbQueue *queue, uint8_t request_type, uint8_t request,
+		 uint16_t value, uint16_t index, const unsigned char *data, uint16_t length,
+		 unsigned int timeout, lib_usb_done done, void *arg)
+{
+	struct libusb_transfer *transfer;
+	UsbRequest *req;
+
+	if ((request_type & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN)
+		return LIBUSB_ERROR_INVALID_PARAM;
+
+	transfer = lib_usb_alloc(queue, LIBUSB_CONTROL_SETUP_SIZE + length, done, arg);
+	if (transfer == NULL)
+		return LIBUSB_ERROR_NO_MEM;
+	req = transfer->user_data;
+
+	libusb_fill_control_setup(req->data, request_type, request, value, index, length);
+	if (length > 0)
+		memcpy(req->data + LIBUSB_CONTROL_SETUP_SIZE, data, length);
+	libusb_fill_control_transfer(transfer, queue->handle, req->data,
+				     lib_usb_finished, req, timeout);
+	return lib_usb_submit(queue, transfer);
+}
+
+
+/**
+ * Submit an interrupt transfer sending data to the device. The data is
+ * copied, so the caller may reuse its buffer at once.
+ * \param queue     The queue.
+ * \param endpoint  Out endpoint, e.g. LIBUSB_ENDPOINT_OUT + 1.
+ * \param data      Data to send.
+ * \param length    Number of bytes.
+ * \param timeout   Time the device has for it, in milliseconds.
+ * \param done      Function to call when it has finished; may be NULL.
+ * \param arg       Argument of done.
+ * \return  0 on success, a libusb error code otherwise.
+ */
+int
+lib_usb_interrupt (UsbQueue *queue, unsigned char endpoint,
+		   const unsigned char *data, int length,
+		   unsigned int timeout, lib_usb_done done, void *arg)
+{
+	struct libusb_transfer *transfer;
+	UsbRequest *req;
+
+	if (((endpoint & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN) || (length < 0))
+		return LIBUSB_ERROR_INVALID_PARAM;
+
+	transfer = lib_usb_alloc(queue, length, done, arg);
+	if (transfer == NULL)
+		return LIBUSB_ERROR_NO_MEM;
+	req = transfer->user_data;
+
+	memcpy(req->data, data, length);
+	libusb_fill_interrupt_transfer(transfer, queue->handle, endpoint, req->data, length,
+				       lib_usb_finished, req, timeout);
+	return lib_usb_submit(queue, transfer);
+}
+
+
+/**
+ * Collect the transfers that have finished, without waiting. Drivers call
+ * this at the end of their flush() function.
+ * \param queue  The queue.
+ * \return  Number of transfers still on the way; a libusb error code on error.
+ */
+int
+lib_usb_poll (UsbQueue *queue)
+{
+	int rc = 0;
+
+	if (queue->pending > 0)
+		rc = lib_usb_handle(queue, 0);
+	return (rc < 0) ? rc : queue->pending;
+}
+
+
+/**
+ * Wait until all transfers of a queue have finished.
+ * \param queue    The queue.
+ * \param timeout  Longest time to wait in milliseconds; <0 to wait until
+ *                 the transfers' own timeouts end them.
+ * \return  Number of transfers still on the way; a libusb error code on error.
+ */
+int
+lib_usb_wait (UsbQueue *queue, int timeout)
+{
+	struct timeval start, now;
+	long left = 1000000;
+	int rc;
+
+	gettimeofday(&start, NULL);
+	while (queue->pending > 0) {
+		if (timeout >= 0) {
+			gettimeofday(&now, NULL);
+			left = (long) timeout * 1000
+			       - ((now.tv_sec - start.tv_sec) * 1000000L + (now.tv_usec - start.tv_usec));
+			if (left <= 0)
+				break;
+		}
+		rc = lib_usb_handle(queue, left);
+		if (rc < 0)
+			return rc;
+	}
+	return queue->pending;
+}
+
+
+/**
+ * Tell whether a transfer found the device gone, e.g. unplugged.
+ * \param queue  The queue.
+ * \return  1 if it is gone, 0 otherwise.
+ */
+int
+lib_usb_lost (UsbQueue *queue)
+{
+	return queue->lost;
+}
+
+
+/**
+ * Wait for the transfers of a queue to finish and free it. Call this
+ * before closing the device.
+ * \param queue  The queue; may be NULL.
+ */
+void
+lib_usb_queue_free (UsbQueue *queue)
+{
+	if (queue == NULL)
+		return;
+
+	if (lib_usb_wait(queue, -1) != 0) {
+		/* the call-backs still refer to it */
+		report(RPT_ERR, "USB transfers did not finish");
+		return;
+	}
+	free(queue);
+}
+
+#endif /* HAVE_LIBUSB_1_0 */
@@ -0,0 +1,61 @@
+/** \file server/drivers/usb_lib.h
+ * Asynchronous USB transfers shared by the drivers using libusb-1.0.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef USB_LIB_H
+#define USB_LIB_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_LIBUSB_1_0
+
+#include <libusb-1.0/libusb.h>
+
+#ifndef LCD_H
+#include "lcd.h"
+#endif
+
+/** Transfers a queue keeps on the way by default */
+#define LIB_USB_QUEUE_DEPTH	16
+
+/**
+ * Function called when a transfer has finished.
+ * \param arg     The argument given when the transfer was submitted.
+ * \param status  How it finished: a libusb_transfer_status.
+ */
+typedef void (*lib_usb_done) (void *arg, int status);
+
+/**
+ * A queue of transfers to one device. Drivers submit the transfers of a
+ * frame without waiting for each to finish, so the USB round trips
+ * overlap. The queue must use a libusb context the driver has for itself:
+ * its transfers finish (and their lib_usb_done functions are called) in
+ * the libusb calls the driver makes on that context. The bytes sent and
+ * the failed transfers are counted for the driver (see count_io()).
+ */
+typedef struct lib_usb_queue UsbQueue;
+
+UsbQueue *lib_usb_queue_new (Driver *drvthis, libusb_context *ctx,
+			     libusb_device_handle *handle, int depth);
+int lib_usb_control (UsbQueue *queue, uint8_t request_type, uint8_t request,
+		     uint16_t value, uint16_t index, const unsigned char *data, uint16_t length,
+		     unsigned int timeout, lib_usb_done done, void *arg);
+int lib_usb_interrupt (UsbQueue *queue, unsigned char endpoint,
+		       const unsigned char *data, int length,
+		       unsigned int timeout, lib_usb_done done, void *arg);
+int lib_usb_poll (UsbQueue *queue);
+int lib_usb_wait (UsbQueue *queue, int timeout);
+int lib_usb_lost (UsbQueue *queue);
+void lib_usb_queue_free (UsbQueue *queue);
+
+#endif /* HAVE_LIBUSB_1_0 */
+
+#endif
@@ -187,7 +187,8 @@ xosdlib_drv_init (Driver *drvthis)
         }
         memset(p->framebuf, ' ', p->width * p->height);
 
-        /* make sure the framebuffer backing store is there... */
+        /* make sure the framebuffer backing store is there...
+         * It holds what xosd shows: blank, as nothing was displayed yet */
         p->backingstore = (unsigned char *) malloc(p->width * p->height);
         if (p->backingstore == NULL) {
                 report(RPT_ERR, "%s: unable to create framebuffer backing store", drvthis->name);
@@ -276,6 +277,8 @@ xosdlib_drv_clear (Driver *drvthis)
 
 /**
  * Flush data on screen to the display.
+ * Only the lines that changed since the last flush are given to xosd, as
+ * each xosd_display() redraws the OSD window.
  * \param drvthis  Pointer to driver structure.
  */
 MODULE_EXPORT void
@@ -283,12 +286,19 @@ xosdlib_drv_flush (Driver *drvthis)
 {
 	PrivateData *p = drvthis->private_data;
 	int i;
-	char buffer[LCD_MAX_WIDTH];
+	char buffer[LCD_MAX_WIDTH + 1];
 
 	debug(RPT_DEBUG, "%s(%p)", __FUNCTION__, drvthis);
 
 	for (i = 0; i < p->height; i++) {
-		memcpy(buffer, p->framebuf + (i * p->width), p->width);
+		unsigned char *line = p->framebuf + (i * p->width);
+		unsigned char *old = p->backingstore + (i * p->width);
+
+		if (memcmp(line, old, p->width) == 0)
+			continue;
+		memcpy(old, line, p->width);
+
+		memcpy(buffer, line, p->width);
 		buffer[p->width] = '\0';
 
 		debug(RPT_DEBUG, "xosd: flushed string \"%s\" at (%d,%d)", buffer, 0, i);
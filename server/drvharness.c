@@ -0,0 +1,659 @@
+/** \file server/drvharness.c
+ * Test harness of the drivers, built and run by "make drvtest". It loads
+ * a driver module from drivers/ below the current directory like LCDd
+ * would, with a pseudo terminal for its device. An emulation of the
+ * display listens on the other end of the terminal: it decodes what the
+ * driver sends into the display's contents and answers its queries. The
+ * frames of a script are played through the server's driver layer, and
+ * for each frame one tab separated line is printed:
+ *
+ *\verbatim
+ * <frame>	<bytes>	<writes>	<microseconds>
+ *\endverbatim
+ *
+ * Bytes are those the emulation received, writes those the driver counted
+ * with count_io(IO_WRITES), and the time is that of drivers_flush().
+ * At the end the emulated display is compared with the rows the script
+ * expects. Lines starting with # are comments.
+ *
+ * A script holds one command per line:
+ *
+ *\verbatim
+ * driver <name>             driver to load, from drivers/<name>.so
+ * emulate <name>            emulation of its display, see emulators[]
+ * size <width>x<height>     size of the display (20x4)
+ * set <key>=<value>         another setting of the driver's section
+ * frame                     start a frame: clear it
+ * string <x> <y> <text>     draw a string
+ * chr <x> <y> <char>        draw a character
+ * hbar <x> <y> <len> <promille>
+ * vbar <x> <y> <len> <promille>
+ * backlight <on|off>
+ * flush                     show the frame and measure it
+ * expect <y> <text>         the row the display ends up with; ? in the
+ *                           text matches any character
+ *\endverbatim
+ *
+ * Usage: drvharness [-v] <script>...
+ * The exit status is non-zero if a display did not end up as expected.
+ * A script whose driver was not built is skipped.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#define _XOPEN_SOURCE 600	/* for posix_openpt() */
+#define _DEFAULT_SOURCE		/* for usleep() */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+
+#include "shared/report.h"
+#include "shared/configfile.h"
+
+#include "drivers/lcd.h"
+#include "drivers.h"
+#include "stats.h"
+#include "main.h"
+
+/* Set by main.c in LCDd */
+long timer = 0;
+int frame_interval = 125000;	/* LCDd's default */
+
+/** Longest line of a script */
+#define TEST_LINE		256
+
+/** Most rows a script may expect */
+#define TEST_MAX_EXPECT		LCD_MAX_HEIGHT
+
+/** Time without output after which a frame is taken as complete, in ms */
+#define TEST_QUIET		20
+
+struct Emulation;
+
+/** Emulation of a display's protocol */
+typedef struct Emulator {
+	const char *name;
+	/** Take a byte the driver sent; replies go to e->fd */
+	void (*input) (struct Emulation *e, unsigned char byte);
+} Emulator;
+
+/** State of an emulated display */
+typedef struct Emulation {
+	const Emulator *emulator;
+	int fd;			/**< Master side of the pseudo terminal */
+	int width, height;
+	unsigned char *display;	/**< Contents, width * height */
+	int x, y;		/**< Cursor, 0-based */
+	unsigned char cmd[16];	/**< Command being received */
+	int cmd_len;		/**< Bytes of it received */
+	int cmd_need;		/**< Bytes it has in total, 0 if none */
+	unsigned long bytes;	/**< Bytes received */
+	int busy;		/**< The reader is decoding a block */
+	int stop;		/**< Tells the reader to end */
+	pthread_mutex_t lock;
+} Emulation;
+
+static int verbose = 0;
+
+
+/* Put a character on the emulated display and move the cursor on */
+static void
+emu_put(Emulation *e, unsigned char c)
+{
+	if ((e->x < e->width) && (e->y < e->height))
+		e->display[e->y * e->width + e->x] = c;
+	if (++e->x >= e->width) {
+		/* displays wrap to the next line */
+		e->x = 0;
+		e->y = (e->y + 1) % e->height;
+	}
+}
+
+
+/* Move the cursor of the emulated display, 0-based */
+static void
+emu_goto(Emulation *e, int x, int y)
+{
+	e->x = ((x >= 0) && (x < e->width)) ? x : 0;
+	e->y = ((y >= 0) && (y < e->height)) ? y : 0;
+}
+
+
+/* Reply to the driver */
+static void
+emu_reply(Emulation *e, const void *data, size_t size)
+{
+	if (write(e->fd, data, size) != (ssize_t) size)
+		fprintf(stderr, "drvharness: cannot reply to the driver: %s\n", strerror(errno));
+}
+
+
+/* Start a command of n bytes in total, the first one received */
+static void
+emu_command(Emulation *e, unsigned char byte, int n)
+{
+	e->cmd[0] = byte;
+	e->cmd_len = 1;
+	e->cmd_need = n;
+}
+
+
+/*
+ * Matrix Orbital: commands are 0xFE, a letter and its arguments; the
+ * cursor positions are 1-based. The type, firmware and serial number
+ * queries are answered as an LK204-25 would.
+ */
+static void
+emu_mtxorb(Emulation *e, unsigned char byte)
+{
+	if (e->cmd_need == 0) {
+		if (byte == 0xFE)
+			emu_command(e, byte, 2);
+		else
+			emu_put(e, byte);
+		return;
+	}
+
+	e->cmd[e->cmd_len++] = byte;
+	if (e->cmd_len == 2) {
+		switch (byte) {
+			case 'G':		/* goto column, row */
+				e->cmd_need = 4;
+				break;
+			case 'N':		/* custom character: number, 8 rows */
+				e->cmd_need = 11;
+				break;
+			case 'P': case 'Y': case 0x99: case 'B':	/* one argument */
+				e->cmd_need = 3;
+				break;
+			default:
+				break;
+		}
+	}
+	if (e->cmd_len < e->cmd_need)
+		return;
+
+	e->cmd_need = 0;
+	switch (e->cmd[1]) {
+		case 'G':
+			emu_goto(e, e->cmd[2] - 1, e->cmd[3] - 1);
+			break;
+		case 'X':		/* clear */
+			memset(e->display, ' ', e->width * e->height);
+			emu_goto(e, 0, 0);
+			break;
+		case 'H':		/* home */
+			emu_goto(e, 0, 0);
+			break;
+		case '7':		/* type */
+			emu_reply(e, "\x09", 1);
+			break;
+		case '6':		/* firmware revision */
+			emu_reply(e, "\x01", 1);
+			break;
+		case '5':		/* serial number */
+			emu_reply(e, "\x00\x01", 2);
+			break;
+		default:
+			break;
+	}
+}
+
+
+/*
+ * CrystalFontz 632/634: commands are control characters with their
+ * arguments; the cursor positions are 0-based. Custom characters are
+ * shown at 0x80 to 0x87.
+ */
+static void
+emu_cfontz(Emulation *e, unsigned char byte)
+{
+	if (e->cmd_need == 0) {
+		switch (byte) {
+			case 0x11:		/* cursor position: column, row */
+				emu_command(e, byte, 3);
+				break;
+			case 0x19:		/* custom character: number, 8 rows */
+				emu_command(e, byte, 10);
+				break;
+			case 0x0E: case 0x0F: case 0x1A: case 0x1E:	/* one argument */
+				emu_command(e, byte, 2);
+				break;
+			case 0x0C:		/* form feed: clear */
+				memset(e->display, ' ', e->width * e->height);
+				emu_goto(e, 0, 0);
+				break;
+			case 0x01:		/* home */
+				emu_goto(e, 0, 0);
+				break;
+			default:
+				if (byte >= 0x20)
+					emu_put(e, byte);
+				break;
+		}
+		return;
+	}
+
+	e->cmd[e->cmd_len++] = byte;
+	if (e->cmd_len < e->cmd_need)
+		return;
+
+	e->cmd_need = 0;
+	switch (e->cmd[0]) {
+		case 0x11:
+			emu_goto(e, e->cmd[1], e->cmd[2]);
+			break;
+		case 0x1E:		/* send data directly: 0x01, then the character */
+			e->cmd[0] = 0x1F;
+			e->cmd_len = 1;
+			e->cmd_need = 2;
+			break;
+		case 0x1F:
+			emu_put(e, e->cmd[1]);
+			break;
+		default:
+			break;
+	}
+}
+
+
+/** The emulations of displays, by name */
+static const Emulator emulators[] = {
+	{ "MtxOrb", emu_mtxorb },
+	{ "CFontz", emu_cfontz },
+	{ NULL, NULL }
+};
+
+
+/* Read what the driver sends and decode it, until told to stop */
+static void *
+emu_reader(void *arg)
+{
+	Emulation *e = arg;
+	unsigned char buf[1024];
+
+	for (;;) {
+		struct pollfd pfd = { e->fd, POLLIN, 0 };
+		int n, i;
+
+		pthread_mutex_lock(&e->lock);
+		if (e->stop) {
+			pthread_mutex_unlock(&e->lock);
+			break;
+		}
+		pthread_mutex_unlock(&e->lock);
+
+		if (poll(&pfd, 1, 10) <= 0)
+			continue;
+
+		pthread_mutex_lock(&e->lock);
+		e->busy = 1;
+		pthread_mutex_unlock(&e->lock);
+
+		n = read(e->fd, buf, sizeof(buf));
+
+		pthread_mutex_lock(&e->lock);
+		for (i = 0; i < n; i++)
+			e->emulator->input(e, buf[i]);
+		if (n > 0)
+			e->bytes += n;
+		e->busy = 0;
+		pthread_mutex_unlock(&e->lock);
+		if ((n < 0) && (errno != EAGAIN) && (errno != EINTR))
+			break;
+	}
+	return NULL;
+}
+
+
+/* Wait until the emulation has taken all the driver sent, and tell how
+ * many bytes it received in total */
+static unsigned long
+emu_settle(Emulation *e)
+{
+	int quiet = 0;
+	unsigned long bytes;
+
+	while (quiet < TEST_QUIET) {
+		int pending = 0;
+		int busy;
+
+		if (ioctl(e->fd, FIONREAD, &pending) < 0)
+			pending = 0;
+		pthread_mutex_lock(&e->lock);
+		busy = e->busy;
+		pthread_mutex_unlock(&e->lock);
+		if ((pending > 0) || busy)
+			quiet = 0;
+		else
+			quiet++;
+		usleep(1000);
+	}
+	pthread_mutex_lock(&e->lock);
+	bytes = e->bytes;
+	pthread_mutex_unlock(&e->lock);
+	return bytes;
+}
+
+
+/* Open the pseudo terminal and start its emulation */
+static int
+emu_start(Emulation *e, pthread_t *thread, char *slave, size_t size)
+{
+	e->fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((e->fd < 0) || (grantpt(e->fd) < 0) || (unlockpt(e->fd) < 0)
+	    || (ptsname(e->fd) == NULL)) {
+		fprintf(stderr, "drvharness: cannot open a pseudo terminal: %s\n", strerror(errno));
+		if (e->fd >= 0)
+			close(e->fd);
+		return -1;
+	}
+	snprintf(slave, size, "%s", ptsname(e->fd));
+
+	e->display = malloc(e->width * e->height);
+	if (e->display == NULL) {
+		close(e->fd);
+		return -1;
+	}
+	memset(e->display, ' ', e->width * e->height);
+	pthread_mutex_init(&e->lock, NULL);
+	if (pthread_create(thread, NULL, emu_reader, e) != 0) {
+		free(e->display);
+		close(e->fd);
+		return -1;
+	}
+	return 0;
+}
+
+
+/* Stop the emulation and close the pseudo terminal */
+static void
+emu_stop(Emulation *e, pthread_t thread)
+{
+	pthread_mutex_lock(&e->lock);
+	e->stop = 1;
+	pthread_mutex_unlock(&e->lock);
+	pthread_join(thread, NULL);
+	pthread_mutex_destroy(&e->lock);
+	close(e->fd);
+	free(e->display);
+}
+
+
+/* Writes the loaded driver counted */
+static unsigned long long
+test_writes(void)
+{
+	DriverStatsBlock block;
+	Driver *drv = drivers_get(0);
+
+	if ((drv == NULL) || (stats_driver_get(drv, &block) < 0))
+		return 0;
+	return block.io[IO_WRITES];
+}
+
+
+/* Load the driver with its device on the pseudo terminal */
+static int
+test_load(const char *driver, const char *slave, const char *size, const char *settings)
+{
+	char config[] = "/tmp/drvharnessXXXXXX";
+	FILE *f;
+	int fd;
+
+	fd = mkstemp(config);
+	if ((fd < 0) || ((f = fdopen(fd, "w")) == NULL)) {
+		if (fd >= 0) {
+			close(fd);
+			unlink(config);
+		}
+		return -1;
+	}
+	fprintf(f, "[server]\nDriverPath=drivers/\n[%s]\nDevice=%s\nSize=%s\n%s",
+		driver, slave, size, settings);
+	fclose(f);
+
+	config_clear();
+	fd = config_read_file(config);
+	unlink(config);
+	if (fd < 0)
+		return -1;
+	return drivers_load_driver(driver);
+}
+
+
+/* Compare a row of the display with what the script expects */
+static int
+test_row(Emulation *e, int y, const char *text)
+{
+	int x;
+
+	for (x = 0; x < e->width; x++) {
+		unsigned char want = (*text != '\0') ? *text++ : ' ';
+
+		if ((want != '?') && (want != e->display[(y - 1) * e->width + x]))
+			return -1;
+	}
+	return 0;
+}
+
+
+/* Print a row of the display, other than printable characters as ? */
+static void
+test_print_row(Emulation *e, int y)
+{
+	int x;
+
+	for (x = 0; x < e->width; x++) {
+		unsigned char c = e->display[(y - 1) * e->width + x];
+
+		putchar(((c >= 0x20) && (c < 0x7F)) ? c : '?');
+	}
+}
+
+
+/* Run a script; returns -1 if it failed, 1 if it was skipped, 0 if not */
+static int
+test_script(const char *path)
+{
+	char line[TEST_LINE];
+	char driver[64] = "";
+	char size[16] = "20x4";
+	char settings[1024] = "";
+	char slave[64];
+	char *expect[TEST_MAX_EXPECT + 1];
+	Emulation emu;
+	pthread_t thread;
+	FILE *f;
+	int frame = 0;
+	int loaded = 0;
+	int ret = 0;
+	int lineno = 0;
+	int y;
+	unsigned long bytes = 0;
+	unsigned long long writes = 0;
+
+	memset(&emu, 0, sizeof(emu));
+	memset(expect, 0, sizeof(expect));
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "drvharness: cannot open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	printf("# %s\n", path);
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		char *cmd, *args;
+		int x, n, promille;
+
+		lineno++;
+		line[strcspn(line, "\r\n")] = '\0';
+		cmd = line + strspn(line, " \t");
+		if ((*cmd == '#') || (*cmd == '\0'))
+			continue;
+		args = cmd + strcspn(cmd, " \t");
+		if (*args != '\0')
+			*args++ = '\0';
+
+		/* the settings come before the first frame */
+		if (strcmp(cmd, "driver") == 0) {
+			strncpy(driver, args, sizeof(driver) - 1);
+			continue;
+		}
+		if (strcmp(cmd, "emulate") == 0) {
+			for (n = 0; (emulators[n].name != NULL) && (strcmp(emulators[n].name, args) != 0); n++)
+				;
+			emu.emulator = (emulators[n].name != NULL) ? &emulators[n] : NULL;
+			continue;
+		}
+		if (strcmp(cmd, "size") == 0) {
+			strncpy(size, args, sizeof(size) - 1);
+			continue;
+		}
+		if (strcmp(cmd, "set") == 0) {
+			strncat(settings, args, sizeof(settings) - strlen(settings) - 2);
+			strcat(settings, "\n");
+			continue;
+		}
+		if (strcmp(cmd, "expect") == 0) {
+			if ((sscanf(args, "%d %n", &y, &n) < 1) || (y < 1) || (y > TEST_MAX_EXPECT))
+				goto syntax;
+			free(expect[y]);
+			expect[y] = strdup(args + n);
+			continue;
+		}
+
+		if (!loaded) {
+			if ((driver[0] == '\0') || (emu.emulator == NULL)
+			    || (sscanf(size, "%dx%d", &emu.width, &emu.height) != 2)
+			    || (emu.width < 1) || (emu.width > LCD_MAX_WIDTH)
+			    || (emu.height < 1) || (emu.height > LCD_MAX_HEIGHT)) {
+				fprintf(stderr, "drvharness: %s: driver, emulate and size must come first\n", path);
+				ret = -1;
+				break;
+			}
+			if (emu_start(&emu, &thread, slave, sizeof(slave)) < 0) {
+				ret = -1;
+				break;
+			}
+			loaded = 1;
+			if (test_load(driver, slave, size, settings) < 0) {
+				printf("# %s skipped: cannot load drivers/%s.so\n", path, driver);
+				ret = 1;
+				break;
+			}
+			loaded = 2;
+			/* what init sends is not part of the first frame */
+			bytes = emu_settle(&emu);
+			writes = test_writes();
+			printf("# frame\tbytes\twrites\tus\n");
+		}
+
+		if (strcmp(cmd, "frame") == 0)
+			drivers_clear();
+		else if ((strcmp(cmd, "string") == 0) && (sscanf(args, "%d %d %n", &x, &y, &n) >= 2))
+			drivers_string(x, y, args + n);
+		else if ((strcmp(cmd, "chr") == 0) && (sscanf(args, "%d %d %n", &x, &y, &n) >= 2))
+			drivers_chr(x, y, args[n]);
+		else if ((strcmp(cmd, "hbar") == 0) && (sscanf(args, "%d %d %d %d", &x, &y, &n, &promille) == 4))
+			drivers_hbar(x, y, n, promille, BAR_PATTERN_FILLED);
+		else if ((strcmp(cmd, "vbar") == 0) && (sscanf(args, "%d %d %d %d", &x, &y, &n, &promille) == 4))
+			drivers_vbar(x, y, n, promille, BAR_PATTERN_FILLED);
+		else if (strcmp(cmd, "backlight") == 0)
+			drivers_backlight((strcmp(args, "off") == 0) ? BACKLIGHT_OFF : BACKLIGHT_ON);
+		else if (strcmp(cmd, "flush") == 0) {
+			struct timespec start, end;
+			unsigned long now_bytes;
+			unsigned long long now_writes;
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			drivers_flush();
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			now_bytes = emu_settle(&emu);
+			now_writes = test_writes();
+			printf("%d\t%lu\t%llu\t%ld\n", ++frame, now_bytes - bytes, now_writes - writes,
+			       (long) ((end.tv_sec - start.tv_sec) * 1000000L
+				       + (end.tv_nsec - start.tv_nsec) / 1000));
+			bytes = now_bytes;
+			writes = now_writes;
+		}
+		else
+			goto syntax;
+		continue;
+
+syntax:
+		fprintf(stderr, "drvharness: %s:%d: cannot run \"%s %s\"\n", path, lineno, cmd, args);
+		ret = -1;
+		break;
+	}
+	fclose(f);
+
+	if (ret == 0) {
+		pthread_mutex_lock(&emu.lock);
+		for (y = 1; y <= emu.height; y++) {
+			if (verbose) {
+				printf("# |");
+				test_print_row(&emu, y);
+				printf("|\n");
+			}
+			if ((expect[y] != NULL) && (test_row(&emu, y, expect[y]) < 0)) {
+				printf("# FAIL row %d: |", y);
+				test_print_row(&emu, y);
+				printf("|, expected |%s|\n", expect[y]);
+				ret = -1;
+			}
+		}
+		pthread_mutex_unlock(&emu.lock);
+		printf("# %s: %s\n", path, (ret == 0) ? "ok" : "FAILED");
+	}
+
+	if (loaded == 2)
+		drivers_unload_all();
+	if (loaded)
+		emu_stop(&emu, thread);
+	for (y = 0; y <= TEST_MAX_EXPECT; y++)
+		free(expect[y]);
+	return ret;
+}
+
+
+int
+main(int argc, char **argv)
+{
+	int failed = 0;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "v")) > 0) {
+		switch (c) {
+			case 'v':
+				verbose = 1;
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-v] <script>...\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	set_reporting("drvharness", RPT_ERR, RPT_DEST_STDERR);
+	for (i = optind; i < argc; i++) {
+		if (test_script(argv[i]) < 0)
+			failed++;
+	}
+	return (failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,660 @@
+/** \file server/drvthread.c
+ * This file contains the flush threads for drivers that update their
+ * display asynchronously. Sending a frame to a slow display (e.g. an
+ * HD44780 on an I2C backpack) can take longer than rendering it; doing it
+ * on the main thread holds back the other drivers and the clients.
+ *
+ * The core records the output operations of a frame in a display list
+ * (see drivers_flush()). When the frame is complete the list is copied
+ * once into a shared frame that the flush threads of the display's drivers
+ * get a reference to; each thread replays it on its driver and flushes the
+ * driver at its own frame interval. Frames that arrive while a thread is still busy are
+ * merged: the frames before the last one starting over with a clear are
+ * dropped, only their last backlight and output state is kept. So a slow
+ * display skips frames without holding back the others.
+ *
+ * A driver with a flush thread must not be called from the main thread
+ * without holding its lock, see drvthread_lock().
+ *
+ * Drivers can also be initialized on threads of their own at startup, so
+ * that the hardware reset pauses of several drivers overlap.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_LIBPTHREAD)
+# define USE_THREADS
+# include <pthread.h>
+# include <signal.h>
+# include <sys/time.h>
+#endif
+
+#include "shared/report.h"
+#include "shared/vector.h"
+
+#include "drvthread.h"
+#include "reconnect.h"
+#include "displaylist.h"
+#include "stats.h"
+#include "profile.h"
+
+
+#ifdef USE_THREADS
+
+/** A frame handed to all flush threads, freed by the last one done */
+typedef struct SharedFrame {
+	DisplayList list;		/**< The frame's operations */
+	int clears;			/**< Whether it starts over with a clear */
+	int backlight;			/**< Last backlight state in it, or -1 */
+	int output;			/**< Last output state in it, or -1 */
+	int refs;			/**< Threads still holding it */
+} SharedFrame;
+
+/** State of one driver's flush thread */
+typedef struct FlushThread {
+	Driver *drv;
+	int display;			/**< Display the driver is on */
+	int interval;			/**< Minimum time between flushes in us */
+	pthread_t thread;
+	pthread_mutex_t mutex;		/**< Protects pending, the states and stop */
+	pthread_cond_t cond;		/**< Signals a new frame or stop */
+	pthread_mutex_t drv_lock;	/**< Held while the driver is used */
+	Vector *pending;		/**< Shared frames not yet picked up */
+	int backlight;			/**< State of frames dropped, or -1 */
+	int output;			/**< State of frames dropped, or -1 */
+	int stop;
+	int dropped;			/**< Frames merged before being shown */
+	struct timeval last_flush;
+	struct FlushThread *next;
+} FlushThread;
+
+static FlushThread *threads = NULL;	/**< All running flush threads */
+static int thread_count = 0;
+
+/** State of a driver initialized on a thread of its own */
+struct DriverInit {
+	Driver *drv;
+	pthread_t thread;
+	pthread_mutex_t mutex;		/**< Protects res, done and abandoned */
+	pthread_cond_t cond;		/**< Signals that init returned */
+	int timeout;			/**< Time allowed in ms, 0 for no limit */
+	struct timespec deadline;
+	int res;			/**< Return code of driver_init() */
+	int done;
+	int abandoned;			/**< Timed out, the thread cleans up */
+};
+
+/** Protects the reference counts of the shared frames */
+static pthread_mutex_t frame_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* Give up a reference to a shared frame */
+static void
+drvthread_release(SharedFrame *frame)
+{
+	int refs;
+
+	pthread_mutex_lock(&frame_lock);
+	refs = --frame->refs;
+	pthread_mutex_unlock(&frame_lock);
+
+	if (refs == 0) {
+		displaylist_free(&frame->list);
+		free(frame);
+	}
+}
+
+
+/* Find the flush thread of a driver */
+static FlushThread *
+drvthread_find(Driver *drv)
+{
+	FlushThread *ft;
+
+	for (ft = threads; ft != NULL; ft = ft->next) {
+		if (ft->drv == drv)
+			return ft;
+	}
+	return NULL;
+}
+
+
+/* Wait until the frame interval has passed since the last flush and the
+ * driver is no longer busy with it, or the thread is stopped. Called with
+ * ft->mutex held. */
+static void
+drvthread_wait_interval(FlushThread *ft)
+{
+	struct timeval now;
+	struct timespec due;
+	long passed;
+	long remaining = 0;
+
+	gettimeofday(&now, NULL);
+	if (ft->interval > 0) {
+		passed = (now.tv_sec - ft->last_flush.tv_sec) * 1000000
+			 + (now.tv_usec - ft->last_flush.tv_usec);
+		/* the clock may have been set back */
+		if ((passed >= 0) && (passed < ft->interval))
+			remaining = ft->interval - passed;
+	}
+	remaining = max(remaining, driver_busy(ft->drv));
+	if (remaining <= 0)
+		return;
+
+	due.tv_sec = now.tv_sec + (now.tv_usec + remaining) / 1000000;
+	due.tv_nsec = ((now.tv_usec + remaining) % 1000000) * 1000;
+
+	/* new frames wake us up too; they simply get merged */
+	while (!ft->stop) {
+		if (pthread_cond_timedwait(&ft->cond, &ft->mutex, &due) == ETIMEDOUT)
+			break;
+	}
+}
+
+
+/* Main function of a flush thread */
+static void *
+drvthread_main(void *arg)
+{
+	FlushThread *ft = arg;
+	Vector *work;
+	Vector *tmp;
+	SharedFrame *frame;
+	DriverOp state;
+	int backlight, output;
+	StatsHistogram *flush_stats;
+	unsigned long start;
+	unsigned long long cpu_start = 0;
+
+	work = V_new();
+	if (work == NULL) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&ft->mutex);
+	for (;;) {
+		while (!ft->stop && (V_Length(ft->pending) == 0))
+			pthread_cond_wait(&ft->cond, &ft->mutex);
+		/* when stopped, the last frame is still shown */
+		if (V_Length(ft->pending) == 0)
+			break;
+
+		drvthread_wait_interval(ft);
+
+		tmp = work;
+		work = ft->pending;
+		ft->pending = tmp;
+		backlight = ft->backlight;
+		output = ft->output;
+		ft->backlight = ft->output = -1;
+		pthread_mutex_unlock(&ft->mutex);
+
+		pthread_mutex_lock(&ft->drv_lock);
+		if (!reconnect_online(ft->drv)) {
+			/* the device is gone, the frames go nowhere */
+			while ((frame = V_Shift(work)) != NULL)
+				drvthread_release(frame);
+			pthread_mutex_unlock(&ft->drv_lock);
+			reconnect_check(ft->drv);
+			pthread_mutex_lock(&ft->mutex);
+			continue;
+		}
+		start = stats_clock();
+		if (profile_enabled)
+			cpu_start = profile_thread_time();
+		memset(&state, 0, sizeof(state));
+		if (backlight >= 0) {
+			state.type = DOP_BACKLIGHT;
+			state.a = backlight;
+			driver_apply_op(ft->drv, &state);
+		}
+		if (output >= 0) {
+			state.type = DOP_OUTPUT;
+			state.a = output;
+			driver_apply_op(ft->drv, &state);
+		}
+		while ((frame = V_Shift(work)) != NULL) {
+			displaylist_apply(&frame->list, ft->drv);
+			drvthread_release(frame);
+		}
+		if (ft->drv->flush)
+			ft->drv->flush(ft->drv);
+		driver_flushed(ft->drv, start);
+		if ((flush_stats = stats_driver_flush(ft->drv)) != NULL)
+			stats_histogram_add(flush_stats, stats_clock() - start);
+		if (profile_enabled)
+			profile_add(profile_driver(ft->drv), profile_thread_time() - cpu_start);
+		pthread_mutex_unlock(&ft->drv_lock);
+		reconnect_check(ft->drv);
+
+		gettimeofday(&ft->last_flush, NULL);
+
+		pthread_mutex_lock(&ft->mutex);
+	}
+	pthread_mutex_unlock(&ft->mutex);
+
+	V_Destroy(work);
+	return NULL;
+}
+
+
+/**
+ * Start a flush thread for a driver. From now on the driver's output
+ * functions and flush() are only called by that thread.
+ * \param drv       The driver.
+ * \param interval  Minimum time between two flushes in microseconds;
+ *                  0 flushes every frame rendered.
+ * \param display   The display the driver is on; it only gets the frames
+ *                  of that one.
+ * \return  -1 on error, 0 on success.
+ */
+int
+drvthread_start(Driver *drv, int interval, int display)
+{
+	FlushThread *ft;
+	sigset_t all, old;
+	int err;
+
+	if (drvthread_find(drv) != NULL)
+		return 0;
+
+	ft = calloc(1, sizeof(FlushThread));
+	if (ft == NULL) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		return -1;
+	}
+	ft->drv = drv;
+	ft->display = display;
+	ft->interval = (interval > 0) ? interval : 0;
+	ft->backlight = ft->output = -1;
+	ft->pending = V_new();
+	if (ft->pending == NULL) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		free(ft);
+		return -1;
+	}
+	pthread_mutex_init(&ft->mutex, NULL);
+	pthread_cond_init(&ft->cond, NULL);
+	pthread_mutex_init(&ft->drv_lock, NULL);
+
+	/* signals are handled by the main thread only */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	err = pthread_create(&ft->thread, NULL, drvthread_main, ft);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err != 0) {
+		report(RPT_ERR, "%s: cannot create flush thread for driver [%.40s] - %s",
+		       __FUNCTION__, drv->name, strerror(err));
+		pthread_mutex_destroy(&ft->mutex);
+		pthread_cond_destroy(&ft->cond);
+		pthread_mutex_destroy(&ft->drv_lock);
+		V_Destroy(ft->pending);
+		free(ft);
+		return -1;
+	}
+
+	ft->next = threads;
+	threads = ft;
+	thread_count++;
+
+	report(RPT_INFO, "Driver [%.40s] flushes on its own thread, interval %d us",
+	       drv->name, ft->interval);
+	return 0;
+}
+
+
+/**
+ * Stop the flush thread of a driver, after it has shown the frames handed
+ * to it. Does nothing if the driver has no flush thread.
+ * \param drv  The driver.
+ */
+void
+drvthread_stop(Driver *drv)
+{
+	FlushThread **p;
+	FlushThread *ft;
+	SharedFrame *frame;
+
+	for (p = &threads; (*p != NULL) && ((*p)->drv != drv); p = &(*p)->next)
+		;
+	if (*p == NULL)
+		return;
+	ft = *p;
+	*p = ft->next;
+	thread_count--;
+
+	pthread_mutex_lock(&ft->mutex);
+	ft->stop = 1;
+	pthread_cond_signal(&ft->cond);
+	pthread_mutex_unlock(&ft->mutex);
+	pthread_join(ft->thread, NULL);
+
+	if (ft->dropped > 0)
+		report(RPT_INFO, "Driver [%.40s] skipped %d frames", drv->name, ft->dropped);
+
+	while ((frame = V_Shift(ft->pending)) != NULL)
+		drvthread_release(frame);
+	V_Destroy(ft->pending);
+	pthread_mutex_destroy(&ft->mutex);
+	pthread_cond_destroy(&ft->cond);
+	pthread_mutex_destroy(&ft->drv_lock);
+	free(ft);
+}
+
+
+/**
+ * Tell how many drivers flush on threads of their own.
+ * \return  Number of flush threads.
+ */
+int
+drvthread_count(void)
+{
+	return thread_count;
+}
+
+
+/**
+ * Tell whether a driver flushes on a thread of its own.
+ * \param drv  The driver.
+ * \return  1 if it does, 0 otherwise.
+ */
+int
+drvthread_active(Driver *drv)
+{
+	return (drvthread_find(drv) != NULL);
+}
+
+
+/**
+ * Tell how many frames a driver's flush thread merged with later ones
+ * because it was still busy with an earlier frame.
+ * \param drv  The driver.
+ * \return  Number of frames skipped, 0 for drivers without flush thread.
+ */
+int
+drvthread_dropped(Driver *drv)
+{
+	FlushThread *ft = drvthread_find(drv);
+	int dropped;
+
+	if (ft == NULL)
+		return 0;
+
+	pthread_mutex_lock(&ft->mutex);
+	dropped = ft->dropped;
+	pthread_mutex_unlock(&ft->mutex);
+	return dropped;
+}
+
+
+/**
+ * Hand a complete frame to the flush threads of the drivers on a display.
+ * The frame is copied once and shared by the threads; a thread that has
+ * not picked up the frames before drops those the new one draws over.
+ * \param frame    The frame's operations; they are copied.
+ * \param display  The display it was rendered for.
+ */
+void
+drvthread_publish(const DisplayList *frame, int display)
+{
+	FlushThread *ft;
+	SharedFrame *shared;
+	SharedFrame *old;
+	int refs = 0;
+	int i;
+
+	for (ft = threads; ft != NULL; ft = ft->next) {
+		if (ft->display == display)
+			refs++;
+	}
+	if (refs == 0)
+		return;
+
+	shared = calloc(1, sizeof(SharedFrame));
+	if (shared == NULL) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		return;
+	}
+	shared->backlight = shared->output = -1;
+	for (i = 0; i < frame->count; i++) {
+		const DriverOp *op = &frame->ops[i];
+
+		if (displaylist_add(&shared->list, op) < 0)
+			break;
+		if (op->type == DOP_CLEAR)
+			shared->clears = 1;
+		else if (op->type == DOP_BACKLIGHT)
+			shared->backlight = op->a;
+		else if (op->type == DOP_OUTPUT)
+			shared->output = op->a;
+	}
+	shared->refs = refs;
+
+	for (ft = threads; ft != NULL; ft = ft->next) {
+		if (ft->display != display)
+			continue;
+		pthread_mutex_lock(&ft->mutex);
+		if (V_Append(ft->pending, shared) < 0) {
+			pthread_mutex_unlock(&ft->mutex);
+			drvthread_release(shared);
+			continue;
+		}
+		while (shared->clears && (V_Length(ft->pending) > 1)) {
+			old = V_Shift(ft->pending);
+			if (old->backlight >= 0)
+				ft->backlight = old->backlight;
+			if (old->output >= 0)
+				ft->output = old->output;
+			if (old->clears)
+				ft->dropped++;
+			drvthread_release(old);
+		}
+		pthread_cond_signal(&ft->cond);
+		pthread_mutex_unlock(&ft->mutex);
+	}
+}
+
+
+/**
+ * Wait for exclusive access to a driver.
+ * \param drv  The driver.
+ */
+void
+drvthread_lock(Driver *drv)
+{
+	FlushThread *ft = drvthread_find(drv);
+
+	if (ft != NULL)
+		pthread_mutex_lock(&ft->drv_lock);
+}
+
+
+/**
+ * Get exclusive access to a driver if it is not flushing right now.
+ * \param drv  The driver.
+ * \return  0 on success, -1 if the driver is busy.
+ */
+int
+drvthread_trylock(Driver *drv)
+{
+	FlushThread *ft = drvthread_find(drv);
+
+	if ((ft != NULL) && (pthread_mutex_trylock(&ft->drv_lock) != 0))
+		return -1;
+	return 0;
+}
+
+
+/**
+ * Give up exclusive access to a driver.
+ * \param drv  The driver.
+ */
+void
+drvthread_unlock(Driver *drv)
+{
+	FlushThread *ft = drvthread_find(drv);
+
+	if (ft != NULL)
+		pthread_mutex_unlock(&ft->drv_lock);
+}
+
+
+/* Free the state of an init thread */
+static void
+drvthread_init_free(DriverInit *job)
+{
+	pthread_mutex_destroy(&job->mutex);
+	pthread_cond_destroy(&job->cond);
+	free(job);
+}
+
+
+/* Main function of an init thread */
+static void *
+drvthread_init_main(void *arg)
+{
+	DriverInit *job = arg;
+	int res;
+	int abandoned;
+
+	res = driver_init(job->drv);
+
+	pthread_mutex_lock(&job->mutex);
+	job->res = res;
+	job->done = 1;
+	abandoned = job->abandoned;
+	pthread_cond_signal(&job->cond);
+	pthread_mutex_unlock(&job->mutex);
+
+	/* nobody waits for the driver any more */
+	if (abandoned) {
+		if (res >= 0) {
+			report(RPT_WARNING, "Driver [%.40s] finished init too late, closing it",
+			       job->drv->name);
+			driver_unload(job->drv);
+		}
+		drvthread_init_free(job);
+	}
+	return NULL;
+}
+
+
+/**
+ * Initialize a driver on a thread of its own; see drvthread_init_wait().
+ * \param drv      A driver created by driver_new().
+ * \param timeout  Time allowed for the init in milliseconds, 0 for no limit.
+ * \return  State of the init; \c NULL if no thread could be started, the
+ *          driver then has to be initialized by the caller.
+ */
+DriverInit *
+drvthread_init_start(Driver *drv, int timeout)
+{
+	DriverInit *job;
+	struct timeval now;
+	long usec;
+	sigset_t all, old;
+	int err;
+
+	job = calloc(1, sizeof(DriverInit));
+	if (job == NULL) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		return NULL;
+	}
+	job->drv = drv;
+	job->timeout = (timeout > 0) ? timeout : 0;
+	gettimeofday(&now, NULL);
+	usec = now.tv_usec + (long) (job->timeout % 1000) * 1000;
+	job->deadline.tv_sec = now.tv_sec + job->timeout / 1000 + usec / 1000000;
+	job->deadline.tv_nsec = (usec % 1000000) * 1000;
+	pthread_mutex_init(&job->mutex, NULL);
+	pthread_cond_init(&job->cond, NULL);
+
+	/* signals are handled by the main thread only */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	err = pthread_create(&job->thread, NULL, drvthread_init_main, job);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err != 0) {
+		report(RPT_WARNING, "%s: cannot create init thread for driver [%.40s] - %s",
+		       __FUNCTION__, drv->name, strerror(err));
+		drvthread_init_free(job);
+		return NULL;
+	}
+	return job;
+}
+
+
+/**
+ * Wait for the init of a driver started by drvthread_init_start(). If the
+ * init function failed the driver is freed already; if it did not return
+ * in time the thread is left alone and frees the driver when it does.
+ * \param job  State of the init.
+ * \return  Return code of the driver's init function; <0 on error or
+ *          time-out.
+ */
+int
+drvthread_init_wait(DriverInit *job)
+{
+	int res;
+
+	pthread_mutex_lock(&job->mutex);
+	while (!job->done) {
+		if (job->timeout == 0)
+			pthread_cond_wait(&job->cond, &job->mutex);
+		else if ((pthread_cond_timedwait(&job->cond, &job->mutex, &job->deadline) == ETIMEDOUT)
+			 && !job->done) {
+			/* report while the thread cannot free the driver */
+			report(RPT_ERR, "Driver [%.40s] init timed out after %d ms",
+			       job->drv->name, job->timeout);
+			job->abandoned = 1;
+			pthread_detach(job->thread);
+			pthread_mutex_unlock(&job->mutex);
+			return -1;
+		}
+	}
+	res = job->res;
+	pthread_mutex_unlock(&job->mutex);
+
+	pthread_join(job->thread, NULL);
+	drvthread_init_free(job);
+	return res;
+}
+
+
+#else
+/****************************************************************************/
+/* Without thread support all drivers flush on the main thread */
+
+int
+drvthread_start(Driver *drv, int interval, int display)
+{
+	report(RPT_WARNING, "%s: LCDd was built without thread support", __FUNCTION__);
+	return -1;
+}
+
+void drvthread_stop(Driver *drv) { }
+int drvthread_count(void) { return 0; }
+int drvthread_active(Driver *drv) { return 0; }
+int drvthread_dropped(Driver *drv) { return 0; }
+void drvthread_publish(const DisplayList *frame, int display) { }
+void drvthread_lock(Driver *drv) { }
+int drvthread_trylock(Driver *drv) { return 0; }
+void drvthread_unlock(Driver *drv) { }
+DriverInit *drvthread_init_start(Driver *drv, int timeout) { return NULL; }
+int drvthread_init_wait(DriverInit *job) { return -1; }
+
+#endif
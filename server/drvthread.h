@@ -0,0 +1,56 @@
+/** \file server/drvthread.h
+ * Interface to the flush threads of drivers that update their display
+ * asynchronously.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef DRVTHREAD_H
+#define DRVTHREAD_H
+
+#include "drivers/lcd.h"
+#include "driver.h"
+#include "displaylist.h"
+
+/* Start a flush thread for a driver on a display; interval is the minimum
+ * time between two flushes in microseconds (0: every frame). */
+int drvthread_start(Driver *drv, int interval, int display);
+
+/* Stop a driver's flush thread after it has shown the last frame. */
+void drvthread_stop(Driver *drv);
+
+/* Number of drivers flushing on threads of their own. */
+int drvthread_count(void);
+
+/* Tell whether a driver flushes on a thread of its own. */
+int drvthread_active(Driver *drv);
+
+/* Number of frames a driver's flush thread skipped. */
+int drvthread_dropped(Driver *drv);
+
+/* Hand a complete frame to the flush threads of a display's drivers. */
+void drvthread_publish(const DisplayList *frame, int display);
+
+/* Get exclusive access to a driver for calls from the main thread.
+ * They do nothing for drivers without a flush thread. */
+void drvthread_lock(Driver *drv);
+int drvthread_trylock(Driver *drv);
+void drvthread_unlock(Driver *drv);
+
+/* State of a driver initialized on a thread of its own. */
+typedef struct DriverInit DriverInit;
+
+/* Initialize a driver (created by driver_new()) on a thread of its own;
+ * timeout is in milliseconds (0: no limit). Returns NULL if no thread
+ * could be started. */
+DriverInit *drvthread_init_start(Driver *drv, int timeout);
+
+/* Wait for the init; returns the init function's return code, or -1 if
+ * it timed out. */
+int drvthread_init_wait(DriverInit *job);
+
+#endif
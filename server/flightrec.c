@@ -0,0 +1,319 @@
+/** \file server/flightrec.c
+ * This file contains the flight recorder: a log of the server's timing,
+ * cheap enough to be always on, for stutters that happen once a day on a
+ * box in the field. Frames, driver flushes, client connections, parsed
+ * commands and keys are written as records of 16 bytes into a file
+ * mapped into memory. The records go round in a circle, so the file keeps
+ * the last ones; as it is a shared mapping, what was written is in the
+ * file also after a crash.
+ *
+ * The file starts with a header of FLIGHT_HEADER_SIZE bytes that tells
+ * the number of records written and the names of the drivers, followed by
+ * the records. Numbers are in the byte order of the machine.
+ * 'LCDd -F <file>' prints a flight record as a timeline.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "shared/report.h"
+
+#include "flightrec.h"
+
+#define FLIGHT_MAGIC		"LCDdFLT"	/**< With the 0: 8 bytes */
+#define FLIGHT_VERSION		1
+#define FLIGHT_HEADER_SIZE	4096		/**< The records start here */
+#define FLIGHT_DRIVERS		32		/**< Driver names in the header */
+#define FLIGHT_NAME_SIZE	32
+#define FLIGHT_NO_DRIVER	0xFFFF		/**< Id of a driver without a name */
+
+/** Header at the start of the file */
+typedef struct FlightHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t capacity;		/**< Records in the file, a power of 2 */
+	uint32_t drivers;		/**< Driver names in use */
+	uint32_t written;		/**< Records written; wraps around */
+	uint32_t reserved;
+	uint64_t started;		/**< Time of the start, in us since the epoch */
+	char driver_names[FLIGHT_DRIVERS][FLIGHT_NAME_SIZE];
+} FlightHeader;
+
+/** A record; type is 0 while it is written */
+typedef struct FlightRecord {
+	uint64_t time;			/**< In us since the epoch */
+	uint16_t type;
+	uint16_t id;
+	uint32_t value;
+} FlightRecord;
+
+static FlightHeader *header = NULL;
+static FlightRecord *records;
+static size_t mapped_size;
+
+
+/** The time in us since the epoch. */
+static uint64_t
+flightrec_now(void)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+
+/**
+ * Start recording into a file. An existing flight record is kept as
+ * <path>.old, in case the server was restarted after a crash.
+ * \param path     File to record into.
+ * \param count    Number of records to keep; rounded up to a power of 2.
+ * \retval 0   The recorder runs.
+ * \retval -1  It could not be started.
+ */
+int
+flightrec_init(const char *path, int count)
+{
+	unsigned int capacity = 16;
+	FlightHeader old;
+	int fd;
+	void *map;
+
+	if (header != NULL)
+		return 0;
+	while ((capacity < (unsigned int) count) && (capacity < (1U << 24)))
+		capacity <<= 1;
+
+	/* Keep the record of the run before */
+	fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		if ((read(fd, &old, sizeof(old)) == sizeof(old))
+		    && (memcmp(old.magic, FLIGHT_MAGIC, sizeof(old.magic)) == 0)) {
+			char *old_path = malloc(strlen(path) + 5);
+
+			if (old_path != NULL) {
+				sprintf(old_path, "%s.old", path);
+				if (rename(path, old_path) < 0)
+					report(RPT_WARNING, "Could not rename %s: %s", path, strerror(errno));
+				free(old_path);
+			}
+		}
+		close(fd);
+	}
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		report(RPT_ERR, "Could not open flight record %s: %s", path, strerror(errno));
+		return -1;
+	}
+	mapped_size = FLIGHT_HEADER_SIZE + (size_t) capacity * sizeof(FlightRecord);
+	if (ftruncate(fd, mapped_size) < 0) {
+		report(RPT_ERR, "Could not size flight record %s: %s", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		report(RPT_ERR, "Could not map flight record %s: %s", path, strerror(errno));
+		return -1;
+	}
+
+	header = map;
+	records = (FlightRecord *) ((char *) map + FLIGHT_HEADER_SIZE);
+	header->version = FLIGHT_VERSION;
+	header->record_size = sizeof(FlightRecord);
+	header->capacity = capacity;
+	header->started = flightrec_now();
+	memcpy(header->magic, FLIGHT_MAGIC, sizeof(header->magic));
+
+	report(RPT_INFO, "Flight recorder keeps the last %u records in %s", capacity, path);
+	return 0;
+}
+
+
+/** Stop recording; what was recorded stays in the file. */
+void
+flightrec_shutdown(void)
+{
+	if (header == NULL)
+		return;
+	munmap(header, mapped_size);
+	header = NULL;
+}
+
+
+/**
+ * Give a driver a number in the flight record.
+ * \param name  Name of the driver.
+ * \return  Its id for flightrec_event(), or -1 if it has none.
+ */
+int
+flightrec_driver(const char *name)
+{
+	int id;
+
+	if ((header == NULL) || (header->drivers >= FLIGHT_DRIVERS))
+		return -1;
+	id = header->drivers;
+	strncpy(header->driver_names[id], name, FLIGHT_NAME_SIZE - 1);
+	header->drivers++;
+	return id;
+}
+
+
+/**
+ * Record an event; may be called from any thread. Does nothing if the
+ * recorder is off.
+ * \param type   One of the FLIGHT_* kinds.
+ * \param id     Socket or driver id it is about.
+ * \param value  Duration or count, as the kind says.
+ */
+void
+flightrec_event(int type, int id, unsigned long value)
+{
+	FlightRecord *r;
+	uint32_t n;
+
+	if (header == NULL)
+		return;
+
+	n = __atomic_fetch_add(&header->written, 1, __ATOMIC_RELAXED);
+	r = &records[n & (header->capacity - 1)];
+	__atomic_store_n(&r->type, 0, __ATOMIC_RELAXED);
+	r->time = flightrec_now();
+	r->id = (id >= 0) ? id : FLIGHT_NO_DRIVER;
+	r->value = (value > UINT32_MAX) ? UINT32_MAX : value;
+	__atomic_store_n(&r->type, type, __ATOMIC_RELEASE);
+}
+
+
+/** Name of a driver in a flight record. */
+static const char *
+flightrec_driver_name(const FlightHeader *h, int id)
+{
+	if (id >= (int) h->drivers)
+		return "?";
+	return h->driver_names[id];
+}
+
+
+/**
+ * Print a flight record as a timeline to stdout: a line per record, with
+ * the wall clock time and what happened.
+ * \param path  The file.
+ * \retval 0   Printed.
+ * \retval -1  It could not be read.
+ */
+int
+flightrec_dump(const char *path)
+{
+	FlightHeader h;
+	FlightRecord *recs;
+	FILE *f;
+	uint32_t count, first, i;
+	uint64_t last_frame = 0;
+	time_t secs;
+	char stamp[32];
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		report(RPT_ERR, "Could not open flight record %s: %s", path, strerror(errno));
+		return -1;
+	}
+	if ((fread(&h, sizeof(h), 1, f) != 1)
+	    || (memcmp(h.magic, FLIGHT_MAGIC, sizeof(h.magic)) != 0)
+	    || (h.version != FLIGHT_VERSION) || (h.record_size != sizeof(FlightRecord))
+	    || (h.capacity == 0) || ((h.capacity & (h.capacity - 1)) != 0)
+	    || (h.capacity > (1U << 24)) || (h.drivers > FLIGHT_DRIVERS)) {
+		report(RPT_ERR, "%s is not a flight record of this LCDd", path);
+		fclose(f);
+		return -1;
+	}
+	recs = malloc((size_t) h.capacity * sizeof(FlightRecord));
+	if ((recs == NULL) || (fseek(f, FLIGHT_HEADER_SIZE, SEEK_SET) < 0)
+	    || (fread(recs, sizeof(FlightRecord), h.capacity, f) != h.capacity)) {
+		report(RPT_ERR, "Could not read flight record %s", path);
+		free(recs);
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	secs = h.started / 1000000;
+	strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&secs));
+	count = (h.written > h.capacity) ? h.capacity : h.written;
+	first = h.written - count;
+	printf("Flight record of LCDd started %s: %u records, %u before them overwritten\n",
+	       stamp, count, first);
+
+	for (i = 0; i < count; i++) {
+		const FlightRecord *r = &recs[(first + i) & (h.capacity - 1)];
+		char when[40];
+
+		if (r->type == 0)
+			continue;	/* being written when it was read */
+
+		secs = r->time / 1000000;
+		strftime(when, sizeof(when), "%H:%M:%S", localtime(&secs));
+		printf("%s.%06u  ", when, (unsigned int) (r->time % 1000000));
+
+		switch (r->type) {
+		    case FLIGHT_FRAME_START:
+			if (last_frame != 0)
+				printf("frame      start, %.1f ms after the last\n",
+				       (r->time - last_frame) / 1000.0);
+			else
+				printf("frame      start\n");
+			last_frame = r->time;
+			break;
+		    case FLIGHT_FRAME_END:
+			if (r->id)
+				printf("frame      skipped\n");
+			else
+				printf("frame      rendered in %u us\n", r->value);
+			break;
+		    case FLIGHT_FLUSH:
+			printf("flush      %s in %u us\n", flightrec_driver_name(&h, r->id), r->value);
+			break;
+		    case FLIGHT_CONNECT:
+			printf("connect    socket %u\n", r->id);
+			break;
+		    case FLIGHT_DISCONNECT:
+			printf("disconnect socket %u\n", r->id);
+			break;
+		    case FLIGHT_COMMANDS:
+			printf("commands   socket %u: %u\n", r->id, r->value);
+			break;
+		    case FLIGHT_KEY:
+			printf("key        %s, %u us after the press\n",
+			       flightrec_driver_name(&h, r->id), r->value);
+			break;
+		    default:
+			printf("type %u    id %u, value %u\n", r->type, r->id, r->value);
+			break;
+		}
+	}
+
+	free(recs);
+	return 0;
+}
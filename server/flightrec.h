@@ -0,0 +1,34 @@
+/** \file server/flightrec.h
+ * Interface to the flight recorder, a binary log of the server's timing
+ * that is kept in a memory-mapped file.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef FLIGHTREC_H
+#define FLIGHTREC_H
+
+/** Records kept by default: 1 MB */
+#define DEFAULT_FLIGHT_RECORDS	65536
+
+/* Kinds of flight records */
+#define FLIGHT_FRAME_START	1	/**< Rendering of a frame started */
+#define FLIGHT_FRAME_END	2	/**< It ended; value: us, id: 1 if skipped */
+#define FLIGHT_FLUSH		3	/**< A driver flushed; id: driver, value: us */
+#define FLIGHT_CONNECT		4	/**< A client connected; id: socket */
+#define FLIGHT_DISCONNECT	5	/**< A client went away; id: socket */
+#define FLIGHT_COMMANDS		6	/**< Commands parsed; id: socket, value: count */
+#define FLIGHT_KEY		7	/**< A key was handled; id: driver, value: us since pressed */
+
+int flightrec_init(const char *path, int records);
+void flightrec_shutdown(void);
+int flightrec_driver(const char *name);
+void flightrec_event(int type, int id, unsigned long value);
+
+int flightrec_dump(const char *path);
+
+#endif
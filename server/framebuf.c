@@ -0,0 +1,492 @@
+/** \file server/framebuf.c
+ * This file contains the server's virtual frame buffer. It records what the
+ * render code sends to the drivers in a frame, and compares it to the
+ * previous frame to find the parts of the display that changed. This is
+ * done once per frame for all drivers: a driver providing \c flush_spans
+ * then only needs to send those spans instead of comparing its own frame
+ * buffer to a backing store.
+ *
+ * The frame buffer does not know what the drivers make of bars, icons or
+ * big numbers. It records the operation and its arguments for every cell
+ * it covers instead, so a cell counts as changed if anything drawn onto it
+ * changed. Output that a driver animates on its own (heartbeat, software
+ * cursor) always counts as changed.
+ *
+ * A line of text that moved by one column, like a scroller filling a line,
+ * is found as well. Displays that can shift a line in hardware (see
+ * scroll_text) are then only sent the character moved in.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "shared/report.h"
+
+#include "framebuf.h"
+
+/** Unchanged cells between two changes that are sent anyway to save a
+ * cursor positioning command. */
+#define FB_SPAN_GAP	3
+
+/** Shortest line worth a hardware scroll instead of sending it */
+#define FB_SCROLL_MIN	4
+
+/** Contents of one character cell */
+typedef struct FrameCell {
+	int op;			/**< FrameOp that wrote the cell */
+	int a, b, c;		/**< Arguments of the operation */
+	int offset;		/**< Position of the cell within the operation */
+} FrameCell;
+
+static FrameCell *frame = NULL;		/**< Frame being rendered */
+static FrameCell *shown = NULL;		/**< Frame on the display */
+static FrameCell *spare = NULL;		/**< Frame rendered ahead, see framebuf_swap() */
+static LCDSpan *spans = NULL;		/**< Result of framebuf_diff() */
+static LCDSpan *scrolled = NULL;	/**< Result of framebuf_diff_scrolled() */
+static FrameScroll *scrolls = NULL;	/**< Result of framebuf_scrolls() */
+static FrameCell *moved = NULL;		/**< A line as shown after a scroll */
+static int fb_width = 0;
+static int fb_height = 0;
+static int frame_seq = 0;		/**< Number of the frame being rendered */
+
+
+/**
+ * Create the frame buffer.
+ * \param width   Display width in characters.
+ * \param height  Display height in characters.
+ * \return  -1 on error, 0 on success.
+ */
+int
+framebuf_init(int width, int height)
+{
+	framebuf_shutdown();
+
+	if ((width <= 0) || (height <= 0))
+		return -1;
+
+	frame = calloc(width * height, sizeof(FrameCell));
+	shown = calloc(width * height, sizeof(FrameCell));
+	spare = calloc(width * height, sizeof(FrameCell));
+	/* at most every other cell starts a span */
+	spans = calloc(height * (width / 2 + 1), sizeof(LCDSpan));
+	scrolled = calloc(height * (width / 2 + 1), sizeof(LCDSpan));
+	scrolls = calloc(height, sizeof(FrameScroll));
+	moved = calloc(width, sizeof(FrameCell));
+	if ((frame == NULL) || (shown == NULL) || (spare == NULL) || (spans == NULL)
+	    || (scrolled == NULL) || (scrolls == NULL) || (moved == NULL)) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		framebuf_shutdown();
+		return -1;
+	}
+	fb_width = width;
+	fb_height = height;
+	framebuf_invalidate();
+
+	return 0;
+}
+
+
+/** Release the frame buffer. */
+void
+framebuf_shutdown(void)
+{
+	free(frame);
+	frame = NULL;
+	free(shown);
+	shown = NULL;
+	free(spare);
+	spare = NULL;
+	free(spans);
+	spans = NULL;
+	free(scrolled);
+	scrolled = NULL;
+	free(scrolls);
+	scrolls = NULL;
+	free(moved);
+	moved = NULL;
+	fb_width = 0;
+	fb_height = 0;
+}
+
+
+/**
+ * Forget what the display shows, e.g. after a driver has been (re)loaded,
+ * so the next frame is sent completely.
+ */
+void
+framebuf_invalidate(void)
+{
+	int i;
+
+	for (i = 0; i < fb_width * fb_height; i++) {
+		memset(&shown[i], 0, sizeof(FrameCell));
+		shown[i].op = FB_UNKNOWN;
+	}
+}
+
+
+/** Start recording a new frame. */
+void
+framebuf_clear(void)
+{
+	if (frame != NULL)
+		memset(frame, 0, fb_width * fb_height * sizeof(FrameCell));
+}
+
+
+/* Record an operation on a single cell; positions are 1-based */
+static void
+framebuf_put(int x, int y, int op, int a, int b, int c, int offset)
+{
+	FrameCell *cell;
+
+	if ((frame == NULL) || (x < 1) || (x > fb_width) || (y < 1) || (y > fb_height))
+		return;
+
+	cell = &frame[(y - 1) * fb_width + (x - 1)];
+	cell->op = op;
+	cell->a = a;
+	cell->b = b;
+	cell->c = c;
+	cell->offset = offset;
+}
+
+
+/**
+ * Record a string written at position (x,y).
+ * \param x       Horizontal character position (column).
+ * \param y       Vertical character position (row).
+ * \param string  String that gets written.
+ */
+void
+framebuf_string(int x, int y, const char *string)
+{
+	int i;
+
+	for (i = 0; (string[i] != '\0') && (x + i <= fb_width); i++)
+		framebuf_put(x + i, y, FB_CHAR, (unsigned char) string[i], 0, 0, 0);
+}
+
+
+/**
+ * Record a character written at position (x,y).
+ * \param x  Horizontal character position (column).
+ * \param y  Vertical character position (row).
+ * \param c  Character that gets written.
+ */
+void
+framebuf_chr(int x, int y, char c)
+{
+	framebuf_put(x, y, FB_CHAR, (unsigned char) c, 0, 0, 0);
+}
+
+
+/**
+ * Record an operation that covers a block of cells and whose output the
+ * frame buffer cannot predict exactly. The block must cover every cell the
+ * drivers may write to for this operation.
+ * \param op      Kind of operation.
+ * \param x       Left column of the block.
+ * \param y       Top row of the block.
+ * \param width   Width of the block.
+ * \param height  Height of the block.
+ * \param a       First argument of the operation.
+ * \param b       Second argument of the operation.
+ * \param c       Third argument of the operation.
+ */
+void
+framebuf_block(FrameOp op, int x, int y, int width, int height, int a, int b, int c)
+{
+	int i, j;
+
+	for (j = 0; j < height; j++)
+		for (i = 0; i < width; i++)
+			framebuf_put(x + i, y + j, op, a, b, c, j * width + i);
+}
+
+
+/**
+ * Record a cell that a driver animates on its own.
+ * \param x  Horizontal character position (column).
+ * \param y  Vertical character position (row).
+ */
+void
+framebuf_animated(int x, int y)
+{
+	framebuf_put(x, y, FB_ANIMATED, frame_seq, 0, 0, 0);
+}
+
+
+/**
+ * Exchange the frame being rendered with the spare one, so a frame can be
+ * rendered ahead without disturbing the current one.
+ */
+void
+framebuf_swap(void)
+{
+	FrameCell *tmp = frame;
+
+	frame = spare;
+	spare = tmp;
+}
+
+
+/* Add the spans of a line that differ from what the display shows */
+static int
+framebuf_diff_line(LCDSpan *result, const FrameCell *f, const FrameCell *s, int y, int count)
+{
+	LCDSpan *span = NULL;
+	int x;
+
+	for (x = 0; x < fb_width; x++) {
+		if (memcmp(&f[x], &s[x], sizeof(FrameCell)) == 0)
+			continue;
+
+		if ((span != NULL) && (x - (span->x - 1 + span->len) <= FB_SPAN_GAP)) {
+			span->len = x - (span->x - 1) + 1;
+		}
+		else {
+			span = &result[count++];
+			span->x = x + 1;
+			span->y = y + 1;
+			span->len = 1;
+		}
+	}
+	return count;
+}
+
+
+/**
+ * Compute the spans of cells that changed since the frame last committed.
+ * Changes on one line that are close to each other are merged into one
+ * span.
+ * \param result  Receives a pointer to the spans, valid until the next call.
+ * \return  Number of spans, or -1 if there is no frame buffer.
+ */
+int
+framebuf_diff(const LCDSpan **result)
+{
+	int count = 0;
+	int y;
+
+	if (frame == NULL)
+		return -1;
+
+	for (y = 0; y < fb_height; y++)
+		count = framebuf_diff_line(spans, frame + y * fb_width, shown + y * fb_width, y, count);
+
+	*result = spans;
+	return count;
+}
+
+
+/* Tell whether line f is line s moved by shift columns; only text moves */
+static int
+framebuf_line_moved(const FrameCell *f, const FrameCell *s, int shift)
+{
+	int x;
+
+	for (x = 0; x < fb_width; x++) {
+		if ((f[x].op != FB_CHAR) || (s[x].op != FB_CHAR))
+			return 0;
+	}
+	if (shift < 0)
+		return (memcmp(f, s + 1, (fb_width - 1) * sizeof(FrameCell)) == 0);
+	return (memcmp(f + 1, s, (fb_width - 1) * sizeof(FrameCell)) == 0);
+}
+
+
+/**
+ * Find the lines of the frame that are the lines on the display moved by
+ * one column, as a scroller filling a line moves.
+ * \param result  Receives a pointer to the lines, valid until the next call.
+ * \return  Number of lines, or -1 if there is no frame buffer.
+ */
+int
+framebuf_scrolls(const FrameScroll **result)
+{
+	int count = 0;
+	int y;
+
+	if (frame == NULL)
+		return -1;
+
+	for (y = 0; (y < fb_height) && (fb_width >= FB_SCROLL_MIN); y++) {
+		FrameCell *f = frame + y * fb_width;
+		FrameCell *s = shown + y * fb_width;
+		int shift;
+
+		if (memcmp(f, s, fb_width * sizeof(FrameCell)) == 0)
+			continue;
+		if (framebuf_line_moved(f, s, -1))
+			shift = -1;
+		else if (framebuf_line_moved(f, s, 1))
+			shift = 1;
+		else
+			continue;
+
+		scrolls[count].rect.x = 1;
+		scrolls[count].rect.y = y + 1;
+		scrolls[count].rect.width = fb_width;
+		scrolls[count].rect.height = 1;
+		scrolls[count].shift = shift;
+		count++;
+	}
+
+	*result = scrolls;
+	return count;
+}
+
+
+/**
+ * Compute the spans of cells that changed like framebuf_diff(), for a
+ * display that moved the lines found by framebuf_scrolls() already. What
+ * a line moved in counts as changed.
+ * \param result  Receives a pointer to the spans, valid until the next call.
+ * \return  Number of spans, or -1 if there is no frame buffer.
+ */
+int
+framebuf_diff_scrolled(const LCDSpan **result)
+{
+	const FrameScroll *scroll;
+	int n = framebuf_scrolls(&scroll);
+	int count = 0;
+	int y;
+
+	if (n < 0)
+		return -1;
+
+	for (y = 0; y < fb_height; y++) {
+		FrameCell *s = shown + y * fb_width;
+
+		if ((n > 0) && (scroll->rect.y == y + 1)) {
+			if (scroll->shift < 0) {
+				memcpy(moved, s + 1, (fb_width - 1) * sizeof(FrameCell));
+				moved[fb_width - 1].op = FB_UNKNOWN;
+			}
+			else {
+				memcpy(moved + 1, s, (fb_width - 1) * sizeof(FrameCell));
+				moved[0].op = FB_UNKNOWN;
+			}
+			s = moved;
+			scroll++;
+			n--;
+		}
+		count = framebuf_diff_line(scrolled, frame + y * fb_width, s, y, count);
+	}
+
+	*result = scrolled;
+	return count;
+}
+
+
+/**
+ * Tell whether a display has the size of the frame buffer, i.e. whether
+ * the spans computed by framebuf_diff() apply to it.
+ * \param width   Display width in characters.
+ * \param height  Display height in characters.
+ * \return  1 if the size matches, 0 otherwise.
+ */
+int
+framebuf_matches(int width, int height)
+{
+	return ((frame != NULL) && (width == fb_width) && (height == fb_height));
+}
+
+
+/** Make the frame just rendered the one the display shows. */
+void
+framebuf_commit(void)
+{
+	if (frame == NULL)
+		return;
+
+	/* like the drivers' frame buffers, the frame keeps its contents
+	 * until it is cleared */
+	memcpy(shown, frame, fb_width * fb_height * sizeof(FrameCell));
+	frame_seq++;
+}
+
+
+/**
+ * Tell how many frames have been committed, so that a change of the frame
+ * on the display can be noticed without comparing it.
+ * \return  Number of frames committed; it wraps around.
+ */
+int
+framebuf_serial(void)
+{
+	return frame_seq;
+}
+
+
+/* Character approximating the contents of a cell of the frame shown */
+static char
+framebuf_cell_char(const FrameCell *cell, int pbar_width)
+{
+	switch (cell->op) {
+	case FB_CHAR:
+		/* no line breaks or terminal controls */
+		return ((cell->a < ' ') || (cell->a == 0x7F)) ? '?' : (char) cell->a;
+	case FB_HBAR:		/* a: promille, c: length */
+		return (cell->offset < (cell->a * cell->c + 500) / 1000) ? '=' : ' ';
+	case FB_PBAR:		/* a: promille of pbar_width cells */
+		return (cell->offset < (cell->a * pbar_width + 500) / 1000) ? '=' : ' ';
+	case FB_VBAR:		/* a: promille, c: length, offset from the top */
+		return (cell->c - 1 - cell->offset < (cell->a * cell->c + 500) / 1000) ? '|' : ' ';
+	case FB_NUM:		/* a: digit, 10 is a colon */
+		return (cell->a == 10) ? ':' : '0' + cell->a;
+	case FB_ICON:
+		return '*';
+	default:		/* nothing, unknown or animated by a driver */
+		return ' ';
+	}
+}
+
+
+/**
+ * Get the characters of the frame the display shows. Bars, big numbers and
+ * icons become plain characters approximating them; what the drivers
+ * animate on their own is left out.
+ * \param text    Where to put the characters, width * height of them, row
+ *                after row; not terminated.
+ * \param width   Width of the display.
+ * \param height  Height of the display.
+ * \return  -1 if the frame buffer has another size or is missing, 0 on success.
+ */
+int
+framebuf_text(char *text, int width, int height)
+{
+	int x, y;
+
+	if ((shown == NULL) || (width != fb_width) || (height != fb_height))
+		return -1;
+
+	for (y = 0; y < height; y++) {
+		/* a progress bar needs its width, which only its first cell knows */
+		int pbar_width = 0;
+
+		for (x = 0; x < width; x++) {
+			const FrameCell *cell = &shown[y * width + x];
+
+			if ((cell->op == FB_PBAR) && (cell->offset == 0)) {
+				for (pbar_width = 1; (x + pbar_width < width)
+				     && (cell[pbar_width].op == FB_PBAR)
+				     && (cell[pbar_width].offset == pbar_width); pbar_width++)
+					;
+			}
+			text[y * width + x] = framebuf_cell_char(cell, pbar_width);
+		}
+	}
+	return 0;
+}
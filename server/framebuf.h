@@ -0,0 +1,75 @@
+/** \file server/framebuf.h
+ * Interface to the server's virtual frame buffer.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef FRAMEBUF_H
+#define FRAMEBUF_H
+
+#include "drivers/lcd.h"
+
+/** Kinds of output recorded in the frame buffer cells */
+typedef enum {
+	FB_EMPTY = 0,		/**< Nothing written since the last clear */
+	FB_CHAR,		/**< A plain character */
+	FB_VBAR,		/**< Part of a vertical bar */
+	FB_HBAR,		/**< Part of a horizontal bar */
+	FB_PBAR,		/**< Part of a progress bar */
+	FB_NUM,			/**< Part of a big number */
+	FB_ICON,		/**< Part of an icon */
+	FB_ANIMATED,		/**< Changes on every frame (heartbeat, cursor) */
+	FB_UNKNOWN		/**< Contents unknown, e.g. after initialization */
+} FrameOp;
+
+/** A line of the frame that is the line on the display moved sideways */
+typedef struct FrameScroll {
+	LCDRect rect;		/**< The characters that moved */
+	int shift;		/**< Columns they moved; < 0: to the left */
+} FrameScroll;
+
+/* Create the frame buffer for a display of the given size. */
+int framebuf_init(int width, int height);
+
+/* Release the frame buffer. */
+void framebuf_shutdown(void);
+
+/* Forget what the display shows, so the next frame counts as changed. */
+void framebuf_invalidate(void);
+
+/* Record operations of the frame being rendered. */
+void framebuf_clear(void);
+void framebuf_string(int x, int y, const char *string);
+void framebuf_chr(int x, int y, char c);
+void framebuf_block(FrameOp op, int x, int y, int width, int height, int a, int b, int c);
+void framebuf_animated(int x, int y);
+
+/* Exchange the frame being rendered with a spare one. */
+void framebuf_swap(void);
+
+/* Compute the spans that changed since the last frame. Returns their number
+ * (0 if nothing changed), or -1 if there is no frame buffer. */
+int framebuf_diff(const LCDSpan **spans);
+
+/* Find the lines that only moved by a column since the last frame, and the
+ * spans that are left to send if the displays move them in hardware. */
+int framebuf_scrolls(const FrameScroll **scrolls);
+int framebuf_diff_scrolled(const LCDSpan **spans);
+
+/* Tell whether a driver's display matches the frame buffer geometry. */
+int framebuf_matches(int width, int height);
+
+/* Make the rendered frame the one the display shows. */
+void framebuf_commit(void);
+
+/* Number of frames committed so far; it wraps around. */
+int framebuf_serial(void);
+
+/* Get the characters the display shows, as far as the frame buffer knows. */
+int framebuf_text(char *text, int width, int height);
+
+#endif
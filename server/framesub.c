@@ -0,0 +1,271 @@
+/** \file server/framesub.c
+ * This file contains the clients that mirror the display, like remote
+ * viewers or tests checking what a screen looks like. A client subscribes
+ * with "subscribe frames" and from then on is sent the characters that
+ * changed on the main display, as plain text lines:
+ *
+ *\verbatim
+ * frame <x> <y> <characters>
+ * ...
+ * frame end
+ *\endverbatim
+ *
+ * The characters are taken from the server's frame buffer (see framebuf.c),
+ * so mirroring costs no driver and no rendering pass of its own. Each
+ * subscriber is compared with the last frame sent to it, so a subscriber
+ * that asked for fewer frames than are shown still gets all that changed
+ * in between, combined.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "shared/report.h"
+#include "shared/sockets.h"
+#include "shared/vector.h"
+
+#include "framesub.h"
+#include "framebuf.h"
+#include "drivers.h"
+#include "stats.h"
+
+/** Unchanged characters between two changes that are sent anyway, rather
+ * than starting another line */
+#define FRAMESUB_GAP	3
+
+/** A client mirroring the display */
+typedef struct FrameSubscriber {
+	Client *client;			/**< The client */
+	long interval;			/**< Shortest time between two frames, in microseconds */
+	unsigned long sent_time;	/**< When the last frame was sent */
+	int sent_serial;		/**< framebuf_serial() of the last frame sent */
+	char *sent;			/**< Characters of the last frame sent, or NULL */
+	int width;			/**< Size of the frame in sent */
+	int height;
+} FrameSubscriber;
+
+static Vector *subscribers = NULL;
+static char *text = NULL;		/**< Characters of the frame shown */
+static char *message = NULL;		/**< Lines sent to a subscriber */
+static int buffer_cells = 0;		/**< Size of the frame text and message are allocated for */
+
+
+/* Find the subscription of a client */
+static FrameSubscriber *
+framesub_find(Client *c)
+{
+	FrameSubscriber *sub;
+	int i;
+
+	for (i = 0; (sub = V_Get(subscribers, i)) != NULL; i++) {
+		if (sub->client == c)
+			return sub;
+	}
+	return NULL;
+}
+
+
+/**
+ * Send a client the changes of the frame on the main display from now on,
+ * starting with all of the frame. A client that subscribed already only
+ * gets its interval changed.
+ * \param c         The client.
+ * \param interval  Shortest time between two frames sent, in milliseconds;
+ *                  0 sends every frame.
+ * \return  -1 on error, 0 on success.
+ */
+int
+framesub_subscribe(Client *c, int interval)
+{
+	FrameSubscriber *sub = framesub_find(c);
+
+	if (sub == NULL) {
+		if ((subscribers == NULL) && ((subscribers = V_new()) == NULL))
+			return -1;
+		sub = calloc(1, sizeof(FrameSubscriber));
+		if (sub == NULL) {
+			report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+			return -1;
+		}
+		sub->client = c;
+		sub->sent_serial = framebuf_serial() - 1;
+		if (V_Append(subscribers, sub) < 0) {
+			free(sub);
+			return -1;
+		}
+	}
+	sub->interval = interval * 1000L;
+	return 0;
+}
+
+
+/**
+ * Stop sending frames to a client. Nothing happens if it did not subscribe.
+ * \param c  The client.
+ */
+void
+framesub_unsubscribe(Client *c)
+{
+	FrameSubscriber *sub = framesub_find(c);
+
+	if (sub != NULL) {
+		V_Remove(subscribers, sub);
+		free(sub->sent);
+		free(sub);
+	}
+}
+
+
+/* Send a subscriber what changed since the last frame it got */
+static void
+framesub_send(FrameSubscriber *sub, int width, int height)
+{
+	int all = 0;
+	int len = 0;
+	int x, y;
+
+	if ((sub->sent == NULL) || (sub->width != width) || (sub->height != height)) {
+		free(sub->sent);
+		sub->sent = malloc(width * height);
+		if (sub->sent == NULL)
+			return;
+		sub->width = width;
+		sub->height = height;
+		all = 1;
+	}
+
+	for (y = 0; y < height; y++) {
+		const char *now = text + y * width;
+		const char *before = sub->sent + y * width;
+
+		x = 0;
+		while (x < width) {
+			int start, end, gap;
+
+			if (!all && (now[x] == before[x])) {
+				x++;
+				continue;
+			}
+			/* a span of changes, with short gaps in it */
+			start = x;
+			end = x + 1;
+			for (gap = 0, x++; (x < width) && (gap <= FRAMESUB_GAP); x++) {
+				if (all || (now[x] != before[x])) {
+					end = x + 1;
+					gap = 0;
+				}
+				else
+					gap++;
+			}
+			len += sprintf(message + len, "frame %d %d ", start + 1, y + 1);
+			memcpy(message + len, now + start, end - start);
+			len += end - start;
+			message[len++] = '\n';
+			x = end;
+		}
+	}
+	memcpy(sub->sent, text, width * height);
+
+	if (len > 0) {
+		len += sprintf(message + len, "frame end\n");
+		sock_send(sub->client->sock, message, len);
+	}
+}
+
+
+/**
+ * Send the frame on the main display to the subscribers that did not get
+ * it yet and whose interval has passed. To be called after rendering.
+ * \return  Time in microseconds until a subscriber is due for a frame it
+ *          did not get yet, or -1 if none is waiting.
+ */
+long
+framesub_publish(void)
+{
+	DisplayProps *props;
+	FrameSubscriber *sub;
+	unsigned long now;
+	int serial;
+	int have_text = 0;
+	long wait = -1;
+	int i;
+
+	if (V_Length(subscribers) == 0)
+		return -1;
+
+	props = drivers_display_props(0);
+	if (props == NULL)
+		return -1;
+	serial = framebuf_serial();
+	now = stats_clock();
+
+	for (i = 0; (sub = V_Get(subscribers, i)) != NULL; i++) {
+		long elapsed = (long) (now - sub->sent_time);
+
+		if (sub->sent_serial == serial)
+			continue;
+		if ((sub->sent != NULL) && (elapsed < sub->interval)) {
+			if ((wait < 0) || (sub->interval - elapsed < wait))
+				wait = sub->interval - elapsed;
+			continue;
+		}
+
+		if (!have_text) {
+			int cells = props->width * props->height;
+
+			if (cells > buffer_cells) {
+				free(text);
+				free(message);
+				text = malloc(cells);
+				/* each line of the message: "frame x y " and \n */
+				message = malloc(cells + props->height * (props->width / 2 + 1) * 24 + 16);
+				if ((text == NULL) || (message == NULL)) {
+					report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+					free(text);
+					free(message);
+					text = message = NULL;
+					buffer_cells = 0;
+					return -1;
+				}
+				buffer_cells = cells;
+			}
+			if (framebuf_text(text, props->width, props->height) < 0)
+				return -1;
+			have_text = 1;
+		}
+		framesub_send(sub, props->width, props->height);
+		sub->sent_serial = serial;
+		sub->sent_time = now;
+	}
+	return wait;
+}
+
+
+/** Forget all subscribers, e.g. on shutdown. */
+void
+framesub_shutdown(void)
+{
+	FrameSubscriber *sub;
+
+	while ((sub = V_Pop(subscribers)) != NULL) {
+		free(sub->sent);
+		free(sub);
+	}
+	V_Destroy(subscribers);
+	subscribers = NULL;
+	free(text);
+	free(message);
+	text = message = NULL;
+	buffer_cells = 0;
+}
@@ -0,0 +1,32 @@
+/** \file server/framesub.h
+ * Interface to the clients mirroring the display.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef FRAMESUB_H
+#define FRAMESUB_H
+
+#include "client.h"
+
+/** Interval between two frames sent to a subscriber, unless it asks for
+ * another one, in milliseconds */
+#define FRAMESUB_DEFAULT_INTERVAL	200
+
+/* Send a client the frames shown from now on, at most one per interval. */
+int framesub_subscribe(Client *c, int interval);
+
+/* Stop sending frames to a client. */
+void framesub_unsubscribe(Client *c);
+
+/* Send the frame shown to the subscribers that are due for it. */
+long framesub_publish(void);
+
+/* Forget all subscribers. */
+void framesub_shutdown(void);
+
+#endif
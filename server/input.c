@@ -18,9 +18,9 @@
 #include "shared/sockets.h"
 #include "shared/report.h"
 #include "shared/configfile.h"
-#include "shared/LL.h"
 
 #include "drivers.h"
+#include "driver.h"
 
 #define INC_TYPES_ONLY 1
 #include "client.h"
@@ -30,32 +30,134 @@
 #include "menuscreens.h"
 #include "input.h"
 #include "render.h" /* For server_msg* */
+#include "stats.h"
+#include "flightrec.h"
 
 
-LinkedList *keylist;
-char *toggle_rotate_key;
-char *prev_screen_key;
-char *next_screen_key;
-char *scroll_up_key;
-char *scroll_down_key;
+/** Most key names known at once, which bounds what clients can add */
+#define MAX_KEY_NAMES	1024
+/** Slots of the key name hash table; a power of 2 above MAX_KEY_NAMES */
+#define KEY_HASH_SIZE	2048
+
+/*
+ * Key names are interned: each name gets a small id when it is first
+ * reserved, requested by a screen or configured, so a key from a driver
+ * is found with one hash lookup and dispatched by comparing ids.
+ */
+static char *key_names[MAX_KEY_NAMES];		/**< Name of each key id */
+static int key_name_count = 0;
+static short key_hash[KEY_HASH_SIZE];		/**< Key id + 1; 0 if free */
+/** Reservations of each key id, oldest first */
+static KeyReservation *key_reservations[MAX_KEY_NAMES];
+
+/** Time between two presses of a key that still makes them a repeat, in us */
+#define KEY_REPEAT_GAP	250000
+/** Most steps one repeat of a key makes with KeyAcceleration */
+#define KEY_MAX_STEP	16
+
+static int key_acceleration;		/**< Repeats per extra step; 0 = off */
+static int last_key = -1;		/**< Id of the last key handled */
+static unsigned long last_key_time;	/**< When it came, see stats_clock() */
+static int key_run;			/**< Repeats of it so far */
+
+static int toggle_rotate_key;
+static int prev_screen_key;
+static int next_screen_key;
+static int scroll_up_key;
+static int scroll_down_key;
 
 /* Local functions */
 int server_input(int key);
-void input_internal_key(const char *key);
+void input_internal_key(const char *key, int id);
+
+
+/* Find the hash table slot of a key name: its id, or the free slot */
+static int
+input_key_slot(const char *name)
+{
+	const unsigned char *c;
+	unsigned int hash = 2166136261u;
+	int slot;
+
+	for (c = (const unsigned char *) name; *c != '\0'; c++)
+		hash = (hash ^ *c) * 16777619u;
+
+	slot = hash & (KEY_HASH_SIZE - 1);
+	while ((key_hash[slot] != 0)
+	       && (strcmp(key_names[key_hash[slot] - 1], name) != 0))
+		slot = (slot + 1) & (KEY_HASH_SIZE - 1);
+	return slot;
+}
+
+
+/**
+ * Get the id of a key name, giving it one if it has none yet.
+ * \param name  Name of the key.
+ * \return  Id of the key, -1 if too many keys are known.
+ */
+int
+input_key_id(const char *name)
+{
+	int slot = input_key_slot(name);
+	char *copy;
+
+	if (key_hash[slot] != 0)
+		return key_hash[slot] - 1;
+
+	if ((key_name_count >= MAX_KEY_NAMES) || ((copy = strdup(name)) == NULL)) {
+		report(RPT_WARNING, "%s: too many key names; ignoring \"%.40s\"",
+		       __FUNCTION__, name);
+		return -1;
+	}
+	key_names[key_name_count] = copy;
+	key_hash[slot] = ++key_name_count;
+	return key_name_count - 1;
+}
+
+
+/**
+ * Get the id of a key name without giving it one: a key without an id
+ * is neither reserved nor requested by any screen.
+ * \param name  Name of the key.
+ * \return  Id of the key, -1 if it has none.
+ */
+int
+input_key_lookup(const char *name)
+{
+	return key_hash[input_key_slot(name)] - 1;
+}
+
+
+/**
+ * Get the name of a key id.
+ * \param key  Id of the key.
+ * \return  Name of the key, NULL if there is no such id.
+ */
+const char *
+input_key_name(int key)
+{
+	if ((key < 0) || (key >= key_name_count))
+		return NULL;
+	return key_names[key];
+}
 
 
 int input_init(void)
 {
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	keylist = LL_new();
-
 	/* Get rotate/scroll keys from config file */
-	toggle_rotate_key = strdup(config_get_string("server", "ToggleRotateKey", 0, "Enter"));
-	prev_screen_key = strdup(config_get_string("server", "PrevScreenKey", 0, "Left"));
-	next_screen_key = strdup(config_get_string("server", "NextScreenKey", 0, "Right"));
-	scroll_up_key = strdup(config_get_string("server", "ScrollUpKey", 0, "Up"));
-	scroll_down_key = strdup(config_get_string("server", "ScrollDownKey", 0, "Down"));
+	toggle_rotate_key = input_key_id(config_get_string("server", "ToggleRotateKey", 0, "Enter"));
+	prev_screen_key = input_key_id(config_get_string("server", "PrevScreenKey", 0, "Left"));
+	next_screen_key = input_key_id(config_get_string("server", "NextScreenKey", 0, "Right"));
+	scroll_up_key = input_key_id(config_get_string("server", "ScrollUpKey", 0, "Up"));
+	scroll_down_key = input_key_id(config_get_string("server", "ScrollDownKey", 0, "Down"));
+
+	key_acceleration = config_get_int("server", "KeyAcceleration", 0, 0);
+	if (key_acceleration < 0) {
+		report(RPT_WARNING, "KeyAcceleration must be 0 or more; using 0");
+		key_acceleration = 0;
+	}
 
 	return 0;
 }
@@ -63,25 +165,85 @@ int input_init(void)
 
 void input_shutdown()
 {
-	if (!keylist) {
-		/* Program shutdown before completed startup */
-		return;
+	KeyReservation *kr;
+	int i;
+
+	for (i = 0; i < key_name_count; i++) {
+		while ((kr = key_reservations[i]) != NULL) {
+			key_reservations[i] = kr->next;
+			free(kr);
+		}
+		free(key_names[i]);
+		key_names[i] = NULL;
+	}
+	key_name_count = 0;
+	memset(key_hash, 0, sizeof(key_hash));
+}
+
+
+/*
+ * Count the steps a run of repeats of a key makes. With KeyAcceleration
+ * set, a key that keeps repeating makes one step more per repeat every
+ * KeyAcceleration repeats, up to KEY_MAX_STEP.
+ */
+static int
+input_accelerate(int id, int repeats)
+{
+	unsigned long now = stats_clock();
+	int steps = 0;
+	int i;
+
+	if ((id < 0) || (id != last_key) || (now - last_key_time > KEY_REPEAT_GAP))
+		key_run = 0;
+	last_key = id;
+	last_key_time = now;
+
+	if (key_acceleration <= 0) {
+		key_run += repeats;
+		return repeats;
 	}
+	for (i = 0; i < repeats; i++, key_run++)
+		steps += min(1 + key_run / key_acceleration, KEY_MAX_STEP);
+	return steps;
+}
 
-	free(keylist);
 
-	free(toggle_rotate_key);
-	free(prev_screen_key);
-	free(next_screen_key);
-	free(scroll_up_key);
-	free(scroll_down_key);
+/* Tell a client about n presses of a key; screen is NULL for reserved keys.
+ * Clients that asked for it get the time of the press, when, at the end. */
+static void
+input_send_key(Client *c, const char *key, const char *screen, int n, unsigned long when)
+{
+	char stamp[32] = "";
+
+	stats_client_event(c);
+	if (c->key_time)
+		snprintf(stamp, sizeof(stamp), " @%lu.%06lu", when / 1000000, when % 1000000);
+	if (c->key_count) {
+		if (screen != NULL)
+			sock_printf(c->sock, "key %s %s %d%s\n", key, screen, n, stamp);
+		else
+			sock_printf(c->sock, "key %s %d%s\n", key, n, stamp);
+		return;
+	}
+	while (n-- > 0) {
+		if (screen != NULL)
+			sock_printf(c->sock, "key %s %s%s\n", key, screen, stamp);
+		else
+			sock_printf(c->sock, "key %s%s\n", key, stamp);
+	}
 }
 
 
-void handle_input(void)
+int handle_input(void)
 {
 	const char *key;
+	char *held;
+	int id, repeats, steps;
+	unsigned long when, next_when;
+	Driver *from, *next_from;
+	int count = 0;
 	Screen *current_screen;
+	Screen *shown;
 	Client *current_client;
 	KeyReservation *kr;
 
@@ -93,39 +255,63 @@ void handle_input(void)
 	else
 		current_client = NULL;
 
-	/* Handle all keypresses */
-	while ((key = drivers_get_key()) != NULL) {
-
-		/* keys from key_add have highest priority */
-		if (current_screen && screen_find_key(current_screen, key)) {
-			sock_printf(current_client->sock, "key %s %s\n",
-				    key, current_screen->id);
+	/* Handle all keypresses, a run of repeats of one key at a time */
+	key = drivers_get_key_event(&next_when, &next_from);
+	while (key != NULL) {
+		/* the driver may reuse the string for its next key */
+		if ((held = strdup(key)) == NULL)
+			break;
+		stats_key_pressed();
+		/* the run counts as pressed with its first key */
+		when = next_when;
+		from = next_from;
+		repeats = 1;
+		while (((key = drivers_get_key_event(&next_when, &next_from)) != NULL)
+		       && (strcmp(key, held) == 0))
+			repeats++;
+		count += repeats;
+
+		id = input_key_lookup(held);
+		steps = input_accelerate(id, repeats);
+		stats_driver_key(from, stats_clock() - when);
+		flightrec_event(FLIGHT_KEY, (from != NULL) ? driver_flight_id(from) : -1,
+				stats_clock() - when);
+
+		/* keys from key_add have highest priority; they are for the
+		 * screen shown on the display the key came from */
+		shown = (from != NULL) ? screenlist_current_on(drivers_display_of(from)) : current_screen;
+		if (shown && (screen_find_key(shown, id) >= 0)) {
+			input_send_key(shown->client, held, shown->id, steps, when);
+			free(held);
 			continue;
 		}
 
 		/* Find what client wants the key */
-		kr = input_find_key(key, current_client);
+		kr = input_find_key(id, current_client);
 		if (kr && kr->client) {
 			/* A hit ! */
-			debug(RPT_DEBUG, "%s: reserved key: \"%.40s\"", __FUNCTION__, key);
-			sock_printf(kr->client->sock, "key %s\n", key);
+			debug(RPT_DEBUG, "%s: reserved key: \"%.40s\" x%d", __FUNCTION__, held, steps);
+			input_send_key(kr->client, held, NULL, steps, when);
 		} else {
-			debug(RPT_DEBUG, "%s: left over key: \"%.40s\"", __FUNCTION__, key);
-			input_internal_key(key);
+			debug(RPT_DEBUG, "%s: left over key: \"%.40s\" x%d", __FUNCTION__, held, steps);
+			while (steps-- > 0)
+				input_internal_key(held, id);
 		}
+		free(held);
 	}
+	return count;
 }
 
 
 void
-input_internal_key(const char *key)
+input_internal_key(const char *key, int id)
 {
 	if (is_menu_key(key) || screenlist_current() == menuscreen) {
 		menuscreen_key_handler(key);
 	}
-	else {
+	else if (id >= 0) {
 		/* Keys are for scrolling or rotating */
-		if (strcmp(key, toggle_rotate_key) == 0) {
+		if (id == toggle_rotate_key) {
 			autorotate = !autorotate;
 			if (autorotate) {
 				server_msg("Rotate", 4);
@@ -133,46 +319,52 @@ input_internal_key(const char *key)
 				server_msg("Hold", 4);
 			}
 		}
-		else if (strcmp(key, prev_screen_key) == 0) {
+		else if (id == prev_screen_key) {
 			screenlist_goto_prev();
 			server_msg("Prev", 4);
 		}
-		else if (strcmp(key, next_screen_key) == 0) {
+		else if (id == next_screen_key) {
 			screenlist_goto_next();
 			server_msg("Next", 4);
 		}
-		else if (strcmp(key, scroll_up_key) == 0) {
+		else if (id == scroll_up_key) {
 		}
-		else if (strcmp(key, scroll_down_key) == 0) {
+		else if (id == scroll_down_key) {
 		}
 	}
 }
 
 int input_reserve_key(const char *key, bool exclusive, Client *client)
 {
-	KeyReservation *kr;
+	KeyReservation *kr, **tail;
+	int id;
 
 	debug(RPT_DEBUG, "%s(key=\"%.40s\", exclusive=%d, client=[%d])",
 		__FUNCTION__, key, exclusive, (client?client->sock:-1));
 
+	id = input_key_id(key);
+	if (id < 0)
+		return -1;
+
 	/* Find out if this key is already reserved in a way that interferes
 	 * with the new reservation.
 	 */
-	for (kr = LL_GetFirst(keylist); kr != NULL; kr = LL_GetNext(keylist)) {
-		if (strcmp(kr->key, key) == 0) {
-			if (kr->exclusive || exclusive) {
-				/* Sorry ! */
-				return -1;
-			}
+	for (tail = &key_reservations[id]; *tail != NULL; tail = &(*tail)->next) {
+		if ((*tail)->exclusive || exclusive) {
+			/* Sorry ! */
+			return -1;
 		}
 	}
 
 	/* We can now safely add it ! */
 	kr = malloc(sizeof(KeyReservation));
-	kr->key = strdup(key);
+	if (kr == NULL)
+		return -1;
+	kr->key = id;
 	kr->exclusive = exclusive;
 	kr->client = client;
-	LL_Push(keylist, kr);
+	kr->next = NULL;
+	*tail = kr;
 
 	report(RPT_INFO, "Key \"%.40s\" is now reserved %s by client [%d]",
 		key, (exclusive ? "exclusively" : "shared"), (client ? client->sock : -1));
@@ -182,17 +374,21 @@ int input_reserve_key(const char *key, bool exclusive, Client *client)
 
 void input_release_key(const char *key, Client *client)
 {
-	KeyReservation *kr;
+	KeyReservation *kr, **link;
+	int id;
 
 	debug(RPT_DEBUG, "%s(key=\"%.40s\", client=[%d])", __FUNCTION__, key, (client ? client->sock : -1));
 
-	for (kr = LL_GetFirst(keylist); kr != NULL; kr = LL_GetNext(keylist)) {
-		if ((kr->client == client) && (strcmp(kr->key, key) == 0)) {
+	id = input_key_lookup(key);
+	if (id < 0)
+		return;
+
+	for (link = &key_reservations[id]; (kr = *link) != NULL; link = &kr->next) {
+		if (kr->client == client) {
 			report(RPT_INFO, "Key \"%.40s\" reserved %s by client [%d] and is now released",
 				key, (kr->exclusive ? "exclusively" : "shared"), (client ? client->sock : -1));
-			free(kr->key);
+			*link = kr->next;
 			free(kr);
-			LL_DeleteNode(keylist, NEXT);
 			return;
 		}
 	}
@@ -200,33 +396,53 @@ void input_release_key(const char *key, Client *client)
 
 void input_release_client_keys(Client *client)
 {
-	KeyReservation *kr;
+	KeyReservation *kr, **link;
+	int id;
 
 	debug(RPT_DEBUG, "%s(client=[%d])", __FUNCTION__, (client ? client->sock : -1));
 
-	for (kr = LL_GetFirst(keylist); kr != NULL; kr = LL_GetNext(keylist)) {
-		if (kr->client == client) {
-			report(RPT_INFO, "Key \"%.40s\" reserved %s by client [%d] and is now released",
-				kr->key, (kr->exclusive ? "exclusively" : "shared"), (client ? client->sock : -1));
-			free(kr->key);
-			free(kr);
-			// jump to node before deleted one to not miss any
-			LL_DeleteNode(keylist, PREV);
+	for (id = 0; id < key_name_count; id++) {
+		link = &key_reservations[id];
+		while ((kr = *link) != NULL) {
+			if (kr->client == client) {
+				report(RPT_INFO, "Key \"%.40s\" reserved %s by client [%d] and is now released",
+					key_names[id], (kr->exclusive ? "exclusively" : "shared"), (client ? client->sock : -1));
+				*link = kr->next;
+				free(kr);
+			}
+			else
+				link = &kr->next;
+		}
+	}
+}
+
+int input_client_key_count(Client *client)
+{
+	KeyReservation *kr;
+	int count = 0;
+	int id;
+
+	for (id = 0; id < key_name_count; id++) {
+		for (kr = key_reservations[id]; kr != NULL; kr = kr->next) {
+			if (kr->client == client)
+				count++;
 		}
 	}
+	return count;
 }
 
-KeyReservation *input_find_key(const char *key, Client *client)
+KeyReservation *input_find_key(int key, Client *client)
 {
 	KeyReservation *kr;
 
-	debug(RPT_DEBUG, "%s(key=\"%.40s\", client=[%d])", __FUNCTION__, key, (client?client->sock:-1));
+	debug(RPT_DEBUG, "%s(key=%d, client=[%d])", __FUNCTION__, key, (client?client->sock:-1));
 
-	for (kr = LL_GetFirst(keylist); kr != NULL; kr = LL_GetNext(keylist)) {
-		if (strcmp(kr->key, key) == 0) {
-			if (kr->exclusive || client == kr->client) {
-				return kr;
-			}
+	if ((key < 0) || (key >= key_name_count))
+		return NULL;
+
+	for (kr = key_reservations[key]; kr != NULL; kr = kr->next) {
+		if (kr->exclusive || client == kr->client) {
+			return kr;
 		}
 	}
 	return NULL;
@@ -21,13 +21,15 @@
 #endif
 #include "shared/defines.h"
 
-/* Accepts and uses keypad input while displaying screens... */
-void handle_input(void);
+/* Accepts and uses keypad input while displaying screens...
+ * Returns the number of keys handled. */
+int handle_input(void);
 
 typedef struct KeyReservation {
-	char *key;
+	int key;		/* Id of the key, see input_key_id() */
 	bool exclusive;
 	Client *client;		/* NULL for internal clients */
+	struct KeyReservation *next;	/* Next reservation of the key */
 } KeyReservation;
 
 
@@ -37,6 +39,16 @@ int input_init(void);
 void input_shutdown(void);
 	/* Shut it down */
 
+int input_key_id(const char *name);
+	/* Returns the id of a key name, giving it one if needed */
+	/* Return -1 if too many keys are known */
+
+int input_key_lookup(const char *name);
+	/* Returns the id of a key name, -1 if it has none */
+
+const char *input_key_name(int key);
+	/* Returns the name of a key id */
+
 int input_reserve_key(const char *key, bool exclusive, Client *client);
 	/* Reserves a key for a client */
 	/* Return -1 if reservation of key is not possible */
@@ -47,7 +59,10 @@ void input_release_key(const char *key, Client *client);
 void input_release_client_keys(Client *client);
 	/* Releases all key reservations for a given client */
 
-KeyReservation *input_find_key(const char *key, Client *client);
+int input_client_key_count(Client *client);
+	/* Returns the number of keys reserved by a given client */
+
+KeyReservation *input_find_key(int key, Client *client);
 	/* Finds if a key reservation causes a 'hit'.
 	 * If the key was reserved exclusively, the client will be ignored.
 	 * If the key was reserved shared, the client must match.
@@ -0,0 +1,351 @@
+/** \file server/iothread.c
+ * This file contains the thread that serves the clients when the server
+ * runs on two threads (IOThread in the server section). The I/O thread
+ * accepts the connections, reads the sockets, parses the messages and runs
+ * the commands; the main thread renders the screens, flushes the drivers
+ * and handles the keys. A slow flush then no longer holds back the
+ * clients, and a flood of commands no longer holds back the frames.
+ *
+ * Ownership and locking rules:
+ * \li The server lock protects the clients, their screens and widgets, the
+ *     screenlist, the menus, the key reservations, the data sources, the
+ *     configuration and the sockets. Both threads hold it while they use
+ *     any of them.
+ * \li The I/O thread holds it except while it waits for the sockets in
+ *     sock_wait(). Meanwhile the main thread may still send to clients;
+ *     changes to the poller are left to sock_wait_end().
+ * \li The main thread holds it except while it waits for its next
+ *     deadline in iothread_wait(), and while the drivers flush, between
+ *     iothread_flush_begin() and iothread_flush_end(). A frame is composed
+ *     with the lock held, so no widget changes halfway through it; the
+ *     flush only uses the frame in the drivers, never a screen.
+ * \li The drivers belong to the main thread. A command calling a driver
+ *     (\c info) takes the drivers lock, which the main thread holds while
+ *     it flushes without the server lock.
+ * \li A thread giving up the server lock for a moment lets the other one
+ *     have it first if it waits for it, so that neither starves the other.
+ *
+ * The I/O thread wakes up the main thread through a pipe when it parsed
+ * input, so that the changes are rendered right away.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_LIBPTHREAD)
+# define USE_THREADS
+# include <pthread.h>
+# include <sched.h>
+# include <signal.h>
+#endif
+
+#include "shared/report.h"
+
+#include "iothread.h"
+#include "sock.h"
+#include "parse.h"
+#include "profile.h"
+#include "drivers.h"
+
+
+#ifdef USE_THREADS
+
+/** Threads taking the server lock */
+enum { SIDE_MAIN = 0, SIDE_IO = 1 };
+
+/** The server lock; recursive, as exit_program() may take it from a
+ * signal handler interrupting the main thread that holds it */
+static pthread_mutex_t server_lock;
+/** Held by the main thread while the drivers flush without the server lock */
+static pthread_mutex_t drivers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t thread;
+static int active = 0;
+/* Only read and written with __atomic builtins */
+static int stop = 0;			/**< Tells the I/O thread to end */
+static int in_wait = 0;			/**< The I/O thread uses the poller without the lock */
+static int wanted[2] = { 0, 0 };	/**< Threads waiting for the lock, by side */
+
+/** Wakes up the main thread in iothread_wait() */
+static int notify_pipe[2] = { -1, -1 };
+
+
+/* Take the server lock, after the other thread if it waits for it */
+static void
+iothread_acquire(int side)
+{
+	while ((__atomic_load_n(&wanted[1 - side], __ATOMIC_SEQ_CST) > 0)
+	       && !__atomic_load_n(&stop, __ATOMIC_SEQ_CST))
+		sched_yield();
+	__atomic_add_fetch(&wanted[side], 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_lock(&server_lock);
+	__atomic_sub_fetch(&wanted[side], 1, __ATOMIC_SEQ_CST);
+}
+
+
+/* Wake up the main thread; a full pipe already does */
+static void
+iothread_notify(void)
+{
+	char c = 0;
+
+	if (write(notify_pipe[1], &c, 1) < 0) {
+		/* EAGAIN: it has not read the last ones yet */
+	}
+}
+
+
+/* The I/O thread */
+static void *
+iothread_main(void *arg)
+{
+	int pending = 0;
+
+	iothread_acquire(SIDE_IO);
+	while (1) {
+		unsigned long long cpu = 0;
+		unsigned long long now;
+		int parsed;
+
+		if (profile_enabled)
+			cpu = profile_thread_time();
+		/* messages left over from the last pass are parsed too */
+		parsed = (sock_poll_clients() > 0) || (pending > 0);
+		if (profile_enabled) {
+			now = profile_thread_time();
+			profile_add(profile_subsystem(PROFILE_POLL), now - cpu);
+			cpu = now;
+		}
+		pending = parse_all_client_messages();
+		if (profile_enabled)
+			profile_add(profile_subsystem(PROFILE_PARSE), profile_thread_time() - cpu);
+
+		/* the main thread renders what the commands changed */
+		if (parsed)
+			iothread_notify();
+
+		/* Clients with messages left get another pass right away */
+		sock_wait_begin();
+		__atomic_store_n(&in_wait, 1, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&server_lock);
+		sock_wait((pending > 0) ? 0 : -1);
+		__atomic_store_n(&in_wait, 0, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&stop, __ATOMIC_SEQ_CST))
+			break;
+		iothread_acquire(SIDE_IO);
+		sock_wait_end();
+	}
+	return NULL;
+}
+
+
+/**
+ * Start the I/O thread. From then on the main thread holds the server
+ * lock, as described above, and must not call sock_poll_clients(),
+ * sock_wait() or parse_all_client_messages() any more.
+ * \return  -1 on error, 0 on success.
+ */
+int
+iothread_start(void)
+{
+	pthread_mutexattr_t attr;
+	sigset_t all, old;
+	int err;
+	int i;
+
+	if (active)
+		return 0;
+
+	if (pipe(notify_pipe) < 0) {
+		report(RPT_ERR, "%s: Cannot create pipe - %s", __FUNCTION__, strerror(errno));
+		return -1;
+	}
+	for (i = 0; i < 2; i++) {
+		fcntl(notify_pipe[i], F_SETFL, O_NONBLOCK);
+		fcntl(notify_pipe[i], F_SETFD, FD_CLOEXEC);
+	}
+	if (sock_wake_init() < 0) {
+		close(notify_pipe[0]);
+		close(notify_pipe[1]);
+		notify_pipe[0] = notify_pipe[1] = -1;
+		return -1;
+	}
+	/* the keys watched so far are polled from now on */
+	drivers_unwatch_keys();
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&server_lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	pthread_mutex_lock(&server_lock);
+
+	/* signals are handled by the main thread only */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	err = pthread_create(&thread, NULL, iothread_main, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err != 0) {
+		report(RPT_ERR, "%s: cannot create the I/O thread - %s",
+		       __FUNCTION__, strerror(err));
+		pthread_mutex_unlock(&server_lock);
+		pthread_mutex_destroy(&server_lock);
+		close(notify_pipe[0]);
+		close(notify_pipe[1]);
+		notify_pipe[0] = notify_pipe[1] = -1;
+		return -1;
+	}
+	active = 1;
+
+	report(RPT_INFO, "Clients are served on a thread of their own");
+	return 0;
+}
+
+
+/**
+ * Stop the I/O thread on the way out, e.g. from exit_program(). Returns
+ * with the server lock held and with the I/O thread either gone or
+ * waiting for the lock for good, so the sockets can be shut down. Does
+ * nothing if the thread does not run.
+ */
+void
+iothread_stop(void)
+{
+	if (!active)
+		return;
+
+	/* Once out of the poller it does not take the lock again */
+	__atomic_store_n(&stop, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_lock(&server_lock);
+	while (__atomic_load_n(&in_wait, __ATOMIC_SEQ_CST)) {
+		sock_wake();
+		sched_yield();
+	}
+	active = 0;
+}
+
+
+/**
+ * Tell whether the I/O thread runs.
+ * \return  1 if it does, 0 if the main thread serves the clients.
+ */
+int
+iothread_active(void)
+{
+	return active;
+}
+
+
+/**
+ * Wait on the main thread for the I/O thread to parse input, or for the
+ * timeout to expire. The server lock is given up meanwhile. A signal ends
+ * the wait early.
+ * \param timeout  Maximum time to wait in microseconds, <0 waits forever.
+ * \return  >0 if input was parsed since the last call, 0 if not.
+ */
+int
+iothread_wait(long timeout)
+{
+	struct pollfd pfd;
+	char buf[64];
+	int ready = 0;
+
+	pfd.fd = notify_pipe[0];
+	pfd.events = POLLIN;
+	pthread_mutex_unlock(&server_lock);
+	/* in milliseconds, rounded up like sock_wait() does */
+	if (poll(&pfd, 1, (timeout < 0) ? -1 : (int) ((timeout + 999) / 1000)) > 0) {
+		while (read(notify_pipe[0], buf, sizeof(buf)) > 0)
+			ready = 1;
+	}
+	iothread_acquire(SIDE_MAIN);
+	return ready;
+}
+
+
+/**
+ * Give up the server lock on the main thread while the drivers flush. The
+ * I/O thread may change any screen meanwhile: the frame flushed must have
+ * been rendered before.
+ */
+void
+iothread_flush_begin(void)
+{
+	if (active) {
+		pthread_mutex_lock(&drivers_lock);
+		pthread_mutex_unlock(&server_lock);
+	}
+}
+
+
+/**
+ * Take the server lock back after a flush.
+ */
+void
+iothread_flush_end(void)
+{
+	if (active) {
+		/* the I/O thread takes the server lock first, the drivers
+		 * lock after it: never hold the latter waiting for the former */
+		pthread_mutex_unlock(&drivers_lock);
+		iothread_acquire(SIDE_MAIN);
+	}
+}
+
+
+/**
+ * Get exclusive access to the drivers on the I/O thread; it may be
+ * flushing on the main thread. Does nothing without the I/O thread.
+ */
+void
+iothread_drivers_lock(void)
+{
+	if (active)
+		pthread_mutex_lock(&drivers_lock);
+}
+
+
+/**
+ * Give up access to the drivers.
+ */
+void
+iothread_drivers_unlock(void)
+{
+	if (active)
+		pthread_mutex_unlock(&drivers_lock);
+}
+
+
+#else
+/****************************************************************************/
+/* Without thread support the main thread serves the clients */
+
+int
+iothread_start(void)
+{
+	report(RPT_WARNING, "%s: LCDd was built without thread support", __FUNCTION__);
+	return -1;
+}
+
+void iothread_stop(void) { }
+int iothread_active(void) { return 0; }
+int iothread_wait(long timeout) { return 0; }
+void iothread_flush_begin(void) { }
+void iothread_flush_end(void) { }
+void iothread_drivers_lock(void) { }
+void iothread_drivers_unlock(void) { }
+
+#endif
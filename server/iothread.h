@@ -0,0 +1,39 @@
+/** \file server/iothread.h
+ * Interface to the thread that serves the clients apart from the
+ * rendering.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef IOTHREAD_H
+#define IOTHREAD_H
+
+/* Start the I/O thread: from then on it accepts, reads and parses, and
+ * the main thread holds the server lock. Returns -1 on error. */
+int iothread_start(void);
+
+/* Stop it for good, from the main thread; leaves the server lock held. */
+void iothread_stop(void);
+
+/* Tell whether the I/O thread runs. */
+int iothread_active(void);
+
+/* Wait on the main thread, without the server lock, until the I/O thread
+ * parsed input or the timeout (in microseconds, <0: none) expired.
+ * Returns >0 if input was parsed. */
+int iothread_wait(long timeout);
+
+/* Give up the server lock on the main thread while the drivers flush;
+ * they do nothing without the I/O thread. */
+void iothread_flush_begin(void);
+void iothread_flush_end(void);
+
+/* Get exclusive access to the drivers for calls from the I/O thread. */
+void iothread_drivers_lock(void);
+void iothread_drivers_unlock(void);
+
+#endif
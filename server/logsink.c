@@ -0,0 +1,349 @@
+/** \file server/logsink.c
+ * This file contains the thread that writes the reports. Writing to
+ * syslog or a terminal can block (a full syslog socket, a paused
+ * terminal), and report() is called from the main loop and the drivers'
+ * error paths. With the sink set, report() only formats the message and
+ * puts it in a queue; the thread takes it from there and writes it.
+ *
+ * The queue is a ring of fixed slots that any thread can add to without a
+ * lock: each slot has a sequence number that tells whether it is free for
+ * the writer position it is at, or filled. When the ring is full new
+ * messages are dropped and counted, instead of waiting.
+ *
+ * The thread also limits the rate of repeated messages: of the messages
+ * with the same format (the same report() call), only so many are
+ * written per second. The number left out is written when the second is
+ * over.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_LIBPTHREAD)
+# define USE_THREADS
+# include <pthread.h>
+# include <semaphore.h>
+#endif
+
+#include "shared/report.h"
+
+#include "logsink.h"
+
+
+#ifdef USE_THREADS
+
+#define LOG_SLOTS	128		/**< Messages queued at most (power of 2) */
+#define LOG_MSG_SIZE	512		/**< Longest message kept, with the 0 */
+#define LOG_FORMATS	16		/**< Formats whose rate is tracked */
+
+/** A queued message */
+typedef struct LogSlot {
+	unsigned int seq;		/**< Position it is free for, or filled at + 1 */
+	int level;
+	const char *format;		/**< Format of the report() call */
+	char message[LOG_MSG_SIZE];
+} LogSlot;
+
+/** Rate of the messages of one format */
+typedef struct LogRate {
+	const char *format;
+	int level;
+	time_t second;			/**< Second counted in */
+	int count;			/**< Messages in that second */
+	int suppressed;			/**< Messages left out in it */
+} LogRate;
+
+static LogSlot slots[LOG_SLOTS];
+static unsigned int write_pos;		/**< Next position to fill */
+static unsigned int read_pos;		/**< Next position to write out */
+static int dropped;			/**< Messages lost to a full ring */
+static int stopping;
+
+static sem_t wakeup;
+static pthread_t thread;
+static int running = 0;
+
+static FILE *file = NULL;
+static int rate_limit;
+static LogRate rates[LOG_FORMATS];
+
+/**
+ * Put a message into the ring; this is the report sink. It is called by
+ * any thread and never waits.
+ */
+static void
+logsink_put(int level, const char *format, const char *message)
+{
+	unsigned int pos = __atomic_load_n(&write_pos, __ATOMIC_RELAXED);
+	LogSlot *slot;
+
+	for (;;) {
+		int diff;
+
+		slot = &slots[pos & (LOG_SLOTS - 1)];
+		diff = (int) (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+		if (diff == 0) {
+			/* Free: take it, unless another thread was faster */
+			if (__atomic_compare_exchange_n(&write_pos, &pos, pos + 1, 0,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if (diff < 0) {
+			/* Still filled from the last round: the ring is full */
+			__atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+		else {
+			pos = __atomic_load_n(&write_pos, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->level = level;
+	slot->format = format;
+	strncpy(slot->message, message, LOG_MSG_SIZE - 1);
+	slot->message[LOG_MSG_SIZE - 1] = '\0';
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+	sem_post(&wakeup);
+}
+
+
+/** Write a message to the file, or the report destination. */
+static void
+logsink_write(int level, const char *message)
+{
+	if (file != NULL) {
+		char stamp[32];
+		time_t now = time(NULL);
+		struct tm tm;
+
+		strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime_r(&now, &tm));
+		fprintf(file, "%s %s\n", stamp, message);
+		fflush(file);
+	}
+	else {
+		report_write(level, message);
+	}
+}
+
+
+/** Write the number of messages of a format left out in its last second. */
+static void
+logsink_write_suppressed(LogRate *rate)
+{
+	char message[LOG_MSG_SIZE];
+
+	if (rate->suppressed == 0)
+		return;
+	snprintf(message, sizeof(message), "%d more messages like \"%.400s\" suppressed",
+		 rate->suppressed, rate->format);
+	logsink_write(rate->level, message);
+	rate->suppressed = 0;
+}
+
+
+/**
+ * Count a message in its format's rate.
+ * \retval 1  The message is to be written.
+ * \retval 0  It is left out.
+ */
+static int
+logsink_rate_check(int level, const char *format, time_t now)
+{
+	LogRate *rate = NULL;
+	int i;
+
+	for (i = 0; i < LOG_FORMATS; i++) {
+		if (rates[i].format == format) {
+			rate = &rates[i];
+			break;
+		}
+		/* Else take the one counted longest ago */
+		if (rate == NULL || rates[i].second < rate->second)
+			rate = &rates[i];
+	}
+
+	if (rate->format != format || rate->second != now) {
+		logsink_write_suppressed(rate);
+		rate->format = format;
+		rate->level = level;
+		rate->second = now;
+		rate->count = 0;
+	}
+	if (++rate->count <= rate_limit)
+		return 1;
+	rate->suppressed++;
+	return 0;
+}
+
+
+/** Write out the suppressed counts of the seconds that are over, or all. */
+static void
+logsink_rate_flush(time_t now, int all)
+{
+	int i;
+
+	for (i = 0; i < LOG_FORMATS; i++) {
+		if (rates[i].suppressed > 0 && (rates[i].second != now || all))
+			logsink_write_suppressed(&rates[i]);
+	}
+}
+
+
+/** Write out all messages in the ring; all suppressed counts if last. */
+static void
+logsink_drain(int last)
+{
+	time_t now = time(NULL);
+	int lost;
+
+	for (;;) {
+		LogSlot *slot = &slots[read_pos & (LOG_SLOTS - 1)];
+
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != read_pos + 1)
+			break;
+
+		if (rate_limit <= 0 || logsink_rate_check(slot->level, slot->format, now))
+			logsink_write(slot->level, slot->message);
+
+		/* Free the slot for the next round */
+		__atomic_store_n(&slot->seq, read_pos + LOG_SLOTS, __ATOMIC_RELEASE);
+		read_pos++;
+	}
+
+	lost = __atomic_exchange_n(&dropped, 0, __ATOMIC_RELAXED);
+	if (lost > 0) {
+		char message[64];
+
+		snprintf(message, sizeof(message), "%d messages dropped, report queue full", lost);
+		logsink_write(RPT_WARNING, message);
+	}
+	logsink_rate_flush(now, last);
+}
+
+
+/** The writer thread. */
+static void *
+logsink_thread(void *arg)
+{
+	for (;;) {
+		struct timespec deadline;
+		int stop;
+
+		/* Wake up once a second to write out the suppressed counts */
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec++;
+		while (sem_timedwait(&wakeup, &deadline) < 0 && errno == EINTR)
+			;
+
+		stop = __atomic_load_n(&stopping, __ATOMIC_ACQUIRE);
+		logsink_drain(stop);
+		if (stop)
+			break;
+	}
+	return NULL;
+}
+
+#endif /* USE_THREADS */
+
+
+/**
+ * Start writing the reports on a thread of their own. If that fails they
+ * are written right away, as before.
+ * \param path        File to append the messages to, or NULL to write them
+ *                    to the report destination.
+ * \param rate        Messages of one report() call written per second at
+ *                    most; 0 for all.
+ * \retval 0   The thread runs.
+ * \retval -1  It could not be started.
+ */
+int
+logsink_init(const char *path, int rate)
+{
+#ifdef USE_THREADS
+	unsigned int i;
+
+	if (running)
+		return 0;
+
+	if (path != NULL) {
+		file = fopen(path, "a");
+		if (file == NULL) {
+			report(RPT_ERR, "Could not open report file %s: %s", path, strerror(errno));
+			return -1;
+		}
+	}
+
+	for (i = 0; i < LOG_SLOTS; i++)
+		slots[i].seq = i;
+	write_pos = read_pos = 0;
+	dropped = stopping = 0;
+	rate_limit = rate;
+	memset(rates, 0, sizeof(rates));
+
+	if (sem_init(&wakeup, 0, 0) < 0) {
+		report(RPT_ERR, "Could not create the report semaphore: %s", strerror(errno));
+		goto fail;
+	}
+	if (pthread_create(&thread, NULL, logsink_thread, NULL) != 0) {
+		report(RPT_ERR, "Could not start the report thread");
+		sem_destroy(&wakeup);
+		goto fail;
+	}
+	running = 1;
+
+	set_report_sink(logsink_put);
+	report(RPT_INFO, "Writing reports on a thread of their own%s%s",
+	       (path != NULL) ? " to " : "", (path != NULL) ? path : "");
+	return 0;
+
+fail:
+	if (file != NULL) {
+		fclose(file);
+		file = NULL;
+	}
+	return -1;
+#else
+	report(RPT_WARNING, "Reports can't be written asynchronously without thread support");
+	return -1;
+#endif
+}
+
+
+/**
+ * Write the messages still queued and stop the thread. Reports are
+ * written right away again afterwards.
+ */
+void
+logsink_shutdown(void)
+{
+#ifdef USE_THREADS
+	if (!running)
+		return;
+
+	set_report_sink(NULL);
+	__atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+	sem_post(&wakeup);
+	pthread_join(thread, NULL);
+
+	sem_destroy(&wakeup);
+	running = 0;
+	if (file != NULL) {
+		fclose(file);
+		file = NULL;
+	}
+#endif
+}
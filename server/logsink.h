@@ -0,0 +1,25 @@
+/** \file server/logsink.h
+ * Interface to writing the reports on a thread of their own.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef LOGSINK_H
+#define LOGSINK_H
+
+/** Messages of one report() call reported per second at most by default */
+#define DEFAULT_REPORT_RATE_LIMIT	10
+
+/* Start writing the reports on a thread; to the file if path is not NULL.
+ * rate is the number of messages of one report() call written per second
+ * (0: all). */
+int logsink_init(const char *path, int rate);
+
+/* Write the messages still queued and stop the thread. */
+void logsink_shutdown(void);
+
+#endif
@@ -62,8 +62,17 @@
 #include "parse.h"
 #include "render.h"
 #include "serverscreens.h"
+#include "stats.h"
+#include "trace.h"
+#include "logsink.h"
+#include "flightrec.h"
+#include "sources.h"
+#include "framesub.h"
+#include "profile.h"
+#include "warmstate.h"
 #include "menuscreens.h"
 #include "input.h"
+#include "iothread.h"
 #include "shared/configfile.h"
 #include "drivers.h"
 #include "main.h"
@@ -78,13 +87,14 @@
 #define DEFAULT_USER			"nobody"
 #define DEFAULT_DRIVER			"curses"
 #define DEFAULT_DRIVER_PATH		""	/* not needed */
-#define MAX_DRIVERS			8
 #define DEFAULT_FOREGROUND_MODE		0
 #define DEFAULT_ROTATE_SERVER_SCREEN	SERVERSCREEN_ON
 #define DEFAULT_REPORTDEST		RPT_DEST_STDERR
 #define DEFAULT_REPORTLEVEL		RPT_WARNING
 
 #define DEFAULT_FRAME_INTERVAL		125000
+#define DEFAULT_KEY_RENDER_INTERVAL	20000
+#define DEFAULT_SCHEDULER		SCHEDULER_FIXED
 #define DEFAULT_SCREEN_DURATION		32
 #define DEFAULT_BACKLIGHT		BACKLIGHT_OPEN
 #define DEFAULT_HEARTBEAT		HEARTBEAT_OPEN
@@ -123,6 +133,7 @@ char configfile[256];	/* a lot of space in the executable. */
 char user[64];		/* The values will be overwritten anyway... */
 
 int frame_interval = DEFAULT_FRAME_INTERVAL;
+int scheduler = DEFAULT_SCHEDULER;
 
 /* The drivers and their driver parameters */
 char *drivernames[MAX_DRIVERS];
@@ -134,10 +145,28 @@ int num_drivers = 0;
 static int foreground_mode = UNSET_INT;
 static int report_dest = UNSET_INT;
 static int report_level = UNSET_INT;
+static char *replay_file = NULL;	/**< Trace to replay (-R) */
+static char *flight_file = NULL;	/**< Flight record to print (-F) */
+static int replay_bench = 0;		/**< Replay it as fast as possible (-B) */
 
 static int stored_argc;
 static char **stored_argv;
 static volatile short got_reload_signal = 0;
+static volatile short got_profile_signal = 0;
+
+static int key_render_interval = DEFAULT_KEY_RENDER_INTERVAL;	/**< Least time between frames rendered for keys, 0: never */
+static unsigned long last_key_render = 0;	/**< When the last of them was rendered */
+
+/** What the main loop last rendered on a display */
+typedef struct ShownFrame {
+	long tick;		/**< Timer of the frame on the display */
+	Screen *screen;		/**< Screen of that frame */
+} ShownFrame;
+
+static ShownFrame main_frame = { 0, NULL };	/**< The frame of the main display */
+static ShownFrame *shown_frames = &main_frame;	/**< The frames of all displays */
+static int shown_frames_size = 1;	/**< Allocated size of shown_frames */
+static int current_display = 0;		/**< Display being rendered */
 
 /* Local exported variables */
 long timer = 0;
@@ -154,9 +183,17 @@ static int wave_to_parent(pid_t parent_pid);
 static int init_drivers(void);
 static int drop_privs(char *user);
 static void do_reload(void);
+static int reload_drivers(void);
 static void do_mainloop(void);
+static long mainloop_wait_time(long process_lag, long render_lag, int render_wanted);
+static long mainloop_skip_ticks(Screen *s);
+static void mainloop_prepare(Screen *s);
+static void mainloop_render(Screen *s);
+static int mainloop_select(int d);
+static long mainloop_idle_ticks(void);
 static void exit_program(int val);
 static void catch_reload_signal(int val);
+static void catch_profile_signal(int val);
 static int interpret_boolean_arg(char *s);
 static void output_help_screen(void);
 static void output_GPL_notice(void);
@@ -173,6 +210,7 @@ main(int argc, char **argv)
 
 	stored_argc = argc;
 	stored_argv = argv;
+	stats_startup_begin();
 
 	/*
 	 * Settings in order of preference:
@@ -204,6 +242,12 @@ main(int argc, char **argv)
 	/* Read command line*/
 	CHAIN(e, process_command_line(argc, argv));
 
+	/* Printing a flight record needs nothing else */
+	if ((e == 0) && (flight_file != NULL)) {
+		set_reporting("LCDd", RPT_ERR, RPT_DEST_STDERR);
+		exit((flightrec_dump(flight_file) == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
 	/* Read config file
 	 * If config file was not given on command line use default */
 	if (strcmp(configfile, UNSET_STR) == 0)
@@ -218,6 +262,7 @@ main(int argc, char **argv)
 	report(RPT_INFO, "Set report level to %d, output to %s", report_level,
 			((report_dest == RPT_DEST_SYSLOG) ? "syslog" : "stderr"));
 	CHAIN_END(e, "Critical error while processing settings, abort.");
+	stats_startup_step("config");
 
 	/* Now, go into daemon mode (if we should)...
 	 * We wait for the child to report it is running OK. This mechanism
@@ -230,18 +275,59 @@ main(int argc, char **argv)
 		output_GPL_notice();
 		report(RPT_INFO, "Server running in foreground");
 	}
+	stats_startup_step("daemonize");
+	/* Before the signal handlers, which report the CPU times on SIGUSR1 */
+	if (config_get_bool("Server", "Profile", 0, 0))
+		profile_init();
 	install_signal_handlers(!foreground_mode);
 		/* Only catch SIGHUP if not in foreground mode */
 
-	/* Startup the subparts of the server */
+	/* Reports are written on a thread of their own if wanted; after
+	 * forking, as the thread would not survive it. No reason to give up
+	 * if it can't be started. */
+	if (config_get_bool("Server", "ReportAsync", 0, 0))
+		logsink_init(config_get_string("Server", "ReportFile", 0, NULL),
+			     config_get_int("Server", "ReportRateLimit", 0, DEFAULT_REPORT_RATE_LIMIT));
+	/* Before the drivers, which get their numbers in it */
+	if (config_get_string("Server", "FlightRecorder", 0, NULL) != NULL)
+		flightrec_init(config_get_string("Server", "FlightRecorder", 0, NULL),
+			       config_get_int("Server", "FlightRecords", 0, DEFAULT_FLIGHT_RECORDS));
+	/* Before the drivers, which take their state from it, and while
+	 * the file can still be opened as root; no reason to give up */
+	if (config_get_string("Server", "StateFile", 0, NULL) != NULL)
+		warmstate_init(config_get_string("Server", "StateFile", 0, NULL));
+	stats_startup_step("services");
+
+	/* Startup the subparts of the server. The socket listens before
+	 * the drivers, which may take long, are loaded: clients connecting
+	 * meanwhile wait in its backlog instead of being refused. */
 	CHAIN(e, sock_init(bind_addr, bind_port));
+	stats_startup_step("sockets");
+	CHAIN(e, parse_init());
 	CHAIN(e, screenlist_init());
 	CHAIN(e, init_drivers());
+	stats_startup_step("drivers");
 	CHAIN(e, clients_init());
 	CHAIN(e, input_init());
 	CHAIN(e, menuscreens_init());
+	stats_startup_step("menus");
 	CHAIN(e, server_screen_init());
+	stats_startup_step("server_screen");
 	CHAIN_END(e, "Critical error while initializing, abort.");
+
+	/* The statistics endpoint is optional: no reason to give up */
+	if (config_get_string("Server", "StatsSocket", 0, NULL) != NULL)
+		stats_socket_init(config_get_string("Server", "StatsSocket", 0, NULL));
+	/* A replay is not recorded again */
+	if ((config_get_string("Server", "TraceFile", 0, NULL) != NULL) && (replay_file == NULL))
+		trace_record_init(config_get_string("Server", "TraceFile", 0, NULL));
+
+	if (replay_file != NULL) {
+		CHAIN(e, trace_replay_init(replay_file, replay_bench));
+		CHAIN_END(e, "Critical error while loading the trace, abort.");
+	}
+	stats_startup_step("endpoints");
+
 	if (!foreground_mode) {
 		/* Tell to parent that startup went OK. */
 		wave_to_parent(parent_pid);
@@ -249,6 +335,17 @@ main(int argc, char **argv)
 	drop_privs(user); /* This can't be done before, because sending a
 			signal to a process of a different user will fail */
 
+	/* After dropping the privileges: the commands of the data sources
+	 * don't run as root. No reason to give up if they can't be sampled. */
+	sources_init();
+	stats_startup_step("sources");
+
+	/* Clients are served on a thread of their own if wanted, but not in
+	 * a replay, which feeds them from the main loop. No reason to give
+	 * up if the thread can't be started. */
+	if (config_get_bool("Server", "IOThread", 0, 0) && (replay_file == NULL))
+		iothread_start();
+
 	do_mainloop();
 	/* This loop never stops; we'll get out only with a signal...*/
 
@@ -294,12 +391,13 @@ process_command_line(int argc, char **argv)
 
 	debug(RPT_DEBUG, "%s(argc=%d, argv=...)", __FUNCTION__, argc);
 
-	/* Reset getopt */
+	/* Reset getopt: a reload parses the command line again */
+	optind = 1;
 	opterr = 0; /* Prevent some messages to stderr */
 
 	/* Analyze options here.. (please try to keep list of options the
 	 * same everywhere) */
-	while ((c = getopt(argc, argv, "hc:d:fa:p:u:w:s:r:i:")) > 0) {
+	while ((c = getopt(argc, argv, "hc:d:fa:p:u:w:s:r:i:R:BF:")) > 0) {
 		switch(c) {
 			case 'h':
 				help = 1; /* Continue to process the other
@@ -367,6 +465,15 @@ process_command_line(int argc, char **argv)
 					rotate_server_screen = b;
 				}
 				break;
+			case 'R':
+				replay_file = optarg;
+				break;
+			case 'B':
+				replay_bench = 1;
+				break;
+			case 'F':
+				flight_file = optarg;
+				break;
 			case '?':
 				/* For some reason getopt also returns an '?'
 				 * when an option argument is mission... */
@@ -384,6 +491,10 @@ process_command_line(int argc, char **argv)
 		report(RPT_ERR, "Non-option arguments on the command line !");
 		e = -1;
 	}
+	if (replay_bench && (replay_file == NULL)) {
+		report(RPT_ERR, "-B needs a trace to replay (-R)");
+		e = -1;
+	}
 	if (help) {
 		output_help_screen();
 		e = -1;
@@ -457,6 +568,22 @@ process_configfile(char *configfile)
 	}
 
 	frame_interval = config_get_int("Server", "FrameInterval", 0, DEFAULT_FRAME_INTERVAL);
+	key_render_interval = max(config_get_int("Server", "KeyRenderInterval", 0, DEFAULT_KEY_RENDER_INTERVAL), 0);
+
+	{
+		const char *sched = config_get_string("Server", "Scheduler", 0, "fixed");
+
+		if (strcasecmp(sched, "event") == 0)
+			scheduler = SCHEDULER_EVENT;
+		else if (strcasecmp(sched, "adaptive") == 0)
+			scheduler = SCHEDULER_ADAPTIVE;
+		else if (strcasecmp(sched, "fixed") == 0)
+			scheduler = SCHEDULER_FIXED;
+		else {
+			report(RPT_WARNING, "Unknown Scheduler \"%s\", using \"fixed\"", sched);
+			scheduler = SCHEDULER_FIXED;
+		}
+	}
 
 	if (report_dest == UNSET_INT) {
 		int rs = config_get_bool("Server", "ReportToSyslog", 0, UNSET_INT);
@@ -575,6 +702,12 @@ install_signal_handlers(int allow_reload)
 		/* Treat this signal just like INT and TERM */
 	}
 	sigaction(SIGHUP, &sa, NULL);
+
+	/* With profiling, SIGUSR1 reports the CPU times */
+	if (profile_enabled) {
+		sa.sa_handler = catch_profile_signal;
+		sigaction(SIGUSR1, &sa, NULL);
+	}
 }
 
 
@@ -663,22 +796,13 @@ wave_to_parent(pid_t parent_pid)
 static int
 init_drivers(void)
 {
-	int i, res;
-
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	for (i = 0; i < num_drivers; i++) {
-
-		res = drivers_load_driver(drivernames[i]);
-		if (res >= 0) {
-			/* Load went OK */
-
-			if (res == 2)
-				foreground_mode = 1;
-		} else {
-			report(RPT_ERR, "Could not load driver %.40s", drivernames[i]);
-		}
-	}
+	/* drivers that failed have been reported already */
+	if (drivers_load_drivers(drivernames, num_drivers) == 2)
+		foreground_mode = 1;
+	/* states of drivers no longer configured go */
+	warmstate_loaded();
 
 	/* Do we have a running output driver ?*/
 	if (output_driver)
@@ -712,13 +836,30 @@ drop_privs(char *user)
 }
 
 
+/* Load the drivers of the reread configuration, keeping the unchanged */
+static int
+reload_drivers(void)
+{
+	if (drivers_reload(drivernames, num_drivers) == 2)
+		foreground_mode = 1;
+
+	if (output_driver)
+		return 0;
+
+	report(RPT_ERR, "There is no output driver");
+	return -1;
+}
+
+
 static void
 do_reload(void)
 {
 	int e = 0;
 
-	drivers_unload_all();		/* Close all drivers */
-
+	/* The drivers stay loaded: those whose settings did not change are
+	 * kept, see drivers_reload() */
+	drivers_unload_offline();
+	sources_shutdown();
 	config_clear();
 	clear_settings();
 
@@ -738,8 +879,10 @@ do_reload(void)
 	CHAIN(e, (report(RPT_INFO, "Set report level to %d, output to %s", report_level,
 			((report_dest == RPT_DEST_SYSLOG) ? "syslog" : "stderr")), 0));
 
-	/* And restart the drivers */
-	CHAIN(e, init_drivers());
+	/* And restart the drivers whose settings changed; all are redrawn */
+	CHAIN(e, reload_drivers());
+	CHAIN(e, (render_invalidate(), 0));
+	CHAIN(e, (sources_init(), 0));
 	CHAIN_END(e, "Critical error while reloading, abort.");
 }
 
@@ -754,6 +897,12 @@ do_mainloop(void)
 	long int process_lag = 0;
 	long int render_lag = 0;
 	long int t_diff;
+	long flush_wait;
+	long replay_wait;
+	long frame_wait;
+	int render_wanted = 1;
+	int key_handled;
+	int d;
 
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
@@ -774,45 +923,164 @@ do_mainloop(void)
 			t_diff += t.tv_usec - last_t.tv_usec;
 		}
                 process_lag += t_diff;
+		key_handled = 0;
+		if (trace_replay_active())
+			process_lag = max(process_lag, 1);	/* feed the trace */
 		if (process_lag > 0) {
 			/* Time for a processing stroke */
-			sock_poll_clients();		/* poll clients for input*/
-			parse_all_client_messages();	/* analyze input from network clients*/
-			handle_input();		/* handle key input from devices*/
+			unsigned long start = stats_clock();
+			ProfileSlot *prev;
+			int pending;
+
+			pending = 0;
+			if (!iothread_active()) {
+				prev = PROFILE_ENTER(profile_subsystem(PROFILE_POLL));
+				sock_poll_clients();		/* poll clients for input*/
+				PROFILE_LEAVE(prev);
+				prev = PROFILE_ENTER(profile_subsystem(PROFILE_PARSE));
+				pending = parse_all_client_messages();	/* analyze input from network clients*/
+				PROFILE_LEAVE(prev);
+			}
+			if (trace_replay_active() && !trace_replay_step()) {
+				trace_replay_report();	/* the replay is over */
+				exit_program(0);
+			}
+			if (handle_input() > 0) {	/* handle key input from devices*/
+				render_wanted = 1;
+				key_handled = 1;
+			}
+			if (drivers_reconnected()) {	/* a display is back, redraw it*/
+				render_invalidate();
+				render_wanted = 1;
+			}
+			if (sources_poll() > 0)		/* show new values of data sources*/
+				render_wanted = 1;
+			stats_socket_poll();		/* serve statistics requests */
+			stats_histogram_add(&server_stats.process, stats_clock() - start);
 
 			/* We've done the job... */
 			process_lag = 0 - (1e6/PROCESS_FREQ);
 			/* Note : this does not make a fixed frequency */
+
+			/* ...unless clients have used up their budgets: give
+			 * them another pass right after the rendering stroke */
+			if (pending > 0) {
+				process_lag = 0;
+				render_wanted = 1;
+			}
 		}
 
 		render_lag += t_diff;
+		if (trace_replay_bench())
+			render_lag = max(render_lag, 1);	/* a frame in every pass */
+		if ((scheduler != SCHEDULER_FIXED) && (render_lag > 0) && !render_wanted) {
+			long skip = mainloop_idle_ticks();
+
+			/* Nothing on the displays would change: skip the
+			 * frames, but keep the timer in step with the
+			 * clock so that screen rotation stays on time. */
+			while ((render_lag > 0) && (skip != 0)) {
+				timer++;
+				render_lag -= frame_interval;
+				server_stats.frames_skipped++;
+				if (skip > 0)
+					skip--;
+			}
+		}
+		if ((render_lag <= 0) && key_handled && (key_render_interval > 0)
+		    && (stats_clock() - last_key_render >= (unsigned long) key_render_interval)) {
+			/* Show what a key did now instead of at the next tick:
+			 * the same tick again, so screens keep their timing */
+			last_key_render = stats_clock();
+			server_stats.frames_key++;
+			screenlist_raise();
+			mainloop_render(screenlist_current());
+			render_wanted = 0;
+		}
 		if (render_lag > 0) {
 			/* Time for a rendering stroke */
+			if (render_lag > (long) server_stats.render_lag_max)
+				server_stats.render_lag_max = render_lag;
 			timer ++;
-			screenlist_process();
-			s = screenlist_current();
-
-			/* TODO: Move this call to every client connection
-			 *       and every screen add...
-			 */
-			if (s == server_screen) {
-				update_server_screen();
+			/* Every display has a rendering pass of its own;
+			 * drivers with flush threads show the frame of one
+			 * while the next one is rendered. */
+			for (d = 0; d < drivers_display_count(); d++) {
+				ProfileSlot *prev;
+
+				if (!mainloop_select(d))
+					continue;
+				prev = PROFILE_ENTER(profile_subsystem(PROFILE_SCREENLIST));
+				screenlist_process();
+				s = screenlist_current();
+				PROFILE_LEAVE(prev);
+				if ((d > 0) && (s == NULL))
+					continue;
+				mainloop_render(s);
+				/* the I/O thread may have removed it meanwhile */
+				mainloop_prepare(screenlist_current());
 			}
-			render_screen(s, timer);
+			mainloop_select(0);
+			render_wanted = 0;
 
 			/* We've done the job... */
 			if (render_lag > frame_interval * MAX_RENDER_LAG_FRAMES) {
-				/* Cause rendering slowdown because too much lag */
+				/* Cause rendering slowdown because too much lag,
+				 * but keep the timer in step with the clock, so
+				 * that timeouts, rotation and animations do not
+				 * fall behind */
+				long dropped = render_lag / frame_interval - MAX_RENDER_LAG_FRAMES;
+
+				server_stats.frames_dropped += dropped;
+				timer += dropped;
 				render_lag = frame_interval * MAX_RENDER_LAG_FRAMES;
 			}
 			render_lag -= frame_interval;
 			/* Note: this DOES make a fixed frequency (except with slowdown) */
 		}
 
-		/* Sleep just as long as needed */
-		sleeptime = min(0-process_lag, 0-render_lag);
-		if (sleeptime > 0) {
-			usleep(sleeptime);
+		/* Catch up on displays too slow for the last frame, and
+		 * wake up again when the next of them can take it. */
+		iothread_flush_begin();
+		flush_wait = drivers_flush_skipped();
+		iothread_flush_end();
+
+		/* Mirror the frame to the clients subscribed to it, and wake
+		 * up for those that get it later */
+		frame_wait = framesub_publish();
+		if ((frame_wait >= 0) && ((flush_wait < 0) || (frame_wait < flush_wait)))
+			flush_wait = frame_wait;
+
+		/* A replay wakes up for its next record */
+		replay_wait = trace_replay_wait();
+		if ((replay_wait >= 0) && ((flush_wait < 0) || (replay_wait < flush_wait)))
+			flush_wait = replay_wait;
+
+		if (scheduler != SCHEDULER_FIXED) {
+			/* Wait for the next deadline or for client input,
+			 * whichever comes first. Input is processed and
+			 * rendered right away. */
+			long timeout = mainloop_wait_time(process_lag, render_lag, render_wanted);
+
+			if (flush_wait >= 0)
+				timeout = min(timeout, flush_wait);
+			if (iothread_active() ? iothread_wait(timeout) : (sock_wait(timeout) > 0)) {
+				process_lag = 1;
+				render_wanted = 1;
+			}
+		}
+		else {
+			/* Sleep just as long as needed */
+			sleeptime = min(0-process_lag, 0-render_lag);
+			if (flush_wait >= 0)
+				sleeptime = min(sleeptime, flush_wait);
+			if (iothread_active()) {
+				/* the I/O thread gets the lock at least this long */
+				iothread_wait(max(sleeptime, 0));
+			}
+			else if (sleeptime > 0) {
+				usleep(sleeptime);
+			}
 		}
 
 		/* Check if a SIGHUP has been caught */
@@ -820,6 +1088,11 @@ do_mainloop(void)
 			got_reload_signal = 0;
 			do_reload();
 		}
+		/* ...or a SIGUSR1 */
+		if (got_profile_signal) {
+			got_profile_signal = 0;
+			profile_report();
+		}
 	}
 
 	/* Quit! */
@@ -827,6 +1100,216 @@ do_mainloop(void)
 }
 
 
+/**
+ * Tell how many of the coming ticks the current screen would render
+ * exactly like the frame on the display, so their rendering strokes can be
+ * skipped. The event-driven scheduler only skips the frames of screens that
+ * are not animated at all, the adaptive one also skips the frames between
+ * the steps of an animation.
+ * \param s  The current screen.
+ * \return  Number of ticks to skip, or -1 if the screen does not change on
+ *          its own.
+ */
+static long
+mainloop_skip_ticks(Screen *s)
+{
+	long ticks;
+
+	if (scheduler == SCHEDULER_EVENT)
+		return render_screen_animated(s) ? 0 : -1;
+
+	if (s != shown_frames[current_display].screen)
+		return 0;
+	ticks = render_screen_idle_ticks(s, shown_frames[current_display].tick);
+	if (ticks < 0)
+		return -1;
+	return max(shown_frames[current_display].tick + ticks - timer, 0);
+}
+
+
+/**
+ * Render a frame of the current screen at the current tick and send it to
+ * the drivers.
+ * \param s  The current screen.
+ */
+static void
+mainloop_render(Screen *s)
+{
+	unsigned long start;
+	ProfileSlot *prev;
+	int rendered;
+	int shown;
+
+	prev = PROFILE_ENTER(profile_subsystem(PROFILE_RENDER));
+	/* only does something after clients or screens came or went */
+	if (s == server_screen) {
+		update_server_screen();
+	}
+	start = stats_clock();
+	flightrec_event(FLIGHT_FRAME_START, 0, 0);
+	rendered = render_screen_frame(s, timer);
+	PROFILE_LEAVE(prev);
+	shown = (s != NULL) && s->ack_pending && render_screen_shown(s);
+	if (rendered == 0) {
+		/* The I/O thread may remove the screen while the drivers
+		 * flush: its client learns now that the frame is on the way */
+		if (shown && iothread_active()) {
+			screen_send_flushed(s, timer);
+			shown = 0;
+		}
+		/* The I/O thread expects the main display to be selected:
+		 * the lock is only given up while that one flushes */
+		if (current_display == 0)
+			iothread_flush_begin();
+		drivers_flush();
+		if (current_display == 0)
+			iothread_flush_end();
+		server_stats.frames_rendered++;
+		stats_histogram_add(&server_stats.render, stats_clock() - start);
+		flightrec_event(FLIGHT_FRAME_END, 0, stats_clock() - start);
+	}
+	else {
+		server_stats.frames_skipped++;
+		flightrec_event(FLIGHT_FRAME_END, 1, 0);
+	}
+	stats_frame_done();
+	stats_startup_frame();
+	/* Tell the clients waiting for it that their changes are shown */
+	if (shown)
+		screen_send_flushed(s, timer);
+	shown_frames[current_display].tick = timer;
+	shown_frames[current_display].screen = s;
+}
+
+
+/**
+ * Select the display to render, in the drivers, the screenlist and the
+ * renderer alike.
+ * \param d  The display's number.
+ * \return  1 if it can be rendered, 0 if it has no output driver (yet).
+ */
+static int
+mainloop_select(int d)
+{
+	if (d >= shown_frames_size) {
+		ShownFrame *frames = malloc((d + 1) * sizeof(ShownFrame));
+
+		if (frames == NULL) {
+			report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+			return 0;
+		}
+		memcpy(frames, shown_frames, shown_frames_size * sizeof(ShownFrame));
+		memset(frames + shown_frames_size, 0, (d + 1 - shown_frames_size) * sizeof(ShownFrame));
+		if (shown_frames != &main_frame)
+			free(shown_frames);
+		shown_frames = frames;
+		shown_frames_size = d + 1;
+	}
+	current_display = d;
+	drivers_select_display(d);
+	screenlist_select(d);
+	render_select_display(d);
+	return (d == 0) || (drivers_display_props(d) != NULL);
+}
+
+
+/**
+ * Tell how many of the coming ticks would render every display exactly
+ * like the frame on it, as far as mainloop_skip_ticks() and
+ * screenlist_idle_ticks() can tell.
+ * \return  Number of ticks to skip, or -1 if no display changes on its own.
+ */
+static long
+mainloop_idle_ticks(void)
+{
+	long ticks = -1;
+	int d;
+
+	for (d = 0; (d < drivers_display_count()) && (ticks != 0); d++) {
+		Screen *s;
+		long skip, idle;
+
+		if (!mainloop_select(d))
+			continue;
+		s = screenlist_current();
+		if (s == NULL) {
+			/* the main display is rendered anyway */
+			if (d == 0)
+				ticks = 0;
+			continue;
+		}
+		skip = mainloop_skip_ticks(s);
+		idle = screenlist_idle_ticks();
+		if ((skip < 0) || ((idle >= 0) && (idle < skip)))
+			skip = idle;
+		if ((skip >= 0) && ((ticks < 0) || (skip < ticks)))
+			ticks = skip;
+	}
+	mainloop_select(0);
+	return ticks;
+}
+
+
+/**
+ * Render the next screen of the rotation ahead, so the frame that switches
+ * to it only has to swap it in. This is done in the last rendering stroke
+ * before the switch: right before it, or as soon as no more strokes will
+ * be rendered until then.
+ * \param s  The current screen, just rendered.
+ */
+static void
+mainloop_prepare(Screen *s)
+{
+	Screen *next;
+	long when;
+	long skip;
+
+	if ((s == NULL) || ((next = screenlist_next_rotation(&when)) == NULL))
+		return;
+
+	skip = (scheduler != SCHEDULER_FIXED) ? mainloop_skip_ticks(s) : 0;
+	if ((skip < 0) || (when - timer <= skip + 1)) {
+		ProfileSlot *prev = PROFILE_ENTER(profile_subsystem(PROFILE_RENDER));
+
+		render_prepare(next, when);
+		PROFILE_LEAVE(prev);
+	}
+}
+
+
+/**
+ * Calculate how long the event-driven main loop may wait for input.
+ * Processing strokes are only scheduled if a driver has to be polled for
+ * keys, rendering strokes only if the current screen of a display
+ * changes: either it is animated, a render has been requested, or the
+ * screenlist is about to rotate. Without any deadline the loop parks for MAX_PARK_TIME.
+ * \param process_lag    Current processing lag.
+ * \param render_lag     Current rendering lag.
+ * \param render_wanted  Non-zero if the next frame has to be rendered.
+ * \return  Time to wait in microseconds.
+ */
+static long
+mainloop_wait_time(long process_lag, long render_lag, int render_wanted)
+{
+	long timeout = MAX_PARK_TIME;
+	long ticks;
+
+	/* a processing stroke is due, e.g. for commands left over */
+	if (process_lag >= 0)
+		return 0;
+
+	if (drivers_have_input() || sources_active())
+		timeout = min(timeout, max(0 - process_lag, 0));
+
+	ticks = render_wanted ? 0 : mainloop_idle_ticks();
+
+	if (ticks >= 0)
+		timeout = min(timeout, max(0 - render_lag, 0) + ticks * frame_interval);
+
+	return timeout;
+}
+
+
 static void
 exit_program(int val)
 {
@@ -834,6 +1317,9 @@ exit_program(int val)
 
 	debug(RPT_DEBUG, "%s(val=%d)", __FUNCTION__, val);
 
+	/* The I/O thread must keep off what is shut down below */
+	iothread_stop();
+
 	/* TODO: These things shouldn't be so interdependent.  The order
 	 * things are shut down in shouldn't matter...
 	 */
@@ -858,16 +1344,24 @@ exit_program(int val)
 	set_reporting("LCDd", report_level, report_dest);
 
 	goodbye_screen();		/* display goodbye screen on LCD display */
+	warmstate_exiting();		/* drivers save their state as they close */
 	drivers_unload_all();		/* release driver memory and file descriptors */
+	warmstate_shutdown();		/* and it is written out for the next start */
 
 	/* Shutdown things if server start was complete */
 	clients_shutdown();		/* shutdown clients (must come first) */
 	menuscreens_shutdown();
 	screenlist_shutdown();		/* shutdown screens (must come after client_shutdown) */
 	input_shutdown();		/* shutdown key input part */
+	sources_shutdown();		/* stop sampling the data sources */
+	framesub_shutdown();		/* forget the clients mirroring the display */
         sock_shutdown();                /* shutdown the sockets server */
+	stats_socket_shutdown();
+	trace_record_shutdown();
+	flightrec_shutdown();
 
 	report(RPT_INFO, "Exiting.");
+	logsink_shutdown();		/* write out the reports still queued */
 	_exit(EXIT_SUCCESS);
 }
 
@@ -881,6 +1375,13 @@ catch_reload_signal(int val)
 }
 
 
+static void
+catch_profile_signal(int val)
+{
+	got_profile_signal = 1;
+}
+
+
 static int
 interpret_boolean_arg(char *s)
 {
@@ -948,6 +1449,9 @@ output_help_screen(void)
 	fprintf(stdout, "    -r <level>          Report level [%d]\n",
 		DEFAULT_REPORTLEVEL);
 	fprintf(stdout, "    -i <bool>           Whether to rotate the server info screen\n");
+	fprintf(stdout, "    -R <trace>          Replay a trace recorded with TraceFile, then exit\n");
+	fprintf(stdout, "    -B                  Replay it as fast as possible and report the results\n");
+	fprintf(stdout, "    -F <record>         Print a flight record written with FlightRecorder, then exit\n");
 
 	/* Error messages will be flushed to the configured output after this
 	 * help message.
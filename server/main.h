@@ -33,6 +33,14 @@ extern char *build_date;
 /* Allow the rendering strokes to lag behind this many frames.
  * More lag will not be corrected, but will cause slow-down. */
 
+#define MAX_PARK_TIME 1000000
+/* Longest time in microseconds the event-driven scheduler waits when there
+ * is nothing to do, so that signals are still noticed in time. */
+
+#define SCHEDULER_FIXED		0
+#define SCHEDULER_EVENT		1
+#define SCHEDULER_ADAPTIVE	2
+
 extern long timer;
 /* 32 bits at 8Hz will overflow in 2 ^ 29 = 5e8 seconds = 17 years.
  * If you get an overflow, please mail us and we will fix this personally
@@ -49,8 +57,10 @@ extern char configfile[];	/* a lot of space in the executable. */
 extern char user[];		/* The values will be overwritten anyway... */
 
 extern int frame_interval;	/* Not a command line option, but could be */
+extern int scheduler;		/* Main loop mode, SCHEDULER_FIXED, _EVENT or _ADAPTIVE */
 
 /* The drivers and their driver parameters */
+#define MAX_DRIVERS	8	/* Most drivers that can be loaded at once */
 extern char *drivernames[];
 extern int num_drivers;
 
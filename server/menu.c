@@ -37,12 +37,63 @@
 #include "menuitem.h"
 #include "menu.h"
 #include "shared/report.h"
+#include "shared/defines.h"
 #include "drivers.h"
 
 
 extern Menu *custom_main_menu;
 
 
+/**
+ * Fill the cache of non-hidden entries of a menu if it is stale.
+ * The cache saves walking the whole list of entries on every key press
+ * and every screen update, which adds up on menus with many entries.
+ * \param menu  Pointer to menu.
+ * \return  Number of visible entries, or -1 if the cache could not be filled.
+ */
+static int
+menu_cache_visible(Menu *menu)
+{
+	MenuItem *item;
+	int count = 0;
+	int itemnr;
+
+	if (menu->data.menu.visible_count >= 0)
+		return menu->data.menu.visible_count;
+
+	free(menu->data.menu.visible);
+	free(menu->data.menu.visible_nr);
+	menu->data.menu.visible = NULL;
+	menu->data.menu.visible_nr = NULL;
+
+	if (LL_Length(menu->data.menu.contents) > 0) {
+		menu->data.menu.visible = malloc(LL_Length(menu->data.menu.contents) * sizeof(MenuItem *));
+		menu->data.menu.visible_nr = malloc(LL_Length(menu->data.menu.contents) * sizeof(int));
+		if ((menu->data.menu.visible == NULL) || (menu->data.menu.visible_nr == NULL)) {
+			report(RPT_ERR, "%s: Could not allocate memory", __FUNCTION__);
+			free(menu->data.menu.visible);
+			free(menu->data.menu.visible_nr);
+			menu->data.menu.visible = NULL;
+			menu->data.menu.visible_nr = NULL;
+			return -1;
+		}
+	}
+
+	for (item = LL_GetFirst(menu->data.menu.contents), itemnr = 0;
+	     item != NULL;
+	     item = LL_GetNext(menu->data.menu.contents), itemnr++) {
+		/* hidden items don't count at all... */
+		if (! item->is_hidden) {
+			menu->data.menu.visible[count] = item;
+			menu->data.menu.visible_nr[count] = itemnr;
+			++count;
+		}
+	}
+	menu->data.menu.visible_count = count;
+	return count;
+}
+
+
 /**
  * Search a menu for an entry by index, ignoring hidden entries.
  * \param menu   Pointer to menu to search in.
@@ -57,6 +108,10 @@ menu_get_subitem(Menu *menu, int index)
 
 	debug(RPT_DEBUG, "%s(menu=[%s], index=%d)", __FUNCTION__,
 			((menu != NULL) ? menu->id : "(null)"), index);
+	if (menu_cache_visible(menu) >= 0)
+		return ((index >= 0) && (index < menu->data.menu.visible_count))
+		       ? menu->data.menu.visible[index] : NULL;
+
 	for (item = LL_GetFirst(menu->data.menu.contents);
 	     item != NULL;
 	     item = LL_GetNext(menu->data.menu.contents)) {
@@ -85,6 +140,14 @@ menu_get_index_of(Menu *menu, char *item_id)
 
 	debug(RPT_DEBUG, "%s(menu=[%s], item_id=%s)", __FUNCTION__,
 			((menu != NULL) ? menu->id : "(null)"), item_id);
+	if (menu_cache_visible(menu) >= 0) {
+		for (i = 0; i < menu->data.menu.visible_count; i++) {
+			if (strcmp(item_id, menu->data.menu.visible[i]->id) == 0)
+				return i;
+		}
+		return -1;
+	}
+
 	for (item = LL_GetFirst(menu->data.menu.contents);
 	     item != NULL;
 	     item = LL_GetNext(menu->data.menu.contents)) {
@@ -110,6 +173,9 @@ menu_visible_item_count(Menu *menu)
 	MenuItem *item;
 	int i = 0;
 
+	if (menu_cache_visible(menu) >= 0)
+		return menu->data.menu.visible_count;
+
 	for (item = LL_GetFirst(menu->data.menu.contents);
 	     item != NULL;
 	     item = LL_GetNext(menu->data.menu.contents))
@@ -194,6 +260,52 @@ fill_labeled_value(char *string, int len, const char *text, const char *value, i
 }
 
 
+/**
+ * Add an item and everything below it to an id index, or remove them.
+ * \param index  Index to change.
+ * \param item   Item to add or remove.
+ * \param add    Add if true, remove if false.
+ */
+static void
+menu_index_tree(HashTable *index, MenuItem *item, bool add)
+{
+	if (add) {
+		if (HT_Insert(index, item->id, item) < 0)
+			report(RPT_ERR, "%s: Could not allocate memory", __FUNCTION__);
+	}
+	else
+		HT_Remove(index, item->id, item);
+
+	if (item->type == MENUITEM_MENU) {
+		MenuItem *subitem;
+
+		for (subitem = LL_GetFirst(item->data.menu.contents);
+		     subitem != NULL;
+		     subitem = LL_GetNext(item->data.menu.contents))
+			menu_index_tree(index, subitem, add);
+	}
+}
+
+
+/**
+ * Add an item that was put in a menu to the id indexes of that menu and
+ * of the menus above it, or remove an item taken out of the menu.
+ * \param menu  Menu the item is in.
+ * \param item  Item to add or remove.
+ * \param add   Add if true, remove if false.
+ */
+static void
+menu_index_item(Menu *menu, MenuItem *item, bool add)
+{
+	Menu *m;
+
+	for (m = menu; m != NULL; m = m->parent) {
+		if (m->data.menu.index != NULL)
+			menu_index_tree(m->data.menu.index, item, add);
+	}
+}
+
+
 Menu *
 menu_create(char *id, MenuEventFunc(*event_func),
 	char *text, Client *client)
@@ -208,6 +320,8 @@ menu_create(char *id, MenuEventFunc(*event_func),
 	if (new_menu != NULL) {
 		new_menu->data.menu.contents = LL_new();
 		new_menu->data.menu.association = NULL;
+		new_menu->data.menu.visible_count = -1;
+		new_menu->data.menu.shown_scroll = -1;
 	}
 
 	return new_menu;
@@ -229,6 +343,12 @@ menu_destroy(Menu *menu)
 	menu_destroy_all_items(menu);
 	LL_Destroy(menu->data.menu.contents);
 	menu->data.menu.contents = NULL;
+	HT_Destroy(menu->data.menu.index);
+	menu->data.menu.index = NULL;
+	free(menu->data.menu.visible);
+	free(menu->data.menu.visible_nr);
+	menu->data.menu.visible = NULL;
+	menu->data.menu.visible_nr = NULL;
 
 	/* After this the general menuitem routine destroys the rest... */
 }
@@ -247,6 +367,8 @@ menu_add_item(Menu *menu, MenuItem *item)
 	/* Add the item to the menu */
 	LL_Push(menu->data.menu.contents, item);
 	item->parent = menu;
+	menu_index_item(menu, item, true);
+	menu_invalidate(menu);
 }
 
 
@@ -269,6 +391,8 @@ menu_remove_item(Menu *menu, MenuItem *item)
 	     item2 = LL_GetNext(menu->data.menu.contents), i++) {
 		if (item == item2) {
 			LL_DeleteNode(menu->data.menu.contents, NEXT);
+			menu_index_item(menu, item, false);
+			menu_invalidate(menu);
 			if (menu->data.menu.selector_pos >= i) {
 				menu->data.menu.selector_pos--;
 				if (menu->data.menu.scroll > 0)
@@ -292,9 +416,46 @@ menu_destroy_all_items(Menu *menu)
 		return;
 
 	for (item = menu_getfirst_item(menu); item != NULL; item = menu_getfirst_item(menu)) {
+		menu_index_item(menu, item, false);
 		menuitem_destroy(item);
 		LL_Remove(menu->data.menu.contents, item, NEXT);
 	}
+	menu_invalidate(menu);
+}
+
+
+void
+menu_invalidate(Menu *menu)
+{
+	if ((menu == NULL) || (menu->type != MENUITEM_MENU))
+		return;
+
+	menu->data.menu.visible_count = -1;
+	menu->data.menu.shown_scroll = -1;
+}
+
+
+int
+menu_create_index(Menu *menu)
+{
+	MenuItem *item;
+
+	debug(RPT_DEBUG, "%s(menu=[%s])", __FUNCTION__,
+			((menu != NULL) ? menu->id : "(null)"));
+
+	if ((menu == NULL) || (menu->type != MENUITEM_MENU))
+		return -1;
+	if (menu->data.menu.index != NULL)
+		return 0;
+
+	menu->data.menu.index = HT_new();
+	if (menu->data.menu.index == NULL) {
+		report(RPT_ERR, "%s: Could not allocate memory", __FUNCTION__);
+		return -1;
+	}
+	for (item = menu_getfirst_item(menu); item != NULL; item = menu_getnext_item(menu))
+		menu_index_tree(menu->data.menu.index, item, true);
+	return 0;
 }
 
 
@@ -309,6 +470,8 @@ MenuItem *menu_get_current_item(Menu *menu)
 MenuItem *menu_find_item(Menu *menu, char *id, bool recursive)
 {
 	MenuItem *item;
+	MenuItem *above;
+	Menu *m;
 
 	debug(RPT_DEBUG, "%s(menu=[%s], id=\"%s\", recursive=%d)", __FUNCTION__,
 			((menu != NULL) ? menu->id : "(null)"), id, recursive);
@@ -318,6 +481,21 @@ MenuItem *menu_find_item(Menu *menu, char *id, bool recursive)
 	if (strcmp(menu->id, id) == 0)
 		return menu;
 
+	/* Use the index of this menu or of one above it, if there is one */
+	for (m = menu; m != NULL; m = m->parent) {
+		if (m->data.menu.index == NULL)
+			continue;
+		item = HT_Find(m->data.menu.index, id);
+		if ((item != NULL) && !recursive)
+			return (item->parent == menu) ? item : NULL;
+		/* the item must be below the menu searched */
+		for (above = item; above != NULL; above = above->parent) {
+			if (above->parent == menu)
+				return item;
+		}
+		return NULL;
+	}
+
 	for (item = menu_getfirst_item(menu); item != NULL; item = menu_getnext_item(menu)) {
 		if (strcmp(item->id, id) == 0) {
 			return item;
@@ -377,6 +555,9 @@ void menu_build_screen(MenuItem *menu, Screen *s)
 	if ((menu == NULL) || (s == NULL))
 		return;
 
+	/* Items may have been hidden or shown, and the widgets are new */
+	menu_invalidate(menu);
+
 	/* TODO: Put menu in a frame to do easy scrolling */
 	/* Problem: frames are not handled correctly by renderer */
 
@@ -479,12 +660,95 @@ void menu_build_screen(MenuItem *menu, Screen *s)
 }
 
 
+/**
+ * Place the widgets of one visible entry of a menu for the current scroll
+ * offset. Entries that are not on the display are made invisible, and only
+ * the entries on the display get their values formatted.
+ * \param menu  Pointer to menu.
+ * \param s     Screen holding the widgets of the menu.
+ * \param pos   Position of the entry among the visible entries.
+ */
+static void
+menu_update_line(MenuItem *menu, Screen *s, int pos)
+{
+	Widget *w;
+	MenuItem *subitem = menu->data.menu.visible[pos];
+	int itemnr = menu->data.menu.visible_nr[pos];
+	char buf[LCD_MAX_WIDTH];	// long enough for "icon%d" and such
+	char *p;
+	int len = display_props->width - 1;
+	int y = 2 + pos - menu->data.menu.scroll;
+	bool shown = ((y > 0) && (y <= display_props->height));
+
+	snprintf(buf, sizeof(buf)-1, "text%d", itemnr);
+	buf[sizeof(buf)-1] = '\0';
+	w = screen_find_widget(s, buf);
+	if (w == NULL) {
+		report(RPT_ERR, "%s: could not find widget: %s", __FUNCTION__, buf);
+		return;
+	}
+	w->y = y;
+
+	/* TODO: remove next line when rendering is safe */
+	w->type = (shown) ? WID_STRING : WID_NONE;	/* make invisible */
+
+	switch (subitem->type) {
+	  case MENUITEM_CHECKBOX:
+		/* Update icon value for checkbox */
+		snprintf(buf, sizeof(buf)-1, "icon%d", itemnr);
+		buf[sizeof(buf)-1] = '\0';
+		w = screen_find_widget(s, buf);
+		if (w == NULL) {
+			report(RPT_ERR, "%s: could not find widget: %s", __FUNCTION__, buf);
+			return;
+		}
+		w->y = y;
+		w->length = ((int[]){ICON_CHECKBOX_OFF,ICON_CHECKBOX_ON,ICON_CHECKBOX_GRAY})[subitem->data.checkbox.value];
+
+		/* TODO: remove next line when rendering is safe */
+		w->type = (shown) ? WID_ICON : WID_NONE;	/* make invisible */
+		return;
+	  default:
+		break;
+	}
+
+	/* a value nobody sees need not be formatted */
+	if (!shown)
+		return;
+
+	switch (subitem->type) {
+	  case MENUITEM_RING:
+		p = LL_GetByIndex(subitem->data.ring.strings, subitem->data.ring.value);
+		fill_labeled_value(w->text, len, subitem->text, p, LV_VALUE_ONLY);
+		break;
+	  case MENUITEM_SLIDER:
+		snprintf(buf, display_props->width, "%d", subitem->data.slider.value);
+		buf[display_props->width-1] = '\0';
+		fill_labeled_value(w->text, len, subitem->text, buf, LV_LABEL_VALU);
+		break;
+	  case MENUITEM_NUMERIC:
+		snprintf(buf, display_props->width, "%d", subitem->data.numeric.value);
+		buf[display_props->width-1] = '\0';
+		fill_labeled_value(w->text, len, subitem->text, buf, LV_LABEL_VALU);
+		break;
+	  case MENUITEM_ALPHA:
+		fill_labeled_value(w->text, len, subitem->text, subitem->data.alpha.value, LV_LABEL_VALU);
+		break;
+	  case MENUITEM_IP:
+		fill_labeled_value(w->text, len, subitem->text, subitem->data.ip.value, LV_LABEL_ALUE);
+		break;
+	  default:
+		break;
+	}
+}
+
+
 void menu_update_screen(MenuItem *menu, Screen *s)
 {
 	Widget *w;
-	MenuItem *subitem;
-	int itemnr;
-	int hidden_count = 0;
+	int count;
+	int first, last;
+	int pos;
 
 	debug(RPT_DEBUG, "%s(menu=[%s], screen=[%s])", __FUNCTION__,
 			((menu != NULL) ? menu->id : "(null)"),
@@ -495,83 +759,44 @@ void menu_update_screen(MenuItem *menu, Screen *s)
 
 	/* Update widgets for the title */
 	w = screen_find_widget(s, "title");
-	if (w == NULL)
-		report(RPT_ERR, "%s: could not find widget: %s", __FUNCTION__, "title");
-	w->y = 1 - menu->data.menu.scroll;
-
-	/* TODO: remove next 3 limes when rendering is safe */
-	w->type = ((w->y > 0) && (w->y <= display_props->height))
-		  ? WID_TITLE
-		  : WID_NONE;	/* make invisible */
-
-	/* Update widgets for each subitem in the menu */
-	for (subitem = LL_GetFirst(menu->data.menu.contents), itemnr = 0;
-	     subitem != NULL;
-	     subitem = LL_GetNext(menu->data.menu.contents), itemnr ++)
-	{
-		char buf[LCD_MAX_WIDTH];	// long enough for "icon%d" and such
-		char *p;
-		int len = display_props->width - 1;
-
-		if (subitem->is_hidden) {
-			debug(RPT_DEBUG, "%s: menu %s has hidden menu: %s",
-			      __FUNCTION__, menu->id, subitem->id);
-			hidden_count++;
-			continue;
-		}
-		snprintf(buf, sizeof(buf)-1, "text%d", itemnr);
-		buf[sizeof(buf)-1] = '\0';
-		w = screen_find_widget(s, buf);
-		if (w == NULL)
-			report(RPT_ERR, "%s: could not find widget: %s", __FUNCTION__, buf);
-		w->y = 2 + itemnr - hidden_count - menu->data.menu.scroll;
+	if (w != NULL) {
+		w->y = 1 - menu->data.menu.scroll;
 
-		/* TODO: remove next 3 lines when rendering is safe */
+		/* TODO: remove next 3 limes when rendering is safe */
 		w->type = ((w->y > 0) && (w->y <= display_props->height))
-			  ? WID_STRING
+			  ? WID_TITLE
 			  : WID_NONE;	/* make invisible */
+	}
+	else
+		report(RPT_ERR, "%s: could not find widget: %s", __FUNCTION__, "title");
 
-		switch (subitem->type) {
-		  case MENUITEM_CHECKBOX:
-			/* Update icon value for checkbox */
-			snprintf(buf, sizeof(buf)-1, "icon%d", itemnr);
-			buf[sizeof(buf)-1] = '\0';
-			w = screen_find_widget(s, buf);
-			if (w == NULL)
-				report(RPT_ERR, "%s: could not find widget: %s", __FUNCTION__, buf);
-			w->y = 2 + itemnr - menu->data.menu.scroll;
-			w->length = ((int[]){ICON_CHECKBOX_OFF,ICON_CHECKBOX_ON,ICON_CHECKBOX_GRAY})[subitem->data.checkbox.value];
-
-			/* TODO: remove next 3 lines when rendering is safe */
-			w->type = ((w->y > 0) && (w->y <= display_props->height))
-				  ? WID_ICON
-				  : WID_NONE;	/* make invisible */
-			break;
-		  case MENUITEM_RING:
-			p = LL_GetByIndex(subitem->data.ring.strings, subitem->data.ring.value);
-			fill_labeled_value(w->text, len, subitem->text, p, LV_VALUE_ONLY);
+	count = menu_cache_visible(menu);
 
-			break;
-		    case MENUITEM_SLIDER:
-			snprintf(buf, display_props->width, "%d", subitem->data.slider.value);
-			buf[display_props->width-1] = '\0';
-			fill_labeled_value(w->text, len, subitem->text, buf, LV_LABEL_VALU);
-		    	break;
-		    case MENUITEM_NUMERIC:
-			snprintf(buf, display_props->width, "%d", subitem->data.numeric.value);
-			buf[display_props->width-1] = '\0';
-			fill_labeled_value(w->text, len, subitem->text, buf, LV_LABEL_VALU);
-		    	break;
-		    case MENUITEM_ALPHA:
-			fill_labeled_value(w->text, len, subitem->text, subitem->data.alpha.value, LV_LABEL_VALU);
-		    	break;
-		    case MENUITEM_IP:
-			fill_labeled_value(w->text, len, subitem->text, subitem->data.ip.value, LV_LABEL_ALUE);
-		    	break;
-		  default:
-                      break;
+	/* Positions of the visible entries on the first and last line */
+	first = max(menu->data.menu.scroll - 1, 0);
+	last = min(menu->data.menu.scroll + display_props->height - 2, count - 1);
+
+	if (menu->data.menu.shown_scroll < 0) {
+		/* Widgets are new: place all of them */
+		for (pos = 0; pos < count; pos++)
+			menu_update_line(menu, s, pos);
+	}
+	else {
+		/* Hide the entries that scrolled off the display */
+		if (menu->data.menu.shown_scroll != menu->data.menu.scroll) {
+			int old_first = max(menu->data.menu.shown_scroll - 1, 0);
+			int old_last = min(menu->data.menu.shown_scroll + display_props->height - 2, count - 1);
+
+			for (pos = old_first; pos <= old_last; pos++) {
+				if ((pos < first) || (pos > last))
+					menu_update_line(menu, s, pos);
+			}
 		}
+		/* Redo only the entries on the display */
+		for (pos = first; pos <= last; pos++)
+			menu_update_line(menu, s, pos);
 	}
+	menu->data.menu.shown_scroll = menu->data.menu.scroll;
 
 	/* Update selector position */
 	w = screen_find_widget(s, "selector");
@@ -590,7 +815,7 @@ void menu_update_screen(MenuItem *menu, Screen *s)
 	/* Enable downscroller (if necessary) */
 	w = screen_find_widget(s, "downscroller");
 	if (w != NULL)
-		w->type = (menu_visible_item_count(menu) >= menu->data.menu.scroll + display_props->height)
+		w->type = (count >= menu->data.menu.scroll + display_props->height)
 			? WID_ICON : WID_NONE;
 	else
 		report(RPT_ERR, "%s: could not find widget: %s", __FUNCTION__, "downscroller");
@@ -711,7 +936,8 @@ MenuResult menu_process_input(Menu *menu, MenuToken token, const char *key, unsi
 				menu->data.menu.scroll--;
 			menu->data.menu.selector_pos--;
 		}
-		else if (menu->data.menu.selector_pos == 0) {
+		else if ((menu->data.menu.selector_pos == 0) &&
+			 (menu_visible_item_count(menu) > 0)) {
 			// wrap around to last menu entry
 			menu->data.menu.selector_pos = menu_visible_item_count(menu) - 1;
 			if (menu_visible_item_count(menu) >= display_props->height)
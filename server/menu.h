@@ -50,6 +50,18 @@ void menu_remove_item(Menu *menu, MenuItem *item);
 /** Destroys and removes all items from the menu */
 void menu_destroy_all_items(Menu *menu);
 
+/** Keeps an index of the items below the menu by id, which makes
+ * menu_find_item() on it and its submenus a hash lookup. The ids must be
+ * unique below the menu.
+ * \return 0 on success, -1 on error.
+ */
+int menu_create_index(Menu *menu);
+
+/** Forgets which items of the menu are visible.
+ * Call this when an item of the menu is hidden or shown.
+ */
+void menu_invalidate(Menu *menu);
+
 /** Enumeration function.
  * Retrieves the first item from the list of items in the menu.
  */
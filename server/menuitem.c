@@ -39,7 +39,7 @@ bool menu_permissive_goto;	/* Flag from configuration file */
 
 char *error_strs[] = {"", "Out of range", "Too long", "Too short", "Invalid Address"};
 char *menuitemtypenames[] = {"menu", "action", "checkbox", "ring", "slider", "numeric", "alpha", "ip"};
-char *menueventtypenames[] = {"select", "update", "plus", "minus", "enter", "leave"};
+char *menueventtypenames[] = {"select", "update", "plus", "minus", "enter", "leave", "populate"};
 
 void menuitem_destroy_action(MenuItem *item);
 void menuitem_destroy_checkbox(MenuItem *item);
@@ -58,6 +58,17 @@ void menuitem_rebuild_screen_numeric(MenuItem *item, Screen *s);
 void menuitem_rebuild_screen_alpha(MenuItem *item, Screen *s);
 void menuitem_rebuild_screen_ip(MenuItem *item, Screen *s);
 
+/** Show an error message, leaving the widget alone if it already shows it.
+ * Most key presses leave the error as it was. */
+static void menuitem_update_error(Widget *w, int error_code)
+{
+	if ((w == NULL) ||
+	    ((w->text != NULL) && (strcmp(w->text, error_strs[error_code]) == 0)))
+		return;
+	free(w->text);
+	w->text = strdup(error_strs[error_code]);
+}
+
 void menuitem_update_screen_slider(MenuItem *item, Screen *s);
 void menuitem_update_screen_numeric(MenuItem *item, Screen *s);
 void menuitem_update_screen_alpha(MenuItem *item, Screen *s);
@@ -536,6 +547,8 @@ void menuitem_destroy_alpha(MenuItem *item)
 		free(item->data.alpha.allowed_extra);
 		free(item->data.alpha.value);
 		free(item->data.alpha.edit_str);
+		free(item->data.alpha.chars);
+		free(item->data.alpha.char_pos);
 	}
 }
 
@@ -550,6 +563,68 @@ void menuitem_destroy_ip(MenuItem *item)
 }
 
 
+/* Size of a copy of a string, 0 for none */
+static size_t menuitem_string_size(const char *s)
+{
+	return (s != NULL) ? strlen(s) + 1 : 0;
+}
+
+size_t menuitem_memory(MenuItem *item)
+{
+	MenuItem *sub;
+	char *s;
+	size_t size;
+
+	if (item == NULL)
+		return 0;
+
+	size = sizeof(MenuItem) + menuitem_string_size(item->id)
+		+ menuitem_string_size(item->text)
+		+ menuitem_string_size(item->successor_id)
+		+ menuitem_string_size(item->predecessor_id);
+
+	switch (item->type) {
+	  case MENUITEM_MENU:
+		for (sub = LL_GetFirst(item->data.menu.contents);
+		     sub != NULL;
+		     sub = LL_GetNext(item->data.menu.contents)) {
+			size += sizeof(LL_node) + menuitem_memory(sub);
+		}
+		if (item->data.menu.visible != NULL)
+			size += LL_Length(item->data.menu.contents)
+				* (sizeof(MenuItem *) + sizeof(int));
+		break;
+	  case MENUITEM_RING:
+		for (s = LL_GetFirst(item->data.ring.strings);
+		     s != NULL;
+		     s = LL_GetNext(item->data.ring.strings)) {
+			size += sizeof(LL_node) + menuitem_string_size(s);
+		}
+		break;
+	  case MENUITEM_SLIDER:
+		size += menuitem_string_size(item->data.slider.mintext)
+			+ menuitem_string_size(item->data.slider.maxtext);
+		break;
+	  case MENUITEM_NUMERIC:
+		size += MAX_NUMERIC_LEN;
+		break;
+	  case MENUITEM_ALPHA:
+		size += menuitem_string_size(item->data.alpha.allowed_extra)
+			+ 2 * (item->data.alpha.maxlength + 1)
+			+ menuitem_string_size(item->data.alpha.chars);
+		if (item->data.alpha.char_pos != NULL)
+			size += 256 * sizeof(short);
+		break;
+	  case MENUITEM_IP:
+		size += 2 * (item->data.ip.maxlength + 1);
+		break;
+	  default:
+		break;
+	}
+	return size;
+}
+
+
 /******** MENU ITEM RESET FUNCTIONS ********/
 
 void menuitem_reset(MenuItem *item)
@@ -676,6 +751,7 @@ void menuitem_rebuild_screen(MenuItem *item, Screen *s)
 void menuitem_rebuild_screen_slider(MenuItem *item, Screen *s)
 {
 	Widget *w;
+	int min_len, max_len;
 
 	debug(RPT_DEBUG, "%s(item=[%s], screen=[%s])", __FUNCTION__,
 			((item != NULL) ? item->id : "(null)"),
@@ -693,6 +769,11 @@ void menuitem_rebuild_screen_slider(MenuItem *item, Screen *s)
 		w->y = 1;
 	}
 
+	/* The layout depends on the texts only, so it is done once here
+	 * and key presses only change the length of the bar */
+	min_len = strlen(item->data.slider.mintext);
+	max_len = strlen(item->data.slider.maxtext);
+
 	w = widget_create("bar", WID_HBAR, s);
 	screen_add_widget(s, w);
 	w->width = display_props->width;
@@ -704,10 +785,19 @@ void menuitem_rebuild_screen_slider(MenuItem *item, Screen *s)
 		w->y = display_props->height / 2 + 1;
 		w->width = display_props->width - 2;
 	}
+	else {
+		/* This is option 2: we're tight on lines, so we put the bar
+		 * and min/max texts on the same line.
+		 */
+		w->x = 1 + min_len;
+		w->y = display_props->height;
+		w->width = display_props->width -
+				min_len - max_len;
+	}
 
 	w = widget_create("min", WID_STRING, s);
 	screen_add_widget(s, w);
-	w->text = NULL;
+	w->text = strdup(item->data.slider.mintext);
 	w->x = 1;
 	if (display_props->height > 2) {
 		w->y = display_props->height / 2 + 2;
@@ -717,8 +807,8 @@ void menuitem_rebuild_screen_slider(MenuItem *item, Screen *s)
 
 	w = widget_create("max", WID_STRING, s);
 	screen_add_widget(s, w);
-	w->text = NULL;
-	w->x = 1;
+	w->text = strdup(item->data.slider.maxtext);
+	w->x = 1 + display_props->width - max_len;
 	if (display_props->height > 2) {
 		w->y = display_props->height / 2 + 2;
 	} else {
@@ -762,6 +852,51 @@ void menuitem_rebuild_screen_numeric(MenuItem *item, Screen *s)
 	}
 }
 
+/**
+ * Make the table of characters an alpha item allows, so that each key
+ * press finds the previous or next character without searching.
+ * \param item  Alpha item.
+ * \return  0 on success, -1 if out of memory.
+ */
+static int menuitem_build_alpha_chars(MenuItem *item)
+{
+	char *chars;
+	int i;
+
+	free(item->data.alpha.chars);
+	free(item->data.alpha.char_pos);
+	item->data.alpha.num_chars = 0;
+
+	item->data.alpha.chars = malloc(26 + 26 + 10 + strlen(item->data.alpha.allowed_extra) + 1);
+	item->data.alpha.char_pos = calloc(256, sizeof(short));
+	if ((item->data.alpha.chars == NULL) || (item->data.alpha.char_pos == NULL)) {
+		report(RPT_ERR, "%s: Could not allocate memory", __FUNCTION__);
+		free(item->data.alpha.chars);
+		free(item->data.alpha.char_pos);
+		item->data.alpha.chars = NULL;
+		item->data.alpha.char_pos = NULL;
+		return -1;
+	}
+
+	chars = item->data.alpha.chars;
+	chars[0] = '\0'; /* clear string */
+	if (item->data.alpha.allow_caps)
+		strcat(chars, "ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+	if (item->data.alpha.allow_noncaps)
+		strcat(chars, "abcdefghijklmnopqrstuvwxyz");
+	if (item->data.alpha.allow_numbers)
+		strcat(chars, "0123456789");
+	strcat(chars, item->data.alpha.allowed_extra);
+
+	/* A character listed twice steps from where it is listed first */
+	for (i = 0; chars[i] != '\0'; i++) {
+		if (item->data.alpha.char_pos[(unsigned char) chars[i]] == 0)
+			item->data.alpha.char_pos[(unsigned char) chars[i]] = i + 1;
+	}
+	item->data.alpha.num_chars = i;
+	return 0;
+}
+
 void menuitem_rebuild_screen_alpha(MenuItem *item, Screen *s)
 {
 	Widget *w;
@@ -782,6 +917,9 @@ void menuitem_rebuild_screen_alpha(MenuItem *item, Screen *s)
 		w->y = 1;
 	}
 
+	/* The allowed characters may have changed since the last time */
+	menuitem_build_alpha_chars(item);
+
 	w = widget_create("value", WID_STRING, s);
 	screen_add_widget(s, w);
 	w->text = malloc(item->data.alpha.maxlength+1);
@@ -849,6 +987,8 @@ void menuitem_update_screen(MenuItem *item, Screen *s)
 
 	/* Disable the cursor by default */
 	s->cursor = CURSOR_OFF;
+	/* The update functions change the widgets directly */
+	s->dirty = 1;
 
 	/* Call type specific screen building function */
 	update_screen = update_screen_table [item->type];
@@ -863,7 +1003,6 @@ void menuitem_update_screen(MenuItem *item, Screen *s)
 void menuitem_update_screen_slider(MenuItem *item, Screen *s)
 {
 	Widget *w;
-	int min_len, max_len;
 
 	debug(RPT_DEBUG, "%s(item=[%s], screen=[%s])", __FUNCTION__,
 			((item != NULL) ? item->id : "(null)"),
@@ -872,35 +1011,14 @@ void menuitem_update_screen_slider(MenuItem *item, Screen *s)
 	if ((item == NULL) || (s == NULL))
 		return;
 
-	/* Calculate the bar position and length by filling buffers */
-	min_len = strlen(item->data.slider.mintext);
-	max_len = strlen(item->data.slider.maxtext);
-
-	/* And adjust the data */
-
+	/* The texts and the layout were set when the screen was built */
 	w = screen_find_widget(s, "bar");
-	if (display_props->height <= 2) {
-		/* This is option 2: we're tight on lines, so we put the bar
-		 * and min/max texts on the same line.
-		 */
-		w->x = 1 + min_len;
-		w->y = display_props->height;
-		w->width = display_props->width -
-				min_len - max_len;
-	}
+	if (w == NULL)
+		return;
 	/* FUTURE: w->promille = 1000 * (item->data.slider.value - item->data.slider.minvalue) / (item->data.slider.maxvalue - item->data.slider.minvalue) */;
 	w->length = w->width * display_props->cellwidth
 		* (item->data.slider.value - item->data.slider.minvalue)
 		/ (item->data.slider.maxvalue - item->data.slider.minvalue);
-
-	w = screen_find_widget(s, "min");
-	if (w->text) free(w->text);
-	w->text = strdup(item->data.slider.mintext);
-
-	w = screen_find_widget(s, "max");
-	if (w->text) free(w->text);
-	w->x = 1 + display_props->width - max_len;
-	w->text = strdup(item->data.slider.maxtext);
 }
 
 void menuitem_update_screen_numeric(MenuItem *item, Screen *s)
@@ -924,8 +1042,7 @@ void menuitem_update_screen_numeric(MenuItem *item, Screen *s)
 	/* Only display error string if enough space... */
 	if (display_props->height > 2) {
 		w = screen_find_widget(s, "error");
-		free(w->text);
-		w->text = strdup(error_strs[item->data.numeric.error_code]);
+		menuitem_update_error(w, item->data.numeric.error_code);
 	}
 }
 
@@ -957,8 +1074,7 @@ void menuitem_update_screen_alpha(MenuItem *item, Screen *s)
 	/* Only display error string if enough space... */
 	if (display_props->height > 2) {
 		w = screen_find_widget(s, "error");
-		free(w->text);
-		w->text = strdup(error_strs[item->data.alpha.error_code]);
+		menuitem_update_error(w, item->data.alpha.error_code);
 	}
 }
 
@@ -984,8 +1100,7 @@ void menuitem_update_screen_ip(MenuItem *item, Screen *s)
 	/* Only display error string if enough space... */
 	if (display_props->height > 2) {
 		w = screen_find_widget(s, "error");
-		free(w->text);
-		w->text = strdup(error_strs[item->data.ip.error_code]);
+		menuitem_update_error(w, item->data.ip.error_code);
 	}
 }
 
@@ -1221,8 +1336,7 @@ MenuResult menuitem_process_input_numeric(MenuItem *item, MenuToken token, const
 
 MenuResult menuitem_process_input_alpha(MenuItem *item, MenuToken token, const char *key, unsigned int keymask)
 {
-	char *p;
-	static char *chars = NULL;
+	int i;
 
 	debug(RPT_DEBUG, "%s(item=[%s], token=%d, key=\"%s\")", __FUNCTION__,
 			((item != NULL) ? item->id : "(null)"), token, key);
@@ -1231,17 +1345,15 @@ MenuResult menuitem_process_input_alpha(MenuItem *item, MenuToken token, const c
 		/* To make life easy... */
 		char *str = item->data.alpha.edit_str;
 		int pos = item->data.alpha.edit_pos;
+		char *chars;
+		short *char_pos;
 
-		/* Create list of allowed chars */
-		chars = realloc(chars, 26 + 26 + 10 + strlen(item->data.alpha.allowed_extra) + 1);
-		chars[0] = '\0'; /* clear string */
-		if (item->data.alpha.allow_caps)
-			strcat(chars, "ABCDEFGHIJKLMNOPQRSTUVWXYZ");
-		if (item->data.alpha.allow_noncaps)
-			strcat(chars, "abcdefghijklmnopqrstuvwxyz");
-		if (item->data.alpha.allow_numbers)
-			strcat(chars, "0123456789");
-		strcat(chars, item->data.alpha.allowed_extra);
+		/* The list of allowed chars is made when the screen is built */
+		if ((item->data.alpha.char_pos == NULL) &&
+		    (menuitem_build_alpha_chars(item) < 0))
+			return MENURESULT_ERROR;
+		chars = item->data.alpha.chars;
+		char_pos = item->data.alpha.char_pos;
 
 		/* Clear the error */
 		item->data.alpha.error_code = 0;
@@ -1299,13 +1411,9 @@ MenuResult menuitem_process_input_alpha(MenuItem *item, MenuToken token, const c
 				str[pos] = chars[0];
 			} else {
 				/* We should have a symbol from our list */
-				p = strchr(chars, str[pos]);
-				if (p != NULL) {
-					str[pos] = *(++p); /* next symbol on list */
-					/* Might be '\0' now */
-				} else {
-					str[pos] = '\0';
-				}
+				i = char_pos[(unsigned char) str[pos]];
+				/* next symbol on list, might be '\0' now */
+				str[pos] = (i > 0) ? chars[i] : '\0';
 			}
 			return MENURESULT_NONE;
 		  case MENUTOKEN_DOWN:
@@ -1318,15 +1426,13 @@ MenuResult menuitem_process_input_alpha(MenuItem *item, MenuToken token, const c
 			}
 			if (str[pos] == '\0') {
 				/* User goes past EOL */
-				str[pos] = chars[strlen(chars)-1];
+				if (item->data.alpha.num_chars > 0)
+					str[pos] = chars[item->data.alpha.num_chars - 1];
 			} else {
 				/* We should have a symbol from our list */
-				p = strchr(chars, str[pos]);
-				if ((p != NULL) && (p != chars)) {
-					str[pos] = *(--p); /* previous symbol on list */
-				} else {
-					str[pos] = '\0';
-				}
+				i = char_pos[(unsigned char) str[pos]];
+				/* previous symbol on list */
+				str[pos] = (i > 1) ? chars[i - 2] : '\0';
 			}
 			return MENURESULT_NONE;
 		  case MENUTOKEN_RIGHT:
@@ -1355,7 +1461,7 @@ MenuResult menuitem_process_input_alpha(MenuItem *item, MenuToken token, const c
 				return MENURESULT_NONE;
 			}
 			/* process other keys */
-  			if ((strlen(key) == 1) && (key[0] >= ' ') && (strchr(chars, key[0]) != NULL)) {
+  			if ((strlen(key) == 1) && (key[0] >= ' ') && (char_pos[(unsigned char) key[0]] != 0)) {
 				str[pos] = key[0];
 				item->data.alpha.edit_pos++;
 				if (pos >= display_props->width - 2)
@@ -36,6 +36,7 @@
 #include "shared/defines.h"
 
 #include "shared/LL.h"
+#include "shared/hash.h"
 
 extern bool menu_permissive_goto; /* Flag from the configuration file */
 
@@ -101,7 +102,8 @@ typedef enum MenuEventType {
 				 * (slider moved) */
 	MENUEVENT_ENTER  = 4,	/**< Menu has been entered */
 	MENUEVENT_LEAVE  = 5,	/**< Menu has been left */
-	NUM_EVENTTYPES   = 6
+	MENUEVENT_POPULATE = 6,	/**< Lazy menu without items has been entered */
+	NUM_EVENTTYPES   = 7
 } MenuEventType;
 
 #define MenuEventFunc(f) int (f) (struct MenuItem *item, MenuEventType event)
@@ -140,6 +142,18 @@ typedef struct MenuItem {
 			void *association;      /**< To associate an object
                                                    with this menu */
 			LinkedList *contents;	/**< What's in this menu */
+			struct MenuItem **visible; /**< Cached non-hidden items, in
+						   menu order */
+			int *visible_nr;	/**< Index in contents of each
+						   cached item (names its widgets) */
+			int visible_count;	/**< Number of cached items, or
+						   -1 if the cache is stale */
+			int shown_scroll;	/**< Scroll the widgets were last
+						   placed for, -1 for none */
+			HashTable *index;	/**< Items below this menu by id,
+						   or NULL to search the tree */
+			bool lazy;		/**< Ask the client for the items
+						   when entered without any */
 		} menu;
 		struct action {
 			/* nothing */
@@ -183,6 +197,11 @@ typedef struct MenuItem {
 			short edit_pos;		/**< Position while editing */
 			short edit_offs;	/**< Offset while editing */
 			short error_code;
+			char *chars;		/**< Allowed characters in the
+						   order Up steps through them */
+			short *char_pos;	/**< 1 + index in chars of each
+						   character, 0 if not allowed */
+			short num_chars;	/**< Length of chars */
 		} alpha;
 		struct ip {
 			char *value;		/**< Current value */
@@ -290,6 +309,11 @@ MenuItem *menuitem_create_ip(char *id, MenuEventFunc(*event_func),
  */
 void menuitem_destroy(MenuItem *item);
 
+/** Tells how much memory an item holds, with its strings and, for a menu,
+ * all items in it. Allocator overhead is not included.
+ */
+size_t menuitem_memory(MenuItem *item);
+
 /** Resets the item to the initial state.
  * You should call menuitem_update after this to see the effects.
  * This call is useless on items that have immediate effect, like a slider.
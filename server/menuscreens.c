@@ -34,6 +34,7 @@
 #include "input.h"
 #include "driver.h"
 #include "drivers.h"
+#include "drvthread.h"
 
 #ifdef HAVE_CONFIG_H
 # include "config.h"
@@ -71,6 +72,8 @@ void menuscreen_create_menu(void);
 void menuscreen_create_testmenu(void);
 #endif
 Menu *menuscreen_get_main(void);
+static void menuscreen_fill_options(Menu *options_menu);
+MenuEventFunc(options_handler);
 MenuEventFunc(heartbeat_handler);
 MenuEventFunc(backlight_handler);
 MenuEventFunc(titlespeed_handler);
@@ -265,6 +268,7 @@ menuscreen_switch_item(MenuItem * new_menuitem)
 	else if (old_menuitem && !new_menuitem) {
 		/* leave menu system */
 		menuscreen->priority = PRI_HIDDEN;
+		screenlist_update(menuscreen);
 	}
 	else if (!old_menuitem && new_menuitem) {
 		/* Menu is becoming active */
@@ -272,6 +276,7 @@ menuscreen_switch_item(MenuItem * new_menuitem)
 		menuitem_rebuild_screen(active_menuitem, menuscreen);
 
 		menuscreen->priority = PRI_INPUT;
+		screenlist_update(menuscreen);
 	}
 	else {
 		/* We're left with the usual case: a menu level switch */
@@ -286,6 +291,13 @@ menuscreen_switch_item(MenuItem * new_menuitem)
 	if (new_menuitem && new_menuitem->event_func)
 		new_menuitem->event_func(new_menuitem, MENUEVENT_ENTER);
 
+	/* A lazy menu gets its items from the client only when needed */
+	if (new_menuitem && new_menuitem->event_func &&
+	    (new_menuitem->type == MENUITEM_MENU) &&
+	    new_menuitem->data.menu.lazy &&
+	    (menu_getfirst_item(new_menuitem) == NULL))
+		new_menuitem->event_func(new_menuitem, MENUEVENT_POPULATE);
+
 	return;
 }
 
@@ -485,10 +497,6 @@ void
 menuscreen_create_menu(void)
 {
 	Menu *options_menu;
-	Menu *driver_menu;
-	MenuItem *checkbox;
-	MenuItem *slider;
-	Driver *driver;
 
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
@@ -498,11 +506,15 @@ menuscreen_create_menu(void)
 		return;
 	}
 
-	options_menu = menu_create("options", NULL, "Options", NULL);
+	/* The options are only made when the menu is first entered: that
+	 * asks every driver for its contrast and brightness, which takes
+	 * long on some displays and is not needed unless someone looks */
+	options_menu = menu_create("options", options_handler, "Options", NULL);
 	if (options_menu == NULL) {
 		report(RPT_ERR, "%s: Cannot create options menu", __FUNCTION__);
 		return;
 	}
+	options_menu->data.menu.lazy = true;
 	menu_add_item(main_menu, options_menu);
 
 #ifdef LCDPROC_TESTMENUS
@@ -520,6 +532,23 @@ menuscreen_create_menu(void)
 
 	menuscreen_create_testmenu();
 #endif
+}
+
+
+/**
+ * Add the server's options and those of each driver to the options menu.
+ * \param options_menu  The options menu.
+ */
+static void
+menuscreen_fill_options(Menu *options_menu)
+{
+	Menu *driver_menu;
+	MenuItem *checkbox;
+	MenuItem *slider;
+	Driver *driver;
+	int i;
+
+	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
 	/*
 	 * add option menu contents: menu's client is NULL since we're in the
@@ -539,7 +568,7 @@ menuscreen_create_menu(void)
 	 * add driver specific option menus for each driver: menu's client is
 	 * NULL since we're in the server
 	 */
-	for (driver = drivers_getfirst(); driver; driver = drivers_getnext()) {
+	for (i = 0; (driver = drivers_get(i)) != NULL; i++) {
 		int contrast_avail = (driver->get_contrast && driver->set_contrast) ? 1 : 0;
 		int brightness_avail = (driver->get_brightness && driver->set_brightness) ? 1 : 0;
 
@@ -554,7 +583,11 @@ menuscreen_create_menu(void)
 			menu_set_association(driver_menu, driver);
 			menu_add_item(options_menu, driver_menu);
 			if (contrast_avail) {
-				int contrast = driver->get_contrast(driver);
+				int contrast;
+
+				drvthread_lock(driver);
+				contrast = driver->get_contrast(driver);
+				drvthread_unlock(driver);
 
 				/* menu's client is NULL since we're in the server */
 				slider = menuitem_create_slider("contrast", contrast_handler, "Contrast",
@@ -562,8 +595,12 @@ menuscreen_create_menu(void)
 				menu_add_item(driver_menu, slider);
 			}
 			if (brightness_avail) {
-				int onbrightness = driver->get_brightness(driver, BACKLIGHT_ON);
-				int offbrightness = driver->get_brightness(driver, BACKLIGHT_OFF);
+				int onbrightness, offbrightness;
+
+				drvthread_lock(driver);
+				onbrightness = driver->get_brightness(driver, BACKLIGHT_ON);
+				offbrightness = driver->get_brightness(driver, BACKLIGHT_OFF);
+				drvthread_unlock(driver);
 
 				slider = menuitem_create_slider("onbrightness", brightness_handler, "On Brightness",
 								NULL, "min", "max", 0, 1000, 25, onbrightness);
@@ -651,6 +688,18 @@ menuscreen_create_testmenu(void)
 }
 #endif /* LCDPROC_TESTMENUS */
 
+MenuEventFunc(options_handler)
+{
+	debug(RPT_DEBUG, "%s(item=[%s], event=%d)", __FUNCTION__,
+	      ((item != NULL) ? item->id : "(null)"), event);
+
+	if ((item != NULL) && (event == MENUEVENT_POPULATE)) {
+		menuscreen_fill_options(item);
+		menuscreen_inform_item_modified(item);
+	}
+	return 0;
+}
+
 MenuEventFunc(heartbeat_handler)
 {
 	debug(RPT_DEBUG, "%s(item=[%s], event=%d)", __FUNCTION__,
@@ -704,7 +753,9 @@ MenuEventFunc(contrast_handler)
 		Driver *driver = item->parent->data.menu.association;
 
 		if (driver != NULL) {
+			drvthread_lock(driver);
 			driver->set_contrast(driver, item->data.slider.value);
+			drvthread_unlock(driver);
 			report(RPT_INFO, "Menu: set contrast of [%.40s] to %d",
 			       driver->name, item->data.slider.value);
 		}
@@ -726,12 +777,14 @@ MenuEventFunc(brightness_handler)
 		Driver *driver = item->parent->data.menu.association;
 
 		if (driver != NULL) {
+			drvthread_lock(driver);
 			if (strcmp(item->id, "onbrightness") == 0) {
 				driver->set_brightness(driver, BACKLIGHT_ON, item->data.slider.value);
 			}
 			else if (strcmp(item->id, "offbrightness") == 0) {
 				driver->set_brightness(driver, BACKLIGHT_OFF, item->data.slider.value);
 			}
+			drvthread_unlock(driver);
 		}
 	}
 	return 0;
@@ -751,7 +804,7 @@ menuscreen_add_screen(Screen *s)
 		return;
 
 	/* Create a menu entry for the screen */
-	m = menu_create(s->id, NULL, ((s->name != NULL) ? s->name : s->id), s->client);
+	m = menu_create((char *) s->id, NULL, ((s->name != NULL) ? s->name : (char *) s->id), s->client);
 	if (m == NULL) {
 		report(RPT_ERR, "%s: Cannot create menu", __FUNCTION__);
 		return;
@@ -789,7 +842,7 @@ menuscreen_remove_screen(Screen *s)
 		return;
 
 	if (screens_menu) {
-		Menu *m = menu_find_item(screens_menu, s->id, false);
+		Menu *m = menu_find_item(screens_menu, (char *) s->id, false);
 
 		menu_remove_item(screens_menu, m);
 		menuitem_destroy(m);
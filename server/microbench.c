@@ -0,0 +1,565 @@
+/** \file server/microbench.c
+ * Micro benchmarks of the server's hot paths, built and run by
+ * "make bench". Each benchmark runs its loop with more and more
+ * iterations until it takes at least the minimum time, and then prints
+ * one tab separated line:
+ *
+ *\verbatim
+ * <name>	<iterations>	<nanoseconds per iteration>
+ *\endverbatim
+ *
+ * Lines starting with # are comments. The parsing and rendering
+ * benchmarks run on the bench driver (see drivers/bench.c), loaded from
+ * drivers/ below the current directory like LCDd would load it.
+ *
+ * Usage: microbench [-t <milliseconds>] [<name>...]
+ * With names given, only the benchmarks whose names start with one of
+ * them are run.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "shared/report.h"
+#include "shared/configfile.h"
+#include "shared/sockets.h"
+#include "shared/sring.h"
+#include "shared/LL.h"
+#include "shared/vector.h"
+#include "shared/pool.h"
+
+#include "drivers/lcd_lib.h"
+#include "commands/command_list.h"
+#include "client.h"
+#include "clients.h"
+#include "screen.h"
+#include "screenlist.h"
+#include "parse.h"
+#include "render.h"
+#include "drivers.h"
+#include "main.h"
+
+/* Set by main.c in LCDd */
+long timer = 0;
+int frame_interval = 125000;	/* LCDd's default */
+
+/** Default minimum run time of a benchmark, in milliseconds */
+#define BENCH_DEFAULT_TIME	200
+
+/** Number of items in the list benchmarks */
+#define BENCH_ITEMS		256
+
+/** Width of a line in the diff benchmarks */
+#define BENCH_LINE		40
+
+/** A benchmark: runs its work n times */
+typedef struct {
+	const char *name;
+	void (*run) (long n);
+	int needs_client;	/**< needs the driver and the client */
+} Benchmark;
+
+static Client *client = NULL;
+static volatile long sink;	/**< keeps results from being optimized away */
+
+
+/* Replies of the commands go nowhere */
+static int
+bench_send(int fd, const void *src, size_t size)
+{
+	return size;
+}
+
+
+/* Queue some lines for the client and parse them */
+static void
+bench_parse(const char *lines)
+{
+	client_add_message(client, pool_strdup(client->pool, lines));
+	parse_client_messages(client);
+}
+
+
+/*
+ * Command lookup
+ */
+
+static void
+run_command_lookup(long n)
+{
+	static char *names[NUM_COMMANDS];
+	long i;
+
+	if (names[0] == NULL) {
+		for (i = 0; i < NUM_COMMANDS; i++)
+			names[i] = (char *) get_command_name(i);
+	}
+	for (i = 0; i < n; i++)
+		sink += (get_command_function(names[i % NUM_COMMANDS]) != NULL);
+}
+
+
+/*
+ * Parsing
+ */
+
+static void
+run_parse_widget_set(long n)
+{
+	char line[80];
+	long i;
+
+	for (i = 0; i < n; i++) {
+		snprintf(line, sizeof(line), "widget_set strings s0 1 1 {Line %ld}", i);
+		bench_parse(line);
+	}
+}
+
+static void
+run_parse_batch(long n)
+{
+	char lines[16 * 48];
+	long i;
+
+	for (i = 0; i < n; i++) {
+		int len = 0;
+		int j;
+
+		for (j = 0; j < 16; j++)
+			len += sprintf(lines + len, "widget_set strings s%d 1 %d {%ld}\n", j, j % 4 + 1, i);
+		bench_parse(lines);
+	}
+}
+
+
+/*
+ * Ring buffer
+ */
+
+static void
+run_sring_lines(long n)
+{
+	static sring_buffer *ring = NULL;
+	char line[64];
+	char out[64];
+	long i;
+
+	if (ring == NULL)
+		ring = sring_create_mirrored(4096);
+	memset(line, 'x', sizeof(line) - 1);
+	line[sizeof(line) - 1] = '\n';
+	for (i = 0; i < n; i++) {
+		int len;
+
+		sring_write(ring, line, sizeof(line));
+		len = sring_lines_length(ring);
+		sink += sring_read(ring, out, len);
+	}
+}
+
+
+/*
+ * Lists: the linked list against the vector
+ */
+
+static int items[BENCH_ITEMS];
+
+static int
+compare_items(void *a, void *b)
+{
+	return *(int *) a - *(int *) b;
+}
+
+static int
+compare_items_qsort(const void *a, const void *b)
+{
+	return **(int *const *) a - **(int *const *) b;
+}
+
+static void
+fill_items(void)
+{
+	int i;
+
+	srand(1);
+	for (i = 0; i < BENCH_ITEMS; i++)
+		items[i] = rand();
+}
+
+static void
+run_ll_push_shift(long n)
+{
+	LinkedList *list = LL_new();
+	long i;
+
+	for (i = 0; i < n; i++) {
+		LL_Push(list, &items[i % BENCH_ITEMS]);
+		if (LL_Length(list) >= BENCH_ITEMS)
+			sink += *(int *) LL_Shift(list);
+	}
+	LL_Destroy(list);
+}
+
+static void
+run_vector_append_shift(long n)
+{
+	Vector *v = V_new();
+	long i;
+
+	for (i = 0; i < n; i++) {
+		V_Append(v, &items[i % BENCH_ITEMS]);
+		if (V_Length(v) >= BENCH_ITEMS)
+			sink += *(int *) V_Shift(v);
+	}
+	V_Destroy(v);
+}
+
+static void
+run_ll_iterate(long n)
+{
+	LinkedList *list = LL_new();
+	long i;
+
+	for (i = 0; i < BENCH_ITEMS; i++)
+		LL_Push(list, &items[i]);
+	for (i = 0; i < n; i++) {
+		int *item;
+
+		for (item = LL_GetFirst(list); item != NULL; item = LL_GetNext(list))
+			sink += *item;
+	}
+	LL_Destroy(list);
+}
+
+static void
+run_vector_iterate(long n)
+{
+	Vector *v = V_new();
+	long i;
+
+	for (i = 0; i < BENCH_ITEMS; i++)
+		V_Append(v, &items[i]);
+	for (i = 0; i < n; i++) {
+		int *item;
+		int j;
+
+		for (j = 0; (item = V_Get(v, j)) != NULL; j++)
+			sink += *item;
+	}
+	V_Destroy(v);
+}
+
+static void
+run_ll_sort(long n)
+{
+	LinkedList *list = LL_new();
+	long i;
+
+	for (i = 0; i < BENCH_ITEMS; i++)
+		LL_Push(list, &items[i]);
+	for (i = 0; i < n; i++) {
+		LL_node *node;
+		int j = 0;
+
+		/* the same unsorted order each time */
+		for (node = list->head.next; node != &list->tail; node = node->next)
+			node->data = &items[j++];
+		LL_Sort(list, compare_items);
+	}
+	sink += *(int *) LL_GetFirst(list);
+	LL_Destroy(list);
+}
+
+static void
+run_qsort(long n)
+{
+	int *array[BENCH_ITEMS];
+	long i;
+
+	for (i = 0; i < n; i++) {
+		int j;
+
+		for (j = 0; j < BENCH_ITEMS; j++)
+			array[j] = &items[j];
+		qsort(array, BENCH_ITEMS, sizeof(int *), compare_items_qsort);
+	}
+	sink += *array[0];
+}
+
+
+/*
+ * Rendering
+ */
+
+static void
+bench_render(const char *id, long n)
+{
+	Screen *s = client_find_screen(client, (char *) id);
+	long i;
+
+	if (s == NULL)
+		return;
+	for (i = 0; i < n; i++) {
+		render_invalidate();
+		render_screen(s, timer++);
+	}
+}
+
+static void
+run_render_strings(long n)
+{
+	bench_render("strings", n);
+}
+
+static void
+run_render_frames(long n)
+{
+	bench_render("frames", n);
+}
+
+static void
+run_render_scrollers(long n)
+{
+	bench_render("scrollers", n);
+}
+
+
+/*
+ * Driver diff kernels
+ */
+
+static unsigned char line_a[BENCH_LINE];
+static unsigned char line_b[BENCH_LINE];
+
+static void
+run_diff_scalar(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++) {
+		int first, last;
+
+		line_b[i % BENCH_LINE] ^= 1;
+		for (first = 0; (first < BENCH_LINE) && (line_a[first] == line_b[first]); first++)
+			;
+		for (last = BENCH_LINE - 1; (last > first) && (line_a[last] == line_b[last]); last--)
+			;
+		line_b[i % BENCH_LINE] ^= 1;
+		sink += first + last;
+	}
+}
+
+static void
+run_diff_lib(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++) {
+		int first = 0, last = 0;
+
+		line_b[i % BENCH_LINE] ^= 1;
+		lib_diff_span(line_a, line_b, BENCH_LINE, &first, &last);
+		line_b[i % BENCH_LINE] ^= 1;
+		sink += first + last;
+	}
+}
+
+
+static const Benchmark benchmarks[] = {
+	{ "command_lookup",		run_command_lookup,		0 },
+	{ "parse_widget_set",		run_parse_widget_set,		1 },
+	{ "parse_batch16",		run_parse_batch,		1 },
+	{ "sring_lines",		run_sring_lines,		0 },
+	{ "ll_push_shift",		run_ll_push_shift,		0 },
+	{ "vector_append_shift",	run_vector_append_shift,	0 },
+	{ "ll_iterate256",		run_ll_iterate,			0 },
+	{ "vector_iterate256",		run_vector_iterate,		0 },
+	{ "ll_sort256",			run_ll_sort,			0 },
+	{ "qsort256",			run_qsort,			0 },
+	{ "render_strings",		run_render_strings,		1 },
+	{ "render_frames",		run_render_frames,		1 },
+	{ "render_scrollers",		run_render_scrollers,		1 },
+	{ "diff_scalar",		run_diff_scalar,		0 },
+	{ "diff_lib",			run_diff_lib,			0 },
+	{ NULL, NULL, 0 }
+};
+
+
+/* Screens the rendering benchmarks show, created through the protocol */
+static const char bench_screens[] =
+	"hello\n"
+	/* many widgets */
+	"screen_add strings\n"
+	"widget_add strings title title\n"
+	"widget_set strings title {Many widgets}\n"
+	"widget_add strings s0 string\n" "widget_add strings s1 string\n"
+	"widget_add strings s2 string\n" "widget_add strings s3 string\n"
+	"widget_add strings s4 string\n" "widget_add strings s5 string\n"
+	"widget_add strings s6 string\n" "widget_add strings s7 string\n"
+	"widget_add strings s8 string\n" "widget_add strings s9 string\n"
+	"widget_add strings s10 string\n" "widget_add strings s11 string\n"
+	"widget_add strings s12 string\n" "widget_add strings s13 string\n"
+	"widget_add strings s14 string\n" "widget_add strings s15 string\n"
+	"widget_add strings h1 hbar\n" "widget_set strings h1 1 3 60\n"
+	"widget_add strings v1 vbar\n" "widget_set strings v1 20 4 20\n"
+	"widget_add strings i1 icon\n" "widget_set strings i1 19 1 HEART_OPEN\n"
+	/* nested frames */
+	"screen_add frames\n"
+	"widget_add frames f1 frame\n"
+	"widget_set frames f1 1 1 20 4 20 8 v 2\n"
+	"widget_add frames f2 frame -in f1\n"
+	"widget_set frames f2 1 2 20 4 20 6 v 4\n"
+	"widget_add frames t1 string -in f1\n"
+	"widget_set frames t1 1 1 {Outer frame}\n"
+	"widget_add frames t2 string -in f2\n"
+	"widget_set frames t2 1 1 {Inner frame, line 1}\n"
+	"widget_add frames t3 string -in f2\n"
+	"widget_set frames t3 1 3 {Inner frame, line 3}\n"
+	"widget_add frames t4 string -in f2\n"
+	"widget_set frames t4 1 5 {Inner frame, line 5}\n"
+	/* scrollers */
+	"screen_add scrollers\n"
+	"widget_add scrollers m1 scroller\n"
+	"widget_set scrollers m1 1 1 20 1 m 1 {A marquee going round and round}\n"
+	"widget_add scrollers m2 scroller\n"
+	"widget_set scrollers m2 1 2 20 2 h 2 {Scrolling back and forth, and on}\n"
+	"widget_add scrollers m3 scroller\n"
+	"widget_set scrollers m3 1 3 20 4 v 3 {A long text scrolling upwards over two lines of the display}\n";
+
+
+/* Load the bench driver and set up a client with the screens */
+static int
+bench_setup_client(void)
+{
+	char config[] = "/tmp/microbenchXXXXXX";
+	const char settings[] =
+		"[server]\nDriverPath=drivers/\n"
+		"[bench]\nSize=20x4\n";
+	int fd;
+
+	fd = mkstemp(config);
+	if (fd < 0)
+		return -1;
+	if (write(fd, settings, sizeof(settings) - 1) != sizeof(settings) - 1) {
+		close(fd);
+		unlink(config);
+		return -1;
+	}
+	close(fd);
+	fd = config_read_file(config);
+	unlink(config);
+	if (fd < 0)
+		return -1;
+
+	if ((screenlist_init() < 0) || (clients_init() < 0) || (parse_init() < 0))
+		return -1;
+	if (drivers_load_driver("bench") < 0) {
+		fprintf(stderr, "microbench: cannot load drivers/bench.so; "
+			"configure with the bench driver enabled\n");
+		return -1;
+	}
+
+	client = client_create(1000);
+	if (client == NULL)
+		return -1;
+	clients_add_client(client);
+	bench_parse(bench_screens);
+	return 0;
+}
+
+
+/* Run a benchmark long enough and print its result */
+static void
+bench_run(const Benchmark *b, long min_ns)
+{
+	long n = 1;
+
+	for (;;) {
+		struct timespec start, end;
+		long long elapsed;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		b->run(n);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		elapsed = (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+
+		if ((elapsed >= min_ns) || (n >= 1L << 30)) {
+			printf("%s\t%ld\t%.1f\n", b->name, n, (double) elapsed / n);
+			fflush(stdout);
+			return;
+		}
+		/* aim a bit past the minimum time */
+		if (elapsed * 100 < min_ns)
+			n *= 100;
+		else
+			n = (long) (n * 1.2 * min_ns / elapsed) + 1;
+	}
+}
+
+
+int
+main(int argc, char **argv)
+{
+	long min_ns = BENCH_DEFAULT_TIME * 1000000L;
+	int have_client = 0;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "t:")) > 0) {
+		switch (c) {
+			case 't':
+				min_ns = atol(optarg) * 1000000L;
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-t <milliseconds>] [<name>...]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	set_reporting("microbench", RPT_ERR, RPT_DEST_STDERR);
+	sock_set_send_func(bench_send);
+	fill_items();
+	memset(line_a, ' ', sizeof(line_a));
+	memcpy(line_b, line_a, sizeof(line_b));
+
+	printf("# benchmark\titerations\tns/iteration\n");
+	for (i = 0; benchmarks[i].name != NULL; i++) {
+		const Benchmark *b = &benchmarks[i];
+
+		if (optind < argc) {
+			int j;
+
+			for (j = optind; j < argc; j++) {
+				if (strncmp(b->name, argv[j], strlen(argv[j])) == 0)
+					break;
+			}
+			if (j == argc)
+				continue;
+		}
+		if (b->needs_client && !have_client) {
+			have_client = (bench_setup_client() == 0) ? 1 : -1;
+		}
+		if (b->needs_client && (have_client < 0)) {
+			printf("# %s skipped\n", b->name);
+			continue;
+		}
+		bench_run(b, min_ns);
+	}
+
+	if (have_client > 0)
+		drivers_unload_all();
+	return EXIT_SUCCESS;
+}
@@ -4,6 +4,11 @@
  *
  * It works much like a command line.  Only the first token is used to
  * determine what function to call.
+ *
+ * Clients that said "hello binary" send binary frames instead of lines,
+ * which need no quoting or escaping: a 2 byte length in network byte
+ * order, then the CommandId in one byte, then each argument as a length
+ * byte followed by its bytes.  The same command functions handle them.
  */
 
 /* This file is part of LCDd, the lcdproc server.
@@ -22,20 +27,32 @@
 #include "shared/LL.h"
 #include "shared/sockets.h"
 #include "shared/report.h"
+#include "shared/configfile.h"
 #include "clients.h"
 #include "commands/command_list.h"
 #include "parse.h"
 #include "sock.h"
+#include "stats.h"
+#include "profile.h"
+#include "flightrec.h"
+
+/* Enough for a widget_set_batch of a whole screen */
+#define MAX_ARGUMENTS 256
 
-#define MAX_ARGUMENTS 40
+/* Commands parsed per client and pass of parse_all_client_messages(), so
+ * that a client sending a flood of commands cannot starve the others;
+ * 0 parses everything at once. */
+#define DEFAULT_COMMAND_BUDGET	64
+static int command_budget = DEFAULT_COMMAND_BUDGET;
 
 
 static inline int is_whitespace(char x)	{
-	return ((x == ' ') || (x == '\t') || (x == '\r'));
+	return ((x == ' ') || (x == '\t'));
 }
 
+/* Messages arrive in blocks of lines: \r, \n and \0 all end a line */
 static inline int is_final(char x) {
-	return ((x == '\n') || (x == '\0'));
+	return ((x == '\n') || (x == '\r') || (x == '\0'));
 }
 
 static inline int is_opening_quote(char x, char q) {
@@ -47,7 +64,51 @@ static inline int is_closing_quote(char x, char q) {
 }
 
 
-static void parse_message(const char *str, Client *c)
+/**
+ * Call the function of a command and complain about errors.
+ * \param c     Client that sent the command.
+ * \param id    Identifier of the command.
+ * \param argc  Number of arguments.
+ * \param argv  The arguments; argv[0] is the command.
+ */
+static void parse_call(Client *c, CommandId id, int argc, char **argv)
+{
+	CommandFunc function = get_command_function_by_id(id);
+	ProfileSlot *prev;
+	int error;
+
+	c->commands++;
+	stats_client_replied(c);
+	if (function != NULL) {
+		prev = PROFILE_ENTER(profile_command(id));
+		error = function(c, argc, argv);
+		PROFILE_LEAVE(prev);
+		if (error) {
+			sock_printf_error(c->sock, "Function returned error \"%.40s\"\n", argv[0]);
+			report(RPT_WARNING, "Command function returned an error after command from client on socket %d: %.40s", c->sock, argv[0]);
+		}
+	}
+	else {
+		sock_printf_error(c->sock, "Invalid command \"%.40s\"\n", argv[0]);
+		report(RPT_WARNING, "Invalid command from client on socket %d: %.40s", c->sock, argv[0]);
+	}
+}
+
+
+/**
+ * Split the first line of a message block into arguments and call the
+ * command's function.
+ *
+ * The line is tokenized in place: The arguments are stored as NUL
+ * terminated strings one after another at the start of the line. As no
+ * argument is longer than the text it was parsed from, the write position
+ * never overtakes the read position.
+ *
+ * \param str  Start of the line; its contents are destroyed.
+ * \param c    Client that sent the message.
+ * \return  Start of the next line in the block, NULL at the end of the block.
+ */
+static char *parse_message(char *str, Client *c)
 {
 	typedef enum { ST_INITIAL, ST_WHITESPACE, ST_ARGUMENT, ST_FINAL } State;
 	State state = ST_INITIAL;
@@ -55,21 +116,19 @@ static void parse_message(const char *str, Client *c)
 	int error = 0;
 	char quote = '\0';	/* The quote used to open a quote string */
 	int pos = 0;
-	char arg_space[strlen(str)+1];
+	char ch = '\0';
+	char *next;
 	int argc = 0;
 	char *argv[MAX_ARGUMENTS];
 	int argpos = 0;
-	CommandFunc function = NULL;
 
 	debug(RPT_DEBUG, "%s(str=\"%.120s\", client=[%d])", __FUNCTION__, str, c->sock);
 
-	/* We will create a list of strings that is shorter or equally long as
-	 * the original string str.
-	 */
-	argv[0] = arg_space;
+	/* The list of strings replaces the original string str. */
+	argv[0] = str;
 
 	while ((state != ST_FINAL) && !error) {
-		char ch = str[pos++];
+		ch = str[pos++];
 
 		switch (state) {
 		  case ST_INITIAL:
@@ -98,7 +157,7 @@ static void parse_message(const char *str, Client *c)
 				state = ST_FINAL;
 			}
 			else if (ch == '\\') {
-			 	if (str[pos]) {
+			 	if (!is_final(str[pos])) {
 			 		/* We solve quoted chars here right away */
 					const char escape_chars[] = "nrt";
 					const char escape_trans[] = "\n\r\t";
@@ -161,7 +220,16 @@ static void parse_message(const char *str, Client *c)
 				state = ST_WHITESPACE;
 			}
 			else {
+				/* Copy the plain characters up to the next one that
+				 * means something at once; strcspn() looks at many
+				 * bytes at a time */
+				size_t run = strcspn(str + pos, (quote == '\0') ? " \t\n\r\\\"{"
+						     : (quote == '{') ? "\n\r\\}" : "\n\r\\\"");
+
 				argv[argc][argpos++] = ch;
+				memmove(argv[argc] + argpos, str + pos, run);
+				argpos += run;
+				pos += run;
 			}
 			break;
 		  case ST_FINAL:
@@ -174,49 +242,204 @@ static void parse_message(const char *str, Client *c)
 	else
 		error = 1;
 
+	/* After an error skip the rest of the line */
+	if (state != ST_FINAL) {
+		do {
+			ch = str[pos++];
+		} while (!is_final(ch));
+	}
+	next = (ch == '\0') ? NULL : str + pos;
+
 	if (error) {
 		sock_send_error(c->sock, "Could not parse command\n");
-		return;
+		return next;
 	}
 
-	/* Now find and call the appropriate function...*/
-	function = get_command_function(argv[0]);
+	/* Ignore empty lines */
+	if (argc == 0)
+		return next;
 
-	if (function != NULL) {
-		error = function(c, argc, argv);
-		if (error) {
-			sock_printf_error(c->sock, "Function returned error \"%.40s\"\n", argv[0]);
-			report(RPT_WARNING, "Command function returned an error after command from client on socket %d: %.40s", c->sock, str);
+	parse_call(c, get_command_id(argv[0]), argc, argv);
+	return next;
+}
+
+
+/**
+ * Decode a binary frame into arguments and call the command's function.
+ *
+ * The payload of a frame is the command's identifier in one byte, followed
+ * by the arguments, each a length byte and that many bytes. Like lines,
+ * the frame is decoded in place: each argument is moved over its length
+ * byte, which leaves room for its terminating NUL.
+ *
+ * \param frame  Start of the frame; its contents are destroyed.
+ * \param end    End of the block of frames.
+ * \param c      Client that sent the frame.
+ * \return  Start of the next frame in the block, NULL at the end of the block.
+ */
+static char *parse_frame(char *frame, char *end, Client *c)
+{
+	unsigned int len;
+	char *p;
+	char *next;
+	int argc = 1;
+	char *argv[MAX_ARGUMENTS];
+	CommandId id;
+
+	if (end - frame < 2)
+		return NULL;
+	len = ((unsigned char) frame[0] << 8) | (unsigned char) frame[1];
+	p = frame + 2;
+	next = p + len;
+	if (next > end) {
+		sock_send_error(c->sock, "Could not parse command\n");
+		return NULL;
+	}
+
+	/* Ignore empty frames */
+	if (len == 0)
+		return (next < end) ? next : NULL;
+
+	id = (CommandId) (unsigned char) *p++;
+	argv[0] = (char *) get_command_name(id);
+
+	while (p < next) {
+		unsigned int arglen = (unsigned char) *p;
+
+		if ((argc >= MAX_ARGUMENTS - 1) || (arglen >= (unsigned int) (next - p))) {
+			sock_send_error(c->sock, "Could not parse command\n");
+			return (next < end) ? next : NULL;
 		}
+		memmove(p, p + 1, arglen);
+		p[arglen] = '\0';
+		argv[argc++] = p;
+		p += arglen + 1;
 	}
-	else {
-		sock_printf_error(c->sock, "Invalid command \"%.40s\"\n", argv[0]);
-		report(RPT_WARNING, "Invalid command from client on socket %d: %.40s", c->sock, str);
+	argv[argc] = NULL;
+
+	if (argv[0] == NULL) {
+		sock_printf_error(c->sock, "Invalid command %d\n", (int) id);
+		report(RPT_WARNING, "Invalid command from client on socket %d: %d", c->sock, (int) id);
+		c->commands++;
 	}
+	else
+		parse_call(c, id, argc, argv);
+
+	return (next < end) ? next : NULL;
 }
 
 
-void
-parse_all_client_messages(void)
+/**
+ * Read the parser's settings from the configuration.
+ * \return  0 (always successful).
+ */
+int
+parse_init(void)
 {
-	Client *c;
+	command_budget = config_get_int("Server", "CommandBudget", 0, DEFAULT_COMMAND_BUDGET);
+	if (command_budget < 0) {
+		report(RPT_WARNING, "%s: CommandBudget must not be negative; using 0", __FUNCTION__);
+		command_budget = 0;
+	}
+	return 0;
+}
 
-	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	for (c = clients_getfirst(); c != NULL; c = clients_getnext()) {
-		char *str;
+/**
+ * Parse and execute the messages a client sent so far, at most
+ * CommandBudget commands of them.
+ * Stops early if the client leaves, or if it gets throttled because it
+ * does not read the replies. The unparsed rest stays in the client's queue.
+ * \param c  The client.
+ * \return  1 if the client's budget ran out before its queue, 0 if not.
+ */
+int
+parse_client_messages(Client *c)
+{
+	char *block;
+	unsigned long start = stats_clock();
+	int commands = 0;
+
+	/* send the replies all at once, by sock_client_parsed() */
+	sock_client_parsing(c);
+	while (!sock_client_throttled(c) && ((block = client_get_message(c)) != NULL)) {
+		char *line = block;
+		char *end = NULL;	/* end of the frames of a binary block */
+		int deflate = c->deflate;	/* block was inflated */
+
+		if (client_message_is_binary(block)) {
+			line = block + CLIENT_BINARY_HEADER;
+			end = line + client_binary_length(block);
+		}
 
-		/* And parse all its messages...*/
-		for (str = client_get_message(c); str != NULL; str = client_get_message(c)) {
-			parse_message(str, c);
-			free(str);
+		while (line != NULL) {
+			line = (end != NULL) ? parse_frame(line, end, c) : parse_message(line, c);
+			commands++;
+
+			if (c->state == GONE)
+				break;
 
-			if (c->state == GONE) {
-				sock_destroy_client_socket(c);
+			/* After "hello binary" or "hello deflate" the rest of
+			 * the lines are void */
+			if ((end == NULL) && (c->binary || (c->deflate != deflate)))
+				break;
+
+			if ((line != NULL) && ((end != NULL) || (*line != '\0'))
+			    && (sock_client_throttled(c)
+				|| ((command_budget > 0) && (commands >= command_budget)))) {
+				/* keep the rest for later, in the same buffer */
+				if (end != NULL) {
+					memmove(block + CLIENT_BINARY_HEADER, line, end - line);
+					client_binary_set_length(block, end - line);
+				}
+				else
+					memmove(block, line, strlen(line) + 1);
+				if (client_unget_message(c, block) == 0)
+					block = NULL;
 				break;
 			}
 		}
+		pool_free(c->pool, block);
+
+		if (c->state == GONE) {
+			/* its statistics go with it */
+			sock_destroy_client_socket(c);
+			return 0;
+		}
+		if ((command_budget > 0) && (commands >= command_budget))
+			break;
+	}
+
+	if (commands > 0) {
+		stats_histogram_add(&c->parse_time, stats_clock() - start);
+		flightrec_event(FLIGHT_COMMANDS, c->sock, commands);
 	}
+
+	/* send the replies, read from its socket again if the queue has gone down */
+	sock_client_parsed(c);
+
+	return ((c->queued > 0) && !sock_client_throttled(c)) ? 1 : 0;
 }
 
 
+/**
+ * Parse the messages of all clients, one budget of commands per client.
+ * \return  Number of clients with messages left for another pass.
+ */
+int
+parse_all_client_messages(void)
+{
+	Client *c;
+	Client *next;
+	int pending = 0;
+
+	debug(RPT_DEBUG, "%s()", __FUNCTION__);
+
+	for (c = clients_getfirst(); c != NULL; c = next) {
+		/* parsing may remove the client from the list */
+		next = clients_getnext(c);
+		/* And parse its messages...*/
+		pending += parse_client_messages(c);
+	}
+	return pending;
+}
@@ -12,7 +12,17 @@
 #ifndef PARSE_H
 #define PARSE_H
 
+#define INC_TYPES_ONLY 1
+#include "client.h"
+#undef INC_TYPES_ONLY
+
+/* Read the parser's settings */
+int parse_init(void);
+
 // This should be pretty self-explanatory...
-void parse_all_client_messages(void);
+int parse_all_client_messages(void);
+
+/* Parse the pending messages of one client, within its budget */
+int parse_client_messages(Client *c);
 
 #endif
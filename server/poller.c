@@ -0,0 +1,421 @@
+/** \file server/poller.c
+ * This file contains the readiness notification used by the socket code.
+ * Instead of handing the full set of sockets to select() on every pass and
+ * then testing every socket, the sockets are registered once and the poller
+ * returns only those with input pending.
+ *
+ * One of three backends is selected at compile time:
+ * \li epoll on Linux,
+ * \li kqueue on the BSDs and Darwin,
+ * \li poll() everywhere else.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CTL)
+# define USE_EPOLL
+# include <sys/epoll.h>
+#elif defined(HAVE_SYS_EVENT_H) && defined(HAVE_KQUEUE)
+# define USE_KQUEUE
+# include <sys/types.h>
+# include <sys/event.h>
+# include <sys/time.h>
+#else
+# include <poll.h>
+#endif
+
+#include "shared/report.h"
+
+#include "poller.h"
+
+
+#if defined(USE_EPOLL)
+/****************************************************************************/
+/* epoll backend */
+
+static int epoll_fd = -1;
+static struct epoll_event *events = NULL;
+static int max_events = 0;
+
+int
+poller_init(int max_fds)
+{
+#ifdef HAVE_EPOLL_CREATE1
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+#else
+	epoll_fd = epoll_create(max_fds);
+#endif
+	if (epoll_fd < 0) {
+		report(RPT_ERR, "%s: cannot create epoll instance - %s",
+			__FUNCTION__, strerror(errno));
+		return -1;
+	}
+
+	events = calloc(max_fds, sizeof(struct epoll_event));
+	if (events == NULL) {
+		report(RPT_ERR, "%s: Error allocating poll events.", __FUNCTION__);
+		close(epoll_fd);
+		epoll_fd = -1;
+		return -1;
+	}
+	max_events = max_fds;
+	return 0;
+}
+
+
+void
+poller_shutdown(void)
+{
+	if (epoll_fd >= 0)
+		close(epoll_fd);
+	epoll_fd = -1;
+	free(events);
+	events = NULL;
+	max_events = 0;
+}
+
+
+int
+poller_add(int fd, void *data)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = data;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		report(RPT_ERR, "%s: cannot watch socket %d - %s",
+			__FUNCTION__, fd, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+
+int
+poller_modify(int fd, void *data, int mask)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = ((mask & POLLER_IN) ? EPOLLIN : 0)
+		  | ((mask & POLLER_OUT) ? EPOLLOUT : 0);
+	ev.data.ptr = data;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+		report(RPT_ERR, "%s: cannot change events of socket %d - %s",
+			__FUNCTION__, fd, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+
+int
+poller_remove(int fd)
+{
+	/* kernels before 2.6.9 require a non-NULL event */
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &ev) < 0)
+		return -1;
+	return 0;
+}
+
+
+int
+poller_wait(void **ready, int max_ready, int timeout)
+{
+	int n, i;
+
+	n = epoll_wait(epoll_fd, events, (max_ready < max_events) ? max_ready : max_events, timeout);
+	if (n < 0) {
+		if (errno == EINTR)
+			return 0;
+		report(RPT_ERR, "%s: epoll error - %s", __FUNCTION__, strerror(errno));
+		return -1;
+	}
+	for (i = 0; i < n; i++)
+		ready[i] = events[i].data.ptr;
+	return n;
+}
+
+
+const char *
+poller_backend(void)
+{
+	return "epoll";
+}
+
+
+#elif defined(USE_KQUEUE)
+/****************************************************************************/
+/* kqueue backend */
+
+/* NetBSD before 10.0 declares udata as intptr_t */
+#if defined(__NetBSD__)
+# define KEV_UDATA(p)	((intptr_t) (p))
+#else
+# define KEV_UDATA(p)	((void *) (p))
+#endif
+
+static int kqueue_fd = -1;
+static struct kevent *events = NULL;
+static int max_events = 0;
+
+int
+poller_init(int max_fds)
+{
+	kqueue_fd = kqueue();
+	if (kqueue_fd < 0) {
+		report(RPT_ERR, "%s: cannot create kqueue - %s",
+			__FUNCTION__, strerror(errno));
+		return -1;
+	}
+
+	events = calloc(max_fds, sizeof(struct kevent));
+	if (events == NULL) {
+		report(RPT_ERR, "%s: Error allocating poll events.", __FUNCTION__);
+		close(kqueue_fd);
+		kqueue_fd = -1;
+		return -1;
+	}
+	max_events = max_fds;
+	return 0;
+}
+
+
+void
+poller_shutdown(void)
+{
+	if (kqueue_fd >= 0)
+		close(kqueue_fd);
+	kqueue_fd = -1;
+	free(events);
+	events = NULL;
+	max_events = 0;
+}
+
+
+int
+poller_add(int fd, void *data)
+{
+	struct kevent kev;
+
+	EV_SET(&kev, fd, EVFILT_READ, EV_ADD, 0, 0, KEV_UDATA(data));
+	if (kevent(kqueue_fd, &kev, 1, NULL, 0, NULL) < 0) {
+		report(RPT_ERR, "%s: cannot watch socket %d - %s",
+			__FUNCTION__, fd, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+
+int
+poller_modify(int fd, void *data, int mask)
+{
+	struct kevent kev[2];
+
+	/* EV_DISABLE keeps the filter registered, so poller_remove()
+	 * always finds both filters to delete */
+	EV_SET(&kev[0], fd, EVFILT_READ,
+	       (mask & POLLER_IN) ? (EV_ADD | EV_ENABLE) : (EV_ADD | EV_DISABLE),
+	       0, 0, KEV_UDATA(data));
+	EV_SET(&kev[1], fd, EVFILT_WRITE,
+	       (mask & POLLER_OUT) ? (EV_ADD | EV_ENABLE) : (EV_ADD | EV_DISABLE),
+	       0, 0, KEV_UDATA(data));
+	if (kevent(kqueue_fd, kev, 2, NULL, 0, NULL) < 0) {
+		report(RPT_ERR, "%s: cannot change events of socket %d - %s",
+			__FUNCTION__, fd, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+
+int
+poller_remove(int fd)
+{
+	struct kevent kev[2];
+
+	/* deleting a filter that was never added fails with ENOENT;
+	 * the read filter is processed first, so that does no harm */
+	EV_SET(&kev[0], fd, EVFILT_READ, EV_DELETE, 0, 0, KEV_UDATA(NULL));
+	EV_SET(&kev[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, KEV_UDATA(NULL));
+	if (kevent(kqueue_fd, kev, 2, NULL, 0, NULL) < 0)
+		return -1;
+	return 0;
+}
+
+
+int
+poller_wait(void **ready, int max_ready, int timeout)
+{
+	struct timespec ts;
+	int n, i, count;
+
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000;
+
+	n = kevent(kqueue_fd, NULL, 0, events,
+		   (max_ready < max_events) ? max_ready : max_events,
+		   (timeout < 0) ? NULL : &ts);
+	if (n < 0) {
+		if (errno == EINTR)
+			return 0;
+		report(RPT_ERR, "%s: kqueue error - %s", __FUNCTION__, strerror(errno));
+		return -1;
+	}
+	/* a socket may be reported by both filters: only hand it out once */
+	count = 0;
+	for (i = 0; i < n; i++) {
+		void *data = (void *) events[i].udata;
+		int j;
+
+		for (j = 0; (j < count) && (ready[j] != data); j++)
+			;
+		if (j == count)
+			ready[count++] = data;
+	}
+	return count;
+}
+
+
+const char *
+poller_backend(void)
+{
+	return "kqueue";
+}
+
+
+#else
+/****************************************************************************/
+/* poll() backend */
+
+static struct pollfd *pollfds = NULL;
+static void **polldata = NULL;
+static int nfds = 0;
+static int max_events = 0;
+
+int
+poller_init(int max_fds)
+{
+	pollfds = calloc(max_fds, sizeof(struct pollfd));
+	polldata = calloc(max_fds, sizeof(void *));
+	if ((pollfds == NULL) || (polldata == NULL)) {
+		report(RPT_ERR, "%s: Error allocating poll descriptors.", __FUNCTION__);
+		poller_shutdown();
+		return -1;
+	}
+	nfds = 0;
+	max_events = max_fds;
+	return 0;
+}
+
+
+void
+poller_shutdown(void)
+{
+	free(pollfds);
+	pollfds = NULL;
+	free(polldata);
+	polldata = NULL;
+	nfds = 0;
+	max_events = 0;
+}
+
+
+int
+poller_add(int fd, void *data)
+{
+	if (nfds >= max_events) {
+		report(RPT_ERR, "%s: cannot watch socket %d - too many sockets",
+			__FUNCTION__, fd);
+		return -1;
+	}
+	pollfds[nfds].fd = fd;
+	pollfds[nfds].events = POLLIN;
+	pollfds[nfds].revents = 0;
+	polldata[nfds] = data;
+	nfds++;
+	return 0;
+}
+
+
+int
+poller_modify(int fd, void *data, int mask)
+{
+	int i;
+
+	for (i = 0; i < nfds; i++) {
+		if (pollfds[i].fd == fd) {
+			pollfds[i].events = ((mask & POLLER_IN) ? POLLIN : 0)
+					  | ((mask & POLLER_OUT) ? POLLOUT : 0);
+			polldata[i] = data;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+
+int
+poller_remove(int fd)
+{
+	int i;
+
+	for (i = 0; i < nfds; i++) {
+		if (pollfds[i].fd == fd) {
+			/* order does not matter: fill the gap with the last entry */
+			nfds--;
+			pollfds[i] = pollfds[nfds];
+			polldata[i] = polldata[nfds];
+			return 0;
+		}
+	}
+	return -1;
+}
+
+
+int
+poller_wait(void **ready, int max_ready, int timeout)
+{
+	int n, i;
+	int count = 0;
+
+	n = poll(pollfds, nfds, timeout);
+	if (n < 0) {
+		if (errno == EINTR)
+			return 0;
+		report(RPT_ERR, "%s: poll error - %s", __FUNCTION__, strerror(errno));
+		return -1;
+	}
+	for (i = 0; (i < nfds) && (count < n) && (count < max_ready); i++) {
+		if (pollfds[i].revents != 0)
+			ready[count++] = polldata[i];
+	}
+	return count;
+}
+
+
+const char *
+poller_backend(void)
+{
+	return "poll";
+}
+
+#endif
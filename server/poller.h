@@ -0,0 +1,41 @@
+/** \file server/poller.h
+ * Interface to the socket readiness notification used by the socket code.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef POLLER_H
+#define POLLER_H
+
+/* Events a descriptor can be watched for */
+#define POLLER_IN	1	/**< Input available */
+#define POLLER_OUT	2	/**< Output possible */
+
+/* Initialize the poller for up to max_fds descriptors. */
+int poller_init(int max_fds);
+
+/* Release all resources held by the poller. */
+void poller_shutdown(void);
+
+/* Watch a descriptor for input, data is handed back when it is ready.
+ * A descriptor watched for multiple events is reported only once. */
+int poller_add(int fd, void *data);
+
+/* Change the events (POLLER_IN / POLLER_OUT) a descriptor is watched for. */
+int poller_modify(int fd, void *data, int mask);
+
+/* Stop watching a descriptor. */
+int poller_remove(int fd);
+
+/* Wait up to timeout milliseconds (<0: forever) for ready descriptors.
+ * Stores at most max_ready data pointers in ready and returns their number. */
+int poller_wait(void **ready, int max_ready, int timeout);
+
+/* Name of the backend compiled in. */
+const char *poller_backend(void);
+
+#endif
@@ -0,0 +1,328 @@
+/** \file server/profile.c
+ * This file contains the server's accounting of CPU time by subsystem:
+ * polling the sockets, parsing client messages, each command, choosing the
+ * screen, rendering, each type of widget and flushing each driver. It
+ * tells where the server spends its time on systems where no profiler can
+ * be run.
+ *
+ * The main thread is always in one slot. PROFILE_ENTER() charges the CPU
+ * time of the thread since the last switch to the current slot and makes
+ * another one current, PROFILE_LEAVE() goes back to the slot left, so a
+ * slot counts the time spent in it without the slots entered from it: the
+ * time of parsing does not include that of the commands parsed. Drivers
+ * with a flush thread are accounted the CPU time of that thread. With
+ * IOThread set, the I/O thread accounts its polling and parsing, commands
+ * included, to the poll and parse slots; PROFILE_ENTER() on it does
+ * nothing.
+ *
+ * Accounting is off unless \c Profile is set in the configuration; then
+ * every switch costs a read of the thread's CPU clock. The totals are
+ * reported by the \c stats command and on SIGUSR1.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "shared/report.h"
+#include "shared/sockets.h"
+
+#include "main.h"
+#include "stats.h"
+#include "profile.h"
+
+/** Number of widget types, WID_GRAPH being the last */
+#define PROFILE_WIDGET_TYPES	(WID_GRAPH + 1)
+
+/** CPU time of a driver, by name, so it survives reloading the driver */
+typedef struct ProfileDriver {
+	char name[40];
+	ProfileSlot slot;
+} ProfileDriver;
+
+static const char *subsystem_names[PROFILE_SUBSYSTEMS] = {
+	"other", "poll", "parse", "screenlist", "render"
+};
+
+int profile_enabled = 0;
+
+static ProfileSlot subsystems[PROFILE_SUBSYSTEMS];
+static ProfileSlot commands[NUM_COMMANDS];
+static ProfileSlot widgets[PROFILE_WIDGET_TYPES];
+static ProfileDriver drivers[MAX_DRIVERS];
+/* Flush threads look up their drivers too */
+static pthread_mutex_t drivers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static ProfileSlot *current = NULL;	/**< Slot being accounted, NULL: other */
+static unsigned long long last_switch;	/**< CPU time at the last switch */
+static pthread_t main_thread;		/**< The thread being accounted */
+
+
+/**
+ * Get the CPU time of the calling thread.
+ * \return  Time in nanoseconds.
+ */
+unsigned long long
+profile_thread_time(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+		return 0;
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/**
+ * Start accounting CPU time. All time of the main thread before was spent
+ * starting up and is not accounted.
+ * \return  -1 if the CPU time can not be measured, 0 on success.
+ */
+int
+profile_init(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0) {
+		report(RPT_WARNING, "CPU time of threads can not be measured, no profiling");
+		return -1;
+	}
+	last_switch = profile_thread_time();
+	current = NULL;
+	main_thread = pthread_self();
+	profile_enabled = 1;
+	report(RPT_INFO, "Accounting CPU time by subsystem");
+	return 0;
+}
+
+
+/* Charge the CPU time since the last switch to the current slot */
+static void
+profile_charge(void)
+{
+	unsigned long long now = profile_thread_time();
+
+	if (current != NULL)
+		current->nsec += now - last_switch;
+	else
+		subsystems[PROFILE_OTHER].nsec += now - last_switch;
+	last_switch = now;
+}
+
+
+/**
+ * Charge the CPU time of the main thread up to now and account the
+ * following time to another slot. Use PROFILE_ENTER() rather than calling
+ * this directly.
+ * \param slot  The slot to account to, NULL for other.
+ * \return  The slot left, to be passed to profile_leave().
+ */
+ProfileSlot *
+profile_enter(ProfileSlot *slot)
+{
+	ProfileSlot *prev = current;
+
+	if (!pthread_equal(pthread_self(), main_thread))
+		return NULL;
+	profile_charge();
+	current = slot;
+	if (slot != NULL)
+		slot->calls++;
+	return prev;
+}
+
+
+/**
+ * Charge the CPU time of the main thread up to now and go back to the
+ * slot that profile_enter() left. Use PROFILE_LEAVE() rather than calling
+ * this directly.
+ * \param prev  The slot profile_enter() returned.
+ */
+void
+profile_leave(ProfileSlot *prev)
+{
+	if (!pthread_equal(pthread_self(), main_thread))
+		return;
+	profile_charge();
+	current = prev;
+}
+
+
+/**
+ * Add the CPU time of a thread other than the main thread to a slot. A
+ * slot must be added to by one thread only.
+ * \param slot  The slot, NULL to do nothing.
+ * \param nsec  CPU time in nanoseconds.
+ */
+void
+profile_add(ProfileSlot *slot, unsigned long long nsec)
+{
+	if (slot != NULL) {
+		slot->nsec += nsec;
+		slot->calls++;
+	}
+}
+
+
+/**
+ * Get the slot of a subsystem.
+ * \param id  The subsystem.
+ * \return  The slot.
+ */
+ProfileSlot *
+profile_subsystem(ProfileSubsystem id)
+{
+	return &subsystems[id];
+}
+
+
+/**
+ * Get the slot of a command; it counts the time of the command's function.
+ * \param id  The command.
+ * \return  The slot, NULL for an invalid command.
+ */
+ProfileSlot *
+profile_command(CommandId id)
+{
+	if ((id < 0) || (id >= NUM_COMMANDS))
+		return NULL;
+	return &commands[id];
+}
+
+
+/**
+ * Get the slot of a widget type; it counts the time of rendering widgets
+ * of the type, without their drivers.
+ * \param type  The widget type.
+ * \return  The slot, NULL for an invalid type.
+ */
+ProfileSlot *
+profile_widget(WidgetType type)
+{
+	if ((type < 0) || (type >= PROFILE_WIDGET_TYPES))
+		return NULL;
+	return &widgets[type];
+}
+
+
+/**
+ * Get the slot of a driver; it counts the time of the driver taking a
+ * frame and flushing it.
+ * \param drv  The driver.
+ * \return  The slot, NULL if there are too many drivers.
+ */
+ProfileSlot *
+profile_driver(Driver *drv)
+{
+	ProfileSlot *slot = NULL;
+	int i;
+
+	pthread_mutex_lock(&drivers_lock);
+	for (i = 0; i < MAX_DRIVERS; i++) {
+		if (drivers[i].name[0] == '\0')
+			strncpy(drivers[i].name, drv->name, sizeof(drivers[i].name) - 1);
+		if (strcmp(drivers[i].name, drv->name) == 0) {
+			slot = &drivers[i].slot;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&drivers_lock);
+	return slot;
+}
+
+
+/* Call a function for every slot that was entered, with its kind and name */
+static void
+profile_foreach(void (*func)(const char *kind, const char *name, const ProfileSlot *slot, void *data),
+		void *data)
+{
+	int i;
+
+	/* the time up to now */
+	profile_charge();
+
+	for (i = 0; i < PROFILE_SUBSYSTEMS; i++)
+		func(subsystem_names[i], NULL, &subsystems[i], data);
+	for (i = 0; i < NUM_COMMANDS; i++) {
+		if (commands[i].calls > 0)
+			func("command", get_command_name(i), &commands[i], data);
+	}
+	for (i = 0; i < PROFILE_WIDGET_TYPES; i++) {
+		if (widgets[i].calls > 0)
+			func("widget", widget_type_to_typename(i), &widgets[i], data);
+	}
+	pthread_mutex_lock(&drivers_lock);
+	for (i = 0; (i < MAX_DRIVERS) && (drivers[i].name[0] != '\0'); i++)
+		func("flush", drivers[i].name, &drivers[i].slot, data);
+	pthread_mutex_unlock(&drivers_lock);
+}
+
+
+/* Average CPU time per frame in microseconds */
+static double
+profile_per_frame(const ProfileSlot *slot)
+{
+	unsigned long frames = server_stats.frames_rendered;
+
+	return (frames > 0) ? slot->nsec / 1000.0 / frames : 0.0;
+}
+
+
+static void
+profile_send_slot(const char *kind, const char *name, const ProfileSlot *slot, void *data)
+{
+	int sock = *(int *) data;
+
+	sock_printf(sock, "stats cpu %s%s%s nsec %llu calls %lu frame_usec %.1f\n",
+		    kind, (name != NULL) ? " " : "", (name != NULL) ? name : "",
+		    slot->nsec, slot->calls, profile_per_frame(slot));
+}
+
+
+/**
+ * Send the CPU times to a client, in reply to the \c stats command. Nothing
+ * is sent if no CPU time is accounted.
+ * \param sock  The client's socket.
+ */
+void
+profile_send(int sock)
+{
+	if (profile_enabled)
+		profile_foreach(profile_send_slot, &sock);
+}
+
+
+static void
+profile_report_slot(const char *kind, const char *name, const ProfileSlot *slot, void *data)
+{
+	report(RPT_NOTICE, "CPU %s%s%s: %llu us in %lu calls, %.1f us per frame",
+	       kind, (name != NULL) ? " " : "", (name != NULL) ? name : "",
+	       slot->nsec / 1000, slot->calls, profile_per_frame(slot));
+}
+
+
+/**
+ * Report the CPU times, e.g. on SIGUSR1.
+ */
+void
+profile_report(void)
+{
+	if (!profile_enabled) {
+		report(RPT_NOTICE, "CPU time is not accounted, set Profile=yes");
+		return;
+	}
+	report(RPT_NOTICE, "CPU time by subsystem over %lu frames:", server_stats.frames_rendered);
+	profile_foreach(profile_report_slot, NULL);
+}
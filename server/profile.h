@@ -0,0 +1,71 @@
+/** \file server/profile.h
+ * Interface to the server's accounting of CPU time by subsystem.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "drivers/lcd.h"
+#include "widget.h"
+#include "commands/command_list.h"
+
+/** CPU time spent in a part of the server */
+typedef struct ProfileSlot {
+	unsigned long long nsec;	/**< CPU time in nanoseconds */
+	unsigned long calls;		/**< Times it was entered */
+} ProfileSlot;
+
+/** Subsystems of the main loop */
+typedef enum {
+	PROFILE_OTHER = 0,	/**< The main loop itself and all not accounted elsewhere */
+	PROFILE_POLL,		/**< Polling the sockets of clients */
+	PROFILE_PARSE,		/**< Parsing client messages, without the commands */
+	PROFILE_SCREENLIST,	/**< Choosing the screen to show */
+	PROFILE_RENDER,		/**< Rendering a frame, without widgets and drivers */
+	PROFILE_SUBSYSTEMS	/**< Number of subsystems */
+} ProfileSubsystem;
+
+/** Non-zero while CPU time is accounted */
+extern int profile_enabled;
+
+/* Start accounting CPU time. */
+int profile_init(void);
+
+/* Charge the CPU time up to now and continue in another slot. */
+ProfileSlot *profile_enter(ProfileSlot *slot);
+void profile_leave(ProfileSlot *prev);
+
+/* Add CPU time measured on another thread to a slot. */
+void profile_add(ProfileSlot *slot, unsigned long long nsec);
+
+/* CPU time of the current thread in nanoseconds. */
+unsigned long long profile_thread_time(void);
+
+/* The slots of subsystems, commands, widget types and drivers. */
+ProfileSlot *profile_subsystem(ProfileSubsystem id);
+ProfileSlot *profile_command(CommandId id);
+ProfileSlot *profile_widget(WidgetType type);
+ProfileSlot *profile_driver(Driver *drv);
+
+/* Send the CPU times to a client in reply to the stats command. */
+void profile_send(int sock);
+
+/* Report the CPU times, e.g. on SIGUSR1. */
+void profile_report(void);
+
+/**
+ * Charge the time up to now to the current slot and account the following
+ * time to another one, until PROFILE_LEAVE(). The slot expression is only
+ * evaluated while profiling.
+ */
+#define PROFILE_ENTER(slot)	(profile_enabled ? profile_enter(slot) : NULL)
+/** Charge the time since PROFILE_ENTER() and go back to the slot it left */
+#define PROFILE_LEAVE(prev)	do { if (profile_enabled) profile_leave(prev); } while (0)
+
+#endif
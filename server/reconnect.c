@@ -0,0 +1,349 @@
+/** \file server/reconnect.c
+ * This file contains the supervisor that brings back drivers whose device
+ * went away, e.g. a USB display that was unplugged.
+ *
+ * A driver tells the server by calling lost_device() from any of its
+ * functions. From then on the driver is offline: the server no longer calls
+ * it, and once the call that noticed the loss has returned, a thread of its
+ * own closes the driver and calls its init function again every
+ * ReconnectInterval seconds, until the device is back. Rendering for the
+ * other displays goes on meanwhile. When the driver is online again, the
+ * next frame is sent to the displays in full, which also sends the custom
+ * characters it needs again.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_LIBPTHREAD)
+# define USE_THREADS
+# include <pthread.h>
+# include <signal.h>
+# include <sys/time.h>
+#endif
+
+#include "shared/report.h"
+#include "shared/configfile.h"
+
+#include "reconnect.h"
+#include "driver.h"
+#include "drvthread.h"
+#include "stats.h"
+
+/** Time between two attempts to initialize a driver again, in seconds */
+#define DEFAULT_RECONNECT_INTERVAL	2
+
+/** States of a driver */
+typedef enum {
+	DRV_ONLINE = 0,		/**< The driver may be used */
+	DRV_LOST,		/**< The device is gone, no attempt started yet */
+	DRV_RETRYING		/**< A thread is trying to initialize it again */
+} DriverState;
+
+
+#ifdef USE_THREADS
+
+/** A driver that lost its device */
+typedef struct LostDriver {
+	Driver *drv;
+	DriverState state;
+	int running;			/**< A thread is working on it */
+	int stop;			/**< Give up, the driver is unloaded */
+	struct LostDriver *next;
+} LostDriver;
+
+static LostDriver *lost_drivers = NULL;	/**< Drivers not online */
+static int reconnected = 0;		/**< Drivers back since the last poll */
+static int any_lost = 0;		/**< Quick check: lost_drivers != NULL */
+
+/** Protects all of the above */
+static pthread_mutex_t lost_lock = PTHREAD_MUTEX_INITIALIZER;
+/** Signals stop to the threads, and their end back */
+static pthread_cond_t lost_cond = PTHREAD_COND_INITIALIZER;
+
+
+/* Find a driver in the list. Called with lost_lock held. */
+static LostDriver *
+reconnect_find(Driver *drv)
+{
+	LostDriver *ld;
+
+	for (ld = lost_drivers; ld != NULL; ld = ld->next) {
+		if (ld->drv == drv)
+			return ld;
+	}
+	return NULL;
+}
+
+
+/* Remove a driver from the list and free it. Called with lost_lock held. */
+static void
+reconnect_remove(LostDriver *ld)
+{
+	LostDriver **p;
+
+	for (p = &lost_drivers; *p != ld; p = &(*p)->next)
+		;
+	*p = ld->next;
+	any_lost = (lost_drivers != NULL);
+	free(ld);
+}
+
+
+/* Main function of a reconnect thread */
+static void *
+reconnect_main(void *arg)
+{
+	LostDriver *ld = arg;
+	Driver *drv = ld->drv;
+	int interval = config_get_float("Server", "ReconnectInterval", 0,
+					DEFAULT_RECONNECT_INTERVAL) * 1000000;
+	struct timeval now;
+	struct timespec due;
+	int res = -1;
+
+	if (interval < 100000)
+		interval = 100000;
+
+	pthread_mutex_lock(&lost_lock);
+	while (!ld->stop) {
+		/* wait a moment, the device may still be going away */
+		gettimeofday(&now, NULL);
+		due.tv_sec = now.tv_sec + (now.tv_usec + interval) / 1000000;
+		due.tv_nsec = ((now.tv_usec + interval) % 1000000) * 1000;
+		while (!ld->stop) {
+			if (pthread_cond_timedwait(&lost_cond, &lost_lock, &due) == ETIMEDOUT)
+				break;
+		}
+		if (ld->stop)
+			break;
+		pthread_mutex_unlock(&lost_lock);
+
+		/* the driver's own flush thread must keep off meanwhile */
+		drvthread_lock(drv);
+		res = driver_reinit(drv);
+		if (res >= 0)
+			stats_driver_reconnected(drv);
+		drvthread_unlock(drv);
+
+		pthread_mutex_lock(&lost_lock);
+		/* lost again while being initialized: keep trying */
+		if (ld->state == DRV_LOST)
+			ld->state = DRV_RETRYING;
+		else if (res >= 0)
+			break;
+	}
+
+	if (ld->stop) {
+		/* reconnect_stop() frees it */
+		ld->running = 0;
+		pthread_cond_broadcast(&lost_cond);
+	}
+	else {
+		report(RPT_NOTICE, "Driver [%.40s] is back online", drv->name);
+		reconnected++;
+		reconnect_remove(ld);
+	}
+	pthread_mutex_unlock(&lost_lock);
+	return NULL;
+}
+
+
+/**
+ * Take a driver offline because its device is gone; drivers call this as
+ * lost_device(). May be called from any thread, also from within the
+ * driver's functions.
+ * \param drv  The driver.
+ */
+void
+reconnect_lost(Driver *drv)
+{
+	LostDriver *ld;
+
+	pthread_mutex_lock(&lost_lock);
+	ld = reconnect_find(drv);
+	if (ld == NULL) {
+		ld = calloc(1, sizeof(LostDriver));
+		if (ld == NULL) {
+			pthread_mutex_unlock(&lost_lock);
+			report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+			return;
+		}
+		ld->drv = drv;
+		ld->state = DRV_LOST;
+		ld->next = lost_drivers;
+		lost_drivers = ld;
+		any_lost = 1;
+		report(RPT_WARNING, "Driver [%.40s] lost its device, going offline", drv->name);
+	}
+	else if (ld->state == DRV_RETRYING) {
+		ld->state = DRV_LOST;
+	}
+	pthread_mutex_unlock(&lost_lock);
+}
+
+
+/**
+ * Tell whether a driver may be used.
+ * \param drv  The driver.
+ * \return  1 if it is online, 0 while its device is gone.
+ */
+int
+reconnect_online(Driver *drv)
+{
+	int online;
+
+	/* usually no driver is lost at all */
+	if (!any_lost)
+		return 1;
+
+	pthread_mutex_lock(&lost_lock);
+	online = (reconnect_find(drv) == NULL);
+	pthread_mutex_unlock(&lost_lock);
+	return online;
+}
+
+
+/**
+ * Start trying to bring back a driver that lost its device. This has to be
+ * called by the thread using the driver, after the driver's function that
+ * noticed the loss has returned.
+ * \param drv  The driver.
+ */
+void
+reconnect_check(Driver *drv)
+{
+	LostDriver *ld;
+	pthread_t thread;
+	sigset_t all, old;
+	int err;
+
+	if (!any_lost)
+		return;
+
+	pthread_mutex_lock(&lost_lock);
+	ld = reconnect_find(drv);
+	if ((ld != NULL) && !ld->running) {
+		ld->state = DRV_RETRYING;
+		ld->running = 1;
+
+		/* signals are handled by the main thread only */
+		sigfillset(&all);
+		pthread_sigmask(SIG_SETMASK, &all, &old);
+		err = pthread_create(&thread, NULL, reconnect_main, ld);
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+		if (err != 0) {
+			report(RPT_ERR, "%s: cannot create reconnect thread for driver [%.40s] - %s",
+			       __FUNCTION__, drv->name, strerror(err));
+			ld->running = 0;
+		}
+		else
+			pthread_detach(thread);
+	}
+	pthread_mutex_unlock(&lost_lock);
+}
+
+
+/**
+ * Tell the main loop whether drivers came back since the last call; their
+ * displays need the next frame in full.
+ * \return  1 if any driver is online again, 0 otherwise.
+ */
+int
+reconnect_poll(void)
+{
+	int res;
+
+	pthread_mutex_lock(&lost_lock);
+	res = (reconnected > 0);
+	reconnected = 0;
+	pthread_mutex_unlock(&lost_lock);
+	return res;
+}
+
+
+/**
+ * Stop trying to bring back a driver because it is unloaded. Waits until
+ * a running attempt to initialize the driver has returned.
+ * \param drv  The driver.
+ */
+void
+reconnect_stop(Driver *drv)
+{
+	LostDriver *ld;
+
+	pthread_mutex_lock(&lost_lock);
+	ld = reconnect_find(drv);
+	if (ld != NULL) {
+		ld->stop = 1;
+		pthread_cond_broadcast(&lost_cond);
+		while (ld->running)
+			pthread_cond_wait(&lost_cond, &lost_lock);
+		reconnect_remove(ld);
+	}
+	pthread_mutex_unlock(&lost_lock);
+}
+
+
+#else
+/****************************************************************************/
+/* Without thread support a lost driver stays offline until LCDd reloads */
+
+static Driver *lost_drivers[MAX_LOST_DRIVERS];
+
+void
+reconnect_lost(Driver *drv)
+{
+	int i;
+
+	for (i = 0; i < MAX_LOST_DRIVERS; i++) {
+		if (lost_drivers[i] == drv)
+			return;
+	}
+	for (i = 0; i < MAX_LOST_DRIVERS; i++) {
+		if (lost_drivers[i] == NULL) {
+			lost_drivers[i] = drv;
+			report(RPT_WARNING, "Driver [%.40s] lost its device, going offline", drv->name);
+			return;
+		}
+	}
+}
+
+int
+reconnect_online(Driver *drv)
+{
+	int i;
+
+	for (i = 0; i < MAX_LOST_DRIVERS; i++) {
+		if (lost_drivers[i] == drv)
+			return 0;
+	}
+	return 1;
+}
+
+void reconnect_check(Driver *drv) { }
+int reconnect_poll(void) { return 0; }
+
+void
+reconnect_stop(Driver *drv)
+{
+	int i;
+
+	for (i = 0; i < MAX_LOST_DRIVERS; i++) {
+		if (lost_drivers[i] == drv)
+			lost_drivers[i] = NULL;
+	}
+}
+
+#endif
@@ -0,0 +1,37 @@
+/** \file server/reconnect.h
+ * Interface to the supervisor that brings back drivers whose device went
+ * away.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef RECONNECT_H
+#define RECONNECT_H
+
+#include "drivers/lcd.h"
+#include "main.h"
+
+/** Most drivers that can be offline at once without thread support */
+#define MAX_LOST_DRIVERS	MAX_DRIVERS
+
+/* Take a driver offline because its device is gone. */
+void reconnect_lost(Driver *drv);
+
+/* Tell whether a driver may be used. */
+int reconnect_online(Driver *drv);
+
+/* Start bringing back a driver that went offline; called by whoever
+ * uses the driver, after the driver function that lost it returned. */
+void reconnect_check(Driver *drv);
+
+/* Tell whether drivers came back since the last call. */
+int reconnect_poll(void);
+
+/* Stop bringing back a driver because it is unloaded. */
+void reconnect_stop(Driver *drv);
+
+#endif
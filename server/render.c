@@ -2,7 +2,17 @@
  * This file contains code that actually generates the full screen data to
  * send to the LCD. render_screen() takes a screen definition and calls
  * render_frame() which in turn builds the screen according to the definition.
- * It may recursively call itself (for nested frames).
+ *
+ * Nested frames are flattened into a display list kept with the screen
+ * (see render_list_update()): every widget with the clipping rectangle of
+ * the frame it is in. The list only changes with the layout, so rendering
+ * a frame is a single loop, however deeply the frames are nested.
+ *
+ * The widgets that scroll with a scrolling frame are drawn offscreen, all
+ * rows of the frame's contents at once, and drawn again only when one of
+ * them changes. Every tick copies the rows in view out of that buffer
+ * (see render_cache_update()), so a long list scrolls at the cost of the
+ * rows shown rather than that of all its widgets.
  *
  * This needs to be greatly expanded and redone for greater flexibility.
  * For example, it should support multiple screen sizes, more flexible
@@ -38,7 +48,7 @@
 #include <stdlib.h>
 
 #include "shared/report.h"
-#include "shared/LL.h"
+#include "shared/vector.h"
 #include "shared/defines.h"
 
 #include "drivers.h"
@@ -46,9 +56,55 @@
 #include "screenlist.h"
 #include "widget.h"
 #include "render.h"
+#include "profile.h"
 
 #define BUFSIZE 1024	/* larger than display width => large enough */
 
+/** Ticks render_screen_idle_ticks() looks ahead */
+#define RENDER_LOOKAHEAD	64
+
+/** Contents of a scrolling frame drawn offscreen, by rows of the frame */
+typedef struct RenderCache {
+	DisplayList ops;	/**< Operations, sorted by row */
+	int *rows;		/**< First operation of each row; row 0 and
+				 *   fhgt + 1 take what lies outside */
+	int nrows;		/**< Height of the contents drawn */
+	int width;		/**< Width of the display it was drawn for */
+	int valid;		/**< Drawn since the widgets last changed */
+	int shown;		/**< Copied into the frame being rendered */
+} RenderCache;
+
+/** Clipping rectangle and scrolling of a frame, or of the screen itself */
+typedef struct RenderClip {
+	Screen *screen;		/**< Screen holding the frame's widgets */
+	int left;		/**< Left edge, counted from 0 */
+	int top;		/**< Top edge */
+	int right;		/**< Right edge */
+	int bottom;		/**< Bottom edge */
+	int fhgt;		/**< Height of the frame contents */
+	int fspeed;		/**< Speed of vertical scrolling; 0 for none */
+	int fy;			/**< Scrolling offset in the frame being rendered */
+	RenderCache *cache;	/**< Its contents if it scrolls, or NULL */
+} RenderClip;
+
+/** Entry of a display list: a widget and the frame it is clipped to */
+typedef struct RenderItem {
+	Widget *w;		/**< The widget */
+	int clip;		/**< Index of its frame in RenderList.clips */
+} RenderItem;
+
+/** Display list of a screen: the widgets of all visible frames in the
+ * order they are drawn. clips[0] is the screen itself. */
+typedef struct RenderList {
+	unsigned long serial;	/**< screen_layout_serial it was built at */
+	RenderItem *items;	/**< Widgets */
+	int length;		/**< Number of widgets */
+	int size;		/**< Allocated size of items */
+	RenderClip *clips;	/**< Frames */
+	int nclips;		/**< Number of frames */
+	int clips_size;		/**< Allocated size of clips */
+} RenderList;
+
 int heartbeat = HEARTBEAT_OPEN;
 static int heartbeat_fallback = HEARTBEAT_ON; /* If no heartbeat setting has been set at all */
 
@@ -61,20 +117,65 @@ int output_state = 0;
 char *server_msg_text;
 int server_msg_expire = 0;
 
-
-static void render_frame(LinkedList *list, int left, int top, int right, int bottom, int fwid, int fhgt, char fscroll, int fspeed, long timer);
+/** What a display showed after the last rendered frame, and the frame
+ * rendered ahead for it by render_prepare() */
+typedef struct RenderState {
+	Screen *last_screen;
+	int last_backlight;
+	int last_heartbeat;
+	int last_output;
+	long last_timer;
+	Screen *prepared_screen;	/**< What the prepared frame was made for */
+	long prepared_timer;
+	int prepared_backlight;
+	int prepared_heartbeat;
+	int prepared_output;
+} RenderState;
+
+/** State of the main display */
+static RenderState main_state = { NULL, -1, -1, -1, 0, NULL, 0, -1, -1, -1 };
+/** States of the other displays, from display 1 on */
+static Vector *other_states = NULL;
+/** State of the display being rendered, see render_select_display() */
+static RenderState *rs = &main_state;
+
+static RenderList *render_list_update(Screen *s);
+static int render_list_add(RenderList *list, Screen *s, int left, int top, int right, int bottom, int fhgt, int fspeed);
+static void render_frame(Screen *s, long timer);
+static void render_list_free_caches(RenderList *list);
 static void render_string(Widget *w, int left, int top, int right, int bottom, int fy);
 static void render_hbar(Widget *w, int left, int top, int right, int bottom, int fy);
 static void render_vbar(Widget *w, int left, int top, int right, int bottom);
 static void render_pbar(Widget *w, int left, int top, int right, int bottom);
+static void render_graph(Widget *w, int left, int top, int right, int bottom);
 static void render_title(Widget *w, int left, int top, int right, int bottom, long timer);
 static void render_scroller(Widget *w, int left, int top, int right, int bottom, long timer);
 static void render_num(Widget *w, int left, int top, int right, int bottom);
+static int render_backlight_state(Screen *s);
+static int render_heartbeat_state(Screen *s);
+static int render_screen_moving(Screen *s);
+static int render_update_pending(Screen *s);
+static int render_frame_animated(Screen *s);
+static int render_frame_dirty(Screen *s);
+static int render_frame_moves(Screen *s, long t0, long t1);
+static int render_backlight_value(int state, long timer);
+static int render_frame_offset(int fhgt, int top, int bottom, int fspeed, long timer);
+static int render_title_delay(void);
+static int render_title_offset(int length, int width, int delay, long timer);
+static int render_scroller_position(Widget *w, long timer);
+static char *render_layout(Widget *w, int width);
+static void render_window(Widget *w, int x, int y, int start, int width);
+static int render_marquee_offset(int length, int speed, long timer);
+static int render_pingpong_offset(int steps, int speed, long timer);
+static void render_frame_clean(Screen *s);
+static void render_compose(Screen *s, long timer, int bl_state, int hb_state);
+static int render_prepared(Screen *s, long timer, int bl_state, int hb_state);
 
 
 /**
  * Renders a screen. The following actions are taken in order:
  *
+ * \li  Skip the frame if it would not change the display.
  * \li  Clear the screen.
  * \li  Set the backlight.
  * \li  Set out-of-band data (output).
@@ -84,26 +185,58 @@ static void render_num(Widget *w, int left, int top, int right, int bottom);
  * \li  Show any server message.
  * \li  Flush all output to screen.
  *
+ * A frame is skipped, without any call to the drivers, if the same screen
+ * was rendered last time, neither it nor any of its widgets is marked
+ * dirty, it is not animated, and backlight, heartbeat and output state are
+ * unchanged. A screen that sets an update interval also has frames
+ * skipped that only show changed widgets, until the interval has passed
+ * since it was last rendered: the widgets keep the last values set, so
+ * updates arriving faster than that are coalesced into one frame.
+ *
+ * If render_prepare() already rendered the screen for this timer value
+ * and nothing changed since, that frame is swapped in instead of
+ * rendering the screen again.
+ *
  * \param s      The screen to render.
  * \param timer  A value increased with every call.
- * \return  -1 on error, 0 on success.
+ * \return  -1 on error, 0 on success, 1 if the frame was skipped.
  */
 int
 render_screen(Screen *s, long timer)
 {
-	int tmp_state = 0;
+	int res = render_screen_frame(s, timer);
+
+	/* 8. Flush display out, frame and all... */
+	if (res == 0)
+		drivers_flush();
+	return res;
+}
 
-	debug(RPT_DEBUG, "%s(screen=[%.40s], timer=%ld)  ==== START RENDERING ====", __FUNCTION__, s->id, timer);
+
+/**
+ * Render a frame like render_screen(), but leave it in the drivers for the
+ * caller to flush with drivers_flush(). The main loop flushes this way to
+ * give up the server lock meanwhile, see iothread.c: the screen is only
+ * used before.
+ * \param s      The screen to render.
+ * \param timer  A value increased with every call.
+ * \return  -1 on error, 0 if the frame is to be flushed, 1 if it was skipped.
+ */
+int
+render_screen_frame(Screen *s, long timer)
+{
+	int tmp_state = 0;
+	int bl_state;
+	int hb_state;
 
 	if (s == NULL)
 		return -1;
 
-	/* 1. Clear the LCD screen... */
-	drivers_clear();
+	debug(RPT_DEBUG, "%s(screen=[%.40s], timer=%ld)  ==== START RENDERING ====", __FUNCTION__, s->id, timer);
 
-	/* 2. Set up the backlight */
+	/* 0. Find out the backlight state */
 	/*-
-	 * 2.1:
+	 * 0.1:
 	 * First we find out who has set the backlight:
 	 *   a) the screen,
 	 *   b) the client, or
@@ -111,144 +244,838 @@ render_screen(Screen *s, long timer)
 	 * with the latter taking precedence over the earlier. If the
 	 * backlight is not set on/off then use the fallback (set it ON).
 	 */
-	if (backlight != BACKLIGHT_OPEN) {
-		tmp_state = backlight;
-	}
-	else if ((s->client != NULL) && (s->client->backlight != BACKLIGHT_OPEN)) {
-		tmp_state = s->client->backlight;
-	}
-	else if (s->backlight != BACKLIGHT_OPEN) {
-		tmp_state = s->backlight;
-	}
-	else {
-		tmp_state = backlight_fallback;
-	}
+	tmp_state = render_backlight_state(s);
 
 	/*-
-	 * 2.2:
+	 * 0.2:
 	 * If one of the backlight options (FLASH or BLINK) has been set turn
 	 * it on/off based on a timed algorithm.
 	 */
-	/* NOTE: dirty stripping of other options... */
-	/* Backlight flash: check timer and flip backlight as appropriate */
-	if (tmp_state & BACKLIGHT_FLASH) {
-		drivers_backlight(
-			(
-				(tmp_state & BACKLIGHT_ON)
-				^ ((timer & 7) == 7)
-			) ? BACKLIGHT_ON : BACKLIGHT_OFF);
+	bl_state = render_backlight_value(tmp_state, timer);
+	hb_state = render_heartbeat_state(s);
+
+	/* 0.3: Skip the frame if nothing changed */
+	if ((s == rs->last_screen) && !s->dirty
+	    && (bl_state == rs->last_backlight) && (hb_state == rs->last_heartbeat)
+	    && (output_state == rs->last_output) && !render_screen_moving(s)
+	    && (!render_frame_dirty(s) || (timer - rs->last_timer < s->update_interval))) {
+		debug(RPT_DEBUG, "==== NOTHING TO RENDER ====");
+		return 1;
 	}
-	/* Backlight blink: check timer and flip backlight as appropriate */
-	else if (tmp_state & BACKLIGHT_BLINK) {
-		drivers_backlight(
-			(
-				(tmp_state & BACKLIGHT_ON)
-				^ ((timer & 14) == 14)
-			) ? BACKLIGHT_ON : BACKLIGHT_OFF);
+
+	/* 1.-6. Use the frame rendered ahead, or render it now */
+	if (render_prepared(s, timer, bl_state, hb_state)) {
+		debug(RPT_DEBUG, "==== USING PREPARED FRAME ====");
+		drivers_swap_frame(0);
 	}
-	else {
-		/* Simple: Only send lowest bit then... */
-		drivers_backlight(tmp_state & BACKLIGHT_ON);
+	else
+		render_compose(s, timer, bl_state, hb_state);
+	rs->prepared_screen = NULL;
+
+	/* 7. If there is an server message that is not expired, display it
+	 * on the main display */
+	if ((server_msg_expire > 0) && (rs == &main_state)) {
+		drivers_string(display_props->width - strlen(server_msg_text) + 1,
+				display_props->height, server_msg_text);
+		server_msg_expire--;
+		if (server_msg_expire == 0) {
+			free(server_msg_text);
+			/* the next frame has to remove it */
+			render_invalidate();
+		}
 	}
 
+	/* Remember what is on the display now */
+	s->dirty = 0;
+	render_frame_clean(s);
+	rs->last_screen = s;
+	rs->last_backlight = bl_state;
+	rs->last_heartbeat = hb_state;
+	rs->last_output = output_state;
+	rs->last_timer = timer;
+
+	debug(RPT_DEBUG, "==== END RENDERING ====");
+	return 0;
+}
+
+
+/**
+ * Tell whether the last frame flushed to the current display shows the
+ * screen with all its changes: none are waiting for the next frame, or
+ * for the screen's update interval to pass.
+ * \param s  The screen.
+ * \return  1 if it is shown as it is, 0 if not.
+ */
+int
+render_screen_shown(Screen *s)
+{
+	return (s != NULL) && (s == rs->last_screen) && !s->dirty && !render_frame_dirty(s);
+}
+
+
+/* Steps 1 to 6 of render_screen(): everything but the server message */
+static void
+render_compose(Screen *s, long timer, int bl_state, int hb_state)
+{
+	/* 1. Clear the LCD screen... */
+	drivers_clear();
+
+	/* 2. Set up the backlight */
+	drivers_backlight(bl_state);
+
 	/* 3. Output ports from LCD - outputs depend on the current screen */
 	drivers_output(output_state);
 
 	/* 4. Draw a frame... */
-	render_frame(s->widgetlist, 0, 0,
-			display_props->width, display_props->height,
-			s->width, s->height, 'v', max(s->duration / s->height, 1), timer);
+	render_frame(s, timer);
 
 	/* 5. Set the cursor */
 	drivers_cursor(s->cursor_x, s->cursor_y, s->cursor);
 
 	/* 6. Set the heartbeat */
-	if (heartbeat != HEARTBEAT_OPEN) {
-		tmp_state = heartbeat;
+	drivers_heartbeat(hb_state);
+}
+
+
+/* Tell whether the prepared frame shows the screen as it would be rendered */
+static int
+render_prepared(Screen *s, long timer, int bl_state, int hb_state)
+{
+	return (s == rs->prepared_screen) && (timer == rs->prepared_timer) && !s->dirty
+	       && (bl_state == rs->prepared_backlight) && (hb_state == rs->prepared_heartbeat)
+	       && (output_state == rs->prepared_output) && !render_frame_dirty(s);
+}
+
+
+/**
+ * Render a screen ahead into a spare frame, e.g. the next screen of the
+ * rotation, so render_screen() only has to swap it in when the screen
+ * comes up at the given timer value. The frame is kept as long as the
+ * screen does not change; a frame already prepared for the same screen
+ * and timer is not rendered again.
+ * \param s      The screen to render.
+ * \param timer  Value of the timer the screen will be shown at.
+ */
+void
+render_prepare(Screen *s, long timer)
+{
+	int bl_state;
+	int hb_state;
+
+	if ((s == NULL) || (s == rs->last_screen))
+		return;
+
+	bl_state = render_backlight_value(render_backlight_state(s), timer);
+	hb_state = render_heartbeat_state(s);
+	if (render_prepared(s, timer, bl_state, hb_state))
+		return;
+
+	debug(RPT_DEBUG, "%s(screen=[%.40s], timer=%ld)", __FUNCTION__, s->id, timer);
+
+	drivers_swap_frame(1);
+	render_compose(s, timer, bl_state, hb_state);
+	drivers_swap_frame(0);
+
+	/* the marks now tell about changes since the frame was prepared */
+	s->dirty = 0;
+	render_frame_clean(s);
+	rs->prepared_screen = s;
+	rs->prepared_timer = timer;
+	rs->prepared_backlight = bl_state;
+	rs->prepared_heartbeat = hb_state;
+	rs->prepared_output = output_state;
+}
+
+/**
+ * Determine the effective backlight state of a screen: the server core
+ * takes precedence over the client, which takes precedence over the screen.
+ * \param s  The screen.
+ * \return  Backlight state including the FLASH / BLINK bits.
+ */
+static int
+render_backlight_state(Screen *s)
+{
+	if (backlight != BACKLIGHT_OPEN)
+		return backlight;
+	if ((s->client != NULL) && (s->client->backlight != BACKLIGHT_OPEN))
+		return s->client->backlight;
+	if (s->backlight != BACKLIGHT_OPEN)
+		return s->backlight;
+	return backlight_fallback;
+}
+
+
+/**
+ * Turn a backlight state into the value sent to the drivers at a given
+ * time: FLASH and BLINK flip the backlight on a timed algorithm.
+ * \param state  Backlight state including the FLASH / BLINK bits.
+ * \param timer  Current timer tick.
+ * \return  BACKLIGHT_ON or BACKLIGHT_OFF.
+ */
+static int
+render_backlight_value(int state, long timer)
+{
+	/* NOTE: dirty stripping of other options... */
+	/* Backlight flash: check timer and flip backlight as appropriate */
+	if (state & BACKLIGHT_FLASH) {
+		return (
+				(state & BACKLIGHT_ON)
+				^ ((timer & 7) == 7)
+			) ? BACKLIGHT_ON : BACKLIGHT_OFF;
 	}
-	else if ((s->client != NULL) && (s->client->heartbeat != HEARTBEAT_OPEN)) {
-		tmp_state = s->client->heartbeat;
+	/* Backlight blink: check timer and flip backlight as appropriate */
+	else if (state & BACKLIGHT_BLINK) {
+		return (
+				(state & BACKLIGHT_ON)
+				^ ((timer & 14) == 14)
+			) ? BACKLIGHT_ON : BACKLIGHT_OFF;
 	}
-	else if (s->heartbeat != HEARTBEAT_OPEN) {
-		tmp_state = s->heartbeat;
+	/* Simple: Only send lowest bit then... */
+	return state & BACKLIGHT_ON;
+}
+
+
+/**
+ * Determine the effective heartbeat state of a screen, using the same
+ * precedence as render_backlight_state().
+ * \param s  The screen.
+ * \return  Heartbeat state.
+ */
+static int
+render_heartbeat_state(Screen *s)
+{
+	if (heartbeat != HEARTBEAT_OPEN)
+		return heartbeat;
+	if ((s->client != NULL) && (s->client->heartbeat != HEARTBEAT_OPEN))
+		return s->client->heartbeat;
+	if (s->heartbeat != HEARTBEAT_OPEN)
+		return s->heartbeat;
+	return heartbeat_fallback;
+}
+
+
+/**
+ * Tell whether rendering a screen depends on the timer, i.e. whether
+ * successive calls to render_screen() with an otherwise unchanged screen
+ * would produce different output. The event-driven main loop uses this
+ * to skip frames while nothing on the display moves.
+ *
+ * The check errs on the safe side: anything that might change with the
+ * timer (blinking backlight, a cursor drawn by the core, heartbeat, server
+ * messages, and titles, scrollers and frames with content larger than
+ * their box) makes the screen count as animated.
+ *
+ * Widget changes held back by the screen's update interval count as
+ * animation too, as they show up without further input.
+ *
+ * \param s  The screen to check.
+ * \return  1 if the screen is animated, 0 if it is static.
+ */
+int
+render_screen_animated(Screen *s)
+{
+	return render_screen_moving(s) || render_update_pending(s);
+}
+
+
+/* Tell whether a screen changes with the timer, apart from held updates */
+static int
+render_screen_moving(Screen *s)
+{
+	if (s == NULL)
+		return 0;
+
+	if (render_backlight_state(s) & (BACKLIGHT_FLASH | BACKLIGHT_BLINK))
+		return 1;
+	if (render_heartbeat_state(s) == HEARTBEAT_ON)
+		return 1;
+	if ((s->cursor != CURSOR_OFF) && !drivers_cursor_native(s->display))
+		return 1;
+	if (server_msg_expire > 0)
+		return 1;
+
+	return render_frame_animated(s);
+}
+
+
+/* Tell whether the update interval holds back changes of the screen shown */
+static int
+render_update_pending(Screen *s)
+{
+	return (s != NULL) && (s == rs->last_screen) && (s->update_interval > 0)
+	       && render_frame_dirty(s);
+}
+
+
+/* Counterpart of render_frame() for render_screen_animated() */
+static int
+render_frame_animated(Screen *s)
+{
+	RenderList *list = render_list_update(s);
+	int i;
+
+	if (list == NULL)
+		return 0;
+
+	/* a frame scrolls when its contents are larger than the visible area */
+	for (i = 0; i < list->nclips; i++) {
+		RenderClip *clip = &list->clips[i];
+
+		if ((clip->fspeed != 0) && (clip->fhgt > clip->bottom - clip->top))
+			return 1;
 	}
-	else {
-		tmp_state = heartbeat_fallback;
+
+	for (i = 0; i < list->length; i++) {
+		Widget *w = list->items[i].w;
+		RenderClip *clip = &list->clips[list->items[i].clip];
+
+		switch (w->type) {
+		case WID_TITLE:
+			if ((w->text != NULL) && (titlespeed > TITLESPEED_NO)
+			    && ((int) strlen(w->text) > (clip->right - clip->left) - 6))
+				return 1;
+			break;
+		case WID_SCROLLER:
+			if ((w->text != NULL) && (w->speed != 0)
+			    && ((int) strlen(w->text) >= abs(w->right - w->left + 1)))
+				return 1;
+			break;
+		default:
+			break;
+		}
 	}
-	drivers_heartbeat(tmp_state);
+	return 0;
+}
 
-	/* 7. If there is an server message that is not expired, display it */
-	if (server_msg_expire > 0) {
-		drivers_string(display_props->width - strlen(server_msg_text) + 1,
-				display_props->height, server_msg_text);
-		server_msg_expire--;
-		if (server_msg_expire == 0) {
-			free(server_msg_text);
+
+/**
+ * Tell for how many ticks after \c timer rendering a screen would produce
+ * the same output as rendering it at \c timer. An animated screen does not
+ * change on every tick: a scroller with speed 4 moves every 4th tick, a
+ * blinking backlight flips twice in 16 ticks. The adaptive main loop
+ * renders such screens only on the ticks where they move.
+ *
+ * \param s      The screen to check.
+ * \param timer  Tick of the frame on the display.
+ * \return  Number of ticks without change (at most RENDER_LOOKAHEAD - 1),
+ *          or -1 if the screen does not change with the timer at all.
+ */
+long
+render_screen_idle_ticks(Screen *s, long timer)
+{
+	Driver *drv;
+	int i;
+	int bl_state;
+	int hb_state;
+	long k;
+
+	if (!render_screen_animated(s))
+		return -1;
+
+	/* server messages count down on every frame */
+	if (server_msg_expire > 0)
+		return 0;
+
+	/* drivers animating the heartbeat on their own count the calls */
+	hb_state = render_heartbeat_state(s);
+	if (hb_state == HEARTBEAT_ON) {
+		for (i = 0; (drv = drivers_get(i)) != NULL; i++) {
+			if (drv->heartbeat != NULL)
+				return 0;
 		}
 	}
 
-	/* 8. Flush display out, frame and all... */
-	drivers_flush();
+	bl_state = render_backlight_state(s);
+	for (k = 1; k < RENDER_LOOKAHEAD; k++) {
+		long t = timer + k;
 
-	debug(RPT_DEBUG, "==== END RENDERING ====");
+		if (render_backlight_value(bl_state, timer) != render_backlight_value(bl_state, t))
+			break;
+		/* see driver_alt_heartbeat() and driver_alt_cursor() */
+		if ((hb_state == HEARTBEAT_ON) && (((timer & 5) != 0) != ((t & 5) != 0)))
+			break;
+		if ((s->cursor != CURSOR_OFF) && !drivers_cursor_native(s->display)
+		    && ((timer & 2) != (t & 2)))
+			break;
+		if (render_frame_moves(s, timer, t))
+			break;
+		if (render_update_pending(s) && (t - rs->last_timer >= s->update_interval))
+			break;
+	}
+	return k - 1;
+}
+
+
+/* Counterpart of render_frame() for render_screen_idle_ticks(): tell
+ * whether anything in the frame is at another position at t1 than at t0 */
+static int
+render_frame_moves(Screen *s, long t0, long t1)
+{
+	RenderList *list = render_list_update(s);
+	int i;
+
+	if (list == NULL)
+		return 0;
+
+	for (i = 0; i < list->nclips; i++) {
+		RenderClip *clip = &list->clips[i];
+
+		if ((clip->fspeed != 0) && (clip->fhgt > clip->bottom - clip->top)
+		    && (render_frame_offset(clip->fhgt, clip->top, clip->bottom, clip->fspeed, t0)
+			!= render_frame_offset(clip->fhgt, clip->top, clip->bottom, clip->fspeed, t1)))
+			return 1;
+	}
+
+	for (i = 0; i < list->length; i++) {
+		Widget *w = list->items[i].w;
+		RenderClip *clip = &list->clips[list->items[i].clip];
+
+		switch (w->type) {
+		case WID_TITLE:
+			if ((w->text != NULL) && (clip->right - clip->left >= 8)
+			    && (render_layout(w, clip->right - clip->left - 6) != NULL)) {
+				int length = w->text_length;
+				int width = clip->right - clip->left - 6;
+				int delay = render_title_delay();
+
+				if ((length > width) && (delay != 0)
+				    && (render_title_offset(length, width, delay, t0)
+					!= render_title_offset(length, width, delay, t1)))
+					return 1;
+			}
+			break;
+		case WID_SCROLLER:
+			if (render_scroller_position(w, t0) != render_scroller_position(w, t1))
+				return 1;
+			break;
+		default:
+			break;
+		}
+	}
 	return 0;
+}
+
+
+/**
+ * Make the next call to render_screen() render the screen even if nothing
+ * seems to have changed, e.g. because the display has been cleared behind
+ * its back.
+ */
+void
+render_invalidate(void)
+{
+	RenderState *st;
+	int i;
 
+	main_state.last_screen = NULL;
+	for (i = 0; (st = V_Get(other_states, i)) != NULL; i++)
+		st->last_screen = NULL;
 }
 
-/* The following function is positively ghastly (as was mentioned above!) */
-/* Best thing to do is to remove support for frames... but anyway... */
-/* */
-static void
-render_frame(LinkedList *list,
-		int left,	/* left edge of frame */
-		int top,	/* top edge of frame */
-		int right,	/* right edge of frame */
-		int bottom,	/* bottom edge of frame */
-		int fwid,	/* frame width? */
-		int fhgt,	/* frame height? */
-		char fscroll,	/* direction of scrolling */
-		int fspeed,	/* speed of scrolling... */
-		long timer)	/* current timer tick */
-{
-	int fy = 0;		/* Scrolling offset for the frame... */
-
-	debug(RPT_DEBUG, "%s(list=%p, left=%d, top=%d, "
-			  "right=%d, bottom=%d, fwid=%d, fhgt=%d, "
-			  "fscroll='%c', fspeed=%d, timer=%ld)",
-			  __FUNCTION__, list, left, top, right, bottom,
-			  fwid, fhgt, fscroll, fspeed, timer);
 
-	/* return on no data or illegal height */
-	if ((list == NULL) || (fhgt <= 0))
+/**
+ * Select the display render_screen() and render_prepare() render for.
+ * Each display remembers what it showed after its last frame on its own.
+ * \param display  The display's number, see drivers_select_display().
+ */
+void
+render_select_display(int display)
+{
+	RenderState *st;
+
+	if (display <= 0) {
+		rs = &main_state;
 		return;
+	}
+	if (other_states == NULL)
+		other_states = V_new();
+	while ((st = V_Get(other_states, display - 1)) == NULL) {
+		st = malloc(sizeof(RenderState));
+		if ((st == NULL) || (V_Append(other_states, st) < 0)) {
+			report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+			free(st);
+			return;
+		}
+		st->last_screen = st->prepared_screen = NULL;
+		st->last_backlight = st->last_heartbeat = st->last_output = -1;
+		st->prepared_backlight = st->prepared_heartbeat = st->prepared_output = -1;
+		st->last_timer = st->prepared_timer = 0;
+	}
+	rs = st;
+}
 
-	if (fscroll == 'v') {		/* vertical scrolling */
-		// only set offset !=0 when fspeed is != 0 and there is something to scroll
-		if ((fspeed != 0) && (fhgt > bottom - top)) {
-			int fy_max = fhgt - (bottom - top) + 1;
 
-			fy = (fspeed > 0)
-			     ? (timer / fspeed) % fy_max
-			     : (-fspeed * timer) % fy_max;
+/**
+ * Forget the display list of a screen that is about to be destroyed.
+ * \param s  The screen.
+ */
+void
+render_forget_screen(Screen *s)
+{
+	RenderList *list = s->render_list;
+	RenderState *st;
+	int i;
+
+	if (s == main_state.prepared_screen)
+		main_state.prepared_screen = NULL;
+	for (i = 0; (st = V_Get(other_states, i)) != NULL; i++) {
+		if (s == st->prepared_screen)
+			st->prepared_screen = NULL;
+	}
+	if (list == NULL)
+		return;
+
+	render_list_free_caches(list);
+	free(list->items);
+	free(list->clips);
+	free(list);
+	s->render_list = NULL;
+}
 
-			fy = max(fy, 0);	// safeguard against negative values
 
-			debug(RPT_DEBUG, "%s: fy=%d", __FUNCTION__, fy);
+/* Add a frame and its widgets to a display list, frames in it included.
+ * Returns the index of the frame in list->clips, or -1 on error. */
+static int
+render_list_add(RenderList *list, Screen *s, int left, int top, int right, int bottom, int fhgt, int fspeed)
+{
+	Widget *w;
+	int clip;
+	int i;
+
+	if (list->nclips == list->clips_size) {
+		int size = (list->clips_size > 0) ? 2 * list->clips_size : 4;
+		RenderClip *clips = realloc(list->clips, size * sizeof(RenderClip));
+
+		if (clips == NULL)
+			return -1;
+		list->clips = clips;
+		list->clips_size = size;
+	}
+	clip = list->nclips++;
+	list->clips[clip].screen = s;
+	list->clips[clip].left = left;
+	list->clips[clip].top = top;
+	list->clips[clip].right = right;
+	list->clips[clip].bottom = bottom;
+	list->clips[clip].fhgt = fhgt;
+	list->clips[clip].fspeed = fspeed;
+	list->clips[clip].fy = 0;
+	list->clips[clip].cache = NULL;
+
+	for (i = 0; (w = V_Get(s->widgetlist, i)) != NULL; i++) {
+		if (list->length == list->size) {
+			int size = (list->size > 0) ? 2 * list->size : 16;
+			RenderItem *items = realloc(list->items, size * sizeof(RenderItem));
+
+			if (items == NULL)
+				return -1;
+			list->items = items;
+			list->size = size;
+		}
+		list->items[list->length].w = w;
+		list->items[list->length].clip = clip;
+		list->length++;
+
+		if ((w->type == WID_FRAME) && (w->frame_screen != NULL) && (w->height > 0)) {
+			/* FIXME: doesn't handle nested frames quite right!
+			 * doesn't handle scrolling in nested frames at all...
+			 */
+			int new_left = left + w->left - 1;
+			int new_top = top + w->top - 1;
+			int new_right = min(left + w->right, right);
+			int new_bottom = min(top + w->bottom, bottom);
+
+			/* TODO:  Frames don't scroll horizontally yet! */
+			if ((new_left < right) && (new_top < bottom)	/* Render only if it's visible... */
+			    && (render_list_add(list, w->frame_screen, new_left, new_top,
+					new_right, new_bottom, w->height,
+					(w->length == 'v') ? w->speed : 0) < 0))
+				return -1;
 		}
 	}
-	else if (fscroll == 'h') {	/* horizontal scrolling */
-		/* TODO:  Frames don't scroll horizontally yet! */
+	return clip;
+}
+
+
+/* Get the display list of a screen, rebuilt if the layout of any screen
+ * changed since it was built. Returns NULL if there is nothing to render. */
+static RenderList *
+render_list_update(Screen *s)
+{
+	RenderList *list = s->render_list;
+
+	if (s->height <= 0)
+		return NULL;
+
+	if (list == NULL) {
+		list = calloc(1, sizeof(RenderList));
+		if (list == NULL) {
+			report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+			return NULL;
+		}
+		s->render_list = list;
+	}
+	else if ((list->serial == screen_layout_serial) && (list->nclips > 0)) {
+		/* the screen's own height and duration need no rebuild */
+		list->clips[0].fhgt = s->height;
+		list->clips[0].fspeed = max(s->duration / s->height, 1);
+		return list;
+	}
+
+	render_list_free_caches(list);
+	list->length = 0;
+	list->nclips = 0;
+	if (render_list_add(list, s, 0, 0, display_props->width, display_props->height,
+			s->height, max(s->duration / s->height, 1)) < 0) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		/* render what fits, and try again next time */
+		list->serial = screen_layout_serial - 1;
+		return (list->nclips > 0) ? list : NULL;
 	}
+	list->serial = screen_layout_serial;
+	return list;
+}
+
+
+/* Free the offscreen contents of a frame */
+static void
+render_cache_free(RenderClip *clip)
+{
+	if (clip->cache == NULL)
+		return;
+	displaylist_free(&clip->cache->ops);
+	free(clip->cache->rows);
+	free(clip->cache);
+	clip->cache = NULL;
+}
 
-	/* reset widget list */
-	LL_Rewind(list);
+
+/* Free the offscreen contents of all frames of a display list */
+static void
+render_list_free_caches(RenderList *list)
+{
+	int i;
+
+	for (i = 0; i < list->nclips; i++)
+		render_cache_free(&list->clips[i]);
+}
+
+
+/* Tell whether a widget moves with the frame it is in when that scrolls,
+ * so it is drawn offscreen */
+static int
+render_cached(const Widget *w)
+{
+	return (w->type == WID_STRING) || (w->type == WID_HBAR) || (w->type == WID_PBAR);
+}
+
+
+/* Row of the contents of a frame an operation is in: 0 above the
+ * contents, rows + 1 below */
+static int
+render_cache_row(const DriverOp *op, int rows)
+{
+	return (op->y < 1) ? 0 : (op->y > rows) ? rows + 1 : op->y;
+}
+
+
+/*
+ * Draw the widgets of a scrolling frame that move with it offscreen, at
+ * the rows of the frame's contents, unless that was done already and none
+ * of them changed since. The operations are sorted by row, so the rows in
+ * view are a range of them. Returns -1 on error: the frame is then drawn
+ * widget by widget.
+ */
+static int
+render_cache_update(RenderList *list, int clip)
+{
+	RenderClip *c = &list->clips[clip];
+	RenderCache *cache = c->cache;
+	int *rows;
+	int i;
+
+	if (cache->valid && !c->screen->dirty && (cache->nrows == c->fhgt)
+	    && (cache->width == display_props->width))
+		return 0;
+
+	rows = realloc(cache->rows, (c->fhgt + 3) * sizeof(int));
+	if (rows == NULL)
+		return -1;
+	cache->rows = rows;
+	cache->nrows = c->fhgt;
+	cache->width = display_props->width;
+
+	drivers_record(&cache->ops);
+	for (i = 0; i < list->length; i++) {
+		Widget *w = list->items[i].w;
+		ProfileSlot *prev;
+
+		if ((list->items[i].clip != clip) || !render_cached(w))
+			continue;
+		prev = PROFILE_ENTER(profile_widget(w->type));
+		switch (w->type) {
+		case WID_STRING:
+			render_string(w, c->left, 0, c->right, c->fhgt, 0);
+			break;
+		case WID_HBAR:
+			render_hbar(w, c->left, 0, c->right, c->fhgt, 0);
+			break;
+		case WID_PBAR:
+			render_pbar(w, c->left, 0, c->right, c->fhgt);
+			break;
+		default:
+			break;
+		}
+		PROFILE_LEAVE(prev);
+	}
+	drivers_record(NULL);
+
+	/* counting sort, keeping the order of the operations in a row */
+	memset(rows, 0, (c->fhgt + 3) * sizeof(int));
+	for (i = 0; i < cache->ops.count; i++)
+		rows[render_cache_row(&cache->ops.ops[i], c->fhgt) + 1]++;
+	for (i = 1; i < c->fhgt + 3; i++)
+		rows[i] += rows[i - 1];
+	if (cache->ops.count > 0) {
+		DriverOp *sorted = malloc(cache->ops.count * sizeof(DriverOp));
+
+		if (sorted == NULL)
+			return -1;
+		for (i = 0; i < cache->ops.count; i++)
+			sorted[rows[render_cache_row(&cache->ops.ops[i], c->fhgt)]++] = cache->ops.ops[i];
+		/* each row now starts where the one before it ended */
+		memmove(rows + 1, rows, (c->fhgt + 2) * sizeof(int));
+		rows[0] = 0;
+		memcpy(cache->ops.ops, sorted, cache->ops.count * sizeof(DriverOp));
+		free(sorted);
+	}
+
+	cache->valid = 1;
+	return 0;
+}
+
+
+/* Copy the rows of a scrolling frame in view into the frame rendered */
+static void
+render_cache_show(RenderClip *clip)
+{
+	RenderCache *cache = clip->cache;
+	int first = clip->fy + 1;
+	int last = min(clip->fy + clip->bottom - clip->top, cache->nrows);
+
+	if (first <= last)
+		drivers_replay(&cache->ops.ops[cache->rows[first]],
+			       cache->rows[last + 1] - cache->rows[first],
+			       0, clip->top - clip->fy);
+	cache->shown = 1;
+}
+
+
+/* Tell whether a widget (or a widget in a frame) is marked dirty */
+static int
+render_frame_dirty(Screen *s)
+{
+	RenderList *list = render_list_update(s);
+	int i;
+
+	if (list == NULL)
+		return 0;
+
+	for (i = 0; i < list->nclips; i++) {
+		if (list->clips[i].screen->dirty)
+			return 1;
+	}
+	for (i = 0; i < list->length; i++) {
+		if (list->items[i].w->dirty)
+			return 1;
+	}
+	return 0;
+}
+
+
+/* Clear the dirty marks set on widgets and frames */
+static void
+render_frame_clean(Screen *s)
+{
+	RenderList *list = render_list_update(s);
+	int i;
+
+	if (list == NULL)
+		return;
+
+	for (i = 0; i < list->nclips; i++)
+		list->clips[i].screen->dirty = 0;
+	for (i = 0; i < list->length; i++)
+		list->items[i].w->dirty = 0;
+}
+
+
+/* Draw the widgets of a screen and of all frames in it */
+static void
+render_frame(Screen *s, long timer)
+{
+	RenderList *list = render_list_update(s);
+	int i;
+
+	debug(RPT_DEBUG, "%s(s=[%.40s], timer=%ld)", __FUNCTION__, s->id, timer);
+
+	/* return on no data or illegal height */
+	if (list == NULL)
+		return;
+
+	/* every frame's scrolling offset once, instead of once per widget */
+	for (i = 0; i < list->nclips; i++) {
+		RenderClip *clip = &list->clips[i];
+
+		// only set offset !=0 when fspeed is != 0 and there is something to scroll
+		clip->fy = 0;
+		if ((clip->fspeed != 0) && (clip->fhgt > clip->bottom - clip->top)) {
+			clip->fy = render_frame_offset(clip->fhgt, clip->top, clip->bottom,
+						       clip->fspeed, timer);
+
+			debug(RPT_DEBUG, "%s: fy=%d", __FUNCTION__, clip->fy);
+			if (clip->cache == NULL)
+				clip->cache = calloc(1, sizeof(RenderCache));
+			else
+				clip->cache->shown = 0;
+		}
+		else
+			render_cache_free(clip);
+	}
+
+	/* scrolling frames are drawn offscreen again when a widget changed */
+	for (i = 0; i < list->length; i++) {
+		RenderClip *clip = &list->clips[list->items[i].clip];
+
+		if ((clip->cache != NULL) && list->items[i].w->dirty)
+			clip->cache->valid = 0;
+	}
+	for (i = 0; i < list->nclips; i++) {
+		if ((list->clips[i].cache != NULL) && (render_cache_update(list, i) < 0)) {
+			report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+			render_cache_free(&list->clips[i]);
+		}
+	}
 
 	/* loop over all widgets */
-	do {
-		Widget *w = (Widget *) LL_Get(list);
+	for (i = 0; i < list->length; i++) {
+		Widget *w = list->items[i].w;
+		RenderClip *clip = &list->clips[list->items[i].clip];
+		int left = clip->left;
+		int top = clip->top;
+		int right = clip->right;
+		int bottom = clip->bottom;
+		int fy = clip->fy;
+		ProfileSlot *prev;
+
+		/* the rows in view of the frame's offscreen contents, once */
+		if ((clip->cache != NULL) && render_cached(w)) {
+			if (!clip->cache->shown)
+				render_cache_show(clip);
+			continue;
+		}
 
-		if (w == NULL)
-			return;
+		prev = PROFILE_ENTER(profile_widget(w->type));
 
 		/* TODO:  Make this cleaner and more flexible! */
 		switch (w->type) {
@@ -274,20 +1101,7 @@ render_frame(LinkedList *list,
 			render_scroller(w, left, top, right, bottom, timer);
 			break;
 		case WID_FRAME:
-			{
-				/* FIXME: doesn't handle nested frames quite right!
-				 * doesn't handle scrolling in nested frames at all...
-				 */
-				int new_left = left + w->left - 1;
-				int new_top = top + w->top - 1;
-				int new_right = min(left + w->right, right);
-				int new_bottom = min(top + w->bottom, bottom);
-
-				if ((new_left < right) && (new_top < bottom))	/* Render only if it's visible... */
-					render_frame(w->frame_screen->widgetlist, new_left, new_top,
-							new_right, new_bottom, w->width, w->height,
-							w->length, w->speed, timer);
-			}
+			/* its widgets follow in the list */
 			break;
 		case WID_NUM:	  /* FIXME: doesn't work in frames... */
 			/* NOTE: y=10 means COLON (:) */
@@ -295,12 +1109,16 @@ render_frame(LinkedList *list,
 				drivers_num(w->x + left, w->y);
 			}
 			break;
+		case WID_GRAPH:	  /* FIXME:  Graphs don't work in frames either */
+			render_graph(w, left, top, right, bottom);
+			break;
 		case WID_NONE:
 			/* FALLTHROUGH */
 		default:
 			break;
 		}
-	} while (LL_Next(list) == 0);
+		PROFILE_LEAVE(prev);
+	}
 }
 
 
@@ -393,79 +1211,66 @@ render_pbar(Widget *w, int left, int top, int right, int bottom)
        		     w->begin_label, w->end_label);
 }
 
+/* One vbar per value, oldest at the left, standing on the bottom row */
+static void
+render_graph(Widget *w, int left, int top, int right, int bottom)
+{
+	int i;
+
+	debug(RPT_DEBUG, "%s(w=%p, left=%d, top=%d, right=%d, bottom=%d)",
+			  __FUNCTION__, w, left, top, right, bottom);
+
+	if (!((w->x > 0) && (w->y > 0) && (w->height > 0) && (w->samples != NULL)))
+		return;
+
+	for (i = 0; i < w->samples_size; i++) {
+		int promille = w->samples[(w->sample_next + i) % w->samples_size];
+
+		if (promille > 0)
+			drivers_vbar(w->x + left + i, w->y + top + w->height - 1,
+				     w->height, promille, BAR_PATTERN_FILLED);
+	}
+}
+
 static void
 render_title(Widget *w, int left, int top, int right, int bottom, long timer)
 {
 	int vis_width = right - left;
-	char str[BUFSIZE];
 	int x, width = vis_width - 6, length, delay;
 
 	debug(RPT_DEBUG, "%s(w=%p, left=%d, top=%d, right=%d, bottom=%d, timer=%ld)",
 			  __FUNCTION__, w, left, top, right, bottom, timer);
 
-	if ((w->text == NULL) || (vis_width < 8))
+	if ((w->text == NULL) || (vis_width < 8) || (render_layout(w, width) == NULL))
 		return;
 
-	length = strlen(w->text);
+	length = w->text_length;
 
-	/* calculate delay from titlespeed: <=0 -> 0, [1 - infty] -> [10 - 1] */
-	delay = (titlespeed <= TITLESPEED_NO)
-		? TITLESPEED_NO
-		: max(TITLESPEED_MIN, TITLESPEED_MAX - titlespeed);
+	delay = render_title_delay();
 
 	/* display leading fillers */
 	drivers_icon(w->x + left, w->y + top, ICON_BLOCK_FILLED);
 	drivers_icon(w->x + left + 1, w->y + top, ICON_BLOCK_FILLED);
 
-	length = min(length, sizeof(str)-1);
 	if ((length <= width) || (delay == 0)) {
 
-		/* copy test starting from the beginning */
+		/* display text starting from the beginning */
 		length = min(length, width);
-		strncpy(str, w->text, length);
-		str[length] = '\0';
+		render_window(w, w->x + 3 + left, w->y + top, 0, length);
 
 		/* set x value for trailing fillers */
 		x = length + 4;
 	}
 	else {			/* Scroll the title, if it doesn't fit... */
-		int offset = timer;
-		int reverse;
-
-		/* if the delay is "too large" increase cycle length */
-		if ((delay != 0) && (delay < length / (length - width)))
-			offset /= delay;
-
-		/* reverse direction every length ticks */
-		reverse = (offset / length) & 1;
-
-		/* restrict offset to cycle length */
-		offset %= length;
-		offset = max(offset, 0);
+		int offset = render_title_offset(length, width, delay, timer);
 
-		/* if the delay is "low enough" slow down as requested */
-		if ((delay != 0) && (delay >= length / (length - width)))
-			offset /= delay;
-
-		/* restrict offset to the max. allowed offset: length - width */
-		offset = min(offset, length - width);
-
-		/* scroll backward by mirroring offset at max. offset */
-		if (reverse)
-			offset = (length - width) - offset;
-
-		/* copy test starting from offset */
-		length = min(width, sizeof(str)-1);
-		strncpy(str, w->text + offset, length);
-		str[length] = '\0';
+		/* display text starting from offset */
+		render_window(w, w->x + 3 + left, w->y + top, offset, width);
 
 		/* set x value for trailing fillers */
 		x = vis_width - 2;
 	}
 
-	/* display text */
-	drivers_string(w->x + 3 + left, w->y + top, str);
-
 	/* display trailing fillers */
 	for ( ; x < vis_width; x++) {
 		drivers_icon(w->x + x + left, w->y + top, ICON_BLOCK_FILLED);
@@ -476,11 +1281,9 @@ render_title(Widget *w, int left, int top, int right, int bottom, long timer)
 static void
 render_scroller(Widget *w, int left, int top, int right, int bottom, long timer)
 {
-	char str[BUFSIZE];
 	int length;
 	int offset, gap;
 	int screen_width;
-	int necessaryTimeUnits = 0;
 
 	debug(RPT_DEBUG, "%s(w=%p, left=%d, top=%d, right=%d, bottom=%d, timer=%ld)",
 			  __FUNCTION__, w, left, top, right, bottom, timer);
@@ -489,11 +1292,14 @@ render_scroller(Widget *w, int left, int top, int right, int bottom, long timer)
 		return;
 
 	screen_width = abs(w->right - w->left + 1);
-	screen_width = min(screen_width, sizeof(str)-1);
+	screen_width = min(screen_width, BUFSIZE - 1);
+
+	if (render_layout(w, screen_width) == NULL)
+		return;
 
 	switch (w->length) {	/* actually, direction... */
 	case 'm': // Marquee
-		length = strlen(w->text);
+		length = w->text_length;
 		if (length <= screen_width) {
 			/* it fits within the box, just render it */
 			drivers_string(w->left, w->top, w->text);
@@ -503,39 +1309,14 @@ render_scroller(Widget *w, int left, int top, int right, int bottom, long timer)
 		gap = screen_width / 2;
 		length += gap; /* Allow gap between end and beginning */
 
-		if (w->speed > 0) {
-			necessaryTimeUnits = length * w->speed;
-			offset = (timer % necessaryTimeUnits) / w->speed;
-		}
-		else if (w->speed < 0) {
-			necessaryTimeUnits = length / (w->speed * -1);
-			offset = (timer % necessaryTimeUnits) * w->speed * -1;
-		}
-		else {
-			offset = 0;
-		}
-		if (offset <= length) {
-			if (gap > offset) {
-				memset(str, ' ', gap - offset);
-				strncpy(&str[gap-offset], w->text, screen_width);
-			}
-			else {
-				int room = screen_width - (length - offset);
-
-				strncpy(str, &w->text[offset-gap], screen_width);
-				if (room > 0) {
-					memset(&str[length-offset], ' ', min(room, gap));
-					room -= gap;
-					if (room > 0)
-						strncpy(&str[length-offset+gap], w->text, room);
-				}
-			}
-			str[screen_width] = '\0';
-			drivers_string(w->left, w->top, str);
-		}
+		/* the layout runs through the gap and the text and on into
+		 * the next round, so each offset is a window of the layout */
+		offset = render_marquee_offset(length, w->speed, timer);
+		if (offset <= length)
+			render_window(w, w->left, w->top, offset, screen_width);
 		break;
 	case 'h':
-		length = strlen(w->text) + 1;
+		length = w->text_length + 1;
 		if (length <= screen_width) {
 			/* it fits within the box, just render it */
 			drivers_string(w->left, w->top, w->text);
@@ -543,41 +1324,9 @@ render_scroller(Widget *w, int left, int top, int right, int bottom, long timer)
 		else {
 			int effLength = length - screen_width;
 
-			if (w->speed > 0) {
-				necessaryTimeUnits = effLength * w->speed;
-				if (((timer / necessaryTimeUnits) % 2) == 0) {
-					/* wiggle one way */
-					offset = (timer % (effLength*w->speed))
-						 / w->speed;
-				}
-				else {
-					/* wiggle the other */
-					offset = (((timer % (effLength * w->speed))
-						  - (effLength * w->speed) + 1)
-						 / w->speed) * -1;
-				}
-			}
-			else if (w->speed < 0) {
-				necessaryTimeUnits = effLength / (w->speed * -1);
-				if (((timer / necessaryTimeUnits) % 2) == 0) {
-					offset = (timer % (effLength / (w->speed * -1)))
-						 * w->speed * -1;
-				}
-				else {
-					offset = (((timer % (effLength / (w->speed * -1)))
-						  * w->speed * -1)
-						  - effLength + 1) * -1;
-				}
-			}
-			else {
-				offset = 0;
-			}
-			if (offset <= length) {
-				strncpy(str, &((w->text)[offset]), screen_width);
-				str[screen_width] = '\0';
-				drivers_string(w->left, w->top, str);
-				/*debug(RPT_DEBUG, "scroller %s : %d", str, length-offset); */
-			}
+			offset = render_pingpong_offset(effLength, w->speed, timer);
+			if (offset <= length)
+				render_window(w, w->left, w->top, offset, screen_width);
 		}
 		break;
 
@@ -585,7 +1334,7 @@ render_scroller(Widget *w, int left, int top, int right, int bottom, long timer)
 	/* back up after hitting the bottom.  They jump back to */
 	/* the top instead...  (nevermind?) */
 	case 'v':
-		length = strlen(w->text);
+		length = w->text_length;
 		if (length <= screen_width) {
 			/* no scrolling required... */
 			drivers_string(w->left, w->top, w->text);
@@ -599,11 +1348,8 @@ render_scroller(Widget *w, int left, int top, int right, int bottom, long timer)
 				/* easy... */
 				int i;
 
-				for (i = 0; i < lines_required; i++) {
-					strncpy(str, &((w->text)[i * screen_width]), screen_width);
-					str[screen_width] = '\0';
-					drivers_string(w->left, w->top + i, str);
-				}
+				for (i = 0; i < lines_required; i++)
+					render_window(w, w->left, w->top + i, i * screen_width, screen_width);
 			}
 			else {
 				int effLines = lines_required - available_lines + 1;
@@ -611,43 +1357,10 @@ render_scroller(Widget *w, int left, int top, int right, int bottom, long timer)
 				int i = 0;
 
 				/*debug(RPT_DEBUG, "length: %d sw: %d lines req: %d  avail lines: %d  effLines: %d ",length,screen_width,lines_required,available_lines,effLines);*/
-				if (w->speed > 0) {
-					necessaryTimeUnits = effLines * w->speed;
-					if (((timer / necessaryTimeUnits) % 2) == 0) {
-						/*debug(RPT_DEBUG, "up ");*/
-						begin = (timer % (necessaryTimeUnits))
-							 / w->speed;
-					}
-					else {
-						/*debug(RPT_DEBUG, "down ");*/
-						begin = (((timer % necessaryTimeUnits)
-							 - necessaryTimeUnits + 1) / w->speed)
-							 * -1;
-					}
-				}
-				else if (w->speed < 0) {
-					necessaryTimeUnits = effLines / (w->speed * -1);
-					if (((timer / necessaryTimeUnits) % 2) == 0) {
-						begin = (timer % necessaryTimeUnits)
-							 * w->speed * -1;
-					}
-					else {
-						begin = (((timer % necessaryTimeUnits)
-							 * w->speed * -1) - effLines + 1)
-							 * -1;
-					}
-				}
-				else {
-					begin = 0;
-				}
+				begin = render_pingpong_offset(effLines, w->speed, timer);
 				/*debug(RPT_DEBUG, "rendering begin: %d  timer: %d effLines: %d",begin,timer,effLines); */
-				for (i = begin; i < begin + available_lines; i++) {
-					strncpy(str, &((w->text)[i * (screen_width)]), screen_width);
-					str[screen_width] = '\0';
-					/*debug(RPT_DEBUG, "rendering: '%s' of %s", */
-					/*str,w->text); */
-					drivers_string(w->left, w->top + (i - begin), str);
-				}
+				for (i = begin; i < begin + available_lines; i++)
+					render_window(w, w->left, w->top + (i - begin), i * screen_width, screen_width);
 			}
 		}
 		break;
@@ -655,6 +1368,215 @@ render_scroller(Widget *w, int left, int top, int right, int bottom, long timer)
 }
 
 
+/* Lay out the text of a scroller or title for a window of the given
+ * width. The layout is kept until the widget or its screen is changed
+ * (marked dirty) or the width changes, so that a frame only has to pick
+ * a window of it. Marquees get the gap, the text, the gap and the start
+ * of the text again: then every window of the cycle is a substring.
+ * Everything else is laid out as the text itself, titles cut to
+ * BUFSIZE - 1. */
+static char *
+render_layout(Widget *w, int width)
+{
+	int length;
+	int size;
+
+	if (!w->dirty && ((w->screen == NULL) || !w->screen->dirty)
+	    && (w->layout != NULL) && (w->layout_width == width))
+		return w->layout;
+
+	length = strlen(w->text);
+	if (w->type == WID_TITLE)
+		length = min(length, BUFSIZE - 1);
+	size = length;
+	if ((w->type == WID_SCROLLER) && (w->length == 'm') && (length > width))
+		size = length + width / 2 + width;
+
+	if (widget_layout_buffer(w, size) == NULL)
+		return NULL;
+
+	if (size == length) {
+		memcpy(w->layout, w->text, length);
+	}
+	else {
+		int gap = width / 2;
+
+		memset(w->layout, ' ', gap);
+		memcpy(w->layout + gap, w->text, length);
+		memset(w->layout + gap + length, ' ', gap);
+		memcpy(w->layout + 2 * gap + length, w->text, width - gap);
+	}
+	w->layout[size] = '\0';
+	w->layout_length = size;
+	w->layout_width = width;
+	w->text_length = length;
+	return w->layout;
+}
+
+
+/* Send a window of a widget's layout to the drivers. The layout is cut
+ * by a NUL for the call, which spares copying the window: the drivers and
+ * the frame buffer copy the string before the call returns. */
+static void
+render_window(Widget *w, int x, int y, int start, int width)
+{
+	char *end;
+	char saved;
+
+	if ((start < 0) || (start > w->layout_length))
+		return;
+
+	end = w->layout + min(start + width, w->layout_length);
+	saved = *end;
+	*end = '\0';
+	drivers_string(x, y, w->layout + start);
+	*end = saved;
+}
+
+
+/* Vertical scrolling offset of a frame whose contents are higher than
+ * its visible area */
+static int
+render_frame_offset(int fhgt, int top, int bottom, int fspeed, long timer)
+{
+	int fy_max = fhgt - (bottom - top) + 1;
+	int fy = (fspeed > 0)
+		 ? (timer / fspeed) % fy_max
+		 : (-fspeed * timer) % fy_max;
+
+	return max(fy, 0);	// safeguard against negative values
+}
+
+
+/* Calculate the title scrolling delay from titlespeed:
+ * <=0 -> 0, [1 - infty] -> [10 - 1] */
+static int
+render_title_delay(void)
+{
+	return (titlespeed <= TITLESPEED_NO)
+		? TITLESPEED_NO
+		: max(TITLESPEED_MIN, TITLESPEED_MAX - titlespeed);
+}
+
+
+/* Offset of a title of the given length that is scrolled in a box of the
+ * given width */
+static int
+render_title_offset(int length, int width, int delay, long timer)
+{
+	int offset = timer;
+	int reverse;
+
+	/* if the delay is "too large" increase cycle length */
+	if ((delay != 0) && (delay < length / (length - width)))
+		offset /= delay;
+
+	/* reverse direction every length ticks */
+	reverse = (offset / length) & 1;
+
+	/* restrict offset to cycle length */
+	offset %= length;
+	offset = max(offset, 0);
+
+	/* if the delay is "low enough" slow down as requested */
+	if ((delay != 0) && (delay >= length / (length - width)))
+		offset /= delay;
+
+	/* restrict offset to the max. allowed offset: length - width */
+	offset = min(offset, length - width);
+
+	/* scroll backward by mirroring offset at max. offset */
+	if (reverse)
+		offset = (length - width) - offset;
+
+	return offset;
+}
+
+
+/* Counterpart of render_scroller() for render_frame_moves(): the scrolling
+ * position of a scroller, 0 if it does not scroll */
+static int
+render_scroller_position(Widget *w, long timer)
+{
+	int screen_width;
+	int length;
+
+	if ((w->text == NULL) || (w->right < w->left))
+		return 0;
+
+	screen_width = abs(w->right - w->left + 1);
+	screen_width = min(screen_width, BUFSIZE - 1);
+
+	if (render_layout(w, screen_width) == NULL)
+		return 0;
+
+	switch (w->length) {
+	case 'm':
+		length = w->text_length;
+		if (length <= screen_width)
+			return 0;
+		return render_marquee_offset(length + screen_width / 2, w->speed, timer);
+	case 'h':
+		length = w->text_length + 1;
+		if (length <= screen_width)
+			return 0;
+		return render_pingpong_offset(length - screen_width, w->speed, timer);
+	case 'v':
+		length = w->text_length;
+		if (length > screen_width) {
+			int lines_required = (length / screen_width)
+				 + (length % screen_width ? 1 : 0);
+			int available_lines = (w->bottom - w->top + 1);
+
+			if (lines_required > available_lines)
+				return render_pingpong_offset(lines_required - available_lines + 1,
+							      w->speed, timer);
+		}
+		return 0;
+	}
+	return 0;
+}
+
+
+/* Offset of a marquee scroller: length includes the gap between the end
+ * and the beginning of the text */
+static int
+render_marquee_offset(int length, int speed, long timer)
+{
+	if (speed > 0)
+		return (timer % (length * speed)) / speed;
+	else if (speed < 0)
+		return (timer % (length / (speed * -1))) * speed * -1;
+	return 0;
+}
+
+
+/* Offset of a scroller that wiggles back and forth over the given number
+ * of steps */
+static int
+render_pingpong_offset(int steps, int speed, long timer)
+{
+	int units;
+
+	if (speed > 0) {
+		units = steps * speed;
+		if (((timer / units) % 2) == 0) {
+			/* wiggle one way */
+			return (timer % units) / speed;
+		}
+		/* wiggle the other */
+		return (((timer % units) - units + 1) / speed) * -1;
+	}
+	else if (speed < 0) {
+		units = steps / (speed * -1);
+		if (((timer / units) % 2) == 0)
+			return (timer % units) * speed * -1;
+		return (((timer % units) * speed * -1) - steps + 1) * -1;
+	}
+	return 0;
+}
+
+
 static void render_num(Widget *w, int left, int top, int right, int bottom)
 {
 	debug(RPT_DEBUG, "%s(w=%p, left=%d, top=%d, right=%d, bottom=%d)",
@@ -40,6 +40,30 @@ extern int output_state;
 /* Render the given screen. */
 int render_screen(Screen *s, long timer);
 
+/* Render the given screen, but leave the flush to the caller. */
+int render_screen_frame(Screen *s, long timer);
+
+/* Tell whether the display shows the screen with all its changes. */
+int render_screen_shown(Screen *s);
+
+/* Render a screen ahead, for the given timer value. */
+void render_prepare(Screen *s, long timer);
+
+/* Tell whether the screen's appearance changes with the timer. */
+int render_screen_animated(Screen *s);
+
+/* Tell for how many ticks after timer the screen would render the same. */
+long render_screen_idle_ticks(Screen *s, long timer);
+
+/* Force the next frame to be rendered even if nothing changed. */
+void render_invalidate(void);
+
+/* Select the display the screens are rendered for. */
+void render_select_display(int display);
+
+/* Free the display list of a screen about to be destroyed. */
+void render_forget_screen(Screen *s);
+
 /* Display a short message, which must be shorter than 16 chars, in a corner */
 int server_msg(const char *text, int expire);
 
@@ -19,6 +19,8 @@
 #include <string.h>
 
 #include "shared/report.h"
+#include "shared/sockets.h"
+#include "shared/intern.h"
 
 #include "drivers.h"
 
@@ -31,6 +33,7 @@
 
 int  default_duration = 0;
 int  default_timeout  = -1;
+unsigned long screen_layout_serial = 0;
 
 char *pri_names[] = {
 	"hidden",
@@ -49,9 +52,11 @@ char *pri_names[] = {
  * \return        Pointer to freshly created screen.
  */
 Screen *
-screen_create(char *id, Client *client)
+screen_create(const char *id, Client *client)
 {
 	Screen *s;
+	Pool *pool = (client != NULL) ? client->pool : NULL;
+	DisplayProps *props;
 
 	debug(RPT_DEBUG, "%s(id=\"%.40s\", client=[%d])",
 		 __FUNCTION__, id, (client?client->sock:-1));
@@ -62,24 +67,29 @@ screen_create(char *id, Client *client)
 	}
 	/* Client can be NULL for serverscreens and other client-less screens */
 
-	s = calloc(sizeof(Screen), 1);
+	s = pool_calloc(pool, sizeof(Screen));
 	if (s == NULL) {
 		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
 		return NULL;
 	}
 
-	s->id = strdup(id);
+	/* ids like those of widgets repeat over clients, they are shared */
+	s->id = intern_get_charged(id, (client != NULL) ? &client->strings : NULL);
 	if (s->id == NULL) {
 		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
-		free(s);
+		pool_free(pool, s);
 		return NULL;
 	}
 
 	s->priority = PRI_INFO;
 	s->duration = default_duration;
 	s->heartbeat = HEARTBEAT_OPEN;
-	s->width = display_props->width;
-	s->height = display_props->height;
+	s->display = (client != NULL) ? client->display : 0;
+	props = drivers_display_props(s->display);
+	if (props == NULL)
+		props = display_props;
+	s->width = props->width;
+	s->height = props->height;
 	s->client = client;
 	s->timeout = default_timeout; 	/*ignored unless greater than 0.*/
 	s->backlight = BACKLIGHT_OPEN;		/*Lets the screen do it's own*/
@@ -87,12 +97,23 @@ screen_create(char *id, Client *client)
 	s->cursor = CURSOR_OFF;
 	s->cursor_x = 1;
 	s->cursor_y = 1;
+	s->dirty = 1;
+	s->update_interval = 0;
 
-	s->widgetlist = LL_new();
+	s->widgetlist = V_new();
 	if (s->widgetlist == NULL) {
 		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
-		free(s->id);
-		free(s);
+		intern_put_charged(s->id, (client != NULL) ? &client->strings : NULL);
+		pool_free(pool, s);
+		return NULL;
+	}
+
+	s->widgethash = HT_new();
+	if (s->widgethash == NULL) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		V_Destroy(s->widgetlist);
+		intern_put_charged(s->id, (client != NULL) ? &client->strings : NULL);
+		pool_free(pool, s);
 		return NULL;
 	}
 
@@ -102,6 +123,94 @@ screen_create(char *id, Client *client)
 }
 
 
+/** Create a copy of a screen with all its attributes and widgets, which
+ * keep their values. Cheaper for a client than building many screens of
+ * the same layout one command at a time.
+ * \param src  Screen to copy.
+ * \param id   Id of the new screen.
+ * \return     The new screen, not yet added to its client; NULL on error.
+ */
+Screen *
+screen_clone(Screen *src, const char *id)
+{
+	Screen *s = screen_create(id, src->client);
+	Widget *w;
+	int i;
+
+	if (s == NULL)
+		return NULL;
+
+	s->display = src->display;
+	s->width = src->width;
+	s->height = src->height;
+	s->duration = src->duration;
+	s->timeout = src->timeout;
+	s->priority = src->priority;
+	s->heartbeat = src->heartbeat;
+	s->backlight = src->backlight;
+	s->cursor = src->cursor;
+	s->cursor_x = src->cursor_x;
+	s->cursor_y = src->cursor_y;
+	s->update_interval = src->update_interval;
+
+	if ((src->name != NULL) && ((s->name = strdup(src->name)) == NULL))
+		goto fail;
+	if (src->keys_size > 0) {
+		s->keys = malloc(src->keys_size * sizeof(int));
+		if (s->keys == NULL)
+			goto fail;
+		memcpy(s->keys, src->keys, src->keys_size * sizeof(int));
+		s->keys_size = src->keys_size;
+	}
+
+	for (i = 0; (w = V_Get(src->widgetlist, i)) != NULL; i++) {
+		Widget *copy = widget_clone(w, s);
+
+		if (copy == NULL) {
+			screen_destroy(s);
+			return NULL;
+		}
+		if (screen_add_widget(s, copy) < 0) {
+			widget_destroy(copy);
+			screen_destroy(s);
+			return NULL;
+		}
+	}
+	return s;
+
+fail:
+	report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+	screen_destroy(s);
+	return NULL;
+}
+
+
+/**
+ * Tell how much memory a client's screen holds: the screen and its id in
+ * the client's pool, its name and keys. The memory of its widgets is added
+ * to \c widgets.
+ * \param s        The screen.
+ * \param widgets  Where to add the memory of the widgets.
+ * \return  Bytes held by the screen itself.
+ */
+size_t
+screen_memory(Screen *s, size_t *widgets)
+{
+	Pool *pool = (s->client != NULL) ? s->client->pool : NULL;
+	Widget *w;
+	size_t size;
+	int i;
+
+	size = pool_usable_size(pool, s) + s->keys_size * sizeof(int);
+	if (s->name != NULL)
+		size += strlen(s->name) + 1;
+
+	for (i = 0; (w = V_Get(s->widgetlist, i)) != NULL; i++)
+		*widgets += widget_memory(w);
+	return size;
+}
+
+
 /** Destroy a screen.
  * \param s    Screen to destroy.
  */
@@ -109,21 +218,24 @@ void
 screen_destroy(Screen *s)
 {
 	Widget *w;
+	int i;
+	Pool *pool = (s->client != NULL) ? s->client->pool : NULL;
 
 	debug(RPT_DEBUG, "%s(s=[%.40s])", __FUNCTION__, s->id);
 
 	menuscreen_remove_screen(s);
 
 	screenlist_remove(s);
+	render_forget_screen(s);
 
-	for (w = LL_GetFirst(s->widgetlist); w; w = LL_GetNext(s->widgetlist)) {
+	for (i = 0; (w = V_Get(s->widgetlist, i)) != NULL; i++) {
 		/* Free a widget...*/
 		widget_destroy(w);
 	}
-	LL_Destroy(s->widgetlist);
+	V_Destroy(s->widgetlist);
+	HT_Destroy(s->widgethash);
 
-	if (s->id != NULL)
-		free(s->id);
+	intern_put_charged(s->id, (s->client != NULL) ? &s->client->strings : NULL);
 
 	if (s->name != NULL)
 		free(s->name);
@@ -131,7 +243,7 @@ screen_destroy(Screen *s)
 	if (s->keys != NULL)
 		free(s->keys);
 
-	free(s);
+	pool_free(pool, s);
 }
 
 
@@ -146,7 +258,19 @@ screen_add_widget(Screen *s, Widget *w)
 {
 	debug(RPT_DEBUG, "%s(s=[%.40s], widget=[%.40s])", __FUNCTION__, s->id, w->id);
 
-	LL_Push(s->widgetlist, (void *) w);
+	if (HT_Insert(s->widgethash, w->id, (void *) w) < 0) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		return -1;
+	}
+	if (V_Append(s->widgetlist, (void *) w) < 0) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		HT_Remove(s->widgethash, w->id, (void *) w);
+		return -1;
+	}
+	if (w->type == WID_FRAME)
+		s->frames++;
+	s->dirty = 1;
+	screen_layout_serial++;
 
 	return 0;
 }
@@ -163,19 +287,85 @@ screen_remove_widget(Screen *s, Widget *w)
 {
 	debug(RPT_DEBUG, "%s(s=[%.40s], widget=[%.40s])", __FUNCTION__, s->id, w->id);
 
-	LL_Remove(s->widgetlist, (void *) w, NEXT);
+	V_Remove(s->widgetlist, (void *) w);
+	HT_Remove(s->widgethash, w->id, (void *) w);
+	if (w->type == WID_FRAME)
+		s->frames--;
+	s->dirty = 1;
+	screen_layout_serial++;
 
 	return 0;
 }
 
 
+/** Move a screen to another display. It takes on the size of that display,
+ * if known, and leaves the rotation of its old display for that of the
+ * new one.
+ * \param s        The screen.
+ * \param display  Number of the display, see drivers_display_find().
+ * \retval <0  Error.
+ * \retval  0  Success.
+ */
+int
+screen_set_display(Screen *s, int display)
+{
+	DisplayProps *props = drivers_display_props(display);
+
+	debug(RPT_DEBUG, "%s(s=[%.40s], display=%d)", __FUNCTION__, s->id, display);
+
+	if (display == s->display)
+		return 0;
+	if (screenlist_move(s, display) < 0)
+		return -1;
+	if (props != NULL) {
+		s->width = props->width;
+		s->height = props->height;
+	}
+	/* the frames are clipped to the display it is on */
+	s->dirty = 1;
+	screen_layout_serial++;
+
+	return 0;
+}
+
+
+/** Note that the screen's client changed it with a command. If the client
+ * asked for it with client_set -frameack, it is sent a \c flushed
+ * notification once the changes are shown, see screen_send_flushed().
+ * \param s  The screen.
+ */
+void
+screen_changed_by_client(Screen *s)
+{
+	if ((s->client != NULL) && s->client->frame_ack)
+		s->ack_pending = 1;
+}
+
+
+/** Tell the screen's client that a frame showing the screen with all its
+ * changes was flushed, if it waits for that. A client gets one
+ * notification per screen and frame, however many commands changed it.
+ * \param s      The screen on the display.
+ * \param frame  The tick the frame was rendered at.
+ */
+void
+screen_send_flushed(Screen *s, long frame)
+{
+	if (!s->ack_pending)
+		return;
+	s->ack_pending = 0;
+	if ((s->client != NULL) && s->client->frame_ack)
+		sock_printf(s->client->sock, "flushed %s %ld\n", s->id, frame);
+}
+
+
 /** Find a widget on a screen by its id.
  * \param s   Screen where to look for the widget.
  * \param id  Identifier of the widget.
  * \return    Pointerr to the widget; \c NULL if widget was not found or error.
  */
 Widget *
-screen_find_widget(Screen *s, char *id)
+screen_find_widget(Screen *s, const char *id)
 {
 	Widget *w;
 
@@ -186,16 +376,23 @@ screen_find_widget(Screen *s, char *id)
 
 	debug(RPT_DEBUG, "%s(s=[%.40s], id=\"%.40s\")", __FUNCTION__, s->id, id);
 
-	for (w = LL_GetFirst(s->widgetlist); w != NULL; w = LL_GetNext(s->widgetlist)) {
-		if (0 == strcmp(w->id, id)) {
-			debug(RPT_DEBUG, "%s: Found %s", __FUNCTION__, id);
-			return w;
-		}
-		/* Search subscreens recursively */
-		if (w->type == WID_FRAME) {
-			w = widget_search_subs(w, id);
-			if (w != NULL)
-				return w;
+	w = HT_Find(s->widgethash, id);
+	if (w != NULL) {
+		debug(RPT_DEBUG, "%s: Found %s", __FUNCTION__, id);
+		return w;
+	}
+
+	/* Search subscreens recursively; only needed if there are any */
+	if (s->frames > 0) {
+		Widget *f;
+		int i;
+
+		for (i = 0; (f = V_Get(s->widgetlist, i)) != NULL; i++) {
+			if (f->type == WID_FRAME) {
+				w = widget_search_subs(f, id);
+				if (w != NULL)
+					return w;
+			}
 		}
 	}
 	debug(RPT_DEBUG, "%s: Not found", __FUNCTION__);
@@ -204,33 +401,22 @@ screen_find_widget(Screen *s, char *id)
 
 /** Test if a key is used by a screen.
  * \param s   Screen
- * \param key Name of the key
- * \return    Pointer to the entry in the key list; \c NULL if key is not used.
+ * \param key Id of the key, see input_key_id()
+ * \return    Index of the key in the key list; -1 if key is not used.
  */
-char *
-screen_find_key(Screen *s, const char *key)
+int
+screen_find_key(Screen *s, int key)
 {
-	char *start = s->keys, *end;
-	int len = strlen(key);
-
-	if (!start)
-		return NULL;
+	int i;
 
-	end = start + s->keys_size - len;
-	while (start < end) {
-		if (start[len] == 0) {
-			if (strcmp(start, key) == 0)
-				return start;
-			else
-				start += len;
-		}
+	if (key < 0)
+		return -1;
 
-		while (*start)  /* Get to start of next string */
-			++start;
-		++start;
+	for (i = 0; i < s->keys_size; i++) {
+		if (s->keys[i] == key)
+			return i;
 	}
-
-	return NULL;
+	return -1;
 }
 
 
@@ -25,6 +25,8 @@
 #define SCREEN_H_TYPES
 
 #include "shared/LL.h"
+#include "shared/vector.h"
+#include "shared/hash.h"
 
 #ifdef INC_TYPES_ONLY
 # include "client.h"
@@ -39,7 +41,7 @@ typedef enum {	PRI_HIDDEN, PRI_BACKGROUND, PRI_INFO, PRI_FOREGROUND,
 } Priority;
 
 typedef struct Screen {
-	char *id;
+	const char *id;		/**< Interned, see shared/intern.h */
 	char *name;
 	int width, height;
 	int duration;
@@ -50,15 +52,30 @@ typedef struct Screen {
 	short int cursor;
 	short int cursor_x;
 	short int cursor_y;
-	char *keys;
-	int keys_size;
-	LinkedList *widgetlist;
+	int *keys;		/**< Ids of the keys asked for with key_add,
+				 *   see input_key_id() */
+	int keys_size;		/**< Number of keys */
+	Vector *widgetlist;
+	HashTable *widgethash;	/**< Index of widgetlist by widget id */
+	int frames;		/**< Number of frame widgets in widgetlist */
 	struct Client *client;
+	int handle;		/**< Numeric handle within the client; 0 if none */
+	int display;		/**< Display it is shown on, see screenlist_move() */
+	short int dirty;	/**< Attributes or widget list changed since the
+				 *   screen was last rendered */
+	struct RenderList *render_list;	/**< Display list, see render.c */
+	int update_interval;	/**< Fewest frames between renders for widget
+				 *   changes; 0 = no limit */
+	short int ack_pending;	/**< Changed by a client that wants to be told
+				 *   when its changes are shown */
 } Screen;
 
 extern int  default_duration ;
 extern int  default_priority ;
 
+/** Increased whenever a widget list or a frame's geometry changes */
+extern unsigned long screen_layout_serial;
+
 #endif
 
 #ifndef INC_TYPES_ONLY
@@ -70,38 +87,51 @@ extern int  default_priority ;
 #undef INC_TYPES_ONLY
 
 /* Creates a new screen */
-Screen *screen_create(char *id, Client *client);
+Screen *screen_create(const char *id, Client *client);
+
+/* Creates a copy of a screen and its widgets */
+Screen *screen_clone(Screen *src, const char *id);
 
 /* Destroys a screen */
 void screen_destroy(Screen *s);
 
+/* Memory a client's screen and its widgets hold */
+size_t screen_memory(Screen *s, size_t *widgets);
+
 /* Add a widget to a screen */
 int screen_add_widget(Screen *s, Widget *w);
 
 /* Remove a widget from a screen (does not destroy it) */
 int screen_remove_widget(Screen *s, Widget *w);
 
+/* Move a screen to another display */
+int screen_set_display(Screen *s, int display);
+
+/* Note that a client changed the screen, for client_set -frameack */
+void screen_changed_by_client(Screen *s);
+
+/* Tell the client that the screen is shown with its changes */
+void screen_send_flushed(Screen *s, long frame);
+
 /* List functions */
-static inline Widget *screen_getfirst_widget(Screen *s)
+static inline Widget *screen_get_widget(Screen *s, int index)
 {
 	return (Widget *) ((s != NULL)
-			   ? LL_GetFirst(s->widgetlist)
+			   ? V_Get(s->widgetlist, index)
 			   : NULL);
 }
 
-static inline Widget *screen_getnext_widget(Screen *s)
+static inline Widget *screen_getfirst_widget(Screen *s)
 {
-	return (Widget *) ((s != NULL)
-			   ? LL_GetNext(s->widgetlist)
-			   : NULL);
+	return screen_get_widget(s, 0);
 }
 
 
 /* Find a widget in a screen */
-Widget *screen_find_widget(Screen *s, char *id);
+Widget *screen_find_widget(Screen *s, const char *id);
 
 /* Test if key is used by screen */
-char *screen_find_key(Screen *s, const char *key);
+int screen_find_key(Screen *s, int key);
 
 /* Convert priority names to priority and vv */
 Priority screen_pri_name_to_pri(char *pri_name);
@@ -1,6 +1,17 @@
 /** \file server/screenlist.c
  * All actions that can be performed on the list of screens.
  * This file also manages the rotation of screens.
+ *
+ * The list is kept sorted by priority class, highest first. Screens are
+ * inserted at the end of their class, so screens of equal priority rotate
+ * in the order they were added. Whoever changes the priority of a listed
+ * screen has to call screenlist_update() to move it to its new place.
+ *
+ * Every display has a list of its own, with its own current screen and
+ * rotation. A screen is in the list of the display it is on. Functions
+ * that are about a screen work on its display's list, the others on the
+ * list of the display selected with screenlist_select(), which is the main
+ * display except while the main loop renders the others.
  */
 
 /* This file is part of LCDd, the lcdproc server.
@@ -15,9 +26,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-#include "shared/LL.h"
+#include "shared/vector.h"
 #include "shared/sockets.h"
 #include "shared/report.h"
+#include "shared/defines.h"
 
 #include "client.h"
 #include "screen.h"
@@ -25,13 +37,48 @@
 
 #include "main.h" /* for timer */
 
+/** The screens of a display and its rotation */
+typedef struct ScreenList {
+	Vector *screens;	/**< Its screens, sorted by priority class */
+	Screen *current;	/**< Screen shown */
+	long start_time;	/**< Timer when the current screen was switched to */
+	long timeout_counted;	/**< Timer up to which the current screen's timeout was counted down */
+} ScreenList;
+
 /* Local functions */
 int compare_priority(void *one, void *two);
+static ScreenList *screenlist_get(int display);
+static void screenlist_count_timeout(ScreenList *l);
+static long screenlist_timeout_left(ScreenList *l);
+static void screenlist_switch_in(ScreenList *l, Screen *s);
+static int screenlist_goto_next_in(ScreenList *l);
 
 int autorotate = UNSET_INT;	/* If on, INFO and FOREGROUND screens will rotate */
-LinkedList *screenlist = NULL;
-Screen *current_screen = NULL;
-long int current_screen_start_time = 0;
+static Vector *screenlists = NULL;	/**< The ScreenList of each display */
+static ScreenList *sl = NULL;		/**< The one of the selected display */
+
+
+/* Get the list of a display, adding lists up to it as needed */
+static ScreenList *
+screenlist_get(int display)
+{
+	ScreenList *l;
+
+	if ((screenlists == NULL) || (display < 0))
+		return NULL;
+	while ((l = V_Get(screenlists, display)) == NULL) {
+		l = calloc(1, sizeof(ScreenList));
+		if ((l == NULL) || ((l->screens = V_new()) == NULL)
+		    || (V_Append(screenlists, l) < 0)) {
+			report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+			if (l != NULL)
+				V_Destroy(l->screens);
+			free(l);
+			return NULL;
+		}
+	}
+	return l;
+}
 
 
 int
@@ -39,8 +86,8 @@ screenlist_init(void)
 {
 	report(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	screenlist = LL_new();
-	if (!screenlist) {
+	screenlists = V_new();
+	if (!screenlists || ((sl = screenlist_get(0)) == NULL)) {
 		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
 		return -1;
 	}
@@ -51,47 +98,120 @@ screenlist_init(void)
 int
 screenlist_shutdown(void)
 {
+	ScreenList *l;
+
 	report(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	if (!screenlist) {
+	if (!screenlists) {
 		/* Program shutdown before completed startup */
 		return -1;
 	}
-	LL_Destroy(screenlist);
+	while ((l = V_Pop(screenlists)) != NULL) {
+		V_Destroy(l->screens);
+		free(l);
+	}
+	V_Destroy(screenlists);
+	screenlists = NULL;
+	sl = NULL;
 
 	return 0;
 }
 
 
+/**
+ * Select the display whose list the functions not about a given screen
+ * work on.
+ * \param display  The display's number.
+ */
+void
+screenlist_select(int display)
+{
+	ScreenList *l = screenlist_get(display);
+
+	if (l != NULL)
+		sl = l;
+}
+
+
 int
 screenlist_add(Screen *s)
 {
-	if (!screenlist)
+	ScreenList *l = screenlist_get(s->display);
+
+	if (!l)
+		return -1;
+	return V_SortedInsert(l->screens, s, compare_priority);
+}
+
+
+int
+screenlist_update(Screen *s)
+{
+	ScreenList *l = screenlist_get(s->display);
+
+	debug(RPT_DEBUG, "%s(s=[%.40s])", __FUNCTION__, s->id);
+
+	if (!l)
 		return -1;
-	return LL_Push(screenlist, s);
+
+	/* Screens that are not (yet) listed get sorted in when added */
+	if (V_Remove(l->screens, s) == NULL)
+		return 0;
+	return V_SortedInsert(l->screens, s, compare_priority);
 }
 
 
 int
 screenlist_remove(Screen *s)
 {
+	ScreenList *l = screenlist_get(s->display);
+
 	debug(RPT_DEBUG, "%s(s=[%.40s])", __FUNCTION__, s->id);
 
-	if (!screenlist)
+	if (!l)
 		return -1;
 
 	/* Are we trying to remove the current screen ? */
-	if (s == current_screen) {
-		screenlist_goto_next();
-		if (s == current_screen) {
+	if (s == l->current) {
+		screenlist_goto_next_in(l);
+		if (s == l->current) {
 			/* Hmm, no other screen had same priority */
-			void *res = LL_Remove(screenlist, s, NEXT);
+			void *res = V_Remove(l->screens, s);
 			/* And now once more */
-			screenlist_goto_next();
+			screenlist_goto_next_in(l);
 			return (res == NULL) ? -1 : 0;
 		}
 	}
-	return (LL_Remove(screenlist, s, NEXT) == NULL) ? -1 : 0;
+	return (V_Remove(l->screens, s) == NULL) ? -1 : 0;
+}
+
+
+/**
+ * Move a screen to another display. A listed screen leaves the rotation
+ * of its display for that of the other one.
+ * \param s        The screen.
+ * \param display  The display's number.
+ * \return  -1 on error, 0 on success.
+ */
+int
+screenlist_move(Screen *s, int display)
+{
+	ScreenList *l = screenlist_get(s->display);
+
+	if (display == s->display)
+		return 0;
+	if (!l || !screenlist_get(display))
+		return -1;
+
+	if (V_IndexOf(l->screens, s) < 0) {
+		/* it is sorted in when added */
+		s->display = display;
+		return 0;
+	}
+	if (screenlist_remove(s) < 0)
+		return -1;
+	s->display = display;
+	return screenlist_add(s);
 }
 
 
@@ -103,11 +223,10 @@ screenlist_process(void)
 
 	report(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	if (!screenlist)
+	if (!sl)
 		return;
-	/* Sort the list according to priority class */
-	LL_Sort(screenlist, compare_priority);
-	f = LL_GetFirst(screenlist);
+	/* The list is sorted, so this is a screen of the highest priority */
+	f = V_Get(sl->screens, 0);
 
 	/**** First we need to check out the current situation. ****/
 
@@ -128,10 +247,11 @@ screenlist_process(void)
 	else {
 		/* There already was an active screen.
 		 * Check to see if it has an expiry time. If so, decrease it
+		 * by the frames since it was last counted, skipped ones too,
 		 * and then check to see if it has expired. Remove the screen
 		 * if expired. */
 		if (s->timeout != -1) {
-			--(s->timeout);
+			screenlist_count_timeout(sl);
 			report(RPT_DEBUG, "Active screen [%.40s] has timeout->%d", s->id, s->timeout);
 			if (s->timeout <= 0) {
 				/* Expired, we can destroy it */
@@ -145,18 +265,16 @@ screenlist_process(void)
 	/**** OK, current situation examined. We can now see if we need to switch. */
 
 	/* Is there a screen of a higher priority class than the
-	 * current one ? */
-	if (f->priority > s->priority) {
-		/* Yes, switch to that screen, job done */
-		report(RPT_DEBUG, "%s: High priority screen [%.40s] selected", __FUNCTION__, f->id);
-		screenlist_switch(f);
+	 * current one ? Yes: switched to it, job done */
+	if (screenlist_raise())
+		return;
+	if ((s = screenlist_current()) == NULL)
 		return;
-	}
 
 	/* Current screen has been visible long enough and is it of 'normal'
 	 * priority ?
 	 */
-	if (autorotate && (timer - current_screen_start_time >= s->duration)
+	if (autorotate && (timer - sl->start_time >= s->duration)
 	&& s->priority > PRI_BACKGROUND && s->priority <= PRI_FOREGROUND) {
 		/* Ah, rotate! */
 		screenlist_goto_next();
@@ -164,26 +282,141 @@ screenlist_process(void)
 }
 
 
+/**
+ * Switch to the first screen of the list if it has a higher priority class
+ * than the current one, as screenlist_process() does. Unlike that, this
+ * does not count the frame, so it can be called between frames.
+ * \return  1 if it switched, 0 if not.
+ */
+int
+screenlist_raise(void)
+{
+	Screen *s = screenlist_current();
+	Screen *f;
+
+	if (!sl || ((f = V_Get(sl->screens, 0)) == NULL))
+		return 0;
+	if ((s != NULL) && (f->priority <= s->priority))
+		return 0;
+
+	report(RPT_DEBUG, "%s: High priority screen [%.40s] selected", __FUNCTION__, f->id);
+	screenlist_switch(f);
+	return 1;
+}
+
+
+/**
+ * Tell for how many upcoming frames screenlist_process() will not change
+ * anything, so that the main loop may skip them. Client activity is not
+ * accounted for: a client adding screens or changing priorities has to
+ * trigger processing on its own.
+ * \return  Number of frames without effect, 0 if the next frame needs
+ *          processing, or -1 if nothing will happen until clients act.
+ */
+long
+screenlist_idle_ticks(void)
+{
+	Screen *s = screenlist_current();
+	Screen *t;
+	long ticks;
+	int i;
+
+	long expire = -1;
+
+	if (!sl || !s)
+		return 0;
+
+	/* The frame that expires the screen is the one where its timeout
+	 * reaches 0 */
+	if (s->timeout != -1)
+		expire = max(screenlist_timeout_left(sl) - 1, 0);
+
+	if (!autorotate || s->priority <= PRI_BACKGROUND || s->priority > PRI_FOREGROUND)
+		return expire;
+
+	/* Rotation only has an effect if there is another screen of the
+	 * same priority to rotate to (see screenlist_goto_next()). */
+	for (i = 0; (t = V_Get(sl->screens, i)) != NULL; i++) {
+		if ((t != s) && (t->priority == s->priority))
+			break;
+	}
+	if (t == NULL)
+		return expire;
+
+	/* The timer is incremented before processing, so the frame that
+	 * rotates is the one where the condition first holds. */
+	ticks = max(s->duration - (timer - sl->start_time) - 1, 0);
+	return (expire >= 0) ? min(ticks, expire) : ticks;
+}
+
+
+/* Count down the timeout of the current screen by the frames since it was
+ * last counted */
+static void
+screenlist_count_timeout(ScreenList *l)
+{
+	Screen *s = l->current;
+
+	if ((s != NULL) && (s->timeout != -1))
+		s->timeout = screenlist_timeout_left(l);
+	l->timeout_counted = timer;
+}
+
+
+/* Tell how many frames the current screen has left before it expires,
+ * counting those since its timeout was last counted */
+static long
+screenlist_timeout_left(ScreenList *l)
+{
+	return max(l->current->timeout - (timer - l->timeout_counted), 0);
+}
+
+
+/**
+ * Start counting the timeout of a screen anew, after it was set: the
+ * frames before do not count.
+ * \param s  The screen.
+ */
+void
+screenlist_timeout_set(Screen *s)
+{
+	ScreenList *l = screenlist_get(s->display);
+
+	if ((l != NULL) && (s == l->current))
+		l->timeout_counted = timer;
+}
+
+
 void
 screenlist_switch(Screen *s)
+{
+	if (!s) return;
+
+	screenlist_switch_in(screenlist_get(s->display), s);
+}
+
+
+/* Switch to a screen of the given list */
+static void
+screenlist_switch_in(ScreenList *l, Screen *s)
 {
 	Client *c;
 	char str[256];
 
-	if (!s) return;
+	if (!l || !s) return;
 
 	report(RPT_DEBUG, "%s(s=[%.40s])", __FUNCTION__, s->id);
 
-	if (s == current_screen) {
+	if (s == l->current) {
 		/* Nothing to be done */
 		return;
 	}
 
-	if (current_screen) {
-		c = current_screen->client;
+	if (l->current) {
+		c = l->current->client;
 		if (c) {
 			/* Tell the client we're not listening any more...*/
-			snprintf(str, sizeof(str), "ignore %s\n", current_screen->id);
+			snprintf(str, sizeof(str), "ignore %s\n", l->current->id);
 			sock_send_string(c->sock, str);
 		} else {
 			/* It's a server screen, no need to inform it. */
@@ -198,71 +431,132 @@ screenlist_switch(Screen *s)
 		/* It's a server screen, no need to inform it. */
 	}
 	report(RPT_INFO, "%s: switched to screen [%.40s]", __FUNCTION__, s->id);
-	current_screen = s;
-	current_screen_start_time = timer;
+	/* the timeout of the screen left only counts while it is shown */
+	screenlist_count_timeout(l);
+	l->current = s;
+	l->start_time = timer;
 }
 
 
 Screen *
 screenlist_current(void)
 {
-	return current_screen;
+	return (sl != NULL) ? sl->current : NULL;
 }
 
 
-int
-screenlist_goto_next(void)
+/**
+ * Get the screen shown on a display, whichever is selected.
+ * \param display  The display's number.
+ * \return  Its current screen, or NULL if there is none.
+ */
+Screen *
+screenlist_current_on(int display)
 {
-	Screen *s;
+	ScreenList *l = V_Get(screenlists, display);
 
-	debug(RPT_DEBUG, "%s()", __FUNCTION__);
+	return (l != NULL) ? l->current : NULL;
+}
 
-	if (!current_screen)
-		return -1;
 
-	/* Find current screen in screenlist */
-	for (s = LL_GetFirst(screenlist); s && s != current_screen; s = LL_GetNext(screenlist))
-		;
+/* Find the screen following the current one in the rotation */
+static Screen *
+screenlist_following(ScreenList *l)
+{
+	Screen *s;
 
-	/* One step forward */
-	s = LL_GetNext(screenlist);
-	if (!s || s->priority < current_screen->priority) {
+	/* One step forward from the current screen */
+	s = V_Get(l->screens, V_IndexOf(l->screens, l->current) + 1);
+	if (!s || s->priority < l->current->priority) {
 		/* To far, go back to start of screenlist */
-		s = LL_GetFirst(screenlist);
+		s = V_Get(l->screens, 0);
 	}
-	screenlist_switch(s);
+	return s;
+}
+
+
+/**
+ * Tell which screen the rotation switches to next, and when, so that it
+ * can be rendered ahead. Client activity is not accounted for, just like
+ * in screenlist_idle_ticks().
+ * \param when  Receives the timer value of the frame that switches.
+ * \return  The next screen; NULL if no rotation is coming up.
+ */
+Screen *
+screenlist_next_rotation(long *when)
+{
+	Screen *s = screenlist_current();
+	Screen *n;
+
+	if (!sl || !s)
+		return NULL;
+	if (!autorotate || s->priority <= PRI_BACKGROUND || s->priority > PRI_FOREGROUND)
+		return NULL;
+	/* a screen of a higher priority class would be switched to first */
+	if (((Screen *) V_Get(sl->screens, 0))->priority > s->priority)
+		return NULL;
+
+	n = screenlist_following(sl);
+	if ((n == NULL) || (n == s))
+		return NULL;
+
+	/* see screenlist_process() */
+	*when = max(sl->start_time + s->duration, timer + 1);
+	/* a screen expiring first is removed instead */
+	if ((s->timeout != -1) && (timer + screenlist_timeout_left(sl) <= *when))
+		return NULL;
+	return n;
+}
+
+
+/* Move on to the next screen of the given list */
+static int
+screenlist_goto_next_in(ScreenList *l)
+{
+	debug(RPT_DEBUG, "%s()", __FUNCTION__);
+
+	if (!l || !l->current)
+		return -1;
+
+	screenlist_switch_in(l, screenlist_following(l));
 	return 0;
 }
 
 
+int
+screenlist_goto_next(void)
+{
+	return screenlist_goto_next_in(sl);
+}
+
+
 int
 screenlist_goto_prev(void)
 {
 	Screen *s;
+	int i;
 
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	if (!current_screen)
+	if (!sl || !sl->current)
 		return -1;
 
-	/* Find current screen in screenlist */
-	for (s = LL_GetFirst(screenlist); s && s != current_screen; s = LL_GetNext(screenlist));
-
-	/* One step back */
-	s = LL_GetPrev(screenlist);
+	/* One step back from the current screen */
+	i = V_IndexOf(sl->screens, sl->current);
+	s = (i > 0) ? V_Get(sl->screens, i - 1) : NULL;
 	if (!s) {
 		/* We're at the start of the screenlist. We should find the
 		 * last screen with the same priority as the first screen.
 		 */
-		Screen *f = LL_GetFirst(screenlist);
+		Screen *f = V_Get(sl->screens, 0);
 		Screen *n;
 
 		s = f;
-		while ((n = LL_GetNext(screenlist)) && n->priority == f->priority) {
+		for (i = 1; (n = V_Get(sl->screens, i)) && n->priority == f->priority; i++) {
 			s = n;
 		}
 	}
-	screenlist_switch(s);
+	screenlist_switch_in(sl, s);
 	return 0;
 }
 
@@ -29,16 +29,39 @@ int screenlist_init(void);
 int screenlist_shutdown(void);
 	/* Shuts down the screenlist. */
 
+void screenlist_select(int display);
+	/* Selects the display whose screenlist the functions below that do
+	 * not take a screen work on. */
+
 int screenlist_add(Screen *s);
 	/* Adds a screen to the screenlist. */
 
 int screenlist_remove(Screen *s);
 	/* Removes a screen from the screenlist. */
 
+int screenlist_move(Screen *s, int display);
+	/* Moves a screen to the screenlist of another display. */
+
+int screenlist_update(Screen *s);
+	/* Moves a screen to its place in the screenlist after its priority
+	 * has been changed. */
+
 void screenlist_process(void);
 	/* Processes the screenlist. Decides if we need to switch to an other
 	 * screen. */
 
+void screenlist_timeout_set(Screen *s);
+	/* Starts counting down the timeout of a screen anew after it was
+	 * set. */
+
+int screenlist_raise(void);
+	/* Switches to the first screen if its priority is higher than the
+	 * current one's, without counting a frame. */
+
+long screenlist_idle_ticks(void);
+	/* Returns the number of frames screenlist_process() will not act
+	 * on, or -1 if it has nothing to do until clients change something. */
+
 void screenlist_switch(Screen *s);
 	/* Switches to an other screen in the proper way. Informs clients of
 	 * the switch. ALWAYS USE THIS FUNCTION TO SWITCH SCREENS. */
@@ -46,6 +69,13 @@ void screenlist_switch(Screen *s);
 Screen *screenlist_current(void);
 	/* Returns the currently active screen. */
 
+Screen *screenlist_current_on(int display);
+	/* Returns the currently active screen of a display. */
+
+Screen *screenlist_next_rotation(long *when);
+	/* Returns the screen the rotation switches to next and when, or
+	 * NULL if no rotation is coming up. */
+
 int screenlist_goto_next(void);
 	/* Moves on to the next screen. */
 
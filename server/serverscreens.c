@@ -47,6 +47,8 @@ int rotate_server_screen = UNSET_INT;
 
 /* file-local variables */
 static int has_hello_msg = 0;
+static unsigned long shown_serial = 0;	/**< clients_serial the screen shows */
+static int shown_valid = 0;		/**< Whether shown_serial is set */
 
 /* file-local function declarations */
 static int reset_server_screen(int rotate, int heartbeat, int title);
@@ -64,6 +66,7 @@ server_screen_init(void)
 	int i;
 
 	has_hello_msg = config_has_key("Server", "Hello");
+	shown_valid = 0;
 
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
@@ -132,10 +135,32 @@ server_screen_shutdown(void)
 }
 
 
+/**
+ * Set the text of a line on the server screen, marking the widget for
+ * rendering only if the text changes.
+ * \param id    Id of the line widget.
+ * \param text  New text.
+ */
+static void
+set_server_screen_line(const char *id, const char *text)
+{
+	Widget *w = screen_find_widget(server_screen, (char *) id);
+
+	if ((w != NULL) && (w->text != NULL) && (strcmp(w->text, text) != 0)) {
+		strncpy(w->text, text, LCD_MAX_WIDTH);
+		w->text[LCD_MAX_WIDTH - 1] = '\0';
+		w->dirty = 1;
+	}
+}
+
+
 /**
  * Print the numbers of connected clients and screens on the server screen
  * unless screen is set to be blank. If a custom hello message has been set
  * it is shown until the first client connects.
+ *
+ * Nothing is done unless clients or screens came or went since the last
+ * call (see clients_serial), so calling this on every frame is cheap.
  * \return  Always 0.
  */
 int
@@ -143,10 +168,14 @@ update_server_screen(void)
 {
 	static int hello_done = 0;
 	Client *c;
-	Widget *w;
 	int num_clients = 0;
 	int num_screens = 0;
 
+	if (shown_valid && (shown_serial == clients_serial))
+		return 0;
+	shown_serial = clients_serial;
+	shown_valid = 1;
+
 	/* get info on the number of connected clients...*/
 	num_clients = clients_client_count();
 
@@ -170,34 +199,28 @@ update_server_screen(void)
 	}
 
 	/* ... and screens */
-	for (c = clients_getfirst(); c != NULL; c = clients_getnext()) {
+	for (c = clients_getfirst(); c != NULL; c = clients_getnext(c)) {
 		num_screens += client_screen_count(c);
 	}
 
 	/* update statistics if we do not only want to show a blank screen */
 	if (rotate_server_screen != SERVERSCREEN_BLANK) {
 		/* format strings for the appropriate display size ... */
+		char line[LCD_MAX_WIDTH];
+
 		if (display_props->height >= 3) {	/* >2-line display */
-			w = screen_find_widget(server_screen, "line2");
-			if ((w != NULL) && (w->text != NULL)) {
-				snprintf(w->text, LCD_MAX_WIDTH,
-						"Clients: %i", num_clients);
-			}
+			snprintf(line, LCD_MAX_WIDTH, "Clients: %i", num_clients);
+			set_server_screen_line("line2", line);
 
-			w = screen_find_widget(server_screen, "line3");
-			if ((w != NULL) && (w->text != NULL)) {
-				snprintf(w->text, LCD_MAX_WIDTH,
-						"Screens: %i", num_screens);
-			}
+			snprintf(line, LCD_MAX_WIDTH, "Screens: %i", num_screens);
+			set_server_screen_line("line3", line);
 		} else {				/* 2-line display */
-			w = screen_find_widget(server_screen, "line2");
-			if ((w != NULL) && (w->text != NULL)) {
-				snprintf(w->text, LCD_MAX_WIDTH,
-						((display_props->width >= 16)
-						 ? "Cli: %i  Scr: %i"
-						 : "C: %i  S: %i"),
-						num_clients, num_screens);
-			}
+			snprintf(line, LCD_MAX_WIDTH,
+					((display_props->width >= 16)
+					 ? "Cli: %i  Scr: %i"
+					 : "C: %i  S: %i"),
+					num_clients, num_screens);
+			set_server_screen_line("line2", line);
 		}
 	}
 	return 0;
@@ -274,6 +297,8 @@ reset_server_screen(int rotate, int heartbeat, int title)
 					? HEARTBEAT_OPEN : HEARTBEAT_OFF;
 	server_screen->priority = (rotate == SERVERSCREEN_ON)
 					? PRI_INFO : PRI_BACKGROUND;
+	server_screen->dirty = 1;
+	screenlist_update(server_screen);
 
 	for (i = 0; i < display_props->height; i++) {
 		char id[8];
@@ -20,6 +20,9 @@
 #ifdef HAVE_CONFIG_H
 # include "config.h"
 #endif
+#ifdef HAVE_ACCEPT4
+# define _GNU_SOURCE		/* for accept4() */
+#endif
 
 #include <unistd.h>
 #include <stddef.h>
@@ -35,19 +38,34 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <fcntl.h>
-#include <string.h>
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#ifdef HAVE_LIBZ
+# include <zlib.h>
+#endif
 
 #include "shared/report.h"
 #include "shared/sring.h"
 #include "shared/defines.h"
+#include "shared/configfile.h"
 
 #include "clients.h"
+#include "poller.h"
 #include "sock.h"
+#include "trace.h"
+#include "flightrec.h"
 
 
 /****************************************************************************/
-static fd_set active_fd_set, read_fd_set;
 static int listening_fd;
+static int unix_fd = -1;		/* Listening UNIX domain socket, if any */
+static char *unix_path = NULL;		/* Its path in the file system */
+
+/* Size of the socket pool. Derived from the descriptor limit, but capped to
+ * keep the pool small on systems with a huge or unlimited limit. */
+#define MAX_SOCKETS 16384
+static int max_sockets = FD_SETSIZE;
 
 /* For efficiency we maintain a list of open sockets. Nodes in this list
  * are obtained from a pre-allocated pool - this removes heap operations
@@ -56,14 +74,28 @@ static int listening_fd;
 static LinkedList* openSocketList = NULL;
 static LinkedList* freeClientSocketList = NULL;
 
-/* ring buffer for incoming messages */
-static sring_buffer *messageRing;
-
 /** Mapping between socket and associated client */
 typedef struct _ClientSocketMap
 {
 	int socket;		/**< Socket for the client */
 	Client *client;		/**< Pointer to client representation */
+	sring_buffer *messageRing;	/**< Received data not yet split into messages */
+	char *outBuffer;	/**< Data queued for sending */
+	int outSize;		/**< Allocated size of outBuffer */
+	int outStart;		/**< Offset of the first unsent byte */
+	int outEnd;		/**< Offset behind the last queued byte */
+	int events;		/**< Events the poller watches for */
+	int throttled;		/**< Input is not read until the output drains */
+	int inputFull;		/**< Input is not read until the client's messages are parsed */
+	int closePending;	/**< Close the socket with the next poll */
+	int inflateHeld;	/**< Reading stopped with data left in the inflater */
+	int eventsStale;	/**< Events changed while the poller was busy, see sock_wait_begin() */
+	int corked;		/**< Replies are gathered while its messages are parsed */
+	int holding;		/**< Replies are held back, see sock_client_hold_replies() */
+	char heldError[128];	/**< First error reply held back */
+#ifdef HAVE_LIBZ
+	struct _Inflater *inflater;	/**< Inflates the input after "hello deflate", or NULL */
+#endif
 } ClientSocketMap;
 
 
@@ -71,13 +103,106 @@ typedef struct _ClientSocketMap
  * is obtained from the freeClientSocketPool array. */
 ClientSocketMap *freeClientSocketPool;
 
+/* Sockets reported ready by the poller. sock_wait() leaves its result here
+ * for the following sock_poll_clients(), which then does not need to poll
+ * again. readyCount is -1 if no result is stored. */
+static ClientSocketMap **readySockets = NULL;
+static int readyCount = -1;
+
+/* Lookup of open sockets by descriptor, for descriptors below max_sockets */
+static ClientSocketMap **socketByFd = NULL;
+
+/* Marker the poller reports for descriptors of input drivers; their keys
+ * are read by the drivers, sock_poll_clients() skips it */
+static ClientSocketMap keyInputEntry;
+
+/* Number of sockets waiting to be closed by sock_poll_clients() */
+static int pendingCloses = 0;
+
+/* Number of sockets whose reading stopped with data left in the inflater.
+ * The poller does not know about that data: sock_poll_clients() reads
+ * them again once they take input. */
+static int heldInflates = 0;
+
+/* Between sock_wait_begin() and sock_wait_end() the poller belongs to a
+ * thread waiting in sock_wait() without the server lock. Output queued
+ * meanwhile does not change the poller: the socket's events are updated
+ * by sock_wait_end(), and the waiting thread is woken up through the wake
+ * pipe to do so. */
+static int pollerBusy = 0;
+static int staleEvents = 0;
+static int wakePipe[2] = { -1, -1 };
+
+/* Marker the poller reports for the wake pipe */
+static ClientSocketMap wakeEntry;
+
+/* Output queued to a client that does not read it is limited to
+ * output_limit bytes. Beyond that the client is either disconnected or
+ * throttled: its input is not read until the queue has drained to half
+ * the limit. A throttled client is still disconnected at 4 times the limit. */
+#define DEFAULT_OUTPUT_LIMIT	65536
+#define OVERFLOW_DISCONNECT	0
+#define OVERFLOW_THROTTLE	1
+static int output_limit = DEFAULT_OUTPUT_LIMIT;
+static int output_overflow = OVERFLOW_DISCONNECT;
+
+/* Messages received from a client but not yet parsed are limited to
+ * input_limit bytes. Beyond that the client's socket is not read until
+ * the parser has worked the queue down to half the limit; the sender is
+ * then held back by TCP flow control instead of filling the server. */
+#define DEFAULT_INPUT_LIMIT	65536
+static int input_limit = DEFAULT_INPUT_LIMIT;
+
+/* TCP connections of clients that are silent for keepalive_idle seconds
+ * are probed by the kernel, so that a client that went away without
+ * closing its connection is noticed without it having to send noops. */
+static int keepalive_idle = SOCK_KEEPALIVE_IDLE;
+
+/* Connections the kernel queues for the listening sockets until they are
+ * accepted. Many clients reconnecting at once, e.g. after a restart of
+ * LCDd, would otherwise be refused or have to retry. */
+#define DEFAULT_LISTEN_BACKLOG	64
+static int listen_backlog = DEFAULT_LISTEN_BACKLOG;
+
 
 /* Length of longest transmission allowed at once...*/
 #define MAXMSG 8192
 
+/* Replies gathered for a corked client before they are sent anyway */
+#define CORK_SIZE 4096
+
+#ifdef HAVE_LIBZ
+/** Decompression state of a client that said "hello deflate" */
+typedef struct _Inflater
+{
+	z_stream stream;		/**< The zlib stream */
+	unsigned char in[MAXMSG];	/**< Compressed data received */
+} Inflater;
+
+/* Preset dictionary for the zlib stream of clients that ask for one by its
+ * id, see language.docbook. The most common words go last, where zlib
+ * reaches them with the shortest distances. Never change it: clients have
+ * compressed their commands with it. */
+static const char deflate_dictionary[] =
+	"noop\nbye\nclient_set -name screen_del widget_del "
+	"screen_add screen_set -priority -duration -heartbeat off -backlight "
+	"-cursor widget_add string title hbar vbar icon scroller frame num "
+	"widget_set_batch widget_set ";
+#endif
+
 /**** Internal function declarations ****************************************/
 static int sock_read_from_client(ClientSocketMap *clientSocketMap);
-static void sock_destroy_socket(void);
+static int sock_receive(ClientSocketMap *entry, char *space, int size);
+static int sock_inflate_pending(ClientSocketMap *entry);
+static void sock_inflate_hold(ClientSocketMap *entry);
+static int sock_inflate_resumable(ClientSocketMap *entry);
+static void sock_destroy_socket(ClientSocketMap *entry);
+static ClientSocketMap *sock_find_socket(int fd);
+static int sock_queue_output(int fd, const void *src, size_t size);
+static int sock_flush_output(ClientSocketMap *entry);
+static void sock_update_events(ClientSocketMap *entry);
+static int sock_add_listener(int fd);
+static int sock_accept(int fd);
 
 
 /** Initialize sockets.
@@ -91,9 +216,41 @@ int
 sock_init(char* bind_addr, int bind_port)
 {
 	int i;
+	struct rlimit rl;
+	const char *overflow;
 
 	debug(RPT_DEBUG, "%s(bind_addr=\"%s\", port=%d)", __FUNCTION__, bind_addr, bind_port);
 
+	output_limit = config_get_int("Server", "MaxOutputQueue", 0, DEFAULT_OUTPUT_LIMIT);
+	if (output_limit < MAXMSG) {
+		report(RPT_WARNING, "%s: MaxOutputQueue must be at least %d; using %d",
+			__FUNCTION__, MAXMSG, MAXMSG);
+		output_limit = MAXMSG;
+	}
+	input_limit = config_get_int("Server", "MaxInputQueue", 0, DEFAULT_INPUT_LIMIT);
+	if (input_limit < MAXMSG) {
+		report(RPT_WARNING, "%s: MaxInputQueue must be at least %d; using %d",
+			__FUNCTION__, MAXMSG, MAXMSG);
+		input_limit = MAXMSG;
+	}
+	overflow = config_get_string("Server", "OutputQueueOverflow", 0, "disconnect");
+	if (strcasecmp(overflow, "throttle") == 0)
+		output_overflow = OVERFLOW_THROTTLE;
+	else if (strcasecmp(overflow, "disconnect") == 0)
+		output_overflow = OVERFLOW_DISCONNECT;
+	else {
+		report(RPT_WARNING, "%s: unknown OutputQueueOverflow \"%s\"; using \"disconnect\"",
+			__FUNCTION__, overflow);
+		output_overflow = OVERFLOW_DISCONNECT;
+	}
+	keepalive_idle = config_get_int("Server", "KeepAlive", 0, SOCK_KEEPALIVE_IDLE);
+	listen_backlog = config_get_int("Server", "ListenBacklog", 0, DEFAULT_LISTEN_BACKLOG);
+	if (listen_backlog < 1) {
+		report(RPT_WARNING, "%s: ListenBacklog must be at least 1; using %d",
+			__FUNCTION__, DEFAULT_LISTEN_BACKLOG);
+		listen_backlog = DEFAULT_LISTEN_BACKLOG;
+	}
+
 	/* Create the socket and set it up to accept connections. */
 	listening_fd = sock_create_inet_socket(bind_addr, bind_port);
 	if (listening_fd < 0) {
@@ -102,11 +259,34 @@ sock_init(char* bind_addr, int bind_port)
 		return -1;
 	}
 
+	/* Local clients may also connect to a UNIX domain socket */
+	if (config_get_string("Server", "UnixSocket", 0, NULL) != NULL) {
+		const char *mode = config_get_string("Server", "UnixSocketMode", 0, "0666");
+
+		unix_path = strdup(config_get_string("Server", "UnixSocket", 0, NULL));
+		if (unix_path == NULL)
+			return -1;
+		unix_fd = sock_create_unix_socket(unix_path, (int) strtol(mode, NULL, 8));
+		if (unix_fd < 0) {
+			free(unix_path);
+			unix_path = NULL;
+			return -1;
+		}
+	}
+
+	/* We cannot have more sockets open than descriptors allowed */
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+		if ((rl.rlim_cur == RLIM_INFINITY) || (rl.rlim_cur > MAX_SOCKETS))
+			max_sockets = MAX_SOCKETS;
+		else
+			max_sockets = (int) rl.rlim_cur;
+	}
+
 	/* Create the socket -> Client mapping pool */
-	/* How large can FD_SETSIZE be? Even if it is ~2000 this only uses a
-	   few kilobytes of memory. Let's trade size for speed! */
+	/* Even with MAX_SOCKETS entries this only uses a few hundred
+	   kilobytes of memory. Let's trade size for speed! */
 	freeClientSocketPool = (ClientSocketMap *)
-				calloc(FD_SETSIZE, sizeof(ClientSocketMap));
+				calloc(max_sockets, sizeof(ClientSocketMap));
 	if (freeClientSocketPool == NULL) {
 		report(RPT_ERR, "%s: Error allocating client sockets.",
 			__FUNCTION__);
@@ -119,31 +299,40 @@ sock_init(char* bind_addr, int bind_port)
 			 __FUNCTION__);
 		return -1;
 	}
-	for (i = 0; i < FD_SETSIZE; ++i) {
+	for (i = 0; i < max_sockets; ++i) {
 		LL_AddNode(freeClientSocketList, (void*) &freeClientSocketPool[i]);
 	}
 
-	/* Create and initialize the open socket list with the server socket */
-	openSocketList = LL_new();
-	if (openSocketList == NULL) {
-		report(RPT_ERR, "%s: error allocating open socket list.",
-			 __FUNCTION__);
+	readySockets = (ClientSocketMap **) calloc(max_sockets, sizeof(ClientSocketMap *));
+	socketByFd = (ClientSocketMap **) calloc(max_sockets, sizeof(ClientSocketMap *));
+	if ((readySockets == NULL) || (socketByFd == NULL)) {
+		report(RPT_ERR, "%s: Error allocating ready socket list.",
+			__FUNCTION__);
 		return -1;
 	}
-	else {
-		ClientSocketMap *entry;
 
-		entry = (ClientSocketMap*) LL_Pop(freeClientSocketList);
-		entry->socket = listening_fd;
-		entry->client = NULL;
-		LL_AddNode(openSocketList, (void*) entry);
+	if (poller_init(max_sockets) < 0) {
+		report(RPT_ERR, "%s: error initializing %s poller.",
+			__FUNCTION__, poller_backend());
+		return -1;
 	}
+	debug(RPT_DEBUG, "%s: using %s for up to %d sockets",
+		__FUNCTION__, poller_backend(), max_sockets);
 
-	if ((messageRing = sring_create(MAXMSG)) == NULL) {
-		report(RPT_ERR, "%s: error allocating receive buffer.",
+	/* Create and initialize the open socket list with the server sockets */
+	openSocketList = LL_new();
+	if (openSocketList == NULL) {
+		report(RPT_ERR, "%s: error allocating open socket list.",
 			 __FUNCTION__);
 		return -1;
 	}
+	if (sock_add_listener(listening_fd) < 0)
+		return -1;
+	if ((unix_fd >= 0) && (sock_add_listener(unix_fd) < 0))
+		return -1;
+
+	/* From now on, output to clients goes through the queues */
+	sock_set_send_func(sock_queue_output);
 
 	return 0;
 }
@@ -179,10 +368,26 @@ sock_shutdown(void)
                   }
                   LL_Destroy(openSocketList);
         */
+	sock_set_send_func(NULL);
 	close(listening_fd);
+	if (unix_fd >= 0) {
+		close(unix_fd);
+		unix_fd = -1;
+		unlink(unix_path);
+	}
+	free(unix_path);
+	unix_path = NULL;
+	if (wakePipe[0] >= 0) {
+		close(wakePipe[0]);
+		close(wakePipe[1]);
+		wakePipe[0] = wakePipe[1] = -1;
+	}
+	poller_shutdown();
 	LL_Destroy(freeClientSocketList);
 	free(freeClientSocketPool);
-	sring_destroy(messageRing);
+	free(readySockets);
+	readyCount = -1;
+	free(socketByFd);
 
 	return retVal;
 }
@@ -197,14 +402,16 @@ sock_shutdown(void)
 int
 sock_create_inet_socket(char *addr, unsigned int port)
 {
-	struct sockaddr_in name;
+	struct sockaddr_storage name;
+	socklen_t namelen;
+	int ipv6 = verify_ipv6(addr);
 	int sock;
 	int sockopt = 1;
 
 	debug(RPT_DEBUG, "%s(addr=\"%s\", port=%i)", __FUNCTION__, addr, port);
 
 	/* Create the socket. */
-	sock = socket(PF_INET, SOCK_STREAM, 0);
+	sock = socket((ipv6) ? PF_INET6 : PF_INET, SOCK_STREAM, 0);
 	if (sock < 0)
 	{
 		report(RPT_ERR, "%s: cannot create socket - %s",
@@ -220,173 +427,610 @@ sock_create_inet_socket(char *addr, unsigned int port)
 
 	/* Give the socket a name. */
 	memset(&name, 0, sizeof(name));
-	name.sin_family = AF_INET;
-	name.sin_port = htons(port);
-	inet_aton(addr, &name.sin_addr);
+	if (ipv6) {
+		struct sockaddr_in6 *inet6 = (struct sockaddr_in6 *) &name;
 
-	if (bind(sock, (struct sockaddr *) &name, sizeof(name)) < 0) {
+		inet6->sin6_family = AF_INET6;
+		inet6->sin6_port = htons(port);
+		inet_pton(AF_INET6, addr, &inet6->sin6_addr);
+		namelen = sizeof(*inet6);
+	}
+	else {
+		struct sockaddr_in *inet = (struct sockaddr_in *) &name;
+
+		inet->sin_family = AF_INET;
+		inet->sin_port = htons(port);
+		inet_aton(addr, &inet->sin_addr);
+		namelen = sizeof(*inet);
+	}
+
+	if (bind(sock, (struct sockaddr *) &name, namelen) < 0) {
 		report(RPT_ERR, "%s: cannot bind to port %d at address %s - %s",
                        __FUNCTION__, port, addr, sock_geterror());
 		return -1;
 	}
 
-	if (listen(sock, 1) < 0) {
+	if (listen(sock, listen_backlog) < 0) {
 		report(RPT_ERR, "%s: error in attempting to listen to port "
 			"%d at %s - %s",
 			__FUNCTION__, port, addr, sock_geterror());
 		return -1;
 	}
 
-	report(RPT_NOTICE, "Listening for queries on %s:%d", addr, port);
+	report(RPT_NOTICE, (ipv6) ? "Listening for queries on [%s]:%d"
+				  : "Listening for queries on %s:%d", addr, port);
+
+	return sock;
+}
+
+
+/** Create a UNIX domain socket, bind to it and listen on it.
+ * A stale socket left at the path by an earlier run is replaced.
+ * \param path      Path of the socket in the file system.
+ * \param mode      Permissions of the socket, which decide who may connect.
+ * \retval  <0      error
+ * \retval  >=0     the socket
+ */
+int
+sock_create_unix_socket(const char *path, int mode)
+{
+	struct sockaddr_un name;
+	int sock;
+
+	debug(RPT_DEBUG, "%s(path=\"%s\", mode=%o)", __FUNCTION__, path, mode);
+
+	if (strlen(path) >= sizeof(name.sun_path)) {
+		report(RPT_ERR, "%s: socket path too long: %s", __FUNCTION__, path);
+		return -1;
+	}
+
+	sock = socket(PF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		report(RPT_ERR, "%s: cannot create socket - %s",
+			__FUNCTION__, sock_geterror());
+		return -1;
+	}
 
-	/* Initialize the set of active sockets. */
-	FD_ZERO(&active_fd_set);
-	FD_SET(sock, &active_fd_set);
+	memset(&name, 0, sizeof(name));
+	name.sun_family = AF_UNIX;
+	strcpy(name.sun_path, path);
+	unlink(path);
+
+	if (bind(sock, (struct sockaddr *) &name, sizeof(name)) < 0) {
+		report(RPT_ERR, "%s: cannot bind to %s - %s",
+			__FUNCTION__, path, sock_geterror());
+		close(sock);
+		return -1;
+	}
+	if (chmod(path, mode) < 0) {
+		report(RPT_ERR, "%s: cannot set mode %o of %s - %s",
+			__FUNCTION__, mode, path, sock_geterror());
+		close(sock);
+		unlink(path);
+		return -1;
+	}
+	if (listen(sock, listen_backlog) < 0) {
+		report(RPT_ERR, "%s: error in attempting to listen to %s - %s",
+			__FUNCTION__, path, sock_geterror());
+		close(sock);
+		unlink(path);
+		return -1;
+	}
+
+	report(RPT_NOTICE, "Listening for queries on %s", path);
 
 	return sock;
 }
 
 
-/** Service all clients with pending input.
+/** Watch a listening socket for connection requests.
+ * \param fd       The listening socket.
+ * \retval  <0     error
+ * \retval   0     success
+ */
+static int
+sock_add_listener(int fd)
+{
+	ClientSocketMap *entry;
+
+	entry = (ClientSocketMap*) LL_Pop(freeClientSocketList);
+	if (entry == NULL)
+		return -1;
+	entry->socket = fd;
+	entry->client = NULL;
+	entry->messageRing = NULL;
+	entry->outBuffer = NULL;
+	entry->events = POLLER_IN;
+	/* sock_accept() takes connections until none are left */
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	LL_AddNode(openSocketList, (void*) entry);
+	if (poller_add(fd, (void *) entry) < 0)
+		return -1;
+	if (fd < max_sockets)
+		socketByFd[fd] = entry;
+	return 0;
+}
+
+
+/** Accept the connection requests waiting on a listening socket and set up
+ * a client for each. All are taken at once, so that many clients connecting
+ * at the same time do not wait for one poll each.
+ * \param fd       The listening socket.
+ * \retval  <0     error
+ * \retval   0     success
+ */
+static int
+sock_accept(int fd)
+{
+	for (;;) {
+		int new_sock;
+		struct sockaddr_storage clientname;
+		socklen_t size = sizeof(clientname);
+
+#ifdef HAVE_ACCEPT4
+		new_sock = accept4(fd, (struct sockaddr *) &clientname, &size,
+				   SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+		new_sock = accept(fd, (struct sockaddr *) &clientname, &size);
+		if (new_sock >= 0) {
+			fcntl(new_sock, F_SETFL, O_NONBLOCK);
+			fcntl(new_sock, F_SETFD, FD_CLOEXEC);
+		}
+#endif
+		if (new_sock < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				return 0;	/* all taken */
+			if ((errno == EINTR) || (errno == ECONNABORTED))
+				continue;
+			if ((errno == EMFILE) || (errno == ENFILE)) {
+				/* the rest wait in the backlog */
+				report(RPT_WARNING, "%s: Out of descriptors, connection requests wait",
+					__FUNCTION__);
+				return 0;
+			}
+			report(RPT_ERR, "%s: Accept error - %s",
+				__FUNCTION__, sock_geterror());
+			return -1;
+		}
+		if ((clientname.ss_family == AF_INET) || (clientname.ss_family == AF_INET6)) {
+			char host[INET6_ADDRSTRLEN];
+			unsigned short port;
+
+			if (clientname.ss_family == AF_INET) {
+				struct sockaddr_in *inet = (struct sockaddr_in *) &clientname;
+
+				inet_ntop(AF_INET, &inet->sin_addr, host, sizeof(host));
+				port = ntohs(inet->sin_port);
+			}
+			else {
+				struct sockaddr_in6 *inet6 = (struct sockaddr_in6 *) &clientname;
+
+				inet_ntop(AF_INET6, &inet6->sin6_addr, host, sizeof(host));
+				port = ntohs(inet6->sin6_port);
+			}
+			report(RPT_NOTICE, "Connect from host %s:%hu on socket %i",
+				host, port, new_sock);
+			if (keepalive_idle > 0)
+				sock_set_keepalive(new_sock, keepalive_idle);
+		}
+		else
+			report(RPT_NOTICE, "Connect to %s on socket %i", unix_path, new_sock);
+
+		if (sock_add_client(new_sock) < 0)
+			return -1;
+	}
+}
+
+
+/** Set up a client for a connected socket. sock_accept() does this for
+ * connections to the server's sockets; a trace replay for its socket pairs.
+ * \param new_sock  The connected socket; it must be non-blocking.
+ * \retval  <0      error
+ * \retval   0      success
+ */
+int
+sock_add_client(int new_sock)
+{
+	Client *c;
+
+	/* Create new client */
+	if ((c = client_create(new_sock)) == NULL) {
+		report(RPT_ERR, "%s: Error creating client on socket %i - %s",
+			__FUNCTION__, new_sock, sock_geterror());
+		return -1;
+	}
+	else {
+		/* add new_sock */
+		ClientSocketMap *newClientSocket;
+		newClientSocket = (ClientSocketMap *) LL_Pop(freeClientSocketList);
+		if (newClientSocket != NULL) {
+			newClientSocket->socket = new_sock;
+			newClientSocket->client = c;
+			newClientSocket->messageRing = sring_create_mirrored(MAXMSG);
+			if (newClientSocket->messageRing == NULL) {
+				report(RPT_ERR, "%s: error allocating receive buffer.",
+					 __FUNCTION__);
+				LL_Push(freeClientSocketList, (void *) newClientSocket);
+				return -1;
+			}
+			newClientSocket->outBuffer = NULL;
+			newClientSocket->outSize = 0;
+			newClientSocket->outStart = 0;
+			newClientSocket->outEnd = 0;
+			newClientSocket->events = POLLER_IN;
+			newClientSocket->throttled = 0;
+			newClientSocket->inputFull = 0;
+			newClientSocket->inflateHeld = 0;
+			newClientSocket->eventsStale = 0;
+			newClientSocket->closePending = 0;
+			newClientSocket->corked = 0;
+			newClientSocket->holding = 0;
+#ifdef HAVE_LIBZ
+			newClientSocket->inflater = NULL;
+#endif
+			LL_Push(openSocketList, (void *) newClientSocket);
+			if (poller_add(new_sock, (void *) newClientSocket) < 0) {
+				report(RPT_ERR, "%s: Error watching socket %i",
+					__FUNCTION__, new_sock);
+				return -1;
+			}
+			if (new_sock < max_sockets)
+				socketByFd[new_sock] = newClientSocket;
+		}
+		else {
+			report(RPT_ERR, "%s: Error - free client socket list exhausted - %d clients.",
+				__FUNCTION__, max_sockets);
+			return -1;
+		}
+	}
+	if (clients_add_client(c) == NULL) {
+		report(RPT_ERR, "%s: Could not add client on socket %i",
+			 __FUNCTION__, new_sock);
+		return -1;
+	}
+	trace_record(TRACE_CONNECT, new_sock, NULL, 0);
+	flightrec_event(FLIGHT_CONNECT, new_sock, 0);
+	return 0;
+}
+
+
+/** Service all clients with pending input, and send queued output to
+ * clients that are able to receive it.
  * \retval  <0       error
- * \retval   0       success
+ * \retval  >=0      number of sockets accepted, read from or closed
  */
 int
 sock_poll_clients(void)
 {
-	struct timeval t;
 	ClientSocketMap* clientSocket;
+	int i;
+	int ret = 0;
+	int serviced = 0;
 
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
-	t.tv_sec = 0;
-	t.tv_usec = 0;
+	/* Use the result of a preceding sock_wait() if there is one */
+	if (readyCount < 0) {
+		readyCount = poller_wait((void **) readySockets, max_sockets, 0);
+		if (readyCount < 0) {
+			report(RPT_ERR, "%s: Poll error", __FUNCTION__);
+			return -1;
+		}
+	}
 
-	/* Block until input arrives on one or more active sockets. */
-	read_fd_set = active_fd_set;
+	/* Close sockets of clients that overflowed their output queue */
+	while (pendingCloses > 0) {
+		for (clientSocket = LL_GetFirst(openSocketList);
+		     (clientSocket != NULL) && !clientSocket->closePending;
+		     clientSocket = LL_GetNext(openSocketList))
+			;
+		if (clientSocket == NULL) {
+			pendingCloses = 0;
+			break;
+		}
+		sock_destroy_socket(clientSocket);
+		serviced++;
+	}
 
-	if (select(FD_SETSIZE, &read_fd_set, NULL, NULL, &t) < 0) {
-		report(RPT_ERR, "%s: Select error - %s",
-			__FUNCTION__, sock_geterror());
-		return -1;
+	/* Go on inflating what clients sent before their input stopped;
+	 * a read stops again at the limits, so this ends */
+	while (heldInflates > 0) {
+		for (clientSocket = LL_GetFirst(openSocketList);
+		     (clientSocket != NULL) && !sock_inflate_resumable(clientSocket);
+		     clientSocket = LL_GetNext(openSocketList))
+			;
+		if (clientSocket == NULL)
+			break;
+		clientSocket->inflateHeld = 0;
+		heldInflates--;
+		serviced++;
+		if (sock_read_from_client(clientSocket) < 0)
+			sock_destroy_socket(clientSocket);
 	}
 
-	/* Service all the sockets with input pending. */
-	LL_Rewind(openSocketList);
-	for (clientSocket = (ClientSocketMap *) LL_Get(openSocketList);
-	     clientSocket != NULL;
-	     clientSocket = LL_GetNext(openSocketList)) {
-
-		if (FD_ISSET(clientSocket->socket, &read_fd_set)) {
-			if (clientSocket->socket == listening_fd) {
-				/* Connection request on original socket. */
-				Client *c;
-				int new_sock;
-				struct sockaddr_in clientname;
-				socklen_t size = sizeof(clientname);
-
-				new_sock = accept(listening_fd, (struct sockaddr *) &clientname, &size);
-				if (new_sock < 0) {
-					report(RPT_ERR, "%s: Accept error - %s",
-						__FUNCTION__, sock_geterror());
-					return -1;
-				}
-				report(RPT_NOTICE, "Connect from host %s:%hu on socket %i",
-					inet_ntoa(clientname.sin_addr), ntohs(clientname.sin_port), new_sock);
-				FD_SET(new_sock, &active_fd_set);
+	/* Service all the sockets that are ready. */
+	for (i = 0; i < readyCount; i++) {
+		clientSocket = readySockets[i];
 
-				fcntl(new_sock, F_SETFL, O_NONBLOCK);
+		/* skip sockets destroyed while servicing earlier ones,
+		 * and keys of input drivers */
+		if ((clientSocket == NULL) || (clientSocket == &keyInputEntry))
+			continue;
 
-				/* Create new client */
-				if ((c = client_create(new_sock)) == NULL) {
-					report(RPT_ERR, "%s: Error creating client on socket %i - %s",
-						__FUNCTION__, clientSocket->socket, sock_geterror());
-					return -1;
-				}
-				else {
-					/* add new_sock */
-					ClientSocketMap *newClientSocket;
-					newClientSocket = (ClientSocketMap *) LL_Pop(freeClientSocketList);
-					if (newClientSocket != NULL) {
-						newClientSocket->socket = new_sock;
-						newClientSocket->client = c;
-						LL_InsertNode(openSocketList, (void *) newClientSocket);
-						/* advance past the new node - check it on the next pass */
-						LL_Next(openSocketList);
-					}
-					else {
-						report(RPT_ERR, "%s: Error - free client socket list exhausted - %d clients.",
-							__FUNCTION__, FD_SETSIZE);
-						return -1;
-					}
-				}
-				if (clients_add_client(c) == NULL) {
-					report(RPT_ERR, "%s: Could not add client on socket %i",
-						 __FUNCTION__, clientSocket->socket);
-					return -1;
-				}
+		if (clientSocket == &wakeEntry) {
+			char buf[64];
+
+			while (read(wakePipe[0], buf, sizeof(buf)) > 0)
+				;
+			continue;
+		}
+
+		if ((clientSocket->socket == listening_fd) || (clientSocket->socket == unix_fd)) {
+			/* Connection request on a listening socket. */
+			if (sock_accept(clientSocket->socket) < 0) {
+				ret = -1;
+				break;
 			}
-			else {	/* Data arriving on an already-connected socket. */
-				int err = 0;
+			serviced++;
+		}
+		else {	/* Data arriving on an already-connected socket. */
+			int err = 0;
+
+			if (clientSocket->outStart != clientSocket->outEnd)
+				err = sock_flush_output(clientSocket);
+			if ((err == 0) && !clientSocket->throttled && !clientSocket->inputFull) {
 				debug(RPT_DEBUG, "%s: reading...", __FUNCTION__);
 				err = sock_read_from_client(clientSocket);
 				debug(RPT_DEBUG, "%s: ...done", __FUNCTION__);
-				if (err < 0)
-					sock_destroy_socket();
+				serviced++;
+			}
+			if (err < 0) {
+				sock_destroy_socket(clientSocket);
+				serviced++;
 			}
 		}
 	}
+
+	readyCount = -1;
+	return (ret < 0) ? ret : serviced;
+}
+
+
+/** Wait for input on the listening socket, any client socket or any
+ * descriptor watched with sock_watch_input().
+ * Used by the event-driven main loop instead of sleeping: it returns as
+ * soon as a connection request, client data or a key arrives, or when the
+ * timeout expires. A signal interrupting the wait is not an error.
+ * The sockets found ready are serviced by the next sock_poll_clients().
+ * \param timeout  Maximum time to wait in microseconds, <0 waits forever.
+ * \retval  <0     error
+ * \retval   0     timeout (or interrupted)
+ * \retval  >0     number of sockets with input pending, or with data left
+ *                 in their inflater
+ */
+int
+sock_wait(long timeout)
+{
+	ClientSocketMap *entry;
+	int count;
+
+	/* Data held in an inflater is input pending as well */
+	if (heldInflates > 0) {
+		for (entry = LL_GetFirst(openSocketList); entry != NULL; entry = LL_GetNext(openSocketList)) {
+			if (sock_inflate_resumable(entry)) {
+				count = poller_wait((void **) readySockets, max_sockets, 0);
+				readyCount = (count > 0) ? count : 0;
+				return readyCount + 1;
+			}
+		}
+	}
+
+	/* round up: waking a little late is cheaper than spinning */
+	count = poller_wait((void **) readySockets, max_sockets,
+			    (timeout < 0) ? -1 : (int) ((timeout + 999) / 1000));
+	readyCount = (count > 0) ? count : -1;
+	return count;
+}
+
+
+/** Watch a descriptor of an input driver along with the sockets, so that
+ * sock_wait() returns when it becomes readable. Reading it is left to the
+ * driver.
+ * \param fd       The descriptor.
+ * \retval  <0     the poller does not take the descriptor
+ * \retval   0     success
+ */
+int
+sock_watch_input(int fd)
+{
+	/* With a thread of its own waiting on the poller, the keys are
+	 * polled instead: that thread does not read them */
+	if (wakePipe[0] >= 0)
+		return -1;
+	return (poller_add(fd, (void *) &keyInputEntry) < 0) ? -1 : 0;
+}
+
+
+/** Stop watching a descriptor given to sock_watch_input().
+ * \param fd       The descriptor.
+ */
+void
+sock_unwatch_input(int fd)
+{
+	poller_remove(fd);
+}
+
+
+/** Set up the pipe that wakes up a thread waiting in sock_wait() when
+ * another thread queued output, see sock_wait_begin(). Keys of input
+ * drivers are no longer watched from then on, they are polled.
+ * \retval  <0     error
+ * \retval   0     success
+ */
+int
+sock_wake_init(void)
+{
+	int i;
+
+	if (wakePipe[0] >= 0)
+		return 0;
+
+	if (pipe(wakePipe) < 0) {
+		report(RPT_ERR, "%s: Cannot create pipe - %s", __FUNCTION__, strerror(errno));
+		return -1;
+	}
+	for (i = 0; i < 2; i++) {
+		fcntl(wakePipe[i], F_SETFL, O_NONBLOCK);
+		fcntl(wakePipe[i], F_SETFD, FD_CLOEXEC);
+	}
+	if (poller_add(wakePipe[0], (void *) &wakeEntry) < 0) {
+		report(RPT_ERR, "%s: Error watching the wake pipe", __FUNCTION__);
+		close(wakePipe[0]);
+		close(wakePipe[1]);
+		wakePipe[0] = wakePipe[1] = -1;
+		return -1;
+	}
 	return 0;
 }
 
 
+/** Wake up a thread waiting in sock_wait(), if sock_wake_init() was called.
+ */
+void
+sock_wake(void)
+{
+	if (wakePipe[1] >= 0) {
+		char c = 0;
+
+		if (write(wakePipe[1], &c, 1) < 0) {
+			/* EAGAIN: it has not read the last ones yet */
+		}
+	}
+}
+
+
+/** Hand the poller over to a thread about to wait in sock_wait() without
+ * the server lock. Until sock_wait_end() other threads holding the lock
+ * may still send to clients, but leave the changes to the poller to
+ * sock_wait_end(). Both are called with the lock held.
+ */
+void
+sock_wait_begin(void)
+{
+	pollerBusy = 1;
+}
+
+
+/** Take the poller back after sock_wait() and apply the changes to it
+ * that were left while it was busy.
+ */
+void
+sock_wait_end(void)
+{
+	ClientSocketMap *entry;
+
+	pollerBusy = 0;
+	for (entry = LL_GetFirst(openSocketList);
+	     (entry != NULL) && (staleEvents > 0);
+	     entry = LL_GetNext(openSocketList)) {
+		if (entry->eventsStale) {
+			entry->eventsStale = 0;
+			staleEvents--;
+			sock_update_events(entry);
+		}
+	}
+}
+
+
 /** Read from a client's socket and store the messages in the client for further parsing.
+ * Incomplete messages are kept in the socket's ring buffer until the rest
+ * of the line arrives with a later read.
  * \retval  <0       error
  * \retval   0       success
  */
 static int
 sock_read_from_client(ClientSocketMap *clientSocketMap)
 {
-	char buffer[MAXMSG];
+	char *space;
 	int nbytes;
+	int fr;
+	sring_buffer *ring = clientSocketMap->messageRing;
 
 	debug(RPT_DEBUG, "%s()", __FUNCTION__);
 
+	/* Receive right into the ring buffer; a mirrored one takes all that
+	 * fits at once */
 	errno = 0;
-	nbytes = sock_recv(clientSocketMap->socket, buffer, MAXMSG);
+	space = sring_write_ptr(ring, &fr);
+	nbytes = sock_receive(clientSocketMap, space, fr);
 
 	while (nbytes > 0) {		/* Data available */
-		int fr;
+		Client *c = clientSocketMap->client;
+		int len;
 		char *str;
 
 		debug(RPT_DEBUG, "%s: received %4d bytes", __FUNCTION__, nbytes);
 
-		/* Append to ring buffer */
-		sring_write(messageRing, buffer, nbytes);
-
-		/* Process all available message in ring buffer */
-		do {
-			str = sring_read_string(messageRing);
-			if (clientSocketMap->client) {
-				client_add_message(clientSocketMap->client, str);
+		/* Add to the data in the ring buffer */
+		sring_written(ring, nbytes);
+
+		/* Hand all complete messages in ring buffer to the client
+		 * in one block; the parser splits them into lines or frames */
+		if ((c != NULL) && c->binary) {
+			if ((len = sring_frames_length(ring)) > 0) {
+				str = pool_alloc(c->pool, CLIENT_BINARY_HEADER + len);
+				if (str != NULL) {
+					client_binary_set_length(str, len);
+					sring_read(ring, str + CLIENT_BINARY_HEADER, len);
+					client_add_binary_message(c, str);
+				} else {
+					report(RPT_DEBUG, "%s: Can't store frames of client %d",
+						__FUNCTION__, clientSocketMap->socket);
+					sring_clear(ring);
+				}
+			}
+		}
+		else if ((len = sring_lines_length(ring)) > 0) {
+			str = (c != NULL) ? pool_alloc(c->pool, len + 1) : NULL;
+			if (str != NULL) {
+				sring_read(ring, str, len);
+				str[len] = '\0';
+				client_add_message(c, str);
 			} else {
-				report(RPT_DEBUG, "%s: Can't find client %d",
+				report(RPT_DEBUG, "%s: Can't store messages of client %d",
 					__FUNCTION__, clientSocketMap->socket);
+				sring_skip(ring, len);
 			}
-		} while (str != NULL);
+		}
 
-		/* Read again, but only as much as space is left */
-		fr = sring_getMaxWrite(messageRing);
-		if (fr == 0)
-			report(RPT_WARNING, "%s: Message buffer full", __FUNCTION__);
+		/* Stop reading when the client does not keep up with its output */
+		if (clientSocketMap->throttled) {
+			sock_inflate_hold(clientSocketMap);
+			return 0;
+		}
 
-		nbytes = sock_recv(clientSocketMap->socket, buffer, min(MAXMSG, fr));
-	}
+		/* Stop reading when the parser does not keep up with the client */
+		if ((clientSocketMap->client != NULL)
+		    && (clientSocketMap->client->queued >= input_limit)) {
+			debug(RPT_DEBUG, "%s: %d bytes queued for client %d, pausing input",
+				__FUNCTION__, clientSocketMap->client->queued, clientSocketMap->socket);
+			clientSocketMap->inputFull = 1;
+			sock_update_events(clientSocketMap);
+			sock_inflate_hold(clientSocketMap);
+			return 0;
+		}
 
-	if (sring_getMaxRead(messageRing) > 0) {
-		report(RPT_WARNING, "%s: left over bytes in message buffer",
-			__FUNCTION__);
-		sring_clear(messageRing);
+		/* Read again, but only as much as space is left */
+		fr = sring_getMaxWrite(ring);
+		if (fr == 0) {
+			/* The buffer is full without a complete message in it */
+			report(RPT_WARNING, "%s: Message buffer full, discarding %d bytes from client %d",
+				__FUNCTION__, sring_getMaxRead(ring), clientSocketMap->socket);
+			sring_clear(ring);
+		}
+
+		space = sring_write_ptr(ring, &fr);
+		nbytes = sock_receive(clientSocketMap, space, fr);
 	}
 
 	if (nbytes < 0 && errno == EAGAIN)
@@ -396,6 +1040,277 @@ sock_read_from_client(ClientSocketMap *clientSocketMap)
 }
 
 
+/** Receive data from a client's socket, inflating it if the client said
+ * "hello deflate". The trace gets the data as received.
+ * \param entry  The client's socket.
+ * \param space  Where to put the data.
+ * \param size   Room in space, > 0.
+ * \retval  >0   number of bytes put into space
+ * \retval   0   EOF, or the end of the zlib stream
+ * \retval  <0   no data (errno is EAGAIN), or error
+ */
+static int
+sock_receive(ClientSocketMap *entry, char *space, int size)
+{
+	int nbytes;
+
+#ifdef HAVE_LIBZ
+	if (entry->inflater != NULL) {
+		z_stream *zs = &entry->inflater->stream;
+
+		zs->next_out = (Bytef *) space;
+		zs->avail_out = size;
+		for (;;) {
+			/* Data received earlier may still give output */
+			int rc = inflate(zs, Z_SYNC_FLUSH);
+
+			if (rc == Z_NEED_DICT) {
+				rc = inflateSetDictionary(zs, (const Bytef *) deflate_dictionary,
+							  sizeof(deflate_dictionary) - 1);
+				if (rc == Z_OK)
+					continue;
+			}
+			if (zs->avail_out < (unsigned int) size)
+				return size - zs->avail_out;
+			if (rc == Z_STREAM_END)
+				return 0;
+			if ((rc != Z_OK) && ((rc != Z_BUF_ERROR) || (zs->avail_in > 0))) {
+				report(RPT_WARNING, "%s: Bad compressed data from client %d: %s",
+					__FUNCTION__, entry->socket,
+					(zs->msg != NULL) ? zs->msg : "inflate failed");
+				errno = 0;
+				return -1;
+			}
+			if (zs->avail_in == 0) {
+				nbytes = sock_recv(entry->socket, entry->inflater->in, MAXMSG);
+				if (nbytes <= 0)
+					return nbytes;
+				trace_record(TRACE_DATA, entry->socket,
+					     (char *) entry->inflater->in, nbytes);
+				zs->next_in = entry->inflater->in;
+				zs->avail_in = nbytes;
+			}
+		}
+	}
+#endif
+
+	nbytes = sock_recv(entry->socket, space, size);
+	if (nbytes > 0)
+		trace_record(TRACE_DATA, entry->socket, space, nbytes);
+	return nbytes;
+}
+
+
+/** Tell whether the inflater of a client's socket holds data that was
+ * received but not inflated yet.
+ * \param entry  The client's socket.
+ * \return  1 if so, 0 if not.
+ */
+static int
+sock_inflate_pending(ClientSocketMap *entry)
+{
+#ifdef HAVE_LIBZ
+	/* Output filling all the room may have left more behind */
+	if ((entry->inflater != NULL)
+	    && ((entry->inflater->stream.avail_in > 0)
+		|| (entry->inflater->stream.avail_out == 0)))
+		return 1;
+#endif
+	return 0;
+}
+
+
+/** Note that reading a client's socket stops with data left in its
+ * inflater, which sock_poll_clients() inflates once the client takes input
+ * again: inflating it right away could queue far more than the limits.
+ * \param entry  The client's socket.
+ */
+static void
+sock_inflate_hold(ClientSocketMap *entry)
+{
+	if (!entry->inflateHeld && sock_inflate_pending(entry)) {
+		entry->inflateHeld = 1;
+		heldInflates++;
+	}
+}
+
+
+/** Tell whether a client's socket has data held in its inflater and takes
+ * input again.
+ * \param entry  The client's socket.
+ * \return  1 if so, 0 if not.
+ */
+static int
+sock_inflate_resumable(ClientSocketMap *entry)
+{
+	return (entry->inflateHeld && !entry->throttled && !entry->inputFull
+		&& !entry->closePending) ? 1 : 0;
+}
+
+
+/**
+ * Inflate everything a client sends from now on, for "hello deflate".
+ * Data the client sent behind the command before the reply is discarded.
+ * \param client  The client.
+ * \retval  <0    error, or the server was built without zlib
+ * \retval   0    success
+ */
+int
+sock_client_inflate(Client *client)
+{
+#ifdef HAVE_LIBZ
+	ClientSocketMap *entry = sock_find_socket(client->sock);
+
+	if (entry == NULL)
+		return -1;
+	if (entry->inflater == NULL) {
+		entry->inflater = calloc(1, sizeof(Inflater));
+		if (entry->inflater == NULL) {
+			report(RPT_ERR, "%s: error allocating inflater", __FUNCTION__);
+			return -1;
+		}
+		/* zalloc, zfree, opaque and next_in are zero from calloc */
+		if (inflateInit(&entry->inflater->stream) != Z_OK) {
+			report(RPT_ERR, "%s: error initializing inflater", __FUNCTION__);
+			free(entry->inflater);
+			entry->inflater = NULL;
+			return -1;
+		}
+	}
+	sring_clear(entry->messageRing);
+	client->deflate = 1;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+
+/** Tell whether a client's input is currently not processed because it
+ * does not read its output.
+ * \param client  Client to check.
+ * \return  1 if the client is throttled, 0 if not.
+ */
+int
+sock_client_throttled(Client *client)
+{
+	ClientSocketMap *entry = sock_find_socket(client->sock);
+
+	return ((entry != NULL) && entry->throttled) ? 1 : 0;
+}
+
+
+/**
+ * Gather the replies to a client while its messages are parsed, so that
+ * sock_client_parsed() sends them with one system call instead of one
+ * for each.
+ * \param client  The client.
+ */
+void
+sock_client_parsing(Client *client)
+{
+	ClientSocketMap *entry = sock_find_socket(client->sock);
+
+	if (entry != NULL)
+		entry->corked = 1;
+}
+
+
+/**
+ * Send the replies gathered while parsing a client's messages, and resume
+ * reading its socket once the parser has worked its message queue down to
+ * half of MaxInputQueue. To be called after parsing the client's messages.
+ * \param client  The client.
+ */
+void
+sock_client_parsed(Client *client)
+{
+	ClientSocketMap *entry = sock_find_socket(client->sock);
+
+	if (entry == NULL)
+		return;
+	if (entry->corked) {
+		entry->corked = 0;
+		if (!entry->closePending && (entry->outStart != entry->outEnd))
+			sock_flush_output(entry);
+	}
+	if (entry->inputFull && (client->queued <= input_limit / 2)) {
+		entry->inputFull = 0;
+		sock_update_events(entry);
+	}
+}
+
+
+/**
+ * Hold back the replies to a client, for a command that runs others and
+ * gives one reply for all of them. Of the replies held back only the
+ * first error is kept, see sock_client_release_replies().
+ * \param client  The client.
+ */
+void
+sock_client_hold_replies(Client *client)
+{
+	ClientSocketMap *entry = sock_find_socket(client->sock);
+
+	if (entry != NULL) {
+		entry->holding = 1;
+		entry->heldError[0] = '\0';
+	}
+}
+
+
+/**
+ * Let replies to a client through again after sock_client_hold_replies().
+ * \param client  The client.
+ * \param error   Where to put the first error reply held back, without
+ *                "huh? " and the newline.
+ * \param size    Size of error.
+ * \return  1 if an error was held back, 0 if not.
+ */
+int
+sock_client_release_replies(Client *client, char *error, size_t size)
+{
+	ClientSocketMap *entry = sock_find_socket(client->sock);
+
+	if ((entry == NULL) || !entry->holding)
+		return 0;
+	entry->holding = 0;
+	if (entry->heldError[0] == '\0')
+		return 0;
+	snprintf(error, size, "%s", entry->heldError);
+	return 1;
+}
+
+
+/**
+ * Tell how much of a client's input has been received but not yet split
+ * into messages.
+ * \param client  The client.
+ * \return  Number of bytes.
+ */
+int
+sock_queued_input(Client *client)
+{
+	ClientSocketMap *entry = sock_find_socket(client->sock);
+
+	return (entry != NULL) ? sring_getMaxRead(entry->messageRing) : 0;
+}
+
+
+/**
+ * Tell how much output is queued for a client.
+ * \param client  The client.
+ * \return  Number of bytes.
+ */
+int
+sock_queued_output(Client *client)
+{
+	ClientSocketMap *entry = sock_find_socket(client->sock);
+
+	return (entry != NULL) ? entry->outEnd - entry->outStart : 0;
+}
+
+
 /* comparison function to find a ClientsocketMap entry by client */
 int byClient(void *csm, void *client)
 {
@@ -417,43 +1332,274 @@ sock_destroy_client_socket(Client *client)
 	entry = LL_Find(openSocketList, byClient, client);
 
 	if (entry != NULL) {
-		sock_destroy_socket();
+		sock_destroy_socket(entry);
 		return 0;
 	}
 	return -1;
 }
 
 
-/** Close the socket the openSocketList's \c current pointer points to.
+/** Close an open socket and return its entry to the free socket pool.
+ * \param entry  Entry of the socket in the openSocketList.
  */
 static void
-sock_destroy_socket(void)
+sock_destroy_socket(ClientSocketMap *entry)
 {
-	ClientSocketMap *entry = LL_Get(openSocketList);
-
 	if (entry != NULL) {
+		int i;
+
+		/* Last chance to deliver queued output, e.g. after "bye" */
+		if (!entry->closePending && (entry->outStart != entry->outEnd))
+			sock_flush_output(entry);
+
 		if (entry->client != NULL) {
 			report(RPT_NOTICE, "Client on socket %i disconnected",
 				entry->socket);
+			trace_record(TRACE_CLOSE, entry->socket, NULL, 0);
+			flightrec_event(FLIGHT_DISCONNECT, entry->socket, 0);
+			clients_remove_client(entry->client);
 			client_destroy(entry->client);
-			clients_remove_client(entry->client, PREV);
 			entry->client = NULL;
 		}
 		else {
 			report(RPT_ERR, "%s: Can't find client of socket %i",
 				__FUNCTION__, entry->socket);
 		}
-		/* close socket and remove it from select()'s mask of active sockets */
-		FD_CLR(entry->socket, &active_fd_set);
+		/* stop watching the socket and close it */
+		poller_remove(entry->socket);
 		close(entry->socket);
 
+		sring_destroy(entry->messageRing);
+		entry->messageRing = NULL;
+		if (entry->inflateHeld) {
+			entry->inflateHeld = 0;
+			heldInflates--;
+		}
+		if (entry->eventsStale) {
+			entry->eventsStale = 0;
+			staleEvents--;
+		}
+#ifdef HAVE_LIBZ
+		if (entry->inflater != NULL) {
+			inflateEnd(&entry->inflater->stream);
+			free(entry->inflater);
+			entry->inflater = NULL;
+		}
+#endif
+		free(entry->outBuffer);
+		entry->outBuffer = NULL;
+		entry->outSize = entry->outStart = entry->outEnd = 0;
+		if (entry->closePending) {
+			entry->closePending = 0;
+			pendingCloses--;
+		}
+
+		if (entry->socket < max_sockets)
+			socketByFd[entry->socket] = NULL;
+
+		/* The entry must not be serviced any more in this poll */
+		for (i = 0; i < readyCount; i++) {
+			if (readySockets[i] == entry)
+				readySockets[i] = NULL;
+		}
+
 		/* re-add socket to the free socket pool */
-		entry = (ClientSocketMap *) LL_DeleteNode(openSocketList, PREV);
+		LL_Remove(openSocketList, (void *) entry, NEXT);
 		LL_Push(freeClientSocketList, (void*) entry);
 	}
 }
 
 
+/* comparison function to find a ClientsocketMap entry by socket */
+static int bySocket(void *csm, void *fd)
+{
+	return (((ClientSocketMap *) csm)->socket == *((int *) fd)) ? 0 : -1;
+}
+
+
+/** Find the open socket entry of a descriptor.
+ * \param fd  Socket descriptor.
+ * \return  Pointer to the entry, or \c NULL if the socket is not open.
+ */
+static ClientSocketMap *
+sock_find_socket(int fd)
+{
+	/* no sockets before sock_init(), e.g. in the micro benchmarks */
+	if (socketByFd == NULL)
+		return NULL;
+
+	if ((fd >= 0) && (fd < max_sockets))
+		return socketByFd[fd];
+
+	LL_Rewind(openSocketList);
+	return LL_Find(openSocketList, bySocket, &fd);
+}
+
+
+/** Set the events a socket is watched for from its state: input unless
+ * the client is throttled or has too many messages queued, output while
+ * data is queued.
+ * \param entry  Entry of the socket.
+ */
+static void
+sock_update_events(ClientSocketMap *entry)
+{
+	int events = ((entry->throttled || entry->inputFull) ? 0 : POLLER_IN)
+		   | ((entry->outStart != entry->outEnd) ? POLLER_OUT : 0);
+
+	if (pollerBusy) {
+		if ((events != entry->events) && !entry->eventsStale) {
+			entry->eventsStale = 1;
+			staleEvents++;
+			sock_wake();
+		}
+		return;
+	}
+	if (events != entry->events) {
+		if (poller_modify(entry->socket, (void *) entry, events) == 0)
+			entry->events = events;
+	}
+}
+
+
+/** Send function for the server, installed with sock_set_send_func().
+ * Data for a client is written right away as far as the socket accepts
+ * it; the rest is queued and sent by sock_poll_clients() as soon as the
+ * socket becomes writable. This way a client that does not read its
+ * socket cannot block the server. While a client is corked the data is
+ * only queued, see sock_client_parsing().
+ * \param fd    Socket descriptor.
+ * \param src   Data to send.
+ * \param size  Number of bytes to send.
+ * \return  Number of bytes sent or queued, -1 on error.
+ */
+static int
+sock_queue_output(int fd, const void *src, size_t size)
+{
+	ClientSocketMap *entry = sock_find_socket(fd);
+	int sent = 0;
+	int queued;
+
+	if ((entry == NULL) || (entry->client == NULL))
+		return sock_write(fd, src, size);
+
+	if ((src == NULL) || entry->closePending)
+		return -1;
+
+	if (entry->holding) {
+		/* Keep the first error, without "huh? " and the newline */
+		if ((entry->heldError[0] == '\0') && (size > 5) && (memcmp(src, "huh? ", 5) == 0)) {
+			size_t len = min(size - 5, sizeof(entry->heldError) - 1);
+
+			memcpy(entry->heldError, (const char *) src + 5, len);
+			entry->heldError[len] = '\0';
+			entry->heldError[strcspn(entry->heldError, "\n")] = '\0';
+		}
+		return size;
+	}
+
+	/* A corked client gets its replies in batches of up to CORK_SIZE */
+	if (entry->corked && ((entry->outEnd - entry->outStart) + (int) size > CORK_SIZE))
+		sock_flush_output(entry);
+
+	/* Nothing queued yet: try to send right away */
+	if ((entry->outStart == entry->outEnd) && !(entry->corked && (size <= CORK_SIZE))) {
+		sent = write(fd, src, size);
+		if (sent < 0) {
+			if ((errno != EAGAIN) && (errno != EINTR)) {
+				/* The closed socket will be noticed when reading */
+				report(RPT_DEBUG, "%s: socket write error on socket %d - %s",
+					__FUNCTION__, fd, sock_geterror());
+				return -1;
+			}
+			sent = 0;
+		}
+		if (sent == size)
+			return sent;
+	}
+
+	queued = (entry->outEnd - entry->outStart) + (size - sent);
+	if (((queued > output_limit) && (output_overflow == OVERFLOW_DISCONNECT))
+	    || (queued > 4 * output_limit)) {
+		report(RPT_WARNING, "Client on socket %i does not read its output (%d bytes queued), disconnecting",
+			fd, queued);
+		entry->closePending = 1;
+		entry->client->state = GONE;
+		pendingCloses++;
+		if (pollerBusy)
+			sock_wake();
+		return -1;
+	}
+
+	/* Make room behind the queued data */
+	if (entry->outEnd + (int) (size - sent) > entry->outSize) {
+		if (entry->outStart > 0) {
+			memmove(entry->outBuffer, entry->outBuffer + entry->outStart,
+				entry->outEnd - entry->outStart);
+			entry->outEnd -= entry->outStart;
+			entry->outStart = 0;
+		}
+		if (entry->outEnd + (int) (size - sent) > entry->outSize) {
+			int newSize = max(max(2 * entry->outSize, MAXMSG), entry->outEnd + (int) (size - sent));
+			char *newBuffer = realloc(entry->outBuffer, newSize);
+
+			if (newBuffer == NULL) {
+				report(RPT_ERR, "%s: error allocating output queue", __FUNCTION__);
+				return -1;
+			}
+			entry->outBuffer = newBuffer;
+			entry->outSize = newSize;
+		}
+	}
+	memcpy(entry->outBuffer + entry->outEnd, ((const char *) src) + sent, size - sent);
+	entry->outEnd += size - sent;
+
+	if ((queued > output_limit) && !entry->throttled) {
+		report(RPT_INFO, "Client on socket %i does not read its output, throttling input", fd);
+		entry->throttled = 1;
+	}
+	sock_update_events(entry);
+
+	return size;
+}
+
+
+/** Send as much of a socket's queued output as it accepts.
+ * \param entry  Entry of the socket.
+ * \retval  <0   error
+ * \retval   0   success (some data may still be queued)
+ */
+static int
+sock_flush_output(ClientSocketMap *entry)
+{
+	while (entry->outStart < entry->outEnd) {
+		int sent = write(entry->socket, entry->outBuffer + entry->outStart,
+				 entry->outEnd - entry->outStart);
+		if (sent < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				break;
+			return -1;
+		}
+		if (sent == 0)
+			break;
+		entry->outStart += sent;
+	}
+
+	if (entry->outStart == entry->outEnd)
+		entry->outStart = entry->outEnd = 0;
+
+	if (entry->throttled && ((entry->outEnd - entry->outStart) <= output_limit / 2)) {
+		report(RPT_INFO, "Client on socket %i caught up with its output", entry->socket);
+		entry->throttled = 0;
+	}
+	sock_update_events(entry);
+
+	return 0;
+}
+
+
 /* return 1 if addr is valid IPv4 */
 int verify_ipv4(const char *addr)
 {
@@ -24,8 +24,25 @@
 int sock_init(char* bind_addr, int bind_port);
 int sock_shutdown(void);
 int sock_create_inet_socket(char* bind_addr, unsigned int port);
+int sock_create_unix_socket(const char *path, int mode);
+int sock_add_client(int new_sock);
 int sock_poll_clients(void);
+int sock_wait(long timeout);
+int sock_watch_input(int fd);
+void sock_unwatch_input(int fd);
+int sock_wake_init(void);
+void sock_wake(void);
+void sock_wait_begin(void);
+void sock_wait_end(void);
 int sock_destroy_client_socket(Client *client);
+int sock_client_throttled(Client *client);
+void sock_client_parsing(Client *client);
+void sock_client_parsed(Client *client);
+void sock_client_hold_replies(Client *client);
+int sock_client_release_replies(Client *client, char *error, size_t size);
+int sock_client_inflate(Client *client);
+int sock_queued_input(Client *client);
+int sock_queued_output(Client *client);
 int verify_ipv4(const char *addr);
 int verify_ipv6(const char *addr);
 
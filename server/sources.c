@@ -0,0 +1,483 @@
+/** \file server/sources.c
+ * This file contains the data sources the server samples itself, so that
+ * simple values like a temperature from sysfs can be shown without a
+ * client process that reads them and sends them on.
+ *
+ * The sources are defined in the configuration file, by one Source line
+ * each: a name, the interval in seconds, the value that fills a bar, and a
+ * file whose first line is read or, behind a '!', a command whose first
+ * line of output is taken. Clients only refer to them by name: a client
+ * can't make the server read a file or run a command of its choice.
+ *
+ * A thread of its own takes the samples, as reading a file or running a
+ * command may block. The main loop calls sources_poll() in every
+ * processing stroke, which puts the new values into the widgets bound to
+ * them; they show on the next frame. Without thread support, the samples
+ * are taken by sources_poll() itself.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_LIBPTHREAD)
+# define USE_THREADS
+# include <pthread.h>
+# include <signal.h>
+#endif
+
+#include "shared/report.h"
+#include "shared/configfile.h"
+
+#include "sources.h"
+#include "client.h"
+#include "clients.h"
+#include "screen.h"
+#include "widget.h"
+
+/** Shortest interval between two samples of a source, in microseconds */
+#define MIN_SOURCE_INTERVAL	100000
+
+/** A data source */
+typedef struct Source {
+	char name[32];			/**< Name the clients use */
+	char *spec;			/**< File to read, or the command */
+	int command;			/**< spec is a command to run */
+	long interval;			/**< Time between two samples, in microseconds */
+	double full_scale;		/**< Value that fills a bar */
+	unsigned long long due;		/**< When the next sample is taken */
+	int failing;			/**< The last sample could not be taken */
+	char value[SOURCE_VALUE_SIZE];	/**< Last value sampled */
+	unsigned long serial;		/**< Number of samples taken */
+	unsigned long shown;		/**< serial of the value in the widgets */
+} Source;
+
+static Source sources[MAX_SOURCES];
+static int num_sources = 0;
+
+#ifdef USE_THREADS
+static pthread_t thread;
+static int running = 0;
+static int stopping = 0;
+
+/** Protects value and serial of the sources, and stopping */
+static pthread_mutex_t sources_lock = PTHREAD_MUTEX_INITIALIZER;
+/** Signals stop to the thread */
+static pthread_cond_t sources_cond = PTHREAD_COND_INITIALIZER;
+
+# define LOCK()		pthread_mutex_lock(&sources_lock)
+# define UNLOCK()	pthread_mutex_unlock(&sources_lock)
+#else
+# define LOCK()
+# define UNLOCK()
+#endif
+
+
+/* The current time in microseconds */
+static unsigned long long
+sources_now(void)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (unsigned long long) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+
+/* Find a source by its name */
+static Source *
+sources_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < num_sources; i++) {
+		if (strcmp(sources[i].name, name) == 0)
+			return &sources[i];
+	}
+	return NULL;
+}
+
+
+/*
+ * Take a sample: read the first line of the file or of the command's
+ * output, without the line end.
+ * \return  0 on success, -1 if nothing could be read.
+ */
+static int
+sources_read(const Source *src, char *buf)
+{
+	char *nl;
+	int res = 0;
+
+	buf[0] = '\0';
+	errno = 0;
+	if (src->command) {
+		FILE *pipe = popen(src->spec, "r");
+
+		if (pipe == NULL)
+			return -1;
+		if (fgets(buf, SOURCE_VALUE_SIZE, pipe) == NULL)
+			res = -1;
+		/* the rest of the output is not wanted */
+		while (!feof(pipe) && !ferror(pipe) && (fgetc(pipe) != EOF))
+			;
+		if ((pclose(pipe) != 0) && (buf[0] == '\0'))
+			res = -1;
+	}
+	else {
+		int fd = open(src->spec, O_RDONLY);
+		ssize_t len;
+
+		if (fd < 0)
+			return -1;
+		len = read(fd, buf, SOURCE_VALUE_SIZE - 1);
+		close(fd);
+		if (len < 0)
+			return -1;
+		buf[len] = '\0';
+	}
+
+	nl = strpbrk(buf, "\r\n");
+	if (nl != NULL)
+		*nl = '\0';
+	return res;
+}
+
+
+/*
+ * Sample a source and store the value. Called with the lock held, which
+ * is given up while the sample is taken.
+ */
+static void
+sources_sample(Source *src)
+{
+	char buf[SOURCE_VALUE_SIZE];
+	int res, err;
+
+	UNLOCK();
+	res = sources_read(src, buf);
+	err = errno;
+	LOCK();
+
+	src->due = sources_now() + src->interval;
+	if (res < 0) {
+		if (!src->failing)
+			report(RPT_WARNING, "Data source [%.40s] can't be read: %s",
+			       src->name, (err != 0) ? strerror(err) : "no value");
+		src->failing = 1;
+		return;
+	}
+	if (src->failing)
+		report(RPT_NOTICE, "Data source [%.40s] can be read again", src->name);
+	src->failing = 0;
+	strcpy(src->value, buf);
+	src->serial++;
+}
+
+
+#ifdef USE_THREADS
+/* Main function of the sampling thread */
+static void *
+sources_main(void *arg)
+{
+	LOCK();
+	while (!stopping) {
+		unsigned long long now = sources_now();
+		unsigned long long next = now + 60 * 1000000ULL;
+		struct timespec due;
+		int i;
+
+		for (i = 0; (i < num_sources) && !stopping; i++) {
+			if (sources[i].due <= now)
+				sources_sample(&sources[i]);
+			if (sources[i].due < next)
+				next = sources[i].due;
+		}
+
+		due.tv_sec = next / 1000000;
+		due.tv_nsec = (next % 1000000) * 1000;
+		while (!stopping) {
+			if (pthread_cond_timedwait(&sources_cond, &sources_lock, &due) == ETIMEDOUT)
+				break;
+		}
+	}
+	UNLOCK();
+	return NULL;
+}
+#endif
+
+
+/**
+ * Read the data sources from the configuration file and start sampling
+ * them. Each Source line in the [Server] section defines one source:
+ *
+ *\verbatim
+ * Source=<name> <interval> <full-scale> <file>|!<command>
+ *\endverbatim
+ *
+ * \retval 0   Sampling runs, or no sources are defined.
+ * \retval -1  Sampling could not be started.
+ */
+int
+sources_init(void)
+{
+	const char *line;
+	int i;
+
+	num_sources = 0;
+	for (i = 0; (line = config_get_string("Server", "Source", i, NULL)) != NULL; i++) {
+		Source *src = &sources[num_sources];
+		double interval;
+		int n = 0;
+
+		if (num_sources >= MAX_SOURCES) {
+			report(RPT_WARNING, "Too many data sources, ignoring the rest");
+			break;
+		}
+		memset(src, 0, sizeof(Source));
+		if ((sscanf(line, "%31s %lf %lf %n", src->name, &interval, &src->full_scale, &n) < 3)
+		    || (line[n] == '\0') || (src->full_scale <= 0)) {
+			report(RPT_WARNING, "Invalid data source: %.80s", line);
+			continue;
+		}
+		if (sources_find(src->name) != NULL) {
+			report(RPT_WARNING, "Data source [%.40s] is defined twice", src->name);
+			continue;
+		}
+		src->command = (line[n] == '!');
+		src->spec = strdup(line + n + src->command);
+		if (src->spec == NULL) {
+			report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+			continue;
+		}
+		src->interval = (interval * 1000000 < MIN_SOURCE_INTERVAL)
+				? MIN_SOURCE_INTERVAL : (long) (interval * 1000000);
+		num_sources++;
+		report(RPT_INFO, "Data source [%.40s] samples %s %.80s every %ld ms",
+		       src->name, src->command ? "command" : "file", src->spec,
+		       src->interval / 1000);
+	}
+	if (num_sources == 0)
+		return 0;
+
+#ifdef USE_THREADS
+	{
+		sigset_t all, old;
+		int err;
+
+		stopping = 0;
+		/* signals are handled by the main thread only */
+		sigfillset(&all);
+		pthread_sigmask(SIG_SETMASK, &all, &old);
+		err = pthread_create(&thread, NULL, sources_main, NULL);
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+		if (err != 0) {
+			report(RPT_ERR, "%s: cannot create the sampling thread - %s",
+			       __FUNCTION__, strerror(err));
+			sources_shutdown();
+			return -1;
+		}
+		running = 1;
+	}
+#endif
+	return 0;
+}
+
+
+/**
+ * Stop sampling and forget the data sources. Waits for a sample being
+ * taken; the widgets keep the values they show.
+ */
+void
+sources_shutdown(void)
+{
+	int i;
+
+#ifdef USE_THREADS
+	if (running) {
+		LOCK();
+		stopping = 1;
+		pthread_cond_broadcast(&sources_cond);
+		UNLOCK();
+		pthread_join(thread, NULL);
+		running = 0;
+	}
+#endif
+	for (i = 0; i < num_sources; i++)
+		free(sources[i].spec);
+	num_sources = 0;
+}
+
+
+/**
+ * Tell whether a widget of this type can show a data source.
+ * \param type  Widget type.
+ * \return  1 for strings, pbars and graphs; 0 otherwise.
+ */
+int
+sources_widget_type(WidgetType type)
+{
+	return (type == WID_STRING) || (type == WID_PBAR) || (type == WID_GRAPH);
+}
+
+
+/*
+ * Put a value into a widget: strings show it as it is, bars its fraction
+ * of the full scale value. A graph adds one value per sample.
+ */
+static void
+sources_show(Widget *w, const Source *src, const char *value, int sample)
+{
+	int promille = (int) (strtod(value, NULL) * 1000 / src->full_scale);
+
+	if (promille < 0)
+		promille = 0;
+	else if (promille > 1000)
+		promille = 1000;
+
+	switch (w->type) {
+	case WID_STRING:
+		w->text = widget_strset(w, w->text, value);
+		break;
+	case WID_PBAR:
+		if (promille != w->promille) {
+			w->promille = promille;
+			w->dirty = 1;
+		}
+		break;
+	case WID_GRAPH:
+		if (sample && (w->width > 0))
+			widget_graph_add(w, w->width, promille);
+		break;
+	default:
+		break;
+	}
+}
+
+
+/* Put a new value into the widgets of a screen and its frames that are
+ * bound to the source. */
+static void
+sources_show_screen(Screen *s, const Source *src, const char *value)
+{
+	Widget *w;
+	int i;
+
+	for (i = 0; (w = V_Get(s->widgetlist, i)) != NULL; i++) {
+		if ((w->type == WID_FRAME) && (w->frame_screen != NULL))
+			sources_show_screen(w->frame_screen, src, value);
+		else if ((w->source != NULL) && (strcmp(w->source, src->name) == 0))
+			sources_show(w, src, value, 1);
+	}
+}
+
+
+/**
+ * Bind a widget to a data source; the widget shows the last value right
+ * away, if there is one.
+ * \param w     The widget, of a type sources_widget_type() accepts.
+ * \param name  Name of the data source.
+ * \retval 0   Success.
+ * \retval -1  There is no such source, or no memory.
+ */
+int
+sources_bind(Widget *w, const char *name)
+{
+	Source *src = sources_find(name);
+	char value[SOURCE_VALUE_SIZE];
+	unsigned long serial;
+
+	if (src == NULL)
+		return -1;
+	w->source = pool_strset(widget_pool(w), w->source, name);
+	if (w->source == NULL)
+		return -1;
+
+	LOCK();
+	serial = src->serial;
+	strcpy(value, src->value);
+	UNLOCK();
+	if (serial > 0)
+		sources_show(w, src, value, 0);
+	return 0;
+}
+
+
+/**
+ * Tell whether there are data sources; the main loop then does not park
+ * longer than a processing stroke, so new values are seen in time.
+ * \return  1 if there are data sources, 0 otherwise.
+ */
+int
+sources_active(void)
+{
+	return (num_sources > 0);
+}
+
+
+/**
+ * Put the values sampled since the last call into the widgets bound to
+ * them. Called by the main loop in every processing stroke.
+ * \return  1 if there were new values, 0 otherwise.
+ */
+int
+sources_poll(void)
+{
+	static char values[MAX_SOURCES][SOURCE_VALUE_SIZE];
+	int changed[MAX_SOURCES];
+	int i, any = 0;
+	Client *c;
+
+	if (num_sources == 0)
+		return 0;
+
+	LOCK();
+#ifndef USE_THREADS
+	{
+		unsigned long long now = sources_now();
+
+		for (i = 0; i < num_sources; i++) {
+			if (sources[i].due <= now)
+				sources_sample(&sources[i]);
+		}
+	}
+#endif
+	for (i = 0; i < num_sources; i++) {
+		changed[i] = (sources[i].serial != sources[i].shown);
+		if (changed[i]) {
+			strcpy(values[i], sources[i].value);
+			sources[i].shown = sources[i].serial;
+			any = 1;
+		}
+	}
+	UNLOCK();
+	if (!any)
+		return 0;
+
+	for (c = clients_getfirst(); c != NULL; c = clients_getnext(c)) {
+		Screen *s;
+		int j;
+
+		for (j = 0; (s = V_Get(c->screenlist, j)) != NULL; j++) {
+			for (i = 0; i < num_sources; i++) {
+				if (changed[i])
+					sources_show_screen(s, &sources[i], values[i]);
+			}
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,40 @@
+/** \file server/sources.h
+ * Interface to the data sources the server samples for widgets.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef SOURCES_H
+#define SOURCES_H
+
+#include "widget.h"
+
+/** Most data sources in the configuration */
+#define MAX_SOURCES		32
+
+/** Longest value of a data source kept, with the 0 */
+#define SOURCE_VALUE_SIZE	256
+
+/* Read the data sources from the configuration and start sampling them. */
+int sources_init(void);
+
+/* Stop sampling and forget the data sources. */
+void sources_shutdown(void);
+
+/* Tell whether a widget of this type can show a data source. */
+int sources_widget_type(WidgetType type);
+
+/* Bind a widget to a data source and show its last value. */
+int sources_bind(Widget *w, const char *name);
+
+/* Tell whether the main loop has to poll for new values. */
+int sources_active(void);
+
+/* Show new values in the widgets bound to them. */
+int sources_poll(void);
+
+#endif
@@ -0,0 +1,34 @@
+/** \file server/static_drivers.h
+ * Registry of the drivers linked into LCDd (configure
+ * --enable-static-drivers). The table is generated at build time by
+ * server/drivers/static-link.sh; the server binds a driver from it instead
+ * of loading the driver's module.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef STATIC_DRIVERS_H
+#define STATIC_DRIVERS_H
+
+#include <stddef.h>
+
+/** A global symbol of a driver linked into LCDd */
+typedef struct static_symbol {
+	const char *name;	/**< Name, as it would be in the module */
+	void *addr;		/**< Its address */
+} StaticSymbol;
+
+/** A driver linked into LCDd */
+typedef struct static_driver {
+	const char *name;		/**< Name of its module without extension */
+	const StaticSymbol *symbols;	/**< Its API entries, ending with a NULL name */
+} StaticDriver;
+
+/** The drivers linked into LCDd, ending with a NULL name */
+extern const StaticDriver static_drivers[];
+
+#endif
@@ -0,0 +1,901 @@
+/** \file server/stats.c
+ * This file contains the server's timing and load statistics: how long
+ * rendering a frame, flushing each driver and parsing each client's input
+ * takes, how many frames were skipped or dropped, and how much data is
+ * queued for and from each client. They tell whether a stutter on the
+ * display comes from a slow driver or from a client flooding the server.
+ *
+ * The statistics are reported to clients by the \c stats command and,
+ * if configured, in the Prometheus text format on a UNIX socket: every
+ * connection to it receives a snapshot and is closed.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "shared/report.h"
+#include "shared/sockets.h"
+#include "shared/intern.h"
+
+#include "main.h"
+#include "drivers.h"
+#include "drvthread.h"
+#include "clients.h"
+#include "sock.h"
+#include "stats.h"
+#include "profile.h"
+
+ServerStats server_stats;
+
+const unsigned long stats_bucket_bounds[STATS_BUCKETS - 1] = {
+	100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000
+};
+
+/** Flush times and I/O of a loaded driver */
+typedef struct DriverStats {
+	Driver *drv;
+	StatsHistogram flush;
+	unsigned long long io[IO_COUNTERS];
+	unsigned long reconnects;
+	StatsHistogram key_latency;
+} DriverStats;
+
+/** Names of the I/O counters in the replies and the Prometheus metrics */
+static const struct {
+	const char *name;
+	const char *metric;
+	const char *help;
+} io_counters[IO_COUNTERS] = {
+	{ "bytes",  "lcdd_driver_written_bytes_total",  "Bytes a driver wrote to its device." },
+	{ "chars",  "lcdd_driver_chars_total",          "Characters a driver wrote to its display." },
+	{ "cgram",  "lcdd_driver_cgram_uploads_total",  "Custom characters a driver uploaded." },
+	{ "errors", "lcdd_driver_io_errors_total",      "Failed reads and writes of a driver." },
+	{ "writes", "lcdd_driver_writes_total",         "Writes, transfers or datagrams a driver sent." }
+};
+
+/* Entries are only added and removed while no flush thread runs */
+static DriverStats driver_stats[MAX_DRIVERS];
+
+/** Most steps of the startup that are timed */
+#define STARTUP_STEPS		16
+
+/** A step of the startup and how long it took */
+typedef struct StartupStep {
+	const char *name;
+	unsigned long usec;
+} StartupStep;
+
+static StartupStep startup_steps[STARTUP_STEPS];
+static int startup_count = 0;
+static unsigned long startup_begin = 0;	/**< When main() started */
+static unsigned long startup_last;	/**< When the last step ended */
+static int startup_done = 0;		/**< Set by the first frame */
+
+static int stats_fd = -1;		/**< Listening Prometheus endpoint */
+static char *stats_path = NULL;		/**< Its path, removed on shutdown */
+
+/** Growing text buffer for a Prometheus snapshot */
+typedef struct StatsBuffer {
+	char *text;
+	size_t len;
+	size_t size;
+} StatsBuffer;
+
+
+/**
+ * Get the current time for measuring durations.
+ * \return  Time in microseconds. The value wraps around, but differences
+ *          of two values are valid for intervals of up to an hour.
+ */
+unsigned long
+stats_clock(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (unsigned long) tv.tv_sec * 1000000UL + tv.tv_usec;
+}
+
+
+/**
+ * Add a duration to a histogram.
+ * \param h     The histogram.
+ * \param usec  Duration in microseconds.
+ */
+void
+stats_histogram_add(StatsHistogram *h, unsigned long usec)
+{
+	int i;
+
+	/* the clock was set back */
+	if (usec > 3600000000UL)
+		return;
+
+	for (i = 0; (i < STATS_BUCKETS - 1) && (usec > stats_bucket_bounds[i]); i++)
+		;
+	h->buckets[i]++;
+	h->count++;
+	h->sum += usec;
+	if (usec > h->max)
+		h->max = usec;
+}
+
+
+/** Number of clients that replied to an event since the last frame */
+static int clients_replied = 0;
+
+
+/**
+ * Note that a key was read from a driver. The time to the next frame is
+ * added to the key_render histogram; keys read before that frame count
+ * from the first of them.
+ */
+void
+stats_key_pressed(void)
+{
+	if (server_stats.key_pressed == 0)
+		server_stats.key_pressed = stats_clock();
+}
+
+
+/**
+ * Note that a key or menu event was sent to a client. Its next command
+ * counts as the reply.
+ * \param c  The client.
+ */
+void
+stats_client_event(Client *c)
+{
+	if ((c != NULL) && (c->event_sent == 0))
+		c->event_sent = stats_clock();
+}
+
+
+/**
+ * Start timing the startup of the server.
+ */
+void
+stats_startup_begin(void)
+{
+	startup_begin = startup_last = stats_clock();
+	startup_count = 0;
+	startup_done = 0;
+}
+
+
+/**
+ * Note that a step of the startup is done; it took the time since the
+ * previous one.
+ * \param name  Name of the step, a string constant.
+ */
+void
+stats_startup_step(const char *name)
+{
+	unsigned long now;
+
+	if (startup_done || (startup_count >= STARTUP_STEPS))
+		return;
+	now = stats_clock();
+	startup_steps[startup_count].name = name;
+	startup_steps[startup_count].usec = now - startup_last;
+	startup_count++;
+	startup_last = now;
+}
+
+
+/**
+ * Note that the first frame is done, which ends the startup, and report
+ * how long it and each of its steps took. Later calls do nothing.
+ */
+void
+stats_startup_frame(void)
+{
+	int i;
+
+	if (startup_done)
+		return;
+	stats_startup_step("first_frame");
+	startup_done = 1;
+
+	report(RPT_NOTICE, "Startup took %lu ms to the first frame",
+	       (startup_last - startup_begin) / 1000);
+	for (i = 0; i < startup_count; i++)
+		report(RPT_INFO, "Startup: %-14s %8lu us",
+		       startup_steps[i].name, startup_steps[i].usec);
+}
+
+
+/**
+ * Note that a client sent a command. If it had an event to answer, the
+ * time it took goes to its reply_time histogram, and the next frame
+ * completes its event_render time. A slow client shows in reply_time,
+ * a slow server in the difference between the two.
+ * \param c  The client.
+ */
+void
+stats_client_replied(Client *c)
+{
+	if (c->event_sent == 0)
+		return;
+	stats_histogram_add(&c->reply_time, stats_clock() - c->event_sent);
+	if (c->event_replied == 0)
+		clients_replied++;
+	c->event_replied = c->event_sent;
+	c->event_sent = 0;
+}
+
+
+/**
+ * Note that the main loop has finished a frame: rendered it, or found
+ * that nothing on the display changed.
+ */
+void
+stats_frame_done(void)
+{
+	unsigned long now;
+	Client *c;
+
+	if ((server_stats.key_pressed == 0) && (clients_replied == 0))
+		return;
+
+	now = stats_clock();
+	if (server_stats.key_pressed != 0) {
+		stats_histogram_add(&server_stats.key_render, now - server_stats.key_pressed);
+		server_stats.key_pressed = 0;
+	}
+	if (clients_replied == 0)
+		return;
+	for (c = clients_getfirst(); c != NULL; c = clients_getnext(c)) {
+		if (c->event_replied != 0) {
+			stats_histogram_add(&c->event_render, now - c->event_replied);
+			c->event_replied = 0;
+		}
+	}
+	clients_replied = 0;
+}
+
+
+/* Find the statistics of a driver */
+static DriverStats *
+stats_driver_find(Driver *drv)
+{
+	int i;
+
+	for (i = 0; i < MAX_DRIVERS; i++) {
+		if (driver_stats[i].drv == drv)
+			return &driver_stats[i];
+	}
+	return NULL;
+}
+
+
+/**
+ * Start keeping the flush times and I/O counters of a driver.
+ * \param drv  The driver.
+ * \return  -1 if there are too many drivers, 0 on success.
+ */
+int
+stats_driver_add(Driver *drv)
+{
+	int i;
+
+	for (i = 0; i < MAX_DRIVERS; i++) {
+		if (driver_stats[i].drv == NULL) {
+			memset(&driver_stats[i], 0, sizeof(DriverStats));
+			driver_stats[i].drv = drv;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+
+/**
+ * Forget the statistics of a driver.
+ * \param drv  The driver.
+ */
+void
+stats_driver_remove(Driver *drv)
+{
+	int i;
+
+	for (i = 0; i < MAX_DRIVERS; i++) {
+		if (driver_stats[i].drv == drv)
+			driver_stats[i].drv = NULL;
+	}
+}
+
+
+/**
+ * Get the histogram of a driver's flush times. It is only updated by the
+ * thread flushing the driver, while it holds the driver (see
+ * drvthread_lock()).
+ * \param drv  The driver.
+ * \return  The histogram, or NULL if the driver is unknown.
+ */
+StatsHistogram *
+stats_driver_flush(Driver *drv)
+{
+	DriverStats *ds = stats_driver_find(drv);
+
+	return (ds != NULL) ? &ds->flush : NULL;
+}
+
+
+/**
+ * Add to one of a driver's I/O counters; drivers call this as count_io(),
+ * from their functions, so it runs like the flush with the driver held.
+ * \param drv      The driver.
+ * \param counter  IO_BYTES, IO_CHARS, IO_CGRAM, IO_ERRORS or IO_WRITES.
+ * \param n        Amount to add.
+ */
+void
+stats_driver_count(Driver *drv, int counter, long n)
+{
+	DriverStats *ds;
+
+	if ((counter < 0) || (counter >= IO_COUNTERS) || (n <= 0))
+		return;
+	if ((ds = stats_driver_find(drv)) != NULL)
+		ds->io[counter] += n;
+}
+
+
+/**
+ * Add the time from a key press on a driver, as get_key_event() tells it,
+ * to the key being sent to a client or handled by the server. Only the
+ * main loop reads keys, so this needs no lock.
+ * \param drv   The driver the key came from.
+ * \param usec  The latency in microseconds.
+ */
+void
+stats_driver_key(Driver *drv, unsigned long usec)
+{
+	DriverStats *ds = stats_driver_find(drv);
+
+	if (ds != NULL)
+		stats_histogram_add(&ds->key_latency, usec);
+}
+
+
+/**
+ * Count a driver's device coming back after it was lost. Called by the
+ * thread that initialized the driver again, with the driver held.
+ * \param drv  The driver.
+ */
+void
+stats_driver_reconnected(Driver *drv)
+{
+	DriverStats *ds = stats_driver_find(drv);
+
+	if (ds != NULL)
+		ds->reconnects++;
+}
+
+
+/**
+ * Copy the statistics of a driver.
+ * \param drv    The driver.
+ * \param block  Where to put them.
+ * \return  -1 if the driver is unknown, 0 on success.
+ */
+int
+stats_driver_get(Driver *drv, DriverStatsBlock *block)
+{
+	DriverStats *ds = stats_driver_find(drv);
+
+	if (ds == NULL)
+		return -1;
+
+	drvthread_lock(drv);
+	block->flush = ds->flush;
+	memcpy(block->io, ds->io, sizeof(block->io));
+	block->reconnects = ds->reconnects;
+	drvthread_unlock(drv);
+	block->key_latency = ds->key_latency;
+	block->dropped = drvthread_dropped(drv);
+	return 0;
+}
+
+
+/* Format a histogram for the stats command: count, sum and maximum,
+ * followed by the cumulative bucket counts */
+static void
+stats_format_histogram(char *buf, size_t size, const StatsHistogram *h)
+{
+	unsigned long cumulative = 0;
+	size_t len;
+	int i;
+
+	len = snprintf(buf, size, "count %lu sum %llu max %lu",
+		       h->count, h->sum, h->max);
+	for (i = 0; (i < STATS_BUCKETS) && (len < size); i++) {
+		cumulative += h->buckets[i];
+		if (i < STATS_BUCKETS - 1)
+			len += snprintf(buf + len, size - len, " le_%lu %lu",
+					stats_bucket_bounds[i], cumulative);
+		else
+			len += snprintf(buf + len, size - len, " le_inf %lu", cumulative);
+	}
+}
+
+
+/* Format the statistics of a driver for the stats and driver_stats
+ * commands */
+static void
+stats_format_driver(char *buf, size_t size, const DriverStatsBlock *block)
+{
+	size_t len;
+	int i;
+
+	len = snprintf(buf, size, "dropped %d", block->dropped);
+	for (i = 0; (i < IO_COUNTERS) && (len < size); i++)
+		len += snprintf(buf + len, size - len, " %s %llu",
+				io_counters[i].name, block->io[i]);
+	if (len < size)
+		len += snprintf(buf + len, size - len, " reconnects %lu ", block->reconnects);
+	if (len < size)
+		stats_format_histogram(buf + len, size - len, &block->flush);
+}
+
+
+/**
+ * Send the statistics of one or all drivers to a client, in reply to the
+ * \c driver_stats command: a line per driver, starting with
+ * \c driver_stats and the driver's name.
+ * \param sock  The client's socket.
+ * \param name  Name of the driver; NULL for all.
+ * \return  -1 if there is no driver of that name, 0 otherwise.
+ */
+int
+stats_send_drivers(int sock, const char *name)
+{
+	DriverStatsBlock block;
+	char buf[768];
+	Driver *drv;
+	int found = 0;
+	int i;
+
+	for (i = 0; (drv = drivers_get(i)) != NULL; i++) {
+		if ((name != NULL) && (strcmp(name, drv->name) != 0))
+			continue;
+		found = 1;
+		if (stats_driver_get(drv, &block) < 0)
+			continue;
+		stats_format_driver(buf, sizeof(buf), &block);
+		sock_printf(sock, "driver_stats %s %s\n", drv->name, buf);
+	}
+	return (found || (name == NULL)) ? 0 : -1;
+}
+
+
+/**
+ * Send all statistics to a client, in reply to the \c stats command.
+ * Every line starts with \c stats, followed by what it describes.
+ * \param sock  The client's socket.
+ */
+void
+stats_send(int sock)
+{
+	char hist[768];
+	ClientMemory mem;
+	Driver *drv;
+	int i;
+	Client *c;
+
+	sock_printf(sock, "stats server frames_rendered %lu frames_skipped %lu frames_dropped %lu render_lag_max %lu clients %d frames_key %lu\n",
+		    server_stats.frames_rendered, server_stats.frames_skipped,
+		    server_stats.frames_dropped, server_stats.render_lag_max,
+		    clients_client_count(), server_stats.frames_key);
+
+	stats_format_histogram(hist, sizeof(hist), &server_stats.render);
+	sock_printf(sock, "stats render %s\n", hist);
+	stats_format_histogram(hist, sizeof(hist), &server_stats.process);
+	sock_printf(sock, "stats process %s\n", hist);
+	stats_format_histogram(hist, sizeof(hist), &server_stats.key_render);
+	sock_printf(sock, "stats key_render %s\n", hist);
+
+	for (i = 0; (drv = drivers_get(i)) != NULL; i++) {
+		DriverStatsBlock block;
+
+		if (stats_driver_get(drv, &block) < 0)
+			continue;
+		stats_format_driver(hist, sizeof(hist), &block);
+		sock_printf(sock, "stats driver %s %s\n", drv->name, hist);
+		if (drv->get_key != NULL) {
+			stats_format_histogram(hist, sizeof(hist), &block.key_latency);
+			sock_printf(sock, "stats driver_key %s %s\n", drv->name, hist);
+		}
+	}
+
+	for (c = clients_getfirst(); c != NULL; c = clients_getnext(c)) {
+		stats_format_histogram(hist, sizeof(hist), &c->parse_time);
+		sock_printf(sock, "stats client %d commands %lu messages %d input %d output %d memory %lu %s\n",
+			    c->sock, c->commands, V_Length(c->messages),
+			    sock_queued_input(c), sock_queued_output(c),
+			    (unsigned long) c->pool->size, hist);
+		stats_format_histogram(hist, sizeof(hist), &c->reply_time);
+		sock_printf(sock, "stats client_reply %d %s\n", c->sock, hist);
+		stats_format_histogram(hist, sizeof(hist), &c->event_render);
+		sock_printf(sock, "stats client_render %d %s\n", c->sock, hist);
+		client_memory(c, &mem);
+		sock_printf(sock, "stats client_memory %d screens %lu widgets %lu menus %lu messages %lu keys %lu strings %lu total %lu limit %lu\n",
+			    c->sock, (unsigned long) mem.screens, (unsigned long) mem.widgets,
+			    (unsigned long) mem.menus, (unsigned long) mem.messages,
+			    (unsigned long) mem.keys, (unsigned long) mem.strings,
+			    (unsigned long) mem.total,
+			    (unsigned long) client_memory_limit);
+	}
+	sock_printf(sock, "stats strings count %d memory %lu\n",
+		    intern_count(), (unsigned long) intern_size());
+	if (startup_done) {
+		size_t len = 0;
+
+		hist[0] = '\0';
+		for (i = 0; (i < startup_count) && (len < sizeof(hist)); i++)
+			len += snprintf(hist + len, sizeof(hist) - len, "%s %lu ",
+					startup_steps[i].name, startup_steps[i].usec);
+		sock_printf(sock, "stats startup %stotal %lu\n",
+			    hist, startup_last - startup_begin);
+	}
+
+	profile_send(sock);
+}
+
+
+/* Append formatted text to a snapshot */
+static void
+stats_buffer_printf(StatsBuffer *b, const char *format, ...)
+{
+	va_list ap;
+	int n;
+
+	for (;;) {
+		if (b->text != NULL) {
+			va_start(ap, format);
+			n = vsnprintf(b->text + b->len, b->size - b->len, format, ap);
+			va_end(ap);
+			if ((n >= 0) && ((size_t) n < b->size - b->len)) {
+				b->len += n;
+				return;
+			}
+		}
+		else
+			n = 0;
+
+		/* grow and try again */
+		{
+			size_t size = (b->size > 0) ? b->size * 2 : 4096;
+			char *text;
+
+			while (size < b->len + n + 1)
+				size *= 2;
+			text = realloc(b->text, size);
+			if (text == NULL)
+				return;
+			b->text = text;
+			b->size = size;
+		}
+	}
+}
+
+
+/* Append a histogram in Prometheus format; labels may be empty */
+static void
+stats_buffer_histogram(StatsBuffer *b, const char *name, const char *labels,
+		       const StatsHistogram *h)
+{
+	unsigned long cumulative = 0;
+	const char *sep = (*labels != '\0') ? "," : "";
+	int i;
+
+	for (i = 0; i < STATS_BUCKETS; i++) {
+		cumulative += h->buckets[i];
+		if (i < STATS_BUCKETS - 1)
+			stats_buffer_printf(b, "%s_bucket{%s%sle=\"%g\"} %lu\n", name, labels, sep,
+					    stats_bucket_bounds[i] / 1e6, cumulative);
+		else
+			stats_buffer_printf(b, "%s_bucket{%s%sle=\"+Inf\"} %lu\n", name, labels, sep,
+					    cumulative);
+	}
+	if (*labels != '\0') {
+		stats_buffer_printf(b, "%s_sum{%s} %g\n", name, labels, h->sum / 1e6);
+		stats_buffer_printf(b, "%s_count{%s} %lu\n", name, labels, h->count);
+	}
+	else {
+		stats_buffer_printf(b, "%s_sum %g\n", name, h->sum / 1e6);
+		stats_buffer_printf(b, "%s_count %lu\n", name, h->count);
+	}
+}
+
+
+/* Make a string usable as a Prometheus label value */
+static void
+stats_escape_label(char *dst, size_t size, const char *src)
+{
+	size_t len = 0;
+
+	for (; (src != NULL) && (*src != '\0') && (len + 3 < size); src++) {
+		if ((*src == '"') || (*src == '\\'))
+			dst[len++] = '\\';
+		if (*src == '\n') {
+			dst[len++] = '\\';
+			dst[len++] = 'n';
+		}
+		else
+			dst[len++] = *src;
+	}
+	dst[len] = '\0';
+}
+
+
+/* Build a snapshot of all statistics in the Prometheus text format */
+static void
+stats_buffer_snapshot(StatsBuffer *b)
+{
+	DriverStatsBlock blocks[MAX_DRIVERS];
+	char labels[256];
+	char name[128];
+	Driver *drv;
+	int i, j, n;
+	Client *c;
+
+	stats_buffer_printf(b, "# HELP lcdd_frames_rendered_total Frames sent to the drivers.\n"
+			       "# TYPE lcdd_frames_rendered_total counter\n"
+			       "lcdd_frames_rendered_total %lu\n", server_stats.frames_rendered);
+	stats_buffer_printf(b, "# HELP lcdd_frames_skipped_total Frames not rendered because nothing changed.\n"
+			       "# TYPE lcdd_frames_skipped_total counter\n"
+			       "lcdd_frames_skipped_total %lu\n", server_stats.frames_skipped);
+	stats_buffer_printf(b, "# HELP lcdd_frames_dropped_total Frames lost because rendering lagged behind.\n"
+			       "# TYPE lcdd_frames_dropped_total counter\n"
+			       "lcdd_frames_dropped_total %lu\n", server_stats.frames_dropped);
+	stats_buffer_printf(b, "# HELP lcdd_frames_key_total Frames rendered right after a key, between ticks.\n"
+			       "# TYPE lcdd_frames_key_total counter\n"
+			       "lcdd_frames_key_total %lu\n", server_stats.frames_key);
+	stats_buffer_printf(b, "# HELP lcdd_render_lag_max_seconds Largest rendering lag seen.\n"
+			       "# TYPE lcdd_render_lag_max_seconds gauge\n"
+			       "lcdd_render_lag_max_seconds %g\n", server_stats.render_lag_max / 1e6);
+	stats_buffer_printf(b, "# HELP lcdd_clients Connected clients.\n"
+			       "# TYPE lcdd_clients gauge\n"
+			       "lcdd_clients %d\n", clients_client_count());
+
+	if (startup_done) {
+		stats_buffer_printf(b, "# HELP lcdd_startup_step_seconds Time a step of the startup took.\n"
+				       "# TYPE lcdd_startup_step_seconds gauge\n");
+		for (i = 0; i < startup_count; i++)
+			stats_buffer_printf(b, "lcdd_startup_step_seconds{step=\"%s\"} %g\n",
+					    startup_steps[i].name, startup_steps[i].usec / 1e6);
+	}
+
+	stats_buffer_printf(b, "# HELP lcdd_render_seconds Time to render and flush a frame.\n"
+			       "# TYPE lcdd_render_seconds histogram\n");
+	stats_buffer_histogram(b, "lcdd_render_seconds", "", &server_stats.render);
+	stats_buffer_printf(b, "# HELP lcdd_process_seconds Time to process client input.\n"
+			       "# TYPE lcdd_process_seconds histogram\n");
+	stats_buffer_histogram(b, "lcdd_process_seconds", "", &server_stats.process);
+	stats_buffer_printf(b, "# HELP lcdd_key_render_seconds Time from a key press to the next frame.\n"
+			       "# TYPE lcdd_key_render_seconds histogram\n");
+	stats_buffer_histogram(b, "lcdd_key_render_seconds", "", &server_stats.key_render);
+
+	for (n = 0; (n < MAX_DRIVERS) && ((drv = drivers_get(n)) != NULL); n++) {
+		if (stats_driver_get(drv, &blocks[n]) < 0)
+			memset(&blocks[n], 0, sizeof(DriverStatsBlock));
+	}
+
+	stats_buffer_printf(b, "# HELP lcdd_driver_flush_seconds Time to flush a frame to a driver.\n"
+			       "# TYPE lcdd_driver_flush_seconds histogram\n");
+	for (i = 0; i < n; i++) {
+		drv = drivers_get(i);
+		stats_escape_label(name, sizeof(name), drv->name);
+		snprintf(labels, sizeof(labels), "driver=\"%s\"", name);
+		stats_buffer_histogram(b, "lcdd_driver_flush_seconds", labels, &blocks[i].flush);
+	}
+	stats_buffer_printf(b, "# HELP lcdd_driver_key_latency_seconds Time from a key press on a driver to its dispatch.\n"
+			       "# TYPE lcdd_driver_key_latency_seconds histogram\n");
+	for (i = 0; i < n; i++) {
+		drv = drivers_get(i);
+		if (drv->get_key == NULL)
+			continue;
+		stats_escape_label(name, sizeof(name), drv->name);
+		snprintf(labels, sizeof(labels), "driver=\"%s\"", name);
+		stats_buffer_histogram(b, "lcdd_driver_key_latency_seconds", labels, &blocks[i].key_latency);
+	}
+	stats_buffer_printf(b, "# HELP lcdd_driver_dropped_frames_total Frames a flush thread skipped.\n"
+			       "# TYPE lcdd_driver_dropped_frames_total counter\n");
+	for (i = 0; i < n; i++) {
+		stats_escape_label(name, sizeof(name), drivers_get(i)->name);
+		stats_buffer_printf(b, "lcdd_driver_dropped_frames_total{driver=\"%s\"} %d\n",
+				    name, blocks[i].dropped);
+	}
+	for (j = 0; j < IO_COUNTERS; j++) {
+		stats_buffer_printf(b, "# HELP %s %s\n# TYPE %s counter\n",
+				    io_counters[j].metric, io_counters[j].help, io_counters[j].metric);
+		for (i = 0; i < n; i++) {
+			stats_escape_label(name, sizeof(name), drivers_get(i)->name);
+			stats_buffer_printf(b, "%s{driver=\"%s\"} %llu\n",
+					    io_counters[j].metric, name, blocks[i].io[j]);
+		}
+	}
+	stats_buffer_printf(b, "# HELP lcdd_driver_reconnects_total Times a driver's device came back.\n"
+			       "# TYPE lcdd_driver_reconnects_total counter\n");
+	for (i = 0; i < n; i++) {
+		stats_escape_label(name, sizeof(name), drivers_get(i)->name);
+		stats_buffer_printf(b, "lcdd_driver_reconnects_total{driver=\"%s\"} %lu\n",
+				    name, blocks[i].reconnects);
+	}
+
+	stats_buffer_printf(b, "# HELP lcdd_client_parse_seconds Time to parse a client's input.\n"
+			       "# TYPE lcdd_client_parse_seconds histogram\n");
+	for (c = clients_getfirst(); c != NULL; c = clients_getnext(c)) {
+		stats_escape_label(name, sizeof(name), c->name);
+		snprintf(labels, sizeof(labels), "client=\"%d\",name=\"%s\"", c->sock, name);
+		stats_buffer_histogram(b, "lcdd_client_parse_seconds", labels, &c->parse_time);
+	}
+	stats_buffer_printf(b, "# HELP lcdd_client_reply_seconds Time from a key or menu event to the client's next command.\n"
+			       "# TYPE lcdd_client_reply_seconds histogram\n");
+	for (c = clients_getfirst(); c != NULL; c = clients_getnext(c)) {
+		stats_escape_label(name, sizeof(name), c->name);
+		snprintf(labels, sizeof(labels), "client=\"%d\",name=\"%s\"", c->sock, name);
+		stats_buffer_histogram(b, "lcdd_client_reply_seconds", labels, &c->reply_time);
+	}
+	stats_buffer_printf(b, "# HELP lcdd_client_event_render_seconds Time from a key or menu event to the frame after the client's reply.\n"
+			       "# TYPE lcdd_client_event_render_seconds histogram\n");
+	for (c = clients_getfirst(); c != NULL; c = clients_getnext(c)) {
+		stats_escape_label(name, sizeof(name), c->name);
+		snprintf(labels, sizeof(labels), "client=\"%d\",name=\"%s\"", c->sock, name);
+		stats_buffer_histogram(b, "lcdd_client_event_render_seconds", labels, &c->event_render);
+	}
+	stats_buffer_printf(b, "# HELP lcdd_client_commands_total Commands a client sent.\n"
+			       "# TYPE lcdd_client_commands_total counter\n");
+	for (c = clients_getfirst(); c != NULL; c = clients_getnext(c))
+		stats_buffer_printf(b, "lcdd_client_commands_total{client=\"%d\"} %lu\n",
+				    c->sock, c->commands);
+	stats_buffer_printf(b, "# HELP lcdd_client_queued_messages Messages received, not yet parsed.\n"
+			       "# TYPE lcdd_client_queued_messages gauge\n");
+	for (c = clients_getfirst(); c != NULL; c = clients_getnext(c))
+		stats_buffer_printf(b, "lcdd_client_queued_messages{client=\"%d\"} %d\n",
+				    c->sock, V_Length(c->messages));
+	stats_buffer_printf(b, "# HELP lcdd_client_input_bytes Bytes received, not yet split into messages.\n"
+			       "# TYPE lcdd_client_input_bytes gauge\n");
+	for (c = clients_getfirst(); c != NULL; c = clients_getnext(c))
+		stats_buffer_printf(b, "lcdd_client_input_bytes{client=\"%d\"} %d\n",
+				    c->sock, sock_queued_input(c));
+	stats_buffer_printf(b, "# HELP lcdd_client_output_bytes Bytes queued for sending to a client.\n"
+			       "# TYPE lcdd_client_output_bytes gauge\n");
+	for (c = clients_getfirst(); c != NULL; c = clients_getnext(c))
+		stats_buffer_printf(b, "lcdd_client_output_bytes{client=\"%d\"} %d\n",
+				    c->sock, sock_queued_output(c));
+	stats_buffer_printf(b, "# HELP lcdd_client_memory_bytes Memory held by a client's messages, screens and widgets.\n"
+			       "# TYPE lcdd_client_memory_bytes gauge\n");
+	for (c = clients_getfirst(); c != NULL; c = clients_getnext(c))
+		stats_buffer_printf(b, "lcdd_client_memory_bytes{client=\"%d\"} %lu\n",
+				    c->sock, (unsigned long) c->pool->size);
+	stats_buffer_printf(b, "# HELP lcdd_client_memory_used_bytes Memory a client's screens, widgets, menus, messages, keys and interned strings use.\n"
+			       "# TYPE lcdd_client_memory_used_bytes gauge\n");
+	for (c = clients_getfirst(); c != NULL; c = clients_getnext(c)) {
+		ClientMemory mem;
+
+		client_memory(c, &mem);
+		stats_buffer_printf(b, "lcdd_client_memory_used_bytes{client=\"%d\",kind=\"screens\"} %lu\n"
+				       "lcdd_client_memory_used_bytes{client=\"%d\",kind=\"widgets\"} %lu\n"
+				       "lcdd_client_memory_used_bytes{client=\"%d\",kind=\"menus\"} %lu\n"
+				       "lcdd_client_memory_used_bytes{client=\"%d\",kind=\"messages\"} %lu\n"
+				       "lcdd_client_memory_used_bytes{client=\"%d\",kind=\"keys\"} %lu\n"
+				       "lcdd_client_memory_used_bytes{client=\"%d\",kind=\"strings\"} %lu\n",
+				    c->sock, (unsigned long) mem.screens, c->sock, (unsigned long) mem.widgets,
+				    c->sock, (unsigned long) mem.menus, c->sock, (unsigned long) mem.messages,
+				    c->sock, (unsigned long) mem.keys, c->sock, (unsigned long) mem.strings);
+	}
+}
+
+
+/**
+ * Open the Prometheus endpoint.
+ * \param path  Path of the UNIX socket; an existing socket is replaced.
+ * \return  -1 on error, 0 on success.
+ */
+int
+stats_socket_init(const char *path)
+{
+	struct sockaddr_un addr;
+
+	stats_socket_shutdown();
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		report(RPT_ERR, "%s: socket path too long: %s", __FUNCTION__, path);
+		return -1;
+	}
+
+	stats_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (stats_fd < 0) {
+		report(RPT_ERR, "%s: cannot create socket - %s", __FUNCTION__, strerror(errno));
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+
+	if ((bind(stats_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+	    || (listen(stats_fd, 4) < 0)) {
+		report(RPT_ERR, "%s: cannot listen on %s - %s", __FUNCTION__, path, strerror(errno));
+		close(stats_fd);
+		stats_fd = -1;
+		return -1;
+	}
+	fcntl(stats_fd, F_SETFL, O_NONBLOCK);
+	fcntl(stats_fd, F_SETFD, FD_CLOEXEC);
+
+	stats_path = strdup(path);
+	report(RPT_INFO, "Serving statistics on %s", path);
+	return 0;
+}
+
+
+/** Close the Prometheus endpoint. */
+void
+stats_socket_shutdown(void)
+{
+	if (stats_fd >= 0)
+		close(stats_fd);
+	stats_fd = -1;
+	if (stats_path != NULL)
+		unlink(stats_path);
+	free(stats_path);
+	stats_path = NULL;
+}
+
+
+/**
+ * Send a snapshot to everyone who connected to the Prometheus endpoint
+ * since the last call. Called from the main loop's processing stroke.
+ */
+void
+stats_socket_poll(void)
+{
+	StatsBuffer b = { NULL, 0, 0 };
+	int fd;
+
+	if (stats_fd < 0)
+		return;
+
+	while ((fd = accept(stats_fd, NULL, NULL)) >= 0) {
+		size_t sent = 0;
+
+		if (b.text == NULL)
+			stats_buffer_snapshot(&b);
+
+		/* the snapshot fits into the socket buffer: a reader that
+		 * does not take it right away gets a truncated one */
+		fcntl(fd, F_SETFL, O_NONBLOCK);
+		while (sent < b.len) {
+			ssize_t n = write(fd, b.text + sent, b.len - sent);
+
+			if (n <= 0)
+				break;
+			sent += n;
+		}
+		close(fd);
+	}
+	free(b.text);
+}
@@ -0,0 +1,103 @@
+/** \file server/stats.h
+ * Interface to the server's timing and load statistics.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "drivers/lcd.h"
+
+/** Number of buckets of a histogram, the last one is unbounded */
+#define STATS_BUCKETS		12
+
+/** Distribution of durations in microseconds */
+typedef struct StatsHistogram {
+	unsigned long count;		/**< Number of samples */
+	unsigned long long sum;		/**< Sum of all samples */
+	unsigned long max;		/**< Largest sample */
+	unsigned long buckets[STATS_BUCKETS];	/**< Samples per bucket */
+} StatsHistogram;
+
+/** Counters of the main loop */
+typedef struct ServerStats {
+	StatsHistogram render;		/**< Time to render and flush a frame */
+	StatsHistogram process;		/**< Time to process client input */
+	StatsHistogram key_render;	/**< Time from a key press to the next frame */
+	unsigned long key_pressed;	/**< When the oldest key not yet shown was pressed, 0 if none */
+	unsigned long frames_rendered;	/**< Frames sent to the drivers */
+	unsigned long frames_skipped;	/**< Frames not rendered, nothing changed */
+	unsigned long frames_dropped;	/**< Frames lost because rendering lagged */
+	unsigned long frames_key;	/**< Frames rendered right after a key, between ticks */
+	unsigned long render_lag_max;	/**< Largest rendering lag seen */
+} ServerStats;
+
+extern ServerStats server_stats;
+
+/** Statistics of a loaded driver */
+typedef struct DriverStatsBlock {
+	StatsHistogram flush;			/**< Time to flush a frame */
+	unsigned long long io[IO_COUNTERS];	/**< From count_io(), by IO_* */
+	unsigned long reconnects;		/**< Times the device came back */
+	int dropped;				/**< Frames its flush thread skipped */
+	StatsHistogram key_latency;		/**< Time from a key press to its dispatch */
+} DriverStatsBlock;
+
+/* Upper bounds of the histogram buckets in microseconds. */
+extern const unsigned long stats_bucket_bounds[STATS_BUCKETS - 1];
+
+/* Current time in microseconds; only differences are meaningful. */
+unsigned long stats_clock(void);
+
+/* Add a duration to a histogram. */
+void stats_histogram_add(StatsHistogram *h, unsigned long usec);
+
+/* Measure the time from a key press, or from a key or menu event sent to
+ * a client, to the client's reply and to the next frame. */
+struct Client;
+void stats_key_pressed(void);
+void stats_client_event(struct Client *c);
+void stats_client_replied(struct Client *c);
+void stats_frame_done(void);
+
+/* Time the steps of the startup, up to the first frame, and report them. */
+void stats_startup_begin(void);
+void stats_startup_step(const char *name);
+void stats_startup_frame(void);
+
+/* Send all statistics to a client in reply to the stats command. */
+void stats_send(int sock);
+
+/* Keep flush times of a driver; forget them again when it is unloaded. */
+int stats_driver_add(Driver *drv);
+void stats_driver_remove(Driver *drv);
+StatsHistogram *stats_driver_flush(Driver *drv);
+
+/* Count I/O of a driver; drivers call this as count_io(). */
+void stats_driver_count(Driver *drv, int counter, long n);
+
+/* Add the time from a key press on a driver to its dispatch. */
+void stats_driver_key(Driver *drv, unsigned long usec);
+
+/* Count a driver's device coming back. */
+void stats_driver_reconnected(Driver *drv);
+
+/* Copy the statistics of a driver. */
+int stats_driver_get(Driver *drv, DriverStatsBlock *block);
+
+/* Send the statistics of one or all drivers to a client in reply to the
+ * driver_stats command. */
+int stats_send_drivers(int sock, const char *name);
+
+/* Open the optional endpoint that serves all statistics as Prometheus
+ * text to everyone connecting to it, and serve pending connections. */
+int stats_socket_init(const char *path);
+void stats_socket_shutdown(void);
+void stats_socket_poll(void);
+
+#endif
@@ -0,0 +1,608 @@
+/** \file server/trace.c
+ * This file records what clients send to the server in a trace file and
+ * replays such traces, to reproduce the load of real clients.
+ *
+ * A trace starts with the line "LCDd trace 1". Every record that follows
+ * holds its kind (TRACE_CONNECT, TRACE_DATA or TRACE_CLOSE), the id of the
+ * client's connection (2 bytes) and the microseconds since the previous
+ * record (4 bytes); data records add the length of the data (4 bytes) and
+ * the data as received. Numbers are big-endian.
+ *
+ * A replay connects a socket pair for every client of the trace and feeds
+ * the data through the sockets, so it takes the same way through the
+ * server as the original did. It keeps the pace of the trace, or in bench
+ * mode goes as fast as the server takes the data and renders a frame in
+ * every pass of the main loop. At the end it reports the throughput and
+ * the time until the server replied to each command.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "shared/report.h"
+
+#include "sock.h"
+#include "stats.h"
+#include "trace.h"
+
+#define TRACE_MAGIC		"LCDd trace 1\n"
+#define TRACE_HEADER_SIZE	7	/* kind, id, delay */
+#define TRACE_DATA_HEADER_SIZE	11	/* plus length */
+
+/** Clients of a replay connected at the same time */
+#define MAX_REPLAY_CLIENTS	256
+
+/** A replay ends this long after the last reply, if replies are missing */
+#define REPLAY_TIMEOUT		2000000
+
+/** Records fed in one pass of the main loop */
+#define REPLAY_RECORDS_PER_STEP	1024
+
+static FILE *trace_file = NULL;		/**< Trace being recorded */
+static unsigned long trace_last;	/**< Time of its last record */
+
+/** A client of a replay */
+typedef struct ReplayClient {
+	int id;			/**< Its id in the trace; -1 if the entry is free */
+	int fd;			/**< Our end of its socket pair */
+	int binary;		/**< Sends binary frames; replies are not timed */
+	char reply[8];		/**< Start of the reply line being read */
+	int reply_len;		/**< Bytes of the line read so far */
+	unsigned long *sent;	/**< Send times of lines waiting for a reply */
+	int sent_head;		/**< First of them */
+	int sent_tail;		/**< Behind the last of them */
+	int sent_size;		/**< Allocated entries */
+} ReplayClient;
+
+/** State of the replay */
+static struct {
+	int active;		/**< A replay is running */
+	int bench;		/**< Do not keep the pace of the trace */
+	unsigned char *buf;	/**< The whole trace */
+	size_t size;		/**< Its length */
+	size_t pos;		/**< Next record */
+	size_t done;		/**< Bytes of its data written already */
+	unsigned long start;	/**< Start of the replay */
+	unsigned long long due;	/**< Time in the trace of the last record fed */
+	unsigned long progress;	/**< Last time data was written or read */
+	unsigned long records, clients, bytes, lines;
+	unsigned long frames;	/**< Frames rendered before the replay */
+	unsigned long *latency;	/**< Reply times in microseconds */
+	size_t latencies, latency_size;
+	ReplayClient client[MAX_REPLAY_CLIENTS];
+} replay;
+
+
+/**
+ * Start recording what clients send.
+ * \param path  File to write the trace to; it is replaced.
+ * \retval  0   Recording.
+ * \retval <0   The file could not be created.
+ */
+int
+trace_record_init(const char *path)
+{
+	trace_file = fopen(path, "wb");
+	if (trace_file == NULL) {
+		report(RPT_ERR, "Cannot create trace file %s: %s", path, strerror(errno));
+		return -1;
+	}
+	fputs(TRACE_MAGIC, trace_file);
+	trace_last = stats_clock();
+	report(RPT_NOTICE, "Recording client input to %s", path);
+	return 0;
+}
+
+
+/**
+ * Stop recording and close the trace file.
+ */
+void
+trace_record_shutdown(void)
+{
+	if (trace_file != NULL)
+		fclose(trace_file);
+	trace_file = NULL;
+}
+
+
+/* Store a number big-endian */
+static void
+trace_put(unsigned char *p, unsigned long value, int bytes)
+{
+	while (bytes-- > 0) {
+		p[bytes] = value & 0xFF;
+		value >>= 8;
+	}
+}
+
+
+/* Read a number stored big-endian */
+static unsigned long
+trace_get(const unsigned char *p, int bytes)
+{
+	unsigned long value = 0;
+
+	while (bytes-- > 0)
+		value = (value << 8) | *p++;
+	return value;
+}
+
+
+/**
+ * Add a record to the trace, if one is being recorded.
+ * \param type  TRACE_CONNECT, TRACE_DATA or TRACE_CLOSE.
+ * \param id    The client's socket.
+ * \param data  Data received, for TRACE_DATA.
+ * \param len   Its length.
+ */
+void
+trace_record(int type, int id, const char *data, int len)
+{
+	unsigned char header[TRACE_DATA_HEADER_SIZE];
+	unsigned long now, delay;
+	int size = TRACE_HEADER_SIZE;
+
+	if (trace_file == NULL)
+		return;
+
+	/* pauses of more than 71 minutes are cut short */
+	now = stats_clock();
+	delay = now - trace_last;
+	if (delay > 0xFFFFFFFFUL)
+		delay = 0xFFFFFFFFUL;
+	trace_last = now;
+
+	header[0] = type;
+	trace_put(header + 1, id, 2);
+	trace_put(header + 3, delay, 4);
+	if (type == TRACE_DATA) {
+		trace_put(header + 7, len, 4);
+		size = TRACE_DATA_HEADER_SIZE;
+	}
+	if ((fwrite(header, size, 1, trace_file) != 1)
+	    || ((type == TRACE_DATA) && (fwrite(data, len, 1, trace_file) != 1))) {
+		report(RPT_ERR, "Cannot write trace file: %s; recording stopped",
+		       strerror(errno));
+		trace_record_shutdown();
+	}
+}
+
+
+/**
+ * Load a trace to replay through the server.
+ * \param path   The trace file.
+ * \param bench  Feed it as fast as possible instead of keeping its pace.
+ * \retval  0    The replay starts with the next trace_replay_step().
+ * \retval <0    The trace could not be read.
+ */
+int
+trace_replay_init(const char *path, int bench)
+{
+	FILE *f;
+	long size;
+	int i;
+
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		report(RPT_ERR, "Cannot open trace %s: %s", path, strerror(errno));
+		return -1;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	replay.buf = (size > 0) ? malloc(size) : NULL;
+	if ((replay.buf == NULL) || (fread(replay.buf, size, 1, f) != 1)) {
+		report(RPT_ERR, "Cannot read trace %s", path);
+		fclose(f);
+		free(replay.buf);
+		return -1;
+	}
+	fclose(f);
+
+	if ((size < (long) strlen(TRACE_MAGIC))
+	    || (memcmp(replay.buf, TRACE_MAGIC, strlen(TRACE_MAGIC)) != 0)) {
+		report(RPT_ERR, "%s is not a trace of LCDd", path);
+		free(replay.buf);
+		return -1;
+	}
+
+	replay.size = size;
+	replay.pos = strlen(TRACE_MAGIC);
+	replay.bench = bench;
+	for (i = 0; i < MAX_REPLAY_CLIENTS; i++)
+		replay.client[i].id = -1;
+	replay.active = 1;
+	report(RPT_NOTICE, "Replaying %s%s", path, bench ? " as fast as possible" : "");
+	return 0;
+}
+
+
+/**
+ * Tell whether a trace is being replayed.
+ * \retval 1  Yes.
+ * \retval 0  No.
+ */
+int
+trace_replay_active(void)
+{
+	return replay.active;
+}
+
+
+/**
+ * Tell whether a trace is replayed as fast as possible. The main loop then
+ * does not wait and renders a frame in every pass.
+ * \retval 1  Yes.
+ * \retval 0  No, or no replay is running.
+ */
+int
+trace_replay_bench(void)
+{
+	return replay.active && replay.bench;
+}
+
+
+/* Read the header of the next record; returns its size, 0 at the end */
+static size_t
+replay_header(int *type, int *id, unsigned long *delay, size_t *len)
+{
+	const unsigned char *p = replay.buf + replay.pos;
+	size_t left = replay.size - replay.pos;
+
+	if (left < TRACE_HEADER_SIZE)
+		return 0;
+	*type = p[0];
+	*id = trace_get(p + 1, 2);
+	*delay = trace_get(p + 3, 4);
+	*len = 0;
+	if (*type != TRACE_DATA)
+		return TRACE_HEADER_SIZE;
+	if (left < TRACE_DATA_HEADER_SIZE)
+		return 0;
+	*len = trace_get(p + 7, 4);
+	if (left - TRACE_DATA_HEADER_SIZE < *len)
+		return 0;
+	return TRACE_DATA_HEADER_SIZE;
+}
+
+
+/* Find the replay client of an id of the trace */
+static ReplayClient *
+replay_find(int id)
+{
+	int i;
+
+	for (i = 0; i < MAX_REPLAY_CLIENTS; i++) {
+		if (replay.client[i].id == id)
+			return &replay.client[i];
+	}
+	return NULL;
+}
+
+
+/* Close the socket of a replay client, which disconnects it */
+static void
+replay_close(ReplayClient *rc)
+{
+	close(rc->fd);
+	free(rc->sent);
+	memset(rc, 0, sizeof(*rc));
+	rc->id = -1;
+}
+
+
+/* Note the time a line was sent, to time its reply */
+static void
+replay_sent(ReplayClient *rc, unsigned long now)
+{
+	if (rc->sent_tail == rc->sent_size) {
+		if (rc->sent_head > 0) {
+			memmove(rc->sent, rc->sent + rc->sent_head,
+				(rc->sent_tail - rc->sent_head) * sizeof(unsigned long));
+			rc->sent_tail -= rc->sent_head;
+			rc->sent_head = 0;
+		}
+		else {
+			int size = (rc->sent_size > 0) ? rc->sent_size * 2 : 64;
+			unsigned long *sent = realloc(rc->sent, size * sizeof(unsigned long));
+
+			if (sent == NULL)
+				return;
+			rc->sent = sent;
+			rc->sent_size = size;
+		}
+	}
+	rc->sent[rc->sent_tail++] = now;
+}
+
+
+/* Take the time of a reply to the oldest line without one */
+static void
+replay_replied(ReplayClient *rc, unsigned long now)
+{
+	if (rc->sent_head == rc->sent_tail)
+		return;
+	if (replay.latencies == replay.latency_size) {
+		size_t size = (replay.latency_size > 0) ? replay.latency_size * 2 : 1024;
+		unsigned long *latency = realloc(replay.latency, size * sizeof(unsigned long));
+
+		if (latency == NULL)
+			return;
+		replay.latency = latency;
+		replay.latency_size = size;
+	}
+	replay.latency[replay.latencies++] = now - rc->sent[rc->sent_head++];
+}
+
+
+/* Connect a client of the trace to the server */
+static void
+replay_connect(int id)
+{
+	ReplayClient *rc = replay_find(-1);
+	int sv[2];
+
+	if (replay_find(id) != NULL)
+		replay_close(replay_find(id));
+	if (rc == NULL) {
+		report(RPT_WARNING, "%s: more than %d clients at once; ignoring client %d",
+		       __FUNCTION__, MAX_REPLAY_CLIENTS, id);
+		return;
+	}
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+		report(RPT_ERR, "%s: cannot create socket pair: %s",
+		       __FUNCTION__, strerror(errno));
+		return;
+	}
+	fcntl(sv[0], F_SETFL, O_NONBLOCK);
+	fcntl(sv[1], F_SETFL, O_NONBLOCK);
+	if (sock_add_client(sv[0]) < 0) {
+		close(sv[0]);
+		close(sv[1]);
+		return;
+	}
+	rc->id = id;
+	rc->fd = sv[1];
+	replay.clients++;
+}
+
+
+/* Write the data of the next record; returns 0 when it is all written */
+static int
+replay_write(ReplayClient *rc, const unsigned char *data, size_t len, unsigned long now)
+{
+	ssize_t n;
+	ssize_t i;
+
+	n = write(rc->fd, data + replay.done, len - replay.done);
+	if (n < 0)
+		return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) ? 1 : 0;
+
+	if (!rc->binary) {
+		for (i = 0; i < n; i++) {
+			if (data[replay.done + i] == '\n') {
+				replay_sent(rc, now);
+				replay.lines++;
+			}
+		}
+		/* with binary frames only the reply to hello is a line */
+		if ((replay.done == 0) && (len >= 12) && (memcmp(data, "hello binary", 12) == 0))
+			rc->binary = 1;
+	}
+	replay.done += n;
+	replay.bytes += n;
+	replay.progress = now;
+	return (replay.done < len) ? 1 : 0;
+}
+
+
+/* Read the replies of a client and time those to commands */
+static void
+replay_read(ReplayClient *rc, unsigned long now)
+{
+	char buf[4096];
+	ssize_t n;
+	ssize_t i;
+
+	while ((n = read(rc->fd, buf, sizeof(buf))) > 0) {
+		replay.progress = now;
+		if (rc->binary && (rc->sent_head == rc->sent_tail))
+			continue;
+		for (i = 0; i < n; i++) {
+			if (buf[i] != '\n') {
+				if (rc->reply_len < (int) sizeof(rc->reply))
+					rc->reply[rc->reply_len] = buf[i];
+				rc->reply_len++;
+				continue;
+			}
+			/* key and menu events come unasked */
+			if (((rc->reply_len >= 7) && (memcmp(rc->reply, "success", 7) == 0))
+			    || ((rc->reply_len >= 4) && (memcmp(rc->reply, "huh?", 4) == 0))
+			    || ((rc->reply_len >= 7) && (memcmp(rc->reply, "connect", 7) == 0)))
+				replay_replied(rc, now);
+			rc->reply_len = 0;
+		}
+	}
+}
+
+
+/**
+ * Feed the records of the trace that are due to the server and read its
+ * replies. Called by the main loop before each processing stroke.
+ * \retval 1  The replay goes on.
+ * \retval 0  The replay is over; see trace_replay_report().
+ */
+int
+trace_replay_step(void)
+{
+	unsigned long now = stats_clock();
+	int count = 0;
+	int waiting = 0;
+	int i;
+
+	if (!replay.active)
+		return 0;
+	if (replay.start == 0) {
+		replay.start = now;
+		replay.progress = now;
+		replay.frames = server_stats.frames_rendered;
+	}
+
+	while (count++ < REPLAY_RECORDS_PER_STEP) {
+		int type, id;
+		unsigned long delay;
+		size_t len;
+		size_t header = replay_header(&type, &id, &delay, &len);
+		ReplayClient *rc;
+
+		if (header == 0) {
+			replay.pos = replay.size;
+			break;
+		}
+		if (!replay.bench && (replay.due + delay > now - replay.start))
+			break;
+
+		rc = replay_find(id);
+		if (type == TRACE_CONNECT)
+			replay_connect(id);
+		else if ((type == TRACE_DATA) && (rc != NULL)) {
+			if (replay_write(rc, replay.buf + replay.pos + header, len, now) != 0)
+				break;
+		}
+		else if ((type == TRACE_CLOSE) && (rc != NULL)) {
+			/* hang up after the last reply, as the client did */
+			replay_read(rc, now);
+			if ((rc->sent_head != rc->sent_tail)
+			    && (now - replay.progress < REPLAY_TIMEOUT))
+				break;
+			replay_close(rc);
+		}
+
+		replay.due += delay;
+		replay.pos += header + len;
+		replay.done = 0;
+		replay.records++;
+	}
+
+	for (i = 0; i < MAX_REPLAY_CLIENTS; i++) {
+		ReplayClient *rc = &replay.client[i];
+
+		if (rc->id < 0)
+			continue;
+		replay_read(rc, now);
+		if (rc->sent_head != rc->sent_tail)
+			waiting = 1;
+	}
+
+	if (replay.pos < replay.size)
+		return 1;
+	if (waiting && (now - replay.progress < REPLAY_TIMEOUT))
+		return 1;
+
+	if (waiting)
+		report(RPT_WARNING, "Replay: some commands got no reply");
+	for (i = 0; i < MAX_REPLAY_CLIENTS; i++) {
+		if (replay.client[i].id >= 0)
+			replay_close(&replay.client[i]);
+	}
+	replay.active = 0;
+	return 0;
+}
+
+
+/**
+ * Tell how long the main loop may wait before the next record is due.
+ * \return  Time in microseconds; -1 if no replay is running.
+ */
+long
+trace_replay_wait(void)
+{
+	int type, id;
+	unsigned long delay;
+	size_t len;
+	unsigned long long due;
+	unsigned long elapsed;
+
+	if (!replay.active)
+		return -1;
+	if (replay.bench || (replay.start == 0))
+		return 0;
+	/* replies are read in the processing strokes */
+	if (replay_header(&type, &id, &delay, &len) == 0)
+		return 1000000 / 32;
+
+	due = replay.due + delay;
+	elapsed = stats_clock() - replay.start;
+	return (due > elapsed) ? (long) (due - elapsed) : 0;
+}
+
+
+/* Compare two latencies for qsort() */
+static int
+replay_compare(const void *a, const void *b)
+{
+	unsigned long x = *(const unsigned long *) a;
+	unsigned long y = *(const unsigned long *) b;
+
+	return (x > y) - (x < y);
+}
+
+
+/* Latency below which a share of the replies came, in microseconds */
+static unsigned long
+replay_percentile(int percent)
+{
+	if (replay.latencies == 0)
+		return 0;
+	return replay.latency[(replay.latencies - 1) * percent / 100];
+}
+
+
+/**
+ * Print the results of the finished replay to stdout.
+ */
+void
+trace_replay_report(void)
+{
+	double secs = (stats_clock() - replay.start) / 1e6;
+	unsigned long frames = server_stats.frames_rendered - replay.frames;
+
+	if (secs <= 0)
+		secs = 1e-6;
+	qsort(replay.latency, replay.latencies, sizeof(unsigned long), replay_compare);
+
+	/* printed to stdout on purpose, like the help screen */
+	fprintf(stdout, "Replayed %lu records of %lu clients in %.3f s\n",
+		replay.records, replay.clients, secs);
+	fprintf(stdout, "  input:   %lu bytes, %lu lines, %.0f lines/s\n",
+		replay.bytes, replay.lines, replay.lines / secs);
+	fprintf(stdout, "  frames:  %lu rendered, %.1f/s, render time avg %llu us, max %lu us\n",
+		frames, frames / secs,
+		server_stats.render.count ? server_stats.render.sum / server_stats.render.count : 0ULL,
+		server_stats.render.max);
+	fprintf(stdout, "  replies: %lu, latency p50 %lu us, p90 %lu us, p99 %lu us, max %lu us\n",
+		(unsigned long) replay.latencies, replay_percentile(50), replay_percentile(90),
+		replay_percentile(99), replay_percentile(100));
+	fflush(stdout);
+	free(replay.latency);
+	free(replay.buf);
+	replay.latency = NULL;
+	replay.buf = NULL;
+}
@@ -0,0 +1,30 @@
+/** \file server/trace.h
+ * Interface to recording client input and replaying it.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+/* Kinds of trace records */
+#define TRACE_CONNECT	'C'	/**< A client connected */
+#define TRACE_DATA	'D'	/**< Data received from a client */
+#define TRACE_CLOSE	'X'	/**< A client went away */
+
+int trace_record_init(const char *path);
+void trace_record_shutdown(void);
+void trace_record(int type, int id, const char *data, int len);
+
+int trace_replay_init(const char *path, int bench);
+int trace_replay_active(void);
+int trace_replay_bench(void);
+int trace_replay_step(void);
+long trace_replay_wait(void);
+void trace_replay_report(void);
+
+#endif
@@ -0,0 +1,321 @@
+/** \file server/warmstate.c
+ * This file contains the state kept over a restart of the server, so that
+ * drivers that opt in need not reset and clear their displays when LCDd
+ * is restarted, e.g. on an upgrade: the display goes on showing the last
+ * frame, and the first frame of the new server is sent as a difference.
+ *
+ * A driver saves what it needs in its close() function with the core
+ * function save_state(), e.g. its backing store, custom characters and
+ * brightness, and gets it back in init() with load_state(). The state is
+ * only saved when the server exits, and only loaded when it starts: a
+ * driver closed and initialized again after its device was lost starts
+ * afresh.
+ *
+ * The states are kept in the file named by StateFile. It is opened when
+ * the server starts, before it drops its privileges, read, and emptied,
+ * so a server that crashes leaves no state behind that the display may
+ * no longer show. It is written again on exit. The file starts with
+ * WARMSTATE_MAGIC, followed by the states: the driver's name, NUL
+ * terminated, the size of the state as an int and the state. Numbers are
+ * in the byte order of the machine.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "shared/report.h"
+#include "shared/vector.h"
+
+#include "warmstate.h"
+
+#define WARMSTATE_MAGIC		"LCDdWRM1"	/**< 8 bytes, without the 0 */
+#define WARMSTATE_MAGIC_SIZE	8
+/** Largest state of a driver: the backing store of a big graphic display */
+#define WARMSTATE_MAX_SIZE	(1024 * 1024)
+
+/** The state of a driver */
+typedef struct WarmState {
+	char *name;		/**< Name of the driver */
+	int size;		/**< Size of data */
+	unsigned char data[];
+} WarmState;
+
+static int state_fd = -1;
+/** States read on startup, until the drivers are loaded */
+static Vector *loaded = NULL;
+/** States saved by the drivers on exit */
+static Vector *saved = NULL;
+/** Non-zero while the drivers are closed on exit */
+static int saving = 0;
+/* Drivers are initialized on threads of their own */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* Free a list of states */
+static void
+warmstate_free(Vector *list)
+{
+	WarmState *st;
+	int i;
+
+	for (i = 0; (st = V_Get(list, i)) != NULL; i++) {
+		free(st->name);
+		free(st);
+	}
+	V_Destroy(list);
+}
+
+
+/* Find the state of a driver in a list */
+static int
+warmstate_find(Vector *list, const char *name)
+{
+	WarmState *st;
+	int i;
+
+	for (i = 0; (st = V_Get(list, i)) != NULL; i++) {
+		if (strcmp(st->name, name) == 0)
+			return i;
+	}
+	return -1;
+}
+
+
+/* Make a state */
+static WarmState *
+warmstate_new(const char *name, const void *data, int size)
+{
+	WarmState *st = malloc(sizeof(WarmState) + size);
+
+	if (st == NULL)
+		return NULL;
+	st->name = strdup(name);
+	if (st->name == NULL) {
+		free(st);
+		return NULL;
+	}
+	st->size = size;
+	if (data != NULL)
+		memcpy(st->data, data, size);
+	return st;
+}
+
+
+/* Read the states in the file; a file cut short ends them */
+static void
+warmstate_read(FILE *f)
+{
+	char magic[WARMSTATE_MAGIC_SIZE];
+	char name[256];
+
+	if ((fread(magic, 1, sizeof(magic), f) != sizeof(magic))
+	    || (memcmp(magic, WARMSTATE_MAGIC, sizeof(magic)) != 0))
+		return;
+
+	while (1) {
+		WarmState *st;
+		int size;
+		int c, len = 0;
+
+		while (((c = getc(f)) != EOF) && (c != '\0') && (len < (int) sizeof(name) - 1))
+			name[len++] = c;
+		if (c != '\0')
+			return;
+		name[len] = '\0';
+		if ((fread(&size, sizeof(size), 1, f) != 1)
+		    || (size <= 0) || (size > WARMSTATE_MAX_SIZE))
+			return;
+		st = warmstate_new(name, NULL, size);
+		if (st == NULL)
+			return;
+		if ((fread(st->data, 1, size, f) != (size_t) size)
+		    || (V_Append(loaded, st) < 0)) {
+			free(st->name);
+			free(st);
+			return;
+		}
+	}
+}
+
+
+/**
+ * Open the state file and read the states the drivers saved when the
+ * server last exited. The file is emptied; it gets the states of this
+ * server on exit.
+ * \param path  Name of the file.
+ * \return  0 on success, -1 if the file cannot be used.
+ */
+int
+warmstate_init(const char *path)
+{
+	FILE *f;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT, 0600);
+	if (fd < 0) {
+		report(RPT_WARNING, "Cannot open state file %s: %s", path, strerror(errno));
+		return -1;
+	}
+	loaded = V_new();
+	saved = V_new();
+	if ((loaded == NULL) || (saved == NULL)) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		close(fd);
+		return -1;
+	}
+
+	/* read through a stream of a copy, which fclose() closes */
+	f = fdopen(dup(fd), "rb");
+	if (f != NULL) {
+		warmstate_read(f);
+		fclose(f);
+	}
+	if (ftruncate(fd, 0) < 0)
+		report(RPT_WARNING, "Cannot empty state file %s: %s", path, strerror(errno));
+
+	state_fd = fd;
+	report(RPT_INFO, "Read the state of %d drivers from %s", V_Length(loaded), path);
+	return 0;
+}
+
+
+/**
+ * Forget the states no driver took, once the drivers are loaded.
+ */
+void
+warmstate_loaded(void)
+{
+	pthread_mutex_lock(&lock);
+	if (loaded != NULL) {
+		warmstate_free(loaded);
+		loaded = NULL;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+
+/**
+ * Get the state a driver saved when the server last exited; it is given
+ * out once. Called by drivers from their init() function, through the
+ * core function load_state().
+ * \param drv   The driver.
+ * \param data  Buffer for the state.
+ * \param size  Size of the buffer.
+ * \return  The size of the state saved, 0 if there is none. If it is
+ *          larger than the buffer, only the start of it is copied.
+ */
+int
+warmstate_load(Driver *drv, void *data, int size)
+{
+	WarmState *st;
+	int i, n = 0;
+
+	pthread_mutex_lock(&lock);
+	i = warmstate_find(loaded, drv->name);
+	if ((i >= 0) && ((st = V_RemoveAt(loaded, i)) != NULL)) {
+		n = st->size;
+		memcpy(data, st->data, (n < size) ? n : size);
+		free(st->name);
+		free(st);
+	}
+	pthread_mutex_unlock(&lock);
+	return n;
+}
+
+
+/**
+ * Keep the state of a driver for the next start of the server. Called by
+ * drivers from their close() function, through the core function
+ * save_state(); it does nothing unless the server exits.
+ * \param drv   The driver.
+ * \param data  The state.
+ * \param size  Its size.
+ * \return  0 if it is kept, -1 if not.
+ */
+int
+warmstate_save(Driver *drv, const void *data, int size)
+{
+	WarmState *st;
+	int i, ret = -1;
+
+	if ((size <= 0) || (size > WARMSTATE_MAX_SIZE))
+		return -1;
+
+	pthread_mutex_lock(&lock);
+	if (saving && (saved != NULL) && ((st = warmstate_new(drv->name, data, size)) != NULL)) {
+		i = warmstate_find(saved, drv->name);
+		if (i >= 0) {
+			WarmState *old = V_RemoveAt(saved, i);
+
+			free(old->name);
+			free(old);
+		}
+		ret = V_Append(saved, st);
+	}
+	pthread_mutex_unlock(&lock);
+	return ret;
+}
+
+
+/**
+ * Let the drivers save their states, as they are closed on exit.
+ */
+void
+warmstate_exiting(void)
+{
+	saving = (state_fd >= 0);
+}
+
+
+/**
+ * Write the states the drivers saved to the state file, and close it.
+ */
+void
+warmstate_shutdown(void)
+{
+	WarmState *st;
+	FILE *f;
+	int i;
+
+	if (state_fd < 0)
+		return;
+
+	f = fdopen(state_fd, "wb");
+	if (f == NULL) {
+		close(state_fd);
+	}
+	else {
+		if (V_Length(saved) > 0) {
+			fwrite(WARMSTATE_MAGIC, 1, WARMSTATE_MAGIC_SIZE, f);
+			for (i = 0; (st = V_Get(saved, i)) != NULL; i++) {
+				fwrite(st->name, 1, strlen(st->name) + 1, f);
+				fwrite(&st->size, sizeof(st->size), 1, f);
+				fwrite(st->data, 1, st->size, f);
+			}
+		}
+		if (fclose(f) != 0)
+			report(RPT_WARNING, "Cannot write the state file: %s", strerror(errno));
+		else
+			report(RPT_INFO, "Saved the state of %d drivers", V_Length(saved));
+	}
+	state_fd = -1;
+	saving = 0;
+	warmstate_loaded();
+	warmstate_free(saved);
+	saved = NULL;
+}
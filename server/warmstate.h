@@ -0,0 +1,25 @@
+/** \file server/warmstate.h
+ * Interface to the state drivers keep over a restart of the server.
+ */
+
+/* This file is part of LCDd, the lcdproc server.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef WARMSTATE_H
+#define WARMSTATE_H
+
+#include "drivers/lcd.h"
+
+int warmstate_init(const char *path);
+void warmstate_loaded(void);
+void warmstate_exiting(void);
+void warmstate_shutdown(void);
+
+/* The core functions load_state() and save_state() of the drivers */
+int warmstate_load(Driver *drv, void *data, int size);
+int warmstate_save(Driver *drv, const void *data, int size);
+
+#endif
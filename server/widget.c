@@ -22,6 +22,8 @@
 
 #include "shared/sockets.h"
 #include "shared/report.h"
+#include "shared/str.h"
+#include "shared/intern.h"
 
 #include "screen.h"
 #include "widget.h"
@@ -39,6 +41,7 @@ char *typenames[] = {
 	"scroller",	/* WID_SCROLLER */
 	"frame",	/* WID_FRAME */
 	"num",		/* WID_NUM */
+	"graph",	/* WID_GRAPH */
 	NULL,		/* WID_NONE */
 };
 
@@ -72,6 +75,25 @@ struct icontable {
 };
 
 
+/* The pool of the client owning the widget; NULL for the server's widgets,
+ * which use plain malloc() */
+Pool *
+widget_pool(Widget *w)
+{
+	return ((w->screen != NULL) && (w->screen->client != NULL))
+	       ? w->screen->client->pool : NULL;
+}
+
+
+/* The client charged for the interned id and labels of a widget */
+static size_t *
+widget_account(Widget *w)
+{
+	return ((w->screen != NULL) && (w->screen->client != NULL))
+	       ? &w->screen->client->strings : NULL;
+}
+
+
 /** Create a widget.
   * \param id       Widget identifier; it's name.
   * \param type     Widget type.
@@ -79,18 +101,27 @@ struct icontable {
   * \return         Pointer to the freshly created widget.
   */
 Widget *
-widget_create(char *id, WidgetType type, Screen *screen)
+widget_create(const char *id, WidgetType type, Screen *screen)
 {
 	Widget *w;
 
 	debug(RPT_DEBUG, "%s(id=\"%s\", type=%d, screen=[%s])", __FUNCTION__, id, type, screen->id);
 
 	/* Create it */
-	w = calloc(1, sizeof(Widget));
-
-	w->id = strdup(id);
-	w->type = type;
+	w = pool_calloc((screen->client != NULL) ? screen->client->pool : NULL, sizeof(Widget));
+	if (w == NULL) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		return NULL;
+	}
 	w->screen = screen;
+	/* the usual ids, "title", "line1" and so on, are shared by all */
+	w->id = intern_get_charged(id, widget_account(w));
+	if (w->id == NULL) {
+		report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+		pool_free(widget_pool(w), w);
+		return NULL;
+	}
+	w->type = type;
 	w->x = 1;
 	w->y = 1;
 	w->left = 1;
@@ -111,25 +142,255 @@ widget_create(char *id, WidgetType type, Screen *screen)
 }
 
 
+/** Create a copy of a widget, with its values, on another screen. The
+ * widgets of a frame are copied too.
+ * \param src     Widget to copy.
+ * \param screen  Screen the copy is to be placed on.
+ * \return        The new widget; NULL on error.
+ */
+Widget *
+widget_clone(Widget *src, Screen *screen)
+{
+	Widget *w = widget_create(src->id, src->type, screen);
+	Pool *pool;
+
+	if (w == NULL)
+		return NULL;
+	pool = widget_pool(w);
+
+	w->x = src->x;
+	w->y = src->y;
+	w->width = src->width;
+	w->height = src->height;
+	w->left = src->left;
+	w->top = src->top;
+	w->right = src->right;
+	w->bottom = src->bottom;
+	w->length = src->length;
+	w->speed = src->speed;
+	w->promille = src->promille;
+	w->dirty = 1;
+
+	/* the strings are already decoded, they are copied as they are */
+	if (((src->text != NULL) && ((w->text = pool_strdup(pool, src->text)) == NULL))
+	    || ((src->source != NULL) && ((w->source = pool_strdup(pool, src->source)) == NULL)))
+		goto fail;
+
+	if ((src->type == WID_PBAR)
+	    && (((src->begin_label != NULL)
+		 && ((w->begin_label = intern_get_charged(src->begin_label, widget_account(w))) == NULL))
+		|| ((src->end_label != NULL)
+		    && ((w->end_label = intern_get_charged(src->end_label, widget_account(w))) == NULL))))
+		goto fail;
+
+	if ((src->type == WID_GRAPH) && (src->samples != NULL)) {
+		w->samples = pool_alloc(pool, src->samples_size * sizeof(int));
+		if (w->samples == NULL)
+			goto fail;
+		memcpy(w->samples, src->samples, src->samples_size * sizeof(int));
+		w->samples_size = src->samples_size;
+		w->sample_next = src->sample_next;
+	}
+
+	if ((src->type == WID_FRAME) && (src->frame_screen != NULL)) {
+		Widget *sub;
+		int i;
+
+		if (w->frame_screen == NULL)
+			goto fail;
+		for (i = 0; (sub = V_Get(src->frame_screen->widgetlist, i)) != NULL; i++) {
+			Widget *copy = widget_clone(sub, w->frame_screen);
+
+			if (copy == NULL)
+				goto fail;
+			if (screen_add_widget(w->frame_screen, copy) < 0) {
+				widget_destroy(copy);
+				goto fail;
+			}
+		}
+	}
+	return w;
+
+fail:
+	report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+	widget_destroy(w);
+	return NULL;
+}
+
+
 /** Destroy a widget.
  * \param w    Widget to destroy.
  */
 void
 widget_destroy(Widget *w)
 {
+	Pool *pool;
+
 	debug(RPT_DEBUG, "%s(w=[%s])", __FUNCTION__, w->id);
 
 	if (!w)
 		return;
 
-	free(w->id);
-	free(w->text);
+	pool = widget_pool(w);
+	intern_put_charged(w->id, widget_account(w));
+	pool_free(pool, w->text);
+	pool_free(pool, w->source);
+
+	switch (w->type) {
+	case WID_PBAR:
+		intern_put_charged(w->begin_label, widget_account(w));
+		intern_put_charged(w->end_label, widget_account(w));
+		break;
+	case WID_FRAME:
+		/* Free subscreen of frame widget too */
+		if (w->frame_screen != NULL)
+			screen_destroy(w->frame_screen);
+		break;
+	case WID_TITLE:
+	case WID_SCROLLER:
+		pool_free(pool, w->layout);
+		break;
+	case WID_GRAPH:
+		pool_free(pool, w->samples);
+		break;
+	default:
+		break;
+	}
+
+	pool_free(pool, w);
+}
 
-	/* Free subscreen of frame widget too */
-	if (w->type == WID_FRAME)
-		screen_destroy(w->frame_screen);
 
-	free(w);
+/** Replace one of a widget's strings by a copy of another string, in the
+ * memory of the widget's client. Text from a client sending UTF-8 is
+ * decoded here, once, so rendering only deals with 8-bit characters.
+ * The widget is marked dirty only if the string really changes, so a
+ * client sending the same text again does not cause a frame.
+ * \param w    Widget the string belongs to.
+ * \param old  Current value, freed or reused; may be NULL.
+ * \param str  New value; NULL only frees the old one.
+ * \return     The new value; NULL on error or if \c str is NULL.
+ */
+char *
+widget_strset(Widget *w, char *old, const char *str)
+{
+	Pool *pool = widget_pool(w);
+	char *copy;
+
+	if ((str != NULL) && (w->screen != NULL) && (w->screen->client != NULL)
+	    && w->screen->client->utf8) {
+		/* compare the decoded text */
+		copy = pool_strdup(pool, str);
+		if (copy != NULL) {
+			utf8_to_latin1(copy);
+			if ((old != NULL) && (strcmp(old, copy) == 0)) {
+				pool_free(pool, copy);
+				return old;
+			}
+		}
+		pool_free(pool, old);
+		w->dirty = 1;
+		return copy;
+	}
+
+	if ((old != NULL) && (str != NULL) && (strcmp(old, str) == 0))
+		return old;
+	if ((old != NULL) || (str != NULL))
+		w->dirty = 1;
+	return pool_strset(pool, old, str);
+}
+
+
+/** Replace a label of a widget by the interned copy of another string,
+ * decoded from UTF-8 like widget_strset() does. Labels are the same on
+ * the screens of many clients, so they are shared.
+ * \param w    Widget the label belongs to.
+ * \param old  Current value, given back; may be NULL.
+ * \param str  New value; NULL only gives back the old one.
+ * \return     The new value; NULL on error or if \c str is NULL.
+ */
+const char *
+widget_labelset(Widget *w, const char *old, const char *str)
+{
+	const char *label;
+	char *copy = NULL;
+
+	if ((str != NULL) && (w->screen != NULL) && (w->screen->client != NULL)
+	    && w->screen->client->utf8) {
+		copy = strdup(str);
+		if (copy == NULL) {
+			intern_put_charged(old, widget_account(w));
+			w->dirty = 1;
+			return NULL;
+		}
+		utf8_to_latin1(copy);
+		str = copy;
+	}
+
+	label = intern_get_charged(str, widget_account(w));
+	free(copy);
+	/* equal strings are the same interned string */
+	if (label != old)
+		w->dirty = 1;
+	intern_put_charged(old, widget_account(w));
+	return label;
+}
+
+
+/** Make sure the widget's layout buffer can hold a string of the given
+ * length; its contents are not kept.
+ * \param w       Widget to lay out.
+ * \param length  Length of the layout, without the terminating NUL.
+ * \return        The buffer; NULL on error.
+ */
+char *
+widget_layout_buffer(Widget *w, int length)
+{
+	Pool *pool = widget_pool(w);
+
+	if ((w->layout != NULL) && (length < w->layout_size))
+		return w->layout;
+
+	pool_free(pool, w->layout);
+	w->layout = pool_alloc(pool, length + 1);
+	w->layout_size = (w->layout != NULL) ? length + 1 : 0;
+	w->layout_width = 0;
+	return w->layout;
+}
+
+
+/** Append a value to the history of a graph widget, dropping the oldest
+ * one. If the width changed, the ring is resized first and keeps as many
+ * of the newest values as fit; new columns start empty.
+ * \param w         Graph widget.
+ * \param width     Number of values the graph shows.
+ * \param promille  The new value, in 1/1000 of the graph's height.
+ */
+void
+widget_graph_add(Widget *w, int width, int promille)
+{
+	if (width != w->samples_size) {
+		Pool *pool = widget_pool(w);
+		int *samples = pool_calloc(pool, width * sizeof(int));
+		int keep = (width < w->samples_size) ? width : w->samples_size;
+		int i;
+
+		if (samples == NULL) {
+			report(RPT_ERR, "%s: Error allocating", __FUNCTION__);
+			return;
+		}
+		/* oldest first, so the newest values end up at the right */
+		for (i = 0; i < keep; i++)
+			samples[width - keep + i] = w->samples[(w->sample_next + w->samples_size - keep + i) % w->samples_size];
+		pool_free(pool, w->samples);
+		w->samples = samples;
+		w->samples_size = width;
+		w->sample_next = 0;
+	}
+
+	w->samples[w->sample_next] = (promille < 0) ? 0 : (promille > 1000) ? 1000 : promille;
+	w->sample_next = (w->sample_next + 1) % w->samples_size;
+	w->dirty = 1;
 }
 
 
@@ -161,13 +422,53 @@ widget_type_to_typename(WidgetType t)
 }
 
 
+/**
+ * Tell how much of its client's pool a widget holds: the widget, its
+ * strings and buffers, and for a frame its screen and the widgets in it.
+ * \param w  The widget.
+ * \return   Bytes held; 0 for the server's widgets, which are not in a pool.
+ */
+size_t
+widget_memory(Widget *w)
+{
+	Pool *pool = widget_pool(w);
+	size_t size;
+	size_t sub = 0;
+
+	if (pool == NULL)
+		return 0;
+
+	size = pool_usable_size(pool, w) + pool_usable_size(pool, w->text)
+		+ pool_usable_size(pool, w->source);
+
+	/* the id and labels are interned and charged to the client that
+	 * took them first, see client_memory() */
+	switch (w->type) {
+	case WID_FRAME:
+		if (w->frame_screen != NULL)
+			size += screen_memory(w->frame_screen, &sub) + sub;
+		break;
+	case WID_TITLE:
+	case WID_SCROLLER:
+		size += pool_usable_size(pool, w->layout);
+		break;
+	case WID_GRAPH:
+		size += pool_usable_size(pool, w->samples);
+		break;
+	default:
+		break;
+	}
+	return size;
+}
+
+
 /** Find subordinate widgets of a widget by name.
  * \param w   Widget.
  * \param id  Name of the subiordinate widget.
  * \return    Pointer to the sub-widget; \c NULL if not found or on error.
  */
 Widget *
-widget_search_subs(Widget *w, char *id)
+widget_search_subs(Widget *w, const char *id)
 {
 	if (w->type == WID_FRAME) {
 		return screen_find_widget(w->frame_screen, id);
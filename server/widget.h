@@ -17,6 +17,8 @@
 #include "screen.h"
 #undef INC_TYPES_ONLY
 
+#include "shared/pool.h"
+
 /* These correspond to the index into the "types" array...*/
 typedef enum WidgetType {
 	WID_NONE = 0,
@@ -28,36 +30,77 @@ typedef enum WidgetType {
 	WID_TITLE,
 	WID_SCROLLER,
 	WID_FRAME,
-	WID_NUM
+	WID_NUM,
+	WID_GRAPH
 } WidgetType;
 
 
-/** Widget structure */
+/** Widget structure. Fields only some types use share their memory: only
+ * the ones of the widget's type may be used. */
 typedef struct Widget {
-	char *id;			/**< the widget's name */
-	WidgetType type;		/**< the widget's type */
+	const char *id;			/**< the widget's name, interned */
 	Screen *screen;			/**< What screen is this widget in ? */
-	int x, y;			/**< Position */
-	int width, height;		/**< Visible size */
-	int left, top, right, bottom;	/**< bounding rectangle */
-	int length;			/**< size or direction */
-	int speed;			/**< For scroller... */
-	int promille;                   /**< For percentage / pbars */
 	char *text;			/**< text or binary data */
-	char *begin_label;		/**< label in front of pbars; or NULL */
-	char *end_label;		/**< label at end of pbars; or NULL */
-	struct Screen *frame_screen;	/**< frame widget get an associated screen */
+	char *source;			/**< Name of the data source shown, see sources.c; or NULL */
+	WidgetType type;		/**< the widget's type */
+	short x, y;			/**< Position */
+	short width, height;		/**< Visible size */
+	short left, top, right, bottom;	/**< bounding rectangle */
+	short length;			/**< size or direction */
+	short speed;			/**< For scroller... */
+	short promille;			/**< For percentage / pbars */
+	short dirty;			/**< Changed since it was last rendered */
+	union {
+		struct {		/* WID_PBAR */
+			const char *begin_label;	/**< label in front of pbars, interned; or NULL */
+			const char *end_label;		/**< label at end of pbars, interned; or NULL */
+		};
+		struct Screen *frame_screen;	/**< WID_FRAME: its associated screen */
+		struct {		/* WID_TITLE, WID_SCROLLER */
+			char *layout;		/**< Text laid out for scrolling */
+			int layout_size;	/**< Allocated size of layout */
+			int layout_length;	/**< Length of layout */
+			int layout_width;	/**< Window width layout was made for */
+			int text_length;	/**< Length of text when it was laid out */
+		};
+		struct {		/* WID_GRAPH */
+			int *samples;		/**< ring of values in promille */
+			int samples_size;	/**< entries in samples */
+			int sample_next;	/**< entry the next value replaces, the oldest */
+		};
+	};
 	//LinkedList *kids;		/* Frames can contain more widgets...*/
 } Widget;
 
 #define WID_MAX_DIR 4
 
 /* Create new widget */
-Widget *widget_create(char *id, WidgetType type, Screen *screen);
+Widget *widget_create(const char *id, WidgetType type, Screen *screen);
+
+/* Copy a widget to another screen */
+Widget *widget_clone(Widget *src, Screen *screen);
 
 /* Destroy a widget */
 void widget_destroy(Widget *w);
 
+/* The memory pool the widget's data is kept in */
+Pool *widget_pool(Widget *w);
+
+/* Memory a client's widget holds */
+size_t widget_memory(Widget *w);
+
+/* Set one of the widget's strings */
+char *widget_strset(Widget *w, char *old, const char *str);
+
+/* Set one of the widget's shared labels */
+const char *widget_labelset(Widget *w, const char *old, const char *str);
+
+/* Append a value to a graph widget's history */
+void widget_graph_add(Widget *w, int width, int promille);
+
+/* Make room for a layout of the given length */
+char *widget_layout_buffer(Widget *w, int length);
+
 /* Convert a widget typename to a widget type */
 WidgetType widget_typename_to_type(char *typename);
 
@@ -65,7 +108,7 @@ WidgetType widget_typename_to_type(char *typename);
 char *widget_type_to_typename(WidgetType t);
 
 /* Search subwidgets of a widget */
-Widget *widget_search_subs(Widget *w, char *id);
+Widget *widget_search_subs(Widget *w, const char *id);
 
 /* Convert icon number to icon name */
 char *widget_icon_to_iconname(int icon);
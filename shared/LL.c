@@ -627,7 +627,8 @@ LL_Unshift(LinkedList *list, void *add)
 
 
 /** Add an item to the end of its "priority group"
- * The list is assumed to be sorted already.
+ * The list is assumed to be sorted already. This is the same as
+ * LL_SortedInsert(): items comparing equal keep the order they were added in.
  * \param list     List object.
  * \param add      Pointer to new node's data.
  * \param compare  Pointer to a comparison function.
@@ -637,6 +638,26 @@ LL_Unshift(LinkedList *list, void *add)
 int
 LL_PriorityEnqueue(LinkedList *list, void *add, int (*compare)(void *, void *))
 {
+	return LL_SortedInsert(list, add, compare);
+}
+
+
+/** Insert an item into a sorted list, after all items not greater than it.
+ * The list is searched from its end, so adding items in about sorted order
+ * is cheap. Items comparing equal keep the order they were added in, which
+ * makes the insert stable like LL_Sort().
+ * Update the list's \c current pointer to point to the freshly created node.
+ * \param list     List object.
+ * \param add      Pointer to new node's data.
+ * \param compare  Pointer to a comparison function, as for LL_Sort().
+ * \retval <0      error
+ * \retval  0      success
+ */
+int
+LL_SortedInsert(LinkedList *list, void *add, int (*compare)(void *, void *))
+{
+	LL_node *node, *prev;
+
 	if (!list)
 		return -1;
 	if (!add)
@@ -644,24 +665,23 @@ LL_PriorityEnqueue(LinkedList *list, void *add, int (*compare)(void *, void *))
 	if (!compare)
 		return -1;
 
-	// From the end of the list, keep searching while we're "less than"
-	// the given nodes...
-	LL_End(list);
-	do {
-		void *data = LL_Get(list);
+	// From the end of the list, skip the items greater than the new one
+	for (prev = list->tail.prev; prev != &list->head; prev = prev->prev) {
+		if (compare(add, prev->data) >= 0)
+			break;
+	}
 
-		if (data) {
-			int i = compare(add, data);
+	node = malloc(sizeof(LL_node));
+	if (node == NULL)
+		return -1;
 
-			if (i >= 0) {	// If we're in the right place, add it and exit
-				LL_AddNode(list, add);
-				return 0;
-			}
-		}
-	} while (LL_Prev(list) == 0);
+	node->data = add;
+	node->prev = prev;
+	node->next = prev->next;
+	prev->next->prev = node;
+	prev->next = node;
 
-	// If we're less than *everything*, put it at the beginning
-	LL_Unshift(list, add);
+	list->current = node;
 
 	return 0;
 }
@@ -851,6 +871,9 @@ LL_GetByIndex(LinkedList *list, int index)
 
 /** Sort list by its contents.
  * The list gets sorted using a comparison function for the data of its nodes.
+ * The sort is stable: nodes comparing equal keep their order. It is a
+ * bottom-up merge sort relinking the nodes in place, so it takes
+ * O(n log n) comparisons and no memory.
  * After the sorting, the list's current pointer is set to the first node.
  * \param list     List object.
  * \param compare  Pointer to a comparison function, that takes to void pointers
@@ -862,43 +885,86 @@ LL_GetByIndex(LinkedList *list, int index)
 int
 LL_Sort(LinkedList *list, int (*compare)(void *, void *))
 {
-	int i, j;			  // Junk / loop variables
-	int numnodes;			  // number of nodes in list
-	LL_node *best, *last;		  // best match and last node in the list
-	LL_node *current;
+	LL_node *first;			  // the nodes, linked by next and NULL terminated
+	LL_node *prev, *node;
+	int width;			  // length of the runs being merged
+	int merges;
 
 	if (!list)
 		return -1;
 	if (!compare)
 		return -1;
 
-	numnodes = LL_Length(list); // get the number of nodes...
-	if (0 > LL_End(list))
-		return -1;				  // Find the last node.
-	last = LL_GetNode(list);
-
-	if (numnodes < 2)
+	if (list->head.next == &list->tail) {
+		LL_Rewind(list);
 		return 0;
+	}
 
-	for (i = numnodes - 1; i > 0; i--) {
-		LL_Rewind(list);			  // get the first node again
-		best = last;				  // reset our "best" node
-
-		for (j = 0; j < i; j++) {
-			current = LL_GetNode(list);
-			// If we found a better match...
-			if (compare(current->data, best->data) > 0) {
-				best = current;	  // keep track of the "best" match
+	// Unhook the nodes from the anchors
+	first = list->head.next;
+	list->tail.prev->next = NULL;
+
+	for (width = 1; ; width *= 2) {
+		LL_node *a = first;
+		LL_node **link = &first;   // where to hook the next merged node
+
+		merges = 0;
+		while (a != NULL) {
+			LL_node *b = a;
+			int alen, blen;
+
+			merges++;
+			// Run a is up to width nodes, run b the up to width after
+			for (alen = 0; (alen < width) && (b != NULL); alen++)
+				b = b->next;
+			blen = width;
+
+			// Take from a unless b is less, so equal nodes keep their order
+			while ((alen > 0) || ((blen > 0) && (b != NULL))) {
+				LL_node *take;
+
+				if ((alen == 0) || (blen == 0) || (b == NULL)) {
+					if (alen > 0) {
+						take = a;
+						a = a->next;
+						alen--;
+					}
+					else {
+						take = b;
+						b = b->next;
+						blen--;
+					}
+				}
+				else if (compare(a->data, b->data) > 0) {
+					take = b;
+					b = b->next;
+					blen--;
+				}
+				else {
+					take = a;
+					a = a->next;
+					alen--;
+				}
+				*link = take;
+				link = &take->next;
 			}
-			LL_Next(list);		  // Go to the next node.
+			a = b;
 		}
+		*link = NULL;
+
+		if (merges <= 1)
+			break;
+	}
 
-		LL_SwapNodes(last, best);	// Switch two nodes...
-		if (best)
-			last = best->prev;
-		else
-			return -1;
+	// Relink the prev pointers and the anchors
+	prev = &list->head;
+	for (node = first; node != NULL; node = node->next) {
+		prev->next = node;
+		node->prev = prev;
+		prev = node;
 	}
+	prev->next = &list->tail;
+	list->tail.prev = prev;
 
 	LL_Rewind(list);
 
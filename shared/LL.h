@@ -188,6 +188,8 @@ int LL_Unshift(LinkedList *list, void *add);	// Add node to beginning of list
 #define LL_Dequeue(list)	LL_Shift(list)
 
 int LL_PriorityEnqueue(LinkedList * list, void *add, int (*compare)(void *, void *));
+// Inserts into a sorted list, after equal nodes
+int LL_SortedInsert(LinkedList *list, void *add, int (*compare)(void *, void *));
 
 int LL_SwapNodes(LL_node *one, LL_node *two);	// Switch two nodes positions...
 
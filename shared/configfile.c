@@ -24,6 +24,8 @@
 #endif
 
 #include "shared/report.h"
+#include "shared/hash.h"
+#include "shared/configfile.h"
 
 
 /** configuration key */
@@ -31,17 +33,25 @@ typedef struct _config_key {
 	char *name;			/**< name of the config key */
 	char *value;			/**< value of the config key */
 	struct _config_key *next_key;	/**< pointer to next config key */
+	struct _config_key *next_same;	/**< next value of the same key */
+	struct _config_key *last_same;	/**< first value only: last value of the key */
+	int count;			/**< first value only: number of values */
 } ConfigKey;
 
 /** configuration section */
 typedef struct _config_section {
 	char *name;			/**< name of the config section */
 	ConfigKey *first_key;		/**< config keys in the config section */
+	ConfigKey *last_key;		/**< last of them, to append to */
+	HashTable *keys;		/**< first value of each key, by name */
 	struct _config_section *next_section;	/**< pointer to next config section */
 } ConfigSection;
 
 
 static ConfigSection *first_section = NULL;
+static ConfigSection *last_section = NULL;
+/* Sections by name; it and the keys tables ignore case, like the config file */
+static HashTable *sections = NULL;
 /* Yes there is a static. It's C after all :)*/
 
 
@@ -49,6 +59,24 @@ static ConfigSection *find_section(const char *sectionname);
 static ConfigSection *add_section(const char *sectionname);
 static ConfigKey *find_key(ConfigSection *s, const char *keyname, int skip);
 static ConfigKey *add_key(ConfigSection *s, const char *keyname, const char *value);
+static short bool_value(const char *value, short default_value);
+/* Interpret a value as a boolean, see config_get_bool() */
+static short bool_value(const char *value, short default_value)
+{
+	if ((strcasecmp(value, "0") == 0) || (strcasecmp(value, "false") == 0) ||
+	    (strcasecmp(value, "n") == 0) || (strcasecmp(value, "no") == 0) ||
+	    (strcasecmp(value, "off") == 0)) {
+		return 0;
+	}
+	if ((strcasecmp(value, "1") == 0) || (strcasecmp(value, "true") == 0) ||
+	    (strcasecmp(value, "y") == 0) || (strcasecmp(value, "yes") == 0) ||
+	    (strcasecmp(value, "on") == 0)) {
+		return 1;
+	}
+	return default_value;
+}
+
+
 #if defined(LCDPROC_CONFIG_READ_STRING)
 static char get_next_char_f(FILE *f);
 static int process_config(ConfigSection **current_section, char(*get_next_char)(), const char *source_descr, FILE *f);
@@ -190,17 +218,7 @@ short config_get_bool(const char *sectionname, const char *keyname,
 	if (k == NULL)
 		return default_value;
 
-	if ((strcasecmp(k->value, "0") == 0) || (strcasecmp(k->value, "false") == 0) ||
-	    (strcasecmp(k->value, "n") == 0) || (strcasecmp(k->value, "no") == 0) ||
-	    (strcasecmp(k->value, "off") == 0)) {
-		return 0;
-	}
-	if ((strcasecmp(k->value, "1") == 0) || (strcasecmp(k->value, "true") == 0) ||
-	    (strcasecmp(k->value, "y") == 0) || (strcasecmp(k->value, "yes") == 0) ||
-	    (strcasecmp(k->value, "on") == 0)) {
-		return 1;
-	}
-	return default_value;
+	return bool_value(k->value, default_value);
 }
 
 
@@ -319,20 +337,106 @@ int config_has_section(const char *sectionname)
  * \retval n           key found with \c n values (\c n > 0)
  */
 int config_has_key(const char *sectionname, const char *keyname)
+{
+	ConfigKey *k = find_key(find_section(sectionname), keyname, 0);
+
+	return (k != NULL) ? k->count : 0;
+}
+
+
+/** Get the keys and values of a section as text, one "key=value" line per
+ * value in the order they were read, e.g. to tell whether a section
+ * changed when the configuration is read again.
+ * \param sectionname  Name of the section.
+ * \return             The text, to be freed by the caller; \c NULL if the
+ *                     section does not exist or on error.
+ */
+char *config_section_text(const char *sectionname)
 {
 	ConfigSection *s = find_section(sectionname);
-	int count = 0;
+	ConfigKey *k;
+	size_t size = 1, len = 0;
+	char *text;
 
-	if (s != NULL) {
-		ConfigKey *k;
+	if (s == NULL)
+		return NULL;
+	for (k = s->first_key; k != NULL; k = k->next_key)
+		size += strlen(k->name) + strlen(k->value) + 2;
+	text = malloc(size);
+	if (text == NULL)
+		return NULL;
+	for (k = s->first_key; k != NULL; k = k->next_key)
+		len += sprintf(text + len, "%s=%s\n", k->name, k->value);
+	text[len] = '\0';
+	return text;
+}
+
+
+/** Get several values of a section of the configuration at once, into a
+ * structure. Each entry of the table tells the name of a key, the type of
+ * its value and where in the structure it goes; the first value of a key
+ * is used. Fields whose key is missing, or has a value that is no legal
+ * value for the type, are left alone, so the structure should hold the
+ * defaults before. Strings are not copied, they are valid until the
+ * configuration is cleared.
+ * \param sectionname  Name of the section to read.
+ * \param options      Table of the keys to read.
+ * \param count        Number of entries in options.
+ * \param dest         Structure to store the values in.
+ * \return             Number of fields set.
+ */
+int config_get_section(const char *sectionname, const ConfigOption *options,
+		int count, void *dest)
+{
+	ConfigSection *s = find_section(sectionname);
+	int set = 0;
+	int i;
+
+	if (s == NULL)
+		return 0;
+
+	for (i = 0; i < count; i++) {
+		ConfigKey *k = find_key(s, options[i].name, 0);
+		void *field = (char *) dest + options[i].offset;
+		char *end;
 
-		for (k = s->first_key; k != NULL; k = k->next_key) {
-			/* Did we find the right key ?*/
-			if (strcasecmp(k->name, keyname) == 0)
-				count++;
+		if (k == NULL)
+			continue;
+
+		switch (options[i].type) {
+		  case CONFIG_BOOL: {
+			int v = bool_value(k->value, -1);
+
+			if (v < 0)
+				continue;
+			*(int *) field = v;
+			break;
+		  }
+		  case CONFIG_INT: {
+			long int v = strtol(k->value, &end, 0);
+
+			if ((end == k->value) || (*end != '\0'))
+				continue;
+			*(int *) field = (int) v;
+			break;
+		  }
+		  case CONFIG_FLOAT: {
+			double v = strtod(k->value, &end);
+
+			if ((end == k->value) || (*end != '\0'))
+				continue;
+			*(double *) field = v;
+			break;
+		  }
+		  case CONFIG_STRING:
+			*(const char **) field = k->value;
+			break;
+		  default:
+			continue;
 		}
+		set++;
 	}
-	return count;
+	return set;
 }
 
 
@@ -358,11 +462,15 @@ void config_clear(void)
 		next_s = s->next_section;
 
 		/* And destroy it */
+		HT_Destroy(s->keys);
 		free(s->name);
 		free(s);
 	}
 	/* Finally make everything inaccessible */
+	HT_Destroy(sections);
+	sections = NULL;
 	first_section = NULL;
+	last_section = NULL;
 }
 
 
@@ -370,83 +478,110 @@ void config_clear(void)
 
 static ConfigSection *find_section(const char *sectionname)
 {
-	ConfigSection *s;
+	if (sectionname == NULL)
+		return NULL;
 
-	for (s = first_section; s != NULL; s = s->next_section) {
-		if (strcasecmp(s->name, sectionname) == 0) {
-			return s;
-		}
-	}
-	return NULL; /* not found */
+	return HT_Find(sections, sectionname);
 }
 
 
 static ConfigSection *add_section(const char *sectionname)
 {
 	ConfigSection *s;
-	ConfigSection **place = &first_section;
 
-	for (s = first_section; s != NULL; s = s->next_section)
-		place = &(s->next_section);
+	if ((sections == NULL) && ((sections = HT_new_nocase()) == NULL))
+		return NULL;
 
-	*place = (ConfigSection *) malloc(sizeof(ConfigSection));
-	if (*place != NULL) {
-		(*place)->name = strdup(sectionname);
-		(*place)->first_key = NULL;
-		(*place)->next_section = NULL;
+	s = (ConfigSection *) malloc(sizeof(ConfigSection));
+	if (s == NULL)
+		return NULL;
+	s->name = strdup(sectionname);
+	s->first_key = NULL;
+	s->last_key = NULL;
+	s->keys = HT_new_nocase();
+	s->next_section = NULL;
+	if ((s->name == NULL) || (s->keys == NULL)
+	    || (HT_Insert(sections, s->name, s) < 0)) {
+		HT_Destroy(s->keys);
+		free(s->name);
+		free(s);
+		return NULL;
 	}
 
-	return(*place);
+	if (last_section != NULL)
+		last_section->next_section = s;
+	else
+		first_section = s;
+	last_section = s;
+
+	return s;
 }
 
 
 static ConfigKey *find_key(ConfigSection *s, const char *keyname, int skip)
 {
 	ConfigKey *k;
-	int count = 0;
-	ConfigKey *last_key = NULL;
 
 	/* Check for NULL section*/
-	if (s == NULL)
+	if ((s == NULL) || (keyname == NULL))
 		return NULL;
 
-	for (k = s->first_key; k != NULL; k = k->next_key) {
-
-		/* Did we find the right key ?*/
-		if (strcasecmp(k->name, keyname) == 0) {
-			if (count == skip)
-				return k;
-
-			count++;
-			last_key = k;
-		}
-	}
+	/* the values of a key are chained from its first one */
+	if ((k = HT_Find(s->keys, keyname)) == NULL)
+		return NULL;
 	if (skip == -1)
-		return last_key;
+		return k->last_same;
 
-	return NULL; /* not found*/
+	while ((k != NULL) && (skip-- > 0))
+		k = k->next_same;
+
+	return k;
 }
 
 
 static ConfigKey *add_key(ConfigSection *s, const char *keyname, const char *value)
 {
-	if (s != NULL) {
-		ConfigKey *k;
-		ConfigKey **place = &(s->first_key);
+	ConfigKey *k;
+	ConfigKey *first;
 
-		for (k = s->first_key; k != NULL; k = k->next_key)
-			place = &(k->next_key);
+	if (s == NULL)
+		return NULL;
 
-		*place = (ConfigKey *) malloc(sizeof(ConfigKey));
-		if (*place != NULL) {
-			(*place)->name = strdup(keyname);
-			(*place)->value = strdup(value);
-			(*place)->next_key = NULL;
-		}
+	k = (ConfigKey *) malloc(sizeof(ConfigKey));
+	if (k == NULL)
+		return NULL;
+	k->name = strdup(keyname);
+	k->value = strdup(value);
+	k->next_key = NULL;
+	k->next_same = NULL;
+	k->last_same = k;
+	k->count = 1;
+	if ((k->name == NULL) || (k->value == NULL)) {
+		free(k->name);
+		free(k->value);
+		free(k);
+		return NULL;
+	}
 
-		return(*place);
+	if ((first = HT_Find(s->keys, k->name)) != NULL) {
+		first->last_same->next_same = k;
+		first->last_same = k;
+		first->count++;
+	}
+	else if (HT_Insert(s->keys, k->name, k) < 0) {
+		free(k->name);
+		free(k->value);
+		free(k);
+		return NULL;
 	}
-	return NULL;
+
+	if (s->last_key != NULL)
+		s->last_key->next_key = k;
+	else
+		s->first_key = k;
+	s->last_key = k;
+
+	return k;
 }
 
 
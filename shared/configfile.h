@@ -19,6 +19,8 @@
 #include "config.h"
 #endif
 
+#include <stddef.h>
+
 /* Opens the specified file and reads everything into memory.
  * Returns 0  when config file was successfully parsed
  * Returns <0 on errors
@@ -99,6 +101,32 @@ int config_has_section(const char *sectionname);
  */
 int config_has_key(const char *sectionname, const char *keyname);
 
+/* Returns the keys and values of a section as "key=value" lines, to be
+ * freed by the caller, or NULL if there is no such section.
+ */
+char *config_section_text(const char *sectionname);
+
+/** Types of the values config_get_section() reads */
+typedef enum {
+	CONFIG_BOOL,		/**< int, 0 or 1 as for config_get_bool() */
+	CONFIG_INT,		/**< int */
+	CONFIG_FLOAT,		/**< double */
+	CONFIG_STRING		/**< const char *, in the stored configuration */
+} ConfigType;
+
+/** A key of a section for config_get_section() */
+typedef struct ConfigOption {
+	const char *name;	/**< Name of the key */
+	ConfigType type;	/**< Type of its value */
+	size_t offset;		/**< Offset of the field in the structure (offsetof()) */
+} ConfigOption;
+
+/* Reads several keys of a section into the fields of a structure. Returns
+ * the number of fields set.
+ */
+int config_get_section(const char *sectionname, const ConfigOption *options,
+		int count, void *dest);
+
 /* Clears all data stored by the config_read_* functions.
  * Should be called if the config should be reread.
  */
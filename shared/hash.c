@@ -0,0 +1,291 @@
+/** \file shared/hash.c
+ * Define routines to deal with hash tables keyed by strings.
+ *
+ * Collisions are resolved by chaining; the number of buckets is doubled
+ * whenever the table holds more entries than buckets.
+ */
+
+/* This file is part of LCDproc.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "hash.h"
+
+/** Number of buckets of a freshly created table */
+#define HT_INITIAL_SIZE	16
+
+
+/** Compute the hash value of a string (32 bit FNV-1a).
+ * \param key  String to hash.
+ * \return  Hash value.
+ */
+unsigned int
+HT_HashString(const char *key)
+{
+	unsigned int hash = 2166136261U;
+
+	while (*key != '\0') {
+		hash ^= (unsigned char) *key++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+
+/** Compute the hash value of a string with its letters folded to lower
+ * case, so that keys differing only in case hash alike.
+ * \param key  String to hash.
+ * \return  Hash value.
+ */
+unsigned int
+HT_HashStringNoCase(const char *key)
+{
+	unsigned int hash = 2166136261U;
+
+	while (*key != '\0') {
+		hash ^= (unsigned char) tolower((unsigned char) *key++);
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+
+/* Hash and compare keys as the table wants it */
+static unsigned int
+HT_Hash(HashTable *table, const char *key)
+{
+	return table->nocase ? HT_HashStringNoCase(key) : HT_HashString(key);
+}
+
+static int
+HT_KeyEqual(HashTable *table, const char *a, const char *b)
+{
+	return (table->nocase ? strcasecmp(a, b) : strcmp(a, b)) == 0;
+}
+
+
+/** Create new hash table.
+ * \return  Pointer to freshly created table object; \c NULL on error.
+ */
+HashTable *
+HT_new(void)
+{
+	HashTable *table;
+
+	table = malloc(sizeof(HashTable));
+	if (table == NULL)
+		return NULL;
+
+	table->buckets = calloc(HT_INITIAL_SIZE, sizeof(HT_entry *));
+	if (table->buckets == NULL) {
+		free(table);
+		return NULL;
+	}
+	table->size = HT_INITIAL_SIZE;
+	table->length = 0;
+	table->nocase = 0;
+
+	return table;
+}
+
+
+/** Create new hash table whose keys are compared ignoring case.
+ * \return  Pointer to freshly created table object; \c NULL on error.
+ */
+HashTable *
+HT_new_nocase(void)
+{
+	HashTable *table = HT_new();
+
+	if (table != NULL)
+		table->nocase = 1;
+	return table;
+}
+
+
+/** Destroy the entire hash table.
+ * The payloads and keys are not touched.
+ * \param table  Table object to destroy.
+ */
+void
+HT_Destroy(HashTable *table)
+{
+	unsigned int i;
+
+	if (table == NULL)
+		return;
+
+	for (i = 0; i < table->size; i++) {
+		HT_entry *entry = table->buckets[i];
+
+		while (entry != NULL) {
+			HT_entry *next = entry->next;
+
+			free(entry);
+			entry = next;
+		}
+	}
+	free(table->buckets);
+	free(table);
+}
+
+
+/* Double the number of buckets and redistribute the entries.
+ * Entries keep their relative order within a bucket. */
+static int
+HT_Grow(HashTable *table)
+{
+	unsigned int size = table->size * 2;
+	HT_entry **buckets;
+	HT_entry **tails;
+	unsigned int i;
+
+	buckets = calloc(size, sizeof(HT_entry *));
+	tails = calloc(size, sizeof(HT_entry *));
+	if ((buckets == NULL) || (tails == NULL)) {
+		free(buckets);
+		free(tails);
+		return -1;
+	}
+
+	for (i = 0; i < table->size; i++) {
+		HT_entry *entry = table->buckets[i];
+
+		while (entry != NULL) {
+			HT_entry *next = entry->next;
+			unsigned int b = entry->hash & (size - 1);
+
+			entry->next = NULL;
+			if (tails[b] == NULL)
+				buckets[b] = entry;
+			else
+				tails[b]->next = entry;
+			tails[b] = entry;
+			entry = next;
+		}
+	}
+	free(tails);
+	free(table->buckets);
+	table->buckets = buckets;
+	table->size = size;
+
+	return 0;
+}
+
+
+/** Add an entry to the table.
+ * \param table  Table object.
+ * \param key    Key of the entry; must stay valid while the entry exists.
+ * \param data   Payload of the entry.
+ * \retval <0    Error.
+ * \retval  0    Success.
+ */
+int
+HT_Insert(HashTable *table, const char *key, void *data)
+{
+	HT_entry *entry;
+	HT_entry **link;
+
+	if ((table == NULL) || (key == NULL))
+		return -1;
+
+	/* a failed grow only makes the chains longer */
+	if ((unsigned int) table->length >= table->size)
+		HT_Grow(table);
+
+	entry = malloc(sizeof(HT_entry));
+	if (entry == NULL)
+		return -1;
+	entry->key = key;
+	entry->hash = HT_Hash(table, key);
+	entry->data = data;
+	entry->next = NULL;
+
+	/* append, so that the first entry added for a key is found first */
+	for (link = &table->buckets[entry->hash & (table->size - 1)];
+	     *link != NULL; link = &(*link)->next)
+		;
+	*link = entry;
+	table->length++;
+
+	return 0;
+}
+
+
+/** Look up an entry by its key.
+ * \param table  Table object.
+ * \param key    Key to look for.
+ * \return  Payload of the first matching entry; \c NULL if not found.
+ */
+void *
+HT_Find(HashTable *table, const char *key)
+{
+	HT_entry *entry;
+	unsigned int hash;
+
+	if ((table == NULL) || (key == NULL))
+		return NULL;
+
+	hash = HT_Hash(table, key);
+	for (entry = table->buckets[hash & (table->size - 1)];
+	     entry != NULL; entry = entry->next) {
+		/* interned keys are found by their pointer */
+		if ((entry->key == key)
+		    || ((entry->hash == hash) && HT_KeyEqual(table, entry->key, key)))
+			return entry->data;
+	}
+	return NULL;
+}
+
+
+/** Remove an entry from the table.
+ * \param table  Table object.
+ * \param key    Key of the entry.
+ * \param data   Payload of the entry to remove; \c NULL removes the first
+ *               entry with a matching key.
+ * \retval <0    Error or not found.
+ * \retval  0    Success.
+ */
+int
+HT_Remove(HashTable *table, const char *key, void *data)
+{
+	HT_entry **link;
+	unsigned int hash;
+
+	if ((table == NULL) || (key == NULL))
+		return -1;
+
+	hash = HT_Hash(table, key);
+	for (link = &table->buckets[hash & (table->size - 1)];
+	     *link != NULL; link = &(*link)->next) {
+		HT_entry *entry = *link;
+
+		if ((entry->hash == hash) && HT_KeyEqual(table, entry->key, key)
+		    && ((data == NULL) || (entry->data == data))) {
+			*link = entry->next;
+			free(entry);
+			table->length--;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+
+/** Return the number of entries in the table.
+ * \param table  Table object.
+ * \return  Number of entries; \c -1 on error.
+ */
+int
+HT_Length(HashTable *table)
+{
+	if (table == NULL)
+		return -1;
+	return table->length;
+}
@@ -0,0 +1,68 @@
+/** \file shared/hash.h
+ * Define routines to deal with hash tables keyed by strings.
+ */
+
+/* This file is part of LCDproc.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+/***********************************************************************
+  Hash tables map a string key to a "void *" payload.
+
+    HashTable *table;
+    table = HT_new();
+    if (!table) handle_an_error();
+
+    HT_Insert(table, thingie->name, (void *) thingie);
+    thingie = (my_data *) HT_Find(table, "name");
+    HT_Remove(table, thingie->name, (void *) thingie);
+
+  The key is not copied: it must stay valid (and unchanged) for as long
+  as the entry is in the table.  Usually it is a string stored inside the
+  payload itself.
+
+  The same key may be inserted several times; HT_Find() then returns the
+  payload that was inserted first.
+
+  Tables made by HT_new_nocase() ignore the case of ASCII letters in keys.
+
+  For errors, the general convention is that "0" means success, and
+  a negative number means failure (as in LL.h).
+***********************************************************************/
+
+/** Structure for an entry in a hash table */
+typedef struct HT_entry {
+	struct HT_entry *next;	/**< Next entry in the same bucket */
+	const char *key;	/**< Key (not owned by the table) */
+	unsigned int hash;	/**< Cached hash value of key */
+	void *data;		/**< Payload */
+} HT_entry;
+
+/** Structure for a hash table */
+typedef struct HashTable {
+	HT_entry **buckets;	/**< Array of bucket chains */
+	unsigned int size;	/**< Number of buckets (power of 2) */
+	int length;		/**< Number of entries */
+	int nocase;		/**< Keys are compared ignoring case */
+} HashTable;
+
+// See hash.c for more detailed descriptions of these functions.
+
+HashTable *HT_new(void);
+HashTable *HT_new_nocase(void);
+void HT_Destroy(HashTable *table);
+
+int HT_Insert(HashTable *table, const char *key, void *data);
+void *HT_Find(HashTable *table, const char *key);
+int HT_Remove(HashTable *table, const char *key, void *data);
+int HT_Length(HashTable *table);
+
+unsigned int HT_HashString(const char *key);
+unsigned int HT_HashStringNoCase(const char *key);
+
+#endif
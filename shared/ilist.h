@@ -0,0 +1,133 @@
+/** \file shared/ilist.h
+ * Define routines to deal with intrusive doubly linked lists.
+ */
+
+/* This file is part of LCDproc.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef ILIST_H
+#define ILIST_H
+
+#include <stddef.h>
+
+/***********************************************************************
+  An intrusive list links objects through a node embedded in the
+  objects themselves: adding and removing an object allocates nothing,
+  and removing it does not need to search for it.  There is no "current"
+  position; a loop keeps its own:
+
+    typedef struct my_data {
+      IL_node node;
+      int number;
+    } my_data;
+
+    IL_list list;
+    IL_Init(&list);
+    IL_Append(&list, &thingie->node);
+
+    for (n = IL_First(&list); n != NULL; n = IL_Next(&list, n)) {
+      thingie = IL_ENTRY(n, my_data, node);
+      ... do something to it ...
+    }
+
+    IL_Remove(&list, &thingie->node);
+
+  To remove objects while walking the list, fetch the next node before
+  removing the current one.  An object can be in as many lists at once
+  as it has nodes.
+***********************************************************************/
+
+/** Structure of the node embedded in a listed object */
+typedef struct IL_node {
+	struct IL_node *prev;	/**< Previous node, the anchor for the first */
+	struct IL_node *next;	/**< Next node, the anchor for the last */
+} IL_node;
+
+/** Structure for an intrusive list */
+typedef struct IL_list {
+	IL_node anchor;		/**< Links to the first and the last node */
+	int length;		/**< Number of nodes */
+} IL_list;
+
+/** Get the object a node is embedded in */
+#define IL_ENTRY(node, type, member) \
+	((type *) ((char *) (node) - offsetof(type, member)))
+
+
+/** Make a list empty.
+ * \param list  List to initialize.
+ */
+static inline void
+IL_Init(IL_list *list)
+{
+	list->anchor.prev = list->anchor.next = &list->anchor;
+	list->length = 0;
+}
+
+
+/** Add a node behind the last node.
+ * \param list  List to add to.
+ * \param node  Node of the object; it must not be in the list yet.
+ */
+static inline void
+IL_Append(IL_list *list, IL_node *node)
+{
+	node->prev = list->anchor.prev;
+	node->next = &list->anchor;
+	list->anchor.prev->next = node;
+	list->anchor.prev = node;
+	list->length++;
+}
+
+
+/** Remove a node from its list.
+ * \param list  List the node is in.
+ * \param node  Node to remove.
+ */
+static inline void
+IL_Remove(IL_list *list, IL_node *node)
+{
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+	node->prev = node->next = NULL;
+	list->length--;
+}
+
+
+/** Get the first node.
+ * \param list  List to walk.
+ * \return      First node; \c NULL if the list is empty.
+ */
+static inline IL_node *
+IL_First(IL_list *list)
+{
+	return (list->anchor.next != &list->anchor) ? list->anchor.next : NULL;
+}
+
+
+/** Get the node following another one.
+ * \param list  List to walk.
+ * \param node  Current node.
+ * \return      Next node; \c NULL at the end of the list.
+ */
+static inline IL_node *
+IL_Next(IL_list *list, IL_node *node)
+{
+	return (node->next != &list->anchor) ? node->next : NULL;
+}
+
+
+/** Tell the number of nodes in a list.
+ * \param list  List to count.
+ * \return      Number of nodes.
+ */
+static inline int
+IL_Length(IL_list *list)
+{
+	return list->length;
+}
+
+#endif
@@ -0,0 +1,184 @@
+/** \file shared/intern.c
+ * Define routines to share the storage of identical strings.
+ *
+ * Each string is kept in an entry with its reference count, the string
+ * following the count, so the pointer handed out leads back to its entry.
+ * A hash table keyed by the strings themselves finds the entries.
+ *
+ * The memory of a string may be charged to an account, a counter of
+ * bytes: that of the first taker charging one. The charge stays for as
+ * long as that account holds a reference, then it goes to the next taker
+ * charging an account.
+ */
+
+/* This file is part of LCDproc.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "hash.h"
+#include "intern.h"
+
+/** An interned string with its reference count */
+typedef struct InternEntry {
+	int refs;		/**< References handed out */
+	size_t *account;	/**< Account charged for it, or NULL */
+	int account_refs;	/**< References the account holds */
+	char str[];		/**< The string */
+} InternEntry;
+
+#define INTERN_ENTRY(str)	((InternEntry *) ((char *) (str) - offsetof(InternEntry, str)))
+
+/** All interned strings; made with the first one */
+static HashTable *strings = NULL;
+/** Memory taken by the entries */
+static size_t strings_size = 0;
+
+
+/**
+ * Get the interned copy of a string, interning it if it is not yet.
+ * \param str  The string.
+ * \return  The shared copy, to be given back with intern_put(); NULL on
+ *          error or if \c str is NULL.
+ */
+const char *
+intern_get(const char *str)
+{
+	return intern_get_charged(str, NULL);
+}
+
+
+/**
+ * Get the interned copy of a string like intern_get(), charging its memory
+ * to an account unless another one is charged already.
+ * \param str      The string.
+ * \param account  Bytes charged to the taker; NULL charges nobody.
+ * \return  The shared copy, to be given back with intern_put_charged() and
+ *          the same account; NULL on error or if \c str is NULL.
+ */
+const char *
+intern_get_charged(const char *str, size_t *account)
+{
+	InternEntry *e;
+	size_t len;
+
+	if (str == NULL)
+		return NULL;
+	if (strings == NULL) {
+		strings = HT_new();
+		if (strings == NULL)
+			return NULL;
+	}
+
+	e = HT_Find(strings, str);
+	if (e != NULL) {
+		e->refs++;
+		if ((account != NULL) && (e->account == NULL)) {
+			e->account = account;
+			*account += sizeof(InternEntry) + strlen(e->str) + 1;
+		}
+		if ((account != NULL) && (e->account == account))
+			e->account_refs++;
+		return e->str;
+	}
+
+	len = strlen(str) + 1;
+	e = malloc(sizeof(InternEntry) + len);
+	if (e == NULL)
+		return NULL;
+	e->refs = 1;
+	e->account = account;
+	e->account_refs = (account != NULL) ? 1 : 0;
+	memcpy(e->str, str, len);
+	if (HT_Insert(strings, e->str, e) < 0) {
+		free(e);
+		return NULL;
+	}
+	strings_size += sizeof(InternEntry) + len;
+	if (account != NULL)
+		*account += sizeof(InternEntry) + len;
+	return e->str;
+}
+
+
+/**
+ * Give back a reference to an interned string; the string is freed with
+ * the last one.
+ * \param str  The string intern_get() returned; NULL does nothing.
+ */
+void
+intern_put(const char *str)
+{
+	intern_put_charged(str, NULL);
+}
+
+
+/**
+ * Give back a reference taken with intern_get_charged(). The account is
+ * no longer charged once it holds no more references.
+ * \param str      The string intern_get_charged() returned; NULL does nothing.
+ * \param account  The account given to intern_get_charged().
+ */
+void
+intern_put_charged(const char *str, size_t *account)
+{
+	InternEntry *e;
+
+	if (str == NULL)
+		return;
+	e = INTERN_ENTRY(str);
+	if ((account != NULL) && (e->account == account) && (--e->account_refs == 0)) {
+		*account -= sizeof(InternEntry) + strlen(e->str) + 1;
+		e->account = NULL;
+	}
+	if (--e->refs > 0)
+		return;
+	HT_Remove(strings, e->str, e);
+	strings_size -= sizeof(InternEntry) + strlen(e->str) + 1;
+	free(e);
+}
+
+
+/**
+ * Find the interned copy of a string without taking a reference, e.g. to
+ * compare it by pointer with the interned strings held.
+ * \param str  The string.
+ * \return  The shared copy; NULL if the string is not interned.
+ */
+const char *
+intern_find(const char *str)
+{
+	InternEntry *e;
+
+	if (str == NULL)
+		return NULL;
+	e = HT_Find(strings, str);
+	return (e != NULL) ? e->str : NULL;
+}
+
+
+/**
+ * Tell how many different strings are interned.
+ * \return  Number of strings.
+ */
+int
+intern_count(void)
+{
+	return (strings != NULL) ? HT_Length(strings) : 0;
+}
+
+
+/**
+ * Tell how much memory the interned strings take, without the table.
+ * \return  Size in bytes.
+ */
+size_t
+intern_size(void)
+{
+	return strings_size;
+}
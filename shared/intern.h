@@ -0,0 +1,53 @@
+/** \file shared/intern.h
+ * Define routines to share the storage of identical strings.
+ */
+
+/* This file is part of LCDproc.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+/***********************************************************************
+  Interned strings are kept once, however often they are asked for, and
+  counted: each intern_get() takes a reference, each intern_put() gives
+  one back, and the string is freed with its last reference.
+
+    const char *id = intern_get("title");
+    if (!id) handle_an_error();
+
+    if (intern_find(name) == id) ...	// same string, no strcmp()
+    intern_put(id);
+
+  As two interned strings are equal exactly if their pointers are, code
+  holding interned strings may compare them by pointer.  Interned strings
+  must not be changed.  The table is not locked: use it from one thread.
+
+  To keep a user of the table from holding unlimited memory in it for
+  free, the memory of a string is charged to the first account, a counter
+  of bytes, that takes it with intern_get_charged(), for as long as that
+  account holds a reference given back with intern_put_charged().
+
+    size_t charged = 0;
+    const char *label = intern_get_charged(str, &charged);
+    ...
+    intern_put_charged(label, &charged);
+***********************************************************************/
+
+// See intern.c for more detailed descriptions of these functions.
+
+const char *intern_get(const char *str);
+void intern_put(const char *str);
+const char *intern_get_charged(const char *str, size_t *account);
+void intern_put_charged(const char *str, size_t *account);
+const char *intern_find(const char *str);
+
+int intern_count(void);
+size_t intern_size(void);
+
+#endif
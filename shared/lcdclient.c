@@ -0,0 +1,371 @@
+/** \file shared/lcdclient.c
+ * Functions for clients talking to LCDd.
+ *
+ * Clients typically set all their widgets on every update, although most
+ * of them did not change. lcd_client_send() remembers the last value sent
+ * for each widget and leaves out a widget_set that would send the same
+ * again. widget_add, widget_del and screen_del make it forget the widgets
+ * they concern, and connecting anew forgets all. The values are kept for
+ * one connection at a time, which is what clients have.
+ *
+ * Batching is done by the socket layer: send the commands of an update
+ * between sock_cork() and sock_uncork().
+ */
+
+/*-
+ * This file is part of LCDproc.
+ *
+ * This file is released under the GNU General Public License. Refer to the
+ * COPYING file distributed with this package.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <stdarg.h>
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "report.h"
+#include "sockets.h"
+#include "str.h"
+#include "hash.h"
+#include "lcdclient.h"
+
+// Longest formatted message of lcd_client_printf()
+#define MAXMSG 8192
+// Longest screen and widget id pair that is remembered
+#define MAXKEY 256
+
+/** Last value sent for a widget */
+typedef struct WidgetValue {
+	char *key;		/**< Screen id, a space and widget id */
+	size_t screen_len;	/**< Length of the screen id in key */
+	char *value;		/**< Arguments of the widget_set after the ids */
+	size_t value_len;
+} WidgetValue;
+
+static HashTable *values = NULL;
+
+
+/**
+ * Connect to the server, say hello and wait up to 5 seconds for its
+ * connect response.
+ * \param host  Hostname or IP-address, or the path of the server's UNIX
+ *              domain socket
+ * \param port  Port number
+ * \param info  Where to store what the server tells about itself
+ * \return  Socket file descriptor on success, -1 on error.
+ */
+int
+lcd_client_connect (char *host, unsigned short int port, LCDServerInfo *info)
+{
+	char buf[MAXMSG];
+	char *argv[40];
+	int argc;
+	int len = 0;
+	int timeout = 50;
+	int fd;
+
+	fd = sock_connect(host, port);
+	if (fd < 0)
+		return -1;
+
+	/* LCDd knows nothing of this client's widgets */
+	lcd_client_forget(NULL);
+
+	if (sock_send_string(fd, "hello\n") < 0) {
+		sock_close(fd);
+		return -1;
+	}
+	while ((len = sock_recv_string(fd, buf, sizeof(buf))) == 0 && (timeout-- > 0))
+		usleep(100000);
+	if (len <= 0) {
+		report(RPT_ERR, "lcd_client_connect: no connect response from %s", host);
+		sock_close(fd);
+		return -1;
+	}
+
+	argc = get_args(argv, buf, sizeof(argv) / sizeof(argv[0]));
+	if (lcd_client_parse_connect(argc, argv, info) < 0) {
+		report(RPT_ERR, "lcd_client_connect: invalid connect response from %s", host);
+		sock_close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+
+/**
+ * Read a connect response, e.g. "connect LCDproc 0.5 protocol 0.4 lcd wid
+ * 20 hgt 4 cellwid 5 cellhgt 8", that was split into arguments.
+ * \param argc  Number of arguments
+ * \param argv  The arguments
+ * \param info  Where to store what the server tells about itself
+ * \return  0 on success, -1 if it is no valid connect response.
+ */
+int
+lcd_client_parse_connect (int argc, char **argv, LCDServerInfo *info)
+{
+	int a;
+
+	if ((argc < 1) || (strcmp(argv[0], "connect") != 0))
+		return -1;
+
+	memset(info, 0, sizeof(*info));
+	for (a = 1; a < argc - 1; a++) {
+		if (strcmp(argv[a], "wid") == 0)
+			info->wid = atoi(argv[++a]);
+		else if (strcmp(argv[a], "hgt") == 0)
+			info->hgt = atoi(argv[++a]);
+		else if (strcmp(argv[a], "cellwid") == 0)
+			info->cellwid = atoi(argv[++a]);
+		else if (strcmp(argv[a], "cellhgt") == 0)
+			info->cellhgt = atoi(argv[++a]);
+		else if (strcmp(argv[a], "protocol") == 0)
+			sscanf(argv[++a], "%d.%d", &info->protocol_major, &info->protocol_minor);
+	}
+	return ((info->wid > 0) && (info->hgt > 0)) ? 0 : -1;
+}
+
+
+/**
+ * Length of the argument at s: a word, or a string quoted with {} or "".
+ */
+static size_t
+arg_length (const char *s, const char *end)
+{
+	const char *p = s;
+
+	if ((p < end) && (*p == '{')) {
+		while ((p < end) && (*p != '}'))
+			p++;
+		if (p < end)
+			p++;
+	}
+	else if ((p < end) && (*p == '"')) {
+		for (p++; (p < end) && (*p != '"'); p++) {
+			if ((*p == '\\') && (p + 1 < end))
+				p++;
+		}
+		if (p < end)
+			p++;
+	}
+	else {
+		while ((p < end) && (*p != ' ') && (*p != '\t'))
+			p++;
+	}
+	return p - s;
+}
+
+
+static const char *
+skip_blanks (const char *p, const char *end)
+{
+	while ((p < end) && ((*p == ' ') || (*p == '\t')))
+		p++;
+	return p;
+}
+
+
+static void
+forget_value (WidgetValue *v)
+{
+	HT_Remove(values, v->key, v);
+	free(v->key);
+	free(v->value);
+	free(v);
+}
+
+
+/**
+ * Account for a line of commands.
+ * \return  1 if it is to be sent, 0 if it changes nothing.
+ */
+static int
+lcd_client_line (const char *line, const char *end)
+{
+	const char *cmd, *screen, *widget, *rest;
+	size_t cmd_len, screen_len, widget_len;
+	char key[MAXKEY];
+	WidgetValue *v;
+
+	cmd = skip_blanks(line, end);
+	cmd_len = arg_length(cmd, end);
+	screen = skip_blanks(cmd + cmd_len, end);
+	screen_len = arg_length(screen, end);
+
+	if ((cmd_len == 10) && (strncmp(cmd, "screen_del", 10) == 0)) {
+		if (screen_len + 1 <= sizeof(key)) {
+			memcpy(key, screen, screen_len);
+			key[screen_len] = '\0';
+			lcd_client_forget(key);
+		}
+		else
+			lcd_client_forget(NULL);
+		return 1;
+	}
+	if ((cmd_len != 10) || ((strncmp(cmd, "widget_set", 10) != 0)
+	    && (strncmp(cmd, "widget_add", 10) != 0) && (strncmp(cmd, "widget_del", 10) != 0)))
+		return 1;
+
+	widget = skip_blanks(screen + screen_len, end);
+	widget_len = arg_length(widget, end);
+	rest = skip_blanks(widget + widget_len, end);
+	if ((screen_len == 0) || (widget_len == 0) || (screen_len + widget_len + 2 > sizeof(key)))
+		return 1;
+
+	memcpy(key, screen, screen_len);
+	key[screen_len] = ' ';
+	memcpy(key + screen_len + 1, widget, widget_len);
+	key[screen_len + 1 + widget_len] = '\0';
+
+	if (values == NULL) {
+		values = HT_new();
+		if (values == NULL)
+			return 1;
+	}
+	v = HT_Find(values, key);
+
+	if (cmd[7] != 's') {
+		/* widget_add or widget_del: the widget starts anew */
+		if (v != NULL)
+			forget_value(v);
+		return 1;
+	}
+
+	if ((v != NULL) && (v->value_len == (size_t) (end - rest))
+	    && (memcmp(v->value, rest, v->value_len) == 0))
+		return 0;
+
+	if (v == NULL) {
+		v = calloc(1, sizeof(*v));
+		if ((v == NULL) || ((v->key = strdup(key)) == NULL)
+		    || (HT_Insert(values, v->key, v) < 0)) {
+			if (v != NULL)
+				free(v->key);
+			free(v);
+			return 1;
+		}
+		v->screen_len = screen_len;
+	}
+	free(v->value);
+	v->value_len = end - rest;
+	v->value = malloc(v->value_len + 1);
+	if (v->value == NULL) {
+		forget_value(v);
+		return 1;
+	}
+	memcpy(v->value, rest, v->value_len);
+	v->value[v->value_len] = '\0';
+	return 1;
+}
+
+
+/**
+ * Send lines of commands, leaving out widget_set that change nothing.
+ * \param fd        Socket file descriptor
+ * \param commands  Commands, each ending with a newline
+ * \param size      Their length
+ * \return  Number of bytes of the commands handled, -1 on error.
+ */
+static int
+lcd_client_send_buf (int fd, const char *commands, size_t size)
+{
+	const char *end = commands + size;
+	const char *pending = commands;	/* start of the lines to send */
+	const char *line = commands;
+
+	while (line < end) {
+		const char *nl = memchr(line, '\n', end - line);
+		const char *next = (nl != NULL) ? nl + 1 : end;
+
+		if (!lcd_client_line(line, (nl != NULL) ? nl : end)) {
+			if ((line > pending) && (sock_send(fd, pending, line - pending) < 0))
+				return -1;
+			pending = next;
+		}
+		line = next;
+	}
+	if ((end > pending) && (sock_send(fd, pending, end - pending) < 0))
+		return -1;
+	return size;
+}
+
+
+/**
+ * Send lines of commands, leaving out widget_set that would send the value
+ * the widget already has.
+ * \param fd        Socket file descriptor
+ * \param commands  Commands, each ending with a newline
+ * \return  Number of bytes of the commands handled, -1 on error.
+ */
+int
+lcd_client_send (int fd, const char *commands)
+{
+	return lcd_client_send_buf(fd, commands, strlen(commands));
+}
+
+
+/**
+ * Send printf-like formatted commands, leaving out widget_set that change
+ * nothing as lcd_client_send() does.
+ * \param fd      Socket file descriptor
+ * \param format  Format string
+ * \param ...     Arguments to the format string
+ * \return  Number of bytes of the commands handled, -1 on error.
+ */
+int
+lcd_client_printf (int fd, const char *format, .../*args*/)
+{
+	char buf[MAXMSG];
+	va_list ap;
+	int size;
+
+	va_start(ap, format);
+	size = vsnprintf(buf, sizeof(buf), format, ap);
+	va_end(ap);
+
+	if (size < 0) {
+		report(RPT_ERR, "lcd_client_printf: vsnprintf failed");
+		return -1;
+	}
+	if (size >= sizeof(buf)) {
+		report(RPT_WARNING, "lcd_client_printf: vsnprintf truncated message");
+		size = sizeof(buf) - 1;
+	}
+	return lcd_client_send_buf(fd, buf, size);
+}
+
+
+/**
+ * Forget the widget values sent for a screen, e.g. because it is gone.
+ * \param screen  Screen id as sent, or \c NULL for all screens.
+ */
+void
+lcd_client_forget (const char *screen)
+{
+	size_t len = (screen != NULL) ? strlen(screen) : 0;
+	unsigned int i;
+
+	if (values == NULL)
+		return;
+
+	for (i = 0; i < values->size; i++) {
+		HT_entry *e = values->buckets[i];
+
+		while (e != NULL) {
+			HT_entry *next = e->next;
+			WidgetValue *v = e->data;
+
+			if ((screen == NULL)
+			    || ((v->screen_len == len) && (strncmp(v->key, screen, len) == 0)))
+				forget_value(v);
+			e = next;
+		}
+	}
+}
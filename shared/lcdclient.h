@@ -0,0 +1,31 @@
+/** \file shared/lcdclient.h
+ * Functions for clients talking to LCDd: connecting, reading the connect
+ * response, and sending commands without repeating widget values the
+ * server already shows.
+ */
+
+#ifndef LCDCLIENT_H
+#define LCDCLIENT_H
+
+/** What the server tells about itself in its connect response */
+typedef struct LCDServerInfo {
+	int wid;		/**< Display width in characters */
+	int hgt;		/**< Display height in characters */
+	int cellwid;		/**< Character cell width in pixels */
+	int cellhgt;		/**< Character cell height in pixels */
+	int protocol_major;	/**< Protocol version */
+	int protocol_minor;
+} LCDServerInfo;
+
+/** Connect to the server, say hello and wait for its connect response */
+int lcd_client_connect (char *host, unsigned short int port, LCDServerInfo *info);
+/** Read a connect response that was split into arguments */
+int lcd_client_parse_connect (int argc, char **argv, LCDServerInfo *info);
+/** Send lines of commands, leaving out widget_set that change nothing */
+int lcd_client_send (int fd, const char *commands);
+/** Send printf-like formatted commands, like lcd_client_send() */
+int lcd_client_printf (int fd, const char *format, .../*args*/);
+/** Forget the widget values sent for a screen (NULL: for all) */
+void lcd_client_forget (const char *screen);
+
+#endif
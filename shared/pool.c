@@ -0,0 +1,285 @@
+/** \file shared/pool.c
+ * Define routines to deal with memory pools for many small objects.
+ *
+ * Every block is preceded by a header telling its size class. Blocks of
+ * a class are cut from chunks of POOL_CHUNK_SIZE bytes and never given
+ * back to the heap before the pool is destroyed; freed blocks are reused
+ * for the next allocation of their class instead.
+ */
+
+/* This file is part of LCDproc.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "pool.h"
+
+/** Size of the chunks blocks are cut from */
+#define POOL_CHUNK_SIZE		8192
+/** Size of the blocks of the smallest class, including the header */
+#define POOL_MIN_BLOCK		16
+/** Class of blocks from malloc() */
+#define POOL_LARGE		POOL_CLASSES
+
+/** Header in front of each block; the union makes it keep the alignment
+ * malloc() guarantees for the block behind it */
+typedef union PoolHeader {
+	unsigned int cls;	/**< Size class of the block */
+	void *align_ptr;
+	long align_long;
+	double align_double;
+} PoolHeader;
+
+/** Round up to a multiple of the header size */
+#define POOL_ALIGN(n)	((((n) + sizeof(PoolHeader) - 1) / sizeof(PoolHeader)) * sizeof(PoolHeader))
+
+#define POOL_HEADER(ptr)	((PoolHeader *) ((char *) (ptr) - sizeof(PoolHeader)))
+#define POOL_LARGE_BLOCK(ptr)	((PoolLarge *) ((char *) POOL_HEADER(ptr) - POOL_ALIGN(sizeof(PoolLarge))))
+
+
+/** Find the size class for a block.
+ * \param size  Size requested.
+ * \return  Size class, POOL_LARGE if the block is too large.
+ */
+static unsigned int
+pool_class(size_t size)
+{
+	size_t block = POOL_MIN_BLOCK;
+	unsigned int cls = 0;
+
+	size += sizeof(PoolHeader);
+	while (block < size) {
+		block <<= 1;
+		if (++cls == POOL_LARGE)
+			break;
+	}
+	return cls;
+}
+
+
+/** Create new pool.
+ * \return  Pointer to freshly created pool object; \c NULL on error.
+ */
+Pool *
+pool_new(void)
+{
+	return calloc(1, sizeof(Pool));
+}
+
+
+/** Destroy a pool and all blocks still allocated from it at once.
+ * \param pool  Pool object to destroy.
+ */
+void
+pool_destroy(Pool *pool)
+{
+	if (pool == NULL)
+		return;
+
+	while (pool->chunks != NULL) {
+		PoolChunk *chunk = pool->chunks;
+
+		pool->chunks = chunk->next;
+		free(chunk);
+	}
+	while (pool->large != NULL) {
+		PoolLarge *large = pool->large;
+
+		pool->large = large->next;
+		free(large);
+	}
+	free(pool);
+}
+
+
+/** Allocate a block of memory.
+ * \param pool  Pool to allocate from, or \c NULL to use malloc().
+ * \param size  Size of the block.
+ * \return  Pointer to the (uninitialised) block; \c NULL on error.
+ */
+void *
+pool_alloc(Pool *pool, size_t size)
+{
+	PoolHeader *header;
+	unsigned int cls;
+	size_t block;
+
+	if (pool == NULL)
+		return malloc(size);
+
+	cls = pool_class(size);
+	if (cls == POOL_LARGE) {
+		PoolLarge *large;
+
+		block = POOL_ALIGN(sizeof(PoolLarge)) + sizeof(PoolHeader) + size;
+		large = malloc(block);
+		if (large == NULL)
+			return NULL;
+		large->prev = NULL;
+		large->next = pool->large;
+		large->size = size;
+		if (pool->large != NULL)
+			pool->large->prev = large;
+		pool->large = large;
+		pool->size += block;
+		pool->used += size;
+
+		header = (PoolHeader *) ((char *) large + POOL_ALIGN(sizeof(PoolLarge)));
+	}
+	else if (pool->free[cls] != NULL) {
+		/* reuse a freed block, it points to the next one */
+		header = POOL_HEADER(pool->free[cls]);
+		pool->free[cls] = *(void **) pool->free[cls];
+	}
+	else {
+		block = POOL_MIN_BLOCK << cls;
+		if (pool->left < block) {
+			/* the rest of the chunk is too small: start a new one */
+			PoolChunk *chunk = malloc(POOL_CHUNK_SIZE);
+
+			if (chunk == NULL)
+				return NULL;
+			chunk->next = pool->chunks;
+			pool->chunks = chunk;
+			pool->size += POOL_CHUNK_SIZE;
+			pool->top = (char *) chunk + POOL_ALIGN(sizeof(PoolChunk));
+			pool->left = POOL_CHUNK_SIZE - POOL_ALIGN(sizeof(PoolChunk));
+		}
+		header = (PoolHeader *) pool->top;
+		pool->top += block;
+		pool->left -= block;
+	}
+	if (cls != POOL_LARGE)
+		pool->used += (POOL_MIN_BLOCK << cls) - sizeof(PoolHeader);
+
+	header->cls = cls;
+	return (char *) header + sizeof(PoolHeader);
+}
+
+
+/** Allocate a block of memory filled with zeros.
+ * \param pool  Pool to allocate from, or \c NULL to use calloc().
+ * \param size  Size of the block.
+ * \return  Pointer to the block; \c NULL on error.
+ */
+void *
+pool_calloc(Pool *pool, size_t size)
+{
+	void *ptr;
+
+	if (pool == NULL)
+		return calloc(1, size);
+
+	ptr = pool_alloc(pool, size);
+	if (ptr != NULL)
+		memset(ptr, 0, size);
+	return ptr;
+}
+
+
+/** Copy a string into a block of memory.
+ * \param pool  Pool to allocate from, or \c NULL to use malloc().
+ * \param str   String to copy.
+ * \return  Pointer to the copy; \c NULL on error.
+ */
+char *
+pool_strdup(Pool *pool, const char *str)
+{
+	size_t size = strlen(str) + 1;
+	char *copy = pool_alloc(pool, size);
+
+	if (copy != NULL)
+		memcpy(copy, str, size);
+	return copy;
+}
+
+
+/** Give a block of memory back to its pool.
+ * \param pool  Pool the block was allocated from, or \c NULL for free().
+ * \param ptr   Block to free; may be \c NULL.
+ */
+void
+pool_free(Pool *pool, void *ptr)
+{
+	unsigned int cls;
+
+	if (ptr == NULL)
+		return;
+	if (pool == NULL) {
+		free(ptr);
+		return;
+	}
+
+	cls = POOL_HEADER(ptr)->cls;
+	if (cls == POOL_LARGE) {
+		PoolLarge *large = POOL_LARGE_BLOCK(ptr);
+
+		if (large->prev != NULL)
+			large->prev->next = large->next;
+		else
+			pool->large = large->next;
+		if (large->next != NULL)
+			large->next->prev = large->prev;
+		pool->size -= POOL_ALIGN(sizeof(PoolLarge)) + sizeof(PoolHeader) + large->size;
+		pool->used -= large->size;
+		free(large);
+	}
+	else {
+		pool->used -= (POOL_MIN_BLOCK << cls) - sizeof(PoolHeader);
+		*(void **) ptr = pool->free[cls];
+		pool->free[cls] = ptr;
+	}
+}
+
+
+/** Tell how many bytes a block can hold.
+ * \param pool  Pool the block was allocated from.
+ * \param ptr   Block to check.
+ * \return  Usable size of the block, 0 if unknown (\c NULL pool).
+ */
+size_t
+pool_usable_size(Pool *pool, void *ptr)
+{
+	unsigned int cls;
+
+	if ((pool == NULL) || (ptr == NULL))
+		return 0;
+
+	cls = POOL_HEADER(ptr)->cls;
+	if (cls == POOL_LARGE)
+		return POOL_LARGE_BLOCK(ptr)->size;
+	return (POOL_MIN_BLOCK << cls) - sizeof(PoolHeader);
+}
+
+
+/** Replace a string by a copy of another one. The old block is reused if
+ * the new string fits into it, which spares an allocation for strings
+ * that are set over and over.
+ * \param pool  Pool both strings belong to, or \c NULL for malloc().
+ * \param old   Current string, freed unless reused; may be \c NULL.
+ * \param str   String to copy; \c NULL just frees \c old.
+ * \return  Pointer to the copy; \c NULL on error or if \c str is \c NULL.
+ */
+char *
+pool_strset(Pool *pool, char *old, const char *str)
+{
+	size_t size;
+	char *copy;
+
+	if (str == NULL) {
+		pool_free(pool, old);
+		return NULL;
+	}
+
+	size = strlen(str) + 1;
+	if ((old != NULL) && (size <= pool_usable_size(pool, old))) {
+		memmove(old, str, size);
+		return old;
+	}
+	copy = pool_strdup(pool, str);
+	pool_free(pool, old);
+	return copy;
+}
@@ -0,0 +1,79 @@
+/** \file shared/pool.h
+ * Define routines to deal with memory pools for many small objects.
+ */
+
+/* This file is part of LCDproc.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/***********************************************************************
+  A pool hands out small blocks of memory from large chunks, sorted into
+  a few size classes. Freed blocks are kept on a list per class and
+  reused for the next block of that class, so objects that are created
+  and destroyed over and over do not fragment the heap.  Blocks too
+  large for the classes come from malloc(), but still belong to the pool.
+
+    Pool *pool;
+    pool = pool_new();
+    if (!pool) handle_an_error();
+
+    thingie = pool_alloc(pool, sizeof(my_data));
+    thingie->name = pool_strdup(pool, "name");
+    pool_free(pool, thingie->name);
+    pool_free(pool, thingie);
+
+    pool_destroy(pool);	// frees everything still allocated, at once
+
+  All functions accept a NULL pool: they then fall back to malloc() and
+  free(), so code can use them for objects that belong to no pool.
+
+  Like malloc(), the allocating functions return NULL on error.
+***********************************************************************/
+
+/** Number of size classes; blocks are 16, 32, ... 1024 bytes large */
+#define POOL_CLASSES	7
+
+/** Structure for a chunk of memory blocks are taken from */
+typedef struct PoolChunk {
+	struct PoolChunk *next;		/**< Chunk allocated before */
+} PoolChunk;
+
+/** Structure for a block too large for the size classes */
+typedef struct PoolLarge {
+	struct PoolLarge *prev;		/**< Previous large block */
+	struct PoolLarge *next;		/**< Next large block */
+	size_t size;			/**< Size requested for the block */
+} PoolLarge;
+
+/** Structure for a pool */
+typedef struct Pool {
+	void *free[POOL_CLASSES];	/**< Lists of freed blocks per class */
+	PoolChunk *chunks;		/**< All chunks, most recent first */
+	char *top;			/**< Unused rest of the current chunk */
+	size_t left;			/**< Size of the rest */
+	PoolLarge *large;		/**< Blocks from malloc() */
+	size_t size;			/**< Memory taken from malloc() in total */
+	size_t used;			/**< Usable size of the blocks in use */
+} Pool;
+
+// See pool.c for more detailed descriptions of these functions.
+
+Pool *pool_new(void);
+void pool_destroy(Pool *pool);
+
+void *pool_alloc(Pool *pool, size_t size);
+void *pool_calloc(Pool *pool, size_t size);
+char *pool_strdup(Pool *pool, const char *str);
+void pool_free(Pool *pool, void *ptr);
+
+size_t pool_usable_size(Pool *pool, void *ptr);
+char *pool_strset(Pool *pool, char *old, const char *str);
+
+#endif
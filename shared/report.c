@@ -24,18 +24,24 @@
 static int report_level = RPT_INFO;
 static int report_dest = RPT_DEST_STORE;
 
+/* While messages are stored, all are kept until the level is known */
+int report_threshold = RPT_DEBUG;
+
 #define MAX_STORED_MSGS 200
 
 static char *stored_msgs[MAX_STORED_MSGS];
 static int stored_levels[MAX_STORED_MSGS];
 static int num_stored_msgs = 0;
 
+/* Takes the formatted messages instead of the destination, if set */
+static report_sink_func report_sink = NULL;
+
 /* local functions */
 static void store_report_message(int level, const char *message);
 static void flush_messages();
 
 void
-report(const int level, const char *format,... /* args */ )
+(report)(const int level, const char *format,... /* args */ )
 {
 	/* Check if we should report it */
 	if (level <= report_level || report_dest == RPT_DEST_STORE) {
@@ -49,6 +55,14 @@ report(const int level, const char *format,... /* args */ )
 		va_list ap;
 		va_start(ap, format);
 
+		if (report_sink != NULL && report_dest != RPT_DEST_STORE) {
+			vsnprintf(buf, sizeof(buf), format, ap);
+			buf[sizeof(buf) - 1] = 0;
+			va_end(ap);
+			report_sink(level, format, buf);
+			return;
+		}
+
 		switch (report_dest) {
 		    case RPT_DEST_STDERR:
 			vfprintf(stderr, format, ap);
@@ -85,6 +99,7 @@ set_reporting(char *application_name, int new_level, int new_dest)
 
 	report_level = new_level;
 	report_dest = new_dest;
+	report_threshold = (report_dest == RPT_DEST_STORE) ? RPT_DEBUG : report_level;
 
 	/*
 	 * Flush all messages currently in the message store if the new
@@ -97,6 +112,30 @@ set_reporting(char *application_name, int new_level, int new_dest)
 }
 
 
+void
+set_report_sink(report_sink_func sink)
+{
+	report_sink = sink;
+}
+
+
+void
+report_write(int level, const char *message)
+{
+	switch (report_dest) {
+	    case RPT_DEST_STDERR:
+		fprintf(stderr, "%s\n", message);
+		break;
+	    case RPT_DEST_SYSLOG:
+		syslog(LOG_USER | (level + 2), "%s", message);
+		break;
+	    case RPT_DEST_STORE:
+		store_report_message(level, message);
+		break;
+	}
+}
+
+
 /**
  * Puts a message into the message store. If the store is full new messages
  * are silently discarded.
@@ -15,6 +15,12 @@
  *
  * This way, the global DEBUG macro is off but is locally enabled in
  * certains parts of the software.
+ *
+ * The same goes for report() calls with the level RPT_DEBUG: without
+ * DEBUG they are not compiled in. Define RPT_MAX_LEVEL to choose the
+ * highest level that is compiled in.
+ *
+ * report() only evaluates its arguments if the message is reported.
  *\endverbatim
  */
 
@@ -74,12 +80,50 @@
 #define RPT_DEST_SYSLOG 1
 #define RPT_DEST_STORE 2
 
+/**
+ * \def RPT_MAX_LEVEL
+ *	Highest level of the report() calls compiled in. Calls with a
+ *	constant level above it cost nothing.
+ */
+#ifndef RPT_MAX_LEVEL
+# ifdef DEBUG
+#  define RPT_MAX_LEVEL RPT_DEBUG
+# else
+#  define RPT_MAX_LEVEL RPT_INFO
+# endif
+#endif
+
+/** Highest level reported at the moment (all while messages are stored) */
+extern int report_threshold;
+
 /** Sets reporting level and message destination. */
 int set_reporting( char *application_name, int new_level, int new_dest );
 
 /** Report the message to the selected destination if important enough */
 void report( const int level, const char *format, .../*args*/ );
 
+/**
+ * Function that takes the formatted messages instead of the destination,
+ * e.g. to write them on another thread. format is the format string of
+ * the report() call, message the message made from it.
+ */
+typedef void (*report_sink_func)( int level, const char *format, const char *message );
+
+/** Hand messages to a sink instead of writing them (NULL: write them) */
+void set_report_sink( report_sink_func sink );
+
+/** Write a formatted message to the selected destination right away */
+void report_write( int level, const char *message );
+
+/**
+ * Check the level before calling report(), so that the arguments of
+ * messages that would not be reported are not evaluated. Use (report) to
+ * get the function itself.
+ */
+#define report(level, ...) \
+	((((level) <= RPT_MAX_LEVEL) && ((level) <= report_threshold)) \
+	 ? (report)((level), __VA_ARGS__) : (void) 0)
+
 /**
  * The code that this function generates will not be in the executable when
  * compiled without debugging. This way memory and CPU cycles are saved.
@@ -89,12 +133,16 @@ static inline void dont_report( const int level, const char *format, .../*args*/
 
 /**
  * Consider the debug function to be exactly the same as the report function.
- * The only difference is that it is only compiled in if DEBUG is defined.
+ * The only difference is that it is only compiled in if DEBUG is defined;
+ * otherwise its arguments are not even evaluated. Where a function is
+ * needed, use DEBUG_FUNCTION.
  */
 #ifdef DEBUG
 #  define debug report
+#  define DEBUG_FUNCTION (report)
 #else
-#  define debug dont_report
+#  define DEBUG_FUNCTION dont_report
+#  define debug(...) (0 ? dont_report(__VA_ARGS__) : (void) 0)
 #endif
 
 #endif  /* REPORT_H */
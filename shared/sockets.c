@@ -18,10 +18,12 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <stdarg.h>
 #include <fcntl.h>
+#include <sys/uio.h>
 
 #ifdef HAVE_CONFIG_H
 # include "config.h"
@@ -33,8 +35,32 @@
 // Length of longest transmission allowed at once...
 #define MAXMSG 8192
 
+// Sockets corked at once, see sock_cork(); lcdproc corks one per server
+#define SOCK_BUFFERS 8
+// Data sent while corked is copied into the buffer up to this size;
+// larger data goes out right away, together with the buffer
+#define SOCK_BUFFER_INLINE 512
+
 typedef struct sockaddr_in sockaddr_in;
 
+/** Output gathered for a corked socket */
+typedef struct SockBuffer {
+	int fd;			/**< The socket, -1 if the entry is free */
+	char *data;
+	size_t len;		/**< Bytes gathered */
+	size_t size;		/**< Bytes allocated */
+	int depth;		/**< sock_cork() calls not yet undone */
+} SockBuffer;
+
+static SockBuffer buffers[SOCK_BUFFERS] = {
+	{ -1, NULL, 0, 0, 0 }, { -1, NULL, 0, 0, 0 }, { -1, NULL, 0, 0, 0 }, { -1, NULL, 0, 0, 0 }
+};
+static int corked = 0;		/* Entries in use */
+
+static SockBuffer *sock_buffer (int fd);
+static int sock_writev (int fd, const void *first, size_t first_size,
+			const void *second, size_t second_size);
+
 /**
  * Tries to resolve a resolve a hostname.
  * \param name      Pointer to resolves IP-address
@@ -62,8 +88,9 @@ sock_init_sockaddr (sockaddr_in *name, const char *hostname, unsigned short int
 
 /**
  * Connect to server.
- * \param host  Hostname or IP-address
- * \param port  Port number
+ * \param host  Hostname or IP-address, or the path of the server's UNIX
+ *              domain socket if it starts with a '/'
+ * \param port  Port number (ignored for a UNIX domain socket)
  * \return  socket file descriptor on success, -1 on error
  */
 int
@@ -73,6 +100,9 @@ sock_connect (char *host, unsigned short int port)
 	int sock;
 	int err = 0;
 
+	if (host[0] == '/')
+		return sock_connect_unix (host);
+
 	report (RPT_DEBUG, "sock_connect: Creating socket");
 	sock = socket (PF_INET, SOCK_STREAM, 0);
 	if (sock < 0) {
@@ -91,6 +121,83 @@ sock_connect (char *host, unsigned short int port)
 		return -1;
 	}
 
+	fcntl (sock, F_SETFL, O_NONBLOCK);
+	sock_set_keepalive (sock, SOCK_KEEPALIVE_IDLE);
+
+	return sock;
+}
+
+/**
+ * Have the kernel probe a TCP connection that was idle for a while, so
+ * that a peer that went away without closing it, e.g. by a crash or a
+ * network failure, shows as an error on the socket. This costs nothing
+ * while the connection carries data and spares the peers sending each
+ * other empty messages to find out.
+ * \param fd    Socket file descriptor
+ * \param idle  Seconds of silence before the first probe; there are 3
+ *              probes, idle / 3 seconds apart.
+ * \return  0 on success, -1 on error.
+ */
+int
+sock_set_keepalive (int fd, int idle)
+{
+	int on = 1;
+	int interval = (idle >= 3) ? idle / 3 : 1;
+	int count = 3;
+
+	if (setsockopt (fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof (on)) < 0) {
+		report (RPT_WARNING, "sock_set_keepalive: SO_KEEPALIVE failed: %s", strerror (errno));
+		return -1;
+	}
+#if defined(TCP_KEEPIDLE)
+	setsockopt (fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof (idle));
+#elif defined(TCP_KEEPALIVE)
+	/* Darwin's name for it */
+	setsockopt (fd, IPPROTO_TCP, TCP_KEEPALIVE, &idle, sizeof (idle));
+#endif
+#ifdef TCP_KEEPINTVL
+	setsockopt (fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof (interval));
+#endif
+#ifdef TCP_KEEPCNT
+	setsockopt (fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof (count));
+#endif
+	return 0;
+}
+
+/**
+ * Connect to server on its UNIX domain socket.
+ * \param path  Path of the socket
+ * \return  socket file descriptor on success, -1 on error
+ */
+int
+sock_connect_unix (const char *path)
+{
+	struct sockaddr_un servername;
+	int sock;
+
+	if (strlen (path) >= sizeof (servername.sun_path)) {
+		report (RPT_ERR, "sock_connect_unix: Path too long: %s", path);
+		return -1;
+	}
+
+	report (RPT_DEBUG, "sock_connect_unix: Creating socket");
+	sock = socket (PF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		report (RPT_ERR, "sock_connect_unix: Error creating socket");
+		return sock;
+	}
+	debug (RPT_DEBUG, "sock_connect_unix: Created socket (%i)", sock);
+
+	memset (&servername, '\0', sizeof (servername));
+	servername.sun_family = AF_UNIX;
+	strcpy (servername.sun_path, path);
+
+	if (connect (sock, (struct sockaddr *) &servername, sizeof (servername)) < 0) {
+		report (RPT_ERR, "sock_connect_unix: connect to %s failed", path);
+		close (sock);
+		return -1;
+	}
+
 	fcntl (sock, F_SETFL, O_NONBLOCK);
 
 	return sock;
@@ -104,8 +211,14 @@ sock_connect (char *host, unsigned short int port)
 int
 sock_close (int fd)
 {
+	SockBuffer *b = sock_buffer(fd);
 	int err;
 
+	/* Send what was gathered and forget the buffer */
+	if (b != NULL) {
+		b->depth = 1;
+		sock_uncork(fd);
+	}
 	err = shutdown (fd, SHUT_RDWR);
 	if (!err)
 		close (fd);
@@ -114,6 +227,127 @@ sock_close (int fd)
 }
 
 
+/**
+ * Find the buffer of a corked socket.
+ * \param fd  Socket file descriptor
+ * \return  Its buffer, or \c NULL if it is not corked.
+ */
+static SockBuffer *
+sock_buffer (int fd)
+{
+	int i;
+
+	if (corked == 0)
+		return NULL;
+	for (i = 0; i < SOCK_BUFFERS; i++) {
+		if (buffers[i].fd == fd)
+			return &buffers[i];
+	}
+	return NULL;
+}
+
+/**
+ * Make room in a buffer.
+ * \param b     The buffer
+ * \param size  Number of bytes needed behind the data gathered
+ * \return  0 on success, -1 on error.
+ */
+static int
+sock_buffer_reserve (SockBuffer *b, size_t size)
+{
+	size_t new_size = (b->size > 0) ? b->size : MAXMSG;
+	char *data;
+
+	if (b->len + size <= b->size)
+		return 0;
+	while (new_size < b->len + size)
+		new_size *= 2;
+	data = realloc(b->data, new_size);
+	if (data == NULL) {
+		report(RPT_ERR, "sock_buffer_reserve: out of memory");
+		return -1;
+	}
+	b->data = data;
+	b->size = new_size;
+	return 0;
+}
+
+/**
+ * Cork a socket: gather what is sent to it in a buffer, to be sent with
+ * one system call by sock_flush() or sock_uncork(). This saves the system
+ * calls of many small messages, e.g. the widget_set commands of a screen
+ * update. Calls can be nested, e.g. a function that sends a batch can be
+ * called while a larger batch is gathered: the data goes out with the
+ * sock_uncork() of the outermost sock_cork().
+ * \param fd  Socket file descriptor
+ * \return  0 on success, -1 on error.
+ */
+int
+sock_cork (int fd)
+{
+	SockBuffer *b = sock_buffer(fd);
+	int i;
+
+	if (b != NULL) {
+		b->depth++;
+		return 0;
+	}
+	for (i = 0; i < SOCK_BUFFERS; i++) {
+		if (buffers[i].fd == -1) {
+			if (sock_buffer_reserve(&buffers[i], MAXMSG) < 0)
+				return -1;
+			buffers[i].fd = fd;
+			buffers[i].len = 0;
+			buffers[i].depth = 1;
+			corked++;
+			return 0;
+		}
+	}
+	report(RPT_ERR, "sock_cork: too many corked sockets");
+	return -1;
+}
+
+/**
+ * Send what was gathered for a corked socket; it stays corked.
+ * \param fd  Socket file descriptor
+ * \return  Number of bytes sent, -1 on error.
+ */
+int
+sock_flush (int fd)
+{
+	SockBuffer *b = sock_buffer(fd);
+	int sent;
+
+	if ((b == NULL) || (b->len == 0))
+		return 0;
+	sent = sock_writev(fd, b->data, b->len, NULL, 0);
+	b->len = 0;
+	return sent;
+}
+
+/**
+ * Undo a sock_cork(). The outermost one sends what was gathered and lets
+ * the data be written directly again.
+ * \param fd  Socket file descriptor
+ * \return  Number of bytes sent, -1 on error.
+ */
+int
+sock_uncork (int fd)
+{
+	SockBuffer *b = sock_buffer(fd);
+	int sent;
+
+	if ((b == NULL) || (--b->depth > 0))
+		return 0;
+	sent = sock_flush(fd);
+	free(b->data);
+	b->data = NULL;
+	b->size = 0;
+	b->fd = -1;
+	corked--;
+	return sent;
+}
+
 /**
  * Send printf-like formatted output.
  * \param fd      Socket file descriptor
@@ -127,6 +361,29 @@ sock_printf(int fd, const char *format, .../*args*/ )
 	char buf[MAXMSG];
 	va_list ap;
 	int size = 0;
+	SockBuffer *b = sock_buffer(fd);
+
+	/* Corked: format right into the buffer */
+	if (b != NULL) {
+		va_start(ap, format);
+		size = vsnprintf(b->data + b->len, b->size - b->len, format, ap);
+		va_end(ap);
+		if (size < 0) {
+			report(RPT_ERR, "sock_printf: vsnprintf failed");
+			return -1;
+		}
+		if (b->len + size >= b->size) {
+			if (sock_buffer_reserve(b, size + 1) < 0)
+				return -1;
+			va_start(ap, format);
+			vsnprintf(b->data + b->len, b->size - b->len, format, ap);
+			va_end(ap);
+		}
+		b->len += size;
+		if ((b->len >= MAXMSG) && (sock_flush(fd) < 0))
+			return -1;
+		return size;
+	}
 
 	va_start(ap, format);
 	size = vsnprintf(buf, sizeof(buf), format, ap);
@@ -136,10 +393,12 @@ sock_printf(int fd, const char *format, .../*args*/ )
 		report(RPT_ERR, "sock_printf: vsnprintf failed");
 		return -1;
 	}
-	if (size > sizeof(buf))
+	if (size >= sizeof(buf)) {
 		report(RPT_WARNING, "sock_printf: vsnprintf truncated message");
+		size = sizeof(buf) - 1;
+	}
 
-	return sock_send_string(fd, buf);
+	return sock_send(fd, buf, size);
 }
 
 /**
@@ -211,6 +470,20 @@ sock_recv_string (int fd, char *dest, size_t maxlen)
 	return recvBytes;
 }
 
+/* Function that handles sock_send() if set, see sock_set_send_func() */
+static sock_send_func send_func = NULL;
+
+/**
+ * Install a function that sock_send() calls instead of writing the data
+ * itself. The server uses this to queue output to non-blocking sockets.
+ * \param func  Function to use, \c NULL to restore direct writes.
+ */
+void
+sock_set_send_func(sock_send_func func)
+{
+	send_func = func;
+}
+
 /**
  * Send raw data.
  * \param fd    Socket file descriptor
@@ -220,6 +493,41 @@ sock_recv_string (int fd, char *dest, size_t maxlen)
  */
 int
 sock_send (int fd, const void *src, size_t size)
+{
+	SockBuffer *b;
+
+	if (send_func != NULL)
+		return send_func(fd, src, size);
+
+	b = sock_buffer(fd);
+	if ((b != NULL) && (src != NULL)) {
+		int sent;
+
+		if ((size <= SOCK_BUFFER_INLINE) && (sock_buffer_reserve(b, size) == 0)) {
+			memcpy(b->data + b->len, src, size);
+			b->len += size;
+			if ((b->len >= MAXMSG) && (sock_flush(fd) < 0))
+				return -1;
+			return size;
+		}
+		/* Send large data along with the buffer, without copying it */
+		sent = sock_writev(fd, b->data, b->len, src, size);
+		b->len = 0;
+		return (sent < 0) ? sent : (int) size;
+	}
+
+	return sock_write(fd, src, size);
+}
+
+/**
+ * Write raw data directly to the socket, retrying until all of it is sent.
+ * \param fd    Socket file descriptor
+ * \param src   Buffer holding the data to send
+ * \param size  Number of bytes to send at most
+ * \return  Number of bytes sent.
+ */
+int
+sock_write (int fd, const void *src, size_t size)
 {
 	int offset = 0;
 
@@ -249,6 +557,64 @@ sock_send (int fd, const void *src, size_t size)
 	return offset;
 }
 
+/**
+ * Write two pieces of data with as few system calls as possible, retrying
+ * until all of it is sent.
+ * \param fd           Socket file descriptor
+ * \param first        First piece
+ * \param first_size   Its size
+ * \param second       Second piece, or \c NULL
+ * \param second_size  Its size
+ * \return  Number of bytes sent.
+ */
+static int
+sock_writev (int fd, const void *first, size_t first_size,
+	     const void *second, size_t second_size)
+{
+	struct iovec iov[2];
+	int count = 0;
+	int offset = 0;
+
+	if (first_size > 0) {
+		iov[count].iov_base = (void *) first;
+		iov[count++].iov_len = first_size;
+	}
+	if ((second != NULL) && (second_size > 0)) {
+		iov[count].iov_base = (void *) second;
+		iov[count++].iov_len = second_size;
+	}
+
+	while (count > 0) {
+		struct iovec *v = (iov[0].iov_len > 0) ? &iov[0] : &iov[1];
+		int sent = writev(fd, v, count);
+
+		if (sent == -1) {
+			if (errno != EAGAIN) {
+				report (RPT_ERR, "sock_send: socket write error");
+				return sent;
+			}
+			continue;
+		} else if (sent == 0) {
+			return offset;
+		}
+		offset += sent;
+
+		/* Skip what was sent */
+		while ((count > 0) && (sent >= (int) v->iov_len)) {
+			sent -= v->iov_len;
+			v->iov_len = 0;
+			v++;
+			count--;
+		}
+		if (count > 0) {
+			v->iov_base = (char *) v->iov_base + sent;
+			v->iov_len -= sent;
+		}
+	}
+
+	return offset;
+}
+
 /**
  * Receive raw data.
  * \param fd      Socket file descriptor
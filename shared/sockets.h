@@ -17,8 +17,15 @@
 # define SHUT_RDWR 2
 #endif
 
+/** Seconds of silence after which a client's connection is probed */
+#define SOCK_KEEPALIVE_IDLE 30
+
 /** Connect to server on host, port */
 int sock_connect (char *host, unsigned short int port);
+/** Connect to server on its UNIX domain socket */
+int sock_connect_unix (const char *path);
+/** Have the kernel probe an idle TCP connection, to notice a lost peer */
+int sock_set_keepalive (int fd, int idle);
 /** Disconnect from server */
 int sock_close (int fd);
 /** Send printf-like formatted output */
@@ -27,12 +34,26 @@ int sock_printf (int fd, const char *format, .../*args*/);
 int sock_send_string (int fd, const char *string);
 /** Send raw data */
 int sock_send (int fd, const void *src, size_t size);
+/** Gather output to a socket, to be sent at once */
+int sock_cork (int fd);
+/** Send the output gathered for a corked socket */
+int sock_flush (int fd);
+/** Send the output gathered and write directly again */
+int sock_uncork (int fd);
 /** Receive a line of text */
 int sock_recv_string (int fd, char *dest, size_t maxlen);
 /** Receive raw data */
 int sock_recv (int fd, void *dest, size_t maxlen);
 
 
+/** Function taking over sock_send(), e.g. to queue output */
+typedef int (*sock_send_func) (int fd, const void *src, size_t size);
+/** Install a function to be called by sock_send() instead of writing directly */
+void sock_set_send_func(sock_send_func func);
+/** Write raw data directly, ignoring any installed send function */
+int sock_write (int fd, const void *src, size_t size);
+
+
 /** Return the error message for the last error occured */
 char *sock_geterror(void);
 /** Send an already formatted error message to the client */
@@ -1,7 +1,7 @@
 /** \file shared/sring.c
  * Circular buffer implementation for string processing.
  *
- * \todo Implement sring_peek() and sring_skip().
+ * \todo Implement sring_peek().
  */
 
 /*-
@@ -13,8 +13,19 @@
  * Copyright (c) 2009, Markus Dolze
  */
 
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#ifdef HAVE_MEMFD_CREATE
+# define _GNU_SOURCE	/* for memfd_create() */
+#endif
+
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_MEMFD_CREATE
+# include <unistd.h>
+# include <sys/mman.h>
+#endif
 #ifdef DEBUG
 # include <stdio.h>
 # include <ctype.h>
@@ -44,8 +55,69 @@ sring_create(int iSize)
 	buf->size = iSize + 1;
 	buf->w = 0;
 	buf->r = 0;
+	buf->mirrored = 0;
+
+	return buf;
+}
+
+/**
+ * Allocate a new ring buffer whose data is mapped twice, back to back, so
+ * that the bytes after the end of the buffer are those at its start. Every
+ * read and write then is one contiguous region, and sring_write_ptr()
+ * always offers all free space at once. The size is rounded up to whole
+ * pages. Where this is not possible (no memfd_create()), a normal ring
+ * buffer is returned.
+ *
+ * \param iSize  Initial size of the ring buffer
+ * \return       Pointer to the created ring buffer
+ */
+sring_buffer*
+sring_create_mirrored(int iSize)
+{
+#ifdef HAVE_MEMFD_CREATE
+	sring_buffer *buf;
+	long page = sysconf(_SC_PAGESIZE);
+	size_t size;
+	char *addr;
+	int fd;
+
+	if (page <= 0)
+		return sring_create(iSize);
+	size = ((iSize + 1 + page - 1) / page) * page;
+
+	if ((fd = memfd_create("sring", 0)) < 0)
+		return sring_create(iSize);
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		return sring_create(iSize);
+	}
+
+	/* reserve room for both views, then map the pages into each half */
+	addr = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if ((addr == MAP_FAILED)
+	    || (mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+	    || (mmap(addr + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+		if (addr != MAP_FAILED)
+			munmap(addr, 2 * size);
+		close(fd);
+		return sring_create(iSize);
+	}
+	close(fd);
+
+	if ((buf = malloc(sizeof(*buf))) == NULL) {
+		munmap(addr, 2 * size);
+		return NULL;
+	}
+	buf->data = addr;
+	buf->size = size;
+	buf->w = 0;
+	buf->r = 0;
+	buf->mirrored = 1;
 
 	return buf;
+#else
+	return sring_create(iSize);
+#endif
 }
 
 /**
@@ -58,7 +130,12 @@ sring_destroy(sring_buffer *buf)
 	if (buf == NULL)
 		return;
 
-	free(buf->data);
+#ifdef HAVE_MEMFD_CREATE
+	if (buf->mirrored)
+		munmap(buf->data, 2 * buf->size);
+	else
+#endif
+		free(buf->data);
 	buf->data = NULL;
 	free(buf);
 }
@@ -142,7 +219,11 @@ sring_write(sring_buffer *buf, char *src, int src_len)
 	if (src_len > sring_getMaxWrite(buf))
 		return -1;
 
-	if (buf->w + src_len < buf->size) {
+	if (buf->mirrored) {
+		memcpy(buf->data + buf->w, src, src_len);
+		buf->w = (buf->w + src_len) % buf->size;
+	}
+	else if (buf->w + src_len < buf->size) {
 		memcpy(buf->data + buf->w, src, src_len);
 		buf->w += src_len;
 	}
@@ -179,7 +260,11 @@ sring_read(sring_buffer *buf, char *dst, int dst_len)
 	if (dst_len > sring_getMaxRead(buf))
 		dst_len = sring_getMaxRead(buf);
 
-	if (buf->r + dst_len < buf->size) {
+	if (buf->mirrored) {
+		memcpy(dst, buf->data + buf->r, dst_len);
+		buf->r = (buf->r + dst_len) % buf->size;
+	}
+	else if (buf->r + dst_len < buf->size) {
 		memcpy(dst, buf->data + buf->r, dst_len);
 		buf->r += dst_len;
 	}
@@ -198,6 +283,128 @@ sring_read(sring_buffer *buf, char *dst, int dst_len)
 	return dst_len;
 }
 
+/**
+ * Get the free space of the ring buffer that can be written to directly,
+ * e.g. by recv(). This is all of it for a mirrored buffer, otherwise the
+ * part up to the end of the buffer. Call sring_written() with the number
+ * of bytes stored there.
+ *
+ * \param buf  Ring buffer to work on
+ * \param len  Where to store the number of bytes that can be written
+ * \return     Pointer to the free space, NULL if buf is NULL
+ */
+char *
+sring_write_ptr(sring_buffer *buf, int *len)
+{
+	int n;
+
+	if (buf == NULL) {
+		*len = 0;
+		return NULL;
+	}
+
+	n = sring_getMaxWrite(buf);
+	if (!buf->mirrored && (n > (int) (buf->size - buf->w)))
+		n = buf->size - buf->w;
+	*len = n;
+
+	return buf->data + buf->w;
+}
+
+/**
+ * Add n bytes written to the space sring_write_ptr() returned to the data
+ * in the ring buffer.
+ *
+ * \param buf  Ring buffer to work on
+ * \param n    Number of bytes written
+ */
+void
+sring_written(sring_buffer *buf, int n)
+{
+	if (buf == NULL || n <= 0)
+		return;
+
+	if (n > sring_getMaxWrite(buf))
+		n = sring_getMaxWrite(buf);
+	buf->w = (buf->w + n) % buf->size;
+}
+
+/**
+ * Skip n bytes of the ring buffer without reading them.
+ *
+ * \param buf  Ring buffer to work on
+ * \param n    Number of bytes to skip at most
+ * \return     The number of bytes actually skipped
+ */
+int
+sring_skip(sring_buffer *buf, int n)
+{
+	if (buf == NULL || n <= 0)
+		return 0;
+
+	if (n > sring_getMaxRead(buf))
+		n = sring_getMaxRead(buf);
+	buf->r = (buf->r + n) % buf->size;
+
+	return n;
+}
+
+/* Find the first end character (\r, \n or \0) in the n bytes at p. Each
+ * search only scans up to the end character found before. */
+static char *
+sring_find_end(char *p, int n)
+{
+	char *end = NULL;
+	char *q;
+
+	if (n <= 0)
+		return NULL;
+
+	if ((q = memchr(p, '\n', n)) != NULL) {
+		end = q;
+		n = q - p;
+	}
+	if ((q = memchr(p, '\r', n)) != NULL) {
+		end = q;
+		n = q - p;
+	}
+	if ((q = memchr(p, '\0', n)) != NULL)
+		end = q;
+
+	return end;
+}
+
+/**
+ * Tell how many bytes the next string in the ring buffer takes up. The
+ * string is a sequence of bytes terminated by \\r, \\n or \\0; the count
+ * includes the end character. The two parts of the data before and after
+ * the end of the buffer are searched with memchr().
+ *
+ * \param buf  Ring buffer to work on
+ * \return     Number of bytes, 0 if no complete string is available
+ */
+int
+sring_string_length(sring_buffer *buf)
+{
+	int n;
+	int first;
+	char *end;
+
+	if (buf == NULL)
+		return 0;
+
+	n = sring_getMaxRead(buf);
+	first = buf->mirrored ? n : (int) (buf->size - buf->r);
+	if (first > n)
+		first = n;
+
+	if ((end = sring_find_end(buf->data + buf->r, first)) != NULL)
+		return end - (buf->data + buf->r) + 1;
+	if ((end = sring_find_end(buf->data, n - first)) != NULL)
+		return first + (end - buf->data) + 1;
+	return 0;
+}
+
 /**
  * Return the next string from the ring buffer.
  * The next string is a sequence of bytes terminated by \\r, \\n or \\0. The
@@ -211,36 +418,147 @@ sring_read(sring_buffer *buf, char *dst, int dst_len)
 char *
 sring_read_string(sring_buffer *buf)
 {
-	int n;
-	char *border;
-	char *p;
 	char *dst;
 	int dst_len;
 
-	if (buf == NULL)
+	dst_len = sring_string_length(buf);
+	if (dst_len == 0)
+		return NULL;
+
+	if ((dst = malloc(dst_len)) == NULL)
 		return NULL;
 
+	sring_read(buf, dst, dst_len);
+	dst[dst_len-1] = '\0';
+
+	return dst;
+}
+
+/**
+ * Read the next string from the ring buffer into a buffer of the
+ * application, like sring_read_string() but without allocating memory.
+ * The string is always NUL terminated and does not include the end
+ * character. If it does not fit, it is cut short; the rest of it is
+ * skipped.
+ *
+ * \param buf       Ring buffer to work on
+ * \param dst       Pointer to target buffer
+ * \param dst_size  Size of the target buffer
+ * \return          Length of the string stored, -1 if no string is available
+ */
+int
+sring_read_string_buf(sring_buffer *buf, char *dst, int dst_size)
+{
+	int len;
+
+	if (dst == NULL || dst_size <= 0)
+		return -1;
+
+	len = sring_string_length(buf);
+	if (len == 0)
+		return -1;
+
+	if (len > dst_size) {
+		sring_read(buf, dst, dst_size);
+		sring_skip(buf, len - dst_size);
+		len = dst_size;
+	}
+	else
+		sring_read(buf, dst, len);
+	dst[len-1] = '\0';
+
+	return len - 1;
+}
+
+/**
+ * Tell how many bytes the complete lines in the ring buffer take up.
+ * Lines are terminated by \r, \n or \0; the count includes the last end
+ * character, a trailing incomplete line is not counted.
+ *
+ * \param buf  Ring buffer to work on
+ * \return     Number of bytes, 0 if no complete line is available
+ */
+int
+sring_lines_length(sring_buffer *buf)
+{
+	int n;
+	char *p;
+
+	if (buf == NULL)
+		return 0;
+
+	/* Search backwards from the write pointer: usually the last byte
+	 * received already is an end character */
 	n = sring_getMaxRead(buf);
-	border = buf->data + buf->size;
-	p = buf->data + buf->r;
+	p = buf->data + buf->w;
 
-	while (--n >= 0) {
+	while (n > 0) {
+		if (p == buf->data)
+			p = buf->data + buf->size;
+		p--;
 		if (*p == '\r' || *p == '\n' || *p == '\0')
 			break;
-		p++;
-		if (p == border)
-			p = buf->data;
-	};
+		n--;
+	}
+	return n;
+}
+
+/**
+ * Tell how many bytes the complete frames in the ring buffer take up.
+ * A frame is a 2 byte length in network byte order followed by that many
+ * bytes of payload; a trailing incomplete frame is not counted.
+ *
+ * \param buf  Ring buffer to work on
+ * \return     Number of bytes, 0 if no complete frame is available
+ */
+int
+sring_frames_length(sring_buffer *buf)
+{
+	int n;
+	int len = 0;
 
-	if (n == -1)
+	if (buf == NULL)
+		return 0;
+
+	n = sring_getMaxRead(buf);
+	while (n - len >= 2) {
+		unsigned int pos = (buf->r + len) % buf->size;
+		int frame = ((unsigned char) buf->data[pos] << 8)
+			  | (unsigned char) buf->data[(pos + 1) % buf->size];
+
+		if (2 + frame > n - len)
+			break;
+		len += 2 + frame;
+	}
+	return len;
+}
+
+/**
+ * Return all complete lines from the ring buffer in one string.
+ * Lines are terminated by \r, \n or \0. Everything up to and including
+ * the last end character is returned, the end characters are kept. A
+ * trailing incomplete line stays in the buffer. The memory for the string
+ * is allocated dynamically and must be free'd by the application. The
+ * string is always NUL terminated.
+ *
+ * \param buf  Ring buffer to work on
+ * \return     Pointer to allocated string, NULL if no complete line is available
+ */
+char *
+sring_read_lines(sring_buffer *buf)
+{
+	char *dst;
+	int dst_len;
+
+	dst_len = sring_lines_length(buf);
+	if (dst_len == 0)
 		return NULL;
 
-	dst_len = sring_getMaxRead(buf) - n;
-	if ((dst = malloc(dst_len)) == NULL)
+	if ((dst = malloc(dst_len + 1)) == NULL)
 		return NULL;
 
 	sring_read(buf, dst, dst_len);
-	dst[dst_len-1] = '\0';
+	dst[dst_len] = '\0';
 
 	return dst;
 }
@@ -7,16 +7,26 @@ typedef struct sring_buffer_t {
 	unsigned int size;	/**< The buffer's size */
 	unsigned int w;		/**< write pointer */
 	unsigned int r;		/**< read pointer */
+	int mirrored;		/**< data is mapped twice, back to back */
 } sring_buffer;
 
 sring_buffer* sring_create(int iSize);
+sring_buffer* sring_create_mirrored(int iSize);
 void sring_destroy(sring_buffer *buf);
 void sring_clear(sring_buffer *buf);
 int  sring_getMaxWrite(sring_buffer *buf);
 int  sring_getMaxRead(sring_buffer *buf);
 int  sring_write(sring_buffer *buf, char *src, int src_len);
 int  sring_read(sring_buffer *buf, char *dst, int dst_len);
+char* sring_write_ptr(sring_buffer *buf, int *len);
+void sring_written(sring_buffer *buf, int n);
+int  sring_skip(sring_buffer *buf, int n);
+int  sring_string_length(sring_buffer *buf);
 char* sring_read_string(sring_buffer *buf);
+int  sring_read_string_buf(sring_buffer *buf, char *dst, int dst_size);
+char* sring_read_lines(sring_buffer *buf);
+int  sring_lines_length(sring_buffer *buf);
+int  sring_frames_length(sring_buffer *buf);
 void sring_dump(sring_buffer *buf);
 
 #endif
@@ -27,8 +27,7 @@
 int
 get_args (char **argv, char *str, int max_args)
 {
-	char *delimiters = " \n";
-	char *item;
+	const char *delimiters = " \n";
 	int i = 0;
 
 	if (!argv)
@@ -40,15 +39,78 @@ get_args (char **argv, char *str, int max_args)
 
 	debug(RPT_DEBUG, "get_args(%i): string=%s", max_args, str);
 
-	/* Parse the command line... */
-	for (item = strtok (str, delimiters); item; item = strtok (NULL, delimiters)) {
-		debug(RPT_DEBUG, "get_args: item=%s", item);
-		if (i < max_args) {
-			argv[i] = item;
-			i++;
-		} else
-			return i;
+	/* Parse the command line; strspn() and strcspn() look at many
+	 * bytes at a time */
+	while (i < max_args) {
+		str += strspn(str, delimiters);
+		if (*str == '\0')
+			break;
+		argv[i++] = str;
+		str += strcspn(str, delimiters);
+		debug(RPT_DEBUG, "get_args: item=%.*s", (int) (str - argv[i-1]), argv[i-1]);
+		if (*str == '\0')
+			break;
+		*str++ = '\0';
 	}
 
 	return i;
 }
+
+/** Decode a UTF-8 string in place into ISO-8859-1, the encoding drivers
+ * translate to their displays' character sets.
+ * Characters beyond ISO-8859-1 become '?'. Bytes that are no valid UTF-8
+ * are kept as they are, so ISO-8859-1 text passes unchanged.
+ * \param *str  The string to decode; the result is never longer.
+ * \return      Length of the decoded string.
+ */
+int
+utf8_to_latin1 (char *str)
+{
+	const unsigned char *in = (const unsigned char *) str;
+	unsigned char *out = (unsigned char *) str;
+
+	while (*in != '\0') {
+		int len, i;
+		unsigned long code;
+
+		if (*in < 0x80) {
+			*out++ = *in++;
+			continue;
+		}
+
+		/* length of the sequence and the bits of its lead byte */
+		if ((*in >= 0xC2) && (*in <= 0xDF)) {
+			len = 2;
+			code = *in & 0x1F;
+		}
+		else if ((*in >= 0xE0) && (*in <= 0xEF)) {
+			len = 3;
+			code = *in & 0x0F;
+		}
+		else if ((*in >= 0xF0) && (*in <= 0xF4)) {
+			len = 4;
+			code = *in & 0x07;
+		}
+		else
+			len = 0;
+
+		for (i = 1; i < len; i++) {
+			if ((in[i] & 0xC0) != 0x80)
+				break;
+			code = (code << 6) | (in[i] & 0x3F);
+		}
+		/* reject truncated and overlong sequences */
+		if ((len == 0) || (i < len)
+		    || ((len == 3) && (code < 0x800))
+		    || ((len == 4) && ((code < 0x10000) || (code > 0x10FFFF)))) {
+			*out++ = *in++;
+			continue;
+		}
+
+		*out++ = (code <= 0xFF) ? (unsigned char) code : '?';
+		in += len;
+	}
+	*out = '\0';
+
+	return (char *) out - str;
+}
@@ -6,5 +6,6 @@
 #define STR_H
 
 int get_args (char **argv, char *str, int max_args);
+int utf8_to_latin1 (char *str);
 
 #endif
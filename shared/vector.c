@@ -0,0 +1,249 @@
+/** \file shared/vector.c
+ * Define routines to deal with vectors: lists stored in one array.
+ *
+ * The payloads occupy items[first] to items[first + length - 1]. Room
+ * in front of them makes V_Shift() and V_Prepend() as cheap as
+ * V_Pop() and V_Append(); the array grows by doubling.
+ */
+
+/* This file is part of LCDproc.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "vector.h"
+
+/** Number of payloads a freshly grown vector has room for */
+#define V_INITIAL_SIZE	8
+
+
+/** Make room for one more payload behind the last one.
+ * \param v  Vector object.
+ * \return   -1 on error, 0 on success.
+ */
+static int
+V_Reserve(Vector *v)
+{
+	if (v->first + v->length < v->size)
+		return 0;
+
+	/* Reuse the room in front if at least half the array is unused */
+	if ((v->first > 0) && (v->length < v->size / 2)) {
+		memmove(v->items, v->items + v->first, v->length * sizeof(void *));
+		v->first = 0;
+		return 0;
+	}
+	else {
+		int size = (v->size > 0) ? 2 * v->size : V_INITIAL_SIZE;
+		void **items = realloc(v->items, size * sizeof(void *));
+
+		if (items == NULL)
+			return -1;
+		v->items = items;
+		v->size = size;
+	}
+	return 0;
+}
+
+
+/** Create new vector.
+ * \return  Pointer to freshly created vector object; \c NULL on error.
+ */
+Vector *
+V_new(void)
+{
+	return calloc(1, sizeof(Vector));
+}
+
+
+/** Destroy a vector.
+ * The payloads are not touched.
+ * \param v  Vector object to destroy.
+ */
+void
+V_Destroy(Vector *v)
+{
+	if (v == NULL)
+		return;
+
+	free(v->items);
+	free(v);
+}
+
+
+/** Add a payload behind the last one.
+ * \param v     Vector object.
+ * \param data  Payload to add.
+ * \return      -1 on error, 0 on success.
+ */
+int
+V_Append(Vector *v, void *data)
+{
+	if ((v == NULL) || (V_Reserve(v) < 0))
+		return -1;
+
+	v->items[v->first + v->length++] = data;
+	return 0;
+}
+
+
+/** Add a payload in front of the first one.
+ * \param v     Vector object.
+ * \param data  Payload to add.
+ * \return      -1 on error, 0 on success.
+ */
+int
+V_Prepend(Vector *v, void *data)
+{
+	if (v == NULL)
+		return -1;
+
+	if (v->first > 0) {
+		v->items[--v->first] = data;
+		v->length++;
+		return 0;
+	}
+	return V_Insert(v, 0, data);
+}
+
+
+/** Insert a payload at a position, moving the following ones back.
+ * \param v      Vector object.
+ * \param index  Position of the new payload, 0 to V_Length(v).
+ * \param data   Payload to add.
+ * \return       -1 on error, 0 on success.
+ */
+int
+V_Insert(Vector *v, int index, void *data)
+{
+	void **at;
+
+	if ((v == NULL) || (index < 0) || (index > v->length))
+		return -1;
+	if (V_Reserve(v) < 0)
+		return -1;
+
+	at = v->items + v->first + index;
+	memmove(at + 1, at, (v->length - index) * sizeof(void *));
+	*at = data;
+	v->length++;
+	return 0;
+}
+
+
+/** Insert a payload into a sorted vector: behind the last payload that it
+ * compares greater than or equal to, so payloads comparing equal stay in
+ * the order they were added (like LL_PriorityEnqueue()).
+ * \param v        Vector object.
+ * \param data     Payload to add.
+ * \param compare  Function returning <0, 0 or >0 like strcmp().
+ * \return         -1 on error, 0 on success.
+ */
+int
+V_SortedInsert(Vector *v, void *data, int (*compare)(void *, void *))
+{
+	int index;
+
+	if ((v == NULL) || (compare == NULL))
+		return -1;
+
+	for (index = v->length; index > 0; index--) {
+		if (compare(data, v->items[v->first + index - 1]) >= 0)
+			break;
+	}
+	return V_Insert(v, index, data);
+}
+
+
+/** Remove the last payload.
+ * \param v  Vector object.
+ * \return   The payload; \c NULL if the vector is empty.
+ */
+void *
+V_Pop(Vector *v)
+{
+	if ((v == NULL) || (v->length == 0))
+		return NULL;
+
+	return v->items[v->first + --v->length];
+}
+
+
+/** Remove the first payload.
+ * \param v  Vector object.
+ * \return   The payload; \c NULL if the vector is empty.
+ */
+void *
+V_Shift(Vector *v)
+{
+	void *data;
+
+	if ((v == NULL) || (v->length == 0))
+		return NULL;
+
+	data = v->items[v->first];
+	v->length--;
+	v->first = (v->length > 0) ? v->first + 1 : 0;
+	return data;
+}
+
+
+/** Remove the payload at a position, moving the following ones forward.
+ * \param v      Vector object.
+ * \param index  Position of the payload.
+ * \return       The payload; \c NULL if the position is out of range.
+ */
+void *
+V_RemoveAt(Vector *v, int index)
+{
+	void **at;
+	void *data;
+
+	if ((v == NULL) || (index < 0) || (index >= v->length))
+		return NULL;
+
+	if (index == 0)
+		return V_Shift(v);
+
+	at = v->items + v->first + index;
+	data = *at;
+	memmove(at, at + 1, (v->length - index - 1) * sizeof(void *));
+	v->length--;
+	return data;
+}
+
+
+/** Remove the first occurrence of a payload.
+ * \param v     Vector object.
+ * \param data  Payload to remove.
+ * \return      The payload; \c NULL if it is not in the vector.
+ */
+void *
+V_Remove(Vector *v, void *data)
+{
+	return V_RemoveAt(v, V_IndexOf(v, data));
+}
+
+
+/** Find the position of a payload.
+ * \param v     Vector object.
+ * \param data  Payload to look for.
+ * \return      Position of its first occurrence; -1 if it is not found.
+ */
+int
+V_IndexOf(Vector *v, void *data)
+{
+	int i;
+
+	if (v == NULL)
+		return -1;
+
+	for (i = 0; i < v->length; i++) {
+		if (v->items[v->first + i] == data)
+			return i;
+	}
+	return -1;
+}
@@ -0,0 +1,91 @@
+/** \file shared/vector.h
+ * Define routines to deal with vectors: lists stored in one array.
+ */
+
+/* This file is part of LCDproc.
+ *
+ * This file is released under the GNU General Public License.
+ * Refer to the COPYING file distributed with this package.
+ */
+
+#ifndef VECTOR_H
+#define VECTOR_H
+
+/***********************************************************************
+  A vector holds "void *" payloads one after another in a single array,
+  so walking it touches consecutive memory instead of chasing pointers.
+  Unlike a LinkedList it has no "current" position: it is walked by
+  index, and any number of loops may walk it at the same time.
+
+    Vector *list;
+    int i;
+
+    list = V_new();
+    if (!list) handle_an_error();
+
+    V_Append(list, (void *) thingie);
+    for (i = 0; i < V_Length(list); i++) {
+      thingie = (my_data *) V_Get(list, i);
+      ... do something to it ...
+    }
+    V_Remove(list, (void *) thingie);
+
+  Adding and removing at either end is cheap, so a vector also serves
+  as a stack or a queue (V_Append(), V_Pop(), V_Prepend(), V_Shift()).
+  Inserting or removing in the middle moves the payloads behind.
+
+  For errors, the general convention is that "0" means success, and
+  a negative number means failure (as in LL.h).
+***********************************************************************/
+
+/** Structure for a vector */
+typedef struct Vector {
+	void **items;		/**< Array of payloads */
+	int first;		/**< Index of the first payload in items */
+	int length;		/**< Number of payloads */
+	int size;		/**< Allocated size of items */
+} Vector;
+
+// See vector.c for more detailed descriptions of these functions.
+
+Vector *V_new(void);
+void V_Destroy(Vector *v);
+
+int V_Append(Vector *v, void *data);
+int V_Prepend(Vector *v, void *data);
+int V_Insert(Vector *v, int index, void *data);
+int V_SortedInsert(Vector *v, void *data, int (*compare)(void *, void *));
+
+void *V_Pop(Vector *v);
+void *V_Shift(Vector *v);
+void *V_RemoveAt(Vector *v, int index);
+void *V_Remove(Vector *v, void *data);
+
+int V_IndexOf(Vector *v, void *data);
+
+
+/** Tell the number of payloads in a vector.
+ * \param v  Vector object.
+ * \return   Number of payloads, 0 for a NULL vector.
+ */
+static inline int
+V_Length(Vector *v)
+{
+	return (v != NULL) ? v->length : 0;
+}
+
+
+/** Get a payload by its position.
+ * \param v      Vector object.
+ * \param index  Position, counted from 0.
+ * \return       Payload; \c NULL if the position is out of range.
+ */
+static inline void *
+V_Get(Vector *v, int index)
+{
+	if ((v == NULL) || (index < 0) || (index >= v->length))
+		return NULL;
+	return v->items[v->first + index];
+}
+
+#endif